@@ -0,0 +1,31 @@
+if(UNIX)
+  find_package(PkgConfig QUIET)
+  pkg_check_modules(_ZSTD QUIET libzstd)
+endif()
+
+find_path(ZSTD_INCLUDE_DIR NAMES zstd.h HINTS ${_ZSTD_INCLUDEDIR})
+find_library(ZSTD_LIBRARY NAMES zstd libzstd HINTS ${_ZSTD_LIBDIR})
+
+if(ZSTD_INCLUDE_DIR)
+    if(_ZSTD_VERSION)
+        set(ZSTD_VERSION ${_ZSTD_VERSION})
+    else()
+        file(STRINGS "${ZSTD_INCLUDE_DIR}/zstd.h" ZSTD_VERSION_STR REGEX "^#define[\t ]+ZSTD_VERSION_(MAJOR|MINOR|RELEASE)[\t ]+[0-9]+")
+        string(REGEX REPLACE ".*MAJOR[\t ]+([0-9]+).*MINOR[\t ]+([0-9]+).*RELEASE[\t ]+([0-9]+).*" "\\1.\\2.\\3" ZSTD_VERSION "${ZSTD_VERSION_STR}")
+    endif()
+endif()
+
+set(ZSTD_INCLUDE_DIRS ${ZSTD_INCLUDE_DIR})
+set(ZSTD_LIBRARIES ${ZSTD_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+
+find_package_handle_standard_args(Zstd
+    REQUIRED_VARS
+        ZSTD_LIBRARY
+        ZSTD_INCLUDE_DIR
+    VERSION_VAR
+        ZSTD_VERSION
+)
+
+mark_as_advanced(ZSTD_INCLUDE_DIR ZSTD_LIBRARY)
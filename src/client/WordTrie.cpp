@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "WordTrie.h"
+
+#include <algorithm>
+#include <utility>
+
+void WordTrie::add(const QString &word, const size_t maxWords)
+{
+    if (word.isEmpty())
+        return;
+
+    Node *node = &m_root;
+    for (const QChar c : word) {
+        auto &child = node->children[c];
+        if (child == nullptr)
+            child = std::make_unique<Node>();
+        node = child.get();
+    }
+
+    if (node->count != 0)
+        m_ranks.erase(Rank{node->count, node->lastSeen, word});
+    ++node->count;
+    node->lastSeen = ++m_sequence;
+    m_ranks.emplace(node->count, node->lastSeen, word);
+
+    while (m_ranks.size() > maxWords)
+        remove(std::get<QString>(*m_ranks.begin()));
+}
+
+void WordTrie::remove(const QString &word)
+{
+    std::vector<Node *> path;
+    path.reserve(static_cast<size_t>(word.size()) + 1);
+    path.emplace_back(&m_root);
+    for (const QChar c : word) {
+        const auto it = path.back()->children.find(c);
+        if (it == path.back()->children.end())
+            return;
+        path.emplace_back(it->second.get());
+    }
+
+    Node &node = *path.back();
+    if (node.count == 0)
+        return;
+    m_ranks.erase(Rank{node.count, node.lastSeen, word});
+    node.count = 0;
+
+    // Prune the nodes that no longer lead to a word.
+    for (int i = word.size() - 1; i >= 0; --i) {
+        const Node &child = *path[static_cast<size_t>(i) + 1];
+        if (child.count != 0 || !child.children.empty())
+            break;
+        path[static_cast<size_t>(i)]->children.erase(word.at(i));
+    }
+}
+
+std::vector<QString> WordTrie::complete(const QString &prefix) const
+{
+    const Node *node = &m_root;
+    for (const QChar c : prefix) {
+        const auto it = node->children.find(c);
+        if (it == node->children.end())
+            return {};
+        node = it->second.get();
+    }
+
+    std::vector<Rank> found;
+    QString word = prefix;
+    const auto collect = [&found, &word](const Node &n, const auto &recurse) -> void {
+        if (n.count != 0)
+            found.emplace_back(n.count, n.lastSeen, word);
+        for (const auto &kv : n.children) {
+            word.append(kv.first);
+            recurse(*kv.second, recurse);
+            word.chop(1);
+        }
+    };
+    collect(*node, collect);
+
+    std::sort(found.begin(), found.end(), [](const Rank &a, const Rank &b) {
+        return std::tie(std::get<0>(a), std::get<1>(a)) > std::tie(std::get<0>(b), std::get<1>(b));
+    });
+
+    std::vector<QString> result;
+    result.reserve(found.size());
+    for (Rank &rank : found)
+        result.emplace_back(std::move(std::get<QString>(rank)));
+    return result;
+}
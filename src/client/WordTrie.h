@@ -0,0 +1,54 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <vector>
+#include <QChar>
+#include <QString>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+
+/// The words used for tab completion. Each remembers how often and how recently it
+/// was seen; once there are too many, the least used words are forgotten.
+class NODISCARD WordTrie final
+{
+private:
+    struct NODISCARD Node final
+    {
+        std::map<QChar, std::unique_ptr<Node>> children;
+        // zero unless a word ends here
+        uint32_t count = 0;
+        uint64_t lastSeen = 0;
+    };
+    // (count, lastSeen, word), so the first is the one to forget.
+    using Rank = std::tuple<uint32_t, uint64_t, QString>;
+
+    Node m_root;
+    std::set<Rank> m_ranks;
+    uint64_t m_sequence = 0;
+
+public:
+    WordTrie() = default;
+    ~WordTrie() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(WordTrie);
+
+public:
+    NODISCARD bool empty() const { return m_ranks.empty(); }
+    NODISCARD size_t size() const { return m_ranks.size(); }
+
+    /// Counts the word, then forgets words until there are at most maxWords.
+    void add(const QString &word, size_t maxWords);
+    /// The words that start with prefix (including prefix itself), most used first,
+    /// then most recently seen.
+    NODISCARD std::vector<QString> complete(const QString &prefix) const;
+
+private:
+    void remove(const QString &word);
+};
@@ -4,8 +4,12 @@
 
 #include "displaywidget.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
 #include <QMessageLogContext>
-#include <QRegularExpression>
 #include <QScrollBar>
 #include <QString>
 #include <QTextCursor>
@@ -17,6 +21,19 @@
 
 static const constexpr int SCROLLBAR_BUFFER = 1;
 static const constexpr int TAB_WIDTH_SPACES = 8;
+// Text is shown this long after it arrives at most; about one frame.
+static const constexpr int FLUSH_INTERVAL_MS = 16;
+// The formats are only ever forgotten all at once, in the unlikely case that the
+// MUD has used this many combinations.
+static const constexpr int MAX_CACHED_FORMATS = 1024;
+
+uint qHash(const AnsiState &state, const uint seed)
+{
+    return qHash(qMakePair(qMakePair(state.foreground.rgba(), state.background.rgba()),
+                           (state.weight << 3) | (state.italic ? 4 : 0) | (state.underline ? 2 : 0)
+                               | (state.strikeOut ? 1 : 0)),
+                 seed);
+}
 
 DisplayWidget::DisplayWidget(QWidget *const parent)
     : QTextEdit(parent)
@@ -44,11 +61,18 @@ DisplayWidget::DisplayWidget(QWidget *const parent)
     frameFormat.setForeground(m_foregroundColor);
     document()->rootFrame()->setFrameFormat(frameFormat);
 
+    // Whole blocks are evicted from the top once there are more than this.
+    document()->setMaximumBlockCount(settings.linesOfScrollback);
+
     m_cursor = document()->rootFrame()->firstCursorPosition();
-    m_format = m_cursor.charFormat();
-    setDefaultFormat(m_format);
+    setDefaultFormat(m_ansiState);
+    m_format = getFormat(m_ansiState);
     m_cursor.setCharFormat(m_format);
 
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(FLUSH_INTERVAL_MS);
+    connect(&m_flushTimer, &QTimer::timeout, this, &DisplayWidget::flushText);
+
     // Add an extra character for the scrollbars
     QFontMetrics fm(m_serverOutputFont);
     int y = fm.lineSpacing() * (settings.rows + SCROLLBAR_BUFFER);
@@ -107,320 +131,280 @@ void DisplayWidget::resizeEvent(QResizeEvent *const event)
     QTextEdit::resizeEvent(event);
 }
 
-void DisplayWidget::setDefaultFormat(QTextCharFormat &format)
+void DisplayWidget::setDefaultFormat(AnsiState &state)
 {
+    state = AnsiState{};
+    state.foreground = m_foregroundColor;
+    state.background = m_backgroundColor;
+}
+
+const QTextCharFormat &DisplayWidget::getFormat(const AnsiState &state)
+{
+    auto it = m_formats.find(state);
+    if (it != m_formats.end())
+        return it.value();
+
+    if (m_formats.size() >= MAX_CACHED_FORMATS)
+        m_formats.clear();
+
+    QTextCharFormat format;
     format.setFont(m_serverOutputFont);
-    format.setBackground(m_backgroundColor);
-    format.setForeground(m_foregroundColor);
-    format.setFontWeight(QFont::Normal);
-    format.setFontUnderline(false);
-    format.setFontItalic(false);
-    format.setFontStrikeOut(false);
+    format.setBackground(state.background);
+    format.setForeground(state.foreground);
+    format.setFontWeight(state.weight);
+    format.setFontUnderline(state.underline);
+    format.setFontItalic(state.italic);
+    format.setFontStrikeOut(state.strikeOut);
+    return m_formats.insert(state, format).value();
 }
 
 void DisplayWidget::displayText(const QString &str)
 {
-    // Split ansi from this text
-    QStringList textList, ansiList;
-    int textIndex = 0, ansiIndex = 0;
-    // ANSI codes are formatted as the following:
-    // escape + [ + n1 (+ n2) + m
-    static const QRegularExpression ansiRx(R"(\x1b\[((?:\d+;)*\d+)m)");
-    QRegularExpressionMatchIterator it = ansiRx.globalMatch(str);
-    while (it.hasNext()) {
-        QRegularExpressionMatch match = it.next();
-        ansiIndex = match.capturedStart(0);
-        textList << str.mid(textIndex, ansiIndex - textIndex);
-        ansiList << match.captured(1);
-        textIndex = match.capturedEnd(0);
-    }
-    if (textIndex < str.length()) {
-        textList << str.mid(textIndex);
+    m_pendingText += str;
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void DisplayWidget::flushText()
+{
+    if (m_pendingText.isEmpty())
+        return;
+
+    const QString text = std::exchange(m_pendingText, QString{});
+    document()->setMaximumBlockCount(getConfig().integratedClient.linesOfScrollback);
+
+    m_cursor.beginEditBlock();
+    insertText(text);
+    m_cursor.endEditBlock();
+
+    verticalScrollBar()->setSliderPosition(verticalScrollBar()->maximum());
+}
+
+// ANSI codes are formatted as the following:
+// escape + [ + n1 (+ ; + n2 ...) + m
+enum class NODISCARD SgrCharEnum : uint8_t { DIGIT, SEMICOLON, FINAL, OTHER };
+enum class NODISCARD SgrStateEnum : uint8_t { EXPECT_DIGIT, IN_NUMBER, DONE, INVALID };
+static constexpr const size_t NUM_SGR_CHARS = 4;
+static constexpr const size_t NUM_SGR_STATES = 2; // DONE and INVALID are final
+
+// Indexed by the state and then the class of the next character.
+static constexpr const SgrStateEnum SGR_TRANSITIONS[NUM_SGR_STATES][NUM_SGR_CHARS] = {
+    // EXPECT_DIGIT: DIGIT, SEMICOLON, FINAL, OTHER
+    {SgrStateEnum::IN_NUMBER,
+     SgrStateEnum::INVALID,
+     SgrStateEnum::INVALID,
+     SgrStateEnum::INVALID},
+    // IN_NUMBER: DIGIT, SEMICOLON, FINAL, OTHER
+    {SgrStateEnum::IN_NUMBER,
+     SgrStateEnum::EXPECT_DIGIT,
+     SgrStateEnum::DONE,
+     SgrStateEnum::INVALID},
+};
+
+// Anything bigger is an unknown code anyway.
+static constexpr const int MAX_SGR_CODE = 9999;
+
+static SgrCharEnum classify(const QChar c)
+{
+    const ushort u = c.unicode();
+    if (u >= '0' && u <= '9')
+        return SgrCharEnum::DIGIT;
+    if (u == ';')
+        return SgrCharEnum::SEMICOLON;
+    if (u == 'm')
+        return SgrCharEnum::FINAL;
+    return SgrCharEnum::OTHER;
+}
+
+// Reads the SGR sequence at pos, which must be an escape, into codes and returns the
+// position after it; returns -1 and leaves codes unspecified if it isn't one.
+static int scanSgr(const QString &str, const int pos, std::vector<int> &codes)
+{
+    codes.clear();
+    if (pos + 1 >= str.length() || str.at(pos + 1) != '[')
+        return -1;
+
+    int code = 0;
+    SgrStateEnum state = SgrStateEnum::EXPECT_DIGIT;
+    for (int i = pos + 2; i < str.length(); ++i) {
+        const QChar c = str.at(i);
+        const SgrCharEnum cls = classify(c);
+        state = SGR_TRANSITIONS[static_cast<size_t>(state)][static_cast<size_t>(cls)];
+        switch (state) {
+        case SgrStateEnum::IN_NUMBER:
+            code = std::min(code * 10 + (c.unicode() - '0'), MAX_SGR_CODE);
+            break;
+        case SgrStateEnum::EXPECT_DIGIT:
+            codes.emplace_back(std::exchange(code, 0));
+            break;
+        case SgrStateEnum::DONE:
+            codes.emplace_back(code);
+            return i + 1;
+        case SgrStateEnum::INVALID:
+            return -1;
+        }
     }
+    // The sequence was cut off.
+    return -1;
+}
 
-    // Display text using a cursor
-    QStringListIterator textIterator(textList), ansiIterator(ansiList);
-    while (textIterator.hasNext()) {
-        QString textStr = textIterator.next();
-
-        if (textStr.length() != 0) {
-            // Backspaces occur on the next character being drawn
-            if (m_backspace) {
-                m_cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, 1);
-                m_backspace = false;
-            }
-            int backspaceIndex = textStr.indexOf('\10');
-            if (backspaceIndex == -1) {
-                // No backspace
-                m_cursor.insertText(textStr, m_format);
-
-            } else {
-                m_backspace = true;
-                m_cursor.insertText(textStr.mid(0, backspaceIndex), m_format);
-                m_cursor.insertText(textStr.mid(backspaceIndex + 1), m_format);
-            }
+void DisplayWidget::insertText(const QString &str)
+{
+    int textIndex = 0;
+    for (int i = str.indexOf('\x1b'); i != -1; i = str.indexOf('\x1b', i)) {
+        const int end = scanSgr(str, i, m_sgrCodes);
+        if (end == -1) {
+            // Not SGR, so it's displayed like any other text.
+            ++i;
+            continue;
         }
 
+        insertRun(str.mid(textIndex, i - textIndex));
         // Change format according to ansi codes
-        if (ansiIterator.hasNext()) {
-            // split several semicoloned ansi codes into individual codes
-            QStringList subAnsi = ansiIterator.next().split(';');
-            QStringListIterator ansiCodeIterator(subAnsi);
-            while (ansiCodeIterator.hasNext()) {
-                int ansiCode = ansiCodeIterator.next().toInt();
-                updateFormat(m_format, ansiCode);
-            }
-        }
+        for (const int ansiCode : m_sgrCodes)
+            updateFormat(m_ansiState, ansiCode);
+        m_format = getFormat(m_ansiState);
+        textIndex = i = end;
     }
+    if (textIndex < str.length())
+        insertRun(str.mid(textIndex));
+}
 
-    // Ensure we limit the scrollback history
-    const int lineLimit = getConfig().integratedClient.linesOfScrollback;
-    const int lineCount = document()->lineCount();
-    if (lineCount > lineLimit) {
-        const int trimLines = lineCount - lineLimit;
-        m_cursor.movePosition(QTextCursor::Start);
-        m_cursor.movePosition(QTextCursor::Down, QTextCursor::KeepAnchor, trimLines);
-        m_cursor.removeSelectedText();
-        m_cursor.movePosition(QTextCursor::End);
+void DisplayWidget::insertRun(const QString &textStr)
+{
+    if (textStr.isEmpty())
+        return;
+
+    // Backspaces occur on the next character being drawn
+    if (m_backspace) {
+        m_cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, 1);
+        m_backspace = false;
     }
+    int backspaceIndex = textStr.indexOf('\10');
+    if (backspaceIndex == -1) {
+        // No backspace
+        m_cursor.insertText(textStr, m_format);
 
-    verticalScrollBar()->setSliderPosition(verticalScrollBar()->maximum());
+    } else {
+        m_backspace = true;
+        m_cursor.insertText(textStr.mid(0, backspaceIndex), m_format);
+        m_cursor.insertText(textStr.mid(backspaceIndex + 1), m_format);
+    }
 }
 
-void DisplayWidget::updateFormat(QTextCharFormat &format, int ansiCode)
+void DisplayWidget::updateFormat(AnsiState &state, int ansiCode)
 {
     if (m_ansi256Foreground) {
         if (ansiCode == 5)
             return;
-        format.setForeground(ansi256toRgb(ansiCode));
+        state.foreground = ansi256toRgb(ansiCode);
         m_ansi256Foreground = false;
         return;
     }
     if (m_ansi256Background) {
         if (ansiCode == 5)
             return;
-        format.setBackground(ansi256toRgb(ansiCode));
+        state.background = ansi256toRgb(ansiCode);
         m_ansi256Background = false;
         return;
     }
+    if ((ansiCode >= 30 && ansiCode <= 37) || (ansiCode >= 90 && ansiCode <= 97)) {
+        // foreground, or high-intensity foreground
+        state.foreground = ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30));
+        return;
+    }
+    if ((ansiCode >= 40 && ansiCode <= 47) || (ansiCode >= 100 && ansiCode <= 107)) {
+        // background, or high-intensity background
+        state.background = ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40));
+        return;
+    }
+
     switch (ansiCode) {
     case 0:
         // turn ANSI off (i.e. return to normal defaults)
-        setDefaultFormat(format);
+        setDefaultFormat(state);
         m_ansi256Background = false;
         m_ansi256Foreground = false;
         break;
     case 1:
         // bold
-        format.setFontWeight(QFont::Bold);
-        updateFormatBoldColor(format);
+        state.weight = QFont::Bold;
+        updateFormatBoldColor(state);
         break;
     case 2:
         // dim
-        format.setFontWeight(QFont::Light);
+        state.weight = QFont::Light;
         break;
     case 3:
         // italic
-        format.setFontItalic(true);
+        state.italic = true;
         break;
     case 4:
         // underline
-        format.setFontUnderline(true);
+        state.underline = true;
         break;
     case 5:
         // blink slow
-        format.setFontWeight(QFont::Bold);
+        state.weight = QFont::Bold;
         break;
     case 6:
         // blink fast
-        format.setFontWeight(QFont::Bold);
-        updateFormatBoldColor(format);
+        state.weight = QFont::Bold;
+        updateFormatBoldColor(state);
         break;
     case 7:
     case 27:
         // inverse
-        {
-            QBrush tempBrush = format.background();
-            format.setBackground(format.foreground());
-            format.setForeground(tempBrush);
-            break;
-        }
+        std::swap(state.foreground, state.background);
+        break;
     case 8:
         // conceal
-        format.setForeground(format.background());
+        state.foreground = state.background;
         break;
     case 9:
         // strike-through
-        format.setFontStrikeOut(true);
+        state.strikeOut = true;
         break;
     case 21:
     case 22:
     case 25:
         // bold off
-        format.setFontWeight(QFont::Normal);
+        state.weight = QFont::Normal;
         break;
     case 23:
         // italic off
-        format.setFontItalic(false);
+        state.italic = false;
         break;
     case 24:
         // underline off
-        format.setFontUnderline(false);
+        state.underline = false;
         break;
     case 28:
         // conceal off
-        format.setForeground(m_foregroundColor);
+        state.foreground = m_foregroundColor;
         break;
     case 29:
         // not crossed out
-        format.setFontStrikeOut(false);
-        break;
-    case 30:
-        // black foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 31:
-        // red foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 32:
-        // green foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 33:
-        // yellow foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 34:
-        // blue foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 35:
-        // magenta foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 36:
-        // cyan foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 37:
-        // gray foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
+        state.strikeOut = false;
         break;
     case 38:
         // 256 color foreground
         m_ansi256Foreground = true;
         break;
-    case 40:
-        // black background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 41:
-        // red background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 42:
-        // green background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 43:
-        // yellow background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 44:
-        // blue background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 45:
-        // magenta background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 46:
-        // cyan background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 47:
-        // gray background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
     case 48:
         // 256 color background
         m_ansi256Background = true;
         break;
-    case 90:
-        // high-black foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 91:
-        // high-red foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 92:
-        // high-green foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 93:
-        // high-yellow foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 94:
-        // high-blue foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 95:
-        // high-magenta foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 96:
-        // high-cyan foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 97:
-        // high-white foreground
-        format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 30)));
-        break;
-    case 100:
-        // high-black background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 101:
-        // high-red background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 102:
-        // high-green background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 103:
-        // high-yellow background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 104:
-        // high-blue background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 105:
-        // high-magenta background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 106:
-        // high-cyan background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
-    case 107:
-        // high-white background
-        format.setBackground(ansiColor(static_cast<AnsiColorTableEnum>(ansiCode - 40)));
-        break;
     default:
         qWarning() << "Unknown ansicode" << ansiCode;
-        format.setBackground(Qt::gray);
+        state.background = Qt::gray;
     }
 }
 
-void DisplayWidget::updateFormatBoldColor(QTextCharFormat &format)
+void DisplayWidget::updateFormatBoldColor(AnsiState &state)
 {
     for (int i = 0; i <= static_cast<int>(AnsiColorTableEnum::white); i++) {
-        if (format.foreground().color() == ansiColor(static_cast<AnsiColorTableEnum>(i)))
-            format.setForeground(ansiColor(static_cast<AnsiColorTableEnum>(i + 60)));
+        if (state.foreground == ansiColor(static_cast<AnsiColorTableEnum>(i)))
+            state.foreground = ansiColor(static_cast<AnsiColorTableEnum>(i + 60));
     }
 }
@@ -3,21 +3,46 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <vector>
 #include <QColor>
 #include <QFont>
+#include <QHash>
 #include <QSize>
 #include <QString>
 #include <QTextCursor>
 #include <QTextEdit>
 #include <QTextFormat>
+#include <QTimer>
 #include <QtCore>
 #include <QtGui>
 
+#include "../global/macros.h"
+
 class QObject;
 class QResizeEvent;
 class QTextDocument;
 class QWidget;
 
+/// What the SGR codes seen so far have selected; the format for each is only built once.
+struct NODISCARD AnsiState final
+{
+    QColor foreground;
+    QColor background;
+    int weight = QFont::Normal;
+    bool italic = false;
+    bool underline = false;
+    bool strikeOut = false;
+
+    NODISCARD bool operator==(const AnsiState &other) const
+    {
+        return foreground == other.foreground && background == other.background
+               && weight == other.weight && italic == other.italic
+               && underline == other.underline && strikeOut == other.strikeOut;
+    }
+};
+
+NODISCARD uint qHash(const AnsiState &state, uint seed = 0);
+
 class DisplayWidget : public QTextEdit
 {
 private:
@@ -53,10 +78,23 @@ public slots:
     bool m_ansi256Foreground = false;
     bool m_ansi256Background = false;
     bool m_backspace = false;
+    AnsiState m_ansiState;
+    QHash<AnsiState, QTextCharFormat> m_formats;
+    // The codes of the SGR sequence being read; kept to reuse its storage.
+    std::vector<int> m_sgrCodes;
+
+    // Text that arrived since the last flush; it's inserted in one edit, so the
+    // document is laid out once however many chunks came in.
+    QString m_pendingText;
+    QTimer m_flushTimer;
 
-    void setDefaultFormat(QTextCharFormat &format);
-    void updateFormat(QTextCharFormat &format, int ansiCode);
-    void updateFormatBoldColor(QTextCharFormat &format);
+    void flushText();
+    void insertText(const QString &str);
+    void insertRun(const QString &textStr);
+    void setDefaultFormat(AnsiState &state);
+    void updateFormat(AnsiState &state, int ansiCode);
+    void updateFormatBoldColor(AnsiState &state);
+    NODISCARD const QTextCharFormat &getFormat(const AnsiState &state);
 
 signals:
     void showMessage(const QString &, int);
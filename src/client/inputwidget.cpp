@@ -4,9 +4,8 @@
 
 #include "inputwidget.h"
 
-#include <QLinkedList>
+#include <algorithm>
 #include <QMessageLogContext>
-#include <QRegularExpression>
 #include <QSize>
 #include <QString>
 #include <QtGui>
@@ -16,7 +15,11 @@
 
 static constexpr const int MIN_WORD_LENGTH = 3;
 
-static const QRegularExpression s_whitespaceRx(R"(\W+)");
+// Same as the \w of a regular expression.
+static bool isWordCharacter(const QChar c)
+{
+    return c.isLetterOrNumber() || c.isMark() || c == '_';
+}
 
 InputWidget::InputWidget(QWidget *const parent)
     : QPlainTextEdit(parent)
@@ -37,8 +40,6 @@ InputWidget::InputWidget(QWidget *const parent)
     setLineWrapMode(QPlainTextEdit::NoWrap);
 
     // Word History
-    m_lineIterator = new InputHistoryIterator(m_lineHistory);
-    m_tabIterator = new TabCompletionIterator(m_tabCompletionDictionary);
     m_newInput = true;
 }
 
@@ -47,11 +48,7 @@ QSize InputWidget::sizeHint() const
     return minimumSize();
 }
 
-InputWidget::~InputWidget()
-{
-    delete m_lineIterator;
-    delete m_tabIterator;
-}
+InputWidget::~InputWidget() = default;
 
 void InputWidget::keyPressEvent(QKeyEvent *const event)
 {
@@ -212,42 +209,53 @@ void InputWidget::gotInput()
     emit sendUserInput(input);
     addLineHistory(input);
     addTabHistory(input);
-    m_lineIterator->toBack();
+    m_linePosition = m_lineHistory.size();
 }
 
 void InputWidget::addLineHistory(const InputHistoryEntry &string)
 {
-    if (!string.isEmpty() && (m_lineHistory.empty() || m_lineHistory.last() != string)) {
+    // An iterator at the back stays there.
+    const bool atBack = m_linePosition == m_lineHistory.size();
+    if (!string.isEmpty() && (m_lineHistory.empty() || m_lineHistory.back() != string)) {
         // Add to line history if it is a new entry
-        m_lineHistory << string;
+        m_lineHistory.emplace_back(string);
+        if (atBack)
+            m_linePosition = m_lineHistory.size();
     }
 
     // Trim line history
-    if (m_lineHistory.size() > getConfig().integratedClient.linesOfInputHistory) {
-        m_lineHistory.removeFirst();
+    const auto limit = std::max(0, getConfig().integratedClient.linesOfInputHistory);
+    while (m_lineHistory.size() > static_cast<size_t>(limit)) {
+        m_lineHistory.pop_front();
+        if (m_linePosition > 0)
+            --m_linePosition;
     }
 }
 
 void InputWidget::addTabHistory(const WordHistoryEntry &string)
 {
-    QStringList list = string.split(s_whitespaceRx, QString::SkipEmptyParts);
-    for (const QString &word : list) {
-        if (word.length() > MIN_WORD_LENGTH) {
+    const auto maxWords = static_cast<size_t>(
+        std::max(0, getConfig().integratedClient.tabCompletionDictionarySize));
+    const int length = string.length();
+    for (int start = 0; start < length;) {
+        if (!isWordCharacter(string.at(start))) {
+            ++start;
+            continue;
+        }
+        int end = start + 1;
+        while (end < length && isWordCharacter(string.at(end)))
+            ++end;
+        if (end - start > MIN_WORD_LENGTH) {
             // Adding this word to the dictionary
-            m_tabCompletionDictionary << word;
-
-            // Trim dictionary
-            if (m_tabCompletionDictionary.size()
-                > getConfig().integratedClient.tabCompletionDictionarySize) {
-                m_tabCompletionDictionary.removeFirst();
-            }
+            m_tabCompletionDictionary.add(string.mid(start, end - start), maxWords);
         }
+        start = end;
     }
 }
 
 void InputWidget::forwardHistory()
 {
-    if (!m_lineIterator->hasNext()) {
+    if (m_linePosition == m_lineHistory.size()) {
         emit showMessage("Reached beginning of input history", 1000);
         clear();
         return;
@@ -259,10 +267,10 @@ void InputWidget::forwardHistory()
         m_newInput = false;
     }
 
-    QString next = m_lineIterator->next();
+    QString next = m_lineHistory.at(m_linePosition++);
     // Ensure we always get "new" input
-    if (next == toPlainText() && m_lineIterator->hasNext()) {
-        next = m_lineIterator->next();
+    if (next == toPlainText() && m_linePosition < m_lineHistory.size()) {
+        next = m_lineHistory.at(m_linePosition++);
     }
 
     insertPlainText(next);
@@ -270,7 +278,7 @@ void InputWidget::forwardHistory()
 
 void InputWidget::backwardHistory()
 {
-    if (!m_lineIterator->hasPrevious()) {
+    if (m_linePosition == 0) {
         emit showMessage("Reached end of input history", 1000);
         return;
     }
@@ -281,10 +289,10 @@ void InputWidget::backwardHistory()
         m_newInput = false;
     }
 
-    QString previous = m_lineIterator->previous();
+    QString previous = m_lineHistory.at(--m_linePosition);
     // Ensure we always get "new" input
-    if (previous == toPlainText() && m_lineIterator->hasPrevious()) {
-        previous = m_lineIterator->previous();
+    if (previous == toPlainText() && m_linePosition > 0) {
+        previous = m_lineHistory.at(--m_linePosition);
     }
 
     insertPlainText(previous);
@@ -292,39 +300,29 @@ void InputWidget::backwardHistory()
 
 void InputWidget::tabComplete()
 {
-    if (m_tabCompletionDictionary.isEmpty())
+    if (m_tabCompletionDictionary.empty())
         return;
 
     QTextCursor current = textCursor();
     current.select(QTextCursor::WordUnderCursor);
     if (!m_tabbing) {
         m_tabFragment = current.selectedText();
-        m_tabIterator->toBack();
+        m_tabCompletions = m_tabCompletionDictionary.complete(m_tabFragment);
+        m_tabPosition = 0;
         m_tabbing = true;
     }
 
     // If we reach the end then loop back to the beginning and clear the selected text again
-    if (!m_tabIterator->hasPrevious()) {
+    if (m_tabPosition == m_tabCompletions.size()) {
         textCursor().removeSelectedText();
-        m_tabIterator->toBack();
+        m_tabPosition = 0;
         return;
     }
 
-    // Iterate through all previous words
-    while (m_tabIterator->hasPrevious()) {
-        // TODO(nschimme): Utilize a trie and store the search results?
-        if (m_tabIterator->peekPrevious().startsWith(m_tabFragment)) {
-            // Found a previous word to complete to
-            current.insertText(m_tabIterator->previous());
-            if (current.movePosition(QTextCursor::StartOfWord, QTextCursor::KeepAnchor)) {
-                current.movePosition(QTextCursor::Right,
-                                     QTextCursor::KeepAnchor,
-                                     m_tabFragment.size());
-                setTextCursor(current);
-            }
-            return;
-        }
-        // Try the next word
-        m_tabIterator->previous();
+    // Found a word to complete to
+    current.insertText(m_tabCompletions.at(m_tabPosition++));
+    if (current.movePosition(QTextCursor::StartOfWord, QTextCursor::KeepAnchor)) {
+        current.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor, m_tabFragment.size());
+        setTextCursor(current);
     }
 }
@@ -3,8 +3,10 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <cstddef>
+#include <deque>
+#include <vector>
 #include <QEvent>
-#include <QLinkedList>
 #include <QObject>
 #include <QPlainTextEdit>
 #include <QSize>
@@ -12,14 +14,14 @@
 #include <QWidget>
 #include <QtCore>
 
+#include "WordTrie.h"
+
 class QKeyEvent;
 class QObject;
 class QWidget;
 
 using InputHistoryEntry = QString;
-using InputHistoryIterator = QMutableLinkedListIterator<InputHistoryEntry>;
 using WordHistoryEntry = QString;
-using TabCompletionIterator = QMutableLinkedListIterator<WordHistoryEntry>;
 
 class InputWidget final : public QPlainTextEdit
 {
@@ -43,10 +45,12 @@ class InputWidget final : public QPlainTextEdit
     bool wordHistory(int);
     void keypadMovement(int);
 
-    InputHistoryIterator *m_lineIterator = nullptr;
     bool m_newInput = false;
-    QLinkedList<QString> m_lineHistory;
-    QLinkedList<QString> m_tabCompletionDictionary;
+    std::deque<InputHistoryEntry> m_lineHistory;
+    // Like a Java-style iterator, this is between two entries: the previous one is
+    // m_lineHistory[m_linePosition - 1] and the next one is m_lineHistory[m_linePosition].
+    size_t m_linePosition = 0;
+    WordTrie m_tabCompletionDictionary;
 
     void addLineHistory(const InputHistoryEntry &);
     void forwardHistory();
@@ -56,7 +60,9 @@ class InputWidget final : public QPlainTextEdit
 
     bool m_tabbing = false;
     QString m_tabFragment;
-    TabCompletionIterator *m_tabIterator = nullptr;
+    // The completions of m_tabFragment, and the next one to offer.
+    std::vector<WordHistoryEntry> m_tabCompletions;
+    size_t m_tabPosition = 0;
     void addTabHistory(const WordHistoryEntry &);
 
 signals:
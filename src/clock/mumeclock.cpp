@@ -4,6 +4,7 @@
 
 #include "mumeclock.h"
 
+#include <array>
 #include <cassert>
 #include <QHash>
 #include <QMetaEnum>
@@ -11,27 +12,44 @@
 #include <QRegularExpression>
 #include <QString>
 
-#include "../global/Array.h"
 #include "mumemoment.h"
 
 static constexpr const int DEFAULT_MUME_START_EPOCH = 1517443173;
 static constexpr const int DEFAULT_TOLERANCE_LIMIT = 10;
 static constexpr const int ONE_RL_DAY_IN_SECONDS = 86400;
 
-static inline int am(int h)
+static constexpr int am(int h)
 {
     return h;
 }
-static inline int pm(int h)
+static constexpr int pm(int h)
 {
     return h + 12;
 }
 
-static const MMapper::Array<int, 12> s_dawnHour
+static constexpr const std::array<int, MumeClock::NUM_MONTHS> DAWN_HOURS
     = {am(8), am(9), am(8), am(7), am(7), am(6), am(5), am(4), am(5), am(6), am(7), am(7)};
-static const MMapper::Array<int, 12> s_duskHour
+static constexpr const std::array<int, MumeClock::NUM_MONTHS> DUSK_HOURS
     = {pm(6), pm(5), pm(6), pm(7), pm(8), pm(8), pm(9), pm(10), pm(9), pm(8), pm(8), pm(7)};
 
+// Same as the keys of WestronMonthNamesEnum and WestronWeekDayNamesEnum, without having
+// to look them up through the meta-object.
+static constexpr const std::array<const char *, MumeClock::NUM_MONTHS> WESTRON_MONTH_NAMES
+    = {"Afteryule",
+       "Solmath",
+       "Rethe",
+       "Astron",
+       "Thrimidge",
+       "Forelithe",
+       "Afterlithe",
+       "Wedmath",
+       "Halimath",
+       "Winterfilth",
+       "Blotmath",
+       "Foreyule"};
+static constexpr const std::array<const char *, 7> WESTRON_WEEKDAY_NAMES
+    = {"Sunday", "Monday", "Trewsday", "Hevensday", "Mersday", "Highday", "Sterday"};
+
 const QMetaEnum MumeClock::s_westronMonthNames
     = QMetaEnum::fromType<MumeClock::WestronMonthNamesEnum>();
 const QMetaEnum MumeClock::s_sindarinMonthNames
@@ -92,7 +110,17 @@ MumeClock::MumeClock(QObject *parent)
 MumeMoment MumeClock::getMumeMoment()
 {
     const int64_t t = QDateTime::currentDateTimeUtc().toTime_t();
-    return MumeMoment::sinceMumeEpoch(t - m_mumeStartEpoch);
+    return getMomentSinceMumeEpoch(t - m_mumeStartEpoch);
+}
+
+MumeMoment MumeClock::getMomentSinceMumeEpoch(const int64_t secsSinceMumeStartEpoch)
+{
+    if (!m_lastMoment.has_value()
+        || m_lastMoment->secsSinceMumeStartEpoch != secsSinceMumeStartEpoch) {
+        m_lastMoment = CachedMoment{secsSinceMumeStartEpoch,
+                                    MumeMoment::sinceMumeEpoch(secsSinceMumeStartEpoch)};
+    }
+    return m_lastMoment->moment;
 }
 
 MumeMoment MumeClock::getMumeMoment(const int64_t secsSinceUnixEpoch)
@@ -102,7 +130,7 @@ MumeMoment MumeClock::getMumeMoment(const int64_t secsSinceUnixEpoch)
         assert(secsSinceUnixEpoch == -1);
         return getMumeMoment();
     }
-    return MumeMoment::sinceMumeEpoch(secsSinceUnixEpoch - m_mumeStartEpoch);
+    return getMomentSinceMumeEpoch(secsSinceUnixEpoch - m_mumeStartEpoch);
 }
 
 void MumeClock::parseMumeTime(const QString &mumeTime)
@@ -194,6 +222,7 @@ void MumeClock::parseMumeTime(const QString &mumeTime, const int64_t secsSinceEp
         qWarning() << "Calculated week day does not match MUME";
     }
     m_mumeStartEpoch = newStartEpoch;
+    emit synchronized();
 }
 
 void MumeClock::parseWeather(const QString &str)
@@ -244,6 +273,7 @@ void MumeClock::parseWeather(const QString &str, int64_t secsSinceEpoch)
     m_precision = MumeClockPrecisionEnum::MINUTE;
     m_mumeStartEpoch = secsSinceEpoch - moment.toSeconds();
     emit log("MumeClock", "Synchronized tick using weather");
+    emit synchronized();
 }
 
 MumeMoment &MumeClock::unknownTimeTick(MumeMoment &moment)
@@ -315,6 +345,7 @@ void MumeClock::parseClockTime(const QString &clockTime, const int64_t secsSince
              "Synchronized with clock in room (" + QString::number(newStartEpoch - m_mumeStartEpoch)
                  + " seconds from previous)");
     m_mumeStartEpoch = newStartEpoch;
+    emit synchronized();
 }
 
 // TODO: move this somewhere useful?
@@ -367,7 +398,7 @@ const QString MumeClock::toMumeTime(const MumeMoment &moment)
         period = "am";
     }
 
-    QString weekDay = MumeClock::s_westronWeekDayNames.valueToKey(moment.weekDay());
+    const QString weekDay = getWestronWeekDayName(moment.weekDay());
     QString time;
     switch (m_precision) {
     case MumeClockPrecisionEnum::HOUR:
@@ -389,7 +420,7 @@ const QString MumeClock::toMumeTime(const MumeMoment &moment)
 
     const int day = moment.day + 1;
     // TODO: Detect what calendar the player is using
-    QString monthName = MumeClock::s_westronMonthNames.valueToKey(moment.month);
+    const QString monthName = getWestronMonthName(moment.month);
     return QString("%1, the %2%3 of %4, year %5 of the Third Age.")
         .arg(time)
         .arg(day)
@@ -429,5 +460,19 @@ MumeClock::DawnDusk MumeClock::getDawnDusk(const int month)
 {
     assert(month >= 0 && month < NUM_MONTHS);
     const auto m = static_cast<uint32_t>(month);
-    return DawnDusk{s_dawnHour.at(m), s_duskHour.at(m)};
+    return DawnDusk{DAWN_HOURS.at(m), DUSK_HOURS.at(m)};
+}
+
+const char *MumeClock::getWestronMonthName(const int month)
+{
+    if (month < 0 || month >= NUM_MONTHS)
+        return nullptr;
+    return WESTRON_MONTH_NAMES[static_cast<size_t>(month)];
+}
+
+const char *MumeClock::getWestronWeekDayName(const int weekDay)
+{
+    if (weekDay < 0 || weekDay >= static_cast<int>(WESTRON_WEEKDAY_NAMES.size()))
+        return nullptr;
+    return WESTRON_WEEKDAY_NAMES[static_cast<size_t>(weekDay)];
 }
@@ -3,6 +3,8 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <cstdint>
+#include <optional>
 #include <QHash>
 #include <QList>
 #include <QMetaEnum>
@@ -30,6 +32,8 @@ class MumeClock final : public QObject
         int duskHour = 18;
     };
     static DawnDusk getDawnDusk(int month);
+    static const char *getWestronMonthName(int month);
+    static const char *getWestronWeekDayName(int weekDay);
 
 public:
     explicit MumeClock(int64_t mumeEpoch, QObject *parent = nullptr);
@@ -120,6 +124,8 @@ class MumeClock final : public QObject
 signals:
 
     void log(const QString &, const QString &);
+    // The epoch or the precision was changed by something MUME said.
+    void synchronized();
 
 public slots:
 
@@ -140,6 +146,15 @@ public slots:
 
 private:
     MumeMoment &unknownTimeTick(MumeMoment &moment);
+    MumeMoment getMomentSinceMumeEpoch(int64_t secsSinceMumeStartEpoch);
+
+    struct CachedMoment final
+    {
+        int64_t secsSinceMumeStartEpoch = 0;
+        MumeMoment moment;
+    };
+    // The clock is read many times a second, but it only changes once a second.
+    std::optional<CachedMoment> m_lastMoment;
 
     int64_t m_lastSyncEpoch = 0;
     int64_t m_mumeStartEpoch = 0;
@@ -5,7 +5,10 @@
 #include "mumeclockwidget.h"
 
 #include <cassert>
+#include <cstdint>
 #include <memory>
+#include <utility>
+#include <QDateTime>
 #include <QLabel>
 #include <QString>
 
@@ -13,6 +16,9 @@
 #include "mumeclock.h"
 #include "mumemoment.h"
 
+// How often the configuration is checked while the clock isn't shown.
+static constexpr const int HIDDEN_INTERVAL_MS = 60 * 1000;
+
 MumeClockWidget::MumeClockWidget(MumeClock *clock, QWidget *parent)
     : QWidget(parent)
     , m_clock(clock)
@@ -21,9 +27,11 @@ MumeClockWidget::MumeClockWidget(MumeClock *clock, QWidget *parent)
     setAttribute(Qt::WA_DeleteOnClose);
     assert(testAttribute(Qt::WA_DeleteOnClose));
 
+    // Nothing that's shown changes between ticks, so the timer is only started for the next one.
     m_timer = std::make_unique<QTimer>(this);
+    m_timer->setSingleShot(true);
     connect(m_timer.get(), &QTimer::timeout, this, &MumeClockWidget::updateLabel);
-    m_timer->start(1000);
+    connect(m_clock, &MumeClock::synchronized, this, &MumeClockWidget::updateLabel);
 
     updateLabel();
 }
@@ -39,17 +47,16 @@ void MumeClockWidget::updateLabel()
     if (!getConfig().mumeClock.display) {
         hide();
         // Slow down the interval to a reasonable number
-        m_timer->setInterval(60 * 1000);
+        m_timer->start(HIDDEN_INTERVAL_MS);
         return;
     }
-    if (m_timer->interval() != 1000) {
+    if (isHidden()) {
         show();
-        // Speed up the interval again if the display needs to be shown
-        m_timer->setInterval(1000);
     }
 
     const MumeMoment moment = m_clock->getMumeMoment();
     const MumeClockPrecisionEnum precision = m_clock->getPrecision();
+    scheduleUpdate(precision);
 
     bool updateMoonText = false;
     const MumeMoonPhaseEnum phase = moment.toMoonPhase();
@@ -87,7 +94,11 @@ void MumeClockWidget::updateLabel()
         updateMoonText = true;
     }
 
-    seasonLabel->setStatusTip(m_clock->toMumeTime(moment));
+    QString mumeTime = m_clock->toMumeTime(moment);
+    if (mumeTime != m_lastMumeTime) {
+        seasonLabel->setStatusTip(mumeTime);
+        m_lastMumeTime = std::move(mumeTime);
+    }
     const MumeSeasonEnum season = moment.toSeason();
     if (season != m_lastSeason) {
         m_lastSeason = season;
@@ -143,11 +154,15 @@ void MumeClockWidget::updateLabel()
         timeLabel->setStatusTip(statusTip);
         updateMoonStyleSheet = true;
     }
+    QString countdown = m_clock->toCountdown(moment);
     if (precision <= MumeClockPrecisionEnum::DAY) {
         // Prepend warning emoji to countdown
-        timeLabel->setText(QString::fromUtf8("\xe2\x9a\xa0").append(m_clock->toCountdown(moment)));
-    } else
-        timeLabel->setText(m_clock->toCountdown(moment));
+        countdown.prepend(QString::fromUtf8("\xe2\x9a\xa0"));
+    }
+    if (countdown != m_lastCountdown) {
+        timeLabel->setText(countdown);
+        m_lastCountdown = std::move(countdown);
+    }
 
     const MumeMoonVisibilityEnum moonVisibility = moment.toMoonVisibility();
     if (moonVisibility != m_lastVisibility || updateMoonStyleSheet) {
@@ -164,3 +179,14 @@ void MumeClockWidget::updateLabel()
     if (updateMoonText)
         moonPhaseLabel->setStatusTip(moment.toMumeMoonTime());
 }
+
+void MumeClockWidget::scheduleUpdate(const MumeClockPrecisionEnum precision)
+{
+    // A MUME minute is one second, and the countdown only shows minutes when the clock is
+    // precise to the minute; everything else changes once an hour.
+    const int64_t periodMs = (precision == MumeClockPrecisionEnum::MINUTE) ? 1000 : 60 * 1000;
+    const int64_t sinceMumeEpochMs = QDateTime::currentMSecsSinceEpoch()
+                                     - m_clock->getMumeStartEpoch() * 1000;
+    const int64_t intoPeriodMs = ((sinceMumeEpochMs % periodMs) + periodMs) % periodMs;
+    m_timer->start(static_cast<int>(periodMs - intoPeriodMs));
+}
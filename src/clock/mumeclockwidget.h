@@ -25,6 +25,9 @@ class MumeClockWidget : public QWidget, private Ui::MumeClockWidget
 public slots:
     void updateLabel();
 
+private:
+    void scheduleUpdate(MumeClockPrecisionEnum precision);
+
 private:
     MumeClock *m_clock = nullptr;
     std::unique_ptr<QTimer> m_timer;
@@ -34,4 +37,6 @@ public slots:
     MumeMoonPhaseEnum m_lastPhase = MumeMoonPhaseEnum::UNKNOWN;
     MumeMoonVisibilityEnum m_lastVisibility = MumeMoonVisibilityEnum::POSITION_UNKNOWN;
     MumeClockPrecisionEnum m_lastPrecision = MumeClockPrecisionEnum::UNSET;
+    QString m_lastMumeTime;
+    QString m_lastCountdown;
 };
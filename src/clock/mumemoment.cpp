@@ -4,6 +4,8 @@
 
 #include "mumemoment.h"
 
+#include <array>
+#include <cstddef>
 #include <iostream>
 
 #include "../global/Array.h"
@@ -24,6 +26,21 @@ static constexpr const int MUME_MINUTES_PER_YEAR = MUME_MONTHS_PER_YEAR * MUME_M
 static constexpr const int MUME_DAYS_PER_YEAR = MUME_MONTHS_PER_YEAR * MUME_DAYS_PER_MONTH;
 static_assert(MUME_DAYS_PER_YEAR == 360);
 
+// Indexed by WestronMonthNamesEnum.
+static constexpr const std::array<MumeSeasonEnum, MUME_MONTHS_PER_YEAR> SEASONS
+    = {MumeSeasonEnum::WINTER, // Afteryule
+       MumeSeasonEnum::WINTER, // Solmath
+       MumeSeasonEnum::WINTER, // Rethe
+       MumeSeasonEnum::SPRING, // Astron
+       MumeSeasonEnum::SPRING, // Thrimidge
+       MumeSeasonEnum::SPRING, // Forelithe
+       MumeSeasonEnum::SUMMER, // Afterlithe
+       MumeSeasonEnum::SUMMER, // Wedmath
+       MumeSeasonEnum::SUMMER, // Halimath
+       MumeSeasonEnum::AUTUMN, // Winterfilth
+       MumeSeasonEnum::AUTUMN, // Blotmath
+       MumeSeasonEnum::AUTUMN}; // Foreyule
+
 static void maybe_warn_if_not_clamped(
     const char *const name, bool &warned, const int val, const int lo, const int hi)
 {
@@ -105,29 +122,9 @@ int MumeMoment::toSeconds() const
 
 MumeSeasonEnum MumeMoment::toSeason() const
 {
-    using WMN = typename MumeClock::WestronMonthNamesEnum;
-    switch (static_cast<WMN>(month)) {
-    case WMN::Afteryule:
-    case WMN::Solmath:
-    case WMN::Rethe:
-        return MumeSeasonEnum::WINTER;
-    case WMN::Astron:
-    case WMN::Thrimidge:
-    case WMN::Forelithe:
-        return MumeSeasonEnum::SPRING;
-    case WMN::Afterlithe:
-    case WMN::Wedmath:
-    case WMN::Halimath:
-        return MumeSeasonEnum::SUMMER;
-    case WMN::Winterfilth:
-    case WMN::Blotmath:
-    case WMN::Foreyule:
-        return MumeSeasonEnum::AUTUMN;
-
-    case MumeClock::WestronMonthNamesEnum::UnknownWestronMonth:
-        break;
-    }
-    return MumeSeasonEnum::UNKNOWN;
+    if (month < 0 || month >= MUME_MONTHS_PER_YEAR)
+        return MumeSeasonEnum::UNKNOWN;
+    return SEASONS[static_cast<size_t>(month)];
 }
 
 MumeTimeEnum MumeMoment::toTimeOfDay() const
@@ -6,15 +6,28 @@
 
 #include "configuration.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <utility>
+#include <vector>
 #include <QByteArray>
 #include <QChar>
+#include <QCoreApplication>
 #include <QDir>
 #include <QHostInfo>
+#include <QMetaObject>
+#include <QRunnable>
 #include <QString>
 #include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariant>
 
 #include "../global/utils.h"
 #include "../pandoragroup/mmapper2group.h"
@@ -174,6 +187,124 @@ void Settings::initSettings()
     Settings settings; \
     QSettings &conf = static_cast<QSettings &>(settings);
 
+// The values a section writes, kept so they can be compared with the ones last written
+// and handed to another thread.
+class NODISCARD ConfigValues final
+{
+private:
+    std::vector<std::pair<QString, QVariant>> m_values;
+
+public:
+    void setValue(const QString &key, QVariant value)
+    {
+        m_values.emplace_back(key, std::move(value));
+    }
+    void writeTo(QSettings &conf) const
+    {
+        for (const auto &[key, value] : m_values)
+            conf.setValue(key, value);
+    }
+
+public:
+    NODISCARD bool operator==(const ConfigValues &other) const
+    {
+        return m_values == other.m_values;
+    }
+    NODISCARD bool operator!=(const ConfigValues &other) const { return !operator==(other); }
+};
+
+class NODISCARD ConfigRecord final
+{
+public:
+    std::vector<std::pair<const char *, ConfigValues>> groups;
+
+public:
+    void writeTo(QSettings &conf) const
+    {
+        for (const auto &[name, values] : groups) {
+            conf.beginGroup(name);
+            values.writeTo(conf);
+            conf.endGroup();
+        }
+    }
+};
+
+namespace { // anonymous
+
+// Writes records on the thread pool, one at a time and in order.
+class NODISCARD ConfigWriter final
+{
+private:
+    class NODISCARD Runner final : public QRunnable
+    {
+    private:
+        ConfigWriter &m_writer;
+
+    public:
+        explicit Runner(ConfigWriter &writer)
+            : m_writer{writer}
+        {
+            setAutoDelete(true);
+        }
+
+        void run() override { m_writer.run(); }
+    };
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_idle;
+    std::deque<ConfigRecord> m_queue; // guarded by m_mutex
+    bool m_running = false;           // guarded by m_mutex
+
+public:
+    void enqueue(ConfigRecord record)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_queue.emplace_back(std::move(record));
+        if (!m_running) {
+            m_running = true;
+            QThreadPool::globalInstance()->start(new Runner(*this));
+        }
+    }
+
+    // Blocks until every record enqueued so far has been written.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_idle.wait(lock, [this]() { return !m_running; });
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        while (!m_queue.empty()) {
+            const ConfigRecord record = std::move(m_queue.front());
+            m_queue.pop_front();
+            lock.unlock();
+            {
+                // The file is saved when this goes out of scope.
+                SETTINGS(conf);
+                record.writeTo(conf);
+            }
+            lock.lock();
+        }
+        m_running = false;
+        m_idle.notify_all();
+    }
+};
+
+} // namespace
+
+static constexpr const int WRITE_LATER_DELAY_MS = 2000;
+
+static ConfigWriter g_configWriter;
+// What each section held when it was last written.
+static std::mutex g_lastWrittenMutex;
+static ConfigRecord g_lastWritten; // guarded by g_lastWrittenMutex
+// Only used on the main thread.
+static uint64_t g_writeLaterGeneration = 0;
+
 ConstString GRP_AUTO_LOAD_WORLD = "Auto load world";
 ConstString GRP_CANVAS = "Canvas";
 ConstString GRP_CONNECTION = "Connection";
@@ -205,6 +336,7 @@ ConstString KEY_CLEAR_INPUT_ON_ENTER = "Clear input on enter";
 ConstString KEY_COLOR = "color";
 ConstString KEY_COLUMNS = "Columns";
 ConstString KEY_COMMAND_PREFIX_CHAR = "Command prefix character";
+ConstString KEY_COMPRESS_MAP_FILES = "Compress map files";
 ConstString KEY_CONNECTION_NORMAL_COLOR = "Connection normal color";
 ConstString KEY_CORRECT_POSITION_BONUS = "correct position bonus";
 ConstString KEY_DISPLAY_CLOCK = "Display clock";
@@ -219,6 +351,8 @@ ConstString KEY_FOREGROUND_COLOR = "Foreground color";
 ConstString KEY_3D_CANVAS = "canvas.advanced.use3D";
 ConstString KEY_3D_AUTO_TILT = "canvas.advanced.autoTilt";
 ConstString KEY_3D_PERFSTATS = "canvas.advanced.printPerfStats";
+ConstString KEY_3D_PERFLOG = "canvas.advanced.logPerfStats";
+ConstString KEY_3D_ADAPTIVE_QUALITY = "canvas.advanced.adaptiveQuality";
 ConstString KEY_3D_FOV = "canvas.advanced.fov";
 ConstString KEY_3D_VERTICAL_ANGLE = "canvas.advanced.verticalAngle";
 ConstString KEY_3D_HORIZONTAL_ANGLE = "canvas.advanced.horizontalAngle";
@@ -229,12 +363,14 @@ ConstString KEY_HOST = "host";
 ConstString KEY_LAST_MAP_LOAD_DIRECTORY = "Last map load directory";
 ConstString KEY_LINES_OF_INPUT_HISTORY = "Lines of input history";
 ConstString KEY_LINES_OF_SCROLLBACK = "Lines of scrollback";
+ConstString KEY_LOAD_ROOM_TEXT_ON_DEMAND = "Load room text on demand";
 ConstString KEY_GROUP_LOCAL_PORT = "local port";
 ConstString KEY_PROXY_LOCAL_PORT = "Local port number";
 ConstString KEY_LOCK_GROUP = "Lock current group members";
 ConstString KEY_MAP_MODE = "Map Mode";
 ConstString KEY_MAXIMUM_NUMBER_OF_PATHS = "maximum number of paths";
 ConstString KEY_MULTIPLE_CONNECTIONS_PENALTY = "multiple connections penalty";
+ConstString KEY_NEARBY_SYNC_RADIUS = "nearby sync radius";
 ConstString KEY_MUME_START_EPOCH = "Mume start epoch";
 ConstString KEY_NO_LAUNCH_PANEL = "No launch panel";
 ConstString KEY_NO_ROOM_DESCRIPTION_PATTERNS = "No room description patterns";
@@ -243,6 +379,7 @@ ConstString KEY_NUMBER_OF_ANTI_ALIASING_SAMPLES = "Number of anti-aliasing sampl
 ConstString KEY_PROXY_THREADED = "Proxy Threaded";
 ConstString KEY_PROXY_CONNECTION_STATUS = "Proxy connection status";
 ConstString KEY_PROXY_LISTENS_ON_ANY_INTERFACE = "Proxy listens on any interface";
+ConstString KEY_PROXY_MAX_SESSIONS = "Proxy max sessions";
 ConstString KEY_RELATIVE_PATH_ACCEPTANCE = "relative path acceptance";
 ConstString KEY_REMOTE_EDITING_AND_VIEWING = "Remote editing and viewing";
 ConstString KEY_MUME_REMOTE_PORT = "Remote port number";
@@ -254,12 +391,15 @@ ConstString KEY_ROOM_DARK_LIT_COLOR = "Room dark lit color";
 ConstString KEY_ROOM_DESC_ANSI_COLOR = "Room desc ansi color";
 ConstString KEY_ROOM_MATCHING_TOLERANCE = "room matching tolerance";
 ConstString KEY_ROOM_NAME_ANSI_COLOR = "Room name ansi color";
+ConstString KEY_ROUTING_PROFILE = "routing profile";
 ConstString KEY_ROWS = "Rows";
 ConstString KEY_RSA_PRIVATE_KEY = "RSA private key";
 ConstString KEY_RULES_WARNING = "rules warning";
 ConstString KEY_RUN_FIRST_TIME = "Run first time";
 ConstString KEY_SECRET_METADATA = "Secret metadata";
 ConstString KEY_SERVER_NAME = "Server name";
+ConstString KEY_SHARE_MAP = "share map";
+ConstString KEY_SHARE_MAP_NOTES = "share map notes";
 ConstString KEY_SHARE_SELF = "share self";
 ConstString KEY_SHOW_HIDDEN_EXIT_FLAGS = "Show hidden exit flags";
 ConstString KEY_SHOW_NOTES = "Show notes";
@@ -268,6 +408,7 @@ ConstString KEY_STATE = "state";
 ConstString KEY_TAB_COMPLETION_DICTIONARY_SIZE = "Tab completion dictionary size";
 ConstString KEY_TLS_ENCRYPTION = "TLS encryption";
 ConstString KEY_USE_INTERNAL_EDITOR = "Use internal editor";
+ConstString KEY_USE_LEGACY_OPENGL = "Use legacy OpenGL";
 ConstString KEY_USE_SOFTWARE_OPENGL = "Use software OpenGL";
 ConstString KEY_USE_TRILINEAR_FILTERING = "Use trilinear filtering";
 ConstString KEY_WINDOW_GEOMETRY = "Window Geometry";
@@ -449,16 +590,67 @@ void Configuration::read()
            && colorSettings.TRANSPARENT.getColor().isTransparent());
     assert(colorSettings.BACKGROUND.isInitialized()
            && !colorSettings.BACKGROUND.getColor().isTransparent());
+
+    {
+        std::lock_guard<std::mutex> lock{g_lastWrittenMutex};
+        g_lastWritten.groups.clear();
+        record(g_lastWritten);
+    }
+
+    publishProxySnapshot();
 }
 
 void Configuration::write() const
 {
-    SETTINGS(conf);
-    FOREACH_CONFIG_GROUP(write);
+    g_configWriter.wait();
+
+    ConfigRecord current;
+    record(current);
+    {
+        SETTINGS(conf);
+        current.writeTo(conf);
+    }
+    std::lock_guard<std::mutex> lock{g_lastWrittenMutex};
+    g_lastWritten = std::move(current);
+}
+
+void Configuration::writeLater() const
+{
+    // The timer is restarted by every call, so a burst of changes is written once.
+    QMetaObject::invokeMethod(
+        QCoreApplication::instance(),
+        []() {
+            const uint64_t generation = ++g_writeLaterGeneration;
+            QTimer::singleShot(WRITE_LATER_DELAY_MS, QCoreApplication::instance(), [generation]() {
+                if (generation == g_writeLaterGeneration)
+                    getConfig().writeChanged();
+            });
+        },
+        Qt::QueuedConnection);
+}
+
+void Configuration::writeChanged() const
+{
+    ConfigRecord current;
+    record(current);
+
+    ConfigRecord changed;
+    std::lock_guard<std::mutex> lock{g_lastWrittenMutex};
+    for (size_t i = 0; i < current.groups.size(); ++i) {
+        const auto &group = current.groups[i];
+        if (i >= g_lastWritten.groups.size() || g_lastWritten.groups[i].second != group.second)
+            changed.groups.emplace_back(group);
+    }
+    g_lastWritten = std::move(current);
+
+    if (!changed.groups.empty())
+        g_configWriter.enqueue(std::move(changed));
 }
 
 void Configuration::reset()
 {
+    g_configWriter.wait();
+
     {
         // Purge old organization settings first to prevent them from being migrated
         QSettings oldConf(OLD_SETTINGS_ORGANIZATION, SETTINGS_APPLICATION);
@@ -474,6 +666,18 @@ void Configuration::reset()
     read();
 }
 
+#undef GROUP_CALLBACK
+#define GROUP_CALLBACK(callback, name, ref) \
+    do { \
+        record.groups.emplace_back(name, ConfigValues{}); \
+        ref.callback(record.groups.back().second); \
+    } while (false)
+
+void Configuration::record(ConfigRecord &record) const
+{
+    FOREACH_CONFIG_GROUP(write);
+}
+
 #undef FOREACH_CONFIG_GROUP
 #undef GROUP_CALLBACK
 
@@ -502,6 +706,8 @@ void Configuration::GeneralSettings::read(QSettings &conf)
     characterEncoding = sanitizeCharacterEncoding(
         conf.value(KEY_CHARACTER_ENCODING, static_cast<uint32_t>(CharacterEncodingEnum::LATIN1))
             .toUInt());
+    compressMapFiles = conf.value(KEY_COMPRESS_MAP_FILES, false).toBool();
+    loadRoomTextOnDemand = conf.value(KEY_LOAD_ROOM_TEXT_ON_DEMAND, false).toBool();
 }
 
 void Configuration::ConnectionSettings::read(QSettings &conf)
@@ -517,6 +723,7 @@ void Configuration::ConnectionSettings::read(QSettings &conf)
     proxyThreaded = conf.value(KEY_PROXY_THREADED, false).toBool();
     proxyConnectionStatus = conf.value(KEY_PROXY_CONNECTION_STATUS, false).toBool();
     proxyListensOnAnyInterface = conf.value(KEY_PROXY_LISTENS_ON_ANY_INTERFACE, false).toBool();
+    maxProxySessions = std::clamp(conf.value(KEY_PROXY_MAX_SESSIONS, 1).toInt(), 1, 64);
 }
 
 // closest well-known color is "Outer Space"
@@ -548,9 +755,12 @@ void Configuration::CanvasSettings::read(QSettings &conf)
     antialiasingSamples = conf.value(KEY_NUMBER_OF_ANTI_ALIASING_SAMPLES, 0).toInt();
     trilinearFiltering = conf.value(KEY_USE_TRILINEAR_FILTERING, true).toBool();
     softwareOpenGL = conf.value(KEY_USE_SOFTWARE_OPENGL, false).toBool();
+    legacyOpenGL = conf.value(KEY_USE_LEGACY_OPENGL, false).toBool();
     advanced.use3D.set(conf.value(KEY_3D_CANVAS, false).toBool());
     advanced.autoTilt.set(conf.value(KEY_3D_AUTO_TILT, true).toBool());
     advanced.printPerfStats.set(conf.value(KEY_3D_PERFSTATS, IS_DEBUG_BUILD).toBool());
+    advanced.logPerfStats.set(conf.value(KEY_3D_PERFLOG, false).toBool());
+    advanced.adaptiveQuality.set(conf.value(KEY_3D_ADAPTIVE_QUALITY, true).toBool());
     advanced.fov.set(conf.value(KEY_3D_FOV, 765).toInt());
     advanced.verticalAngle.set(conf.value(KEY_3D_VERTICAL_ANGLE, 450).toInt());
     advanced.horizontalAngle.set(conf.value(KEY_3D_HORIZONTAL_ANGLE, 0).toInt());
@@ -608,6 +818,12 @@ void Configuration::PathMachineSettings::read(QSettings &conf)
     multipleConnectionsPenalty = conf.value(KEY_MULTIPLE_CONNECTIONS_PENALTY, 2.0).toDouble();
     maxPaths = std::max(0, conf.value(KEY_MAXIMUM_NUMBER_OF_PATHS, 1000).toInt());
     matchingTolerance = std::max(0, conf.value(KEY_ROOM_MATCHING_TOLERANCE, 8).toInt());
+    nearbySyncRadius = std::max(0, conf.value(KEY_NEARBY_SYNC_RADIUS, 0).toInt());
+    const QString profileName = conf.value(KEY_ROUTING_PROFILE,
+                                           getRoutingProfileName(RoutingProfileEnum::MOUNTED))
+                                    .toString();
+    routingProfile = findRoutingProfile(profileName.toStdString())
+                         .value_or(RoutingProfileEnum::MOUNTED);
 }
 
 void Configuration::GroupManagerSettings::read(QSettings &conf)
@@ -634,6 +850,8 @@ void Configuration::GroupManagerSettings::read(QSettings &conf)
     groupTellColor = conf.value(KEY_GROUP_TELL_ANSI_COLOR, QString(ANSI_GREEN)).toString();
     useGroupTellAnsi256Color = conf.value(KEY_GROUP_TELL_USE_256_ANSI_COLOR, false).toBool();
     lockGroup = conf.value(KEY_LOCK_GROUP, false).toBool();
+    shareMap = conf.value(KEY_SHARE_MAP, false).toBool();
+    shareMapNotes = conf.value(KEY_SHARE_MAP_NOTES, false).toBool();
     autoStart = conf.value(KEY_AUTO_START_GROUP_MANAGER, false).toBool();
 }
 
@@ -673,7 +891,7 @@ void Configuration::FindRoomsDialog::read(QSettings &conf)
     geometry = conf.value(KEY_WINDOW_GEOMETRY).toByteArray();
 }
 
-void Configuration::GeneralSettings::write(QSettings &conf) const
+void Configuration::GeneralSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_RUN_FIRST_TIME, false);
     conf.setValue(KEY_WINDOW_GEOMETRY, windowGeometry);
@@ -684,9 +902,11 @@ void Configuration::GeneralSettings::write(QSettings &conf) const
     conf.setValue(KEY_NO_LAUNCH_PANEL, noClientPanel);
     conf.setValue(KEY_CHECK_FOR_UPDATE, checkForUpdate);
     conf.setValue(KEY_CHARACTER_ENCODING, static_cast<uint32_t>(characterEncoding));
+    conf.setValue(KEY_COMPRESS_MAP_FILES, compressMapFiles);
+    conf.setValue(KEY_LOAD_ROOM_TEXT_ON_DEMAND, loadRoomTextOnDemand);
 }
 
-void Configuration::ConnectionSettings::write(QSettings &conf) const
+void Configuration::ConnectionSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_SERVER_NAME, remoteServerName);
     conf.setValue(KEY_MUME_REMOTE_PORT, static_cast<int>(remotePort));
@@ -695,6 +915,7 @@ void Configuration::ConnectionSettings::write(QSettings &conf) const
     conf.setValue(KEY_PROXY_THREADED, proxyThreaded);
     conf.setValue(KEY_PROXY_CONNECTION_STATUS, proxyConnectionStatus);
     conf.setValue(KEY_PROXY_LISTENS_ON_ANY_INTERFACE, proxyListensOnAnyInterface);
+    conf.setValue(KEY_PROXY_MAX_SESSIONS, maxProxySessions);
 }
 
 static auto getQColorName(const XNamedColor &color)
@@ -702,7 +923,7 @@ static auto getQColorName(const XNamedColor &color)
     return color.getColor().getQColor().name();
 }
 
-void Configuration::CanvasSettings::write(QSettings &conf) const
+void Configuration::CanvasSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_SHOW_UPDATED_ROOMS, showUpdated);
     conf.setValue(KEY_DRAW_NOT_MAPPED_EXITS, drawNotMappedExits);
@@ -715,23 +936,26 @@ void Configuration::CanvasSettings::write(QSettings &conf) const
     conf.setValue(KEY_NUMBER_OF_ANTI_ALIASING_SAMPLES, antialiasingSamples);
     conf.setValue(KEY_USE_TRILINEAR_FILTERING, trilinearFiltering);
     conf.setValue(KEY_USE_SOFTWARE_OPENGL, softwareOpenGL);
+    conf.setValue(KEY_USE_LEGACY_OPENGL, legacyOpenGL);
     conf.setValue(KEY_3D_CANVAS, advanced.use3D.get());
     conf.setValue(KEY_3D_AUTO_TILT, advanced.autoTilt.get());
     conf.setValue(KEY_3D_PERFSTATS, advanced.printPerfStats.get());
+    conf.setValue(KEY_3D_PERFLOG, advanced.logPerfStats.get());
+    conf.setValue(KEY_3D_ADAPTIVE_QUALITY, advanced.adaptiveQuality.get());
     conf.setValue(KEY_3D_FOV, advanced.fov.get());
     conf.setValue(KEY_3D_VERTICAL_ANGLE, advanced.verticalAngle.get());
     conf.setValue(KEY_3D_HORIZONTAL_ANGLE, advanced.horizontalAngle.get());
     conf.setValue(KEY_3D_LAYER_HEIGHT, advanced.layerHeight.get());
 }
 
-void Configuration::AutoLoadSettings::write(QSettings &conf) const
+void Configuration::AutoLoadSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_AUTO_LOAD, autoLoadMap);
     conf.setValue(KEY_FILE_NAME, fileName);
     conf.setValue(KEY_LAST_MAP_LOAD_DIRECTORY, lastMapDirectory);
 }
 
-void Configuration::ParserSettings::write(QSettings &conf) const
+void Configuration::ParserSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_ROOM_NAME_ANSI_COLOR, roomNameColor);
     conf.setValue(KEY_ROOM_DESC_ANSI_COLOR, roomDescColor);
@@ -740,21 +964,21 @@ void Configuration::ParserSettings::write(QSettings &conf) const
     conf.setValue(KEY_NO_ROOM_DESCRIPTION_PATTERNS, noDescriptionPatternsList);
 }
 
-void Configuration::MumeNativeSettings::write(QSettings &conf) const
+void Configuration::MumeNativeSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_EMULATED_EXITS, emulatedExits);
     conf.setValue(KEY_SHOW_HIDDEN_EXIT_FLAGS, showHiddenExitFlags);
     conf.setValue(KEY_SHOW_NOTES, showNotes);
 }
 
-void Configuration::MumeClientProtocolSettings::write(QSettings &conf) const
+void Configuration::MumeClientProtocolSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_REMOTE_EDITING_AND_VIEWING, remoteEditing);
     conf.setValue(KEY_USE_INTERNAL_EDITOR, internalRemoteEditor);
     conf.setValue(KEY_EXTERNAL_EDITOR_COMMAND, externalRemoteEditorCommand);
 }
 
-void Configuration::PathMachineSettings::write(QSettings &conf) const
+void Configuration::PathMachineSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_RELATIVE_PATH_ACCEPTANCE, acceptBestRelative);
     conf.setValue(KEY_ABSOLUTE_PATH_ACCEPTANCE, acceptBestAbsolute);
@@ -763,9 +987,11 @@ void Configuration::PathMachineSettings::write(QSettings &conf) const
     conf.setValue(KEY_MAXIMUM_NUMBER_OF_PATHS, maxPaths);
     conf.setValue(KEY_ROOM_MATCHING_TOLERANCE, matchingTolerance);
     conf.setValue(KEY_MULTIPLE_CONNECTIONS_PENALTY, multipleConnectionsPenalty);
+    conf.setValue(KEY_NEARBY_SYNC_RADIUS, nearbySyncRadius);
+    conf.setValue(KEY_ROUTING_PROFILE, getRoutingProfileName(routingProfile));
 }
 
-void Configuration::GroupManagerSettings::write(QSettings &conf) const
+void Configuration::GroupManagerSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_STATE, static_cast<int>(state));
     // Note: There's no QVariant(quint16) constructor.
@@ -785,17 +1011,19 @@ void Configuration::GroupManagerSettings::write(QSettings &conf) const
     conf.setValue(KEY_GROUP_TELL_ANSI_COLOR, groupTellColor);
     conf.setValue(KEY_GROUP_TELL_USE_256_ANSI_COLOR, useGroupTellAnsi256Color);
     conf.setValue(KEY_LOCK_GROUP, lockGroup);
+    conf.setValue(KEY_SHARE_MAP, shareMap);
+    conf.setValue(KEY_SHARE_MAP_NOTES, shareMapNotes);
     conf.setValue(KEY_AUTO_START_GROUP_MANAGER, autoStart);
 }
 
-void Configuration::MumeClockSettings::write(QSettings &conf) const
+void Configuration::MumeClockSettings::write(ConfigValues &conf) const
 {
     // Note: There's no QVariant(int64_t) constructor.
     conf.setValue(KEY_MUME_START_EPOCH, static_cast<qlonglong>(startEpoch));
     conf.setValue(KEY_DISPLAY_CLOCK, display);
 }
 
-void Configuration::IntegratedMudClientSettings::write(QSettings &conf) const
+void Configuration::IntegratedMudClientSettings::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_FONT, font);
     conf.setValue(KEY_BACKGROUND_COLOR, backgroundColor.name());
@@ -809,17 +1037,17 @@ void Configuration::IntegratedMudClientSettings::write(QSettings &conf) const
     conf.setValue(KEY_AUTO_RESIZE_TERMINAL, autoResizeTerminal);
 }
 
-void Configuration::InfoMarksDialog::write(QSettings &conf) const
+void Configuration::InfoMarksDialog::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_WINDOW_GEOMETRY, geometry);
 }
 
-void Configuration::RoomEditDialog::write(QSettings &conf) const
+void Configuration::RoomEditDialog::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_WINDOW_GEOMETRY, geometry);
 }
 
-void Configuration::FindRoomsDialog::write(QSettings &conf) const
+void Configuration::FindRoomsDialog::write(ConfigValues &conf) const
 {
     conf.setValue(KEY_WINDOW_GEOMETRY, geometry);
 }
@@ -836,6 +1064,47 @@ const Configuration &getConfig()
     return setConfig();
 }
 
+// Only accessed with std::atomic_load() and std::atomic_store().
+static std::shared_ptr<const ProxyConfigSnapshot> g_proxySnapshot;
+static std::atomic<uint64_t> g_proxySnapshotGeneration{0};
+
+void Configuration::publishProxySnapshot() const
+{
+    // Called from the constructor too, so this mustn't go through getConfig().
+    auto snapshot = std::make_shared<ProxyConfigSnapshot>();
+    snapshot->parser = parser;
+    snapshot->mumeNative = mumeNative;
+
+    static std::mutex mutex;
+    std::lock_guard<std::mutex> lock{mutex};
+    snapshot->generation = g_proxySnapshotGeneration.load(std::memory_order_relaxed) + 1;
+    std::atomic_store(&g_proxySnapshot, std::shared_ptr<const ProxyConfigSnapshot>{snapshot});
+    g_proxySnapshotGeneration.store(snapshot->generation, std::memory_order_release);
+}
+
+static thread_local std::shared_ptr<const ProxyConfigSnapshot> t_proxySnapshot;
+
+void refreshProxyConfigSnapshot()
+{
+    const uint64_t generation = g_proxySnapshotGeneration.load(std::memory_order_acquire);
+    if (t_proxySnapshot != nullptr && t_proxySnapshot->generation == generation)
+        return;
+
+    if (generation == 0) {
+        // the constructor publishes the first one
+        static_cast<void>(getConfig());
+    }
+    t_proxySnapshot = std::atomic_load(&g_proxySnapshot);
+    assert(t_proxySnapshot != nullptr);
+}
+
+const ProxyConfigSnapshot &getProxyConfigSnapshot()
+{
+    if (t_proxySnapshot == nullptr)
+        refreshProxyConfigSnapshot();
+    return *t_proxySnapshot;
+}
+
 void Configuration::ColorSettings::resetToDefaults()
 {
     assert(Colors::black.getRGB() == 0 && Colors::black.getRGBA() != 0);
@@ -880,7 +1149,8 @@ void Configuration::ColorSettings::resetToDefaults()
 
 Configuration::CanvasSettings::Advanced::Advanced()
 {
-    for (NamedConfig<bool> *const it : {&use3D, &autoTilt, &printPerfStats}) {
+    for (NamedConfig<bool> *const it :
+         {&use3D, &autoTilt, &printPerfStats, &logPerfStats, &adaptiveQuality}) {
         const char *const name = it->getName().c_str();
         qInfo() << "Checking environment variable" << name;
         if (std::optional<bool> opt = utils::getEnvBool(name)) {
@@ -904,6 +1174,8 @@ ConnectionSet Configuration::CanvasSettings::Advanced::registerChangeCallback(
     result += use3D.registerChangeCallback(callback);
     result += autoTilt.registerChangeCallback(callback);
     result += printPerfStats.registerChangeCallback(callback);
+    result += logPerfStats.registerChangeCallback(callback);
+    result += adaptiveQuality.registerChangeCallback(callback);
     result += fov.registerChangeCallback(callback);
     result += verticalAngle.registerChangeCallback(callback);
     result += horizontalAngle.registerChangeCallback(callback);
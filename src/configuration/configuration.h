@@ -19,11 +19,15 @@
 #include "../global/FixedPoint.h"
 #include "../global/NamedColors.h"
 #include "../global/RuleOf5.h"
+#include "../mapdata/RoutingProfile.h"
 #include "../pandoragroup/mmapper2group.h"
 #include "NamedConfig.h"
 
 #undef TRANSPARENT // Bad dog, Microsoft; bad dog!!!
 
+class ConfigRecord;
+class ConfigValues;
+
 enum class MapModeEnum { PLAY, MAP, OFFLINE };
 enum class PlatformEnum { Unknown, Windows, Mac, Linux };
 enum class CharacterEncodingEnum { LATIN1, UTF8, ASCII };
@@ -82,17 +86,38 @@ static constexpr const bool NO_ZLIB = true;
 static constexpr const bool NO_ZLIB = false;
 #endif
 
+#if defined(MMAPPER_WITH_ZSTD) && MMAPPER_WITH_ZSTD
+static constexpr const bool WITH_ZSTD = true;
+#else
+static constexpr const bool WITH_ZSTD = false;
+#endif
+
+#if defined(MMAPPER_NO_TRACING) && MMAPPER_NO_TRACING
+static constexpr const bool NO_TRACING = true;
+#else
+static constexpr const bool NO_TRACING = false;
+#endif
+
 #define SUBGROUP() \
     friend class Configuration; \
     void read(QSettings &conf); \
-    void write(QSettings &conf) const
+    void write(ConfigValues &conf) const
 
 class Configuration final
 {
 public:
     void read();
+    /// Writes every section now, after any writes still pending from writeLater().
+    /// Use it at shutdown and when the user asks to save.
     void write() const;
+    /// Writes the sections that changed since they were last written, on a background
+    /// thread, a moment after the last call; changes made meanwhile are written together.
+    /// It can be called from any thread.
+    void writeLater() const;
     void reset();
+    /// Publishes a copy of the settings the proxy threads read; see getProxyConfigSnapshot().
+    /// Call it after changing any of them.
+    void publishProxySnapshot() const;
 
 public:
     struct GeneralSettings final
@@ -106,6 +131,12 @@ class Configuration final
         bool noClientPanel = false;
         bool checkForUpdate = true;
         CharacterEncodingEnum characterEncoding = CharacterEncodingEnum::LATIN1;
+        /// Saves .mm2 files as independently compressed blocks (smaller, decoded
+        /// in parallel) instead of uncompressed sections that can be mapped directly.
+        bool compressMapFiles = false;
+        /// Leaves room descriptions and notes in uncompressed .mm2 files until
+        /// they're first used, which makes loading faster and uses less memory.
+        bool loadRoomTextOnDemand = false;
 
     private:
         SUBGROUP();
@@ -120,6 +151,8 @@ class Configuration final
         bool proxyThreaded = false;
         bool proxyConnectionStatus = false;
         bool proxyListensOnAnyInterface = false;
+        /// How many clients can use the proxy at once; only the first one drives the mapper.
+        int maxProxySessions = 1;
 
     private:
         SUBGROUP();
@@ -142,6 +175,14 @@ class Configuration final
         bool remoteEditing = false;
         bool internalRemoteEditor = false;
         QString externalRemoteEditorCommand;
+        // Turns remote editing off for this run without changing the saved setting
+        // (e.g. headless, where there's nowhere to open an editor); never saved.
+        bool remoteEditingSuppressed = false;
+
+        NODISCARD bool usesRemoteEditing() const
+        {
+            return remoteEditing && !remoteEditingSuppressed;
+        }
 
     private:
         SUBGROUP();
@@ -176,6 +217,8 @@ class Configuration final
         int antialiasingSamples = 0;
         bool trilinearFiltering = false;
         bool softwareOpenGL = false;
+        // GL 2.0 / ES 2.0 even if the driver has GL 3.3 / ES 3.0 (needs a restart)
+        bool legacyOpenGL = false;
 
         // not saved yet:
         bool drawCharBeacons = true;
@@ -183,6 +226,7 @@ class Configuration final
         float doorNameScaleCutoff = 0.4f;
         float infomarkScaleCutoff = 0.25f;
         float extraDetailScaleCutoff = 0.15f;
+        float lowDetailScaleCutoff = 0.08f;
 
         MMapper::Array<int, 3> mapRadius{100, 100, 100};
         RestrictMapEnum useRestrictedMap = RestrictMapEnum::OnlyInMapMode;
@@ -192,6 +236,9 @@ class Configuration final
             NamedConfig<bool> use3D{"MMAPPER_3D", true};
             NamedConfig<bool> autoTilt{"MMAPPER_AUTO_TILT", true};
             NamedConfig<bool> printPerfStats{"MMAPPER_GL_PERFSTATS", IS_DEBUG_BUILD};
+            NamedConfig<bool> logPerfStats{"MMAPPER_GL_PERFLOG", false};
+            // Lowers the drawing quality while frames are slow; see FrameBudget.
+            NamedConfig<bool> adaptiveQuality{"MMAPPER_ADAPTIVE_QUALITY", true};
 
             // 5..90 degrees
             FixedPoint<1> fov{50, 900, 765};
@@ -273,6 +320,9 @@ class Configuration final
         double correctPositionBonus = 0.0;
         int maxPaths = 0;
         int matchingTolerance = 0;
+        int nearbySyncRadius = 0;
+        // The costs `dirs` finds routes with.
+        RoutingProfileEnum routingProfile = RoutingProfileEnum::MOUNTED;
 
     private:
         SUBGROUP();
@@ -297,6 +347,9 @@ class Configuration final
         QString groupTellColor; // ANSI color
         bool useGroupTellAnsi256Color = false;
         bool lockGroup = false;
+        // Whether clients may sync their map with the host's, and whether the notes go too
+        bool shareMap = false;
+        bool shareMapNotes = false;
         bool autoStart = false;
 
     private:
@@ -359,6 +412,9 @@ class Configuration final
 private:
     Configuration();
     friend Configuration &setConfig();
+
+    void record(ConfigRecord &record) const;
+    void writeChanged() const;
 };
 
 /// Must be called before you can call setConfig() or getConfig().
@@ -368,4 +424,22 @@ void setEnteredMain();
 Configuration &setConfig();
 const Configuration &getConfig();
 
+/// An immutable copy of the settings that the parser reads for every line. The proxy
+/// threads read these instead of racing with the main thread while settings change.
+struct NODISCARD ProxyConfigSnapshot final
+{
+    Configuration::ParserSettings parser;
+    Configuration::MumeNativeSettings mumeNative;
+    /// Increases with every publication, so caches derived from a snapshot can tell it changed.
+    uint64_t generation = 0;
+};
+
+/// Picks up the latest snapshot published by Configuration::publishProxySnapshot(), if it's
+/// newer than this thread's. That's one atomic load, and it releases the thread's old
+/// snapshot, so call it where nothing refers to it, e.g. before handling each input.
+void refreshProxyConfigSnapshot();
+/// Returns this thread's snapshot without synchronizing; it stays the same until the thread
+/// calls refreshProxyConfigSnapshot().
+const ProxyConfigSnapshot &getProxyConfigSnapshot();
+
 #undef SUBGROUP
@@ -6,6 +6,7 @@
 #include <cmath>
 #include <glm/glm.hpp>
 #include <optional>
+#include <utility>
 #include <vector>
 #include <QtCore>
 
@@ -47,6 +48,60 @@ bool CharacterBatch::isVisible(const Coordinate &c, float margin) const
 }
 
 void CharacterBatch::drawCharacter(const Coordinate &c, const Color &color, bool fill)
+{
+    // REVISIT: The margin probably needs to be modified for high-dpi.
+    const float marginPixels = MapScreen::DEFAULT_MARGIN_PIXELS;
+    const bool visible = isVisible(c, marginPixels / 2.f);
+    drawDistantCharacter(c, color, fill);
+    drawCharacterBody(c, color, fill, visible);
+}
+
+void CharacterBatch::drawCharacterOnMap(const Coordinate &c, const Color &color, bool fill)
+{
+    // The beacon of a room that's out of view is either off screen too, or pointing up at the
+    // edge of it, which is harmless.
+    drawCharacterBody(c, color, fill, true);
+}
+
+void CharacterBatch::drawDistantCharacter(const Coordinate &c, const Color &color, bool fill)
+{
+    const Configuration::CanvasSettings &settings = getConfig().canvas;
+
+    // REVISIT: The margin probably needs to be modified for high-dpi.
+    const float marginPixels = MapScreen::DEFAULT_MARGIN_PIXELS;
+    if (isVisible(c, marginPixels / 2.f))
+        return;
+
+    const glm::vec3 roomCenter = c.to_vec3() + glm::vec3{0.5f, 0.5f, 0.f};
+    const bool isFar = m_scale <= settings.charBeaconScaleCutoff;
+    const bool wantBeacons = settings.drawCharBeacons && isFar;
+
+    auto &gl = getOpenGL();
+    gl.setColor(color);
+
+    static const bool useScreenSpacePlayerArrow = []() -> bool {
+        auto opt = utils::getEnvBool("MMAPPER_SCREEN_SPACE_ARROW");
+        return opt ? opt.value() : true;
+    }();
+    const auto dot = DistantObjectTransform::construct(roomCenter, m_mapScreen, marginPixels);
+    // Player is distant
+    if (useScreenSpacePlayerArrow) {
+        gl.addScreenSpaceArrow(dot.offset, dot.rotationDegrees, color, fill);
+    } else {
+        gl.glPushMatrix();
+        gl.glTranslatef(dot.offset);
+        // NOTE: 180 degrees of additional rotation flips the arrow to point right instead of left.
+        gl.glRotateZ(dot.rotationDegrees + 180.f);
+        // NOTE: arrow is centered, so it doesn't need additional translation.
+        gl.drawArrow(fill, wantBeacons);
+        gl.glPopMatrix();
+    }
+}
+
+void CharacterBatch::drawCharacterBody(const Coordinate &c,
+                                       const Color &color,
+                                       const bool fill,
+                                       const bool allowBeacon)
 {
     const Configuration::CanvasSettings &settings = getConfig().canvas;
 
@@ -56,30 +111,8 @@ void CharacterBatch::drawCharacter(const Coordinate &c, const Color &color, bool
     auto &gl = getOpenGL();
     gl.setColor(color);
 
-    // REVISIT: The margin probably needs to be modified for high-dpi.
-    const float marginPixels = MapScreen::DEFAULT_MARGIN_PIXELS;
-    const bool visible = isVisible(c, marginPixels / 2.f);
     const bool isFar = m_scale <= settings.charBeaconScaleCutoff;
     const bool wantBeacons = settings.drawCharBeacons && isFar;
-    if (!visible) {
-        static const bool useScreenSpacePlayerArrow = []() -> bool {
-            auto opt = utils::getEnvBool("MMAPPER_SCREEN_SPACE_ARROW");
-            return opt ? opt.value() : true;
-        }();
-        const auto dot = DistantObjectTransform::construct(roomCenter, m_mapScreen, marginPixels);
-        // Player is distant
-        if (useScreenSpacePlayerArrow) {
-            gl.addScreenSpaceArrow(dot.offset, dot.rotationDegrees, color, fill);
-        } else {
-            gl.glPushMatrix();
-            gl.glTranslatef(dot.offset);
-            // NOTE: 180 degrees of additional rotation flips the arrow to point right instead of left.
-            gl.glRotateZ(dot.rotationDegrees + 180.f);
-            // NOTE: arrow is centered, so it doesn't need additional translation.
-            gl.drawArrow(fill, wantBeacons);
-            gl.glPopMatrix();
-        }
-    }
 
     const bool differentLayer = layerDifference != 0;
     if (differentLayer) {
@@ -96,7 +129,7 @@ void CharacterBatch::drawCharacter(const Coordinate &c, const Color &color, bool
         gl.glPopMatrix();
     }
 
-    const bool beacon = visible && !differentLayer && wantBeacons;
+    const bool beacon = allowBeacon && !differentLayer && wantBeacons;
     gl.drawBox(c, fill, beacon, isFar);
 }
 
@@ -334,6 +367,35 @@ void CharacterBatch::CharFakeGL::reallyDrawCharacters(OpenGL &gl, const MapCanva
     }
 }
 
+CharacterMeshes CharacterBatch::CharFakeGL::bake(OpenGL &gl,
+                                                 const MapCanvasTextures &textures) const
+{
+    assert(m_screenSpaceArrows.empty());
+    const auto blended_noDepth
+        = GLRenderState().withDepthFunction(std::nullopt).withBlend(BlendModeEnum::TRANSPARENCY);
+
+    // Same order and states as reallyDraw()
+    CharacterMeshes result;
+    if (!m_charBeaconQuads.empty())
+        result.add(gl.createColoredQuadBatch(m_charBeaconQuads),
+                   blended_noDepth.withCulling(CullingEnum::FRONT));
+    if (!m_charRoomQuads.empty())
+        result.add(gl.createColoredTexturedQuadBatch(m_charRoomQuads, textures.char_room_sel),
+                   blended_noDepth);
+    if (!m_charTris.empty())
+        result.add(gl.createColoredTriBatch(m_charTris), blended_noDepth);
+    if (!m_charLines.empty())
+        result.add(gl.createColoredLineBatch(m_charLines),
+                   blended_noDepth.withLineParams(LineParams{CHAR_ARROW_LINE_WIDTH}));
+    if (!m_pathPoints.empty())
+        result.add(gl.createPointBatch(m_pathPoints),
+                   blended_noDepth.withPointSize(PATH_POINT_SIZE));
+    if (!m_pathLineVerts.empty())
+        result.add(gl.createColoredLineBatch(m_pathLineVerts),
+                   blended_noDepth.withLineParams(LineParams{PATH_LINE_WIDTH}));
+    return result;
+}
+
 void CharacterBatch::CharFakeGL::reallyDrawPaths(OpenGL &gl)
 {
     const auto blended_noDepth
@@ -379,13 +441,15 @@ void MapCanvas::paintCharacters()
         return;
     }
 
-    CharacterBatch characterBatch{m_mapScreen, m_currentLayer, getTotalScaleFactor()};
     const Coordinate &pos = m_data.getPosition();
+    paintGroupCharacters(pos);
 
-    // draw the characters before the current position
-    characterBatch.incrementCount(pos);
-    drawGroupCharacters(characterBatch);
-    characterBatch.resetCount(pos);
+    // The rest is drawn after the group, so it's on top.
+    CharacterBatch characterBatch{m_mapScreen, m_currentLayer, getTotalScaleFactor()};
+    if (m_groupCharacters.has_value()) {
+        for (const GroupCharacterPosition &character : m_groupCharacters.value())
+            characterBatch.drawDistantCharacter(character.pos, character.color, character.fill);
+    }
 
     // paint char current position
     const Color color{getConfig().groupManager.color};
@@ -398,12 +462,42 @@ void MapCanvas::paintCharacters()
     characterBatch.reallyDraw(getOpenGL(), m_textures);
 }
 
-void MapCanvas::drawGroupCharacters(CharacterBatch &batch)
+void MapCanvas::paintGroupCharacters(const Coordinate &pos)
 {
+    if (!m_groupCharacters.has_value()) {
+        m_groupCharacters = getGroupCharacters();
+        m_batches.groupCharacterMeshes.reset();
+    }
+    if (m_groupCharacters->empty())
+        return;
+
+    const Configuration::CanvasSettings &settings = getConfig().canvas;
+    const float scale = getTotalScaleFactor();
+    const GroupCharacterMeshes::Key key{m_currentLayer,
+                                        scale <= settings.charBeaconScaleCutoff,
+                                        settings.drawCharBeacons,
+                                        pos};
+    auto &meshes = m_batches.groupCharacterMeshes;
+    if (!meshes.has_value() || meshes->key != key) {
+        CharacterBatch batch{m_mapScreen, m_currentLayer, scale};
+        // draw the characters before the current position
+        batch.incrementCount(pos);
+        for (const GroupCharacterPosition &character : m_groupCharacters.value()) {
+            batch.drawCharacterOnMap(character.pos, character.color, character.fill);
+            batch.drawPreSpammedPath(character.pos, character.prespam, character.color);
+        }
+        meshes.emplace(GroupCharacterMeshes{key, batch.bake(getOpenGL(), m_textures)});
+    }
+    meshes->meshes.render();
+}
+
+std::vector<GroupCharacterPosition> MapCanvas::getGroupCharacters()
+{
+    std::vector<GroupCharacterPosition> result;
     CGroup *const group = m_groupManager->getGroup();
     if ((group == nullptr) || getConfig().groupManager.state == GroupManagerStateEnum::Off
         || m_data.isEmpty()) {
-        return;
+        return result;
     }
 
     // Omit player so that they know group members are below them
@@ -418,13 +512,15 @@ void MapCanvas::drawGroupCharacters(CharacterBatch &batch)
             auto roomSelection = RoomSelection(m_data);
             if (const Room *const r = roomSelection.getRoom(id)) {
                 const auto pos = r->getPosition();
-                const auto color = Color{character->getColor()};
                 const bool fill = !drawnRoomIds.contains(r->getId());
-                batch.drawCharacter(pos, color, fill);
-                const auto prespam = m_data.getPath(pos, character->prespam);
-                batch.drawPreSpammedPath(pos, prespam, color);
+                auto prespam = m_data.getPath(pos, character->prespam);
+                result.emplace_back(GroupCharacterPosition{pos,
+                                                           Color{character->getColor()},
+                                                           fill,
+                                                           std::move(prespam)});
                 drawnRoomIds.insert(r->getId());
             }
         }
     }
+    return result;
 }
@@ -9,8 +9,10 @@
 #include <map>
 #include <memory>
 #include <stack>
+#include <utility>
 #include <vector>
 #include <QColor>
+#include <QList>
 #include <QListData>
 
 #include "../expandoracommon/coordinate.h"
@@ -23,6 +25,67 @@ class MapScreen;
 class OpenGL;
 struct MapCanvasTextures;
 
+/// Where a member of the group is drawn, as of the last group or map change.
+struct NODISCARD GroupCharacterPosition final
+{
+    Coordinate pos;
+    Color color;
+    bool fill = true;
+    QList<Coordinate> prespam;
+};
+
+/// Geometry built once by CharacterBatch::bake(), and drawn until it's out of date.
+class NODISCARD CharacterMeshes final
+{
+private:
+    struct NODISCARD Part final
+    {
+        UniqueMesh mesh;
+        GLRenderState state;
+    };
+    std::vector<Part> m_parts;
+
+public:
+    CharacterMeshes() = default;
+    ~CharacterMeshes() = default;
+    DEFAULT_MOVES_DELETE_COPIES(CharacterMeshes);
+
+public:
+    void add(UniqueMesh mesh, const GLRenderState &state)
+    {
+        m_parts.emplace_back(Part{std::move(mesh), state});
+    }
+    void render()
+    {
+        for (Part &part : m_parts)
+            part.mesh.render(part.state);
+    }
+};
+
+/// The group's characters on the map, and what they were drawn for; the edge arrows of
+/// characters that are out of view depend on the view, so they're drawn every frame.
+struct NODISCARD GroupCharacterMeshes final
+{
+    struct NODISCARD Key final
+    {
+        int layer = 0;
+        bool isFar = false;
+        bool drawBeacons = false;
+        // Our own room, which the group's characters make room for.
+        Coordinate self;
+
+        NODISCARD bool operator==(const Key &other) const
+        {
+            return layer == other.layer && isFar == other.isFar
+                   && drawBeacons == other.drawBeacons && self == other.self;
+        }
+        NODISCARD bool operator!=(const Key &other) const { return !operator==(other); }
+    };
+
+    Key key;
+    CharacterMeshes meshes;
+};
+
 // TODO: find a better home for this. It's common to characters and room selections.
 class NODISCARD DistantObjectTransform final
 {
@@ -116,6 +179,8 @@ class NODISCARD CharacterBatch final
             reallyDrawPaths(gl);
         }
 
+        NODISCARD CharacterMeshes bake(OpenGL &gl, const MapCanvasTextures &textures) const;
+
     private:
         void reallyDrawCharacters(OpenGL &gl, const MapCanvasTextures &textures);
         void reallyDrawPaths(OpenGL &gl);
@@ -207,14 +272,30 @@ class NODISCARD CharacterBatch final
 
 public:
     void drawCharacter(const Coordinate &coordinate, const Color &color, bool fill = true);
+    // The part of drawCharacter() that doesn't depend on where the view is: the box, with a
+    // beacon even if it's out of view, and the arrow that points to another layer.
+    void drawCharacterOnMap(const Coordinate &coordinate, const Color &color, bool fill = true);
+    // The part that does: the arrow at the edge of the screen that points to it.
+    void drawDistantCharacter(const Coordinate &coordinate, const Color &color, bool fill = true);
 
     void drawPreSpammedPath(const Coordinate &coordinate,
                             const QList<Coordinate> &path,
                             const Color &color);
 
+private:
+    void drawCharacterBody(const Coordinate &coordinate,
+                           const Color &color,
+                           bool fill,
+                           bool allowBeacon);
+
 public:
     void reallyDraw(OpenGL &gl, const MapCanvasTextures &textures)
     {
         m_fakeGL.reallyDraw(gl, textures);
     }
+    /// Screen-space arrows aren't kept; use drawDistantCharacter() every frame instead.
+    NODISCARD CharacterMeshes bake(OpenGL &gl, const MapCanvasTextures &textures) const
+    {
+        return m_fakeGL.bake(gl, textures);
+    }
 };
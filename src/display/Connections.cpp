@@ -5,7 +5,9 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <functional>
 #include <glm/glm.hpp>
+#include <map>
 #include <optional>
 #include <vector>
 #include <QColor>
@@ -18,12 +20,14 @@
 #include "../global/Flags.h"
 #include "../mapdata/DoorFlags.h"
 #include "../mapdata/ExitFieldVariant.h"
+#include "../mapdata/MapSnapshot.h"
 #include "../mapdata/mapdata.h"
 #include "../opengl/Font.h"
 #include "../opengl/FontFormatFlags.h"
 #include "../opengl/OpenGL.h"
 #include "../opengl/OpenGLTypes.h"
 #include "ConnectionLineBuilder.h"
+#include "LabelPlacement.h"
 #include "MapCanvasData.h"
 #include "connectionselection.h"
 #include "mapcanvas.h"
@@ -116,9 +120,42 @@ static QString getPostfixedDoorName(const Room *const room, const ExitDirEnum di
     return room->exit(dir).getDoorName() + postFix;
 }
 
-UniqueMesh RoomNameBatch::getMesh(GLFont &font)
+RoomNameMeshes RoomNameBatch::getMeshes(GLFont &font, const float devicePixelRatio)
 {
-    return font.getFontMesh(m_names);
+    const auto fontHeight = static_cast<float>(font.getFontHeight());
+    std::vector<LabelPlacement::Label> labels;
+    labels.reserve(m_names.size());
+    for (size_t i = 0, size = m_names.size(); i < size; ++i) {
+        const GLText &name = m_names[i];
+        float width = 0.f;
+        for (const char c : name.text)
+            width += static_cast<float>(font.getGlyphAdvance(c).value_or(0));
+        labels.emplace_back(LabelPlacement::Label{glm::vec2{name.pos},
+                                                  glm::vec2{width, fontHeight} / devicePixelRatio,
+                                                  m_priorities[i]});
+    }
+    const std::vector<int> lastLevels = LabelPlacement::getLastLevels(labels);
+
+    std::map<int, std::vector<GLText>, std::greater<>> byLevel;
+    for (size_t i = 0, size = m_names.size(); i < size; ++i) {
+        if (lastLevels[i] >= 0)
+            byLevel[lastLevels[i]].emplace_back(m_names[i]);
+    }
+
+    RoomNameMeshes result;
+    result.meshes.reserve(byLevel.size());
+    for (const auto &entry : byLevel)
+        result.meshes.emplace_back(entry.first, font.getFontMesh(entry.second));
+    return result;
+}
+
+void RoomNameMeshes::render(const int level)
+{
+    for (auto &entry : meshes) {
+        if (entry.first < level)
+            break;
+        entry.second.render(GLRenderState());
+    }
 }
 
 void ConnectionDrawer::drawRoomDoorName(const Room *const sourceRoom,
@@ -155,11 +192,6 @@ void ConnectionDrawer::drawRoomDoorName(const Room *const sourceRoom,
             return;
         }
 
-        if (m_measureOnly) {
-            ++m_expectedRoomNames;
-            return;
-        }
-
         together = true;
 
         // no need for duplicating names (its spammy)
@@ -171,10 +203,6 @@ void ConnectionDrawer::drawRoomDoorName(const Room *const sourceRoom,
             name = sourceName;
         }
     } else {
-        if (m_measureOnly) {
-            ++m_expectedRoomNames;
-            return;
-        }
         name = getPostfixedDoorName(sourceRoom, sourceDir);
     }
 
@@ -218,14 +246,17 @@ void ConnectionDrawer::drawRoomDoorName(const Room *const sourceRoom,
 
     static const auto bg = Colors::black.withAlpha(0.4f);
     const glm::vec3 pos{xy, m_currentLayer};
+    // The names of both sides of a door are kept over the names of one side.
     m_roomNameBatch.emplace_back(GLText{pos,
                                         ::toStdStringLatin1(name),
                                         Colors::white,
                                         bg,
-                                        FontFormatFlags{FontFormatFlagEnum::HALIGN_CENTER}});
+                                        FontFormatFlags{FontFormatFlagEnum::HALIGN_CENTER}},
+                                 together ? 1 : 0);
 }
 
-void ConnectionDrawer::drawRoomConnectionsAndDoors(const Room *const room, const RoomIndex &rooms)
+void ConnectionDrawer::drawRoomConnectionsAndDoors(const Room *const room,
+                                                   const MapSnapshot &snapshot)
 {
     // Ooops, this is wrong since we may reject a connection that would be visible
     // if we looked at the other side.
@@ -239,15 +270,13 @@ void ConnectionDrawer::drawRoomConnectionsAndDoors(const Room *const room, const
         // outgoing connections
         if (sourceWithinBounds) {
             for (const auto &outTargetId : sourceExit.outRange()) {
-                const SharedConstRoom &sharedTargetRoom = rooms[outTargetId];
-                if (!sharedTargetRoom) {
+                const Room *const targetRoom = snapshot.getRoom(outTargetId);
+                if (targetRoom == nullptr) {
                     qWarning() << "Source room" << sourceId.asUint32() << "has target room"
                                << outTargetId.asUint32() << "which does not exist!";
                     continue;
                 }
 
-                const Room *const targetRoom = sharedTargetRoom.get();
-
                 const bool targetOutsideBounds = !m_bounds.contains(targetRoom->getPosition());
 
                 // Two way means that the target room directly connects back to source room
@@ -286,15 +315,13 @@ void ConnectionDrawer::drawRoomConnectionsAndDoors(const Room *const room, const
 
         // incoming connections
         for (const auto &inTargetId : sourceExit.inRange()) {
-            const SharedConstRoom &sharedTargetRoom = rooms[inTargetId];
-            if (!sharedTargetRoom) {
+            const Room *const targetRoom = snapshot.getRoom(inTargetId);
+            if (targetRoom == nullptr) {
                 qWarning() << "Source room" << sourceId.asUint32() << "has target room"
                            << inTargetId.asUint32() << "which does not exist!";
                 continue;
             }
 
-            const Room *const targetRoom = sharedTargetRoom.get();
-
             // Only draw the connection if the target room is within the bounds
             if (!m_bounds.contains(targetRoom->getPosition()))
                 continue;
@@ -383,38 +410,49 @@ void ConnectionDrawer::drawConnection(const Room *leftRoom,
         neighbours = true;
     }
 
-    auto &gl = getFakeGL();
-
-    gl.setOffset(static_cast<float>(leftX), static_cast<float>(leftY), 0.f);
+    const glm::ivec3 delta{dX, dY, dZ};
+    const ConnectionShapeCache::Key key{startDir, endDir, oneway, neighbours, delta};
+    emitShape(getShape(key), leftPos.to_vec3(), inExitFlags);
+}
 
-    if (inExitFlags)
-        gl.setNormal();
-    else
-        gl.setRed();
+const ConnectionShape &ConnectionDrawer::getShape(const ConnectionShapeCache::Key &key)
+{
+    if (const ConnectionShape *const shape = m_shapes.find(key))
+        return *shape;
 
+    // The shape is relative to the start room, so it starts on layer 0.
+    ConnectionShape shape;
+    m_fake.setShape(&shape);
     {
-        const auto srcZ = static_cast<float>(leftZ);
-        const auto dstZ = static_cast<float>(rightZ);
-
-        drawConnectionLine(startDir,
-                           endDir,
-                           oneway,
-                           neighbours,
-                           static_cast<float>(dX),
-                           static_cast<float>(dY),
-                           srcZ,
-                           dstZ);
-        drawConnectionTriangles(startDir,
-                                endDir,
-                                oneway,
-                                static_cast<float>(dX),
-                                static_cast<float>(dY),
-                                srcZ,
-                                dstZ);
+        const auto dX = static_cast<float>(key.delta.x);
+        const auto dY = static_cast<float>(key.delta.y);
+        const auto dstZ = static_cast<float>(key.delta.z);
+        drawConnectionLine(key.startDir, key.endDir, key.oneway, key.neighbours, dX, dY, 0.f, dstZ);
+        drawConnectionTriangles(key.startDir, key.endDir, key.oneway, dX, dY, 0.f, dstZ);
     }
+    m_fake.setShape(nullptr);
+    return m_shapes.insert(key, std::move(shape));
+}
 
-    gl.setOffset(0, 0, 0);
-    gl.setNormal();
+void ConnectionDrawer::emitShape(const ConnectionShape &shape,
+                                 const glm::vec3 &offset,
+                                 const bool inExitFlags)
+{
+    ConnectionDrawerColorBuffer &buffer = inExitFlags ? m_buffers.normal : m_buffers.red;
+    const Color color = inExitFlags ? getConfig().canvas.connectionNormalColor.getColor()
+                                    : Colors::red;
+
+    buffer.segments.reserve(buffer.segments.size() + shape.segments.size());
+    for (const ConnectionShape::Segment &segment : shape.segments) {
+        buffer.segments.emplace_back(color,
+                                     segment.from + offset,
+                                     segment.to + offset,
+                                     FAINT_CONNECTION_ALPHA);
+    }
+    buffer.triVerts.reserve(buffer.triVerts.size() + shape.triVerts.size());
+    for (const glm::vec3 &v : shape.triVerts) {
+        buffer.triVerts.emplace_back(color, v + offset);
+    }
 }
 
 void ConnectionDrawer::drawConnectionTriangles(const ExitDirEnum startDir,
@@ -594,13 +632,34 @@ void ConnectionDrawer::drawConnEndTriUpDownUnknown(float dX, float dY, float dst
                              glm::vec3{dX + 0.7f, dY + 0.45f, dstZ});
 }
 
-ConnectionMeshes ConnectionDrawerBuffers::getMeshes(OpenGL &gl)
+NODISCARD static std::optional<std::vector<PackedColorVert>> tryPack(
+    const std::vector<ColorVert> &verts, const glm::vec3 &origin)
+{
+    std::vector<PackedColorVert> result;
+    result.reserve(verts.size());
+    for (const ColorVert &v : verts) {
+        const glm::vec3 offset = v.vert - origin;
+        if (!PackedColorVert::canPack(offset))
+            return std::nullopt;
+        result.emplace_back(v.color, offset);
+    }
+    return result;
+}
+
+ConnectionMeshes ConnectionDrawerBuffers::getMeshes(OpenGL &gl, const glm::vec3 &origin)
 {
+    // A connection to a room far enough away keeps the whole buffer in floats.
+    const auto createTris = [&gl, &origin](const std::vector<ColorVert> &verts) -> UniqueMesh {
+        if (const auto packed = tryPack(verts, origin))
+            return gl.createPackedColoredTriBatch(packed.value(), origin);
+        return gl.createColoredTriBatch(verts);
+    };
+
     ConnectionMeshes result;
-    result.normalLines = gl.createColoredLineBatch(normal.lineVerts);
-    result.normalTris = gl.createColoredTriBatch(normal.triVerts);
-    result.redLines = gl.createColoredLineBatch(red.lineVerts);
-    result.redTris = gl.createColoredTriBatch(red.triVerts);
+    result.normalLines = gl.createSegmentBatch(normal.segments, origin);
+    result.normalTris = createTris(normal.triVerts);
+    result.redLines = gl.createSegmentBatch(red.segments, origin);
+    result.redTris = createTris(red.triVerts);
     return result;
 }
 
@@ -668,11 +727,12 @@ void MapCanvas::paintNearbyConnectionPoints()
         for (int dy = -1; dy <= 1; ++dy) {
             for (int dx = -1; dx <= 1; ++dx) {
                 const auto roomCoord = mouse + Coordinate(dx, dy, 0);
-                const Room *const room = m_data.getRoom(roomCoord);
+                const auto handle = m_data.readRoom(roomCoord);
+                const Room *const room = handle.getRoom();
                 if (room == nullptr)
                     continue;
 
-                ExitDirections dirs = isSelection ? m_data.getExitDirections(roomCoord) : allExits;
+                ExitDirections dirs = isSelection ? handle.getExitDirections() : allExits;
                 if (optFirst)
                     dirs |= ExitDirEnum::UNKNOWN;
 
@@ -743,74 +803,21 @@ void MapCanvas::paintSelectedConnection()
     gl.renderPoints(points, rs.withPointSize(NEW_CONNECTION_POINT_SIZE));
 }
 
-static constexpr float LONG_LINE_HALFLEN = 1.5f;
-static constexpr float LONG_LINE_LEN = 2.f * LONG_LINE_HALFLEN;
-static bool isLongLine(const glm::vec3 &a, const glm::vec3 &b)
-{
-    return glm::length(a - b) >= LONG_LINE_LEN;
-}
-
 void ConnectionDrawer::ConnectionFakeGL::drawTriangle(const glm::vec3 &a,
                                                       const glm::vec3 &b,
                                                       const glm::vec3 &c)
 {
-    if (m_measureOnly) {
-        m_expectedTriVerts[isNormal() ? 0 : 1] += 3;
-        return;
-    }
-
-    const auto &color = isNormal() ? getConfig().canvas.connectionNormalColor.getColor()
-                                   : Colors::red;
-    auto &verts = deref(m_currentBuffer).triVerts;
-    verts.emplace_back(color, a + m_offset);
-    verts.emplace_back(color, b + m_offset);
-    verts.emplace_back(color, c + m_offset);
+    auto &verts = deref(m_shape).triVerts;
+    verts.emplace_back(a);
+    verts.emplace_back(b);
+    verts.emplace_back(c);
 }
 
 void ConnectionDrawer::ConnectionFakeGL::drawLineStrip(const std::vector<glm::vec3> &points)
 {
-    static const size_t LONG_LINE_DIVISONS = 3;
-
-    if (m_measureOnly) {
-        auto count = VERTS_PER_LINE * (points.size() - 1);
-        for (size_t i = 1, size = points.size(); i < size; ++i) {
-            if (isLongLine(points[i - 1u], points[i])) {
-                count += (LONG_LINE_DIVISONS - 1) * VERTS_PER_LINE;
-            }
-        }
-        m_expectedLineVerts[isNormal() ? 0 : 1] += count;
-        return;
-    }
-
-    const auto &color = isNormal() ? getConfig().canvas.connectionNormalColor.getColor()
-                                   : Colors::red;
-
     assert(points.size() >= 2);
-    const auto transform = [this](const glm::vec3 &vert) { return vert + m_offset; };
-    auto &verts = deref(m_currentBuffer).lineVerts;
+    auto &segments = deref(m_shape).segments;
     for (size_t i = 1, size = points.size(); i < size; ++i) {
-        const auto &a = points[i - 1u];
-        const auto &b = points[i];
-
-        if (!isLongLine(a, b)) {
-            verts.emplace_back(color, transform(a));
-            verts.emplace_back(color, transform(b));
-            continue;
-        }
-
-        const auto start = transform(a);
-        const auto end = transform(b);
-        const auto len = glm::length(start - end);
-        const auto faintCutoff = LONG_LINE_HALFLEN / len;
-        const auto mid1 = glm::mix(start, end, faintCutoff);
-        const auto mid2 = glm::mix(start, end, 1.f - faintCutoff);
-        const auto faint = color.withAlpha(FAINT_CONNECTION_ALPHA);
-#define LINE(color, a, b) \
-    verts.emplace_back((color), (a)); \
-    verts.emplace_back((color), (b));
-        LINE(color, start, mid1);
-        LINE(faint, mid1, mid2);
-        LINE(color, mid2, end);
-#undef LINE
+        segments.push_back(ConnectionShape::Segment{points[i - 1u], points[i]});
     }
 }
@@ -6,7 +6,10 @@
 #include <cassert>
 #include <cstddef>
 #include <glm/glm.hpp>
+#include <map>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <QString>
 
@@ -19,13 +22,31 @@
 #include "../opengl/Font.h"
 #include "../opengl/OpenGLTypes.h"
 
+class MapSnapshot;
 class OpenGL;
 class Room;
 
+/// The door names of a tile, with one mesh for each zoom level that hides some of them, so
+/// they don't pile up on each other when zoomed out; see LabelPlacement.
+struct NODISCARD RoomNameMeshes final
+{
+    // by decreasing level; each one is drawn at its level and the closer ones
+    std::vector<std::pair<int, UniqueMesh>> meshes;
+
+    RoomNameMeshes() = default;
+    DEFAULT_MOVES_DELETE_COPIES(RoomNameMeshes);
+    ~RoomNameMeshes() = default;
+
+    /// `level` is LabelPlacement::getLevel() of the zoom.
+    void render(int level);
+};
+
 struct NODISCARD RoomNameBatch final
 {
 private:
     std::vector<GLText> m_names;
+    // of each name; higher priority names are the last hidden
+    std::vector<int> m_priorities;
 
 public:
     RoomNameBatch() = default;
@@ -33,23 +54,34 @@ struct NODISCARD RoomNameBatch final
     ~RoomNameBatch() = default;
 
 public:
-    void emplace_back(GLText &&glt) { m_names.emplace_back(std::move(glt)); }
+    void emplace_back(GLText &&glt, const int priority)
+    {
+        m_names.emplace_back(std::move(glt));
+        m_priorities.emplace_back(priority);
+    }
 
 public:
-    void reserve(const size_t elements) { m_names.reserve(elements); }
+    void reserve(const size_t elements)
+    {
+        m_names.reserve(elements);
+        m_priorities.reserve(elements);
+    }
     size_t size() const { return m_names.size(); }
-    void clear() { m_names.clear(); }
+    void clear()
+    {
+        m_names.clear();
+        m_priorities.clear();
+    }
     bool empty() const { return m_names.empty(); }
 
 public:
-    UniqueMesh getMesh(GLFont &font);
+    /// The names are measured with the font, which is in physical pixels.
+    RoomNameMeshes getMeshes(GLFont &font, float devicePixelRatio);
 };
 
-using BatchedRoomNames = std::unordered_map<int, UniqueMesh>;
-
 struct NODISCARD ConnectionDrawerColorBuffer final
 {
-    std::vector<ColorVert> lineVerts;
+    std::vector<ColorSegment> segments;
     std::vector<ColorVert> triVerts;
 
     ConnectionDrawerColorBuffer() = default;
@@ -58,10 +90,10 @@ struct NODISCARD ConnectionDrawerColorBuffer final
 
     void clear()
     {
-        lineVerts.clear();
+        segments.clear();
         triVerts.clear();
     }
-    NODISCARD bool empty() const { return lineVerts.empty() && triVerts.empty(); }
+    NODISCARD bool empty() const { return segments.empty() && triVerts.empty(); }
 };
 
 struct NODISCARD ConnectionMeshes final
@@ -94,57 +126,89 @@ struct NODISCARD ConnectionDrawerBuffers final
     }
     NODISCARD bool empty() const { return red.empty() && normal.empty(); }
 
-    ConnectionMeshes getMeshes(OpenGL &gl);
+    // The meshes are relative to the origin, if they're close enough to it.
+    ConnectionMeshes getMeshes(OpenGL &gl, const glm::vec3 &origin);
+};
+
+/// The lines and triangles of one connection, relative to the room it starts from.
+/// The middle of a long line is made faint when it's drawn; see ColorSegment.
+struct NODISCARD ConnectionShape final
+{
+    struct NODISCARD Segment final
+    {
+        glm::vec3 from{0.f};
+        glm::vec3 to{0.f};
+    };
+
+    std::vector<Segment> segments;
+    std::vector<glm::vec3> triVerts;
+};
+
+/// Memoizes ConnectionShape by everything that decides the shape, so the
+/// connection code only runs once for each distinct kind of connection;
+/// most connections are between neighbours, so there are only a few.
+///
+/// One cache is shared by all of the tiles of a batch build.
+class NODISCARD ConnectionShapeCache final
+{
+public:
+    struct NODISCARD Key final
+    {
+        ExitDirEnum startDir = ExitDirEnum::NONE;
+        ExitDirEnum endDir = ExitDirEnum::NONE;
+        bool oneway = false;
+        bool neighbours = false;
+        glm::ivec3 delta{0};
+
+        NODISCARD bool operator<(const Key &rhs) const
+        {
+            return std::tie(startDir, endDir, oneway, neighbours, delta.x, delta.y, delta.z)
+                   < std::tie(rhs.startDir,
+                              rhs.endDir,
+                              rhs.oneway,
+                              rhs.neighbours,
+                              rhs.delta.x,
+                              rhs.delta.y,
+                              rhs.delta.z);
+        }
+    };
+
+private:
+    std::map<Key, ConnectionShape> m_shapes;
+
+public:
+    ConnectionShapeCache() = default;
+    ~ConnectionShapeCache() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(ConnectionShapeCache);
+
+public:
+    NODISCARD const ConnectionShape *find(const Key &key) const
+    {
+        const auto it = m_shapes.find(key);
+        return (it == m_shapes.end()) ? nullptr : &it->second;
+    }
+    NODISCARD const ConnectionShape &insert(const Key &key, ConnectionShape &&shape)
+    {
+        return m_shapes.emplace(key, std::move(shape)).first->second;
+    }
 };
 
 struct NODISCARD ConnectionDrawer final
 {
 private:
+    // Records the primitives of the connection code into a ConnectionShape.
     struct NODISCARD ConnectionFakeGL final
     {
     private:
-        ConnectionDrawerBuffers &m_buffers;
-        ConnectionDrawerColorBuffer *m_currentBuffer = nullptr;
-        glm::vec3 m_offset{0.f};
-        bool m_measureOnly = true;
-
-        MMapper::Array<size_t, 2> m_expectedTriVerts;
-        MMapper::Array<size_t, 2> m_expectedLineVerts;
+        ConnectionShape *m_shape = nullptr;
 
     public:
-        explicit ConnectionFakeGL(ConnectionDrawerBuffers &buffers)
-            : m_buffers{buffers}
-            , m_currentBuffer{&m_buffers.normal}
-        {}
-
+        ConnectionFakeGL() = default;
         ~ConnectionFakeGL() = default;
         DELETE_CTORS_AND_ASSIGN_OPS(ConnectionFakeGL);
 
     public:
-        void endMeasurements()
-        {
-            m_measureOnly = false;
-
-            assert(m_buffers.empty());
-            m_buffers.normal.lineVerts.reserve(m_expectedLineVerts[0]);
-            m_buffers.normal.triVerts.reserve(m_expectedTriVerts[0]);
-            m_buffers.red.lineVerts.reserve(m_expectedLineVerts[1]);
-            m_buffers.red.triVerts.reserve(m_expectedTriVerts[1]);
-        }
-
-        void verify()
-        {
-            assert(m_buffers.normal.lineVerts.size() == m_expectedLineVerts[0]);
-            assert(m_buffers.normal.triVerts.size() == m_expectedTriVerts[0]);
-            assert(m_buffers.red.lineVerts.size() == m_expectedLineVerts[1]);
-            assert(m_buffers.red.triVerts.size() == m_expectedTriVerts[1]);
-        }
-
-    public:
-        void setOffset(float x, float y, float z) { m_offset = glm::vec3{x, y, z}; }
-        void setRed() { m_currentBuffer = &m_buffers.red; }
-        void setNormal() { m_currentBuffer = &m_buffers.normal; }
-        bool isNormal() const { return m_currentBuffer == &m_buffers.normal; }
+        void setShape(ConnectionShape *const shape) { m_shape = shape; }
 
     public:
         void drawTriangle(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c);
@@ -153,19 +217,19 @@ struct NODISCARD ConnectionDrawer final
 
 private:
     ConnectionFakeGL m_fake;
+    ConnectionShapeCache &m_shapes;
     ConnectionDrawerBuffers &m_buffers;
     RoomNameBatch &m_roomNameBatch;
     const OptBounds &m_bounds;
     const int &m_currentLayer;
-    bool m_measureOnly = true;
-    size_t m_expectedRoomNames = 0;
 
 public:
-    explicit ConnectionDrawer(ConnectionDrawerBuffers &buffers,
+    explicit ConnectionDrawer(ConnectionShapeCache &shapes,
+                              ConnectionDrawerBuffers &buffers,
                               RoomNameBatch &roomNameBatch,
                               const int &currentLayer,
                               const OptBounds &bounds)
-        : m_fake{buffers}
+        : m_shapes{shapes}
         , m_buffers{buffers}
         , m_roomNameBatch{roomNameBatch}
         , m_bounds{bounds}
@@ -178,23 +242,14 @@ struct NODISCARD ConnectionDrawer final
     ~ConnectionDrawer() = default;
     DELETE_CTORS_AND_ASSIGN_OPS(ConnectionDrawer);
 
-public:
-    void endMeasurements()
-    {
-        m_measureOnly = false;
-        m_fake.endMeasurements();
-        m_roomNameBatch.reserve(m_expectedRoomNames);
-    }
-
-    void verify()
-    {
-        m_fake.verify();
-        assert(m_roomNameBatch.size() == m_expectedRoomNames);
-    }
+private:
+    NODISCARD const ConnectionShape &getShape(const ConnectionShapeCache::Key &key);
+    void emitShape(const ConnectionShape &shape, const glm::vec3 &offset, bool inExitFlags);
 
+public:
     ConnectionFakeGL &getFakeGL() { return m_fake; }
 
-    void drawRoomConnectionsAndDoors(const Room *room, const RoomIndex &rooms);
+    void drawRoomConnectionsAndDoors(const Room *room, const MapSnapshot &snapshot);
 
     void drawRoomDoorName(const Room *sourceRoom,
                           ExitDirEnum sourceDir,
@@ -235,6 +290,3 @@ struct NODISCARD ConnectionDrawer final
                                  float srcZ,
                                  float dstZ);
 };
-
-using BatchedConnections = std::unordered_map<int, ConnectionDrawerBuffers>;
-using BatchedConnectionMeshes = std::unordered_map<int, ConnectionMeshes>;
@@ -0,0 +1,38 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "FrameBudget.h"
+
+bool FrameBudget::addFrame(const double ms)
+{
+    m_averageMs = (m_framesSinceStep == 0) ? ms : m_averageMs + (ms - m_averageMs) * SMOOTHING;
+    if (++m_framesSinceStep < SETTLE_FRAMES)
+        return false;
+
+    if (m_averageMs > BUDGET_MS && m_step < NUM_STEPS) {
+        ++m_step;
+    } else if (m_averageMs < BUDGET_MS * HEADROOM && m_step > 0) {
+        --m_step;
+    } else {
+        return false;
+    }
+    m_framesSinceStep = 0;
+    return true;
+}
+
+void FrameBudget::reset()
+{
+    m_averageMs = 0.0;
+    m_framesSinceStep = 0;
+    m_step = 0;
+}
+
+FrameQuality FrameBudget::getQuality() const
+{
+    FrameQuality quality;
+    quality.multisampling = m_step < 1;
+    quality.doorNames = m_step < 2;
+    if (m_step >= 3)
+        quality.maxLayerDistance = FAR_LAYER_DISTANCE;
+    return quality;
+}
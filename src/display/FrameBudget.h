@@ -0,0 +1,60 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <optional>
+
+#include "../global/macros.h"
+
+/// What a frame may draw; the defaults are the full quality.
+struct NODISCARD FrameQuality final
+{
+    bool multisampling = true;
+    bool doorNames = true;
+    // How many layers away from the focused one are still drawn; nothing if they all are.
+    std::optional<int> maxLayerDistance;
+
+    NODISCARD bool isLayerDrawn(const int layer, const int focusedLayer) const
+    {
+        if (!maxLayerDistance.has_value())
+            return true;
+        const int distance = layer < focusedLayer ? focusedLayer - layer : layer - focusedLayer;
+        return distance <= maxLayerDistance.value();
+    }
+};
+
+/// Lowers the quality one step at a time while the recent frames take longer than the
+/// budget, and raises it again once they've had plenty of headroom for a while: first
+/// multisampling goes, then the door names, and then the layers far from the focused one.
+///
+/// Frame times are averaged, and each step waits for the average to follow it, so a
+/// single slow frame (e.g. one that uploads meshes) doesn't change anything.
+class NODISCARD FrameBudget final
+{
+public:
+    static constexpr const double BUDGET_MS = 16.0;
+    // The quality is only raised while the frames take less than this part of the budget,
+    // so that it doesn't go back and forth.
+    static constexpr const double HEADROOM = 0.5;
+    // The weight of each new frame in the average.
+    static constexpr const double SMOOTHING = 0.1;
+    // Frames drawn after each step before the next one.
+    static constexpr const int SETTLE_FRAMES = 30;
+    static constexpr const int FAR_LAYER_DISTANCE = 2;
+    static constexpr const int NUM_STEPS = 3;
+
+private:
+    double m_averageMs = 0.0;
+    int m_framesSinceStep = 0;
+    int m_step = 0;
+
+public:
+    /// Counts a frame that took `ms` milliseconds; returns true if the quality changed.
+    NODISCARD bool addFrame(double ms);
+    /// Goes back to the full quality, e.g. once adapting is turned off.
+    void reset();
+
+    NODISCARD int getStep() const { return m_step; }
+    NODISCARD double getAverageMs() const { return m_averageMs; }
+    NODISCARD FrameQuality getQuality() const;
+};
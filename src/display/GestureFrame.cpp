@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "GestureFrame.h"
+
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../opengl/OpenGL.h"
+#include "../opengl/OpenGLTypes.h"
+
+namespace { // anonymous
+
+// Where the ray through `ndc` meets the plane z = layer, if it does between the near and
+// far planes.
+std::optional<glm::vec3> unprojectToLayer(const glm::mat4 &inverseViewProj,
+                                          const glm::vec2 &ndc,
+                                          const float layer)
+{
+    const auto unproject = [&inverseViewProj, &ndc](const float depth) -> glm::vec3 {
+        const glm::vec4 tmp = inverseViewProj * glm::vec4{ndc, depth, 1.f};
+        return glm::vec3{tmp} / tmp.w;
+    };
+    const glm::vec3 a = unproject(-1.f); // near
+    const glm::vec3 b = unproject(+1.f); // far
+    if (std::abs(b.z - a.z) < 1e-6f)
+        return std::nullopt;
+    const float t = (layer - a.z) / (b.z - a.z);
+    if (!(t >= 0.f && t <= 1.f))
+        return std::nullopt;
+    return glm::vec3{glm::vec2{glm::mix(a, b, t)}, layer};
+}
+
+float cross2(const glm::vec2 &a, const glm::vec2 &b)
+{
+    return a.x * b.y - a.y * b.x;
+}
+
+} // namespace
+
+GestureFrame::GestureFrame() = default;
+GestureFrame::~GestureFrame() = default;
+
+glm::mat4 GestureFrame::getFrameViewProj(const glm::mat4 &viewProj)
+{
+    const float scale = 1.f / SIZE_IN_VIEWS;
+    return glm::scale(glm::mat4(1.f), glm::vec3{scale, scale, 1.f}) * viewProj;
+}
+
+glm::ivec2 GestureFrame::getFrameSize(const glm::ivec2 &viewSize)
+{
+    return glm::ivec2{glm::vec2{viewSize} * SIZE_IN_VIEWS};
+}
+
+bool GestureFrame::begin(const glm::ivec2 &frameSize)
+{
+    invalidate();
+    return m_target.bind(frameSize);
+}
+
+void GestureFrame::end(const glm::mat4 &frameViewProj, const int layer)
+{
+    m_target.release();
+
+    const glm::mat4 inverseViewProj = glm::inverse(frameViewProj);
+    const auto flayer = static_cast<float>(layer);
+
+    // The layer's intersection with the view frustum is convex, so if the corners reach
+    // the layer, so does everything between them.
+    std::vector<glm::vec3> grid;
+    grid.reserve(static_cast<size_t>((GRID_SIZE + 1) * (GRID_SIZE + 1)));
+    for (int row = 0; row <= GRID_SIZE; ++row) {
+        for (int col = 0; col <= GRID_SIZE; ++col) {
+            const glm::vec2 tex = glm::vec2{col, row} / static_cast<float>(GRID_SIZE);
+            const auto pos = unprojectToLayer(inverseViewProj, tex * 2.f - 1.f, flayer);
+            if (!pos.has_value())
+                return;
+            grid.emplace_back(pos.value());
+        }
+    }
+
+    const auto index = [](const int col, const int row) -> size_t {
+        return static_cast<size_t>(row * (GRID_SIZE + 1) + col);
+    };
+    m_quads.clear();
+    m_quads.reserve(static_cast<size_t>(GRID_SIZE * GRID_SIZE * 4));
+    for (int row = 0; row < GRID_SIZE; ++row) {
+        for (int col = 0; col < GRID_SIZE; ++col) {
+            for (const glm::ivec2 &corner :
+                 {glm::ivec2{0, 0}, glm::ivec2{1, 0}, glm::ivec2{1, 1}, glm::ivec2{0, 1}}) {
+                const int c = col + corner.x;
+                const int r = row + corner.y;
+                const glm::vec2 tex = glm::vec2{c, r} / static_cast<float>(GRID_SIZE);
+                m_quads.emplace_back(tex, grid[index(c, r)]);
+            }
+        }
+    }
+
+    m_corners = std::array<glm::vec3, 4>{grid[index(0, 0)],
+                                         grid[index(GRID_SIZE, 0)],
+                                         grid[index(GRID_SIZE, GRID_SIZE)],
+                                         grid[index(0, GRID_SIZE)]};
+    m_layer = layer;
+}
+
+bool GestureFrame::covers(const glm::mat4 &viewProj, const int layer) const
+{
+    if (!m_corners.has_value() || layer != m_layer)
+        return false;
+
+    std::array<glm::vec2, 4> quad;
+    for (size_t i = 0; i < quad.size(); ++i) {
+        const glm::vec4 clip = viewProj * glm::vec4{m_corners.value()[i], 1.f};
+        if (clip.w < 1e-6f)
+            return false;
+        quad[i] = glm::vec2{clip} / clip.w;
+    }
+
+    // The quad is convex and counter-clockwise, so the view's corners are inside it if
+    // they're to the left of each of its edges.
+    float doubleArea = 0.f;
+    for (size_t i = 0; i < quad.size(); ++i) {
+        const glm::vec2 &a = quad[i];
+        const glm::vec2 &b = quad[(i + 1) % quad.size()];
+        doubleArea += cross2(a, b);
+        for (const glm::vec2 &corner : {glm::vec2{-1, -1}, glm::vec2{1, -1}, glm::vec2{1, 1},
+                                        glm::vec2{-1, 1}}) {
+            if (cross2(b - a, corner - a) < 0.f)
+                return false;
+        }
+    }
+
+    // The view spans 2x2 in NDC, so the frame spans SIZE_IN_VIEWS times that when it's drawn.
+    const float magnification = std::sqrt(doubleArea / 8.f) / SIZE_IN_VIEWS;
+    return magnification <= MAX_MAGNIFICATION;
+}
+
+void GestureFrame::composite(OpenGL &gl) const
+{
+    const SharedMMTexture &texture = m_target.getTexture();
+    if (!isValid() || texture == nullptr)
+        return;
+
+    gl.renderTexturedQuads(m_quads,
+                           GLRenderState()
+                               .withBlend(BlendModeEnum::NONE)
+                               .withDepthFunction(std::nullopt)
+                               .withTexture0(texture));
+}
+
+void GestureFrame::destroy()
+{
+    invalidate();
+    m_target.destroy();
+}
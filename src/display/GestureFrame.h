@@ -0,0 +1,70 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <glm/glm.hpp>
+#include <optional>
+#include <vector>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "RenderTexture.h"
+
+class OpenGL;
+struct TexVert;
+
+/// The whole frame, drawn once around the view with a margin on every side, so that while
+/// the view is being panned or zoomed it can be drawn as one textured quad on the current
+/// layer instead of drawing the map again.
+///
+/// The quad lies on the current layer, so that layer stays exactly in place; the others
+/// are slightly off in perspective until the frame is drawn again. It's drawn again once
+/// the view no longer fits in it, or is magnified too much to look sharp.
+///
+/// Everything has to be called with the canvas's OpenGL context current.
+class NODISCARD GestureFrame final
+{
+public:
+    // The frame is this many views wide and tall.
+    static constexpr const float SIZE_IN_VIEWS = 2.f;
+    static constexpr const float MAX_MAGNIFICATION = 1.5f;
+    // The quad is split into this many rows and columns, since a tilted view doesn't map
+    // the layer onto the frame linearly.
+    static constexpr const int GRID_SIZE = 8;
+
+private:
+    RenderTexture m_target;
+    // Where the corners of the frame are on its layer, counter-clockwise from the bottom
+    // left; nothing if the frame isn't valid.
+    std::optional<std::array<glm::vec3, 4>> m_corners;
+    std::vector<TexVert> m_quads;
+    int m_layer = 0;
+
+public:
+    GestureFrame();
+    ~GestureFrame();
+    DELETE_CTORS_AND_ASSIGN_OPS(GestureFrame);
+
+public:
+    /// The projection that draws `viewProj`'s view in the middle of the frame.
+    NODISCARD static glm::mat4 getFrameViewProj(const glm::mat4 &viewProj);
+    /// The frame's size for a view of `viewSize`, in the same units.
+    NODISCARD static glm::ivec2 getFrameSize(const glm::ivec2 &viewSize);
+
+public:
+    NODISCARD bool isValid() const { return m_corners.has_value(); }
+    void invalidate() { m_corners.reset(); }
+    /// Whether the view of `viewProj` on `layer` can be drawn from the frame.
+    NODISCARD bool covers(const glm::mat4 &viewProj, int layer) const;
+
+    /// Binds the frame (of `frameSize` device pixels) as the framebuffer to draw into;
+    /// returns false if it can't be made.
+    NODISCARD bool begin(const glm::ivec2 &frameSize);
+    /// Restores the previous framebuffer; the frame is valid unless the corners of
+    /// `frameViewProj` don't reach `layer` (e.g. a view tilted towards the horizon).
+    void end(const glm::mat4 &frameViewProj, int layer);
+    /// Draws the frame with the current projection; requires isValid().
+    void composite(OpenGL &gl) const;
+    void destroy();
+};
@@ -6,8 +6,10 @@
 
 #include <algorithm>
 #include <cassert>
+#include <glm/glm.hpp>
 
 #include "../expandoracommon/coordinate.h"
+#include "../mapdata/InfoMarkIndex.h"
 #include "../mapdata/infomark.h"
 #include "../mapdata/mapdata.h"
 
@@ -57,9 +59,13 @@ InfoMarkSelection::InfoMarkSelection(this_is_private,
     };
 
     assert(mapData);
-    for (const auto &marker : mapData->getMarkersList()) {
-        if (isMarkerInSelection(marker)) {
-            emplace_back(marker);
+    InfoMarkIndex::Area area;
+    area.z = z;
+    area.lo = glm::ivec2{bx1, by1};
+    area.hi = glm::ivec2{bx2, by2};
+    mapData->getMarkerIndex().forEachInArea(area, [this, &isMarkerInSelection](InfoMark &marker) {
+        if (isMarkerInSelection(&marker)) {
+            emplace_back(marker.shared_from_this());
         }
-    }
+    });
 }
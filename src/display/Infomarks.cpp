@@ -4,7 +4,9 @@
 #include "Infomarks.h"
 
 #include <cassert>
+#include <climits>
 #include <glm/glm.hpp>
+#include <limits>
 #include <optional>
 #include <unordered_map>
 #include <utility>
@@ -88,49 +90,39 @@ static FontFormatFlags getFontFormatFlags(const InfoMarkClassEnum infoMarkClass)
     return {};
 }
 
-BatchedInfomarksMeshes MapCanvas::getInfoMarksMeshes()
+std::optional<InfomarksTile> MapCanvas::getInfoMarksTile(const InfoMarkIndex::CellId &cell)
 {
-    // REVISIT: Infomarks uses QLinkedList. Linked list iteration can be
-    // an order of magnitude slower than vector iteration.
-    //
-    // Consider converting the infomarks data structure to std::vector.
-
-    BatchedInfomarksMeshes result;
-    {
-        for (const auto &mark : m_data.getMarkersList()) {
-            const int layer = mark->getPosition1().z;
-            const auto it = result.find(layer);
-            if (it == result.end())
-                result[layer]; // side effect: this creates the entry
+    std::vector<InfoMark *> markers;
+    m_data.getMarkerIndex().forEachHomedIn(cell, [&markers](InfoMark &marker) {
+        markers.emplace_back(&marker);
+    });
+    if (markers.empty())
+        return std::nullopt;
+
+    InfomarksTile result;
+    const auto toRooms = [](const Coordinate &c) -> glm::vec3 {
+        return glm::vec3{glm::vec2{c.x, c.y} / static_cast<float>(INFOMARK_SCALE), c.z};
+    };
+    result.min = result.max = toRooms(markers.front()->getPosition1());
+
+    InfomarksBatch batch{getOpenGL(), getGLFont()};
+    for (int i = 0; i < 2; ++i) {
+        for (InfoMark *const marker : markers) {
+            drawInfoMark(batch, marker, cell.z);
         }
+        if (i == 0)
+            batch.endMeasure();
+        else
+            batch.verify();
     }
-
-    if (result.size() >= 30)
-        qWarning() << "Infomarks span" << result.size()
-                   << "layers. Consider using a different algorithm if this function is too slow.";
-
-    // WARNING: This is O(layers) * O(markers), which is okay as long
-    // as the number of layers with infomarks is small.
-    //
-    // If the performance gets too bad, count # in each layer,
-    // allocate vectors, fill the vectors, and then only visit
-    // each one once per layer.
-    for (auto &it : result) {
-        const int layer = it.first;
-        InfomarksBatch batch{getOpenGL(), getGLFont()};
-        for (int i = 0; i < 2; ++i) {
-            for (const auto &m : m_data.getMarkersList()) {
-                drawInfoMark(batch, m.get(), layer);
-            }
-            if (i == 0)
-                batch.endMeasure();
-            else
-                batch.verify();
+    for (const InfoMark *const marker : markers) {
+        for (const Coordinate &c : {marker->getPosition1(), marker->getPosition2()}) {
+            result.min = glm::min(result.min, toRooms(c));
+            result.max = glm::max(result.max, toRooms(c));
         }
-
-        it.second = batch.getMeshes();
     }
 
+    result.meshes = batch.getMeshes();
     return result;
 }
 
@@ -209,9 +201,16 @@ InfomarksMeshes InfomarksBatch::getMeshes()
 {
     InfomarksMeshes result;
 
+    // The lines are widened on the GPU, relative to where the first one starts.
+    std::vector<ColorSegment> segments;
+    segments.reserve(m_lines.size() / VERTS_PER_LINE);
+    for (size_t i = 0; i + 1 < m_lines.size(); i += VERTS_PER_LINE)
+        segments.emplace_back(m_lines[i].color, m_lines[i].vert, m_lines[i + 1].vert);
+    const glm::vec3 origin = m_lines.empty() ? glm::vec3{0.f} : glm::floor(m_lines.front().vert);
+
     auto &gl = m_realGL;
     result.points = gl.createPointBatch(m_points);
-    result.lines = gl.createColoredLineBatch(m_lines);
+    result.lines = gl.createSegmentBatch(segments, origin);
     result.tris = gl.createColoredTriBatch(m_tris);
     result.textMesh = m_font.getFontMesh(m_text);
     result.isValid = true;
@@ -340,14 +339,35 @@ void MapCanvas::paintSelectedInfoMarks()
     if (m_infoMarkSelection == nullptr && m_canvasMouseMode != CanvasMouseModeEnum::SELECT_INFOMARKS)
         return;
 
+    // The selection itself only changes with the selection or the markers,
+    // so it's kept (per layer) until then; the rest depends on the mouse.
+    if (m_infoMarkSelection != nullptr) {
+        auto &cache = m_batches.selectedInfomarksMeshes;
+        if (!cache.has_value())
+            cache.emplace();
+        const int layer = m_currentLayer;
+        auto it = cache->find(layer);
+        if (it == cache->end()) {
+            InfomarksBatch selected{getOpenGL(), getGLFont()};
+            for (int i = 0; i < 2; ++i) {
+                for (const auto &marker : *m_infoMarkSelection) {
+                    drawInfoMark(selected, marker.get(), layer, {}, Colors::red);
+                }
+                if (i == 0)
+                    selected.endMeasure();
+                else
+                    selected.verify();
+            }
+            it = cache->emplace(layer, selected.getMeshes()).first;
+        }
+        it->second.render();
+    }
+
     const bool measureAndVerify = true;
     InfomarksBatch batch{getOpenGL(), getGLFont()};
     const auto draw = [this, &batch]() {
-        // draw selections
+        // draw the moved copies of the selection
         if (m_infoMarkSelection != nullptr) {
-            for (const auto &marker : *m_infoMarkSelection) {
-                drawInfoMark(batch, marker.get(), m_currentLayer, {}, Colors::red);
-            }
             if (hasInfoMarkSelectionMove()) {
                 const glm::vec2 offset = m_infoMarkSelectionMove->pos.to_vec2();
                 for (const auto &marker : *m_infoMarkSelection) {
@@ -386,9 +406,24 @@ void MapCanvas::paintSelectedInfoMarks()
                 drawPoint(pos2, color);
             };
 
-            for (const auto &marker : m_data.getMarkersList()) {
-                drawSelectionPoints(marker.get());
+            // Only the markers in view need their points.
+            glm::vec2 lo{std::numeric_limits<float>::max()};
+            glm::vec2 hi{std::numeric_limits<float>::lowest()};
+            const auto w = static_cast<float>(width());
+            const auto h = static_cast<float>(height());
+            const glm::vec2 corners[]{{0.f, 0.f}, {w, 0.f}, {0.f, h}, {w, h}};
+            for (const glm::vec2 &corner : corners) {
+                const glm::vec2 pos{unproject_clamped(corner)};
+                lo = glm::min(lo, pos);
+                hi = glm::max(hi, pos);
             }
+            InfoMarkIndex::Area area;
+            area.z = m_currentLayer;
+            area.lo = glm::ivec2{glm::floor(lo * static_cast<float>(INFOMARK_SCALE))};
+            area.hi = glm::ivec2{glm::ceil(hi * static_cast<float>(INFOMARK_SCALE))};
+            m_data.getMarkerIndex().forEachInArea(area, [&drawSelectionPoints](InfoMark &marker) {
+                drawSelectionPoints(&marker);
+            });
         }
     };
     if (measureAndVerify) {
@@ -409,20 +444,40 @@ void MapCanvas::paintBatchedInfomarks()
         return;
     }
 
-    BatchedInfomarksMeshes &map = m_batches.infomarksMeshes.value();
-    const auto it = map.find(static_cast<int>(m_currentLayer));
-    if (it == map.end())
-        return;
-
-    InfomarksMeshes &infomarksMeshes = it->second;
-    infomarksMeshes.render();
+    // Text and arrow heads can reach past the markers' positions by a few rooms.
+    static const glm::vec3 TEXT_MARGIN{8.f, 8.f, 0.5f};
+
+    TiledInfomarksMeshes &tiles = m_batches.infomarksMeshes.value();
+    const int layer = m_currentLayer;
+    const auto beg = tiles.lower_bound(InfoMarkIndex::CellId{layer, INT_MIN, INT_MIN});
+    const auto end = tiles.lower_bound(InfoMarkIndex::CellId{layer + 1, INT_MIN, INT_MIN});
+    for (auto it = beg; it != end; ++it) {
+        InfomarksTile &tile = it->second;
+        if (isBoxVisible(tile.min - TEXT_MARGIN, tile.max + TEXT_MARGIN))
+            tile.meshes.render();
+    }
 }
 
 void MapCanvas::updateInfomarkBatches()
 {
-    std::optional<BatchedInfomarksMeshes> &opt_infomarks = m_batches.infomarksMeshes;
-    if (opt_infomarks.has_value())
+    // The changes are taken even if everything is rebuilt, so they don't pile up.
+    const auto changes = m_data.takeMarkerMeshChanges();
+    std::optional<TiledInfomarksMeshes> &opt_infomarks = m_batches.infomarksMeshes;
+
+    const auto update = [this, &opt_infomarks](const InfoMarkIndex::CellId &cell) {
+        TiledInfomarksMeshes &tiles = opt_infomarks.value();
+        if (auto tile = getInfoMarksTile(cell))
+            tiles[cell] = std::move(tile.value());
+        else
+            tiles.erase(cell);
+    };
+
+    if (opt_infomarks.has_value() && changes.has_value()) {
+        for (const InfoMarkIndex::CellId &cell : changes.value())
+            update(cell);
         return;
+    }
 
-    opt_infomarks.emplace(getInfoMarksMeshes());
+    opt_infomarks.emplace();
+    m_data.getMarkerIndex().forEachHomeCell(update);
 }
@@ -4,6 +4,7 @@
 
 #include <cstddef>
 #include <glm/glm.hpp>
+#include <map>
 #include <optional>
 #include <unordered_map>
 #include <vector>
@@ -11,6 +12,7 @@
 
 #include "../global/Color.h"
 #include "../global/utils.h"
+#include "../mapdata/InfoMarkIndex.h"
 #include "../opengl/Font.h"
 #include "../opengl/FontFormatFlags.h"
 #include "../opengl/OpenGLTypes.h"
@@ -29,6 +31,16 @@ struct NODISCARD InfomarksMeshes final
 
 using BatchedInfomarksMeshes = std::unordered_map<int, InfomarksMeshes>;
 
+/// The markers whose home is one InfoMarkIndex cell, so a changed marker only
+/// rebuilds its cell; the box is around their positions (in rooms), not their text.
+struct NODISCARD InfomarksTile final
+{
+    InfomarksMeshes meshes;
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+};
+using TiledInfomarksMeshes = std::map<InfoMarkIndex::CellId, InfomarksTile>;
+
 struct NODISCARD InfomarksBatch final
 {
 private:
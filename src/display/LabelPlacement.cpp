@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "LabelPlacement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <unordered_set>
+
+#include "MapCanvasData.h"
+
+namespace LabelPlacement {
+
+// Logical pixels per room at a total scale factor of 1; see MapCanvas::getViewProj_old().
+static constexpr const float PIXELS_PER_ROOM = 44.f;
+// The size of a grid cell, in logical pixels.
+static constexpr const float CELL_PIXELS = 8.f;
+// Kept between labels, in logical pixels, so their backgrounds don't touch.
+static constexpr const float LABEL_MARGIN = 2.f;
+
+NODISCARD static float getScale(const int level)
+{
+    return ScaleFactor::MAX_VALUE / std::exp2(static_cast<float>(level) * 0.5f);
+}
+
+int getLevel(const float totalScaleFactor)
+{
+    if (!(totalScaleFactor > 0.f))
+        return NUM_LEVELS - 1;
+    const float level = 2.f * std::log2(ScaleFactor::MAX_VALUE / totalScaleFactor);
+    return std::clamp(static_cast<int>(std::ceil(level)), 0, NUM_LEVELS - 1);
+}
+
+std::vector<int> getLastLevels(const std::vector<Label> &labels)
+{
+    std::vector<size_t> order(labels.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&labels](const size_t lhs, const size_t rhs) {
+        return labels[lhs].priority > labels[rhs].priority;
+    });
+
+    std::vector<int> result(labels.size(), NUM_LEVELS - 1);
+    // still placed at the current level, in order of priority
+    std::vector<size_t> placed = order;
+    std::vector<size_t> kept;
+    std::unordered_set<uint64_t> taken;
+    for (int level = 0; level < NUM_LEVELS && !placed.empty(); ++level) {
+        const float cellRooms = CELL_PIXELS / (PIXELS_PER_ROOM * getScale(level));
+        const float pixelRooms = 1.f / (PIXELS_PER_ROOM * getScale(level));
+        const auto toCell = [cellRooms](const float rooms) -> int32_t {
+            return static_cast<int32_t>(std::floor(rooms / cellRooms));
+        };
+
+        taken.clear();
+        kept.clear();
+        for (const size_t index : placed) {
+            const Label &label = labels[index];
+            const glm::vec2 half{(label.size.x * 0.5f + LABEL_MARGIN) * pixelRooms,
+                                 (label.size.y + LABEL_MARGIN) * pixelRooms};
+            const glm::ivec2 lo{toCell(label.pos.x - half.x), toCell(label.pos.y)};
+            const glm::ivec2 hi{toCell(label.pos.x + half.x), toCell(label.pos.y + half.y)};
+
+            const auto key = [](const int x, const int y) -> uint64_t {
+                return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32u)
+                       | static_cast<uint32_t>(y);
+            };
+            bool isFree = true;
+            for (int y = lo.y; y <= hi.y && isFree; ++y)
+                for (int x = lo.x; x <= hi.x && isFree; ++x)
+                    isFree = taken.count(key(x, y)) == 0;
+
+            if (!isFree) {
+                result[index] = level - 1;
+                continue;
+            }
+            for (int y = lo.y; y <= hi.y; ++y)
+                for (int x = lo.x; x <= hi.x; ++x)
+                    taken.insert(key(x, y));
+            kept.emplace_back(index);
+        }
+        std::swap(placed, kept);
+    }
+    return result;
+}
+
+} // namespace LabelPlacement
@@ -0,0 +1,40 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <glm/glm.hpp>
+#include <vector>
+
+#include "../global/macros.h"
+
+/// Thins out labels that would overlap on the screen, at discrete zoom levels: level 0 is
+/// the closest zoom, and every level after it is zoomed out by sqrt(2). Each level is
+/// placed once, on a screen-space grid, and a label that loses its place at one level stays
+/// hidden at the levels after it, so a mesh can be built for each level up front and the
+/// draw only has to pick the meshes for the current zoom.
+///
+/// The view is assumed to be looking straight down, and only labels placed together
+/// (i.e. in the same tile) are kept apart.
+namespace LabelPlacement {
+
+static constexpr const int NUM_LEVELS = 16;
+
+struct NODISCARD Label final
+{
+    // where the text is anchored, in rooms; it's centered on x and starts at y
+    glm::vec2 pos{0.f};
+    // in logical pixels
+    glm::vec2 size{0.f};
+    // higher priority labels are placed first
+    int priority = 0;
+};
+
+/// The level of `totalScaleFactor`, rounded towards the levels that are further away,
+/// so labels placed for it don't overlap at that zoom.
+NODISCARD int getLevel(float totalScaleFactor);
+
+/// For each label, the last level at which it's drawn, or -1 if it overlaps a label of
+/// higher priority even at level 0.
+NODISCARD std::vector<int> getLastLevels(const std::vector<Label> &labels);
+
+} // namespace LabelPlacement
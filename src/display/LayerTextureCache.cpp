@@ -0,0 +1,43 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "LayerTextureCache.h"
+
+#include <vector>
+
+#include "../opengl/OpenGL.h"
+#include "../opengl/OpenGLTypes.h"
+
+bool LayerTextureCache::begin(const Key &key)
+{
+    m_key.reset();
+    return m_target.bind(key.size);
+}
+
+void LayerTextureCache::end(const Key &key)
+{
+    m_target.release();
+    m_key = key;
+}
+
+void LayerTextureCache::composite(OpenGL &gl) const
+{
+    const SharedMMTexture &texture = m_target.getTexture();
+    if (texture == nullptr)
+        return;
+
+    // The viewport is [-1,+1]^2, and the texture's first row is the bottom one.
+    const std::vector<TexVert> quad{TexVert{glm::vec2{0, 0}, glm::vec3{-1, -1, 0}},
+                                    TexVert{glm::vec2{1, 0}, glm::vec3{+1, -1, 0}},
+                                    TexVert{glm::vec2{1, 1}, glm::vec3{+1, +1, 0}},
+                                    TexVert{glm::vec2{0, 1}, glm::vec3{-1, +1, 0}}};
+
+    const auto oldProj = gl.getProjectionMatrix();
+    gl.setProjectionMatrix(glm::mat4(1));
+    gl.renderTexturedQuads(quad,
+                           GLRenderState()
+                               .withBlend(BlendModeEnum::NONE)
+                               .withDepthFunction(std::nullopt)
+                               .withTexture0(texture));
+    gl.setProjectionMatrix(oldProj);
+}
@@ -0,0 +1,67 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <glm/glm.hpp>
+#include <optional>
+
+#include "../global/Color.h"
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "MapCanvasData.h"
+#include "RenderTexture.h"
+
+class OpenGL;
+
+/// The background and the faded layers below the focused one, drawn once into a texture
+/// that's the size of the viewport, so they can be drawn as one opaque quad until the view,
+/// the focused layer, the level of detail, the layers drawn or the meshes change.
+///
+/// The layers above the focused one are blended over it, so they're still drawn every
+/// frame; caching them too would need premultiplied alpha, which GLRenderState can't do.
+///
+/// Everything has to be called with the canvas's OpenGL context current.
+class NODISCARD LayerTextureCache final
+{
+public:
+    struct NODISCARD Key final
+    {
+        glm::mat4 viewProj{1.f};
+        glm::ivec2 size{0};
+        int layer = 0;
+        LevelOfDetailEnum lod = LevelOfDetailEnum::LOW;
+        bool extraDetail = false;
+        Color background;
+        std::optional<int> maxLayerDistance;
+
+        NODISCARD bool operator==(const Key &rhs) const
+        {
+            return viewProj == rhs.viewProj && size == rhs.size && layer == rhs.layer
+                   && lod == rhs.lod && extraDetail == rhs.extraDetail
+                   && background == rhs.background && maxLayerDistance == rhs.maxLayerDistance;
+        }
+        NODISCARD bool operator!=(const Key &rhs) const { return !operator==(rhs); }
+    };
+
+private:
+    RenderTexture m_target;
+    std::optional<Key> m_key;
+
+public:
+    LayerTextureCache() = default;
+    ~LayerTextureCache() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(LayerTextureCache);
+
+public:
+    NODISCARD bool isCurrent(const Key &key) const { return m_key == key; }
+    /// Forgets the contents, e.g. because the meshes or the settings changed.
+    void invalidate() { m_key.reset(); }
+
+    /// Binds the texture as the framebuffer to draw the layers into; returns false if it
+    /// can't be made, in which case the caller should draw the layers directly.
+    NODISCARD bool begin(const Key &key);
+    /// Restores the framebuffer that was bound before begin().
+    void end(const Key &key);
+    /// Draws the texture over the whole viewport; requires isCurrent().
+    void composite(OpenGL &gl) const;
+};
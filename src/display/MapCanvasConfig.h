@@ -14,5 +14,8 @@ extern bool isAutoTilt();
 extern void setAutoTilt(bool val);
 extern bool getShowPerfStats();
 extern void setShowPerfStats(bool);
+extern bool getLogPerfStats();
+extern bool isAdaptiveQuality();
+extern void setAdaptiveQuality(bool);
 
 } // namespace MapCanvasConfig
@@ -47,6 +47,30 @@ std::optional<glm::vec3> MapCanvasViewport::project(const glm::vec3 &v) const
     return mouse_depth;
 }
 
+bool MapCanvasViewport::isBoxVisible(const glm::vec3 &min, const glm::vec3 &max) const
+{
+    // Each bit is one of the six clip planes; the box is culled if all of its
+    // corners are on the outside of the same plane.
+    uint32_t outsideAll = (1u << 6) - 1u;
+    for (uint32_t i = 0; i < 8; ++i) {
+        const glm::vec3 corner{(i & 1u) ? max.x : min.x,
+                               (i & 2u) ? max.y : min.y,
+                               (i & 4u) ? max.z : min.z};
+        const auto clip = m_viewProj * glm::vec4(corner, 1.f);
+        uint32_t outside = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            if (clip[axis] < -clip.w)
+                outside |= 1u << (2 * axis);
+            if (clip[axis] > clip.w)
+                outside |= 1u << (2 * axis + 1);
+        }
+        outsideAll &= outside;
+        if (outsideAll == 0)
+            return true;
+    }
+    return false;
+}
+
 // input: 2d mouse coordinates clamped in viewport_offset + [0..viewport_size]
 // and a depth value in the range 0..1.
 //
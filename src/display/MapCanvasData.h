@@ -7,6 +7,7 @@
 #include <memory>
 #include <optional>
 #include <unordered_map>
+#include <vector>
 #include <QWidget>
 #include <QtGui/QMatrix4x4>
 #include <QtGui/QMouseEvent>
@@ -38,6 +39,12 @@ const MMapper::Array<RoomTintEnum, NUM_ROOM_TINTS> &getAllRoomTints();
 template<typename T>
 using RoomTintArray = EnumIndexedArray<T, RoomTintEnum, NUM_ROOM_TINTS>;
 
+// How much of the map is drawn, depending on the zoom:
+// LOW only draws one prebaked image of the room colors per tile,
+// MEDIUM also draws the room textures but no walls, doors, or exits, and
+// FULL draws everything (connections and door names have their own cutoffs).
+enum class LevelOfDetailEnum { LOW, MEDIUM, FULL };
+
 struct NODISCARD LayerMeshes final
 {
     UniqueMeshVector terrain;
@@ -50,19 +57,21 @@ struct NODISCARD LayerMeshes final
     UniqueMeshVector streamIns;
     UniqueMeshVector streamOuts;
     UniqueMesh layerBoost;
+    UniqueMesh lowDetail;
     bool isValid = false;
 
     LayerMeshes() = default;
     DEFAULT_MOVES_DELETE_COPIES(LayerMeshes);
     ~LayerMeshes() = default;
 
-    void render(int thisLayer, int focusedLayer);
+    // Draws the meshes of several tiles of one layer, one kind of mesh at a time.
+    static void render(const std::vector<LayerMeshes *> &tiles,
+                       int thisLayer,
+                       int focusedLayer,
+                       LevelOfDetailEnum lod);
     explicit operator bool() const { return isValid; }
 };
 
-// This must be ordered so we can iterate over the layers from lowest to highest.
-using BatchedMeshes = std::map<int, LayerMeshes>;
-
 struct ScaleFactor final
 {
 public:
@@ -126,7 +135,9 @@ struct ScaleFactor final
 struct MapCanvasViewport
 {
 private:
-    QWidget &m_sizeWidget;
+    // Off-screen viewports have a fixed size instead of a widget.
+    const QWidget *m_sizeWidget = nullptr;
+    QSize m_fixedSize;
 
 public:
     glm::mat4 m_viewProj{1.f};
@@ -136,21 +147,37 @@ struct MapCanvasViewport
 
 public:
     explicit MapCanvasViewport(QWidget &sizeWidget)
-        : m_sizeWidget{sizeWidget}
+        : m_sizeWidget{&sizeWidget}
+    {}
+    explicit MapCanvasViewport(const QSize &fixedSize)
+        : m_fixedSize{fixedSize}
     {}
 
+private:
+    QRect getRect() const
+    {
+        return (m_sizeWidget != nullptr) ? m_sizeWidget->rect() : QRect{QPoint{}, m_fixedSize};
+    }
+
 public:
-    auto width() const { return m_sizeWidget.width(); }
-    auto height() const { return m_sizeWidget.height(); }
+    auto width() const { return getRect().width(); }
+    auto height() const { return getRect().height(); }
+    void setFixedSize(const QSize &size)
+    {
+        assert(m_sizeWidget == nullptr);
+        m_fixedSize = size;
+    }
     Viewport getViewport() const
     {
-        const auto &r = m_sizeWidget.rect();
+        const auto r = getRect();
         return Viewport{glm::ivec2{r.x(), r.y()}, glm::ivec2{r.width(), r.height()}};
     }
     float getTotalScaleFactor() const { return m_scaleFactor.getTotal(); }
 
 public:
     std::optional<glm::vec3> project(const glm::vec3 &) const;
+    // False only if the whole box is outside the view frustum.
+    bool isBoxVisible(const glm::vec3 &min, const glm::vec3 &max) const;
     glm::vec3 unproject_raw(const glm::vec3 &) const;
     glm::vec3 unproject_clamped(const glm::vec2 &) const;
     std::optional<glm::vec3> unproject(const QInputEvent *event) const;
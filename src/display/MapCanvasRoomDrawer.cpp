@@ -4,13 +4,18 @@
 
 #include "MapCanvasRoomDrawer.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <functional>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <memory>
 #include <optional>
 #include <set>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 #include <QColor>
 #include <QMessageLogContext>
@@ -27,11 +32,13 @@
 #include "../global/Debug.h"
 #include "../global/EnumIndexedArray.h"
 #include "../global/Flags.h"
+#include "../global/ParallelFor.h"
 #include "../global/RuleOf5.h"
 #include "../global/utils.h"
 #include "../mapdata/DoorFlags.h"
 #include "../mapdata/ExitFieldVariant.h"
 #include "../mapdata/ExitFlags.h"
+#include "../mapdata/MapSnapshot.h"
 #include "../mapdata/enums.h"
 #include "../mapdata/infomark.h"
 #include "../mapdata/mapdata.h"
@@ -40,6 +47,7 @@
 #include "../opengl/OpenGL.h"
 #include "../opengl/OpenGLTypes.h"
 #include "ConnectionLineBuilder.h"
+#include "LabelPlacement.h"
 #include "MapCanvasData.h"
 #include "RoadIndex.h"
 #include "mapcanvas.h" // hack, since we're now definining some of its symbols
@@ -113,31 +121,6 @@ static XNamedColor getVerticalNamedColor(const ExitFlags &flags)
     return getWallNamedColorCommon(flags, WallOrientationEnum::VERTICAL);
 }
 
-// All layers
-static void generateAllLayerMeshes(MapBatches &batches,
-                                   OpenGL &gl,
-                                   GLFont &font,
-                                   const LayerToRooms &layerToRooms,
-                                   const RoomIndex &roomIndex,
-                                   const MapCanvasTextures &textures,
-                                   const OptBounds &bounds);
-
-void MapCanvasRoomDrawer::generateBatches(const LayerToRooms &layerToRooms,
-                                          const RoomIndex &roomIndex,
-                                          const OptBounds &bounds)
-{
-    m_batches.reset();   // dtor, if necessary
-    m_batches.emplace(); // ctor
-
-    generateAllLayerMeshes(m_batches.value(),
-                           getOpenGL(),
-                           getFont(),
-                           layerToRooms,
-                           roomIndex,
-                           m_textures,
-                           bounds);
-}
-
 struct TerrainAndTrail
 {
     MMTexture *terrain = nullptr;
@@ -182,7 +165,7 @@ struct IRoomVisitorCallbacks
 IRoomVisitorCallbacks::~IRoomVisitorCallbacks() = default;
 
 static void visitRoom(const Room *const room,
-                      const RoomIndex &roomIndex,
+                      const MapSnapshot &snapshot,
                       const MapCanvasTextures &textures,
                       IRoomVisitorCallbacks &callbacks)
 {
@@ -228,17 +211,22 @@ static void visitRoom(const Room *const room,
         callbacks.visitOverlayTexture(room, textures.update->getRaw());
     }
 
-    const auto drawInFlow = [room, &roomIndex, &callbacks](const Exit &exit,
-                                                           const ExitDirEnum &dir) -> void {
+    const auto drawInFlow = [room, &snapshot, &callbacks](const Exit &exit,
+                                                          const ExitDirEnum &dir) -> void {
         // For each incoming connections
         for (const auto &targetId : exit.inRange()) {
-            const SharedConstRoom &targetRoom = roomIndex[targetId];
+            const Room *const targetRoom = snapshot.getRoom(targetId);
             if (targetRoom == nullptr)
                 continue;
+            // Most rooms have no flows at all, so their exits aren't looked at.
+            const uint32_t flows = targetRoom->getExitRenderMasks().flows;
+            if (flows == 0u)
+                continue;
             for (const auto targetDir : ALL_EXITS_NESWUD) {
+                if ((flows & ExitRenderMasks::dirBit(targetDir)) == 0u)
+                    continue;
                 const Exit &targetExit = targetRoom->exit(targetDir);
-                const ExitFlags &flags = targetExit.getExitFlags();
-                if (flags.isFlow() && targetExit.containsOut(room->getId())) {
+                if (targetExit.containsOut(room->getId())) {
                     callbacks.visitStream(room, dir, StreamTypeEnum::InFlow);
                     return;
                 }
@@ -251,6 +239,7 @@ static void visitRoom(const Room *const room,
     // FIXME: This requires a map update.
     // REVISIT: The logic of drawNotMappedExits seems a bit wonky.
     const auto drawNotMappedExits = getConfig().canvas.drawNotMappedExits;
+    const ExitRenderMasks &masks = room->getExitRenderMasks();
     for (auto &dir : ALL_EXITS_NESW) {
         const Exit &exit = room->exit(dir);
         const ExitFlags &flags = exit.getExitFlags();
@@ -269,9 +258,10 @@ static void visitRoom(const Room *const room,
                                 WallTypeEnum::DOTTED,
                                 isClimb);
         } else {
-            const auto namedColor = getWallNamedColor(flags);
-            if (!isTransparent(namedColor)) {
-                callbacks.visitWall(room, dir, namedColor, WallTypeEnum::DOTTED, isClimb);
+            if (masks.hasColoredWall(dir)) {
+                const auto namedColor = getWallNamedColor(flags);
+                if (!isTransparent(namedColor))
+                    callbacks.visitWall(room, dir, namedColor, WallTypeEnum::DOTTED, isClimb);
             }
 
             if (flags.isFlow()) {
@@ -329,7 +319,8 @@ static void visitRoom(const Room *const room,
 
         // NOTE: in the "old" version, this falls-thru and the custom color is overwritten
         // by the regular exit; so using if-else here is a bug fix.
-        const auto namedColor = getVerticalNamedColor(flags);
+        const auto namedColor = masks.hasColoredWall(dir) ? getVerticalNamedColor(flags)
+                                                          : LOOKUP_COLOR(TRANSPARENT);
         if (!isTransparent(namedColor)) {
             callbacks.visitWall(room, dir, namedColor, WallTypeEnum::DOTTED, isClimb);
         } else {
@@ -358,12 +349,12 @@ static void visitRoom(const Room *const room,
 }
 
 static void visitRooms(const RoomVector &rooms,
-                       const RoomIndex &roomIndex,
+                       const MapSnapshot &snapshot,
                        const MapCanvasTextures &textures,
                        IRoomVisitorCallbacks &callbacks)
 {
     for (const auto &room : rooms) {
-        visitRoom(room, roomIndex, textures, callbacks);
+        visitRoom(room, snapshot, textures, callbacks);
     }
 }
 
@@ -380,7 +371,6 @@ struct RoomTex
     }
 
     int priority() const { return deref(tex).getPriority(); }
-    GLuint textureId() const { return deref(tex).textureId(); }
 
     friend bool operator<(const RoomTex &lhs, const RoomTex &rhs)
     {
@@ -470,6 +460,17 @@ struct ColoredRoomTexVector final : public std::vector<ColoredRoomTex>
     }
 };
 
+// Textures packed into the atlas are drawn from it, so they can share a batch.
+NODISCARD static const MMTexture *getBatchTexture(const MMTexture &tex)
+{
+    const SharedMMTexture &atlas = tex.getAtlas();
+    return (atlas != nullptr) ? atlas.get() : &tex;
+}
+
+// NOTE: Every texture has its own priority, so after sorting the rooms that share
+// a texture are adjacent, and the atlas textures have adjacent priorities.
+// This compares the textures themselves rather than their OpenGL ids, since it
+// runs on the mesh worker thread.
 template<typename T, typename Callback>
 static void foreach_texture(const T &textures, Callback &&callback)
 {
@@ -478,11 +479,11 @@ static void foreach_texture(const T &textures, Callback &&callback)
     const auto size = textures.size();
     for (size_t beg = 0, next = size; beg < size; beg = next) {
         const RoomTex &rtex = textures[beg];
-        const auto textureId = rtex.textureId();
+        const MMTexture *const tex = getBatchTexture(deref(rtex.tex));
 
         size_t end = beg + 1;
         for (; end < size; ++end)
-            if (textureId != textures[end].textureId())
+            if (tex != getBatchTexture(deref(textures[end].tex)))
                 break;
 
         next = end;
@@ -491,72 +492,78 @@ static void foreach_texture(const T &textures, Callback &&callback)
     }
 }
 
-static UniqueMeshVector createSortedTexturedMeshes(OpenGL &gl, const RoomTexVector &textures)
+template<typename VertType>
+struct NODISCARD TexturedQuadBatch final
 {
-    if (textures.empty())
-        return UniqueMeshVector{};
+    SharedMMTexture texture;
+    std::vector<VertType> verts;
+    // the texture is MapCanvasTextures::atlas, and the verts carry their cells
+    bool atlas = false;
+    // of the first room's texture, so it increases from batch to batch
+    int priority = -1;
+};
+using TexturedQuadBatches = std::vector<TexturedQuadBatch<RoomQuadVert>>;
+using ColoredTexturedQuadBatches = std::vector<TexturedQuadBatch<ColoredRoomQuadVert>>;
 
-    const size_t numUniqueTextures = [&textures]() -> size_t {
-        size_t texCount = 0;
-        ::foreach_texture(textures,
-                          [&texCount](size_t /* beg */, size_t /*end*/) -> void { ++texCount; });
-        return texCount;
-    }();
+// The quads are relative to the origin, which must be within 255 rooms of them;
+// see RoomQuadVert.
+static TexturedQuadBatches createSortedTexturedQuads(const RoomTexVector &textures,
+                                                     const glm::ivec2 &origin)
+{
+    TexturedQuadBatches result;
+    if (textures.empty())
+        return result;
 
-    std::vector<UniqueMesh> result_meshes;
-    result_meshes.reserve(numUniqueTextures);
-    const auto lambda = [&gl, &result_meshes, &textures](const size_t beg,
-                                                         const size_t end) -> void {
+    const auto lambda = [&result, &textures, &origin](const size_t beg, const size_t end) -> void {
         const RoomTex &rtex = textures[beg];
         const size_t count = end - beg;
 
-        std::vector<TexVert> verts;
+        TexturedQuadBatch<RoomQuadVert> &batch = result.emplace_back();
+        const SharedMMTexture &atlas = rtex.tex->getAtlas();
+        batch.atlas = atlas != nullptr;
+        batch.texture = batch.atlas ? atlas : rtex.tex->getShared();
+        batch.priority = rtex.priority();
+        std::vector<RoomQuadVert> &verts = batch.verts;
         verts.reserve(count * VERTS_PER_QUAD); /* quads */
 
         // D-C
         // | |  ccw winding
         // A-B
         for (size_t i = beg; i < end; ++i) {
-            const auto &pos = textures[i].room->getPosition();
-            const auto v0 = pos.to_vec3();
-#define EMIT(x, y) verts.emplace_back(glm::vec2((x), (y)), v0 + glm::vec3((x), (y), 0));
+            const RoomTex &thisVert = textures[i];
+            const auto &pos = thisVert.room->getPosition();
+            const glm::ivec2 room = pos.to_ivec2() - origin;
+            const int cell = batch.atlas ? thisVert.tex->getAtlasCell() : 0;
+#define EMIT(x, y) verts.emplace_back(room, glm::ivec2((x), (y)), cell);
             EMIT(0, 0);
             EMIT(1, 0);
             EMIT(1, 1);
             EMIT(0, 1);
 #undef EMIT
         }
-
-        result_meshes.emplace_back(gl.createTexturedQuadBatch(verts, rtex.tex->getShared()));
     };
 
     ::foreach_texture(textures, lambda);
-    assert(result_meshes.size() == numUniqueTextures);
-    return UniqueMeshVector{std::move(result_meshes)};
+    return result;
 }
 
-static UniqueMeshVector createSortedColoredTexturedMeshes(OpenGL &gl,
-                                                          const ColoredRoomTexVector &textures)
+static ColoredTexturedQuadBatches createSortedColoredTexturedQuads(
+    const ColoredRoomTexVector &textures, const glm::ivec2 &origin)
 {
+    ColoredTexturedQuadBatches result;
     if (textures.empty())
-        return UniqueMeshVector{};
-
-    const size_t numUniqueTextures = [&textures]() -> size_t {
-        size_t texCount = 0;
-        ::foreach_texture(textures,
-                          [&texCount](size_t /* beg */, size_t /*end*/) -> void { ++texCount; });
-        return texCount;
-    }();
-
-    std::vector<UniqueMesh> result_meshes;
-    result_meshes.reserve(numUniqueTextures);
+        return result;
 
-    const auto lambda = [&gl, &result_meshes, &textures](const size_t beg,
-                                                         const size_t end) -> void {
+    const auto lambda = [&result, &textures, &origin](const size_t beg, const size_t end) -> void {
         const RoomTex &rtex = textures[beg];
         const size_t count = end - beg;
 
-        std::vector<ColoredTexVert> verts;
+        // the colored room quad shaders don't read from the atlas
+        assert(rtex.tex->getAtlas() == nullptr);
+        TexturedQuadBatch<ColoredRoomQuadVert> &batch = result.emplace_back();
+        batch.texture = rtex.tex->getShared();
+        batch.priority = rtex.priority();
+        std::vector<ColoredRoomQuadVert> &verts = batch.verts;
         verts.reserve(count * VERTS_PER_QUAD); /* quads */
 
         // D-C
@@ -565,23 +572,53 @@ static UniqueMeshVector createSortedColoredTexturedMeshes(OpenGL &gl,
         for (size_t i = beg; i < end; ++i) {
             const ColoredRoomTex &thisVert = textures[i];
             const auto &pos = thisVert.room->getPosition();
-            const auto v0 = pos.to_vec3();
+            const glm::ivec2 room = pos.to_ivec2() - origin;
             const auto color = thisVert.color;
 
-#define EMIT(x, y) verts.emplace_back(color, glm::vec2((x), (y)), v0 + glm::vec3((x), (y), 0));
+#define EMIT(x, y) verts.emplace_back(color, room, glm::ivec2((x), (y)));
             EMIT(0, 0);
             EMIT(1, 0);
             EMIT(1, 1);
             EMIT(0, 1);
 #undef EMIT
         }
-
-        result_meshes.emplace_back(gl.createColoredTexturedQuadBatch(verts, rtex.tex->getShared()));
     };
 
     ::foreach_texture(textures, lambda);
-    assert(result_meshes.size() == numUniqueTextures);
-    return UniqueMeshVector{std::move(result_meshes)};
+    return result;
+}
+
+static UniqueMeshVector createTexturedMeshes(OpenGL &gl,
+                                             const TexturedQuadBatches &batches,
+                                             const glm::vec3 &origin)
+{
+    std::vector<UniqueMesh> result_meshes;
+    std::vector<int> sortKeys;
+    result_meshes.reserve(batches.size());
+    sortKeys.reserve(batches.size());
+    for (const auto &batch : batches) {
+        result_meshes.emplace_back(
+            batch.atlas ? gl.createAtlasRoomQuadBatch(batch.verts, origin, batch.texture)
+                        : gl.createRoomQuadBatch(batch.verts, origin, batch.texture));
+        sortKeys.emplace_back(batch.priority);
+    }
+    return UniqueMeshVector{std::move(result_meshes), std::move(sortKeys)};
+}
+
+static UniqueMeshVector createColoredTexturedMeshes(OpenGL &gl,
+                                                    const ColoredTexturedQuadBatches &batches,
+                                                    const glm::vec3 &origin)
+{
+    std::vector<UniqueMesh> result_meshes;
+    std::vector<int> sortKeys;
+    result_meshes.reserve(batches.size());
+    sortKeys.reserve(batches.size());
+    for (const auto &batch : batches) {
+        result_meshes.emplace_back(
+            gl.createColoredRoomQuadBatch(batch.verts, origin, batch.texture));
+        sortKeys.emplace_back(batch.priority);
+    }
+    return UniqueMeshVector{std::move(result_meshes), std::move(sortKeys)};
 }
 
 struct LayerBatchMeasurements final
@@ -686,7 +723,82 @@ LayerBatchMeasurer::~LayerBatchMeasurer() = default;
 
 using ColoredLineBatch = std::vector<ColorVert>;
 using ColoredQuadBatch = std::vector<ColorVert>;
-using PlainQuadBatch = std::vector<glm::vec3>;
+using PlainQuadBatch = std::vector<RoomQuadVert>;
+
+// The quads are relative to the origin; see RoomQuadVert.
+static void emitPlainQuad(PlainQuadBatch &verts, const Room *const room, const glm::ivec2 &origin)
+{
+    const glm::ivec2 pos = room->getPosition().to_ivec2() - origin;
+#define EMIT(x, y) verts.emplace_back(pos, glm::ivec2((x), (y)), 0);
+    EMIT(0, 0);
+    EMIT(1, 0);
+    EMIT(1, 1);
+    EMIT(0, 1);
+#undef EMIT
+}
+
+// The vertices of LayerMeshes, built without touching OpenGL.
+struct NODISCARD LayerMeshesData final
+{
+    // The room quads are relative to this.
+    glm::ivec3 origin{0};
+    TexturedQuadBatches terrain;
+    RoomTintArray<PlainQuadBatch> tints;
+    TexturedQuadBatches overlays;
+    ColoredTexturedQuadBatches doors;
+    ColoredTexturedQuadBatches walls;
+    ColoredTexturedQuadBatches dottedWalls;
+    ColoredTexturedQuadBatches upDownExits;
+    ColoredTexturedQuadBatches streamIns;
+    ColoredTexturedQuadBatches streamOuts;
+    PlainQuadBatch layerBoost;
+    // One pixel per room, in the average color of its terrain; see LevelOfDetailEnum::LOW.
+    QImage lowDetail;
+
+    LayerMeshes getMeshes(OpenGL &gl) const
+    {
+        const glm::vec3 o{origin};
+        LayerMeshes meshes;
+        meshes.terrain = ::createTexturedMeshes(gl, terrain, o);
+        for (const auto tint : ALL_ROOM_TINTS) {
+            meshes.tints[tint] = gl.createPlainRoomQuadBatch(tints[tint], o);
+        }
+        meshes.overlays = ::createTexturedMeshes(gl, overlays, o);
+        meshes.doors = ::createColoredTexturedMeshes(gl, doors, o);
+        meshes.walls = ::createColoredTexturedMeshes(gl, walls, o);
+        meshes.dottedWalls = ::createColoredTexturedMeshes(gl, dottedWalls, o);
+        meshes.upDownExits = ::createColoredTexturedMeshes(gl, upDownExits, o);
+        meshes.streamIns = ::createColoredTexturedMeshes(gl, streamIns, o);
+        meshes.streamOuts = ::createColoredTexturedMeshes(gl, streamOuts, o);
+        meshes.layerBoost = gl.createPlainRoomQuadBatch(layerBoost, o);
+        meshes.lowDetail = createLowDetailMesh(gl);
+        meshes.isValid = true;
+        return meshes;
+    }
+
+private:
+    UniqueMesh createLowDetailMesh(OpenGL &gl) const
+    {
+        const QImage &image = lowDetail;
+        auto texture = MMTexture::alloc(
+            QOpenGLTexture::Target::Target2D,
+            [&image](QOpenGLTexture &tex) -> void {
+                tex.setData(image);
+                tex.setWrapMode(QOpenGLTexture::WrapMode::ClampToEdge);
+                tex.setMinMagFilters(QOpenGLTexture::Filter::LinearMipMapLinear,
+                                     QOpenGLTexture::Filter::Nearest);
+            },
+            true);
+
+        const glm::vec3 lo{origin};
+        const glm::vec3 hi = lo + glm::vec3{MapTileId::SIZE, MapTileId::SIZE, 0};
+        const std::vector<TexVert> verts{TexVert{glm::vec2{0, 0}, lo},
+                                         TexVert{glm::vec2{1, 0}, glm::vec3{hi.x, lo.y, lo.z}},
+                                         TexVert{glm::vec2{1, 1}, hi},
+                                         TexVert{glm::vec2{0, 1}, glm::vec3{lo.x, hi.y, lo.z}}};
+        return gl.createTexturedQuadBatch(verts, texture);
+    }
+};
 
 struct LayerBatchData final
 {
@@ -700,8 +812,8 @@ struct LayerBatchData final
     ColoredRoomTexVector roomUpDownExits;
     ColoredRoomTexVector streamIns;
     ColoredRoomTexVector streamOuts;
-    RoomTintArray<PlainQuadBatch> roomTints;
-    PlainQuadBatch roomLayerBoostQuads;
+    // the layer boost covers every room with a terrain
+    RoomTintArray<RoomVector> roomTints;
 
     explicit LayerBatchData(const LayerBatchMeasurements &measurements)
     {
@@ -714,9 +826,8 @@ struct LayerBatchData final
         streamIns.reserve(measurements.numStreamIns);
         streamOuts.reserve(measurements.numStreamOuts);
         for (const auto tint : ALL_ROOM_TINTS) {
-            roomTints[tint].reserve(measurements.numTints[tint] * VERTS_PER_QUAD);
+            roomTints[tint].reserve(measurements.numTints[tint]);
         }
-        roomLayerBoostQuads.reserve(VERTS_PER_QUAD * measurements.numTerrains);
     }
 
     void verifyCounts(const LayerBatchMeasurements &measurements)
@@ -731,9 +842,8 @@ struct LayerBatchData final
             assert(streamIns.size() == measurements.numStreamIns);
             assert(streamOuts.size() == measurements.numStreamOuts);
             for (const auto tint : ALL_ROOM_TINTS) {
-                assert(roomTints[tint].size() == measurements.numTints[tint] * VERTS_PER_QUAD);
+                assert(roomTints[tint].size() == measurements.numTints[tint]);
             }
-            assert(roomLayerBoostQuads.size() == VERTS_PER_QUAD * measurements.numTerrains);
         }
     }
 
@@ -757,23 +867,45 @@ struct LayerBatchData final
         streamOuts.sortByTexture();
     }
 
-    LayerMeshes getMeshes(OpenGL &gl)
+    LayerMeshesData takeMeshesData(const glm::ivec3 &origin)
     {
-        LayerMeshes meshes;
-        meshes.terrain = ::createSortedTexturedMeshes(gl, roomTerrains);
+        const glm::ivec2 o{origin};
+        LayerMeshesData result;
+        result.origin = origin;
+        result.terrain = ::createSortedTexturedQuads(roomTerrains, o);
         for (const auto tint : ALL_ROOM_TINTS) {
-            meshes.tints[tint] = gl.createPlainQuadBatch(roomTints[tint]);
+            PlainQuadBatch &verts = result.tints[tint];
+            verts.reserve(roomTints[tint].size() * VERTS_PER_QUAD);
+            for (const Room *const room : roomTints[tint])
+                ::emitPlainQuad(verts, room, o);
         }
-        meshes.overlays = ::createSortedTexturedMeshes(gl, roomOverlays);
-        meshes.doors = ::createSortedColoredTexturedMeshes(gl, doors);
-        meshes.walls = ::createSortedColoredTexturedMeshes(gl, solidWallLines);
-        meshes.dottedWalls = ::createSortedColoredTexturedMeshes(gl, dottedWallLines);
-        meshes.upDownExits = ::createSortedColoredTexturedMeshes(gl, roomUpDownExits);
-        meshes.streamIns = ::createSortedColoredTexturedMeshes(gl, streamIns);
-        meshes.streamOuts = ::createSortedColoredTexturedMeshes(gl, streamOuts);
-        meshes.layerBoost = gl.createPlainQuadBatch(roomLayerBoostQuads);
-        meshes.isValid = true;
-        return meshes;
+        result.overlays = ::createSortedTexturedQuads(roomOverlays, o);
+        result.doors = ::createSortedColoredTexturedQuads(doors, o);
+        result.walls = ::createSortedColoredTexturedQuads(solidWallLines, o);
+        result.dottedWalls = ::createSortedColoredTexturedQuads(dottedWallLines, o);
+        result.upDownExits = ::createSortedColoredTexturedQuads(roomUpDownExits, o);
+        result.streamIns = ::createSortedColoredTexturedQuads(streamIns, o);
+        result.streamOuts = ::createSortedColoredTexturedQuads(streamOuts, o);
+        result.layerBoost.reserve(roomTerrains.size() * VERTS_PER_QUAD);
+        for (const RoomTex &rtex : roomTerrains)
+            ::emitPlainQuad(result.layerBoost, rtex.room, o);
+        result.lowDetail = createLowDetailImage(o);
+        return result;
+    }
+
+private:
+    // Texture row 0 is the southmost row of rooms, so the image isn't mirrored.
+    QImage createLowDetailImage(const glm::ivec2 &origin) const
+    {
+        QImage image{MapTileId::SIZE, MapTileId::SIZE, QImage::Format::Format_RGBA8888};
+        image.fill(QColor::fromRgbF(0.0, 0.0, 0.0, 0.0));
+        for (const RoomTex &rtex : roomTerrains) {
+            const glm::ivec2 pos = rtex.room->getPosition().to_ivec2() - origin;
+            assert(isClamped(pos.x, 0, MapTileId::SIZE - 1));
+            assert(isClamped(pos.y, 0, MapTileId::SIZE - 1));
+            image.setPixelColor(pos.x, pos.y, rtex.tex->getAverageColor().getQColor());
+        }
+        return image;
     }
 };
 
@@ -808,14 +940,6 @@ class LayerBatchBuilder final : public IRoomVisitorCallbacks
             return;
 
         data.roomTerrains.emplace_back(room, terrain);
-
-        const auto v0 = room->getPosition().to_vec3();
-#define EMIT(x, y) data.roomLayerBoostQuads.emplace_back(v0 + glm::vec3((x), (y), 0));
-        EMIT(0, 0);
-        EMIT(1, 0);
-        EMIT(1, 1);
-        EMIT(0, 1);
-#undef EMIT
     }
 
     void visitOverlayTexture(const Room *const room, MMTexture *const overlay) override
@@ -826,13 +950,7 @@ class LayerBatchBuilder final : public IRoomVisitorCallbacks
 
     void visitNamedColorTint(const Room *const room, const RoomTintEnum tint) override
     {
-        const auto v0 = room->getPosition().to_vec3();
-#define EMIT(x, y) data.roomTints[tint].emplace_back(v0 + glm::vec3((x), (y), 0));
-        EMIT(0, 0);
-        EMIT(1, 0);
-        EMIT(1, 1);
-        EMIT(0, 1);
-#undef EMIT
+        data.roomTints[tint].emplace_back(room);
     }
 
     void visitWall(const Room *const room,
@@ -904,84 +1022,457 @@ class LayerBatchBuilder final : public IRoomVisitorCallbacks
 
 LayerBatchBuilder::~LayerBatchBuilder() = default;
 
-static LayerMeshes generateLayerMeshes(OpenGL &gl,
-                                       const RoomVector &rooms,
-                                       const RoomIndex &roomIndex,
-                                       const MapCanvasTextures &textures,
-                                       const OptBounds &bounds)
+static LayerMeshesData generateLayerMeshesData(const MapTileId &tile,
+                                               const RoomVector &rooms,
+                                               const MapSnapshot &snapshot,
+                                               const MapCanvasTextures &textures,
+                                               const OptBounds &bounds)
 {
     const LayerBatchMeasurements measurements =
-        [&bounds, &rooms, &roomIndex, &textures]() -> LayerBatchMeasurements {
+        [&bounds, &rooms, &snapshot, &textures]() -> LayerBatchMeasurements {
         LayerBatchMeasurements result;
         LayerBatchMeasurer measurer{result, bounds};
-        visitRooms(rooms, roomIndex, textures, measurer);
+        visitRooms(rooms, snapshot, textures, measurer);
         return result;
     }();
 
     LayerBatchData data{measurements};
     LayerBatchBuilder builder{data, textures, bounds};
-    visitRooms(rooms, roomIndex, textures, builder);
+    visitRooms(rooms, snapshot, textures, builder);
 
     if constexpr (IS_DEBUG_BUILD) {
         data.verifyCounts(measurements);
     }
 
     data.sort();
-    return data.getMeshes(gl);
+    return data.takeMeshesData(tile.getMin().to_ivec3());
 }
 
-static void generateAllLayerMeshes(MapBatches &batches,
-                                   OpenGL &gl,
-                                   GLFont &font,
-                                   const LayerToRooms &layerToRooms,
-                                   const RoomIndex &roomIndex,
-                                   const MapCanvasTextures &textures,
-                                   const OptBounds &bounds)
+struct NODISCARD MapTileData final
 {
-    auto &batchedMeshes = batches.batchedMeshes;
-    auto &connectionDrawerBuffers = batches.connectionDrawerBuffers;
-    auto &roomNameBatches = batches.roomNameBatches;
-    auto &connectionMeshes = batches.connectionMeshes;
-
-    for (const auto &layer : layerToRooms) {
-        const int thisLayer = layer.first;
-        auto &layerMeshes = batchedMeshes[thisLayer];
-        auto &layerRoomNames = roomNameBatches[thisLayer];
-        auto &layerConnections = connectionMeshes[thisLayer];
-        auto &rooms = layer.second;
-
-        layerMeshes = ::generateLayerMeshes(gl, rooms, roomIndex, textures, bounds);
-
-        {
-            auto &cdb = connectionDrawerBuffers[thisLayer];
-            cdb.clear();
-
-            const auto currentLayer = thisLayer;
-
-            RoomNameBatch rnb;
-            ConnectionDrawer cd{cdb, rnb, currentLayer, bounds};
-            {
-                // pass 1: measurements
-                for (const auto &room : rooms) {
-                    cd.drawRoomConnectionsAndDoors(room, roomIndex);
-                }
-                cd.endMeasurements();
+    LayerMeshesData meshes;
+    ConnectionDrawerBuffers connections;
+    RoomNameBatch roomNames;
+    MapTileBox box;
+
+    MapTileData() = default;
+    ~MapTileData() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(MapTileData);
+};
 
-                // pass 2: add to buffers
-                for (const auto &room : rooms) {
-                    cd.drawRoomConnectionsAndDoors(room, roomIndex);
-                }
-                cd.verify();
+MapBatchesData::MapBatchesData() = default;
+MapBatchesData::~MapBatchesData() = default;
+
+static std::unique_ptr<MapTileData> generateTileData(const MapTileId &tile,
+                                                     const RoomVector &rooms,
+                                                     const MapSnapshot &snapshot,
+                                                     const MapCanvasTextures &textures,
+                                                     const OptBounds &bounds,
+                                                     ConnectionShapeCache &shapes)
+{
+    auto result = std::make_unique<MapTileData>();
+    result->meshes = ::generateLayerMeshesData(tile, rooms, snapshot, textures, bounds);
+
+    ConnectionDrawer cd{shapes, result->connections, result->roomNames, tile.z, bounds};
+    for (const auto &room : rooms) {
+        cd.drawRoomConnectionsAndDoors(room, snapshot);
+    }
+
+    // The rooms are inside the tile, but connections can leave it.
+    MapTileBox &box = result->box;
+    box.min = tile.getMin().to_vec3();
+    box.max = tile.getMax().to_vec3() + glm::vec3{1.f, 1.f, 0.f};
+    for (const ConnectionDrawerColorBuffer *const buffer :
+         {&result->connections.normal, &result->connections.red}) {
+        for (const ColorSegment &segment : buffer->segments) {
+            box.include(segment.from);
+            box.include(segment.to);
+        }
+        for (const ColorVert &v : buffer->triVerts)
+            box.include(v.vert);
+    }
+    // Room shapes and up/down exits are drawn slightly above and below the layer.
+    box = box.grownBy(glm::vec3{0.5f});
+    return result;
+}
+
+// Room names are only laid out here, since the font belongs to the OpenGL thread.
+static MapTileBatches uploadTileBatches(OpenGL &gl, GLFont &font, MapTileData &data)
+{
+    MapTileBatches result;
+    result.meshes = data.meshes.getMeshes(gl);
+    result.connectionMeshes = data.connections.getMeshes(gl, glm::vec3{data.meshes.origin});
+    result.roomNames = data.roomNames.getMeshes(font, gl.getDevicePixelRatio());
+    result.box = data.box;
+    return result;
+}
+
+static bool intersects(const OptBounds &bounds, const MapTileId &tile)
+{
+    if (!bounds.isRestricted())
+        return true;
+    const Bounds &b = bounds.getBounds();
+    const Coordinate lo = tile.getMin();
+    const Coordinate hi = tile.getMax();
+    return lo.x <= b.max.x && b.min.x <= hi.x     //
+           && lo.y <= b.max.y && b.min.y <= hi.y  //
+           && b.min.z <= tile.z && tile.z <= b.max.z;
+}
+
+// Returns false if the build was cancelled.
+//
+// The tiles don't share anything but the shape cache, so they're built on the
+// thread pool; each chunk of tiles has its own cache.
+static bool generateTiles(MapBatchesData &result,
+                          const TileToRooms &tiles,
+                          const MapSnapshot &snapshot,
+                          const MapCanvasTextures &textures,
+                          const OptBounds &bounds,
+                          const std::function<bool()> &isCancelled)
+{
+    static constexpr const size_t TILES_PER_CHUNK = 4;
+
+    std::vector<const TileToRooms::value_type *> work;
+    work.reserve(tiles.size());
+    for (const auto &entry : tiles) {
+        const MapTileId &tile = entry.first;
+        const RoomVector &rooms = entry.second;
+        // Tiles without rooms are still reported, so they get removed.
+        static_cast<void>(result.tiles[tile]);
+        if (rooms.empty())
+            continue;
+
+        for (const Room *const room : rooms) {
+            result.roomTiles.emplace_back(room->getId(), tile);
+        }
+        work.emplace_back(&entry);
+    }
+
+    std::vector<std::unique_ptr<MapTileData>> built(work.size());
+    std::atomic<bool> cancelled{false};
+    parallelFor(work.size(), TILES_PER_CHUNK, [&](const size_t begin, const size_t end) {
+        ConnectionShapeCache shapes;
+        for (size_t i = begin; i < end; ++i) {
+            if (cancelled.load(std::memory_order_relaxed))
+                return;
+            if (isCancelled && isCancelled()) {
+                cancelled.store(true, std::memory_order_relaxed);
+                return;
             }
 
-            layerRoomNames = rnb.getMesh(font);
-            layerConnections = cdb.getMeshes(gl);
+            const MapTileId &tile = work[i]->first;
+            const RoomVector &rooms = work[i]->second;
+            built[i] = generateTileData(tile, rooms, snapshot, textures, bounds, shapes);
         }
+    });
+    if (cancelled.load())
+        return false;
+
+    for (size_t i = 0; i < work.size(); ++i) {
+        result.tiles[work[i]->first] = std::move(built[i]);
+    }
+    return true;
+}
+
+SharedMapBatchesData MapCanvasRoomDrawer::buildBatches(const MapSnapshot &snapshot,
+                                                       const MapCanvasTextures &textures,
+                                                       const OptBounds &bounds,
+                                                       const std::function<bool()> &isCancelled)
+{
+    // Tiles entirely outside the bounds would be empty.
+    TileToRooms tiles;
+    snapshot.forEach([&tiles, &bounds](const Room &room) {
+        const MapTileId tile = MapTileId::of(room.getPosition());
+        if (intersects(bounds, tile))
+            tiles[tile].emplace_back(&room);
+    });
+
+    auto result = std::make_shared<MapBatchesData>();
+    result->replaceAll = true;
+    result->bounds = bounds;
+    if (!generateTiles(*result, tiles, snapshot, textures, bounds, isCancelled))
+        return nullptr;
+    return result;
+}
+
+SharedMapBatchesData MapCanvasRoomDrawer::buildTiles(const MapSnapshot &snapshot,
+                                                     const MapCanvasTextures &textures,
+                                                     const OptBounds &bounds,
+                                                     const std::set<MapTileId> &dirtyTiles,
+                                                     const std::function<bool()> &isCancelled)
+{
+    // Tiles that end up without rooms are removed.
+    TileToRooms tiles;
+    for (const MapTileId &tile : dirtyTiles) {
+        static_cast<void>(tiles[tile]);
+    }
+    snapshot.forEach([&tiles](const Room &room) {
+        const auto it = tiles.find(MapTileId::of(room.getPosition()));
+        if (it != tiles.end())
+            it->second.emplace_back(&room);
+    });
+
+    auto result = std::make_shared<MapBatchesData>();
+    if (!generateTiles(*result, tiles, snapshot, textures, bounds, isCancelled))
+        return nullptr;
+    return result;
+}
+
+std::set<MapTileId> MapCanvasRoomDrawer::takeDirtyTiles(const RoomIdSet &changed,
+                                                        const MapSnapshot &snapshot)
+{
+    MapBatches &batches = m_batches.value();
+    std::set<MapTileId> result;
+    const auto addTile = [&result, &batches](const MapTileId &tile) {
+        if (intersects(batches.bounds, tile))
+            result.insert(tile);
+    };
+
+    for (const RoomId id : changed) {
+        const auto index = static_cast<size_t>(id.asUint32());
+        if (index < batches.roomTiles.size()) {
+            if (const std::optional<MapTileId> old = std::exchange(batches.roomTiles[index],
+                                                                   std::nullopt))
+                addTile(old.value());
+        }
+
+        const Room *const room = snapshot.getRoom(id);
+        if (room == nullptr)
+            continue;
+        addTile(MapTileId::of(room->getPosition()));
+
+        // Walls, doors and connection lines also depend on the room at the
+        // other end of each exit.
+        for (const Exit &exit : room->getExitsList()) {
+            for (const RoomId to : exit.outRange()) {
+                if (const Room *const other = snapshot.getRoom(to))
+                    addTile(MapTileId::of(other->getPosition()));
+            }
+            for (const RoomId from : exit.inRange()) {
+                if (const Room *const other = snapshot.getRoom(from))
+                    addTile(MapTileId::of(other->getPosition()));
+            }
+        }
+    }
+    return result;
+}
+
+void MapCanvasRoomDrawer::renderBatches(MapBatches &batches,
+                                        const MapCanvasViewport &viewport,
+                                        const FrameQuality &quality,
+                                        OpenGL &gl)
+{
+    const Configuration::CanvasSettings &settings = getConfig().canvas;
+
+    const float totalScaleFactor = viewport.getTotalScaleFactor();
+    const auto wantExtraDetail = totalScaleFactor >= settings.extraDetailScaleCutoff;
+    const auto wantDoorNames = settings.drawDoorNames && quality.doorNames
+                               && (totalScaleFactor >= settings.doorNameScaleCutoff);
+    const auto lod = [&settings, totalScaleFactor, wantExtraDetail]() -> LevelOfDetailEnum {
+        if (wantExtraDetail)
+            return LevelOfDetailEnum::FULL;
+        if (totalScaleFactor >= settings.lowDetailScaleCutoff)
+            return LevelOfDetailEnum::MEDIUM;
+        return LevelOfDetailEnum::LOW;
+    }();
+
+    const int labelLevel = LabelPlacement::getLevel(totalScaleFactor);
+
+    const auto drawLayer = [&viewport,
+                            &batches,
+                            &quality,
+                            wantExtraDetail,
+                            wantDoorNames,
+                            lod,
+                            labelLevel](const int thisLayer, const int currentLayer) {
+        if (!quality.isLayerDrawn(thisLayer, currentLayer))
+            return;
+        const auto it_layer = batches.layers.find(thisLayer);
+        if (it_layer == batches.layers.end())
+            return;
+        MapLayerTiles &tiles = it_layer->second;
+
+        // Only the tiles in the view frustum are drawn.
+        std::vector<MapTileBatches *> visibleTiles;
+        std::vector<LayerMeshes *> visibleMeshes;
+        std::vector<MapTileBatches *> visibleNames;
+
+        // The text of a door name can extend past its tile, but only by
+        // a few rooms at the zoom levels where they're drawn.
+        static const glm::vec3 NAME_MARGIN{MapTileId::SIZE / 2, MapTileId::SIZE / 2, 0};
+        const bool wantNames = wantExtraDetail && wantDoorNames && thisLayer == currentLayer;
+
+        for (auto &tile : tiles) {
+            MapTileBatches &batch = tile.second;
+            if (viewport.isBoxVisible(batch.box.min, batch.box.max)) {
+                visibleTiles.emplace_back(&batch);
+                visibleMeshes.emplace_back(&batch.meshes);
+            }
+            if (wantNames) {
+                const MapTileBox namesBox = batch.box.grownBy(NAME_MARGIN);
+                if (viewport.isBoxVisible(namesBox.min, namesBox.max))
+                    visibleNames.emplace_back(&batch);
+            }
+        }
+
+        LayerMeshes::render(visibleMeshes, thisLayer, currentLayer, lod);
+
+        if (wantExtraDetail) {
+            for (MapTileBatches *const tile : visibleTiles) {
+                tile->connectionMeshes.render(thisLayer, currentLayer);
+            }
+
+            // NOTE: This can display room names in lower layers, but the text
+            // isn't currently drawn with an appropriate Z-offset, so it doesn't
+            // stay aligned to its actual layer when you switch view layers.
+            for (MapTileBatches *const tile : visibleNames) {
+                tile->roomNames.render(labelLevel);
+            }
+        }
+    };
+
+    const auto fadeBackground = [&gl, &settings]() {
+        auto bgColor = Color{settings.backgroundColor.getColor(), 0.5f};
+
+        const auto blendedWithBackground
+            = GLRenderState().withBlend(BlendModeEnum::TRANSPARENCY).withColor(bgColor);
+
+        gl.renderPlainFullScreenQuad(blendedWithBackground);
+    };
+
+    const int currentLayer = viewport.m_currentLayer;
+    if (batches.layers.find(currentLayer) == batches.layers.end()) {
+        // Nothing to fade the other layers behind.
+        for (const auto &layer : batches.layers) {
+            drawLayer(layer.first, currentLayer);
+        }
+        return;
+    }
+
+    const auto drawLowerLayers = [&batches, &drawLayer, &fadeBackground, &gl, currentLayer]() {
+        for (const auto &layer : batches.layers) {
+            if (layer.first >= currentLayer)
+                break;
+            drawLayer(layer.first, currentLayer);
+        }
+        gl.clearDepth();
+        fadeBackground();
+    };
+
+    // The layers below only change with the view, so they're drawn into a texture once.
+    const LayerTextureCache::Key key{viewport.m_viewProj,
+                                     gl.getPhysicalViewport().size,
+                                     currentLayer,
+                                     lod,
+                                     wantExtraDetail,
+                                     Color{settings.backgroundColor},
+                                     quality.maxLayerDistance};
+    LayerTextureCache &cache = batches.lowerLayers;
+    if (!cache.isCurrent(key) && cache.begin(key)) {
+        gl.clear(key.background);
+        drawLowerLayers();
+        gl.resetBindings();
+        cache.end(key);
+    }
+    if (cache.isCurrent(key)) {
+        cache.composite(gl);
+        gl.clearDepth();
+    } else {
+        drawLowerLayers();
+    }
+
+    for (auto it = batches.layers.find(currentLayer); it != batches.layers.end(); ++it) {
+        drawLayer(it->first, currentLayer);
+    }
+}
+
+void MapCanvasRoomDrawer::applyBatches(MapBatchesData &data)
+{
+    if (data.replaceAll) {
+        m_batches.reset();   // dtor, if necessary
+        m_batches.emplace(); // ctor
+        m_batches->bounds = data.bounds;
+        m_batches->redrawMargin = data.redrawMargin;
+    } else if (!m_batches) {
+        assert(false);
+        return;
+    }
+
+    MapBatches &batches = m_batches.value();
+    batches.lowerLayers.invalidate();
+    for (auto &entry : data.tiles) {
+        const MapTileId &tile = entry.first;
+        const std::unique_ptr<MapTileData> &tileData = entry.second;
+
+        auto it_layer = batches.layers.find(tile.z);
+        if (it_layer != batches.layers.end()) {
+            it_layer->second.erase(tile);
+            if (tileData == nullptr && it_layer->second.empty())
+                batches.layers.erase(it_layer);
+        }
+        if (tileData == nullptr)
+            continue;
+
+        batches.layers[tile.z].emplace(tile,
+                                       uploadTileBatches(getOpenGL(), getFont(), *tileData));
+    }
+
+    for (const auto &roomTile : data.roomTiles) {
+        const auto index = static_cast<size_t>(roomTile.first.asUint32());
+        if (index >= batches.roomTiles.size())
+            batches.roomTiles.resize(index + 1);
+        batches.roomTiles[index] = roomTile.second;
     }
 }
 
-void LayerMeshes::render(const int thisLayer, const int focusedLayer)
+// Draws one kind of mesh for all of the tiles, grouped by sort key (i.e. by texture).
+// Tiles don't overlap, so only the order within each tile matters, and the stable
+// sort keeps it because a tile's keys never decrease.
+static void renderSorted(const std::vector<LayerMeshes *> &tiles,
+                         UniqueMeshVector LayerMeshes::*const member,
+                         const GLRenderState &rs)
 {
+    struct NODISCARD Entry final
+    {
+        int key = 0;
+        UniqueMesh *mesh = nullptr;
+    };
+
+    // only used on the rendering thread
+    static std::vector<Entry> entries;
+    entries.clear();
+    for (LayerMeshes *const tile : tiles) {
+        UniqueMeshVector &meshes = deref(tile).*member;
+        for (size_t i = 0, size = meshes.size(); i < size; ++i)
+            entries.emplace_back(Entry{meshes.getSortKey(i), &meshes.getMesh(i)});
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.key < rhs.key;
+    });
+    for (const Entry &entry : entries)
+        deref(entry.mesh).render(rs);
+}
+
+static void renderAll(const std::vector<LayerMeshes *> &tiles,
+                      UniqueMesh LayerMeshes::*const member,
+                      const GLRenderState &rs)
+{
+    for (LayerMeshes *const tile : tiles)
+        (deref(tile).*member).render(rs);
+}
+
+// Drawing one kind of mesh for every tile before the next kind gives the same
+// image as drawing them tile by tile, but consecutive draws mostly share their
+// program and textures, so the state cache can skip rebinding them.
+void LayerMeshes::render(const std::vector<LayerMeshes *> &tiles,
+                         const int thisLayer,
+                         const int focusedLayer,
+                         const LevelOfDetailEnum lod)
+{
+    if (tiles.empty())
+        return;
+
     bool disableTextures = false;
     if (thisLayer > focusedLayer) {
         if (!getConfig().canvas.drawUpperLayersTextured) {
@@ -1016,9 +1507,11 @@ void LayerMeshes::render(const int thisLayer, const int focusedLayer)
         if (disableTextures) {
             const auto layerWhite = Colors::white.withAlpha((thisLayer <= focusedLayer) ? 0.90f
                                                                                         : 0.20f);
-            layerBoost.render(less_blended.withColor(layerWhite));
+            renderAll(tiles, &LayerMeshes::layerBoost, less_blended.withColor(layerWhite));
+        } else if (lod == LevelOfDetailEnum::LOW) {
+            renderAll(tiles, &LayerMeshes::lowDetail, less_blended.withColor(color));
         } else {
-            terrain.render(less_blended.withColor(color));
+            renderSorted(tiles, &LayerMeshes::terrain, less_blended.withColor(color));
         }
     }
 
@@ -1036,30 +1529,31 @@ void LayerMeshes::render(const int thisLayer, const int focusedLayer)
         }();
 
         if (const auto optColor = getColor(namedColor)) {
-            tints[tint].render(equal_multiplied.withColor(optColor.value()));
+            const GLRenderState tinted = equal_multiplied.withColor(optColor.value());
+            for (LayerMeshes *const tile : tiles)
+                deref(tile).tints[tint].render(tinted);
         } else {
             assert(false);
         }
     }
 
-    if (!disableTextures) {
+    if (!disableTextures && lod != LevelOfDetailEnum::LOW) {
         // streams go under everything else, including trails
-        streamIns.render(lequal_blended.withColor(color));
-        streamOuts.render(lequal_blended.withColor(color));
+        renderSorted(tiles, &LayerMeshes::streamIns, lequal_blended.withColor(color));
+        renderSorted(tiles, &LayerMeshes::streamOuts, lequal_blended.withColor(color));
 
-        overlays.render(equal_blended.withColor(color));
+        renderSorted(tiles, &LayerMeshes::overlays, equal_blended.withColor(color));
     }
 
-    // always
-    {
+    if (lod == LevelOfDetailEnum::FULL) {
         // doors and walls are considered lines, even though they're drawn with textures.
-        upDownExits.render(equal_blended.withColor(color));
+        renderSorted(tiles, &LayerMeshes::upDownExits, equal_blended.withColor(color));
 
         // Doors are drawn on top of the up-down exits
-        doors.render(lequal_blended.withColor(color));
+        renderSorted(tiles, &LayerMeshes::doors, lequal_blended.withColor(color));
         // and walls are drawn on top of doors.
-        walls.render(lequal_blended.withColor(color));
-        dottedWalls.render(lequal_blended.withColor(color));
+        renderSorted(tiles, &LayerMeshes::walls, lequal_blended.withColor(color));
+        renderSorted(tiles, &LayerMeshes::dottedWalls, lequal_blended.withColor(color));
     }
 
     if (thisLayer != focusedLayer) {
@@ -1071,6 +1565,8 @@ void LayerMeshes::render(const int thisLayer, const int focusedLayer)
                          1.f);
         const Color &baseColor = (thisLayer < focusedLayer || disableTextures) ? Colors::black
                                                                                : Colors::white;
-        layerBoost.render(equal_blended.withColor(baseColor.withAlpha(alpha)));
+        renderAll(tiles,
+                  &LayerMeshes::layerBoost,
+                  equal_blended.withColor(baseColor.withAlpha(alpha)));
     }
 }
@@ -5,9 +5,14 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <functional>
 #include <map>
+#include <memory>
 #include <optional>
+#include <set>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 #include <QColor>
 #include <QtCore>
@@ -19,28 +24,127 @@
 #include "../mapdata/ExitDirection.h"
 #include "../mapdata/infomark.h"
 #include "../opengl/Font.h"
+#include "Characters.h"
 #include "Connections.h"
+#include "FrameBudget.h"
 #include "Infomarks.h"
+#include "LayerTextureCache.h"
 #include "MapCanvasData.h"
 #include "RoadIndex.h"
 
 class InfoMark;
 class MapCanvasRoomDrawer;
+class MapSnapshot;
 struct MapCanvasTextures;
 class OpenGL;
 class QOpenGLTexture;
 class Room;
 
 using RoomVector = std::vector<const Room *>;
-using LayerToRooms = std::map<int, RoomVector>;
+
+/// A square of MapTileId::SIZE x MapTileId::SIZE rooms on one layer.
+///
+/// The map is meshed tile by tile, so a modified room only rebuilds the tiles
+/// of the rooms it touches instead of every layer.
+struct NODISCARD MapTileId final
+{
+    static constexpr const int SIZE_BITS = 5;
+    static constexpr const int SIZE = 1 << SIZE_BITS;
+
+    int z = 0;
+    int y = 0;
+    int x = 0;
+
+    NODISCARD static MapTileId of(const Coordinate &c)
+    {
+        return MapTileId{c.z, c.y >> SIZE_BITS, c.x >> SIZE_BITS};
+    }
+    NODISCARD Coordinate getMin() const { return Coordinate{x * SIZE, y * SIZE, z}; }
+    NODISCARD Coordinate getMax() const
+    {
+        return Coordinate{x * SIZE + SIZE - 1, y * SIZE + SIZE - 1, z};
+    }
+
+    NODISCARD bool operator<(const MapTileId &rhs) const
+    {
+        return std::tie(z, y, x) < std::tie(rhs.z, rhs.y, rhs.x);
+    }
+    NODISCARD bool operator==(const MapTileId &rhs) const
+    {
+        return z == rhs.z && y == rhs.y && x == rhs.x;
+    }
+};
+
+/// World-space box around everything a tile draws, except for the extent of its
+/// room names' text, which depends on the zoom.
+struct NODISCARD MapTileBox final
+{
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+
+    void include(const glm::vec3 &v)
+    {
+        min = glm::min(min, v);
+        max = glm::max(max, v);
+    }
+    NODISCARD MapTileBox grownBy(const glm::vec3 &margin) const
+    {
+        return MapTileBox{min - margin, max + margin};
+    }
+};
+
+struct NODISCARD MapTileBatches final
+{
+    LayerMeshes meshes;
+    ConnectionMeshes connectionMeshes;
+    RoomNameMeshes roomNames;
+    MapTileBox box;
+
+    MapTileBatches() = default;
+    DEFAULT_MOVES_DELETE_COPIES(MapTileBatches);
+    ~MapTileBatches() = default;
+};
+
+using MapLayerTiles = std::map<MapTileId, MapTileBatches>;
+using TileToRooms = std::map<MapTileId, RoomVector>;
+
+// The vertices of one tile, waiting to be uploaded; defined in MapCanvasRoomDrawer.cpp.
+struct MapTileData;
+
+/// The meshes of some tiles (or the whole map) before they're uploaded.
+///
+/// Building this only reads a MapSnapshot and the textures, so it can be done on
+/// a worker thread while the previous MapBatches are still being drawn; only
+/// MapCanvasRoomDrawer::applyBatches() needs the OpenGL context.
+struct NODISCARD MapBatchesData final
+{
+    // A tile without data is removed.
+    std::map<MapTileId, std::unique_ptr<MapTileData>> tiles;
+    // The tile of every room in the tiles above.
+    std::vector<std::pair<RoomId, MapTileId>> roomTiles;
+    // Replaces every existing tile, bounds, and margin instead of just these tiles.
+    bool replaceAll = false;
+    OptBounds bounds;
+    OptBounds redrawMargin;
+
+    MapBatchesData();
+    ~MapBatchesData();
+    DELETE_CTORS_AND_ASSIGN_OPS(MapBatchesData);
+};
+using SharedMapBatchesData = std::shared_ptr<MapBatchesData>;
 
 struct NODISCARD MapBatches final
 {
-    BatchedMeshes batchedMeshes;
-    BatchedConnections connectionDrawerBuffers;
-    BatchedConnectionMeshes connectionMeshes;
-    BatchedRoomNames roomNameBatches;
+    // This must be ordered so we can iterate over the layers from lowest to highest.
+    std::map<int, MapLayerTiles> layers;
+    // The tile each room was last meshed in, indexed by RoomId, so a room that
+    // moved or was removed also rebuilds the tile it left.
+    std::vector<std::optional<MapTileId>> roomTiles;
+    // The bounds the tiles were built for.
+    OptBounds bounds;
     OptBounds redrawMargin;
+    // The layers below the current one, as they were last drawn.
+    LayerTextureCache lowerLayers;
 
     MapBatches() = default;
     ~MapBatches() = default;
@@ -50,7 +154,14 @@ struct NODISCARD MapBatches final
 struct NODISCARD Batches final
 {
     std::optional<MapBatches> mapBatches;
-    std::optional<BatchedInfomarksMeshes> infomarksMeshes;
+    std::optional<TiledInfomarksMeshes> infomarksMeshes;
+    // The selection overlays only change with the selection or the map, so they're
+    // kept until then; see MapCanvas::paintSelectedRooms() and paintSelectedInfoMarks().
+    std::optional<std::vector<UniqueMesh>> selectedRoomMeshes;
+    std::optional<BatchedInfomarksMeshes> selectedInfomarksMeshes;
+    // Rebuilt when the group, the map or the view's layer changes; see
+    // MapCanvas::paintGroupCharacters().
+    std::optional<GroupCharacterMeshes> groupCharacterMeshes;
 
     Batches() = default;
     ~Batches() = default;
@@ -60,6 +171,14 @@ struct NODISCARD Batches final
     {
         mapBatches.reset();
         infomarksMeshes.reset();
+        groupCharacterMeshes.reset();
+        resetSelections();
+    }
+
+    void resetSelections()
+    {
+        selectedRoomMeshes.reset();
+        selectedInfomarksMeshes.reset();
     }
 };
 
@@ -89,9 +208,34 @@ class MapCanvasRoomDrawer final
     auto &getOpenGL() const { return m_opengl; }
 
 public:
-    void generateBatches(const LayerToRooms &layerToRooms,
-                         const RoomIndex &roomIndex,
-                         const OptBounds &bounds);
+    /// Builds every tile within the bounds. This doesn't touch OpenGL, so it's safe
+    /// to call from a worker thread; returns nullptr if isCancelled reported true.
+    NODISCARD static SharedMapBatchesData buildBatches(const MapSnapshot &snapshot,
+                                                       const MapCanvasTextures &textures,
+                                                       const OptBounds &bounds,
+                                                       const std::function<bool()> &isCancelled);
+    /// Same as buildBatches(), but only for these tiles; tiles without rooms
+    /// will be removed.
+    NODISCARD static SharedMapBatchesData buildTiles(const MapSnapshot &snapshot,
+                                                     const MapCanvasTextures &textures,
+                                                     const OptBounds &bounds,
+                                                     const std::set<MapTileId> &tiles,
+                                                     const std::function<bool()> &isCancelled);
+
+    /// Returns the tiles that have to be rebuilt because these rooms changed;
+    /// that includes the tiles of the rooms they have exits to or from.
+    /// The batches must already exist.
+    NODISCARD std::set<MapTileId> takeDirtyTiles(const RoomIdSet &changed,
+                                                 const MapSnapshot &snapshot);
+    /// Uploads the data and swaps it into the batches.
+    void applyBatches(MapBatchesData &data);
+
+    /// Draws the tiles in the viewport's frustum, with the level of detail
+    /// that goes with its zoom, leaving out whatever `quality` drops.
+    static void renderBatches(MapBatches &batches,
+                              const MapCanvasViewport &viewport,
+                              const FrameQuality &quality,
+                              OpenGL &gl);
 
 public:
     inline GLFont &getFont() { return m_font; }
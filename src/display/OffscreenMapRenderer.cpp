@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "OffscreenMapRenderer.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <stdexcept>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFramebufferObjectFormat>
+#include <QOpenGLFunctions>
+#include <QSurfaceFormat>
+
+#include "../configuration/configuration.h"
+#include "../expandoracommon/coordinate.h"
+#include "../global/Color.h"
+#include "../global/utils.h"
+#include "../mapdata/MapSnapshot.h"
+
+OffscreenMapRenderer::OffscreenMapRenderer()
+    : m_font{m_opengl}
+    , m_viewport{QSize{}}
+{
+    const QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+    m_context.setFormat(format);
+    if (!m_context.create())
+        throw std::runtime_error("unable to create an OpenGL context");
+    m_surface.setFormat(m_context.format());
+    m_surface.create();
+    if (!m_surface.isValid())
+        throw std::runtime_error("unable to create an offscreen surface");
+
+    makeCurrent();
+    m_opengl.initializeOpenGLFunctions();
+    m_opengl.initializeBackend(!getConfig().canvas.legacyOpenGL);
+    m_opengl.initializeRenderer(1.f);
+    m_textures.loadAll(m_opengl);
+    m_font.init();
+}
+
+OffscreenMapRenderer::~OffscreenMapRenderer()
+{
+    // The meshes, textures and buffers have to be destroyed with the context current.
+    makeCurrent();
+    m_batches.reset();
+    m_textures.destroyAll();
+    m_font.cleanup();
+    m_opengl.cleanup();
+    m_fbo.reset();
+    m_context.doneCurrent();
+}
+
+void OffscreenMapRenderer::makeCurrent()
+{
+    if (!m_context.makeCurrent(&m_surface))
+        throw std::runtime_error("unable to make the offscreen OpenGL context current");
+}
+
+void OffscreenMapRenderer::setMap(const MapSnapshot &snapshot)
+{
+    const SharedMapBatchesData data
+        = MapCanvasRoomDrawer::buildBatches(snapshot, m_textures, OptBounds{}, {});
+
+    makeCurrent();
+    MapCanvasRoomDrawer drawer{m_viewport, m_textures, m_opengl, m_font, m_batches};
+    drawer.applyBatches(deref(data));
+}
+
+void OffscreenMapRenderer::resizeFramebuffer(const QSize &size)
+{
+    if (m_fbo != nullptr && m_fbo->size() == size)
+        return;
+
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    m_fbo = std::make_unique<QOpenGLFramebufferObject>(size, format);
+    if (!m_fbo->isValid())
+        throw std::runtime_error("unable to create a framebuffer object");
+}
+
+void OffscreenMapRenderer::render(const View &view)
+{
+    if (view.size.isEmpty())
+        throw std::invalid_argument("view.size");
+
+    makeCurrent();
+    resizeFramebuffer(view.size);
+    m_fbo->bind();
+
+    m_viewport.setFixedSize(view.size);
+    m_viewport.m_scroll = view.center;
+    m_viewport.m_currentLayer = view.layer;
+    m_viewport.m_scaleFactor.set(view.zoom);
+
+    // The zoom is clamped the same way as MapCanvas's.
+    const float pixelsPerRoom = PIXELS_PER_ROOM * m_viewport.getTotalScaleFactor();
+    const glm::vec2 halfSize = glm::vec2{view.size.width(), view.size.height()}
+                               / (2.f * pixelsPerRoom);
+    // Layers above the current one are closer to the camera.
+    static constexpr float DEPTH_RANGE = 100.f;
+    const glm::mat4 proj
+        = glm::ortho(-halfSize.x, halfSize.x, -halfSize.y, halfSize.y, -DEPTH_RANGE, DEPTH_RANGE);
+    const glm::mat4 viewMatrix = glm::translate(glm::mat4(1.f),
+                                                -glm::vec3{view.center,
+                                                           static_cast<float>(view.layer)});
+    m_viewport.m_viewProj = proj * viewMatrix;
+
+    m_opengl.setProjectionMatrix(m_viewport.m_viewProj);
+    m_opengl.glViewport(0, 0, view.size.width(), view.size.height());
+    m_opengl.clear(Color{getConfig().canvas.backgroundColor});
+
+    if (m_batches.has_value())
+        MapCanvasRoomDrawer::renderBatches(m_batches.value(),
+                                           m_viewport,
+                                           FrameQuality{},
+                                           m_opengl);
+    m_opengl.resetBindings();
+
+    m_fbo->release();
+}
+
+void OffscreenMapRenderer::finish()
+{
+    makeCurrent();
+    m_context.functions()->glFinish();
+}
+
+QImage OffscreenMapRenderer::grabImage()
+{
+    if (m_fbo == nullptr)
+        return QImage{};
+
+    makeCurrent();
+    return m_fbo->toImage();
+}
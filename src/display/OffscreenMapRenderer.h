@@ -0,0 +1,85 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <glm/glm.hpp>
+#include <memory>
+#include <optional>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QSize>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "../opengl/Font.h"
+#include "../opengl/OpenGL.h"
+#include "MapCanvasData.h"
+#include "MapCanvasRoomDrawer.h"
+#include "Textures.h"
+
+class MapSnapshot;
+class QOpenGLFramebufferObject;
+
+/// Draws the map into a framebuffer object instead of a window, with the same
+/// meshes, textures and shaders as MapCanvas.
+///
+/// The view is always straight down with an orthographic projection, so an
+/// image covers exactly the rooms it's asked for; that makes it usable both as
+/// a rendering benchmark and as a generator of web map tiles.
+///
+/// It owns its own OpenGL context, so it must be created, used and destroyed on
+/// one thread (normally the GUI thread).
+class NODISCARD OffscreenMapRenderer final
+{
+public:
+    /// Pixels per room at a zoom of 1, the same as MapCanvas.
+    static constexpr const float PIXELS_PER_ROOM = 44.f;
+
+    struct NODISCARD View final
+    {
+        /// World coordinates of the middle of the image.
+        glm::vec2 center{0.f};
+        int layer = 0;
+        /// Same scale as MapCanvas's zoom; it also picks the level of detail.
+        float zoom = 1.f;
+        QSize size{512, 512};
+    };
+
+private:
+    QOffscreenSurface m_surface;
+    QOpenGLContext m_context;
+    OpenGL m_opengl;
+    GLFont m_font;
+    MapCanvasTextures m_textures;
+    MapCanvasViewport m_viewport;
+    std::optional<MapBatches> m_batches;
+    std::unique_ptr<QOpenGLFramebufferObject> m_fbo;
+
+public:
+    /// Throws std::runtime_error if no OpenGL context can be created.
+    OffscreenMapRenderer();
+    ~OffscreenMapRenderer();
+    DELETE_CTORS_AND_ASSIGN_OPS(OffscreenMapRenderer);
+
+public:
+    /// Meshes and uploads the whole map; this is the slow part.
+    void setMap(const MapSnapshot &snapshot);
+
+    /// Draws the view into the framebuffer without waiting for the GPU.
+    void render(const View &view);
+    /// Waits for everything rendered so far to finish.
+    void finish();
+    /// Reads back the last rendered view.
+    NODISCARD QImage grabImage();
+
+    NODISCARD QImage renderImage(const View &view)
+    {
+        render(view);
+        return grabImage();
+    }
+
+private:
+    void makeCurrent();
+    void resizeFramebuffer(const QSize &size);
+};
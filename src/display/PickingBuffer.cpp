@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "PickingBuffer.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFramebufferObjectFormat>
+#include <QOpenGLFunctions>
+#include <QRect>
+
+#include "../expandoracommon/coordinate.h"
+#include "../expandoracommon/room.h"
+#include "../global/Color.h"
+#include "../mapdata/MapSnapshot.h"
+#include "../opengl/OpenGL.h"
+#include "../opengl/OpenGLTypes.h"
+#include "MapCanvasData.h"
+
+PickingBuffer::PickingBuffer() = default;
+PickingBuffer::~PickingBuffer() = default;
+
+void PickingBuffer::destroy()
+{
+    m_fbo.reset();
+}
+
+bool PickingBuffer::isCurrent(const MapCanvasViewport &viewport,
+                              const MapSnapshot &snapshot,
+                              const QSize &size) const
+{
+    return m_fbo != nullptr && m_fbo->size() == size && m_viewProj == viewport.m_viewProj
+           && m_layer == viewport.m_currentLayer && m_generation == snapshot.getGeneration();
+}
+
+bool PickingBuffer::update(OpenGL &gl,
+                           const MapCanvasViewport &viewport,
+                           const MapSnapshot &snapshot,
+                           const float devicePixelRatio)
+{
+    if (m_failed)
+        return false;
+
+    const auto scaled = [devicePixelRatio](const int n) -> int {
+        return std::max(1, static_cast<int>(static_cast<float>(n) * devicePixelRatio));
+    };
+    const QSize size{scaled(viewport.width()), scaled(viewport.height())};
+    if (isCurrent(viewport, snapshot, size))
+        return true;
+
+    if (m_fbo == nullptr || m_fbo->size() != size) {
+        // No multisampling, so the edges of rooms don't blend into ids that don't exist.
+        QOpenGLFramebufferObjectFormat format;
+        format.setAttachment(QOpenGLFramebufferObject::NoAttachment);
+        m_fbo = std::make_unique<QOpenGLFramebufferObject>(size, format);
+        if (!m_fbo->isValid()) {
+            m_fbo.reset();
+            m_failed = true;
+            return false;
+        }
+    }
+
+    render(gl, viewport, snapshot);
+    m_viewProj = viewport.m_viewProj;
+    m_layer = viewport.m_currentLayer;
+    m_generation = snapshot.getGeneration();
+    return true;
+}
+
+void PickingBuffer::render(OpenGL &gl,
+                           const MapCanvasViewport &viewport,
+                           const MapSnapshot &snapshot)
+{
+    const int currentLayer = viewport.m_currentLayer;
+
+    // Lower layers first, so each layer covers the ones below it; only rooms in
+    // the view frustum are drawn.
+    std::map<int, std::vector<ColorVert>> layers;
+    snapshot.forEach([&layers, &viewport, currentLayer](const Room &room) {
+        const Coordinate &pos = room.getPosition();
+        const uint32_t rgb = room.getId().asUint32() + 1u;
+        if (pos.z > currentLayer || rgb > MAX_RGB)
+            return;
+        const glm::vec3 min = pos.to_vec3();
+        const glm::vec3 max = min + glm::vec3{1.f, 1.f, 0.f};
+        if (!viewport.isBoxVisible(min, max))
+            return;
+
+        const Color color = Color::fromRGB(rgb);
+        auto &verts = layers[pos.z];
+        verts.emplace_back(color, min);
+        verts.emplace_back(color, glm::vec3{max.x, min.y, min.z});
+        verts.emplace_back(color, max);
+        verts.emplace_back(color, glm::vec3{min.x, max.y, min.z});
+    });
+
+    m_fbo->bind();
+    gl.setProjectionMatrix(viewport.m_viewProj);
+    gl.glViewport(0, 0, viewport.width(), viewport.height());
+    gl.clear(Color::fromRGB(NO_ROOM));
+    for (const auto &layer : layers)
+        gl.renderColoredQuads(layer.second, GLRenderState());
+    gl.resetBindings();
+    m_fbo->release();
+}
+
+RoomId PickingBuffer::pick(const QPoint &pos) const
+{
+    if (m_fbo == nullptr || !QRect{QPoint{}, m_fbo->size()}.contains(pos))
+        return INVALID_ROOMID;
+
+    // OpenGL counts rows from the bottom.
+    uint8_t rgba[4] = {0, 0, 0, 0};
+    m_fbo->bind();
+    QOpenGLContext::currentContext()->functions()->glReadPixels(pos.x(),
+                                                                m_fbo->height() - 1 - pos.y(),
+                                                                1,
+                                                                1,
+                                                                GL_RGBA,
+                                                                GL_UNSIGNED_BYTE,
+                                                                rgba);
+    m_fbo->release();
+
+    const uint32_t rgb = static_cast<uint32_t>(rgba[0]) | (static_cast<uint32_t>(rgba[1]) << 8u)
+                         | (static_cast<uint32_t>(rgba[2]) << 16u);
+    if (rgb == NO_ROOM)
+        return INVALID_ROOMID;
+    return RoomId{rgb - 1u};
+}
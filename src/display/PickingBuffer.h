@@ -0,0 +1,67 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <memory>
+#include <optional>
+#include <QPoint>
+#include <QSize>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
+
+class MapSnapshot;
+class OpenGL;
+class QOpenGLFramebufferObject;
+struct MapCanvasViewport;
+
+/// An off-screen copy of the view in which each room is drawn in a colour that
+/// encodes its id, so finding the room drawn under a pixel is one glReadPixels()
+/// of that pixel, however many layers a ray through it would cross.
+///
+/// It's only drawn when a pick asks for it and the view or the map changed
+/// since the last one. The current layer is drawn over the ones below it, as on
+/// the canvas; the faded layers above it aren't drawn at all.
+///
+/// Everything has to be called with the canvas's OpenGL context current.
+class NODISCARD PickingBuffer final
+{
+private:
+    // The colour of a room is its id plus one; black means no room.
+    static constexpr const uint32_t NO_ROOM = 0u;
+    // Rooms with larger ids can't be picked.
+    static constexpr const uint32_t MAX_RGB = 0xffffffu;
+
+    std::unique_ptr<QOpenGLFramebufferObject> m_fbo;
+    glm::mat4 m_viewProj{1.f};
+    uint64_t m_generation = 0;
+    int m_layer = 0;
+    bool m_failed = false;
+
+public:
+    PickingBuffer();
+    ~PickingBuffer();
+    DELETE_CTORS_AND_ASSIGN_OPS(PickingBuffer);
+
+public:
+    /// Redraws the buffer if `viewport` or `snapshot` changed since it was drawn.
+    /// Returns false if no framebuffer object can be made; the caller should
+    /// find the room some other way.
+    NODISCARD bool update(OpenGL &gl,
+                          const MapCanvasViewport &viewport,
+                          const MapSnapshot &snapshot,
+                          float devicePixelRatio);
+    /// The room drawn at `pos` (in device pixels, from the top left), or
+    /// INVALID_ROOMID if there's none; requires update().
+    NODISCARD RoomId pick(const QPoint &pos) const;
+    void destroy();
+
+private:
+    NODISCARD bool isCurrent(const MapCanvasViewport &viewport,
+                             const MapSnapshot &snapshot,
+                             const QSize &size) const;
+    void render(OpenGL &gl, const MapCanvasViewport &viewport, const MapSnapshot &snapshot);
+};
@@ -0,0 +1,107 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "RenderTexture.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLTexture>
+
+NODISCARD static QOpenGLFunctions *getCurrentFunctions()
+{
+    QOpenGLContext *const context = QOpenGLContext::currentContext();
+    return (context != nullptr) ? context->functions() : nullptr;
+}
+
+RenderTexture::~RenderTexture()
+{
+    destroy();
+}
+
+void RenderTexture::destroy()
+{
+    if (QOpenGLFunctions *const functions = getCurrentFunctions())
+        destroy(*functions);
+}
+
+void RenderTexture::destroy(QOpenGLFunctions &functions)
+{
+    if (m_fbo != 0)
+        functions.glDeleteFramebuffers(1, &m_fbo);
+    if (m_depth != 0)
+        functions.glDeleteRenderbuffers(1, &m_depth);
+    m_fbo = 0;
+    m_depth = 0;
+    m_texture.reset();
+    m_size = glm::ivec2{0};
+}
+
+bool RenderTexture::allocate(QOpenGLFunctions &functions, const glm::ivec2 &size)
+{
+    destroy(functions);
+
+    // The texture is drawn back one texel per pixel, or close to it.
+    m_texture = MMTexture::alloc(
+        QOpenGLTexture::Target::Target2D,
+        [&size](QOpenGLTexture &tex) -> void {
+            tex.create();
+            tex.setSize(size.x, size.y, 1);
+            tex.setMipLevels(1);
+            tex.setFormat(QOpenGLTexture::TextureFormat::RGBA8_UNorm);
+            tex.allocateStorage(QOpenGLTexture::PixelFormat::RGBA,
+                                QOpenGLTexture::PixelType::UInt8);
+            tex.setWrapMode(QOpenGLTexture::WrapMode::ClampToEdge);
+            tex.setMinMagFilters(QOpenGLTexture::Filter::Linear, QOpenGLTexture::Filter::Linear);
+        },
+        true);
+
+    functions.glGenRenderbuffers(1, &m_depth);
+    functions.glBindRenderbuffer(GL_RENDERBUFFER, m_depth);
+    functions.glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, size.x, size.y);
+    functions.glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    functions.glGenFramebuffers(1, &m_fbo);
+    functions.glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    functions.glFramebufferTexture2D(GL_FRAMEBUFFER,
+                                     GL_COLOR_ATTACHMENT0,
+                                     GL_TEXTURE_2D,
+                                     m_texture->textureId(),
+                                     0);
+    functions.glFramebufferRenderbuffer(GL_FRAMEBUFFER,
+                                        GL_DEPTH_ATTACHMENT,
+                                        GL_RENDERBUFFER,
+                                        m_depth);
+    const bool complete = functions.glCheckFramebufferStatus(GL_FRAMEBUFFER)
+                          == GL_FRAMEBUFFER_COMPLETE;
+    functions.glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_prevFbo));
+
+    if (!complete) {
+        destroy(functions);
+        return false;
+    }
+    m_size = size;
+    return true;
+}
+
+bool RenderTexture::bind(const glm::ivec2 &size)
+{
+    QOpenGLFunctions *const functions = getCurrentFunctions();
+    if (m_failed || functions == nullptr || size.x <= 0 || size.y <= 0)
+        return false;
+
+    // The canvas draws into its widget's framebuffer, and the offscreen renderer into its own.
+    functions->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &m_prevFbo);
+    if (m_fbo == 0 || m_size != size) {
+        if (!allocate(*functions, size)) {
+            m_failed = true;
+            return false;
+        }
+    }
+    functions->glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    return true;
+}
+
+void RenderTexture::release()
+{
+    if (QOpenGLFunctions *const functions = getCurrentFunctions())
+        functions->glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(m_prevFbo));
+}
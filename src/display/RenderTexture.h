@@ -0,0 +1,44 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <glm/glm.hpp>
+#include <QOpenGLFunctions>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "Textures.h"
+
+/// A framebuffer whose colour is a texture (with a depth buffer), for drawing part of a
+/// frame once and drawing that texture on later frames.
+///
+/// Everything has to be called with the canvas's OpenGL context current.
+class NODISCARD RenderTexture final
+{
+private:
+    SharedMMTexture m_texture;
+    GLuint m_fbo = 0;
+    GLuint m_depth = 0;
+    GLint m_prevFbo = 0;
+    glm::ivec2 m_size{0};
+    bool m_failed = false;
+
+public:
+    RenderTexture() = default;
+    ~RenderTexture();
+    DELETE_CTORS_AND_ASSIGN_OPS(RenderTexture);
+
+public:
+    /// Binds the framebuffer, (re)allocated at `size` (in device pixels) if necessary;
+    /// returns false if it can't be made, and keeps failing after that.
+    NODISCARD bool bind(const glm::ivec2 &size);
+    /// Restores the framebuffer that was bound before bind().
+    void release();
+    /// Null until bind() succeeded.
+    NODISCARD const SharedMMTexture &getTexture() const { return m_texture; }
+    void destroy();
+
+private:
+    NODISCARD bool allocate(QOpenGLFunctions &functions, const glm::ivec2 &size);
+    void destroy(QOpenGLFunctions &functions);
+};
@@ -6,7 +6,6 @@
 
 #include <stdexcept>
 
-#include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
 #include "../mapdata/ExitDirection.h"
 
@@ -19,11 +18,7 @@ RoadIndexMaskEnum getRoadIndex(const ExitDirEnum dir)
 
 RoadIndexMaskEnum getRoadIndex(const Room &room)
 {
-    RoadIndexMaskEnum roadIndex = RoadIndexMaskEnum::NONE;
-
-    for (auto dir : ALL_EXITS_NESW)
-        if (room.exit(dir).exitIsRoad())
-            roadIndex |= getRoadIndex(dir);
-
-    return roadIndex;
+    // The room keeps a mask of its road exits, with the same bits for NESW.
+    const uint32_t roads = room.getExitRenderMasks().roads;
+    return static_cast<RoadIndexMaskEnum>(roads) & RoadIndexMaskEnum::ALL;
 }
@@ -4,30 +4,28 @@
 #include <cstdlib>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <map>
 #include <memory>
 #include <optional>
 #include <vector>
 
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/room.h"
-#include "../global/EnumIndexedArray.h"
 #include "../mapdata/roomselection.h"
 #include "../opengl/OpenGL.h"
 #include "../opengl/OpenGLTypes.h"
 #include "Characters.h"
 #include "MapCanvasData.h"
+#include "MapCanvasRoomDrawer.h"
 #include "Textures.h"
 #include "mapcanvas.h"
 
+// Only used for the icons of the selected rooms out of view, since those move with the view.
 class NODISCARD RoomSelFakeGL final
 {
-public:
-    enum class SelTypeEnum { Near, Distant, MoveBad, MoveGood };
-    static constexpr size_t NUM_SEL_TYPES = 4;
-
 private:
     glm::mat4 m_modelView = glm::mat4(1);
-    EnumIndexedArray<std::vector<TexVert>, SelTypeEnum, NUM_SEL_TYPES> m_arrays;
+    std::vector<TexVert> m_verts;
 
 public:
     void resetMatrix() { m_modelView = glm::mat4(1); }
@@ -36,17 +34,13 @@ class NODISCARD RoomSelFakeGL final
         auto &m = m_modelView;
         m = glm::rotate(m, glm::radians(degrees), glm::vec3(x, y, z));
     }
-    void glTranslatef(int x, int y, int z)
-    {
-        glTranslatef(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
-    }
     void glTranslatef(float x, float y, float z)
     {
         auto &m = m_modelView;
         m = glm::translate(m, glm::vec3(x, y, z));
     }
 
-    void drawColoredQuad(const SelTypeEnum type)
+    void drawColoredQuad()
     {
 #define DECL(name, a, b) \
     const TexVert name \
@@ -63,97 +57,101 @@ class NODISCARD RoomSelFakeGL final
             return TexVert{in_vert.tex, glm::vec3{tmp / tmp.w}};
         };
 
-        m_arrays[type].emplace_back(transform(A));
-        m_arrays[type].emplace_back(transform(B));
-        m_arrays[type].emplace_back(transform(C));
-        m_arrays[type].emplace_back(transform(D));
+        m_verts.emplace_back(transform(A));
+        m_verts.emplace_back(transform(B));
+        m_verts.emplace_back(transform(C));
+        m_verts.emplace_back(transform(D));
 #undef DECL
     }
 
-    void draw(OpenGL &gl, const MapCanvasTextures &textures)
+    void draw(OpenGL &gl, const MapCanvasTextures &textures, const GLRenderState &rs)
     {
-        static const MMapper::Array<SelTypeEnum, NUM_SEL_TYPES> ALL_SEL_TYPES
-            = {SelTypeEnum::Near, SelTypeEnum::Distant, SelTypeEnum::MoveBad, SelTypeEnum::MoveGood};
-
-        const auto rs
-            = GLRenderState().withBlend(BlendModeEnum::TRANSPARENCY).withDepthFunction(std::nullopt);
-
-        for (const SelTypeEnum type : ALL_SEL_TYPES) {
-            const std::vector<TexVert> &arr = m_arrays[type];
-            if (arr.empty())
-                continue;
-
-            const SharedMMTexture &texture = [&textures, type]() -> const SharedMMTexture & {
-                switch (type) {
-                case SelTypeEnum::Near:
-                    return textures.room_sel;
-                case SelTypeEnum::Distant:
-                    return textures.room_sel_distant;
-                case SelTypeEnum::MoveBad:
-                    return textures.room_sel_move_bad;
-                case SelTypeEnum::MoveGood:
-                    return textures.room_sel_move_good;
-                default:
-                    break;
-                }
-                std::abort();
-            }();
-
-            gl.renderTexturedQuads(arr, rs.withTexture0(texture));
-        }
+        if (!m_verts.empty())
+            gl.renderTexturedQuads(m_verts, rs.withTexture0(textures.room_sel_distant));
     }
 };
 
-void MapCanvas::paintSelectedRoom(RoomSelFakeGL &gl, const Room &room)
+// One mesh per tile, with a quad for every selected room; see RoomQuadVert.
+// The texture comes from the render state, so the same meshes also show the move.
+static std::vector<UniqueMesh> createSelectedRoomMeshes(OpenGL &gl, const RoomSelection &sel)
+{
+    std::map<MapTileId, std::vector<RoomQuadVert>> tiles;
+    for (const Room *const room : sel) {
+        if (room == nullptr)
+            continue;
+
+        const Coordinate &pos = room->getPosition();
+        const MapTileId tile = MapTileId::of(pos);
+        const glm::ivec2 rel = pos.to_ivec2() - tile.getMin().to_ivec2();
+        std::vector<RoomQuadVert> &verts = tiles[tile];
+#define EMIT(x, y) verts.emplace_back(rel, glm::ivec2((x), (y)), 0);
+        EMIT(0, 0);
+        EMIT(1, 0);
+        EMIT(1, 1);
+        EMIT(0, 1);
+#undef EMIT
+    }
+
+    std::vector<UniqueMesh> result;
+    result.reserve(tiles.size());
+    for (const auto &[tile, verts] : tiles)
+        result.emplace_back(gl.createRoomQuadBatch(verts, tile.getMin().to_vec3()));
+    return result;
+}
+
+void MapCanvas::paintDistantSelectedRoom(RoomSelFakeGL &gl, const Room &room)
 {
     const Coordinate &roomPos = room.getPosition();
-    const int x = roomPos.x;
-    const int y = roomPos.y;
-    const int z = roomPos.z;
+    const float marginPixels = MapScreen::DEFAULT_MARGIN_PIXELS;
+    if (m_mapScreen.isRoomVisible(roomPos, marginPixels / 2.f))
+        return;
 
     // This fake GL uses resetMatrix() before this function.
     gl.resetMatrix();
 
-    const float marginPixels = MapScreen::DEFAULT_MARGIN_PIXELS;
-    const bool isMoving = hasRoomSelectionMove();
-
-    if (!isMoving && !m_mapScreen.isRoomVisible(roomPos, marginPixels / 2.f)) {
-        const glm::vec3 roomCenter = roomPos.to_vec3() + glm::vec3{0.5f, 0.5f, 0.f};
-        const auto dot = DistantObjectTransform::construct(roomCenter, m_mapScreen, marginPixels);
-        gl.glTranslatef(dot.offset.x, dot.offset.y, dot.offset.z);
-        gl.glRotatef(dot.rotationDegrees, 0.f, 0.f, 1.f);
-        const glm::vec2 iconCenter{0.5f, 0.5f};
-        gl.glTranslatef(-iconCenter.x, -iconCenter.y, 0.f);
-        gl.drawColoredQuad(RoomSelFakeGL::SelTypeEnum::Distant);
-    } else {
-        // Room is close
-        gl.glTranslatef(x, y, z);
-        gl.drawColoredQuad(RoomSelFakeGL::SelTypeEnum::Near);
-        gl.resetMatrix();
-    }
-
-    if (isMoving) {
-        gl.resetMatrix();
-        const auto &relativeOffset = m_roomSelectionMove->pos;
-        gl.glTranslatef(x + relativeOffset.x, y + relativeOffset.y, z);
-        gl.drawColoredQuad(m_roomSelectionMove->wrongPlace ? RoomSelFakeGL::SelTypeEnum::MoveBad
-                                                           : RoomSelFakeGL::SelTypeEnum::MoveGood);
-    }
+    const glm::vec3 roomCenter = roomPos.to_vec3() + glm::vec3{0.5f, 0.5f, 0.f};
+    const auto dot = DistantObjectTransform::construct(roomCenter, m_mapScreen, marginPixels);
+    gl.glTranslatef(dot.offset.x, dot.offset.y, dot.offset.z);
+    gl.glRotatef(dot.rotationDegrees, 0.f, 0.f, 1.f);
+    const glm::vec2 iconCenter{0.5f, 0.5f};
+    gl.glTranslatef(-iconCenter.x, -iconCenter.y, 0.f);
+    gl.drawColoredQuad();
 }
 
 void MapCanvas::paintSelectedRooms()
 {
-    if (!m_roomSelection || m_roomSelection->isEmpty())
+    if (!m_roomSelection || m_roomSelection->empty())
         return;
 
-    RoomSelFakeGL gl;
+    auto &gl = getOpenGL();
+    std::optional<std::vector<UniqueMesh>> &meshes = m_batches.selectedRoomMeshes;
+    if (!meshes.has_value())
+        meshes = createSelectedRoomMeshes(gl, *m_roomSelection);
+
+    const auto rs
+        = GLRenderState().withBlend(BlendModeEnum::TRANSPARENCY).withDepthFunction(std::nullopt);
 
-    for (const Room *const room : *m_roomSelection) {
-        if (room != nullptr) {
-            gl.resetMatrix();
-            paintSelectedRoom(gl, *room);
+    // The rooms out of view are drawn too, but only the GPU sees them.
+    for (UniqueMesh &mesh : meshes.value())
+        mesh.render(rs.withTexture0(m_textures.room_sel));
+
+    if (!hasRoomSelectionMove()) {
+        RoomSelFakeGL fake;
+        for (const Room *const room : *m_roomSelection) {
+            if (room != nullptr)
+                paintDistantSelectedRoom(fake, *room);
         }
+        fake.draw(gl, m_textures, rs);
+        return;
     }
 
-    gl.draw(getOpenGL(), m_textures);
+    const SharedMMTexture &texture = m_roomSelectionMove->wrongPlace
+                                         ? m_textures.room_sel_move_bad
+                                         : m_textures.room_sel_move_good;
+    const glm::vec2 offset{m_roomSelectionMove->pos.to_ivec2()};
+    const glm::mat4 viewProj = gl.getProjectionMatrix();
+    gl.setProjectionMatrix(glm::translate(viewProj, glm::vec3{offset, 0.f}));
+    for (UniqueMesh &mesh : meshes.value())
+        mesh.render(rs.withTexture0(texture));
+    gl.setProjectionMatrix(viewProj);
 }
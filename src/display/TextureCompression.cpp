@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <glm/glm.hpp>
+#include <stdexcept>
+
+namespace { // anonymous
+
+using Block = std::array<glm::ivec4, 16>;
+
+Block readBlock(const QImage &image, const int bx, const int by)
+{
+    Block block;
+    for (int y = 0; y < 4; ++y) {
+        const uchar *const line = image.constScanLine(std::min(by + y, image.height() - 1));
+        for (int x = 0; x < 4; ++x) {
+            const uchar *const px = line + 4 * std::min(bx + x, image.width() - 1);
+            block[static_cast<size_t>(4 * y + x)] = glm::ivec4{px[0], px[1], px[2], px[3]};
+        }
+    }
+    return block;
+}
+
+uint16_t toRgb565(const glm::vec3 &c)
+{
+    const auto quantize = [](const float v, const int max) -> uint16_t {
+        return static_cast<uint16_t>(std::clamp(static_cast<int>(v * max / 255.f + 0.5f), 0, max));
+    };
+    return static_cast<uint16_t>((quantize(c.r, 31) << 11u) | (quantize(c.g, 63) << 5u)
+                                 | quantize(c.b, 31));
+}
+
+glm::ivec3 fromRgb565(const uint16_t c)
+{
+    const int r = (c >> 11u) & 31;
+    const int g = (c >> 5u) & 63;
+    const int b = c & 31;
+    return glm::ivec3{(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+}
+
+void appendLittleEndian(QByteArray &out, uint64_t value, const int bytes)
+{
+    for (int i = 0; i < bytes; ++i) {
+        out.append(static_cast<char>(value & 0xffu));
+        value >>= 8u;
+    }
+}
+
+// The colours are fitted to the block's principal axis, which is found by a few rounds of
+// power iteration on their covariance. Transparent texels are left out when there are
+// others, since they're never seen.
+void encodeColors(QByteArray &out, const Block &block)
+{
+    std::array<bool, 16> isCounted;
+    size_t numCounted = 0;
+    for (size_t i = 0; i < block.size(); ++i) {
+        isCounted[i] = block[i].a > 0;
+        numCounted += isCounted[i] ? 1u : 0u;
+    }
+    if (numCounted == 0)
+        isCounted.fill(true);
+
+    glm::vec3 mean{0.f};
+    float n = 0.f;
+    for (size_t i = 0; i < block.size(); ++i) {
+        if (isCounted[i]) {
+            mean += glm::vec3{block[i]};
+            n += 1.f;
+        }
+    }
+    mean /= n;
+
+    glm::mat3 cov{0.f};
+    for (size_t i = 0; i < block.size(); ++i) {
+        if (isCounted[i]) {
+            const glm::vec3 d = glm::vec3{block[i]} - mean;
+            cov += glm::outerProduct(d, d);
+        }
+    }
+    glm::vec3 axis{1.f, 1.f, 1.f};
+    for (int iter = 0; iter < 8; ++iter) {
+        const glm::vec3 next = cov * axis;
+        const float len = glm::length(next);
+        if (len < 1e-6f)
+            break;
+        axis = next / len;
+    }
+
+    float lo = 0.f;
+    float hi = 0.f;
+    for (size_t i = 0; i < block.size(); ++i) {
+        if (isCounted[i]) {
+            const float t = glm::dot(glm::vec3{block[i]} - mean, axis);
+            lo = std::min(lo, t);
+            hi = std::max(hi, t);
+        }
+    }
+
+    uint16_t c0 = toRgb565(mean + axis * hi);
+    uint16_t c1 = toRgb565(mean + axis * lo);
+    // c0 > c1 selects the four-colour mode in BC1; BC3 always uses it.
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        const glm::ivec3 e0 = fromRgb565(c0);
+        const glm::ivec3 e1 = fromRgb565(c1);
+        const std::array<glm::ivec3, 4> palette{e0,
+                                                e1,
+                                                (2 * e0 + e1) / 3,
+                                                (e0 + 2 * e1) / 3};
+        for (size_t i = 0; i < block.size(); ++i) {
+            const glm::ivec3 c{block[i]};
+            uint32_t best = 0;
+            int bestDist = INT32_MAX;
+            for (uint32_t j = 0; j < 4; ++j) {
+                const glm::ivec3 d = c - palette[j];
+                const int dist = d.r * d.r + d.g * d.g + d.b * d.b;
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = j;
+                }
+            }
+            indices |= best << (2u * static_cast<uint32_t>(i));
+        }
+    }
+
+    appendLittleEndian(out, c0, 2);
+    appendLittleEndian(out, c1, 2);
+    appendLittleEndian(out, indices, 4);
+}
+
+// The eight-value mode between the block's lowest and highest alpha.
+void encodeAlpha(QByteArray &out, const Block &block)
+{
+    int a0 = 0;
+    int a1 = 255;
+    for (const glm::ivec4 &texel : block) {
+        a0 = std::max(a0, texel.a);
+        a1 = std::min(a1, texel.a);
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        std::array<int, 8> palette{a0, a1};
+        for (int j = 1; j <= 6; ++j)
+            palette[static_cast<size_t>(j + 1)] = ((7 - j) * a0 + j * a1) / 7;
+        for (size_t i = 0; i < block.size(); ++i) {
+            uint64_t best = 0;
+            int bestDist = 256;
+            for (uint64_t j = 0; j < 8; ++j) {
+                const int dist = std::abs(block[i].a - palette[j]);
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = j;
+                }
+            }
+            indices |= best << (3u * static_cast<uint64_t>(i));
+        }
+    }
+
+    appendLittleEndian(out, static_cast<uint64_t>(a0), 1);
+    appendLittleEndian(out, static_cast<uint64_t>(a1), 1);
+    appendLittleEndian(out, indices, 6);
+}
+
+} // namespace
+
+int getCompressedSize(const TextureCompressionEnum format, const int width, const int height)
+{
+    const int blocks = ((width + 3) / 4) * ((height + 3) / 4);
+    switch (format) {
+    case TextureCompressionEnum::NONE:
+        return width * height * 4;
+    case TextureCompressionEnum::BC1:
+        return blocks * 8;
+    case TextureCompressionEnum::BC3:
+        return blocks * 16;
+    }
+    throw std::invalid_argument("format");
+}
+
+QByteArray compressImage(const QImage &image, const TextureCompressionEnum format)
+{
+    if (format == TextureCompressionEnum::NONE || image.format() != QImage::Format_RGBA8888)
+        throw std::invalid_argument("compressImage");
+
+    QByteArray out;
+    out.reserve(getCompressedSize(format, image.width(), image.height()));
+    for (int by = 0; by < image.height(); by += 4) {
+        for (int bx = 0; bx < image.width(); bx += 4) {
+            const Block block = readBlock(image, bx, by);
+            if (format == TextureCompressionEnum::BC3)
+                encodeAlpha(out, block);
+            encodeColors(out, block);
+        }
+    }
+    return out;
+}
+
+CompressedMips compressLevels(const std::vector<QImage> &levels)
+{
+    const bool opaque = std::all_of(levels.begin(), levels.end(), [](const QImage &level) {
+        for (int y = 0; y < level.height(); ++y) {
+            const uchar *const line = level.constScanLine(y);
+            for (int x = 0; x < level.width(); ++x) {
+                if (line[4 * x + 3] != 255)
+                    return false;
+            }
+        }
+        return true;
+    });
+
+    CompressedMips result;
+    result.format = opaque ? TextureCompressionEnum::BC1 : TextureCompressionEnum::BC3;
+    result.levels.reserve(levels.size());
+    for (const QImage &level : levels)
+        result.levels.emplace_back(compressImage(level, result.format));
+    return result;
+}
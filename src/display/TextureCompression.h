@@ -0,0 +1,30 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <vector>
+#include <QByteArray>
+#include <QImage>
+
+#include "../global/macros.h"
+#include "../opengl/OpenGLTypes.h"
+
+/// The levels of a MipChain, block-compressed for drivers that can sample them directly,
+/// which takes a quarter (BC3) or an eighth (BC1) of the memory of RGBA8888.
+struct NODISCARD CompressedMips final
+{
+    TextureCompressionEnum format = TextureCompressionEnum::NONE;
+    std::vector<QByteArray> levels;
+
+    NODISCARD bool empty() const { return format == TextureCompressionEnum::NONE; }
+};
+
+/// Encodes an RGBA8888 image (in any row order; the blocks keep it) as 4x4 blocks; images
+/// whose sides aren't multiples of 4 repeat their last row or column in the last blocks.
+NODISCARD QByteArray compressImage(const QImage &image, TextureCompressionEnum format);
+
+/// BC1 if every texel of the levels is opaque, and BC3 otherwise.
+NODISCARD CompressedMips compressLevels(const std::vector<QImage> &levels);
+
+/// The size in bytes of an image of `width` by `height` texels in `format`.
+NODISCARD int getCompressedSize(TextureCompressionEnum format, int width, int height);
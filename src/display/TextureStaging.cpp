@@ -0,0 +1,354 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "TextureStaging.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <QtCore>
+#include <QtGui>
+
+#include "../global/ParallelFor.h"
+#include "Textures.h"
+
+// Bump this whenever the format or the filtering changes, so old cached chains are ignored.
+static constexpr const quint32 CACHE_MAGIC = 0x4d4d5458; // "MMTX"
+static constexpr const quint32 CACHE_VERSION = 2;
+
+NODISCARD static Color getAverageColor(const QImage &image)
+{
+    glm::dvec4 sum{0.0};
+    for (int y = 0; y < image.height(); ++y) {
+        const uchar *const line = image.constScanLine(y);
+        for (int x = 0; x < image.width(); ++x) {
+            const uchar *const px = line + 4 * x;
+            const double a = px[3] / 255.0;
+            sum += glm::dvec4{px[0] / 255.0 * a, px[1] / 255.0 * a, px[2] / 255.0 * a, a};
+        }
+    }
+    if (sum.a <= 0.0)
+        return Color{0.f, 0.f, 0.f, 0.f};
+
+    const auto numPixels = static_cast<double>(image.width() * image.height());
+    const glm::dvec4 avg{glm::dvec3{sum} / sum.a, sum.a / numPixels};
+    return Color{glm::vec4{avg}};
+}
+
+// A 2x2 box filter, like glGenerateMipmap(); odd edges repeat their last texel.
+NODISCARD static QImage downsample(const QImage &src)
+{
+    const int w = std::max(1, src.width() / 2);
+    const int h = std::max(1, src.height() / 2);
+    QImage dst{w, h, QImage::Format::Format_RGBA8888};
+    for (int y = 0; y < h; ++y) {
+        const uchar *const row0 = src.constScanLine(std::min(2 * y, src.height() - 1));
+        const uchar *const row1 = src.constScanLine(std::min(2 * y + 1, src.height() - 1));
+        uchar *const out = dst.scanLine(y);
+        for (int x = 0; x < w; ++x) {
+            const int x0 = 4 * std::min(2 * x, src.width() - 1);
+            const int x1 = 4 * std::min(2 * x + 1, src.width() - 1);
+            for (int c = 0; c < 4; ++c) {
+                const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                out[4 * x + c] = static_cast<uchar>((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+NODISCARD static MipChain fromFlipped(QImage level0, const Color &averageColor)
+{
+    MipChain result;
+    result.averageColor = averageColor;
+    result.levels.emplace_back(std::move(level0));
+    while (result.levels.back().width() > 1 || result.levels.back().height() > 1) {
+        // NOTE: emplace_back() can reallocate, so don't pass it a reference to back().
+        QImage next = downsample(result.levels.back());
+        result.levels.emplace_back(std::move(next));
+    }
+    return result;
+}
+
+MipChain MipChain::fromImage(const QImage &input)
+{
+    if (input.isNull())
+        return MipChain{};
+
+    const QImage image = input.convertToFormat(QImage::Format::Format_RGBA8888);
+    return fromFlipped(image.mirrored(), ::getAverageColor(image));
+}
+
+// GL 2.0 and ES 2.0 don't have texture arrays, so the images are also packed
+// into a grid of equally sized cells, in the same orientation as MMTexture
+// uploads each of them.
+//
+// NOTE: Each cell's mips only average texels of that cell, but linear filtering
+// still reaches half a texel across the edge of the cell at the smaller mips.
+// That only shows when a room is a few pixels wide.
+NODISCARD static MipChain composeAtlas(const std::vector<const MipChain *> &members)
+{
+    static constexpr const int COLUMNS = MapCanvasTextures::ATLAS_COLUMNS;
+    static constexpr const int ROWS = MapCanvasTextures::ATLAS_ROWS;
+    static constexpr const int CELL_SIZE = MapCanvasTextures::ATLAS_CELL_SIZE;
+
+    if (members.size() > static_cast<size_t>(COLUMNS * ROWS))
+        throw std::runtime_error("too many textures for the atlas");
+
+    QImage image{COLUMNS * CELL_SIZE, ROWS * CELL_SIZE, QImage::Format::Format_RGBA8888};
+    image.fill(QColor::fromRgbF(0.0, 0.0, 0.0, 0.0));
+    {
+        QPainter painter{&image};
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        int cell = 0;
+        for (const MipChain *const member : members) {
+            const QRect rect{(cell % COLUMNS) * CELL_SIZE,
+                             (cell / COLUMNS) * CELL_SIZE,
+                             CELL_SIZE,
+                             CELL_SIZE};
+            // smaller images (e.g. trails) are scaled up to fill the cell
+            if (!deref(member).empty())
+                painter.drawImage(rect, member->levels.front());
+            ++cell;
+        }
+    }
+    return fromFlipped(std::move(image), Color{});
+}
+
+NODISCARD static QString getCachePath(const QByteArray &key)
+{
+    const QString cacheDir = QStandardPaths::writableLocation(
+        QStandardPaths::GenericCacheLocation);
+    if (cacheDir.isEmpty())
+        return QString{};
+
+    const QString dir = cacheDir + "/mmapper/textures";
+    if (!QDir{}.mkpath(dir))
+        return QString{};
+
+    QCryptographicHash hash{QCryptographicHash::Md5};
+    hash.addData(key);
+    hash.addData(QByteArray::number(CACHE_VERSION));
+    return QString("%1/%2.mip").arg(dir).arg(QString{hash.result().toHex()});
+}
+
+NODISCARD static std::optional<MipChain> readCache(const QString &path)
+{
+    QFile f{path};
+    if (path.isEmpty() || !f.open(QIODevice::ReadOnly))
+        return std::nullopt;
+
+    QDataStream in{&f};
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 averageColor = 0;
+    quint32 numLevels = 0;
+    in >> magic >> version >> averageColor >> numLevels;
+    if (in.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION
+        || numLevels == 0 || numLevels > 32)
+        return std::nullopt;
+
+    MipChain result;
+    result.averageColor = Color{glm::unpackUnorm4x8(averageColor)};
+    for (quint32 i = 0; i < numLevels; ++i) {
+        qint32 width = 0;
+        qint32 height = 0;
+        in >> width >> height;
+        if (in.status() != QDataStream::Ok || width <= 0 || height <= 0 || width > 16384
+            || height > 16384)
+            return std::nullopt;
+
+        QImage level{width, height, QImage::Format::Format_RGBA8888};
+        const int bytes = static_cast<int>(level.sizeInBytes());
+        if (in.readRawData(reinterpret_cast<char *>(level.bits()), bytes) != bytes)
+            return std::nullopt;
+        result.levels.emplace_back(std::move(level));
+    }
+
+    quint8 format = 0;
+    in >> format;
+    if (in.status() != QDataStream::Ok || format > static_cast<quint8>(TextureCompressionEnum::BC3))
+        return std::nullopt;
+    result.compressed.format = static_cast<TextureCompressionEnum>(format);
+    if (!result.compressed.empty()) {
+        for (const QImage &level : result.levels) {
+            const int expected = getCompressedSize(result.compressed.format,
+                                                   level.width(),
+                                                   level.height());
+            QByteArray data;
+            in >> data;
+            if (in.status() != QDataStream::Ok || data.size() != expected)
+                return std::nullopt;
+            result.compressed.levels.emplace_back(std::move(data));
+        }
+    }
+    return result;
+}
+
+static void writeCache(const QString &path, const MipChain &chain)
+{
+    if (path.isEmpty() || chain.empty())
+        return;
+
+    QSaveFile f{path};
+    if (!f.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out{&f};
+    out << CACHE_MAGIC << CACHE_VERSION << quint32{chain.averageColor.getUint32()}
+        << static_cast<quint32>(chain.levels.size());
+    for (const QImage &level : chain.levels) {
+        out << static_cast<qint32>(level.width()) << static_cast<qint32>(level.height());
+        out.writeRawData(reinterpret_cast<const char *>(level.constBits()),
+                         static_cast<int>(level.sizeInBytes()));
+    }
+    out << static_cast<quint8>(chain.compressed.format);
+    for (const QByteArray &data : chain.compressed.levels)
+        out << data;
+    if (out.status() != QDataStream::Ok || !f.commit())
+        qWarning() << "Unable to cache the texture in" << path;
+}
+
+NODISCARD static QByteArray readWholeFile(const QString &filename)
+{
+    QFile f{filename};
+    if (!f.open(QIODevice::ReadOnly))
+        return QByteArray{};
+    return f.readAll();
+}
+
+NODISCARD static MipChain loadCached(const QByteArray &key, const std::function<MipChain()> &build)
+{
+    const QString path = getCachePath(key);
+    if (std::optional<MipChain> cached = readCache(path))
+        return std::move(cached.value());
+
+    MipChain chain = build();
+    if (!chain.empty())
+        chain.compressed = compressLevels(chain.levels);
+    writeCache(path, chain);
+    return chain;
+}
+
+NODISCARD static TextureStaging::Result decodeAll(const std::vector<QString> &filenames,
+                                                  const std::vector<QString> &atlasMembers)
+{
+    std::vector<QByteArray> contents(filenames.size());
+    std::vector<MipChain> chains(filenames.size());
+    parallelFor(filenames.size(), 1, [&](const size_t begin, const size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            contents[i] = readWholeFile(filenames[i]);
+            if (contents[i].isEmpty())
+                continue;
+            chains[i] = loadCached(contents[i], [&contents, i]() -> MipChain {
+                return MipChain::fromImage(QImage::fromData(contents[i]));
+            });
+        }
+    });
+
+    TextureStaging::Result result;
+    QByteArray atlasKey = QByteArray::number(MapCanvasTextures::ATLAS_CELL_SIZE);
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        result.images[filenames[i]] = std::move(chains[i]);
+    }
+
+    std::vector<const MipChain *> members;
+    members.reserve(atlasMembers.size());
+    for (const QString &member : atlasMembers) {
+        const auto it = result.images.find(member);
+        if (it == result.images.end())
+            throw std::invalid_argument("atlasMembers");
+        members.emplace_back(&it->second);
+
+        const auto index = std::find(filenames.begin(), filenames.end(), member)
+                           - filenames.begin();
+        atlasKey += QCryptographicHash::hash(contents[static_cast<size_t>(index)],
+                                             QCryptographicHash::Md5);
+    }
+    result.atlas = loadCached(atlasKey, [&members]() -> MipChain { return composeAtlas(members); });
+    return result;
+}
+
+struct TextureStaging::State final
+{
+    std::vector<QString> filenames;
+    std::vector<QString> atlasMembers;
+
+    std::mutex mutex;
+    std::condition_variable done;
+    // guarded by mutex
+    std::optional<Result> result;
+    std::exception_ptr error;
+
+    void run()
+    {
+        std::optional<Result> decoded;
+        std::exception_ptr caught;
+        try {
+            decoded.emplace(decodeAll(filenames, atlasMembers));
+        } catch (...) {
+            caught = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            result = std::move(decoded);
+            error = caught;
+        }
+        done.notify_all();
+    }
+
+    NODISCARD Result wait()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        done.wait(lock, [this]() { return result.has_value() || error != nullptr; });
+        if (error != nullptr)
+            std::rethrow_exception(error);
+        return std::move(result.value());
+    }
+};
+
+namespace {
+class NODISCARD Runner final : public QRunnable
+{
+private:
+    std::function<void()> m_fn;
+
+public:
+    explicit Runner(std::function<void()> fn)
+        : m_fn{std::move(fn)}
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override { m_fn(); }
+};
+} // namespace
+
+TextureStaging::TextureStaging() = default;
+TextureStaging::~TextureStaging() = default;
+
+void TextureStaging::start(std::vector<QString> filenames, std::vector<QString> atlasMembers)
+{
+    m_state = std::make_shared<State>();
+    m_state->filenames = std::move(filenames);
+    m_state->atlasMembers = std::move(atlasMembers);
+    QThreadPool::globalInstance()->start(new Runner([state = m_state]() { deref(state).run(); }));
+}
+
+TextureStaging::Result TextureStaging::take()
+{
+    if (!isStarted())
+        throw std::logic_error("TextureStaging::take() before start()");
+
+    // The state is shared with the worker, which may still be running.
+    const auto state = std::exchange(m_state, nullptr);
+    return state->wait();
+}
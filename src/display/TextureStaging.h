@@ -0,0 +1,63 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <QImage>
+#include <QString>
+
+#include "../global/Color.h"
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "TextureCompression.h"
+
+/// An image and all of its mips, the way MMTexture uploads them: RGBA8888,
+/// with the rows already in OpenGL's bottom-up order. Empty if the image
+/// couldn't be read.
+struct NODISCARD MipChain final
+{
+    std::vector<QImage> levels;
+    // The same levels, block-compressed; uploaded instead of them if the driver can.
+    CompressedMips compressed;
+    // alpha-weighted average of the image
+    Color averageColor;
+
+    NODISCARD bool empty() const { return levels.empty(); }
+
+    /// Flips the image and box-filters it down to 1x1.
+    NODISCARD static MipChain fromImage(const QImage &image);
+};
+
+/// Decodes the pixmaps on the thread pool ahead of MapCanvasTextures::loadAll(),
+/// so the OpenGL thread only has to upload them instead of decoding every image
+/// and generating its mipmaps in initializeGL().
+///
+/// The chains (and their compressed levels) are also cached on disk, keyed by the
+/// contents of the files, so later runs don't decode, downsample or compress anything.
+class NODISCARD TextureStaging final
+{
+public:
+    struct NODISCARD Result final
+    {
+        std::map<QString, MipChain> images;
+        // the atlasMembers, in that order; see MapCanvasTextures::atlas
+        MipChain atlas;
+    };
+
+private:
+    struct State;
+    std::shared_ptr<State> m_state;
+
+public:
+    TextureStaging();
+    ~TextureStaging();
+    DELETE_CTORS_AND_ASSIGN_OPS(TextureStaging);
+
+public:
+    NODISCARD bool isStarted() const { return m_state != nullptr; }
+    void start(std::vector<QString> filenames, std::vector<QString> atlasMembers);
+    /// Blocks until the images are decoded, and forgets them.
+    NODISCARD Result take();
+};
@@ -3,26 +3,102 @@
 
 #include "Textures.h"
 
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <optional>
 #include <stdexcept>
+#include <unordered_set>
 #include <vector>
 #include <QMessageLogContext>
 #include <QtCore>
 #include <QtGui>
 
 #include "../configuration/configuration.h"
+#include "../global/MemoryUsage.h"
 #include "../global/utils.h"
 #include "../opengl/Font.h"
+#include "../opengl/OpenGL.h"
 #include "../opengl/OpenGLTypes.h"
 #include "Filenames.h"
 #include "RoadIndex.h"
 #include "mapcanvas.h"
 
+NODISCARD static Color getAverageColor(const QImage &input)
+{
+    const QImage image = input.convertToFormat(QImage::Format::Format_RGBA8888);
+    glm::dvec4 sum{0.0};
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x) {
+            const QColor c = image.pixelColor(x, y);
+            const double a = c.alphaF();
+            sum += glm::dvec4{c.redF() * a, c.greenF() * a, c.blueF() * a, a};
+        }
+    }
+    if (sum.a <= 0.0)
+        return Color{0.f, 0.f, 0.f, 0.f};
+
+    const auto numPixels = static_cast<double>(image.width() * image.height());
+    const glm::dvec4 avg{glm::dvec3{sum} / sum.a, sum.a / numPixels};
+    return Color{glm::vec4{avg}};
+}
+
 MMTexture::MMTexture(this_is_private, const QString &name)
-    : m_qt_texture{QImage{name}.mirrored()}
+    : MMTexture{this_is_private{0}, QImage{name}, name}
+{}
+
+MMTexture::MMTexture(this_is_private, const QImage &image, const QString &name)
+    : m_qt_texture{image.mirrored()}
+    , m_filename{name}
+    , m_averageColor{::getAverageColor(image)}
+{
+    auto &tex = m_qt_texture;
+    tex.setWrapMode(QOpenGLTexture::WrapMode::MirroredRepeat);
+    tex.setMinMagFilters(QOpenGLTexture::Filter::LinearMipMapLinear, QOpenGLTexture::Filter::Linear);
+}
+
+// Uploads the compressed levels if the chain still has them; see MapCanvasTextures::loadAll().
+static void uploadMipChain(QOpenGLTexture &tex, const MipChain &chain)
+{
+    const QImage &base = chain.levels.front();
+    tex.setAutoMipMapGenerationEnabled(false);
+    tex.create();
+    tex.setSize(base.width(), base.height(), 1);
+    tex.setMipLevels(static_cast<int>(chain.levels.size()));
+
+    const CompressedMips &compressed = chain.compressed;
+    if (!compressed.empty()) {
+        tex.setFormat(compressed.format == TextureCompressionEnum::BC1
+                          ? QOpenGLTexture::TextureFormat::RGB_DXT1
+                          : QOpenGLTexture::TextureFormat::RGBA_DXT5);
+        tex.allocateStorage();
+        for (size_t i = 0; i < compressed.levels.size(); ++i) {
+            const QByteArray &data = compressed.levels[i];
+            tex.setCompressedData(static_cast<int>(i), data.size(), data.constData());
+        }
+        return;
+    }
+
+    tex.setFormat(QOpenGLTexture::TextureFormat::RGBA8_UNorm);
+    tex.allocateStorage(QOpenGLTexture::PixelFormat::RGBA, QOpenGLTexture::PixelType::UInt8);
+    for (size_t i = 0; i < chain.levels.size(); ++i) {
+        tex.setData(static_cast<int>(i),
+                    QOpenGLTexture::PixelFormat::RGBA,
+                    QOpenGLTexture::PixelType::UInt8,
+                    chain.levels[i].constBits());
+    }
+}
+
+MMTexture::MMTexture(this_is_private, const MipChain &chain, const QString &name)
+    : m_qt_texture{QOpenGLTexture::Target::Target2D}
+    , m_filename{name}
+    , m_averageColor{chain.averageColor}
 {
+    // loadTexture() replaces it with a blank texture
+    if (chain.empty())
+        return;
+
     auto &tex = m_qt_texture;
+    ::uploadMipChain(tex, chain);
     tex.setWrapMode(QOpenGLTexture::WrapMode::MirroredRepeat);
     tex.setMinMagFilters(QOpenGLTexture::Filter::LinearMipMapLinear, QOpenGLTexture::Filter::Linear);
 }
@@ -32,9 +108,9 @@ void MapCanvasTextures::destroyAll()
     for_each([](SharedMMTexture &tex) -> void { tex.reset(); });
 }
 
-static SharedMMTexture loadTexture(const QString &name)
+static SharedMMTexture loadTexture(const MipChain &chain, const QString &name)
 {
-    auto mmtex = MMTexture::alloc(name);
+    auto mmtex = MMTexture::alloc(chain, name);
     auto *texture = mmtex->get();
     if (!texture->isCreated()) {
         qWarning() << "failed to create: " << name;
@@ -49,24 +125,64 @@ static SharedMMTexture loadTexture(const QString &name)
     return mmtex;
 }
 
-template<typename E>
-static void loadPixmapArray(texture_array<E> &textures)
+template<typename E, typename Callback>
+static void forEachPixmapIn(texture_array<E> &textures, Callback &&callback)
 {
     const auto N = textures.size();
     for (uint i = 0u; i < N; ++i) {
         const auto x = static_cast<E>(i);
-        textures[x] = loadTexture(getPixmapFilename(x));
+        callback(textures[x], getPixmapFilename(x));
     }
 }
 
-template<RoadTagEnum Tag>
-static void loadPixmapArray(road_texture_array<Tag> &textures)
+template<RoadTagEnum Tag, typename Callback>
+static void forEachPixmapIn(road_texture_array<Tag> &textures, Callback &&callback)
 {
     const auto N = textures.size();
     for (uint i = 0u; i < N; ++i) {
         const auto x = TaggedRoadIndex<Tag>{static_cast<RoadIndexMaskEnum>(i)};
-        textures[x] = loadTexture(getPixmapFilename(x));
+        callback(textures[x], getPixmapFilename(x));
+    }
+}
+
+// Calls callback(SharedMMTexture &, const QString &filename) for each image in the atlas, in order.
+template<typename Callback>
+static void forEachAtlasPixmap(MapCanvasTextures &textures, Callback &&callback)
+{
+    forEachPixmapIn(textures.terrain, callback);
+    forEachPixmapIn(textures.road, callback);
+    forEachPixmapIn(textures.trail, callback);
+    forEachPixmapIn(textures.mob, callback);
+    forEachPixmapIn(textures.load, callback);
+    callback(textures.no_ride, getPixmapFilenameRaw("no-ride.png"));
+    callback(textures.update, getPixmapFilenameRaw("update0.png"));
+}
+
+// ... and for the rest of the images.
+template<typename Callback>
+static void forEachOtherPixmap(MapCanvasTextures &textures, Callback &&callback)
+{
+    const auto raw = [](const char *const format, const ExitDirEnum dir) -> QString {
+        return getPixmapFilenameRaw(QString::asprintf(format, lowercaseDirection(dir)));
+    };
+    for (auto &dir : ALL_EXITS_NESW) {
+        callback(textures.wall[dir], raw("wall-%s.png", dir));
+    }
+    for (auto &dir : ALL_EXITS_NESWUD) {
+        callback(textures.door[dir], raw("door-%s.png", dir));
+        callback(textures.stream_in[dir], raw("stream-in-%s.png", dir));
+        callback(textures.stream_out[dir], raw("stream-out-%s.png", dir));
     }
+    callback(textures.char_arrows, getPixmapFilenameRaw("char-arrows.png"));
+    callback(textures.char_room_sel, getPixmapFilenameRaw("char-room-sel.png"));
+    callback(textures.exit_climb_down, getPixmapFilenameRaw("exit-climb-down.png"));
+    callback(textures.exit_climb_up, getPixmapFilenameRaw("exit-climb-up.png"));
+    callback(textures.exit_down, getPixmapFilenameRaw("exit-down.png"));
+    callback(textures.exit_up, getPixmapFilenameRaw("exit-up.png"));
+    callback(textures.room_sel, getPixmapFilenameRaw("room-sel.png"));
+    callback(textures.room_sel_distant, getPixmapFilenameRaw("room-sel-distant.png"));
+    callback(textures.room_sel_move_bad, getPixmapFilenameRaw("room-sel-move-bad.png"));
+    callback(textures.room_sel_move_good, getPixmapFilenameRaw("room-sel-move-good.png"));
 }
 
 // Technically only the "minifying" filter can be trilinear.
@@ -200,48 +316,117 @@ static SharedMMTexture createDottedWall(const ExitDirEnum dir)
         QOpenGLTexture::Target::Target2D, [&init](QOpenGLTexture &tex) { return init(tex); }, true);
 }
 
-void MapCanvas::initTextures()
+// The image is composed by TextureStaging; see composeAtlas().
+static SharedMMTexture createAtlas(const std::vector<SharedMMTexture> &members,
+                                   const MipChain &chain)
+{
+    auto atlas = MMTexture::alloc(
+        QOpenGLTexture::Target::Target2D,
+        [&chain](QOpenGLTexture &tex) -> void {
+            ::uploadMipChain(tex, chain);
+            tex.setWrapMode(QOpenGLTexture::WrapMode::ClampToEdge);
+            tex.setMinMagFilters(QOpenGLTexture::Filter::LinearMipMapLinear,
+                                 QOpenGLTexture::Filter::Linear);
+        },
+        false);
+
+    int cell = 0;
+    for (const SharedMMTexture &tex : members) {
+        deref(tex).setAtlas(atlas, cell++);
+    }
+    return atlas;
+}
+
+void MapCanvasTextures::prefetch()
+{
+    std::vector<QString> filenames;
+    std::vector<QString> atlasMembers;
+    // This only collects the names; the textures aren't touched.
+    forEachAtlasPixmap(*this, [&](SharedMMTexture &, const QString &name) -> void {
+        filenames.emplace_back(name);
+        atlasMembers.emplace_back(name);
+    });
+    forEachOtherPixmap(*this, [&filenames](SharedMMTexture &, const QString &name) -> void {
+        filenames.emplace_back(name);
+    });
+    m_staging.start(std::move(filenames), std::move(atlasMembers));
+}
+
+void MapCanvasTextures::loadAll(const OpenGL &gl)
 {
-    MapCanvasTextures &textures = this->m_textures;
+    MapCanvasTextures &textures = *this;
+
+    if (!m_staging.isStarted())
+        prefetch();
+    TextureStaging::Result staged = m_staging.take();
 
-    loadPixmapArray(textures.terrain);
-    loadPixmapArray(textures.road);
-    loadPixmapArray(textures.trail);
-    loadPixmapArray(textures.mob);
-    loadPixmapArray(textures.load);
+    // The compressed levels are dropped where the driver can't sample them.
+    const auto dropUnsupported = [&gl](MipChain &chain) -> void {
+        if (!gl.supportsCompression(chain.compressed.format))
+            chain.compressed = CompressedMips{};
+    };
+    for (auto &image : staged.images) {
+        dropUnsupported(image.second);
+    }
+    dropUnsupported(staged.atlas);
+
+    const auto load = [&staged](SharedMMTexture &tex, const QString &name) -> void {
+        tex = loadTexture(staged.images[name], name);
+    };
+
+    std::vector<SharedMMTexture> members;
+    forEachAtlasPixmap(textures, [&load, &members](SharedMMTexture &tex, const QString &name) {
+        load(tex, name);
+        members.push_back(tex);
+    });
+    forEachOtherPixmap(textures, load);
     for (auto &dir : ALL_EXITS_NESW) {
         textures.dotted_wall[dir] = createDottedWall(dir);
-        textures.wall[dir] = loadTexture(
-            getPixmapFilenameRaw(QString::asprintf("wall-%s.png", lowercaseDirection(dir))));
-    }
-    for (auto &dir : ALL_EXITS_NESWUD) {
-        textures.door[dir] = loadTexture(
-            getPixmapFilenameRaw(QString::asprintf("door-%s.png", lowercaseDirection(dir))));
-        textures.stream_in[dir] = loadTexture(
-            getPixmapFilenameRaw(QString::asprintf("stream-in-%s.png", lowercaseDirection(dir))));
-        textures.stream_out[dir] = loadTexture(
-            getPixmapFilenameRaw(QString::asprintf("stream-out-%s.png", lowercaseDirection(dir))));
     }
-    textures.char_arrows = loadTexture(getPixmapFilenameRaw("char-arrows.png"));
-    textures.char_room_sel = loadTexture(getPixmapFilenameRaw("char-room-sel.png"));
-    textures.exit_climb_down = loadTexture(getPixmapFilenameRaw("exit-climb-down.png"));
-    textures.exit_climb_up = loadTexture(getPixmapFilenameRaw("exit-climb-up.png"));
-    textures.exit_down = loadTexture(getPixmapFilenameRaw("exit-down.png"));
-    textures.exit_up = loadTexture(getPixmapFilenameRaw("exit-up.png"));
-    textures.no_ride = loadTexture(getPixmapFilenameRaw("no-ride.png"));
-    textures.room_sel = loadTexture(getPixmapFilenameRaw("room-sel.png"));
-    textures.room_sel_distant = loadTexture(getPixmapFilenameRaw("room-sel-distant.png"));
-    textures.room_sel_move_bad = loadTexture(getPixmapFilenameRaw("room-sel-move-bad.png"));
-    textures.room_sel_move_good = loadTexture(getPixmapFilenameRaw("room-sel-move-good.png"));
-    textures.update = loadTexture(getPixmapFilenameRaw("update0.png"));
+    textures.atlas = createAtlas(members, staged.atlas);
 
     {
         int priority = 0;
         textures.for_each(
             [&priority](SharedMMTexture &tex) -> void { deref(tex).setPriority(priority++); });
     }
+}
 
+void MapCanvas::initTextures()
+{
+    m_textures.loadAll(getOpenGL());
     updateTextures();
+    publishTextureMemoryUsage();
+}
+
+void MapCanvas::publishTextureMemoryUsage()
+{
+    // The atlas may also be one of the named textures.
+    std::unordered_set<const QOpenGLTexture *> seen;
+    size_t bytes = 0;
+    m_textures.for_each([&seen, &bytes](SharedMMTexture &tex) -> void {
+        const QOpenGLTexture *const qtex = (tex == nullptr) ? nullptr : tex->get();
+        if (qtex == nullptr || !qtex->isStorageAllocated() || !seen.insert(qtex).second)
+            return;
+        // RGBA8 or a compressed format; a full mip chain adds a third.
+        const TextureCompressionEnum compression = [qtex]() -> TextureCompressionEnum {
+            switch (qtex->format()) {
+            case QOpenGLTexture::TextureFormat::RGB_DXT1:
+                return TextureCompressionEnum::BC1;
+            case QOpenGLTexture::TextureFormat::RGBA_DXT5:
+                return TextureCompressionEnum::BC3;
+            default:
+                return TextureCompressionEnum::NONE;
+            }
+        }();
+        size_t texBytes = static_cast<size_t>(
+                              getCompressedSize(compression, qtex->width(), qtex->height()))
+                          * static_cast<size_t>(std::max(1, qtex->layers()));
+        if (qtex->mipLevels() > 1)
+            texBytes += texBytes / 3;
+        bytes += texBytes;
+    });
+    ::publishMemoryUsage("textures", seen.size(), bytes);
 }
 
 void MapCanvas::updateTextures()
@@ -4,6 +4,7 @@
 
 #include <functional>
 #include <memory>
+#include <QImage>
 #include <QOpenGLTexture>
 #include <QString>
 #include <QtGui/qopengl.h>
@@ -12,6 +13,9 @@
 #include "../mapdata/mmapper2room.h"
 #include "../opengl/OpenGLTypes.h"
 #include "RoadIndex.h"
+#include "TextureStaging.h"
+
+class OpenGL;
 
 // currently forward declared in OpenGLTypes.h
 // so it can define SharedMMTexture
@@ -26,6 +30,11 @@ class MMTexture : public std::enable_shared_from_this<MMTexture>
 private:
     // REVISIT: can we store the actual QOpenGLTexture in this object?
     QOpenGLTexture m_qt_texture;
+    QString m_filename;
+    Color m_averageColor;
+    // Set if the image is also packed into MapCanvasTextures::atlas.
+    SharedMMTexture m_atlas;
+    int m_atlasCell = -1;
     int m_priority = -1;
     bool m_forbidUpdates = false;
 
@@ -34,6 +43,10 @@ class MMTexture : public std::enable_shared_from_this<MMTexture>
     {
         return std::make_shared<MMTexture>(this_is_private{0}, name);
     }
+    static std::shared_ptr<MMTexture> alloc(const MipChain &chain, const QString &name)
+    {
+        return std::make_shared<MMTexture>(this_is_private{0}, chain, name);
+    }
     static std::shared_ptr<MMTexture> alloc(const QOpenGLTexture::Target target,
                                             const std::function<void(QOpenGLTexture &)> &init,
                                             const bool forbidUpdates)
@@ -44,6 +57,9 @@ class MMTexture : public std::enable_shared_from_this<MMTexture>
 public:
     MMTexture() = delete;
     MMTexture(this_is_private, const QString &name);
+    MMTexture(this_is_private, const QImage &image, const QString &name);
+    // Uploads the chain's mips instead of generating them.
+    MMTexture(this_is_private, const MipChain &chain, const QString &name);
     MMTexture(this_is_private,
               const QOpenGLTexture::Target target,
               const std::function<void(QOpenGLTexture &)> &init,
@@ -70,8 +86,21 @@ class MMTexture : public std::enable_shared_from_this<MMTexture>
     SharedMMTexture getShared() { return shared_from_this(); }
     MMTexture *getRaw() { return this; }
 
+    // empty unless the texture was loaded from a file
+    const QString &getFilename() const { return m_filename; }
+    // alpha-weighted average of the image; opaque white unless loaded from a file
+    const Color &getAverageColor() const { return m_averageColor; }
+
     int getPriority() const { return m_priority; }
     void setPriority(const int priority) { m_priority = priority; }
+
+    const SharedMMTexture &getAtlas() const { return m_atlas; }
+    int getAtlasCell() const { return m_atlasCell; }
+    void setAtlas(SharedMMTexture atlas, const int cell)
+    {
+        m_atlas = std::move(atlas);
+        m_atlasCell = cell;
+    }
 };
 
 template<typename E>
@@ -91,6 +120,11 @@ struct road_texture_array : private texture_array<RoadIndexMaskEnum>
 
 struct MapCanvasTextures final
 {
+    // Layout of the atlas; the room/atlas vertex shader must agree.
+    static constexpr const int ATLAS_COLUMNS = 16;
+    static constexpr const int ATLAS_ROWS = 8;
+    static constexpr const int ATLAS_CELL_SIZE = 128;
+
     texture_array<RoomTerrainEnum> terrain;
     road_texture_array<RoadTagEnum::ROAD> road;
     road_texture_array<RoadTagEnum::TRAIL> trail;
@@ -113,6 +147,9 @@ struct MapCanvasTextures final
     SharedMMTexture room_sel_move_bad;
     SharedMMTexture room_sel_move_good;
     SharedMMTexture update;
+    // The terrain, road, trail, mob, load, no_ride, and update images,
+    // so a layer's base and overlay quads can each be drawn in one call.
+    SharedMMTexture atlas;
 
     template<typename Callback>
     void for_each(Callback &&callback)
@@ -139,7 +176,17 @@ struct MapCanvasTextures final
         callback(room_sel_move_bad);
         callback(room_sel_move_good);
         callback(update);
+        callback(atlas);
     }
 
+    /// Starts decoding the images on the thread pool; the OpenGL context isn't needed yet.
+    void prefetch();
+    /// Loads every texture; the OpenGL context must be current.
+    /// Waits for prefetch() to finish, or decodes the images itself if it wasn't called;
+    /// the images are uploaded compressed if `gl` supports their formats.
+    void loadAll(const OpenGL &gl);
     void destroyAll();
+
+private:
+    TextureStaging m_staging;
 };
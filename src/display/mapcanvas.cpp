@@ -7,9 +7,11 @@
 #include "mapcanvas.h"
 
 #include <array>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <cstdlib>
 #include <memory>
 #include <stdexcept>
 #include <utility>
@@ -34,6 +36,7 @@
 #include "../mapdata/infomark.h"
 #include "../mapdata/mapdata.h"
 #include "../mapdata/roomselection.h"
+#include "../proxy/ProxyLatencyStats.h"
 #include "InfoMarkSelection.h"
 #include "MapCanvasData.h"
 #include "MapCanvasRoomDrawer.h"
@@ -70,7 +73,17 @@ MapCanvas::MapCanvas(MapData *const mapData,
     grabGesture(Qt::PinchGesture);
     setContextMenuPolicy(Qt::CustomContextMenu);
 
+    m_repaintTimer.setSingleShot(true);
+    connect(&m_repaintTimer, &QTimer::timeout, this, [this]() {
+        if (m_dirtySources != 0)
+            update();
+    });
+    m_gestureSettleTimer.setSingleShot(true);
+    connect(&m_gestureSettleTimer, &QTimer::timeout, this, &MapCanvas::endGesture);
+
     initSurface();
+    // Decode the textures while the rest of the window is set up; see initTextures().
+    m_textures.prefetch();
 }
 
 MapCanvas::~MapCanvas()
@@ -150,7 +163,7 @@ void MapCanvas::setRoomSelection(const SigRoomSelection &selection)
         m_roomSelection = selection.getShared();
         qDebug() << "Updated selection with" << m_roomSelection->size() << "rooms";
         if (m_roomSelection->size() == 1) {
-            const Room *const r = m_roomSelection->first();
+            const Room *const r = m_roomSelection->getFirstRoom();
             const Coordinate &roomPos = r->getPosition();
             const auto x = roomPos.x;
             const auto y = roomPos.y;
@@ -163,6 +176,7 @@ void MapCanvas::setRoomSelection(const SigRoomSelection &selection)
     } else {
         m_roomSelection.reset();
     }
+    m_batches.selectedRoomMeshes.reset();
 
     // Let the MainWindow know
     emit newRoomSelection(selection);
@@ -189,6 +203,7 @@ void MapCanvas::setInfoMarkSelection(const std::shared_ptr<InfoMarkSelection> &s
         m_infoMarkSelection = selection;
     }
 
+    m_batches.selectedInfomarksMeshes.reset();
     emit newInfoMarkSelection(m_infoMarkSelection.get());
     selectionChanged();
 }
@@ -268,9 +283,10 @@ void MapCanvas::wheelEvent(QWheelEvent *const event)
             // Change the zoom level
             const int numSteps = event->angleDelta().y() / 120;
             if (numSteps != 0) {
+                beginGesture();
                 zoomAndMaybeRecenter(numSteps);
                 zoomChanged();
-                resizeGL();
+                scrollChanged();
             }
         }
         break;
@@ -325,8 +341,11 @@ bool MapCanvas::event(QEvent *const event)
         if (pinch->state() == Qt::GestureFinished) {
             m_scaleFactor.endPinch();
             zoomChanged(); // might not have actualy changed
+            endGesture();
+        } else {
+            beginGesture();
         }
-        resizeGL();
+        scrollChanged();
         return true;
     };
 
@@ -342,7 +361,7 @@ void MapCanvas::createRoom()
         return;
     const Coordinate c = getSel1().getCoordinate();
     RoomSelection tmpSel = RoomSelection(m_data, c);
-    if (tmpSel.isEmpty()) {
+    if (tmpSel.empty()) {
         m_data.createEmptyRoom(Coordinate{c.x, c.y, m_currentLayer});
     }
     mapChanged();
@@ -461,6 +480,18 @@ void MapCanvas::mousePressEvent(QMouseEvent *const event)
 
     case CanvasMouseModeEnum::RAYPICK_ROOMS:
         if (hasLeftButton) {
+            // The room that's drawn under the mouse, if the picking buffer works;
+            // walking the ray would also find the rooms hidden behind it.
+            if (const std::optional<RoomId> picked = pickRoom(event->pos())) {
+                if (picked.value() != INVALID_ROOMID) {
+                    const auto tmpSel = RoomSelection::createSelection(m_data);
+                    if (tmpSel->getRoom(picked.value()) != nullptr)
+                        setRoomSelection(SigRoomSelection(tmpSel));
+                }
+                selectionChanged();
+                break;
+            }
+
             const auto xy = getMouseCoords(event);
             const auto near = unproject_raw(glm::vec3{xy, 0.f});
             const auto far = unproject_raw(glm::vec3{xy, 1.f});
@@ -520,8 +551,8 @@ void MapCanvas::mousePressEvent(QMouseEvent *const event)
             if (!hasCtrl) {
                 const auto tmpSel = RoomSelection::createSelection(m_data,
                                                                    getSel1().getCoordinate());
-                if ((m_roomSelection != nullptr) && !tmpSel->isEmpty()
-                    && m_roomSelection->contains(tmpSel->begin().key())) {
+                if ((m_roomSelection != nullptr) && !tmpSel->empty()
+                    && m_roomSelection->contains(tmpSel->getFirstRoomId())) {
                     m_roomSelectionMove.emplace(RoomSelMove{});
                 } else {
                     m_roomSelectionMove.reset();
@@ -615,6 +646,8 @@ void MapCanvas::mouseMoveEvent(QMouseEvent *const event)
             }
         }();
 
+        if (hScroll != 0 || vScroll != 0)
+            beginGesture();
         emit sig_continuousScroll(hScroll, vScroll);
     }
 
@@ -645,6 +678,7 @@ void MapCanvas::mouseMoveEvent(QMouseEvent *const event)
             const Coordinate2i delta
                 = ((getSel2().pos - getBackup().pos) * static_cast<float>(SCROLL_SCALE)).truncate();
             if (delta.x != 0 || delta.y != 0) {
+                beginGesture();
                 // negated because dragging to right is scrolling to the left.
                 emit sig_mapMove(-delta.x, -delta.y);
             }
@@ -712,6 +746,7 @@ void MapCanvas::mouseMoveEvent(QMouseEvent *const event)
 void MapCanvas::mouseReleaseEvent(QMouseEvent *const event)
 {
     emit sig_continuousScroll(0, 0);
+    endGesture();
     m_sel2 = getUnprojectedMouseSel(event);
 
     if (m_mouseRightPressed) {
@@ -780,7 +815,7 @@ void MapCanvas::mouseReleaseEvent(QMouseEvent *const event)
         // Display a room info tooltip if there was no mouse movement
         if (hasSel1() && hasSel2() && getSel1().to_vec3() == getSel2().to_vec3()) {
             RoomSelection tmpSel = RoomSelection(m_data, getSel1().getCoordinate());
-            if (!tmpSel.isEmpty()) {
+            if (!tmpSel.empty()) {
                 QString message = tmpSel.getFirstRoom()->toQString();
                 QToolTip::showText(mapToGlobal(event->pos()), message, this, rect(), 5000);
             }
@@ -824,7 +859,7 @@ void MapCanvas::mouseReleaseEvent(QMouseEvent *const event)
                     } else {
                         // add or remove rooms to/from default selection
                         const auto tmpSel = RoomSelection(m_data, c1, c2);
-                        for (const RoomId &key : tmpSel.keys()) {
+                        for (const RoomId key : tmpSel.getRoomIds()) {
                             if (m_roomSelection->contains(key)) {
                                 m_roomSelection->unselect(key);
                             } else {
@@ -938,20 +973,60 @@ QSize MapCanvas::sizeHint() const
 
 void MapCanvas::setScroll(const glm::vec2 &worldPos)
 {
+    if (worldPos == m_scroll)
+        return;
     m_scroll = worldPos;
-    resizeGL();
+    scrollChanged();
 }
 
 void MapCanvas::setHorizontalScroll(const float worldX)
 {
+    if (utils::equals(worldX, m_scroll.x))
+        return;
     m_scroll.x = worldX;
-    resizeGL();
+    scrollChanged();
 }
 
 void MapCanvas::setVerticalScroll(const float worldY)
 {
+    if (utils::equals(worldY, m_scroll.y))
+        return;
     m_scroll.y = worldY;
-    resizeGL();
+    scrollChanged();
+}
+
+void MapCanvas::scrollChanged()
+{
+    if (m_textures.update == nullptr) {
+        // initializeGL was not called yet
+        return;
+    }
+
+    // Dragging and continuous scrolling move the view on every mouse event
+    // or timer tick, so they're drawn at most once per animation frame.
+    setViewportAndMvp(width(), height());
+    if (m_gestureActive)
+        m_gestureSettleTimer.start(GESTURE_SETTLE_MS);
+    requestRepaint(RepaintSourceEnum::ANIMATION);
+}
+
+/// Called on the input that pans or zooms the view; the gesture lasts until the view
+/// hasn't moved for GESTURE_SETTLE_MS (e.g. continuous scrolling keeps it going).
+void MapCanvas::beginGesture()
+{
+    m_gestureActive = true;
+    m_gestureSettleTimer.start(GESTURE_SETTLE_MS);
+}
+
+void MapCanvas::endGesture()
+{
+    m_gestureSettleTimer.stop();
+    if (!m_gestureActive)
+        return;
+    m_gestureActive = false;
+    m_gestureFrame.invalidate();
+    // The frame is drawn at full quality again.
+    requestRepaint(RepaintSourceEnum::MAP);
 }
 
 void MapCanvas::zoomIn()
@@ -994,7 +1069,7 @@ void MapCanvas::moveMarker(const Coordinate &c)
     {
         // REVISIT: is the makeCurrent necessary for calling update()?
         // MakeCurrentRaii makeCurrentRaii{*this};
-        update();
+        requestRepaint(RepaintSourceEnum::MAP);
     }
 
     emit sig_onCenter(c.to_vec2() + glm::vec2{0.5f, 0.5f});
@@ -1002,32 +1077,83 @@ void MapCanvas::moveMarker(const Coordinate &c)
 
 void MapCanvas::infomarksChanged()
 {
-    m_batches.infomarksMeshes.reset();
-    update();
+    // MapData tracks which markers changed, so only their cells are rebuilt.
+    m_batches.selectedInfomarksMeshes.reset();
+    requestRepaint(RepaintSourceEnum::MAP);
 }
 
 void MapCanvas::layerChanged()
 {
-    update();
+    requestRepaint(RepaintSourceEnum::MAP);
 }
 
 void MapCanvas::mapAndInfomarksChanged()
 {
-    m_batches.resetAll();
-    update();
+    // The old map is drawn until the new batches are ready.
+    m_batches.infomarksMeshes.reset();
+    m_batches.resetSelections();
+    m_groupCharacters.reset();
+    invalidateMapBatches();
+    requestRepaint(RepaintSourceEnum::MAP);
 }
 
 void MapCanvas::mapChanged()
 {
     // REVISIT: Ideally we'd want to only update the layers/chunks
     // that actually changed.
-    m_batches.mapBatches.reset();
-    update();
+    invalidateMapBatches();
+    // The selected rooms may have moved.
+    m_batches.selectedRoomMeshes.reset();
+    // ... and so may the group's characters.
+    m_groupCharacters.reset();
+    requestRepaint(RepaintSourceEnum::MAP);
 }
 
 void MapCanvas::requestUpdate()
 {
-    update();
+    requestRepaint(RepaintSourceEnum::MAP);
+}
+
+void MapCanvas::groupChanged()
+{
+    m_groupCharacters.reset();
+    requestRepaint(RepaintSourceEnum::GROUP);
+}
+
+/// MAP and SELECTION requests are drawn on the next frame; the others may
+/// arrive many times a second while nothing else changes, so they're limited
+/// to one repaint per interval, counted from the last paint. Requests made
+/// while a repaint is already pending are coalesced into it.
+void MapCanvas::requestRepaint(const RepaintSourceEnum source)
+{
+    m_dirtySources = static_cast<uint8_t>(m_dirtySources | (1u << static_cast<int>(source)));
+    if (source == RepaintSourceEnum::MAP)
+        getProxyLatencyStats().onRepaintRequested();
+
+    const std::chrono::milliseconds interval = [source]() {
+        switch (source) {
+        case RepaintSourceEnum::MAP:
+        case RepaintSourceEnum::SELECTION:
+            return std::chrono::milliseconds{0};
+        case RepaintSourceEnum::ANIMATION:
+            return std::chrono::milliseconds{16};
+        case RepaintSourceEnum::GROUP:
+            return std::chrono::milliseconds{100};
+        }
+        std::abort();
+    }();
+
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - m_lastPaint);
+    if (elapsed >= interval) {
+        m_repaintTimer.stop();
+        update();
+        return;
+    }
+
+    const auto delay = static_cast<int>((interval - elapsed).count());
+    if (!m_repaintTimer.isActive() || m_repaintTimer.remainingTime() > delay)
+        m_repaintTimer.start(delay);
 }
 
 void MapCanvas::screenChanged()
@@ -1037,23 +1163,24 @@ void MapCanvas::screenChanged()
     const auto oldDpi = gl.getDevicePixelRatio();
     if (!utils::equals(newDpi, oldDpi)) {
         emit log("MapCanvas", QString("Display: %1 DPI").arg(static_cast<double>(newDpi)));
+        invalidateMapBatches();
         m_batches.resetAll();
+        // The font atlas serves every DPI; the text is just scaled.
         gl.setDevicePixelRatio(newDpi);
-        auto &font = getGLFont();
-        font.cleanup();
-        font.init();
-        update();
+        requestRepaint(RepaintSourceEnum::MAP);
     }
 }
 
 void MapCanvas::selectionChanged()
 {
-    update();
+    requestRepaint(RepaintSourceEnum::SELECTION);
 }
 
 void MapCanvas::graphicsSettingsChanged()
 {
-    update();
+    if (m_batches.mapBatches.has_value())
+        m_batches.mapBatches->lowerLayers.invalidate();
+    requestRepaint(RepaintSourceEnum::MAP);
 }
 
 void MapCanvas::userPressedEscape(bool /*pressed*/)
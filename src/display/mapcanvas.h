@@ -6,6 +6,7 @@
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
 #include <array>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <glm/glm.hpp>
@@ -21,16 +22,21 @@
 #include <QOpenGLWidget>
 #include <QtCore>
 
+#include "../global/BackgroundJob.h"
+#include "../mapdata/MapSnapshot.h"
 #include "../mapdata/roomselection.h"
 #include "../opengl/Font.h"
 #include "../opengl/FontFormatFlags.h"
 #include "../opengl/OpenGL.h"
+#include "Characters.h"
+#include "FrameBudget.h"
+#include "GestureFrame.h"
 #include "Infomarks.h"
 #include "MapCanvasData.h"
 #include "MapCanvasRoomDrawer.h"
+#include "PickingBuffer.h"
 #include "Textures.h"
 
-class CharacterBatch;
 class ConnectionSelection;
 class Coordinate;
 class InfoMark;
@@ -58,8 +64,53 @@ class MapCanvas final : public QOpenGLWidget, private MapCanvasViewport, private
     Batches m_batches;
     MapCanvasTextures m_textures;
     MapData &m_data;
+    // Only drawn when something asks which room is under the mouse; see pickRoom().
+    PickingBuffer m_pickingBuffer;
+    // While the view is dragged, scrolled or zoomed, frames that only move the view are
+    // drawn from this; the map is drawn in full again once the view has been still for
+    // GESTURE_SETTLE_MS. See beginGesture().
+    static constexpr const int GESTURE_SETTLE_MS = 200;
+    GestureFrame m_gestureFrame;
+    QTimer m_gestureSettleTimer;
+    bool m_gestureActive = false;
+
+    // Meshes are built from a snapshot on a worker, one job at a time, while
+    // the previous batches are still drawn; they're uploaded on the next paint.
+    enum class MeshJobEnum { UPDATE, PREFETCH };
+    BackgroundJob m_meshJob{*this};
+    SharedMapBatchesData m_pendingMapBatches;
+    // Built around where the view is headed, to replace the batches once the
+    // view leaves their redrawMargin.
+    SharedMapBatchesData m_prefetchedMapBatches;
+    bool m_meshJobRunning = false;
+    MeshJobEnum m_meshJobType = MeshJobEnum::UPDATE;
+    // The batches no longer match the map and have to be rebuilt from scratch.
+    bool m_mapBatchesStale = true;
 
     Mmapper2Group *m_groupManager = nullptr;
+    // Where the group's characters are; looked up again when the group or the map changes.
+    std::optional<std::vector<GroupCharacterPosition>> m_groupCharacters;
+
+    // Repaint requests are coalesced, and sources that can change many times
+    // a second are held to a frame budget (see requestRepaint()), so an idle
+    // canvas doesn't repaint at all.
+    enum class RepaintSourceEnum : uint8_t { MAP, GROUP, SELECTION, ANIMATION };
+    QTimer m_repaintTimer;
+    uint8_t m_dirtySources = 0;
+    std::chrono::steady_clock::time_point m_lastPaint;
+    // The vertex buffers' size when it was last published; see publishBufferMemoryUsage().
+    size_t m_publishedBufferBytes = 0;
+    // Lowers the quality while frames are slow, if the adaptive quality setting is on.
+    FrameBudget m_frameBudget;
+
+    // CPU time of each phase of actuallyPaintGL(), for the perf stats.
+    struct PaintTimes final
+    {
+        double paintMap = 0.0;
+        double paintBatchedInfomarks = 0.0;
+        double paintSelections = 0.0;
+        double paintCharacters = 0.0;
+    };
     struct OptionStatus final
     {
         std::optional<int> multisampling;
@@ -80,6 +131,9 @@ class MapCanvas final : public QOpenGLWidget, private MapCanvasViewport, private
     inline auto &getOpenGL() { return m_opengl; }
     inline auto &getGLFont() { return m_glFont; }
     void cleanupOpenGL();
+    // The room drawn under `pos` (in widget coordinates), or INVALID_ROOMID;
+    // nothing if the picking buffer isn't available.
+    NODISCARD std::optional<RoomId> pickRoom(const QPoint &pos);
 
     void initSurface();
 
@@ -137,6 +191,8 @@ public slots:
 
     void dataLoaded();
     void moveMarker(const Coordinate &);
+    // characters and the prespammed path
+    void groupChanged();
 
     void slot_onMessageLoggedDirect(const QOpenGLDebugMessage &message);
 
@@ -163,7 +219,8 @@ public slots:
     void initializeGL() override;
     void paintGL() override;
 
-    void drawGroupCharacters(CharacterBatch &characterBatch);
+    void paintGroupCharacters(const Coordinate &pos);
+    NODISCARD std::vector<GroupCharacterPosition> getGroupCharacters();
 
     void resizeGL(int width, int height) override;
     void mousePressEvent(QMouseEvent *event) override;
@@ -177,9 +234,18 @@ public slots:
     void initLogger();
 
     void resizeGL() { resizeGL(width(), height()); }
+    void scrollChanged();
+    void beginGesture();
+    void endGesture();
+    void requestRepaint(RepaintSourceEnum source);
     void initTextures();
     void updateTextures();
+    // The GPU's share of the memory report (see MemoryUsage), which other threads can't
+    // ask the canvas for.
+    void publishTextureMemoryUsage();
+    void publishBufferMemoryUsage();
     void updateMultisampling();
+    void updateFrameBudget(double cpuMs, std::optional<double> gpuMs);
 
     std::shared_ptr<InfoMarkSelection> getInfoMarkSelection(const MouseSel &sel);
     static glm::mat4 getViewProj_old(const glm::vec2 &scrollPos,
@@ -193,7 +259,7 @@ public slots:
     void setMvp(const glm::mat4 &viewProj);
     void setViewportAndMvp(int width, int height);
 
-    BatchedInfomarksMeshes getInfoMarksMeshes();
+    std::optional<InfomarksTile> getInfoMarksTile(const InfoMarkIndex::CellId &cell);
     void drawInfoMark(InfomarksBatch &batch,
                       InfoMark *marker,
                       int currentLayer,
@@ -201,9 +267,21 @@ public slots:
                       const std::optional<Color> &overrideColor = std::nullopt);
     void updateBatches();
     void updateMapBatches();
+    void startMeshJob(MeshJobEnum type,
+                      SharedMapSnapshot snapshot,
+                      OptBounds bounds,
+                      OptBounds redrawMargin,
+                      std::optional<std::set<MapTileId>> tiles);
+    void prefetchMapBatches(const Coordinate &center);
+    void discardPrefetchedMapBatches();
+    void invalidateMapBatches();
     void updateInfomarkBatches();
 
-    void actuallyPaintGL();
+    void actuallyPaintGL(PaintTimes *times = nullptr);
+    void paintScene(PaintTimes *times);
+    // Draws the scene into the gesture frame and then the frame; returns false if there's
+    // no frame, in which case the caller should draw the scene.
+    NODISCARD bool paintSceneIntoGestureFrame(PaintTimes *times);
     void paintMap();
     void renderMapBatches();
     void paintBatchedInfomarks();
@@ -211,7 +289,7 @@ public slots:
     void paintSelectionArea();
     void paintNewInfomarkSelection();
     void paintSelectedRooms();
-    void paintSelectedRoom(RoomSelFakeGL &, const Room &room);
+    void paintDistantSelectedRoom(RoomSelFakeGL &, const Room &room);
     void paintSelectedConnection();
     void paintNearbyConnectionPoints();
     void paintSelectedInfoMarks();
@@ -34,13 +34,16 @@
 #include "../global/Array.h"
 #include "../global/ChangeMonitor.h"
 #include "../global/Debug.h"
+#include "../global/MemoryUsage.h"
 #include "../global/RuleOf5.h"
+#include "../global/Trace.h"
 #include "../global/utils.h"
 #include "../mapdata/mapdata.h"
 #include "../opengl/Font.h"
 #include "../opengl/FontFormatFlags.h"
 #include "../opengl/OpenGL.h"
 #include "../opengl/OpenGLTypes.h"
+#include "../proxy/ProxyLatencyStats.h"
 #include "Connections.h"
 #include "MapCanvasConfig.h"
 #include "MapCanvasData.h"
@@ -85,6 +88,21 @@ void setShowPerfStats(const bool show)
     setConfig().canvas.advanced.printPerfStats.set(show);
 }
 
+bool getLogPerfStats()
+{
+    return getConfig().canvas.advanced.logPerfStats.get();
+}
+
+bool isAdaptiveQuality()
+{
+    return getConfig().canvas.advanced.adaptiveQuality.get();
+}
+
+void setAdaptiveQuality(const bool val)
+{
+    setConfig().canvas.advanced.adaptiveQuality.set(val);
+}
+
 } // namespace MapCanvasConfig
 
 class NODISCARD MakeCurrentRaii final
@@ -109,15 +127,34 @@ void MapCanvas::cleanupOpenGL()
     // destroy all underlying OpenGL resources.
     MakeCurrentRaii makeCurrentRaii{*this};
 
+    // The mesh worker reads the textures, and its results co-own them.
+    invalidateMapBatches();
+    m_meshJob.wait();
+
     // note: m_batchedMeshes co-owns textures created by MapCanvasData,
     // and it also owns the lifetime of some OpenGL objects (e.g. VBOs).
     m_batches.resetAll();
+    m_pickingBuffer.destroy();
+    m_gestureFrame.destroy();
     m_textures.destroyAll();
     getGLFont().cleanup();
     getOpenGL().cleanup();
     m_logger.reset();
 }
 
+std::optional<RoomId> MapCanvas::pickRoom(const QPoint &pos)
+{
+    MakeCurrentRaii makeCurrentRaii{*this};
+    auto &gl = getOpenGL();
+    const SharedMapSnapshot snapshot = m_data.getSnapshot();
+    const float dpr = gl.getDevicePixelRatio();
+    if (!m_pickingBuffer.update(gl, *this, deref(snapshot), dpr))
+        return std::nullopt;
+
+    const QPointF scaled = QPointF{pos} * static_cast<qreal>(dpr);
+    return m_pickingBuffer.pick(scaled.toPoint());
+}
+
 /// Must be called from constructor;
 /// initializeGL() will fail if you forget to call this.
 void MapCanvas::initSurface()
@@ -132,6 +169,16 @@ void MapCanvas::initSurface()
     const int samples = getAaSamples();
     QSurfaceFormat format;
     format.setSamples(samples);
+    if (!getConfig().canvas.legacyOpenGL) {
+        // If the driver can't do this, it still gives us a context, and
+        // initializeGL() picks the legacy renderer for it.
+        if (QOpenGLContext::openGLModuleType() == QOpenGLContext::LibGLES) {
+            format.setVersion(3, 0);
+        } else {
+            format.setVersion(3, 3);
+            format.setProfile(QSurfaceFormat::CoreProfile);
+        }
+    }
     setFormat(format);
 }
 
@@ -164,6 +211,8 @@ void MapCanvas::reportGLVersion()
                .arg(context()->isValid() ? "valid" : "invalid")
                .toUtf8());
     logMsg("Display:", QString("%1 DPI").arg(QPaintDevice::devicePixelRatioF()).toUtf8());
+    const bool isCore = gl.getBackend() == RendererBackendEnum::CORE;
+    logMsg("Renderer:", isCore ? "GL 3.3 core / ES 3.0" : "GL 2.0 / ES 2.0 (legacy)");
 }
 
 bool MapCanvas::isBlacklistedDriver()
@@ -188,6 +237,7 @@ void MapCanvas::initializeGL()
 {
     auto &gl = getOpenGL();
     gl.initializeOpenGLFunctions();
+    gl.initializeBackend(!getConfig().canvas.legacyOpenGL);
 
     reportGLVersion();
 
@@ -410,79 +460,298 @@ void MapCanvas::resizeGL(int width, int height)
     setViewportAndMvp(width, height);
 
     // Render
-    update();
+    requestRepaint(RepaintSourceEnum::MAP);
 }
 
 void MapCanvas::updateBatches()
 {
+    MMAPPER_TRACE_SCOPE("MapCanvas::updateBatches");
     updateMapBatches();
     updateInfomarkBatches();
 }
 
-void MapCanvas::updateMapBatches()
+struct NODISCARD MapBatchArea final
 {
-    if (m_data.getNeedsMapUpdate()) {
-        m_batches.mapBatches.reset();
-        m_data.clearNeedsMapUpdate();
-        assert(!m_data.getNeedsMapUpdate());
-    }
+    OptBounds bounds;
+    OptBounds redrawMargin;
+};
+
+static MapBatchArea getMapBatchArea(const Coordinate &center)
+{
+    const auto radius = []() -> Coordinate {
+        const auto &r = getConfig().canvas.mapRadius;
+        return Coordinate{r[0], r[1], r[2]};
+    }();
 
+    // TODO: allow unrestricted map if there hasn't been a map update or movement within N seconds.
+    // This could be done by using a timer to increment a counter on mapBatches,
+    // and then reset the counter if the player moves.
+    const bool restrict = []() -> bool {
+        const Configuration &config = getConfig();
+        switch (config.canvas.useRestrictedMap) {
+        case RestrictMapEnum::Never:
+            return false;
+        case RestrictMapEnum::Always:
+            return true;
+        case RestrictMapEnum::OnlyInMapMode:
+            return config.general.mapMode == MapModeEnum::MAP;
+        }
+        std::abort();
+    }();
+
+    if (!restrict)
+        return MapBatchArea{};
+
+    return MapBatchArea{OptBounds::fromCenterRadius(center, radius),
+                        OptBounds::fromCenterRadius(center, radius * 3 / 4)};
+}
+
+void MapCanvas::updateMapBatches()
+{
     const Coordinate &center = [this]() {
         const auto &screenCenter = m_mapScreen.getCenter();
         return Coordinate{static_cast<int>(screenCenter.x),
                           static_cast<int>(screenCenter.y),
                           m_currentLayer};
     }();
+
     std::optional<MapBatches> &opt_mapBatches = m_batches.mapBatches;
-    if (opt_mapBatches && opt_mapBatches->redrawMargin.contains(center)) {
+    if (m_data.getNeedsMapUpdate()) {
+        // The prefetched batches wouldn't have the changes.
+        discardPrefetchedMapBatches();
+    }
+
+    // Crossing the margin just swaps in the batches that were built ahead of time.
+    if (m_pendingMapBatches == nullptr && m_prefetchedMapBatches != nullptr && opt_mapBatches
+        && !m_mapBatchesStale && !opt_mapBatches->redrawMargin.contains(center)
+        && m_prefetchedMapBatches->redrawMargin.contains(center)) {
+        m_pendingMapBatches = std::exchange(m_prefetchedMapBatches, nullptr);
+    }
+
+    if (const SharedMapBatchesData pending = std::exchange(m_pendingMapBatches, nullptr)) {
+        MapCanvasRoomDrawer drawer{static_cast<MapCanvasViewport &>(*this),
+                                   m_textures,
+                                   getOpenGL(),
+                                   getGLFont(),
+                                   opt_mapBatches};
+        drawer.applyBatches(*pending);
+    }
+
+    // Anything that changes in the meantime is picked up once the job is done.
+    if (m_meshJobRunning)
+        return;
+
+    const bool withinMargin = opt_mapBatches && !m_mapBatchesStale
+                              && opt_mapBatches->redrawMargin.contains(center);
+    if (withinMargin && !m_data.getNeedsMapUpdate()) {
+        prefetchMapBatches(center);
         return;
     }
 
-    const auto radius = []() -> Coordinate {
-        const auto &r = getConfig().canvas.mapRadius;
-        return Coordinate{r[0], r[1], r[2]};
-    }();
+    m_data.clearNeedsMapUpdate();
+    assert(!m_data.getNeedsMapUpdate());
+
+    // The changes have to be taken before the snapshot they're applied to.
+    const std::optional<RoomIdSet> changes = m_data.takeMeshChanges();
+    SharedMapSnapshot snapshot = m_data.getSnapshot();
+
+    if (withinMargin && changes.has_value()) {
+        MapCanvasRoomDrawer drawer{static_cast<MapCanvasViewport &>(*this),
+                                   m_textures,
+                                   getOpenGL(),
+                                   getGLFont(),
+                                   opt_mapBatches};
+
+        /// Only rebuilds the tiles of the rooms that changed.
+        std::set<MapTileId> tiles = drawer.takeDirtyTiles(changes.value(), deref(snapshot));
+        if (!tiles.empty()) {
+            startMeshJob(MeshJobEnum::UPDATE,
+                         std::move(snapshot),
+                         opt_mapBatches->bounds,
+                         opt_mapBatches->redrawMargin,
+                         std::move(tiles));
+        }
+        return;
+    }
 
-    const OptBounds bounds = [&center, &radius]() -> OptBounds {
-        // TODO: allow unrestricted map if there hasn't been a map update or movement within N seconds.
-        // This could be done by using a timer to increment a counter on mapBatches,
-        // and then reset the counter if the player moves.
-        const bool restrict = []() -> bool {
-            const Configuration &config = getConfig();
-            switch (config.canvas.useRestrictedMap) {
-            case RestrictMapEnum::Never:
-                return false;
-            case RestrictMapEnum::Always:
-                return true;
-            case RestrictMapEnum::OnlyInMapMode:
-                return config.general.mapMode == MapModeEnum::MAP;
-            }
-            std::abort();
-        }();
+    // Whatever was prefetched was meant to follow the batches being replaced.
+    discardPrefetchedMapBatches();
 
-        return restrict                                          //
-                   ? OptBounds::fromCenterRadius(center, radius) //
-                   : OptBounds{};                                //
-    }();
+    if (withinMargin) {
+        // Too many changes to track; rebuild everything for the same area.
+        startMeshJob(MeshJobEnum::UPDATE,
+                     std::move(snapshot),
+                     opt_mapBatches->bounds,
+                     opt_mapBatches->redrawMargin,
+                     std::nullopt);
+        return;
+    }
 
-    MapCanvasRoomDrawer drawer{static_cast<MapCanvasViewport &>(*this),
-                               m_textures,
-                               getOpenGL(),
-                               getGLFont(),
-                               opt_mapBatches};
+    const MapBatchArea area = getMapBatchArea(center);
+    m_mapBatchesStale = false;
+    startMeshJob(MeshJobEnum::UPDATE,
+                 std::move(snapshot),
+                 area.bounds,
+                 area.redrawMargin,
+                 std::nullopt);
+}
+
+void MapCanvas::prefetchMapBatches(const Coordinate &center)
+{
+    const MapBatches &batches = m_batches.mapBatches.value();
+    if (m_prefetchedMapBatches != nullptr || !batches.redrawMargin.isRestricted())
+        return;
+
+    // The distance from the center the batches were built around is the best
+    // guess of where the view is headed, whether it follows the player or is
+    // being scrolled.
+    const Bounds &margin = batches.redrawMargin.getBounds();
+    const glm::ivec2 size = margin.max.to_ivec2() - margin.min.to_ivec2();
+    const glm::ivec2 offset = 2 * center.to_ivec2() - margin.min.to_ivec2()
+                              - margin.max.to_ivec2();
 
-    /// The following ends up calling MapCanvasRoomDrawer::generateBatches()
-    m_data.generateBatches(drawer, bounds);
+    // Wait until the view has covered half of the way to the margin.
+    if (2 * std::abs(offset.x) < size.x && 2 * std::abs(offset.y) < size.y)
+        return;
+
+    const glm::ivec2 ahead = center.to_ivec2() + offset / 2;
+    const MapBatchArea area = getMapBatchArea(Coordinate{ahead.x, ahead.y, center.z});
+    if (!area.bounds.isRestricted())
+        return;
+
+    startMeshJob(MeshJobEnum::PREFETCH,
+                 m_data.getSnapshot(),
+                 area.bounds,
+                 area.redrawMargin,
+                 std::nullopt);
+}
 
-    if (bounds.isRestricted()) {
-        m_batches.mapBatches->redrawMargin = OptBounds::fromCenterRadius(center, radius * 3 / 4);
+void MapCanvas::discardPrefetchedMapBatches()
+{
+    m_prefetchedMapBatches.reset();
+    if (m_meshJobRunning && m_meshJobType == MeshJobEnum::PREFETCH) {
+        // Unlike an update, nothing is lost by cancelling a prefetch.
+        m_meshJob.cancel();
+        m_meshJobRunning = false;
     }
 }
 
-void MapCanvas::actuallyPaintGL()
+void MapCanvas::startMeshJob(const MeshJobEnum type,
+                             SharedMapSnapshot snapshot,
+                             OptBounds bounds,
+                             OptBounds redrawMargin,
+                             std::optional<std::set<MapTileId>> tiles)
+{
+    m_meshJobRunning = true;
+    m_meshJobType = type;
+    m_meshJob.start([this,
+                     snapshot = std::move(snapshot),
+                     bounds = std::move(bounds),
+                     redrawMargin = std::move(redrawMargin),
+                     tiles = std::move(tiles)](const BackgroundJob::Token &token) {
+        MMAPPER_TRACE_SCOPE("MapCanvas meshes");
+        const auto isCancelled = [&token]() -> bool { return token.isCancelled(); };
+        SharedMapBatchesData data;
+        try {
+            if (tiles.has_value()) {
+                data = MapCanvasRoomDrawer::buildTiles(deref(snapshot),
+                                                       m_textures,
+                                                       bounds,
+                                                       tiles.value(),
+                                                       isCancelled);
+            } else {
+                data = MapCanvasRoomDrawer::buildBatches(deref(snapshot),
+                                                         m_textures,
+                                                         bounds,
+                                                         isCancelled);
+                if (data != nullptr)
+                    data->redrawMargin = redrawMargin;
+            }
+        } catch (const std::exception &ex) {
+            qWarning() << "Exception while building the map meshes:" << ex.what();
+        }
+
+        // Nothing is delivered if the job was cancelled.
+        token.post([this, type, data]() {
+            m_meshJobRunning = false;
+            if (type == MeshJobEnum::PREFETCH) {
+                // Kept until the view crosses the margin, which may have already happened.
+                m_prefetchedMapBatches = data;
+                // Only worth a repaint if the view already left the margin.
+                const auto &batches = m_batches.mapBatches;
+                const auto &center = m_mapScreen.getCenter();
+                if (batches.has_value()
+                    && !batches->redrawMargin.contains(Coordinate{static_cast<int>(center.x),
+                                                                  static_cast<int>(center.y),
+                                                                  m_currentLayer}))
+                    requestRepaint(RepaintSourceEnum::MAP);
+                return;
+            }
+            if (data == nullptr) {
+                // Start over the next time the map is painted.
+                m_mapBatchesStale = true;
+                return;
+            }
+            m_pendingMapBatches = data;
+            requestRepaint(RepaintSourceEnum::MAP);
+        });
+    });
+}
+
+void MapCanvas::invalidateMapBatches()
 {
+    // A job that's still running was started for data that's now out of date.
+    m_meshJob.cancel();
+    m_meshJobRunning = false;
+    m_pendingMapBatches.reset();
+    m_prefetchedMapBatches.reset();
+    m_mapBatchesStale = true;
+}
+
+using PerfClock = std::chrono::high_resolution_clock;
+
+NODISCARD static double toMs(const PerfClock::duration delta)
+{
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(delta).count()) * 1e-6;
+}
+
+void MapCanvas::actuallyPaintGL(PaintTimes *const times)
+{
+    MMAPPER_TRACE_SCOPE("MapCanvas::actuallyPaintGL");
     setViewportAndMvp(width(), height());
 
+    if (m_gestureActive && paintSceneIntoGestureFrame(times))
+        return;
+    paintScene(times);
+}
+
+bool MapCanvas::paintSceneIntoGestureFrame(PaintTimes *const times)
+{
+    auto &gl = getOpenGL();
+    const glm::mat4 viewProj = m_viewProj;
+    const glm::mat4 frameViewProj = GestureFrame::getFrameViewProj(viewProj);
+    const glm::ivec2 frameSize = GestureFrame::getFrameSize(glm::ivec2{width(), height()});
+
+    gl.glViewport(0, 0, frameSize.x, frameSize.y);
+    if (!m_gestureFrame.begin(gl.getPhysicalViewport().size)) {
+        setViewportAndMvp(width(), height());
+        return false;
+    }
+    setMvp(frameViewProj);
+    paintScene(times);
+    gl.resetBindings();
+    m_gestureFrame.end(frameViewProj, m_currentLayer);
+
+    setViewportAndMvp(width(), height());
+    if (!m_gestureFrame.isValid())
+        return false;
+    gl.clear(Color{getConfig().canvas.backgroundColor});
+    m_gestureFrame.composite(gl);
+    return true;
+}
+
+void MapCanvas::paintScene(PaintTimes *const times)
+{
     auto &gl = getOpenGL();
     gl.clear(Color{getConfig().canvas.backgroundColor});
 
@@ -491,17 +760,45 @@ void MapCanvas::actuallyPaintGL()
         return;
     }
 
+    if (times == nullptr) {
+        paintMap();
+        paintBatchedInfomarks();
+        paintSelections();
+        paintCharacters();
+        return;
+    }
+
+    auto last = PerfClock::now();
+    const auto lap = [&last](double &ms) {
+        const auto now = PerfClock::now();
+        ms = toMs(now - last);
+        last = now;
+    };
+
     paintMap();
+    lap(times->paintMap);
     paintBatchedInfomarks();
+    lap(times->paintBatchedInfomarks);
     paintSelections();
+    lap(times->paintSelections);
     paintCharacters();
+    lap(times->paintCharacters);
+}
+
+void MapCanvas::publishBufferMemoryUsage()
+{
+    auto &gl = getOpenGL();
+    const size_t bytes = gl.getBufferBytes();
+    if (bytes == m_publishedBufferBytes)
+        return;
+    m_publishedBufferBytes = bytes;
+    ::publishMemoryUsage("vertex buffers", gl.getNumBuffers(), bytes);
 }
 
 void MapCanvas::paintMap()
 {
     if (!m_batches.mapBatches.has_value()) {
-        // This should never happen.
-        getGLFont().renderTextCentered("Batch error");
+        // The first batches are still being built.
         return;
     }
 
@@ -518,42 +815,80 @@ void MapCanvas::paintSelections()
 
 void MapCanvas::paintGL()
 {
+    MMAPPER_TRACE_SCOPE("MapCanvas::paintGL");
     static double longestBatchMs = 0.0;
 
-    const bool showPerfStats = MapCanvasConfig::getShowPerfStats();
+    // Whatever asked for this frame, it covers every pending request.
+    const uint8_t dirtySources = std::exchange(m_dirtySources, uint8_t{0});
+    m_lastPaint = std::chrono::steady_clock::now();
+    m_repaintTimer.stop();
+
+    // Frames that only move the view during a gesture are drawn from the gesture frame,
+    // without updating the batches; anything else draws (and captures) the map again.
+    const auto viewOnly = static_cast<uint8_t>(1u
+                                               << static_cast<int>(RepaintSourceEnum::ANIMATION));
+    if (m_gestureActive && dirtySources == viewOnly) {
+        setViewportAndMvp(width(), height());
+        if (m_gestureFrame.covers(m_viewProj, m_currentLayer)) {
+            auto &gl = getOpenGL();
+            gl.clear(Color{getConfig().canvas.backgroundColor});
+            m_gestureFrame.composite(gl);
+            gl.resetBindings();
+            getProxyLatencyStats().onFramePainted();
+            return;
+        }
+    }
 
-    using Clock = std::chrono::high_resolution_clock;
-    std::optional<Clock::time_point> optStart;
+    const bool showPerfStats = MapCanvasConfig::getShowPerfStats();
+    const bool logPerfStats = MapCanvasConfig::getLogPerfStats();
+    const bool wantPerfStats = showPerfStats || logPerfStats;
+    const bool adaptiveQuality = MapCanvasConfig::isAdaptiveQuality();
+    if (!adaptiveQuality)
+        m_frameBudget.reset();
+
+    using Clock = PerfClock;
+    const auto start = Clock::now();
     std::optional<Clock::time_point> optAfterTextures;
     std::optional<Clock::time_point> optAfterBatches;
-    if (showPerfStats)
-        optStart = Clock::now();
+    PaintTimes paintTimes;
+    // The timer queries are read a few frames late, so they don't stall anything.
+    if (wantPerfStats || adaptiveQuality)
+        getOpenGL().beginFrameStats();
 
     {
         updateMultisampling();
         updateTextures();
-        if (showPerfStats)
+        if (wantPerfStats)
             optAfterTextures = Clock::now();
 
         // Note: The real work happens here!
         updateBatches();
 
-        // For accurate timing of the update, we'd need to call glFinish(),
-        // or at least set up an OpenGL query object. The update will send
-        // a lot of data to the GPU, so it could take a while...
-        if (showPerfStats)
+        // This only measures the CPU side of the update; the GPU's share shows
+        // up in the timer query (if supported) and in the glFinish() below.
+        if (wantPerfStats)
             optAfterBatches = Clock::now();
 
-        actuallyPaintGL();
+        actuallyPaintGL(wantPerfStats ? &paintTimes : nullptr);
+        getOpenGL().resetBindings();
     }
 
-    if (!showPerfStats)
+    // The GPU may still be drawing, but nothing in MMapper delays the frame after this.
+    getProxyLatencyStats().onFramePainted();
+    publishBufferMemoryUsage();
+
+    const auto afterPaint = Clock::now();
+    FrameStats frameStats;
+    if (wantPerfStats || adaptiveQuality)
+        frameStats = getOpenGL().endFrameStats();
+    if (adaptiveQuality)
+        updateFrameBudget(toMs(afterPaint - start), frameStats.gpuMs);
+
+    if (!wantPerfStats)
         return; /* don't wait to finish */
 
-    const auto &start = optStart.value();
     const auto &afterTextures = optAfterTextures.value();
     const auto &afterBatches = optAfterBatches.value();
-    const auto afterPaint = Clock::now();
     const bool calledFinish = [this]() -> bool {
         if (auto *const ctxt = QOpenGLWidget::context())
             if (auto *const func = ctxt->functions()) {
@@ -565,9 +900,41 @@ void MapCanvas::paintGL()
 
     const auto end = Clock::now();
 
-    const auto ms = [](auto delta) -> double {
-        return double(std::chrono::duration_cast<std::chrono::nanoseconds>(delta).count()) * 1e-6;
-    };
+    const auto texturesTime = toMs(afterTextures - start);
+    const auto batchTime = toMs(afterBatches - afterTextures);
+    const auto total = toMs(end - start);
+    longestBatchMs = std::max(batchTime, longestBatchMs);
+
+    const QString timesMsg = QString::asprintf(
+        "%.1f (updateTextures) + %.1f (updateBatches) + %.1f (paintGL) + %.1f (glFinish%s) = %.1f ms",
+        texturesTime,
+        batchTime,
+        toMs(afterPaint - afterBatches),
+        toMs(end - afterPaint),
+        calledFinish ? "" : "*",
+        total);
+    const QString phasesMsg = QString::asprintf(
+        "%.1f (paintMap) + %.1f (paintBatchedInfomarks) + %.1f (paintSelections)"
+        " + %.1f (paintCharacters) ms",
+        paintTimes.paintMap,
+        paintTimes.paintBatchedInfomarks,
+        paintTimes.paintSelections,
+        paintTimes.paintCharacters);
+    const QString gpuMsg = frameStats.gpuMs.has_value()
+                               ? QString::asprintf("GPU: %.1f ms", frameStats.gpuMs.value())
+                               : QString("GPU: n/a (no timer queries)");
+    const QString countsMsg = QString::asprintf("%zu draw calls, %zu vertices, %.1f KiB uploaded",
+                                                frameStats.drawCalls,
+                                                frameStats.vertices,
+                                                double(frameStats.uploadedBytes) / 1024.0);
+
+    if (logPerfStats) {
+        qInfo().noquote() << "Frame:" << timesMsg << "|" << phasesMsg << "|" << gpuMsg << "|"
+                          << countsMsg;
+    }
+
+    if (!showPerfStats)
+        return;
 
     const auto w = width();
     const auto h = height();
@@ -592,23 +959,20 @@ void MapCanvas::paintGL()
         y += lineHeight;
     };
 
-    const auto texturesTime = ms(afterTextures - start);
-    const auto batchTime = ms(afterBatches - afterTextures);
-
-    const auto total = ms(end - start);
-    print(QString::asprintf(
-        "%.1f (updateTextures) + %.1f (updateBatches) + %.1f (paintGL) + %.1f (glFinish%s) = %.1f ms",
-        texturesTime,
-        batchTime,
-        ms(afterPaint - afterBatches),
-        ms(end - afterPaint),
-        calledFinish ? "" : "*",
-        total));
+    print(timesMsg);
     if (!calledFinish)
         print("* = unable to call glFinish()");
 
-    longestBatchMs = std::max(batchTime, longestBatchMs);
     print(QString::asprintf("Worst updateBatches: %.1f ms", longestBatchMs));
+    print(phasesMsg);
+    print(gpuMsg);
+    print(countsMsg);
+    if (adaptiveQuality) {
+        print(QString::asprintf("Quality step: %d of %d (%.1f ms average)",
+                                m_frameBudget.getStep(),
+                                FrameBudget::NUM_STEPS,
+                                m_frameBudget.getAverageMs()));
+    }
 
     const auto &advanced = getConfig().canvas.advanced;
     const float zoom = getTotalScaleFactor();
@@ -684,7 +1048,9 @@ void MapCanvas::paintSelectionArea()
 
 void MapCanvas::updateMultisampling()
 {
-    const int wantMultisampling = getConfig().canvas.antialiasingSamples;
+    const int wantMultisampling = m_frameBudget.getQuality().multisampling
+                                      ? getConfig().canvas.antialiasingSamples
+                                      : 0;
     std::optional<int> &activeStatus = graphicsOptionsStatus.multisampling;
     if (activeStatus == wantMultisampling)
         return;
@@ -693,6 +1059,18 @@ void MapCanvas::updateMultisampling()
     activeStatus = wantMultisampling;
 }
 
+void MapCanvas::updateFrameBudget(const double cpuMs, const std::optional<double> gpuMs)
+{
+    // A slow driver spends most of the frame on the GPU, whose time comes in a few frames late.
+    const double ms = std::max(cpuMs, gpuMs.value_or(0.0));
+    if (!m_frameBudget.addFrame(ms))
+        return;
+
+    qInfo() << "[MapCanvas] Frames took" << m_frameBudget.getAverageMs()
+            << "ms on average; drawing quality step is now" << m_frameBudget.getStep() << "of"
+            << FrameBudget::NUM_STEPS;
+}
+
 void MapCanvas::renderMapBatches()
 {
     std::optional<MapBatches> &mapBatches = m_batches.mapBatches;
@@ -702,65 +1080,11 @@ void MapCanvas::renderMapBatches()
     }
 
     MapBatches &batches = mapBatches.value();
-    const Configuration::CanvasSettings &settings = getConfig().canvas;
-
-    const float totalScaleFactor = getTotalScaleFactor();
-    const auto wantExtraDetail = totalScaleFactor >= settings.extraDetailScaleCutoff;
-    const auto wantDoorNames = settings.drawDoorNames
-                               && (totalScaleFactor >= settings.doorNameScaleCutoff);
-
     auto &gl = getOpenGL();
-    BatchedMeshes &batchedMeshes = batches.batchedMeshes;
-    const auto drawLayer =
-        [&batches, &batchedMeshes, wantExtraDetail, wantDoorNames](const int thisLayer,
-                                                                   const int currentLayer) {
-            const auto it_mesh = batchedMeshes.find(thisLayer);
-            if (it_mesh != batchedMeshes.end()) {
-                LayerMeshes &meshes = it_mesh->second;
-                meshes.render(thisLayer, currentLayer);
-            }
-
-            if (wantExtraDetail) {
-                {
-                    BatchedConnectionMeshes &connectionMeshes = batches.connectionMeshes;
-                    const auto it_conn = connectionMeshes.find(thisLayer);
-                    if (it_conn != connectionMeshes.end()) {
-                        ConnectionMeshes &meshes = it_conn->second;
-                        meshes.render(thisLayer, currentLayer);
-                    }
-                }
-
-                // NOTE: This can display room names in lower layers, but the text
-                // isn't currently drawn with an appropriate Z-offset, so it doesn't
-                // stay aligned to its actual layer when you switch view layers.
-                if (wantDoorNames && thisLayer == currentLayer) {
-                    BatchedRoomNames &roomNameBatches = batches.roomNameBatches;
-                    const auto it_name = roomNameBatches.find(thisLayer);
-                    if (it_name != roomNameBatches.end()) {
-                        auto &roomNameBatch = it_name->second;
-                        roomNameBatch.render(GLRenderState());
-                    }
-                }
-            }
-        };
-
-    const auto fadeBackground = [&gl, &settings]() {
-        auto bgColor = Color{settings.backgroundColor.getColor(), 0.5f};
-
-        const auto blendedWithBackground
-            = GLRenderState().withBlend(BlendModeEnum::TRANSPARENCY).withColor(bgColor);
-
-        gl.renderPlainFullScreenQuad(blendedWithBackground);
-    };
-
-    for (const auto &layer : batchedMeshes) {
-        const int thisLayer = layer.first;
-        if (thisLayer == m_currentLayer) {
-            gl.clearDepth();
-            fadeBackground();
-        }
-        drawLayer(thisLayer, m_currentLayer);
-    }
+    MapCanvasRoomDrawer::renderBatches(batches,
+                                       static_cast<MapCanvasViewport &>(*this),
+                                       m_frameBudget.getQuality(),
+                                       gl);
 
     // Draw the bounds that will cause a mesh rebuild
     if (batches.redrawMargin.isRestricted()) {
@@ -34,6 +34,9 @@ PrespammedPath::~PrespammedPath() = default;
 
 void PrespammedPath::setPath(CommandQueue queue)
 {
+    // The parser sends the path after every command, but it usually hasn't changed.
+    if (queue == m_queue)
+        return;
     m_queue = std::move(queue);
     emit update();
 }
@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "ContentFingerprint.h"
+
+#include <cctype>
+
+ContentFingerprint ContentFingerprint::compute(const std::string_view sv) noexcept
+{
+    ContentFingerprint result;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint32_t nonSpace = 0;
+    for (const char c : sv) {
+        const auto uc = static_cast<uint8_t>(c);
+        hash = (hash ^ uc) * FNV_PRIME;
+        // NOTE: must agree with StringView's notion of whitespace.
+        if (!std::isspace(uc))
+            ++nonSpace;
+    }
+    result.hash = hash;
+    result.length = static_cast<uint32_t>(sv.size());
+    result.nonSpaceChars = nonSpace;
+    return result;
+}
@@ -0,0 +1,31 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <string_view>
+
+/// Cheap signature of a room name or description, computed once when the
+/// string is set, so Room::compare can skip the word-by-word diff.
+struct ContentFingerprint final
+{
+private:
+    static constexpr const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    static constexpr const uint64_t FNV_PRIME = 1099511628211ull;
+
+public:
+    /// FNV-1a of the exact bytes; the default value is the hash of "".
+    uint64_t hash = FNV_OFFSET_BASIS;
+    uint32_t length = 0;
+    uint32_t nonSpaceChars = 0;
+
+public:
+    static ContentFingerprint compute(std::string_view sv) noexcept;
+
+public:
+    bool operator==(const ContentFingerprint &rhs) const
+    {
+        return hash == rhs.hash && length == rhs.length && nonSpaceChars == rhs.nonSpaceChars;
+    }
+    bool operator!=(const ContentFingerprint &rhs) const { return !(*this == rhs); }
+};
@@ -0,0 +1,91 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+
+#include "../global/macros.h"
+#include "../mapdata/ExitDirection.h"
+#include "../mapdata/ExitFlags.h"
+#include "../parser/ExitsFlags.h"
+#include "exit.h"
+
+/// Which of the six directions (NESWUD) have exits and doors, packed so
+/// ParseTree::getRooms() can drop rooms whose exits can't be the ones the
+/// player saw without comparing them.
+struct NODISCARD ExitLayout final
+{
+public:
+    // Bit 2*dir is set for an exit, and bit 2*dir+1 for a door.
+    uint32_t exitsAndDoors = 0;
+    // Bit dir is set for exits that are never matched (NO_MATCH) ...
+    uint32_t noMatch = 0;
+    // ... and for hidden doors, which the player usually can't see.
+    uint32_t hidden = 0;
+    bool hasExitFlags = false;
+
+private:
+    static uint32_t dirBit(const ExitDirEnum dir) { return 1u << static_cast<int>(dir); }
+    static uint32_t pack(const ExitDirEnum dir, const ExitFlags flags)
+    {
+        const uint32_t bits = (flags.isExit() ? 1u : 0u) | (flags.isDoor() ? 2u : 0u);
+        return bits << (2 * static_cast<int>(dir));
+    }
+
+public:
+    void add(const ExitDirEnum dir, const Exit &e)
+    {
+        const ExitFlags flags = e.getExitFlags();
+        exitsAndDoors |= pack(dir, flags);
+        if (flags.isNoMatch())
+            noMatch |= dirBit(dir);
+        if (e.isHiddenExit())
+            hidden |= dirBit(dir);
+        hasExitFlags = hasExitFlags || !flags.empty();
+    }
+
+    /// The exits in a ParseEvent; only meaningful if flags.isValid().
+    NODISCARD static ExitLayout fromEvent(const ExitsFlagsType flags)
+    {
+        ExitLayout layout;
+        for (const ExitDirEnum dir : ALL_EXITS_NESWUD)
+            layout.exitsAndDoors |= pack(dir, flags.get(dir));
+        return layout;
+    }
+
+public:
+    /// True if Room::compareWeakProps() is known to find a room with this
+    /// layout DIFFERENT from an event with the layout `seen`.
+    ///
+    /// That happens once two directions (other than NO_MATCH ones) differ in
+    /// their exit or door, since it only tolerates one such difference. A
+    /// hidden door that the player didn't see doesn't count, and neither do
+    /// any differences for a room without exit flags that isn't up to date,
+    /// whose exits aren't known at all.
+    NODISCARD bool rulesOut(const ExitLayout &seen, const bool upToDate) const
+    {
+        if (!upToDate && !hasExitFlags)
+            return false;
+
+        const uint32_t diff = exitsAndDoors ^ seen.exitsAndDoors;
+        uint32_t dirs = 0;
+        uint32_t seenDoors = 0;
+        for (uint32_t dir = 0; dir < NUM_EXITS_NESWUD; ++dir) {
+            if (((diff >> (2 * dir)) & 3u) != 0u)
+                dirs |= 1u << dir;
+            if (((seen.exitsAndDoors >> (2 * dir)) & 2u) != 0u)
+                seenDoors |= 1u << dir;
+        }
+        dirs &= ~noMatch;
+        dirs &= ~(hidden & ~seenDoors);
+        return (dirs & (dirs - 1u)) != 0u;
+    }
+
+public:
+    bool operator==(const ExitLayout &rhs) const
+    {
+        return exitsAndDoors == rhs.exitsAndDoors && noMatch == rhs.noMatch
+               && hidden == rhs.hidden && hasExitFlags == rhs.hasExitFlags;
+    }
+    bool operator!=(const ExitLayout &rhs) const { return !(*this == rhs); }
+};
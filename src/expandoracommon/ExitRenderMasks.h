@@ -0,0 +1,61 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+
+#include "../global/macros.h"
+#include "../mapdata/ExitDirection.h"
+#include "../mapdata/ExitFlags.h"
+#include "exit.h"
+
+/// The exit flags that the map canvas draws, one bit per direction (NESWUD),
+/// so building a mesh can skip the exits that have nothing special to draw,
+/// and find a neighbour's streams without testing each of its exits.
+///
+/// Only the room's own exits are covered; the colours still come from the
+/// configuration when the mesh is built.
+struct NODISCARD ExitRenderMasks final
+{
+public:
+    // Bit dir is set for roads; for NESW that's the room's RoadIndexMaskEnum.
+    uint32_t roads = 0;
+    uint32_t flows = 0;
+    // Exits whose wall is drawn in a colour of its own (see getWallNamedColor()).
+    uint32_t coloredWalls = 0;
+
+public:
+    NODISCARD static uint32_t dirBit(const ExitDirEnum dir)
+    {
+        return 1u << static_cast<int>(dir);
+    }
+
+    void add(const ExitDirEnum dir, const Exit &e)
+    {
+        static constexpr const ExitFlags COLORED_WALL_FLAGS
+            = ExitFlags{ExitFlagEnum::NO_FLEE} | ExitFlagEnum::RANDOM | ExitFlagEnum::FALL
+              | ExitFlagEnum::DAMAGE | ExitFlagEnum::SPECIAL | ExitFlagEnum::CLIMB
+              | ExitFlagEnum::GUARDED | ExitFlagEnum::NO_MATCH;
+
+        const ExitFlags flags = e.getExitFlags();
+        if (flags.isRoad())
+            roads |= dirBit(dir);
+        if (flags.isFlow())
+            flows |= dirBit(dir);
+        if (flags.containsAny(COLORED_WALL_FLAGS))
+            coloredWalls |= dirBit(dir);
+    }
+
+public:
+    NODISCARD bool hasColoredWall(const ExitDirEnum dir) const
+    {
+        return (coloredWalls & dirBit(dir)) != 0u;
+    }
+
+public:
+    bool operator==(const ExitRenderMasks &rhs) const
+    {
+        return roads == rhs.roads && flows == rhs.flows && coloredWalls == rhs.coloredWalls;
+    }
+    bool operator!=(const ExitRenderMasks &rhs) const { return !(*this == rhs); }
+};
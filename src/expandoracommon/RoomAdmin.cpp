@@ -5,4 +5,12 @@
 
 #include "RoomAdmin.h"
 
+#include "RoomRecipient.h"
+
 RoomAdmin::~RoomAdmin() = default;
+
+void RoomAdmin::releaseRooms(const std::vector<std::pair<RoomRecipient *, RoomId>> &locks)
+{
+    for (const auto &lock : locks)
+        releaseRoom(*lock.first, lock.second);
+}
@@ -5,6 +5,8 @@
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "room.h"
 
@@ -21,6 +23,8 @@ class RoomAdmin : public RoomModificationTracker
     // removes the lock on a room
     // after the last lock is removed, the room is deleted
     virtual void releaseRoom(RoomRecipient &, RoomId) = 0;
+    // Releases each recipient's lock on its room, in order; by default with releaseRoom().
+    virtual void releaseRooms(const std::vector<std::pair<RoomRecipient *, RoomId>> &locks);
 
     // makes a lock on a room permanent and anonymous.
     // Like that the room can't be deleted via releaseRoom anymore.
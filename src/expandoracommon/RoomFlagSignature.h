@@ -0,0 +1,82 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../mapdata/DoorFlags.h"
+#include "../mapdata/ExitFlags.h"
+#include "../mapdata/mmapper2room.h"
+
+/// Every flag a room has -- its mob and load flags, the door and exit flags of
+/// all of its exits, and its defined light, sundeath, portable, ridable and
+/// align types -- packed into two words, so "does this room have any of these
+/// flags?" is one mask test instead of a walk over the exits.
+///
+/// Rooms keep theirs up to date as they're modified (see Room::getFlagSignature()),
+/// and a set of flags to look for is just another signature.
+struct RoomFlagSignature final
+{
+private:
+    static constexpr const size_t MOB_SHIFT = 0;
+    static constexpr const size_t LOAD_SHIFT = MOB_SHIFT + NUM_ROOM_MOB_FLAGS;
+    static constexpr const size_t DOOR_SHIFT = LOAD_SHIFT + NUM_ROOM_LOAD_FLAGS;
+    static constexpr const size_t EXIT_SHIFT = DOOR_SHIFT + NUM_DOOR_FLAGS;
+    static_assert(EXIT_SHIFT + NUM_EXIT_FLAGS <= 64);
+
+    // UNDEFINED doesn't get a bit, so each type needs one bit fewer than it has values.
+    static constexpr const size_t LIGHT_SHIFT = 0;
+    static constexpr const size_t SUNDEATH_SHIFT = LIGHT_SHIFT + NUM_LIGHT_TYPES - 1;
+    static constexpr const size_t PORTABLE_SHIFT = SUNDEATH_SHIFT + NUM_SUNDEATH_TYPES - 1;
+    static constexpr const size_t RIDABLE_SHIFT = PORTABLE_SHIFT + NUM_PORTABLE_TYPES - 1;
+    static constexpr const size_t ALIGN_SHIFT = RIDABLE_SHIFT + NUM_RIDABLE_TYPES - 1;
+    static_assert(ALIGN_SHIFT + NUM_ALIGN_TYPES - 1 <= 64);
+
+public:
+    uint64_t flags = 0;
+    uint64_t types = 0;
+
+private:
+    static constexpr uint64_t packFlags(const uint32_t bits, const size_t shift) noexcept
+    {
+        return static_cast<uint64_t>(bits) << shift;
+    }
+    template<typename E>
+    static constexpr uint64_t packType(const E type, const size_t shift) noexcept
+    {
+        if (type == E::UNDEFINED)
+            return 0u;
+        return uint64_t{1u} << (shift + static_cast<size_t>(type) - 1u);
+    }
+
+public:
+    void add(const RoomMobFlags f) { flags |= packFlags(f.asUint32(), MOB_SHIFT); }
+    void add(const RoomLoadFlags f) { flags |= packFlags(f.asUint32(), LOAD_SHIFT); }
+    void add(const DoorFlags f) { flags |= packFlags(f.asUint32(), DOOR_SHIFT); }
+    void add(const ExitFlags f) { flags |= packFlags(f.asUint32(), EXIT_SHIFT); }
+    void add(const RoomMobFlagEnum f) { add(RoomMobFlags{f}); }
+    void add(const RoomLoadFlagEnum f) { add(RoomLoadFlags{f}); }
+    void add(const DoorFlagEnum f) { add(DoorFlags{f}); }
+    void add(const ExitFlagEnum f) { add(ExitFlags{f}); }
+    void add(const RoomLightEnum t) { types |= packType(t, LIGHT_SHIFT); }
+    void add(const RoomSundeathEnum t) { types |= packType(t, SUNDEATH_SHIFT); }
+    void add(const RoomPortableEnum t) { types |= packType(t, PORTABLE_SHIFT); }
+    void add(const RoomRidableEnum t) { types |= packType(t, RIDABLE_SHIFT); }
+    void add(const RoomAlignEnum t) { types |= packType(t, ALIGN_SHIFT); }
+
+public:
+    bool empty() const { return (flags | types) == 0u; }
+    /// True if the two signatures share at least one flag.
+    bool intersects(const RoomFlagSignature &rhs) const
+    {
+        return ((flags & rhs.flags) | (types & rhs.types)) != 0u;
+    }
+
+public:
+    bool operator==(const RoomFlagSignature &rhs) const
+    {
+        return flags == rhs.flags && types == rhs.types;
+    }
+    bool operator!=(const RoomFlagSignature &rhs) const { return !(*this == rhs); }
+};
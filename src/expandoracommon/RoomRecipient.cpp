@@ -7,3 +7,9 @@
 
 RoomRecipient::RoomRecipient() = default;
 RoomRecipient::~RoomRecipient() = default;
+
+void RoomRecipient::receiveRooms(RoomAdmin *const admin, const std::vector<const Room *> &rooms)
+{
+    for (const Room *const room : rooms)
+        receiveRoom(admin, room);
+}
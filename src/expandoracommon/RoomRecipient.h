@@ -5,6 +5,8 @@
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <vector>
+
 #include "../global/RuleOf5.h"
 
 class Room;
@@ -20,6 +22,9 @@ class RoomRecipient
     RoomRecipient();
     virtual ~RoomRecipient();
     virtual void receiveRoom(RoomAdmin *admin, const Room *room) = 0;
+    // Called by searches that find many rooms at once, after they're all locked;
+    // by default each one is passed to receiveRoom().
+    virtual void receiveRooms(RoomAdmin *admin, const std::vector<const Room *> &rooms);
 
 public:
     DELETE_CTORS_AND_ASSIGN_OPS(RoomRecipient);
@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "WordTokens.h"
+
+#include <cctype>
+#include <limits>
+
+static bool isSpace(const char c)
+{
+    // NOTE: must agree with StringView's notion of whitespace.
+    return std::isspace(static_cast<uint8_t>(c)) != 0;
+}
+
+WordTokens WordTokens::compute(const std::string_view sv)
+{
+    WordTokens result;
+    if (sv.size() > std::numeric_limits<uint16_t>::max()) {
+        result.m_valid = false;
+        return result;
+    }
+
+    const size_t len = sv.size();
+    size_t pos = 0;
+    while (pos < len) {
+        while (pos < len && isSpace(sv[pos]))
+            ++pos;
+        if (pos == len)
+            break;
+
+        const size_t begin = pos;
+        uint32_t hash = 2166136261u; // 32-bit FNV-1a
+        while (pos < len && !isSpace(sv[pos])) {
+            hash = (hash ^ static_cast<uint8_t>(sv[pos])) * 16777619u;
+            ++pos;
+        }
+
+        Word word;
+        word.hash = hash;
+        word.offset = static_cast<uint16_t>(begin);
+        word.length = static_cast<uint16_t>(pos - begin);
+        result.m_words.emplace_back(word);
+    }
+    result.m_words.shrink_to_fit();
+    return result;
+}
+
+size_t WordTokens::countCharsFrom(const size_t first) const
+{
+    size_t result = 0;
+    for (size_t i = first, n = m_words.size(); i < n; ++i)
+        result += m_words[i].length;
+    return result;
+}
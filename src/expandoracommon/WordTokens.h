@@ -0,0 +1,46 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+/// Whitespace-separated words of a room name or description, split once when
+/// the string is set so tolerant comparisons don't have to re-trim and re-split.
+///
+/// Offsets refer to the string the tokens were computed from, so the tokens are
+/// only meaningful alongside that same string.
+class WordTokens final
+{
+public:
+    struct Word final
+    {
+        uint32_t hash = 0;
+        uint16_t offset = 0;
+        uint16_t length = 0;
+    };
+
+private:
+    std::vector<Word> m_words;
+    bool m_valid = true;
+
+public:
+    static WordTokens compute(std::string_view sv);
+
+public:
+    /// False if the string was too long to tokenize; callers must fall back to
+    /// splitting the string themselves.
+    bool isValid() const { return m_valid; }
+    bool empty() const { return m_words.empty(); }
+    size_t size() const { return m_words.size(); }
+    const Word &operator[](const size_t i) const { return m_words[i]; }
+
+public:
+    /// Number of non-space characters in words [first, size()).
+    size_t countCharsFrom(size_t first) const;
+
+public:
+    size_t getHeapBytes() const { return m_words.capacity() * sizeof(Word); }
+};
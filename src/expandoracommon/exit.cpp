@@ -5,6 +5,7 @@
 #include "exit.h"
 
 #include "../global/Flags.h"
+#include "../global/MemoryUsage.h"
 #include "../mapdata/DoorFlags.h"
 #include "../mapdata/ExitFieldVariant.h"
 #include "../mapdata/ExitFlags.h"
@@ -38,6 +39,13 @@ bool Exit::doorNeedsKey() const
     return isDoor() && getDoorFlags().needsKey();
 }
 
+void Exit::addMemoryUsage(MemoryUsage &usage) const
+{
+    // Only the exits that lead somewhere are counted.
+    usage.add("exits", outIsEmpty() ? 0 : 1, incoming.getHeapBytes() + outgoing.getHeapBytes());
+    usage.addSharedString(getDoorName().getSharedString());
+}
+
 bool Exit::operator==(const Exit &rhs) const
 {
     return m_fields.doorName == rhs.m_fields.doorName
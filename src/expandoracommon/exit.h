@@ -5,11 +5,10 @@
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
 #include <cassert>
-#include <set>
 #include <stdexcept>
 #include <QVariant>
-#include <QVector>
 
+#include "../global/TinyRoomIdSet.h"
 #include "../global/range.h"
 #include "../global/roomid.h"
 #include "../mapdata/DoorFlags.h"
@@ -17,6 +16,8 @@
 #include "../mapdata/ExitFlags.h"
 #include "../mapdata/mmapper2exit.h"
 
+class MemoryUsage;
+
 #define XFOREACH_EXIT_PROPERTY(X) \
     X(DoorName, doorName, ) \
     X(ExitFlags, exitFlags, ) \
@@ -36,11 +37,10 @@ class Exit final
     ExitFields m_fields;
 
 private:
-    RoomIdSet incoming;
-    RoomIdSet outgoing;
+    TinyRoomIdSet incoming;
+    TinyRoomIdSet outgoing;
 
 public:
-    // This has to exist as long as ExitsList uses QVector<Exit>.
     Exit() = default;
     ~Exit() = default;
 
@@ -53,14 +53,14 @@ class Exit final
     }
 
 public:
-    const RoomIdSet &getIncoming() const { return incoming; }
-    const RoomIdSet &getOutgoing() const { return outgoing; }
+    const TinyRoomIdSet &getIncoming() const { return incoming; }
+    const TinyRoomIdSet &getOutgoing() const { return outgoing; }
 
 public:
     auto inSize() const { return incoming.size(); }
     bool inIsEmpty() const { return inSize() == 0; }
     auto inRange() const { return make_range(inBegin(), inEnd()); }
-    RoomIdSet inClone() const { return incoming; }
+    TinyRoomIdSet inClone() const { return incoming; }
 
 public:
     auto outSize() const { return outgoing.size(); }
@@ -72,25 +72,25 @@ class Exit final
         return *outgoing.begin();
     }
     auto outRange() const { return make_range(outBegin(), outEnd()); }
-    RoomIdSet outClone() const { return outgoing; }
+    TinyRoomIdSet outClone() const { return outgoing; }
 
 public:
     auto getRange(bool out) const { return out ? outRange() : inRange(); }
 
 private:
-    std::set<RoomId>::const_iterator inBegin() const { return incoming.begin(); }
-    std::set<RoomId>::const_iterator outBegin() const { return outgoing.begin(); }
+    TinyRoomIdSet::const_iterator inBegin() const { return incoming.begin(); }
+    TinyRoomIdSet::const_iterator outBegin() const { return outgoing.begin(); }
 
-    std::set<RoomId>::const_iterator inEnd() const { return incoming.end(); }
-    std::set<RoomId>::const_iterator outEnd() const { return outgoing.end(); }
+    TinyRoomIdSet::const_iterator inEnd() const { return incoming.end(); }
+    TinyRoomIdSet::const_iterator outEnd() const { return outgoing.end(); }
 
 public:
     void addIn(RoomId from) { incoming.insert(from); }
     void addOut(RoomId to) { outgoing.insert(to); }
     void removeIn(RoomId from) { incoming.erase(from); }
     void removeOut(RoomId to) { outgoing.erase(to); }
-    bool containsIn(RoomId from) const { return incoming.find(from) != incoming.end(); }
-    bool containsOut(RoomId to) const { return outgoing.find(to) != outgoing.end(); }
+    bool containsIn(RoomId from) const { return incoming.contains(from); }
+    bool containsOut(RoomId to) const { return outgoing.contains(to); }
 
 public:
 #define DECL_GETTERS_AND_SETTERS(_Type, _Prop, _OptInit) \
@@ -129,6 +129,10 @@ class Exit final
     bool operator==(const Exit &rhs) const;
     bool operator!=(const Exit &rhs) const;
 
+public:
+    /// Only what the exit holds outside of itself; the exit is part of its room.
+    void addMemoryUsage(MemoryUsage &usage) const;
+
 public:
     Exit(Exit &&) = default;
     Exit(const Exit &) = default;
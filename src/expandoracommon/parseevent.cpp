@@ -10,6 +10,7 @@
 #include <cstdint>
 #include <memory>
 
+#include "../global/PoolAllocator.h"
 #include "../global/TextUtils.h"
 #include "../global/utils.h"
 #include "../mapdata/ExitDirection.h"
@@ -106,7 +107,8 @@ SharedParseEvent ParseEvent::createEvent(const CommandEnum c,
                                          const PromptFlagsType &promptFlags,
                                          const ConnectedRoomFlagsType &connectedRoomFlags)
 {
-    auto result = std::make_shared<ParseEvent>(c);
+    // One is made for every room the parser sees, so it comes from a pool like the paths do.
+    auto result = std::allocate_shared<ParseEvent>(PoolAllocator<ParseEvent>{}, c);
     ParseEvent *const event = result.get();
 
     // the moved strings are used by const ref here before they're moved.
@@ -118,6 +120,10 @@ SharedParseEvent ParseEvent::createEvent(const CommandEnum c,
     event->m_roomName = std::exchange(moved_roomName, {});
     event->m_dynamicDesc = std::exchange(moved_dynamicDesc, {});
     event->m_staticDesc = std::exchange(moved_staticDesc, {});
+    event->m_roomNameFingerprint = ContentFingerprint::compute(event->m_roomName.getStdString());
+    event->m_staticDescFingerprint = ContentFingerprint::compute(event->m_staticDesc.getStdString());
+    event->m_roomNameWords = WordTokens::compute(event->m_roomName.getStdString());
+    event->m_staticDescWords = WordTokens::compute(event->m_staticDesc.getStdString());
     event->m_exitsFlags = exitsFlags;
     event->m_promptFlags = promptFlags;
     event->m_connectedRoomFlags = connectedRoomFlags;
@@ -18,18 +18,32 @@
 #include <QVariant>
 #include <QtGlobal>
 
+#include "../global/macros.h"
 #include "../mapdata/mmapper2exit.h"
 #include "../parser/CommandId.h"
 #include "../parser/ConnectedRoomFlags.h"
 #include "../parser/ExitsFlags.h"
 #include "../parser/PromptFlags.h"
+#include "ContentFingerprint.h"
 #include "MmQtHandle.h"
+#include "WordTokens.h"
 #include "property.h"
 
 class ParseEvent;
 using SharedParseEvent = std::shared_ptr<ParseEvent>;
 using SigParseEvent = MmQtHandle<ParseEvent>;
 
+/// The keys a room is filed under, which only depend on its name, static
+/// description and terrain; see ParseTree::computeKeys().
+struct NODISCARD ParseKeys final
+{
+    static constexpr const size_t MAX_LEVELS = 3;
+    uint32_t mask = 0;
+    uint64_t primary = 0;
+    // The key for mask, then for each less specific mask the tree also files it under.
+    std::array<uint64_t, MAX_LEVELS> levels{};
+};
+
 /**
  * the ParseEvents will walk around in the SearchTree
  */
@@ -61,9 +75,15 @@ class ParseEvent final
     RoomName m_roomName;
     RoomDynamicDesc m_dynamicDesc;
     RoomStaticDesc m_staticDesc;
+    ContentFingerprint m_roomNameFingerprint;
+    ContentFingerprint m_staticDescFingerprint;
+    WordTokens m_roomNameWords;
+    WordTokens m_staticDescWords;
     ExitsFlagsType m_exitsFlags;
     PromptFlagsType m_promptFlags;
     ConnectedRoomFlagsType m_connectedRoomFlags;
+    // Filled in by ParseTree::getKeys(), which runs with the map locked.
+    mutable std::optional<ParseKeys> m_parseKeys;
 
     CommandEnum m_moveType = CommandEnum::NONE;
     uint m_numSkipped = 0u;
@@ -102,6 +122,10 @@ class ParseEvent final
     const RoomName &getRoomName() const { return m_roomName; }
     const RoomDynamicDesc &getDynamicDesc() const { return m_dynamicDesc; }
     const RoomStaticDesc &getStaticDesc() const { return m_staticDesc; }
+    const ContentFingerprint &getRoomNameFingerprint() const { return m_roomNameFingerprint; }
+    const ContentFingerprint &getStaticDescFingerprint() const { return m_staticDescFingerprint; }
+    const WordTokens &getRoomNameWords() const { return m_roomNameWords; }
+    const WordTokens &getStaticDescWords() const { return m_staticDescWords; }
     ExitsFlagsType getExitsFlags() const { return m_exitsFlags; }
     PromptFlagsType getPromptFlags() const { return m_promptFlags; }
     ConnectedRoomFlagsType getConnectedRoomFlags() const { return m_connectedRoomFlags; }
@@ -109,6 +133,10 @@ class ParseEvent final
     uint getNumSkipped() const { return m_numSkipped; }
     const Property &operator[](const size_t pos) const { return m_properties.at(pos); }
 
+public:
+    const std::optional<ParseKeys> &getCachedParseKeys() const { return m_parseKeys; }
+    void setCachedParseKeys(const ParseKeys &keys) const { m_parseKeys = keys; }
+
 public:
     static SharedParseEvent createEvent(CommandEnum c,
                                         RoomName roomName,
@@ -5,10 +5,17 @@
 
 #include "room.h"
 
+#include <cstdint>
+#include <cstdlib>
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "../global/MemoryUsage.h"
+#include "../global/PoolAllocator.h"
 #include "../global/StringView.h"
 #include "../global/random.h"
 #include "../mapdata/ExitFieldVariant.h"
@@ -50,6 +57,7 @@ RoomModificationTracker::~RoomModificationTracker() = default;
 void RoomModificationTracker::notifyModified(Room &room, RoomUpdateFlags updateFlags)
 {
     m_isModified = true;
+    ++m_modificationCount;
     if (updateFlags.contains(RoomUpdateEnum::Mesh))
         m_needsMapUpdate = true;
     virt_onNotifyModified(room, updateFlags);
@@ -61,7 +69,7 @@ ExitDirConstRef::ExitDirConstRef(const ExitDirEnum dir, const Exit &exit)
 {}
 
 Room::Room(this_is_private, RoomModificationTracker &tracker, const RoomStatusEnum status)
-    : m_tracker{tracker}
+    : m_tracker{&tracker}
     , m_status{status}
 {
     assert(status == RoomStatusEnum::Temporary || status == RoomStatusEnum::Permanent);
@@ -118,10 +126,25 @@ inline bool maybeModify(T &ours, T &&value)
     return true;
 }
 
+// Room fields that are part of the room's flag signature.
+template<typename T>
+static constexpr const bool IS_FLAG_SIGNATURE_FIELD = std::is_same_v<T, RoomMobFlags>
+                                                      || std::is_same_v<T, RoomLoadFlags>
+                                                      || std::is_same_v<T, RoomPortableEnum>
+                                                      || std::is_same_v<T, RoomLightEnum>
+                                                      || std::is_same_v<T, RoomAlignEnum>
+                                                      || std::is_same_v<T, RoomRidableEnum>
+                                                      || std::is_same_v<T, RoomSundeathEnum>;
+
 #define DEFINE_SETTERS(_Type, _Prop, _OptInit) \
     void Room::set##_Prop(_Type value) \
     { \
+        if constexpr (IS_COLD_ROOM_FIELD<_Type>) \
+            ensureColdText(); \
         if (maybeModify<_Type>((m_fields._Prop), std::move(value))) { \
+            updateComparisonCache(m_fields._Prop); \
+            if constexpr (IS_FLAG_SIGNATURE_FIELD<_Type>) \
+                updateFlagSignature(); \
             setModified(_Type##_updateFlags); \
         } \
     }
@@ -129,12 +152,69 @@ inline bool maybeModify(T &ours, T &&value)
 XFOREACH_ROOM_PROPERTY(DEFINE_SETTERS)
 #undef DEFINE_SETTERS
 
+RoomColdTextSource::~RoomColdTextSource() = default;
+
+// Loading cold text is rare and quick, so one lock covers every room.
+static std::mutex &getColdTextMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+void Room::setColdTextSource(std::shared_ptr<const RoomColdTextSource> source,
+                             const uint32_t index)
+{
+    std::lock_guard<std::mutex> lock{getColdTextMutex()};
+    m_coldSource = std::move(source);
+    m_coldIndex = index;
+    m_coldPending.store(m_coldSource != nullptr, std::memory_order_release);
+}
+
+void Room::loadColdText() const
+{
+    std::lock_guard<std::mutex> lock{getColdTextMutex()};
+    if (!m_coldPending.load(std::memory_order_relaxed))
+        return;
+
+    // Filling in what was left unloaded doesn't change the room, so it's done even
+    // through a const reference (rooms are never created const).
+    Room &self = const_cast<Room &>(*this);
+    RoomColdTextSource::Text text = m_coldSource->load(m_coldIndex);
+    self.m_fields.StaticDescription = std::move(text.staticDesc);
+    self.m_fields.DynamicDescription = std::move(text.dynamicDesc);
+    self.m_fields.Note = std::move(text.note);
+    self.updateComparisonCache(m_fields.StaticDescription);
+    self.m_coldSource.reset();
+    m_coldPending.store(false, std::memory_order_release);
+}
+
+void Room::updateComparisonCache(const RoomName &name)
+{
+    m_nameFingerprint = ContentFingerprint::compute(name.getStdString());
+    m_nameWords.set(WordTokens::compute(name.getStdString()));
+}
+
+void Room::updateComparisonCache(const RoomStaticDesc &desc)
+{
+    m_staticDescFingerprint = ContentFingerprint::compute(desc.getStdString());
+    m_staticDescWords.set(WordTokens::compute(desc.getStdString()));
+}
+
+static constexpr const auto DoorName_updateFlags = doorNameUpdateFlags;
+static constexpr const auto ExitFlags_updateFlags = exitFlagUpdateFlags;
+static constexpr const auto DoorFlags_updateFlags = doorFlagUpdateFlags;
+
+// Changes the one field in place; copying the whole list through setExitsList()
+// would also copy every exit's connections.
 #define DEFINE_SETTERS(_Type, _Prop, _OptInit) \
     void Room::set##_Type(ExitDirEnum dir, _Type value) \
     { \
-        ExitsList exits = getExitsList(); \
-        exits[dir].set##_Type(std::move(value)); \
-        setExitsList(exits); \
+        if (getExitsList()[dir].get##_Type() == value) \
+            return; \
+        exit(dir).set##_Type(std::move(value)); \
+        if constexpr (!std::is_same_v<_Type, DoorName>) \
+            updateExitCaches(); \
+        setModified(_Type##_updateFlags); \
     }
 
 XFOREACH_EXIT_PROPERTY(DEFINE_SETTERS)
@@ -169,56 +249,87 @@ void Room::setExitsList(const ExitsList &newExits)
     RoomUpdateFlags flags;
 
     for (const auto dir : ALL_EXITS7) {
-        Exit &ex = m_exits[dir];
         const Exit &newValue = newExits[dir];
-        if (ex == newValue)
+        if (getExitsList()[dir] == newValue)
             continue;
 
-        const auto diff = getDifferences(ex, newValue);
+        const auto diff = getDifferences(getExitsList()[dir], newValue);
         assert(!diff.empty());
         flags |= diff;
+        Exit &ex = exit(dir);
         ex = newValue;
         assert(ex == newValue);
     }
 
+    if (flags.containsAny(RoomUpdateFlags{RoomUpdateEnum::DoorFlags} | RoomUpdateEnum::ExitFlags))
+        updateExitCaches();
     if (!flags.empty())
         setModified(flags);
 }
 
+void Room::updateFlagSignature()
+{
+    RoomFlagSignature sig;
+    sig.add(m_fields.MobFlags);
+    sig.add(m_fields.LoadFlags);
+    sig.add(m_fields.LightType);
+    sig.add(m_fields.SundeathType);
+    sig.add(m_fields.PortableType);
+    sig.add(m_fields.RidableType);
+    sig.add(m_fields.AlignType);
+    for (const Exit &e : getExitsList()) {
+        sig.add(e.getDoorFlags());
+        sig.add(e.getExitFlags());
+    }
+    m_flagSignature = sig;
+}
+
+void Room::updateExitLayout()
+{
+    ExitLayout layout;
+    for (const ExitDirEnum dir : ALL_EXITS_NESWUD)
+        layout.add(dir, getExitsList()[dir]);
+    m_exitLayout = layout;
+}
+
+void Room::updateExitRenderMasks()
+{
+    ExitRenderMasks masks;
+    for (const ExitDirEnum dir : ALL_EXITS_NESWUD)
+        masks.add(dir, getExitsList()[dir]);
+    m_exitRenderMasks = masks;
+}
+
 void Room::addInExit(const ExitDirEnum dir, const RoomId id)
 {
-    Exit &ex = exit(dir);
-    if (ex.containsIn(id))
+    if (getExitsList()[dir].containsIn(id))
         return;
-    ex.addIn(id);
+    exit(dir).addIn(id);
     setModified(incomingUpdateFlags);
 }
 
 void Room::addOutExit(const ExitDirEnum dir, const RoomId id)
 {
-    Exit &ex = exit(dir);
-    if (ex.containsOut(id))
+    if (getExitsList()[dir].containsOut(id))
         return;
-    ex.addOut(id);
+    exit(dir).addOut(id);
     setModified(outgoingUpdateFlags);
 }
 
 void Room::removeInExit(const ExitDirEnum dir, const RoomId id)
 {
-    Exit &ex = exit(dir);
-    if (!ex.containsIn(id))
+    if (!getExitsList()[dir].containsIn(id))
         return;
-    ex.removeIn(id);
+    exit(dir).removeIn(id);
     setModified(incomingUpdateFlags);
 }
 
 void Room::removeOutExit(const ExitDirEnum dir, const RoomId id)
 {
-    Exit &ex = exit(dir);
-    if (!ex.containsOut(id))
+    if (!getExitsList()[dir].containsOut(id))
         return;
     // REVISIT: check if it was actually there?
-    ex.removeOut(id);
+    exit(dir).removeOut(id);
     setModified(outgoingUpdateFlags);
 }
 
@@ -277,17 +388,53 @@ void Room::setOutDated()
 
 void Room::setModified(const RoomUpdateFlags updateFlags)
 {
-    m_tracker.notifyModified(*this, updateFlags);
+    m_tracker->notifyModified(*this, updateFlags);
+}
+
+template<typename T>
+static auto addFieldUsage(MemoryUsage &usage, const T &value, int)
+    -> decltype(value.getSharedString(), void())
+{
+    usage.addSharedString(value.getSharedString());
+}
+
+template<typename T>
+static void addFieldUsage(MemoryUsage &, const T &, long)
+{}
+
+void Room::addMemoryUsage(MemoryUsage &usage) const
+{
+    usage.add("rooms",
+              1,
+              sizeof(Room) + m_nameWords->getHeapBytes() + m_staticDescWords->getHeapBytes());
+    usage.add("exits", 0, sizeof(ExitsList));
+    for (const Exit &e : getExitsList())
+        e.addMemoryUsage(usage);
+
+    // The cold fields may be being loaded by another thread until they're ready.
+    const bool coldPending = m_coldPending.load();
+#define ADD_FIELD(_Type, _Prop, _OptInit) \
+    if (!IS_COLD_ROOM_FIELD<_Type> || !coldPending) \
+        addFieldUsage(usage, m_fields._Prop, 0);
+    XFOREACH_ROOM_PROPERTY(ADD_FIELD)
+#undef ADD_FIELD
+}
+
+SharedRoom Room::allocateRoom(RoomModificationTracker &tracker, const RoomStatusEnum status)
+{
+    // Rooms and their control blocks share one pooled block, and rooms created
+    // together (e.g. while loading a map) end up contiguous in memory.
+    return std::allocate_shared<Room>(PoolAllocator<Room>{}, this_is_private{0}, tracker, status);
 }
 
 std::shared_ptr<Room> Room::createPermanentRoom(RoomModificationTracker &tracker)
 {
-    return std::make_shared<Room>(this_is_private{0}, tracker, RoomStatusEnum::Permanent);
+    return allocateRoom(tracker, RoomStatusEnum::Permanent);
 }
 
 SharedRoom Room::createTemporaryRoom(RoomModificationTracker &tracker, const ParseEvent &ev)
 {
-    auto room = std::make_shared<Room>(this_is_private{0}, tracker, RoomStatusEnum::Temporary);
+    auto room = allocateRoom(tracker, RoomStatusEnum::Temporary);
     Room::update(*room, ev);
     return room;
 }
@@ -320,8 +467,52 @@ static int wordDifference(StringView a, StringView b)
     return static_cast<int>(diff + a.size() + b.size());
 }
 
+static int wordDifference(const std::string &a,
+                          const WordTokens::Word &aw,
+                          const std::string &b,
+                          const WordTokens::Word &bw)
+{
+    if (aw.length == bw.length && aw.hash == bw.hash
+        && a.compare(aw.offset, aw.length, b, bw.offset, bw.length) == 0) {
+        return 0;
+    }
+    return wordDifference(StringView{std::string_view{a}.substr(aw.offset, aw.length)},
+                          StringView{std::string_view{b}.substr(bw.offset, bw.length)});
+}
+
+// Same as the StringView loop in compareStrings(), but walks the cached words.
+static void spendTolerance(int &tolerance,
+                           const std::string &room,
+                           const WordTokens &roomWords,
+                           const std::string &event,
+                           const WordTokens &eventWords,
+                           const bool updated)
+{
+    const size_t numRoomWords = roomWords.size();
+    const size_t numEventWords = eventWords.size();
+    size_t i = 0;
+    size_t j = 0;
+    while (tolerance >= 0) {
+        if (i == numRoomWords) {
+            if (updated) { // if notUpdated the desc is allowed to be shorter than the event
+                tolerance -= static_cast<int>(eventWords.countCharsFrom(j));
+            }
+            break;
+        }
+        if (j == numEventWords) {
+            tolerance -= static_cast<int>(roomWords.countCharsFrom(i));
+            break;
+        }
+        tolerance -= wordDifference(event, eventWords[j++], room, roomWords[i++]);
+    }
+}
+
 ComparisonResultEnum Room::compareStrings(const std::string &room,
+                                          const ContentFingerprint &roomFingerprint,
+                                          const WordTokens &roomWords,
                                           const std::string &event,
+                                          const ContentFingerprint &eventFingerprint,
+                                          const WordTokens &eventWords,
                                           int prevTolerance,
                                           const bool updated)
 {
@@ -331,23 +522,50 @@ ComparisonResultEnum Room::compareStrings(const std::string &room,
     prevTolerance /= 100;
     int tolerance = prevTolerance;
 
-    auto descWords = StringView{room}.trim();
-    auto eventWords = StringView{event}.trim();
+    // Identical strings always compare EQUAL below; the string compare only
+    // guards against hash collisions. Interned names and descriptions that are
+    // equal are the same string, so that's checked first.
+    if (&room == &event || (roomFingerprint == eventFingerprint && room == event)) {
+        return ComparisonResultEnum::EQUAL;
+    }
+
+    // Each word pair costs at least the difference of the word lengths, and any
+    // unpaired words cost their length, so the total cost is bounded below by the
+    // difference in non-space characters (extra event words are free when the
+    // room isn't up to date).
+    if (eventFingerprint.nonSpaceChars != 0) {
+        const auto roomChars = static_cast<int64_t>(roomFingerprint.nonSpaceChars);
+        const auto eventChars = static_cast<int64_t>(eventFingerprint.nonSpaceChars);
+        const int64_t minCost = updated ? std::abs(roomChars - eventChars)
+                                        : std::max<int64_t>(0, roomChars - eventChars);
+        if (minCost > tolerance) {
+            return ComparisonResultEnum::DIFFERENT;
+        }
+    }
 
-    if (!eventWords.isEmpty()) { // if event is empty we don't compare (due to blindness)
-        while (tolerance >= 0) {
-            if (descWords.isEmpty()) {
-                if (updated) { // if notUpdated the desc is allowed to be shorter than the event
-                    tolerance -= eventWords.countNonSpaceChars();
+    if (roomWords.isValid() && eventWords.isValid()) {
+        if (!eventWords.empty()) { // if event is empty we don't compare (due to blindness)
+            spendTolerance(tolerance, room, roomWords, event, eventWords, updated);
+        }
+    } else {
+        auto descText = StringView{room}.trim();
+        auto eventText = StringView{event}.trim();
+
+        if (!eventText.isEmpty()) { // if event is empty we don't compare (due to blindness)
+            while (tolerance >= 0) {
+                if (descText.isEmpty()) {
+                    if (updated) { // if notUpdated the desc is allowed to be shorter than the event
+                        tolerance -= eventText.countNonSpaceChars();
+                    }
+                    break;
+                }
+                if (eventText.isEmpty()) { // if we get here the event isn't empty
+                    tolerance -= descText.countNonSpaceChars();
+                    break;
                 }
-                break;
-            }
-            if (eventWords.isEmpty()) { // if we get here the event isn't empty
-                tolerance -= descWords.countNonSpaceChars();
-                break;
-            }
 
-            tolerance -= wordDifference(eventWords.takeFirstWord(), descWords.takeFirstWord());
+                tolerance -= wordDifference(eventText.takeFirstWord(), descText.takeFirstWord());
+            }
         }
     }
 
@@ -388,7 +606,13 @@ ComparisonResultEnum Room::compare(const Room *const room,
         }
     }
 
-    switch (compareStrings(name.getStdString(), event.getRoomName().getStdString(), tolerance)) {
+    switch (compareStrings(name.getStdString(),
+                           room->getNameFingerprint(),
+                           room->getNameWords(),
+                           event.getRoomName().getStdString(),
+                           event.getRoomNameFingerprint(),
+                           event.getRoomNameWords(),
+                           tolerance)) {
     case ComparisonResultEnum::TOLERANCE:
         updated = false;
         break;
@@ -399,7 +623,11 @@ ComparisonResultEnum Room::compare(const Room *const room,
     }
 
     switch (compareStrings(staticDesc.getStdString(),
+                           room->getStaticDescFingerprint(),
+                           room->getStaticDescWords(),
                            event.getStaticDesc().getStdString(),
+                           event.getStaticDescFingerprint(),
+                           event.getStaticDescWords(),
                            tolerance,
                            updated)) {
     case ComparisonResultEnum::TOLERANCE:
@@ -593,6 +821,8 @@ void Room::update(Room &room, const ParseEvent &event)
                 roomExit.updateExit(eventExitFlags);
             }
         }
+        // The exit flags changed through exit(dir), not setExitsList().
+        room.updateExitCaches();
         isUpToDate = true;
     }
 
@@ -705,6 +935,7 @@ void Room::update(Room *const target, const Room *const source)
             targetExit.setDoorFlags(doorFlags);
         }
     }
+    target->updateExitCaches();
     if (source->isUpToDate()) {
         target->setUpToDate();
     }
@@ -767,12 +998,16 @@ const Coordinate &Room::exitDir(ExitDirEnum dir)
     return exitDirs[dir];
 }
 
-std::shared_ptr<Room> Room::clone(RoomModificationTracker &tracker) const
+std::shared_ptr<Room> Room::cloneImpl(RoomModificationTracker &tracker) const
 {
     if (m_status == RoomStatusEnum::Zombie)
         throw std::runtime_error("Attempt to clone a zombie");
 
-    const auto copy = std::make_shared<Room>(this_is_private{0}, tracker, RoomStatusEnum::Temporary);
+    const auto copy = allocateRoom(tracker, RoomStatusEnum::Temporary);
+    // The copy shares unloaded cold text instead of loading it.
+    std::lock_guard<std::mutex> lock{getColdTextMutex()};
+    copy->m_coldPending.store(m_coldPending.load(std::memory_order_relaxed),
+                              std::memory_order_relaxed);
 #define COPY(x) \
     do { \
         copy->x = this->x; \
@@ -780,10 +1015,25 @@ std::shared_ptr<Room> Room::clone(RoomModificationTracker &tracker) const
     COPY(m_position);
     COPY(m_fields);
     COPY(m_exits);
+    COPY(m_nameFingerprint);
+    COPY(m_staticDescFingerprint);
+    COPY(m_nameWords);
+    COPY(m_staticDescWords);
+    COPY(m_flagSignature);
+    COPY(m_exitLayout);
+    COPY(m_exitRenderMasks);
     COPY(m_id);
     COPY(m_status);
     COPY(m_borked);
+    COPY(m_coldSource);
+    COPY(m_coldIndex);
 #undef COPY
+    return copy;
+}
+
+std::shared_ptr<Room> Room::clone(RoomModificationTracker &tracker) const
+{
+    const auto copy = cloneImpl(tracker);
     switch (copy->m_status) {
     case RoomStatusEnum::Permanent:
         copy->m_status = RoomStatusEnum::Temporary;
@@ -795,3 +1045,8 @@ std::shared_ptr<Room> Room::clone(RoomModificationTracker &tracker) const
     }
     return copy;
 }
+
+SharedConstRoom Room::cloneFrozen(RoomModificationTracker &tracker) const
+{
+    return cloneImpl(tracker);
+}
@@ -4,12 +4,16 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <memory>
 #include <optional>
+#include <type_traits>
 #include <QDebug>
 #include <QVariant>
 
+#include "../global/CopyOnWrite.h"
 #include "../global/EnumIndexedArray.h"
 #include "../global/Flags.h"
 #include "../global/RuleOf5.h"
@@ -17,10 +21,16 @@
 #include "../global/roomid.h"
 #include "../mapdata/mmapper2exit.h"
 #include "../mapdata/mmapper2room.h"
+#include "ContentFingerprint.h"
+#include "ExitLayout.h"
+#include "ExitRenderMasks.h"
+#include "RoomFlagSignature.h"
+#include "WordTokens.h"
 #include "coordinate.h"
 #include "exit.h"
 
 class ExitFieldVariant;
+class MemoryUsage;
 class ParseEvent;
 
 enum class FlagModifyModeEnum { SET, UNSET, TOGGLE };
@@ -77,6 +87,8 @@ class RoomModificationTracker
 private:
     bool m_isModified = false;
     bool m_needsMapUpdate = false;
+    // Counts every change to any room; readers on other threads only compare it.
+    std::atomic<uint64_t> m_modificationCount{0};
 
 public:
     virtual ~RoomModificationTracker();
@@ -92,6 +104,9 @@ class RoomModificationTracker
 public:
     bool getNeedsMapUpdate() const { return m_needsMapUpdate; }
     void clearNeedsMapUpdate() { m_needsMapUpdate = false; }
+
+public:
+    uint64_t getModificationCount() const { return m_modificationCount.load(); }
 };
 
 // NOTE: Names are capitalized for use with getRoomName() and setRoomName(),
@@ -115,6 +130,32 @@ using SharedRoom = std::shared_ptr<Room>;
 using SharedConstRoom = std::shared_ptr<const Room>;
 enum class RoomStatusEnum : uint8_t { Zombie, Temporary, Permanent };
 
+// Room text that neither the map view nor path finding needs until a room is
+// looked at closely, so it can be left in the map file; see Room::setColdTextSource().
+template<typename T>
+static constexpr const bool IS_COLD_ROOM_FIELD = std::is_same_v<T, RoomStaticDesc>
+                                                 || std::is_same_v<T, RoomDynamicDesc>
+                                                 || std::is_same_v<T, RoomNote>;
+
+/// Supplies the cold text fields of rooms that were loaded without them.
+class NODISCARD RoomColdTextSource
+{
+public:
+    struct NODISCARD Text final
+    {
+        RoomStaticDesc staticDesc;
+        RoomDynamicDesc dynamicDesc;
+        RoomNote note;
+    };
+
+public:
+    virtual ~RoomColdTextSource();
+
+public:
+    /// Called at most once per room, possibly from any thread.
+    NODISCARD virtual Text load(uint32_t index) const = 0;
+};
+
 class Room final : public std::enable_shared_from_this<Room>
 {
 private:
@@ -132,20 +173,34 @@ class Room final : public std::enable_shared_from_this<Room>
 
 private:
     /* WARNING: If you make any changes to the data members of Room, you'll have to modify clone() */
-    RoomModificationTracker &m_tracker;
+    RoomModificationTracker *m_tracker = nullptr;
     Coordinate m_position;
+    // The text fields are TaggedStrings, which clones already share.
     RoomFields m_fields;
-    ExitsList m_exits;
+    // Shared with clones until either of them changes; exits hold the connection sets, and
+    // word tokens grow with the text.
+    CopyOnWrite<ExitsList> m_exits;
+    ContentFingerprint m_nameFingerprint;
+    ContentFingerprint m_staticDescFingerprint;
+    CopyOnWrite<WordTokens> m_nameWords;
+    CopyOnWrite<WordTokens> m_staticDescWords;
+    RoomFlagSignature m_flagSignature;
+    ExitLayout m_exitLayout;
+    ExitRenderMasks m_exitRenderMasks;
     RoomId m_id = INVALID_ROOMID;
     RoomStatusEnum m_status = RoomStatusEnum::Zombie;
     bool m_borked = true;
+    // Set until the cold text fields have been loaded from m_coldSource.
+    mutable std::atomic<bool> m_coldPending{false};
+    std::shared_ptr<const RoomColdTextSource> m_coldSource;
+    uint32_t m_coldIndex = 0;
 
 private:
-    Exit &exit(ExitDirEnum dir) { return m_exits[dir]; }
+    Exit &exit(ExitDirEnum dir) { return m_exits.mut()[dir]; }
 
 public:
-    const Exit &exit(ExitDirEnum dir) const { return m_exits[dir]; }
-    const ExitsList &getExitsList() const { return m_exits; }
+    const Exit &exit(ExitDirEnum dir) const { return (*m_exits)[dir]; }
+    const ExitsList &getExitsList() const { return *m_exits; }
 
 public:
     void setExitsList(const ExitsList &newExits);
@@ -184,6 +239,8 @@ class Room final : public std::enable_shared_from_this<Room>
     // It's not clear why it can't track their "temporary" status itself.
     bool isTemporary() const { return m_status == RoomStatusEnum::Temporary; }
     void setPermanent();
+    // Only for handing a loaded map over to another admin; see MapFrontend::takeRoomsFrom().
+    void setTracker(RoomModificationTracker &tracker) { m_tracker = &tracker; }
 
     void setAboutToDie();
 
@@ -196,13 +253,67 @@ class Room final : public std::enable_shared_from_this<Room>
 
     void setModified(RoomUpdateFlags updateFlags);
 
+private:
+    void updateComparisonCache(const RoomName &name);
+    void updateComparisonCache(const RoomStaticDesc &desc);
+    template<typename T>
+    void updateComparisonCache(const T &)
+    {}
+    void updateFlagSignature();
+    void updateExitLayout();
+    void updateExitRenderMasks();
+    // For code that changes exit or door flags through exit(dir).
+    void updateExitCaches()
+    {
+        updateFlagSignature();
+        updateExitLayout();
+        updateExitRenderMasks();
+    }
+
+public:
+    const ContentFingerprint &getNameFingerprint() const { return m_nameFingerprint; }
+    const ContentFingerprint &getStaticDescFingerprint() const
+    {
+        ensureColdText();
+        return m_staticDescFingerprint;
+    }
+    const WordTokens &getNameWords() const { return *m_nameWords; }
+    const WordTokens &getStaticDescWords() const
+    {
+        ensureColdText();
+        return *m_staticDescWords;
+    }
+    /// All of the room's flags, including those of its exits.
+    const RoomFlagSignature &getFlagSignature() const { return m_flagSignature; }
+    const ExitLayout &getExitLayout() const { return m_exitLayout; }
+    const ExitRenderMasks &getExitRenderMasks() const { return m_exitRenderMasks; }
+
 public:
 #define DECL_GETTERS_AND_SETTERS(_Type, _Prop, _OptInit) \
-    inline const _Type &get##_Prop() const { return m_fields._Prop; } \
+    inline const _Type &get##_Prop() const \
+    { \
+        if constexpr (IS_COLD_ROOM_FIELD<_Type>) \
+            ensureColdText(); \
+        return m_fields._Prop; \
+    } \
     void set##_Prop(_Type value);
     XFOREACH_ROOM_PROPERTY(DECL_GETTERS_AND_SETTERS)
 #undef DECL_GETTERS_AND_SETTERS
 
+public:
+    // Leaves the static and dynamic descriptions and the note to be loaded by
+    // source.load(index) the first time they're used. This isn't a modification;
+    // it's meant for rooms that are still being loaded.
+    void setColdTextSource(std::shared_ptr<const RoomColdTextSource> source, uint32_t index);
+
+private:
+    void ensureColdText() const
+    {
+        if (m_coldPending.load(std::memory_order_acquire))
+            loadColdText();
+    }
+    void loadColdText() const;
+
 public:
     Room() = delete;
     explicit Room(this_is_private, RoomModificationTracker &tracker, RoomStatusEnum status);
@@ -214,12 +325,19 @@ class Room final : public std::enable_shared_from_this<Room>
     static void update(Room &, const ParseEvent &event);
     static void update(Room *target, const Room *source);
 
+public:
+    /// Counts the room, its exits and its strings; cold text still in the map file isn't.
+    void addMemoryUsage(MemoryUsage &usage) const;
+
 public:
     std::string toStdString() const;
     QString toQString() const { return ::toQStringLatin1(toStdString()); }
     explicit operator QString() const { return toQString(); }
     friend QDebug operator<<(QDebug os, const Room &r) { return os << r.toQString(); }
 
+private:
+    static SharedRoom allocateRoom(RoomModificationTracker &tracker, RoomStatusEnum status);
+
 public:
     static std::shared_ptr<Room> createPermanentRoom(RoomModificationTracker &tracker);
     static std::shared_ptr<Room> createTemporaryRoom(RoomModificationTracker &tracker,
@@ -235,10 +353,19 @@ class Room final : public std::enable_shared_from_this<Room>
 
 private:
     static ComparisonResultEnum compareStrings(const std::string &room,
+                                               const ContentFingerprint &roomFingerprint,
+                                               const WordTokens &roomWords,
                                                const std::string &event,
+                                               const ContentFingerprint &eventFingerprint,
+                                               const WordTokens &eventWords,
                                                int prevTolerance,
                                                bool updated = true);
 
+private:
+    std::shared_ptr<Room> cloneImpl(RoomModificationTracker &tracker) const;
+
 public:
     std::shared_ptr<Room> clone(RoomModificationTracker &tracker) const;
+    // Unlike clone(), this keeps the room's status; see MapSnapshot.
+    SharedConstRoom cloneFrozen(RoomModificationTracker &tracker) const;
 };
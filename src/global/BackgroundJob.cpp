@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "BackgroundJob.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <QMetaObject>
+#include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
+
+struct BackgroundJob::Token::State final
+{
+    QObject &context;
+    std::atomic<bool> cancelled{false};
+
+    explicit State(QObject &context)
+        : context{context}
+    {}
+};
+
+struct BackgroundJob::Tracker final
+{
+    std::mutex mutex;
+    std::condition_variable idle;
+    size_t running = 0; // guarded by mutex
+
+    void begin()
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        ++running;
+    }
+
+    void end()
+    {
+        bool finished = false;
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            finished = (--running == 0);
+        }
+        if (finished) {
+            idle.notify_all();
+        }
+    }
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock{mutex};
+        idle.wait(lock, [this]() { return running == 0; });
+    }
+};
+
+class NODISCARD BackgroundJob::Runner final : public QRunnable
+{
+private:
+    std::shared_ptr<BackgroundJob::Token::State> m_state;
+    std::shared_ptr<BackgroundJob::Tracker> m_tracker;
+    BackgroundJob::Work m_work;
+
+public:
+    explicit Runner(std::shared_ptr<BackgroundJob::Token::State> state,
+                    std::shared_ptr<BackgroundJob::Tracker> tracker,
+                    BackgroundJob::Work work)
+        : m_state{std::move(state)}
+        , m_tracker{std::move(tracker)}
+        , m_work{std::move(work)}
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        if (!m_state->cancelled.load()) {
+            m_work(BackgroundJob::Token{m_state});
+        }
+        // Drop the work before reporting, since it may capture the owner.
+        m_work = nullptr;
+        m_tracker->end();
+    }
+};
+
+BackgroundJob::Token::Token(std::shared_ptr<State> state)
+    : m_state{std::move(state)}
+{}
+
+bool BackgroundJob::Token::isCancelled() const
+{
+    return m_state->cancelled.load();
+}
+
+void BackgroundJob::Token::post(std::function<void()> fn) const
+{
+    if (isCancelled())
+        return;
+    QMetaObject::invokeMethod(
+        &m_state->context,
+        [state = m_state, fn = std::move(fn)]() {
+            if (!state->cancelled.load())
+                fn();
+        },
+        Qt::QueuedConnection);
+}
+
+BackgroundJob::BackgroundJob(QObject &context)
+    : m_context{context}
+    , m_tracker{std::make_shared<Tracker>()}
+{}
+
+BackgroundJob::~BackgroundJob()
+{
+    cancel();
+    wait();
+}
+
+void BackgroundJob::start(Work work)
+{
+    cancel();
+    m_current = std::make_shared<Token::State>(m_context);
+    m_tracker->begin();
+    QThreadPool::globalInstance()->start(new Runner(m_current, m_tracker, std::move(work)));
+}
+
+void BackgroundJob::cancel()
+{
+    if (m_current != nullptr) {
+        m_current->cancelled.store(true);
+        m_current.reset();
+    }
+}
+
+void BackgroundJob::wait()
+{
+    m_tracker->wait();
+}
@@ -0,0 +1,61 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <functional>
+#include <memory>
+
+#include "RuleOf5.h"
+#include "macros.h"
+
+class QObject;
+
+/// Runs one cancellable job at a time on QThreadPool::globalInstance().
+///
+/// Starting a new job cancels the previous one. A job hands results back with
+/// Token::post(), which runs them on the context object's thread unless the job
+/// has been cancelled by then, so a cancelled job never delivers stale output.
+///
+/// The destructor cancels the current job and waits for every job that is still
+/// running, so jobs may safely refer to the object that owns this.
+class NODISCARD BackgroundJob final
+{
+public:
+    class NODISCARD Token final
+    {
+    public:
+        struct State;
+
+    private:
+        std::shared_ptr<State> m_state;
+
+    public:
+        explicit Token(std::shared_ptr<State> state);
+
+    public:
+        /// Jobs should poll this regularly and return early once it's set.
+        NODISCARD bool isCancelled() const;
+        void post(std::function<void()> fn) const;
+    };
+
+    using Work = std::function<void(const Token &token)>;
+
+private:
+    struct Tracker;
+    class Runner;
+    QObject &m_context;
+    std::shared_ptr<Tracker> m_tracker;
+    std::shared_ptr<Token::State> m_current;
+
+public:
+    explicit BackgroundJob(QObject &context);
+    ~BackgroundJob();
+    DELETE_CTORS_AND_ASSIGN_OPS(BackgroundJob);
+
+public:
+    void start(Work work);
+    void cancel();
+    /// Blocks until every job started so far has returned. Anything they posted
+    /// is still delivered through the context object's event loop.
+    void wait();
+};
@@ -12,6 +12,7 @@ class ChangeMonitor final : private ::Signal<>
     using Base = ::Signal<>;
     using Function = Base::Function;
     using CallbackLifetime = Signal::SharedConnection;
+    using DeferredNotifications = Base::Deferrer;
 
 public:
     NODISCARD CallbackLifetime registerChangeCallback(Base::Function callback)
@@ -28,6 +29,8 @@ class ChangeMonitor final : private ::Signal<>
 
 public:
     void notifyAll() { Base::invoke(); }
+    // The callbacks are called once when it's destroyed, if notifyAll() was called.
+    NODISCARD DeferredNotifications deferNotifications() { return Base::defer(); }
 };
 
 struct NODISCARD ConnectionSet final
@@ -0,0 +1,57 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <memory>
+#include <utility>
+
+#include "macros.h"
+
+/// A value that copies share until one of them is changed, so copying is a reference
+/// count increment; the first write through a shared copy gives it a value of its own.
+///
+/// Like the values it holds, one object mustn't be written while it's being read, but
+/// separate copies can be read and written on different threads.
+template<typename T>
+class NODISCARD CopyOnWrite final
+{
+private:
+    // nullptr for a default-constructed value, so empty objects don't allocate.
+    std::shared_ptr<T> m_ptr;
+
+private:
+    NODISCARD static const T &getDefault()
+    {
+        static const T value{};
+        return value;
+    }
+
+public:
+    CopyOnWrite() = default;
+    explicit CopyOnWrite(T value)
+        : m_ptr{std::make_shared<T>(std::move(value))}
+    {}
+
+public:
+    NODISCARD const T &get() const { return (m_ptr == nullptr) ? getDefault() : *m_ptr; }
+    NODISCARD const T &operator*() const { return get(); }
+    NODISCARD const T *operator->() const { return &get(); }
+
+    /// Copies the value first if it's shared; references that get() returned before then
+    /// still refer to the shared value.
+    NODISCARD T &mut()
+    {
+        if (m_ptr == nullptr)
+            m_ptr = std::make_shared<T>();
+        else if (m_ptr.use_count() != 1)
+            m_ptr = std::make_shared<T>(*m_ptr);
+        return *m_ptr;
+    }
+    void set(T value) { m_ptr = std::make_shared<T>(std::move(value)); }
+
+public:
+    NODISCARD bool isSharedWith(const CopyOnWrite &other) const
+    {
+        return m_ptr != nullptr && m_ptr == other.m_ptr;
+    }
+};
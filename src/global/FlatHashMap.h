@@ -0,0 +1,120 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "macros.h"
+
+/// Open-addressing (linear probing) map from 64-bit keys that are already
+/// hashes to values of type V. The slots are one contiguous array, so a lookup
+/// usually touches a single cache line instead of chasing bucket nodes.
+///
+/// Entries can't be removed, which is all ParseTree needs.
+template<typename V>
+class NODISCARD FlatHashMap final
+{
+private:
+    struct NODISCARD Slot final
+    {
+        uint64_t key = 0;
+        V value{};
+        bool used = false;
+    };
+
+    static constexpr const size_t MIN_CAPACITY = 16;
+
+    std::vector<Slot> m_slots;
+    size_t m_size = 0;
+
+private:
+    // The keys are hashes already, but their low bits pick the slot, so any
+    // structure in them is spread out first (the MurmurHash3 finalizer).
+    NODISCARD static size_t mix(uint64_t key) noexcept
+    {
+        key ^= key >> 33u;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33u;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33u;
+        return static_cast<size_t>(key);
+    }
+
+    // The slot holding key, or else the empty slot where it would go.
+    NODISCARD size_t findSlot(const uint64_t key) const
+    {
+        assert(!m_slots.empty());
+        const size_t mask = m_slots.size() - 1u;
+        size_t i = mix(key) & mask;
+        while (m_slots[i].used && m_slots[i].key != key)
+            i = (i + 1u) & mask;
+        return i;
+    }
+
+    // Keeps the load factor at or below 3/4.
+    NODISCARD static size_t capacityFor(const size_t size)
+    {
+        size_t capacity = MIN_CAPACITY;
+        while (capacity / 4u * 3u < size)
+            capacity *= 2u;
+        return capacity;
+    }
+
+    void rehash(const size_t capacity)
+    {
+        std::vector<Slot> old = std::exchange(m_slots, std::vector<Slot>(capacity));
+        for (Slot &slot : old) {
+            if (slot.used)
+                m_slots[findSlot(slot.key)] = std::move(slot);
+        }
+    }
+
+public:
+    NODISCARD size_t size() const { return m_size; }
+    NODISCARD bool empty() const { return m_size == 0; }
+    NODISCARD size_t getMemoryBytes() const { return m_slots.capacity() * sizeof(Slot); }
+
+    void reserve(const size_t size)
+    {
+        const size_t capacity = capacityFor(size);
+        if (capacity > m_slots.size())
+            rehash(capacity);
+    }
+
+public:
+    /// Returns the value for key, inserting a default-constructed one if needed.
+    V &operator[](const uint64_t key)
+    {
+        reserve(m_size + 1u);
+        Slot &slot = m_slots[findSlot(key)];
+        if (!slot.used) {
+            slot.key = key;
+            slot.used = true;
+            ++m_size;
+        }
+        return slot.value;
+    }
+
+    /// Returns nullptr if there's no value for key.
+    NODISCARD const V *find(const uint64_t key) const
+    {
+        if (m_slots.empty())
+            return nullptr;
+        const Slot &slot = m_slots[findSlot(key)];
+        return slot.used ? &slot.value : nullptr;
+    }
+
+    /// Calls f(key, value) for each entry, in no particular order.
+    template<typename F>
+    void forEach(F &&f) const
+    {
+        for (const Slot &slot : m_slots) {
+            if (slot.used)
+                f(slot.key, slot.value);
+        }
+    }
+};
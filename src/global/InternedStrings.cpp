@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "InternedStrings.h"
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace interned {
+namespace {
+struct NODISCARD Entry final
+{
+    const std::string *str = nullptr;
+    std::weak_ptr<const std::string> weak;
+};
+
+// Loading a map interns from several threads at once, so the table is split
+// into independently locked shards.
+struct NODISCARD Shard final
+{
+    std::mutex mutex;
+    // Keys point into the strings themselves.
+    std::unordered_map<std::string_view, Entry> map;
+};
+
+static constexpr const size_t NUM_SHARDS = 16;
+using Table = std::array<Shard, NUM_SHARDS>;
+
+Table &getTable()
+{
+    // Never destroyed: strings held by other statics may die after it would have.
+    static Table *const table = new Table;
+    return *table;
+}
+
+Shard &getShard(const std::string_view s)
+{
+    return getTable()[std::hash<std::string_view>{}(s) % NUM_SHARDS];
+}
+
+void release(Shard &shard, const std::string *const str)
+{
+    {
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        // intern() may have already replaced this entry with a new copy.
+        const auto it = shard.map.find(std::string_view{*str});
+        if (it != shard.map.end() && it->second.str == str)
+            shard.map.erase(it);
+    }
+    delete str;
+}
+} // namespace
+
+SharedString intern(std::string s)
+{
+    Shard &shard = getShard(s);
+    std::lock_guard<std::mutex> lock{shard.mutex};
+    const auto it = shard.map.find(std::string_view{s});
+    if (it != shard.map.end()) {
+        if (SharedString existing = it->second.weak.lock())
+            return existing;
+        // Its last reference is being dropped on another thread right now.
+        shard.map.erase(it);
+    }
+
+    const std::string *const str = new std::string(std::move(s));
+    SharedString result(str, [&shard](const std::string *const p) { release(shard, p); });
+    shard.map.emplace(std::string_view{*str}, Entry{str, result});
+    return result;
+}
+
+size_t getNumStrings()
+{
+    size_t total = 0;
+    for (Shard &shard : getTable()) {
+        std::lock_guard<std::mutex> lock{shard.mutex};
+        total += shard.map.size();
+    }
+    return total;
+}
+} // namespace interned
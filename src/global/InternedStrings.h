@@ -0,0 +1,24 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "macros.h"
+
+/// A process-wide table of immutable, refcounted strings.
+///
+/// Equal strings interned anywhere share one copy, so a map full of rooms named
+/// "A Dark Tunnel" stores that name once, and two interned strings are equal
+/// exactly when they're the same object. Entries are dropped when their last
+/// reference goes away. Safe to use from any thread.
+namespace interned {
+using SharedString = std::shared_ptr<const std::string>;
+
+/// Returns the shared copy of `s`, adding it to the table if needed.
+NODISCARD SharedString intern(std::string s);
+/// Number of distinct strings currently in the table.
+NODISCARD size_t getNumStrings();
+} // namespace interned
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "LogRing.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace { // anonymous
+
+size_t roundUpToPowerOfTwo(const size_t n)
+{
+    size_t result = 1;
+    while (result < n)
+        result <<= 1u;
+    return result;
+}
+
+} // namespace
+
+LogRing::LogRing(const size_t capacity)
+    : m_mask{roundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1}
+    , m_cells{std::make_unique<Cell[]>(m_mask + 1)}
+{
+    for (size_t i = 0; i <= m_mask; ++i)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+LogRing::~LogRing() = default;
+
+bool LogRing::push(const QString &module, const QString &message)
+{
+    size_t pos = m_head.load(std::memory_order_relaxed);
+    Cell *cell = nullptr;
+    for (;;) {
+        cell = &m_cells[pos & m_mask];
+        const size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (seq == pos) {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (seq < pos) {
+            // The consumer hasn't emptied this cell since the last lap.
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->module = module;
+    cell->message = message;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogRing::pop(QString &module, QString &message)
+{
+    Cell &cell = m_cells[m_tail & m_mask];
+    if (cell.sequence.load(std::memory_order_acquire) != m_tail + 1)
+        return false;
+
+    module = std::exchange(cell.module, QString{});
+    message = std::exchange(cell.message, QString{});
+    cell.sequence.store(m_tail + m_mask + 1, std::memory_order_release);
+    ++m_tail;
+    return true;
+}
+
+LogRing::Drained LogRing::drain(const size_t maxLines)
+{
+    Drained result;
+    QString module;
+    QString message;
+    while (pop(module, message)) {
+        if (!result.lines.empty()) {
+            Line &last = result.lines.back();
+            if (last.module == module && last.message == message) {
+                ++last.repeats;
+                continue;
+            }
+        }
+        if (result.lines.size() >= maxLines) {
+            ++result.suppressed;
+            continue;
+        }
+        result.lines.emplace_back(Line{std::move(module), std::move(message), 1});
+    }
+    result.suppressed += m_dropped.exchange(0, std::memory_order_relaxed);
+    return result;
+}
@@ -0,0 +1,72 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include <QString>
+
+#include "RuleOf5.h"
+#include "macros.h"
+
+/// Bounded queue of log lines that any number of threads can push to without
+/// taking a lock, and that one thread (the GUI) drains.
+///
+/// A push while the ring is full drops the line and counts it instead of waiting,
+/// so a burst of logging can never stall the thread that logs.
+class NODISCARD LogRing final
+{
+public:
+    struct NODISCARD Line final
+    {
+        QString module;
+        QString message;
+        // How many identical lines in a row this one stands for.
+        size_t repeats = 1;
+    };
+
+    struct NODISCARD Drained final
+    {
+        std::vector<Line> lines;
+        // Lines dropped because the ring was full, or over the limit given to drain().
+        size_t suppressed = 0;
+    };
+
+private:
+    // Each cell's sequence says whose turn it is: it equals the position a
+    // producer may write at, and that position plus one once the line is there.
+    struct Cell final
+    {
+        std::atomic<size_t> sequence{0};
+        QString module;
+        QString message;
+    };
+
+    const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) size_t m_tail = 0;
+    std::atomic<size_t> m_dropped{0};
+
+public:
+    /// The capacity is rounded up to a power of two.
+    explicit LogRing(size_t capacity);
+    ~LogRing();
+    DELETE_CTORS_AND_ASSIGN_OPS(LogRing);
+
+public:
+    /// Safe to call from any thread; returns false if the line was dropped.
+    bool push(const QString &module, const QString &message);
+
+    /// Consumer only. Takes everything queued so far, folding runs of identical
+    /// lines into one, and keeps at most maxLines of the result.
+    NODISCARD Drained drain(size_t maxLines);
+
+public:
+    NODISCARD size_t capacity() const { return m_mask + 1; }
+
+private:
+    NODISCARD bool pop(QString &module, QString &message);
+};
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "MemoryUsage.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace { // anonymous
+
+struct NODISCARD Published final
+{
+    std::mutex mutex;
+    std::vector<MemoryUsage::Category> categories;
+};
+
+Published &getPublished()
+{
+    static Published published;
+    return published;
+}
+
+QString formatBytes(const size_t bytes)
+{
+    static constexpr const double KIB = 1024.0;
+    static constexpr const double MIB = KIB * KIB;
+    if (bytes >= (1u << 20))
+        return QString("%1 MiB").arg(static_cast<double>(bytes) / MIB, 0, 'f', 1);
+    return QString("%1 KiB").arg(static_cast<double>(bytes) / KIB, 0, 'f', 1);
+}
+
+} // namespace
+
+void MemoryUsage::add(const std::string_view category, const size_t count, const size_t bytes)
+{
+    const auto it = std::find_if(m_categories.begin(),
+                                 m_categories.end(),
+                                 [category](const Category &c) { return c.name == category; });
+    if (it == m_categories.end()) {
+        m_categories.emplace_back(Category{std::string{category}, count, bytes});
+        return;
+    }
+    it->count += count;
+    it->bytes += bytes;
+}
+
+void MemoryUsage::add(const MemoryUsage &other)
+{
+    for (const Category &c : other.m_categories)
+        add(c.name, c.count, c.bytes);
+}
+
+void MemoryUsage::addSharedString(const std::string *const s)
+{
+    if (s == nullptr || !isFirstReference(s))
+        return;
+    add("strings", 1, sizeof(std::string) + s->capacity());
+}
+
+size_t MemoryUsage::getTotalBytes() const
+{
+    size_t total = 0;
+    for (const Category &c : m_categories)
+        total += c.bytes;
+    return total;
+}
+
+QString MemoryUsage::toString() const
+{
+    QString result;
+    for (const Category &c : m_categories) {
+        result += QString("%1 %2 (%3)\n")
+                      .arg(QString::fromStdString(c.name) + ":", -16)
+                      .arg(formatBytes(c.bytes), 10)
+                      .arg(c.count);
+    }
+    result += QString("%1 %2\n").arg("total:", -16).arg(formatBytes(getTotalBytes()), 10);
+    return result;
+}
+
+void publishMemoryUsage(const std::string_view category, const size_t count, const size_t bytes)
+{
+    Published &published = getPublished();
+    std::lock_guard<std::mutex> lock{published.mutex};
+    auto &categories = published.categories;
+    const auto it = std::find_if(categories.begin(),
+                                 categories.end(),
+                                 [category](const auto &c) { return c.name == category; });
+    if (it == categories.end()) {
+        categories.emplace_back(MemoryUsage::Category{std::string{category}, count, bytes});
+        return;
+    }
+    it->count = count;
+    it->bytes = bytes;
+}
+
+MemoryUsage getPublishedMemoryUsage()
+{
+    Published &published = getPublished();
+    std::lock_guard<std::mutex> lock{published.mutex};
+    MemoryUsage result;
+    for (const auto &c : published.categories)
+        result.add(c.name, c.count, c.bytes);
+    return result;
+}
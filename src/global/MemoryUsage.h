@@ -0,0 +1,65 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <QString>
+
+#include "macros.h"
+
+/// An estimate of the memory held by each part of MMapper, for the "memory"
+/// command and the About dialog.
+///
+/// The figures are the objects themselves and what their containers reserved,
+/// without the allocator's overhead, so they're a lower bound. Data shared by
+/// several owners (e.g. interned strings) is counted once.
+class NODISCARD MemoryUsage final
+{
+public:
+    struct NODISCARD Category final
+    {
+        std::string name;
+        size_t count = 0;
+        size_t bytes = 0;
+    };
+
+private:
+    std::vector<Category> m_categories;
+    std::unordered_set<const void *> m_seen;
+
+public:
+    /// Adds to the named category, which is listed in the order it was first added.
+    void add(std::string_view category, size_t count, size_t bytes);
+    void add(const MemoryUsage &other);
+    /// True the first time it's given `p`, so that shared data is only counted once.
+    NODISCARD bool isFirstReference(const void *p) { return m_seen.insert(p).second; }
+    /// Counts a string that may be shared (see TaggedString::getSharedString()).
+    void addSharedString(const std::string *s);
+
+public:
+    NODISCARD const std::vector<Category> &getCategories() const { return m_categories; }
+    NODISCARD size_t getTotalBytes() const;
+    /// One line per category, then the total.
+    NODISCARD QString toString() const;
+};
+
+/// The nodes and buckets of a std::unordered_map or std::unordered_set,
+/// but not what its values own.
+template<typename HashTable>
+NODISCARD size_t estimateHashTableBytes(const HashTable &table)
+{
+    // Each node holds its value, the next pointer and the cached hash.
+    static constexpr const size_t NODE_BYTES = sizeof(typename HashTable::value_type)
+                                               + sizeof(void *) + sizeof(size_t);
+    return sizeof(table) + table.bucket_count() * sizeof(void *) + table.size() * NODE_BYTES;
+}
+
+/// For the parts of MMapper that can't be asked from another thread (e.g. the
+/// map canvas, which owns the OpenGL buffers); they publish their usage when it
+/// changes instead, and it replaces whatever they published before.
+void publishMemoryUsage(std::string_view category, size_t count, size_t bytes);
+NODISCARD MemoryUsage getPublishedMemoryUsage();
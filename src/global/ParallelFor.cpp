@@ -0,0 +1,116 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "macros.h"
+
+namespace {
+struct NODISCARD SharedState final
+{
+    const std::function<void(size_t, size_t)> &fn;
+    const size_t count;
+    const size_t chunkSize;
+    std::atomic<size_t> next{0};
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t inFlight = 0; // guarded by mutex
+
+    explicit SharedState(const std::function<void(size_t, size_t)> &fn,
+                         const size_t count,
+                         const size_t chunkSize)
+        : fn{fn}
+        , count{count}
+        , chunkSize{chunkSize}
+    {}
+
+    // Runs chunks until none are left; safe to call from any number of threads.
+    void drain()
+    {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                ++inFlight;
+            }
+            const size_t begin = next.fetch_add(chunkSize);
+            if (begin < count) {
+                fn(begin, std::min(begin + chunkSize, count));
+            }
+
+            bool finished = false;
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                finished = (--inFlight == 0);
+            }
+            if (finished) {
+                done.notify_all();
+            }
+            if (begin >= count) {
+                return;
+            }
+        }
+    }
+};
+
+class NODISCARD ChunkRunner final : public QRunnable
+{
+private:
+    // Keeps the state alive for workers that only start after the caller returned.
+    std::shared_ptr<SharedState> m_state;
+
+public:
+    explicit ChunkRunner(std::shared_ptr<SharedState> state)
+        : m_state{std::move(state)}
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        // Late starters must not touch fn, which may be gone by now.
+        if (m_state->next.load() >= m_state->count) {
+            return;
+        }
+        m_state->drain();
+    }
+};
+} // namespace
+
+void parallelFor(const size_t count,
+                 const size_t minChunkSize,
+                 const std::function<void(size_t, size_t)> &fn)
+{
+    if (count == 0) {
+        return;
+    }
+
+    QThreadPool &pool = *QThreadPool::globalInstance();
+    const size_t chunkSize = std::max<size_t>(1, minChunkSize);
+    const size_t numChunks = (count + chunkSize - 1) / chunkSize;
+    const size_t numWorkers = std::min(numChunks,
+                                       static_cast<size_t>(std::max(1, pool.maxThreadCount())))
+                              - 1;
+    if (numWorkers == 0) {
+        fn(0, count);
+        return;
+    }
+
+    const auto state = std::make_shared<SharedState>(fn, count, chunkSize);
+    for (size_t i = 0; i < numWorkers; ++i) {
+        pool.start(new ChunkRunner(state));
+    }
+
+    state->drain();
+
+    // Every chunk has been claimed; wait for the ones still running elsewhere.
+    std::unique_lock<std::mutex> lock{state->mutex};
+    state->done.wait(lock, [&state]() { return state->inFlight == 0; });
+}
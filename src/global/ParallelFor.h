@@ -0,0 +1,20 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <functional>
+
+/// Calls fn(begin, end) for consecutive chunks covering [0, count), spreading the
+/// chunks over QThreadPool::globalInstance() and the calling thread. Returns once
+/// every chunk has finished.
+///
+/// The calling thread also pulls chunks, so this never waits on workers that
+/// haven't started yet and makes progress even if the pool is busy. Small inputs
+/// (fewer than two chunks) run inline.
+///
+/// NOTE: fn must be safe to call concurrently for disjoint ranges, and the order
+/// in which chunks run is unspecified; write results by index to stay deterministic.
+void parallelFor(size_t count,
+                 size_t minChunkSize,
+                 const std::function<void(size_t begin, size_t end)> &fn);
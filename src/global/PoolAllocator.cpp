@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "PoolAllocator.h"
+
+#include <cassert>
+
+FixedBlockPool::FixedBlockPool(const size_t blockSize, const size_t blocksPerSlab)
+    : m_blockSize{blockSize}
+    , m_blocksPerSlab{blocksPerSlab}
+{
+    assert(m_blockSize >= sizeof(FreeBlock));
+    assert(m_blockSize % alignof(FreeBlock) == 0);
+    assert(m_blocksPerSlab > 0);
+}
+
+FixedBlockPool::~FixedBlockPool()
+{
+    for (std::byte *const slab : m_slabs) {
+        ::operator delete(slab);
+    }
+}
+
+void FixedBlockPool::addSlab()
+{
+    // operator new returns memory aligned for any fundamental type.
+    auto *const slab = static_cast<std::byte *>(::operator new(m_blockSize * m_blocksPerSlab));
+    m_slabs.emplace_back(slab);
+
+    // Thread the blocks in address order, so consecutive allocations are adjacent.
+    for (size_t i = m_blocksPerSlab; i-- > 0;) {
+        auto *const block = new (slab + i * m_blockSize) FreeBlock{};
+        block->next = m_freeList;
+        m_freeList = block;
+    }
+}
+
+void *FixedBlockPool::allocate()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_freeList == nullptr)
+        addSlab();
+
+    FreeBlock *const block = m_freeList;
+    m_freeList = block->next;
+    ++m_numAllocated;
+    return block;
+}
+
+void FixedBlockPool::deallocate(void *const ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    assert(m_numAllocated > 0);
+    --m_numAllocated;
+    auto *const block = new (ptr) FreeBlock{};
+    block->next = m_freeList;
+    m_freeList = block;
+}
+
+size_t FixedBlockPool::getNumAllocated()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_numAllocated;
+}
+
+size_t FixedBlockPool::getNumReserved()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_slabs.size() * m_blocksPerSlab;
+}
@@ -0,0 +1,123 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "RuleOf5.h"
+#include "macros.h"
+
+/// Thread-safe pool of fixed-size blocks carved out of large slabs.
+///
+/// Objects allocated back-to-back end up next to each other in memory, and
+/// freed blocks are recycled through an intrusive free list instead of going
+/// back to the general-purpose heap. Slabs are only released when the pool
+/// itself is destroyed, which never happens for the pools used by PoolAllocator.
+class NODISCARD FixedBlockPool final
+{
+private:
+    struct FreeBlock final
+    {
+        FreeBlock *next = nullptr;
+    };
+
+    const size_t m_blockSize;
+    const size_t m_blocksPerSlab;
+    std::mutex m_mutex;
+    std::vector<std::byte *> m_slabs;
+    FreeBlock *m_freeList = nullptr;
+    size_t m_numAllocated = 0;
+
+public:
+    explicit FixedBlockPool(size_t blockSize, size_t blocksPerSlab);
+    ~FixedBlockPool();
+    DELETE_CTORS_AND_ASSIGN_OPS(FixedBlockPool);
+
+public:
+    NODISCARD void *allocate();
+    void deallocate(void *ptr) noexcept;
+
+public:
+    NODISCARD size_t getBlockSize() const { return m_blockSize; }
+    NODISCARD size_t getNumAllocated();
+    NODISCARD size_t getNumReserved();
+
+private:
+    void addSlab();
+
+public:
+    /// One pool per block size and alignment, shared by every allocator that needs it.
+    template<size_t BlockSize, size_t Alignment>
+    static FixedBlockPool &getInstance()
+    {
+        static_assert(Alignment <= alignof(std::max_align_t));
+        static constexpr const size_t SLAB_BYTES = 64 * 1024;
+        static constexpr const size_t BLOCK = roundUp(BlockSize, Alignment);
+        static constexpr const size_t PER_SLAB = (SLAB_BYTES / BLOCK) < 32 ? 32
+                                                                           : (SLAB_BYTES / BLOCK);
+        // Intentionally never destroyed, so pooled objects owned by other statics
+        // can still be released safely during shutdown.
+        static FixedBlockPool &pool = *new FixedBlockPool{BLOCK, PER_SLAB};
+        return pool;
+    }
+
+private:
+    static constexpr size_t roundUp(const size_t n, const size_t alignment)
+    {
+        const size_t minimum = (n < sizeof(FreeBlock)) ? sizeof(FreeBlock) : n;
+        const size_t align = (alignment < alignof(FreeBlock)) ? alignof(FreeBlock) : alignment;
+        return (minimum + align - 1) / align * align;
+    }
+};
+
+/// Standard allocator that serves single-object allocations from a FixedBlockPool.
+///
+/// This is meant for std::allocate_shared(), which rebinds the allocator to its
+/// internal control block type, so the object and its reference counts share one
+/// pooled block. Array allocations fall back to the global heap.
+template<typename T>
+class PoolAllocator final
+{
+public:
+    using value_type = T;
+
+    PoolAllocator() noexcept = default;
+    template<typename U>
+    PoolAllocator(const PoolAllocator<U> &) noexcept
+    {}
+
+    NODISCARD T *allocate(const size_t n)
+    {
+        if (n == 1)
+            return static_cast<T *>(getPool().allocate());
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *const ptr, const size_t n) noexcept
+    {
+        if (n == 1)
+            getPool().deallocate(ptr);
+        else
+            ::operator delete(ptr);
+    }
+
+    template<typename U>
+    bool operator==(const PoolAllocator<U> &) const noexcept
+    {
+        return true;
+    }
+    template<typename U>
+    bool operator!=(const PoolAllocator<U> &) const noexcept
+    {
+        return false;
+    }
+
+private:
+    static FixedBlockPool &getPool()
+    {
+        return FixedBlockPool::getInstance<sizeof(T), alignof(T)>();
+    }
+};
@@ -3,10 +3,14 @@
 // Copyright (C) 2019 The MMapper Authors
 
 #include <cassert>
+#include <algorithm>
 #include <functional>
-#include <list>
 #include <memory>
+#include <optional>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 #include <QDebug>
 
 #include "RuleOf5.h"
@@ -94,8 +98,14 @@ struct Signal
     using WeakConnection = std::weak_ptr<Connection>;
 
 private:
-    std::list<WeakConnection> m_connections;
+    std::vector<WeakConnection> m_connections;
+    // While invoke() is iterating, disconnected entries are only reset, and they're
+    // removed once the outermost invoke() returns.
+    int m_invokeDepth = 0;
+    bool m_needsCompaction = false;
     int m_disableCount = 0;
+    int m_deferCount = 0;
+    std::optional<std::tuple<Args...>> m_deferred;
 
 public:
     Signal() { static_assert(Connection::hasValidArgTypes()); }
@@ -124,6 +134,43 @@ struct Signal
         }
     }
 
+    void compact()
+    {
+        assert(m_invokeDepth == 0);
+        if (!std::exchange(m_needsCompaction, false))
+            return;
+        m_connections.erase(std::remove_if(m_connections.begin(),
+                                           m_connections.end(),
+                                           [](const WeakConnection &weakConnection) {
+                                               return weakConnection.expired();
+                                           }),
+                            m_connections.end());
+    }
+
+    // Doesn't allocate; connections made by the callbacks aren't called until the next time.
+    void invokeConnections(Args... args)
+    {
+        const size_t numConnections = m_connections.size();
+        ++m_invokeDepth;
+        for (size_t i = 0; i < numConnections; ++i) {
+            const SharedConnection sharedConnection = m_connections[i].lock();
+            if (sharedConnection == nullptr) {
+                m_needsCompaction = true;
+                continue;
+            }
+            try {
+                sharedConnection->invoke(args...);
+            } catch (...) {
+                reportException();
+                qInfo() << "Automatically removing connection that threw an exception";
+                m_connections[i].reset();
+                m_needsCompaction = true;
+            }
+        }
+        if (--m_invokeDepth == 0)
+            compact();
+    }
+
 public:
     void invoke(Args... args)
     {
@@ -131,27 +178,13 @@ struct Signal
         if (m_disableCount > 0)
             return;
 
-        m_connections.remove_if(
-            [tuple = std::tuple<Args...>(args...)](const WeakConnection &weakConnection) {
-                if (const SharedConnection sharedConnection = weakConnection.lock()) {
-                    try {
-                        const Connection &connection = *sharedConnection;
-                        std::apply(
-                            [&connection](Args... tupleArgs) {
-                                ///
-                                connection.invoke(tupleArgs...);
-                            },
-                            tuple);
-                        return false;
-                    } catch (...) {
-                        reportException();
-                        qInfo() << "Automatically removing connection that threw an exception";
-                        return true;
-                    }
-                } else {
-                    return true;
-                }
-            });
+        assert(m_deferCount >= 0);
+        if (m_deferCount > 0) {
+            m_deferred.emplace(args...);
+            return;
+        }
+
+        invokeConnections(args...);
     }
 
     void operator()(Args &&... args) { invoke(std::forward<Args>(args)...); }
@@ -186,12 +219,14 @@ struct Signal
         if (m_connections.empty())
             return;
 
-        m_connections.remove_if([&toRemove](WeakConnection &weakConnection) {
-            if (auto shared = weakConnection.lock()) {
-                return shared.get() == &toRemove;
-            }
-            return true;
-        });
+        for (WeakConnection &weakConnection : m_connections) {
+            const auto shared = weakConnection.lock();
+            if (shared == nullptr || shared.get() == &toRemove)
+                weakConnection.reset();
+        }
+        m_needsCompaction = true;
+        if (m_invokeDepth == 0)
+            compact();
     }
 
 public:
@@ -218,4 +253,42 @@ struct Signal
         ++m_disableCount;
         return ReEnabler{*this};
     }
+
+public:
+    // Collapses the invocations made while it's alive into one, with the last arguments,
+    // when the outermost Deferrer is destroyed.
+    struct NODISCARD Deferrer final
+    {
+    private:
+        friend Signal;
+        Signal &m_self;
+        explicit Deferrer(Signal &self)
+            : m_self{self}
+        {}
+
+    public:
+        DELETE_CTORS_AND_ASSIGN_OPS(Deferrer);
+        ~Deferrer()
+        {
+            assert(m_self.m_deferCount > 0);
+            if (--m_self.m_deferCount == 0)
+                m_self.invokeDeferred();
+        }
+    };
+
+    NODISCARD Deferrer defer()
+    {
+        ++m_deferCount;
+        return Deferrer{*this};
+    }
+
+private:
+    void invokeDeferred()
+    {
+        if (!m_deferred.has_value())
+            return;
+        const std::tuple<Args...> args = std::move(m_deferred.value());
+        m_deferred.reset();
+        std::apply([this](const Args &... tupleArgs) { invoke(tupleArgs...); }, args);
+    }
 };
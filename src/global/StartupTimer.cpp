@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "StartupTimer.h"
+
+#include <chrono>
+#include <vector>
+#include <QDebug>
+#include <QString>
+#include <QStringList>
+
+#include "Trace.h"
+#include "macros.h"
+
+namespace { // anonymous
+
+struct NODISCARD Phase final
+{
+    const char *name = nullptr;
+    trace::Clock::duration duration{};
+};
+
+// Startup only happens on the main thread, so there's nothing to lock.
+struct NODISCARD State final
+{
+    bool started = false;
+    bool finished = false;
+    trace::Clock::time_point begin;
+    trace::Clock::time_point last;
+    std::vector<Phase> phases;
+};
+
+State &getState()
+{
+    static State state;
+    return state;
+}
+
+double toMilliseconds(const trace::Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+} // namespace
+
+void startup::begin()
+{
+    State &state = getState();
+    state.started = true;
+    state.begin = state.last = trace::Clock::now();
+}
+
+void startup::mark(const char *const phase)
+{
+    State &state = getState();
+    if (!state.started || state.finished)
+        return;
+
+    const auto now = trace::Clock::now();
+    if (trace::isEnabled())
+        trace::record(phase, state.last, now);
+    state.phases.emplace_back(Phase{phase, now - state.last});
+    state.last = now;
+}
+
+void startup::finish()
+{
+    State &state = getState();
+    if (!state.started || state.finished)
+        return;
+    state.finished = true;
+
+    QStringList phases;
+    for (const Phase &phase : state.phases) {
+        const double ms = toMilliseconds(phase.duration);
+        phases << QString("%1 %2 ms").arg(phase.name).arg(ms, 0, 'f', 1);
+    }
+    qInfo().noquote() << QString("[startup] Usable after %1 ms (%2)")
+                             .arg(toMilliseconds(state.last - state.begin), 0, 'f', 1)
+                             .arg(phases.join(", "));
+}
@@ -0,0 +1,20 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+/// Times the phases of startup, from main() until the main window is usable.
+///
+/// Each phase ends where the next begins, so only the ends are marked. The
+/// phases are also recorded as trace events (see Trace.h), and are logged as
+/// one line when startup finishes.
+namespace startup {
+
+/// Starts the clock; call it first thing in main().
+void begin();
+/// Ends the phase that began at the previous mark (or at begin()).
+/// `phase` must outlive the process, e.g. a string literal.
+void mark(const char *phase);
+/// Logs the phases; any marks after this are ignored.
+void finish();
+
+} // namespace startup
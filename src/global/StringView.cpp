@@ -4,20 +4,144 @@
 
 #include "StringView.h"
 
-#include <cctype>
+#include <cstdint>
 #include <iostream>
 #include <stdexcept>
 #include <string>
 #include <vector>
 #include <QString>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MMAPPER_STRINGVIEW_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MMAPPER_STRINGVIEW_NEON
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #include "TextUtils.h"
 
-static bool is_space(char c)
+// Same as std::isspace() in the "C" locale: space, \t, \n, \v, \f and \r.
+static constexpr bool is_space(const char c)
 {
-    return std::isspace(static_cast<uint8_t>(c) & 0xff);
+    return c == ' ' || static_cast<uint8_t>(static_cast<uint8_t>(c) - '\t') <= '\r' - '\t';
 }
 
+namespace { // anonymous
+namespace scan {
+
+static constexpr const size_t BLOCK_SIZE = 16;
+
+static int countTrailingZeros(const uint32_t x)
+{
+    assert(x != 0);
+#if defined(_MSC_VER)
+    unsigned long result = 0;
+    _BitScanForward(&result, x);
+    return static_cast<int>(result);
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+static int popCount(uint32_t x)
+{
+#if defined(_MSC_VER)
+    int result = 0;
+    for (; x != 0; x &= x - 1)
+        ++result;
+    return result;
+#else
+    return __builtin_popcount(x);
+#endif
+}
+
+// Bit i is set if p[i] is a space.
+static uint32_t getSpaceMask(const char *const p)
+{
+#if defined(MMAPPER_STRINGVIEW_SSE2)
+    const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const __m128i isBlank = _mm_cmpeq_epi8(c, _mm_set1_epi8(' '));
+    // (c - '\t') <= ('\r' - '\t') as unsigned bytes
+    const __m128i offset = _mm_sub_epi8(c, _mm_set1_epi8('\t'));
+    const __m128i isControl = _mm_cmpeq_epi8(_mm_subs_epu8(offset, _mm_set1_epi8('\r' - '\t')),
+                                             _mm_setzero_si128());
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(isBlank, isControl)));
+#elif defined(MMAPPER_STRINGVIEW_NEON)
+    static const uint8_t BITS[BLOCK_SIZE] = {1, 2, 4, 8, 16, 32, 64, 128, //
+                                             1, 2, 4, 8, 16, 32, 64, 128};
+    const uint8x16_t c = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+    const uint8x16_t isBlank = vceqq_u8(c, vdupq_n_u8(' '));
+    const uint8x16_t isControl = vcleq_u8(vsubq_u8(c, vdupq_n_u8('\t')),
+                                          vdupq_n_u8('\r' - '\t'));
+    const uint8x16_t bits = vandq_u8(vorrq_u8(isBlank, isControl), vld1q_u8(BITS));
+    uint8x8_t sum = vpadd_u8(vget_low_u8(bits), vget_high_u8(bits));
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    return static_cast<uint32_t>(vget_lane_u8(sum, 0))
+           | (static_cast<uint32_t>(vget_lane_u8(sum, 1)) << 8);
+#else
+    uint32_t result = 0;
+    for (size_t i = 0; i < BLOCK_SIZE; ++i)
+        if (is_space(p[i]))
+            result |= 1u << i;
+    return result;
+#endif
+}
+
+static constexpr const uint32_t ALL_BITS = (1u << BLOCK_SIZE) - 1u;
+
+// Returns the first character in [begin, end) that is (or isn't) a space, or end.
+static const char *find(const char *begin, const char *const end, const bool space)
+{
+    for (; end - begin >= static_cast<ptrdiff_t>(BLOCK_SIZE); begin += BLOCK_SIZE) {
+        const uint32_t mask = space ? getSpaceMask(begin) : (~getSpaceMask(begin) & ALL_BITS);
+        if (mask != 0)
+            return begin + countTrailingZeros(mask);
+    }
+    for (; begin != end; ++begin)
+        if (is_space(*begin) == space)
+            break;
+    return begin;
+}
+
+static size_t countSpaces(const char *begin, const char *const end)
+{
+    size_t result = 0;
+    for (; end - begin >= static_cast<ptrdiff_t>(BLOCK_SIZE); begin += BLOCK_SIZE)
+        result += static_cast<size_t>(popCount(getSpaceMask(begin)));
+    for (; begin != end; ++begin)
+        if (is_space(*begin))
+            ++result;
+    return result;
+}
+
+// A word starts at each non-space that follows a space (or the start).
+static size_t countWords(const char *begin, const char *const end)
+{
+    size_t result = 0;
+    uint32_t prevSpace = 1;
+    for (; end - begin >= static_cast<ptrdiff_t>(BLOCK_SIZE); begin += BLOCK_SIZE) {
+        const uint32_t spaces = getSpaceMask(begin);
+        const uint32_t starts = ~spaces & ((spaces << 1) | prevSpace) & ALL_BITS;
+        result += static_cast<size_t>(popCount(starts));
+        prevSpace = (spaces >> (BLOCK_SIZE - 1)) & 1u;
+    }
+    for (; begin != end; ++begin) {
+        const bool space = is_space(*begin);
+        if (!space && prevSpace != 0)
+            ++result;
+        prevSpace = space ? 1 : 0;
+    }
+    return result;
+}
+
+} // namespace scan
+} // namespace
+
 StringView::StringView(const std::string_view &sv) noexcept
     : m_sv{sv}
 {}
@@ -41,12 +165,6 @@ QByteArray StringView::toQByteArray() const noexcept(false)
     return ::toQByteArrayLatin1(m_sv);
 }
 
-void StringView::eatFirst()
-{
-    assert(!isEmpty());
-    m_sv.remove_prefix(1);
-}
-
 void StringView::eatLast()
 {
     assert(!isEmpty());
@@ -55,9 +173,9 @@ void StringView::eatLast()
 
 StringView &StringView::trimLeft() noexcept
 {
-    for (; !isEmpty(); eatFirst())
-        if (!is_space(firstChar()))
-            break;
+    const char *const begin = m_sv.data();
+    const char *const first = scan::find(begin, begin + m_sv.size(), false);
+    m_sv.remove_prefix(static_cast<size_t>(first - begin));
     return *this;
 }
 
@@ -107,12 +225,10 @@ StringView StringView::takeFirstWordNoPostTrim() noexcept(false)
 
     assert(!is_space(lastChar()));
 
-    size_t len = 0;
     const auto before = m_sv;
-    for (; !isEmpty(); eatFirst(), ++len)
-        if (is_space(firstChar()))
-            break;
-
+    const char *const begin = m_sv.data();
+    const auto len = static_cast<size_t>(scan::find(begin, begin + m_sv.size(), true) - begin);
+    m_sv.remove_prefix(len);
     return StringView{before.substr(0, len)};
 }
 
@@ -125,22 +241,32 @@ StringView StringView::takeFirstWord() noexcept(false)
 
 int StringView::countNonSpaceChars() const noexcept
 {
-    int result = 0;
-    for (char c : m_sv)
-        if (!is_space(c))
-            ++result;
-    return result;
+    const char *const begin = m_sv.data();
+    return static_cast<int>(m_sv.size() - scan::countSpaces(begin, begin + m_sv.size()));
 }
 
-/* NOTE: This must be flagged noexcept(false) because it calls takeFirstWord() */
 int StringView::countWords() const noexcept(false)
 {
-    auto tmp = *this;
-    tmp.trim();
+    const char *const begin = m_sv.data();
+    return static_cast<int>(scan::countWords(begin, begin + m_sv.size()));
+}
 
-    int result = 0;
-    for (; !tmp.isEmpty(); tmp.takeFirstWord())
+size_t StringView::getWords(StringView *const buffer, const size_t capacity) const noexcept
+{
+    assert(buffer != nullptr || capacity == 0);
+    const char *it = m_sv.data();
+    const char *const end = it + m_sv.size();
+
+    size_t result = 0;
+    for (;;) {
+        const char *const first = scan::find(it, end, false);
+        if (first == end)
+            break;
+        it = scan::find(first, end, true);
+        if (result < capacity)
+            buffer[result] = StringView{std::string_view{first, static_cast<size_t>(it - first)}};
         ++result;
+    }
     return result;
 }
 
@@ -148,16 +274,10 @@ std::vector<StringView> StringView::getWords() const noexcept(false)
 {
     const auto numWords = countWords();
     assert(numWords >= 0);
-    std::vector<StringView> result{};
-    result.reserve(static_cast<size_t>(numWords));
-
-    auto tmp = *this;
-    tmp.trim();
-
-    while (!tmp.isEmpty())
-        result.emplace_back(tmp.takeFirstWord());
-
-    assert(static_cast<int>(result.size()) == numWords);
+    std::vector<StringView> result(static_cast<size_t>(numWords));
+    const size_t written = getWords(result.data(), result.size());
+    assert(written == result.size());
+    static_cast<void>(written);
     return result;
 }
 
@@ -514,6 +634,30 @@ static void testLazyDog(const bool verbose = false)
     }
 }
 
+static void testWordBuffer()
+{
+    // longer than a 16-byte block, with words across the block boundaries
+    const std::string s = " \v alpha  beta\tgamma-delta\r\nepsilon        zeta eta \f";
+    const StringView view{s};
+    TEST_ASSERT(view.countWords() == 6);
+    TEST_ASSERT(view.countNonSpaceChars() == 34);
+
+    StringView buffer[4];
+    TEST_ASSERT(view.getWords(buffer, 4) == 6);
+    TEST_ASSERT(buffer[0] == std::string_view{"alpha"});
+    TEST_ASSERT(buffer[2] == std::string_view{"gamma-delta"});
+    TEST_ASSERT(buffer[3] == std::string_view{"epsilon"});
+    TEST_ASSERT(view.getWords(nullptr, 0) == 6);
+
+    const auto words = view.getWords();
+    TEST_ASSERT(words.size() == 6 && words.back() == std::string_view{"eta"});
+
+    auto tmp = view;
+    TEST_ASSERT(tmp.trim() == std::string_view{s}.substr(3, s.size() - 5));
+    TEST_ASSERT(tmp.takeFirstWord() == std::string_view{"alpha"});
+    TEST_ASSERT(tmp.firstChar() == 'b');
+}
+
 static void testIntersect()
 {
     const std::string s = "test";
@@ -552,6 +696,7 @@ void testStringView()
 {
     testEmpty();
     testLazyDog();
+    testWordBuffer();
     testIntersect();
     testSubstring();
     std::cout << "Test \"" << __FUNCTION__ << "\" passed.\n" << std::flush;
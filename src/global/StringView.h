@@ -54,7 +54,6 @@ struct StringView final
 
 private:
     void mustNotBeEmpty() const noexcept(false);
-    void eatFirst();
     void eatLast();
 
 public:
@@ -72,6 +71,9 @@ struct StringView final
     int countNonSpaceChars() const noexcept;
     int countWords() const noexcept(false);
     std::vector<StringView> getWords() const noexcept(false);
+    // Writes the first `capacity` words to `buffer`, and returns the number of words
+    // (which can be more than `capacity`, like snprintf).
+    size_t getWords(StringView *buffer, size_t capacity) const noexcept;
     std::vector<std::string> getWordsAsStdStrings() const noexcept(false);
     std::vector<QString> getWordsAsQStrings() const noexcept(false);
 
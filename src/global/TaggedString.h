@@ -3,44 +3,74 @@
 // Copyright (C) 2019 The MMapper Authors
 
 #include <cassert>
+#include <memory>
 #include <string>
+#include <type_traits>
 #include <QByteArray>
 #include <QString>
 
+#include "InternedStrings.h"
 #include "RuleOf5.h"
 #include "TextUtils.h"
 
+// Tags of strings that repeat a lot (e.g. room names) can declare
+//     static constexpr const bool is_interned = true;
+// so that equal strings share a single copy; see InternedStrings.h.
+template<typename T, typename = void>
+struct is_interned_tag : std::false_type
+{};
+template<typename T>
+struct is_interned_tag<T, std::void_t<decltype(T::is_interned)>>
+    : std::bool_constant<T::is_interned>
+{};
+
 // Latin1
 template<typename T>
 class TaggedString
 {
 private:
-    std::string m_str;
+    // Immutable, so copies share it; nullptr for the empty string.
+    std::shared_ptr<const std::string> m_str;
+
+    static std::shared_ptr<const std::string> share(std::string s)
+    {
+        if (s.empty())
+            return nullptr;
+        if constexpr (is_interned_tag<T>::value)
+            return interned::intern(std::move(s));
+        else
+            return std::make_shared<const std::string>(std::move(s));
+    }
 
 public:
     TaggedString() = default;
     explicit TaggedString(std::nullptr_t) = delete;
     explicit TaggedString(const char *const s)
-        : m_str((s == nullptr) ? "" : s)
+        : m_str(share((s == nullptr) ? "" : s))
     {
         assert(s != nullptr);
     }
     template<size_t N>
     explicit TaggedString(const char (&s)[N])
-        : m_str(s, N)
+        : m_str(share(std::string(s, N)))
     {
         assert(s != nullptr);
     }
     explicit TaggedString(std::string s)
-        : m_str(std::move(s))
+        : m_str(share(std::move(s)))
     {}
     explicit TaggedString(const QString &s)
-        : m_str(::toStdStringLatin1(s))
+        : m_str(share(::toStdStringLatin1(s)))
     {}
     DEFAULT_RULE_OF_5(TaggedString);
 
 public:
-    bool operator==(const TaggedString &rhs) const { return m_str == rhs.m_str; }
+    // Interned strings are equal exactly when they're the same object.
+    bool operator==(const TaggedString &rhs) const
+    {
+        return m_str == rhs.m_str
+               || (!is_interned_tag<T>::value && getStdString() == rhs.getStdString());
+    }
     bool operator!=(const TaggedString &rhs) const { return !(rhs == *this); }
 
 #if 0
@@ -68,12 +98,18 @@ class TaggedString
     }
 
 public:
-    const std::string &getStdString() const { return m_str; }
-    QByteArray toQByteArray() const { return ::toQByteArrayLatin1(m_str); }
-    QString toQString() const { return ::toQStringLatin1(m_str); }
+    const std::string &getStdString() const
+    {
+        static const std::string empty;
+        return (m_str != nullptr) ? *m_str : empty;
+    }
+    QByteArray toQByteArray() const { return ::toQByteArrayLatin1(getStdString()); }
+    QString toQString() const { return ::toQStringLatin1(getStdString()); }
+    /// Copies share it, so MemoryUsage can count it once; nullptr for the empty string.
+    const std::string *getSharedString() const { return m_str.get(); }
 
 public:
-    bool empty() const { return m_str.empty(); }
+    bool empty() const { return m_str == nullptr; }
     bool isEmpty() const { return empty(); }
 };
 
@@ -107,6 +143,7 @@ class TaggedStringUtf8 : private TaggedString<T>
     }
 
 public:
+    using base::getSharedString;
     using base::getStdString;
     QByteArray toQByteArray() const { return ::toQByteArrayUtf8(getStdString()); }
     QString toQString() const { return ::toQStringUtf8(getStdString()); }
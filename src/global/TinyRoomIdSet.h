@@ -0,0 +1,132 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "macros.h"
+#include "roomid.h"
+
+/// A sorted set of room ids for an exit's links. Almost every exit leads to zero or one
+/// rooms, so up to INLINE_CAPACITY ids are kept in the object itself; only larger sets
+/// allocate. The ids are contiguous and in ascending order, like iterating a RoomIdSet.
+class NODISCARD TinyRoomIdSet final
+{
+public:
+    using const_iterator = const RoomId *;
+    static constexpr const size_t INLINE_CAPACITY = 2;
+
+private:
+    std::array<RoomId, INLINE_CAPACITY> m_inline{};
+    // Only used when there are more than INLINE_CAPACITY ids.
+    std::unique_ptr<std::vector<RoomId>> m_heap;
+    uint32_t m_size = 0;
+
+public:
+    TinyRoomIdSet() = default;
+    ~TinyRoomIdSet() = default;
+    TinyRoomIdSet(TinyRoomIdSet &&other) noexcept
+        : m_inline{other.m_inline}
+        , m_heap{std::move(other.m_heap)}
+        , m_size{std::exchange(other.m_size, 0)}
+    {}
+    TinyRoomIdSet(const TinyRoomIdSet &other)
+        : m_inline{other.m_inline}
+        , m_heap{(other.m_heap == nullptr) ? nullptr
+                                           : std::make_unique<std::vector<RoomId>>(*other.m_heap)}
+        , m_size{other.m_size}
+    {}
+    TinyRoomIdSet &operator=(TinyRoomIdSet &&other) noexcept
+    {
+        if (this != &other) {
+            m_inline = other.m_inline;
+            m_heap = std::move(other.m_heap);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+    TinyRoomIdSet &operator=(const TinyRoomIdSet &other)
+    {
+        if (this != &other)
+            *this = TinyRoomIdSet{other};
+        return *this;
+    }
+
+public:
+    NODISCARD const_iterator begin() const
+    {
+        return (m_heap == nullptr) ? m_inline.data() : m_heap->data();
+    }
+    NODISCARD const_iterator end() const { return begin() + m_size; }
+    NODISCARD size_t size() const { return m_size; }
+    NODISCARD bool empty() const { return m_size == 0; }
+    NODISCARD size_t getHeapBytes() const
+    {
+        return (m_heap == nullptr) ? 0
+                                   : sizeof(*m_heap) + m_heap->capacity() * sizeof(RoomId);
+    }
+
+    NODISCARD const_iterator find(const RoomId id) const
+    {
+        const auto it = std::lower_bound(begin(), end(), id);
+        return (it != end() && *it == id) ? it : end();
+    }
+    NODISCARD bool contains(const RoomId id) const { return find(id) != end(); }
+
+public:
+    void insert(const RoomId id)
+    {
+        const auto it = std::lower_bound(begin(), end(), id);
+        if (it != end() && *it == id)
+            return;
+        const auto pos = static_cast<size_t>(it - begin());
+
+        if (m_heap == nullptr && m_size == INLINE_CAPACITY) {
+            m_heap = std::make_unique<std::vector<RoomId>>(m_inline.begin(), m_inline.end());
+        }
+        if (m_heap != nullptr) {
+            m_heap->insert(m_heap->begin() + static_cast<std::ptrdiff_t>(pos), id);
+        } else {
+            std::copy_backward(m_inline.begin() + pos,
+                               m_inline.begin() + m_size,
+                               m_inline.begin() + m_size + 1);
+            m_inline[pos] = id;
+        }
+        ++m_size;
+    }
+
+    void erase(const RoomId id)
+    {
+        const auto it = find(id);
+        if (it == end())
+            return;
+        const auto pos = static_cast<size_t>(it - begin());
+
+        if (m_heap != nullptr) {
+            m_heap->erase(m_heap->begin() + static_cast<std::ptrdiff_t>(pos));
+            if (m_heap->size() <= INLINE_CAPACITY) {
+                std::copy(m_heap->begin(), m_heap->end(), m_inline.begin());
+                m_heap.reset();
+            }
+        } else {
+            std::copy(m_inline.begin() + pos + 1,
+                      m_inline.begin() + m_size,
+                      m_inline.begin() + pos);
+        }
+        --m_size;
+    }
+
+public:
+    NODISCARD bool operator==(const TinyRoomIdSet &rhs) const
+    {
+        return std::equal(begin(), end(), rhs.begin(), rhs.end());
+    }
+    NODISCARD bool operator!=(const TinyRoomIdSet &rhs) const { return !operator==(rhs); }
+};
@@ -0,0 +1,160 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "Trace.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QThread>
+
+std::atomic_bool trace::detail::g_enabled{false};
+
+namespace { // anonymous
+
+struct NODISCARD Event final
+{
+    const char *name = nullptr;
+    trace::Clock::time_point start;
+    trace::Clock::duration duration{};
+};
+
+// Only its own thread writes to it, so the mutex is only contended while
+// the trace is being written or cleared.
+struct NODISCARD ThreadBuffer final
+{
+    std::mutex mutex;
+    std::vector<Event> events;
+    size_t next = 0;
+    int tid = 0;
+    QString name;
+};
+
+// Buffers outlive their threads, so their events can still be written.
+struct NODISCARD Registry final
+{
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    const trace::Clock::time_point epoch = trace::Clock::now();
+};
+
+Registry &getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+ThreadBuffer &getThreadBuffer()
+{
+    static thread_local std::shared_ptr<ThreadBuffer> tl_buffer;
+    if (tl_buffer != nullptr)
+        return *tl_buffer;
+
+    auto buffer = std::make_shared<ThreadBuffer>();
+    buffer->events.reserve(trace::BUFFER_SIZE);
+    if (QThread *const thread = QThread::currentThread()) {
+        buffer->name = thread->objectName();
+        const QCoreApplication *const app = QCoreApplication::instance();
+        if (buffer->name.isEmpty() && app != nullptr && app->thread() == thread)
+            buffer->name = "Main";
+    }
+
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock{registry.mutex};
+    buffer->tid = static_cast<int>(registry.buffers.size()) + 1;
+    if (buffer->name.isEmpty())
+        buffer->name = QString("Thread %1").arg(buffer->tid);
+    registry.buffers.emplace_back(buffer);
+    tl_buffer = std::move(buffer);
+    return *tl_buffer;
+}
+
+int64_t toMicroseconds(const trace::Clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+}
+
+} // namespace
+
+void trace::setEnabled(const bool enabled)
+{
+    static_cast<void>(getRegistry()); // the epoch
+    detail::g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void trace::record(const char *const name,
+                   const Clock::time_point start,
+                   const Clock::time_point end)
+{
+    ThreadBuffer &buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+    const Event event{name, start, end - start};
+    if (buffer.events.size() < BUFFER_SIZE) {
+        buffer.events.emplace_back(event);
+    } else {
+        buffer.events[buffer.next] = event;
+        buffer.next = (buffer.next + 1) % BUFFER_SIZE;
+    }
+}
+
+void trace::clear()
+{
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> lock{registry.mutex};
+    for (const auto &buffer : registry.buffers) {
+        std::lock_guard<std::mutex> bufferLock{buffer->mutex};
+        buffer->events.clear();
+        buffer->next = 0;
+    }
+}
+
+bool trace::writeChromeTrace(const QString &fileName)
+{
+    const auto pid = static_cast<qint64>(QCoreApplication::applicationPid());
+
+    QJsonArray events;
+    {
+        Registry &registry = getRegistry();
+        std::lock_guard<std::mutex> lock{registry.mutex};
+        for (const auto &buffer : registry.buffers) {
+            std::lock_guard<std::mutex> bufferLock{buffer->mutex};
+
+            QJsonObject threadName;
+            threadName["name"] = "thread_name";
+            threadName["ph"] = "M";
+            threadName["pid"] = pid;
+            threadName["tid"] = buffer->tid;
+            threadName["args"] = QJsonObject{{"name", buffer->name}};
+            events.append(threadName);
+
+            // Oldest first, once the ring has wrapped.
+            const size_t size = buffer->events.size();
+            for (size_t i = 0; i < size; ++i) {
+                const Event &e = buffer->events[(buffer->next + i) % size];
+                QJsonObject event;
+                event["name"] = e.name;
+                event["ph"] = "X";
+                event["ts"] = static_cast<qint64>(toMicroseconds(e.start - registry.epoch));
+                event["dur"] = static_cast<qint64>(toMicroseconds(e.duration));
+                event["pid"] = pid;
+                event["tid"] = buffer->tid;
+                events.append(event);
+            }
+        }
+    }
+
+    QJsonObject doc;
+    doc["traceEvents"] = events;
+    doc["displayTimeUnit"] = "ms";
+    const QByteArray json = QJsonDocument(doc).toJson(QJsonDocument::Compact);
+
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(json) == json.size();
+}
@@ -0,0 +1,76 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+#include "RuleOf5.h"
+#include "macros.h"
+
+class QString;
+
+/// Scoped timing events from every thread, for chrome://tracing or Perfetto.
+///
+/// Each thread records into its own ring buffer, which keeps its most recent
+/// BUFFER_SIZE events, so recording never blocks on another thread. It's off
+/// until setEnabled(true); until then a scope costs one relaxed atomic load.
+/// Building with -DWITH_TRACING=OFF removes the scopes altogether.
+namespace trace {
+
+using Clock = std::chrono::steady_clock;
+static constexpr const size_t BUFFER_SIZE = 1u << 15;
+
+namespace detail {
+extern std::atomic_bool g_enabled;
+} // namespace detail
+
+NODISCARD inline bool isEnabled()
+{
+    return detail::g_enabled.load(std::memory_order_relaxed);
+}
+void setEnabled(bool enabled);
+
+/// `name` must outlive the trace, e.g. a string literal.
+void record(const char *name, Clock::time_point start, Clock::time_point end);
+/// Forgets the events recorded so far.
+void clear();
+
+/// Writes the events recorded so far in the Chrome trace event format.
+NODISCARD bool writeChromeTrace(const QString &fileName);
+
+/// Records the time from its construction to its destruction; lives on the stack.
+class NODISCARD Scope final
+{
+private:
+    const char *const m_name;
+    const bool m_enabled;
+    Clock::time_point m_start;
+
+public:
+    explicit Scope(const char *const name)
+        : m_name{name}
+        , m_enabled{isEnabled()}
+    {
+        if (m_enabled)
+            m_start = Clock::now();
+    }
+    ~Scope()
+    {
+        if (m_enabled)
+            record(m_name, m_start, Clock::now());
+    }
+    DELETE_CTORS_AND_ASSIGN_OPS(Scope);
+};
+
+} // namespace trace
+
+#ifdef MMAPPER_NO_TRACING
+#define MMAPPER_TRACE_SCOPE(name) static_cast<void>(0)
+#else
+#define MMAPPER_TRACE_CAT2(a, b) a##b
+#define MMAPPER_TRACE_CAT(a, b) MMAPPER_TRACE_CAT2(a, b)
+#define MMAPPER_TRACE_SCOPE(name) \
+    const ::trace::Scope MMAPPER_TRACE_CAT(traceScope_, __LINE__) { name }
+#endif
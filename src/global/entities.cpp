@@ -4,13 +4,16 @@
 
 #include "entities.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <optional>
 #include <unordered_map>
 #include <vector>
 #include <QByteArray>
-#include <QHash>
 #include <QString>
 
 #include "RuleOf5.h"
@@ -35,6 +38,17 @@ static bool isLatin1Alpha(const QChar &qc)
     return isLatin1(qc) && isalpha(qc.toLatin1());
 }
 
+// The decoders are shared by QString and Latin-1 input.
+static QChar toQChar(const QChar qc)
+{
+    return qc;
+}
+
+static QChar toQChar(const char c)
+{
+    return QChar::fromLatin1(c);
+}
+
 entities::EntityCallback::~EntityCallback() = default;
 
 // clang-format off
@@ -359,17 +373,8 @@ using OptQByteArray = std::optional<QByteArray>;
 
 struct EntityTable final
 {
-    struct MyHash final
-    {
-        uint32_t operator()(const QString &qs) const { return qHash(qs); }
-    };
-
-    std::unordered_map<QString, XmlEntity, MyHash> by_short_name;
-    std::unordered_map<QString, XmlEntity, MyHash> by_full_name;
     std::unordered_map<XmlEntityEnum, XmlEntity> by_id;
 
-    XmlEntityEnum lookup_entity_id_by_short_name(const QString &entity) const;
-    XmlEntityEnum lookup_entity_id_by_full_name(const QString &entity) const;
     OptQByteArray lookup_entity_short_name_by_id(XmlEntityEnum id) const;
     OptQByteArray lookup_entity_full_name_by_id(XmlEntityEnum id) const;
 };
@@ -389,8 +394,6 @@ static EntityTable initEntityTable()
 
     EntityTable entityTable;
     for (const auto &ent : all_entities) {
-        entityTable.by_short_name[QString::fromLatin1(ent.short_name)] = ent;
-        entityTable.by_full_name[QString::fromLatin1(ent.full_name)] = ent;
         entityTable.by_id[ent.id] = ent;
     }
 
@@ -403,24 +406,6 @@ static const EntityTable &getEntityTable()
     return g_entityTable;
 }
 
-XmlEntityEnum EntityTable::lookup_entity_id_by_short_name(const QString &entity) const
-{
-    const auto &map = by_short_name;
-    const auto it = map.find(entity);
-    if (it != map.end())
-        return it->second.id;
-    return XmlEntityEnum::INVALID;
-}
-
-XmlEntityEnum EntityTable::lookup_entity_id_by_full_name(const QString &entity) const
-{
-    const auto &map = by_full_name;
-    const auto it = map.find(entity);
-    if (it != map.end())
-        return it->second.id;
-    return XmlEntityEnum::INVALID;
-}
-
 OptQByteArray EntityTable::lookup_entity_short_name_by_id(const XmlEntityEnum id) const
 {
     const auto &map = by_id;
@@ -616,9 +601,10 @@ auto entities::encode(const DecodedUnicode &name, const EncodingEnum encodingTyp
     return out;
 }
 
-static OptQChar tryParseDec(const QChar *const beg, const QChar *const end)
+template<typename CharT>
+static OptQChar tryParseDec(const CharT *const beg, const CharT *const end)
 {
-    if (beg >= end || !isLatin1Digit(*beg))
+    if (beg >= end || !isLatin1Digit(toQChar(*beg)))
         return OptQChar{};
 
     using val_type = uint32_t;
@@ -626,8 +612,8 @@ static OptQChar tryParseDec(const QChar *const beg, const QChar *const end)
                   >= static_cast<uint64_t>(MAX_UNICODE_CODEPOINT) * 10 + 9);
 
     val_type val = 0;
-    for (const QChar *it = beg; it < end; ++it) {
-        const QChar &qc = *it;
+    for (const CharT *it = beg; it < end; ++it) {
+        const QChar qc = toQChar(*it);
         if (!isLatin1(qc))
             return OptQChar{};
         const char c = qc.toLatin1();
@@ -644,9 +630,10 @@ static OptQChar tryParseDec(const QChar *const beg, const QChar *const end)
     return OptQChar{val};
 }
 
-static OptQChar tryParseHex(const QChar *const beg, const QChar *const end)
+template<typename CharT>
+static OptQChar tryParseHex(const CharT *const beg, const CharT *const end)
 {
-    if (beg >= end || !isLatin1HexDigit(*beg))
+    if (beg >= end || !isLatin1HexDigit(toQChar(*beg)))
         return OptQChar{};
 
     using val_type = uint32_t;
@@ -654,8 +641,8 @@ static OptQChar tryParseHex(const QChar *const beg, const QChar *const end)
                   >= static_cast<uint64_t>(MAX_UNICODE_CODEPOINT) * 16 + 15);
 
     val_type val = 0;
-    for (const QChar *it = beg; it < end; ++it) {
-        const QChar &qc = *it;
+    for (const CharT *it = beg; it < end; ++it) {
+        const QChar qc = toQChar(*it);
         if (!isLatin1(qc))
             return OptQChar{};
         const char c = qc.toLatin1();
@@ -672,135 +659,205 @@ static OptQChar tryParseHex(const QChar *const beg, const QChar *const end)
     return OptQChar{val};
 }
 
-// TODO: test with strings like "", "&;", "&&", "&&;", "&lt", "&lt;" "&lt&lt;",
-// "&foo;", "&1114111;", "&1114112;", "&x10FFFF;", "&x110000;", etc
-void entities::foreachEntity(const QStringRef &input, EntityCallback &callback)
+// The name is without the '&' and the ';'.
+struct NamedEntity final
 {
-    const auto &tab = getEntityTable();
+    const char *name = nullptr;
+    size_t length = 0;
+    uint16_t codepoint = 0;
+};
 
-    const QChar *const beg = input.begin();
-    const QChar *const end = input.end();
+#define X(name, value) \
+    NamedEntity { #name, sizeof(#name) - 1, value }
+#define SEP_COMMA() ,
+static constexpr const NamedEntity ALL_NAMED_ENTITIES[] = {X_FOREACH_ENTITY(X, SEP_COMMA)};
+#undef X
+#undef SEP_COMMA
 
-    for (const QChar *it = beg; it < end;) {
-        if (*it != '&') {
-            // out.append(*it);
-            ++it;
-            continue;
-        }
+static constexpr const size_t NUM_NAMED_ENTITIES = std::size(ALL_NAMED_ENTITIES);
+static_assert(NUM_NAMED_ENTITIES == 258);
 
-        const QChar *const amp = it++;
-        const auto ampStart = static_cast<int>(amp - beg);
-        if (it + 1 < end && *it == '#') {
-            ++it;
+static constexpr const size_t MAX_NAMED_ENTITY_LENGTH = []() {
+    size_t result = 0;
+    for (const NamedEntity &ent : ALL_NAMED_ENTITIES)
+        result = std::max(result, ent.length);
+    return result;
+}();
 
-            if (*it == 'x') {
-                ++it;
-                for (; it < end; ++it)
-                    if (!isLatin1HexDigit(*it))
-                        break;
+// FNV-1a
+static constexpr uint32_t hashEntityName(const char *const name, const size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<uint8_t>(name[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
 
-                if (it < end && *it == ';') {
-                    ++it;
+// An open-addressed hash table of the named entities, built by the compiler;
+// each slot holds the entity's index in ALL_NAMED_ENTITIES plus one, or 0 if it's empty.
+static constexpr const size_t NUM_ENTITY_SLOTS = 1024;
+static_assert(NUM_ENTITY_SLOTS >= 2 * NUM_NAMED_ENTITIES);
+static_assert((NUM_ENTITY_SLOTS & (NUM_ENTITY_SLOTS - 1)) == 0);
 
-                    callback.decodedEntity(ampStart,
-                                           static_cast<int>(it - amp),
-                                           tryParseHex(amp + 3, it - 1));
-                    continue;
-                }
+struct NamedEntitySlots final
+{
+    std::array<uint16_t, NUM_ENTITY_SLOTS> slots{};
+    // the longest probe sequence of any entity, so a lookup never scans further
+    size_t maxProbes = 0;
+};
 
-            } else if (isLatin1Digit(*it)) {
-                for (; it < end; ++it)
-                    if (!isLatin1Digit(*it))
-                        break;
+static constexpr const NamedEntitySlots NAMED_ENTITY_SLOTS = []() {
+    NamedEntitySlots result;
+    for (size_t i = 0; i < NUM_NAMED_ENTITIES; ++i) {
+        const NamedEntity &ent = ALL_NAMED_ENTITIES[i];
+        size_t slot = hashEntityName(ent.name, ent.length) & (NUM_ENTITY_SLOTS - 1);
+        size_t probes = 1;
+        for (; result.slots[slot] != 0; ++probes)
+            slot = (slot + 1) & (NUM_ENTITY_SLOTS - 1);
+        result.slots[slot] = static_cast<uint16_t>(i + 1);
+        result.maxProbes = std::max(result.maxProbes, probes);
+    }
+    return result;
+}();
+static_assert(NAMED_ENTITY_SLOTS.maxProbes <= 4);
 
-                if (it < end && *it == ';') {
-                    ++it;
-                    callback.decodedEntity(ampStart,
-                                           static_cast<int>(it - amp),
-                                           tryParseDec(amp + 2, it - 1));
-                    continue;
-                }
-            }
-        } else if (isNameStartChar(*it)) {
+static OptQChar findNamedEntity(const char *const name, const size_t length)
+{
+    size_t slot = hashEntityName(name, length) & (NUM_ENTITY_SLOTS - 1);
+    for (size_t probe = 0; probe < NAMED_ENTITY_SLOTS.maxProbes; ++probe) {
+        const uint16_t index = NAMED_ENTITY_SLOTS.slots[slot];
+        if (index == 0)
+            break;
+        const NamedEntity &ent = ALL_NAMED_ENTITIES[index - 1];
+        if (ent.length == length && std::memcmp(ent.name, name, length) == 0)
+            return OptQChar{QChar{ent.codepoint}};
+        slot = (slot + 1) & (NUM_ENTITY_SLOTS - 1);
+    }
+    return OptQChar{};
+}
+
+template<typename CharT>
+static OptQChar findNamedEntity(const CharT *const beg, const CharT *const end)
+{
+    const auto length = static_cast<size_t>(end - beg);
+    if (length > MAX_NAMED_ENTITY_LENGTH)
+        return OptQChar{};
+
+    char name[MAX_NAMED_ENTITY_LENGTH];
+    for (size_t i = 0; i < length; ++i) {
+        const QChar qc = toQChar(beg[i]);
+        if (!isLatin1(qc))
+            return OptQChar{};
+        name[i] = qc.toLatin1();
+    }
+    return findNamedEntity(name, length);
+}
+
+struct EntityMatch final
+{
+    // 0 if the '&' doesn't start an entity, e.g. "&bogus"
+    int length = 0;
+    // empty if the entity is unknown or invalid, e.g. "&bogus;"
+    OptQChar decoded;
+};
+
+template<typename CharT>
+static EntityMatch matchEntity(const CharT *const amp, const CharT *const end)
+{
+    assert(amp < end && toQChar(*amp) == '&');
+    const auto lengthTo = [amp](const CharT *const semicolon) {
+        return static_cast<int>(semicolon + 1 - amp);
+    };
+
+    const CharT *it = amp + 1;
+    if (it + 1 < end && toQChar(*it) == '#') {
+        ++it;
+
+        if (toQChar(*it) == 'x') {
             ++it;
-            for (; it < end; ++it)
-                if (!isNameChar(*it))
-                    break;
+            while (it < end && isLatin1HexDigit(toQChar(*it)))
+                ++it;
+            if (it < end && toQChar(*it) == ';')
+                return EntityMatch{lengthTo(it), tryParseHex(amp + 3, it)};
 
-            if (it < end && *it == ';') {
+        } else if (isLatin1Digit(toQChar(*it))) {
+            while (it < end && isLatin1Digit(toQChar(*it)))
                 ++it;
-                const auto ampLen = static_cast<int>(it - amp);
-                const auto full = input.mid(ampStart, ampLen).toString();
-                assert(full.size() == ampLen);
-                const XmlEntityEnum id = tab.lookup_entity_id_by_full_name(full);
-                if (id != XmlEntityEnum::INVALID) {
-                    const auto bits = static_cast<uint16_t>(id);
-                    const QChar qc(bits);
-                    assert(qc.unicode() == bits);
-                    callback.decodedEntity(ampStart, ampLen, OptQChar{qc});
-                    continue;
-                } else {
-                    callback.decodedEntity(ampStart, ampLen, OptQChar{});
-                }
-            }
+            if (it < end && toQChar(*it) == ';')
+                return EntityMatch{lengthTo(it), tryParseDec(amp + 2, it)};
         }
-
-        // "&bogus" or "&bogus;"
-        assert(beg <= amp && amp < it && it <= end);
-        // for (const char *tmp = amp; tmp != it; ++tmp)
-        //   out.append(*tmp);
-        continue;
+    } else if (it < end && entities::isNameStartChar(toQChar(*it))) {
+        ++it;
+        while (it < end && entities::isNameChar(toQChar(*it)))
+            ++it;
+        if (it < end && toQChar(*it) == ';')
+            return EntityMatch{lengthTo(it), findNamedEntity(amp + 1, it)};
     }
+
+    return EntityMatch{};
 }
 
-auto entities::decode(const EncodedLatin1 &input) -> DecodedUnicode
+void entities::foreachEntity(const QStringRef &input, EntityCallback &callback)
 {
-    static constexpr const char unprintable = '?';
-    struct MyEntityCallback final : EntityCallback
-    {
-        const EncodedLatin1 &input;
-        DecodedUnicode out;
-        int pos = 0;
-
-        explicit MyEntityCallback(const EncodedLatin1 &_input)
-            : input{_input}
-        {
-            out.reserve(input.size());
+    const QChar *const beg = input.begin();
+    const QChar *const end = input.end();
+
+    for (const QChar *it = beg; it < end;) {
+        if (*it != '&') {
+            ++it;
+            continue;
         }
 
-        virtual void decodedEntity(int start, int len, OptQChar decoded) override
-        {
-            skipto(start);
-            if (decoded)
-                out += decoded.value();
-            else
-                out += unprintable;
-            pos = start + len;
+        const EntityMatch match = matchEntity(it, end);
+        if (match.length == 0) {
+            // "&bogus"
+            ++it;
+            continue;
         }
 
-        void skipto(int start)
-        {
-            assert(start >= this->pos);
-            if (start == this->pos)
-                return;
+        callback.decodedEntity(static_cast<int>(it - beg), match.length, match.decoded);
+        it += match.length;
+    }
+}
 
-            const char *const pos_it = input.begin() + pos;
-            const char *const start_it = input.begin() + start;
+auto entities::decode(const EncodedLatin1 &input) -> DecodedUnicode
+{
+    static constexpr const char unprintable = '?';
 
-            for (const char *it = pos_it; it != start_it; ++it) {
-                out += *it;
-            }
-            pos = start;
+    // Each byte and each entity decodes to one QChar, so the output can't be
+    // longer than the input.
+    DecodedUnicode out;
+    out.resize(input.size());
+    QChar *const outBeg = out.data();
+    QChar *dst = outBeg;
+
+    const char *it = input.constData();
+    const char *const end = it + input.size();
+    while (it < end) {
+        const auto *amp = static_cast<const char *>(
+            std::memchr(it, '&', static_cast<size_t>(end - it)));
+        if (amp == nullptr)
+            amp = end;
+        for (; it < amp; ++it)
+            *dst++ = QChar::fromLatin1(*it);
+        if (it == end)
+            break;
+
+        const EntityMatch match = matchEntity(it, end);
+        if (match.length == 0) {
+            *dst++ = QChar::fromLatin1('&');
+            ++it;
+            continue;
         }
-    } callback{input};
 
-    const QString &tmp = QString(input);
-    assert(tmp.size() == input.size());
-
-    foreachEntity(tmp.midRef(0), callback);
-    callback.skipto(input.size());
+        *dst++ = match.decoded ? match.decoded.value() : QChar::fromLatin1(unprintable);
+        it += match.length;
+    }
 
-    return std::move(callback.out);
+    out.resize(static_cast<int>(dst - outBeg));
+    return out;
 }
 
 // self test
@@ -836,6 +893,9 @@ static bool self_test = []() -> bool {
     testDecode("&#32;", " ");
     testDecode("&#xFF;", "\xFF");
     testDecode("&#255;", "\xFF");
+    testDecode("&lt;&amp;&gt;", "<&>");
+    testDecode("&Ouml;&diams", "\xD6&diams");
+    testDecode("a&b &bogus; &#;", "a&b ? &#;");
 
     //
     testEncode("", "");
@@ -3,6 +3,7 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <cassert>
 #include <climits>
 #include <cstdint>
 #include <functional>
@@ -55,14 +56,38 @@ class roomid_vector : private std::vector<T>
     using std::vector<T>::vector;
 
 public:
-    auto operator[](RoomId roomId) -> decltype(auto) { return base::at(roomId.asUint32()); }
-    auto operator[](RoomId roomId) const -> decltype(auto) { return base::at(roomId.asUint32()); }
+    /// Unchecked in release builds; use at() or tryGet() if roomId may be out of range.
+    auto operator[](RoomId roomId) -> decltype(auto)
+    {
+        assert(roomId.asUint32() < base::size());
+        return base::operator[](roomId.asUint32());
+    }
+    auto operator[](RoomId roomId) const -> decltype(auto)
+    {
+        assert(roomId.asUint32() < base::size());
+        return base::operator[](roomId.asUint32());
+    }
+
+    /// Throws std::out_of_range.
+    auto at(RoomId roomId) -> decltype(auto) { return base::at(roomId.asUint32()); }
+    auto at(RoomId roomId) const -> decltype(auto) { return base::at(roomId.asUint32()); }
+
+    /// Returns nullptr if roomId is out of range.
+    T *tryGet(RoomId roomId)
+    {
+        return roomId.asUint32() < base::size() ? &base::operator[](roomId.asUint32()) : nullptr;
+    }
+    const T *tryGet(RoomId roomId) const
+    {
+        return roomId.asUint32() < base::size() ? &base::operator[](roomId.asUint32()) : nullptr;
+    }
 
 public:
     using base::begin;
     using base::end;
 
 public:
+    using base::capacity;
     using base::resize;
     using base::size;
 };
@@ -70,9 +95,6 @@ class roomid_vector : private std::vector<T>
 class Room;
 using RoomIndex = roomid_vector<std::shared_ptr<Room>>;
 
-class RoomRecipient;
-using RoomLocks = roomid_vector<std::set<RoomRecipient *>>;
-
 class RoomCollection;
 using SharedRoomCollection = std::shared_ptr<RoomCollection>;
 using RoomHomes = roomid_vector<SharedRoomCollection>;
@@ -0,0 +1,335 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "HeadlessMapper.h"
+
+#include <csignal>
+#include <exception>
+#include <tuple>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtCore>
+
+#include "../clock/mumeclock.h"
+#include "../configuration/configuration.h"
+#include "../display/prespammedpath.h"
+#include "../expandoracommon/parseevent.h"
+#include "../global/roomid.h"
+#include "../mapdata/ExitDirection.h"
+#include "../mapdata/mapdata.h"
+#include "../mapdata/roomselection.h"
+#include "../mapstorage/abstractmapstorage.h"
+#include "../mapstorage/filesaver.h"
+#include "../mapstorage/mapstorage.h"
+#include "../pandoragroup/mmapper2group.h"
+#include "../parser/DoorAction.h"
+#include "../parser/abstractparser.h"
+#include "../pathmachine/mmapper2pathmachine.h"
+#include "../pathmachine/pathmachine.h"
+#include "../proxy/connectionlistener.h"
+#include "../proxy/telnetfilter.h"
+
+static constexpr const char *const HEADLESS = "Headless";
+
+void connectPathMachine(Mmapper2PathMachine &pathMachine, MapData &mapData)
+{
+    QObject::connect(&pathMachine,
+                     SIGNAL(lookingForRooms(RoomRecipient &, const Coordinate &)),
+                     &mapData,
+                     SLOT(lookingForRooms(RoomRecipient &, const Coordinate &)));
+    QObject::connect(&pathMachine,
+                     QOverload<RoomRecipient &, const SigParseEvent &>::of(
+                         &Mmapper2PathMachine::lookingForRooms),
+                     &mapData,
+                     QOverload<RoomRecipient &, const SigParseEvent &>::of(
+                         &MapData::lookingForRooms));
+    QObject::connect(&pathMachine,
+                     &Mmapper2PathMachine::lookingForNearbyRooms,
+                     &mapData,
+                     &MapData::lookingForNearbyRooms);
+    QObject::connect(&pathMachine,
+                     &Mmapper2PathMachine::lookingForRoomsNear,
+                     &mapData,
+                     &MapData::lookingForRoomsNear);
+    QObject::connect(&pathMachine,
+                     &Mmapper2PathMachine::sig_sweepTemporaryRooms,
+                     &mapData,
+                     &MapData::sweepTemporaryRooms);
+    QObject::connect(&pathMachine,
+                     &Mmapper2PathMachine::lookingForSimilarRooms,
+                     &mapData,
+                     &MapData::lookingForSimilarRooms);
+    QObject::connect(&pathMachine,
+                     SIGNAL(lookingForRooms(RoomRecipient &, RoomId)),
+                     &mapData,
+                     SLOT(lookingForRooms(RoomRecipient &, RoomId)));
+    QObject::connect(&mapData,
+                     &MapFrontend::sig_clearingMap,
+                     &pathMachine,
+                     &PathMachine::releaseAllPaths);
+
+    if (getConfig().general.mapMode == MapModeEnum::MAP) {
+        QObject::connect(&pathMachine,
+                         &Mmapper2PathMachine::createRoom,
+                         &mapData,
+                         &MapData::createRoom);
+        QObject::connect(&pathMachine,
+                         &Mmapper2PathMachine::sig_scheduleAction,
+                         &mapData,
+                         &MapData::slot_scheduleAction);
+        QObject::connect(&pathMachine,
+                         &Mmapper2PathMachine::sig_scheduleActions,
+                         &mapData,
+                         &MapData::slot_scheduleActions);
+    }
+}
+
+HeadlessMapper::HeadlessMapper(QObject *const parent)
+    : QObject(parent)
+{
+    // The same types MainWindow registers for its queued connections.
+    qRegisterMetaType<RoomId>("RoomId");
+    qRegisterMetaType<TelnetData>("TelnetData");
+    qRegisterMetaType<CommandQueue>("CommandQueue");
+    qRegisterMetaType<DoorActionEnum>("DoorActionEnum");
+    qRegisterMetaType<ExitDirEnum>("ExitDirEnum");
+    qRegisterMetaType<GroupManagerStateEnum>("GroupManagerStateEnum");
+    qRegisterMetaType<SigParseEvent>("SigParseEvent");
+    qRegisterMetaType<SigRoomSelection>("SigRoomSelection");
+
+    m_mapData = new MapData(this);
+    m_mapData->setObjectName("MapData");
+    m_prespammedPath = new PrespammedPath(this);
+    m_groupManager = new Mmapper2Group(this);
+    m_groupManager->setObjectName("GroupManager");
+    m_pathMachine = new Mmapper2PathMachine(m_mapData, this);
+    m_pathMachine->setObjectName("Mmapper2PathMachine");
+    m_mumeClock = new MumeClock(getConfig().mumeClock.startEpoch, this);
+    m_listener = new ConnectionListener(m_mapData,
+                                        m_pathMachine,
+                                        m_prespammedPath,
+                                        m_groupManager,
+                                        m_mumeClock,
+                                        nullptr,
+                                        this);
+
+    connectPathMachine(*m_pathMachine, *m_mapData);
+    connect(m_pathMachine,
+            &PathMachine::setCharPosition,
+            m_groupManager,
+            &Mmapper2Group::setCharacterRoomId,
+            Qt::QueuedConnection);
+    connect(m_groupManager,
+            &Mmapper2Group::sig_applySyncedRooms,
+            m_mapData,
+            &MapData::slot_applySyncedRooms,
+            Qt::QueuedConnection);
+    m_groupManager->setMapDigestSource([mapData = m_mapData]() { return mapData->getMapDigest(); });
+
+    connect(m_mapData, &MapData::log, this, &HeadlessMapper::log, Qt::DirectConnection);
+    connect(m_pathMachine,
+            &Mmapper2PathMachine::log,
+            this,
+            &HeadlessMapper::log,
+            Qt::DirectConnection);
+    connect(m_groupManager,
+            &Mmapper2Group::log,
+            this,
+            &HeadlessMapper::log,
+            Qt::DirectConnection);
+    connect(m_listener,
+            &ConnectionListener::log,
+            this,
+            &HeadlessMapper::log,
+            Qt::DirectConnection);
+    connect(m_mumeClock, &MumeClock::log, this, &HeadlessMapper::log, Qt::DirectConnection);
+
+    connect(&m_autosaveTimer, &QTimer::timeout, this, &HeadlessMapper::autosave);
+}
+
+HeadlessMapper::~HeadlessMapper() = default;
+
+void HeadlessMapper::log(const QString &module, const QString &message)
+{
+    qInfo().noquote() << QString("[%1] %2").arg(module, message);
+}
+
+bool HeadlessMapper::loadMap(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly)) {
+        log(HEADLESS, QString("Cannot read map %1: %2.").arg(fileName, file.errorString()));
+        return false;
+    }
+
+    MapStorage storage(*m_mapData, fileName, &file, this);
+    connect(&storage, &AbstractMapStorage::log, this, &HeadlessMapper::log, Qt::DirectConnection);
+    AbstractMapStorage &abstractStorage = storage;
+    if (!abstractStorage.canLoad() || !abstractStorage.loadData()) {
+        log(HEADLESS, QString("Failed to load map %1.").arg(fileName));
+        return false;
+    }
+    log(HEADLESS, QString("Loaded map %1.").arg(fileName));
+    return true;
+}
+
+bool HeadlessMapper::start()
+{
+    try {
+        m_listener->listen();
+    } catch (const std::exception &e) {
+        log("ConnectionListener", QString("Unable to start the server: %1.").arg(e.what()));
+        return false;
+    }
+    log("ConnectionListener",
+        QString("Server bound to port: %1.").arg(getConfig().connection.localPort));
+
+    m_groupManager->start();
+    const auto &groupConfig = getConfig().groupManager;
+    const GroupManagerStateEnum state = groupConfig.state;
+    const bool autoStart = groupConfig.autoStart;
+    Mmapper2Group *const groupManager = m_groupManager;
+    // The group manager runs on its own thread once it has started.
+    QMetaObject::invokeMethod(
+        groupManager,
+        [groupManager, state, autoStart]() {
+            groupManager->setMode(state);
+            if (state != GroupManagerStateEnum::Off && autoStart)
+                groupManager->startNetwork();
+        },
+        Qt::QueuedConnection);
+
+    m_autosaveTimer.start(AUTOSAVE_INTERVAL_MS);
+    return true;
+}
+
+void HeadlessMapper::stop()
+{
+    m_autosaveTimer.stop();
+
+    const QString fileName = m_mapData->getFileName();
+    const bool hasJournal = !fileName.isEmpty()
+                            && QFileInfo::exists(MapStorage::getJournalFileName(fileName));
+    // Fold the journal back into the map so the next load doesn't have to replay it.
+    if (m_mapData->dataChanged() || hasJournal)
+        std::ignore = saveMap(true);
+
+    m_groupManager->stop();
+}
+
+void HeadlessMapper::autosave()
+{
+    if (m_mapData->dataChanged())
+        std::ignore = saveMap(false);
+}
+
+bool HeadlessMapper::saveMap(const bool compact)
+{
+    const QString fileName = m_mapData->getFileName();
+    if (fileName.isEmpty() || m_mapData->isFileReadOnly()) {
+        log(HEADLESS, "The map has no writable file, so it isn't saved.");
+        return false;
+    }
+
+    if (!compact) {
+        MapStorage journal(*m_mapData, fileName, this);
+        connect(&journal,
+                &AbstractMapStorage::log,
+                this,
+                &HeadlessMapper::log,
+                Qt::DirectConnection);
+        if (journal.saveJournal())
+            return true;
+        // The journal may have found edits on disk that a full save would remove.
+        if (m_mapData->isFileReadOnly()) {
+            log(HEADLESS, "The map's journal has to be dealt with first, so it isn't saved.");
+            return false;
+        }
+    }
+
+    FileSaver saver;
+    try {
+        saver.open(fileName);
+    } catch (const std::exception &e) {
+        log(HEADLESS, QString("Cannot write file %1: %2.").arg(fileName).arg(e.what()));
+        return false;
+    }
+
+    MapStorage storage(*m_mapData, fileName, &saver.file(), this);
+    connect(&storage, &AbstractMapStorage::log, this, &HeadlessMapper::log, Qt::DirectConnection);
+    AbstractMapStorage &abstractStorage = storage;
+    const bool saveOk = abstractStorage.saveData(false);
+
+    try {
+        saver.close();
+    } catch (const std::exception &e) {
+        log(HEADLESS, QString("Cannot write file %1: %2.").arg(fileName).arg(e.what()));
+        return false;
+    }
+
+    if (!saveOk) {
+        log(HEADLESS, "Error while saving (see log).");
+        return false;
+    }
+    MapStorage::discardJournal(*m_mapData, fileName);
+    log(HEADLESS, QString("Saved map %1.").arg(fileName));
+    return true;
+}
+
+namespace { // anonymous
+
+volatile std::sig_atomic_t g_quitRequested = 0;
+
+void requestQuit(const int /*signal*/)
+{
+    g_quitRequested = 1;
+}
+
+QString getMapFileName(const QStringList &args)
+{
+    const int pos = args.indexOf("--headless");
+    if (pos >= 0 && pos + 1 < args.size())
+        return args.at(pos + 1);
+
+    const auto &settings = getConfig().autoLoad;
+    if (!settings.autoLoadMap || settings.fileName.isEmpty())
+        return QString{};
+    if (QFileInfo{settings.fileName}.isAbsolute())
+        return settings.fileName;
+    return QDir{settings.lastMapDirectory}.absoluteFilePath(settings.fileName);
+}
+
+} // namespace
+
+int runHeadlessMapper(const QStringList &args)
+{
+    // Remote editing opens its editor in a window; MUME falls back to its own editor.
+    // The saved setting is left alone, since other settings are still written back.
+    setConfig().mumeClientProtocol.remoteEditingSuppressed = true;
+
+    HeadlessMapper mapper;
+    const QString fileName = getMapFileName(args);
+    if (fileName.isEmpty())
+        mapper.log(HEADLESS, "No map given; the rooms that are mapped won't be saved.");
+    else if (!mapper.loadMap(fileName))
+        return 1;
+
+    if (!mapper.start())
+        return 1;
+
+    // Only set a flag in the handler; the event loop polls it.
+    std::signal(SIGINT, requestQuit);
+    std::signal(SIGTERM, requestQuit);
+    QTimer quitPoll;
+    QObject::connect(&quitPoll, &QTimer::timeout, []() {
+        if (g_quitRequested != 0)
+            QCoreApplication::quit();
+    });
+    quitPoll.start(250);
+
+    const int ret = QCoreApplication::exec();
+    mapper.stop();
+    return ret;
+}
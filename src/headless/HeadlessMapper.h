@@ -0,0 +1,70 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QtCore>
+
+#include "../global/macros.h"
+
+class ConnectionListener;
+class MapData;
+class Mmapper2Group;
+class Mmapper2PathMachine;
+class MumeClock;
+class PrespammedPath;
+
+/// Makes the connections between the path machine and the map that
+/// MainWindow::wireConnections() makes, minus the display; for the modes
+/// that run without a main window.
+void connectPathMachine(Mmapper2PathMachine &pathMachine, MapData &mapData);
+
+/// The mapping proxy without any widgets or OpenGL: the listener and its proxies,
+/// the parser, the path machine, the group manager and the map, which is saved
+/// every AUTOSAVE_INTERVAL once it has changed, and when the mapper stops.
+///
+/// The proxies' `dirs` and `search` commands work as usual; a search selects its
+/// rooms for the next client command, but nothing draws them.
+class NODISCARD HeadlessMapper final : public QObject
+{
+    Q_OBJECT
+
+private:
+    static constexpr const int AUTOSAVE_INTERVAL_MS = 60 * 1000;
+
+    MapData *m_mapData = nullptr;
+    PrespammedPath *m_prespammedPath = nullptr;
+    Mmapper2Group *m_groupManager = nullptr;
+    Mmapper2PathMachine *m_pathMachine = nullptr;
+    MumeClock *m_mumeClock = nullptr;
+    ConnectionListener *m_listener = nullptr;
+    QTimer m_autosaveTimer;
+
+public:
+    explicit HeadlessMapper(QObject *parent = nullptr);
+    ~HeadlessMapper() override;
+
+public:
+    NODISCARD bool loadMap(const QString &fileName);
+    /// Listens for clients and starts the group manager; returns false if the
+    /// listener couldn't be bound.
+    NODISCARD bool start();
+    /// Saves the map if it changed and stops the group manager.
+    void stop();
+
+public slots:
+    void log(const QString &module, const QString &message);
+
+private:
+    void autosave();
+    /// Appends to the journal when it can, unless compacting; otherwise saves in full.
+    NODISCARD bool saveMap(bool compact);
+};
+
+/// Usage: mmapper --headless [map.mm2]
+/// Without a map, the one the settings would auto-load is used (if any).
+/// Runs until the process is interrupted or terminated; returns an exit code.
+int runHeadlessMapper(const QStringList &args);
@@ -5,6 +5,7 @@
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <memory>
 #include <optional>
@@ -17,9 +18,12 @@
 #include "configuration/configuration.h"
 #include "display/Filenames.h"
 #include "global/Debug.h"
+#include "global/StartupTimer.h"
+#include "global/Trace.h"
 #include "global/Version.h"
 #include "global/WinSock.h"
 #include "global/utils.h"
+#include "headless/HeadlessMapper.h"
 #include "mainwindow/mainwindow.h"
 
 #ifdef WITH_DRMINGW
@@ -140,8 +144,19 @@ static void tryAutoLoad(MainWindow &mw)
     }
 }
 
+// Checked before any QApplication exists, since a headless mapper must not create one.
+static bool isHeadless(const int argc, char **const argv)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0)
+            return true;
+    }
+    return false;
+}
+
 int main(int argc, char **argv)
 {
+    startup::begin();
     seedRandomNumberGenerator();
     useHighDpi();
     trySetHighDpiScaleFactorRoundingPolicy();
@@ -153,10 +168,22 @@ int main(int argc, char **argv)
             "[%{time} %{threadid}] %{type} in %{function} (at %{file}:%{line}): %{message}");
     }
 
+    if (isHeadless(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        auto tryLoadingWinSock = std::make_unique<WinSock>();
+        return runHeadlessMapper(QCoreApplication::arguments());
+    }
+
     QApplication app(argc, argv);
+    startup::mark("QApplication");
     tryInitDrMingw();
     auto tryLoadingWinSock = std::make_unique<WinSock>();
 
+    // Set MMAPPER_TRACE=<trace.json> to trace the whole session; see Tools > Record Trace.
+    const QString traceFile = QString::fromLocal8Bit(qgetenv("MMAPPER_TRACE"));
+    if (!NO_TRACING && !traceFile.isEmpty())
+        trace::setEnabled(true);
+
     const auto &config = getConfig();
     if (config.canvas.softwareOpenGL) {
         QApplication::setAttribute(Qt::AA_UseSoftwareOpenGL);
@@ -171,13 +198,18 @@ int main(int argc, char **argv)
     std::unique_ptr<ISplash> splash = !config.general.noSplash
                                           ? static_upcast<ISplash>(std::make_unique<Splash>())
                                           : static_upcast<ISplash>(std::make_unique<FakeSplash>());
+    startup::mark("splash");
     auto mw = std::make_unique<MainWindow>();
+    startup::mark("main window");
     tryAutoLoad(*mw);
+    startup::mark("autoload");
     mw->show();
     splash->finish(mw.get());
     splash.reset();
     const int ret = QApplication::exec();
     mw.reset();
     config.write();
+    if (!NO_TRACING && !traceFile.isEmpty() && !trace::writeChromeTrace(traceFile))
+        qWarning() << "[main] Unable to write the trace to" << traceFile;
     return ret;
 }
@@ -0,0 +1,164 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "FindRoomsModel.h"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <QString>
+
+#include "../expandoracommon/room.h"
+
+FindRoomsModel::FindRoomsModel(QObject *const parent)
+    : QAbstractTableModel(parent)
+{}
+
+FindRoomsModel::~FindRoomsModel() = default;
+
+void FindRoomsModel::reset(SharedMapSnapshot snapshot)
+{
+    beginResetModel();
+    m_snapshot = std::move(snapshot);
+    m_ids.clear();
+    endResetModel();
+}
+
+void FindRoomsModel::append(const std::vector<RoomId> &ids)
+{
+    if (ids.empty())
+        return;
+    const int first = size();
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(ids.size()) - 1);
+    m_ids.insert(m_ids.end(), ids.begin(), ids.end());
+    endInsertRows();
+}
+
+void FindRoomsModel::finish()
+{
+    // The results arrive in order of id.
+    const bool byId = static_cast<ColumnTypeEnum>(m_sortColumn) == ColumnTypeEnum::ID;
+    if (m_sortColumn < 0 || (byId && m_sortOrder == Qt::AscendingOrder))
+        return;
+    sortIds();
+}
+
+RoomId FindRoomsModel::getRoomId(const QModelIndex &index) const
+{
+    if (!index.isValid() || index.row() >= size())
+        return INVALID_ROOMID;
+    return m_ids[static_cast<size_t>(index.row())];
+}
+
+const Room *FindRoomsModel::getRoom(const QModelIndex &index) const
+{
+    const RoomId id = getRoomId(index);
+    if (id == INVALID_ROOMID || m_snapshot == nullptr)
+        return nullptr;
+    return m_snapshot->getRoom(id);
+}
+
+int FindRoomsModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : size();
+}
+
+int FindRoomsModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+QVariant FindRoomsModel::data(const QModelIndex &index, const int role) const
+{
+    const Room *const room = getRoom(index);
+    if (room == nullptr)
+        return QVariant();
+
+    switch (role) {
+    case Qt::DisplayRole:
+        switch (static_cast<ColumnTypeEnum>(index.column())) {
+        case ColumnTypeEnum::ID:
+            return room->getId().asUint32();
+        case ColumnTypeEnum::NAME:
+            return room->getName().toQString();
+        }
+        break;
+    case Qt::ToolTipRole:
+        // FIXME: This is almost identical to the code in MapCanvas::mouseReleaseEvent.
+        return QString("Selected Room ID: %1\n%2")
+            .arg(room->getId().asUint32())
+            .arg(room->toQString());
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QVariant FindRoomsModel::headerData(const int section,
+                                    const Qt::Orientation orientation,
+                                    const int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+    switch (static_cast<ColumnTypeEnum>(section)) {
+    case ColumnTypeEnum::ID:
+        return tr("Room ID");
+    case ColumnTypeEnum::NAME:
+        return tr("Room Name");
+    }
+    return QVariant();
+}
+
+void FindRoomsModel::sort(const int column, const Qt::SortOrder order)
+{
+    m_sortColumn = column;
+    m_sortOrder = order;
+    sortIds();
+}
+
+void FindRoomsModel::sortIds()
+{
+    const bool byName = static_cast<ColumnTypeEnum>(m_sortColumn) == ColumnTypeEnum::NAME;
+    const bool ascending = m_sortOrder == Qt::AscendingOrder;
+    const MapSnapshot *const snapshot = m_snapshot.get();
+    const auto less = [byName, ascending, snapshot](RoomId a, RoomId b) -> bool {
+        if (!ascending)
+            std::swap(a, b);
+        if (byName && snapshot != nullptr) {
+            const Room *const ra = snapshot->getRoom(a);
+            const Room *const rb = snapshot->getRoom(b);
+            if (ra != nullptr && rb != nullptr) {
+                const std::string &na = ra->getName().getStdString();
+                const std::string &nb = rb->getName().getStdString();
+                if (na != nb)
+                    return na < nb;
+            }
+        }
+        return a < b;
+    };
+
+    emit layoutAboutToBeChanged();
+    const QModelIndexList persistent = persistentIndexList();
+    std::vector<RoomId> persistentIds;
+    persistentIds.reserve(static_cast<size_t>(persistent.size()));
+    for (const QModelIndex &old : persistent)
+        persistentIds.emplace_back(getRoomId(old));
+
+    std::sort(m_ids.begin(), m_ids.end(), less);
+
+    // Keep the selection and the current item on the same rooms.
+    if (!persistent.isEmpty()) {
+        std::unordered_map<RoomId, int> rows;
+        for (size_t i = 0; i < m_ids.size(); ++i)
+            rows.emplace(m_ids[i], static_cast<int>(i));
+        QModelIndexList moved;
+        for (int i = 0; i < persistent.size(); ++i) {
+            const auto it = rows.find(persistentIds[static_cast<size_t>(i)]);
+            moved << (it == rows.end() ? QModelIndex()
+                                       : index(it->second, persistent.at(i).column()));
+        }
+        changePersistentIndexList(persistent, moved);
+    }
+    emit layoutChanged();
+}
@@ -0,0 +1,55 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <vector>
+#include <QAbstractTableModel>
+#include <QVariant>
+
+#include "../global/macros.h"
+#include "../global/roomid.h"
+#include "../mapdata/MapSnapshot.h"
+
+/// The results of a FindRoomsDlg search: just the matching ids, which arrive in
+/// batches while the search runs. Rows are formatted from the snapshot that was
+/// searched when the view asks for them, so only the visible ones ever are.
+class FindRoomsModel final : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum class ColumnTypeEnum { ID = 0, NAME };
+    static constexpr const int COLUMN_COUNT = static_cast<int>(ColumnTypeEnum::NAME) + 1;
+
+private:
+    SharedMapSnapshot m_snapshot;
+    std::vector<RoomId> m_ids;
+    int m_sortColumn = -1;
+    Qt::SortOrder m_sortOrder = Qt::AscendingOrder;
+
+public:
+    explicit FindRoomsModel(QObject *parent = nullptr);
+    ~FindRoomsModel() override;
+
+public:
+    /// Forgets the results, and shows rooms from `snapshot` from now on.
+    void reset(SharedMapSnapshot snapshot);
+    void append(const std::vector<RoomId> &ids);
+    /// Sorts the results that arrived since the view was last sorted.
+    void finish();
+
+public:
+    NODISCARD RoomId getRoomId(const QModelIndex &index) const;
+    NODISCARD const Room *getRoom(const QModelIndex &index) const;
+    NODISCARD int size() const { return static_cast<int>(m_ids.size()); }
+
+public:
+    int rowCount(const QModelIndex &parent) const override;
+    int columnCount(const QModelIndex &parent) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+    void sort(int column, Qt::SortOrder order) override;
+
+private:
+    void sortIds();
+};
@@ -33,7 +33,7 @@ static QString getBuildInformation()
         .arg(get_compiler());
 }
 
-AboutDialog::AboutDialog(QWidget *parent)
+AboutDialog::AboutDialog(const QString &memoryUsage, QWidget *parent)
     : QDialog(parent)
 {
     setWindowIcon(QIcon(":/icons/m.png"));
@@ -131,6 +131,10 @@ AboutDialog::AboutDialog(QWidget *parent)
         + loadLicenseResource(":/LICENSE.OPENSSL") + "</pre>");
     setFixedFont(licenseView);
 
+    /* Memory tab */
+    memoryView->setPlainText(memoryUsage);
+    setFixedFont(memoryView);
+
     adjustSize();
 }
 
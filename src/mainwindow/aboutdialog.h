@@ -18,7 +18,7 @@ class AboutDialog : public QDialog, private Ui::AboutDialog
     Q_OBJECT
 
 public:
-    explicit AboutDialog(QWidget *parent = nullptr);
+    explicit AboutDialog(const QString &memoryUsage, QWidget *parent = nullptr);
 
 private:
     void setFixedFont(QTextBrowser *browser);
@@ -5,7 +5,13 @@
 
 #include "findroomsdlg.h"
 
+#include <chrono>
 #include <cstdint>
+#include <exception>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
 #include <QString>
 #include <QtGui>
 #include <QtWidgets>
@@ -14,13 +20,18 @@
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
+#include "../global/BackgroundJob.h"
 #include "../global/roomid.h"
+#include "../global/utils.h"
 #include "../mapdata/ExitDirection.h"
 #include "../mapdata/mapdata.h"
 #include "../mapdata/roomfilter.h"
 #include "../mapdata/roomselection.h"
 #include "../parser/parserutils.h"
 
+// How long the query has to stay the same before it's searched for.
+static constexpr const auto SEARCH_AS_YOU_TYPE_DELAY = std::chrono::milliseconds(250);
+
 FindRoomsDlg::FindRoomsDlg(MapData *const md, QWidget *const parent)
     : QDialog(parent)
 {
@@ -35,23 +46,44 @@ FindRoomsDlg::FindRoomsDlg(MapData *const md, QWidget *const parent)
     selectButton->setEnabled(false);
     editButton->setEnabled(false);
 
+    m_searchTimer.setSingleShot(true);
+    m_searchTimer.setInterval(SEARCH_AS_YOU_TYPE_DELAY);
+    connect(&m_searchTimer, &QTimer::timeout, this, &FindRoomsDlg::findClicked);
+    const auto searchSoon = [this]() {
+        if (!lineEdit->text().isEmpty())
+            m_searchTimer.start();
+    };
+    const QList<QAbstractButton *> options{nameRadioButton,
+                                           descRadioButton,
+                                           dynDescRadioButton,
+                                           exitsRadioButton,
+                                           notesRadioButton,
+                                           flagsRadioButton,
+                                           allRadioButton,
+                                           caseCheckBox};
+    for (QAbstractButton *const button : options) {
+        connect(button, &QAbstractButton::toggled, this, searchSoon);
+    }
+
     connect(lineEdit, &QLineEdit::textChanged, this, &FindRoomsDlg::enableFindButton);
+    connect(lineEdit, &QLineEdit::textChanged, this, [this, searchSoon](const QString &text) {
+        if (text.isEmpty())
+            clearResults();
+        else
+            searchSoon();
+    });
     connect(findButton, &QAbstractButton::clicked, this, &FindRoomsDlg::findClicked);
     connect(closeButton, &QAbstractButton::clicked, this, &QWidget::close);
-    connect(resultTable, &QTreeWidget::itemDoubleClicked, this, &FindRoomsDlg::itemDoubleClicked);
+    connect(resultTable, &QAbstractItemView::doubleClicked, this, &FindRoomsDlg::itemDoubleClicked);
     connect(m_showSelectedRoom, &QShortcut::activated, this, &FindRoomsDlg::showSelectedRoom);
-    connect(resultTable, &QTreeWidget::itemSelectionChanged, this, [this]() {
-        const bool enabled = !resultTable->selectedItems().isEmpty();
+    connect(resultTable->selectionModel(), &QItemSelectionModel::selectionChanged, this, [this]() {
+        const bool enabled = resultTable->selectionModel()->hasSelection();
         selectButton->setEnabled(enabled);
         editButton->setEnabled(enabled);
     });
     connect(selectButton, &QAbstractButton::clicked, this, [this]() {
-        const auto tmpSel = RoomSelection::createSelection(*m_mapData);
-        for (const auto &selectedItem : resultTable->selectedItems()) {
-            const auto id = RoomId{selectedItem->text(0).toUInt()};
-            tmpSel->getRoom(id);
-        }
-        if (!tmpSel->isEmpty()) {
+        const auto tmpSel = getSelectedRooms();
+        if (!tmpSel->empty()) {
             glm::vec2 sum{0.f, 0.f};
             // FIXME: This is actually an anti-feature if the rooms are far apart,
             // because it drops you off in the middle of nowhere.
@@ -66,12 +98,7 @@ FindRoomsDlg::FindRoomsDlg(MapData *const md, QWidget *const parent)
         emit newRoomSelection(SigRoomSelection{tmpSel});
     });
     connect(editButton, &QAbstractButton::clicked, this, [this]() {
-        const auto tmpSel = RoomSelection::createSelection(*m_mapData);
-        for (const auto &selectedItem : resultTable->selectedItems()) {
-            const auto id = RoomId{selectedItem->text(0).toUInt()};
-            tmpSel->getRoom(id);
-        }
-        emit newRoomSelection(SigRoomSelection{tmpSel});
+        emit newRoomSelection(SigRoomSelection{getSelectedRooms()});
         emit editSelection();
     });
 
@@ -85,7 +112,6 @@ FindRoomsDlg::FindRoomsDlg(MapData *const md, QWidget *const parent)
 FindRoomsDlg::~FindRoomsDlg()
 {
     delete m_showSelectedRoom;
-    resultTable->clear();
 }
 
 void FindRoomsDlg::readSettings()
@@ -98,19 +124,13 @@ void FindRoomsDlg::writeSettings()
     setConfig().findRoomsDialog.geometry = saveGeometry();
 }
 
-void FindRoomsDlg::findClicked()
+RoomFilter FindRoomsDlg::getFilter() const
 {
     const Qt::CaseSensitivity cs = caseCheckBox->isChecked() ? Qt::CaseSensitive
                                                              : Qt::CaseInsensitive;
     std::string text = lineEdit->text().toLatin1().toStdString();
     // remove latin1
     text = ParserUtils::latin1ToAsciiInPlace(text);
-    resultTable->clear();
-    roomsFoundLabel->clear();
-
-    /*  for an absolute match do the below:
-    m_mapData->lookingForRooms(this, createEvent(CommandEnum::UNKNOWN, text, nullString, nullString, 0, 0));
-    */
 
     auto kind = PatternKindsEnum::ALL;
     if (nameRadioButton->isChecked()) {
@@ -126,72 +146,127 @@ void FindRoomsDlg::findClicked()
     } else if (flagsRadioButton->isChecked()) {
         kind = PatternKindsEnum::FLAGS;
     }
+    return RoomFilter(text, cs, kind);
+}
+
+void FindRoomsDlg::findClicked()
+{
+    m_searchTimer.stop();
 
+    /*  for an absolute match do the below:
+    m_mapData->lookingForRooms(this, createEvent(CommandEnum::UNKNOWN, text, nullString, nullString, 0, 0));
+    */
+
+    std::optional<RoomFilter> optFilter;
     try {
-        auto tmpSel = RoomSelection(*m_mapData);
-        tmpSel.genericSearch(RoomFilter(text, cs, kind));
-
-        for (const Room *const room : tmpSel) {
-            QString id;
-            id.setNum(room->getId().asUint32());
-            QString roomName = room->getName().toQString();
-            QString toolTip = constructToolTip(room);
-
-            item = new QTreeWidgetItem(resultTable);
-            item->setText(0, id);
-            item->setText(1, roomName);
-            item->setToolTip(0, toolTip);
-            item->setToolTip(1, toolTip);
-        }
+        optFilter.emplace(getFilter());
     } catch (const std::exception &ex) {
         qWarning() << "Exception: " << ex.what();
         QMessageBox::critical(this,
                               "Internal Error",
                               QString::asprintf("An exception occurred: %s\r\n", ex.what()));
+        return;
     }
-    roomsFoundLabel->setText(tr("%1 room%2 found")
-                                 .arg(resultTable->topLevelItemCount())
-                                 .arg((resultTable->topLevelItemCount() == 1) ? "" : "s"));
+
+    // The rooms are matched on a worker, and handed to the model in batches
+    // as they're found; starting another search drops whatever this one
+    // hasn't delivered yet.
+    MapData &mapData = deref(m_mapData);
+    const SharedMapSnapshot snapshot = mapData.getSnapshot();
+    m_model.reset(snapshot);
+    updateRoomsFoundLabel(true);
+
+    m_searchJob.start([this, &mapData, snapshot, f = std::move(optFilter.value())](
+                          const BackgroundJob::Token &token) {
+        static constexpr const size_t BATCH_SIZE = 256;
+        std::vector<RoomId> batch;
+        const auto flush = [this, &token, &batch]() {
+            token.post([this, ids = std::exchange(batch, {})]() {
+                m_model.append(ids);
+                updateRoomsFoundLabel(true);
+            });
+        };
+        if (!mapData.searchSnapshot(
+                *snapshot,
+                f,
+                [&batch, &flush](const RoomId id) {
+                    batch.emplace_back(id);
+                    if (batch.size() >= BATCH_SIZE)
+                        flush();
+                },
+                [&token]() { return token.isCancelled(); }))
+            return;
+        flush();
+        token.post([this]() {
+            m_model.finish();
+            updateRoomsFoundLabel(false);
+        });
+    });
 }
 
-// FIXME: This code is almost identical to the code in MapCanvas::mouseReleaseEvent. Refactor!
-QString FindRoomsDlg::constructToolTip(const Room *const r)
+void FindRoomsDlg::updateRoomsFoundLabel(const bool searching)
 {
-    return QString("Selected Room ID: %1\n%2").arg(r->getId().asUint32()).arg(r->toQString());
+    const int count = m_model.size();
+    if (searching)
+        roomsFoundLabel->setText(tr("Searching... %1 so far").arg(count));
+    else
+        roomsFoundLabel->setText(tr("%1 room%2 found").arg(count).arg((count == 1) ? "" : "s"));
+}
+
+void FindRoomsDlg::clearResults()
+{
+    m_searchTimer.stop();
+    m_searchJob.cancel();
+    m_model.reset(nullptr);
+    roomsFoundLabel->clear();
+}
+
+SharedRoomSelection FindRoomsDlg::getSelectedRooms()
+{
+    const auto tmpSel = RoomSelection::createSelection(*m_mapData);
+    for (const QModelIndex &index : resultTable->selectionModel()->selectedRows()) {
+        const RoomId id = m_model.getRoomId(index);
+        if (id != INVALID_ROOMID)
+            tmpSel->getRoom(id);
+    }
+    return tmpSel;
 }
 
 void FindRoomsDlg::showSelectedRoom()
 {
-    itemDoubleClicked(resultTable->currentItem());
+    itemDoubleClicked(resultTable->currentIndex());
 }
 
-void FindRoomsDlg::itemDoubleClicked(QTreeWidgetItem *const inputItem)
+void FindRoomsDlg::itemDoubleClicked(const QModelIndex &index)
 {
-    if (inputItem == nullptr) {
+    const RoomId id = m_model.getRoomId(index);
+    if (id == INVALID_ROOMID) {
         return;
     }
 
     auto tmpSel = RoomSelection(*m_mapData);
-    const auto id = RoomId{inputItem->text(0).toUInt()};
     if (const Room *const r = tmpSel.getRoom(id)) {
         if (r->getId() == id) {
             const Coordinate &c = r->getPosition();
             const auto worldPos = c.to_vec2() + glm::vec2{0.5f, 0.5f};
             emit sig_center(worldPos); // connects to MapWindow
         }
-        emit log("FindRooms", inputItem->toolTip(0));
+        const QModelIndex first = index.sibling(index.row(), 0);
+        emit log("FindRooms", m_model.data(first, Qt::ToolTipRole).toString());
     }
 }
 
 void FindRoomsDlg::adjustResultTable()
 {
-    resultTable->setColumnCount(2);
-    resultTable->setHeaderLabels(QStringList() << tr("Room ID") << tr("Room Name"));
+    resultTable->setModel(&m_model);
     resultTable->header()->setSectionResizeMode(QHeaderView::ResizeToContents);
     resultTable->setRootIsDecorated(false);
     resultTable->setAlternatingRowColors(true);
     resultTable->setSelectionBehavior(QAbstractItemView::SelectionBehavior::SelectRows);
     resultTable->setSelectionMode(QAbstractItemView::SelectionMode::ExtendedSelection);
+    resultTable->setSortingEnabled(true);
+    resultTable->sortByColumn(static_cast<int>(FindRoomsModel::ColumnTypeEnum::ID),
+                              Qt::AscendingOrder);
 }
 
 void FindRoomsDlg::enableFindButton(const QString &text)
@@ -202,8 +277,7 @@ void FindRoomsDlg::enableFindButton(const QString &text)
 void FindRoomsDlg::closeEvent(QCloseEvent *event)
 {
     writeSettings();
-    resultTable->clear();
-    roomsFoundLabel->clear();
+    clearResults();
     lineEdit->setFocus();
     selectButton->setEnabled(false);
     editButton->setEnabled(false);
@@ -6,12 +6,14 @@
 
 #include <QDialog>
 #include <QString>
+#include <QTimer>
 #include <QtCore>
 #include <QtGlobal>
-#include <QtWidgets/QTreeWidgetItem>
 
+#include "../global/BackgroundJob.h"
 #include "../mapdata/roomselection.h"
 #include "../parser/abstractparser.h"
+#include "FindRoomsModel.h"
 #include "ui_findroomsdlg.h" // auto-generated
 
 class MapCanvas;
@@ -19,9 +21,9 @@ class MapData;
 class QCloseEvent;
 class QObject;
 class QShortcut;
-class QTreeWidgetItem;
 class QWidget;
 class Room;
+class RoomFilter;
 
 class FindRoomsDlg : public QDialog, private Ui::FindRoomsDlg
 {
@@ -45,16 +47,23 @@ public slots:
 
 private:
     MapData *m_mapData = nullptr;
-    QTreeWidgetItem *item = nullptr;
     QShortcut *m_showSelectedRoom = nullptr;
+    FindRoomsModel m_model;
+    // Searches again once the query has stopped changing for a moment.
+    QTimer m_searchTimer;
+    // Declared last, so that it's waited for before the model is destroyed.
+    BackgroundJob m_searchJob{*this};
 
     void adjustResultTable();
+    NODISCARD RoomFilter getFilter() const;
+    NODISCARD SharedRoomSelection getSelectedRooms();
+    void clearResults();
+    void updateRoomsFoundLabel(bool searching);
 
 private slots:
-    QString constructToolTip(const Room *);
     void on_lineEdit_textChanged();
     void findClicked();
     void enableFindButton(const QString &text);
-    void itemDoubleClicked(QTreeWidgetItem *inputItem);
+    void itemDoubleClicked(const QModelIndex &index);
     void showSelectedRoom();
 };
@@ -6,9 +6,12 @@
 
 #include "mainwindow.h"
 
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <stdexcept>
+#include <utility>
 #include <vector>
 #include <QActionGroup>
 #include <QCloseEvent>
@@ -37,8 +40,11 @@
 #include "../expandoracommon/parseevent.h"
 #include "../expandoracommon/room.h"
 #include "../global/Debug.h"
+#include "../global/MemoryUsage.h"
 #include "../global/NullPointerException.h"
 #include "../global/SignalBlocker.h"
+#include "../global/StartupTimer.h"
+#include "../global/Trace.h"
 #include "../global/Version.h"
 #include "../global/roomid.h"
 #include "../mapdata/ExitDirection.h"
@@ -86,6 +92,9 @@ class NODISCARD CanvasDisabler final
     DELETE_CTORS_AND_ASSIGN_OPS(CanvasDisabler);
 };
 
+// How long startServices() waits for the first frame.
+static constexpr const auto FIRST_FRAME_TIMEOUT = std::chrono::seconds(2);
+
 static void addApplicationFont()
 {
     const auto id = QFontDatabase::addApplicationFont(":/fonts/DejaVuSansMono.ttf");
@@ -187,6 +196,7 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
 
     m_prespammedPath = new PrespammedPath(this);
 
+    // Its thread, certificate and sockets wait for startServices().
     m_groupManager = new Mmapper2Group(this);
     m_groupManager->setObjectName("GroupManager");
 
@@ -195,6 +205,7 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
 
     m_pathMachine = new Mmapper2PathMachine(m_mapData, this);
     m_pathMachine->setObjectName("Mmapper2PathMachine");
+    startup::mark("map window");
 
     m_clientWidget = new ClientWidget(this);
     m_clientWidget->setObjectName("InternalMudClientWidget");
@@ -231,18 +242,15 @@ MainWindow::MainWindow(QWidget *parent, Qt::WindowFlags flags)
     m_dockDialogGroup->setWidget(m_groupWidget);
     m_dockDialogGroup->hide();
     connect(m_groupWidget, &GroupWidget::sig_center, m_mapWindow, &MapWindow::centerOnWorldPos);
-
-    m_findRoomsDlg = new FindRoomsDlg(m_mapData, this);
-    m_findRoomsDlg->setObjectName("FindRoomsDlg");
+    startup::mark("panels");
 
     m_mumeClock = new MumeClock(getConfig().mumeClock.startEpoch, this);
-    if constexpr (!NO_UPDATER)
-        m_updateDialog = new UpdateDialog(this);
 
     createActions();
     setupToolBars();
     setupMenuBar();
     setupStatusBar();
+    startup::mark("menus");
 
     setCorner(Qt::TopLeftCorner, Qt::TopDockWidgetArea);
     setCorner(Qt::BottomLeftCorner, Qt::BottomDockWidgetArea);
@@ -337,7 +345,7 @@ void MainWindow::startServices()
     if constexpr (!NO_UPDATER) {
         // Raise the update dialog if an update is found
         if (getConfig().general.checkForUpdate)
-            m_updateDialog->open();
+            getUpdateDialog().open();
     }
 }
 
@@ -370,7 +378,7 @@ void MainWindow::writeSettings()
 
 void MainWindow::wireConnections()
 {
-    connect(m_pathMachine, &Mmapper2PathMachine::log, this, &MainWindow::log);
+    connect(m_pathMachine, &Mmapper2PathMachine::log, this, &MainWindow::log, Qt::DirectConnection);
 
     connect(m_pathMachine,
             SIGNAL(lookingForRooms(RoomRecipient &, const Coordinate &)),
@@ -381,6 +389,22 @@ void MainWindow::wireConnections()
                 &Mmapper2PathMachine::lookingForRooms),
             m_mapData,
             QOverload<RoomRecipient &, const SigParseEvent &>::of(&MapData::lookingForRooms));
+    connect(m_pathMachine,
+            &Mmapper2PathMachine::lookingForNearbyRooms,
+            m_mapData,
+            &MapData::lookingForNearbyRooms);
+    connect(m_pathMachine,
+            &Mmapper2PathMachine::lookingForRoomsNear,
+            m_mapData,
+            &MapData::lookingForRoomsNear);
+    connect(m_pathMachine,
+            &Mmapper2PathMachine::sig_sweepTemporaryRooms,
+            m_mapData,
+            &MapData::sweepTemporaryRooms);
+    connect(m_pathMachine,
+            &Mmapper2PathMachine::lookingForSimilarRooms,
+            m_mapData,
+            &MapData::lookingForSimilarRooms);
     connect(m_pathMachine,
             SIGNAL(lookingForRooms(RoomRecipient &, RoomId)),
             m_mapData,
@@ -397,15 +421,22 @@ void MainWindow::wireConnections()
     // moved to mapwindow
     connect(m_mapData, &MapData::sig_mapSizeChanged, m_mapWindow, &MapWindow::setScrollBars);
 
-    connect(m_prespammedPath, &PrespammedPath::update, canvas, &MapCanvas::requestUpdate);
+    connect(m_prespammedPath, &PrespammedPath::update, canvas, &MapCanvas::groupChanged);
 
-    connect(m_mapData, &MapData::log, this, &MainWindow::log);
-    connect(canvas, &MapCanvas::log, this, &MainWindow::log);
+    connect(m_mapData, &MapData::log, this, &MainWindow::log, Qt::DirectConnection);
+    connect(canvas, &MapCanvas::log, this, &MainWindow::log, Qt::DirectConnection);
 
     connect(m_mapData, &MapData::onDataChanged, this, [this]() {
         setWindowModified(true);
         saveAct->setEnabled(true);
     });
+    connect(m_mapData,
+            &MapData::sig_editHistoryChanged,
+            this,
+            [this](const bool canUndo, const bool canRedo) {
+                undoAct->setEnabled(canUndo);
+                redoAct->setEnabled(canRedo);
+            });
 
     connect(zoomInAct, &QAction::triggered, canvas, &MapCanvas::zoomIn);
     connect(zoomOutAct, &QAction::triggered, canvas, &MapCanvas::zoomOut);
@@ -417,7 +448,7 @@ void MainWindow::wireConnections()
     connect(canvas, &QWidget::customContextMenuRequested, this, &MainWindow::showContextMenu);
 
     // Group
-    connect(m_groupManager, &Mmapper2Group::log, this, &MainWindow::log);
+    connect(m_groupManager, &Mmapper2Group::log, this, &MainWindow::log, Qt::DirectConnection);
     connect(m_pathMachine,
             &PathMachine::setCharPosition,
             m_groupManager,
@@ -426,7 +457,7 @@ void MainWindow::wireConnections()
     connect(m_groupManager,
             &Mmapper2Group::updateMapCanvas,
             canvas,
-            &MapCanvas::requestUpdate,
+            &MapCanvas::groupChanged,
             Qt::QueuedConnection);
     connect(this,
             &MainWindow::setGroupMode,
@@ -438,12 +469,18 @@ void MainWindow::wireConnections()
             this,
             &MainWindow::groupNetworkStatus,
             Qt::QueuedConnection);
+    connect(m_groupManager,
+            &Mmapper2Group::sig_applySyncedRooms,
+            m_mapData,
+            &MapData::slot_applySyncedRooms,
+            Qt::QueuedConnection);
+    m_groupManager->setMapDigestSource([mapData = m_mapData]() { return mapData->getMapDigest(); });
 
     connect(m_mapData, &MapFrontend::sig_clearingMap, m_groupWidget, &GroupWidget::mapUnloaded);
 
-    connect(m_mumeClock, &MumeClock::log, this, &MainWindow::log);
+    connect(m_mumeClock, &MumeClock::log, this, &MainWindow::log, Qt::DirectConnection);
 
-    connect(m_listener, &ConnectionListener::log, this, &MainWindow::log);
+    connect(m_listener, &ConnectionListener::log, this, &MainWindow::log, Qt::DirectConnection);
     connect(m_dockDialogClient,
             &QDockWidget::visibilityChanged,
             m_clientWidget,
@@ -455,17 +492,71 @@ void MainWindow::wireConnections()
     connect(m_clientWidget, &ClientWidget::relayMessage, this, [this](const QString &message) {
         statusBar()->showMessage(message, 2000);
     });
+}
 
-    // Find Room Dialog Connections
-    connect(m_findRoomsDlg, &FindRoomsDlg::newRoomSelection, canvas, &MapCanvas::setRoomSelection);
+FindRoomsDlg &MainWindow::getFindRoomsDlg()
+{
+    if (m_findRoomsDlg != nullptr)
+        return *m_findRoomsDlg;
+
+    m_findRoomsDlg = new FindRoomsDlg(m_mapData, this);
+    m_findRoomsDlg->setObjectName("FindRoomsDlg");
+    connect(m_findRoomsDlg,
+            &FindRoomsDlg::newRoomSelection,
+            getCanvas(),
+            &MapCanvas::setRoomSelection);
     connect(m_findRoomsDlg, &FindRoomsDlg::sig_center, m_mapWindow, &MapWindow::centerOnWorldPos);
-    connect(m_findRoomsDlg, &FindRoomsDlg::log, this, &MainWindow::log);
+    connect(m_findRoomsDlg, &FindRoomsDlg::log, this, &MainWindow::log, Qt::DirectConnection);
     connect(m_findRoomsDlg, &FindRoomsDlg::editSelection, this, &MainWindow::onEditRoomSelection);
+    return *m_findRoomsDlg;
+}
+
+UpdateDialog &MainWindow::getUpdateDialog()
+{
+    assert(!NO_UPDATER);
+    // The first network request also loads the TLS libraries, which is slow.
+    if (m_updateDialog == nullptr)
+        m_updateDialog = new UpdateDialog(this);
+    return *m_updateDialog;
 }
 
 void MainWindow::log(const QString &module, const QString &message)
 {
-    logWindow->append("[" + module + "] " + message);
+    // About a frame.
+    static constexpr const int LOG_DRAIN_INTERVAL_MS = 16;
+
+    m_logRing.push(module, message);
+    if (!m_logDrainScheduled.exchange(true)) {
+        QMetaObject::invokeMethod(
+            this,
+            [this]() { QTimer::singleShot(LOG_DRAIN_INTERVAL_MS, this, &MainWindow::drainLog); },
+            Qt::QueuedConnection);
+    }
+}
+
+void MainWindow::drainLog()
+{
+    // More than this per frame can't be read anyway, and would hold up the GUI.
+    static constexpr const size_t MAX_LOG_LINES_PER_DRAIN = 200;
+
+    // Lines logged from now on schedule another drain.
+    m_logDrainScheduled = false;
+    const LogRing::Drained drained = m_logRing.drain(MAX_LOG_LINES_PER_DRAIN);
+    if (drained.lines.empty() && drained.suppressed == 0)
+        return;
+
+    QStringList text;
+    for (const LogRing::Line &line : drained.lines) {
+        QString entry = "[" + line.module + "] " + line.message;
+        if (line.repeats > 1)
+            entry += QString(" (repeated %1 times)").arg(line.repeats);
+        text.append(entry);
+    }
+    if (drained.suppressed != 0)
+        text.append(
+            QString("[MainWindow] %1 more log lines were not shown.").arg(drained.suppressed));
+
+    logWindow->append(text.join("\n"));
     logWindow->moveCursor(QTextCursor::MoveOperation::End);
     logWindow->ensureCursorVisible();
     logWindow->update();
@@ -527,6 +618,18 @@ void MainWindow::createActions()
     exitAct->setStatusTip(tr("Exit the application"));
     connect(exitAct, &QAction::triggered, this, &QWidget::close);
 
+    undoAct = new QAction(QIcon::fromTheme("edit-undo"), tr("&Undo"), this);
+    undoAct->setShortcut(tr("Ctrl+Z"));
+    undoAct->setStatusTip(tr("Undo the last change to the rooms"));
+    undoAct->setEnabled(false);
+    connect(undoAct, &QAction::triggered, this, &MainWindow::onUndo);
+
+    redoAct = new QAction(QIcon::fromTheme("edit-redo"), tr("&Redo"), this);
+    redoAct->setShortcut(tr("Ctrl+Shift+Z"));
+    redoAct->setStatusTip(tr("Redo the last undone change to the rooms"));
+    redoAct->setEnabled(false);
+    connect(redoAct, &QAction::triggered, this, &MainWindow::onRedo);
+
     preferencesAct = new QAction(QIcon::fromTheme("preferences-desktop",
                                                   QIcon(":/icons/preferences.png")),
                                  tr("&Preferences"),
@@ -771,6 +874,18 @@ void MainWindow::createActions()
     connect(saveLogAct, &QAction::triggered, m_clientWidget, &ClientWidget::saveLog);
     saveLogAct->setStatusTip(tr("Save log as file"));
 
+    recordTraceAct = new QAction(tr("&Record Trace"), this);
+    recordTraceAct->setStatusTip(tr("Record what each thread is doing, for chrome://tracing"));
+    recordTraceAct->setCheckable(true);
+    recordTraceAct->setChecked(trace::isEnabled());
+    connect(recordTraceAct, &QAction::toggled, this, &MainWindow::onRecordTrace);
+
+    saveTraceAct = new QAction(QIcon::fromTheme("document-save", QIcon(":/icons/save.png")),
+                               tr("Save &Trace as..."),
+                               this);
+    saveTraceAct->setStatusTip(tr("Save the recorded trace as a Chrome trace file"));
+    connect(saveTraceAct, &QAction::triggered, this, &MainWindow::onSaveTrace);
+
     releaseAllPathsAct = new QAction(QIcon(":/icons/cancel.png"), tr("Release All Paths"), this);
     releaseAllPathsAct->setStatusTip(tr("Release all paths"));
     releaseAllPathsAct->setCheckable(false);
@@ -927,7 +1042,12 @@ void MainWindow::onPlayMode()
                &Mmapper2PathMachine::sig_scheduleAction,
                m_mapData,
                &MapData::slot_scheduleAction);
+    disconnect(m_pathMachine,
+               &Mmapper2PathMachine::sig_scheduleActions,
+               m_mapData,
+               &MapData::slot_scheduleActions);
     setConfig().general.mapMode = MapModeEnum::PLAY;
+    getConfig().writeLater();
     modeMenu->setIcon(mapperMode.playModeAct->icon());
 }
 
@@ -939,7 +1059,12 @@ void MainWindow::onMapMode()
             &Mmapper2PathMachine::sig_scheduleAction,
             m_mapData,
             &MapData::slot_scheduleAction);
+    connect(m_pathMachine,
+            &Mmapper2PathMachine::sig_scheduleActions,
+            m_mapData,
+            &MapData::slot_scheduleActions);
     setConfig().general.mapMode = MapModeEnum::MAP;
+    getConfig().writeLater();
     modeMenu->setIcon(mapperMode.mapModeAct->icon());
 }
 
@@ -951,7 +1076,12 @@ void MainWindow::onOfflineMode()
                &Mmapper2PathMachine::sig_scheduleAction,
                m_mapData,
                &MapData::slot_scheduleAction);
+    disconnect(m_pathMachine,
+               &Mmapper2PathMachine::sig_scheduleActions,
+               m_mapData,
+               &MapData::slot_scheduleActions);
     setConfig().general.mapMode = MapModeEnum::OFFLINE;
+    getConfig().writeLater();
     modeMenu->setIcon(mapperMode.offlineModeAct->icon());
 }
 
@@ -1019,6 +1149,9 @@ void MainWindow::setupMenuBar()
     fileMenu->addAction(exitAct);
 
     editMenu = menuBar()->addMenu(tr("&Edit"));
+    editMenu->addAction(undoAct);
+    editMenu->addAction(redoAct);
+    editMenu->addSeparator();
     modeMenu = editMenu->addMenu(QIcon(":/icons/online.png"), tr("&Mode"));
     modeMenu->addAction(mapperMode.playModeAct);
     modeMenu->addAction(mapperMode.mapModeAct);
@@ -1103,6 +1236,11 @@ void MainWindow::setupMenuBar()
     pathMachineMenu->addSeparator();
     pathMachineMenu->addAction(forceRoomAct);
     pathMachineMenu->addAction(releaseAllPathsAct);
+    if (!NO_TRACING) {
+        settingsMenu->addSeparator();
+        settingsMenu->addAction(recordTraceAct);
+        settingsMenu->addAction(saveTraceAct);
+    }
 
     helpMenu = menuBar()->addMenu(tr("&Help"));
     helpMenu->addAction(voteAct);
@@ -1173,6 +1311,7 @@ void MainWindow::alwaysOnTop()
     qInfo() << "Setting AlwaysOnTop flag to " << alwaysOnTop;
     setWindowFlag(Qt::WindowStaysOnTopHint, alwaysOnTop);
     setConfig().general.alwaysOnTop = alwaysOnTop;
+    getConfig().writeLater();
     show();
 }
 
@@ -1312,6 +1451,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 {
     writeSettings();
     if (maybeSave()) {
+        compactJournal();
         // REVISIT: Group Manager is not owned by the MainWindow and needs to be terminated
         m_groupManager->stop();
         event->accept();
@@ -1327,9 +1467,13 @@ void MainWindow::showEvent(QShowEvent *const event)
 
     static std::once_flag flag;
     std::call_once(flag, [this]() {
-        // Read geometry and state settings and start services on startup
+        // Read geometry and state settings on startup; the services wait
+        // until the window has been drawn once, so it's usable sooner.
         readSettings();
-        startServices();
+        startup::mark("show");
+        connect(getCanvas(), &QOpenGLWidget::frameSwapped, this, &MainWindow::onFirstFrame);
+        // There won't be a frame if OpenGL couldn't be initialized.
+        QTimer::singleShot(FIRST_FRAME_TIMEOUT, this, &MainWindow::onFirstFrame);
 
         connect(window()->windowHandle(), &QWindow::screenChanged, this, [this]() {
             MapCanvas &canvas = deref(getCanvas());
@@ -1340,6 +1484,17 @@ void MainWindow::showEvent(QShowEvent *const event)
     event->accept();
 }
 
+void MainWindow::onFirstFrame()
+{
+    if (std::exchange(m_startedServices, true))
+        return;
+    disconnect(getCanvas(), &QOpenGLWidget::frameSwapped, this, &MainWindow::onFirstFrame);
+    startup::mark("first frame");
+    startServices();
+    startup::mark("services");
+    startup::finish();
+}
+
 void MainWindow::newFile()
 {
     if (maybeSave()) {
@@ -1357,7 +1512,7 @@ void MainWindow::forceNewFile()
         setWindowModified(false);
         saveAct->setEnabled(false);
     });
-    connect(storage, &AbstractMapStorage::log, this, &MainWindow::log);
+    connect(storage, &AbstractMapStorage::log, this, &MainWindow::log, Qt::DirectConnection);
     storage->newData();
     setCurrentFile("");
     mapChanged();
@@ -1386,31 +1541,34 @@ void MainWindow::merge()
 
     getCanvas()->clearAllSelections();
 
-    MapStorage mapStorage(*m_mapData, fileName, &file, this);
+    // The other map is read on its own, and then merged into ours by position (see mergeMap).
+    const auto staging = std::make_shared<MapData>();
+    MapStorage mapStorage(*staging, fileName, &file, this);
     auto storage = static_cast<AbstractMapStorage *>(&mapStorage);
-    connect(storage, &AbstractMapStorage::onDataLoaded, getCanvas(), &MapCanvas::dataLoaded);
-    connect(storage, &AbstractMapStorage::onDataLoaded, m_groupWidget, &GroupWidget::mapLoaded);
-    connect(storage, &AbstractMapStorage::onDataLoaded, this, [this]() {
-        setWindowModified(false);
-        saveAct->setEnabled(false);
-    });
     connect(&storage->getProgressCounter(),
             &ProgressCounter::onPercentageChanged,
             this,
             &MainWindow::percentageChanged);
-    connect(storage, &AbstractMapStorage::log, this, &MainWindow::log);
+    connect(storage, &AbstractMapStorage::log, this, &MainWindow::log, Qt::DirectConnection);
 
-    const bool merged = [this, &storage]() -> bool {
+    const std::optional<MapDiff> merged = [this, &storage, &staging]() -> std::optional<MapDiff> {
         ActionDisabler actionDisabler{*this};
         CanvasHider canvasHider{*this};
-        return storage->canLoad() && storage->mergeData();
+        if (!storage->canLoad() || !storage->loadData())
+            return std::nullopt;
+        return m_mapData->mergeMap(*staging);
     }();
 
-    if (!merged) {
+    if (!merged.has_value()) {
         showWarning(tr("Failed to merge file %1.").arg(fileName));
     } else {
+        getCanvas()->dataLoaded();
+        m_groupWidget->mapLoaded();
         mapChanged();
-        statusBar()->showMessage(tr("File merged"), 2000);
+        statusBar()->showMessage(tr("File merged: %1 room(s) added, %2 changed")
+                                     .arg(merged->added.size())
+                                     .arg(merged->changed.size()),
+                                 2000);
     }
 
     progressDlg.reset();
@@ -1446,13 +1604,131 @@ void MainWindow::reload()
 }
 
 bool MainWindow::save()
+{
+    return saveCurrentFile(true);
+}
+
+bool MainWindow::saveCurrentFile(const bool inBackground)
 {
     if (m_mapData->getFileName().isEmpty() || m_mapData->isFileReadOnly()) {
         return saveAs();
     }
+    if (m_backgroundSave.running) {
+        if (!inBackground) {
+            waitForBackgroundSave();
+        } else {
+            // Save again once it's done, so that whatever changed meanwhile is included.
+            m_backgroundSave.queued = true;
+            return true;
+        }
+    }
+    // Most saves only touch a few rooms, so try appending them to the journal first.
+    MapStorage journal(*m_mapData, m_mapData->getFileName(), this);
+    connect(&journal, &AbstractMapStorage::log, this, &MainWindow::log, Qt::DirectConnection);
+    if (journal.saveJournal()) {
+        statusBar()->showMessage(tr("File saved"), 2000);
+        setWindowModified(false);
+        saveAct->setEnabled(false);
+        return true;
+    }
+    // The journal may have found edits on disk that a full save would remove.
+    if (m_mapData->isFileReadOnly()) {
+        return saveAs();
+    }
+    if (inBackground) {
+        startBackgroundSave(m_mapData->getFileName());
+        return true;
+    }
     return saveFile(m_mapData->getFileName(), SaveModeEnum::FULL, SaveFormatEnum::MM2);
 }
 
+void MainWindow::startBackgroundSave(const QString &fileName)
+{
+    assert(!m_backgroundSave.running);
+    const auto snapshot = std::make_shared<const MapStorage::SaveSnapshot>(
+        MapStorage::takeSaveSnapshot(*m_mapData));
+    // Anything that changes from now on is relative to the file being written.
+    m_mapData->unsetDataChanged();
+    m_mapData->resetJournal(true);
+    setWindowModified(false);
+    saveAct->setEnabled(false);
+    m_backgroundSave.running = true;
+    statusBar()->showMessage(tr("Saving map..."));
+
+    MapData &mapData = *m_mapData;
+    m_saveJob.start([this, &mapData, fileName, snapshot](const BackgroundJob::Token &token) {
+        QString error;
+        try {
+            FileSaver saver;
+            saver.open(fileName);
+            MapStorage storage(mapData, fileName, &saver.file());
+            connect(&storage,
+                    &AbstractMapStorage::log,
+                    this,
+                    &MainWindow::log,
+                    Qt::DirectConnection);
+            connect(&storage.getProgressCounter(),
+                    &ProgressCounter::onPercentageChanged,
+                    this,
+                    [this](const quint32 p) {
+                        statusBar()->showMessage(tr("Saving map... %1%").arg(p));
+                    });
+            if (storage.saveSnapshot(*snapshot)) {
+                saver.close();
+            } else {
+                error = tr("Error while saving (see log).");
+            }
+        } catch (const std::exception &e) {
+            error = tr("Cannot write file %1:\n%2.").arg(fileName).arg(e.what());
+        }
+        token.post([this, fileName, error]() { finishBackgroundSave(fileName, error); });
+    });
+}
+
+void MainWindow::finishBackgroundSave(const QString &fileName, const QString &error)
+{
+    m_backgroundSave.running = false;
+    if (!error.isEmpty()) {
+        m_backgroundSave.queued = false;
+        // Neither the old file nor its journal are known to match what's on disk now.
+        m_mapData->resetJournal(false);
+        m_mapData->setDataChanged();
+        statusBar()->clearMessage();
+        showWarning(error);
+        return;
+    }
+
+    // The journal belonged to the file that was just replaced.
+    QFile::remove(MapStorage::getJournalFileName(fileName));
+    m_mapData->setFileName(fileName, !QFileInfo(fileName).isWritable());
+    setCurrentFile(fileName);
+    statusBar()->showMessage(tr("File saved"), 2000);
+    if (std::exchange(m_backgroundSave.queued, false) && m_mapData->dataChanged()) {
+        save();
+    }
+}
+
+void MainWindow::waitForBackgroundSave()
+{
+    if (!m_backgroundSave.running)
+        return;
+    m_backgroundSave.queued = false;
+    m_saveJob.wait();
+    // Apply its result now instead of from the event loop.
+    QCoreApplication::sendPostedEvents(this, QEvent::MetaCall);
+}
+
+void MainWindow::compactJournal()
+{
+    const QString fileName = m_mapData->getFileName();
+    if (fileName.isEmpty() || m_mapData->isFileReadOnly()
+        || !QFileInfo::exists(MapStorage::getJournalFileName(fileName))) {
+        return;
+    }
+    // Fold the journal back into the map so the next load doesn't have to replay it.
+    saveFile(fileName, SaveModeEnum::FULL, SaveFormatEnum::MM2);
+}
+
 std::unique_ptr<QFileDialog> MainWindow::createDefaultSaveDialog()
 {
     auto save = std::make_unique<QFileDialog>(this, "Choose map file name ...");
@@ -1585,12 +1861,15 @@ bool MainWindow::exportMmpMap()
 
 void MainWindow::about()
 {
-    AboutDialog about(this);
+    MemoryUsage usage = m_mapData->getMemoryUsage();
+    usage.add(getPublishedMemoryUsage());
+    AboutDialog about(usage.toString(), this);
     about.exec();
 }
 
 bool MainWindow::maybeSave()
 {
+    waitForBackgroundSave();
     if (!m_mapData->dataChanged())
         return true;
 
@@ -1603,7 +1882,7 @@ bool MainWindow::maybeSave()
                                          QMessageBox::Cancel | QMessageBox::Escape);
 
     if (ret == QMessageBox::Yes) {
-        return save();
+        return saveCurrentFile(false);
     }
 
     // REVISIT: is it a bug if this returns true? (Shouldn't this always be false?)
@@ -1611,6 +1890,12 @@ bool MainWindow::maybeSave()
 }
 
 MainWindow::ProgressDialogLifetime MainWindow::createNewProgressDialog(const QString &text)
+{
+    showProgressDialog(text);
+    return ProgressDialogLifetime{*this};
+}
+
+void MainWindow::showProgressDialog(const QString &text)
 {
     m_progressDlg = std::make_unique<QProgressDialog>(this);
     {
@@ -1624,7 +1909,6 @@ MainWindow::ProgressDialogLifetime MainWindow::createNewProgressDialog(const QSt
     m_progressDlg->setMaximum(100);
     m_progressDlg->setValue(0);
     m_progressDlg->show();
-    return ProgressDialogLifetime{*this};
 }
 
 void MainWindow::endProgressDialog()
@@ -1638,57 +1922,98 @@ void MainWindow::loadFile(const QString &fileName)
         statusBar()->showMessage(tr("No filename provided"), 2000);
         return;
     }
-
-    CanvasDisabler canvasDisabler{deref(getCanvas())};
-
-    QFile file(fileName);
-    if (!file.open(QFile::ReadOnly)) {
-        showWarning(tr("Cannot read file %1:\n%2.").arg(fileName).arg(file.errorString()));
+    if (m_backgroundLoad.running) {
+        statusBar()->showMessage(tr("Another map is still being loaded"), 2000);
         return;
     }
+    waitForBackgroundSave();
+
+    {
+        QFile file(fileName);
+        if (!file.open(QFile::ReadOnly)) {
+            showWarning(tr("Cannot read file %1:\n%2.").arg(fileName).arg(file.errorString()));
+            return;
+        }
+    }
 
     // Immediately discard the old map.
     forceNewFile();
+    startBackgroundLoad(fileName);
+}
 
-    auto progressDlg = createNewProgressDialog("Loading map...");
+void MainWindow::startBackgroundLoad(const QString &fileName)
+{
+    assert(!m_backgroundLoad.running);
+    BackgroundLoadState &state = m_backgroundLoad;
+    state.running = true;
+    state.actionDisabler.emplace(*this);
+    state.canvasHider.emplace(*this);
+    showProgressDialog("Loading map...");
+    state.progressDlg.emplace(*this);
 
-    const bool isPandoraMap = fileName.toLower().endsWith(".xml");
-    const auto storage =
-        [this, &fileName, &file, isPandoraMap]() -> std::unique_ptr<AbstractMapStorage> {
-        if (isPandoraMap) {
-            return std::make_unique<PandoraMapStorage>(*m_mapData, fileName, &file, this);
-        } else {
-            return std::make_unique<MapStorage>(*m_mapData, fileName, &file, this);
+    // Nothing else knows about it, so it can be filled without any locks. If the job is
+    // cancelled, the last reference is dropped on the pool thread, so it's always handed
+    // back to the thread it lives on (this one) to be destroyed.
+    auto staging = std::shared_ptr<MapData>(new MapData, [](MapData *const mapData) {
+        mapData->deleteLater();
+    });
+    m_loadJob.start([this, fileName, staging](const BackgroundJob::Token &token) mutable {
+        QString error;
+        try {
+            QFile file(fileName);
+            if (!file.open(QFile::ReadOnly)) {
+                throw std::runtime_error(file.errorString().toStdString());
+            }
+            const bool isPandoraMap = fileName.toLower().endsWith(".xml");
+            const auto storage = [&staging, &fileName, &file, isPandoraMap]()
+                -> std::unique_ptr<AbstractMapStorage> {
+                if (isPandoraMap) {
+                    return std::make_unique<PandoraMapStorage>(*staging, fileName, &file);
+                } else {
+                    return std::make_unique<MapStorage>(*staging, fileName, &file);
+                }
+            }();
+            connect(storage.get(),
+                    &AbstractMapStorage::log,
+                    this,
+                    &MainWindow::log,
+                    Qt::DirectConnection);
+            connect(&storage->getProgressCounter(),
+                    &ProgressCounter::onPercentageChanged,
+                    this,
+                    &MainWindow::percentageChanged);
+            if (!storage->canLoad() || !storage->loadData()) {
+                error = tr("Failed to load file %1.").arg(fileName);
+            }
+        } catch (const std::exception &e) {
+            error = tr("Cannot read file %1:\n%2.").arg(fileName).arg(e.what());
         }
-    }();
-
-    // REVISIT: refactor the connections to a common function?
-    connect(storage.get(), &AbstractMapStorage::onDataLoaded, getCanvas(), &MapCanvas::dataLoaded);
-    connect(storage.get(),
-            &AbstractMapStorage::onDataLoaded,
-            m_groupWidget,
-            &GroupWidget::mapLoaded);
-    connect(storage.get(), &AbstractMapStorage::onDataLoaded, this, [this]() {
-        setWindowModified(false);
-        saveAct->setEnabled(false);
+        // The map goes with the result, so it's adopted on the GUI thread.
+        token.post([this, staging = std::move(staging), error]() {
+            finishBackgroundLoad(staging, error);
+        });
     });
-    connect(&storage->getProgressCounter(),
-            &ProgressCounter::onPercentageChanged,
-            this,
-            &MainWindow::percentageChanged);
-    connect(storage.get(), &AbstractMapStorage::log, this, &MainWindow::log);
-
-    const bool loaded = [this, &storage]() -> bool {
-        ActionDisabler actionDisabler{*this};
-        CanvasHider canvasHider{*this};
-        return storage->canLoad() && storage->loadData();
-    }();
+}
 
-    if (!loaded) {
-        showWarning(tr("Failed to load file %1.").arg(fileName));
+void MainWindow::finishBackgroundLoad(const std::shared_ptr<MapData> &staging,
+                                      const QString &error)
+{
+    BackgroundLoadState &state = m_backgroundLoad;
+    state.running = false;
+    state.progressDlg.reset();
+    state.canvasHider.reset();
+    state.actionDisabler.reset();
+    if (!error.isEmpty()) {
+        showWarning(error);
         return;
     }
 
+    m_mapData->adoptLoadedMap(deref(staging));
+    getCanvas()->dataLoaded();
+    m_groupWidget->mapLoaded();
+    setWindowModified(false);
+    saveAct->setEnabled(false);
+
     mapChanged();
     setCurrentFile(m_mapData->getFileName());
     statusBar()->showMessage(tr("File loaded"), 2000);
@@ -1713,6 +2038,7 @@ bool MainWindow::saveFile(const QString &fileName,
                           const SaveModeEnum mode,
                           const SaveFormatEnum format)
 {
+    waitForBackgroundSave();
     CanvasDisabler canvasDisabler{deref(getCanvas())};
 
     FileSaver saver;
@@ -1751,7 +2077,7 @@ bool MainWindow::saveFile(const QString &fileName,
             &ProgressCounter::onPercentageChanged,
             this,
             &MainWindow::percentageChanged);
-    connect(storage.get(), &AbstractMapStorage::log, this, &MainWindow::log);
+    connect(storage.get(), &AbstractMapStorage::log, this, &MainWindow::log, Qt::DirectConnection);
 
     const bool saveOk = [this, mode, &storage]() -> bool {
         ActionDisabler actionDisabler{*this};
@@ -1772,6 +2098,7 @@ bool MainWindow::saveFile(const QString &fileName,
         // REVISIT: Shouldn't this return false?
     } else {
         if (mode == SaveModeEnum::FULL && format == SaveFormatEnum::MM2) {
+            MapStorage::discardJournal(*m_mapData, fileName);
             m_mapData->setFileName(fileName, !QFileInfo(fileName).isWritable());
             setCurrentFile(fileName);
         }
@@ -1785,7 +2112,7 @@ bool MainWindow::saveFile(const QString &fileName,
 
 void MainWindow::onFindRoom()
 {
-    m_findRoomsDlg->show();
+    getFindRoomsDlg().show();
 }
 
 void MainWindow::onLaunchClient()
@@ -1794,6 +2121,31 @@ void MainWindow::onLaunchClient()
     m_clientWidget->setFocus();
 }
 
+void MainWindow::onRecordTrace(const bool enabled)
+{
+    if (enabled)
+        trace::clear();
+    trace::setEnabled(enabled);
+}
+
+void MainWindow::onSaveTrace()
+{
+    const QString fileName = QFileDialog::getSaveFileName(this,
+                                                          tr("Save Trace"),
+                                                          "mmapper-trace.json",
+                                                          tr("Chrome trace (*.json)"));
+    if (fileName.isEmpty()) {
+        statusBar()->showMessage(tr("No filename provided"), 2000);
+        return;
+    }
+
+    if (!trace::writeChromeTrace(fileName)) {
+        QMessageBox::warning(this, tr("Save Trace"), tr("Unable to write %1.").arg(fileName));
+        return;
+    }
+    statusBar()->showMessage(tr("Trace saved"), 2000);
+}
+
 void MainWindow::groupNetworkStatus(const bool status)
 {
     if (status) {
@@ -1966,6 +2318,24 @@ void MainWindow::onDeleteRoomSelection()
     mapChanged();
 }
 
+void MainWindow::onUndo()
+{
+    if (!m_mapData->undo(m_roomSelection)) {
+        statusBar()->showMessage(tr("Nothing to undo, or its rooms are in use or have changed since"), 2000);
+        return;
+    }
+    mapChanged();
+}
+
+void MainWindow::onRedo()
+{
+    if (!m_mapData->redo(m_roomSelection)) {
+        statusBar()->showMessage(tr("Nothing to redo, or its rooms are in use or have changed since"), 2000);
+        return;
+    }
+    mapChanged();
+}
+
 void MainWindow::onDeleteConnectionSelection()
 {
     if (m_connectionSelection == nullptr)
@@ -2046,8 +2416,9 @@ void MainWindow::onConnectToNeighboursRoomSelection()
 void MainWindow::onCheckForUpdate()
 {
     assert(!NO_UPDATER);
-    m_updateDialog->show();
-    m_updateDialog->open();
+    UpdateDialog &updateDialog = getUpdateDialog();
+    updateDialog.show();
+    updateDialog.open();
 }
 
 void MainWindow::voteForMUMEOnTMC()
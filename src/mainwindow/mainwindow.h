@@ -5,6 +5,7 @@
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <QActionGroup>
@@ -19,6 +20,8 @@
 #include <QtGlobal>
 
 #include "../display/CanvasMouseModeEnum.h"
+#include "../global/BackgroundJob.h"
+#include "../global/LogRing.h"
 #include "../mapdata/roomselection.h"
 #include "../pandoragroup/mmapper2group.h"
 
@@ -85,6 +88,8 @@ public slots:
 
     void percentageChanged(quint32);
 
+    // Safe to call from any thread: the line is queued, and the log pane takes
+    // everything queued about once a frame (see drainLog()).
     void log(const QString &, const QString &);
 
     void onModeConnectionSelect();
@@ -104,6 +109,8 @@ public slots:
     void onEditInfoMarkSelection();
     void onDeleteInfoMarkSelection();
     void onDeleteRoomSelection();
+    void onUndo();
+    void onRedo();
     void onDeleteConnectionSelection();
     void onMoveUpRoomSelection();
     void onMoveDownRoomSelection();
@@ -112,6 +119,8 @@ public slots:
     void onConnectToNeighboursRoomSelection();
     void onFindRoom();
     void onLaunchClient();
+    void onRecordTrace(bool enabled);
+    void onSaveTrace();
     void onPreferences();
     void onPlayMode();
     void onMapMode();
@@ -144,12 +153,19 @@ public slots:
 
 private:
     void startServices();
+    void onFirstFrame();
     void forceNewFile();
     void showWarning(const QString &s);
+    void drainLog();
 
 private:
+    // Enough for a few frames of a burst; past that, lines are dropped and counted.
+    static constexpr const size_t LOG_RING_CAPACITY = 4096;
+
     MapWindow *m_mapWindow = nullptr;
     QTextBrowser *logWindow = nullptr;
+    LogRing m_logRing{LOG_RING_CAPACITY};
+    std::atomic<bool> m_logDrainScheduled{false};
 
     QDockWidget *m_dockDialogLog = nullptr;
     QDockWidget *m_dockDialogGroup = nullptr;
@@ -168,6 +184,7 @@ public slots:
 
     ClientWidget *m_clientWidget = nullptr;
     UpdateDialog *m_updateDialog = nullptr;
+    bool m_startedServices = false;
 
     SharedRoomSelection m_roomSelection;
     std::shared_ptr<ConnectionSelection> m_connectionSelection;
@@ -208,6 +225,8 @@ public slots:
     QAction *exportWebMapAct = nullptr;
     QAction *exportMmpMapAct = nullptr;
     QAction *exitAct = nullptr;
+    QAction *undoAct = nullptr;
+    QAction *redoAct = nullptr;
     QAction *voteAct = nullptr;
     QAction *mmapperCheckForUpdateAct = nullptr;
     QAction *mumeWebsiteAct = nullptr;
@@ -290,12 +309,25 @@ public slots:
     QAction *clientAct = nullptr;
     QAction *saveLogAct = nullptr;
 
+    QAction *recordTraceAct = nullptr;
+    QAction *saveTraceAct = nullptr;
+
     QAction *forceRoomAct = nullptr;
     QAction *releaseAllPathsAct = nullptr;
     QAction *rebuildMeshesAct = nullptr;
 
     std::unique_ptr<ConfigDialog> m_configDialog;
 
+    struct NODISCARD BackgroundSaveState final
+    {
+        bool running = false;
+        // Another save was requested while one was running.
+        bool queued = false;
+    };
+    BackgroundSaveState m_backgroundSave;
+    // Declared last, so that a running save is waited for before anything it uses goes away.
+    BackgroundJob m_saveJob{*this};
+
     void wireConnections();
 
     void createActions();
@@ -307,6 +339,12 @@ public slots:
     void writeSettings();
 
     bool maybeSave();
+    void compactJournal();
+    bool saveCurrentFile(bool inBackground);
+    void startBackgroundSave(const QString &fileName);
+    void finishBackgroundSave(const QString &fileName, const QString &error);
+    // Blocks until a running background save is done, and applies its result.
+    void waitForBackgroundSave();
     std::unique_ptr<QFileDialog> createDefaultSaveDialog();
 
     struct NODISCARD ActionDisabler final
@@ -363,8 +401,27 @@ public slots:
         void reset() { self.endProgressDialog(); }
     };
     ProgressDialogLifetime createNewProgressDialog(const QString &text);
+    void showProgressDialog(const QString &text);
     void endProgressDialog();
+
+    // Maps are loaded into a map of their own on a worker thread, which replaces
+    // the current one once it's complete, so the event loop keeps running meanwhile.
+    struct NODISCARD BackgroundLoadState final
+    {
+        std::optional<ActionDisabler> actionDisabler;
+        std::optional<CanvasHider> canvasHider;
+        std::optional<ProgressDialogLifetime> progressDlg;
+        bool running = false;
+    };
+    BackgroundLoadState m_backgroundLoad;
+    // Declared after everything the load uses, so that it's waited for first.
+    BackgroundJob m_loadJob{*this};
+    void startBackgroundLoad(const QString &fileName);
+    void finishBackgroundLoad(const std::shared_ptr<MapData> &staging, const QString &error);
     MapCanvas *getCanvas() const;
+    // Created on first use, since most sessions never open them.
+    FindRoomsDlg &getFindRoomsDlg();
+    UpdateDialog &getUpdateDialog();
     void mapChanged() const;
     void setCanvasMouseMode(CanvasMouseModeEnum mode);
     void execSelectionGroupMapAction(std::unique_ptr<AbstractAction> action);
@@ -475,9 +475,9 @@ const Room *RoomEditAttrDlg::getSelectedRoom()
         return nullptr;
     }
     if (m_roomSelection->size() == 1) {
-        return m_roomSelection->first();
+        return m_roomSelection->getFirstRoom();
     }
-    return m_roomSelection->value(
+    return m_roomSelection->find(
         RoomId{roomListComboBox->itemData(roomListComboBox->currentIndex()).toUInt()});
 }
 
@@ -523,7 +523,7 @@ void RoomEditAttrDlg::setRoomSelection(const SharedRoomSelection &rs,
         return;
     else if (rs->size() == 1) {
         tabWidget->setCurrentWidget(attributesTab);
-        const auto room = m_roomSelection->first();
+        const auto room = m_roomSelection->getFirstRoom();
         roomListComboBox->addItem(room->getName().toQString(), room->getId().asUint32());
         updateDialog(room);
     } else {
@@ -14,7 +14,10 @@
 #include "ExitFlags.h"
 
 struct DoorNameTag final
-{};
+{
+    // Most doors are just called "door".
+    static constexpr const bool is_interned = true;
+};
 
 using DoorName = TaggedString<DoorNameTag>;
 
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "InfoMarkIndex.h"
+
+#include <algorithm>
+#include <cassert>
+
+NODISCARD static int floorDiv(const int n, const int d)
+{
+    return (n >= 0) ? (n / d) : -((-n + d - 1) / d);
+}
+
+InfoMarkIndex::CellId InfoMarkIndex::getCell(const int x, const int y, const int z)
+{
+    return CellId{z, floorDiv(y, CELL_SIZE), floorDiv(x, CELL_SIZE)};
+}
+
+InfoMarkIndex::Area InfoMarkIndex::getArea(const InfoMark &marker)
+{
+    const Coordinate &pos1 = marker.getPosition1();
+    // Text only has one position; see InfoMark::setPosition1().
+    const Coordinate &pos2 = (marker.getType() == InfoMarkTypeEnum::TEXT)
+                                 ? pos1
+                                 : marker.getPosition2();
+    assert(pos2.z == pos1.z);
+
+    Area area;
+    area.z = pos1.z;
+    area.lo = glm::ivec2{std::min(pos1.x, pos2.x), std::min(pos1.y, pos2.y)};
+    area.hi = glm::ivec2{std::max(pos1.x, pos2.x), std::max(pos1.y, pos2.y)};
+    return area;
+}
+
+void InfoMarkIndex::clear()
+{
+    m_cells.clear();
+    m_entries.clear();
+}
+
+void InfoMarkIndex::insert(InfoMark &marker)
+{
+    if (contains(marker)) {
+        assert(false);
+        return;
+    }
+
+    Entry entry;
+    entry.area = getArea(marker);
+    entry.first = getCell(entry.area.lo.x, entry.area.lo.y, entry.area.z);
+    entry.last = getCell(entry.area.hi.x, entry.area.hi.y, entry.area.z);
+    for (int y = entry.first.y; y <= entry.last.y; ++y) {
+        for (int x = entry.first.x; x <= entry.last.x; ++x) {
+            m_cells[CellId{entry.area.z, y, x}].emplace_back(&marker);
+        }
+    }
+    m_entries.emplace(&marker, entry);
+}
+
+void InfoMarkIndex::remove(const InfoMark &marker)
+{
+    const auto it = m_entries.find(&marker);
+    if (it == m_entries.end())
+        return;
+
+    const Entry &entry = it->second;
+    for (int y = entry.first.y; y <= entry.last.y; ++y) {
+        for (int x = entry.first.x; x <= entry.last.x; ++x) {
+            const auto cell = m_cells.find(CellId{entry.area.z, y, x});
+            if (cell == m_cells.end()) {
+                assert(false);
+                continue;
+            }
+            auto &markers = cell->second;
+            markers.erase(std::remove(markers.begin(), markers.end(), &marker), markers.end());
+            if (markers.empty())
+                m_cells.erase(cell);
+        }
+    }
+    m_entries.erase(it);
+}
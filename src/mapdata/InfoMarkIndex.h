@@ -0,0 +1,159 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "../expandoracommon/coordinate.h"
+#include "../global/macros.h"
+#include "infomark.h"
+
+/// Buckets the infomarks of each layer by the square cells of CELL_SIZE rooms
+/// that their bounding boxes overlap, so a query for an area only looks at the
+/// markers near it instead of at every marker of the map.
+///
+/// Positions are in infomark units (INFOMARK_SCALE per room), like InfoMark's.
+/// The index doesn't notice when a marker changes; MapData calls update().
+class NODISCARD InfoMarkIndex final
+{
+public:
+    static constexpr const int CELL_SIZE = 32 * INFOMARK_SCALE;
+
+    struct NODISCARD CellId final
+    {
+        int z = 0;
+        int y = 0;
+        int x = 0;
+
+        NODISCARD bool operator<(const CellId &rhs) const
+        {
+            return std::tie(z, y, x) < std::tie(rhs.z, rhs.y, rhs.x);
+        }
+        NODISCARD bool operator==(const CellId &rhs) const
+        {
+            return z == rhs.z && y == rhs.y && x == rhs.x;
+        }
+        NODISCARD bool operator!=(const CellId &rhs) const { return !(*this == rhs); }
+
+        /// The lowest corner of the cell, in infomark units.
+        NODISCARD Coordinate getMin() const { return Coordinate{x * CELL_SIZE, y * CELL_SIZE, z}; }
+    };
+
+    /// One layer; lo and hi are inclusive.
+    struct NODISCARD Area final
+    {
+        int z = 0;
+        glm::ivec2 lo{0};
+        glm::ivec2 hi{0};
+    };
+
+private:
+    struct NODISCARD Entry final
+    {
+        // The corners of the marker's bounding box; the first cell is its "home".
+        Area area;
+        CellId first;
+        CellId last;
+    };
+
+private:
+    std::map<CellId, std::vector<InfoMark *>> m_cells;
+    std::unordered_map<const InfoMark *, Entry> m_entries;
+
+public:
+    NODISCARD static CellId getCell(int x, int y, int z);
+    NODISCARD static Area getArea(const InfoMark &marker);
+
+public:
+    void clear();
+    void insert(InfoMark &marker);
+    void remove(const InfoMark &marker);
+    /// Moves the marker to the cells of its current position.
+    void update(InfoMark &marker)
+    {
+        remove(marker);
+        insert(marker);
+    }
+
+    NODISCARD bool contains(const InfoMark &marker) const
+    {
+        return m_entries.find(&marker) != m_entries.end();
+    }
+    NODISCARD bool empty() const { return m_entries.empty(); }
+    NODISCARD size_t size() const { return m_entries.size(); }
+
+    /// The first cell the marker overlaps; every marker is drawn with its home cell.
+    NODISCARD const CellId *getHomeCell(const InfoMark &marker) const
+    {
+        const auto it = m_entries.find(&marker);
+        return it == m_entries.end() ? nullptr : &it->second.first;
+    }
+
+public:
+    /// Calls callback(InfoMark &) once for each marker whose bounding box overlaps the area.
+    template<typename Callback>
+    void forEachInArea(const Area &area, Callback &&callback) const
+    {
+        const CellId lo = getCell(area.lo.x, area.lo.y, area.z);
+        const CellId hi = getCell(area.hi.x, area.hi.y, area.z);
+        for (int y = lo.y; y <= hi.y; ++y) {
+            const auto beg = m_cells.lower_bound(CellId{area.z, y, lo.x});
+            const auto end = m_cells.upper_bound(CellId{area.z, y, hi.x});
+            for (auto it = beg; it != end; ++it) {
+                const CellId &cell = it->first;
+                for (InfoMark *const marker : it->second) {
+                    const Entry &entry = m_entries.at(marker);
+                    // A marker in several cells is only reported from the first one
+                    // the query shares with it.
+                    if (cell.x != std::max(entry.first.x, lo.x)
+                        || cell.y != std::max(entry.first.y, lo.y))
+                        continue;
+                    if (overlaps(entry.area, area))
+                        callback(*marker);
+                }
+            }
+        }
+    }
+
+    /// Calls callback(InfoMark &) for each marker whose home is the cell.
+    template<typename Callback>
+    void forEachHomedIn(const CellId &cell, Callback &&callback) const
+    {
+        const auto it = m_cells.find(cell);
+        if (it == m_cells.end())
+            return;
+        for (InfoMark *const marker : it->second) {
+            if (m_entries.at(marker).first == cell)
+                callback(*marker);
+        }
+    }
+
+    /// Calls callback(const CellId &) for each cell that's home to at least one marker.
+    template<typename Callback>
+    void forEachHomeCell(Callback &&callback) const
+    {
+        for (const auto &it : m_cells) {
+            const CellId &cell = it.first;
+            const auto &markers = it.second;
+            const bool isHome = std::any_of(markers.begin(),
+                                            markers.end(),
+                                            [this, &cell](const InfoMark *const marker) {
+                                                return m_entries.at(marker).first == cell;
+                                            });
+            if (isHome)
+                callback(cell);
+        }
+    }
+
+private:
+    NODISCARD static bool overlaps(const Area &a, const Area &b)
+    {
+        return a.z == b.z && a.lo.x <= b.hi.x && b.lo.x <= a.hi.x && a.lo.y <= b.hi.y
+               && b.lo.y <= a.hi.y;
+    }
+};
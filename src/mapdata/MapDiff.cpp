@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "MapDiff.h"
+
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+
+#include "../expandoracommon/coordinate.h"
+#include "../expandoracommon/room.h"
+#include "../global/hash.h"
+#include "MapDigest.h"
+
+namespace { // anonymous
+
+struct NODISCARD CoordinateHash final
+{
+    size_t operator()(const Coordinate &c) const noexcept
+    {
+        size_t hash = numeric_hash(c.x);
+        hash = hash * 31u + numeric_hash(c.y);
+        return hash * 31u + numeric_hash(c.z);
+    }
+};
+
+bool isPermanent(const SharedConstRoom &room)
+{
+    return room != nullptr && !room->isTemporary();
+}
+
+class NODISCARD PositionIndex final
+{
+private:
+    // INVALID_ROOMID for positions that hold more than one room
+    std::unordered_map<Coordinate, RoomId, CoordinateHash> m_rooms;
+
+public:
+    explicit PositionIndex(const MapSnapshot &snapshot)
+    {
+        m_rooms.reserve(snapshot.getRooms().size());
+        for (const SharedConstRoom &room : snapshot.getRooms()) {
+            if (!isPermanent(room))
+                continue;
+            const auto [it, inserted] = m_rooms.emplace(room->getPosition(), room->getId());
+            if (!inserted)
+                it->second = INVALID_ROOMID;
+        }
+    }
+
+public:
+    /// Nothing if there's no room at `pos`, and INVALID_ROOMID if there's more than one.
+    NODISCARD std::optional<RoomId> find(const Coordinate &pos) const
+    {
+        const auto it = m_rooms.find(pos);
+        if (it == m_rooms.end())
+            return std::nullopt;
+        return it->second;
+    }
+};
+
+QString describeRoom(const Room &room)
+{
+    const Coordinate &pos = room.getPosition();
+    return QString("'%1' at (%2, %3, %4)")
+        .arg(room.getName().toQString())
+        .arg(pos.x)
+        .arg(pos.y)
+        .arg(pos.z);
+}
+
+} // namespace
+
+MapDiff MapDiff::compute(const MapSnapshot &ours, const MapSnapshot &theirs)
+{
+    const PositionIndex ourIndex{ours};
+    const PositionIndex theirIndex{theirs};
+    MapDiff diff;
+
+    for (const SharedConstRoom &room : theirs.getRooms()) {
+        if (!isPermanent(room))
+            continue;
+        const Coordinate &pos = room->getPosition();
+        if (theirIndex.find(pos) == INVALID_ROOMID) {
+            ++diff.ambiguous;
+            continue;
+        }
+        const std::optional<RoomId> ourId = ourIndex.find(pos);
+        if (!ourId.has_value()) {
+            diff.added.emplace_back(room->getId());
+            continue;
+        }
+        if (ourId.value() == INVALID_ROOMID) {
+            ++diff.ambiguous;
+            continue;
+        }
+        const Match match{ourId.value(), room->getId()};
+        const Room &ourRoom = *ours.getRoom(ourId.value());
+        if (hashRoomStructure(ourRoom, ours) == hashRoomStructure(*room, theirs))
+            diff.unchanged.emplace_back(match);
+        else
+            diff.changed.emplace_back(match);
+    }
+
+    for (const SharedConstRoom &room : ours.getRooms()) {
+        if (!isPermanent(room))
+            continue;
+        const Coordinate &pos = room->getPosition();
+        if (ourIndex.find(pos) == INVALID_ROOMID) {
+            ++diff.ambiguous;
+            continue;
+        }
+        // Rooms at their ambiguous positions were counted above.
+        if (!theirIndex.find(pos).has_value())
+            diff.removed.emplace_back(room->getId());
+    }
+    return diff;
+}
+
+QString MapDiff::describe(const MapSnapshot &ours,
+                          const MapSnapshot &theirs,
+                          const size_t maxRooms) const
+{
+    QString result = QString("%1 room(s) added, %2 changed, %3 only in this map, %4 unchanged, "
+                             "and %5 that share a position and can't be compared.")
+                         .arg(added.size())
+                         .arg(changed.size())
+                         .arg(removed.size())
+                         .arg(unchanged.size())
+                         .arg(ambiguous);
+
+    const auto listRooms = [&result, maxRooms](const QString &kind,
+                                               const MapSnapshot &snapshot,
+                                               const size_t count,
+                                               auto &&getId) {
+        for (size_t i = 0; i < std::min(count, maxRooms); ++i) {
+            if (const Room *const room = snapshot.getRoom(getId(i)))
+                result += QString("\n%1: %2").arg(kind, describeRoom(*room));
+        }
+        if (count > maxRooms)
+            result += QString("\n... and %1 more %2.").arg(count - maxRooms).arg(kind.toLower());
+    };
+    listRooms("Added", theirs, added.size(), [this](const size_t i) { return added[i]; });
+    listRooms("Changed", ours, changed.size(), [this](const size_t i) {
+        return changed[i].ours;
+    });
+    listRooms("Only in this map", ours, removed.size(), [this](const size_t i) {
+        return removed[i];
+    });
+    return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <vector>
+#include <QString>
+
+#include "../global/macros.h"
+#include "../global/roomid.h"
+#include "MapSnapshot.h"
+
+/// How another copy of the same world (e.g. a community map update) differs from ours.
+///
+/// The ids of two maps have nothing in common, so rooms are matched by position, and
+/// compared by hashRoomStructure(), whose exits list where they lead instead of ids. Rooms
+/// that share their position with another room in either map can't be matched, so they're
+/// only counted. Each map is indexed and hashed once, so this takes linear time.
+struct NODISCARD MapDiff final
+{
+    struct NODISCARD Match final
+    {
+        RoomId ours = INVALID_ROOMID;
+        RoomId theirs = INVALID_ROOMID;
+    };
+
+    /// Their rooms at positions where we have none
+    std::vector<RoomId> added;
+    /// Our rooms at positions where they have none
+    std::vector<RoomId> removed;
+    /// Rooms at the same position whose fields or exits differ
+    std::vector<Match> changed;
+    std::vector<Match> unchanged;
+    /// Rooms of either map that are at a position that holds more than one room in either map
+    size_t ambiguous = 0;
+
+    NODISCARD static MapDiff compute(const MapSnapshot &ours, const MapSnapshot &theirs);
+
+    /// The counts, and up to `maxRooms` rooms of each kind with their names and positions.
+    NODISCARD QString describe(const MapSnapshot &ours,
+                               const MapSnapshot &theirs,
+                               size_t maxRooms) const;
+};
@@ -0,0 +1,562 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "MapDigest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "../expandoracommon/exit.h"
+#include "../expandoracommon/room.h"
+#include "../global/TaggedString.h"
+#include "../global/TinyRoomIdSet.h"
+#include "../global/utils.h"
+#include "DoorFlags.h"
+#include "ExitDirection.h"
+#include "ExitFlags.h"
+#include "mmapper2room.h"
+
+namespace { // anonymous
+
+// Bumped whenever encodeRoomContent() or encodeSyncedRooms() changes.
+constexpr const uint32_t SYNC_FORMAT_VERSION = 3;
+
+// FNV-1a, since std::hash differs between standard libraries.
+constexpr const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+constexpr const uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t fnv1a(const char *const data, const size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<uint8_t>(data[i]);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// 0 is kept for rooms and ranges that are empty.
+uint64_t nonZero(const uint64_t hash)
+{
+    return (hash == 0) ? 1 : hash;
+}
+
+uint64_t hashNode(const std::vector<uint64_t> &below, const size_t first)
+{
+    bool empty = true;
+    uint64_t hash = FNV_OFFSET_BASIS;
+    // Children past the end of the level count as empty, so the hashes don't depend on
+    // the size of the levels.
+    for (size_t i = first; i < first + MapDigest::FANOUT; ++i) {
+        const uint64_t child = (i < below.size()) ? below[i] : 0;
+        // Hashed in little-endian order, whatever the platform's.
+        char bytes[8];
+        for (size_t b = 0; b < sizeof(bytes); ++b)
+            bytes[b] = static_cast<char>((child >> (8 * b)) & 0xFFu);
+        hash = fnv1a(bytes, sizeof(bytes), hash);
+        empty = empty && child == 0;
+    }
+    return empty ? 0 : nonZero(hash);
+}
+
+class NODISCARD SyncWriter final
+{
+private:
+    QByteArray m_bytes;
+
+public:
+    void writeVarint(uint64_t value)
+    {
+        while (value >= 0x80u) {
+            m_bytes.append(static_cast<char>((value & 0x7Fu) | 0x80u));
+            value >>= 7;
+        }
+        m_bytes.append(static_cast<char>(value));
+    }
+    void writeSigned(const int32_t value)
+    {
+        const auto u = static_cast<uint32_t>(value);
+        writeVarint((u << 1) ^ (value < 0 ? ~0u : 0u));
+    }
+    void writeBytes(const char *const data, const size_t size)
+    {
+        writeVarint(size);
+        m_bytes.append(data, static_cast<int>(size));
+    }
+
+public:
+    template<typename Tag>
+    void writeField(const TaggedString<Tag> &s)
+    {
+        const std::string &str = s.getStdString();
+        writeBytes(str.data(), str.size());
+    }
+    void writeField(const RoomMobFlags flags) { writeVarint(flags.asUint32()); }
+    void writeField(const RoomLoadFlags flags) { writeVarint(flags.asUint32()); }
+    template<typename E>
+    std::enable_if_t<std::is_enum_v<E>> writeField(const E value)
+    {
+        writeVarint(static_cast<uint32_t>(value));
+    }
+    void writeIds(const TinyRoomIdSet &ids)
+    {
+        writeVarint(ids.size());
+        for (const RoomId id : ids)
+            writeVarint(id.asUint32());
+    }
+
+public:
+    NODISCARD QByteArray getBytes() && { return std::move(m_bytes); }
+};
+
+class NODISCARD SyncReader final
+{
+private:
+    const char *m_pos = nullptr;
+    const char *const m_end = nullptr;
+
+public:
+    explicit SyncReader(const QByteArray &bytes)
+        : m_pos{bytes.constData()}
+        , m_end{bytes.constData() + bytes.size()}
+    {}
+
+public:
+    NODISCARD bool isEmpty() const { return m_pos == m_end; }
+    NODISCARD std::optional<uint64_t> readVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && m_pos != m_end; shift += 7) {
+            const auto byte = static_cast<uint8_t>(*m_pos++);
+            value |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+            if ((byte & 0x80u) == 0)
+                return value;
+        }
+        return std::nullopt;
+    }
+    NODISCARD std::optional<uint32_t> readUint32()
+    {
+        const auto value = readVarint();
+        if (!value.has_value() || value.value() > UINT32_MAX)
+            return std::nullopt;
+        return static_cast<uint32_t>(value.value());
+    }
+    NODISCARD std::optional<int32_t> readSigned()
+    {
+        const auto u = readUint32();
+        if (!u.has_value())
+            return std::nullopt;
+        return static_cast<int32_t>((u.value() >> 1) ^ (0u - (u.value() & 1u)));
+    }
+    NODISCARD std::optional<std::string> readBytes()
+    {
+        const auto length = readVarint();
+        if (!length.has_value() || length.value() > static_cast<uint64_t>(m_end - m_pos))
+            return std::nullopt;
+        const auto size = static_cast<size_t>(length.value());
+        std::string result(m_pos, size);
+        m_pos += size;
+        return result;
+    }
+
+private:
+    template<typename E>
+    NODISCARD bool readEnum(E &out, const int count)
+    {
+        const auto value = readUint32();
+        if (!value.has_value() || value.value() >= static_cast<uint32_t>(count))
+            return false;
+        out = static_cast<E>(value.value());
+        return true;
+    }
+    template<typename FlagsType>
+    NODISCARD bool readFlags(FlagsType &out)
+    {
+        const auto value = readUint32();
+        if (!value.has_value())
+            return false;
+        out = FlagsType{value.value()};
+        return true;
+    }
+
+public:
+    template<typename Tag>
+    NODISCARD bool readField(TaggedString<Tag> &out)
+    {
+        auto str = readBytes();
+        if (!str.has_value())
+            return false;
+        out = TaggedString<Tag>{std::move(str.value())};
+        return true;
+    }
+    NODISCARD bool readField(RoomMobFlags &out) { return readFlags(out); }
+    NODISCARD bool readField(RoomLoadFlags &out) { return readFlags(out); }
+    NODISCARD bool readField(RoomTerrainEnum &out)
+    {
+        return readEnum(out, static_cast<int>(NUM_ROOM_TERRAIN_TYPES));
+    }
+    NODISCARD bool readField(RoomPortableEnum &out) { return readEnum(out, NUM_PORTABLE_TYPES); }
+    NODISCARD bool readField(RoomLightEnum &out) { return readEnum(out, NUM_LIGHT_TYPES); }
+    NODISCARD bool readField(RoomAlignEnum &out) { return readEnum(out, NUM_ALIGN_TYPES); }
+    NODISCARD bool readField(RoomRidableEnum &out) { return readEnum(out, NUM_RIDABLE_TYPES); }
+    NODISCARD bool readField(RoomSundeathEnum &out) { return readEnum(out, NUM_SUNDEATH_TYPES); }
+
+    NODISCARD bool readExit(Exit &out)
+    {
+        auto doorName = readBytes();
+        const auto exitFlags = readUint32();
+        const auto doorFlags = readUint32();
+        if (!doorName.has_value() || !exitFlags.has_value() || !doorFlags.has_value()
+            || exitFlags.value() > UINT16_MAX || doorFlags.value() > UINT16_MAX) {
+            return false;
+        }
+        out.setDoorName(DoorName{std::move(doorName.value())});
+        out.setExitFlags(ExitFlags{static_cast<uint16_t>(exitFlags.value())});
+        out.setDoorFlags(DoorFlags{static_cast<uint16_t>(doorFlags.value())});
+        const auto readIds = [this](auto &&add) -> bool {
+            const auto count = readVarint();
+            if (!count.has_value() || count.value() > static_cast<uint64_t>(m_end - m_pos))
+                return false;
+            for (uint64_t i = 0; i < count.value(); ++i) {
+                const auto id = readUint32();
+                if (!id.has_value())
+                    return false;
+                add(RoomId{id.value()});
+            }
+            return true;
+        };
+        return readIds([&out](const RoomId id) { out.addOut(id); })
+               && readIds([&out](const RoomId id) { out.addIn(id); });
+    }
+};
+
+void writeCoordinate(SyncWriter &writer, const Coordinate &pos)
+{
+    writer.writeSigned(pos.x);
+    writer.writeSigned(pos.y);
+    writer.writeSigned(pos.z);
+}
+
+// Everything but the position, with the exits' ids written by `writeLinks`.
+template<bool WITH_NOTE, typename WriteLinks>
+void writeRoomFields(SyncWriter &writer, const Room &room, WriteLinks &&writeLinks)
+{
+#define X_WRITE(_Type, _Prop, _OptInit) \
+    if constexpr (WITH_NOTE || !std::is_same_v<_Type, RoomNote>) \
+        writer.writeField(room.get##_Prop());
+    XFOREACH_ROOM_PROPERTY(X_WRITE)
+#undef X_WRITE
+    for (const ExitDirEnum dir : ALL_EXITS7) {
+        const Exit &e = room.exit(dir);
+        writer.writeField(e.getDoorName());
+        writer.writeVarint(e.getExitFlags().asUint32());
+        writer.writeVarint(e.getDoorFlags().asUint32());
+        writeLinks(e.getOutgoing());
+        writeLinks(e.getIncoming());
+    }
+}
+
+template<bool WITH_NOTE>
+void writeRoomContent(SyncWriter &writer, const Room &room)
+{
+    writeCoordinate(writer, room.getPosition());
+    writeRoomFields<WITH_NOTE>(writer, room, [&writer](const TinyRoomIdSet &ids) {
+        writer.writeIds(ids);
+    });
+}
+
+bool readRoomContent(SyncReader &reader, MapEditHistory::RoomState &state, const bool withNote)
+{
+    const auto x = reader.readSigned();
+    const auto y = reader.readSigned();
+    const auto z = reader.readSigned();
+    if (!x.has_value() || !y.has_value() || !z.has_value())
+        return false;
+    state.position = Coordinate{x.value(), y.value(), z.value()};
+#define X_READ(_Type, _Prop, _OptInit) \
+    if ((withNote || !std::is_same_v<_Type, RoomNote>) && !reader.readField(state._Prop)) \
+        return false;
+    XFOREACH_ROOM_PROPERTY(X_READ)
+#undef X_READ
+    for (const ExitDirEnum dir : ALL_EXITS7) {
+        if (!reader.readExit(state.exits[dir]))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+MapDigest::MapDigest(this_is_private, SharedMapSnapshot snapshot)
+    : m_snapshot{std::move(snapshot)}
+{}
+
+uint64_t MapDigest::hashRoom(const Room &room)
+{
+    const QByteArray content = encodeRoomContent(room);
+    return nonZero(fnv1a(content.constData(), static_cast<size_t>(content.size())));
+}
+
+SharedMapDigest MapDigest::build(SharedMapSnapshot snapshot,
+                                 const MapDigest *const prev,
+                                 const uint64_t mapIdentity)
+{
+    auto digest = std::make_shared<MapDigest>(this_is_private{0}, std::move(snapshot));
+    const MapSnapshot::RoomTable &rooms = digest->m_snapshot->getRooms();
+    const MapSnapshot::RoomTable *const prevRooms = (prev != nullptr)
+                                                        ? &prev->m_snapshot->getRooms()
+                                                        : nullptr;
+
+    std::vector<uint64_t> &roomHashes = digest->m_levels[ROOM_LEVEL];
+    roomHashes.resize(std::min<size_t>(rooms.size(), MAX_ROOM_IDS), 0);
+    for (size_t i = 0, size = roomHashes.size(); i < size; ++i) {
+        const SharedConstRoom &room = rooms[i];
+        if (room == nullptr || room->isTemporary())
+            continue;
+        // Snapshots share the rooms that didn't change.
+        if (prevRooms != nullptr && i < prevRooms->size() && (*prevRooms)[i] == room) {
+            roomHashes[i] = prev->m_levels[ROOM_LEVEL][i];
+            continue;
+        }
+        roomHashes[i] = hashRoom(*room);
+    }
+
+    for (uint32_t level = ROOM_LEVEL; level > 0; --level) {
+        const std::vector<uint64_t> &below = digest->m_levels[level];
+        std::vector<uint64_t> &above = digest->m_levels[level - 1];
+        above.resize((below.size() + FANOUT - 1) / FANOUT, 0);
+        for (size_t i = 0, size = above.size(); i < size; ++i)
+            above[i] = hashNode(below, i * FANOUT);
+    }
+    digest->m_mapIdentity = (mapIdentity != 0) ? mapIdentity : digest->getHash(0, 0);
+    return digest;
+}
+
+uint64_t MapDigest::getHash(const uint32_t level, const uint32_t index) const
+{
+    if (level >= NUM_LEVELS)
+        return 0;
+    const std::vector<uint64_t> &hashes = m_levels[level];
+    return (index < hashes.size()) ? hashes[index] : 0;
+}
+
+QByteArray encodeRoomContent(const Room &room)
+{
+    SyncWriter writer;
+    writeRoomContent<true>(writer, room);
+    return std::move(writer).getBytes();
+}
+
+QByteArray encodeRoomStructure(const Room &room, const MapSnapshot &snapshot)
+{
+    SyncWriter writer;
+    std::vector<Coordinate> targets;
+    writeRoomFields<false>(writer, room, [&writer, &snapshot, &targets](const TinyRoomIdSet &ids) {
+        targets.clear();
+        for (const RoomId id : ids) {
+            if (const Room *const other = snapshot.getRoom(id))
+                targets.emplace_back(other->getPosition());
+        }
+        // The ids' order has nothing to do with the positions'.
+        std::sort(targets.begin(), targets.end(), [](const Coordinate &a, const Coordinate &b) {
+            return std::tie(a.x, a.y, a.z) < std::tie(b.x, b.y, b.z);
+        });
+        writer.writeVarint(targets.size());
+        for (const Coordinate &pos : targets)
+            writeCoordinate(writer, pos);
+    });
+    return std::move(writer).getBytes();
+}
+
+uint64_t hashRoomStructure(const Room &room, const MapSnapshot &snapshot)
+{
+    const QByteArray structure = encodeRoomStructure(room, snapshot);
+    return nonZero(fnv1a(structure.constData(), static_cast<size_t>(structure.size())));
+}
+
+QByteArray encodeSyncedRooms(const MapDigest &digest,
+                             const std::vector<RoomId> &ids,
+                             const bool withNotes)
+{
+    const MapSnapshot &snapshot = *digest.getSnapshot();
+    SyncWriter writer;
+    writer.writeVarint(SYNC_FORMAT_VERSION);
+    writer.writeVarint(digest.getMapIdentity());
+    writer.writeVarint(withNotes ? 1u : 0u);
+    for (const RoomId id : ids) {
+        const Room *const room = snapshot.getRoom(id);
+        if (room == nullptr || room->isTemporary())
+            continue;
+        writer.writeVarint(id.asUint32());
+        if (withNotes)
+            writeRoomContent<true>(writer, *room);
+        else
+            writeRoomContent<false>(writer, *room);
+    }
+    return std::move(writer).getBytes();
+}
+
+std::optional<SyncedRooms> decodeSyncedRooms(const QByteArray &data)
+{
+    SyncReader reader{data};
+    const auto version = reader.readVarint();
+    if (!version.has_value() || version.value() != SYNC_FORMAT_VERSION)
+        return std::nullopt;
+    const auto mapIdentity = reader.readVarint();
+    const auto hasNotes = reader.readVarint();
+    if (!mapIdentity.has_value() || !hasNotes.has_value() || hasNotes.value() > 1)
+        return std::nullopt;
+
+    SyncedRooms result;
+    result.mapIdentity = mapIdentity.value();
+    result.hasNotes = hasNotes.value() != 0;
+    while (!reader.isEmpty()) {
+        const auto id = reader.readUint32();
+        if (!id.has_value())
+            return std::nullopt;
+        MapEditHistory::RoomState state;
+        state.id = RoomId{id.value()};
+        if (!readRoomContent(reader, state, result.hasNotes))
+            return std::nullopt;
+        result.rooms.emplace_back(std::move(state));
+    }
+    return result;
+}
+
+SyncTarget buildSyncTarget(const RoomIndex &index, const SyncedRooms &synced)
+{
+    const auto findRoom = [&index](const RoomId id) -> const Room * {
+        const SharedRoom *const room = index.tryGet(id);
+        return (room != nullptr) ? room->get() : nullptr;
+    };
+
+    // The synced rooms come first, followed by the rooms at the other ends of their exits.
+    SyncTarget result;
+    MapEditHistory::Snapshot &target = result.rooms;
+    std::unordered_map<RoomId, size_t> indexOf;
+    for (const MapEditHistory::RoomState &state : synced.rooms) {
+        const Room *const room = findRoom(state.id);
+        if (room == nullptr) {
+            ++result.numOnlyThere;
+            continue;
+        }
+        if (!indexOf.emplace(state.id, target.size()).second)
+            continue;
+        target.emplace_back(state);
+        // Notes are the map's own unless the sender shared theirs.
+        if (!synced.hasNotes)
+            target.back().Note = room->getNote();
+    }
+    const size_t numSynced = result.numSynced = target.size();
+    const auto isSynced = [&indexOf, numSynced](const RoomId id) {
+        const auto it = indexOf.find(id);
+        return it != indexOf.end() && it->second < numSynced;
+    };
+
+    // The synced exits are taken as they are, except for those to rooms that this map
+    // doesn't have. What leads into a synced room is worked out again from this map's
+    // rooms, since the sender's rooms around it may not be the same as this map's.
+    for (size_t i = 0; i < numSynced; ++i) {
+        const Room &room = deref(findRoom(target[i].id));
+        for (const ExitDirEnum dir : ALL_EXITS7) {
+            Exit &e = target[i].exits[dir];
+            for (const RoomId to : e.outClone())
+                if (findRoom(to) == nullptr)
+                    e.removeOut(to);
+            for (const RoomId from : e.inClone())
+                e.removeIn(from);
+            for (const RoomId from : room.exit(dir).inRange())
+                if (!isSynced(from))
+                    e.addIn(from);
+        }
+    }
+
+    // The other rooms that synced rooms led to, or lead to now, only keep the incoming
+    // links that the rest of the map gives them.
+    const auto addNeighbour = [&](const RoomId id) {
+        if (!indexOf.emplace(id, target.size()).second)
+            return;
+        MapEditHistory::RoomState state = MapEditHistory::captureRoom(deref(findRoom(id)));
+        for (const ExitDirEnum dir : ALL_EXITS7) {
+            Exit &e = state.exits[dir];
+            for (const RoomId from : e.inClone())
+                if (isSynced(from))
+                    e.removeIn(from);
+        }
+        target.emplace_back(std::move(state));
+    };
+    for (size_t i = 0; i < numSynced; ++i) {
+        const Room &room = deref(findRoom(target[i].id));
+        for (const ExitDirEnum dir : ALL_EXITS7) {
+            for (const RoomId to : room.exit(dir).outRange())
+                if (!isSynced(to) && findRoom(to) != nullptr)
+                    addNeighbour(to);
+            for (const RoomId to : target[i].exits[dir].outClone())
+                if (!isSynced(to))
+                    addNeighbour(to);
+        }
+    }
+
+    // Then every synced exit is entered at its other end.
+    for (size_t i = 0; i < numSynced; ++i) {
+        const RoomId id = target[i].id;
+        for (const ExitDirEnum dir : ALL_EXITS7)
+            for (const RoomId to : target[i].exits[dir].outClone())
+                target[indexOf.at(to)].exits[opposite(dir)].addIn(id);
+    }
+    return result;
+}
+
+QByteArray packMapNodes(const std::vector<uint32_t> &nodes)
+{
+    SyncWriter writer;
+    for (const uint32_t node : nodes)
+        writer.writeVarint(node);
+    return std::move(writer).getBytes();
+}
+
+std::optional<std::vector<uint32_t>> unpackMapNodes(const QByteArray &packed)
+{
+    SyncReader reader{packed};
+    std::vector<uint32_t> result;
+    while (!reader.isEmpty()) {
+        const auto node = reader.readVarint();
+        if (!node.has_value() || node.value() >= MapDigest::MAX_ROOM_IDS)
+            return std::nullopt;
+        result.push_back(static_cast<uint32_t>(node.value()));
+    }
+    return result;
+}
+
+QByteArray packMapHashes(const std::vector<uint64_t> &hashes)
+{
+    QByteArray result;
+    result.reserve(static_cast<int>(hashes.size() * sizeof(uint64_t)));
+    for (const uint64_t hash : hashes) {
+        for (uint32_t i = 0; i < sizeof(uint64_t); ++i)
+            result.append(static_cast<char>((hash >> (8u * i)) & 0xFFu));
+    }
+    return result;
+}
+
+std::optional<std::vector<uint64_t>> unpackMapHashes(const QByteArray &packed)
+{
+    const auto size = static_cast<size_t>(packed.size());
+    if (size % sizeof(uint64_t) != 0)
+        return std::nullopt;
+    std::vector<uint64_t> result;
+    result.reserve(size / sizeof(uint64_t));
+    for (size_t pos = 0; pos < size; pos += sizeof(uint64_t)) {
+        uint64_t hash = 0;
+        for (uint32_t i = 0; i < sizeof(uint64_t); ++i) {
+            const auto byte = static_cast<uint8_t>(packed.at(static_cast<int>(pos + i)));
+            hash |= static_cast<uint64_t>(byte) << (8u * i);
+        }
+        result.push_back(hash);
+    }
+    return result;
+}
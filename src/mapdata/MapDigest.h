@@ -0,0 +1,124 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <QByteArray>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
+#include "MapEditHistory.h"
+#include "MapSnapshot.h"
+
+class MapDigest;
+class Room;
+using SharedMapDigest = std::shared_ptr<const MapDigest>;
+
+/// Hashes of a snapshot's rooms and of the ranges of ids above them (a Merkle tree), so two
+/// copies of a map can find the rooms where they differ by comparing a few hashes at a time:
+/// ranges with equal hashes are equal, so only the ones whose hashes differ are looked into.
+///
+/// Level 0 is one node over every id, each node covers FANOUT nodes of the level below it,
+/// and ROOM_LEVEL is the rooms themselves. Missing rooms and empty ranges hash to 0, so the
+/// hashes don't depend on how many ids either map has. Ids past MAX_ROOM_IDS aren't covered.
+///
+/// A room's hash is that of encodeRoomContent(), without temporary rooms or whether a room
+/// is up to date, and is the same on every platform, so hashes can be compared between peers.
+///
+/// Room ids only mean the same thing in copies of one map, so each digest also carries the
+/// map's identity, which peers compare before anything else (see MapData::getMapIdentity()).
+class NODISCARD MapDigest final
+{
+public:
+    static constexpr const uint32_t FANOUT = 32;
+    static constexpr const uint32_t NUM_LEVELS = 6;
+    static constexpr const uint32_t ROOM_LEVEL = NUM_LEVELS - 1;
+    static constexpr const uint32_t MAX_ROOM_IDS = 1u << 25; // FANOUT to the ROOM_LEVEL
+
+private:
+    struct this_is_private final
+    {
+        explicit this_is_private(int) {}
+    };
+
+private:
+    SharedMapSnapshot m_snapshot;
+    std::array<std::vector<uint64_t>, NUM_LEVELS> m_levels;
+    uint64_t m_mapIdentity = 0;
+
+public:
+    explicit MapDigest(this_is_private, SharedMapSnapshot snapshot);
+    DELETE_CTORS_AND_ASSIGN_OPS(MapDigest);
+
+public:
+    /// Rooms that the snapshot shares with `prev`'s keep their hashes; pass nullptr to hash
+    /// every room. A mapIdentity of 0 stands for the root hash, i.e. the rooms as they are.
+    NODISCARD static SharedMapDigest build(SharedMapSnapshot snapshot,
+                                           const MapDigest *prev,
+                                           uint64_t mapIdentity);
+    NODISCARD static uint64_t hashRoom(const Room &room);
+
+public:
+    NODISCARD uint64_t getGeneration() const { return m_snapshot->getGeneration(); }
+    NODISCARD const SharedMapSnapshot &getSnapshot() const { return m_snapshot; }
+    /// Only 0 for a map without rooms that doesn't have an identity yet.
+    NODISCARD uint64_t getMapIdentity() const { return m_mapIdentity; }
+    /// Returns 0 past the end of the level.
+    NODISCARD uint64_t getHash(uint32_t level, uint32_t index) const;
+};
+
+/// What a room holds that a map file saves, besides its id; MapDigest hashes it.
+NODISCARD QByteArray encodeRoomContent(const Room &room);
+
+/// Like encodeRoomContent(), but for comparing rooms between maps whose ids have nothing in
+/// common: the exits list the positions that they lead to instead of ids, and the position
+/// and the note are left out, since rooms are matched by position and notes are a map's own
+/// annotations (see MapDiff).
+NODISCARD QByteArray encodeRoomStructure(const Room &room, const MapSnapshot &snapshot);
+NODISCARD uint64_t hashRoomStructure(const Room &room, const MapSnapshot &snapshot);
+
+/// The rooms with the given ids from the digest's snapshot, tagged with its map identity, for
+/// decodeSyncedRooms(); ids without a room are left out, and so are the notes unless
+/// `withNotes` is set.
+NODISCARD QByteArray encodeSyncedRooms(const MapDigest &digest,
+                                       const std::vector<RoomId> &ids,
+                                       bool withNotes);
+
+struct NODISCARD SyncedRooms final
+{
+    uint64_t mapIdentity = 0;
+    bool hasNotes = false;
+    std::vector<MapEditHistory::RoomState> rooms;
+};
+
+/// Returns nothing if `data` is malformed. Whether the rooms are up to date isn't sent, so
+/// each state's upToDate is false.
+NODISCARD std::optional<SyncedRooms> decodeSyncedRooms(const QByteArray &data);
+
+struct NODISCARD SyncTarget final
+{
+    /// The synced rooms, then the rooms whose incoming links change with them.
+    MapEditHistory::Snapshot rooms;
+    size_t numSynced = 0;
+    /// Synced rooms that `index` doesn't have; they're left out.
+    size_t numOnlyThere = 0;
+};
+
+/// The states that give the rooms of `index` the synced rooms' contents, for
+/// MapEditHistory::diff(). Only rooms that both maps have are changed: exits to rooms that
+/// `index` doesn't have are dropped, and every exit stays entered at its other end. Without
+/// the sender's notes, each room keeps its own.
+NODISCARD SyncTarget buildSyncTarget(const RoomIndex &index, const SyncedRooms &synced);
+
+/// Node or room ids as varints, and hashes as 8 little-endian bytes each, for the group's
+/// map requests.
+NODISCARD QByteArray packMapNodes(const std::vector<uint32_t> &nodes);
+NODISCARD std::optional<std::vector<uint32_t>> unpackMapNodes(const QByteArray &packed);
+NODISCARD QByteArray packMapHashes(const std::vector<uint64_t> &hashes);
+NODISCARD std::optional<std::vector<uint64_t>> unpackMapHashes(const QByteArray &packed);
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "MapEditHistory.h"
+
+#include <cassert>
+#include <utility>
+#include <variant>
+
+namespace { // anonymous
+
+// Heap memory that isn't counted by sizeof(FieldChange).
+template<typename T>
+auto getExtraBytes(const T &value, int) -> decltype(value.getStdString().size())
+{
+    return value.getStdString().size();
+}
+
+template<typename T>
+size_t getExtraBytes(const T &, long)
+{
+    return 0;
+}
+
+size_t getExtraBytes(const MapEditHistory::ExitChange &change, int)
+{
+    const Exit &e = change.exit;
+    return (e.getIncoming().size() + e.getOutgoing().size()) * sizeof(RoomId);
+}
+
+size_t getExtraBytes(const MapEditHistory::FieldValue &value)
+{
+    return std::visit([](const auto &x) -> size_t { return getExtraBytes(x, 0); }, value);
+}
+
+void addChange(MapEditHistory::RoomDelta &delta,
+               MapEditHistory::FieldValue before,
+               MapEditHistory::FieldValue after)
+{
+    delta.changes.emplace_back(MapEditHistory::FieldChange{std::move(before), std::move(after)});
+}
+
+// Everything but whether the room is up to date.
+void addChanges(MapEditHistory::RoomDelta &delta,
+                const MapEditHistory::RoomState &before,
+                const MapEditHistory::RoomState &after)
+{
+    using ExitChange = MapEditHistory::ExitChange;
+    if (after.position != before.position)
+        addChange(delta, before.position, after.position);
+    for (const ExitDirEnum dir : ALL_EXITS7) {
+        if (after.exits[dir] != before.exits[dir])
+            addChange(delta, ExitChange{dir, before.exits[dir]}, ExitChange{dir, after.exits[dir]});
+    }
+#define DIFF_FIELD(_Type, _Prop, _OptInit) \
+    if (!(after._Prop == before._Prop)) \
+        addChange(delta, before._Prop, after._Prop);
+    XFOREACH_ROOM_PROPERTY(DIFF_FIELD)
+#undef DIFF_FIELD
+}
+
+bool holds(const Room &room, const MapEditHistory::FieldValue &value)
+{
+    if (const auto *const pos = std::get_if<Coordinate>(&value))
+        return room.getPosition() == *pos;
+    if (const auto *const ec = std::get_if<MapEditHistory::ExitChange>(&value))
+        return room.getExitsList()[ec->dir] == ec->exit;
+    if (const auto *const upToDate = std::get_if<MapEditHistory::UpToDate>(&value))
+        return room.isUpToDate() == upToDate->value;
+#define X_CASE(_Type, _Prop, _OptInit) \
+    if (const auto *const field = std::get_if<_Type>(&value)) \
+        return room.get##_Prop() == *field;
+    XFOREACH_ROOM_PROPERTY(X_CASE)
+#undef X_CASE
+    assert(false);
+    return false;
+}
+
+void addDelta(MapEditHistory::Edit &edit, MapEditHistory::RoomDelta &&delta)
+{
+    edit.bytes += sizeof(MapEditHistory::RoomDelta);
+    for (const MapEditHistory::FieldChange &change : delta.changes)
+        edit.bytes += sizeof(MapEditHistory::FieldChange) + getExtraBytes(change.before)
+                      + getExtraBytes(change.after);
+    edit.rooms.emplace_back(std::move(delta));
+}
+
+} // namespace
+
+MapEditHistory::RoomState MapEditHistory::captureRoom(const Room &room)
+{
+    RoomState state;
+    state.id = room.getId();
+    state.position = room.getPosition();
+    state.exits = room.getExitsList();
+    state.upToDate = room.isUpToDate();
+#define COPY_FIELD(_Type, _Prop, _OptInit) state._Prop = room.get##_Prop();
+    XFOREACH_ROOM_PROPERTY(COPY_FIELD)
+#undef COPY_FIELD
+    return state;
+}
+
+MapEditHistory::Snapshot MapEditHistory::capture(const RoomIndex &index, const RoomIdSet &ids)
+{
+    Snapshot result;
+    result.reserve(ids.size());
+    for (const RoomId id : ids) {
+        const SharedRoom *const found = index.tryGet(id);
+        if (found == nullptr || *found == nullptr)
+            continue;
+        result.emplace_back(captureRoom(**found));
+    }
+    return result;
+}
+
+void MapEditHistory::record(const Snapshot &before, const RoomIndex &index)
+{
+    auto edit = std::make_shared<Edit>();
+    for (const RoomState &state : before) {
+        const SharedRoom *const found = index.tryGet(state.id);
+        if (found == nullptr || *found == nullptr) {
+            // The older edits may refer to it.
+            clear();
+            return;
+        }
+        const RoomState after = captureRoom(**found);
+
+        RoomDelta delta;
+        delta.id = state.id;
+        addChanges(delta, state, after);
+        if (after.upToDate != state.upToDate)
+            addChange(delta, UpToDate{state.upToDate}, UpToDate{after.upToDate});
+        if (!delta.changes.empty())
+            addDelta(*edit, std::move(delta));
+    }
+
+    if (edit->rooms.empty())
+        return;
+
+    m_redo.clear();
+    m_undo.emplace_back(std::move(edit));
+    trim();
+}
+
+MapEditHistory::SharedEdit MapEditHistory::diff(const RoomIndex &index, const Snapshot &target)
+{
+    auto edit = std::make_shared<Edit>();
+    for (const RoomState &state : target) {
+        const SharedRoom *const found = index.tryGet(state.id);
+        if (found == nullptr || *found == nullptr)
+            continue;
+        RoomDelta delta;
+        delta.id = state.id;
+        addChanges(delta, captureRoom(**found), state);
+        if (!delta.changes.empty())
+            addDelta(*edit, std::move(delta));
+    }
+    return edit;
+}
+
+bool MapEditHistory::isCurrent(const Edit &edit,
+                               const RoomIndex &index,
+                               const MapEditDirectionEnum direction)
+{
+    const bool undo = direction == MapEditDirectionEnum::UNDO;
+    for (const RoomDelta &delta : edit.rooms) {
+        const SharedRoom *const found = index.tryGet(delta.id);
+        if (found == nullptr || *found == nullptr)
+            return false;
+        for (const FieldChange &change : delta.changes) {
+            if (!holds(**found, undo ? change.after : change.before))
+                return false;
+        }
+    }
+    return true;
+}
+
+void MapEditHistory::onUndone()
+{
+    if (m_undo.empty())
+        return;
+    m_redo.emplace_back(std::move(m_undo.back()));
+    m_undo.pop_back();
+}
+
+void MapEditHistory::onRedone()
+{
+    if (m_redo.empty())
+        return;
+    m_undo.emplace_back(std::move(m_redo.back()));
+    m_redo.pop_back();
+}
+
+void MapEditHistory::clear()
+{
+    m_undo.clear();
+    m_redo.clear();
+}
+
+std::pair<size_t, size_t> MapEditHistory::getMemoryUsage() const
+{
+    size_t bytes = 0;
+    for (const SharedEdit &edit : m_undo)
+        bytes += sizeof(Edit) + edit->bytes;
+    for (const SharedEdit &edit : m_redo)
+        bytes += sizeof(Edit) + edit->bytes;
+    return std::make_pair(m_undo.size() + m_redo.size(), bytes);
+}
+
+void MapEditHistory::trim()
+{
+    // Only called when the redo log is empty.
+    assert(m_redo.empty());
+    size_t bytes = 0;
+    for (const SharedEdit &edit : m_undo)
+        bytes += edit->bytes;
+
+    // Always keeps the newest edit, even if it's larger than MAX_BYTES.
+    while (m_undo.size() > 1 && (m_undo.size() > MAX_EDITS || bytes > MAX_BYTES)) {
+        bytes -= m_undo.front()->bytes;
+        m_undo.pop_front();
+    }
+}
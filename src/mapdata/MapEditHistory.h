@@ -0,0 +1,122 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "../expandoracommon/coordinate.h"
+#include "../expandoracommon/exit.h"
+#include "../expandoracommon/room.h"
+#include "../global/RuleOf5.h"
+#include "../global/roomid.h"
+#include "ExitDirection.h"
+
+enum class NODISCARD MapEditDirectionEnum { UNDO, REDO };
+
+/// The undo and redo logs of the edits made with MapData::execute().
+///
+/// Each edit is kept as the fields that it changed, with their values before and
+/// after, so undoing it only touches the rooms that changed, and unchanged rooms
+/// cost nothing. The oldest edits are forgotten past MAX_EDITS or MAX_BYTES.
+///
+/// Edits that remove rooms (e.g. deleting or merging them) can't be undone, so
+/// they clear the logs.
+class NODISCARD MapEditHistory final
+{
+public:
+    static constexpr const size_t MAX_EDITS = 100;
+    static constexpr const size_t MAX_BYTES = 16u << 20;
+
+public:
+    struct NODISCARD ExitChange final
+    {
+        ExitDirEnum dir = ExitDirEnum::UNKNOWN;
+        Exit exit;
+    };
+    struct NODISCARD UpToDate final
+    {
+        bool value = false;
+    };
+
+#define X_TYPE(_Type, _Prop, _OptInit) , _Type
+    using FieldValue = std::variant<Coordinate, ExitChange, UpToDate XFOREACH_ROOM_PROPERTY(X_TYPE)>;
+#undef X_TYPE
+
+    struct NODISCARD FieldChange final
+    {
+        FieldValue before;
+        FieldValue after;
+    };
+
+    struct NODISCARD RoomDelta final
+    {
+        RoomId id = INVALID_ROOMID;
+        std::vector<FieldChange> changes;
+    };
+
+    struct NODISCARD Edit final
+    {
+        std::vector<RoomDelta> rooms;
+        size_t bytes = 0;
+    };
+    using SharedEdit = std::shared_ptr<const Edit>;
+
+    /// The fields of a room that an edit may change, taken before it runs.
+    struct NODISCARD RoomState final
+    {
+        RoomId id = INVALID_ROOMID;
+        Coordinate position;
+        ExitsList exits;
+        bool upToDate = false;
+#define DECL_FIELD(_Type, _Prop, _OptInit) _Type _Prop _OptInit;
+        XFOREACH_ROOM_PROPERTY(DECL_FIELD)
+#undef DECL_FIELD
+    };
+    using Snapshot = std::vector<RoomState>;
+
+private:
+    std::deque<SharedEdit> m_undo;
+    std::deque<SharedEdit> m_redo;
+
+public:
+    MapEditHistory() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(MapEditHistory);
+
+public:
+    NODISCARD static RoomState captureRoom(const Room &room);
+    NODISCARD static Snapshot capture(const RoomIndex &index, const RoomIdSet &ids);
+
+    /// Compares the rooms to `before`, and logs what changed as a new edit, which
+    /// forgets the redo log; an edit that didn't change anything isn't logged.
+    void record(const Snapshot &before, const RoomIndex &index);
+    /// The edit that would change the rooms to the states in `target`, except for whether
+    /// they're up to date; states of rooms that aren't in the index are left out.
+    NODISCARD static SharedEdit diff(const RoomIndex &index, const Snapshot &target);
+    /// Whether the rooms still hold the values that the edit left (to be undone) or found
+    /// (to be redone). If not, something that isn't logged changed them since.
+    NODISCARD static bool isCurrent(const Edit &edit,
+                                    const RoomIndex &index,
+                                    MapEditDirectionEnum direction);
+
+public:
+    NODISCARD bool canUndo() const { return !m_undo.empty(); }
+    NODISCARD bool canRedo() const { return !m_redo.empty(); }
+    /// The edit that undo() would apply, or nullptr.
+    NODISCARD SharedEdit getUndo() const { return canUndo() ? m_undo.back() : nullptr; }
+    NODISCARD SharedEdit getRedo() const { return canRedo() ? m_redo.back() : nullptr; }
+    /// Moves the edit from getUndo() to the redo log, once it has been undone.
+    void onUndone();
+    /// Moves the edit from getRedo() to the undo log, once it has been redone.
+    void onRedone();
+    void clear();
+    /// The number of edits in both logs, and their estimated size.
+    NODISCARD std::pair<size_t, size_t> getMemoryUsage() const;
+
+private:
+    void trim();
+};
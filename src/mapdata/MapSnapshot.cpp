@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "MapSnapshot.h"
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+MapSnapshot::MapSnapshot(this_is_private,
+                         const uint64_t generation,
+                         MapSnapshot::RoomTable &&rooms)
+    : m_generation{generation}
+    , m_rooms{std::move(rooms)}
+{
+    std::optional<Bounds> bounds;
+    for (const SharedConstRoom &room : m_rooms) {
+        if (room == nullptr)
+            continue;
+        ++m_numRooms;
+        const Coordinate &c = room->getPosition();
+        if (!bounds) {
+            bounds.emplace(c, c);
+            continue;
+        }
+        const auto lo = glm::min(bounds->min.to_ivec3(), c.to_ivec3());
+        const auto hi = glm::max(bounds->max.to_ivec3(), c.to_ivec3());
+        bounds->min = Coordinate{lo.x, lo.y, lo.z};
+        bounds->max = Coordinate{hi.x, hi.y, hi.z};
+    }
+    if (bounds)
+        m_bounds = OptBounds{bounds->min, bounds->max};
+}
+
+MapSnapshot::~MapSnapshot() = default;
+
+RoomModificationTracker &MapSnapshot::getFrozenRoomTracker()
+{
+    // Frozen rooms are only ever exposed as const, so nothing is ever reported here.
+    static RoomModificationTracker tracker;
+    return tracker;
+}
+
+const SharedConstRoom &MapSnapshot::getSharedRoom(const RoomId id) const
+{
+    static const SharedConstRoom none;
+    const auto i = static_cast<size_t>(id.asUint32());
+    return (i < m_rooms.size()) ? m_rooms[i] : none;
+}
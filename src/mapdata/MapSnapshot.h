@@ -0,0 +1,98 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../expandoracommon/coordinate.h"
+#include "../expandoracommon/room.h"
+#include "../global/RuleOf5.h"
+#include "../global/roomid.h"
+
+class MapSnapshot;
+using SharedMapSnapshot = std::shared_ptr<const MapSnapshot>;
+
+/// An immutable, versioned copy of the room table.
+///
+/// Holding a snapshot requires no lock: its rooms are frozen clones that are
+/// never modified, so it can be read from worker threads while the live map
+/// keeps changing. Rooms that did not change between two generations are
+/// shared with the previous snapshot, so taking a new one only clones the
+/// rooms that were touched in the meantime.
+///
+/// Use MapData::getSnapshot() to obtain one.
+class NODISCARD MapSnapshot final
+{
+public:
+    using RoomTable = std::vector<SharedConstRoom>;
+
+private:
+    struct this_is_private final
+    {
+        explicit this_is_private(int) {}
+    };
+
+private:
+    uint64_t m_generation = 0;
+    RoomTable m_rooms;
+    size_t m_numRooms = 0;
+    OptBounds m_bounds;
+
+public:
+    explicit MapSnapshot(this_is_private, uint64_t generation, RoomTable &&rooms);
+    ~MapSnapshot();
+    DELETE_CTORS_AND_ASSIGN_OPS(MapSnapshot);
+
+public:
+    /// Builds the snapshot for `generation` from the live table, reusing the
+    /// frozen rooms of `prev` except for the ids flagged in `isDirty`.
+    /// Pass `prev == nullptr` to clone everything.
+    template<typename IsDirty>
+    NODISCARD static SharedMapSnapshot build(uint64_t generation,
+                                             const RoomIndex &live,
+                                             const MapSnapshot *prev,
+                                             IsDirty &&isDirty)
+    {
+        RoomTable rooms;
+        rooms.resize(live.size());
+        for (size_t i = 0, size = live.size(); i < size; ++i) {
+            const RoomId id{static_cast<uint32_t>(i)};
+            const SharedRoom &room = live[id];
+            if (room == nullptr)
+                continue;
+            if (prev != nullptr && !isDirty(id)) {
+                if (const SharedConstRoom &old = prev->getSharedRoom(id)) {
+                    rooms[i] = old;
+                    continue;
+                }
+            }
+            rooms[i] = room->cloneFrozen(getFrozenRoomTracker());
+        }
+        return std::make_shared<const MapSnapshot>(this_is_private{0}, generation, std::move(rooms));
+    }
+
+private:
+    static RoomModificationTracker &getFrozenRoomTracker();
+    NODISCARD const SharedConstRoom &getSharedRoom(RoomId id) const;
+
+public:
+    NODISCARD uint64_t getGeneration() const { return m_generation; }
+    NODISCARD size_t getNumRooms() const { return m_numRooms; }
+    NODISCARD bool isEmpty() const { return m_numRooms == 0; }
+    NODISCARD const OptBounds &getBounds() const { return m_bounds; }
+
+    /// The table is indexed by RoomId; unused ids are nullptr.
+    NODISCARD const RoomTable &getRooms() const { return m_rooms; }
+    NODISCARD const Room *getRoom(RoomId id) const { return getSharedRoom(id).get(); }
+
+    template<typename Callback>
+    void forEach(Callback &&callback) const
+    {
+        for (const SharedConstRoom &room : m_rooms) {
+            if (room != nullptr)
+                callback(*room);
+        }
+    }
+};
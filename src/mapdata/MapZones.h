@@ -0,0 +1,32 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "../expandoracommon/coordinate.h"
+
+namespace zones {
+
+// Split the world into 20x20 zones.
+// NOTE: The web map export shares this tiling with its JS code.
+static constexpr const int ZONE_WIDTH = 20;
+
+/// Rounds n down to the lower bound of its zone, also for negative n.
+static constexpr int calcZoneCoord(const int n)
+{
+    const auto f = [](const int x) -> int { return (x / ZONE_WIDTH) * ZONE_WIDTH; };
+    return f((n < 0) ? (n + 1 - ZONE_WIDTH) : n);
+}
+static_assert(calcZoneCoord(-ZONE_WIDTH - 1) == -2 * ZONE_WIDTH);
+static_assert(calcZoneCoord(-ZONE_WIDTH) == -ZONE_WIDTH);
+static_assert(calcZoneCoord(-1) == -ZONE_WIDTH);
+static_assert(calcZoneCoord(0) == 0);
+static_assert(calcZoneCoord(ZONE_WIDTH - 1) == 0);
+static_assert(calcZoneCoord(ZONE_WIDTH) == ZONE_WIDTH);
+
+/// Zones span every layer; the JSON export flips the y axis.
+static inline Coordinate2i getZoneOrigin(const Coordinate &c)
+{
+    return Coordinate2i{calcZoneCoord(c.x), calcZoneCoord(-c.y)};
+}
+
+} // namespace zones
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "RoomTextIndex.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "../expandoracommon/exit.h"
+#include "../expandoracommon/room.h"
+#include "MapSnapshot.h"
+
+static void indexField(std::unordered_map<uint32_t, RoomTextIndex::Postings> &table,
+                       const std::string_view &text,
+                       const uint32_t id)
+{
+    RoomTextIndex::forEachTrigram(text, [&table, id](const uint32_t trigram) {
+        // Rooms are added in id order, so each list stays sorted and a
+        // repeated trigram is always a repeat of the last entry.
+        auto &postings = table[trigram];
+        if (postings.empty() || postings.back() != id)
+            postings.push_back(id);
+    });
+}
+
+RoomTextIndex::RoomTextIndex(this_is_private, const MapSnapshot &snapshot)
+{
+    const auto &rooms = snapshot.getRooms();
+    for (size_t i = 0, size = rooms.size(); i < size; ++i) {
+        const Room *const room = rooms[i].get();
+        if (room == nullptr)
+            continue;
+        const auto id = static_cast<uint32_t>(i);
+        indexField(m_names, room->getName().getStdString(), id);
+        indexField(m_descs, room->getStaticDescription().getStdString(), id);
+        indexField(m_dynDescs, room->getDynamicDescription().getStdString(), id);
+        indexField(m_notes, room->getNote().getStdString(), id);
+        for (const Exit &e : room->getExitsList()) {
+            indexField(m_doorNames, e.getDoorName().getStdString(), id);
+        }
+    }
+}
+
+RoomTextIndex::~RoomTextIndex() = default;
+
+SharedRoomTextIndex RoomTextIndex::build(const MapSnapshot &snapshot)
+{
+    return std::make_shared<const RoomTextIndex>(this_is_private{0}, snapshot);
+}
+
+std::optional<RoomTextIndex::Postings> RoomTextIndex::getCandidates(const RoomFilter &filter) const
+{
+    const Table *const table = [this, &filter]() -> const Table * {
+        switch (filter.patternKind()) {
+        case PatternKindsEnum::NAME:
+            return &m_names;
+        case PatternKindsEnum::DESC:
+            return &m_descs;
+        case PatternKindsEnum::DYN_DESC:
+            return &m_dynDescs;
+        case PatternKindsEnum::NOTE:
+            return &m_notes;
+        case PatternKindsEnum::EXITS:
+            return &m_doorNames;
+        case PatternKindsEnum::NONE:
+        case PatternKindsEnum::FLAGS:
+        case PatternKindsEnum::ALL:
+            // Flags match against command names rather than room text, and ALL includes them.
+            break;
+        }
+        return nullptr;
+    }();
+    if (table == nullptr)
+        return std::nullopt;
+
+    std::vector<const Postings *> lists;
+    bool missing = false;
+    forEachTrigram(filter.getPattern(), [table, &lists, &missing](const uint32_t trigram) {
+        const auto it = table->find(trigram);
+        if (it == table->end())
+            missing = true;
+        else
+            lists.push_back(&it->second);
+    });
+    if (missing)
+        return Postings{};
+    if (lists.empty())
+        return std::nullopt;
+
+    // Intersect the shortest lists first.
+    std::sort(lists.begin(), lists.end(), [](const Postings *a, const Postings *b) {
+        return std::make_pair(a->size(), a) < std::make_pair(b->size(), b);
+    });
+    lists.erase(std::unique(lists.begin(), lists.end()), lists.end());
+    Postings result = *lists.front();
+    Postings next;
+    for (size_t i = 1; i < lists.size() && !result.empty(); ++i) {
+        next.clear();
+        std::set_intersection(result.begin(),
+                              result.end(),
+                              lists[i]->begin(),
+                              lists[i]->end(),
+                              std::back_inserter(next));
+        result.swap(next);
+    }
+    return result;
+}
@@ -0,0 +1,81 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
+#include "roomfilter.h"
+
+class MapSnapshot;
+class RoomTextIndex;
+using SharedRoomTextIndex = std::shared_ptr<const RoomTextIndex>;
+
+/// Trigram index over every free-text room field: names, static and dynamic
+/// descriptions, notes and door names.
+///
+/// RoomFilter matches substrings, so a plain word index can't answer it; but a
+/// room can only contain the pattern if it contains every three-character
+/// window of it. Looking up those windows narrows a search to a few candidates
+/// that are then checked with RoomFilter::filter() as usual.
+///
+/// Trigrams are folded to lower case and only cover ASCII text, so the index
+/// never rules out a room that the filter would accept, case-insensitive or not.
+class NODISCARD RoomTextIndex final
+{
+public:
+    using Postings = std::vector<uint32_t>;
+
+private:
+    struct this_is_private final
+    {
+        explicit this_is_private(int) {}
+    };
+    using Table = std::unordered_map<uint32_t, Postings>;
+
+private:
+    Table m_names;
+    Table m_descs;
+    Table m_dynDescs;
+    Table m_notes;
+    Table m_doorNames;
+
+public:
+    explicit RoomTextIndex(this_is_private, const MapSnapshot &snapshot);
+    ~RoomTextIndex();
+    DELETE_CTORS_AND_ASSIGN_OPS(RoomTextIndex);
+
+public:
+    NODISCARD static SharedRoomTextIndex build(const MapSnapshot &snapshot);
+
+    /// Returns the sorted ids of every room the filter could match, or nothing
+    /// if this kind of filter or too short a pattern can't be narrowed down.
+    NODISCARD std::optional<Postings> getCandidates(const RoomFilter &filter) const;
+
+public:
+    /// Calls callback(trigram) for every indexable trigram of s, with repeats.
+    template<typename Callback>
+    static void forEachTrigram(const std::string_view &s, Callback &&callback)
+    {
+        uint32_t window = 0;
+        uint32_t valid = 0;
+        for (const char c : s) {
+            const auto uc = static_cast<unsigned char>(c);
+            if (uc >= 0x80u) {
+                valid = 0;
+                continue;
+            }
+            const auto folded = static_cast<uint32_t>((uc >= 'A' && uc <= 'Z') ? (uc + 32u) : uc);
+            window = ((window << 8) | folded) & 0xFFFFFFu;
+            if (++valid >= 3)
+                callback(window);
+        }
+    }
+};
@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "RoutingGraph.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "../expandoracommon/exit.h"
+#include "../expandoracommon/room.h"
+#include "../global/enums.h"
+#include "MapSnapshot.h"
+
+RoutingGraph::RoutingGraph(this_is_private,
+                           const MapSnapshot &snapshot,
+                           const RoutingProfileEnum profile)
+    : m_profile{profile}
+    , m_minStepCost{getRoutingCosts(profile).getMinStepCost()}
+{
+    const RoutingCosts &costs = getRoutingCosts(profile);
+    const auto &rooms = snapshot.getRooms();
+    const size_t numNodes = rooms.size();
+    m_offsets.reserve(numNodes + 1u);
+    m_positions.resize(numNodes);
+    m_present.resize(numNodes, false);
+
+    for (size_t i = 0; i < numNodes; ++i) {
+        m_offsets.push_back(static_cast<uint32_t>(m_edges.size()));
+        const Room *const room = rooms[i].get();
+        if (room == nullptr)
+            continue;
+        m_present[i] = true;
+        m_positions[i] = room->getPosition();
+
+        const ExitsList &exits = room->getExitsList();
+        for (const ExitDirEnum dir : enums::makeCountingIterator<ExitDirEnum>(exits)) {
+            const Exit &e = exits[dir];
+            if (!e.outIsUnique()) {
+                // 0: Not mapped
+                // 2+: Random, so no clear directions; skip it.
+                continue;
+            }
+            if (!e.isExit()) {
+                continue;
+            }
+            const RoomId to = e.outFirst();
+            const Room *const nextr = snapshot.getRoom(to);
+            if (nextr == nullptr) {
+                continue;
+            }
+            m_edges.emplace_back(Edge{to.asUint32(), dir, costs.getCost(e, *room, *nextr)});
+            m_maxStepDistance = std::max(m_maxStepDistance,
+                                         room->getPosition().distance(nextr->getPosition()));
+        }
+    }
+    m_offsets.push_back(static_cast<uint32_t>(m_edges.size()));
+    m_edges.shrink_to_fit();
+
+    // Reverse adjacency from the same edges, so one-way exits and the exit
+    // penalties look the same from both ends.
+    m_reverseOffsets.assign(numNodes + 1u, 0);
+    for (const Edge &e : m_edges)
+        ++m_reverseOffsets[e.to + 1u];
+    for (size_t i = 1; i <= numNodes; ++i)
+        m_reverseOffsets[i] += m_reverseOffsets[i - 1];
+    m_reverseEdges.resize(m_edges.size());
+    std::vector<uint32_t> fill(m_reverseOffsets.begin(), m_reverseOffsets.end() - 1);
+    for (uint32_t from = 0; from < numNodes; ++from) {
+        for (uint32_t i = m_offsets[from]; i < m_offsets[from + 1u]; ++i) {
+            const Edge &e = m_edges[i];
+            m_reverseEdges[fill[e.to]++] = Edge{from, e.dir, e.cost};
+        }
+    }
+}
+
+RoutingGraph::~RoutingGraph() = default;
+
+SharedRoutingGraph RoutingGraph::build(const MapSnapshot &snapshot,
+                                       const RoutingProfileEnum profile)
+{
+    return std::make_shared<const RoutingGraph>(this_is_private{0}, snapshot, profile);
+}
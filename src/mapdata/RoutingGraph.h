@@ -0,0 +1,111 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../expandoracommon/coordinate.h"
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
+#include "ExitDirection.h"
+#include "RoutingProfile.h"
+
+class MapSnapshot;
+class RoutingGraph;
+using SharedRoutingGraph = std::shared_ptr<const RoutingGraph>;
+
+/// Compressed-sparse-row adjacency of every routable exit in a MapSnapshot.
+///
+/// Nodes are indexed by RoomId, and each node's outgoing edges are stored
+/// contiguously with their movement cost under one RoutingProfileEnum already
+/// computed, so a search never touches the rooms themselves until it reports a
+/// path. Only exits with a single mapped destination are included.
+///
+/// Use MapData::getRoutingGraph() to obtain one.
+class NODISCARD RoutingGraph final
+{
+public:
+    struct Edge final
+    {
+        uint32_t to = 0;
+        ExitDirEnum dir = ExitDirEnum::NONE;
+        double cost = 0.0;
+    };
+
+    /// One room along a reported route.
+    struct Step final
+    {
+        RoomId room = INVALID_ROOMID;
+        ExitDirEnum dir = ExitDirEnum::NONE;
+        /// Total cost from the origin up to and including this step.
+        double dist = 0.0;
+    };
+
+private:
+    struct this_is_private final
+    {
+        explicit this_is_private(int) {}
+    };
+
+private:
+    std::vector<uint32_t> m_offsets;
+    std::vector<Edge> m_edges;
+    // Incoming edges; Edge::to is the room the exit starts from.
+    std::vector<uint32_t> m_reverseOffsets;
+    std::vector<Edge> m_reverseEdges;
+    std::vector<Coordinate> m_positions;
+    std::vector<bool> m_present;
+    RoutingProfileEnum m_profile = RoutingProfileEnum::MOUNTED;
+    double m_minStepCost = 0.0;
+    int m_maxStepDistance = 1;
+
+public:
+    explicit RoutingGraph(this_is_private, const MapSnapshot &snapshot, RoutingProfileEnum profile);
+    ~RoutingGraph();
+    DELETE_CTORS_AND_ASSIGN_OPS(RoutingGraph);
+
+public:
+    NODISCARD static SharedRoutingGraph build(const MapSnapshot &snapshot,
+                                              RoutingProfileEnum profile);
+
+public:
+    NODISCARD RoutingProfileEnum getProfile() const { return m_profile; }
+    /// Lower bound on the cost of any single edge, for scaling A* heuristics.
+    NODISCARD double getMinStepCost() const { return m_minStepCost; }
+    /// The largest Manhattan distance any single edge covers (at least 1), so
+    /// getMinStepCost() / getMaxStepDistance() per cell never overestimates.
+    NODISCARD int getMaxStepDistance() const { return m_maxStepDistance; }
+
+public:
+    /// One past the largest RoomId; suitable for sizing per-node arrays.
+    NODISCARD size_t getNumNodes() const { return m_present.size(); }
+    NODISCARD bool contains(const RoomId id) const
+    {
+        const auto i = static_cast<size_t>(id.asUint32());
+        return i < m_present.size() && m_present[i];
+    }
+    NODISCARD const Coordinate &getPosition(const RoomId id) const
+    {
+        return m_positions[id.asUint32()];
+    }
+    NODISCARD const Edge *edgesBegin(const RoomId id) const
+    {
+        return m_edges.data() + m_offsets[id.asUint32()];
+    }
+    NODISCARD const Edge *edgesEnd(const RoomId id) const
+    {
+        return m_edges.data() + m_offsets[id.asUint32() + 1u];
+    }
+    /// The same edges as seen from their destination, with the same costs.
+    NODISCARD const Edge *reverseEdgesBegin(const RoomId id) const
+    {
+        return m_reverseEdges.data() + m_reverseOffsets[id.asUint32()];
+    }
+    NODISCARD const Edge *reverseEdgesEnd(const RoomId id) const
+    {
+        return m_reverseEdges.data() + m_reverseOffsets[id.asUint32() + 1u];
+    }
+};
@@ -0,0 +1,357 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "RoutingHierarchy.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include "../global/utils.h"
+#include "MapZones.h"
+
+namespace {
+static constexpr const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+static constexpr const double INF = std::numeric_limits<double>::infinity();
+static constexpr const uint32_t CANCEL_POLL_INTERVAL = 1024;
+
+struct NODISCARD Label final
+{
+    double dist = 0.0;
+    // Forward searches: the room this one was reached from.
+    // Reverse searches: the next room towards the target.
+    uint32_t link = NONE;
+    ExitDirEnum dir = ExitDirEnum::NONE;
+};
+using LabelMap = std::unordered_map<uint32_t, Label>;
+
+using EdgeRange = std::pair<const RoutingGraph::Edge *, const RoutingGraph::Edge *>;
+
+/// Dijkstra from `source` that never leaves its zone. For reverse searches
+/// `getEdges` yields incoming edges, so each label's link points downstream.
+/// Stops early once `stopAt` has been settled.
+template<typename GetEdges>
+NODISCARD LabelMap searchZone(const uint32_t source,
+                              const std::vector<uint32_t> &zoneOf,
+                              GetEdges &&getEdges,
+                              const uint32_t stopAt = NONE)
+{
+    const uint32_t zone = zoneOf[source];
+    LabelMap labels;
+    labels.emplace(source, Label{0.0, NONE, ExitDirEnum::NONE});
+    using Entry = std::pair<double, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    queue.emplace(0.0, source);
+    while (!queue.empty()) {
+        const auto [dist, room] = queue.top();
+        queue.pop();
+        if (dist > labels[room].dist)
+            continue;
+        if (room == stopAt)
+            break;
+        const EdgeRange range = getEdges(room);
+        for (auto e = range.first; e != range.second; ++e) {
+            if (zoneOf[e->to] != zone)
+                continue;
+            const double next = dist + e->cost;
+            const auto it = labels.find(e->to);
+            if (it != labels.end() && it->second.dist <= next)
+                continue;
+            labels[e->to] = Label{next, room, e->dir};
+            queue.emplace(next, e->to);
+        }
+    }
+    return labels;
+}
+
+NODISCARD uint64_t mixHash(uint64_t hash, const uint64_t value)
+{
+    // FNV-1a over the 8 bytes of value.
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (i * 8)) & 0xFFu;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+NODISCARD uint64_t doubleBits(const double d)
+{
+    uint64_t bits = 0;
+    static_assert(sizeof(bits) == sizeof(d));
+    std::memcpy(&bits, &d, sizeof(bits));
+    return bits;
+}
+} // namespace
+
+struct RoutingHierarchy::ZoneTable final
+{
+    uint64_t signature = 0;
+    std::vector<uint32_t> entrances;
+    std::vector<uint32_t> exits;
+    /// entrances.size() rows of exits.size() distances; INF if unreachable.
+    std::vector<double> dist;
+};
+
+RoutingHierarchy::RoutingHierarchy(this_is_private,
+                                   SharedRoutingGraph moved_graph,
+                                   const RoutingHierarchy *const prev)
+    : m_graph{std::move(moved_graph)}
+{
+    const RoutingGraph &graph = deref(m_graph);
+    const size_t numRooms = graph.getNumNodes();
+    const auto forward = [&graph](const uint32_t room) -> EdgeRange {
+        return {graph.edgesBegin(RoomId{room}), graph.edgesEnd(RoomId{room})};
+    };
+
+    // Assign every room to its zone.
+    m_zoneOf.assign(numRooms, NONE);
+    for (uint32_t room = 0; room < numRooms; ++room) {
+        if (!graph.contains(RoomId{room}))
+            continue;
+        const Coordinate2i origin = zones::getZoneOrigin(graph.getPosition(RoomId{room}));
+        const ZoneKey key{origin.x, origin.y};
+        const auto [it, inserted] = m_zoneIndex.emplace(key, static_cast<uint32_t>(m_zones.size()));
+        if (inserted) {
+            m_zones.emplace_back();
+            m_zones.back().key = key;
+        }
+        m_zoneOf[room] = it->second;
+        m_zones[it->second].rooms.push_back(room);
+    }
+
+    // Find each zone's portals and reuse or compute its distance table.
+    for (Zone &zone : m_zones) {
+        const uint32_t self = m_zoneOf[zone.rooms.front()];
+        auto table = std::make_shared<ZoneTable>();
+        uint64_t signature = 14695981039346656037ull;
+        for (const uint32_t room : zone.rooms) {
+            signature = mixHash(signature, room);
+            bool isExit = false;
+            const auto [begin, end] = forward(room);
+            for (auto e = begin; e != end; ++e) {
+                if (m_zoneOf[e->to] != self) {
+                    isExit = true;
+                    continue;
+                }
+                signature = mixHash(signature, e->to);
+                signature = mixHash(signature, static_cast<uint64_t>(e->dir));
+                signature = mixHash(signature, doubleBits(e->cost));
+            }
+            const bool isEntrance = std::any_of(graph.reverseEdgesBegin(RoomId{room}),
+                                                graph.reverseEdgesEnd(RoomId{room}),
+                                                [this, self](const RoutingGraph::Edge &e) {
+                                                    return m_zoneOf[e.to] != self;
+                                                });
+            if (isEntrance)
+                table->entrances.push_back(room);
+            if (isExit)
+                table->exits.push_back(room);
+        }
+        table->signature = signature;
+
+        if (prev != nullptr) {
+            if (const Zone *const old = prev->findZone(zone.key)) {
+                const ZoneTable &o = deref(old->table);
+                if (o.signature == signature && o.entrances == table->entrances
+                    && o.exits == table->exits) {
+                    zone.table = old->table;
+                    continue;
+                }
+            }
+        }
+
+        table->dist.assign(table->entrances.size() * table->exits.size(), INF);
+        for (size_t i = 0; i < table->entrances.size(); ++i) {
+            const LabelMap labels = searchZone(table->entrances[i], m_zoneOf, forward);
+            for (size_t j = 0; j < table->exits.size(); ++j) {
+                const auto it = labels.find(table->exits[j]);
+                if (it != labels.end())
+                    table->dist[i * table->exits.size() + j] = it->second.dist;
+            }
+        }
+        zone.table = std::move(table);
+    }
+
+    // Portal graph: through-zone paths from entrances to exits, plus the
+    // exits that cross into another zone.
+    m_portalOf.assign(numRooms, NONE);
+    const auto getPortal = [this](const uint32_t room) -> uint32_t {
+        uint32_t &portal = m_portalOf[room];
+        if (portal == NONE) {
+            portal = static_cast<uint32_t>(m_portalRoom.size());
+            m_portalRoom.push_back(room);
+        }
+        return portal;
+    };
+    for (const Zone &zone : m_zones) {
+        for (const uint32_t room : zone.table->entrances)
+            getPortal(room);
+        for (const uint32_t room : zone.table->exits)
+            getPortal(room);
+    }
+
+    std::vector<std::vector<PortalEdge>> edges(m_portalRoom.size());
+    for (const Zone &zone : m_zones) {
+        const ZoneTable &table = *zone.table;
+        for (size_t i = 0; i < table.entrances.size(); ++i) {
+            const uint32_t from = m_portalOf[table.entrances[i]];
+            for (size_t j = 0; j < table.exits.size(); ++j) {
+                const double dist = table.dist[i * table.exits.size() + j];
+                const uint32_t to = m_portalOf[table.exits[j]];
+                if (from != to && dist != INF)
+                    edges[from].emplace_back(PortalEdge{to, ExitDirEnum::NONE, dist});
+            }
+        }
+        for (const uint32_t room : table.exits) {
+            const auto [begin, end] = forward(room);
+            for (auto e = begin; e != end; ++e) {
+                if (m_zoneOf[e->to] != m_zoneOf[room])
+                    edges[m_portalOf[room]].emplace_back(
+                        PortalEdge{m_portalOf[e->to], e->dir, e->cost});
+            }
+        }
+    }
+    m_portalOffsets.reserve(edges.size() + 1u);
+    for (const auto &list : edges) {
+        m_portalOffsets.push_back(static_cast<uint32_t>(m_portalEdges.size()));
+        m_portalEdges.insert(m_portalEdges.end(), list.begin(), list.end());
+    }
+    m_portalOffsets.push_back(static_cast<uint32_t>(m_portalEdges.size()));
+}
+
+RoutingHierarchy::~RoutingHierarchy() = default;
+
+SharedRoutingHierarchy RoutingHierarchy::build(SharedRoutingGraph graph,
+                                               const RoutingHierarchy *const prev)
+{
+    return std::make_shared<const RoutingHierarchy>(this_is_private{0}, std::move(graph), prev);
+}
+
+const RoutingHierarchy::Zone *RoutingHierarchy::findZone(const ZoneKey &key) const
+{
+    const auto it = m_zoneIndex.find(key);
+    return (it == m_zoneIndex.end()) ? nullptr : &m_zones[it->second];
+}
+
+std::optional<std::vector<RoutingHierarchy::Step>> RoutingHierarchy::findPath(
+    const RoomId fromId, const RoomId toId, const std::function<bool()> &isCancelled) const
+{
+    const RoutingGraph &graph = *m_graph;
+    if (!graph.contains(fromId) || !graph.contains(toId))
+        return std::nullopt;
+    const uint32_t from = fromId.asUint32();
+    const uint32_t to = toId.asUint32();
+    if (from == to)
+        return std::vector<Step>{};
+
+    const auto forward = [&graph](const uint32_t room) -> EdgeRange {
+        return {graph.edgesBegin(RoomId{room}), graph.edgesEnd(RoomId{room})};
+    };
+    const auto reverse = [&graph](const uint32_t room) -> EdgeRange {
+        return {graph.reverseEdgesBegin(RoomId{room}), graph.reverseEdgesEnd(RoomId{room})};
+    };
+
+    const uint32_t startZone = m_zoneOf[from];
+    const uint32_t goalZone = m_zoneOf[to];
+    const LabelMap head = searchZone(from, m_zoneOf, forward);
+    const LabelMap tail = searchZone(to, m_zoneOf, reverse);
+
+    // Routes that never leave the zone are only possible if both ends share it.
+    double best = INF;
+    uint32_t bestPortal = NONE;
+    if (startZone == goalZone) {
+        if (const auto it = head.find(to); it != head.end())
+            best = it->second.dist;
+    }
+
+    // Portal-level Dijkstra, seeded with the start zone's exits.
+    const size_t numPortals = m_portalRoom.size();
+    std::vector<double> dist(numPortals, INF);
+    std::vector<uint32_t> prevPortal(numPortals, NONE);
+    std::vector<uint32_t> prevEdge(numPortals, NONE);
+    using Entry = std::pair<double, uint32_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (const uint32_t room : m_zones[startZone].table->exits) {
+        const auto it = head.find(room);
+        if (it == head.end())
+            continue;
+        const uint32_t portal = m_portalOf[room];
+        dist[portal] = it->second.dist;
+        queue.emplace(it->second.dist, portal);
+    }
+    uint32_t expanded = 0;
+    while (!queue.empty()) {
+        if (isCancelled && ++expanded % CANCEL_POLL_INTERVAL == 0 && isCancelled())
+            return std::nullopt;
+        const auto [d, portal] = queue.top();
+        queue.pop();
+        if (d > dist[portal])
+            continue;
+        if (d >= best)
+            break;
+        const uint32_t room = m_portalRoom[portal];
+        if (m_zoneOf[room] == goalZone) {
+            if (const auto it = tail.find(room); it != tail.end() && d + it->second.dist < best) {
+                best = d + it->second.dist;
+                bestPortal = portal;
+            }
+        }
+        for (uint32_t i = m_portalOffsets[portal]; i < m_portalOffsets[portal + 1u]; ++i) {
+            const PortalEdge &e = m_portalEdges[i];
+            const double next = d + e.cost;
+            if (next < dist[e.to]) {
+                dist[e.to] = next;
+                prevPortal[e.to] = portal;
+                prevEdge[e.to] = i;
+                queue.emplace(next, e.to);
+            }
+        }
+    }
+    if (best == INF)
+        return std::nullopt;
+
+    std::vector<Step> steps;
+    // Appends the forward label chain that ends at `last`, excluding its root.
+    const auto appendChain = [&steps](const LabelMap &labels, const uint32_t last, const double base) {
+        std::vector<Step> chain;
+        for (uint32_t room = last;;) {
+            const Label &label = labels.at(room);
+            if (label.link == NONE)
+                break;
+            chain.push_back(Step{RoomId{room}, label.dir, base + label.dist});
+            room = label.link;
+        }
+        steps.insert(steps.end(), chain.rbegin(), chain.rend());
+    };
+
+    if (bestPortal == NONE) {
+        appendChain(head, to, 0.0);
+        return steps;
+    }
+
+    std::vector<uint32_t> portals;
+    for (uint32_t p = bestPortal; p != NONE; p = prevPortal[p])
+        portals.push_back(p);
+    std::reverse(portals.begin(), portals.end());
+
+    appendChain(head, m_portalRoom[portals.front()], 0.0);
+    for (size_t i = 1; i < portals.size(); ++i) {
+        const uint32_t portal = portals[i];
+        const PortalEdge &e = m_portalEdges[prevEdge[portal]];
+        const uint32_t room = m_portalRoom[portal];
+        if (e.dir != ExitDirEnum::NONE) {
+            steps.push_back(Step{RoomId{room}, e.dir, dist[portal]});
+            continue;
+        }
+        const uint32_t start = m_portalRoom[portals[i - 1]];
+        appendChain(searchZone(start, m_zoneOf, forward, room), room, dist[portals[i - 1]]);
+    }
+    for (uint32_t room = m_portalRoom[bestPortal]; room != to;) {
+        const Label &label = tail.at(room);
+        steps.push_back(Step{RoomId{label.link}, label.dir, best - tail.at(label.link).dist});
+        room = label.link;
+    }
+    return steps;
+}
@@ -0,0 +1,92 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
+#include "ExitDirection.h"
+#include "RoutingGraph.h"
+
+class RoutingHierarchy;
+using SharedRoutingHierarchy = std::shared_ptr<const RoutingHierarchy>;
+
+/// Two-level routing over a RoutingGraph, clustered by the same zone tiling
+/// as the web map export (see MapZones.h).
+///
+/// Rooms with an exit into another zone, or an entrance from one, are portals.
+/// Every zone stores the shortest distance from each of its entrances to each
+/// of its exits, so a long trip is searched over portals only and then refined
+/// zone by zone. Paths are still exact: every intra-zone distance is a true
+/// shortest path within the zone, and leaving and re-entering a zone is just
+/// another portal-level route.
+///
+/// Zones whose rooms and internal exits didn't change share their distance
+/// tables with the previous hierarchy, so a rebuild after a local edit only
+/// recomputes the zones that were touched.
+class NODISCARD RoutingHierarchy final
+{
+public:
+    using Step = RoutingGraph::Step;
+    using ZoneKey = std::pair<int, int>;
+
+private:
+    struct this_is_private final
+    {
+        explicit this_is_private(int) {}
+    };
+    struct ZoneTable;
+    struct Zone final
+    {
+        ZoneKey key;
+        std::vector<uint32_t> rooms;
+        std::shared_ptr<const ZoneTable> table;
+    };
+    struct PortalEdge final
+    {
+        uint32_t to = 0;
+        ExitDirEnum dir = ExitDirEnum::NONE; // NONE for a path through a zone
+        double cost = 0.0;
+    };
+
+private:
+    SharedRoutingGraph m_graph;
+    std::map<ZoneKey, uint32_t> m_zoneIndex;
+    std::vector<Zone> m_zones;
+    std::vector<uint32_t> m_zoneOf;
+    std::vector<uint32_t> m_portalOf;
+    std::vector<uint32_t> m_portalRoom;
+    std::vector<uint32_t> m_portalOffsets;
+    std::vector<PortalEdge> m_portalEdges;
+
+public:
+    explicit RoutingHierarchy(this_is_private, SharedRoutingGraph graph, const RoutingHierarchy *prev);
+    ~RoutingHierarchy();
+    DELETE_CTORS_AND_ASSIGN_OPS(RoutingHierarchy);
+
+public:
+    /// Pass the previous hierarchy (or nullptr) to reuse its unchanged zones.
+    NODISCARD static SharedRoutingHierarchy build(SharedRoutingGraph graph,
+                                                  const RoutingHierarchy *prev);
+
+public:
+    NODISCARD const RoutingGraph &getGraph() const { return *m_graph; }
+    NODISCARD size_t getNumZones() const { return m_zones.size(); }
+    NODISCARD size_t getNumPortals() const { return m_portalRoom.size(); }
+
+    /// Returns the steps after `from` that lead to `to`, or nothing if there is
+    /// no route or isCancelled (if set) reported true.
+    NODISCARD std::optional<std::vector<Step>> findPath(
+        RoomId from, RoomId to, const std::function<bool()> &isCancelled = {}) const;
+
+private:
+    NODISCARD const Zone *findZone(const ZoneKey &key) const;
+};
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "RoutingProfile.h"
+
+#include <algorithm>
+
+#include "../expandoracommon/exit.h"
+#include "../expandoracommon/room.h"
+#include "ExitFlags.h"
+
+namespace { // anonymous
+
+using TerrainCosts = std::array<double, NUM_ROOM_TERRAIN_TYPES>;
+
+// Movement costs per terrain type.
+// Same order as the RoomTerrainEnum enum.
+// Values taken from https://github.com/nstockton/tintin-mume/blob/master/mapperproxy/mapper/constants.py
+constexpr const TerrainCosts BASE_TERRAIN_COSTS{
+    1.0,    // undefined
+    0.75,   // indoors
+    0.75,   // city
+    1.5,    // field
+    2.15,   // forest
+    2.45,   // hills
+    2.8,    // mountains
+    2.45,   // shallow
+    50.0,   // water
+    60.0,   // rapids
+    100.0,  // underwater
+    0.85,   // road
+    1.5,    // brush
+    0.75,   // tunnel
+    0.75,   // cavern
+    1000.0, // deathtrap
+};
+
+struct NODISCARD ExitPenalties final
+{
+    double hazard = 30.0;
+    double door = 1.0;
+    double climb = 2.0;
+    // Not sure if this is appropriate.
+    double road = -0.1;
+};
+
+constexpr size_t terrainIndex(const RoomTerrainEnum terrain)
+{
+    return static_cast<size_t>(terrain);
+}
+
+constexpr std::array<double, RoutingCosts::NUM_EXIT_INDICES> makeExitCosts(const ExitPenalties &p)
+{
+    std::array<double, RoutingCosts::NUM_EXIT_INDICES> result{};
+    for (uint32_t i = 0; i < RoutingCosts::NUM_EXIT_INDICES; ++i) {
+        double cost = 0.0;
+        if ((i & RoutingCosts::EXIT_HAZARD) != 0u)
+            cost += p.hazard;
+        if ((i & RoutingCosts::EXIT_DOOR) != 0u)
+            cost += p.door;
+        if ((i & RoutingCosts::EXIT_CLIMB) != 0u)
+            cost += p.climb;
+        if ((i & RoutingCosts::EXIT_ROAD) != 0u)
+            cost += p.road;
+        result[i] = cost;
+    }
+    return result;
+}
+
+// One room that can't be ridden means walking it, and a dismount and mount
+// when it's entered from one that can.
+using RidingCosts = std::array<double, RoutingCosts::NUM_RIDING_INDICES>;
+constexpr RidingCosts makeRidingCosts(const double walk, const double dismount)
+{
+    return {0.0, walk + dismount, 0.0, walk};
+}
+
+constexpr RoutingCosts makeCosts(const RoutingProfileEnum profile)
+{
+    RoutingCosts result;
+    result.terrain = BASE_TERRAIN_COSTS;
+    result.exit = makeExitCosts(ExitPenalties{});
+    switch (profile) {
+    case RoutingProfileEnum::MOUNTED:
+        result.riding = makeRidingCosts(3.0, 4.0);
+        break;
+    case RoutingProfileEnum::ON_FOOT:
+        break;
+    case RoutingProfileEnum::TROLL:
+        result.terrain[terrainIndex(RoomTerrainEnum::FOREST)] = 1.6;
+        result.terrain[terrainIndex(RoomTerrainEnum::HILLS)] = 1.7;
+        result.terrain[terrainIndex(RoomTerrainEnum::MOUNTAINS)] = 1.9;
+        break;
+    case RoutingProfileEnum::AVOID_WATER:
+        result.terrain[terrainIndex(RoomTerrainEnum::SHALLOW)] = 20.0;
+        result.terrain[terrainIndex(RoomTerrainEnum::WATER)] = 500.0;
+        result.terrain[terrainIndex(RoomTerrainEnum::RAPIDS)] = 600.0;
+        result.terrain[terrainIndex(RoomTerrainEnum::UNDERWATER)] = 1000.0;
+        result.riding = makeRidingCosts(3.0, 4.0);
+        break;
+    case RoutingProfileEnum::STEALTH: {
+        result.terrain[terrainIndex(RoomTerrainEnum::CITY)] = 3.0;
+        result.terrain[terrainIndex(RoomTerrainEnum::ROAD)] = 2.0;
+        ExitPenalties penalties;
+        penalties.road = 1.0;
+        result.exit = makeExitCosts(penalties);
+        break;
+    }
+    }
+    return result;
+}
+
+constexpr std::array<RoutingCosts, NUM_ROUTING_PROFILES> makeAllCosts()
+{
+    std::array<RoutingCosts, NUM_ROUTING_PROFILES> result{};
+    for (size_t i = 0; i < NUM_ROUTING_PROFILES; ++i)
+        result[i] = makeCosts(static_cast<RoutingProfileEnum>(i));
+    return result;
+}
+
+constexpr const std::array<RoutingCosts, NUM_ROUTING_PROFILES> ALL_COSTS = makeAllCosts();
+
+} // namespace
+
+const char *getRoutingProfileName(const RoutingProfileEnum profile)
+{
+#define X_CASE(UPPER_CASE, name, description) \
+    case RoutingProfileEnum::UPPER_CASE: \
+        return name;
+    switch (profile) {
+        X_FOREACH_ROUTING_PROFILE(X_CASE)
+    }
+#undef X_CASE
+    return "unknown";
+}
+
+const char *getRoutingProfileDescription(const RoutingProfileEnum profile)
+{
+#define X_CASE(UPPER_CASE, name, description) \
+    case RoutingProfileEnum::UPPER_CASE: \
+        return description;
+    switch (profile) {
+        X_FOREACH_ROUTING_PROFILE(X_CASE)
+    }
+#undef X_CASE
+    return "";
+}
+
+std::optional<RoutingProfileEnum> findRoutingProfile(const std::string_view name)
+{
+#define X_FIND(UPPER_CASE, lower_case, description) \
+    if (name == std::string_view{lower_case}) \
+        return RoutingProfileEnum::UPPER_CASE;
+    X_FOREACH_ROUTING_PROFILE(X_FIND)
+#undef X_FIND
+    return std::nullopt;
+}
+
+uint32_t RoutingCosts::getExitIndex(const Exit &e)
+{
+    const ExitFlags flags = e.getExitFlags();
+    uint32_t index = 0;
+    if (flags.isRandom() || flags.isDamage() || flags.isFall())
+        index |= EXIT_HAZARD;
+    if (flags.isDoor())
+        index |= EXIT_DOOR;
+    if (flags.isClimb())
+        index |= EXIT_CLIMB;
+    if (flags.isRoad())
+        index |= EXIT_ROAD;
+    return index;
+}
+
+uint32_t RoutingCosts::getRidingIndex(const Room &from, const Room &to)
+{
+    const auto notRidable = [](const Room &room) -> uint32_t {
+        return (room.getRidableType() == RoomRidableEnum::NOT_RIDABLE) ? 1u : 0u;
+    };
+    return notRidable(to) | (notRidable(from) << 1);
+}
+
+double RoutingCosts::getCost(const Exit &e, const Room &from, const Room &to) const
+{
+    return terrain[terrainIndex(to.getTerrainType())] + exit[getExitIndex(e)]
+           + riding[getRidingIndex(from, to)];
+}
+
+double RoutingCosts::getMinStepCost() const
+{
+    return *std::min_element(terrain.begin(), terrain.end())
+           + *std::min_element(exit.begin(), exit.end())
+           + *std::min_element(riding.begin(), riding.end());
+}
+
+const RoutingCosts &getRoutingCosts(const RoutingProfileEnum profile)
+{
+    return ALL_COSTS.at(static_cast<size_t>(profile));
+}
@@ -0,0 +1,73 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "../global/Flags.h"
+#include "../global/macros.h"
+#include "mmapper2room.h"
+
+class Exit;
+class Room;
+
+// X(UPPER_CASE, "name", "description")
+#define X_FOREACH_ROUTING_PROFILE(X) \
+    X(MOUNTED, "mounted", "riding, and walking through rooms that can't be ridden") \
+    X(ON_FOOT, "foot", "walking everywhere") \
+    X(TROLL, "troll", "walking, with rough terrain costing little more than fields") \
+    X(AVOID_WATER, "nowater", "riding, but with any water only as a last resort") \
+    X(STEALTH, "stealth", "walking, keeping off roads and out of cities") \
+    /* define routing profiles above */
+
+enum class RoutingProfileEnum : uint8_t {
+#define X_DECL_ROUTING_PROFILE(UPPER_CASE, name, description) UPPER_CASE,
+    X_FOREACH_ROUTING_PROFILE(X_DECL_ROUTING_PROFILE)
+#undef X_DECL_ROUTING_PROFILE
+};
+
+#define X_COUNT(UPPER_CASE, name, description) +1
+static constexpr const size_t NUM_ROUTING_PROFILES = X_FOREACH_ROUTING_PROFILE(X_COUNT);
+#undef X_COUNT
+DEFINE_ENUM_COUNT(RoutingProfileEnum, NUM_ROUTING_PROFILES)
+
+NODISCARD const char *getRoutingProfileName(RoutingProfileEnum profile);
+NODISCARD const char *getRoutingProfileDescription(RoutingProfileEnum profile);
+NODISCARD std::optional<RoutingProfileEnum> findRoutingProfile(std::string_view name);
+
+/// What moving through one exit costs under a routing profile, as dense tables
+/// indexed by the destination's terrain, the exit's flags (see getExitIndex()),
+/// and whether the rooms at either end can be ridden, so a cost is three loads
+/// and two additions.
+class NODISCARD RoutingCosts final
+{
+public:
+    // Exit flags that change the cost; random, damage and fall exits count as one.
+    static constexpr const uint32_t EXIT_HAZARD = 1u << 0;
+    static constexpr const uint32_t EXIT_DOOR = 1u << 1;
+    static constexpr const uint32_t EXIT_CLIMB = 1u << 2;
+    static constexpr const uint32_t EXIT_ROAD = 1u << 3;
+    static constexpr const size_t NUM_EXIT_INDICES = 16;
+    // Bit 0: the destination can't be ridden; bit 1: the origin can't be ridden.
+    static constexpr const size_t NUM_RIDING_INDICES = 4;
+
+public:
+    std::array<double, NUM_ROOM_TERRAIN_TYPES> terrain{};
+    std::array<double, NUM_EXIT_INDICES> exit{};
+    std::array<double, NUM_RIDING_INDICES> riding{};
+
+public:
+    NODISCARD static uint32_t getExitIndex(const Exit &e);
+    NODISCARD static uint32_t getRidingIndex(const Room &from, const Room &to);
+
+public:
+    NODISCARD double getCost(const Exit &e, const Room &from, const Room &to) const;
+    /// Lower bound on the cost of any single exit, for scaling A* heuristics.
+    NODISCARD double getMinStepCost() const;
+};
+
+NODISCARD const RoutingCosts &getRoutingCosts(RoutingProfileEnum profile);
@@ -6,9 +6,12 @@
 #include "customaction.h"
 
 #include <memory>
+#include <optional>
 #include <set>
+#include <type_traits>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
@@ -63,9 +66,7 @@ GroupMapAction::GroupMapAction(std::unique_ptr<AbstractAction> action,
                                const SharedRoomSelection &selection)
     : executor(std::move(action))
 {
-    QMapIterator<RoomId, const Room *> roomIter(*selection);
-    while (roomIter.hasNext()) {
-        RoomId rid = roomIter.next().key();
+    for (const RoomId rid : selection->getRoomIds()) {
         affectedRooms.insert(rid);
         selectedRooms.push_back(rid);
     }
@@ -103,12 +104,7 @@ const RoomIdSet &GroupMapAction::getAffectedRooms()
 
 void GroupMapAction::exec()
 {
-    for (auto &selectedRoom : selectedRooms) {
-        executor->preExec(selectedRoom);
-    }
-    for (auto &selectedRoom : selectedRooms) {
-        executor->exec(selectedRoom);
-    }
+    executor->execAll(selectedRooms);
 }
 
 MoveRelative::MoveRelative(const Coordinate &in_move)
@@ -131,6 +127,36 @@ void MoveRelative::preExec(const RoomId id)
     }
 }
 
+void MoveRelative::execAll(const std::vector<RoomId> &ids)
+{
+    Map &roomMap = map();
+    std::vector<Room *> rooms;
+    rooms.reserve(ids.size());
+    for (const RoomId id : ids) {
+        if (Room *const room = roomIndex(id)) {
+            roomMap.remove(room->getPosition());
+            rooms.emplace_back(room);
+        }
+    }
+
+    // With the whole selection lifted out, the rooms can only collide with the
+    // rest of the map. The rooms whose target is free claim it first, so the
+    // blocked ones can't take it from them while looking for the nearest free
+    // cell, and push them around in turn.
+    std::vector<Room *> blocked;
+    for (Room *const room : rooms) {
+        const Coordinate target = room->getPosition() + move;
+        if (roomMap.defined(target)) {
+            blocked.emplace_back(room);
+        } else {
+            roomMap.setNearest(target, *room);
+        }
+    }
+    for (Room *const room : blocked) {
+        roomMap.setNearest(room->getPosition() + move, *room);
+    }
+}
+
 MergeRelative::MergeRelative(const Coordinate &in_move)
     : move(in_move)
 {}
@@ -382,3 +408,94 @@ void ModifyExitFlags::exec(const RoomId id)
         }
     }
 }
+
+// The fields that ParseTree::computeKeys() looks at, besides the exits.
+template<typename T>
+static constexpr const bool IS_HOME_FIELD = std::is_same_v<T, RoomName>
+                                            || std::is_same_v<T, RoomStaticDesc>
+                                            || std::is_same_v<T, RoomDynamicDesc>
+                                            || std::is_same_v<T, RoomTerrainEnum>;
+
+RestoreRoomFields::RestoreRoomFields(MapEditHistory::SharedEdit in_edit,
+                                     const MapEditDirectionEnum in_direction)
+    : edit{std::move(in_edit)}
+    , direction{in_direction}
+{
+    for (const MapEditHistory::RoomDelta &delta : edit->rooms) {
+        affectedRooms.insert(delta.id);
+    }
+}
+
+void RestoreRoomFields::exec()
+{
+    using FieldValue = MapEditHistory::FieldValue;
+    const bool undo = direction == MapEditDirectionEnum::UNDO;
+    Map &roomMap = map();
+
+    // Like MoveRelative, this frees all of the old positions before taking the new ones.
+    for (const MapEditHistory::RoomDelta &delta : edit->rooms) {
+        Room *const room = roomIndex(delta.id);
+        if (room == nullptr) {
+            continue;
+        }
+        for (const MapEditHistory::FieldChange &change : delta.changes) {
+            const Coordinate &pos = room->getPosition();
+            if (std::holds_alternative<Coordinate>(change.before) && roomMap.get(pos) == room) {
+                roomMap.remove(pos);
+            }
+        }
+    }
+
+    for (const MapEditHistory::RoomDelta &delta : edit->rooms) {
+        Room *const room = roomIndex(delta.id);
+        if (room == nullptr) {
+            continue;
+        }
+        std::optional<ExitsList> exits;
+        bool homeChanged = false;
+        for (const MapEditHistory::FieldChange &change : delta.changes) {
+            const FieldValue &value = undo ? change.before : change.after;
+            if (const auto *const pos = std::get_if<Coordinate>(&value)) {
+                roomMap.setNearest(*pos, *room);
+            } else if (const auto *const ec = std::get_if<MapEditHistory::ExitChange>(&value)) {
+                if (!exits.has_value()) {
+                    exits = room->getExitsList();
+                }
+                exits.value()[ec->dir] = ec->exit;
+                homeChanged = true;
+            } else if (const auto *const upToDate = std::get_if<MapEditHistory::UpToDate>(&value)) {
+                if (upToDate->value)
+                    room->setUpToDate();
+                else
+                    room->setOutDated();
+            }
+#define X_CASE(_Type, _Prop, _OptInit) \
+    else if (const auto *const field = std::get_if<_Type>(&value)) \
+    { \
+        room->set##_Prop(*field); \
+        homeChanged = homeChanged || IS_HOME_FIELD<_Type>; \
+    }
+            XFOREACH_ROOM_PROPERTY(X_CASE)
+#undef X_CASE
+        }
+        if (exits.has_value()) {
+            room->setExitsList(exits.value());
+        }
+        if (homeChanged) {
+            updateHome(*room);
+        }
+    }
+}
+
+void RestoreRoomFields::updateHome(Room &room)
+{
+    const SharedRoomCollection newHome = getParseTree().insertRoom(*Room::getEvent(&room));
+    auto &home_ref = roomHomes()[room.getId()];
+    if (SharedRoomCollection &oldHome = home_ref) {
+        oldHome->removeRoom(&room);
+    }
+    home_ref = newHome;
+    if (newHome != nullptr) {
+        newHome->addRoom(&room);
+    }
+}
@@ -4,8 +4,8 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
-#include <list>
 #include <memory>
+#include <vector>
 #include <QVariant>
 #include <QtCore>
 #include <QtGlobal>
@@ -15,6 +15,7 @@
 #include "../mapfrontend/mapaction.h"
 #include "ExitDirection.h"
 #include "ExitFieldVariant.h"
+#include "MapEditHistory.h"
 #include "RoomFieldVariant.h"
 #include "mmapper2exit.h"
 #include "mmapper2room.h"
@@ -79,7 +80,7 @@ class GroupMapAction final : virtual public MapAction
     virtual const RoomIdSet &getAffectedRooms() override;
 
 private:
-    std::list<RoomId> selectedRooms{};
+    std::vector<RoomId> selectedRooms{};
     std::unique_ptr<AbstractAction> executor;
 };
 
@@ -92,6 +93,8 @@ class MoveRelative final : public AbstractAction
 
     virtual void exec(RoomId id) override;
 
+    virtual void execAll(const std::vector<RoomId> &ids) override;
+
 protected:
     Coordinate move;
 };
@@ -176,3 +179,22 @@ class ModifyExitFlags final : public AbstractAction
     const FlagModifyModeEnum mode;
     const ExitDirEnum dir = ExitDirEnum::UNKNOWN;
 };
+
+// Sets the fields changed by an edit back to their values before it (undo),
+// or to their values after it (redo); see MapEditHistory.
+class RestoreRoomFields final : public MapAction, public FrontendAccessor
+{
+public:
+    explicit RestoreRoomFields(MapEditHistory::SharedEdit edit, MapEditDirectionEnum direction);
+
+    void schedule(MapFrontend *in) override { setFrontend(in); }
+
+protected:
+    virtual void exec() override;
+
+private:
+    void updateHome(Room &room);
+
+    const MapEditHistory::SharedEdit edit;
+    const MapEditDirectionEnum direction = MapEditDirectionEnum::UNDO;
+};
@@ -11,12 +11,12 @@ void InfoMarkModificationTracker::notifyModified(InfoMark &mark, InfoMarkUpdateF
 }
 
 InfoMark::InfoMark(InfoMark::this_is_private, InfoMarkModificationTracker &tracker)
-    : m_tracker{tracker}
+    : m_tracker{&tracker}
 {}
 
 void InfoMark::setModified(InfoMarkUpdateFlags updateFlags)
 {
-    m_tracker.notifyModified(*this, updateFlags);
+    m_tracker->notifyModified(*this, updateFlags);
 }
 
 template<typename T>
@@ -111,8 +111,10 @@ class InfoMark final : public std::enable_shared_from_this<InfoMark>
 
 public:
     void setModified(InfoMarkUpdateFlags updateFlags);
+    // Only for handing a loaded map over to another MapData.
+    void setTracker(InfoMarkModificationTracker &tracker) { m_tracker = &tracker; }
 
 private:
-    InfoMarkModificationTracker &m_tracker;
+    InfoMarkModificationTracker *m_tracker = nullptr;
     InfoMarkFields m_fields;
 };
@@ -8,10 +8,13 @@
 
 #include <algorithm>
 #include <cassert>
-#include <list>
 #include <map>
 #include <memory>
+#include <optional>
 #include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include <QList>
 #include <QString>
 
@@ -19,8 +22,10 @@
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
+#include "../global/ParallelFor.h"
 #include "../global/roomid.h"
 #include "../global/utils.h"
+#include "../mapfrontend/MapLock.h"
 #include "../mapfrontend/map.h"
 #include "../mapfrontend/mapaction.h"
 #include "../mapfrontend/mapfrontend.h"
@@ -28,7 +33,6 @@
 #include "ExitDirection.h"
 #include "ExitFieldVariant.h"
 #include "customaction.h"
-#include "drawstream.h"
 #include "infomark.h"
 #include "mmapper2room.h"
 #include "roomfilter.h"
@@ -38,72 +42,77 @@ MapData::MapData(QObject *const parent)
     : MapFrontend(parent)
 {}
 
-const DoorName &MapData::getDoorName(const Coordinate &pos, const ExitDirEnum dir)
+MapData::RoomReadHandle::RoomReadHandle(MapData &data, const Coordinate &pos)
+    : m_locker{data.mapLock}
+    , m_room{data.map.get(pos)}
+{}
+
+const DoorName &MapData::RoomReadHandle::getDoorName(const ExitDirEnum dir) const
 {
-    // REVISIT: Could this function could be made const if we make mapLock mutable?
-    // Alternately, WTF are we accessing this from multiple threads?
-    QMutexLocker locker(&mapLock);
-    if (const Room *const room = map.get(pos)) {
-        if (dir < ExitDirEnum::UNKNOWN) {
-            return room->exit(dir).getDoorName();
-        }
+    if (m_room != nullptr && dir < ExitDirEnum::UNKNOWN) {
+        return m_room->exit(dir).getDoorName();
     }
 
     static const DoorName tmp{"exit"};
     return tmp;
 }
 
-ExitDirections MapData::getExitDirections(const Coordinate &pos)
+ExitDirections MapData::RoomReadHandle::getExitDirections() const
 {
     ExitDirections result;
-    QMutexLocker locker(&mapLock);
-    if (const Room *const room = map.get(pos)) {
+    if (m_room != nullptr) {
         for (auto dir : ALL_EXITS7) {
-            if (room->exit(dir).isExit())
+            if (m_room->exit(dir).isExit())
                 result |= dir;
         }
     }
     return result;
 }
 
-bool MapData::getExitFlag(const Coordinate &pos, const ExitDirEnum dir, ExitFieldVariant var)
+bool MapData::RoomReadHandle::getExitFlag(const ExitDirEnum dir, const ExitFieldVariant &var) const
 {
     assert(var.getType() != ExitFieldEnum::DOOR_NAME);
 
-    QMutexLocker locker(&mapLock);
-    if (const Room *const room = map.get(pos)) {
-        if (dir < ExitDirEnum::NONE) {
-            switch (var.getType()) {
-            case ExitFieldEnum::DOOR_NAME:
-                if (var.getDoorName() == room->exit(dir).getDoorName()) {
-                    return true;
-                }
-                break;
-            case ExitFieldEnum::EXIT_FLAGS:
-                if (room->exit(dir).getExitFlags().containsAny(var.getExitFlags())) {
-                    return true;
-                }
-                break;
-            case ExitFieldEnum::DOOR_FLAGS:
-                if (room->exit(dir).getDoorFlags().containsAny(var.getDoorFlags())) {
-                    return true;
-                }
-                break;
-            }
-        }
+    if (m_room == nullptr || dir >= ExitDirEnum::NONE)
+        return false;
+
+    const Exit &e = m_room->exit(dir);
+    switch (var.getType()) {
+    case ExitFieldEnum::DOOR_NAME:
+        return var.getDoorName() == e.getDoorName();
+    case ExitFieldEnum::EXIT_FLAGS:
+        return e.getExitFlags().containsAny(var.getExitFlags());
+    case ExitFieldEnum::DOOR_FLAGS:
+        return e.getDoorFlags().containsAny(var.getDoorFlags());
     }
     return false;
 }
 
+const DoorName &MapData::getDoorName(const Coordinate &pos, const ExitDirEnum dir)
+{
+    // REVISIT: Could this function could be made const if we make mapLock mutable?
+    // Alternately, WTF are we accessing this from multiple threads?
+    return readRoom(pos).getDoorName(dir);
+}
+
+ExitDirections MapData::getExitDirections(const Coordinate &pos)
+{
+    return readRoom(pos).getExitDirections();
+}
+
+bool MapData::getExitFlag(const Coordinate &pos, const ExitDirEnum dir, ExitFieldVariant var)
+{
+    return readRoom(pos).getExitFlag(dir, var);
+}
+
 const Room *MapData::getRoom(const Coordinate &pos)
 {
-    QMutexLocker locker(&mapLock);
-    return map.get(pos);
+    return readRoom(pos).getRoom();
 }
 
 QList<Coordinate> MapData::getPath(const Coordinate &start, const CommandQueue &dirs)
 {
-    QMutexLocker locker(&mapLock);
+    MapReadLocker locker(mapLock);
     QList<Coordinate> ret;
 
     //* NOTE: room is used and then reassigned inside the loop.
@@ -142,7 +151,7 @@ QList<Coordinate> MapData::getPath(const Coordinate &start, const CommandQueue &
 // the room will be inserted in the given selection. the selection must have been created by mapdata
 const Room *MapData::getRoom(const Coordinate &pos, RoomSelection &selection)
 {
-    QMutexLocker locker(&mapLock);
+    MapReadLocker locker(mapLock);
     if (Room *const room = map.get(pos)) {
         auto id = room->getId();
         lockRoom(&selection, id);
@@ -154,8 +163,11 @@ const Room *MapData::getRoom(const Coordinate &pos, RoomSelection &selection)
 
 const Room *MapData::getRoom(const RoomId id, RoomSelection &selection)
 {
-    QMutexLocker locker(&mapLock);
-    if (const SharedRoom &room = roomIndex[id]) {
+    MapReadLocker locker(mapLock);
+    const SharedRoom *const found = roomIndex.tryGet(id);
+    if (found == nullptr)
+        return nullptr;
+    if (const SharedRoom &room = *found) {
         const RoomId roomId = room->getId();
         assert(id == roomId);
 
@@ -167,43 +179,153 @@ const Room *MapData::getRoom(const RoomId id, RoomSelection &selection)
     return nullptr;
 }
 
-void MapData::generateBatches(MapCanvasRoomDrawer &screen, const OptBounds &bounds)
+bool MapData::isMovable(const RoomSelection &selection, const Coordinate &offset) const
+{
+    MapReadLocker locker(mapLock);
+    for (const Room *const room : selection) {
+        const Room *const other = map.get(room->getPosition() + offset);
+        if (other != nullptr && !selection.contains(other->getId()))
+            return false;
+    }
+    return true;
+}
+
+void MapData::markMeshDirty(const RoomId *const ids, const size_t count)
+{
+    // Past this point it's cheaper to rebuild every tile than to find the changed ones.
+    static constexpr const size_t MAX_MESH_DIRTY_ROOMS = 2048;
+
+    MeshState &state = m_meshState;
+    QMutexLocker locker(&state.mutex);
+    for (size_t i = 0; i < count && !state.allDirty; ++i) {
+        // A room that doesn't have an id yet could be anywhere.
+        if (ids[i] != INVALID_ROOMID)
+            state.dirty.insert(ids[i]);
+        if (ids[i] == INVALID_ROOMID || state.dirty.size() > MAX_MESH_DIRTY_ROOMS) {
+            state.allDirty = true;
+            state.dirty.clear();
+        }
+    }
+}
+
+std::optional<RoomIdSet> MapData::takeMeshChanges()
 {
-    QMutexLocker locker(&mapLock);
-    const LayerToRooms layerToRooms = [this]() -> LayerToRooms {
-        LayerToRooms ltr;
-        DrawStream drawer(ltr);
-        map.getRooms(drawer);
-        return ltr;
-    }();
-    screen.generateBatches(layerToRooms, roomIndex, bounds);
+    MeshState &state = m_meshState;
+    QMutexLocker locker(&state.mutex);
+    RoomIdSet dirty = std::exchange(state.dirty, RoomIdSet{});
+    if (std::exchange(state.allDirty, false))
+        return std::nullopt;
+    return dirty;
+}
+
+void MapData::markMarkerMeshDirty(const InfoMark &mark)
+{
+    // Past this point it's cheaper to rebuild every cell than to track them.
+    static constexpr const size_t MAX_MARKER_MESH_DIRTY_CELLS = 256;
+
+    MarkerMeshState &state = m_markerMeshState;
+    if (state.allDirty)
+        return;
+    const InfoMarkIndex::CellId *const cell = m_markerIndex.getHomeCell(mark);
+    if (cell == nullptr)
+        return;
+    state.dirty.insert(*cell);
+    if (state.dirty.size() > MAX_MARKER_MESH_DIRTY_CELLS) {
+        state.allDirty = true;
+        state.dirty.clear();
+    }
+}
+
+std::optional<std::set<InfoMarkIndex::CellId>> MapData::takeMarkerMeshChanges()
+{
+    MarkerMeshState &state = m_markerMeshState;
+    std::set<InfoMarkIndex::CellId> dirty = std::exchange(state.dirty, {});
+    if (std::exchange(state.allDirty, false))
+        return std::nullopt;
+    return dirty;
 }
 
 bool MapData::execute(std::unique_ptr<MapAction> action, const SharedRoomSelection &selection)
 {
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
     action->schedule(this);
-    std::list<RoomId> selectedIds;
+    return executeLocked(*action, selection.get(), EditHistoryEnum::RECORD);
+}
+
+bool MapData::undo(const SharedRoomSelection &selection)
+{
+    MapWriteLocker locker(mapLock);
+    return restoreLocked(MapEditDirectionEnum::UNDO, selection.get());
+}
+
+bool MapData::redo(const SharedRoomSelection &selection)
+{
+    MapWriteLocker locker(mapLock);
+    return restoreLocked(MapEditDirectionEnum::REDO, selection.get());
+}
+
+bool MapData::restoreLocked(const MapEditDirectionEnum direction, RoomSelection *const selection)
+{
+    const bool undo = direction == MapEditDirectionEnum::UNDO;
+    MapEditHistory::SharedEdit edit = undo ? m_editHistory.getUndo() : m_editHistory.getRedo();
+    if (edit == nullptr) {
+        return false;
+    }
+    // Rooms also change without being logged (e.g. by the path machine or the group),
+    // and restoring the logged values would silently revert those changes as well.
+    if (!MapEditHistory::isCurrent(*edit, roomIndex, direction)) {
+        m_editHistory.clear();
+        emit log("MapData", "The rooms changed since that edit, so the undo history was cleared");
+        emit sig_editHistoryChanged(false, false);
+        return false;
+    }
+
+    RestoreRoomFields action{std::move(edit), direction};
+    action.schedule(this);
+    if (!executeLocked(action, selection, EditHistoryEnum::SKIP)) {
+        return false;
+    }
+
+    if (undo) {
+        m_editHistory.onUndone();
+    } else {
+        m_editHistory.onRedone();
+    }
+    emit sig_editHistoryChanged(m_editHistory.canUndo(), m_editHistory.canRedo());
+    return true;
+}
 
-    for (auto i = selection->begin(); i != selection->end();) {
-        const Room *room = *i++;
-        const auto id = room->getId();
-        locks[id].erase(selection.get());
-        selectedIds.push_back(id);
+bool MapData::executeLocked(MapAction &action,
+                            RoomSelection *const selection,
+                            const EditHistoryEnum history)
+{
+    const ModificationBatch batch{*this};
+    std::vector<RoomId> selectedIds;
+
+    if (selection != nullptr) {
+        selectedIds = selection->getRoomIds();
+        for (const RoomId id : selectedIds)
+            locks.erase(id, selection);
+        selection->clear();
     }
-    selection->clear();
 
-    MapAction *const pAction = action.get();
-    const bool executable = isExecutable(pAction);
+    const bool executable = isExecutable(&action);
     if (executable) {
-        executeAction(pAction);
+        if (history == EditHistoryEnum::RECORD) {
+            const auto before = MapEditHistory::capture(roomIndex, getAffectedRooms(action));
+            executeAction(&action);
+            m_editHistory.record(before, roomIndex);
+            emit sig_editHistoryChanged(m_editHistory.canUndo(), m_editHistory.canRedo());
+        } else {
+            executeAction(&action);
+        }
     } else {
-        qWarning() << "Unable to execute action" << pAction;
+        qWarning() << "Unable to execute action" << &action;
     }
 
     for (auto id : selectedIds) {
         if (const SharedRoom &room = roomIndex[id]) {
-            locks[id].insert(selection.get());
+            locks.insert(id, selection);
             selection->insert(id, room.get());
         }
     }
@@ -213,38 +335,576 @@ bool MapData::execute(std::unique_ptr<MapAction> action, const SharedRoomSelecti
 void MapData::clear()
 {
     MapFrontend::clear();
+    resetSnapshot();
+    resetJournal(false);
     m_markers.clear();
+    m_markerIndex.clear();
+    m_markerMeshState.dirty.clear();
+    m_markerMeshState.allDirty = true;
+    {
+        DigestState &digest = m_digestState;
+        QMutexLocker digestLocker(&digest.mutex);
+        digest.last.reset();
+        digest.identity = 0;
+    }
+    {
+        MapWriteLocker locker(mapLock);
+        m_editHistory.clear();
+    }
+    emit sig_editHistoryChanged(false, false);
     emit log("MapData", "cleared MapData");
 }
 
+void MapData::adoptLoadedMap(MapData &staging)
+{
+    clear();
+    block();
+    takeRoomsFrom(staging);
+    unblock();
+    resetSnapshot();
+    markRoutingDirty();
+
+    {
+        const DataChangedBatch batch{*this};
+        for (const auto &mark : std::exchange(staging.m_markers, MarkerList{})) {
+            mark->setTracker(*this);
+            addMarker(mark);
+        }
+        staging.m_markerIndex.clear();
+    }
+
+    setPosition(staging.getPosition());
+    setFileName(staging.getFileName(), staging.isFileReadOnly());
+    setMapIdentity(staging.getMapIdentity());
+    JournalChanges pending;
+    bool hasBase = false;
+    {
+        JournalState &state = staging.m_journalState;
+        QMutexLocker locker(&state.mutex);
+        hasBase = state.hasBase;
+        pending = std::exchange(state.pending, JournalChanges{});
+    }
+    resetJournal(hasBase);
+    restoreJournalChanges(pending);
+    if (staging.dataChanged()) {
+        setDataChanged();
+    } else {
+        unsetDataChanged();
+    }
+    checkSize();
+    emit log("MapData", "adopted the loaded map");
+}
+
+// The most rooms of each kind that mergeMap() lists in the log
+static constexpr const size_t MAX_MERGE_REPORT_ROOMS = 10;
+
+static QString getMarkerKey(const InfoMark &mark)
+{
+    const Coordinate &a = mark.getPosition1();
+    const Coordinate &b = mark.getPosition2();
+    return QString("%1|%2|%3|%4,%5,%6|%7,%8,%9|%10")
+        .arg(mark.getText().toQString())
+        .arg(static_cast<int>(mark.getType()))
+        .arg(static_cast<int>(mark.getClass()))
+        .arg(a.x)
+        .arg(a.y)
+        .arg(a.z)
+        .arg(b.x)
+        .arg(b.y)
+        .arg(b.z)
+        .arg(mark.getRotationAngle());
+}
+
+MapDiff MapData::mergeMap(MapData &other)
+{
+    const SharedMapSnapshot ours = getSnapshot();
+    const SharedMapSnapshot theirs = other.getSnapshot();
+    const MapDiff diff = MapDiff::compute(*ours, *theirs);
+
+    // Their ids in this map; the rooms that are added take new ones.
+    std::vector<RoomId> toOurs(theirs->getRooms().size(), INVALID_ROOMID);
+    std::vector<bool> isMatched(ours->getRooms().size(), false);
+    for (const auto *const matches : {&diff.changed, &diff.unchanged}) {
+        for (const MapDiff::Match &match : *matches) {
+            toOurs[match.theirs.asUint32()] = match.ours;
+            isMatched[match.ours.asUint32()] = true;
+        }
+    }
+    /* NOTE: This relies on the maxID being ~0u, so adding 1 brings us back to 0u. */
+    uint32_t nextId = getMaxId().asUint32() + 1u;
+    for (const RoomId id : diff.added)
+        toOurs[id.asUint32()] = RoomId{nextId++};
+
+    const auto translate = [&toOurs](const RoomId id) {
+        return (id.asUint32() < toOurs.size()) ? toOurs[id.asUint32()] : INVALID_ROOMID;
+    };
+    const auto isOnlyOurs = [&isMatched](const RoomId id) {
+        return id.asUint32() >= isMatched.size() || !isMatched[id.asUint32()];
+    };
+    // Their links to rooms that can't be matched are dropped, and ours to rooms that only
+    // this map has are kept.
+    const auto translateExits = [&translate, &isOnlyOurs](const Room &theirRoom,
+                                                          const Room *const ourRoom) {
+        ExitsList exits;
+        for (const ExitDirEnum dir : ALL_EXITS7) {
+            const Exit &theirExit = theirRoom.exit(dir);
+            Exit &e = exits[dir];
+            e.setDoorName(theirExit.getDoorName());
+            e.setExitFlags(theirExit.getExitFlags());
+            e.setDoorFlags(theirExit.getDoorFlags());
+            for (const RoomId id : theirExit.getOutgoing()) {
+                if (const RoomId to = translate(id); to != INVALID_ROOMID)
+                    e.addOut(to);
+            }
+            for (const RoomId id : theirExit.getIncoming()) {
+                if (const RoomId from = translate(id); from != INVALID_ROOMID)
+                    e.addIn(from);
+            }
+            if (ourRoom == nullptr)
+                continue;
+            const Exit &ourExit = ourRoom->exit(dir);
+            for (const RoomId id : ourExit.getOutgoing()) {
+                if (isOnlyOurs(id))
+                    e.addOut(id);
+            }
+            for (const RoomId id : ourExit.getIncoming()) {
+                if (isOnlyOurs(id))
+                    e.addIn(id);
+            }
+        }
+        return exits;
+    };
+
+    std::vector<SharedRoom> added;
+    added.reserve(diff.added.size());
+    for (const RoomId theirId : diff.added) {
+        const Room &theirRoom = deref(theirs->getRoom(theirId));
+        const SharedRoom room = Room::createPermanentRoom(*this);
+        room->setId(toOurs[theirId.asUint32()]);
+        room->setPosition(theirRoom.getPosition());
+#define X_COPY(_Type, _Prop, _OptInit) room->set##_Prop(theirRoom.get##_Prop());
+        XFOREACH_ROOM_PROPERTY(X_COPY)
+#undef X_COPY
+        room->setExitsList(translateExits(theirRoom, nullptr));
+        if (theirRoom.isUpToDate())
+            room->setUpToDate();
+        added.emplace_back(room);
+    }
+
+    MapEditHistory::Snapshot changed;
+    changed.reserve(diff.changed.size());
+    for (const MapDiff::Match &match : diff.changed) {
+        const Room &theirRoom = deref(theirs->getRoom(match.theirs));
+        const Room &ourRoom = deref(ours->getRoom(match.ours));
+        MapEditHistory::RoomState state = MapEditHistory::captureRoom(theirRoom);
+        state.id = match.ours;
+        state.Note = ourRoom.getNote();
+        state.exits = translateExits(theirRoom, &ourRoom);
+        changed.emplace_back(std::move(state));
+    }
+
+    if (!added.empty()) {
+        block();
+        insertPredefinedRooms(added);
+        unblock();
+    }
+    {
+        MapWriteLocker locker(mapLock);
+        MapEditHistory::SharedEdit edit = MapEditHistory::diff(roomIndex, changed);
+        if (!edit->rooms.empty()) {
+            RestoreRoomFields action{std::move(edit), MapEditDirectionEnum::REDO};
+            action.schedule(this);
+            std::ignore = executeLocked(action, nullptr, EditHistoryEnum::SKIP);
+        }
+        m_editHistory.clear();
+    }
+    emit sig_editHistoryChanged(false, false);
+
+    size_t marksAdded = 0;
+    {
+        std::set<QString> keys;
+        for (const auto &mark : m_markers)
+            keys.insert(getMarkerKey(*mark));
+        const DataChangedBatch batch{*this};
+        for (const auto &mark : std::exchange(other.m_markers, MarkerList{})) {
+            if (!keys.insert(getMarkerKey(*mark)).second)
+                continue;
+            mark->setTracker(*this);
+            addMarker(mark);
+            ++marksAdded;
+        }
+        other.m_markerIndex.clear();
+    }
+
+    // The map no longer matches its file closely enough to append to its journal.
+    resetJournal(false);
+    setDataChanged();
+    checkSize();
+    emit log("MapData", diff.describe(*ours, *theirs, MAX_MERGE_REPORT_ROOMS));
+    emit log("MapData", QString("Added %1 marker(s).").arg(marksAdded));
+    return diff;
+}
+
 void MapData::removeDoorNames()
 {
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
 
     const auto noName = DoorName{};
+    std::vector<SharedMapAction> actions;
     for (auto &room : roomIndex) {
         if (room != nullptr) {
             for (const auto dir : ALL_EXITS_NESWUD) {
-                scheduleAction(std::make_unique<SingleRoomAction>(
+                actions.emplace_back(std::make_shared<SingleRoomAction>(
                     std::make_unique<ModifyExitFlags>(noName, dir, FlagModifyModeEnum::UNSET),
                     room->getId()));
             }
         }
     }
+    scheduleActions(actions);
 }
 
+// Below this many rooms, handing chunks to the thread pool costs more than it saves.
+static constexpr const size_t SEARCH_CHUNK_SIZE = 512;
+
+// NOTE: This only takes the read lock, so the recipient must not call back into
+// anything that modifies the map (e.g. releaseRoom()) from receiveRooms().
+
 void MapData::genericSearch(RoomRecipient *recipient, const RoomFilter &f)
 {
-    QMutexLocker locker(&mapLock);
-    for (const SharedRoom &room : roomIndex) {
-        if (room == nullptr)
-            continue;
-        Room *const r = room.get();
-        if (!f.filter(r))
+    const auto candidates = getTextSearchCandidates(f);
+    MapReadLocker locker(mapLock);
+
+    std::vector<const Room *> rooms;
+    const auto add = [&rooms](const SharedRoom &room) {
+        if (room != nullptr)
+            rooms.emplace_back(room.get());
+    };
+    if (!candidates) {
+        rooms.reserve(roomIndex.size());
+        for (const SharedRoom &room : roomIndex)
+            add(room);
+    } else {
+        rooms.reserve(candidates->size());
+        for (const RoomId id : *candidates) {
+            if (id.asUint32() < roomIndex.size())
+                add(roomIndex[id]);
+        }
+    }
+
+    // The filter only reads the rooms, and the read lock keeps them from changing,
+    // so the chunks can be checked concurrently; matches are then reported
+    // in one batch, in the same (id) order as before.
+    std::vector<char> matched(rooms.size(), 0);
+    parallelFor(rooms.size(), SEARCH_CHUNK_SIZE, [&rooms, &matched, &f](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            matched[i] = f.filter(rooms[i]) ? 1 : 0;
+    });
+
+    size_t numMatched = 0;
+    for (size_t i = 0; i < rooms.size(); ++i) {
+        if (matched[i])
+            rooms[numMatched++] = rooms[i];
+    }
+    rooms.resize(numMatched);
+    deliverRooms(deref(recipient), rooms);
+}
+
+void MapData::markRoomsDirty(const std::pair<RoomId, RoomUpdateFlags> *const updates,
+                             const size_t count)
+{
+    static constexpr const RoomUpdateFlags TEXT_FLAGS
+        = RoomUpdateFlags{RoomUpdateEnum::Name} | RoomUpdateEnum::StaticDesc
+          | RoomUpdateEnum::DynamicDesc | RoomUpdateEnum::Note | RoomUpdateEnum::DoorName
+          | RoomUpdateEnum::Id;
+    // Everything that affects routing also invalidates the mesh, except a new room id.
+    static constexpr const RoomUpdateFlags MESH_FLAGS = RoomUpdateFlags{RoomUpdateEnum::Mesh}
+                                                        | RoomUpdateEnum::Id;
+
+    std::vector<RoomId> ids;
+    std::vector<RoomId> textIds;
+    std::vector<RoomId> meshIds;
+    ids.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const auto &[id, flags] = updates[i];
+        ids.emplace_back(id);
+        if (flags.containsAny(TEXT_FLAGS))
+            textIds.emplace_back(id);
+        if (flags.containsAny(MESH_FLAGS))
+            meshIds.emplace_back(id);
+    }
+
+    markSnapshotDirty(ids.data(), ids.size());
+    markJournalDirty(ids.data(), ids.size());
+    if (!textIds.empty())
+        markTextDirty(textIds.data(), textIds.size());
+    if (!meshIds.empty()) {
+        markRoutingDirty();
+        markMeshDirty(meshIds.data(), meshIds.size());
+    }
+}
+
+void MapData::markJournalDirty(const RoomId *const ids, const size_t count)
+{
+    JournalState &state = m_journalState;
+    QMutexLocker locker(&state.mutex);
+    if (state.hasBase)
+        state.pending.rooms.insert(ids, ids + count);
+}
+
+void MapData::markJournalMarksDirty()
+{
+    JournalState &state = m_journalState;
+    QMutexLocker locker(&state.mutex);
+    if (state.hasBase)
+        state.pending.marks = true;
+}
+
+void MapData::resetJournal(const bool hasBase)
+{
+    JournalState &state = m_journalState;
+    QMutexLocker locker(&state.mutex);
+    state.hasBase = hasBase;
+    state.pending = JournalChanges{};
+}
+
+std::optional<MapData::JournalChanges> MapData::takeJournalChanges()
+{
+    JournalState &state = m_journalState;
+    QMutexLocker locker(&state.mutex);
+    if (!state.hasBase)
+        return std::nullopt;
+    return std::exchange(state.pending, JournalChanges{});
+}
+
+void MapData::restoreJournalChanges(const JournalChanges &changes)
+{
+    JournalState &state = m_journalState;
+    QMutexLocker locker(&state.mutex);
+    if (!state.hasBase)
+        return;
+    state.pending.rooms.insert(changes.rooms.begin(), changes.rooms.end());
+    state.pending.marks = state.pending.marks || changes.marks;
+}
+
+// Past this point it's cheaper to rebuild the text index than to re-check every changed room.
+static constexpr const size_t MAX_TEXT_DIRTY_ROOMS = 1024;
+
+void MapData::markTextDirty(const RoomId *const ids, const size_t count)
+{
+    TextIndexState &state = m_textIndexState;
+    QMutexLocker locker(&state.mutex);
+    // Keep recording while a rebuild runs, but don't bother once the next
+    // query is going to rebuild anyway.
+    for (size_t i = 0; i < count && state.dirty.size() <= MAX_TEXT_DIRTY_ROOMS; ++i)
+        state.dirty.insert(ids[i]);
+}
+
+MemoryUsage MapData::getMemoryUsage()
+{
+    MemoryUsage usage;
+    addMemoryUsage(usage);
+    {
+        // The history is only changed with the write lock held.
+        MapReadLocker locker(mapLock);
+        const auto [edits, bytes] = m_editHistory.getMemoryUsage();
+        usage.add("undo history", edits, bytes);
+    }
+
+    // Its rooms are frozen clones that share their strings with the live ones.
+    SharedMapSnapshot snapshot;
+    {
+        QMutexLocker locker(&m_snapshotState.mutex);
+        snapshot = m_snapshotState.last;
+    }
+    if (snapshot != nullptr) {
+        size_t bytes = snapshot->getRooms().capacity() * sizeof(SharedConstRoom);
+        size_t numRooms = 0;
+        snapshot->forEach([&usage, &bytes, &numRooms](const Room &room) {
+            if (usage.isFirstReference(&room)) {
+                bytes += sizeof(Room);
+                ++numRooms;
+            }
+        });
+        usage.add("map snapshot", numRooms, bytes);
+    }
+
+    usage.add("infomarks", 0, m_markers.capacity() * sizeof(std::shared_ptr<InfoMark>));
+    for (const auto &mark : m_markers) {
+        usage.add("infomarks", 1, sizeof(InfoMark));
+        usage.addSharedString(mark->getText().getSharedString());
+    }
+    return usage;
+}
+
+std::optional<std::vector<RoomId>> MapData::getTextSearchCandidates(const RoomFilter &f)
+{
+    TextIndexState &state = m_textIndexState;
+    const auto tryGet = [&state]() -> std::pair<SharedRoomTextIndex, RoomIdSet> {
+        QMutexLocker locker(&state.mutex);
+        if (state.index == nullptr || state.dirty.size() > MAX_TEXT_DIRTY_ROOMS)
+            return {};
+        return {state.index, state.dirty};
+    };
+
+    auto [index, dirty] = tryGet();
+    if (index == nullptr) {
+        QMutexLocker buildLocker(&state.buildMutex);
+        std::tie(index, dirty) = tryGet();
+        if (index == nullptr) {
+            {
+                // Changes from here on are in the snapshot, in the dirty set, or both.
+                QMutexLocker locker(&state.mutex);
+                state.index.reset();
+                state.dirty.clear();
+            }
+            index = RoomTextIndex::build(deref(getSnapshot()));
+            QMutexLocker locker(&state.mutex);
+            state.index = index;
+            dirty = state.dirty;
+        }
+    }
+
+    std::optional<RoomTextIndex::Postings> postings = index->getCandidates(f);
+    if (!postings)
+        return std::nullopt;
+
+    std::vector<RoomId> result;
+    result.reserve(postings->size() + dirty.size());
+    auto it = dirty.begin();
+    for (const uint32_t id : *postings) {
+        for (; it != dirty.end() && it->asUint32() < id; ++it)
+            result.emplace_back(*it);
+        if (it != dirty.end() && it->asUint32() == id)
+            ++it;
+        result.emplace_back(RoomId{id});
+    }
+    result.insert(result.end(), it, dirty.end());
+    return result;
+}
+
+bool MapData::searchSnapshot(const MapSnapshot &snapshot,
+                             const RoomFilter &f,
+                             const std::function<void(RoomId)> &onMatch,
+                             const std::function<bool()> &isCancelled)
+{
+    static constexpr const size_t CANCEL_POLL_INTERVAL = 1024;
+    size_t visited = 0;
+    const auto visit = [&](const Room *const room) -> bool {
+        if (++visited % CANCEL_POLL_INTERVAL == 0 && isCancelled && isCancelled())
+            return false;
+        if (room != nullptr && f.filter(room))
+            onMatch(room->getId());
+        return true;
+    };
+
+    if (const auto candidates = getTextSearchCandidates(f)) {
+        for (const RoomId id : *candidates)
+            if (!visit(snapshot.getRoom(id)))
+                return false;
+    } else {
+        for (const SharedConstRoom &room : snapshot.getRooms())
+            if (!visit(room.get()))
+                return false;
+    }
+    return true;
+}
+
+void MapData::markSnapshotDirty(const RoomId *const ids, const size_t count)
+{
+    // Past this point it's cheaper to rebuild the next snapshot from scratch.
+    static constexpr const size_t MAX_TRACKED_DIRTY_ROOMS = 4096;
+
+    SnapshotState &state = m_snapshotState;
+    QMutexLocker locker(&state.mutex);
+    ++state.generation;
+    for (size_t i = 0; i < count && !state.allDirty; ++i) {
+        if (ids[i] == INVALID_ROOMID)
             continue;
-        locks[room->getId()].insert(recipient);
-        recipient->receiveRoom(this, r);
+        state.dirty.insert(ids[i]);
+        if (state.dirty.size() > MAX_TRACKED_DIRTY_ROOMS) {
+            state.allDirty = true;
+            state.dirty.clear();
+        }
+    }
+}
+
+void MapData::resetSnapshot()
+{
+    SnapshotState &state = m_snapshotState;
+    QMutexLocker locker(&state.mutex);
+    ++state.generation;
+    state.last.reset();
+    state.dirty.clear();
+    state.allDirty = true;
+    markRoutingDirty();
+    {
+        MeshState &mesh = m_meshState;
+        QMutexLocker meshLocker(&mesh.mutex);
+        mesh.dirty.clear();
+        mesh.allDirty = true;
+    }
+    {
+        TextIndexState &text = m_textIndexState;
+        QMutexLocker textLocker(&text.mutex);
+        text.index.reset();
+        text.dirty.clear();
+    }
+}
+
+SharedMapSnapshot MapData::getSnapshot()
+{
+    MapReadLocker locker(mapLock);
+    SnapshotState &state = m_snapshotState;
+    QMutexLocker snapshotLocker(&state.mutex);
+    if (state.last != nullptr && state.last->getGeneration() == state.generation)
+        return state.last;
+
+    const MapSnapshot *const prev = state.allDirty ? nullptr : state.last.get();
+    const RoomIdSet &dirty = state.dirty;
+    state.last = MapSnapshot::build(state.generation, roomIndex, prev, [&dirty](const RoomId id) {
+        return dirty.find(id) != dirty.end();
+    });
+    state.dirty.clear();
+    state.allDirty = false;
+    return state.last;
+}
+
+SharedRoutingGraph MapData::getRoutingGraph(const SharedMapSnapshot &snapshot,
+                                            const RoutingProfileEnum profile)
+{
+    RoutingState &state = m_routingState;
+    QMutexLocker routingLocker(&state.mutex);
+    RoutingState::Profile &built = state.profiles[profile];
+    const uint64_t ofSnapshot = deref(snapshot).getGeneration();
+    if (built.graph != nullptr && built.builtSnapshot == ofSnapshot)
+        return built.graph;
+
+    // Whether nothing routing cares about changed since the graph was built is
+    // only known for the current snapshot. Read the generation before checking,
+    // so a modification that races with this leaves the result marked stale.
+    const uint64_t generation = state.generation.load();
+    const bool isCurrent = getSnapshot() == snapshot;
+    if (built.graph != nullptr && isCurrent && built.builtGeneration == generation) {
+        built.builtSnapshot = ofSnapshot;
+        return built.graph;
     }
+
+    built.graph = RoutingGraph::build(*snapshot, profile);
+    built.builtGeneration = isCurrent ? generation : 0;
+    built.builtSnapshot = ofSnapshot;
+    return built.graph;
+}
+
+SharedRoutingHierarchy MapData::getRoutingHierarchy(const SharedMapSnapshot &snapshot,
+                                                    const RoutingProfileEnum profile)
+{
+    const SharedRoutingGraph graph = getRoutingGraph(snapshot, profile);
+    RoutingState &state = m_routingState;
+    QMutexLocker routingLocker(&state.mutex);
+    SharedRoutingHierarchy &hierarchy = state.profiles[profile].hierarchy;
+    if (hierarchy == nullptr || &hierarchy->getGraph() != graph.get())
+        hierarchy = RoutingHierarchy::build(graph, hierarchy.get());
+    return hierarchy;
 }
 
 MapData::~MapData() = default;
@@ -256,14 +916,69 @@ void MapData::removeMarker(const std::shared_ptr<InfoMark> &im)
             return target == im;
         });
         if (it != m_markers.end()) {
+            markMarkerMeshDirty(*im);
+            m_markerIndex.remove(*im);
             m_markers.erase(it);
-            setDataChanged();
+            markJournalMarksDirty();
+            onModified();
         }
     }
 }
 
+SharedMapDigest MapData::getMapDigest()
+{
+    const SharedMapSnapshot snapshot = getSnapshot();
+    DigestState &state = m_digestState;
+    QMutexLocker locker(&state.mutex);
+    if (state.last == nullptr || state.last->getGeneration() != snapshot->getGeneration()
+        || (state.identity != 0 && state.last->getMapIdentity() != state.identity))
+        state.last = MapDigest::build(snapshot, state.last.get(), state.identity);
+    state.identity = state.last->getMapIdentity();
+    return state.last;
+}
+
+void MapData::setMapIdentity(const uint64_t identity)
+{
+    DigestState &state = m_digestState;
+    QMutexLocker locker(&state.mutex);
+    state.identity = identity;
+}
+
+void MapData::slot_applySyncedRooms(const QByteArray &data)
+{
+    const auto synced = decodeSyncedRooms(data);
+    if (!synced.has_value()) {
+        emit log("MapData", "Ignored synced rooms that couldn't be read.");
+        return;
+    }
+    // Rooms with the same id are only the same room in copies of the same map.
+    if (synced->mapIdentity != getMapIdentity()) {
+        emit log("MapData", "Ignored synced rooms from a map that isn't a copy of this one.");
+        return;
+    }
+
+    MapWriteLocker locker(mapLock);
+    const SyncTarget target = buildSyncTarget(roomIndex, synced.value());
+    MapEditHistory::SharedEdit edit = MapEditHistory::diff(roomIndex, target.rooms);
+    const size_t numChanged = edit->rooms.size();
+    if (numChanged != 0) {
+        // Recorded like any other edit, so the sync can be undone.
+        RestoreRoomFields action{std::move(edit), MapEditDirectionEnum::REDO};
+        action.schedule(this);
+        std::ignore = executeLocked(action, nullptr, EditHistoryEnum::RECORD);
+    }
+    // Rooms are only updated, never added or removed.
+    emit log("MapData",
+             QString("Compared %1 room(s) that both maps have with the group's, and updated "
+                     "%2 room(s) here; %3 room(s) that only the group has were left out.")
+                 .arg(target.numSynced)
+                 .arg(numChanged)
+                 .arg(target.numOnlyThere));
+}
+
 void MapData::removeMarkers(const MarkerList &toRemove)
 {
+    const DataChangedBatch batch{*this};
     // If toRemove is short, this is probably "good enough." However, it may become
     // very painful if both toRemove.size() and m_markers.size() are in the thousands.
     for (const auto &im : toRemove) {
@@ -275,6 +990,9 @@ void MapData::addMarker(const std::shared_ptr<InfoMark> &im)
 {
     if (im != nullptr) {
         m_markers.emplace_back(im);
-        setDataChanged();
+        m_markerIndex.insert(*im);
+        markMarkerMeshDirty(*im);
+        markJournalMarksDirty();
+        onModified();
     }
 }
@@ -5,22 +5,41 @@
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
+#include <optional>
+#include <set>
+#include <utility>
 #include <vector>
+#include <QByteArray>
 #include <QList>
+#include <QMutex>
 #include <QString>
 #include <QVariant>
 #include <QtCore>
 #include <QtGlobal>
 
 #include "../expandoracommon/coordinate.h"
+#include "../global/EnumIndexedArray.h"
+#include "../global/MemoryUsage.h"
 #include "../global/roomid.h"
 #include "../mapfrontend/mapfrontend.h"
 #include "../opengl/OpenGL.h"
 #include "../parser/CommandId.h"
 #include "../parser/CommandQueue.h"
 #include "ExitDirection.h"
+#include "InfoMarkIndex.h"
+#include "MapDiff.h"
+#include "MapDigest.h"
+#include "MapEditHistory.h"
+#include "MapSnapshot.h"
+#include "RoomTextIndex.h"
+#include "RoutingGraph.h"
+#include "RoutingHierarchy.h"
+#include "RoutingProfile.h"
 #include "mmapper2exit.h"
 #include "mmapper2room.h"
 #include "roomfilter.h"
@@ -31,7 +50,6 @@ class AbstractAction;
 class ExitFieldVariant;
 class InfoMark;
 class MapAction;
-class MapCanvasRoomDrawer;
 class QObject;
 class Room;
 class RoomFieldVariant;
@@ -51,14 +69,22 @@ class MapData final : public MapFrontend
     // the room will be inserted in the given selection. the selection must have been created by mapdata
     const Room *getRoom(const Coordinate &pos, RoomSelection &in);
     const Room *getRoom(RoomId id, RoomSelection &in);
+    // True unless moving the rooms by the offset would land one of them on a room
+    // that isn't selected.
+    bool isMovable(const RoomSelection &selection, const Coordinate &offset) const;
 
 public:
     explicit MapData(QObject *parent = nullptr);
     virtual ~MapData() override;
 
-    void generateBatches(MapCanvasRoomDrawer &screen, const OptBounds &bounds);
-
     bool execute(std::unique_ptr<MapAction> action, const SharedRoomSelection &unlock);
+    // Undo and redo the edits made by execute(); `unlock` may be null. These return
+    // false if there's nothing to undo (or redo), or if its rooms are locked. If its
+    // rooms were changed since without being logged, the history is cleared instead.
+    bool undo(const SharedRoomSelection &unlock);
+    bool redo(const SharedRoomSelection &unlock);
+    bool canUndo() const { return m_editHistory.canUndo(); }
+    bool canRedo() const { return m_editHistory.canRedo(); }
 
     const Coordinate &getPosition() const { return m_position; }
     const MarkerList &getMarkersList() const { return m_markers; }
@@ -70,20 +96,50 @@ class MapData final : public MapFrontend
     void addMarker(const std::shared_ptr<InfoMark> &im);
     void removeMarker(const std::shared_ptr<InfoMark> &im);
     void removeMarkers(const MarkerList &toRemove);
+    // Finds the markers of an area without looking at all of them.
+    const InfoMarkIndex &getMarkerIndex() const { return m_markerIndex; }
+    // Returns and forgets the home cells (see InfoMarkIndex) of the markers that
+    // changed since the last call, or nothing if the meshes all have to be rebuilt.
+    std::optional<std::set<InfoMarkIndex::CellId>> takeMarkerMeshChanges();
 
     bool isEmpty() const { return (greatestUsedId == INVALID_ROOMID) && m_markers.empty(); }
     bool dataChanged() const { return m_dataChanged; }
     QList<Coordinate> getPath(const Coordinate &start, const CommandQueue &dirs);
     virtual void clear() override;
+    // Replaces this map with one that was loaded into `staging` (e.g. on a worker
+    // thread), taking over its rooms and markers without copying them. Afterwards,
+    // `staging` holds nothing but this map's old rooms, and should be destroyed.
+    void adoptLoadedMap(MapData &staging);
+    // Merges in another copy of the same world that was loaded into `other` (see MapDiff):
+    // their rooms at new positions are added, and rooms that they changed take their fields
+    // and exits, except our notes. Nothing is removed, and their markers are taken unless
+    // the same one is already here. Like a load, this clears the undo log.
+    MapDiff mergeMap(MapData &other);
 
     // search for matches
     void genericSearch(RoomRecipient *recipient, const RoomFilter &f);
 
-    void shortestPathSearch(const Room *origin,
+    // These run on a snapshot, so they may be called from any thread; they poll
+    // isCancelled (if set) and return early once it reports true.
+    void shortestPathSearch(RoomId origin,
                             ShortestPathRecipient *recipient,
                             const RoomFilter &f,
+                            RoutingProfileEnum profile,
                             int max_hits = -1,
-                            double max_dist = 0);
+                            double max_dist = 0,
+                            const std::function<bool()> &isCancelled = {});
+    // goal-directed (A*) search for a single known room
+    void shortestPathSearch(RoomId origin,
+                            ShortestPathRecipient *recipient,
+                            RoomId target,
+                            RoutingProfileEnum profile,
+                            const std::function<bool()> &isCancelled = {});
+    // Calls onMatch for each room of the snapshot that `f` matches, in id order;
+    // returns false if it was cancelled.
+    bool searchSnapshot(const MapSnapshot &snapshot,
+                        const RoomFilter &f,
+                        const std::function<void(RoomId)> &onMatch,
+                        const std::function<bool()> &isCancelled = {});
 
     // Used in Console Commands
     void removeDoorNames();
@@ -98,6 +154,22 @@ class MapData final : public MapFrontend
     const QString &getFileName() const { return m_fileName; }
     bool isFileReadOnly() const { return m_fileReadOnly; }
 
+public:
+    // What changed since the map file (plus its journal) was last written.
+    struct JournalChanges final
+    {
+        // Modified, added or removed rooms.
+        RoomIdSet rooms;
+        bool marks = false;
+    };
+    // Starts tracking changes against the map file; pass false if the map no
+    // longer matches any file that a journal could be appended to.
+    void resetJournal(bool hasBase);
+    // Returns and forgets the pending changes, or nothing if there's no base file.
+    std::optional<JournalChanges> takeJournalChanges();
+    // Puts changes back after they failed to be written.
+    void restoreJournalChanges(const JournalChanges &changes);
+
 public:
     bool getExitFlag(const Coordinate &pos, ExitDirEnum dir, ExitFieldVariant var);
     ExitDirections getExitDirections(const Coordinate &pos);
@@ -105,27 +177,247 @@ class MapData final : public MapFrontend
 public:
     const Room *getRoom(const Coordinate &pos);
 
+public:
+    // Holds the read lock and the room at a position, so that several questions about
+    // the same room take the lock and look the room up once. The room may be null; it
+    // (and everything it returns) is only valid while the handle exists, so keep it short.
+    class NODISCARD RoomReadHandle final
+    {
+    private:
+        MapReadLocker m_locker;
+        const Room *const m_room;
+
+    public:
+        explicit RoomReadHandle(MapData &data, const Coordinate &pos);
+        DELETE_CTORS_AND_ASSIGN_OPS(RoomReadHandle);
+
+    public:
+        NODISCARD const Room *getRoom() const { return m_room; }
+        NODISCARD explicit operator bool() const { return m_room != nullptr; }
+
+    public:
+        // "exit" if there's no room or no such exit.
+        NODISCARD const DoorName &getDoorName(ExitDirEnum dir) const;
+        NODISCARD bool getExitFlag(ExitDirEnum dir, const ExitFieldVariant &var) const;
+        NODISCARD ExitDirections getExitDirections() const;
+    };
+
+    NODISCARD RoomReadHandle readRoom(const Coordinate &pos) { return RoomReadHandle{*this, pos}; }
+
+public:
+    // Returns an immutable copy of the room table that can be read without holding
+    // any lock. This is cheap if nothing changed since the previous call.
+    SharedMapSnapshot getSnapshot();
+    // Returns and forgets the rooms whose meshes changed, or nothing if there
+    // were too many of them to track. Call this before getSnapshot(), so the
+    // snapshot includes every change that was returned.
+    std::optional<RoomIdSet> takeMeshChanges();
+    // Returns the routing graph of `snapshot` with the profile's costs; the last one
+    // is reused if no exits, terrain or positions changed between its snapshot and
+    // this one.
+    SharedRoutingGraph getRoutingGraph(const SharedMapSnapshot &snapshot,
+                                       RoutingProfileEnum profile);
+    // Returns the zone-level hierarchy over the routing graph of `snapshot`; zones
+    // that didn't change are carried over from the previous one.
+    SharedRoutingHierarchy getRoutingHierarchy(const SharedMapSnapshot &snapshot,
+                                               RoutingProfileEnum profile);
+    // Returns the hashes that group members compare to sync their maps; rooms that didn't
+    // change since the last call keep their hashes. Safe to call from any thread.
+    SharedMapDigest getMapDigest();
+    // What tells copies of this map apart from other maps, whose room ids mean something
+    // else: it's saved with the map, and a map that doesn't have one yet (e.g. one loaded
+    // from an older file) takes the root hash of its rooms, so copies of a file agree on it.
+    // Safe to call from any thread.
+    NODISCARD uint64_t getMapIdentity() { return getMapDigest()->getMapIdentity(); }
+    void setMapIdentity(uint64_t identity);
+    // Returns the sorted ids of every room that `f` could match, or nothing if
+    // `f` can't use the text index and every room has to be checked.
+    std::optional<std::vector<RoomId>> getTextSearchCandidates(const RoomFilter &f);
+    // Estimates the memory held by the rooms, their indexes, the latest snapshot, the
+    // undo history and the markers.
+    MemoryUsage getMemoryUsage();
+
+private:
+    struct SnapshotState final
+    {
+        QMutex mutex;
+        uint64_t generation = 1;
+        SharedMapSnapshot last;
+        RoomIdSet dirty;
+        bool allDirty = true;
+    };
+    SnapshotState m_snapshotState;
+
+    struct RoutingState final
+    {
+        QMutex mutex;
+        // Bumped without the mutex, since modifications arrive under the map lock.
+        std::atomic<uint64_t> generation{1};
+        // Each profile's graph is only built once a route is searched with it.
+        struct Profile final
+        {
+            // The generation the graph is known to be up to date with, or 0.
+            uint64_t builtGeneration = 0;
+            // The snapshots' own generations, which are never 0.
+            uint64_t builtSnapshot = 0;
+            SharedRoutingGraph graph;
+            SharedRoutingHierarchy hierarchy;
+        };
+        EnumIndexedArray<Profile, RoutingProfileEnum> profiles;
+    };
+    RoutingState m_routingState;
+
+    struct DigestState final
+    {
+        QMutex mutex;
+        SharedMapDigest last;
+        // 0 until the map is given one or a digest is first built.
+        uint64_t identity = 0;
+    };
+    DigestState m_digestState;
+
+    void markRoutingDirty() { ++m_routingState.generation; }
+
+    struct TextIndexState final
+    {
+        QMutex mutex;
+        // Serializes rebuilds; never taken while modifications are reported.
+        QMutex buildMutex;
+        SharedRoomTextIndex index;
+        // Rooms whose text changed since the index was built.
+        RoomIdSet dirty;
+    };
+    TextIndexState m_textIndexState;
+
+    void markTextDirty(const RoomId *ids, size_t count);
+    void markTextDirty(const RoomId id) { markTextDirty(&id, 1); }
+
+    struct JournalState final
+    {
+        QMutex mutex;
+        bool hasBase = false;
+        JournalChanges pending;
+    };
+    JournalState m_journalState;
+
+    void markJournalDirty(const RoomId *ids, size_t count);
+    void markJournalDirty(const RoomId id) { markJournalDirty(&id, 1); }
+    void markJournalMarksDirty();
+
+    struct MeshState final
+    {
+        QMutex mutex;
+        // Rooms whose meshes changed since the batches were last generated.
+        RoomIdSet dirty;
+        bool allDirty = true;
+    };
+    MeshState m_meshState;
+
+    void markMeshDirty(const RoomId *ids, size_t count);
+    void markMeshDirty(const RoomId id) { markMeshDirty(&id, 1); }
+
+    // Markers are only changed on the GUI thread, so this doesn't need a mutex.
+    struct MarkerMeshState final
+    {
+        std::set<InfoMarkIndex::CellId> dirty;
+        bool allDirty = true;
+    };
+    MarkerMeshState m_markerMeshState;
+
+    // Only used with the write lock held.
+    MapEditHistory m_editHistory;
+
+    enum class EditHistoryEnum { RECORD, SKIP };
+    bool executeLocked(MapAction &action, RoomSelection *unlock, EditHistoryEnum history);
+    bool restoreLocked(MapEditDirectionEnum direction, RoomSelection *unlock);
+
+    void markMarkerMeshDirty(const InfoMark &mark);
+
+    void markSnapshotDirty(const RoomId *ids, size_t count);
+    void markSnapshotDirty(const RoomId id) { markSnapshotDirty(&id, 1); }
+    void resetSnapshot();
+    void virt_onRoomRemoved(RoomId id) override
+    {
+        markSnapshotDirty(id);
+        markMeshDirty(id);
+        markRoutingDirty();
+        markJournalDirty(id);
+    }
+
 private:
     // REVISIT: This might be the equivalent of blocking Qt signals.
     bool m_ignoreModifications = false;
-    void virt_onNotifyModified(Room &room, const RoomUpdateFlags updateFlags) override
+    bool m_modifiedDuringBatch = false;
+    int m_dataChangedBatchDepth = 0;
+    void virt_onRoomsModified(
+        const std::vector<std::pair<RoomId, RoomUpdateFlags>> &updates) override
     {
-        RoomModificationTracker::virt_onNotifyModified(room, updateFlags);
-        if (!m_ignoreModifications) {
-            setDataChanged();
-        }
+        MapFrontend::virt_onRoomsModified(updates);
+        markRoomsDirty(updates.data(), updates.size());
+        onModified();
     }
+    void markRoomsDirty(const std::pair<RoomId, RoomUpdateFlags> *updates, size_t count);
     void virt_onNotifyModified(InfoMark &mark, const InfoMarkUpdateFlags updateFlags) override
     {
         InfoMarkModificationTracker::virt_onNotifyModified(mark, updateFlags);
-        if (!m_ignoreModifications) {
+        markJournalMarksDirty();
+        // Markers that haven't been added yet (e.g. while loading) aren't indexed.
+        if (m_markerIndex.contains(mark)) {
+            markMarkerMeshDirty(mark);
+            m_markerIndex.update(mark);
+            markMarkerMeshDirty(mark);
+        }
+        onModified();
+    }
+    void onModified()
+    {
+        if (m_ignoreModifications) {
+            return;
+        }
+        if (isInModificationBatch() || m_dataChangedBatchDepth > 0) {
+            m_modifiedDuringBatch = true;
+            return;
+        }
+        setDataChanged();
+    }
+    void virt_onModificationBatchFinished() override { onBatchFinished(); }
+    void onBatchFinished()
+    {
+        if (isInModificationBatch() || m_dataChangedBatchDepth > 0) {
+            return;
+        }
+        if (std::exchange(m_modifiedDuringBatch, false)) {
             setDataChanged();
         }
     }
 
+public:
+    // Like ModificationBatch, but for changes made without the map lock (e.g. to the
+    // markers): onDataChanged() is emitted at most once, when the outermost one ends.
+    class NODISCARD DataChangedBatch final
+    {
+    private:
+        MapData &m_data;
+
+    public:
+        explicit DataChangedBatch(MapData &data)
+            : m_data{data}
+        {
+            ++m_data.m_dataChangedBatchDepth;
+        }
+        ~DataChangedBatch()
+        {
+            assert(m_data.m_dataChangedBatchDepth > 0);
+            --m_data.m_dataChangedBatchDepth;
+            m_data.onBatchFinished();
+        }
+        DELETE_CTORS_AND_ASSIGN_OPS(DataChangedBatch);
+    };
+
 signals:
     void log(const QString &, const QString &);
     void onDataChanged();
+    void sig_editHistoryChanged(bool canUndo, bool canRedo);
 
 public slots:
     void unsetDataChanged() { m_dataChanged = false; }
@@ -139,9 +431,18 @@ public slots:
     {
         MapFrontend::scheduleAction(action);
     }
+    void slot_scheduleActions(const std::vector<std::shared_ptr<MapAction>> &actions)
+    {
+        MapFrontend::scheduleActions(actions);
+    }
+    // Rooms from a group member's copy of this map (see MapDigest) replace the ones with the
+    // same ids, keeping their notes unless the member shared theirs; rooms are never added
+    // or removed, and rooms from any other map are rejected. See buildSyncTarget().
+    void slot_applySyncedRooms(const QByteArray &data);
 
 protected:
     MarkerList m_markers;
+    InfoMarkIndex m_markerIndex;
     // changed data?
     bool m_dataChanged = false;
     bool m_fileReadOnly = false;
@@ -11,14 +11,21 @@
 
 class Room;
 
+// Names, static descriptions and notes repeat across many rooms, so they're interned.
 struct RoomNameTag final
-{};
+{
+    static constexpr const bool is_interned = true;
+};
 struct RoomDynamicDescTag final
 {};
 struct RoomStaticDescTag final
-{};
+{
+    static constexpr const bool is_interned = true;
+};
 struct RoomNoteTag final
-{};
+{
+    static constexpr const bool is_interned = true;
+};
 
 using RoomName = TaggedString<RoomNameTag>;
 using RoomDynamicDesc = TaggedString<RoomDynamicDescTag>;
@@ -5,7 +5,8 @@
 #include "roomfilter.h"
 
 #include <optional>
-#include <regex>
+#include <string>
+#include <vector>
 
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
@@ -19,39 +20,95 @@
 #include "enums.h"
 #include "mmapper2room.h"
 
-static std::regex createRegex(const std::string &input, const Qt::CaseSensitivity cs)
+// Room text is matched byte-wise, so only ASCII letters fold; this is what
+// std::regex::icase did for the same input.
+static char foldCase(const char c)
 {
-    // TODO: Switch from std::regex::exteneded to std::regex::multiline once GCC supports it
-    auto options = std::regex::nosubs | std::regex::optimize | std::regex::extended;
-    if (cs == Qt::CaseInsensitive)
-        options |= std::regex_constants::icase;
-    const std::string pattern = [&input, &options]() -> std::string {
-        if (input.empty())
-            return R"(^$)";
-
-        // REVISIT: Add another option to support regex where we do not santize the input
-
-        const auto escape_pattern = [&options]() {
-            // Prevent user input from being interpreted as a POSIX extended regex
-            if (options & std::regex::extended)
-                return R"([.[{}()*+?|^$])";
-            // ECMAScript escape pattern (unused)
-            return R"([-[\]{}()*+?.,\^$|#\s])";
-        };
-        static const std::regex escape(escape_pattern(), std::regex::optimize);
-        const std::string sanitized = std::regex_replace(input, escape, R"(\$&)");
-        return ".*" + sanitized + ".*";
-    }();
-    return std::regex(pattern, options);
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+static std::string createNeedle(const std::string &pattern, const Qt::CaseSensitivity cs)
+{
+    std::string needle = pattern;
+    if (cs == Qt::CaseInsensitive) {
+        for (char &c : needle)
+            c = foldCase(c);
+    }
+    return needle;
+}
+
+// Knuth-Morris-Pratt failure function: failure[i] is the length of the longest
+// proper prefix of needle[0..i] that is also a suffix of it.
+static std::vector<uint32_t> createFailureTable(const std::string &needle)
+{
+    std::vector<uint32_t> failure(needle.size(), 0);
+    uint32_t k = 0;
+    for (size_t i = 1; i < needle.size(); ++i) {
+        while (k > 0 && needle[i] != needle[k])
+            k = failure[k - 1];
+        if (needle[i] == needle[k])
+            ++k;
+        failure[i] = k;
+    }
+    return failure;
 }
 
 RoomFilter::RoomFilter(const std::string_view &sv,
                        const Qt::CaseSensitivity cs,
                        const PatternKindsEnum kind)
-    : m_regex(createRegex(ParserUtils::latin1ToAscii(sv), cs))
+    : m_pattern(ParserUtils::latin1ToAscii(sv))
+    , m_needle(createNeedle(m_pattern, cs))
+    , m_failure(createFailureTable(m_needle))
+    , m_cs(cs)
     , m_kind(kind)
+    , m_flagMask(compileFlagMask())
 {}
 
+RoomFlagSignature RoomFilter::compileFlagMask() const
+{
+    RoomFlagSignature mask;
+    if (m_kind != PatternKindsEnum::FLAGS && m_kind != PatternKindsEnum::ALL)
+        return mask;
+
+    const auto addMatching = [this, &mask](const auto &values) {
+        for (const auto value : values) {
+            if (matchesParserCommand(value))
+                mask.add(value);
+        }
+    };
+    addMatching(ALL_MOB_FLAGS);
+    addMatching(ALL_LOAD_FLAGS);
+    addMatching(ALL_DOOR_FLAGS);
+    addMatching(ALL_EXIT_FLAGS);
+    addMatching(DEFINED_ROOM_LIGHT_TYPES);
+    addMatching(DEFINED_ROOM_SUNDEATH_TYPES);
+    addMatching(DEFINED_ROOM_PORTABLE_TYPES);
+    addMatching(DEFINED_ROOM_RIDABLE_TYPES);
+    addMatching(DEFINED_ROOM_ALIGN_TYPES);
+    return mask;
+}
+
+bool RoomFilter::matches(const std::string_view &s) const
+{
+    // User input is always taken literally, so a linear-time substring search
+    // does the same job as the old ".*pattern.*" regex without its overhead.
+    const size_t n = m_needle.size();
+    if (n == 0)
+        return s.empty();
+    if (m_cs == Qt::CaseSensitive)
+        return s.find(m_needle) != std::string_view::npos;
+
+    size_t k = 0;
+    for (const char raw : s) {
+        const char c = foldCase(raw);
+        while (k > 0 && c != m_needle[k])
+            k = m_failure[k - 1];
+        if (c == m_needle[k] && ++k == n)
+            return true;
+    }
+    return false;
+}
+
 const char *const RoomFilter::parse_help
     = "Parse error; format is: [-(name|desc|dyndesc|note|exits|all|clear)] pattern\r\n";
 
@@ -127,22 +184,8 @@ bool RoomFilter::filter(const Room *const pr) const
             }
             return false;
 
-        case PatternKindsEnum::FLAGS: {
-            for (const auto &e : r.getExitsList()) {
-                if (this->matchesAny(e.getDoorFlags()) //
-                    || this->matchesAny(e.getExitFlags())) {
-                    return true;
-                }
-            }
-
-            return this->matchesAny(r.getMobFlags())            //
-                   || this->matchesAny(r.getLoadFlags())        //
-                   || this->matchesDefined(r.getLightType())    //
-                   || this->matchesDefined(r.getSundeathType()) //
-                   || this->matchesDefined(r.getPortableType()) //
-                   || this->matchesDefined(r.getRidableType())  //
-                   || this->matchesDefined(r.getAlignType());
-        }
+        case PatternKindsEnum::FLAGS:
+            return r.getFlagSignature().intersects(m_flagMask);
 
         case PatternKindsEnum::NONE:
             return false;
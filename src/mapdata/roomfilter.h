@@ -4,11 +4,12 @@
 // Author: 'Ethorondil' <ethorondil@gmail.com> (Elval)
 
 #include <cassert>
+#include <cstdint>
 #include <optional>
-#include <regex>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <vector>
 #include <QString>
 #include <QtCore>
 
@@ -33,12 +34,12 @@ class RoomFilter final
 public:
     bool filter(const Room *r) const;
     PatternKindsEnum patternKind() const { return m_kind; }
+    /// The search text (transliterated to ASCII); every match contains it, up to case.
+    const std::string &getPattern() const { return m_pattern; }
 
 private:
-    bool matches(const std::string_view &s) const
-    {
-        return std::regex_match(s.begin(), s.end(), m_regex);
-    }
+    /// True if s contains the pattern; an empty pattern only matches an empty s.
+    bool matches(const std::string_view &s) const;
 
 private:
     template<typename T>
@@ -58,22 +59,15 @@ class RoomFilter final
     }
 
 private:
-    template<typename F> // enum::Flags<...>
-    bool matchesAny(const F &flags) const
-    {
-        auto pred = [this](auto flag) -> bool { return this->matchesParserCommand(flag); };
-        return flags.find_first_matching(pred).has_value();
-    }
-
-private:
-    /// Note: Assumes enum E has value E::UNDEFINED.
-    template<typename E>
-    bool matchesDefined(const E type) const
-    {
-        return (type != E::UNDEFINED) && this->matchesParserCommand(type);
-    }
+    /// The flags whose names match the pattern, for PatternKindsEnum::FLAGS.
+    RoomFlagSignature compileFlagMask() const;
 
 private:
-    const std::regex m_regex;
+    const std::string m_pattern;
+    // Case-folded (if insensitive) copy of m_pattern, and its KMP failure table.
+    const std::string m_needle;
+    const std::vector<uint32_t> m_failure;
+    const Qt::CaseSensitivity m_cs;
     const PatternKindsEnum m_kind;
+    const RoomFlagSignature m_flagMask;
 };
@@ -7,6 +7,7 @@
 
 #include <cassert>
 #include <memory>
+#include <stdexcept>
 
 #include "../expandoracommon/room.h"
 #include "mapdata.h"
@@ -48,24 +49,43 @@ void RoomSelection::receiveRoom(RoomAdmin *const admin, const Room *const aRoom)
     insert(aRoom->getId(), aRoom);
 }
 
+void RoomSelection::receiveRooms(RoomAdmin *const admin, const std::vector<const Room *> &rooms)
+{
+    assert(admin == &m_mapData);
+    const size_t capacity = size() + rooms.size();
+    m_ids.reserve(capacity);
+    m_rooms.reserve(capacity);
+    m_positions.reserve(capacity);
+    for (const Room *const room : rooms)
+        insert(room->getId(), room);
+}
+
 RoomSelection::~RoomSelection()
 {
     // Remove the lock within the map
-    for (auto i = cbegin(); i != cend(); i++) {
-        m_mapData.releaseRoom(*this, i.key());
+    for (const RoomId id : m_ids) {
+        m_mapData.releaseRoom(*this, id);
     }
 }
 
+const Room *RoomSelection::find(const RoomId id) const
+{
+    const auto it = m_positions.find(id);
+    return (it == m_positions.end()) ? nullptr : m_rooms[it->second];
+}
+
 const Room *RoomSelection::getFirstRoom() const noexcept(false)
 {
-    if (isEmpty())
+    if (empty())
         throw std::runtime_error("empty");
-    return first();
+    return m_rooms.front();
 }
 
 RoomId RoomSelection::getFirstRoomId() const noexcept(false)
 {
-    return getFirstRoom()->getId();
+    if (empty())
+        throw std::runtime_error("empty");
+    return m_ids.front();
 }
 
 const Room *RoomSelection::getRoom(const RoomId targetId)
@@ -84,18 +104,45 @@ void RoomSelection::unselect(const RoomId targetId)
     remove(targetId);
 }
 
-bool RoomSelection::isMovable(const Coordinate &offset) const
+void RoomSelection::insert(const RoomId id, const Room *const room)
 {
-    for (auto i = cbegin(); i != cend(); i++) {
-        const Coordinate target = i.value()->getPosition() + offset;
-        RoomSelection tmpSel = RoomSelection(m_mapData);
-        if (const Room *const other = tmpSel.getRoom(target)) {
-            if (!contains(other->getId())) {
-                return false;
-            }
-        }
+    const auto [it, inserted] = m_positions.emplace(id, m_rooms.size());
+    if (!inserted) {
+        m_rooms[it->second] = room;
+        return;
     }
-    return true;
+    m_ids.emplace_back(id);
+    m_rooms.emplace_back(room);
+}
+
+void RoomSelection::remove(const RoomId id)
+{
+    const auto it = m_positions.find(id);
+    if (it == m_positions.end())
+        return;
+
+    // The last room takes its place.
+    const size_t pos = it->second;
+    m_positions.erase(it);
+    if (pos + 1 != m_ids.size()) {
+        m_ids[pos] = m_ids.back();
+        m_rooms[pos] = m_rooms.back();
+        m_positions[m_ids[pos]] = pos;
+    }
+    m_ids.pop_back();
+    m_rooms.pop_back();
+}
+
+void RoomSelection::clear()
+{
+    m_ids.clear();
+    m_rooms.clear();
+    m_positions.clear();
+}
+
+bool RoomSelection::isMovable(const Coordinate &offset) const
+{
+    return m_mapData.isMovable(*this, offset);
 }
 
 void RoomSelection::genericSearch(const RoomFilter &f)
@@ -4,8 +4,10 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
+#include <cstddef>
 #include <memory>
-#include <QMap>
+#include <unordered_map>
+#include <vector>
 
 #include "../expandoracommon/MmQtHandle.h"
 #include "../expandoracommon/RoomRecipient.h"
@@ -23,13 +25,26 @@ class Room;
 class RoomAdmin;
 class Coordinate;
 class MapData;
-class NODISCARD RoomSelection final : public QMap<RoomId, const Room *>, public RoomRecipient
+/// The selected rooms, each locked by the selection until it's unselected or the
+/// selection is destroyed.
+///
+/// The rooms are kept in the order they were selected, in a flat array that is
+/// indexed by id, so large selections are cheap to build, test and walk.
+class NODISCARD RoomSelection final : public RoomRecipient
 {
+public:
+    using const_iterator = std::vector<const Room *>::const_iterator;
+
 public:
     void receiveRoom(RoomAdmin *admin, const Room *aRoom) override;
+    void receiveRooms(RoomAdmin *admin, const std::vector<const Room *> &rooms) override;
 
 private:
     MapData &m_mapData;
+    // Parallel arrays; m_positions maps each id to its index in both.
+    std::vector<RoomId> m_ids;
+    std::vector<const Room *> m_rooms;
+    std::unordered_map<RoomId, size_t> m_positions;
 
 public:
     explicit RoomSelection(MapData &mapData);
@@ -37,6 +52,16 @@ class NODISCARD RoomSelection final : public QMap<RoomId, const Room *>, public
     explicit RoomSelection(MapData &mapData, const Coordinate &min, const Coordinate &max);
     ~RoomSelection() override;
 
+public:
+    NODISCARD const_iterator begin() const { return m_rooms.cbegin(); }
+    NODISCARD const_iterator end() const { return m_rooms.cend(); }
+    NODISCARD size_t size() const { return m_rooms.size(); }
+    NODISCARD bool empty() const { return m_rooms.empty(); }
+    NODISCARD bool contains(const RoomId id) const { return m_positions.count(id) != 0; }
+    /// nullptr unless the room is selected.
+    NODISCARD const Room *find(RoomId id) const;
+    NODISCARD const std::vector<RoomId> &getRoomIds() const { return m_ids; }
+
 public:
     const Room *getFirstRoom() const noexcept(false);
     RoomId getFirstRoomId() const noexcept(false);
@@ -46,6 +71,14 @@ class NODISCARD RoomSelection final : public QMap<RoomId, const Room *>, public
     const Room *getRoom(const Coordinate &coord);
     void unselect(RoomId targetId);
 
+private:
+    friend class MapData;
+    // MapData locks the room first.
+    void insert(RoomId id, const Room *room);
+    // MapData releases the locks itself.
+    void clear();
+    void remove(RoomId id);
+
 public:
     bool isMovable(const Coordinate &offset) const;
 
@@ -4,118 +4,65 @@
 
 #include "shortestpath.h"
 
-#include <memory>
-#include <type_traits>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <optional>
 #include <utility>
-#include <QBasicMutex>
-#include <QSet>
+#include <vector>
 #include <QVector>
 #include <queue>
 
-#include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
-#include "../global/enums.h"
 #include "../global/roomid.h"
+#include "../global/utils.h"
 #include "ExitDirection.h"
-#include "ExitFlags.h"
+#include "MapSnapshot.h"
+#include "MapZones.h"
+#include "RoutingGraph.h"
+#include "RoutingHierarchy.h"
 #include "mapdata.h"
-#include "mmapper2room.h"
 #include "roomfilter.h"
 
-// Movement costs per terrain type.
-// Same order as the RoomTerrainEnum enum.
-// Values taken from https://github.com/nstockton/tintin-mume/blob/master/mapperproxy/mapper/constants.py
-
 ShortestPathRecipient::~ShortestPathRecipient() = default;
 
-static double terrain_cost(const RoomTerrainEnum type)
-{
-    switch (type) {
-    case RoomTerrainEnum::UNDEFINED:
-        return 1.0; // undefined
-    case RoomTerrainEnum::INDOORS:
-        return 0.75; // indoors
-    case RoomTerrainEnum::CITY:
-        return 0.75; // city
-    case RoomTerrainEnum::FIELD:
-        return 1.5; // field
-    case RoomTerrainEnum::FOREST:
-        return 2.15; // forest
-    case RoomTerrainEnum::HILLS:
-        return 2.45; // hills
-    case RoomTerrainEnum::MOUNTAINS:
-        return 2.8; // mountains
-    case RoomTerrainEnum::SHALLOW:
-        return 2.45; // shallow
-    case RoomTerrainEnum::WATER:
-        return 50.0; // water
-    case RoomTerrainEnum::RAPIDS:
-        return 60.0; // rapids
-    case RoomTerrainEnum::UNDERWATER:
-        return 100.0; // underwater
-    case RoomTerrainEnum::ROAD:
-        return 0.85; // road
-    case RoomTerrainEnum::BRUSH:
-        return 1.5; // brush
-    case RoomTerrainEnum::TUNNEL:
-        return 0.75; // tunnel
-    case RoomTerrainEnum::CAVERN:
-        return 0.75; // cavern
-    case RoomTerrainEnum::DEATHTRAP:
-        return 1000.0; // deathtrap
-    }
-
-    return 1.0;
-}
-
-static double getLength(const Exit &e, const Room *curr, const Room *nextr)
-{
-    double cost = terrain_cost(nextr->getTerrainType());
-    auto flags = e.getExitFlags();
-    if (flags.isRandom() || flags.isDamage() || flags.isFall()) {
-        cost += 30;
-    }
-    if (flags.isDoor()) {
-        cost += 1;
-    }
-    if (flags.isClimb()) {
-        cost += 2;
-    }
-    if (nextr->getRidableType() == RoomRidableEnum::NOT_RIDABLE) {
-        cost += 3;
-        // One non-ridable room means walking two rooms, plus dismount/mount.
-        if (curr->getRidableType() != RoomRidableEnum::NOT_RIDABLE) {
-            cost += 4;
-        }
-    }
-    if (flags.isRoad()) { // Not sure if this is appropriate.
-        cost -= 0.1;
-    }
-    return cost;
-}
+// How many nodes to expand between polls of the cancellation callback.
+static constexpr const uint32_t CANCEL_POLL_INTERVAL = 1024;
 
-void MapData::shortestPathSearch(const Room *origin,
+void MapData::shortestPathSearch(const RoomId startId,
                                  ShortestPathRecipient *recipient,
                                  const RoomFilter &f,
+                                 const RoutingProfileEnum profile,
                                  int max_hits,
-                                 double max_dist)
+                                 double max_dist,
+                                 const std::function<bool()> &isCancelled)
 {
-    QMutexLocker locker(&mapLock);
+    // The search runs on a snapshot, so it doesn't hold up writers while it runs.
+    const SharedMapSnapshot snapshot = getSnapshot();
+    const SharedRoutingGraph graph = getRoutingGraph(snapshot, profile);
+    const Room *const start = snapshot->getRoom(startId);
+    if (start == nullptr || !graph->contains(startId))
+        return;
+
     QVector<SPNode> sp_nodes;
-    QSet<RoomId> visited;
+    std::vector<bool> visited(graph->getNumNodes(), false);
     std::priority_queue<std::pair<double, int>> future_paths;
-    sp_nodes.push_back(SPNode(origin, -1, 0, ExitDirEnum::UNKNOWN));
+    sp_nodes.push_back(SPNode(start, -1, 0, ExitDirEnum::UNKNOWN));
     future_paths.push(std::make_pair(0, 0));
+    uint32_t expanded = 0;
     while (!future_paths.empty()) {
+        if (isCancelled && ++expanded % CANCEL_POLL_INTERVAL == 0 && isCancelled()) {
+            return;
+        }
         int spindex = future_paths.top().second;
         future_paths.pop();
         const Room *thisr = sp_nodes[spindex].r;
         auto thisdist = sp_nodes[spindex].dist;
         auto room_id = thisr->getId();
-        if (visited.contains(room_id)) {
+        if (visited[room_id.asUint32()]) {
             continue;
         }
-        visited.insert(room_id);
+        visited[room_id.asUint32()] = true;
         if (f.filter(thisr)) {
             recipient->receiveShortestPath(this, sp_nodes, spindex);
             if (--max_hits == 0) {
@@ -125,24 +72,240 @@ void MapData::shortestPathSearch(const Room *origin,
         if ((max_dist != 0.0) && thisdist > max_dist) {
             return;
         }
-        ExitsList exits = thisr->getExitsList();
-        for (const ExitDirEnum dir : enums::makeCountingIterator<ExitDirEnum>(exits)) {
-            const Exit &e = exits[dir];
-            if (!e.outIsUnique()) {
-                // 0: Not mapped
-                // 2+: Random, so no clear directions; skip it.
+        for (auto e = graph->edgesBegin(room_id), end = graph->edgesEnd(room_id); e != end; ++e) {
+            if (visited[e->to]) {
                 continue;
             }
-            if (!e.isExit()) {
+            const Room *const nextr = snapshot->getRoom(RoomId{e->to});
+            if (nextr == nullptr) {
                 continue;
             }
-            const SharedConstRoom &nextr = roomIndex[e.outFirst()];
-            if (visited.contains(nextr->getId())) {
+            sp_nodes.push_back(SPNode(nextr, spindex, thisdist + e->cost, e->dir));
+            future_paths.push(std::make_pair(-(thisdist + e->cost), sp_nodes.size() - 1));
+        }
+    }
+}
+
+// Reports a route found over the routing graph as SPNodes rooted at the origin.
+static void deliverSteps(RoomAdmin *const admin,
+                         const MapSnapshot &snapshot,
+                         ShortestPathRecipient &recipient,
+                         const RoomId startId,
+                         const std::vector<RoutingGraph::Step> &steps)
+{
+    const Room *const start = snapshot.getRoom(startId);
+    if (start == nullptr)
+        return;
+    QVector<SPNode> sp_nodes;
+    sp_nodes.reserve(static_cast<int>(steps.size()) + 1);
+    sp_nodes.push_back(SPNode(start, -1, 0, ExitDirEnum::UNKNOWN));
+    for (const RoutingGraph::Step &step : steps) {
+        const Room *const room = snapshot.getRoom(step.room);
+        if (room == nullptr)
+            return;
+        sp_nodes.push_back(SPNode(room, sp_nodes.size() - 1, step.dist, step.dir));
+    }
+    recipient.receiveShortestPath(admin, sp_nodes, sp_nodes.size() - 1);
+}
+
+// Bidirectional Dijkstra: grows one frontier from the origin over outgoing
+// exits and one from the target over incoming exits, always advancing the
+// cheaper one, and stops once no path through either frontier can beat the
+// best meeting point. Unlike A* it needs no heuristic, so stacked layers and
+// long jumps don't make it wander.
+static std::optional<std::vector<RoutingGraph::Step>> bidirectionalSearch(
+    const RoutingGraph &graph,
+    const RoomId startId,
+    const RoomId targetId,
+    const std::function<bool()> &isCancelled)
+{
+    static constexpr const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+    static constexpr const double INF = std::numeric_limits<double>::infinity();
+    struct NODISCARD Side final
+    {
+        std::vector<double> dist;
+        std::vector<bool> settled;
+        // Forward: the room before this one. Backward: the room after it.
+        std::vector<uint32_t> link;
+        std::vector<ExitDirEnum> dir;
+        using Entry = std::pair<double, uint32_t>;
+        std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+
+        explicit Side(const size_t numNodes, const uint32_t origin)
+            : dist(numNodes, INF)
+            , settled(numNodes, false)
+            , link(numNodes, NONE)
+            , dir(numNodes, ExitDirEnum::NONE)
+        {
+            dist[origin] = 0.0;
+            queue.emplace(0.0, origin);
+        }
+
+        double top()
+        {
+            while (!queue.empty() && settled[queue.top().second])
+                queue.pop();
+            return queue.empty() ? INF : queue.top().first;
+        }
+    };
+
+    const uint32_t start = startId.asUint32();
+    const uint32_t target = targetId.asUint32();
+    const size_t numNodes = graph.getNumNodes();
+    Side fwd{numNodes, start};
+    Side bwd{numNodes, target};
+    double best = (start == target) ? 0.0 : INF;
+    uint32_t meet = (start == target) ? start : NONE;
+
+    uint32_t expanded = 0;
+    while (true) {
+        if (isCancelled && ++expanded % CANCEL_POLL_INTERVAL == 0 && isCancelled())
+            return std::nullopt;
+        const double fwdTop = fwd.top();
+        const double bwdTop = bwd.top();
+        if (fwdTop + bwdTop >= best)
+            break;
+
+        const bool forward = fwdTop <= bwdTop;
+        Side &side = forward ? fwd : bwd;
+        const Side &other = forward ? bwd : fwd;
+        const uint32_t room = side.queue.top().second;
+        side.queue.pop();
+        side.settled[room] = true;
+
+        const RoomId id{room};
+        const RoutingGraph::Edge *const begin = forward ? graph.edgesBegin(id)
+                                                        : graph.reverseEdgesBegin(id);
+        const RoutingGraph::Edge *const end = forward ? graph.edgesEnd(id)
+                                                      : graph.reverseEdgesEnd(id);
+        for (auto e = begin; e != end; ++e) {
+            const double next = side.dist[room] + e->cost;
+            if (next < side.dist[e->to]) {
+                side.dist[e->to] = next;
+                side.link[e->to] = room;
+                side.dir[e->to] = e->dir;
+                side.queue.emplace(next, e->to);
+            }
+            // Both sides have a label here, so their chains join at this room.
+            const double through = side.dist[e->to] + other.dist[e->to];
+            if (through < best) {
+                best = through;
+                meet = e->to;
+            }
+        }
+    }
+    if (meet == NONE)
+        return std::nullopt;
+
+    std::vector<RoutingGraph::Step> steps;
+    for (uint32_t room = meet; room != start; room = fwd.link[room])
+        steps.push_back(RoutingGraph::Step{RoomId{room}, fwd.dir[room], fwd.dist[room]});
+    std::reverse(steps.begin(), steps.end());
+    const double total = fwd.dist[meet] + bwd.dist[meet];
+    for (uint32_t room = meet; room != target; room = bwd.link[room]) {
+        const uint32_t next = bwd.link[room];
+        steps.push_back(RoutingGraph::Step{RoomId{next}, bwd.dir[room], total - bwd.dist[next]});
+    }
+    return steps;
+}
+
+void MapData::shortestPathSearch(const RoomId startId,
+                                 ShortestPathRecipient *const recipient,
+                                 const RoomId target,
+                                 const RoutingProfileEnum profile,
+                                 const std::function<bool()> &isCancelled)
+{
+    // A* towards a single known room. The heuristic is the Manhattan distance
+    // scaled by the cheapest possible step over the longest jump any exit
+    // makes, so it never overestimates (and is consistent), even when exits
+    // skip cells; closed rooms therefore never need to be reopened.
+    const SharedMapSnapshot snapshot = getSnapshot();
+    const SharedRoutingGraph graph = getRoutingGraph(snapshot, profile);
+    if (!graph->contains(startId) || !graph->contains(target))
+        return;
+
+    // Far-away targets are routed over the zone hierarchy instead.
+    static constexpr const int HIERARCHY_MIN_DISTANCE = 3 * zones::ZONE_WIDTH;
+    if (graph->getPosition(startId).distance(graph->getPosition(target))
+        >= HIERARCHY_MIN_DISTANCE) {
+        const SharedRoutingHierarchy hierarchy = getRoutingHierarchy(snapshot, profile);
+        if (const auto steps = hierarchy->findPath(startId, target, isCancelled))
+            deliverSteps(this, *snapshot, deref(recipient), startId, *steps);
+        return;
+    }
+
+    // Across layers the Manhattan heuristic mostly measures the wrong thing.
+    if (graph->getPosition(startId).z != graph->getPosition(target).z) {
+        if (const auto steps = bidirectionalSearch(*graph, startId, target, isCancelled))
+            deliverSteps(this, *snapshot, deref(recipient), startId, *steps);
+        return;
+    }
+
+    const Coordinate &goalPos = graph->getPosition(target);
+    const double costPerCell = graph->getMinStepCost()
+                               / static_cast<double>(graph->getMaxStepDistance());
+    const auto heuristic = [&graph, &goalPos, costPerCell](const uint32_t node) -> double {
+        return costPerCell * graph->getPosition(RoomId{node}).distance(goalPos);
+    };
+
+    // Search over bare node indices and only materialize the path that is reported.
+    struct NODISCARD Node final
+    {
+        uint32_t id = 0;
+        int parent = -1;
+        double dist = 0.0;
+        ExitDirEnum lastdir = ExitDirEnum::UNKNOWN;
+    };
+
+    const size_t numNodes = graph->getNumNodes();
+    std::vector<bool> visited(numNodes, false);
+    std::vector<double> bestDist(numNodes, std::numeric_limits<double>::infinity());
+
+    std::vector<Node> nodes;
+    std::priority_queue<std::pair<double, int>> future_paths;
+    nodes.emplace_back(Node{startId.asUint32(), -1, 0.0, ExitDirEnum::UNKNOWN});
+    bestDist[startId.asUint32()] = 0.0;
+    future_paths.push(std::make_pair(-heuristic(startId.asUint32()), 0));
+    uint32_t expanded = 0;
+    while (!future_paths.empty()) {
+        if (isCancelled && ++expanded % CANCEL_POLL_INTERVAL == 0 && isCancelled()) {
+            return;
+        }
+        const int index = future_paths.top().second;
+        future_paths.pop();
+        const Node node = nodes[static_cast<size_t>(index)];
+        if (visited[node.id]) {
+            continue;
+        }
+        visited[node.id] = true;
+        if (node.id == target.asUint32()) {
+            // Rebuild the chain of parents as SPNodes, root first.
+            std::vector<int> chain;
+            for (int i = index; i >= 0; i = nodes[static_cast<size_t>(i)].parent) {
+                chain.push_back(i);
+            }
+            QVector<SPNode> sp_nodes;
+            sp_nodes.reserve(static_cast<int>(chain.size()));
+            for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+                const Node &n = nodes[static_cast<size_t>(*it)];
+                const Room *const room = snapshot->getRoom(RoomId{n.id});
+                if (room == nullptr)
+                    return;
+                sp_nodes.push_back(SPNode(room, sp_nodes.size() - 1, n.dist, n.lastdir));
+            }
+            recipient->receiveShortestPath(this, sp_nodes, sp_nodes.size() - 1);
+            return;
+        }
+        const RoomId nodeId{node.id};
+        for (auto e = graph->edgesBegin(nodeId), end = graph->edgesEnd(nodeId); e != end; ++e) {
+            const double nextdist = node.dist + e->cost;
+            if (visited[e->to] || nextdist >= bestDist[e->to]) {
                 continue;
             }
-            const double length = getLength(e, thisr, nextr.get());
-            sp_nodes.push_back(SPNode(nextr.get(), spindex, thisdist + length, dir));
-            future_paths.push(std::make_pair(-(thisdist + length), sp_nodes.size() - 1));
+            bestDist[e->to] = nextdist;
+            nodes.emplace_back(Node{e->to, index, nextdist, e->dir});
+            future_paths.push(
+                std::make_pair(-(nextdist + heuristic(e->to)), static_cast<int>(nodes.size() - 1)));
         }
     }
 }
@@ -33,6 +33,11 @@ class SPNode
 class ShortestPathRecipient
 {
 public:
-    virtual void receiveShortestPath(RoomAdmin *admin, QVector<SPNode> spnodes, int endpoint) = 0;
+    /// `spnodes` is the search's own node table and is only valid during the call;
+    /// the path is found by following `parent` from `endpoint` back to the origin.
+    virtual void receiveShortestPath(RoomAdmin *admin,
+                                     const QVector<SPNode> &spnodes,
+                                     int endpoint)
+        = 0;
     virtual ~ShortestPathRecipient();
 };
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "ActionSchedule.h"
+
+#include <algorithm>
+
+void ActionSchedule::add(const SharedMapAction &action, const RoomIdSet &rooms)
+{
+    const MapAction *const key = action.get();
+    auto it = m_pending.find(key);
+    if (it == m_pending.end()) {
+        it = m_pending.emplace(key, Entry{action, {}, m_nextSequence++}).first;
+    }
+
+    // Scheduling the same action again (e.g. because it now affects more rooms)
+    // keeps its original position.
+    Entry &entry = it->second;
+    for (const RoomId id : rooms) {
+        if (entry.rooms.insert(id).second) {
+            m_byRoom[id].push_back(key);
+        }
+    }
+}
+
+void ActionSchedule::remove(const MapAction *const action)
+{
+    const auto it = m_pending.find(action);
+    if (it == m_pending.end()) {
+        return;
+    }
+
+    for (const RoomId id : it->second.rooms) {
+        const auto found = m_byRoom.find(id);
+        if (found == m_byRoom.end()) {
+            continue;
+        }
+        auto &list = found->second;
+        list.erase(std::remove(list.begin(), list.end(), action), list.end());
+        if (list.empty()) {
+            m_byRoom.erase(found);
+        }
+    }
+    m_pending.erase(it);
+}
+
+void ActionSchedule::clear()
+{
+    m_byRoom.clear();
+    m_pending.clear();
+}
+
+std::vector<SharedMapAction> ActionSchedule::getPending(const RoomId id) const
+{
+    std::vector<SharedMapAction> result;
+    const auto it = m_byRoom.find(id);
+    if (it == m_byRoom.end()) {
+        return result;
+    }
+
+    std::vector<const Entry *> entries;
+    entries.reserve(it->second.size());
+    for (const MapAction *const action : it->second) {
+        const auto found = m_pending.find(action);
+        if (found != m_pending.end()) {
+            entries.emplace_back(&found->second);
+        }
+    }
+    // An action re-scheduled with more rooms is appended to the back of the new
+    // rooms' lists, so sort to restore scheduling order.
+    std::sort(entries.begin(), entries.end(), [](const Entry *a, const Entry *b) {
+        return a->sequence < b->sequence;
+    });
+
+    result.reserve(entries.size());
+    for (const Entry *const entry : entries) {
+        result.emplace_back(entry->action);
+    }
+    return result;
+}
@@ -0,0 +1,45 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "../global/roomid.h"
+
+class MapAction;
+using SharedMapAction = std::shared_ptr<MapAction>;
+
+/// Actions waiting for their affected rooms to be unlocked, grouped by room.
+///
+/// Each room keeps its pending actions in the order they were scheduled, so
+/// releasing a room runs them in that order instead of by pointer value.
+class ActionSchedule final
+{
+private:
+    struct Entry final
+    {
+        SharedMapAction action;
+        RoomIdSet rooms;
+        uint64_t sequence = 0;
+    };
+
+    std::unordered_map<const MapAction *, Entry> m_pending;
+    std::unordered_map<RoomId, std::vector<const MapAction *>> m_byRoom;
+    uint64_t m_nextSequence = 0;
+
+public:
+    void add(const SharedMapAction &action, const RoomIdSet &rooms);
+    void remove(const MapAction *action);
+    void clear();
+
+public:
+    bool empty() const { return m_pending.empty(); }
+    size_t size() const { return m_pending.size(); }
+
+    /// Returns a copy, so the caller may add or remove actions while iterating.
+    std::vector<SharedMapAction> getPending(RoomId id) const;
+};
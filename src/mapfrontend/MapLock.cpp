@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "MapLock.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <QThread>
+
+#include "../global/Trace.h"
+
+static thread_local std::chrono::nanoseconds tl_waitTime{};
+static std::atomic<uint64_t> g_writeHoldCount{0};
+static std::atomic<int64_t> g_writeHoldTotalNs{0};
+static std::atomic<int64_t> g_writeHoldMaxNs{0};
+
+namespace {
+class NODISCARD WaitTimer final
+{
+private:
+    const std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+public:
+    WaitTimer() = default;
+    ~WaitTimer()
+    {
+        tl_waitTime += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start);
+    }
+    DELETE_CTORS_AND_ASSIGN_OPS(WaitTimer);
+};
+
+void recordWriteHold(const std::chrono::nanoseconds held)
+{
+    const int64_t ns = held.count();
+    g_writeHoldCount.fetch_add(1, std::memory_order_relaxed);
+    g_writeHoldTotalNs.fetch_add(ns, std::memory_order_relaxed);
+    int64_t max = g_writeHoldMaxNs.load(std::memory_order_relaxed);
+    while (ns > max && !g_writeHoldMaxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+        ;
+}
+} // namespace
+
+MapLock::~MapLock()
+{
+    assert(m_writer.load() == nullptr);
+}
+
+bool MapLock::isLockedForWriteByCurrentThread() const
+{
+    return m_writer.load() == QThread::currentThreadId();
+}
+
+bool MapLock::lockForRead()
+{
+    if (isLockedForWriteByCurrentThread())
+        return false;
+
+    if (!m_rwLock.tryLockForRead()) {
+        MMAPPER_TRACE_SCOPE("MapLock::lockForRead (contended)");
+        WaitTimer timer;
+        m_rwLock.lockForRead();
+    }
+    return true;
+}
+
+void MapLock::unlockForRead(const bool wasLocked)
+{
+    if (wasLocked)
+        m_rwLock.unlock();
+}
+
+void MapLock::lockForWrite()
+{
+    if (isLockedForWriteByCurrentThread()) {
+        ++m_writeDepth;
+        return;
+    }
+
+    if (!m_rwLock.tryLockForWrite()) {
+        MMAPPER_TRACE_SCOPE("MapLock::lockForWrite (contended)");
+        WaitTimer timer;
+        m_rwLock.lockForWrite();
+    }
+    assert(m_writeDepth == 0);
+    m_writeDepth = 1;
+    m_writer.store(QThread::currentThreadId());
+    m_writeStart = std::chrono::steady_clock::now();
+}
+
+void MapLock::unlockForWrite()
+{
+    assert(isLockedForWriteByCurrentThread());
+    assert(m_writeDepth > 0);
+    if (--m_writeDepth != 0)
+        return;
+
+    const auto held = std::chrono::steady_clock::now() - m_writeStart;
+    m_writer.store(nullptr);
+    m_rwLock.unlock();
+    recordWriteHold(std::chrono::duration_cast<std::chrono::nanoseconds>(held));
+}
+
+std::chrono::nanoseconds MapLock::getCurrentThreadWaitTime()
+{
+    return tl_waitTime;
+}
+
+MapLock::WriteHoldStats MapLock::takeWriteHoldStats()
+{
+    static constexpr const auto relaxed = std::memory_order_relaxed;
+    WriteHoldStats stats;
+    stats.count = g_writeHoldCount.exchange(0, relaxed);
+    stats.total = std::chrono::nanoseconds{g_writeHoldTotalNs.exchange(0, relaxed)};
+    stats.max = std::chrono::nanoseconds{g_writeHoldMaxNs.exchange(0, relaxed)};
+    return stats;
+}
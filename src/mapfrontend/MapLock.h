@@ -0,0 +1,94 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <QReadWriteLock>
+#include <QtGlobal>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+
+/// Shared/exclusive lock guarding a MapFrontend.
+///
+/// Any number of readers may hold the lock at once, while a writer excludes
+/// everyone else. Both modes are recursive, and a thread that already holds
+/// the write lock may also take the read lock (QReadWriteLock alone deadlocks
+/// in that case, and the map code nests calls that way all the time).
+///
+/// WARNING: Upgrading is not supported; never request the write lock while
+/// the same thread holds only the read lock.
+class MapLock final
+{
+private:
+    QReadWriteLock m_rwLock{QReadWriteLock::Recursive};
+    std::atomic<Qt::HANDLE> m_writer{nullptr};
+    int m_writeDepth = 0; // only touched by the thread that holds the write lock
+    std::chrono::steady_clock::time_point m_writeStart{}; // likewise
+
+public:
+    MapLock() = default;
+    ~MapLock();
+    DELETE_CTORS_AND_ASSIGN_OPS(MapLock);
+
+public:
+    /// Returns false if the read lock was implied by this thread's write lock,
+    /// in which case unlockForRead() must be told so.
+    NODISCARD bool lockForRead();
+    void unlockForRead(bool wasLocked);
+
+public:
+    void lockForWrite();
+    void unlockForWrite();
+
+public:
+    NODISCARD bool isLockedForWriteByCurrentThread() const;
+
+public:
+    /// Total time the calling thread has spent blocked waiting for any MapLock.
+    /// Uncontended acquisitions are not timed, so this costs nothing normally.
+    NODISCARD static std::chrono::nanoseconds getCurrentThreadWaitTime();
+
+public:
+    struct NODISCARD WriteHoldStats final
+    {
+        uint64_t count = 0;
+        std::chrono::nanoseconds total{};
+        std::chrono::nanoseconds max{};
+    };
+    /// How long any MapLock has been held for writing, by any thread, since the last
+    /// call; only the outermost lock is timed, from when it's acquired to its release.
+    NODISCARD static WriteHoldStats takeWriteHoldStats();
+};
+
+class NODISCARD MapReadLocker final
+{
+private:
+    MapLock &m_lock;
+    const bool m_locked;
+
+public:
+    explicit MapReadLocker(MapLock &lock)
+        : m_lock{lock}
+        , m_locked{lock.lockForRead()}
+    {}
+    ~MapReadLocker() { m_lock.unlockForRead(m_locked); }
+    DELETE_CTORS_AND_ASSIGN_OPS(MapReadLocker);
+};
+
+class NODISCARD MapWriteLocker final
+{
+private:
+    MapLock &m_lock;
+
+public:
+    explicit MapWriteLocker(MapLock &lock)
+        : m_lock{lock}
+    {
+        m_lock.lockForWrite();
+    }
+    ~MapWriteLocker() { m_lock.unlockForWrite(); }
+    DELETE_CTORS_AND_ASSIGN_OPS(MapWriteLocker);
+};
@@ -13,13 +13,17 @@
 #include <mutex>
 #include <sstream>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
+#include "../expandoracommon/ContentFingerprint.h"
+#include "../expandoracommon/ExitLayout.h"
 #include "../expandoracommon/parseevent.h"
 #include "../expandoracommon/property.h"
+#include "../expandoracommon/room.h"
 #include "../global/Array.h"
 #include "../global/EnumIndexedArray.h"
+#include "../global/FlatHashMap.h"
+#include "../global/MemoryUsage.h"
 #include "../global/utils.h"
 #include "roomcollection.h"
 
@@ -135,14 +139,38 @@ static auto makeKey(const ParseEvent &event, const MaskFlagsEnum maskFlags)
     return key;
 }
 
+// FNV-1a, which is also what's saved with the map, so it must not change.
+static uint64_t makeKeyHash(const ParseEvent &event, const MaskFlagsEnum maskFlags)
+{
+    return ContentFingerprint::compute(makeKey(event, maskFlags)).hash;
+}
+
+ParseKeys ParseTree::computeKeys(const ParseEvent &event)
+{
+    const MaskFlagsEnum mask = getKeyMask(event);
+
+    ParseKeys keys;
+    keys.mask = static_cast<uint32_t>(mask);
+    if (!isMatchedByTree(mask))
+        return keys;
+
+    keys.primary = makeKeyHash(event, MaskFlagsEnum::NAME_DESC_TERRAIN);
+    size_t level = 0;
+    for (auto subMask = mask; subMask != MaskFlagsEnum::NONE; subMask = reduceMask(subMask)) {
+        keys.levels.at(level++) = makeKeyHash(event, subMask);
+    }
+    return keys;
+}
+
 class ParseTree::ParseHashMap final
 {
 private:
-    using Key = std::string;
+    using Key = uint64_t;
     using PV = SharedRoomCollection;
-    using Primary = std::unordered_map<Key, PV>;
-    using SV = std::unordered_set<PV>;
-    using Secondary = std::unordered_map<Key, SV>;
+    using Primary = FlatHashMap<PV>;
+    // Almost every key leads to one collection, so a vector beats a set.
+    using SV = std::vector<PV>;
+    using Secondary = FlatHashMap<SV>;
     Primary m_primary;
     EnumIndexedArray<Secondary, MaskFlagsEnum> m_secondary;
 
@@ -150,45 +178,100 @@ class ParseTree::ParseHashMap final
     ParseHashMap() = default;
     virtual ~ParseHashMap();
 
-    SharedRoomCollection insertRoom(const ParseEvent &event)
+    void reserveMore(const size_t numRooms)
     {
-        const MaskFlagsEnum mask = getKeyMask(event);
+        // Nearly every room is filed under all three of these masks, but many
+        // rooms share a name, so this overestimates the less specific ones.
+        m_primary.reserve(m_primary.size() + numRooms);
+        for (const auto mask : {MaskFlagsEnum::NAME,
+                                MaskFlagsEnum::NAME_DESC,
+                                MaskFlagsEnum::NAME_DESC_TERRAIN}) {
+            Secondary &secondary = m_secondary[mask];
+            secondary.reserve(secondary.size() + numRooms);
+        }
+    }
+
+    SharedRoomCollection insertRoom(const ParseKeys &keys)
+    {
+        // Saved keys come from a file, so they're checked like any other input.
+        if (keys.mask >= enums::CountOf<MaskFlagsEnum>::value)
+            return nullptr;
+        const auto mask = static_cast<MaskFlagsEnum>(keys.mask);
 
         if (!isMatchedByTree(mask))
             return nullptr;
 
-        const auto pk = makeKey(event, MaskFlagsEnum::NAME_DESC_TERRAIN);
-        auto &result = m_primary[pk];
+        auto &result = m_primary[keys.primary];
         if (result == nullptr)
             result = std::make_shared<RoomCollection>();
 
+        size_t level = 0;
         for (auto subMask = mask; subMask != MaskFlagsEnum::NONE; subMask = reduceMask(subMask)) {
-            const auto key = makeKey(event, subMask);
             Secondary &reference = m_secondary[subMask];
-            SV &bucket = reference[key];
-            bucket.emplace(result);
+            SV &bucket = reference[keys.levels.at(level++)];
+            if (std::find(bucket.begin(), bucket.end(), result) == bucket.end())
+                bucket.emplace_back(result);
         }
 
         return result;
     }
 
-    void getRooms(AbstractRoomVisitor &stream, const ParseEvent &event)
+    void getRooms(const RoomIndex &roomIndex, AbstractRoomVisitor &stream, const ParseEvent &event)
     {
-        const MaskFlagsEnum mask = getKeyMask(event);
+        const ParseKeys &keys = getKeys(event);
+        const auto mask = static_cast<MaskFlagsEnum>(keys.mask);
 
         if (!isMatchedByTree(mask))
             return;
 
-        const auto &key = makeKey(event, mask);
+        // The first level is the key for the event's own mask.
+        const SV *const homes = m_secondary[mask].find(keys.levels.front());
+        if (homes == nullptr)
+            return;
 
-        Secondary &thislevel = m_secondary[mask];
-        SV &homes = thislevel[key];
-        for (const PV &home : homes) {
-            if (home != nullptr) {
-                home->forEach(stream);
+        // Rooms with the same name and description (e.g. the many "Forest" rooms)
+        // are told apart by their exits first, which is much cheaper than
+        // letting the stream compare them.
+        const ExitsFlagsType exitsFlags = event.getExitsFlags();
+        if (!exitsFlags.isValid()) {
+            for (const PV &home : *homes) {
+                if (home != nullptr) {
+                    home->forEach(roomIndex, stream);
+                }
             }
+            return;
+        }
+
+        const ExitLayout seen = ExitLayout::fromEvent(exitsFlags);
+        for (const PV &home : *homes) {
+            if (home == nullptr)
+                continue;
+            home->forEachRoom(roomIndex, [&stream, &seen](const Room *const room) {
+                if (!room->getExitLayout().rulesOut(seen, room->isUpToDate()))
+                    stream.visit(room);
+            });
         }
     }
+
+    void addMemoryUsage(MemoryUsage &usage) const
+    {
+        size_t bytes = m_primary.getMemoryBytes();
+        size_t keys = m_primary.size();
+        for (const Secondary &secondary : m_secondary) {
+            bytes += secondary.getMemoryBytes();
+            keys += secondary.size();
+            secondary.forEach([&bytes](Key, const SV &homes) {
+                bytes += homes.capacity() * sizeof(PV);
+            });
+        }
+        usage.add("parse tree", keys, bytes);
+
+        // Every collection is in the primary map.
+        m_primary.forEach([&usage](Key, const PV &home) {
+            if (home != nullptr && usage.isFirstReference(home.get()))
+                usage.add("room collections", 1, home->getMemoryBytes());
+        });
+    }
 };
 
 ParseTree::ParseHashMap::~ParseHashMap() = default;
@@ -198,12 +281,36 @@ ParseTree::ParseTree()
 {}
 ParseTree::~ParseTree() = default;
 
+const ParseKeys &ParseTree::getKeys(const ParseEvent &event)
+{
+    if (!event.getCachedParseKeys().has_value())
+        event.setCachedParseKeys(computeKeys(event));
+    return event.getCachedParseKeys().value();
+}
+
+void ParseTree::reserveMore(const size_t numRooms)
+{
+    m_pimpl->reserveMore(numRooms);
+}
+
 SharedRoomCollection ParseTree::insertRoom(const ParseEvent &event)
 {
-    return m_pimpl->insertRoom(event);
+    return m_pimpl->insertRoom(getKeys(event));
+}
+
+SharedRoomCollection ParseTree::insertRoom(const ParseKeys &keys)
+{
+    return m_pimpl->insertRoom(keys);
+}
+
+void ParseTree::getRooms(const RoomIndex &roomIndex,
+                         AbstractRoomVisitor &stream,
+                         const ParseEvent &event)
+{
+    m_pimpl->getRooms(roomIndex, stream, event);
 }
 
-void ParseTree::getRooms(AbstractRoomVisitor &stream, const ParseEvent &event)
+void ParseTree::addMemoryUsage(MemoryUsage &usage) const
 {
-    m_pimpl->getRooms(stream, event);
+    m_pimpl->addMemoryUsage(usage);
 }
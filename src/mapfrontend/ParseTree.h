@@ -3,6 +3,7 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <memory>
@@ -10,14 +11,19 @@
 
 #include "../expandoracommon/parseevent.h"
 #include "../global/RuleOf5.h"
+#include "../global/macros.h"
 #include "../global/roomid.h"
 #include "AbstractRoomVisitor.h"
 
 class AbstractRoomVisitor;
+class MemoryUsage;
 class ParseEvent;
 
 /// ParseTree is an 8-way hashmap combining key data from
 /// ParseEvent's name, description, and terrain.
+///
+/// Keys are stored as 64-bit hashes. A collision only adds candidates, and
+/// every candidate is compared with the event anyway.
 class ParseTree final
 {
 public:
@@ -30,8 +36,22 @@ class ParseTree final
     ParseTree();
     ~ParseTree();
     DELETE_CTORS_AND_ASSIGN_OPS(ParseTree);
+    void swap(ParseTree &other) noexcept { m_pimpl.swap(other.m_pimpl); }
 
 public:
+    /// The hashes are stable, so they can be saved with the map and passed to
+    /// insertRoom() without the room's text.
+    NODISCARD static ParseKeys computeKeys(const ParseEvent &event);
+    /// Like computeKeys(), but the keys are kept with the event, since the path
+    /// machine looks most events up more than once. Only call it with the map locked.
+    NODISCARD static const ParseKeys &getKeys(const ParseEvent &event);
+    /// Makes room for numRooms more rooms, e.g. before loading a map.
+    void reserveMore(size_t numRooms);
     SharedRoomCollection insertRoom(const ParseEvent &event);
-    void getRooms(AbstractRoomVisitor &stream, const ParseEvent &event);
+    SharedRoomCollection insertRoom(const ParseKeys &keys);
+    void getRooms(const RoomIndex &roomIndex, AbstractRoomVisitor &stream, const ParseEvent &event);
+
+public:
+    /// Counts the hash maps and the room collections they point to.
+    void addMemoryUsage(MemoryUsage &usage) const;
 };
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "RoomLocks.h"
+
+#include <algorithm>
+#include <limits>
+
+bool RoomLocks::Holders::contains(const RoomRecipient *const recipient) const
+{
+    const auto inlineEnd = first.begin() + std::min(size, INLINE_CAPACITY);
+    return std::find(first.begin(), inlineEnd, recipient) != inlineEnd
+           || std::find(rest.begin(), rest.end(), recipient) != rest.end();
+}
+
+void RoomLocks::Holders::insert(RoomRecipient *const recipient)
+{
+    if (contains(recipient))
+        return;
+    if (size < INLINE_CAPACITY) {
+        first[size] = recipient;
+    } else {
+        rest.emplace_back(recipient);
+    }
+    ++size;
+}
+
+bool RoomLocks::Holders::erase(const RoomRecipient *const recipient)
+{
+    const auto inlineEnd = first.begin() + std::min(size, INLINE_CAPACITY);
+    const auto it = std::find(first.begin(), inlineEnd, recipient);
+    if (it != inlineEnd) {
+        // Fill the hole with the last holder.
+        if (!rest.empty()) {
+            *it = rest.back();
+            rest.pop_back();
+        } else {
+            *it = *(inlineEnd - 1);
+            *(inlineEnd - 1) = nullptr;
+        }
+        --size;
+        return true;
+    }
+
+    const auto restIt = std::find(rest.begin(), rest.end(), recipient);
+    if (restIt == rest.end())
+        return false;
+    *restIt = rest.back();
+    rest.pop_back();
+    --size;
+    return true;
+}
+
+void RoomLocks::updateCount(const RoomId id, const size_t count)
+{
+    static constexpr const size_t MAX_COUNT = std::numeric_limits<uint8_t>::max();
+    m_counts.at(id.asUint32()) = static_cast<uint8_t>(std::min(count, MAX_COUNT));
+}
+
+void RoomLocks::insert(const RoomId id, RoomRecipient *const recipient)
+{
+    // Check the id before it gets an entry.
+    static_cast<void>(isLocked(id));
+    Holders &holders = m_holders[id];
+    holders.insert(recipient);
+    updateCount(id, holders.size);
+}
+
+void RoomLocks::erase(const RoomId id, const RoomRecipient *const recipient)
+{
+    if (!isLocked(id))
+        return;
+
+    const auto it = m_holders.find(id);
+    if (it == m_holders.end() || !it->second.erase(recipient))
+        return;
+
+    const size_t count = it->second.size;
+    if (count == 0)
+        m_holders.erase(it);
+    updateCount(id, count);
+}
+
+void RoomLocks::clear(const RoomId id)
+{
+    if (!isLocked(id))
+        return;
+    m_holders.erase(id);
+    updateCount(id, 0);
+}
@@ -0,0 +1,52 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../global/roomid.h"
+
+class RoomRecipient;
+
+/// The recipients that hold each room.
+///
+/// Nearly every room is unlocked, and the rest are held by one or two recipients
+/// (the path machine, a selection), so rooms only have a byte each here; the holders
+/// of the locked rooms are kept in a side table.
+class RoomLocks final
+{
+private:
+    /// A small set of recipients; the first few don't allocate.
+    struct Holders final
+    {
+        static constexpr const size_t INLINE_CAPACITY = 2;
+        std::array<RoomRecipient *, INLINE_CAPACITY> first{};
+        std::vector<RoomRecipient *> rest;
+        size_t size = 0;
+
+        bool contains(const RoomRecipient *recipient) const;
+        void insert(RoomRecipient *recipient);
+        bool erase(const RoomRecipient *recipient);
+    };
+
+    // The number of holders of each room, saturated at UINT8_MAX; zero when it's unlocked.
+    std::vector<uint8_t> m_counts;
+    std::unordered_map<RoomId, Holders> m_holders;
+
+public:
+    void resize(size_t size) { m_counts.resize(size, 0); }
+
+    /// Throws std::out_of_range like RoomIndex::at(), if id was never reserved.
+    bool isLocked(const RoomId id) const { return m_counts.at(id.asUint32()) != 0; }
+
+    void insert(RoomId id, RoomRecipient *recipient);
+    void erase(RoomId id, const RoomRecipient *recipient);
+    void clear(RoomId id);
+
+private:
+    void updateCount(RoomId id, size_t count);
+};
@@ -0,0 +1,108 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "SimilarRoomIndex.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "../expandoracommon/WordTokens.h"
+#include "../global/MemoryUsage.h"
+
+namespace { // anonymous
+
+// SplitMix64, which turns consecutive seeds into unrelated hash functions.
+uint64_t mix64(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30u)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27u)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31u);
+}
+
+uint64_t getBandKey(const SimilarRoomIndex::Signature &sig, const size_t band)
+{
+    uint64_t key = band;
+    for (size_t row = 0; row < SimilarRoomIndex::ROWS_PER_BAND; ++row)
+        key = mix64(key ^ sig[band * SimilarRoomIndex::ROWS_PER_BAND + row]);
+    return key;
+}
+
+} // namespace
+
+std::optional<SimilarRoomIndex::Signature> SimilarRoomIndex::computeSignature(
+    const WordTokens &words)
+{
+    if (!words.isValid() || words.empty())
+        return std::nullopt;
+
+    Signature sig;
+    sig.fill(std::numeric_limits<uint32_t>::max());
+    const auto addShingle = [&sig](const uint64_t shingle) {
+        const uint64_t base = mix64(shingle);
+        for (size_t i = 0; i < NUM_HASHES; ++i) {
+            const auto h = static_cast<uint32_t>(mix64(base + i) >> 32u);
+            sig[i] = std::min(sig[i], h);
+        }
+    };
+
+    // Word pairs, so that a one-word change only affects the two pairs around it;
+    // a one-word description is its own shingle.
+    if (words.size() == 1) {
+        addShingle(words[0].hash);
+        return sig;
+    }
+    for (size_t i = 1, n = words.size(); i < n; ++i)
+        addShingle((static_cast<uint64_t>(words[i - 1].hash) << 32u) | words[i].hash);
+    return sig;
+}
+
+void SimilarRoomIndex::clear()
+{
+    for (auto &band : m_bands)
+        band = {};
+    m_built = false;
+}
+
+void SimilarRoomIndex::insert(const RoomId id, const WordTokens &staticDescWords)
+{
+    const auto sig = computeSignature(staticDescWords);
+    if (!sig.has_value())
+        return;
+
+    for (size_t band = 0; band < NUM_BANDS; ++band) {
+        std::vector<RoomId> &ids = m_bands[band][getBandKey(sig.value(), band)];
+        if (std::find(ids.begin(), ids.end(), id) == ids.end())
+            ids.emplace_back(id);
+    }
+}
+
+std::vector<RoomId> SimilarRoomIndex::getCandidates(const WordTokens &staticDescWords) const
+{
+    std::vector<RoomId> result;
+    const auto sig = computeSignature(staticDescWords);
+    if (!sig.has_value())
+        return result;
+
+    for (size_t band = 0; band < NUM_BANDS; ++band) {
+        if (const auto *const ids = m_bands[band].find(getBandKey(sig.value(), band)))
+            result.insert(result.end(), ids->begin(), ids->end());
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+void SimilarRoomIndex::addMemoryUsage(MemoryUsage &usage) const
+{
+    size_t keys = 0;
+    size_t bytes = 0;
+    for (const auto &band : m_bands) {
+        keys += band.size();
+        bytes += band.getMemoryBytes();
+        band.forEach([&bytes](uint64_t, const std::vector<RoomId> &ids) {
+            bytes += ids.capacity() * sizeof(RoomId);
+        });
+    }
+    usage.add("similar room index", keys, bytes);
+}
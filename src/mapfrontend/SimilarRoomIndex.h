@@ -0,0 +1,61 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "../global/FlatHashMap.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
+
+class MemoryUsage;
+class WordTokens;
+
+/// Finds rooms whose static description is nearly the same as a given one,
+/// for when MUME has changed a description and the exact ParseTree keys miss.
+///
+/// Each description is reduced to a MinHash signature over its word pairs;
+/// two descriptions agree on any one of its values about as often as they
+/// share word pairs. The signature is cut into bands, and rooms are filed
+/// under each band, so a lookup only returns rooms that agree with the
+/// description on at least one whole band: nearly every near-duplicate, and
+/// few rooms that merely share some words. Candidates still have to be
+/// checked with Room::compare().
+///
+/// Entries are never removed; a room whose description changes is filed again,
+/// so candidates may include rooms that no longer match, or no longer exist.
+class NODISCARD SimilarRoomIndex final
+{
+public:
+    static constexpr const size_t ROWS_PER_BAND = 4;
+    static constexpr const size_t NUM_BANDS = 8;
+    static constexpr const size_t NUM_HASHES = ROWS_PER_BAND * NUM_BANDS;
+    using Signature = std::array<uint32_t, NUM_HASHES>;
+
+private:
+    std::array<FlatHashMap<std::vector<RoomId>>, NUM_BANDS> m_bands;
+    bool m_built = false;
+
+public:
+    /// Returns nothing for descriptions without words, or too long to tokenize.
+    NODISCARD static std::optional<Signature> computeSignature(const WordTokens &words);
+
+public:
+    /// MapFrontend only builds the index the first time it's needed, since that
+    /// reads every room's description, and keeps it up to date from then on.
+    NODISCARD bool isBuilt() const { return m_built; }
+    void setBuilt() { m_built = true; }
+    void clear();
+
+public:
+    void insert(RoomId id, const WordTokens &staticDescWords);
+    /// Sorted ids of the rooms filed under any band of this description's signature.
+    NODISCARD std::vector<RoomId> getCandidates(const WordTokens &staticDescWords) const;
+
+public:
+    void addMemoryUsage(MemoryUsage &usage) const;
+};
@@ -5,12 +5,21 @@
 
 #include "map.h"
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdlib>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/room.h"
+#include "../global/MemoryUsage.h"
+#include "../global/hash.h"
 #include "../global/utils.h"
 #include "AbstractRoomVisitor.h"
 
@@ -38,42 +47,324 @@ struct NODISCARD CoordinateMinMax final
     }
 };
 
-class Map::MapOrderedTree final
+/// Exact per-layer bounding boxes of occupied coordinates.
+///
+/// Each layer counts its rooms per column and per row, so the extent is just the
+/// first and last key, and removing a room on the boundary shrinks the extent
+/// without rescanning the layer.
+class NODISCARD LayerExtents final
 {
 private:
-    // REVISIT: consider using something more efficient
-    std::map<int, std::map<int, std::map<int, Room *>>> map{};
+    struct NODISCARD Layer final
+    {
+        std::map<int, uint32_t> columns;
+        std::map<int, uint32_t> rows;
+    };
+
+    std::map<int, Layer> m_layers;
+
+private:
+    static void decrement(std::map<int, uint32_t> &counts, const int key)
+    {
+        const auto it = counts.find(key);
+        if (it == counts.end()) {
+            assert(false);
+            return;
+        }
+        if (--it->second == 0)
+            counts.erase(it);
+    }
+
+    static MapExtent extentOf(const int z, const Layer &layer)
+    {
+        assert(!layer.columns.empty() && !layer.rows.empty());
+        MapExtent result;
+        result.min = Coordinate{layer.columns.begin()->first, layer.rows.begin()->first, z};
+        result.max = Coordinate{layer.columns.rbegin()->first, layer.rows.rbegin()->first, z};
+        return result;
+    }
+
+public:
+    void clear() { m_layers.clear(); }
+
+    void add(const Coordinate &c)
+    {
+        Layer &layer = m_layers[c.z];
+        ++layer.columns[c.x];
+        ++layer.rows[c.y];
+    }
+
+    void remove(const Coordinate &c)
+    {
+        const auto it = m_layers.find(c.z);
+        if (it == m_layers.end()) {
+            assert(false);
+            return;
+        }
+        Layer &layer = it->second;
+        decrement(layer.columns, c.x);
+        decrement(layer.rows, c.y);
+        if (layer.columns.empty())
+            m_layers.erase(it);
+    }
+
+    OptMapExtent getLayerExtent(const int z) const
+    {
+        const auto it = m_layers.find(z);
+        if (it == m_layers.end())
+            return std::nullopt;
+        return extentOf(z, it->second);
+    }
+
+    OptMapExtent getBounds() const
+    {
+        if (m_layers.empty())
+            return std::nullopt;
+
+        MapExtent result = extentOf(m_layers.begin()->first, m_layers.begin()->second);
+        for (const auto &kv : m_layers) {
+            const MapExtent layer = extentOf(kv.first, kv.second);
+            result.min.x = std::min(result.min.x, layer.min.x);
+            result.min.y = std::min(result.min.y, layer.min.y);
+            result.max.x = std::max(result.max.x, layer.max.x);
+            result.max.y = std::max(result.max.y, layer.max.y);
+        }
+        result.max.z = m_layers.rbegin()->first;
+        return result;
+    }
+};
+
+/// Rooms are bucketed into fixed-size square tiles per layer. Each tile is a dense
+/// row-major array, and tiles are found by hashing their (z, tileY, tileX) key.
+/// Point lookups are therefore one hash probe plus an array index, and range
+/// queries stream whole tiles instead of chasing tree nodes.
+class Map::SpatialGrid final
+{
+public:
+    static constexpr const int TILE_BITS = 4;
+    static constexpr const int TILE_SIZE = 1 << TILE_BITS;
+    static constexpr const int TILE_MASK = TILE_SIZE - 1;
+    static constexpr const size_t TILE_AREA = TILE_SIZE * TILE_SIZE;
+
+private:
+    struct NODISCARD TileKey final
+    {
+        int z = 0;
+        int y = 0;
+        int x = 0;
+
+        bool operator==(const TileKey &rhs) const
+        {
+            return z == rhs.z && y == rhs.y && x == rhs.x;
+        }
+        bool operator<(const TileKey &rhs) const
+        {
+            if (z != rhs.z)
+                return z < rhs.z;
+            if (y != rhs.y)
+                return y < rhs.y;
+            return x < rhs.x;
+        }
+    };
+
+    struct NODISCARD TileKeyHash final
+    {
+        size_t operator()(const TileKey &key) const noexcept
+        {
+            // Tile coordinates are small, so mixing them into one 64-bit word
+            // before hashing is collision-free in practice.
+            const auto ux = static_cast<uint64_t>(static_cast<uint32_t>(key.x));
+            const auto uy = static_cast<uint64_t>(static_cast<uint32_t>(key.y));
+            const auto uz = static_cast<uint64_t>(static_cast<uint32_t>(key.z));
+            return numeric_hash((uz << 42) ^ (uy << 21) ^ ux);
+        }
+    };
+
+    struct NODISCARD Tile final
+    {
+        static constexpr const size_t WORD_BITS = 64;
+
+        std::array<Room *, TILE_AREA> rooms{};
+        // One bit per cell, so a probe (e.g. by Map::getNearestFree()) reads one word
+        // instead of the cell's pointer.
+        std::array<uint64_t, TILE_AREA / WORD_BITS> occupied{};
+        size_t count = 0;
+
+        bool isOccupied(const size_t i) const
+        {
+            return ((occupied[i / WORD_BITS] >> (i % WORD_BITS)) & 1u) != 0u;
+        }
+        void setOccupied(const size_t i, const bool value)
+        {
+            const uint64_t bit = uint64_t{1} << (i % WORD_BITS);
+            uint64_t &word = occupied[i / WORD_BITS];
+            word = value ? (word | bit) : (word & ~bit);
+        }
+    };
+
+    using TileMap = std::unordered_map<TileKey, std::unique_ptr<Tile>, TileKeyHash>;
+    TileMap m_tiles;
+    LayerExtents m_extents;
+
+private:
+    static int tileOf(const int n) { return n >> TILE_BITS; }
+    static int originOf(const int tile) { return tile * TILE_SIZE; }
+    static TileKey keyOf(const Coordinate &c) { return TileKey{c.z, tileOf(c.y), tileOf(c.x)}; }
+    static size_t indexOf(const Coordinate &c)
+    {
+        return static_cast<size_t>(((c.y & TILE_MASK) << TILE_BITS) | (c.x & TILE_MASK));
+    }
+
+    const Tile *findTile(const TileKey &key) const
+    {
+        const auto it = m_tiles.find(key);
+        return (it == m_tiles.end()) ? nullptr : it->second.get();
+    }
+
+    using RunCallback = void (*)(const void *context, Room *const *cells, size_t count);
+
+    static void visitTile(const RunCallback callback, const void *const context, const Tile &tile)
+    {
+        callback(context, tile.rooms.data(), tile.rooms.size());
+    }
+
+    /// Visits the cells of one tile whose absolute coordinates lie in [lo, hi], one row at a time.
+    static void visitTile(const RunCallback callback,
+                          const void *const context,
+                          const TileKey &key,
+                          const Tile &tile,
+                          const Coordinate &lo,
+                          const Coordinate &hi)
+    {
+        const int x0 = originOf(key.x);
+        const int y0 = originOf(key.y);
+        const int xBegin = std::max(lo.x, x0) - x0;
+        const int xEnd = std::min(hi.x, x0 + TILE_MASK) - x0;
+        const int yBegin = std::max(lo.y, y0) - y0;
+        const int yEnd = std::min(hi.y, y0 + TILE_MASK) - y0;
+        if (xBegin == 0 && xEnd == TILE_MASK && yBegin == 0 && yEnd == TILE_MASK) {
+            visitTile(callback, context, tile);
+            return;
+        }
+        const auto width = static_cast<size_t>(xEnd - xBegin + 1);
+        for (int y = yBegin; y <= yEnd; ++y) {
+            const auto first = static_cast<size_t>((y << TILE_BITS) + xBegin);
+            callback(context, tile.rooms.data() + first, width);
+        }
+    }
 
 public:
-    MapOrderedTree() = default;
-    ~MapOrderedTree();
+    SpatialGrid() = default;
+    ~SpatialGrid();
 
-    void clear() { map.clear(); }
+    void clear()
+    {
+        m_tiles.clear();
+        m_extents.clear();
+    }
 
-    void getRooms(AbstractRoomVisitor &stream) const
+    OptMapExtent getBounds() const { return m_extents.getBounds(); }
+    OptMapExtent getLayerExtent(const int z) const { return m_extents.getLayerExtent(z); }
+
+    // The extents are left out; they only hold a few counters per row and column.
+    void addMemoryUsage(MemoryUsage &usage) const
     {
-        for (const auto &z : map) {
-            for (const auto &y : z.second) {
-                for (const auto &x : y.second) {
-                    stream.visit(x.second);
+        usage.add("spatial grid",
+                  m_tiles.size(),
+                  estimateHashTableBytes(m_tiles) + m_tiles.size() * sizeof(Tile));
+    }
+
+    // In (z, y, x) tile order so the output doesn't depend on hash order.
+    template<typename Pred>
+    std::vector<std::pair<TileKey, const Tile *>> getSortedTiles(Pred &&pred) const
+    {
+        std::vector<std::pair<TileKey, const Tile *>> sorted;
+        sorted.reserve(m_tiles.size());
+        for (const auto &kv : m_tiles) {
+            if (pred(kv.first))
+                sorted.emplace_back(kv.first, kv.second.get());
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) {
+            return a.first < b.first;
+        });
+        return sorted;
+    }
+
+    void forEachRun(const RunCallback callback, const void *const context) const
+    {
+        for (const auto &kv : getSortedTiles([](const TileKey &) { return true; }))
+            visitTile(callback, context, deref(kv.second));
+    }
+
+    void forEachRun(const Coordinate &min,
+                    const Coordinate &max,
+                    const RunCallback callback,
+                    const void *const context) const
+    {
+        // Nothing outside the rooms' bounding box can match, so clamp the window to it;
+        // a window of arbitrary size would otherwise cover more tiles than can be counted.
+        const OptMapExtent bounds = getBounds();
+        if (!bounds.has_value())
+            return;
+        const Coordinate clampedMin{std::max(min.x, bounds->min.x),
+                                    std::max(min.y, bounds->min.y),
+                                    std::max(min.z, bounds->min.z)};
+        const Coordinate clampedMax{std::min(max.x, bounds->max.x),
+                                    std::min(max.y, bounds->max.y),
+                                    std::min(max.z, bounds->max.z)};
+        if (clampedMin.x > clampedMax.x || clampedMin.y > clampedMax.y
+            || clampedMin.z > clampedMax.z)
+            return;
+
+        const CoordinateMinMax range{clampedMin, clampedMax};
+        const TileKey lo = keyOf(range.min);
+        const TileKey hi = keyOf(range.max);
+
+        const auto span = [](const int a, const int b) -> uint64_t {
+            return static_cast<uint64_t>(static_cast<int64_t>(b) - static_cast<int64_t>(a) + 1);
+        };
+        // Saturates, since the bounding box itself can still be huge.
+        const auto multiply = [](const uint64_t a, const uint64_t b) -> uint64_t {
+            return (b != 0 && a > UINT64_MAX / b) ? UINT64_MAX : a * b;
+        };
+        const uint64_t numCandidates = multiply(multiply(span(lo.z, hi.z), span(lo.y, hi.y)),
+                                                span(lo.x, hi.x));
+
+        if (numCandidates <= m_tiles.size()) {
+            // Small window: probe each covered tile directly.
+            for (int z = lo.z; z <= hi.z; ++z) {
+                for (int y = lo.y; y <= hi.y; ++y) {
+                    for (int x = lo.x; x <= hi.x; ++x) {
+                        const TileKey key{z, y, x};
+                        if (const Tile *const tile = findTile(key))
+                            visitTile(callback, context, key, *tile, range.min, range.max);
+                    }
                 }
             }
+            return;
         }
+
+        // Huge window (e.g. zoomed far out): cheaper to filter the existing tiles.
+        const auto isInWindow = [&lo, &hi](const TileKey &key) {
+            return isClamped(key.z, lo.z, hi.z) && isClamped(key.y, lo.y, hi.y)
+                   && isClamped(key.x, lo.x, hi.x);
+        };
+        for (const auto &kv : getSortedTiles(isInWindow))
+            visitTile(callback, context, kv.first, deref(kv.second), range.min, range.max);
     }
 
-    void getRooms(AbstractRoomVisitor &stream, const Coordinate &min, const Coordinate &max) const
+    void getRoomsNear(const Coordinate &center,
+                      const int radius,
+                      std::vector<const Room *> &result) const
     {
-        const auto range = CoordinateMinMax(min, max).expandCopy(Coordinate{1, 1, 1});
-
-        const auto zUpper = map.lower_bound(range.max.z);
-        for (auto z = map.upper_bound(range.min.z); z != zUpper; ++z) {
-            const auto &ymap = (*z).second;
-            const auto yUpper = ymap.lower_bound(range.max.y);
-            for (auto y = ymap.upper_bound(range.min.y); y != yUpper; ++y) {
-                const auto &xmap = (*y).second;
-                const auto xUpper = xmap.lower_bound(range.max.x);
-                for (auto x = xmap.upper_bound(range.min.x); x != xUpper; ++x) {
-                    stream.visit(x->second);
+        for (int dz = -radius; dz <= radius; ++dz) {
+            const int ry = radius - std::abs(dz);
+            for (int dy = -ry; dy <= ry; ++dy) {
+                const int rx = ry - std::abs(dy);
+                for (int dx = -rx; dx <= rx; ++dx) {
+                    const Coordinate c{center.x + dx, center.y + dy, center.z + dz};
+                    if (const Room *const room = get(c))
+                        result.emplace_back(room);
                 }
             }
         }
@@ -84,57 +375,64 @@ class Map::MapOrderedTree final
      */
     bool defined(const Coordinate &c) const
     {
-        const auto &z = map.find(c.z);
-        if (z != map.end()) {
-            auto &ySeg = (*z).second;
-            const auto &y = ySeg.find(c.y);
-            if (y != ySeg.end()) {
-                const auto &xSeg = (*y).second;
-                if (xSeg.find(c.x) != xSeg.end()) {
-                    return true;
-                }
-            }
-        }
-        return false;
+        const Tile *const tile = findTile(keyOf(c));
+        return tile != nullptr && tile->isOccupied(indexOf(c));
     }
 
     Room *get(const Coordinate &c) const
-    { // map<K,V>::operator[] is not const!
-        //    if (!defined(c)) {
-        //        return nullptr;
-        //    }
-        //    return m_map[c.z][c.y][c.x];
-
-        const auto &zmap = map;
-        const auto &z = zmap.find(c.z);
-        if (z == zmap.end())
-            return nullptr;
-
-        const auto &ymap = z->second;
-        const auto &y = ymap.find(c.y);
-        if (y == ymap.end())
-            return nullptr;
-
-        const auto &xmap = y->second;
-        const auto &x = xmap.find(c.x);
-        if (x == xmap.end())
-            return nullptr;
-
-        return x->second;
+    {
+        if (const Tile *const tile = findTile(keyOf(c)))
+            return tile->rooms[indexOf(c)];
+        return nullptr;
     }
 
-    void remove(const Coordinate &c) { map[c.z][c.y].erase(c.x); }
+    void remove(const Coordinate &c)
+    {
+        const auto it = m_tiles.find(keyOf(c));
+        if (it == m_tiles.end())
+            return;
+
+        Tile &tile = deref(it->second);
+        Room *&ref = tile.rooms[indexOf(c)];
+        if (ref == nullptr)
+            return;
+
+        ref = nullptr;
+        tile.setOccupied(indexOf(c), false);
+        m_extents.remove(c);
+        assert(tile.count > 0);
+        if (--tile.count == 0)
+            m_tiles.erase(it);
+    }
 
     /**
      * doesn't modify c
      */
-    void set(const Coordinate &c, Room *room) { map[c.z][c.y][c.x] = room; }
+    void set(const Coordinate &c, Room *const room)
+    {
+        if (room == nullptr) {
+            remove(c);
+            return;
+        }
+
+        auto &tile = m_tiles[keyOf(c)];
+        if (tile == nullptr)
+            tile = std::make_unique<Tile>();
+
+        Room *&ref = tile->rooms[indexOf(c)];
+        if (ref == nullptr) {
+            ++tile->count;
+            tile->setOccupied(indexOf(c), true);
+            m_extents.add(c);
+        }
+        ref = room;
+    }
 };
 
-Map::MapOrderedTree::~MapOrderedTree() = default;
+Map::SpatialGrid::~SpatialGrid() = default;
 
 Map::Map()
-    : m_pimpl{std::make_unique<MapOrderedTree>()}
+    : m_pimpl{std::make_unique<SpatialGrid>()}
 {}
 
 Map::~Map() = default;
@@ -159,14 +457,49 @@ void Map::clear()
     return m_pimpl->clear();
 }
 
+void Map::addMemoryUsage(MemoryUsage &usage) const
+{
+    m_pimpl->addMemoryUsage(usage);
+}
+
+void Map::forEachRun(const RunCallback callback, const void *const context) const
+{
+    m_pimpl->forEachRun(callback, context);
+}
+
+void Map::forEachRun(const Coordinate &min,
+                     const Coordinate &max,
+                     const RunCallback callback,
+                     const void *const context) const
+{
+    m_pimpl->forEachRun(min, max, callback, context);
+}
+
 void Map::getRooms(AbstractRoomVisitor &stream) const
 {
-    return m_pimpl->getRooms(stream);
+    forEachRoom([&stream](const Room *const room) { stream.visit(room); });
 }
 
 void Map::getRooms(AbstractRoomVisitor &stream, const Coordinate &min, const Coordinate &max) const
 {
-    return m_pimpl->getRooms(stream, min, max);
+    forEachRoom(min, max, [&stream](const Room *const room) { stream.visit(room); });
+}
+
+void Map::getRoomsNear(const Coordinate &center,
+                       const int radius,
+                       std::vector<const Room *> &result) const
+{
+    return m_pimpl->getRoomsNear(center, radius, result);
+}
+
+OptMapExtent Map::getBounds() const
+{
+    return m_pimpl->getBounds();
+}
+
+OptMapExtent Map::getLayerExtent(const int z) const
+{
+    return m_pimpl->getLayerExtent(z);
 }
 
 /**
@@ -7,12 +7,28 @@
 
 #include "../expandoracommon/coordinate.h"
 #include "../global/RuleOf5.h"
+#include "../global/macros.h"
 
+#include <cstddef>
 #include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 class AbstractRoomVisitor;
+class MemoryUsage;
 class Room;
 
+struct NODISCARD MapExtent final
+{
+    Coordinate min;
+    Coordinate max;
+
+    bool operator==(const MapExtent &rhs) const { return min == rhs.min && max == rhs.max; }
+    bool operator!=(const MapExtent &rhs) const { return !(*this == rhs); }
+};
+using OptMapExtent = std::optional<MapExtent>;
+
 /**
  * The Map stores the geographic relations of rooms to each other
  * it doesn't store the search tree. The Map class is only used by the
@@ -21,15 +37,16 @@ class Room;
 class Map final
 {
 public:
-    class MapOrderedTree;
+    class SpatialGrid;
 
 private:
-    std::unique_ptr<MapOrderedTree> m_pimpl;
+    std::unique_ptr<SpatialGrid> m_pimpl;
 
 public:
     Map();
     ~Map();
     DELETE_CTORS_AND_ASSIGN_OPS(Map);
+    void swap(Map &other) noexcept { m_pimpl.swap(other.m_pimpl); }
 
 public:
     bool defined(const Coordinate &c) const;
@@ -40,8 +57,53 @@ class Map final
     void getRooms(AbstractRoomVisitor &stream) const;
     void getRooms(AbstractRoomVisitor &stream, const Coordinate &min, const Coordinate &max) const;
 
+    /// Calls f(const Room *) for each room, in the same order as getRooms().
+    /// The grid hands out contiguous runs of cells, so there's one indirect
+    /// call per run instead of one virtual call per room, and f can be inlined.
+    template<typename F>
+    void forEachRoom(F &&f) const
+    {
+        forEachRun(&visitRun<std::remove_reference_t<F>>, std::addressof(f));
+    }
+    template<typename F>
+    void forEachRoom(const Coordinate &min, const Coordinate &max, F &&f) const
+    {
+        forEachRun(min, max, &visitRun<std::remove_reference_t<F>>, std::addressof(f));
+    }
+    /// Appends the rooms within Manhattan distance `radius` of `center`, in (z, y, x) order.
+    void getRoomsNear(const Coordinate &center, int radius, std::vector<const Room *> &result) const;
+
+public:
+    /// Bounding box of all rooms; maintained incrementally, so this is cheap.
+    OptMapExtent getBounds() const;
+    /// Bounding box of the rooms on layer z (min.z == max.z == z).
+    OptMapExtent getLayerExtent(int z) const;
+
+public:
+    void addMemoryUsage(MemoryUsage &usage) const;
+
 private:
     Coordinate getNearestFree(const Coordinate &c);
+
+private:
+    // Cells of a run may be empty (nullptr).
+    using RunCallback = void (*)(const void *context, Room *const *cells, size_t count);
+    void forEachRun(RunCallback callback, const void *context) const;
+    void forEachRun(const Coordinate &min,
+                    const Coordinate &max,
+                    RunCallback callback,
+                    const void *context) const;
+
+    template<typename F>
+    static void visitRun(const void *const context, Room *const *const cells, const size_t count)
+    {
+        // const_cast: the callable was only made const to pass it through void*.
+        F &f = *const_cast<F *>(static_cast<const F *>(context));
+        for (size_t i = 0; i < count; ++i) {
+            if (const Room *const room = cells[i])
+                f(room);
+        }
+    }
 };
 
 class CoordinateIterator final
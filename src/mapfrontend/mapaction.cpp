@@ -23,6 +23,16 @@
 #include "roomcollection.h"
 
 AbstractAction::~AbstractAction() = default;
+
+void AbstractAction::execAll(const std::vector<RoomId> &ids)
+{
+    for (const RoomId id : ids) {
+        preExec(id);
+    }
+    for (const RoomId id : ids) {
+        exec(id);
+    }
+}
 MapAction::~MapAction() = default;
 
 SingleRoomAction::SingleRoomAction(std::unique_ptr<AbstractAction> moved_ex, const RoomId in_id)
@@ -181,6 +191,7 @@ void Remove::exec(const RoomId id)
     }
 
     room->setAboutToDie();
+    notifyRoomRemoved(id);
 }
 
 void FrontendAccessor::setFrontend(MapFrontend *const in)
@@ -204,7 +215,8 @@ RoomIndex &FrontendAccessor::roomIndex()
 }
 Room *FrontendAccessor::roomIndex(const RoomId id) const
 {
-    return m_frontend->roomIndex[id].get();
+    const SharedRoom *const room = m_frontend->roomIndex.tryGet(id);
+    return room != nullptr ? room->get() : nullptr;
 }
 
 RoomHomes &FrontendAccessor::roomHomes()
@@ -215,3 +227,8 @@ const SharedRoomCollection &FrontendAccessor::roomHomes(const RoomId id) const
 {
     return m_frontend->roomHomes[id];
 }
+
+void FrontendAccessor::notifyRoomRemoved(const RoomId id)
+{
+    m_frontend->virt_onRoomRemoved(id);
+}
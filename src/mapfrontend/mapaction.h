@@ -45,6 +45,8 @@ class FrontendAccessor
 
     RoomHomes &roomHomes();
     const SharedRoomCollection &roomHomes(RoomId) const;
+
+    void notifyRoomRemoved(RoomId);
 };
 
 class AbstractAction : public virtual FrontendAccessor
@@ -55,6 +57,10 @@ class AbstractAction : public virtual FrontendAccessor
 
     virtual void exec(RoomId id) = 0;
 
+    // Runs the action on each room of a GroupMapAction: by default, preExec() on
+    // all of them, then exec() on all of them.
+    virtual void execAll(const std::vector<RoomId> &ids);
+
     virtual void insertAffected(RoomId id, std::set<RoomId> &affected) { affected.insert(id); }
 };
 
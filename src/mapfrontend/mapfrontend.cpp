@@ -6,43 +6,93 @@
 
 #include "mapfrontend.h"
 
+#include <algorithm>
 #include <cassert>
+#include <climits>
+#include <exception>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <utility>
+#include <vector>
 #include <QMutex>
+#include <QMutexLocker>
 
 #include "../expandoracommon/RoomRecipient.h"
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/parseevent.h"
 #include "../expandoracommon/room.h"
+#include "../global/MemoryUsage.h"
+#include "../global/ParallelFor.h"
 #include "../global/roomid.h"
+#include "MapLock.h"
 #include "ParseTree.h"
 #include "map.h"
 #include "mapaction.h"
 #include "roomcollection.h"
+#include "AbstractRoomVisitor.h"
 #include "roomlocker.h"
 
+namespace {
+// Collects the ids (not pointers, since delivering one room may release
+// another) and distances of the rooms the parse tree considers matches.
+class NearbyRoomCollector final : public AbstractRoomVisitor
+{
+public:
+    struct Candidate final
+    {
+        RoomId id;
+        int distance = 0;
+    };
+
+private:
+    const ParseEvent &m_event;
+    const Coordinate m_center;
+    std::vector<Candidate> m_candidates;
+    int m_nearest = INT_MAX;
+
+public:
+    explicit NearbyRoomCollector(const ParseEvent &event, const Coordinate &center)
+        : m_event{event}
+        , m_center{center}
+    {}
+
+public:
+    void visit(const Room *const room) override
+    {
+        if (Room::compareWeakProps(room, m_event) == ComparisonResultEnum::DIFFERENT)
+            return;
+        const int distance = room->getPosition().distance(m_center);
+        m_nearest = std::min(m_nearest, distance);
+        m_candidates.emplace_back(Candidate{room->getId(), distance});
+    }
+
+public:
+    bool empty() const { return m_candidates.empty(); }
+    int getNearestDistance() const { return m_nearest; }
+    const std::vector<Candidate> &getCandidates() const { return m_candidates; }
+};
+} // namespace
+
 MapFrontend::MapFrontend(QObject *const parent)
     : QObject(parent)
-    , mapLock(QMutex::Recursive)
 {}
 
 MapFrontend::~MapFrontend()
 {
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
     emit sig_clearingMap();
 }
 
 void MapFrontend::block()
 {
-    mapLock.lock();
+    mapLock.lockForWrite();
     blockSignals(true);
 }
 
 void MapFrontend::unblock()
 {
-    mapLock.unlock();
+    mapLock.unlockForWrite();
     blockSignals(false);
 }
 
@@ -51,16 +101,43 @@ void MapFrontend::checkSize()
     emit sig_mapSizeChanged(getMin(), getMax());
 }
 
+MapFrontend::ModificationBatch::ModificationBatch(MapFrontend &frontend)
+    : m_frontend{frontend}
+{
+    assert(m_frontend.mapLock.isLockedForWriteByCurrentThread());
+    ++m_frontend.m_batchDepth;
+}
+
+MapFrontend::ModificationBatch::~ModificationBatch()
+{
+    assert(m_frontend.m_batchDepth > 0);
+    // Delivered while still in the batch, so whatever they trigger is reported with it.
+    if (m_frontend.m_batchDepth == 1 && !m_frontend.m_pendingRoomUpdates.empty()) {
+        const std::vector<std::pair<RoomId, RoomUpdateFlags>>
+            updates{m_frontend.m_pendingRoomUpdates.begin(), m_frontend.m_pendingRoomUpdates.end()};
+        m_frontend.m_pendingRoomUpdates.clear();
+        m_frontend.virt_onRoomsModified(updates);
+    }
+    if (--m_frontend.m_batchDepth == 0) {
+        m_frontend.virt_onModificationBatchFinished();
+    }
+}
+
 void MapFrontend::scheduleAction(const std::shared_ptr<MapAction> &action)
 {
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
+    // An action usually changes several fields of each room it affects.
+    const ModificationBatch batch{*this};
     action->schedule(this);
 
+    const RoomIdSet &affected = action->getAffectedRooms();
+    actionSchedule.add(action, affected);
+
     bool executable = true;
-    for (auto roomId : action->getAffectedRooms()) {
-        actionSchedule[roomId].insert(action);
-        if (!locks[roomId].empty()) {
+    for (auto roomId : affected) {
+        if (locks.isLocked(roomId)) {
             executable = false;
+            break;
         }
     }
     if (executable) {
@@ -69,54 +146,114 @@ void MapFrontend::scheduleAction(const std::shared_ptr<MapAction> &action)
     }
 }
 
+void MapFrontend::scheduleActions(const std::vector<SharedMapAction> &actions)
+{
+    MapWriteLocker locker(mapLock);
+    const ModificationBatch batch{*this};
+    for (const SharedMapAction &action : actions) {
+        scheduleAction(action);
+    }
+}
+
 void MapFrontend::executeAction(MapAction *const action)
 {
     action->exec();
+    // Actions can move or remove rooms.
+    updateBounds();
 }
 
 void MapFrontend::removeAction(const std::shared_ptr<MapAction> &action)
 {
-    for (auto roomId : action->getAffectedRooms()) {
-        actionSchedule[roomId].erase(action);
-    }
+    actionSchedule.remove(action.get());
 }
 
 bool MapFrontend::isExecutable(MapAction *const action)
 {
     for (auto roomId : action->getAffectedRooms()) {
-        if (!locks[roomId].empty()) {
+        if (locks.isLocked(roomId)) {
             return false;
         }
     }
     return true;
 }
 
+const RoomIdSet &MapFrontend::getAffectedRooms(MapAction &action)
+{
+    return action.getAffectedRooms();
+}
+
 void MapFrontend::executeActions(const RoomId roomId)
 {
-    std::set<std::shared_ptr<MapAction>> executedActions;
-    for (const auto &action : actionSchedule[roomId]) {
+    const std::vector<SharedMapAction> pending = actionSchedule.getPending(roomId);
+    if (pending.empty()) {
+        return;
+    }
+
+    const ModificationBatch batch{*this};
+    for (const SharedMapAction &action : pending) {
         if (isExecutable(action.get())) {
             executeAction(action.get());
-            executedActions.insert(action);
+            removeAction(action);
         }
     }
-    for (const auto &action : executedActions) {
-        removeAction(action);
-    }
 }
 
 void MapFrontend::lookingForRooms(RoomRecipient &recipient, const Coordinate &pos)
 {
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
     if (Room *const r = map.get(pos)) {
-        locks[r->getId()].insert(&recipient);
+        locks.insert(r->getId(), &recipient);
         recipient.receiveRoom(this, r);
     }
 }
 
+void MapFrontend::addMemoryUsage(MemoryUsage &usage) const
+{
+    MapReadLocker locker(mapLock);
+    size_t numRooms = 0;
+    for (const SharedRoom &room : roomIndex) {
+        if (room != nullptr) {
+            room->addMemoryUsage(usage);
+            ++numRooms;
+        }
+    }
+    usage.add("room index",
+              numRooms,
+              roomIndex.capacity() * sizeof(SharedRoom)
+                  + roomHomes.capacity() * sizeof(SharedRoomCollection));
+    map.addMemoryUsage(usage);
+    parseTree.addMemoryUsage(usage);
+    similarRooms.addMemoryUsage(usage);
+}
+
+void MapFrontend::virt_onNotifyModified(Room &room, const RoomUpdateFlags updateFlags)
+{
+    RoomAdmin::virt_onNotifyModified(room, updateFlags);
+    if (isInModificationBatch()) {
+        m_pendingRoomUpdates[room.getId()] |= updateFlags;
+        return;
+    }
+    virt_onRoomsModified({{room.getId(), updateFlags}});
+}
+
+void MapFrontend::virt_onRoomsModified(
+    const std::vector<std::pair<RoomId, RoomUpdateFlags>> &updates)
+{
+    if (!similarRooms.isBuilt())
+        return;
+    for (const auto &[id, flags] : updates) {
+        if (!flags.contains(RoomUpdateEnum::StaticDesc) || id == INVALID_ROOMID)
+            continue;
+        // The old entries stay, but candidates are compared with the room anyway.
+        const SharedRoom *const room = roomIndex.tryGet(id);
+        if (room != nullptr && *room != nullptr)
+            similarRooms.insert(id, (*room)->getStaticDescWords());
+    }
+}
+
 void MapFrontend::clear()
 {
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
     emit sig_clearingMap();
 
     for (size_t i = 0, size = roomIndex.size(); i < size; ++i) {
@@ -131,10 +268,12 @@ void MapFrontend::clear()
         if (SharedRoomCollection h = std::exchange(roomHomes[roomId], nullptr)) {
             h->clear();
         }
-        locks[roomId].clear();
+        locks.clear(roomId);
     }
 
     map.clear();
+    similarRooms.clear();
+    temporaryRooms.clear();
 
     while (!unusedIds.empty()) {
         unusedIds.pop();
@@ -146,13 +285,26 @@ void MapFrontend::clear()
 
 void MapFrontend::lookingForRooms(RoomRecipient &recipient, const RoomId id)
 {
-    QMutexLocker locker(&mapLock);
-    if (greatestUsedId >= id) {
-        if (const SharedRoom &r = roomIndex[id]) {
-            locks[id].insert(&recipient);
-            recipient.receiveRoom(this, r.get());
-        }
+    MapWriteLocker locker(mapLock);
+    // greatestUsedId is INVALID_ROOMID when the map is empty.
+    if (greatestUsedId == INVALID_ROOMID || greatestUsedId < id)
+        return;
+    if (const SharedRoom *const r = roomIndex.tryGet(id); r != nullptr && *r) {
+        locks.insert(id, &recipient);
+        recipient.receiveRoom(this, r->get());
+    }
+}
+
+void MapFrontend::lookingForAllRooms(RoomRecipient &recipient)
+{
+    MapWriteLocker locker(mapLock);
+    std::vector<const Room *> rooms;
+    rooms.reserve(roomIndex.size());
+    for (const SharedRoom &room : roomIndex) {
+        if (room != nullptr)
+            rooms.emplace_back(room.get());
     }
+    deliverRooms(recipient, rooms);
 }
 
 RoomId MapFrontend::assignId(const SharedRoom &room, const SharedRoomCollection &roomHome)
@@ -176,108 +328,192 @@ RoomId MapFrontend::assignId(const SharedRoom &room, const SharedRoomCollection
     room->setId(id);
 
     if (roomIndex.size() <= id.asUint32()) {
-        const auto bigger = id.asUint32() * 2u + 1u;
-        roomIndex.resize(bigger, nullptr);
-        locks.resize(bigger);
-        roomHomes.resize(bigger, nullptr);
+        reserveIds(RoomId{id.asUint32() * 2u});
     }
     roomIndex[id] = room;
     roomHomes[id] = roomHome;
     return id;
 }
 
+void MapFrontend::reserveIds(const RoomId maxId)
+{
+    const auto size = static_cast<size_t>(maxId.asUint32()) + 1u;
+    if (roomIndex.size() >= size)
+        return;
+    roomIndex.resize(size, nullptr);
+    locks.resize(size);
+    roomHomes.resize(size, nullptr);
+}
+
 void MapFrontend::lookingForRooms(RoomRecipient &recipient,
                                   const Coordinate &input_min,
                                   const Coordinate &input_max)
 {
-    QMutexLocker locker(&mapLock);
-    RoomLocker ret(recipient, *this);
-    map.getRooms(ret, input_min, input_max);
+    MapWriteLocker locker(mapLock);
+    std::vector<const Room *> rooms;
+    map.forEachRoom(input_min, input_max, [&rooms](const Room *const room) {
+        rooms.emplace_back(room);
+    });
+    if (rooms.empty())
+        return;
+
+    // Whole zones can be dragged over, so the rooms are locked and handed over at once.
+    deliverRooms(recipient, rooms);
 }
 
 void MapFrontend::insertPredefinedRoom(const SharedRoom &sharedRoom)
 {
-    Room &room = deref(sharedRoom);
+    const auto event = Room::getEvent(&deref(sharedRoom));
+    insertPredefinedRoom(sharedRoom, ParseTree::computeKeys(*event));
+}
 
-    QMutexLocker locker(&mapLock);
+void MapFrontend::insertPredefinedRoom(const SharedRoom &sharedRoom, const ParseKeys &keys)
+{
+    MapWriteLocker locker(mapLock);
+    assert(signalsBlocked());
+    insertPredefinedRoomLocked(sharedRoom, keys);
+    updateBounds();
+}
+
+void MapFrontend::insertPredefinedRooms(const std::vector<SharedRoom> &rooms)
+{
+    // Computing the keys reads every name and description, so it's the part worth
+    // spreading over the pool; the rooms aren't in the map yet, so no lock is needed.
+    std::vector<ParseKeys> keys(rooms.size());
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    parallelFor(rooms.size(), 256, [&](const size_t begin, const size_t end) {
+        try {
+            for (size_t i = begin; i < end; ++i)
+                keys[i] = ParseTree::computeKeys(*Room::getEvent(rooms[i].get()));
+        } catch (...) {
+            std::lock_guard<std::mutex> lock{errorMutex};
+            if (!error)
+                error = std::current_exception();
+        }
+    });
+    if (error)
+        std::rethrow_exception(error);
+
+    MapWriteLocker locker(mapLock);
     assert(signalsBlocked());
+    RoomId maxId = greatestUsedId;
+    for (const SharedRoom &room : rooms) {
+        const RoomId id = deref(room).getId();
+        if (maxId == INVALID_ROOMID || id > maxId)
+            maxId = id;
+    }
+    if (maxId != INVALID_ROOMID)
+        reserveIds(maxId);
+    parseTree.reserveMore(rooms.size());
+    for (size_t i = 0; i < rooms.size(); ++i)
+        insertPredefinedRoomLocked(rooms[i], keys[i]);
+    updateBounds();
+}
+
+void MapFrontend::takeRoomsFrom(MapFrontend &other)
+{
+    MapWriteLocker locker(mapLock);
+    MapWriteLocker otherLocker(other.mapLock);
+    assert(signalsBlocked());
+
+    parseTree.swap(other.parseTree);
+    similarRooms.clear();
+    other.similarRooms.clear();
+    map.swap(other.map);
+    roomIndex.swap(other.roomIndex);
+    unusedIds.swap(other.unusedIds);
+    temporaryRooms.swap(other.temporaryRooms);
+    roomHomes.swap(other.roomHomes);
+    std::swap(greatestUsedId, other.greatestUsedId);
+    for (const SharedRoom &room : roomIndex) {
+        if (room != nullptr)
+            room->setTracker(*this);
+    }
+    for (const SharedRoom &room : other.roomIndex) {
+        if (room != nullptr)
+            room->setTracker(other);
+    }
+
+    // The locks stay, since their holders will still release them; so the tables
+    // have to keep covering every id that was reserved before.
+    const size_t size = std::max(roomIndex.size(), other.roomIndex.size());
+    roomIndex.resize(size, nullptr);
+    roomHomes.resize(size, nullptr);
+    locks.resize(size);
+    other.locks.resize(other.roomIndex.size());
+    updateBounds();
+}
+
+void MapFrontend::insertPredefinedRoomLocked(const SharedRoom &sharedRoom, const ParseKeys &keys)
+{
+    Room &room = deref(sharedRoom);
     const auto id = room.getId();
     const Coordinate &c = room.getPosition();
-    auto event = Room::getEvent(&room);
 
     assert(roomIndex.size() <= id.asUint32() || roomIndex[id] == nullptr);
 
-    auto roomHome = parseTree.insertRoom(*event);
+    auto roomHome = parseTree.insertRoom(keys);
     map.setNearest(c, room);
-    checkSize(room.getPosition());
     unusedIds.push(id);
     assignId(sharedRoom, roomHome);
     if (roomHome != nullptr) {
         roomHome->addRoom(sharedRoom);
     }
+    // Rebuilt when it's next needed, rather than loading the room's description now.
+    similarRooms.clear();
 }
 
 RoomId MapFrontend::createEmptyRoom(const Coordinate &c)
 {
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
     SharedRoom room = Room::createPermanentRoom(*this);
     map.setNearest(c, *room);
-    checkSize(room->getPosition());
+    updateBounds();
     return assignId(room, nullptr);
 }
 
-void MapFrontend::checkSize(const Coordinate &c)
+void MapFrontend::updateBounds()
 {
-    if (!m_bounds) {
-        m_bounds.emplace();
-        m_bounds->min = m_bounds->max = c;
-        emit sig_mapSizeChanged(c, c);
+    // Only report changes: this is called after every room insertion, and
+    // a map load would otherwise signal once per room.
+    OptMapExtent bounds = map.getBounds();
+    if (bounds == m_bounds) {
         return;
     }
-
-#define MINMAX(xyz) \
-    do { \
-        auto &lo = min.xyz; \
-        auto &hi = max.xyz; \
-        lo = std::min(lo, c.xyz); \
-        hi = std::max(hi, c.xyz); \
-    } while (false)
-
-    auto &min = m_bounds->min;
-    auto &max = m_bounds->max;
-
-    const Coordinate oldMin{min};
-    const Coordinate oldMax{max};
-
-    MINMAX(x);
-    MINMAX(y);
-    MINMAX(z);
-
-    if (min != oldMin || max != oldMax) {
-        emit sig_mapSizeChanged(min, max);
+    m_bounds = bounds;
+    if (m_bounds) {
+        emit sig_mapSizeChanged(m_bounds->min, m_bounds->max);
     }
+}
 
-#undef MINMAX
+OptMapExtent MapFrontend::getLayerExtent(const int z) const
+{
+    MapReadLocker locker(mapLock);
+    return map.getLayerExtent(z);
 }
 
 void MapFrontend::createRoom(const SigParseEvent &sigParseEvent, const Coordinate &expectedPosition)
 {
     const ParseEvent &event = sigParseEvent.deref();
 
-    QMutexLocker locker(&mapLock);
-    checkSize(expectedPosition); // still hackish but somewhat better
+    MapWriteLocker locker(mapLock);
     if (SharedRoomCollection roomHome = parseTree.insertRoom(event)) {
         SharedRoom room = Room::createTemporaryRoom(*this, event);
-        roomHome->addRoom(room);
         map.setNearest(expectedPosition, *room);
-        assignId(room, roomHome);
+        // RoomCollection is keyed by id, so the id must be assigned first.
+        temporaryRooms.emplace_back(assignId(room, roomHome));
+        roomHome->addRoom(room);
+        if (similarRooms.isBuilt())
+            similarRooms.insert(room->getId(), room->getStaticDescWords());
+        updateBounds();
     }
 }
 
 void MapFrontend::lookingForRooms(RoomRecipient &recipient, const SigParseEvent &sigParseEvent)
 {
     const ParseEvent &event = sigParseEvent.deref();
-    QMutexLocker locker(&mapLock);
+    MapWriteLocker locker(mapLock);
     if (greatestUsedId == INVALID_ROOMID) {
         Coordinate c(0, 0, 0);
         createRoom(sigParseEvent, c);
@@ -287,45 +523,172 @@ void MapFrontend::lookingForRooms(RoomRecipient &recipient, const SigParseEvent
     }
 
     RoomLocker ret(recipient, *this, &event);
-    parseTree.getRooms(ret, event);
+    parseTree.getRooms(roomIndex, ret, event);
+    ret.deliver();
+}
+
+void MapFrontend::lookingForNearbyRooms(RoomRecipient &recipient,
+                                        const SigParseEvent &sigParseEvent,
+                                        const Coordinate &center,
+                                        const int radius)
+{
+    const ParseEvent &event = sigParseEvent.deref();
+    MapWriteLocker locker(mapLock);
+    if (greatestUsedId == INVALID_ROOMID) {
+        // Let the regular lookup create the first room.
+        lookingForRooms(recipient, sigParseEvent);
+        return;
+    }
+
+    NearbyRoomCollector collector{event, center};
+    parseTree.getRooms(roomIndex, collector, event);
+    if (collector.empty())
+        return;
+
+    // Without a match inside the radius the last known position says nothing
+    // about where we are, so every match is offered, as the full lookup would.
+    const int bound = std::max(1, radius);
+    const bool anyNearby = collector.getNearestDistance() <= bound;
+
+    std::vector<const Room *> rooms;
+    for (const auto &candidate : collector.getCandidates()) {
+        if (anyNearby && candidate.distance > bound)
+            continue;
+        if (const SharedRoom &room = roomIndex[candidate.id])
+            rooms.emplace_back(room.get());
+    }
+    deliverRooms(recipient, rooms);
+}
+
+void MapFrontend::lookingForSimilarRooms(RoomRecipient &recipient,
+                                        const SigParseEvent &sigParseEvent,
+                                        const int tolerance)
+{
+    const ParseEvent &event = sigParseEvent.deref();
+    MapWriteLocker locker(mapLock);
+    if (!similarRooms.isBuilt()) {
+        for (const SharedRoom &room : roomIndex) {
+            if (room != nullptr)
+                similarRooms.insert(room->getId(), room->getStaticDescWords());
+        }
+        similarRooms.setBuilt();
+    }
+
+    std::vector<const Room *> rooms;
+    for (const RoomId id : similarRooms.getCandidates(event.getStaticDescWords())) {
+        if (id.asUint32() >= roomIndex.size())
+            continue;
+        const Room *const room = roomIndex[id].get();
+        if (room != nullptr
+            && Room::compare(room, event, tolerance) != ComparisonResultEnum::DIFFERENT)
+            rooms.emplace_back(room);
+    }
+    deliverRooms(recipient, rooms);
+}
+
+void MapFrontend::lookingForRoomsNear(RoomRecipient &recipient,
+                                      const Coordinate &center,
+                                      const int radius,
+                                      const PromptFlagsType promptFlags)
+{
+    MapWriteLocker locker(mapLock);
+
+    std::vector<const Room *> rooms;
+    map.getRoomsNear(center, radius, rooms);
+
+    if (promptFlags.isValid()) {
+        const auto terrain = promptFlags.getTerrainType();
+        rooms.erase(std::remove_if(rooms.begin(),
+                                   rooms.end(),
+                                   [terrain](const Room *const room) {
+                                       return room->isUpToDate()
+                                              && room->getTerrainType() != terrain;
+                                   }),
+                    rooms.end());
+    }
+    deliverRooms(recipient, rooms);
 }
 
 void MapFrontend::lockRoom(RoomRecipient *const recipient, const RoomId id)
 {
-    locks[id].insert(recipient);
+    // Readers may lock rooms concurrently, so the lock table needs its own guard.
+    QMutexLocker locker(&m_locksMutex);
+    locks.insert(id, recipient);
+}
+
+// Every room is locked before any is handed over, so a recipient that releases
+// (and thereby deletes) one room can't pull the others out from under the batch.
+void MapFrontend::deliverRooms(RoomRecipient &recipient, const std::vector<const Room *> &rooms)
+{
+    if (rooms.empty())
+        return;
+    {
+        QMutexLocker locker(&m_locksMutex);
+        for (const Room *const room : rooms)
+            locks.insert(room->getId(), &recipient);
+    }
+    recipient.receiveRooms(this, rooms);
 }
 
 // removes the lock on a room
 // after the last lock is removed, the room is deleted
 void MapFrontend::releaseRoom(RoomRecipient &sender, const RoomId id)
 {
-    QMutexLocker lock(&mapLock);
-    auto &room_locks_ref = locks[id];
-    room_locks_ref.erase(&sender);
-    if (room_locks_ref.empty()) {
+    MapWriteLocker locker(mapLock);
+    locks.erase(id, &sender);
+    if (!locks.isLocked(id)) {
+        // Temporary rooms are left for sweepTemporaryRooms().
         executeActions(id);
-        if (const SharedRoom &room = roomIndex[id]) {
-            // REVISIT: Why do temporary rooms exist?
-            // Also, note: After the conversion to SharedRoom, it's no longer necessary
-            // to explicitly delete rooms. Just release all references to them.
-            if (room->isTemporary()) {
-                scheduleAction(std::make_shared<SingleRoomAction>(std::make_unique<Remove>(), id));
-            }
-        }
     }
 }
 
+void MapFrontend::sweepTemporaryRooms()
+{
+    MapWriteLocker locker(mapLock);
+    if (temporaryRooms.empty())
+        return;
+
+    // REVISIT: Why do temporary rooms exist?
+    // Also, note: After the conversion to SharedRoom, it's no longer necessary
+    // to explicitly delete rooms. Just release all references to them.
+    std::vector<SharedMapAction> removals;
+    std::vector<RoomId> held;
+    for (const RoomId id : std::exchange(temporaryRooms, {})) {
+        const SharedRoom *const room = roomIndex.tryGet(id);
+        if (room == nullptr || *room == nullptr || !(*room)->isTemporary())
+            continue;
+        if (locks.isLocked(id))
+            held.emplace_back(id);
+        else
+            removals.emplace_back(
+                std::make_shared<SingleRoomAction>(std::make_unique<Remove>(), id));
+    }
+    temporaryRooms = std::move(held);
+    if (!removals.empty())
+        scheduleActions(removals);
+}
+
+void MapFrontend::releaseRooms(const std::vector<std::pair<RoomRecipient *, RoomId>> &toRelease)
+{
+    if (toRelease.empty())
+        return;
+    MapWriteLocker locker(mapLock);
+    const ModificationBatch batch{*this};
+    for (const auto &lock : toRelease)
+        releaseRoom(*lock.first, lock.second);
+}
+
 // REVISIT: This is sent too often. Hunt down and kill the unnecessary cases (probably most of them).
 //
 // makes a lock on a room permanent and anonymous.
 // Like that the room can't be deleted via releaseRoom anymore.
 void MapFrontend::keepRoom(RoomRecipient &sender, const RoomId id)
 {
-    QMutexLocker lock(&mapLock);
-    auto &lock_ref = locks[id];
-    lock_ref.erase(&sender);
+    MapWriteLocker locker(mapLock);
+    const ModificationBatch batch{*this};
+    locks.erase(id, &sender);
     scheduleAction(std::make_shared<SingleRoomAction>(std::make_unique<MakePermanent>(), id));
-    if (lock_ref.empty()) {
+    if (!locks.isLocked(id)) {
         executeActions(id);
     }
 }
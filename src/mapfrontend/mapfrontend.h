@@ -10,6 +10,9 @@
 #include <optional>
 #include <set>
 #include <stack>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <QMutex>
 #include <QString>
 #include <QtCore>
@@ -17,9 +20,14 @@
 #include "../expandoracommon/RoomAdmin.h"
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/parseevent.h"
+#include "../global/RuleOf5.h"
 #include "../global/roomid.h"
 #include "../mapdata/infomark.h"
+#include "ActionSchedule.h"
+#include "MapLock.h"
 #include "ParseTree.h"
+#include "RoomLocks.h"
+#include "SimilarRoomIndex.h"
 #include "map.h"
 
 class MapAction;
@@ -39,34 +47,98 @@ class MapFrontend : public QObject, public RoomAdmin, public InfoMarkModificatio
 
 protected:
     ParseTree parseTree;
+    // Only built once lookingForSimilarRooms() needs it.
+    SimilarRoomIndex similarRooms;
     Map map;
     RoomIndex roomIndex;
     std::stack<RoomId> unusedIds;
-    std::map<RoomId, std::set<std::shared_ptr<MapAction>>> actionSchedule;
+    ActionSchedule actionSchedule;
     RoomHomes roomHomes;
     RoomLocks locks;
+    // The rooms createRoom() made for the path machine that haven't been swept yet
+    // (see sweepTemporaryRooms()); some may have been made permanent since.
+    std::vector<RoomId> temporaryRooms;
 
     RoomId greatestUsedId = INVALID_ROOMID;
-    QMutex mapLock;
-    struct Bounds final
-    {
-        Coordinate min;
-        Coordinate max;
-    };
-    std::optional<Bounds> m_bounds;
+    // Readers (searches, mesh generation, queries) take MapReadLocker; anything that
+    // changes rooms, locks or actions, or calls back into a RoomRecipient, takes
+    // MapWriteLocker.
+    mutable MapLock mapLock;
+    // Guards `locks` when lockRoom() is called by a reader.
+    QMutex m_locksMutex;
+    // Last bounds reported via sig_mapSizeChanged; the Map keeps the real ones.
+    OptMapExtent m_bounds;
+    int m_batchDepth = 0;
+    // The rooms changed during the current ModificationBatch, with all of their
+    // changes OR'ed together; they're delivered once, just before it finishes.
+    std::unordered_map<RoomId, RoomUpdateFlags> m_pendingRoomUpdates;
 
     void executeActions(RoomId roomId);
     void executeAction(MapAction *action);
     bool isExecutable(MapAction *action);
+    static const RoomIdSet &getAffectedRooms(MapAction &action);
     void removeAction(const std::shared_ptr<MapAction> &action);
 
     RoomId assignId(const SharedRoom &room, const SharedRoomCollection &roomHome);
-    void checkSize(const Coordinate &);
+    void reserveIds(RoomId maxId);
+    void insertPredefinedRoomLocked(const SharedRoom &room, const ParseKeys &keys);
+    void updateBounds();
+    // Replaces this map's rooms with those of `other` (e.g. a map that was loaded
+    // on another thread), which is left with this map's old ones. Nothing is copied,
+    // and the rooms are told that this is their admin now.
+    void takeRoomsFrom(MapFrontend &other);
+
+    // Called after a room has been taken out of the room index.
+    virtual void virt_onRoomRemoved(RoomId /*id*/) {}
+    // Collects the changes to each room while in a ModificationBatch; otherwise they're
+    // delivered right away.
+    void virt_onNotifyModified(Room &room, RoomUpdateFlags updateFlags) final;
+    using InfoMarkModificationTracker::virt_onNotifyModified;
+    // Called once per batch with every room that changed (each one once), or for each
+    // change made outside a batch; rooms removed since then are included.
+    // Subclasses that override this must call it.
+    virtual void virt_onRoomsModified(
+        const std::vector<std::pair<RoomId, RoomUpdateFlags>> &updates);
+
+    // Groups modifications made while it's alive (e.g. one action per selected
+    // room) so subclasses can report them once in virt_onModificationBatchFinished().
+    // Must be used while holding the write lock.
+    class ModificationBatch final
+    {
+    private:
+        MapFrontend &m_frontend;
+
+    public:
+        explicit ModificationBatch(MapFrontend &frontend);
+        ~ModificationBatch();
+        DELETE_CTORS_AND_ASSIGN_OPS(ModificationBatch);
+    };
+    bool isInModificationBatch() const { return m_batchDepth > 0; }
+    virtual void virt_onModificationBatchFinished() {}
 
 public:
     explicit MapFrontend(QObject *parent = nullptr);
     virtual ~MapFrontend() override;
 
+public:
+    /// Counts the rooms and the structures that find them; takes the read lock.
+    void addMemoryUsage(MemoryUsage &usage) const;
+
+    /// Calls f(const Room *) for each room (see Map::forEachRoom()) while holding
+    /// the read lock, so f must not take the write lock or keep the pointers.
+    template<typename F>
+    void forEachRoom(F &&f) const
+    {
+        MapReadLocker locker(mapLock);
+        map.forEachRoom(std::forward<F>(f));
+    }
+    template<typename F>
+    void forEachRoom(const Coordinate &min, const Coordinate &max, F &&f) const
+    {
+        MapReadLocker locker(mapLock);
+        map.forEachRoom(min, max, std::forward<F>(f));
+    }
+
 public:
     virtual void clear();
     void block();
@@ -76,33 +148,64 @@ class MapFrontend : public QObject, public RoomAdmin, public InfoMarkModificatio
     // removes the lock on a room
     // after the last lock is removed, the room is deleted
     void releaseRoom(RoomRecipient &, RoomId) final;
+    // Takes the write lock once for all of them, and reports the changes as one batch.
+    void releaseRooms(const std::vector<std::pair<RoomRecipient *, RoomId>> &locks) final;
 
     // makes a lock on a room permanent and anonymous.
     // Like that the room can't be deleted via releaseRoom anymore.
     void keepRoom(RoomRecipient &, RoomId) final;
 
     void lockRoom(RoomRecipient *, RoomId);
+    // Locks all of the rooms with one acquisition of the lock table, then hands
+    // them over in a single receiveRooms() call.
+    void deliverRooms(RoomRecipient &, const std::vector<const Room *> &rooms);
     RoomId createEmptyRoom(const Coordinate &);
     void insertPredefinedRoom(const SharedRoom &);
+    // Files the room under keys computed earlier, so its text isn't needed.
+    void insertPredefinedRoom(const SharedRoom &, const ParseKeys &keys);
+    // Inserts many rooms under one lock, sizing the indexes once and computing
+    // their keys in parallel; the bounds are reported once at the end.
+    void insertPredefinedRooms(const std::vector<SharedRoom> &rooms);
     RoomId getMaxId() { return greatestUsedId; }
     Coordinate getMin() const { return m_bounds ? m_bounds->min : Coordinate{}; }
     Coordinate getMax() const { return m_bounds ? m_bounds->max : Coordinate{}; }
+    OptMapExtent getLayerExtent(int z) const;
 
 public:
     void scheduleAction(const std::shared_ptr<MapAction> &action) final;
+    // Schedules the actions in order under a single lock, as one modification batch.
+    void scheduleActions(const std::vector<SharedMapAction> &actions);
 
 public slots:
     // looking for rooms leads to a bunch of foundRoom() signals
     void lookingForRooms(RoomRecipient &, const SigParseEvent &);
     void lookingForRooms(RoomRecipient &, RoomId); // by id
+    // Every room, in id order, in one batch; cheaper than looking for each id.
+    void lookingForAllRooms(RoomRecipient &);
     void lookingForRooms(RoomRecipient &, const Coordinate &);
     void lookingForRooms(RoomRecipient &,
                          const Coordinate &,
                          const Coordinate &); // by bounding box
+    // Like lookingForRooms(RoomRecipient &, const SigParseEvent &), but only
+    // delivers the matches within the radius of the given position. If none
+    // are that close, every match is delivered.
+    void lookingForNearbyRooms(RoomRecipient &, const SigParseEvent &, const Coordinate &, int radius);
+    // Rooms within the given Manhattan distance of the coordinate, skipping
+    // up-to-date rooms whose terrain contradicts the prompt (if it's valid),
+    // since Room::compare() would reject those anyway.
+    void lookingForRoomsNear(RoomRecipient &, const Coordinate &, int radius, PromptFlagsType);
+    // For when there are no exact matches: rooms whose static description is
+    // nearly the same as the event's (see SimilarRoomIndex), and that
+    // Room::compare() accepts within the tolerance.
+    void lookingForSimilarRooms(RoomRecipient &, const SigParseEvent &, int tolerance);
 
     // createRoom creates a room without a lock
     // it will get deleted if no one looks for it for a certain time
     void createRoom(const SigParseEvent &, const Coordinate &);
+    // Removes the temporary rooms that no one holds any more, all at once; the
+    // path machine asks for this whenever it's sure of the player's room again.
+    // Until then released temporary rooms stay, so they can still be found.
+    void sweepTemporaryRooms();
 
     void slot_scheduleAction(std::shared_ptr<MapAction> action) { scheduleAction(action); }
 
@@ -5,6 +5,7 @@
 
 #include "roomcollection.h"
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 
@@ -20,15 +21,48 @@
 
 #define DEBUG_LOCK() DEBUG_ONLY(assert(!m_inUse); const RAIIBool useLock{m_inUse})
 
+bool RoomCollection::contains(const RoomId id) const
+{
+    return std::binary_search(begin(), end(), id);
+}
+
 void RoomCollection::addRoom(Room *const room)
 {
-    if (room == nullptr) {
+    if (room == nullptr || room->getId() == INVALID_ROOMID) {
         assert(false);
         return;
     }
 
     DEBUG_LOCK();
-    m_rooms.insert(room->shared_from_this());
+    const RoomId id = room->getId();
+
+    if (isSpilled()) {
+        const auto it = std::lower_bound(m_spilled.begin(), m_spilled.end(), id);
+        if (it == m_spilled.end() || *it != id) {
+            m_spilled.insert(it, id);
+        }
+        return;
+    }
+
+    RoomId *const first = m_inline.data();
+    RoomId *const last = first + m_inlineSize;
+    RoomId *const pos = std::lower_bound(first, last, id);
+    if (pos != last && *pos == id) {
+        return;
+    }
+
+    if (m_inlineSize < INLINE_CAPACITY) {
+        std::move_backward(pos, last, last + 1);
+        *pos = id;
+        ++m_inlineSize;
+        return;
+    }
+
+    m_spilled.reserve(INLINE_CAPACITY * 2);
+    m_spilled.assign(first, pos);
+    m_spilled.push_back(id);
+    m_spilled.insert(m_spilled.end(), pos, last);
+    m_inlineSize = 0;
 }
 
 void RoomCollection::removeRoom(Room *const room)
@@ -39,19 +73,41 @@ void RoomCollection::removeRoom(Room *const room)
     }
 
     DEBUG_LOCK();
-    m_rooms.erase(room->shared_from_this());
+    const RoomId id = room->getId();
+
+    if (isSpilled()) {
+        const auto it = std::lower_bound(m_spilled.begin(), m_spilled.end(), id);
+        if (it == m_spilled.end() || *it != id) {
+            return;
+        }
+        m_spilled.erase(it);
+        if (m_spilled.size() <= INLINE_CAPACITY) {
+            // Move back inline; this also makes isSpilled() false for an empty set.
+            m_inlineSize = static_cast<uint32_t>(m_spilled.size());
+            std::copy(m_spilled.begin(), m_spilled.end(), m_inline.begin());
+            std::vector<RoomId>{}.swap(m_spilled);
+        }
+        return;
+    }
+
+    RoomId *const first = m_inline.data();
+    RoomId *const last = first + m_inlineSize;
+    RoomId *const pos = std::lower_bound(first, last, id);
+    if (pos == last || *pos != id) {
+        return;
+    }
+    std::move(pos + 1, last, pos);
+    --m_inlineSize;
 }
 
 void RoomCollection::clear()
 {
     DEBUG_LOCK();
-    return m_rooms.clear();
+    m_inlineSize = 0;
+    std::vector<RoomId>{}.swap(m_spilled);
 }
 
-void RoomCollection::forEach(AbstractRoomVisitor &stream) const
+void RoomCollection::forEach(const RoomIndex &roomIndex, AbstractRoomVisitor &stream) const
 {
-    DEBUG_LOCK();
-    for (const std::shared_ptr<Room> &room : m_rooms) {
-        stream.visit(room.get());
-    }
+    forEachRoom(roomIndex, [&stream](const Room *const room) { stream.visit(room); });
 }
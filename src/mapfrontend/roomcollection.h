@@ -4,22 +4,40 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
+#include <array>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
-#include <set>
+#include <vector>
 
+#include "../global/RAII.h"
+#include "../global/roomid.h"
 #include "AbstractRoomVisitor.h"
 
 class AbstractRoomVisitor;
 class Room;
 
+/// Sorted set of RoomIds sharing the same parse key.
+///
+/// Almost every collection holds between one and a handful of rooms, so the
+/// first few ids are stored inline; larger collections spill to a vector.
+/// Rooms are resolved through the RoomIndex at visit time, so iteration order
+/// is by RoomId rather than by pointer value.
 class RoomCollection final
 {
 private:
-    using RoomSet = std::set<std::shared_ptr<Room>>;
-    RoomSet m_rooms;
+    static constexpr const uint32_t INLINE_CAPACITY = 4;
+    std::array<RoomId, INLINE_CAPACITY> m_inline{};
+    std::vector<RoomId> m_spilled;
+    uint32_t m_inlineSize = 0;
     mutable bool m_inUse = false;
 
+private:
+    bool isSpilled() const { return !m_spilled.empty(); }
+    const RoomId *begin() const { return isSpilled() ? m_spilled.data() : m_inline.data(); }
+    const RoomId *end() const { return begin() + size(); }
+
 public:
     void addRoom(Room *room);
     void removeRoom(Room *room);
@@ -29,10 +47,32 @@ class RoomCollection final
 
 public:
     void clear();
-    size_t size() const { return m_rooms.size(); }
+    size_t size() const { return isSpilled() ? m_spilled.size() : m_inlineSize; }
+    size_t getMemoryBytes() const { return sizeof(*this) + m_spilled.capacity() * sizeof(RoomId); }
+    bool contains(RoomId id) const;
 
 public:
     /* NOTE: It's not safe for the stream to modify this
      * collection during this function call. */
-    void forEach(AbstractRoomVisitor &stream) const;
+    void forEach(const RoomIndex &roomIndex, AbstractRoomVisitor &stream) const;
+
+    /// Calls f(const Room *) for each room; same order and caveat as forEach().
+    template<typename F>
+    void forEachRoom(const RoomIndex &roomIndex, F &&f) const
+    {
+#ifndef NDEBUG
+        assert(!m_inUse);
+        const RAIIBool useLock{m_inUse};
+#endif
+        const size_t numIds = roomIndex.size();
+        for (const RoomId id : *this) {
+            if (id.asUint32() >= numIds) {
+                assert(false);
+                continue;
+            }
+            if (const Room *const room = roomIndex[id].get()) {
+                f(room);
+            }
+        }
+    }
 };
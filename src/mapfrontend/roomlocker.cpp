@@ -5,6 +5,8 @@
 
 #include "roomlocker.h"
 
+#include <utility>
+
 #include "../expandoracommon/RoomRecipient.h"
 #include "../expandoracommon/room.h"
 #include "mapfrontend.h"
@@ -21,11 +23,12 @@ RoomLocker::~RoomLocker() = default;
 
 void RoomLocker::visit(const Room *room)
 {
-    if (comparator == nullptr) {
-        data.lockRoom(&recipient, room->getId());
-        recipient.receiveRoom(&data, room);
-    } else if (Room::compareWeakProps(room, *comparator) != ComparisonResultEnum::DIFFERENT) {
-        data.lockRoom(&recipient, room->getId());
-        recipient.receiveRoom(&data, room);
-    }
+    if (comparator == nullptr
+        || Room::compareWeakProps(room, *comparator) != ComparisonResultEnum::DIFFERENT)
+        rooms.emplace_back(room);
+}
+
+void RoomLocker::deliver()
+{
+    data.deliverRooms(recipient, std::exchange(rooms, {}));
 }
@@ -4,6 +4,8 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
+#include <vector>
+
 #include "AbstractRoomVisitor.h"
 
 class Room;
@@ -11,6 +13,8 @@ class MapFrontend;
 class ParseEvent;
 class RoomRecipient;
 
+// Collects the rooms that match the event; deliver() then locks them and hands
+// them to the recipient in one batch.
 class RoomLocker final : public AbstractRoomVisitor
 {
 public:
@@ -19,9 +23,11 @@ class RoomLocker final : public AbstractRoomVisitor
                         const ParseEvent *compare = nullptr);
     virtual void visit(const Room *room) override;
     virtual ~RoomLocker() override;
+    void deliver();
 
 private:
     RoomRecipient &recipient;
     MapFrontend &data;
     const ParseEvent *const comparator;
+    std::vector<const Room *> rooms;
 };
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "InflateDevice.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+#include <QString>
+
+#ifndef MMAPPER_NO_ZLIB
+#include <zlib.h>
+#endif
+
+#ifndef MMAPPER_NO_ZLIB
+
+struct InflateDevice::Impl final
+{
+    static constexpr const int CHUNK = 64 * 1024;
+
+    QIODevice &source;
+    const HeaderEnum header;
+    std::vector<char> in = std::vector<char>(CHUNK);
+    z_stream strm{};
+    bool initialized = false;
+    bool finished = false;
+
+    explicit Impl(QIODevice &source, const HeaderEnum header)
+        : source{source}
+        , header{header}
+    {}
+    ~Impl() { end(); }
+    DELETE_CTORS_AND_ASSIGN_OPS(Impl);
+
+    void end()
+    {
+        if (initialized)
+            (void) inflateEnd(&strm);
+        initialized = false;
+    }
+};
+
+InflateDevice::InflateDevice(QIODevice &source, const HeaderEnum header, QObject *const parent)
+    : QIODevice(parent)
+    , m_impl{std::make_unique<Impl>(source, header)}
+{}
+
+InflateDevice::~InflateDevice() = default;
+
+bool InflateDevice::open(const OpenMode mode)
+{
+    Impl &impl = *m_impl;
+    if ((mode & ReadWrite) != ReadOnly) {
+        setErrorString("InflateDevice is read-only");
+        return false;
+    }
+
+    if (impl.header == HeaderEnum::QCOMPRESS) {
+        // The expected size is only a hint for qUncompress(); the zlib stream
+        // knows where it ends.
+        char size[4];
+        if (impl.source.read(size, sizeof(size)) != static_cast<qint64>(sizeof(size))) {
+            setErrorString("missing qCompress header");
+            return false;
+        }
+    }
+
+    impl.end();
+    impl.strm = z_stream{};
+    impl.finished = false;
+    if (inflateInit(&impl.strm) != Z_OK) {
+        setErrorString("Unable to initialize zlib");
+        return false;
+    }
+    impl.initialized = true;
+    return QIODevice::open(mode);
+}
+
+void InflateDevice::close()
+{
+    m_impl->end();
+    QIODevice::close();
+}
+
+qint64 InflateDevice::readData(char *const data, const qint64 maxSize)
+{
+    Impl &impl = *m_impl;
+    z_stream &strm = impl.strm;
+    if (impl.finished)
+        return -1;
+    if (!impl.initialized)
+        return -1;
+
+    strm.next_out = reinterpret_cast<Bytef *>(data);
+    strm.avail_out = static_cast<uInt>(
+        std::min<qint64>(maxSize, std::numeric_limits<uInt>::max()));
+    const uInt wanted = strm.avail_out;
+
+    while (strm.avail_out != 0) {
+        if (strm.avail_in == 0) {
+            const qint64 got = impl.source.read(impl.in.data(), Impl::CHUNK);
+            if (got <= 0) {
+                setErrorString("compressed stream is truncated");
+                impl.end();
+                return -1;
+            }
+            strm.next_in = reinterpret_cast<Bytef *>(impl.in.data());
+            strm.avail_in = static_cast<uInt>(got);
+        }
+
+        const int ret = inflate(&strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            impl.finished = true;
+            impl.end();
+            break;
+        }
+        if (ret != Z_OK) {
+            setErrorString(QString("zlib error: (%1) %2")
+                               .arg(ret)
+                               .arg(strm.msg != nullptr ? strm.msg : ""));
+            impl.end();
+            return -1;
+        }
+    }
+
+    const auto produced = static_cast<qint64>(wanted - strm.avail_out);
+    return (produced == 0 && impl.finished) ? -1 : produced;
+}
+
+#else
+
+struct InflateDevice::Impl final
+{};
+
+InflateDevice::InflateDevice(QIODevice & /*source*/, HeaderEnum /*header*/, QObject *const parent)
+    : QIODevice(parent)
+{}
+
+InflateDevice::~InflateDevice() = default;
+
+bool InflateDevice::open(OpenMode /*mode*/)
+{
+    abort();
+}
+
+void InflateDevice::close()
+{
+    QIODevice::close();
+}
+
+qint64 InflateDevice::readData(char * /*data*/, qint64 /*maxSize*/)
+{
+    abort();
+}
+
+#endif
+
+qint64 InflateDevice::writeData(const char * /*data*/, qint64 /*maxSize*/)
+{
+    return -1;
+}
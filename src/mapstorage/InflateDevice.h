@@ -0,0 +1,49 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <memory>
+#include <QIODevice>
+#include <QtGlobal>
+
+#include "../global/RuleOf5.h"
+
+/*! \brief Read-only device that inflates a zlib stream from another device.
+ *
+ * Only a small input buffer is held, so a compressed map can be parsed as it
+ * is read instead of having both the compressed and uncompressed copies in
+ * memory. Errors (including a truncated stream) make readData() fail, which
+ * QDataStream reports as ReadPastEnd.
+ *
+ * NOTE: Requires zlib; don't open one if NO_ZLIB.
+ */
+class InflateDevice final : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    enum class HeaderEnum {
+        /// Plain zlib stream.
+        NONE,
+        /// qCompress() output: a 32-bit big-endian length, then the zlib stream.
+        QCOMPRESS
+    };
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+
+public:
+    explicit InflateDevice(QIODevice &source, HeaderEnum header, QObject *parent = nullptr);
+    ~InflateDevice() override;
+    DELETE_CTORS_AND_ASSIGN_OPS(InflateDevice);
+
+public:
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+};
@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "JsonWriter.h"
+
+#include <cassert>
+
+void JsonWriter::separate()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+    if (m_hasElements.empty())
+        return;
+    if (m_hasElements.back())
+        m_out.append(',');
+    m_hasElements.back() = true;
+}
+
+void JsonWriter::open(const char bracket)
+{
+    separate();
+    m_out.append(bracket);
+    m_hasElements.push_back(false);
+}
+
+void JsonWriter::close(const char bracket)
+{
+    assert(!m_hasElements.empty() && !m_afterKey);
+    m_hasElements.pop_back();
+    m_out.append(bracket);
+}
+
+void JsonWriter::key(const char *const name)
+{
+    assert(!m_afterKey);
+    separate();
+    appendString(QByteArray::fromRawData(name, static_cast<int>(qstrlen(name))));
+    m_out.append(':');
+    m_afterKey = true;
+}
+
+void JsonWriter::value(const QString &s)
+{
+    separate();
+    appendString(s.toUtf8());
+}
+
+void JsonWriter::value(const char *const s)
+{
+    separate();
+    appendString(QByteArray::fromRawData(s, static_cast<int>(qstrlen(s))));
+}
+
+void JsonWriter::value(const int64_t n)
+{
+    separate();
+    m_out.append(QByteArray::number(static_cast<qlonglong>(n)));
+}
+
+void JsonWriter::quotedValue(const int64_t n)
+{
+    separate();
+    // Digits and the sign never need escaping.
+    m_out.append('"');
+    m_out.append(QByteArray::number(static_cast<qlonglong>(n)));
+    m_out.append('"');
+}
+
+void JsonWriter::appendString(const QByteArray &utf8)
+{
+    static constexpr const char hex[] = "0123456789abcdef";
+    m_out.append('"');
+    for (const char c : utf8) {
+        switch (c) {
+        case '"':
+            m_out.append("\\\"");
+            break;
+        case '\\':
+            m_out.append("\\\\");
+            break;
+        case '\n':
+            m_out.append("\\n");
+            break;
+        case '\r':
+            m_out.append("\\r");
+            break;
+        case '\t':
+            m_out.append("\\t");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20u) {
+                const auto u = static_cast<unsigned char>(c);
+                m_out.append("\\u00");
+                m_out.append(hex[u >> 4u]);
+                m_out.append(hex[u & 0xFu]);
+            } else {
+                m_out.append(c); // including UTF-8 continuation bytes
+            }
+            break;
+        }
+    }
+    m_out.append('"');
+}
@@ -0,0 +1,56 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <vector>
+#include <QByteArray>
+#include <QString>
+
+#include "../global/macros.h"
+
+/*! \brief Appends compact JSON text to a buffer as it's produced.
+ *
+ * Unlike QJsonDocument there's no tree to build first, so each value costs
+ * only the bytes it takes up in the output. Members are written in the order
+ * they're given, and commas are inserted automatically. Keys must be followed
+ * by exactly one value.
+ */
+class NODISCARD JsonWriter final
+{
+private:
+    QByteArray m_out;
+    // One entry per open object or array: whether it already has an element.
+    std::vector<bool> m_hasElements;
+    bool m_afterKey = false;
+
+public:
+    void beginObject() { open('{'); }
+    void endObject() { close('}'); }
+    void beginArray() { open('['); }
+    void endArray() { close(']'); }
+
+    void key(const char *name);
+    void value(const QString &s);
+    void value(const char *s);
+    void value(int64_t n);
+    // The number as a string, e.g. "42", without going through a QString.
+    void quotedValue(int64_t n);
+
+    template<typename T>
+    void member(const char *name, const T &v)
+    {
+        key(name);
+        value(v);
+    }
+
+public:
+    NODISCARD const QByteArray &getData() const { return m_out; }
+    void reserve(int bytes) { m_out.reserve(bytes); }
+
+private:
+    void open(char bracket);
+    void close(char bracket);
+    void separate();
+    void appendString(const QByteArray &utf8);
+};
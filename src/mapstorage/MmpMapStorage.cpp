@@ -4,15 +4,24 @@
 
 #include "MmpMapStorage.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
+#include <string>
+#include <vector>
+#include <QByteArray>
+#include <QIODevice>
 #include <QString>
-#include <QXmlStreamWriter>
 
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
+#include "../global/EnumIndexedArray.h"
+#include "../global/ParallelFor.h"
 #include "../global/roomid.h"
 #include "../global/utils.h"
 #include "../mapdata/DoorFlags.h"
@@ -50,12 +59,14 @@ bool MmpMapStorage::mergeData()
     return false;
 }
 
-static QString getTerrainTypeName(const RoomTerrainEnum x)
+namespace {
+
+const char *getTerrainTypeName(const RoomTerrainEnum x)
 {
 #define CASE2(UPPER, PrettyName) \
     do { \
     case RoomTerrainEnum::UPPER: \
-        return QString{PrettyName}; \
+        return PrettyName; \
     } while (false)
     switch (x) {
         CASE2(UNDEFINED, "Undefined");
@@ -75,16 +86,16 @@ static QString getTerrainTypeName(const RoomTerrainEnum x)
         CASE2(CAVERN, "Cavern");
         CASE2(DEATHTRAP, "Deathtrap");
     }
-    return QString::asprintf("(TerrainType)%d", static_cast<int>(x));
+    return "Unknown";
 #undef CASE2
 }
 
-static QString getTerrainTypeColor(const RoomTerrainEnum x)
+const char *getTerrainTypeColor(const RoomTerrainEnum x)
 {
 #define CASE2(UPPER, Color) \
     do { \
     case RoomTerrainEnum::UPPER: \
-        return QString{Color}; \
+        return Color; \
     } while (false)
     switch (x) {
         CASE2(UNDEFINED, "0");
@@ -108,11 +119,237 @@ static QString getTerrainTypeColor(const RoomTerrainEnum x)
 #undef CASE2
 }
 
-static QString toMmpRoomId(const RoomId &roomId)
+// Rooms are serialized in batches so progress is reported and memory stays
+// bounded; each batch is split into chunks that are serialized in parallel.
+static constexpr const size_t ROOMS_PER_BATCH = 8192;
+static constexpr const size_t ROOMS_PER_CHUNK = 512;
+static constexpr const int FLUSH_SIZE = 1 << 20;
+
+/*! \brief Appends XML text to a buffer, formatted like QXmlStreamWriter.
+ *
+ * The output matches QXmlStreamWriter with auto-formatting (four spaces per
+ * level, empty elements self-closed, attribute values escaped the same way).
+ * Unlike QXmlStreamWriter, nothing is converted to QString, and a writer can
+ * start at any depth, so pieces written independently can be concatenated.
+ */
+class NODISCARD MmpWriter final
+{
+private:
+    QByteArray m_out;
+    // One entry per open element: whether it already has a child element.
+    std::vector<bool> m_hasChildren;
+    int m_baseDepth = 0;
+    bool m_inStartTag = false;
+
+public:
+    explicit MmpWriter(const int baseDepth = 0)
+        : m_baseDepth{baseDepth}
+    {}
+
+public:
+    void startElement(const char *const name)
+    {
+        if (m_inStartTag)
+            m_out.append('>');
+        if (!m_hasChildren.empty())
+            m_hasChildren.back() = true;
+        m_out.append('\n');
+        indent(depth());
+        m_out.append('<');
+        m_out.append(name);
+        m_hasChildren.push_back(false);
+        m_inStartTag = true;
+    }
+
+    void endElement(const char *const name)
+    {
+        assert(!m_hasChildren.empty());
+        const bool hadChildren = m_hasChildren.back();
+        m_hasChildren.pop_back();
+        if (m_inStartTag) {
+            m_out.append("/>");
+            m_inStartTag = false;
+            return;
+        }
+        if (hadChildren) {
+            m_out.append('\n');
+            indent(depth());
+        }
+        m_out.append("</");
+        m_out.append(name);
+        m_out.append('>');
+    }
+
+    // The value must already be valid UTF-8 that needs no escaping.
+    void attribute(const char *const name, const QByteArray &plain)
+    {
+        beginAttribute(name);
+        m_out.append(plain);
+        m_out.append('"');
+    }
+    void attribute(const char *const name, const char *const plain)
+    {
+        beginAttribute(name);
+        m_out.append(plain);
+        m_out.append('"');
+    }
+    void attribute(const char *const name, const int64_t n)
+    {
+        beginAttribute(name);
+        m_out.append(QByteArray::number(static_cast<qlonglong>(n)));
+        m_out.append('"');
+    }
+    // Converts the Latin-1 text to UTF-8 and escapes it.
+    void latin1Attribute(const char *const name, const std::string &latin1)
+    {
+        beginAttribute(name);
+        for (const char c : latin1) {
+            const auto uc = static_cast<unsigned char>(c);
+            switch (c) {
+            case '<':
+                m_out.append("&lt;");
+                break;
+            case '>':
+                m_out.append("&gt;");
+                break;
+            case '&':
+                m_out.append("&amp;");
+                break;
+            case '"':
+                m_out.append("&quot;");
+                break;
+            case '\t':
+                m_out.append("&#9;");
+                break;
+            case '\n':
+                m_out.append("&#10;");
+                break;
+            case '\r':
+                m_out.append("&#13;");
+                break;
+            default:
+                if (uc < 0x80u) {
+                    m_out.append(c);
+                } else {
+                    m_out.append(static_cast<char>(0xC0u | (uc >> 6u)));
+                    m_out.append(static_cast<char>(0x80u | (uc & 0x3Fu)));
+                }
+                break;
+            }
+        }
+        m_out.append('"');
+    }
+
+    // Appends output of another writer that started at the current depth.
+    void appendRaw(const QByteArray &xml)
+    {
+        assert(!m_inStartTag);
+        m_out.append(xml);
+    }
+
+public:
+    NODISCARD const QByteArray &getData() const { return m_out; }
+
+private:
+    NODISCARD int depth() const
+    {
+        return m_baseDepth + static_cast<int>(m_hasChildren.size());
+    }
+    void indent(const int levels) { m_out.append(QByteArray(4 * levels, ' ')); }
+    void beginAttribute(const char *const name)
+    {
+        assert(m_inStartTag);
+        m_out.append(' ');
+        m_out.append(name);
+        m_out.append("=\"");
+    }
+};
+
+// Formatted once instead of for every room.
+struct NODISCARD MmpStrings final
+{
+    EnumIndexedArray<QByteArray, RoomTerrainEnum, NUM_ROOM_TERRAIN_TYPES> environments;
+
+    MmpStrings()
+    {
+        for (const auto terrainType : ALL_TERRAIN_TYPES)
+            environments[terrainType] = QByteArray::number(static_cast<int>(terrainType));
+    }
+};
+
+void saveRoom(const Room &room, const MmpStrings &strings, MmpWriter &writer)
 {
-    return QString("%1").arg(roomId.asUint32() + 1);
+    // MMP room ids start at 1.
+    const auto toMmpRoomId = [](const RoomId id) -> int64_t { return id.asUint32() + 1; };
+
+    writer.startElement("room");
+    writer.attribute("id", toMmpRoomId(room.getId()));
+    writer.attribute("area", "1");
+    writer.latin1Attribute("title", room.getName().getStdString());
+    writer.attribute("environment", strings.environments[room.getTerrainType()]);
+    if (room.getLoadFlags().contains(RoomLoadFlagEnum::ATTENTION))
+        writer.attribute("important", "1");
+
+    writer.startElement("coord");
+    const Coordinate &pos = room.getPosition();
+    writer.attribute("x", pos.x);
+    writer.attribute("y", pos.y);
+    writer.attribute("z", pos.z);
+    writer.endElement("coord");
+
+    for (auto dir : ALL_EXITS_NESWUD) {
+        const Exit &e = room.exit(dir);
+        if (e.isExit() && !e.outIsEmpty()) {
+            writer.startElement("exit");
+            writer.attribute("direction", lowercaseDirection(dir));
+            // REVISIT: Can MMP handle multiple exits in the same direction?
+            writer.attribute("target", toMmpRoomId(e.outFirst()));
+            if (e.isHiddenExit())
+                writer.attribute("hidden", "1");
+            if (e.isDoor()) {
+                writer.attribute("door", "2");
+            }
+            writer.endElement("exit");
+        }
+    }
+
+    writer.endElement("room");
 }
 
+// Collects output and writes it to the device a megabyte at a time.
+class NODISCARD BufferedOutput final
+{
+private:
+    QIODevice &m_device;
+    QByteArray m_buffer;
+
+public:
+    explicit BufferedOutput(QIODevice &device)
+        : m_device{device}
+    {
+        m_buffer.reserve(2 * FLUSH_SIZE);
+    }
+
+public:
+    void append(const QByteArray &bytes)
+    {
+        m_buffer.append(bytes);
+        if (m_buffer.size() >= FLUSH_SIZE)
+            flush();
+    }
+
+    void flush()
+    {
+        if (m_buffer.isEmpty())
+            return;
+        if (m_device.write(m_buffer) != m_buffer.size())
+            throw std::runtime_error(::toStdStringUtf8(m_device.errorString()));
+        m_buffer.resize(0);
+    }
+};
+
+} // namespace
+
 bool MmpMapStorage::saveData(bool baseMapOnly)
 {
     emit log("MmpMapStorage", "Writing data to file ...");
@@ -123,9 +360,7 @@ bool MmpMapStorage::saveData(bool baseMapOnly)
     // The RoomSaver acts as a lock on the rooms.
     ConstRoomList roomList;
     RoomSaver saver(m_mapData, roomList);
-    for (uint i = 0; i < m_mapData.getRoomsCount(); ++i) {
-        m_mapData.lookingForRooms(saver, RoomId{i});
-    }
+    m_mapData.lookingForAllRooms(saver);
 
     uint roomsCount = saver.getRoomsCount();
 
@@ -140,46 +375,109 @@ bool MmpMapStorage::saveData(bool baseMapOnly)
         filter.prepare(progressCounter);
     }
 
-    QXmlStreamWriter stream(m_file);
-    stream.setAutoFormatting(true);
-    stream.writeStartDocument();
+    try {
+        BufferedOutput out(deref(m_file));
+        const MmpStrings strings;
+
+        // save areas
+        MmpWriter head{1};
+        head.startElement("areas");
+        head.startElement("area");
+        head.attribute("id", "1");
+        head.attribute("name", "Arda");
+        head.endElement("area");
+        head.endElement("areas");
+        out.append(QByteArray(R"(<?xml version="1.0" encoding="UTF-8"?>)" "\n<map>"));
+        out.append(head.getData());
+        progressCounter.step();
+
+        // save rooms
+        out.append(QByteArray("\n    <rooms>"));
 
-    // save map
-    stream.writeStartElement("map");
+        // Rooms altered by the filter are copies that only live during the
+        // visit, and copying isn't thread-safe, so those are serialized while
+        // visiting; the others are serialized in parallel afterwards.
+        struct NODISCARD Entry final
+        {
+            const Room *room = nullptr;
+            QByteArray altered;
+        };
+        std::vector<Entry> batch;
+        batch.reserve(ROOMS_PER_BATCH);
+        std::vector<QByteArray> chunks;
+        for (size_t batchBegin = 0; batchBegin < roomList.size(); batchBegin += ROOMS_PER_BATCH) {
+            const size_t batchEnd = std::min(roomList.size(), batchBegin + ROOMS_PER_BATCH);
+            batch.clear();
+            for (size_t i = batchBegin; i < batchEnd; ++i) {
+                const Room &room = deref(roomList[i]);
+                filter.visitRoom(room, baseMapOnly, [&room, &strings, &batch](const Room &r) {
+                    Entry entry;
+                    if (&r == &room) {
+                        entry.room = &room;
+                    } else {
+                        MmpWriter altered{2};
+                        saveRoom(r, strings, altered);
+                        entry.altered = altered.getData();
+                    }
+                    batch.emplace_back(std::move(entry));
+                });
+            }
 
-    // save areas
-    stream.writeStartElement("areas");
-    stream.writeStartElement("area");
-    stream.writeAttribute("id", "1");
-    stream.writeAttribute("name", "Arda");
-    stream.writeEndElement(); // end area
-    stream.writeEndElement(); // end areas
-    progressCounter.step();
+            const size_t numChunks = (batch.size() + ROOMS_PER_CHUNK - 1) / ROOMS_PER_CHUNK;
+            chunks.assign(numChunks, QByteArray{});
+            std::mutex mutex;
+            std::exception_ptr error;
+            parallelFor(numChunks, 1, [&](const size_t begin, const size_t end) {
+                try {
+                    for (size_t c = begin; c < end; ++c) {
+                        MmpWriter writer{2};
+                        const size_t last = std::min(batch.size(), (c + 1) * ROOMS_PER_CHUNK);
+                        for (size_t i = c * ROOMS_PER_CHUNK; i < last; ++i) {
+                            if (batch[i].room != nullptr)
+                                saveRoom(*batch[i].room, strings, writer);
+                            else
+                                writer.appendRaw(batch[i].altered);
+                        }
+                        chunks[c] = writer.getData();
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    if (!error)
+                        error = std::current_exception();
+                }
+            });
+            if (error)
+                std::rethrow_exception(error);
 
-    // save rooms
-    stream.writeStartElement("rooms");
-    auto saveOne = [this, &stream](const Room &room) { saveRoom(room, stream); };
+            for (const QByteArray &chunk : chunks)
+                out.append(chunk);
+            progressCounter.step(static_cast<quint32>(batchEnd - batchBegin));
+        }
+        out.append(QByteArray("\n    </rooms>"));
 
-    for (const auto &pRoom : roomList) {
-        filter.visitRoom(deref(pRoom), baseMapOnly, saveOne);
+        // save environments
+        MmpWriter tail{1};
+        tail.startElement("environments");
+        for (auto terrainType : ALL_TERRAIN_TYPES) {
+            tail.startElement("environment");
+            tail.attribute("id", strings.environments[terrainType]);
+            tail.attribute("name", getTerrainTypeName(terrainType));
+            tail.attribute("color", getTerrainTypeColor(terrainType));
+            tail.endElement("environment");
+        }
+        tail.endElement("environments");
+        out.append(tail.getData());
         progressCounter.step();
-    }
-    stream.writeEndElement(); // end rooms
 
-    // save environments
-    stream.writeStartElement("environments");
-    for (auto terrainType : ALL_TERRAIN_TYPES) {
-        stream.writeStartElement("environment");
-        stream.writeAttribute("id", QString("%1").arg(static_cast<int>(terrainType)));
-        stream.writeAttribute("name", getTerrainTypeName(terrainType));
-        stream.writeAttribute("color", getTerrainTypeColor(terrainType));
-        stream.writeEndElement(); // end environment
+        out.append(QByteArray("\n</map>\n"));
+        out.flush();
+        progressCounter.step();
+    } catch (const std::exception &ex) {
+        const auto msg = QString::asprintf("Exception: %s", ex.what());
+        emit log("MmpMapStorage", msg);
+        qWarning().noquote() << msg;
+        return false;
     }
-    stream.writeEndElement(); // end environments
-    progressCounter.step();
-
-    stream.writeEndElement(); // end map
-    progressCounter.step();
 
     emit log("MmpMapStorage", "Writing data finished.");
 
@@ -188,39 +486,3 @@ bool MmpMapStorage::saveData(bool baseMapOnly)
 
     return true;
 }
-
-void MmpMapStorage::saveRoom(const Room &room, QXmlStreamWriter &stream)
-{
-    stream.writeStartElement("room");
-    stream.writeAttribute("id", toMmpRoomId(room.getId()));
-    stream.writeAttribute("area", "1");
-    stream.writeAttribute("title", room.getName().toQString());
-    stream.writeAttribute("environment", QString("%1").arg(static_cast<int>(room.getTerrainType())));
-    if (room.getLoadFlags().contains(RoomLoadFlagEnum::ATTENTION))
-        stream.writeAttribute("important", "1");
-
-    stream.writeStartElement("coord");
-    const Coordinate &pos = room.getPosition();
-    stream.writeAttribute("x", QString("%1").arg(pos.x));
-    stream.writeAttribute("y", QString("%1").arg(pos.y));
-    stream.writeAttribute("z", QString("%1").arg(pos.z));
-    stream.writeEndElement(); // end coord
-
-    for (auto dir : ALL_EXITS_NESWUD) {
-        const Exit &e = room.exit(dir);
-        if (e.isExit() && !e.outIsEmpty()) {
-            stream.writeStartElement("exit");
-            stream.writeAttribute("direction", lowercaseDirection(dir));
-            // REVISIT: Can MMP handle multiple exits in the same direction?
-            stream.writeAttribute("target", toMmpRoomId(e.outFirst()));
-            if (e.isHiddenExit())
-                stream.writeAttribute("hidden", "1");
-            if (e.isDoor()) {
-                stream.writeAttribute("door", "2");
-            }
-            stream.writeEndElement(); // end exit
-        }
-    }
-
-    stream.writeEndElement(); // end room
-}
@@ -10,7 +10,6 @@
 
 class MapData;
 class QObject;
-class QXmlStreamWriter;
 
 /*! \brief MMP export for other clients
  *
@@ -36,7 +35,4 @@ class MmpMapStorage final : public AbstractMapStorage
     virtual bool loadData() override;
     virtual bool saveData(bool baseMapOnly) override;
     virtual bool mergeData() override;
-
-private:
-    void saveRoom(const Room &room, QXmlStreamWriter &stream);
 };
@@ -5,6 +5,8 @@
 #include "PandoraMapStorage.h"
 
 #include <cassert>
+#include <tuple>
+#include <vector>
 #include <QRegularExpression>
 #include <QXmlStreamReader>
 
@@ -78,28 +80,33 @@ SharedRoom PandoraMapStorage::loadRoom(QXmlStreamReader &xml)
     SharedRoom room = Room::createPermanentRoom(m_mapData);
     room->setDynamicDescription(RoomDynamicDesc{});
     room->setUpToDate();
-    while (!(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == "room")) {
+    // Comparing names against QLatin1String doesn't allocate, unlike const char *.
+    while (!(xml.tokenType() == QXmlStreamReader::EndElement
+             && xml.name() == QLatin1String("room"))) {
         if (xml.tokenType() == QXmlStreamReader::StartElement) {
-            if (xml.name() == "room") {
-                room->setId(RoomId{static_cast<uint32_t>(xml.attributes().value("id").toInt())});
+            const auto name = xml.name();
+            if (name == QLatin1String("room")) {
+                const QXmlStreamAttributes attr = xml.attributes();
+                room->setId(RoomId{static_cast<uint32_t>(attr.value("id").toInt())});
 
                 // Terrain
-                const auto terrainString = xml.attributes().value("terrain").toString().toLower();
+                const auto terrainString = attr.value("terrain").toString().toLower();
                 room->setTerrainType(toTerrainType(terrainString));
 
                 // Coordinate
-                const auto x = xml.attributes().value("x").toInt();
-                const auto y = xml.attributes().value("y").toInt();
-                const auto z = xml.attributes().value("z").toInt();
+                const auto x = attr.value("x").toInt();
+                const auto y = attr.value("y").toInt();
+                const auto z = attr.value("z").toInt();
                 room->setPosition(Coordinate{x, y, z} + basePosition);
 
-            } else if (xml.name() == "roomname") {
+            } else if (name == QLatin1String("roomname")) {
                 room->setName(RoomName{xml.readElementText()});
-            } else if (xml.name() == "desc") {
-                room->setStaticDescription(RoomStaticDesc{xml.readElementText().replace("|", "\n")});
-            } else if (xml.name() == "note") {
+            } else if (name == QLatin1String("desc")) {
+                room->setStaticDescription(
+                    RoomStaticDesc{xml.readElementText().replace(QChar('|'), QChar('\n'))});
+            } else if (name == QLatin1String("note")) {
                 room->setNote(RoomNote{xml.readElementText()});
-            } else if (xml.name() == "exits") {
+            } else if (name == QLatin1String("exits")) {
                 loadExits(*room, xml);
             }
         }
@@ -111,25 +118,26 @@ SharedRoom PandoraMapStorage::loadRoom(QXmlStreamReader &xml)
 void PandoraMapStorage::loadExits(Room &room, QXmlStreamReader &xml)
 {
     ExitsList copiedExits = room.getExitsList();
-    while (!(xml.tokenType() == QXmlStreamReader::EndElement && xml.name() == "exits")) {
+    while (!(xml.tokenType() == QXmlStreamReader::EndElement
+             && xml.name() == QLatin1String("exits"))) {
         if (xml.tokenType() == QXmlStreamReader::StartElement) {
-            if (xml.name() == "exit") {
+            if (xml.name() == QLatin1String("exit")) {
                 const auto attr = xml.attributes();
                 if (attr.hasAttribute("dir") && attr.hasAttribute("to")
                     && attr.hasAttribute("door")) {
-                    const auto dirStr = xml.attributes().value("dir").toString();
+                    const auto dirStr = attr.value("dir");
                     const auto dir = Mmapper2Exit::dirForChar(dirStr.at(0).toLatin1());
                     Exit &exit = copiedExits[dir];
                     exit.updateExit(ExitFlags{ExitFlagEnum::EXIT});
 
-                    const auto to = xml.attributes().value("to").toString();
-                    if (to == "DEATH") {
+                    const auto to = attr.value("to");
+                    if (to == QLatin1String("DEATH")) {
                         // REVISIT: Create a room for the death trap?
-                    } else if (to != "UNDEFINED") {
+                    } else if (to != QLatin1String("UNDEFINED")) {
                         exit.addOut(RoomId{static_cast<uint32_t>(to.toInt())});
                     }
 
-                    const auto doorName = xml.attributes().value("door").toString();
+                    const auto doorName = attr.value("door").toString();
                     if (doorName != nullptr && !doorName.isEmpty()) {
                         exit.updateExit(ExitFlags{ExitFlagEnum::DOOR});
                         if (doorName != "exit") {
@@ -182,15 +190,25 @@ bool PandoraMapStorage::mergeData()
         progressCounter.increaseTotalStepsBy(roomsCount);
         emit log("PandoraMapStorage", QString("Number of rooms: %1").arg(roomsCount));
 
-        for (uint32_t i = 0; i < roomsCount; i++) {
-            while (xml.readNextStartElement() && !xml.hasError()) {
-                if (xml.name() == "room") {
-                    SharedRoom room = loadRoom(xml);
-                    progressCounter.step();
-                    m_mapData.insertPredefinedRoom(room);
-                }
+        // The rooms are read in one pass and inserted together, so the map's
+        // indexes are sized once instead of growing room by room.
+        std::vector<SharedRoom> rooms;
+        rooms.reserve(roomsCount);
+        while (xml.readNextStartElement()) {
+            if (xml.name() == QLatin1String("room")) {
+                rooms.emplace_back(loadRoom(xml));
+                progressCounter.step();
+            } else {
+                xml.skipCurrentElement();
             }
         }
+        if (xml.hasError()) {
+            qWarning() << "Stopped reading" << m_file->fileName() << "at line" << xml.lineNumber()
+                       << ":" << xml.errorString();
+        }
+
+        emit log("PandoraMapStorage", "Indexing rooms ...");
+        m_mapData.insertPredefinedRooms(rooms);
 
         // Set base position
         m_mapData.setPosition(Coordinate{});
@@ -203,6 +221,8 @@ bool PandoraMapStorage::mergeData()
         }
 
         m_mapData.setFileName(m_fileName, true);
+        // Pandora maps don't have an identity, so they take that of their rooms.
+        std::ignore = m_mapData.getMapIdentity();
         m_mapData.unsetDataChanged();
     }
 
@@ -1,10 +0,0 @@
-#pragma once
-// SPDX-License-Identifier: GPL-2.0-or-later
-// Copyright (C) 2019 The MMapper Authors
-// Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
-
-class QByteArray;
-
-namespace StorageUtils {
-QByteArray inflate(QByteArray &);
-} // namespace StorageUtils
@@ -4,20 +4,19 @@
 
 #include "basemapsavefilter.h"
 
+#include <algorithm>
 #include <cassert>
-#include <list>
-#include <set>
+#include <vector>
 #include <QtCore>
 
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
 #include "../global/roomid.h"
+#include "../mapdata/MapSnapshot.h"
 #include "../mapdata/mapdata.h"
 #include "../mapdata/roomfilter.h"
 #include "progresscounter.h"
 
-class RoomAdmin;
-
 namespace {
 
 struct RoomLink
@@ -39,6 +38,11 @@ bool operator<(const RoomLink &a, const RoomLink &b)
     }
     return a.to < b.to;
 }
+
+bool operator==(const RoomLink &a, const RoomLink &b)
+{
+    return a.from == b.from && a.to == b.to;
+}
 } // namespace
 
 struct BaseMapSaveFilter::Impl
@@ -46,25 +50,29 @@ struct BaseMapSaveFilter::Impl
     //! Owned by caller
     MapData *mapData = nullptr;
 
-    //! Rooms reachable without going through hidden doors
-    RoomIdSet baseRooms;
+    //! Indexed by RoomId: rooms reachable without going through hidden doors
+    std::vector<bool> baseRooms;
+    uint32_t numBaseRooms = 0;
 
-    /*! \brief Rooms scheduled for exploration during prepare
-     *
-     * Order matters (can't be replaced by a set) to prevent infinite looping.
-     */
-    std::list<RoomId> roomsTodo;
-
-    /*! \brief Secret links noticed during the exploration (prepare).
+    /*! \brief Secret links noticed during the exploration (prepare), sorted.
      *
      * This data is used to remove secret links between public rooms (example:
      * hedge on OER near Bree). As such it doesn't include secret links between
      * secret rooms, but this doesn't matter.
      */
-    std::set<RoomLink> secretLinks{};
+    std::vector<RoomLink> secretLinks;
 
     // It's considered secret if it's NOT FOUND in the set of rooms only reachable without going through hidden exits.
-    bool isSecret(RoomId id) const { return baseRooms.find(id) == baseRooms.end(); }
+    bool isSecret(RoomId id) const
+    {
+        const auto i = static_cast<size_t>(id.asUint32());
+        return i >= baseRooms.size() || !baseRooms[i];
+    }
+
+    bool isSecretLink(RoomId from, RoomId to) const
+    {
+        return std::binary_search(secretLinks.begin(), secretLinks.end(), RoomLink(from, to));
+    }
 };
 
 BaseMapSaveFilter::BaseMapSaveFilter()
@@ -81,45 +89,54 @@ bool BaseMapSaveFilter::isSecret(RoomId id) const
 void BaseMapSaveFilter::prepare(ProgressCounter &counter)
 {
     assert(m_impl->mapData);
-
-    std::set<RoomId> considered{};
+    Impl &impl = *m_impl;
+    MapData &mapData = deref(impl.mapData);
+
+    // The snapshot is indexed by RoomId, so the walk below takes no room locks
+    // and looks nothing up by more than an array index.
+    const SharedMapSnapshot snapshot = mapData.getSnapshot();
+    const MapSnapshot::RoomTable &rooms = deref(snapshot).getRooms();
+
+    impl.baseRooms.assign(rooms.size(), false);
+    impl.numBaseRooms = 0;
+    impl.secretLinks.clear();
+
+    // Breadth-first; every room is queued at most once, when it's first reached.
+    std::vector<RoomId> todo;
+    const auto reach = [&impl, &rooms, &todo](const RoomId id) {
+        const auto i = static_cast<size_t>(id.asUint32());
+        if (i >= rooms.size() || rooms[i] == nullptr || impl.baseRooms[i])
+            return;
+        impl.baseRooms[i] = true;
+        ++impl.numBaseRooms;
+        todo.emplace_back(id);
+    };
 
     // Seed room
-    m_impl->mapData->genericSearch(this,
-                                   RoomFilter("The Fountain Square",
-                                              Qt::CaseSensitive,
-                                              PatternKindsEnum::NAME));
+    const RoomFilter seed("The Fountain Square", Qt::CaseSensitive, PatternKindsEnum::NAME);
+    mapData.searchSnapshot(deref(snapshot), seed, reach);
 
     // Walk the whole map through non-hidden exits without recursing
-    while (!m_impl->roomsTodo.empty()) {
-        auto todo = m_impl->roomsTodo.front();
-        m_impl->roomsTodo.pop_front();
-
-        if (considered.find(todo)
-            == considered.end()) { // Don't process twice the same room (ending condition)
-            m_impl->mapData->lookingForRooms(*this, todo);
-            m_impl->mapData->releaseRoom(*this, todo);
-            considered.insert(todo);
-            counter.step();
+    for (size_t next = 0; next < todo.size(); ++next) {
+        const Room &room = deref(rooms[todo[next].asUint32()]);
+        for (const auto &exit : room.getExitsList()) {
+            for (auto to : exit.outRange()) {
+                if (exit.isHiddenExit()) {
+                    impl.secretLinks.emplace_back(room.getId(), to);
+                } else {
+                    reach(to);
+                }
+            }
         }
+        counter.step();
     }
 
-    for (auto steps = considered.size(); steps < prepareCount(); ++steps) {
-        counter.step(); // Make up for the secret rooms we skipped
-    }
-}
+    auto &secretLinks = impl.secretLinks;
+    std::sort(secretLinks.begin(), secretLinks.end());
+    secretLinks.erase(std::unique(secretLinks.begin(), secretLinks.end()), secretLinks.end());
 
-void BaseMapSaveFilter::receiveRoom(RoomAdmin * /*admin*/, const Room *room)
-{
-    for (const auto &exit : room->getExitsList()) {
-        for (auto to : exit.outRange()) {
-            if (exit.isHiddenExit()) {
-                m_impl->secretLinks.emplace(RoomLink(room->getId(), to));
-            } else {
-                m_impl->baseRooms.emplace(to);
-                m_impl->roomsTodo.emplace_back(to);
-            }
-        }
+    for (auto steps = todo.size(); steps < prepareCount(); ++steps) {
+        counter.step(); // Make up for the secret rooms we skipped
     }
 }
 
@@ -136,15 +153,14 @@ uint32_t BaseMapSaveFilter::prepareCount()
 
 uint32_t BaseMapSaveFilter::acceptedRoomsCount()
 {
-    return static_cast<uint32_t>(m_impl->baseRooms.size());
+    return m_impl->numBaseRooms;
 }
 
 BaseMapSaveFilter::ActionEnum BaseMapSaveFilter::filter(const Room &room)
 {
-    auto &baseRooms = m_impl->baseRooms;
-    assert(!baseRooms.empty());
+    assert(m_impl->numBaseRooms != 0);
 
-    if (baseRooms.find(room.getId()) != baseRooms.end()) {
+    if (!isSecret(room.getId())) {
         const ExitsList &exits = room.getExitsList();
         for (const auto &exit : exits) {
             if (exit.isHiddenExit()) {
@@ -170,9 +186,8 @@ BaseMapSaveFilter::ActionEnum BaseMapSaveFilter::filter(const Room &room)
 std::shared_ptr<Room> BaseMapSaveFilter::alteredRoom(RoomModificationTracker &tracker,
                                                      const Room &room)
 {
-    auto &baseRooms = m_impl->baseRooms;
-    auto &secretLinks = m_impl->secretLinks;
-    assert(!baseRooms.empty());
+    const Impl &impl = deref(m_impl);
+    assert(impl.numBaseRooms != 0);
 
     auto result = room.clone(tracker);
     Room &copy = deref(result);
@@ -185,10 +200,8 @@ std::shared_ptr<Room> BaseMapSaveFilter::alteredRoom(RoomModificationTracker &tr
         // Destroy links to secret rooms
         for (auto outLink : outLinks) {
             const bool destRoomIsSecret = isSecret(outLink);
-            const bool outLinkIsSecret = (secretLinks.find(RoomLink(copy.getId(), outLink))
-                                          != secretLinks.end());
-            const bool linkBackIsSecret = (secretLinks.find(RoomLink(outLink, copy.getId()))
-                                           != secretLinks.end());
+            const bool outLinkIsSecret = impl.isSecretLink(copy.getId(), outLink);
+            const bool linkBackIsSecret = impl.isSecretLink(outLink, copy.getId());
 
             if (destRoomIsSecret || (outLinkIsSecret && linkBackIsSecret)) {
                 exit.removeOut(outLink);
@@ -7,11 +7,9 @@
 #include <memory>
 #include <sys/types.h>
 
-#include "../expandoracommon/RoomRecipient.h"
 #include "../expandoracommon/room.h"
 #include "../global/RuleOf5.h"
 
-class RoomAdmin;
 class MapData;
 class Room;
 class ProgressCounter;
@@ -19,7 +17,7 @@ class ProgressCounter;
 /*! \brief Filters
  *
  */
-class BaseMapSaveFilter final : public RoomRecipient
+class BaseMapSaveFilter final
 {
 public:
     enum class ActionEnum { PASS, ALTER, REJECT };
@@ -28,15 +26,12 @@ class BaseMapSaveFilter final : public RoomRecipient
     struct Impl;
     std::unique_ptr<Impl> m_impl;
 
-private:
-    virtual void receiveRoom(RoomAdmin *, const Room *room) override;
-
 public:
     DELETE_CTORS_AND_ASSIGN_OPS(BaseMapSaveFilter);
 
 public:
     BaseMapSaveFilter();
-    virtual ~BaseMapSaveFilter() override;
+    ~BaseMapSaveFilter();
 
 public:
     //! The map data to work on
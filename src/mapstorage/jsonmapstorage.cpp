@@ -6,23 +6,34 @@
 
 #include "jsonmapstorage.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <exception>
+#include <map>
+#include <mutex>
 #include <stdexcept>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QString>
 
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
+#include "../global/ParallelFor.h"
 #include "../global/roomid.h"
 #include "../global/utils.h"
 #include "../mapdata/DoorFlags.h"
 #include "../mapdata/ExitDirection.h"
 #include "../mapdata/ExitFlags.h"
+#include "../mapdata/MapZones.h"
 #include "../mapdata/mapdata.h"
 #include "../mapdata/mmapper2room.h"
 #include "../parser/parserutils.h"
+#include "JsonWriter.h"
 #include "abstractmapstorage.h"
 #include "basemapsavefilter.h"
 #include "progresscounter.h"
@@ -33,8 +44,6 @@ namespace {
 // These settings have to be shared with the JS code:
 // Group all rooms with the same 2 first hash bytes into the same file
 static constexpr const int c_roomIndexFileNameSize = 2;
-// Split the world into 20x20 zones
-static constexpr const int ZONE_WIDTH = 20;
 
 /* Performs MD5 hashing on ASCII-transliterated, whitespace-normalized name+descs.
  * MD5 is for convenience (easily available in all languages), the rest makes
@@ -43,6 +52,8 @@ static constexpr const int ZONE_WIDTH = 20;
 class WebHasher final
 {
     QCryptographicHash m_hash;
+    const QRegularExpression m_spaces{" +"};
+    const QRegularExpression m_lineEnds{" *\r?\n"};
 
 public:
     WebHasher()
@@ -59,8 +70,8 @@ class WebHasher final
         // spaces after periods). MMapper ignores such changes when comparing rooms,
         // but the web mapper may only look up rooms by hash. Normalizing the
         // whitespaces makes the hash more resilient.
-        str.replace(QRegularExpression(" +"), " ");
-        str.replace(QRegularExpression(" *\r?\n"), "\n");
+        str.replace(m_spaces, " ");
+        str.replace(m_lineEnds, "\n");
 
         // REVISIT: should this be latin1 or utf8?
         m_hash.addData(str.toLatin1());
@@ -76,19 +87,32 @@ class WebHasher final
 class RoomHashIndex final
 {
 public:
-    using Index = QMultiMap<QByteArray, Coordinate>;
+    using Entry = std::pair<QByteArray, Coordinate>;
+    // Sorted by hash; rooms with the same hash keep the order they were added in.
+    using Index = std::vector<Entry>;
 
 private:
     Index m_index;
-    WebHasher m_hasher;
 
 public:
-    void addRoom(const Room &room)
+    void build(const ConstRoomList &rooms)
     {
-        m_hasher.add(room.getName().toQString() + "\n");
-        m_hasher.add(room.getStaticDescription().toQString());
-        m_index.insert(m_hasher.result().toHex(), room.getPosition());
-        m_hasher.reset();
+        // Hashing (and normalizing the text for it) dominates the cost of the
+        // index, so it's done in parallel; each chunk gets its own hasher.
+        m_index.resize(rooms.size());
+        parallelFor(rooms.size(), 256, [this, &rooms](const size_t begin, const size_t end) {
+            WebHasher hasher;
+            for (size_t i = begin; i < end; ++i) {
+                const Room &room = deref(rooms[i]);
+                hasher.add(room.getName().toQString() + "\n");
+                hasher.add(room.getStaticDescription().toQString());
+                m_index[i] = Entry{hasher.result().toHex(), room.getPosition()};
+                hasher.reset();
+            }
+        });
+        std::stable_sort(m_index.begin(), m_index.end(), [](const Entry &a, const Entry &b) {
+            return a.first < b.first;
+        });
     }
 
     const Index &index() const { return m_index; }
@@ -96,51 +120,40 @@ class RoomHashIndex final
 
 static std::string getZoneKey(const Coordinate &c)
 {
-    static constexpr const auto calcZoneCoord = [](const int n) -> int {
-        auto f = [](const int x) -> int { return (x / ZONE_WIDTH) * ZONE_WIDTH; };
-        return f((n < 0) ? (n + 1 - ZONE_WIDTH) : n);
-    };
-    static_assert(calcZoneCoord(-ZONE_WIDTH - 1) == -2 * ZONE_WIDTH);
-    static_assert(calcZoneCoord(-ZONE_WIDTH) == -ZONE_WIDTH);
-    static_assert(calcZoneCoord(-1) == -ZONE_WIDTH);
-    static_assert(calcZoneCoord(0) == 0);
-    static_assert(calcZoneCoord(ZONE_WIDTH - 1) == 0);
-    static_assert(calcZoneCoord(ZONE_WIDTH) == ZONE_WIDTH);
-
+    const Coordinate2i zone = zones::getZoneOrigin(c);
     // REVISIT: consider sprintf here instead of std::string concatenation if this shows up in perf.
-    return std::to_string(calcZoneCoord(c.x)) + "," + std::to_string(calcZoneCoord(-c.y));
+    return std::to_string(zone.x) + "," + std::to_string(zone.y);
 }
 
 // Splits the world in zones easier to download and load
 class ZoneIndex final
 {
 public:
-    using Index = std::unordered_map<std::string, ConstRoomList>;
+    using Zone = std::pair<std::string, ConstRoomList>;
+    using Index = std::vector<Zone>;
 
 private:
+    std::unordered_map<std::string, size_t> m_lookup;
     Index m_index;
 
 public:
-    void addRoom(const Room &room)
+    void addRoom(const SharedConstRoom &room)
     {
-        const auto zone = getZoneKey(room.getPosition());
-        const auto iter = m_index.find(zone);
-        if (iter == m_index.end()) {
-            ConstRoomList list;
-            list.emplace_back(room.shared_from_this());
-            m_index.emplace(zone, std::move(list));
+        auto zone = getZoneKey(deref(room).getPosition());
+        const auto iter = m_lookup.find(zone);
+        if (iter == m_lookup.end()) {
+            m_lookup.emplace(zone, m_index.size());
+            m_index.emplace_back(std::move(zone), ConstRoomList{room});
         } else {
-            iter->second.emplace_back(room.shared_from_this());
+            m_index[iter->second].second.emplace_back(room);
         }
     }
 
     const Index &index() const { return m_index; }
 };
 
-template<typename JsonT>
-static void writeJson(const QString &filePath, JsonT &json, const QString &what)
+static void writeFile(const QString &filePath, const QByteArray &data, const QString &what)
 {
-    static_assert(std::is_same_v<JsonT, QJsonObject> || std::is_same_v<JsonT, QJsonArray>);
     QFile file(filePath);
     if (!file.open(QIODevice::WriteOnly)) {
         QString msg(
@@ -148,82 +161,113 @@ static void writeJson(const QString &filePath, JsonT &json, const QString &what)
         throw std::runtime_error(::toStdStringUtf8(msg));
     }
 
-    QJsonDocument doc(json);
-    QTextStream stream(&file);
-    stream << doc.toJson();
-    stream.flush();
-    if (!file.flush() || stream.status() != QTextStream::Ok) {
+    if (file.write(data) != data.size() || !file.flush()) {
         QString msg(
             QString("error writing %1 to %2: %3").arg(what).arg(filePath).arg(file.errorString()));
         throw std::runtime_error(::toStdStringUtf8(msg));
     }
 }
 
-class RoomIndexStore final
+// Content hashes of the zone and room index files, keyed by zone key and by
+// hash prefix. The metadata keeps the ones of the last export, so the next one
+// only has to write the files that came out differently.
+struct ExportHashes final
 {
-    const QDir m_dir;
-    QJsonObject m_hashes;
-    QByteArray m_prefix;
-
-public:
-    RoomIndexStore() = delete;
-
-public:
-    explicit RoomIndexStore(const QDir &dir)
-        : m_dir(dir)
-    {}
+    using Hashes = std::map<std::string, QByteArray>;
+    Hashes zones;
+    Hashes roomIndex;
+};
 
-    void add(const QByteArray &hash, Coordinate coords)
-    {
-        QByteArray prefix = hash.left(c_roomIndexFileNameSize);
-        if (m_prefix != prefix) {
-            close();
-            m_prefix = prefix;
-        }
+static ExportHashes readExportHashes(const QFileInfo &path)
+{
+    ExportHashes result;
+    QFile file(path.filePath());
+    if (!file.open(QIODevice::ReadOnly))
+        return result;
+
+    // Anything unreadable just means that every file gets written again.
+    const QJsonObject meta = QJsonDocument::fromJson(file.readAll()).object();
+    const auto read = [&meta](const char *const name, ExportHashes::Hashes &hashes) {
+        const QJsonObject obj = meta.value(name).toObject();
+        for (auto it = obj.begin(); it != obj.end(); ++it)
+            hashes.emplace(::toStdStringUtf8(it.key()), it.value().toString().toLatin1());
+    };
+    read("zoneHashes", result.zones);
+    read("roomIndexHashes", result.roomIndex);
+    return result;
+}
 
-        QJsonArray jCoords;
-        jCoords.push_back(coords.x);
-        jCoords.push_back(coords.y * -1);
-        jCoords.push_back(coords.z);
+// Writes the file unless the last export wrote the same data to it; returns its hash.
+static QByteArray writeFileIfChanged(const ExportHashes::Hashes &previous,
+                                     const std::string &key,
+                                     const QString &filePath,
+                                     const QByteArray &data,
+                                     const QString &what)
+{
+    QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Md5).toHex();
+    const auto it = previous.find(key);
+    if (it == previous.end() || it->second != hash || !QFile::exists(filePath))
+        writeFile(filePath, data, what);
+    return hash;
+}
 
-        QJsonObject::iterator collision = m_hashes.find(hash);
-        if (collision == m_hashes.end()) {
-            QJsonArray array;
-            array.push_back(jCoords);
-            m_hashes.insert(hash, array);
-        } else {
-            collision->toArray().push_back(jCoords);
-        }
+// Deletes the files that the last export wrote but this one didn't.
+static void removeStaleFiles(const QDir &dir,
+                             const ExportHashes::Hashes &previous,
+                             const ExportHashes::Hashes &current)
+{
+    for (const auto &kv : previous) {
+        if (current.find(kv.first) == current.end())
+            QFile::remove(dir.filePath(::toQStringUtf8(kv.first + ".json")));
     }
+}
 
-    void close()
-    {
-        if (m_hashes.isEmpty()) {
-            return;
+// Runs fn(i) for every i in [begin, end) on the thread pool. The calls must be
+// independent; the first exception any of them throws is rethrown here once
+// they're all done.
+template<typename Fn>
+static void parallelForEach(const size_t begin, const size_t end, Fn &&fn)
+{
+    std::mutex mutex;
+    std::exception_ptr error;
+    parallelFor(end - begin, 1, [&](const size_t from, const size_t to) {
+        for (size_t i = begin + from; i < begin + to; ++i) {
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock{mutex};
+                if (!error)
+                    error = std::current_exception();
+            }
         }
-
-        assert(!m_prefix.isEmpty());
-        QString filePath = m_dir.filePath(QString::fromLocal8Bit(m_prefix) + ".json");
-
-        writeJson(filePath, m_hashes, "room index");
-
-        m_hashes = QJsonObject();
-        m_prefix = QByteArray();
-    }
-};
+    });
+    if (error)
+        std::rethrow_exception(error);
+}
 
 using JsonRoomId = uint;
 
-// Maps MM2 room IDs -> hole-free JSON room IDs
+// Maps MM2 room IDs -> hole-free JSON room IDs, indexed by the MM2 ID.
 class JsonRoomIdsCache
 {
-    using CacheT = QMap<RoomId, JsonRoomId>;
-    CacheT m_cache;
+    static constexpr const JsonRoomId INVALID_JSON_ID = ~0u;
+    std::vector<JsonRoomId> m_cache;
     JsonRoomId m_nextJsonId = 0u;
 
 public:
     JsonRoomIdsCache();
-    void addRoom(RoomId mm2RoomId) { m_cache[mm2RoomId] = m_nextJsonId++; }
+    // Sizes the cache once for every ID up to and including maxRoomId.
+    void reserve(RoomId maxRoomId)
+    {
+        m_cache.assign(static_cast<size_t>(maxRoomId.asUint32()) + 1, INVALID_JSON_ID);
+    }
+    void addRoom(RoomId mm2RoomId)
+    {
+        const auto i = static_cast<size_t>(mm2RoomId.asUint32());
+        if (i >= m_cache.size())
+            m_cache.resize(i + 1, INVALID_JSON_ID);
+        m_cache[i] = m_nextJsonId++;
+    }
     JsonRoomId operator[](RoomId roomId) const;
     uint size() const;
 };
@@ -232,9 +276,9 @@ JsonRoomIdsCache::JsonRoomIdsCache() = default;
 
 JsonRoomId JsonRoomIdsCache::operator[](RoomId roomId) const
 {
-    CacheT::const_iterator it = m_cache.find(roomId);
-    assert(it != m_cache.end());
-    return *it;
+    const auto i = static_cast<size_t>(roomId.asUint32());
+    assert(i < m_cache.size() && m_cache[i] != INVALID_JSON_ID);
+    return m_cache[i];
 }
 
 uint JsonRoomIdsCache::size() const
@@ -248,9 +292,12 @@ class JsonWorld final
     JsonRoomIdsCache m_jRoomIds;
     RoomHashIndex m_roomHashIndex;
     ZoneIndex m_zoneIndex;
+    // Base-map copies of rooms whose secret exits had to be removed.
+    RoomModificationTracker m_alteredTracker;
+    std::vector<std::shared_ptr<Room>> m_alteredRooms;
 
-    void addRoom(QJsonArray &jRooms, const Room &room) const;
-    void addExits(const Room &room, QJsonObject &jr) const;
+    void addRoom(JsonWriter &out, const Room &room) const;
+    void addExits(JsonWriter &out, const Room &room) const;
 
 public:
     JsonWorld();
@@ -259,38 +306,64 @@ class JsonWorld final
                   BaseMapSaveFilter &filter,
                   ProgressCounter &progressCounter,
                   bool baseMapOnly);
-    void writeMetadata(const QFileInfo &path, const MapData &mapData) const;
-    void writeRoomIndex(const QDir &dir) const;
-    void writeZones(const QDir &dir,
-                    BaseMapSaveFilter &filter,
-                    ProgressCounter &progressCounter,
-                    bool baseMapOnly) const;
+    void writeMetadata(const QFileInfo &path,
+                       const MapData &mapData,
+                       const ExportHashes &hashes) const;
+    NODISCARD ExportHashes::Hashes writeRoomIndex(const QDir &dir,
+                                                  const ExportHashes::Hashes &previous) const;
+    NODISCARD ExportHashes::Hashes writeZones(const QDir &dir,
+                                              const ExportHashes::Hashes &previous,
+                                              ProgressCounter &progressCounter) const;
 };
 
 JsonWorld::JsonWorld() = default;
 
-JsonWorld::~JsonWorld() = default;
+JsonWorld::~JsonWorld()
+{
+    for (const auto &room : m_alteredRooms)
+        room->setAboutToDie();
+}
 
 void JsonWorld::addRooms(const ConstRoomList &roomList,
                          BaseMapSaveFilter &filter,
                          ProgressCounter &progressCounter,
                          bool baseMapOnly)
 {
+    ConstRoomList accepted;
+    accepted.reserve(roomList.size());
+    {
+        uint32_t maxRoomId = 0;
+        for (const SharedConstRoom &pRoom : roomList)
+            maxRoomId = std::max(maxRoomId, deref(pRoom).getId().asUint32());
+        m_jRoomIds.reserve(RoomId{maxRoomId});
+    }
     for (const SharedConstRoom &pRoom : roomList) {
         const Room &room = deref(pRoom);
         progressCounter.step();
 
+        SharedConstRoom saved = pRoom;
         if (baseMapOnly) {
-            BaseMapSaveFilter::ActionEnum action = filter.filter(room);
-            if (room.isTemporary() || action == BaseMapSaveFilter::ActionEnum::REJECT) {
+            if (room.isTemporary())
+                continue;
+            // Alter rooms here rather than while writing the zones, since those
+            // are written in parallel and copying a room isn't thread-safe.
+            bool rejected = true;
+            filter.visitRoom(room, baseMapOnly, [this, &room, &saved, &rejected](const Room &r) {
+                rejected = false;
+                if (&r != &room) {
+                    m_alteredRooms.emplace_back(r.clone(m_alteredTracker));
+                    saved = m_alteredRooms.back();
+                }
+            });
+            if (rejected)
                 continue;
-            }
         }
 
         m_jRoomIds.addRoom(room.getId());
-        m_roomHashIndex.addRoom(room);
-        m_zoneIndex.addRoom(room);
+        m_zoneIndex.addRoom(saved);
+        accepted.emplace_back(std::move(saved));
     }
+    m_roomHashIndex.build(accepted);
 }
 
 static constexpr const char *getNameUpper(const ExitDirEnum dir)
@@ -316,47 +389,101 @@ static constexpr const char *getNameUpper(const ExitDirEnum dir)
 #undef CASE
 }
 
-void JsonWorld::writeMetadata(const QFileInfo &path, const MapData &mapData) const
+void JsonWorld::writeMetadata(const QFileInfo &path,
+                              const MapData &mapData,
+                              const ExportHashes &hashes) const
 {
     // This can give bogus data if the bounds aren't set.
     const Coordinate &min = mapData.getMin();
     const Coordinate &max = mapData.getMax();
 
-    QJsonObject meta;
-    meta["roomsCount"] = static_cast<qint64>(m_jRoomIds.size());
-    meta["minX"] = min.x;
-    meta["minY"] = std::min(-min.y, -max.y);
-    meta["minZ"] = min.z;
-    meta["maxX"] = max.x;
-    meta["maxY"] = std::max(-min.y, -max.y);
-    meta["maxZ"] = max.z;
-
-    meta["directions"] = []() {
-        QJsonArray arr;
-        // why is there no QJsonArray::resize()?
-        for (size_t i = 0; i <= NUM_EXITS; ++i)
-            arr.push_back(QString{});
-        for (size_t i = 0; i <= NUM_EXITS; ++i)
-            arr[static_cast<int>(i)] = getNameUpper(static_cast<ExitDirEnum>(i));
-        return arr;
-    }();
-
-    writeJson(path.filePath(), meta, "metadata");
+    JsonWriter meta;
+    meta.beginObject();
+    meta.member("roomsCount", static_cast<int64_t>(m_jRoomIds.size()));
+    meta.member("minX", min.x);
+    meta.member("minY", std::min(-min.y, -max.y));
+    meta.member("minZ", min.z);
+    meta.member("maxX", max.x);
+    meta.member("maxY", std::max(-min.y, -max.y));
+    meta.member("maxZ", max.z);
+
+    meta.key("directions");
+    meta.beginArray();
+    for (size_t i = 0; i <= NUM_EXITS; ++i)
+        meta.value(getNameUpper(static_cast<ExitDirEnum>(i)));
+    meta.endArray();
+
+    const auto writeHashes = [&meta](const char *const name, const ExportHashes::Hashes &h) {
+        meta.key(name);
+        meta.beginObject();
+        for (const auto &kv : h)
+            meta.member(kv.first.c_str(), kv.second.constData());
+        meta.endObject();
+    };
+    writeHashes("zoneHashes", hashes.zones);
+    writeHashes("roomIndexHashes", hashes.roomIndex);
+    meta.endObject();
+
+    writeFile(path.filePath(), meta.getData(), "metadata");
 }
 
-void JsonWorld::writeRoomIndex(const QDir &dir) const
+ExportHashes::Hashes JsonWorld::writeRoomIndex(const QDir &dir,
+                                               const ExportHashes::Hashes &previous) const
 {
-    using IterT = RoomHashIndex::Index::const_iterator;
+    // Rooms are grouped into one file per hash prefix, and each file maps
+    // every hash to the coordinates of all of its rooms.
     const RoomHashIndex::Index &index = m_roomHashIndex.index();
-
-    RoomIndexStore store(dir);
-    for (IterT iter = index.cbegin(); iter != index.cend(); ++iter) {
-        store.add(iter.key(), iter.value());
+    std::vector<size_t> fileStarts;
+    for (size_t i = 0; i < index.size(); ++i) {
+        if (i == 0
+            || index[i].first.left(c_roomIndexFileNameSize)
+                   != index[i - 1].first.left(c_roomIndexFileNameSize))
+            fileStarts.emplace_back(i);
     }
-    store.close();
+    fileStarts.emplace_back(index.size());
+
+    std::vector<QByteArray> hashes(fileStarts.size() - 1);
+    parallelForEach(0, fileStarts.size() - 1, [&](const size_t f) {
+        const size_t begin = fileStarts[f];
+        const size_t end = fileStarts[f + 1];
+        JsonWriter out;
+        out.beginObject();
+        for (size_t i = begin; i < end; ++i) {
+            const QByteArray &hash = index[i].first;
+            if (i == begin || hash != index[i - 1].first) {
+                if (i != begin)
+                    out.endArray();
+                out.key(hash.constData());
+                out.beginArray();
+            }
+            const Coordinate &coords = index[i].second;
+            out.beginArray();
+            out.value(coords.x);
+            out.value(coords.y * -1);
+            out.value(coords.z);
+            out.endArray();
+        }
+        out.endArray();
+        out.endObject();
+
+        const QByteArray prefix = index[begin].first.left(c_roomIndexFileNameSize);
+        const QString filePath = dir.filePath(QString::fromLocal8Bit(prefix) + ".json");
+        hashes[f] = writeFileIfChanged(previous,
+                                       prefix.toStdString(),
+                                       filePath,
+                                       out.getData(),
+                                       "room index");
+    });
+
+    ExportHashes::Hashes result;
+    for (size_t f = 0; f < hashes.size(); ++f) {
+        const QByteArray prefix = index[fileStarts[f]].first.left(c_roomIndexFileNameSize);
+        result.emplace(prefix.toStdString(), std::move(hashes[f]));
+    }
+    return result;
 }
 
-void JsonWorld::addRoom(QJsonArray &jRooms, const Room &room) const
+void JsonWorld::addRoom(JsonWriter &out, const Room &room) const
 {
     /*
           x: 5, y: 5, z: 0,
@@ -368,75 +495,99 @@ void JsonWorld::addRoom(QJsonArray &jRooms, const Room &room) const
     */
 
     const Coordinate &pos = room.getPosition();
-    QJsonObject jr;
-    jr["x"] = pos.x;
-    jr["y"] = -pos.y;
-    jr["z"] = pos.z;
+    out.beginObject();
+    out.member("x", pos.x);
+    out.member("y", -pos.y);
+    out.member("z", pos.z);
 
     uint jsonId = m_jRoomIds[room.getId()];
-    jr["id"] = QString::number(jsonId);
-    jr["name"] = room.getName().toQString();
-    jr["desc"] = room.getStaticDescription().toQString();
-    jr["sector"] = static_cast<quint8>(room.getTerrainType());
-    jr["light"] = static_cast<quint8>(room.getLightType());
-    jr["portable"] = static_cast<quint8>(room.getPortableType());
-    jr["rideable"] = static_cast<quint8>(room.getRidableType());
-    jr["sundeath"] = static_cast<quint8>(room.getSundeathType());
-    jr["mobflags"] = static_cast<qint64>(room.getMobFlags().asUint32());
-    jr["loadflags"] = static_cast<qint64>(room.getLoadFlags().asUint32());
-
-    addExits(room, jr);
-
-    jRooms.push_back(jr);
+    out.key("id");
+    out.quotedValue(jsonId);
+    out.member("name", room.getName().toQString());
+    out.member("desc", room.getStaticDescription().toQString());
+    out.member("sector", static_cast<quint8>(room.getTerrainType()));
+    out.member("light", static_cast<quint8>(room.getLightType()));
+    out.member("portable", static_cast<quint8>(room.getPortableType()));
+    out.member("rideable", static_cast<quint8>(room.getRidableType()));
+    out.member("sundeath", static_cast<quint8>(room.getSundeathType()));
+    out.member("mobflags", static_cast<int64_t>(room.getMobFlags().asUint32()));
+    out.member("loadflags", static_cast<int64_t>(room.getLoadFlags().asUint32()));
+
+    addExits(out, room);
+
+    out.endObject();
 }
 
-void JsonWorld::addExits(const Room &room, QJsonObject &jr) const
+void JsonWorld::addExits(JsonWriter &out, const Room &room) const
 {
     const ExitsList &exitList = room.getExitsList();
-    QJsonArray jExits; // Direction-indexed
+    out.key("exits");
+    out.beginArray(); // Direction-indexed
     for (const Exit &e : exitList) {
-        QJsonObject je;
-        je["flags"] = static_cast<qint64>(e.getExitFlags().asUint32());
-        je["dflags"] = static_cast<qint64>(e.getDoorFlags().asUint32());
-        je["name"] = e.getDoorName().toQString();
+        out.beginObject();
+        out.member("flags", static_cast<int64_t>(e.getExitFlags().asUint32()));
+        out.member("dflags", static_cast<int64_t>(e.getDoorFlags().asUint32()));
+        out.member("name", e.getDoorName().toQString());
 
-        QJsonArray jin;
+        out.key("in");
+        out.beginArray();
         for (auto idx : e.inRange()) {
-            jin << QString::number(m_jRoomIds[idx]);
+            out.quotedValue(m_jRoomIds[idx]);
         }
-        je["in"] = jin;
+        out.endArray();
 
-        QJsonArray jout;
+        out.key("out");
+        out.beginArray();
         for (auto idx : e.outRange()) {
-            jout << QString::number(m_jRoomIds[idx]);
+            out.quotedValue(m_jRoomIds[idx]);
         }
-        je["out"] = jout;
+        out.endArray();
 
-        jExits << je;
+        out.endObject();
     }
-
-    jr["exits"] = jExits;
+    out.endArray();
 }
 
-void JsonWorld::writeZones(const QDir &dir,
-                           BaseMapSaveFilter &filter,
-                           ProgressCounter &progressCounter,
-                           bool baseMapOnly) const
+// Zones are written this many at a time, so progress can be reported in between.
+static constexpr const size_t ZONES_PER_BATCH = 64;
+
+ExportHashes::Hashes JsonWorld::writeZones(const QDir &dir,
+                                           const ExportHashes::Hashes &previous,
+                                           ProgressCounter &progressCounter) const
 {
     const ZoneIndex::Index &index = m_zoneIndex.index();
-
-    for (auto &kv : index) {
-        const ConstRoomList &rooms = kv.second;
-        QJsonArray jRooms;
-        auto saveOne = [this, &jRooms](const Room &room) { addRoom(jRooms, room); };
-        for (const auto &pRoom : rooms) {
-            filter.visitRoom(deref(pRoom), baseMapOnly, saveOne);
-            progressCounter.step();
-        }
-
-        QString filePath = dir.filePath(::toQStringUtf8(kv.first + ".json"));
-        writeJson(filePath, jRooms, "zone");
+    std::vector<QByteArray> hashes(index.size());
+
+    for (size_t batch = 0; batch < index.size(); batch += ZONES_PER_BATCH) {
+        const size_t batchEnd = std::min(index.size(), batch + ZONES_PER_BATCH);
+        parallelForEach(batch, batchEnd, [this, &dir, &previous, &index, &hashes](const size_t z) {
+            const ConstRoomList &rooms = index[z].second;
+            JsonWriter out;
+            out.reserve(static_cast<int>(rooms.size()) * 1024);
+            out.beginArray();
+            for (const auto &pRoom : rooms) {
+                addRoom(out, deref(pRoom));
+            }
+            out.endArray();
+
+            QString filePath = dir.filePath(::toQStringUtf8(index[z].first + ".json"));
+            hashes[z] = writeFileIfChanged(previous,
+                                           index[z].first,
+                                           filePath,
+                                           out.getData(),
+                                           "zone");
+        });
+
+        size_t steps = 0;
+        for (size_t z = batch; z < batchEnd; ++z)
+            steps += index[z].second.size();
+        progressCounter.step(static_cast<quint32>(steps));
     }
+
+    ExportHashes::Hashes result;
+    for (size_t z = 0; z < index.size(); ++z)
+        result.emplace(index[z].first, std::move(hashes[z]));
+    return result;
 }
 
 } // namespace
@@ -475,9 +626,7 @@ bool JsonMapStorage::saveData(bool baseMapOnly)
 
     const MarkerList &markerList = m_mapData.getMarkersList();
     RoomSaver saver(m_mapData, roomList);
-    for (uint i = 0; i < m_mapData.getRoomsCount(); ++i) {
-        m_mapData.lookingForRooms(saver, RoomId{i});
-    }
+    m_mapData.lookingForAllRooms(saver);
 
     uint roomsCount = saver.getRoomsCount();
     auto marksCount = static_cast<uint>(markerList.size());
@@ -501,19 +650,27 @@ bool JsonMapStorage::saveData(bool baseMapOnly)
     QDir roomIndexDir(QFileInfo(destDir, "roomindex").filePath());
     QDir zoneDir(QFileInfo(destDir, "zone").filePath());
     try {
-        if (!saveDir.mkdir("v1")) {
+        // The directories may be left over from an earlier export, which is then updated.
+        if (!saveDir.mkpath("v1")) {
             throw std::runtime_error("error creating dir v1");
         }
-        if (!destDir.mkdir("roomindex")) {
+        if (!destDir.mkpath("roomindex")) {
             throw std::runtime_error("error creating dir v1/roomindex");
         }
-        if (!destDir.mkdir("zone")) {
+        if (!destDir.mkpath("zone")) {
             throw std::runtime_error("error creating dir v1/zone");
         }
 
-        world.writeMetadata(QFileInfo(destDir, "arda.json"), m_mapData);
-        world.writeRoomIndex(roomIndexDir);
-        world.writeZones(zoneDir, filter, progressCounter, baseMapOnly);
+        // The metadata is written last, so an export that fails halfway still
+        // leaves hashes that are at worst out of date, which only costs rewrites.
+        const QFileInfo metadataPath(destDir, "arda.json");
+        const ExportHashes previous = readExportHashes(metadataPath);
+        ExportHashes current;
+        current.roomIndex = world.writeRoomIndex(roomIndexDir, previous.roomIndex);
+        current.zones = world.writeZones(zoneDir, previous.zones, progressCounter);
+        removeStaleFiles(roomIndexDir, previous.roomIndex, current.roomIndex);
+        removeStaleFiles(zoneDir, previous.zones, current.zones);
+        world.writeMetadata(metadataPath, m_mapData, current);
     } catch (std::exception &e) {
         emit log("JsonMapStorage", e.what());
         return false;
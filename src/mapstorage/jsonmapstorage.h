@@ -21,6 +21,9 @@ class QObject;
  * - v1/arda.json (global metadata like map size).
  * - v1/roomindex/ss.json (room sums -> zone coords).
  * - v1/zone/xx-yy.json (full info on the NxN rooms zone at coords xx,yy).
+ *
+ * Saving over an earlier export only rewrites the files whose contents changed,
+ * going by the hashes of the files that arda.json records.
  */
 class JsonMapStorage final : public AbstractMapStorage
 {
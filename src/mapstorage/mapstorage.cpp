@@ -6,23 +6,44 @@
 
 #include "mapstorage.h"
 
+#include <algorithm>
+#include <array>
 #include <climits>
+#include <cmath>
 #include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
 #include <stdexcept>
+#include <string>
+#include <tuple>
 #include <type_traits>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 #include <QMessageLogContext>
 #include <QObject>
 #include <QtCore>
+#include <QtEndian>
 #include <QtWidgets>
+#ifdef MMAPPER_WITH_ZSTD
+#include <zstd.h>
+#endif
 
 #include "../configuration/configuration.h"
 #include "../expandoracommon/exit.h"
 #include "../expandoracommon/room.h"
 #include "../global/Flags.h"
+#include "../global/ParallelFor.h"
+#include "../global/RuleOf5.h"
+#include "../global/Trace.h"
 #include "../global/io.h"
+#include "../global/random.h"
 #include "../global/roomid.h"
 #include "../global/utils.h"
 #include "../mapdata/DoorFlags.h"
@@ -31,8 +52,9 @@
 #include "../mapdata/infomark.h"
 #include "../mapdata/mapdata.h"
 #include "../mapdata/mmapper2room.h"
+#include "../mapfrontend/ParseTree.h"
 #include "../parser/patterns.h"
-#include "StorageUtils.h"
+#include "InflateDevice.h"
 #include "abstractmapstorage.h"
 #include "basemapsavefilter.h"
 #include "progresscounter.h"
@@ -46,7 +68,11 @@ static constexpr const int MMAPPER_2_4_0_SCHEMA = 33; // 16bit ExitsFlags, 32bit
 static constexpr const int MMAPPER_2_4_3_SCHEMA = 34; // qCompress, SunDeath flag
 static constexpr const int MMAPPER_2_5_1_SCHEMA = 35; // discard all previous NoMatch flags
 static constexpr const int MMAPPER_19_10_0_SCHEMA = 36; // switches to new coordinate system
-static constexpr const int CURRENT_SCHEMA = MMAPPER_19_10_0_SCHEMA;
+static constexpr const int MMAPPER_20_05_0_SCHEMA = 37; // uncompressed sections, loaded via mmap
+static constexpr const int CURRENT_SCHEMA = MMAPPER_20_05_0_SCHEMA;
+
+// Journals smaller than this are never worth compacting.
+static constexpr const qint64 MIN_JOURNAL_COMPACT_SIZE = 1 << 20;
 
 static_assert(021 == 17, "MMapper 2.0.0 Schema");
 static_assert(030 == 24, "MMapper 2.0.2 Schema");
@@ -109,13 +135,6 @@ static void transformInfomarkOnLoad(const uint32_t version, InfoMark &mark)
     mark.setPosition2(convertESUtoENU(mark.getPosition2()));
 }
 
-static void writeCoordinate(QDataStream &stream, const Coordinate &c)
-{
-    stream << static_cast<qint32>(c.x);
-    stream << static_cast<qint32>(c.y);
-    stream << static_cast<qint32>(c.z);
-}
-
 MapStorage::MapStorage(MapData &mapdata, const QString &filename, QFile *file, QObject *parent)
     : AbstractMapStorage(mapdata, filename, file, parent)
 {}
@@ -254,6 +273,911 @@ static RoomTerrainEnum serialize(const uint32_t value)
     return static_cast<RoomTerrainEnum>(value);
 }
 
+namespace mapped {
+// Layout of MMAPPER_20_05_0_SCHEMA files.
+//
+// The magic and version are written by QDataStream (big-endian) like every
+// other schema. Everything after them is little-endian and addressed by
+// absolute file offsets, so the file can be mapped and decoded in place
+// instead of being read, decompressed and parsed as one stream:
+//
+//   u32 sectionCount, u32 reserved
+//   sectionCount * { u32 kind, u32 reserved, u64 offset, u64 size }
+//   the sections, each aligned to SECTION_ALIGNMENT
+//
+// Records are fixed-width; strings are { u32 offset, u32 length } references
+// into the STRINGS section, which holds each distinct UTF-8 string once.
+//
+// Compressed maps replace ROOMS, EXITS and CONNECTIONS with BLOCKS, so STRINGS
+// then only holds the text of the marks.
+enum class SectionEnum : uint32_t {
+    // u32 roomsCount, u32 marksCount, i32 x, y, z (selected position)
+    META = 1,
+    // u32 id, string name, staticDesc, dynamicDesc, note,
+    // u8 terrain, light, align, portable, ridable, sundeath, upToDate, (padding),
+    // u32 mobFlags, u32 loadFlags, i32 x, y, z
+    ROOMS = 2,
+    // NUM_EXITS records per room, in room order:
+    // u16 exitFlags, u16 doorFlags, string doorName,
+    // u32 firstIn, u32 numIn, u32 firstOut, u32 numOut (indices into CONNECTIONS)
+    EXITS = 3,
+    // u32 room ids
+    CONNECTIONS = 4,
+    // string text, u8 type, u8 class, (u16 padding), i32 rotation,
+    // i32 x1, y1, z1, i32 x2, y2, z2
+    MARKS = 5,
+    STRINGS = 6,
+    // One entry per block: u64 offset (into BLOCKS), u64 compressedSize, u32 numRooms, u32 codec
+    BLOCK_INDEX = 7,
+    // Compressed blocks of up to ROOMS_PER_BLOCK rooms, each self-contained:
+    // u32 numRooms, u32 reserved, u64 roomsSize, exitsSize, connectionsSize, stringsSize,
+    // followed by those ROOMS, EXITS, CONNECTIONS and STRINGS (indices are block-local)
+    BLOCKS = 8,
+    // Optional; what ParseTree::computeKeys() returned for each room, in file order:
+    // u32 keysVersion, u32 roomsCount, u64 contentHash (see hashRoomSections()),
+    // then roomsCount * { u32 mask, u32 reserved, u64 primary, u64 levels[3] }
+    PARSE_KEYS = 9,
+    // Optional; u64 journalId, drawn at random by every full save. A journal is only
+    // replayed over the file whose id it carries (see makeJournalHeader()).
+    JOURNAL_ID = 10,
+    // Optional; u64 mapIdentity (see MapData::getMapIdentity()), which every save keeps.
+    MAP_IDENTITY = 11,
+};
+static constexpr const size_t NUM_SECTIONS = 11;
+
+static constexpr const uint32_t FILE_MAGIC = 0xFFB2AF01u;
+static constexpr const size_t FILE_HEADER_SIZE = 8; // magic and version (big-endian)
+static constexpr const size_t SECTION_TABLE_HEADER_SIZE = 8;
+static constexpr const size_t SECTION_ENTRY_SIZE = 24;
+static constexpr const size_t SECTION_ALIGNMENT = 8;
+
+static constexpr const size_t STRING_REF_SIZE = 8;
+static constexpr const size_t COORD_SIZE = 12;
+static constexpr const size_t META_SIZE = 8 + COORD_SIZE;
+static constexpr const size_t ROOM_RECORD_SIZE = 4 + 4 * STRING_REF_SIZE + 8 + 8 + COORD_SIZE;
+static constexpr const size_t EXIT_RECORD_SIZE = 4 + STRING_REF_SIZE + 16;
+static constexpr const size_t MARK_RECORD_SIZE = STRING_REF_SIZE + 8 + 2 * COORD_SIZE;
+/// How each block in BLOCKS is compressed; readers reject codecs they don't know.
+enum class BlockCodecEnum : uint32_t {
+    // qCompress() output
+    ZLIB = 1,
+    // one Zstandard frame that records its content size; only builds with
+    // WITH_ZSTD write or read these
+    ZSTD = 2,
+};
+// Saves stay readable by every build unless this one opted into zstd.
+static constexpr const BlockCodecEnum BLOCK_CODEC = WITH_ZSTD ? BlockCodecEnum::ZSTD
+                                                              : BlockCodecEnum::ZLIB;
+// Blocks are compressed in parallel, and zlib's fastest level is several times
+// quicker than its default for a slightly larger file; zstd's level 1 is
+// quicker still and compresses better.
+static constexpr const int BLOCK_COMPRESSION_LEVEL = 1;
+
+NODISCARD static QByteArray compressBlock(const QByteArray &payload)
+{
+#ifdef MMAPPER_WITH_ZSTD
+    QByteArray result(static_cast<int>(ZSTD_compressBound(static_cast<size_t>(payload.size()))),
+                      Qt::Uninitialized);
+    const size_t size = ZSTD_compress(result.data(),
+                                      static_cast<size_t>(result.size()),
+                                      payload.constData(),
+                                      static_cast<size_t>(payload.size()),
+                                      BLOCK_COMPRESSION_LEVEL);
+    if (ZSTD_isError(size))
+        throw io::IOException(std::string("zstd failed: ") + ZSTD_getErrorName(size));
+    result.resize(static_cast<int>(size));
+    return result;
+#else
+    return qCompress(payload, BLOCK_COMPRESSION_LEVEL);
+#endif
+}
+
+NODISCARD static QByteArray uncompressBlock(const uint32_t codec,
+                                            const uchar *const data,
+                                            const size_t size)
+{
+    if (codec == static_cast<uint32_t>(BlockCodecEnum::ZLIB))
+        return qUncompress(data, static_cast<int>(size));
+#ifdef MMAPPER_WITH_ZSTD
+    if (codec == static_cast<uint32_t>(BlockCodecEnum::ZSTD)) {
+        const auto contentSize = ZSTD_getFrameContentSize(data, size);
+        if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN
+            || contentSize > static_cast<unsigned long long>(std::numeric_limits<int>::max())) {
+            throw io::IOException("map block is corrupt");
+        }
+        QByteArray result(static_cast<int>(contentSize), Qt::Uninitialized);
+        const size_t written = ZSTD_decompress(result.data(),
+                                               static_cast<size_t>(result.size()),
+                                               data,
+                                               size);
+        if (ZSTD_isError(written) || written != static_cast<size_t>(contentSize))
+            throw io::IOException("map block is corrupt");
+        return result;
+    }
+#endif
+    throw io::IOException("map block uses unsupported codec " + std::to_string(codec));
+}
+
+// Bump this if ParseTree's keys ever change, so older saved keys are ignored.
+static constexpr const uint32_t PARSE_KEYS_VERSION = 1;
+static constexpr const size_t PARSE_KEYS_HEADER_SIZE = 16;
+static constexpr const size_t PARSE_KEYS_RECORD_SIZE = 8 + 8 * (1 + ParseKeys::MAX_LEVELS);
+
+static constexpr const size_t BLOCK_INDEX_ENTRY_SIZE = 24;
+static constexpr const size_t BLOCK_HEADER_SIZE = 8 + 4 * 8;
+static constexpr const uint32_t ROOMS_PER_BLOCK = 4096;
+static_assert(ROOM_RECORD_SIZE == 64);
+static_assert(EXIT_RECORD_SIZE == 28);
+static_assert(MARK_RECORD_SIZE == 40);
+static_assert(PARSE_KEYS_RECORD_SIZE == 40);
+
+/// Bounds-checked view of (part of) a mapped file.
+class NODISCARD Span final
+{
+private:
+    const uchar *m_data = nullptr;
+    size_t m_size = 0;
+
+public:
+    Span() = default;
+    explicit Span(const uchar *const data, const size_t size)
+        : m_data{data}
+        , m_size{size}
+    {}
+
+public:
+    NODISCARD size_t size() const { return m_size; }
+
+    NODISCARD Span slice(const uint64_t offset, const uint64_t size) const
+    {
+        if (offset > m_size || size > m_size - offset)
+            throw io::IOException("section is out of bounds");
+        return Span{m_data + offset, static_cast<size_t>(size)};
+    }
+
+    NODISCARD const char *bytes(const size_t offset, const size_t len) const
+    {
+        if (offset > m_size || len > m_size - offset)
+            throw io::IOException("read past end of section");
+        return reinterpret_cast<const char *>(m_data + offset);
+    }
+
+    template<typename T>
+    NODISCARD T read(const size_t offset) const
+    {
+        static_assert(std::is_integral_v<T>);
+        const char *const p = bytes(offset, sizeof(T));
+        if constexpr (sizeof(T) == 1) {
+            return static_cast<T>(*p);
+        } else {
+            return qFromLittleEndian<T>(p);
+        }
+    }
+};
+
+/// Sequential reader over one fixed-width record.
+class NODISCARD RecordReader final
+{
+private:
+    const Span &m_span;
+    const Span &m_strings;
+    size_t m_pos = 0;
+
+public:
+    explicit RecordReader(const Span &span,
+                          const Span &strings,
+                          const size_t index,
+                          const size_t recordSize)
+        : m_span{span}
+        , m_strings{strings}
+        , m_pos{index * recordSize}
+    {}
+
+public:
+    template<typename T>
+    NODISCARD T read()
+    {
+        const T result = m_span.read<T>(m_pos);
+        m_pos += sizeof(T);
+        return result;
+    }
+    NODISCARD auto read_u8() { return read<uint8_t>(); }
+    NODISCARD auto read_u16() { return read<uint16_t>(); }
+    NODISCARD auto read_u32() { return read<uint32_t>(); }
+    NODISCARD auto read_i32() { return read<int32_t>(); }
+    void skip(const size_t bytes) { m_pos += bytes; }
+
+    NODISCARD QString read_string()
+    {
+        const auto offset = read_u32();
+        const auto len = read_u32();
+        if (len == 0)
+            return QString{};
+        if (len > static_cast<uint32_t>(std::numeric_limits<int>::max()))
+            throw io::IOException("string is too long");
+        return QString::fromUtf8(m_strings.bytes(offset, len), static_cast<int>(len));
+    }
+    // Checks the reference so the string can safely be read later.
+    void skip_string()
+    {
+        const auto offset = read_u32();
+        const auto len = read_u32();
+        if (len > static_cast<uint32_t>(std::numeric_limits<int>::max()))
+            throw io::IOException("string is too long");
+        static_cast<void>(m_strings.bytes(offset, len));
+    }
+
+    NODISCARD Coordinate readCoord3d()
+    {
+        const auto x = read_i32();
+        const auto y = read_i32();
+        const auto z = read_i32();
+        return Coordinate{x, y, z};
+    }
+};
+
+template<typename T>
+static void append(QByteArray &out, const T value)
+{
+    static_assert(std::is_integral_v<T>);
+    if constexpr (sizeof(T) == 1) {
+        out.append(static_cast<char>(value));
+    } else {
+        const T le = qToLittleEndian(value);
+        out.append(reinterpret_cast<const char *>(&le), static_cast<int>(sizeof(T)));
+    }
+}
+
+static void appendCoord(QByteArray &out, const Coordinate &c)
+{
+    append<int32_t>(out, c.x);
+    append<int32_t>(out, c.y);
+    append<int32_t>(out, c.z);
+}
+
+/// Hash of the sections that rooms are decoded from, so saved keys are only
+/// used with the rooms they were computed for.
+NODISCARD static uint64_t hashRoomSections(const std::initializer_list<Span> &spans)
+{
+    static constexpr const uint64_t PRIME = 1099511628211ull;
+    uint64_t h = 14695981039346656037ull;
+    const auto mix = [&h](const uint64_t word) {
+        h = (h ^ word) * PRIME;
+        h ^= h >> 32;
+    };
+    for (const Span &span : spans) {
+        const size_t size = span.size();
+        const char *const data = span.bytes(0, size);
+        mix(size);
+        // A word at a time; this has to keep up with mapping the file.
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+            mix(qFromLittleEndian<uint64_t>(data + i));
+        for (; i < size; ++i)
+            mix(static_cast<uchar>(data[i]));
+    }
+    return h;
+}
+
+NODISCARD static Span toSpan(const QByteArray &data)
+{
+    return Span{reinterpret_cast<const uchar *>(data.constData()), static_cast<size_t>(data.size())};
+}
+
+/// Builds the STRINGS section; identical strings share storage.
+class NODISCARD StringPool final
+{
+private:
+    QByteArray m_data;
+    QHash<QByteArray, uint32_t> m_offsets;
+
+public:
+    void append(QByteArray &out, const QString &s)
+    {
+        if (s.isEmpty()) {
+            mapped::append<uint32_t>(out, 0);
+            mapped::append<uint32_t>(out, 0);
+            return;
+        }
+        const QByteArray utf8 = s.toUtf8();
+        auto it = m_offsets.find(utf8);
+        if (it == m_offsets.end()) {
+            if (static_cast<uint64_t>(m_data.size()) + static_cast<uint64_t>(utf8.size())
+                > std::numeric_limits<uint32_t>::max()) {
+                throw io::IOException("string pool is too large");
+            }
+            it = m_offsets.insert(utf8, static_cast<uint32_t>(m_data.size()));
+            m_data.append(utf8);
+        }
+        mapped::append<uint32_t>(out, it.value());
+        mapped::append<uint32_t>(out, static_cast<uint32_t>(utf8.size()));
+    }
+    NODISCARD const QByteArray &getData() const { return m_data; }
+};
+
+/// The per-room sections, either of the whole file or of one block.
+struct NODISCARD RoomSections final
+{
+    Span rooms;
+    Span exits;
+    Span connections;
+    Span strings;
+};
+
+/// Everything loaded for one room, so records can be decoded on any thread and
+/// turned into rooms in order afterwards.
+struct NODISCARD DecodedRoom final
+{
+#define DECL_FIELD(_Type, _Prop, _OptInit) _Type _Prop _OptInit;
+    XFOREACH_ROOM_PROPERTY(DECL_FIELD)
+#undef DECL_FIELD
+    RoomId id = INVALID_ROOMID;
+    bool upToDate = false;
+    Coordinate position;
+    ExitsList exits;
+    // Set if the descriptions and note were left in the file, at this record.
+    bool coldTextPending = false;
+    uint32_t record = 0;
+    // From the PARSE_KEYS section, if it could be used.
+    std::optional<ParseKeys> parseKeys;
+};
+
+/// Reads the cold text of ROOMS records from a file that stays mapped for as
+/// long as any room still needs it.
+///
+/// Saving replaces the file rather than writing over it, so the mapping keeps the
+/// old contents. But if something else truncates the file while rooms still have
+/// their text pending, reading the text past the new end raises SIGBUS; and since
+/// the mapping is private but not a copy, anything else written over the file
+/// shows through.
+class NODISCARD MappedRoomText final : public RoomColdTextSource
+{
+private:
+    std::unique_ptr<QFile> m_file;
+    uchar *m_data = nullptr;
+    // As it was mapped, whatever happens to the file later.
+    size_t m_size = 0;
+    Span m_rooms;
+    Span m_strings;
+
+public:
+    explicit MappedRoomText(std::unique_ptr<QFile> file, uchar *const data, const size_t size)
+        : m_file{std::move(file)}
+        , m_data{data}
+        , m_size{size}
+    {}
+    ~MappedRoomText() final { m_file->unmap(m_data); }
+    DELETE_CTORS_AND_ASSIGN_OPS(MappedRoomText);
+
+public:
+    NODISCARD Span getFile() const { return Span{m_data, m_size}; }
+    void setSections(const Span &rooms, const Span &strings)
+    {
+        m_rooms = rooms;
+        m_strings = strings;
+    }
+
+public:
+    NODISCARD Text load(const uint32_t index) const final
+    {
+        // The references were checked by decodeRooms().
+        RecordReader r{m_rooms, m_strings, index, ROOM_RECORD_SIZE};
+        r.skip(sizeof(uint32_t) + 2 * sizeof(uint32_t)); // id and name
+        Text text;
+        text.staticDesc = RoomStaticDesc{r.read_string()};
+        text.dynamicDesc = RoomDynamicDesc{r.read_string()};
+        text.note = RoomNote{r.read_string()};
+        return text;
+    }
+};
+
+/// Returns a private mapping of the file, or nullptr if it can't be mapped.
+NODISCARD static std::shared_ptr<MappedRoomText> mapRoomText(const QString &fileName)
+{
+    auto file = std::make_unique<QFile>(fileName);
+    if (!file->open(QIODevice::ReadOnly))
+        return nullptr;
+    const qint64 size = file->size();
+    uchar *const data = file->map(0, size, QFileDevice::MapPrivateOption);
+    if (data == nullptr)
+        return nullptr;
+    return std::make_shared<MappedRoomText>(std::move(file), data, static_cast<size_t>(size));
+}
+
+// With skipColdText, the descriptions and note are validated but not read.
+static void decodeRooms(const RoomSections &sections,
+                        const size_t begin,
+                        const size_t end,
+                        const uint32_t baseId,
+                        const Coordinate &basePosition,
+                        DecodedRoom *const out,
+                        const bool skipColdText = false)
+{
+    const auto readConnections = [&sections, baseId](const uint32_t first,
+                                                     const uint32_t count,
+                                                     auto &&callback) {
+        for (uint32_t k = 0; k < count; ++k) {
+            const size_t index = static_cast<size_t>(first) + k;
+            callback(RoomId{sections.connections.read<uint32_t>(index * sizeof(uint32_t))
+                            + baseId});
+        }
+    };
+
+    for (size_t i = begin; i < end; ++i) {
+        DecodedRoom &d = out[i - begin];
+        RecordReader r{sections.rooms, sections.strings, i, ROOM_RECORD_SIZE};
+        d.id = RoomId{r.read_u32() + baseId};
+        d.Name = RoomName{r.read_string()};
+        if (skipColdText) {
+            r.skip_string();
+            r.skip_string();
+            r.skip_string();
+            d.coldTextPending = true;
+            d.record = static_cast<uint32_t>(i);
+        } else {
+            d.StaticDescription = RoomStaticDesc{r.read_string()};
+            d.DynamicDescription = RoomDynamicDesc{r.read_string()};
+            d.Note = RoomNote{r.read_string()};
+        }
+        d.TerrainType = serialize(r.read_u8());
+        d.LightType = serialize<RoomLightEnum>(r.read_u8());
+        d.AlignType = serialize<RoomAlignEnum>(r.read_u8());
+        d.PortableType = serialize<RoomPortableEnum>(r.read_u8());
+        d.RidableType = serialize<RoomRidableEnum>(r.read_u8());
+        d.SundeathType = serialize<RoomSundeathEnum>(r.read_u8());
+        d.upToDate = (r.read_u8() != 0u);
+        r.skip(1);
+        d.MobFlags = serialize<RoomMobFlags>(r.read_u32());
+        d.LoadFlags = serialize<RoomLoadFlags>(r.read_u32());
+        d.position = r.readCoord3d() + basePosition;
+
+        for (const auto dir : ALL_EXITS7) {
+            Exit &e = d.exits[dir];
+            RecordReader x{sections.exits,
+                           sections.strings,
+                           i * NUM_EXITS + static_cast<size_t>(dir),
+                           EXIT_RECORD_SIZE};
+            e.setExitFlags(serialize<ExitFlags>(x.read_u16()));
+            e.setDoorFlags(serialize<DoorFlags>(x.read_u16()));
+            e.setDoorName(static_cast<DoorName>(x.read_string()));
+            const auto firstIn = x.read_u32();
+            const auto numIn = x.read_u32();
+            readConnections(firstIn, numIn, [&e](const RoomId id) { e.addIn(id); });
+            const auto firstOut = x.read_u32();
+            const auto numOut = x.read_u32();
+            readConnections(firstOut, numOut, [&e](const RoomId id) { e.addOut(id); });
+        }
+    }
+}
+
+static void writeMark(QByteArray &out, StringPool &strings, const InfoMark &mark)
+{
+    // REVISIT: round to 45 degrees?
+    const InfoMarkTypeEnum type = mark.getType();
+    strings.append(out, (type == InfoMarkTypeEnum::TEXT) ? mark.getText().toQString() : QString{});
+    append<uint8_t>(out, static_cast<quint8>(type));
+    append<uint8_t>(out, static_cast<quint8>(mark.getClass()));
+    append<uint16_t>(out, 0);
+    append<int32_t>(out, static_cast<qint32>(std::lround(mark.getRotationAngle())));
+    appendCoord(out, mark.getPosition1());
+    appendCoord(out, mark.getPosition2());
+}
+
+/// Rooms being written, either for the whole file or for one compressed block.
+struct NODISCARD RoomBlock final
+{
+    uint32_t numRooms = 0;
+    QByteArray rooms;
+    QByteArray exits;
+    QByteArray connections;
+    StringPool strings;
+
+    void writeRoom(const Room &room)
+    {
+        ++numRooms;
+        append<uint32_t>(rooms, static_cast<quint32>(room.getId()));
+        strings.append(rooms, room.getName().toQString());
+        strings.append(rooms, room.getStaticDescription().toQString());
+        strings.append(rooms, room.getDynamicDescription().toQString());
+        strings.append(rooms, room.getNote().toQString());
+        append<uint8_t>(rooms, static_cast<quint8>(room.getTerrainType()));
+        append<uint8_t>(rooms, static_cast<quint8>(room.getLightType()));
+        append<uint8_t>(rooms, static_cast<quint8>(room.getAlignType()));
+        append<uint8_t>(rooms, static_cast<quint8>(room.getPortableType()));
+        append<uint8_t>(rooms, static_cast<quint8>(room.getRidableType()));
+        append<uint8_t>(rooms, static_cast<quint8>(room.getSundeathType()));
+        append<uint8_t>(rooms, static_cast<quint8>(room.isUpToDate()));
+        append<uint8_t>(rooms, 0);
+        append<uint32_t>(rooms, static_cast<quint32>(room.getMobFlags()));
+        append<uint32_t>(rooms, static_cast<quint32>(room.getLoadFlags()));
+        appendCoord(rooms, room.getPosition());
+
+        for (const Exit &e : room.getExitsList()) {
+            append<uint16_t>(exits, static_cast<uint16_t>(e.getExitFlags()));
+            append<uint16_t>(exits, static_cast<uint16_t>(e.getDoorFlags()));
+            strings.append(exits, e.getDoorName().toQString());
+            writeConnections(e.inRange());
+            writeConnections(e.outRange());
+        }
+    }
+
+    NODISCARD QByteArray compress() const
+    {
+        QByteArray payload;
+        append<uint32_t>(payload, numRooms);
+        append<uint32_t>(payload, 0);
+        append<uint64_t>(payload, static_cast<uint64_t>(rooms.size()));
+        append<uint64_t>(payload, static_cast<uint64_t>(exits.size()));
+        append<uint64_t>(payload, static_cast<uint64_t>(connections.size()));
+        append<uint64_t>(payload, static_cast<uint64_t>(strings.getData().size()));
+        payload.append(rooms);
+        payload.append(exits);
+        payload.append(connections);
+        payload.append(strings.getData());
+        return compressBlock(payload);
+    }
+
+private:
+    template<typename Range>
+    void writeConnections(const Range &range)
+    {
+        const auto first = static_cast<uint32_t>(static_cast<size_t>(connections.size())
+                                                 / sizeof(uint32_t));
+        uint32_t count = 0;
+        for (const RoomId id : range) {
+            append<uint32_t>(connections, static_cast<quint32>(id));
+            ++count;
+        }
+        append<uint32_t>(exits, first);
+        append<uint32_t>(exits, count);
+    }
+};
+
+class NODISCARD Writer final
+{
+private:
+    const bool m_compress;
+    QByteArray m_meta;
+    QByteArray m_marks;
+    // Uncompressed maps keep everything in m_blocks.front(); compressed maps
+    // start a new block every ROOMS_PER_BLOCK rooms and keep mark text here.
+    StringPool m_markStrings;
+    std::vector<RoomBlock> m_blocks;
+    QByteArray m_parseKeys;
+    uint32_t m_numParseKeys = 0;
+    const uint64_t m_journalId;
+    const uint64_t m_mapIdentity;
+
+public:
+    explicit Writer(const uint32_t roomsCount,
+                    const uint32_t marksCount,
+                    const Coordinate &pos,
+                    const bool compress,
+                    const uint64_t journalId,
+                    const uint64_t mapIdentity)
+        : m_compress{compress}
+        , m_journalId{journalId}
+        , m_mapIdentity{mapIdentity}
+    {
+        append<uint32_t>(m_meta, roomsCount);
+        append<uint32_t>(m_meta, marksCount);
+        appendCoord(m_meta, pos);
+        m_marks.reserve(static_cast<int>(marksCount * MARK_RECORD_SIZE));
+        m_blocks.emplace_back();
+    }
+
+public:
+    void writeRoom(const Room &room)
+    {
+        if (m_compress && m_blocks.back().numRooms == ROOMS_PER_BLOCK)
+            m_blocks.emplace_back();
+        m_blocks.back().writeRoom(room);
+
+        const auto event = Room::getEvent(&room);
+        const ParseKeys keys = ParseTree::computeKeys(deref(event));
+        append<uint32_t>(m_parseKeys, keys.mask);
+        append<uint32_t>(m_parseKeys, 0);
+        append<uint64_t>(m_parseKeys, keys.primary);
+        for (const uint64_t key : keys.levels)
+            append<uint64_t>(m_parseKeys, key);
+        ++m_numParseKeys;
+    }
+
+    void writeMark(const InfoMark &mark)
+    {
+        mapped::writeMark(m_marks, m_compress ? m_markStrings : m_blocks.front().strings, mark);
+    }
+
+    /// Writes the section table and every section; returns the number of bytes written.
+    size_t finish(QDataStream &stream) const
+    {
+        std::vector<std::pair<SectionEnum, QByteArray>> sections;
+        sections.emplace_back(SectionEnum::META, m_meta);
+        if (!m_compress) {
+            const RoomBlock &block = m_blocks.front();
+            sections.emplace_back(SectionEnum::ROOMS, block.rooms);
+            sections.emplace_back(SectionEnum::EXITS, block.exits);
+            sections.emplace_back(SectionEnum::CONNECTIONS, block.connections);
+            sections.emplace_back(SectionEnum::MARKS, m_marks);
+            sections.emplace_back(SectionEnum::STRINGS, block.strings.getData());
+        } else {
+            // Blocks are independent, so they compress in parallel as well.
+            std::vector<QByteArray> compressed(m_blocks.size());
+            parallelFor(m_blocks.size(), 1, [this, &compressed](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                    compressed[i] = m_blocks[i].compress();
+            });
+
+            QByteArray index;
+            QByteArray blocks;
+            for (size_t i = 0; i < m_blocks.size(); ++i) {
+                append<uint64_t>(index, static_cast<uint64_t>(blocks.size()));
+                append<uint64_t>(index, static_cast<uint64_t>(compressed[i].size()));
+                append<uint32_t>(index, m_blocks[i].numRooms);
+                append<uint32_t>(index, static_cast<uint32_t>(BLOCK_CODEC));
+                blocks.append(compressed[i]);
+            }
+            sections.emplace_back(SectionEnum::MARKS, m_marks);
+            sections.emplace_back(SectionEnum::STRINGS, m_markStrings.getData());
+            sections.emplace_back(SectionEnum::BLOCK_INDEX, std::move(index));
+            sections.emplace_back(SectionEnum::BLOCKS, std::move(blocks));
+        }
+        {
+            const uint64_t hash = m_compress ? hashRoomSections({toSpan(sections.back().second)})
+                                             : hashRoomSections(
+                                                 {toSpan(m_blocks.front().rooms),
+                                                  toSpan(m_blocks.front().strings.getData())});
+            QByteArray keys;
+            keys.reserve(static_cast<int>(PARSE_KEYS_HEADER_SIZE) + m_parseKeys.size());
+            append<uint32_t>(keys, PARSE_KEYS_VERSION);
+            append<uint32_t>(keys, m_numParseKeys);
+            append<uint64_t>(keys, hash);
+            keys.append(m_parseKeys);
+            sections.emplace_back(SectionEnum::PARSE_KEYS, std::move(keys));
+        }
+        {
+            QByteArray journalId;
+            append<uint64_t>(journalId, m_journalId);
+            sections.emplace_back(SectionEnum::JOURNAL_ID, std::move(journalId));
+        }
+        {
+            QByteArray mapIdentity;
+            append<uint64_t>(mapIdentity, m_mapIdentity);
+            sections.emplace_back(SectionEnum::MAP_IDENTITY, std::move(mapIdentity));
+        }
+
+        const auto align = [](const size_t n) {
+            return (n + SECTION_ALIGNMENT - 1u) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        };
+
+        QByteArray table;
+        append<uint32_t>(table, static_cast<uint32_t>(sections.size()));
+        append<uint32_t>(table, 0);
+        size_t offset = FILE_HEADER_SIZE + SECTION_TABLE_HEADER_SIZE
+                        + sections.size() * SECTION_ENTRY_SIZE;
+        for (const auto &section : sections) {
+            offset = align(offset);
+            append<uint32_t>(table, static_cast<uint32_t>(section.first));
+            append<uint32_t>(table, 0);
+            append<uint64_t>(table, offset);
+            append<uint64_t>(table, static_cast<uint64_t>(section.second.size()));
+            offset += static_cast<size_t>(section.second.size());
+        }
+
+        size_t pos = FILE_HEADER_SIZE;
+        const auto write = [&stream, &pos](const QByteArray &data) {
+            stream.writeRawData(data.constData(), data.size());
+            pos += static_cast<size_t>(data.size());
+        };
+        write(table);
+        for (const auto &section : sections) {
+            write(QByteArray(static_cast<int>(align(pos) - pos), '\0'));
+            write(section.second);
+        }
+        return pos;
+    }
+};
+
+// The journal ("<map>.journal") records what changed since the map file was
+// last written in full, so a save only has to append the rooms that changed:
+//
+//   u32 JOURNAL_MAGIC, u32 JOURNAL_VERSION, u64 journalId (the map file's JOURNAL_ID)
+//   records: u32 payloadSize, u32 checksum (qChecksum of the payload), payload
+//
+// The header ties the journal to one version of the map file, since every full
+// save draws a new id; a journal that carries another id is never replayed, but
+// it's moved aside rather than overwritten. Each payload is:
+//
+//   u32 numRooms, u32 numRemoved, u32 numMarks, u32 flags (JOURNAL_HAS_MARKS)
+//   u64 roomsSize, exitsSize, connectionsSize, stringsSize
+//   ROOMS, EXITS, CONNECTIONS (as in a block), numRemoved u32 room ids, MARKS, STRINGS
+//
+// Records are replayed in order; a torn or corrupt record ends the journal.
+static constexpr const uint32_t JOURNAL_MAGIC = 0x4A4D4D31u; // "1MMJ"
+// Version 1 was tied to the map file's size and modification time.
+static constexpr const uint32_t JOURNAL_VERSION = 2;
+static constexpr const size_t JOURNAL_HEADER_SIZE = 16;
+static constexpr const size_t JOURNAL_RECORD_HEADER_SIZE = 8;
+static constexpr const size_t JOURNAL_PAYLOAD_HEADER_SIZE = 16 + 4 * 8;
+static constexpr const uint32_t JOURNAL_HAS_MARKS = 1u << 0;
+
+NODISCARD static uint64_t makeJournalId()
+{
+    std::uniform_int_distribution<uint64_t> dist;
+    return dist(RandomEngine::getSingleton());
+}
+
+NODISCARD static QByteArray makeJournalHeader(const uint64_t journalId)
+{
+    QByteArray header;
+    append<uint32_t>(header, JOURNAL_MAGIC);
+    append<uint32_t>(header, JOURNAL_VERSION);
+    append<uint64_t>(header, journalId);
+    return header;
+}
+
+/// The JOURNAL_ID of the current-schema map file that `device` reads from the start,
+/// if it has one; only the header, the section table and the id itself are read.
+NODISCARD static std::optional<uint64_t> readJournalId(QIODevice &device)
+{
+    static constexpr const qint64 HEAD_SIZE = FILE_HEADER_SIZE + SECTION_TABLE_HEADER_SIZE;
+    const QByteArray head = device.read(HEAD_SIZE);
+    if (head.size() != HEAD_SIZE || qFromBigEndian<quint32>(head.constData()) != FILE_MAGIC
+        || qFromBigEndian<qint32>(head.constData() + 4) != CURRENT_SCHEMA) {
+        return std::nullopt;
+    }
+    const auto numSections = qFromLittleEndian<uint32_t>(head.constData() + FILE_HEADER_SIZE);
+    const QByteArray table = device.read(static_cast<qint64>(numSections) * SECTION_ENTRY_SIZE);
+    const Span entries = toSpan(table);
+    for (size_t entry = 0; entry + SECTION_ENTRY_SIZE <= entries.size();
+         entry += SECTION_ENTRY_SIZE) {
+        if (entries.read<uint32_t>(entry) != static_cast<uint32_t>(SectionEnum::JOURNAL_ID))
+            continue;
+        if (entries.read<uint64_t>(entry + 16) < sizeof(uint64_t)
+            || !device.seek(static_cast<qint64>(entries.read<uint64_t>(entry + 8)))) {
+            return std::nullopt;
+        }
+        const QByteArray id = device.read(sizeof(uint64_t));
+        if (id.size() != static_cast<int>(sizeof(uint64_t)))
+            return std::nullopt;
+        return qFromLittleEndian<uint64_t>(id.constData());
+    }
+    return std::nullopt;
+}
+
+NODISCARD static QByteArray makeJournalRecord(const ConstRoomList &rooms,
+                                              const std::vector<RoomId> &removed,
+                                              const MarkerList *const marks)
+{
+    RoomBlock block;
+    for (const auto &room : rooms)
+        block.writeRoom(deref(room));
+    QByteArray marksData;
+    if (marks != nullptr) {
+        for (const auto &mark : *marks)
+            writeMark(marksData, block.strings, deref(mark));
+    }
+
+    QByteArray payload;
+    append<uint32_t>(payload, block.numRooms);
+    append<uint32_t>(payload, static_cast<uint32_t>(removed.size()));
+    append<uint32_t>(payload, (marks != nullptr) ? static_cast<uint32_t>(marks->size()) : 0u);
+    append<uint32_t>(payload, (marks != nullptr) ? JOURNAL_HAS_MARKS : 0u);
+    append<uint64_t>(payload, static_cast<uint64_t>(block.rooms.size()));
+    append<uint64_t>(payload, static_cast<uint64_t>(block.exits.size()));
+    append<uint64_t>(payload, static_cast<uint64_t>(block.connections.size()));
+    append<uint64_t>(payload, static_cast<uint64_t>(block.strings.getData().size()));
+    payload.append(block.rooms);
+    payload.append(block.exits);
+    payload.append(block.connections);
+    for (const RoomId id : removed)
+        append<uint32_t>(payload, static_cast<quint32>(id));
+    payload.append(marksData);
+    payload.append(block.strings.getData());
+
+    QByteArray record;
+    append<uint32_t>(record, static_cast<uint32_t>(payload.size()));
+    append<uint32_t>(record, qChecksum(payload.constData(), static_cast<uint>(payload.size())));
+    record.append(payload);
+    return record;
+}
+
+struct NODISCARD JournalRecord final
+{
+    RoomSections sections;
+    uint32_t numRooms = 0;
+    Span removed;
+    uint32_t numRemoved = 0;
+    bool hasMarks = false;
+    Span marks;
+    uint32_t numMarks = 0;
+};
+
+/// Parses the valid prefix of a journal written against the map file with `journalId`.
+/// Returns how many bytes of `data` that prefix covers (0 if it doesn't belong).
+NODISCARD static size_t parseJournal(const QByteArray &data,
+                                     const uint64_t journalId,
+                                     std::vector<JournalRecord> &records)
+{
+    const Span file{reinterpret_cast<const uchar *>(data.constData()),
+                    static_cast<size_t>(data.size())};
+    const QByteArray expected = makeJournalHeader(journalId);
+    if (file.size() < JOURNAL_HEADER_SIZE
+        || !std::equal(expected.begin(), expected.end(), data.begin())) {
+        return 0;
+    }
+
+    size_t pos = JOURNAL_HEADER_SIZE;
+    while (file.size() - pos >= JOURNAL_RECORD_HEADER_SIZE) {
+        const size_t size = file.read<uint32_t>(pos);
+        const auto checksum = file.read<uint32_t>(pos + 4);
+        if (size > file.size() - pos - JOURNAL_RECORD_HEADER_SIZE)
+            break;
+        const Span payload = file.slice(pos + JOURNAL_RECORD_HEADER_SIZE, size);
+        if (checksum != qChecksum(payload.bytes(0, size), static_cast<uint>(size)))
+            break;
+
+        try {
+            JournalRecord record;
+            record.numRooms = payload.read<uint32_t>(0);
+            record.numRemoved = payload.read<uint32_t>(4);
+            record.numMarks = payload.read<uint32_t>(8);
+            record.hasMarks = (payload.read<uint32_t>(12) & JOURNAL_HAS_MARKS) != 0;
+            uint64_t offset = JOURNAL_PAYLOAD_HEADER_SIZE;
+            const auto next = [&payload, &offset](const uint64_t len) {
+                const Span result = payload.slice(offset, len);
+                offset += len;
+                return result;
+            };
+            record.sections.rooms = next(payload.read<uint64_t>(16));
+            record.sections.exits = next(payload.read<uint64_t>(24));
+            record.sections.connections = next(payload.read<uint64_t>(32));
+            const auto stringsSize = payload.read<uint64_t>(40);
+            record.removed = next(uint64_t{record.numRemoved} * sizeof(uint32_t));
+            record.marks = next(uint64_t{record.numMarks} * MARK_RECORD_SIZE);
+            record.sections.strings = next(stringsSize);
+            if (record.sections.rooms.size() != record.numRooms * ROOM_RECORD_SIZE
+                || record.sections.exits.size() != record.numRooms * NUM_EXITS * EXIT_RECORD_SIZE)
+                break;
+            records.emplace_back(record);
+        } catch (const io::IOException &) {
+            break;
+        }
+        pos += JOURNAL_RECORD_HEADER_SIZE + size;
+    }
+    return pos;
+}
+} // namespace mapped
+
+static InfoMarkTypeEnum toInfoMarkType(const uint8_t value)
+{
+    if (value >= NUM_INFOMARK_TYPES) {
+        static std::once_flag flag;
+        std::call_once(flag, []() { qWarning() << "Detected out of bounds info mark type!"; });
+        return InfoMarkTypeEnum::TEXT;
+    }
+    return static_cast<InfoMarkTypeEnum>(value);
+}
+
+static InfoMarkClassEnum toInfoMarkClass(const uint8_t value)
+{
+    if (value >= NUM_INFOMARK_CLASSES) {
+        static std::once_flag flag;
+        std::call_once(flag, []() { qWarning() << "Detected out of bounds info mark class!"; });
+        return InfoMarkClassEnum::GENERIC;
+    }
+    return static_cast<InfoMarkClassEnum>(value);
+}
+
+static void sanitizeMarkText(InfoMark &mark)
+{
+    if (mark.getType() != InfoMarkTypeEnum::TEXT && !mark.getText().isEmpty())
+        mark.setText(InfoMarkText{});
+    // REVISIT: Just discard empty text markers?
+    else if (mark.getType() == InfoMarkTypeEnum::TEXT && mark.getText().isEmpty())
+        mark.setText(InfoMarkText{"New Marker"});
+}
+
 SharedRoom MapStorage::loadRoom(QDataStream &stream, const uint32_t version)
 {
     // TODO: change schema to just store size and latin1 bytes for strings.
@@ -346,7 +1270,14 @@ bool MapStorage::loadData()
 
 bool MapStorage::mergeData()
 {
+    MMAPPER_TRACE_SCOPE("MapStorage::mergeData");
     const auto critical = [this](const QString &msg) -> void {
+        // Maps are loaded on a worker thread, which can't show a dialog.
+        if (QThread::currentThread() != QCoreApplication::instance()->thread()) {
+            emit log("MapStorage", msg);
+            qWarning().noquote() << msg;
+            return;
+        }
         QMessageBox::critical(checked_dynamic_downcast<QWidget *>(parent()),
                               tr("MapStorage Error"),
                               msg);
@@ -397,6 +1328,7 @@ bool MapStorage::mergeData()
             case MMAPPER_2_4_3_SCHEMA:
             case MMAPPER_2_5_1_SCHEMA:
             case MMAPPER_19_10_0_SCHEMA:
+            case MMAPPER_20_05_0_SCHEMA:
                 return true;
             default:
                 break;
@@ -414,68 +1346,60 @@ bool MapStorage::mergeData()
             return false;
         }
 
-        // Force serialization to Qt4.8 because Qt5 has broke backwards compatability with QDateTime serialization
-        // http://doc.qt.io/qt-5/sourcebreaks.html#changes-to-qdate-qtime-and-qdatetime
-        // http://doc.qt.io/qt-5/qdatastream.html#versioning
-        stream.setVersion(QDataStream::Qt_4_8);
-
-        /* Caution! Stream requires buffer to have extended lifetime for new version,
-         * so don't be tempted to move this inside the scope. */
-        // Then shouldn't buffer be declared before stream, so it will outlive the stream?
-        QBuffer buffer;
-        const bool qCompressed = (version >= MMAPPER_2_4_3_SCHEMA);
-        const bool zlibCompressed = (version >= MMAPPER_2_0_4_SCHEMA
-                                     && version <= MMAPPER_2_4_0_SCHEMA);
-        if (qCompressed || (!NO_ZLIB && zlibCompressed)) {
-            QByteArray compressedData(stream.device()->readAll());
-            QByteArray uncompressedData = qCompressed ? qUncompress(compressedData)
-                                                      : StorageUtils::inflate(compressedData);
-            buffer.setData(uncompressedData);
-            buffer.open(QIODevice::ReadOnly);
-            stream.setDevice(&buffer);
-            emit_log(QString("Uncompressed map using %1").arg(qCompressed ? "qUncompress" : "zlib"));
-
-        } else if (NO_ZLIB && zlibCompressed) {
-            critical("MMapper could not load this map because it is too old.\r\n\r\n"
-                     "Please recompile MMapper with USE_ZLIB.");
-            return false;
+        if (version >= MMAPPER_20_05_0_SCHEMA) {
+            emit_log(QString("Schema version: %1").arg(version));
+            loadMappedData();
         } else {
-            emit_log("Map was not compressed");
-        }
-        emit_log(QString("Schema version: %1").arg(version));
-
-        const uint32_t roomsCount = helper.read_u32();
-        const uint32_t marksCount = helper.read_u32();
-        progressCounter.increaseTotalStepsBy(roomsCount + marksCount);
-
-        m_mapData.setPosition(transformRoomOnLoad(version, helper.readCoord3d() + basePosition));
-
-        emit_log(QString("Number of rooms: %1").arg(roomsCount));
-
-        for (uint32_t i = 0; i < roomsCount; ++i) {
-            SharedRoom room = loadRoom(stream, version);
-
-            progressCounter.step();
-            m_mapData.insertPredefinedRoom(room);
-        }
-
-        emit_log(QString("Number of info items: %1").arg(marksCount));
-
-        // TODO: reserve the markerList with marksCount
+            // Force serialization to Qt4.8 because Qt5 has broke backwards compatability with QDateTime serialization
+            // http://doc.qt.io/qt-5/sourcebreaks.html#changes-to-qdate-qtime-and-qdatetime
+            // http://doc.qt.io/qt-5/qdatastream.html#versioning
+            stream.setVersion(QDataStream::Qt_4_8);
+
+            /* Caution! Stream requires buffer to have extended lifetime for new version,
+             * so don't be tempted to move this inside the scope. */
+            // Then shouldn't buffer be declared before stream, so it will outlive the stream?
+            QBuffer buffer;
+            std::unique_ptr<InflateDevice> inflater;
+            const bool qCompressed = (version >= MMAPPER_2_4_3_SCHEMA);
+            const bool zlibCompressed = (version >= MMAPPER_2_0_4_SCHEMA
+                                         && version <= MMAPPER_2_4_0_SCHEMA);
+            if (!NO_ZLIB && (qCompressed || zlibCompressed)) {
+                // Rooms are parsed as the data is inflated, so neither the compressed
+                // nor the uncompressed map has to be held in memory as a whole.
+                const auto header = qCompressed ? InflateDevice::HeaderEnum::QCOMPRESS
+                                                : InflateDevice::HeaderEnum::NONE;
+                inflater = std::make_unique<InflateDevice>(*m_file, header);
+                if (!inflater->open(QIODevice::ReadOnly)) {
+                    throw io::IOException(inflater->errorString().toStdString());
+                }
+                stream.setDevice(inflater.get());
+                emit_log("Uncompressing map while loading it");
+
+            } else if (qCompressed) {
+                QByteArray uncompressedData = qUncompress(stream.device()->readAll());
+                buffer.setData(uncompressedData);
+                buffer.open(QIODevice::ReadOnly);
+                stream.setDevice(&buffer);
+                emit_log("Uncompressed map using qUncompress");
+
+            } else if (NO_ZLIB && zlibCompressed) {
+                critical("MMapper could not load this map because it is too old.\r\n\r\n"
+                         "Please recompile MMapper with USE_ZLIB.");
+                return false;
+            } else {
+                emit_log("Map was not compressed");
+            }
+            emit_log(QString("Schema version: %1").arg(version));
 
-        // create all pointers to items
-        for (uint32_t index = 0; index < marksCount; ++index) {
-            auto mark = InfoMark::alloc(m_mapData);
-            loadMark(mark.get(), stream, version);
-            m_mapData.addMarker(mark);
+            loadStreamData(stream, version);
 
-            progressCounter.step();
+            // REVISIT: Closing is probably not necessary, since you don't do it in the failure cases.
+            if (inflater != nullptr)
+                inflater->close();
+            buffer.close();
         }
 
         emit_log("Finished loading.");
-
-        // REVISIT: Closing is probably not necessary, since you don't do it in the failure cases.
-        buffer.close();
         m_file->close();
 
         // REVISIT: Having a save-file with 0 rooms probably shouldn't be treated as an error.
@@ -484,8 +1408,16 @@ bool MapStorage::mergeData()
             return false;
         }
 
-        m_mapData.setFileName(m_fileName, !QFileInfo(m_fileName).isWritable());
+        // A full save would remove the journal that couldn't be moved aside, so the
+        // map has to be saved somewhere else.
+        m_mapData.setFileName(m_fileName,
+                              !QFileInfo(m_fileName).isWritable() || m_keepsUnreplayedJournal);
+        // A file without an identity gives the map that of the rooms it was loaded with.
+        if (baseId == 0u)
+            std::ignore = m_mapData.getMapIdentity();
         m_mapData.unsetDataChanged();
+        // Only a map loaded on its own from the current schema can be journaled.
+        m_mapData.resetJournal(baseId == 0u && version >= MMAPPER_20_05_0_SCHEMA);
     }
 
     m_mapData.checkSize();
@@ -493,6 +1425,369 @@ bool MapStorage::mergeData()
     return true;
 }
 
+void MapStorage::loadStreamData(QDataStream &stream, const uint32_t version)
+{
+    MMAPPER_TRACE_SCOPE("MapStorage::loadStreamData");
+    auto helper = LoadRoomHelper{stream};
+    auto &progressCounter = getProgressCounter();
+
+    const uint32_t roomsCount = helper.read_u32();
+    const uint32_t marksCount = helper.read_u32();
+    progressCounter.increaseTotalStepsBy(roomsCount + marksCount);
+
+    m_mapData.setPosition(transformRoomOnLoad(version, helper.readCoord3d() + basePosition));
+
+    emit log("MapStorage", QString("Number of rooms: %1").arg(roomsCount));
+
+    for (uint32_t i = 0; i < roomsCount; ++i) {
+        SharedRoom room = loadRoom(stream, version);
+
+        progressCounter.step();
+        m_mapData.insertPredefinedRoom(room);
+    }
+
+    emit log("MapStorage", QString("Number of info items: %1").arg(marksCount));
+
+    // TODO: reserve the markerList with marksCount
+
+    // create all pointers to items
+    const MapData::DataChangedBatch batch{m_mapData};
+    for (uint32_t index = 0; index < marksCount; ++index) {
+        auto mark = InfoMark::alloc(m_mapData);
+        loadMark(mark.get(), stream, version);
+        m_mapData.addMarker(mark);
+
+        progressCounter.step();
+    }
+}
+
+void MapStorage::loadMappedData()
+{
+    // On demand, the room text is read from a mapping owned by the rooms themselves.
+    // Windows can't replace a file that is still mapped, so it would block saving.
+    std::shared_ptr<mapped::MappedRoomText> roomText;
+    if constexpr (CURRENT_PLATFORM != PlatformEnum::Windows) {
+        if (getConfig().general.loadRoomTextOnDemand)
+            roomText = mapped::mapRoomText(m_fileName);
+    }
+
+    const auto fileSize = static_cast<size_t>(m_file->size());
+    uchar *const mappedData = (roomText != nullptr) ? nullptr : m_file->map(0, m_file->size());
+    // Not every device can be mapped (e.g. some network filesystems); reading it is still
+    // cheaper than the old stream format, since nothing has to be decompressed.
+    QByteArray fallback;
+    if (mappedData == nullptr && roomText == nullptr) {
+        emit log("MapStorage", "Unable to map file; reading it instead");
+        m_file->seek(0);
+        fallback = m_file->readAll();
+    }
+    struct NODISCARD Unmapper final
+    {
+        QFile &file;
+        uchar *const data;
+        ~Unmapper()
+        {
+            if (data != nullptr)
+                file.unmap(data);
+        }
+    } unmapper{*m_file, mappedData};
+
+    const mapped::Span file = (roomText != nullptr) ? roomText->getFile()
+                              : (mappedData != nullptr)
+                                  ? mapped::Span{mappedData, fileSize}
+                                  : mapped::Span{reinterpret_cast<const uchar *>(
+                                                     fallback.constData()),
+                                                 static_cast<size_t>(fallback.size())};
+
+    std::array<mapped::Span, mapped::NUM_SECTIONS> sections;
+    const auto numSections = file.read<uint32_t>(mapped::FILE_HEADER_SIZE);
+    for (uint32_t i = 0; i < numSections; ++i) {
+        const size_t entry = mapped::FILE_HEADER_SIZE + mapped::SECTION_TABLE_HEADER_SIZE
+                             + static_cast<size_t>(i) * mapped::SECTION_ENTRY_SIZE;
+        const auto kind = file.read<uint32_t>(entry);
+        const auto section = file.slice(file.read<uint64_t>(entry + 8),
+                                        file.read<uint64_t>(entry + 16));
+        // Unknown sections are ignored.
+        if (kind >= 1u && kind <= mapped::NUM_SECTIONS)
+            sections[kind - 1u] = section;
+    }
+    const auto getSection = [&sections](const mapped::SectionEnum kind) -> const mapped::Span & {
+        return sections[static_cast<size_t>(kind) - 1u];
+    };
+    const mapped::Span &marks = getSection(mapped::SectionEnum::MARKS);
+    const mapped::Span &strings = getSection(mapped::SectionEnum::STRINGS);
+    const mapped::Span &blockIndex = getSection(mapped::SectionEnum::BLOCK_INDEX);
+    // Rooms merged into a map become part of it, so they don't bring their identity along.
+    if (const mapped::Span &identity = getSection(mapped::SectionEnum::MAP_IDENTITY);
+        baseId == 0u && identity.size() >= sizeof(uint64_t)) {
+        m_mapData.setMapIdentity(identity.read<uint64_t>(0));
+    }
+    const bool compressed = blockIndex.size() != 0;
+    if (compressed) {
+        // Blocks are decompressed into memory that doesn't outlive the load.
+        roomText.reset();
+    }
+
+    mapped::RecordReader meta{getSection(mapped::SectionEnum::META),
+                              strings,
+                              0,
+                              mapped::META_SIZE};
+    const uint32_t roomsCount = meta.read_u32();
+    const uint32_t marksCount = meta.read_u32();
+    if (marks.size() / mapped::MARK_RECORD_SIZE < marksCount) {
+        throw io::IOException("map sections are truncated");
+    }
+
+    auto &progressCounter = getProgressCounter();
+    progressCounter.increaseTotalStepsBy(roomsCount + marksCount);
+
+    m_mapData.setPosition(meta.readCoord3d() + basePosition);
+
+    emit log("MapStorage", QString("Number of rooms: %1").arg(roomsCount));
+
+    // Records are decoded on the thread pool; only creating and inserting the
+    // rooms has to happen here, in file order.
+    std::vector<mapped::DecodedRoom> decoded;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    const auto decodeSafely = [&errorMutex, &error](auto &&fn) {
+        // Exceptions must not escape a pool thread.
+        try {
+            fn();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock{errorMutex};
+            if (!error)
+                error = std::current_exception();
+        }
+    };
+
+    if (!compressed) {
+        const mapped::RoomSections roomSections{getSection(mapped::SectionEnum::ROOMS),
+                                                getSection(mapped::SectionEnum::EXITS),
+                                                getSection(mapped::SectionEnum::CONNECTIONS),
+                                                strings};
+        if (roomSections.rooms.size() / mapped::ROOM_RECORD_SIZE < roomsCount
+            || roomSections.exits.size() / (mapped::EXIT_RECORD_SIZE * NUM_EXITS) < roomsCount) {
+            throw io::IOException("map sections are truncated");
+        }
+        if (roomText != nullptr) {
+            emit log("MapStorage", "Leaving room descriptions and notes in the file");
+            roomText->setSections(roomSections.rooms, strings);
+        }
+        decoded.resize(roomsCount);
+        parallelFor(roomsCount, mapped::ROOMS_PER_BLOCK, [&](const size_t begin, const size_t end) {
+            decodeSafely([&]() {
+                mapped::decodeRooms(roomSections,
+                                    begin,
+                                    end,
+                                    baseId,
+                                    basePosition,
+                                    decoded.data() + begin,
+                                    roomText != nullptr);
+            });
+        });
+    } else {
+        emit log("MapStorage", "Uncompressing map blocks");
+        const mapped::Span &blocks = getSection(mapped::SectionEnum::BLOCKS);
+        const size_t numBlocks = blockIndex.size() / mapped::BLOCK_INDEX_ENTRY_SIZE;
+        std::vector<size_t> firstRoom(numBlocks + 1u, 0);
+        for (size_t b = 0; b < numBlocks; ++b) {
+            const auto n = blockIndex.read<uint32_t>(b * mapped::BLOCK_INDEX_ENTRY_SIZE + 16);
+            firstRoom[b + 1u] = firstRoom[b] + n;
+        }
+        if (firstRoom.back() != roomsCount) {
+            throw io::IOException("map block index does not match the room count");
+        }
+        decoded.resize(roomsCount);
+        parallelFor(numBlocks, 1, [&](const size_t begin, const size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                decodeSafely([&]() {
+                    const size_t entry = b * mapped::BLOCK_INDEX_ENTRY_SIZE;
+                    const auto codec = blockIndex.read<uint32_t>(entry + 20);
+                    const mapped::Span block = blocks.slice(blockIndex.read<uint64_t>(entry),
+                                                            blockIndex.read<uint64_t>(entry + 8));
+                    const QByteArray payload = mapped::uncompressBlock(
+                        codec,
+                        reinterpret_cast<const uchar *>(block.bytes(0, block.size())),
+                        block.size());
+                    const mapped::Span data{reinterpret_cast<const uchar *>(payload.constData()),
+                                            static_cast<size_t>(payload.size())};
+                    const size_t numRooms = firstRoom[b + 1u] - firstRoom[b];
+                    if (data.read<uint32_t>(0) != numRooms)
+                        throw io::IOException("map block is corrupt");
+                    uint64_t offset = mapped::BLOCK_HEADER_SIZE;
+                    const auto next = [&data, &offset](const size_t field) {
+                        const auto size = data.read<uint64_t>(8 + field * 8);
+                        const mapped::Span result = data.slice(offset, size);
+                        offset += size;
+                        return result;
+                    };
+                    mapped::RoomSections roomSections;
+                    roomSections.rooms = next(0);
+                    roomSections.exits = next(1);
+                    roomSections.connections = next(2);
+                    roomSections.strings = next(3);
+                    mapped::decodeRooms(roomSections,
+                                        0,
+                                        numRooms,
+                                        baseId,
+                                        basePosition,
+                                        decoded.data() + firstRoom[b]);
+                });
+            }
+        });
+    }
+    if (error)
+        std::rethrow_exception(error);
+
+    // Saved keys spare computing every room's keys from its text; when they were
+    // left out or don't match the rooms, the keys are computed as before.
+    if (const mapped::Span &keys = getSection(mapped::SectionEnum::PARSE_KEYS);
+        keys.size() >= mapped::PARSE_KEYS_HEADER_SIZE) {
+        const uint64_t hash = compressed
+                                  ? mapped::hashRoomSections(
+                                      {getSection(mapped::SectionEnum::BLOCKS)})
+                                  : mapped::hashRoomSections(
+                                      {getSection(mapped::SectionEnum::ROOMS), strings});
+        if (keys.read<uint32_t>(0) != mapped::PARSE_KEYS_VERSION
+            || keys.read<uint32_t>(4) != roomsCount || keys.read<uint64_t>(8) != hash
+            || (keys.size() - mapped::PARSE_KEYS_HEADER_SIZE) / mapped::PARSE_KEYS_RECORD_SIZE
+                   < roomsCount) {
+            emit log("MapStorage", "Ignoring saved room keys that don't match the rooms");
+        } else {
+            const mapped::Span records = keys.slice(mapped::PARSE_KEYS_HEADER_SIZE,
+                                                    keys.size() - mapped::PARSE_KEYS_HEADER_SIZE);
+            for (uint32_t i = 0; i < roomsCount; ++i) {
+                mapped::RecordReader r{records, strings, i, mapped::PARSE_KEYS_RECORD_SIZE};
+                ParseKeys &k = decoded[i].parseKeys.emplace();
+                k.mask = r.read_u32();
+                r.skip(4);
+                k.primary = r.read<uint64_t>();
+                for (uint64_t &key : k.levels)
+                    key = r.read<uint64_t>();
+            }
+        }
+    }
+
+    // Apply whatever was saved to the journal since the map was last written in full.
+    const mapped::Span *markRecords = &marks;
+    const mapped::Span *markStrings = &strings;
+    uint32_t numMarks = marksCount;
+    QByteArray journalData;
+    std::vector<mapped::JournalRecord> journal;
+    {
+        const QString journalName = getJournalFileName(m_fileName);
+        QFile journalFile(journalName);
+        if (journalFile.open(QIODevice::ReadOnly)) {
+            journalData = journalFile.readAll();
+            journalFile.close();
+        }
+        if (!journalData.isEmpty()) {
+            const mapped::Span &idSection = getSection(mapped::SectionEnum::JOURNAL_ID);
+            const size_t valid = (idSection.size() < sizeof(uint64_t))
+                                     ? 0u
+                                     : mapped::parseJournal(journalData,
+                                                            idSection.read<uint64_t>(0),
+                                                            journal);
+            if (valid == 0) {
+                if (!setJournalAside("A journal that belongs to a different map file"))
+                    m_keepsUnreplayedJournal = true;
+            } else if (valid < static_cast<size_t>(journalData.size())) {
+                // Most likely a save that was interrupted. New records have to follow the
+                // last good one, so the journal goes on from a copy of the valid part.
+                if (!setJournalAside("A journal with an incomplete end")
+                    || !writeNewJournal(journalData.left(static_cast<int>(valid)))) {
+                    m_keepsUnreplayedJournal = true;
+                }
+            }
+        }
+    }
+    if (!journal.empty()) {
+        emit log("MapStorage", QString("Replaying %1 journal record(s)").arg(journal.size()));
+        std::unordered_map<uint32_t, size_t> indexOf;
+        indexOf.reserve(decoded.size());
+        for (size_t i = 0; i < decoded.size(); ++i)
+            indexOf.emplace(decoded[i].id.asUint32(), i);
+
+        for (const mapped::JournalRecord &record : journal) {
+            std::vector<mapped::DecodedRoom> changed(record.numRooms);
+            mapped::decodeRooms(record.sections,
+                                0,
+                                record.numRooms,
+                                baseId,
+                                basePosition,
+                                changed.data());
+            for (mapped::DecodedRoom &d : changed) {
+                const auto it = indexOf.find(d.id.asUint32());
+                if (it != indexOf.end()) {
+                    decoded[it->second] = std::move(d);
+                } else {
+                    indexOf.emplace(d.id.asUint32(), decoded.size());
+                    decoded.emplace_back(std::move(d));
+                }
+            }
+            for (uint32_t k = 0; k < record.numRemoved; ++k) {
+                const auto id = record.removed.read<uint32_t>(k * sizeof(uint32_t)) + baseId;
+                const auto it = indexOf.find(id);
+                if (it != indexOf.end())
+                    decoded[it->second].id = INVALID_ROOMID;
+            }
+            if (record.hasMarks) {
+                markRecords = &record.marks;
+                markStrings = &record.sections.strings;
+                numMarks = record.numMarks;
+            }
+        }
+    }
+
+    for (mapped::DecodedRoom &d : decoded) {
+        if (d.id == INVALID_ROOMID)
+            continue; // removed by the journal
+        const SharedRoom room = Room::createPermanentRoom(m_mapData);
+        room->setId(d.id);
+#define SET_FIELD(_Type, _Prop, _OptInit) room->set##_Prop(std::move(d._Prop));
+        XFOREACH_ROOM_PROPERTY(SET_FIELD)
+#undef SET_FIELD
+        if (d.upToDate) {
+            room->setUpToDate();
+        }
+        room->setPosition(d.position);
+        room->setExitsList(d.exits);
+        if (d.coldTextPending) {
+            room->setColdTextSource(roomText, d.record);
+        }
+
+        progressCounter.step();
+        if (d.parseKeys) {
+            m_mapData.insertPredefinedRoom(room, *d.parseKeys);
+        } else {
+            m_mapData.insertPredefinedRoom(room);
+        }
+    }
+
+    emit log("MapStorage", QString("Number of info items: %1").arg(numMarks));
+
+    const Coordinate markOffset{basePosition.x * INFOMARK_SCALE,
+                                basePosition.y * INFOMARK_SCALE,
+                                basePosition.z};
+    const MapData::DataChangedBatch batch{m_mapData};
+    for (uint32_t i = 0; i < numMarks; ++i) {
+        mapped::RecordReader r{*markRecords, *markStrings, i, mapped::MARK_RECORD_SIZE};
+        auto mark = InfoMark::alloc(m_mapData);
+        mark->setText(InfoMarkText(r.read_string()));
+        mark->setType(toInfoMarkType(r.read_u8()));
+        mark->setClass(toInfoMarkClass(r.read_u8()));
+        r.skip(2);
+        mark->setRotationAngle(r.read_i32());
+        mark->setPosition1(r.readCoord3d() + markOffset);
+        mark->setPosition2(r.readCoord3d() + markOffset);
+        sanitizeMarkText(*mark);
+        m_mapData.addMarker(mark);
+
+        progressCounter.step();
+    }
+}
+
 void MapStorage::loadMark(InfoMark *mark, QDataStream &stream, uint32_t version)
 {
     auto helper = LoadRoomHelper{stream};
@@ -507,27 +1802,10 @@ void MapStorage::loadMark(InfoMark *mark, QDataStream &stream, uint32_t version)
         helper.read_datetime(); /* value ignored; called for side effect */
     }
 
-    const auto type = [](const uint8_t value) {
-        if (value >= NUM_INFOMARK_TYPES) {
-            static std::once_flag flag;
-            std::call_once(flag, []() { qWarning() << "Detected out of bounds info mark type!"; });
-            return InfoMarkTypeEnum::TEXT;
-        }
-        return static_cast<InfoMarkTypeEnum>(value);
-    }(helper.read_u8());
-    mark->setType(type);
+    mark->setType(toInfoMarkType(helper.read_u8()));
 
     if (version >= MMAPPER_2_3_7_SCHEMA) {
-        const auto clazz = [](const uint8_t value) {
-            if (value >= NUM_INFOMARK_CLASSES) {
-                static std::once_flag flag;
-                std::call_once(flag,
-                               []() { qWarning() << "Detected out of bounds info mark class!"; });
-                return InfoMarkClassEnum::GENERIC;
-            }
-            return static_cast<InfoMarkClassEnum>(value);
-        }(helper.read_u8());
-        mark->setClass(clazz);
+        mark->setClass(toInfoMarkClass(helper.read_u8()));
         if (version < MMAPPER_19_10_0_SCHEMA) {
             mark->setRotationAngle(helper.read_i32() / INFOMARK_SCALE);
         } else {
@@ -544,61 +1822,113 @@ void MapStorage::loadMark(InfoMark *mark, QDataStream &stream, uint32_t version)
     mark->setPosition2(read_coord(helper, basePosition));
 
     transformInfomarkOnLoad(version, *mark);
+    sanitizeMarkText(*mark);
+}
 
-    if (mark->getType() != InfoMarkTypeEnum::TEXT && !mark->getText().isEmpty())
-        mark->setText(InfoMarkText{});
-    // REVISIT: Just discard empty text markers?
-    else if (mark->getType() == InfoMarkTypeEnum::TEXT && mark->getText().isEmpty())
-        mark->setText(InfoMarkText{"New Marker"});
+static InfoMarkModificationTracker &getDetachedMarkTracker()
+{
+    // Copies only exist to be written out, so nothing needs to hear about them.
+    static InfoMarkModificationTracker tracker;
+    return tracker;
 }
 
-void MapStorage::saveRoom(const Room &room, QDataStream &stream)
+MapStorage::SaveSnapshot MapStorage::takeSaveSnapshot(MapData &mapData)
 {
-    stream << room.getName().toQString();
-    stream << room.getStaticDescription().toQString();
-    stream << room.getDynamicDescription().toQString();
-    stream << static_cast<quint32>(room.getId());
-    stream << room.getNote().toQString();
-    stream << static_cast<quint8>(room.getTerrainType());
-    stream << static_cast<quint8>(room.getLightType());
-    stream << static_cast<quint8>(room.getAlignType());
-    stream << static_cast<quint8>(room.getPortableType());
-    stream << static_cast<quint8>(room.getRidableType());
-    stream << static_cast<quint8>(room.getSundeathType());
-    stream << static_cast<quint32>(room.getMobFlags());
-    stream << static_cast<quint32>(room.getLoadFlags());
-    stream << static_cast<quint8>(room.isUpToDate());
-    writeCoordinate(stream, room.getPosition());
-    saveExits(room, stream);
+    SaveSnapshot result;
+    result.rooms = mapData.getSnapshot();
+    result.position = mapData.getPosition();
+    result.mapIdentity = mapData.getMapIdentity();
+    const MarkerList &markerList = mapData.getMarkersList();
+    result.marks.reserve(markerList.size());
+    for (const auto &mark : markerList) {
+        const InfoMark &from = deref(mark);
+        auto copy = InfoMark::alloc(getDetachedMarkTracker());
+#define COPY_FIELD(_Type, _Prop, _OptInit) copy->set##_Prop(from.get##_Prop());
+        XFOREACH_INFOMARK_PROPERTY(COPY_FIELD)
+#undef COPY_FIELD
+        result.marks.emplace_back(std::move(copy));
+    }
+    return result;
 }
 
-void MapStorage::saveExits(const Room &room, QDataStream &stream)
+size_t MapStorage::writeMapFile(const uint32_t roomsCount,
+                                const MarkerList &markerList,
+                                const Coordinate &position,
+                                const uint64_t mapIdentity,
+                                const std::function<void(const RoomCallback &)> &forEachRoom)
 {
-    const ExitsList &exitList = room.getExitsList();
-    for (const Exit &e : exitList) {
-        // REVISIT: need to be much more careful about how we serialize flags;
-        // places like this will be easy to overlook when the definition changes
-        // to increase the size beyond 16 bits.
-        stream << static_cast<uint16_t>(e.getExitFlags());
-        stream << static_cast<uint16_t>(e.getDoorFlags());
-        stream << e.getDoorName().toQString();
-        for (auto idx : e.inRange()) {
-            stream << static_cast<quint32>(idx);
-        }
-        stream << UINT_MAX;
-        for (auto idx : e.outRange()) {
-            stream << static_cast<quint32>(idx);
-        }
-        stream << UINT_MAX;
+    QDataStream fileStream(m_file);
+    fileStream.setVersion(QDataStream::Qt_4_8);
+
+    // Write a header with a "magic number" and a version
+    fileStream << static_cast<quint32>(mapped::FILE_MAGIC);
+    fileStream << static_cast<qint32>(CURRENT_SCHEMA);
+
+    const bool compress = getConfig().general.compressMapFiles;
+    mapped::Writer writer{roomsCount,
+                          static_cast<uint32_t>(markerList.size()),
+                          position,
+                          compress,
+                          mapped::makeJournalId(),
+                          mapIdentity};
+
+    // save rooms
+    forEachRoom([&writer](const Room &room) { writer.writeRoom(room); });
+
+    // save items
+    auto &progressCounter = getProgressCounter();
+    for (auto &mark : markerList) {
+        writer.writeMark(deref(mark));
+        progressCounter.step();
     }
+
+    return writer.finish(fileStream);
 }
 
-bool MapStorage::saveData(bool baseMapOnly)
+bool MapStorage::saveSnapshot(const SaveSnapshot &snapshot)
 {
+    MMAPPER_TRACE_SCOPE("MapStorage::saveSnapshot");
     emit log("MapStorage", "Writing data to file ...");
 
-    QDataStream fileStream(m_file);
-    fileStream.setVersion(QDataStream::Qt_4_8);
+    const MapSnapshot &rooms = deref(snapshot.rooms);
+    uint32_t roomsCount = 0;
+    rooms.forEach([&roomsCount](const Room &room) {
+        if (!room.isTemporary())
+            ++roomsCount;
+    });
+
+    auto &progressCounter = getProgressCounter();
+    progressCounter.reset();
+    progressCounter.increaseTotalStepsBy(roomsCount + snapshot.marks.size());
+
+    const size_t bytes = writeMapFile(roomsCount,
+                                      snapshot.marks,
+                                      snapshot.position,
+                                      snapshot.mapIdentity,
+                                      [&rooms, &progressCounter](const RoomCallback &callback) {
+                                          rooms.forEach([&](const Room &room) {
+                                              if (room.isTemporary())
+                                                  return;
+                                              callback(room);
+                                              progressCounter.step();
+                                          });
+                                      });
+    emit log("MapStorage", QString("Wrote %1 bytes").arg(bytes));
+    emit log("MapStorage", "Writing data finished.");
+    return true;
+}
+
+bool MapStorage::saveData(bool baseMapOnly)
+{
+    if (!baseMapOnly) {
+        if (!saveSnapshot(takeSaveSnapshot(m_mapData)))
+            return false;
+        m_mapData.unsetDataChanged();
+        emit onDataSaved();
+        return true;
+    }
+
+    emit log("MapStorage", "Writing data to file ...");
 
     // Collect the room and marker lists. The room list can't be acquired
     // directly apparently and we have to go through a RoomSaver which receives
@@ -608,9 +1938,7 @@ bool MapStorage::saveData(bool baseMapOnly)
 
     const MarkerList &markerList = m_mapData.getMarkersList();
     RoomSaver saver(m_mapData, roomList);
-    for (uint i = 0; i < m_mapData.getRoomsCount(); ++i) {
-        m_mapData.lookingForRooms(saver, RoomId{i});
-    }
+    m_mapData.lookingForAllRooms(saver);
 
     auto roomsCount = saver.getRoomsCount();
     const auto marksCount = static_cast<uint32_t>(markerList.size());
@@ -620,77 +1948,168 @@ bool MapStorage::saveData(bool baseMapOnly)
     progressCounter.increaseTotalStepsBy(roomsCount + marksCount);
 
     BaseMapSaveFilter filter;
-    if (baseMapOnly) {
-        filter.setMapData(&m_mapData);
-        progressCounter.increaseTotalStepsBy(filter.prepareCount());
-        filter.prepare(progressCounter);
-        roomsCount = filter.acceptedRoomsCount();
-    }
-
-    // Compression step
-    progressCounter.increaseTotalStepsBy(1);
-
-    // Write a header with a "magic number" and a version
-    fileStream << static_cast<quint32>(0xFFB2AF01);
-    fileStream << static_cast<qint32>(CURRENT_SCHEMA);
+    filter.setMapData(&m_mapData);
+    progressCounter.increaseTotalStepsBy(filter.prepareCount());
+    filter.prepare(progressCounter);
+    roomsCount = filter.acceptedRoomsCount();
+
+    const size_t bytes = writeMapFile(static_cast<uint32_t>(roomsCount),
+                                      markerList,
+                                      m_mapData.getPosition(),
+                                      m_mapData.getMapIdentity(),
+                                      [&](const RoomCallback &callback) {
+                                          for (const SharedConstRoom &pRoom : roomList) {
+                                              filter.visitRoom(deref(pRoom), true, callback);
+                                              progressCounter.step();
+                                          }
+                                      });
+    emit log("MapStorage", QString("Wrote %1 bytes").arg(bytes));
+    emit log("MapStorage", "Writing data finished.");
 
-    // Serialize the data
-    QBuffer buffer;
-    buffer.open(QIODevice::WriteOnly);
-    QDataStream stream(&buffer);
-    stream.setVersion(QDataStream::Qt_4_8);
+    m_mapData.unsetDataChanged();
+    emit onDataSaved();
 
-    // write counters
-    stream << static_cast<quint32>(roomsCount);
-    stream << static_cast<quint32>(marksCount);
+    return true;
+}
 
-    // write selected room x,y,z
-    writeCoordinate(stream, m_mapData.getPosition());
+QString MapStorage::getJournalFileName(const QString &mapFileName)
+{
+    return mapFileName + ".journal";
+}
 
-    // save rooms
-    auto saveOne = [this, &stream](const Room &room) { saveRoom(room, stream); };
-    for (const std::shared_ptr<const Room> &pRoom : roomList) {
-        filter.visitRoom(deref(pRoom), baseMapOnly, saveOne);
-        progressCounter.step();
+bool MapStorage::setJournalAside(const QString &what)
+{
+    const QString journalName = getJournalFileName(m_fileName);
+    const QString stem = QString("%1.%2").arg(journalName).arg(
+        QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss"));
+    QString asideName = stem + ".unreplayed";
+    for (int i = 2; QFileInfo::exists(asideName); ++i)
+        asideName = QString("%1-%2.unreplayed").arg(stem).arg(i);
+
+    if (!QFile::rename(journalName, asideName)) {
+        qWarning() << what << "could not be moved out of the way, so" << journalName
+                   << "is left alone and the map can only be saved under another name.";
+        emit log("MapStorage",
+                 QString("%1 could not be moved aside; save the map under another name")
+                     .arg(what));
+        return false;
     }
+    qWarning() << what << "was not replayed; it was kept as" << asideName;
+    emit log("MapStorage", QString("%1 was not replayed; it was kept as %2").arg(what, asideName));
+    return true;
+}
 
-    // save items
-    for (auto &mark : markerList) {
-        saveMark(mark.get(), stream);
-        progressCounter.step();
+bool MapStorage::writeNewJournal(const QByteArray &data)
+{
+    QFile journal(getJournalFileName(m_fileName));
+    if (!journal.open(QIODevice::WriteOnly | QIODevice::NewOnly)
+        || journal.write(data) != data.size() || !journal.flush()) {
+        emit log("MapStorage", QString("Unable to write journal: %1").arg(journal.errorString()));
+        return false;
+    }
+    try {
+        ::io::fsync(journal);
+    } catch (const io::IOException &ex) {
+        emit log("MapStorage", QString("Unable to sync journal: %1").arg(ex.what()));
+        return false;
     }
+    return true;
+}
 
-    buffer.close();
+void MapStorage::discardJournal(MapData &mapData, const QString &mapFileName)
+{
+    QFile::remove(getJournalFileName(mapFileName));
+    mapData.resetJournal(true);
+}
 
-    QByteArray uncompressedData(buffer.data());
-    QByteArray compressedData = qCompress(uncompressedData);
-    progressCounter.step();
-    double compressionRatio = (compressedData.isEmpty())
-                                  ? 1.0
-                                  : (static_cast<double>(uncompressedData.size())
-                                     / static_cast<double>(compressedData.size()));
-    emit log("MapStorage",
-             QString("Map compressed (compression ratio of %1:1)")
-                 .arg(QString::number(compressionRatio, 'f', 1)));
+bool MapStorage::saveJournal()
+{
+    const std::optional<MapData::JournalChanges> changes = m_mapData.takeJournalChanges();
+    if (!changes) {
+        return false;
+    }
+    // If the changes don't make it to the journal, hand them back so the caller's
+    // full save (and any later journal) still knows about them.
+    if (!writeJournal(*changes)) {
+        m_mapData.restoreJournalChanges(*changes);
+        return false;
+    }
 
-    fileStream.writeRawData(compressedData.data(), compressedData.size());
     emit log("MapStorage", "Writing data finished.");
-
     m_mapData.unsetDataChanged();
     emit onDataSaved();
-
     return true;
 }
 
-void MapStorage::saveMark(InfoMark *mark, QDataStream &stream)
+bool MapStorage::writeJournal(const MapData::JournalChanges &changes)
 {
-    // REVISIT: save type first, and then avoid saving fields that aren't necessary?
-    const InfoMarkTypeEnum type = mark->getType();
-    stream << QString((type == InfoMarkTypeEnum::TEXT) ? mark->getText().toQString() : "");
-    stream << static_cast<quint8>(type);
-    stream << static_cast<quint8>(mark->getClass());
-    // REVISIT: round to 45 degrees?
-    stream << static_cast<qint32>(std::lround(mark->getRotationAngle()));
-    writeCoordinate(stream, mark->getPosition1());
-    writeCoordinate(stream, mark->getPosition2());
+    const QFileInfo base(m_fileName);
+    const QString journalName = getJournalFileName(m_fileName);
+    const std::optional<uint64_t> journalId = [this]() -> std::optional<uint64_t> {
+        QFile baseFile(m_fileName);
+        if (!baseFile.open(QIODevice::ReadOnly))
+            return std::nullopt;
+        return mapped::readJournalId(baseFile);
+    }();
+    if (!journalId) {
+        // Written before journals were tied to an id (or not there at all).
+        return false;
+    }
+    if (QFileInfo(journalName).size() > std::max(MIN_JOURNAL_COMPACT_SIZE, base.size() / 4)) {
+        emit log("MapStorage", "Journal is large; saving the whole map instead");
+        return false;
+    }
+
+    emit log("MapStorage",
+             QString("Writing %1 changed room(s) to the journal ...").arg(changes.rooms.size()));
+
+    ConstRoomList rooms;
+    rooms.reserve(changes.rooms.size());
+    std::vector<RoomId> removed;
+    RoomSaver saver(m_mapData, rooms);
+    for (const RoomId id : changes.rooms) {
+        const auto before = rooms.size();
+        m_mapData.lookingForRooms(saver, id);
+        if (rooms.size() == before)
+            removed.emplace_back(id);
+    }
+
+    const MarkerList *const marks = changes.marks ? &m_mapData.getMarkersList() : nullptr;
+    const QByteArray record = mapped::makeJournalRecord(rooms, removed, marks);
+
+    const QByteArray header = mapped::makeJournalHeader(*journalId);
+    {
+        QFile existing(journalName);
+        if (existing.open(QIODevice::ReadOnly) && existing.size() != 0
+            && existing.read(header.size()) != header) {
+            existing.close();
+            // Left behind by another version of the map file (e.g. one written elsewhere);
+            // its edits were never replayed, so they're kept rather than overwritten.
+            if (!setJournalAside("A journal that belongs to a different map file")) {
+                // Neither kind of save may replace it now.
+                m_mapData.setFileName(m_fileName, true);
+                return false;
+            }
+        }
+    }
+
+    QFile journal(journalName);
+    if (!journal.open(QIODevice::ReadWrite)) {
+        emit log("MapStorage", QString("Unable to open journal: %1").arg(journal.errorString()));
+        return false;
+    }
+    if (journal.size() == 0 && journal.write(header) != header.size()) {
+        return false;
+    }
+    if (!journal.seek(journal.size()) || journal.write(record) != record.size()
+        || !journal.flush()) {
+        return false;
+    }
+    try {
+        ::io::fsync(journal);
+    } catch (const io::IOException &ex) {
+        emit log("MapStorage", QString("Unable to sync journal: %1").arg(ex.what()));
+        return false;
+    }
+    return true;
 }
@@ -6,6 +6,7 @@
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
 #include <cstdint>
+#include <functional>
 #include <QArgument>
 #include <QObject>
 #include <QString>
@@ -13,6 +14,7 @@
 
 #include "../expandoracommon/coordinate.h"
 #include "../global/RuleOf5.h"
+#include "../global/macros.h"
 #include "../mapdata/mapdata.h"
 #include "../mapfrontend/mapfrontend.h"
 #include "abstractmapstorage.h"
@@ -32,6 +34,34 @@ class MapStorage final : public AbstractMapStorage
     explicit MapStorage(MapData &, const QString &, QObject *parent = nullptr);
     bool mergeData() override;
 
+public:
+    NODISCARD static QString getJournalFileName(const QString &mapFileName);
+    // Appends the rooms and marks that changed since the last save to the map's
+    // journal, instead of rewriting the whole map. Returns false if the map has
+    // to be saved in full instead (e.g. it wasn't loaded from a current-schema
+    // file, or the journal has grown large enough to be compacted).
+    NODISCARD bool saveJournal();
+    // Call once a full save to mapFileName has been committed to disk.
+    static void discardJournal(MapData &mapData, const QString &mapFileName);
+
+public:
+    // Everything a full save writes, frozen so that it can be written out while
+    // the map keeps changing.
+    struct NODISCARD SaveSnapshot final
+    {
+        SharedMapSnapshot rooms;
+        // Detached copies; changes to the live marks don't reach them.
+        MarkerList marks;
+        Coordinate position;
+        uint64_t mapIdentity = 0;
+    };
+    // Must be called on the thread that owns mapData.
+    NODISCARD static SaveSnapshot takeSaveSnapshot(MapData &mapData);
+    // Writes a full save of the snapshot. Unlike saveData(), this never touches
+    // the live map, so it's safe to call from a worker thread; it's up to the
+    // caller to mark the map as saved afterwards.
+    NODISCARD bool saveSnapshot(const SaveSnapshot &snapshot);
+
 public:
     virtual bool canLoad() const override { return true; }
     virtual bool canSave() const override { return true; }
@@ -41,15 +71,32 @@ class MapStorage final : public AbstractMapStorage
     virtual bool loadData() override;
     virtual bool saveData(bool baseMapOnly) override;
 
+    // Schemas up to MMAPPER_19_10_0_SCHEMA: one (usually compressed) QDataStream.
+    void loadStreamData(QDataStream &stream, uint32_t version);
     SharedRoom loadRoom(QDataStream &stream, uint32_t version);
     void loadExits(Room &room, QDataStream &stream, uint32_t version);
     void loadMark(InfoMark *mark, QDataStream &stream, uint32_t version);
-    void saveMark(InfoMark *mark, QDataStream &stream);
-    void saveRoom(const Room &room, QDataStream &stream);
-    void saveExits(const Room &room, QDataStream &stream);
+    // Current schema: fixed-width records decoded straight from the mapped file.
+    void loadMappedData();
+    NODISCARD bool writeJournal(const MapData::JournalChanges &changes);
+    // Renames the journal so nothing overwrites the edits it holds, and warns about
+    // it; `what` describes the journal. Returns false if it couldn't be moved.
+    NODISCARD bool setJournalAside(const QString &what);
+    // Creates the journal (which must not exist) with the given contents.
+    NODISCARD bool writeNewJournal(const QByteArray &data);
+    using RoomCallback = std::function<void(const Room &)>;
+    // Writes the header and every section; forEachRoom must pass each room to save
+    // to its callback. Returns the number of bytes written.
+    size_t writeMapFile(uint32_t roomsCount,
+                        const MarkerList &markerList,
+                        const Coordinate &position,
+                        uint64_t mapIdentity,
+                        const std::function<void(const RoomCallback &)> &forEachRoom);
 
     uint32_t baseId = 0u;
     Coordinate basePosition;
+    // Set when a journal that wasn't replayed couldn't be moved aside.
+    bool m_keepsUnreplayedJournal = false;
 };
 
 class MapFrontendBlocker final
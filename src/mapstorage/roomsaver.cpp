@@ -24,6 +24,13 @@ void RoomSaver::receiveRoom(RoomAdmin *admin, const Room *room)
     }
 }
 
+void RoomSaver::receiveRooms(RoomAdmin *const admin, const std::vector<const Room *> &rooms)
+{
+    m_roomList.reserve(m_roomList.size() + rooms.size());
+    for (const Room *const room : rooms)
+        receiveRoom(admin, room);
+}
+
 quint32 RoomSaver::getRoomsCount()
 {
     return static_cast<quint32>(m_roomList.size());
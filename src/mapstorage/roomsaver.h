@@ -4,6 +4,7 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
+#include <vector>
 #include <QtGlobal>
 
 #include "../expandoracommon/RoomRecipient.h"
@@ -19,6 +20,7 @@ class RoomSaver final : public RoomRecipient
     explicit RoomSaver(RoomAdmin &admin, ConstRoomList &list);
     ~RoomSaver() override;
     void receiveRoom(RoomAdmin *admin, const Room *room) override;
+    void receiveRooms(RoomAdmin *admin, const std::vector<const Room *> &rooms) override;
     quint32 getRoomsCount();
 
 public:
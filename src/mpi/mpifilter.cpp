@@ -57,7 +57,7 @@ void MpiFilter::analyzeNewMudInput(const TelnetData &data)
                 m_buffer.clear();
                 m_command = data.line.at(4);
                 m_remaining = data.line.mid(5).simplified().toInt();
-                if (getConfig().mumeClientProtocol.remoteEditing
+                if (getConfig().mumeClientProtocol.usesRemoteEditing()
                     && (m_command == 'V' || m_command == 'E')) {
                     m_receivingMpi = true;
                 }
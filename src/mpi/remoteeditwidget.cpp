@@ -57,6 +57,37 @@ static int measureTabAndAnsiAware(const QString &s)
     return col;
 }
 
+// What the status bar reports about each line. The highlighter stores them as the block's
+// user state, so they're only recomputed for the blocks that change.
+static constexpr const int LINE_HAS_TABS = 1 << 0;
+static constexpr const int LINE_HAS_TRAILING_SPACE = 1 << 1;
+static constexpr const int LINE_IS_LONG = 1 << 2;
+static constexpr const int ALL_LINE_METRICS = LINE_HAS_TABS | LINE_HAS_TRAILING_SPACE
+                                              | LINE_IS_LONG;
+static constexpr const int LONG_LINE_LENGTH = 80;
+
+static int computeLineMetrics(const QString &line, const int width)
+{
+    int metrics = 0;
+    if (line.indexOf(C_TAB) >= 0)
+        metrics |= LINE_HAS_TABS;
+    if (findTrailingWhitespace(line) >= 0)
+        metrics |= LINE_HAS_TRAILING_SPACE;
+    if (width > LONG_LINE_LENGTH)
+        metrics |= LINE_IS_LONG;
+    return metrics;
+}
+
+static int getLineMetrics(const QTextBlock &block)
+{
+    const int state = block.userState();
+    if (state >= 0)
+        return state;
+    // not highlighted yet
+    const QString line = block.text();
+    return computeLineMetrics(line, measureTabAndAnsiAware(line));
+}
+
 class QWidget;
 
 /// Groups everything in the scope as a single undo action.
@@ -82,8 +113,11 @@ class LineHighlighter final : public QSyntaxHighlighter
 
     void highlightBlock(const QString &line) override
     {
+        const int width = measureTabAndAnsiAware(line);
+        setCurrentBlockState(computeLineMetrics(line, width));
+
         highlightTabs(line);
-        highlightOverflow(line);
+        highlightOverflow(line, width);
         highlightTrailingSpace(line);
         highlightAnsi(line);
         highlightEntities(line);
@@ -112,9 +146,9 @@ class LineHighlighter final : public QSyntaxHighlighter
         foreachChar(line, '\t', [this, &fmt](const int at) { setFormat(at, 1, fmt); });
     }
 
-    void highlightOverflow(const QString &line)
+    void highlightOverflow(const QString &line, const int width)
     {
-        const int breakPos = (measureTabAndAnsiAware(line) <= maxLength) ? -1 : maxLength;
+        const int breakPos = (width <= maxLength) ? -1 : maxLength;
         if (breakPos < 0) {
             return;
         }
@@ -449,23 +483,6 @@ static void foreach_partly_selected_block_until(QTextCursor cur, Callback &&call
     }
 }
 
-template<typename Callback>
-bool exists_partly_selected_block(QTextCursor cur, Callback &&callback)
-{
-    static_assert(std::is_same_v<bool, decltype(callback(std::declval<const QTextCursor &>()))>);
-
-    bool result = false;
-    foreach_partly_selected_block_until(cur,
-                                        [&result, &callback](QTextCursor it) -> CallbackResultEnum {
-                                            if (callback(it)) {
-                                                result = true;
-                                                return CallbackResultEnum::STOP;
-                                            }
-                                            return CallbackResultEnum::KEEP_GOING;
-                                        });
-    return result;
-}
-
 static void insertPrefix(QTextCursor line, const QString &prefix)
 {
     line.movePosition(QTextCursor::StartOfBlock, QTextCursor::MoveAnchor);
@@ -986,29 +1003,15 @@ static CursorAnsiInfo getCursorAnsi(QTextCursor cursor)
     return result;
 }
 
-static bool linesHaveTabs(const QTextCursor &cur)
-{
-    return exists_partly_selected_block(cur, [](const QTextCursor &it) -> bool {
-        return lineHasTabs(it);
-    });
-}
-
-static bool linesHaveTrailingSpace(const QTextCursor &cur)
+static int getPartlySelectedLineMetrics(const QTextCursor &cur)
 {
-    return exists_partly_selected_block(cur, [](const QTextCursor &it) -> bool {
-        const auto &block = it.block();
-        const auto &line = block.text();
-        return findTrailingWhitespace(line) >= 0;
-    });
-}
-
-static bool hasLongLines(const QTextCursor &cur)
-{
-    return exists_partly_selected_block(cur, [](const QTextCursor &line) -> bool {
-        const auto &block = line.block();
-        const auto &s = block.text();
-        return measureTabAndAnsiAware(s) > 80;
+    int result = 0;
+    foreach_partly_selected_block_until(cur, [&result](const QTextCursor &it) {
+        result |= getLineMetrics(it.block());
+        return (result == ALL_LINE_METRICS) ? CallbackResultEnum::STOP
+                                            : CallbackResultEnum::KEEP_GOING;
     });
+    return result;
 }
 
 void RemoteEditWidget::updateStatusBar()
@@ -1055,13 +1058,14 @@ void RemoteEditWidget::updateStatusBar()
             status.append(std::forward<decltype(x)>(x));
         };
 
-        if (linesHaveTabs(cur))
+        const int metrics = getPartlySelectedLineMetrics(cur);
+        if ((metrics & LINE_HAS_TABS) != 0)
             err("Tabs");
 
-        if (linesHaveTrailingSpace(cur))
+        if ((metrics & LINE_HAS_TRAILING_SPACE) != 0)
             err("Trailing-Spaces");
 
-        if (hasLongLines(cur))
+        if ((metrics & LINE_IS_LONG) != 0)
             err("Long-lines");
 
         if (first)
@@ -3,13 +3,16 @@
 
 #include "Font.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cmath>
 #include <cstdlib>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <memory>
 #include <optional>
+#include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -45,12 +48,28 @@ struct Rect final
     glm::ivec2 size() const { return {width(), height()}; }
 };
 
-static bool intersects(const Rect &a, const Rect &b)
+// The text is this many pixels tall at a device pixel ratio of 1; the vertices are
+// scaled from the atlas font's size, so one atlas serves every DPI.
+static constexpr const int FONT_SIZE = 18;
+
+// The atlas holds the distance of each texel from the outline of its glyph, from
+// -SDF_SPREAD (outside) to SDF_SPREAD (inside) texels mapped to [0, 1], which keeps
+// the edges sharp at any scale; see the font shader.
+static constexpr const int SDF_SPREAD = 4;
+static constexpr const int SDF_ATLAS_WIDTH = 512;
+static constexpr const int SDF_SOLID_SIZE = 8;
+// Bump this whenever the layout or the encoding changes, so old cached atlases are ignored.
+static constexpr const int SDF_VERSION = 1;
+
+// Where a glyph of the bitmap atlas goes in the distance field atlas;
+// both positions use the upper left origin.
+struct NODISCARD SdfCell final
 {
-#define OVERLAPS(_xy) ((a.lo._xy) < (b.hi._xy) && (b.lo._xy) < (a.hi._xy))
-    return OVERLAPS(x) && OVERLAPS(y);
-#undef OVERLAPS
-}
+    glm::ivec2 src{0};
+    glm::ivec2 dst{0};
+    // of the glyph, without the padding
+    glm::ivec2 size{0};
+};
 
 using IntPair = std::pair<int, int>;
 
@@ -65,6 +84,57 @@ struct std::hash<IntPair>
     }
 };
 
+// Everything about a GLText except for its position.
+struct NODISCARD GlyphRunKey final
+{
+    std::string text;
+    Color color;
+    std::optional<Color> bgcolor;
+    FontFormatFlags fontFormatFlag;
+    int rotationAngle = 0;
+
+    explicit GlyphRunKey(const GLText &glt)
+        : text{glt.text}
+        , color{glt.color}
+        , bgcolor{glt.bgcolor}
+        , fontFormatFlag{glt.fontFormatFlag}
+        , rotationAngle{glt.rotationAngle}
+    {}
+
+    bool operator==(const GlyphRunKey &rhs) const
+    {
+        return text == rhs.text && color == rhs.color && bgcolor == rhs.bgcolor
+               && fontFormatFlag == rhs.fontFormatFlag && rotationAngle == rhs.rotationAngle;
+    }
+};
+
+template<>
+struct std::hash<GlyphRunKey>
+{
+    std::size_t operator()(const GlyphRunKey &key) const noexcept
+    {
+        const uint64_t bg = key.bgcolor ? (uint64_t{1} << 32 | key.bgcolor->getUint32()) : 0u;
+        const uint64_t flags = static_cast<uint64_t>(key.fontFormatFlag.asUint32()) << 32
+                               | static_cast<uint32_t>(key.rotationAngle);
+        size_t h = std::hash<std::string>()(key.text);
+        h = h * 31u + numeric_hash(key.color.getUint32());
+        h = h * 31u + numeric_hash(bg);
+        h = h * 31u + numeric_hash(flags);
+        return h;
+    }
+};
+
+// Room and door names repeat a lot, and the batches are rebuilt often,
+// so laying out the same string again only copies its quads.
+struct NODISCARD GlyphRunCache final
+{
+    // Strings like the frame timings change every frame, so this just starts
+    // over instead of growing without bound.
+    static constexpr const size_t MAX_RUNS = 8192;
+
+    std::unordered_map<GlyphRunKey, std::vector<FontVert3d>> runs;
+};
+
 struct FontMetrics
 {
     static constexpr int UNDERLINE_ID = -257;
@@ -179,6 +249,8 @@ struct FontMetrics
     std::optional<Glyph> underline;
 
     Common common;
+    // upper left corner of the solid cell of the distance field atlas
+    glm::ivec2 solidCell{0};
 
     // REVISIT: Since we only support latin-1, it might make sense to just have fixed
     // size lookup tables such as array<const Glyph*, 256> and array<uint16_t, 65536>
@@ -204,77 +276,63 @@ struct FontMetrics
     const Glyph *getBackground() const { return background ? &background.value() : nullptr; }
     const Glyph *getUnderline() const { return underline ? &underline.value() : nullptr; }
 
-    bool tryAddBackgroundGlyph(QImage &img)
+    // Moves every glyph into its own cell of the distance field atlas, with SDF_SPREAD
+    // texels of room around it, and adds a solid cell for the background and underline.
+    std::vector<SdfCell> layoutSdfAtlas()
     {
-        const int w = common.scaleW;
-        const int h = common.scaleH;
-
-        // must not overlap underline
-        const Rect ourGlyph{{w - 4, 0}, {w, 4}};
-
-        for (const Glyph &glyph : raw_glyphs) {
-            if (intersects(glyph.getRect(), ourGlyph)) {
-                qWarning() << "Glyph" << glyph.id << "overlaps expected background location";
-                return false;
-            }
-        }
-
-        if (VERBOSE_FONT_DEBUG) {
-            qDebug() << "Adding background glyph";
-        }
-        // glyph location uses lower left origin
-        background.emplace(BACKGROUND_ID, common.scaleW - 3, 1, 2, 2);
-
-        // note: the current image still uses UPPER left origin,
-        // but it will be flipped after this function.
-        for (int dy = -4; dy < 0; ++dy) {
-            for (int dx = -4; dx < 0; ++dx) {
-                img.setPixelColor(w + dx, h + dy, Qt::white);
+        std::vector<SdfCell> cells;
+        cells.reserve(raw_glyphs.size());
+
+        glm::ivec2 cursor{0};
+        int rowHeight = 0;
+        const auto place = [&cursor, &rowHeight](const glm::ivec2 &size) -> glm::ivec2 {
+            if (cursor.x + size.x > SDF_ATLAS_WIDTH) {
+                cursor = glm::ivec2{0, cursor.y + rowHeight};
+                rowHeight = 0;
             }
-        }
-        return true;
-    }
-
-    bool tryAddUnderlineGlyph(QImage &img)
-    {
-        const int w = common.scaleW;
-        const int h = common.scaleH;
-        const Rect ourGlyph{{w - 12, 0}, {w - 8, 4}};
+            const glm::ivec2 result = cursor;
+            cursor.x += size.x;
+            rowHeight = std::max(rowHeight, size.y);
+            return result;
+        };
 
-        // must not overlap background
+        const glm::ivec2 solid = place(glm::ivec2{SDF_SOLID_SIZE});
         for (const Glyph &glyph : raw_glyphs) {
-            if (intersects(glyph.getRect(), ourGlyph)) {
-                qWarning() << "Glyph" << glyph.id << "overlaps expected underline location";
-                return false;
-            }
+            SdfCell cell;
+            cell.size = glyph.getSize();
+            // the bitmap uses the upper left origin
+            cell.src = glm::ivec2{glyph.x, common.scaleH - (glyph.y + glyph.height)};
+            cell.dst = place(cell.size + 2 * SDF_SPREAD);
+            cells.emplace_back(cell);
         }
 
-        if (VERBOSE_FONT_DEBUG) {
-            qDebug() << "Adding underline glyph";
+        int height = 1;
+        while (height < cursor.y + rowHeight)
+            height *= 2;
+
+        // glyph locations use lower left origin
+        for (size_t i = 0; i < raw_glyphs.size(); ++i) {
+            Glyph &glyph = raw_glyphs[i];
+            const SdfCell &cell = cells[i];
+            glyph.width += 2 * SDF_SPREAD;
+            glyph.height += 2 * SDF_SPREAD;
+            glyph.x = cell.dst.x;
+            glyph.y = height - (cell.dst.y + glyph.height);
+            glyph.xoffset -= SDF_SPREAD;
+            glyph.yoffset -= SDF_SPREAD;
         }
-        // glyph location uses lower left origin
-        underline.emplace(UNDERLINE_ID, common.scaleW - 11, 1, 2, 1, 0, -1);
-
-        // note: the current image still uses UPPER left origin,
-        // but it will be flipped after this function.
-        for (int dy = -4; dy < 0; ++dy) {
-            const auto color = (dy == -2) ? QColor{Qt::white} : QColor(0, 0, 0, 0);
-            for (int dx = -12; dx < -8; ++dx) {
-                img.setPixelColor(w + dx, h + dy, color);
-            }
-        }
-        return true;
-    }
 
-    void tryAddSyntheticGlyphs(QImage &img)
-    {
-        if (img.width() != common.scaleW || img.height() != common.scaleH) {
-            qWarning() << "Image is the wrong size";
-            return;
-        }
-
-        tryAddBackgroundGlyph(img);
-        tryAddUnderlineGlyph(img);
+        // Both sample the middle of the solid cell, so filtering never reaches its edges.
+        const glm::ivec2 center{solid.x + SDF_SOLID_SIZE / 2 - 1,
+                                height - (solid.y + SDF_SOLID_SIZE / 2 + 1)};
+        const int thickness = std::max(1, common.lineHeight / FONT_SIZE);
+        background.emplace(BACKGROUND_ID, center.x, center.y, 2, 2);
+        underline.emplace(UNDERLINE_ID, center.x, center.y, 2, thickness, 0, -thickness);
+
+        common.scaleW = SDF_ATLAS_WIDTH;
+        common.scaleH = height;
+        solidCell = solid;
+        return cells;
     }
 
     const Kerning *lookupKerning(const Glyph *const prev, const Glyph *const current) const
@@ -365,8 +423,9 @@ QString FontMetrics::init(const QString &fontFilename)
                 const int base = attr.value("base").toInt();
                 const int scaleW = attr.value("scaleW").toInt();
                 const int scaleH = attr.value("scaleH").toInt();
-                const int marginX = 2;
-                const int marginY = 1;
+                // 2 by 1 pixels at the size of the text
+                const int marginX = std::max(1, 2 * lineHeight / FONT_SIZE);
+                const int marginY = std::max(1, lineHeight / FONT_SIZE);
                 if (VERBOSE_FONT_DEBUG) {
                     qDebug() << "Common" << lineHeight << base << scaleW << scaleH << marginX
                              << marginY;
@@ -559,12 +618,14 @@ class FontBatchBuilder final
                        const glm::ivec2 &iTexCoord00,
                        const glm::ivec2 &iglyphSize)
     {
-        const auto emitWithOffset =
-            [this, isEmpty, &iVertex00, &iTexCoord00](const glm::ivec2 &pixelOffset) -> void {
+        // The glyph's outline is inside the distance field's padding.
+        const auto emitWithOffset = [this, isEmpty, &iVertex00, &iTexCoord00](
+                                        const glm::ivec2 &pixelOffset,
+                                        const glm::ivec2 &inset) -> void {
             const glm::ivec2 relativeVertPos = iVertex00 + pixelOffset;
             if (!isEmpty) {
                 // side-effect: updates bounds; this must come before return
-                bounds.include(relativeVertPos);
+                bounds.include(relativeVertPos + inset);
             }
 
             if (noOutput) {
@@ -581,10 +642,11 @@ class FontBatchBuilder final
         // 3-2
         // | |
         // 0-1
-        emitWithOffset(glm::ivec2(0, 0));
-        emitWithOffset(glm::ivec2(x, 0));
-        emitWithOffset(glm::ivec2(x, y));
-        emitWithOffset(glm::ivec2(0, y));
+        const auto &pad = SDF_SPREAD;
+        emitWithOffset(glm::ivec2(0, 0), glm::ivec2(pad, pad));
+        emitWithOffset(glm::ivec2(x, 0), glm::ivec2(-pad, pad));
+        emitWithOffset(glm::ivec2(x, y), glm::ivec2(-pad, -pad));
+        emitWithOffset(glm::ivec2(0, y), glm::ivec2(pad, -pad));
     }
 
     void emitGlyph(const FontMetrics::Glyph *const g, const FontMetrics::Kerning *const k)
@@ -684,18 +746,11 @@ GLFont::GLFont(OpenGL &gl)
 
 GLFont::~GLFont() = default;
 
-static QString getFontFilename(const float devicePixelRatio)
+static QString getFontFilename()
 {
     const char *const FONT_KEY = "MMAPPER_FONT";
-    const char *const font = "Cantarell";
-    const char *const size = [&devicePixelRatio]() {
-        if (devicePixelRatio > 1.75f)
-            return "36";
-        if (devicePixelRatio > 1.25f)
-            return "27";
-        return "18";
-    }();
-    const QString fontFilename = QString(":/fonts/%1%2.fnt").arg(font).arg(size);
+    // The biggest bitmap makes the most accurate distance field.
+    const QString fontFilename = ":/fonts/Cantarell36.fnt";
     if (qEnvironmentVariableIsSet(FONT_KEY)) {
         const QString tmp = qgetenv(FONT_KEY);
         if (QFile{tmp}.exists()) {
@@ -716,11 +771,114 @@ static QString getFontFilename(const float devicePixelRatio)
     return fontFilename;
 }
 
+// Uses the upper left origin, like the bitmap.
+static QImage buildSdfAtlas(const QImage &bitmap,
+                            const FontMetrics &fm,
+                            const std::vector<SdfCell> &cells)
+{
+    const QImage coverage = bitmap.convertToFormat(QImage::Format_Alpha8);
+    QImage atlas{fm.common.scaleW, fm.common.scaleH, QImage::Format_ARGB32};
+    atlas.fill(QColor(255, 255, 255, 0));
+
+    for (int dy = 0; dy < SDF_SOLID_SIZE; ++dy) {
+        for (int dx = 0; dx < SDF_SOLID_SIZE; ++dx) {
+            atlas.setPixel(fm.solidCell.x + dx, fm.solidCell.y + dy, qRgba(255, 255, 255, 255));
+        }
+    }
+
+    for (const SdfCell &cell : cells) {
+        const auto isInside = [&coverage, &cell](const int x, const int y) -> bool {
+            if (x < 0 || y < 0 || x >= cell.size.x || y >= cell.size.y)
+                return false;
+            const uchar *const line = coverage.constScanLine(cell.src.y + y);
+            return line[cell.src.x + x] >= 128;
+        };
+
+        // The glyphs are tiny, so just search the neighbourhood for the nearest texel
+        // on the other side of the outline.
+        for (int y = -SDF_SPREAD; y < cell.size.y + SDF_SPREAD; ++y) {
+            for (int x = -SDF_SPREAD; x < cell.size.x + SDF_SPREAD; ++x) {
+                const bool inside = isInside(x, y);
+                int best = SDF_SPREAD * SDF_SPREAD;
+                for (int dy = -SDF_SPREAD; dy <= SDF_SPREAD; ++dy) {
+                    for (int dx = -SDF_SPREAD; dx <= SDF_SPREAD; ++dx) {
+                        const int dist = dx * dx + dy * dy;
+                        if (dist < best && isInside(x + dx, y + dy) != inside)
+                            best = dist;
+                    }
+                }
+
+                // the outline is halfway between the two texels
+                const float dist = std::sqrt(static_cast<float>(best)) - 0.5f;
+                const float value = 0.5f + (inside ? dist : -dist) / (2.f * SDF_SPREAD);
+                const int alpha = static_cast<int>(std::lround(
+                    255.f * std::clamp(value, 0.f, 1.f)));
+                const glm::ivec2 pos = cell.dst + SDF_SPREAD + glm::ivec2{x, y};
+                atlas.setPixel(pos.x, pos.y, qRgba(255, 255, 255, alpha));
+            }
+        }
+    }
+    return atlas;
+}
+
+// The atlas only depends on the font, so it's only built the first time a font is used.
+static QString getSdfCachePath(const QString &fontFilename, const QString &imageFilename)
+{
+    const QString cacheDir = QStandardPaths::writableLocation(
+        QStandardPaths::GenericCacheLocation);
+    if (cacheDir.isEmpty())
+        return QString{};
+
+    QCryptographicHash hash{QCryptographicHash::Md5};
+    for (const QString &filename : {fontFilename, imageFilename}) {
+        QFile f{filename};
+        if (!f.open(QIODevice::ReadOnly))
+            return QString{};
+        hash.addData(f.readAll());
+    }
+    hash.addData(QByteArray::number(SDF_VERSION));
+    hash.addData(QByteArray::number(SDF_SPREAD));
+
+    const QString dir = cacheDir + "/mmapper/fonts";
+    if (!QDir{}.mkpath(dir))
+        return QString{};
+    return QString("%1/%2-sdf-%3.png")
+        .arg(dir)
+        .arg(QFileInfo{fontFilename}.completeBaseName())
+        .arg(QString{hash.result().toHex()});
+}
+
+static QImage loadSdfAtlas(const QString &fontFilename,
+                           const QString &imageFilename,
+                           const FontMetrics &fm,
+                           const std::vector<SdfCell> &cells)
+{
+    const QString cachePath = getSdfCachePath(fontFilename, imageFilename);
+    if (!cachePath.isEmpty()) {
+        QImage cached{cachePath};
+        if (!cached.isNull() && cached.width() == fm.common.scaleW
+            && cached.height() == fm.common.scaleH) {
+            if (VERBOSE_FONT_DEBUG) {
+                qDebug() << "Using cached font atlas" << cachePath;
+            }
+            return cached;
+        }
+    }
+
+    qInfo() << "Building the font atlas";
+    QImage atlas = buildSdfAtlas(QImage{imageFilename}, fm, cells);
+    if (!cachePath.isEmpty() && !atlas.save(cachePath, "PNG")) {
+        qWarning() << "Unable to save the font atlas to" << cachePath;
+    }
+    return atlas;
+}
+
 void GLFont::init()
 {
     assert(m_gl.isRendererInitialized());
     m_fontMetrics = std::make_unique<FontMetrics>();
-    const auto fontFilename = getFontFilename(m_gl.getDevicePixelRatio());
+    m_glyphRuns = std::make_unique<GlyphRunCache>();
+    const auto fontFilename = getFontFilename();
     const QString imageFilename = m_fontMetrics->init(fontFilename);
 
     auto &fm = *m_fontMetrics;
@@ -729,17 +887,16 @@ void GLFont::init()
         qWarning() << "invalid font filename" << imageFilename;
     }
 
+    const std::vector<SdfCell> cells = fm.layoutSdfAtlas();
+    const QImage atlas = loadSdfAtlas(fontFilename, imageFilename, fm, cells);
+
     m_texture = MMTexture::alloc(
         QOpenGLTexture::Target::Target2D,
-        [&fm, &imageFilename](QOpenGLTexture &tex) -> void {
-            QImage img{imageFilename};
-            fm.tryAddSyntheticGlyphs(img);
-            img = img.mirrored();
-
+        [&atlas](QOpenGLTexture &tex) -> void {
             tex.setMinMagFilters(QOpenGLTexture::Filter::Linear, QOpenGLTexture::Filter::Linear);
             tex.setAutoMipMapGenerationEnabled(false);
             tex.setMipLevels(0);
-            tex.setData(img, QOpenGLTexture::MipMapGeneration::DontGenerateMipMaps);
+            tex.setData(atlas.mirrored(), QOpenGLTexture::MipMapGeneration::DontGenerateMipMaps);
         },
         true);
 }
@@ -747,18 +904,26 @@ void GLFont::init()
 void GLFont::cleanup()
 {
     m_fontMetrics.reset();
+    m_glyphRuns.reset();
     m_texture.reset();
 }
 
+float GLFont::getScale() const
+{
+    return m_gl.getDevicePixelRatio() * static_cast<float>(FONT_SIZE)
+           / static_cast<float>(std::max(1, getFontMetrics().common.lineHeight));
+}
+
 int GLFont::getFontHeight() const
 {
-    return getFontMetrics().common.lineHeight;
+    return static_cast<int>(
+        std::lround(static_cast<float>(getFontMetrics().common.lineHeight) * getScale()));
 }
 
 std::optional<int> GLFont::getGlyphAdvance(const char c) const
 {
     if (const FontMetrics::Glyph *const g = getFontMetrics().lookupGlyph(c)) {
-        return g->xadvance;
+        return static_cast<int>(std::lround(static_cast<float>(g->xadvance) * getScale()));
     }
     return std::nullopt;
 }
@@ -774,7 +939,6 @@ std::vector<FontVert3d> GLFont::getFontBatchRawData(const GLText *const text, co
     if (count == 0)
         return result;
 
-    auto &fm = getFontMetrics();
     const auto end = text + count;
 
     const size_t expectedVerts = [text, end]() -> size_t {
@@ -788,14 +952,39 @@ std::vector<FontVert3d> GLFont::getFontBatchRawData(const GLText *const text, co
 
     result.reserve(expectedVerts);
 
-    FontBatchBuilder fontBatchBuilder{fm, result};
+    // The runs are laid out in texels of the atlas.
+    const float scale = getScale();
     for (const GLText *it = text; it != end; ++it) {
-        fontBatchBuilder.addString(*it);
+        for (const FontVert3d &vert : getGlyphRun(*it)) {
+            FontVert3d &out = result.emplace_back(vert);
+            out.base = it->pos;
+            out.vert *= scale;
+        }
     }
     assert(result.size() == expectedVerts);
     return result;
 }
 
+const std::vector<FontVert3d> &GLFont::getGlyphRun(const GLText &text)
+{
+    auto &runs = deref(m_glyphRuns).runs;
+    GlyphRunKey key{text};
+    if (const auto it = runs.find(key); it != runs.end())
+        return it->second;
+
+    if (runs.size() >= GlyphRunCache::MAX_RUNS)
+        runs.clear();
+
+    // FontBatchBuilder puts the position into every vertex, so lay it out at the origin.
+    GLText atOrigin = text;
+    atOrigin.pos = glm::vec3{0.f};
+
+    std::vector<FontVert3d> run;
+    FontBatchBuilder builder{getFontMetrics(), run};
+    builder.addString(atOrigin);
+    return runs.emplace(std::move(key), std::move(run)).first->second;
+}
+
 void GLFont::render2dTextImmediate(const std::vector<GLText> &text)
 {
     if (text.empty())
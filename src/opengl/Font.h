@@ -43,6 +43,7 @@ struct NODISCARD GLText final
 };
 
 struct FontMetrics;
+struct GlyphRunCache;
 
 class GLFont final
 {
@@ -50,6 +51,7 @@ class GLFont final
     OpenGL &m_gl;
     SharedMMTexture m_texture;
     std::unique_ptr<FontMetrics> m_fontMetrics;
+    std::unique_ptr<GlyphRunCache> m_glyphRuns;
 
 public:
     explicit GLFont(OpenGL &gl);
@@ -69,6 +71,8 @@ class GLFont final
 
 private:
     glm::ivec2 getScreenCenter() const;
+    // From the atlas's texels to physical pixels.
+    NODISCARD float getScale() const;
 
 public:
     void renderTextCentered(const QString &text,
@@ -82,4 +86,6 @@ class GLFont final
 
 private:
     std::vector<FontVert3d> getFontBatchRawData(const GLText *text, size_t count);
+    // The quads of the text relative to its position; cached by everything but the position.
+    const std::vector<FontVert3d> &getGlyphRun(const GLText &text);
 };
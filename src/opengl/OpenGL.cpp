@@ -4,12 +4,16 @@
 
 #include "OpenGL.h"
 
+#include <algorithm>
 #include <cassert>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <optional>
+#include <stdexcept>
 #include <vector>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
 
 #include "OpenGLTypes.h"
 #include "legacy/Legacy.h"
@@ -69,6 +73,56 @@ UniqueMesh OpenGL::createColoredLineBatch(const std::vector<ColorVert> &batch)
     return getFunctions().createColoredBatch(DrawModeEnum::LINES, batch);
 }
 
+UniqueMesh OpenGL::createPackedColoredLineBatch(const std::vector<PackedColorVert> &batch,
+                                                const glm::vec3 &origin)
+{
+    return getFunctions().createPackedColoredBatch(DrawModeEnum::LINES, batch, origin);
+}
+
+// The solid ends and faint middle of each segment as separate lines; see ColorSegment.
+static std::vector<ColorVert> getSegmentLines(const std::vector<ColorSegment> &segments)
+{
+    static constexpr const float HALF_FADE_LENGTH = ColorSegment::FADE_LENGTH * 0.5f;
+
+    std::vector<ColorVert> result;
+    result.reserve(segments.size() * VERTS_PER_LINE);
+    for (const ColorSegment &segment : segments) {
+        const glm::vec3 &a = segment.from;
+        const glm::vec3 &b = segment.to;
+        const float len = glm::length(a - b);
+        if (len < ColorSegment::FADE_LENGTH) {
+            result.emplace_back(segment.color, a);
+            result.emplace_back(segment.color, b);
+            continue;
+        }
+
+        const float cutoff = HALF_FADE_LENGTH / len;
+        const glm::vec3 mid1 = glm::mix(a, b, cutoff);
+        const glm::vec3 mid2 = glm::mix(a, b, 1.f - cutoff);
+        const Color faint = segment.color.withAlpha(segment.middleAlpha);
+        result.emplace_back(segment.color, a);
+        result.emplace_back(segment.color, mid1);
+        result.emplace_back(faint, mid1);
+        result.emplace_back(faint, mid2);
+        result.emplace_back(segment.color, mid2);
+        result.emplace_back(segment.color, b);
+    }
+    return result;
+}
+
+UniqueMesh OpenGL::createSegmentBatch(const std::vector<ColorSegment> &segments,
+                                      const glm::vec3 &origin)
+{
+    const bool canPack = std::all_of(segments.begin(),
+                                     segments.end(),
+                                     [&origin](const ColorSegment &segment) {
+                                         return PackedSegmentVert::canPack(segment, origin);
+                                     });
+    if (!canPack)
+        return createColoredLineBatch(getSegmentLines(segments));
+    return getFunctions().createSegmentBatch(segments, origin);
+}
+
 UniqueMesh OpenGL::createPlainTriBatch(const std::vector<glm::vec3> &batch)
 {
     return getFunctions().createPlainBatch(DrawModeEnum::TRIANGLES, batch);
@@ -79,6 +133,12 @@ UniqueMesh OpenGL::createColoredTriBatch(const std::vector<ColorVert> &batch)
     return getFunctions().createColoredBatch(DrawModeEnum::TRIANGLES, batch);
 }
 
+UniqueMesh OpenGL::createPackedColoredTriBatch(const std::vector<PackedColorVert> &batch,
+                                               const glm::vec3 &origin)
+{
+    return getFunctions().createPackedColoredBatch(DrawModeEnum::TRIANGLES, batch, origin);
+}
+
 UniqueMesh OpenGL::createPlainQuadBatch(const std::vector<glm::vec3> &batch)
 {
     return getFunctions().createPlainBatch(DrawModeEnum::QUADS, batch);
@@ -101,6 +161,39 @@ UniqueMesh OpenGL::createColoredTexturedQuadBatch(const std::vector<ColoredTexVe
     return getFunctions().createColoredTexturedBatch(DrawModeEnum::QUADS, batch, texture);
 }
 
+UniqueMesh OpenGL::createRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                       const glm::vec3 &origin,
+                                       const SharedMMTexture &texture)
+{
+    return getFunctions().createRoomQuadBatch(batch, origin, texture);
+}
+
+UniqueMesh OpenGL::createRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                       const glm::vec3 &origin)
+{
+    return getFunctions().createRoomQuadBatch(batch, origin);
+}
+
+UniqueMesh OpenGL::createAtlasRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                            const glm::vec3 &origin,
+                                            const SharedMMTexture &atlas)
+{
+    return getFunctions().createAtlasRoomQuadBatch(batch, origin, atlas);
+}
+
+UniqueMesh OpenGL::createPlainRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                            const glm::vec3 &origin)
+{
+    return getFunctions().createPlainRoomQuadBatch(batch, origin);
+}
+
+UniqueMesh OpenGL::createColoredRoomQuadBatch(const std::vector<ColoredRoomQuadVert> &batch,
+                                              const glm::vec3 &origin,
+                                              const SharedMMTexture &texture)
+{
+    return getFunctions().createColoredRoomQuadBatch(batch, origin, texture);
+}
+
 UniqueMesh OpenGL::createFontMesh(const SharedMMTexture &texture,
                                   const DrawModeEnum mode,
                                   const std::vector<FontVert3d> &batch)
@@ -169,6 +262,31 @@ void OpenGL::renderPlainFullScreenQuad(const GLRenderState &renderState)
     setProjectionMatrix(oldProj);
 }
 
+void OpenGL::beginFrameStats()
+{
+    getFunctions().beginFrameStats();
+}
+
+FrameStats OpenGL::endFrameStats()
+{
+    return getFunctions().endFrameStats();
+}
+
+size_t OpenGL::getNumBuffers() const
+{
+    return getFunctions().getNumBuffers();
+}
+
+size_t OpenGL::getBufferBytes() const
+{
+    return getFunctions().getTotalBufferBytes();
+}
+
+void OpenGL::resetBindings()
+{
+    getFunctions().resetBindings();
+}
+
 void OpenGL::cleanup()
 {
     getFunctions().cleanup();
@@ -190,6 +308,49 @@ void OpenGL::initializeOpenGLFunctions()
     getFunctions().initializeOpenGLFunctions();
 }
 
+RendererBackendEnum OpenGL::initializeBackend(const bool allowCore)
+{
+    const QOpenGLContext *const context = QOpenGLContext::currentContext();
+    if (context == nullptr)
+        throw std::runtime_error("no current OpenGL context");
+
+    const QSurfaceFormat format = context->format();
+    const bool isES = context->isOpenGLES();
+    const bool hasCore = format.version() >= (isES ? qMakePair(3, 0) : qMakePair(3, 3));
+    // A core profile doesn't have the GL 2.0 functions the legacy backend needs.
+    const bool isCoreProfile = !isES && format.profile() == QSurfaceFormat::CoreProfile;
+
+    const auto backend = (hasCore && (allowCore || isCoreProfile)) ? RendererBackendEnum::CORE
+                                                                   : RendererBackendEnum::LEGACY;
+    getFunctions().setBackend(backend);
+    return backend;
+}
+
+RendererBackendEnum OpenGL::getBackend() const
+{
+    return getFunctions().getBackend();
+}
+
+bool OpenGL::supportsCompression(const TextureCompressionEnum format) const
+{
+    const QOpenGLContext *const context = QOpenGLContext::currentContext();
+    if (context == nullptr)
+        return false;
+
+    switch (format) {
+    case TextureCompressionEnum::NONE:
+        return true;
+    case TextureCompressionEnum::BC1:
+        if (context->hasExtension("GL_EXT_texture_compression_dxt1"))
+            return true;
+        FALLTHRU;
+    case TextureCompressionEnum::BC3:
+        return context->hasExtension("GL_EXT_texture_compression_s3tc")
+               || context->hasExtension("GL_ANGLE_texture_compression_dxt5");
+    }
+    return false;
+}
+
 const char *OpenGL::glGetString(GLenum name)
 {
     return as_cstring(getFunctions().glGetString(name));
@@ -33,6 +33,14 @@ class OpenGL final
 public:
     /* must be called before any other functions */
     void initializeOpenGLFunctions();
+    /// Picks the CORE backend if the current context is GL 3.3 or ES 3.0 (or newer),
+    /// and LEGACY otherwise, or if allowCore is false and the context still has GL 2.0.
+    /// Call this right after initializeOpenGLFunctions().
+    RendererBackendEnum initializeBackend(bool allowCore);
+    NODISCARD RendererBackendEnum getBackend() const;
+    /// Whether the current context can sample textures in `format`; the BCn formats come
+    /// with S3TC, which every desktop driver and a few ES ones (e.g. ANGLE) have.
+    NODISCARD bool supportsCompression(TextureCompressionEnum format) const;
     void initializeRenderer(float devicePixelRatio);
     const char *glGetString(GLenum name);
     void setDevicePixelRatio(float devicePixelRatio);
@@ -57,11 +65,20 @@ class OpenGL final
     UniqueMesh createPlainLineBatch(const std::vector<glm::vec3> &verts);
     // colored means the color is defined by attribute
     UniqueMesh createColoredLineBatch(const std::vector<ColorVert> &verts);
+    // packed means the position is relative to the origin; see PackedColorVert
+    UniqueMesh createPackedColoredLineBatch(const std::vector<PackedColorVert> &verts,
+                                            const glm::vec3 &origin);
+    // widened by the vertex shader to the render state's line width; segments too far from
+    // the origin to pack make it fall back to a colored line batch; see PackedSegmentVert
+    UniqueMesh createSegmentBatch(const std::vector<ColorSegment> &segments,
+                                  const glm::vec3 &origin);
 
 public:
     // plain means the color is defined by uniform
     UniqueMesh createPlainTriBatch(const std::vector<glm::vec3> &verts);
     UniqueMesh createColoredTriBatch(const std::vector<ColorVert> &verts);
+    UniqueMesh createPackedColoredTriBatch(const std::vector<PackedColorVert> &verts,
+                                           const glm::vec3 &origin);
 
 public:
     // plain means the color is defined by uniform
@@ -72,6 +89,23 @@ class OpenGL final
                                        const SharedMMTexture &texture);
     UniqueMesh createColoredTexturedQuadBatch(const std::vector<ColoredTexVert> &verts,
                                               const SharedMMTexture &texture);
+    // room quads are relative to the origin
+    UniqueMesh createRoomQuadBatch(const std::vector<RoomQuadVert> &verts,
+                                   const glm::vec3 &origin,
+                                   const SharedMMTexture &texture);
+    // same, but the texture comes from the render state
+    UniqueMesh createRoomQuadBatch(const std::vector<RoomQuadVert> &verts,
+                                   const glm::vec3 &origin);
+    // the texture is an atlas of MapCanvasTextures::ATLAS_COLUMNS x ATLAS_ROWS cells
+    UniqueMesh createAtlasRoomQuadBatch(const std::vector<RoomQuadVert> &verts,
+                                        const glm::vec3 &origin,
+                                        const SharedMMTexture &atlas);
+    // untextured, with the color defined by uniform; the atlas cells are ignored
+    UniqueMesh createPlainRoomQuadBatch(const std::vector<RoomQuadVert> &verts,
+                                        const glm::vec3 &origin);
+    UniqueMesh createColoredRoomQuadBatch(const std::vector<ColoredRoomQuadVert> &verts,
+                                          const glm::vec3 &origin,
+                                          const SharedMMTexture &texture);
 
     UniqueMesh createFontMesh(const SharedMMTexture &texture,
                               DrawModeEnum mode,
@@ -143,6 +177,21 @@ class OpenGL final
     void clearDepth();
     void renderPlainFullScreenQuad(const GLRenderState &state);
 
+public:
+    /// Starts counting draw calls, vertices and VBO uploads, and timing the GPU.
+    void beginFrameStats();
+    FrameStats endFrameStats();
+
+public:
+    /// The vertex buffers and the bytes uploaded to them, for the memory report.
+    NODISCARD size_t getNumBuffers() const;
+    NODISCARD size_t getBufferBytes() const;
+
+public:
+    /// Program, buffer and texture bindings are left in place between draws;
+    /// call this at the end of a frame, before Qt uses the context again.
+    void resetBindings();
+
 public:
     void cleanup();
 };
@@ -2,6 +2,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2019 The MMapper Authors
 
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <glm/glm.hpp>
 #include <memory>
@@ -41,6 +45,45 @@ struct ColoredTexVert final
     {}
 };
 
+// One corner of a room-sized quad, relative to the origin of its mesh.
+//
+// The vertex shader adds the corner to the room to get the position, and uses
+// the corner as the texture coordinate (within the atlas cell, if the mesh uses
+// an atlas), so this takes 4 bytes instead of the 20 of a TexVert.
+// The room must be within 255 units of the origin.
+struct RoomQuadVert final
+{
+    uint8_t x = 0;
+    uint8_t y = 0;
+    // cornerX + 2 * cornerY
+    uint8_t corner = 0;
+    uint8_t atlasCell = 0;
+
+    explicit RoomQuadVert(const glm::ivec2 &room, const glm::ivec2 &corner, const int atlasCell)
+        : x{static_cast<uint8_t>(room.x)}
+        , y{static_cast<uint8_t>(room.y)}
+        , corner{static_cast<uint8_t>(corner.x + 2 * corner.y)}
+        , atlasCell{static_cast<uint8_t>(atlasCell)}
+    {
+        assert(isClamped(room.x, 0, 255) && isClamped(room.y, 0, 255));
+        assert(isClamped(corner.x, 0, 1) && isClamped(corner.y, 0, 1));
+        assert(isClamped(atlasCell, 0, 255));
+    }
+};
+
+struct ColoredRoomQuadVert final
+{
+    Color color;
+    RoomQuadVert quad;
+
+    explicit ColoredRoomQuadVert(const Color &color,
+                                 const glm::ivec2 &room,
+                                 const glm::ivec2 &corner)
+        : color{color}
+        , quad{room, corner, 0}
+    {}
+};
+
 struct ColorVert final
 {
     Color color;
@@ -52,6 +95,106 @@ struct ColorVert final
     {}
 };
 
+// A ColorVert relative to the origin of its mesh, in fixed point units of 1/SCALE of a room,
+// so it takes 12 bytes instead of 16. The mesh's model matrix undoes the scale.
+// Check canPack() first: it only reaches about 255 rooms from the origin.
+struct PackedColorVert final
+{
+    static constexpr const float SCALE = 128.f;
+
+    Color color;
+    std::array<int16_t, 3> vert{};
+    // keeps the next vertex 4-byte aligned
+    int16_t padding = 0;
+
+    explicit PackedColorVert(const Color &color, const glm::vec3 &offset)
+        : color{color}
+    {
+        assert(canPack(offset));
+        for (int i = 0; i < 3; ++i)
+            vert[static_cast<size_t>(i)] = static_cast<int16_t>(std::lround(offset[i] * SCALE));
+    }
+
+    NODISCARD static bool canPack(const glm::vec3 &offset)
+    {
+        static constexpr const float LIMIT = static_cast<float>(INT16_MAX) / SCALE;
+        return glm::all(glm::lessThanEqual(glm::abs(offset), glm::vec3{LIMIT}));
+    }
+};
+
+// A line segment in world coordinates. If it's at least FADE_LENGTH long, the part of it
+// that's more than FADE_LENGTH/2 from both ends has the alpha middleAlpha instead of the
+// color's, so long lines don't hide what they cross.
+struct ColorSegment final
+{
+    static constexpr const float FADE_LENGTH = 3.f;
+
+    Color color;
+    glm::vec3 from{0.f};
+    glm::vec3 to{0.f};
+    float middleAlpha = 1.f;
+
+    explicit ColorSegment(const Color &color, const glm::vec3 &from, const glm::vec3 &to)
+        : color{color}
+        , from{from}
+        , to{to}
+        , middleAlpha{static_cast<float>(color.getAlpha()) / 255.f}
+    {}
+    explicit ColorSegment(const Color &color,
+                          const glm::vec3 &from,
+                          const glm::vec3 &to,
+                          const float middleAlpha)
+        : color{color}
+        , from{from}
+        , to{to}
+        , middleAlpha{middleAlpha}
+    {}
+};
+
+// One corner of the quad of a ColorSegment, relative to the origin of its mesh and in the
+// fixed point units of PackedColorVert. The vertex shader widens the segment into a quad
+// facing the screen, so wide lines don't depend on glLineWidth(), which core profiles
+// may not support, and fades its middle.
+//
+// With the CORE backend only the first corner of each quad is uploaded (see
+// SimpleMesh::setStaticQuadInstances()), so a segment takes 20 bytes instead of the 24
+// of two PackedColorVert, or 72 for a long line split into its solid and faint parts.
+struct PackedSegmentVert final
+{
+    Color color;
+    std::array<int16_t, 3> from{};
+    std::array<int16_t, 3> to{};
+    // end (0 = from, 1 = to) + 2 * side
+    uint8_t corner = 0;
+    uint8_t middleAlpha = 255;
+    // keeps the next vertex 4-byte aligned
+    int16_t padding = 0;
+
+    explicit PackedSegmentVert(const ColorSegment &segment,
+                               const glm::vec3 &origin,
+                               const glm::ivec2 &corner)
+        : color{segment.color}
+        , corner{static_cast<uint8_t>(corner.x + 2 * corner.y)}
+        , middleAlpha{static_cast<uint8_t>(std::lround(segment.middleAlpha * 255.f))}
+    {
+        assert(canPack(segment, origin));
+        assert(isClamped(corner.x, 0, 1) && isClamped(corner.y, 0, 1));
+        for (int i = 0; i < 3; ++i) {
+            const auto index = static_cast<size_t>(i);
+            from[index] = static_cast<int16_t>(
+                std::lround((segment.from[i] - origin[i]) * PackedColorVert::SCALE));
+            to[index] = static_cast<int16_t>(
+                std::lround((segment.to[i] - origin[i]) * PackedColorVert::SCALE));
+        }
+    }
+
+    NODISCARD static bool canPack(const ColorSegment &segment, const glm::vec3 &origin)
+    {
+        return PackedColorVert::canPack(segment.from - origin)
+               && PackedColorVert::canPack(segment.to - origin);
+    }
+};
+
 // Similar to ColoredTexVert, except it has a base position in world coordinates.
 // the font's vertex shader transforms the world position to screen space,
 // rounds to integer pixel offset, and then adds the vertex position in screen space.
@@ -78,6 +221,24 @@ struct FontVert3d final
 
 enum class DrawModeEnum { INVALID = 0, POINTS = 1, LINES = 2, TRIANGLES = 3, QUADS = 4 };
 
+// Which OpenGL features the renderer uses; see OpenGL::initializeBackend().
+enum class NODISCARD RendererBackendEnum : uint8_t {
+    // GL 2.0 / ES 2.0: the attributes are set up again for every draw.
+    LEGACY,
+    // GL 3.3 core / ES 3.0: every mesh keeps its attributes in a VAO, and the
+    // room quads are drawn as instances.
+    CORE
+};
+
+// Block-compressed texture formats (4x4 texels per block); see OpenGL::supportsCompression().
+enum class NODISCARD TextureCompressionEnum : uint8_t {
+    NONE,
+    // 8 bytes per block, opaque
+    BC1,
+    // 16 bytes per block: BC1's colours plus interpolated alpha
+    BC3
+};
+
 struct LineParams final
 {
     float width = 1.f;
@@ -154,6 +315,8 @@ struct GLRenderState final
         // glEnable(TEXTURE_2D), or glEnable(TEXTURE_3D)
         Textures textures;
         std::optional<float> pointSize;
+        // for the shaders that widen lines themselves; see PackedSegmentVert
+        std::optional<float> lineWidth;
     };
 
     Uniforms uniforms;
@@ -197,6 +360,7 @@ struct GLRenderState final
     {
         GLRenderState copy = *this;
         copy.lineParams = new_lineParams;
+        copy.uniforms.lineWidth = new_lineParams.width;
         return copy;
     }
 
@@ -263,7 +427,18 @@ struct NODISCARD TexturedRenderable final : IRenderable
     }
 };
 
-enum class BufferUsageEnum { STATIC_DRAW, DYNAMIC_DRAW };
+/// Counters for the GL work of one frame; see OpenGL::beginFrameStats().
+struct NODISCARD FrameStats final
+{
+    size_t drawCalls = 0;
+    size_t vertices = 0;
+    size_t uploadedBytes = 0;
+    /// GPU time of a recent frame, if the context supports timer queries;
+    /// the result is read a few frames late so it never stalls the pipeline.
+    std::optional<double> gpuMs;
+};
+
+enum class BufferUsageEnum { STATIC_DRAW, DYNAMIC_DRAW, STREAM_DRAW };
 
 class NODISCARD UniqueMesh final
 {
@@ -287,12 +462,18 @@ struct NODISCARD UniqueMeshVector final
 {
 private:
     std::vector<UniqueMesh> m_meshes;
+    // Optional; if given, they increase, and meshes from different vectors with the
+    // same key share their texture (so they're worth drawing one after another).
+    std::vector<int> m_sortKeys;
 
 public:
     UniqueMeshVector() = default;
-    explicit UniqueMeshVector(std::vector<UniqueMesh> &&meshes)
+    explicit UniqueMeshVector(std::vector<UniqueMesh> &&meshes, std::vector<int> &&sortKeys = {})
         : m_meshes{std::move(meshes)}
-    {}
+        , m_sortKeys{std::move(sortKeys)}
+    {
+        assert(m_sortKeys.empty() || m_sortKeys.size() == m_meshes.size());
+    }
 
     void render(const GLRenderState &rs)
     {
@@ -300,6 +481,14 @@ struct NODISCARD UniqueMeshVector final
             mesh.render(rs);
         }
     }
+
+public:
+    NODISCARD size_t size() const { return m_meshes.size(); }
+    NODISCARD UniqueMesh &getMesh(const size_t i) { return m_meshes.at(i); }
+    NODISCARD int getSortKey(const size_t i) const
+    {
+        return m_sortKeys.empty() ? 0 : m_sortKeys.at(i);
+    }
 };
 
 struct Viewport
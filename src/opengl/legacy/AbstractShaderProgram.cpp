@@ -40,9 +40,6 @@ AbstractShaderProgram::ProgramUnbinder AbstractShaderProgram::bind()
 void AbstractShaderProgram::unbind()
 {
     assert(m_isBound);
-    if (auto f = m_functions.lock()) {
-        f->glUseProgram(0);
-    }
     m_isBound = false;
 }
 
@@ -55,6 +52,9 @@ void AbstractShaderProgram::setUniforms(const glm::mat4 &mvp,
     if (uniforms.pointSize) {
         setPointSize(uniforms.pointSize.value());
     }
+    if (uniforms.lineWidth) {
+        setLineWidth(uniforms.lineWidth.value());
+    }
 }
 
 GLuint AbstractShaderProgram::getAttribLocation(const char *const name) const
@@ -152,6 +152,15 @@ void AbstractShaderProgram::setPointSize(const float in_pointSize)
     }
 }
 
+void AbstractShaderProgram::setLineWidth(const float in_lineWidth)
+{
+    const auto location = getUniformLocation("uLineWidth");
+    if (location != INVALID_UNIFORM_LOCATION) {
+        const float lineWidth = in_lineWidth * getDevicePixelRatio();
+        setUniform1fv(location, 1, &lineWidth);
+    }
+}
+
 void AbstractShaderProgram::setColor(const char *const name, const Color &color)
 {
     const auto location = getUniformLocation(name);
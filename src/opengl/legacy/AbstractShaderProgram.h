@@ -51,7 +51,8 @@ struct NODISCARD AbstractShaderProgram
 
 private:
     friend ProgramUnbinder;
-    // REVISIT: store the currently bound program on the functions object?
+    // The program stays in use, so the next mesh with the same one doesn't rebind it;
+    // see Functions::resetBindings().
     void unbind();
 
 public:
@@ -81,6 +82,7 @@ struct NODISCARD AbstractShaderProgram
 
 public:
     void setPointSize(float in_pointSize);
+    void setLineWidth(float in_lineWidth);
     void setColor(const char *name, const Color &color);
     void setMatrix(const char *name, const glm::mat4 &m);
     void setTexture(const char *name, int textureUnit);
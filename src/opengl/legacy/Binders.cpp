@@ -128,23 +128,14 @@ PointSizeBinder::~PointSizeBinder()
     }
 }
 
-TexturesBinder::TexturesBinder(const TexturesBinder::Textures &in_textures)
-    : textures{in_textures}
+TexturesBinder::TexturesBinder(Functions &functions, const TexturesBinder::Textures &textures)
 {
     for (size_t i = 0, size = textures.size(); i < size; ++i) {
         const SharedMMTexture &tex = textures[i];
         if (tex != nullptr) {
-            tex->bind(static_cast<uint32_t>(i));
-        }
-    }
-}
-
-TexturesBinder::~TexturesBinder()
-{
-    for (size_t i = 0, size = textures.size(); i < size; ++i) {
-        auto &tex = textures[i];
-        if (tex != nullptr) {
-            tex->release(static_cast<uint32_t>(i));
+            functions.bindTexture(static_cast<GLuint>(i),
+                                  static_cast<GLenum>(tex->target()),
+                                  tex->textureId());
         }
     }
 }
@@ -155,7 +146,7 @@ RenderStateBinder::RenderStateBinder(Functions &functions, const GLRenderState &
     , depthBinder{functions, renderState.depth}
     , lineParamsBinder{functions, renderState.lineParams}
     , pointSizeBinder{functions, renderState.uniforms.pointSize}
-    , texturesBinder{renderState.uniforms.textures}
+    , texturesBinder{functions, renderState.uniforms.textures}
 {}
 
 } // namespace Legacy
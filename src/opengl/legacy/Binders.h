@@ -73,18 +73,17 @@ struct NODISCARD PointSizeBinder
     DELETE_CTORS_AND_ASSIGN_OPS(PointSizeBinder);
 };
 
+// The textures are left bound, so the next mesh with the same ones doesn't rebind them;
+// see Functions::resetBindings().
 struct NODISCARD TexturesBinder final
 {
 public:
     using Textures = GLRenderState::Textures;
 
-private:
-    const Textures &textures;
-
 public:
-    explicit TexturesBinder(const Textures &in_textures);
-    ~TexturesBinder();
+    explicit TexturesBinder(Functions &functions, const Textures &textures);
     DELETE_CTORS_AND_ASSIGN_OPS(TexturesBinder);
+    DTOR(TexturesBinder) = default;
 };
 
 struct NODISCARD RenderStateBinder final
@@ -82,7 +82,6 @@ class NODISCARD SimpleFont3dMesh : public SimpleMesh<_VertexType, FontShader>
         gl.glDisableVertexAttribArray(attribs.colorPos);
         gl.glDisableVertexAttribArray(attribs.texPos);
         gl.glDisableVertexAttribArray(attribs.vertPos);
-        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
         boundAttribs.reset();
     }
 };
@@ -3,6 +3,7 @@
 
 #include "Legacy.h"
 
+#include <array>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -28,6 +29,7 @@
 #include "ShaderUtils.h"
 #include "Shaders.h"
 #include "SimpleMesh.h"
+#include "TimerQueries.h"
 #include "VBO.h"
 
 namespace Legacy {
@@ -86,6 +88,16 @@ UniqueMesh Functions::createColoredBatch(const DrawModeEnum mode,
     return createUniqueMesh<ColoredMesh>(shared_from_this(), mode, batch, prog);
 }
 
+UniqueMesh Functions::createPackedColoredBatch(const DrawModeEnum mode,
+                                               const std::vector<PackedColorVert> &batch,
+                                               const glm::vec3 &origin)
+{
+    assert(static_cast<size_t>(mode) >= VERTS_PER_LINE);
+    const auto &prog = getShaderPrograms().getPlainAColorShader();
+    using Mesh = PackedColoredMesh<PackedColorVert>;
+    return UniqueMesh{std::make_unique<Mesh>(shared_from_this(), prog, mode, origin, batch)};
+}
+
 UniqueMesh Functions::createTexturedBatch(const DrawModeEnum mode,
                                           const std::vector<TexVert> &batch,
                                           const SharedMMTexture &texture)
@@ -104,6 +116,60 @@ UniqueMesh Functions::createColoredTexturedBatch(const DrawModeEnum mode,
     return createTexturedMesh<ColoredTexturedMesh>(shared_from_this(), mode, batch, prog, texture);
 }
 
+UniqueMesh Functions::createRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                          const glm::vec3 &origin)
+{
+    const auto &prog = getShaderPrograms().getRoomQuadUColorShader();
+    using Mesh = RoomQuadMesh<RoomQuadVert>;
+    return UniqueMesh{std::make_unique<Mesh>(shared_from_this(), prog, origin, batch)};
+}
+
+UniqueMesh Functions::createRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                          const glm::vec3 &origin,
+                                          const SharedMMTexture &texture)
+{
+    const auto &prog = getShaderPrograms().getRoomQuadUColorShader();
+    using Mesh = RoomQuadMesh<RoomQuadVert>;
+    auto mesh = std::make_unique<Mesh>(shared_from_this(), prog, origin, batch);
+    return UniqueMesh{std::make_unique<TexturedRenderable>(texture, std::move(mesh))};
+}
+
+UniqueMesh Functions::createAtlasRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                               const glm::vec3 &origin,
+                                               const SharedMMTexture &atlas)
+{
+    const auto &prog = getShaderPrograms().getRoomQuadAtlasShader();
+    using Mesh = RoomQuadMesh<RoomQuadVert>;
+    auto mesh = std::make_unique<Mesh>(shared_from_this(), prog, origin, batch);
+    return UniqueMesh{std::make_unique<TexturedRenderable>(atlas, std::move(mesh))};
+}
+
+UniqueMesh Functions::createPlainRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                               const glm::vec3 &origin)
+{
+    const auto &prog = getShaderPrograms().getRoomQuadPlainShader();
+    using Mesh = RoomQuadMesh<RoomQuadVert, UColorPlainShader>;
+    return UniqueMesh{std::make_unique<Mesh>(shared_from_this(), prog, origin, batch)};
+}
+
+UniqueMesh Functions::createColoredRoomQuadBatch(const std::vector<ColoredRoomQuadVert> &batch,
+                                                 const glm::vec3 &origin,
+                                                 const SharedMMTexture &texture)
+{
+    const auto &prog = getShaderPrograms().getRoomQuadAColorShader();
+    using Mesh = ColoredRoomQuadMesh<ColoredRoomQuadVert>;
+    auto mesh = std::make_unique<Mesh>(shared_from_this(), prog, origin, batch);
+    return UniqueMesh{std::make_unique<TexturedRenderable>(texture, std::move(mesh))};
+}
+
+UniqueMesh Functions::createSegmentBatch(const std::vector<ColorSegment> &batch,
+                                         const glm::vec3 &origin)
+{
+    const auto &prog = getShaderPrograms().getSegmentShader();
+    using Mesh = SegmentMesh<PackedSegmentVert>;
+    return UniqueMesh{std::make_unique<Mesh>(shared_from_this(), prog, origin, batch)};
+}
+
 template<typename _VertexType, template<typename> typename _Mesh, typename _ShaderType>
 static void renderImmediate(const SharedFunctions &sharedFunctions,
                             const DrawModeEnum mode,
@@ -114,40 +180,38 @@ static void renderImmediate(const SharedFunctions &sharedFunctions,
     if (verts.empty())
         return;
 
-    static WeakVbo weak;
+    static WeakStreamingVbo weak;
     auto shared = weak.lock();
     if (shared == nullptr) {
-        weak = shared = sharedFunctions->getStaticVbos().alloc();
+        weak = shared = sharedFunctions->getStaticVbos().allocStreaming();
         if (shared == nullptr)
             throw std::runtime_error("OpenGL error: failed to alloc VBO");
     }
 
-    VBO &vbo = *shared;
-    if (!vbo) {
-        vbo.emplace(sharedFunctions);
-    }
-
     using Mesh = _Mesh<_VertexType>;
     static_assert(std::is_same_v<typename Mesh::ProgramType, _ShaderType>);
 
+    StreamingVbo::Slot &slot = shared->next(sharedFunctions);
+    VBO &vbo = slot.vbo;
     const auto before = vbo.get();
     {
         Mesh mesh{sharedFunctions, sharedShader};
         {
-            // temporarily loan our VBO to the mesh.
+            // temporarily loan the VBO (and the VAO, if any) to the mesh.
             mesh.unsafe_swapVboId(vbo);
+            mesh.unsafe_swapVaoId(slot.vao);
             assert(!vbo);
             {
-                mesh.setDynamic(mode, verts);
+                mesh.setStreaming(mode, verts, slot);
                 mesh.render(renderState);
             }
+            mesh.unsafe_swapVaoId(slot.vao);
             mesh.unsafe_swapVboId(vbo);
             assert(vbo);
         }
     }
     const auto after = vbo.get();
     assert(before == after);
-    sharedFunctions->clearVbo(vbo.get());
 }
 
 void Functions::renderPlain(const DrawModeEnum mode,
@@ -231,6 +295,7 @@ UniqueMesh Functions::createFontMesh(const SharedMMTexture &texture,
 Functions::Functions(this_is_private)
     : m_shaderPrograms{std::make_unique<ShaderPrograms>(*this)}
     , m_staticVbos{std::make_unique<StaticVbos>()}
+    , m_timerQueries{std::make_unique<TimerQueries>()}
 {}
 
 Functions::~Functions()
@@ -252,6 +317,11 @@ Functions::~Functions()
 /// only keep static weak pointers to the VBOs, and the weak pointers will
 /// expire immediately when you call this function. If you call those
 /// functions again, they'll detect the expiration and request new buffers.</li>
+///
+/// <li>Deletes the timer queries used by beginFrameStats(); they're recreated
+/// the next time it's called.</li>
+///
+/// <li>Resets the state cache.</li>
 /// </ul>
 void Functions::cleanup()
 {
@@ -261,6 +331,67 @@ void Functions::cleanup()
 
     getShaderPrograms().resetAll();
     getStaticVbos().resetAll();
+    deref(m_timerQueries).reset();
+    m_stateCache = StateCache{};
+}
+
+void Functions::resetBindings()
+{
+    if (m_stateCache.hasProgram())
+        Base::glUseProgram(0);
+    if (isCore() && m_stateCache.hasVertexArray())
+        Base::glBindVertexArray(0);
+    if (m_stateCache.hasArrayBuffer())
+        Base::glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_stateCache.forEachBoundTexture([this](const GLuint unit, const GLenum target) {
+        Base::glActiveTexture(GL_TEXTURE0 + unit);
+        Base::glBindTexture(target, 0);
+    });
+    Base::glActiveTexture(GL_TEXTURE0);
+    m_stateCache.invalidate();
+}
+
+void Functions::setBackend(const RendererBackendEnum backend)
+{
+    m_backend = backend;
+    if (isCore()) {
+        // Core profiles may have dropped wide lines entirely.
+        std::array<GLfloat, 2> range{1.f, 1.f};
+        Base::glGetFloatv(GL_ALIASED_LINE_WIDTH_RANGE, range.data());
+        m_maxLineWidth = std::max(1.f, range[1]);
+    }
+}
+
+const char *Functions::getCoreShaderMacros(const GLenum shaderType)
+{
+    // MM_INSTANCED_QUADS tells the room shaders to take the corner from gl_VertexID;
+    // see SimpleMesh::setStaticQuadInstances().
+    if (shaderType == GL_VERTEX_SHADER)
+        return "#define MM_INSTANCED_QUADS 1\n"
+               "#define attribute in\n"
+               "#define varying out\n"
+               "\n";
+
+    return "#define varying in\n"
+           "#define texture2D texture\n"
+           "out vec4 mmFragColor;\n"
+           "#define gl_FragColor mmFragColor\n"
+           "\n";
+}
+
+void Functions::beginFrameStats()
+{
+    m_frameStats = FrameStats{};
+    deref(m_timerQueries).begin();
+}
+
+FrameStats Functions::endFrameStats()
+{
+    auto &timerQueries = deref(m_timerQueries);
+    timerQueries.end();
+    FrameStats result = m_frameStats;
+    result.gpuMs = timerQueries.getLastMs();
+    return result;
 }
 
 ShaderPrograms &Functions::getShaderPrograms()
@@ -2,25 +2,31 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2019 The MMapper Authors
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <memory>
 #include <optional>
 #include <stdexcept>
+#include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
-#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
 
 #include "../../global/RuleOf5.h"
 #include "../../global/utils.h"
 #include "../OpenGLTypes.h"
+#include "StateCache.h"
 
 class OpenGL;
 
 namespace Legacy {
 
 class StaticVbos;
+class TimerQueries;
 struct ShaderPrograms;
 struct PointSizeBinder;
 
@@ -31,6 +37,8 @@ static inline GLenum toGLenum(const BufferUsageEnum usage)
         return GL_DYNAMIC_DRAW;
     case BufferUsageEnum::STATIC_DRAW:
         return GL_STATIC_DRAW;
+    case BufferUsageEnum::STREAM_DRAW:
+        return GL_STREAM_DRAW;
     }
     std::abort();
 }
@@ -39,7 +47,8 @@ static inline GLenum toGLenum(const BufferUsageEnum usage)
 // Note: This version is only suitable for drawArrays(). You'll need another function
 // to transform indices if you want to use it with drawElements().
 template<typename _VertexType>
-static inline std::vector<_VertexType> convertQuadsToTris(const std::vector<_VertexType> &quads)
+static inline void convertQuadsToTris(const std::vector<_VertexType> &quads,
+                                      std::vector<_VertexType> &triangles)
 {
     // d-c
     // |/|
@@ -47,7 +56,7 @@ static inline std::vector<_VertexType> convertQuadsToTris(const std::vector<_Ver
     const static constexpr int TRIANGLE_VERTS_PER_QUAD = 6;
     const size_t numQuads = quads.size() / VERTS_PER_QUAD;
     const size_t expected = numQuads * TRIANGLE_VERTS_PER_QUAD;
-    std::vector<_VertexType> triangles;
+    triangles.clear();
     triangles.reserve(expected);
     const auto *it = quads.data();
     for (size_t i = 0; i < numQuads; i++) {
@@ -63,6 +72,13 @@ static inline std::vector<_VertexType> convertQuadsToTris(const std::vector<_Ver
         triangles.emplace_back(a);
     }
     assert(triangles.size() == expected);
+}
+
+template<typename _VertexType>
+static inline std::vector<_VertexType> convertQuadsToTris(const std::vector<_VertexType> &quads)
+{
+    std::vector<_VertexType> triangles;
+    convertQuadsToTris(quads, triangles);
     return triangles;
 }
 
@@ -73,16 +89,30 @@ using WeakFunctions = std::weak_ptr<Functions>;
 /// \c Legacy::Functions implements both GL 2.0 and ES 2.0 (based on a subset of
 /// GL 2.0); this is accomplished by using separate implementation files for the
 /// differences between GL 2.0 and ES 2.0.
-class NODISCARD Functions final : private QOpenGLFunctions,
+///
+/// On a GL 3.3 or ES 3.0 context it can also use the CORE backend, which needs
+/// a VAO for every draw and has no quads, but lets meshes keep their attributes
+/// and draw instances; see RendererBackendEnum. The extra functions must only
+/// be called with that backend.
+class NODISCARD Functions final : private QOpenGLExtraFunctions,
                                   public std::enable_shared_from_this<Functions>
 {
 private:
-    using Base = QOpenGLFunctions;
+    using Base = QOpenGLExtraFunctions;
+    RendererBackendEnum m_backend = RendererBackendEnum::LEGACY;
+    // only used by the CORE backend, which may not have wide lines
+    GLfloat m_maxLineWidth = 1.f;
     glm::mat4 m_viewProj = glm::mat4(1);
     Viewport m_viewport;
     float m_devicePixelRatio = 1.f;
     std::unique_ptr<ShaderPrograms> m_shaderPrograms;
     std::unique_ptr<StaticVbos> m_staticVbos;
+    std::unique_ptr<TimerQueries> m_timerQueries;
+    FrameStats m_frameStats;
+    StateCache m_stateCache;
+    // The size of each buffer's storage, for the memory report.
+    std::unordered_map<GLuint, size_t> m_bufferBytes;
+    size_t m_totalBufferBytes = 0;
 
 private:
     struct this_is_private final
@@ -114,9 +144,13 @@ class NODISCARD Functions final : private QOpenGLFunctions,
 public:
     using Base::initializeOpenGLFunctions;
 
+    NODISCARD RendererBackendEnum getBackend() const { return m_backend; }
+    NODISCARD bool isCore() const { return m_backend == RendererBackendEnum::CORE; }
+    /// Call after initializeOpenGLFunctions(), and before creating any shaders or meshes.
+    void setBackend(RendererBackendEnum backend);
+
 public:
     using Base::glAttachShader;
-    using Base::glBindBuffer;
     using Base::glBlendFunc;
     using Base::glBlendFuncSeparate;
     using Base::glBufferData;
@@ -126,8 +160,6 @@ class NODISCARD Functions final : private QOpenGLFunctions,
     using Base::glCreateProgram;
     using Base::glCreateShader;
     using Base::glCullFace;
-    using Base::glDeleteBuffers;
-    using Base::glDeleteProgram;
     using Base::glDeleteShader;
     using Base::glDepthFunc;
     using Base::glDetachShader;
@@ -148,17 +180,108 @@ class NODISCARD Functions final : private QOpenGLFunctions,
     using Base::glHint;
     using Base::glLinkProgram;
     using Base::glShaderSource;
-    using Base::glUniform1fv;
-    using Base::glUniform1iv;
-    using Base::glUniform4fv;
-    using Base::glUniform4iv;
-    using Base::glUniformMatrix4fv;
-    using Base::glUseProgram;
     using Base::glVertexAttribPointer;
 
+public:
+    // These skip the call if the state cache says it wouldn't change anything.
+    void glUseProgram(const GLuint program)
+    {
+        if (m_stateCache.useProgram(program))
+            Base::glUseProgram(program);
+    }
+    void glBindBuffer(const GLenum target, const GLuint buffer)
+    {
+        if (target != GL_ARRAY_BUFFER || m_stateCache.bindArrayBuffer(buffer))
+            Base::glBindBuffer(target, buffer);
+    }
+    void glBindVertexArray(const GLuint vao)
+    {
+        assert(isCore());
+        if (m_stateCache.bindVertexArray(vao))
+            Base::glBindVertexArray(vao);
+    }
+    void bindTexture(const GLuint unit, const GLenum target, const GLuint texture)
+    {
+        if (!m_stateCache.bindTexture(unit, target, texture))
+            return;
+        if (m_stateCache.activeTexture(unit))
+            Base::glActiveTexture(GL_TEXTURE0 + unit);
+        Base::glBindTexture(target, texture);
+    }
+    void glDeleteBuffers(const GLsizei n, const GLuint *const buffers)
+    {
+        for (GLsizei i = 0; i < n; ++i) {
+            m_stateCache.onDeleteBuffer(buffers[i]);
+            forgetBuffer(buffers[i]);
+        }
+        Base::glDeleteBuffers(n, buffers);
+    }
+    void glDeleteVertexArrays(const GLsizei n, const GLuint *const arrays)
+    {
+        assert(isCore());
+        for (GLsizei i = 0; i < n; ++i)
+            m_stateCache.onDeleteVertexArray(arrays[i]);
+        Base::glDeleteVertexArrays(n, arrays);
+    }
+    void glDeleteProgram(const GLuint program)
+    {
+        m_stateCache.onDeleteProgram(program);
+        Base::glDeleteProgram(program);
+    }
+
+    void glUniform1fv(const GLint location, const GLsizei count, const GLfloat *const value)
+    {
+        if (m_stateCache.setUniform(location, value, sizeof(GLfloat) * toSize(count)))
+            Base::glUniform1fv(location, count, value);
+    }
+    void glUniform1iv(const GLint location, const GLsizei count, const GLint *const value)
+    {
+        if (m_stateCache.setUniform(location, value, sizeof(GLint) * toSize(count)))
+            Base::glUniform1iv(location, count, value);
+    }
+    void glUniform4fv(const GLint location, const GLsizei count, const GLfloat *const value)
+    {
+        if (m_stateCache.setUniform(location, value, 4 * sizeof(GLfloat) * toSize(count)))
+            Base::glUniform4fv(location, count, value);
+    }
+    void glUniform4iv(const GLint location, const GLsizei count, const GLint *const value)
+    {
+        if (m_stateCache.setUniform(location, value, 4 * sizeof(GLint) * toSize(count)))
+            Base::glUniform4iv(location, count, value);
+    }
+    void glUniformMatrix4fv(const GLint location,
+                            const GLsizei count,
+                            const GLboolean transpose,
+                            const GLfloat *const value)
+    {
+        if (transpose != GL_FALSE
+            || m_stateCache.setUniform(location, value, 16 * sizeof(GLfloat) * toSize(count)))
+            Base::glUniformMatrix4fv(location, count, transpose, value);
+    }
+
+    /// Unbinds what the state cache left bound and forgets the rest; call this
+    /// before anything that doesn't go through Functions uses the context.
+    void resetBindings();
+
+private:
+    NODISCARD static size_t toSize(const GLsizei count)
+    {
+        return static_cast<size_t>(std::max(count, 0));
+    }
+
 public:
     // OpenGL man page says "Only width 1 is guaranteed to be supported."
-    void glLineWidth(const GLfloat lineWidth) { Base::glLineWidth(scalef(lineWidth)); }
+    void glLineWidth(const GLfloat lineWidth)
+    {
+        const GLfloat width = scalef(lineWidth);
+        Base::glLineWidth(isCore() ? std::min(width, m_maxLineWidth) : width);
+    }
+
+public:
+    // CORE backend only
+    using Base::glDrawArraysInstanced;
+    using Base::glGenVertexArrays;
+    using Base::glVertexAttribDivisor;
 
 public:
     void glViewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height)
@@ -203,6 +326,35 @@ class NODISCARD Functions final : private QOpenGLFunctions,
 
     StaticVbos &getStaticVbos();
 
+public:
+    /// Resets the counters and starts timing the GPU work that follows.
+    void beginFrameStats();
+    /// Stops the GPU timer; the counters cover everything since beginFrameStats().
+    NODISCARD FrameStats endFrameStats();
+    void countDrawCall(const GLsizei numVerts)
+    {
+        ++m_frameStats.drawCalls;
+        m_frameStats.vertices += static_cast<size_t>(numVerts);
+    }
+
+public:
+    /// What the vertex buffers' storage adds up to, as far as the uploads tell.
+    NODISCARD size_t getNumBuffers() const { return m_bufferBytes.size(); }
+    NODISCARD size_t getTotalBufferBytes() const { return m_totalBufferBytes; }
+
+private:
+    void setBufferBytes(const GLuint vbo, const size_t bytes)
+    {
+        size_t &ref = m_bufferBytes[vbo];
+        m_totalBufferBytes = m_totalBufferBytes - ref + bytes;
+        ref = bytes;
+    }
+    void forgetBuffer(const GLuint vbo)
+    {
+        setBufferBytes(vbo, 0);
+        m_bufferBytes.erase(vbo);
+    }
+
 private:
     friend PointSizeBinder;
     /// platform-specific (ES vs GL)
@@ -214,8 +366,12 @@ class NODISCARD Functions final : private QOpenGLFunctions,
     bool tryEnableMultisampling(int requestedSamples);
 
 public:
-    /// platform-specific (ES vs GL)
-    static const char *getShaderVersion();
+    /// platform-specific (ES vs GL); the #version line, and the macros that let the
+    /// GLSL 1.10 / ES 1.00 shaders compile with the CORE backend.
+    NODISCARD std::string getShaderPreamble(GLenum shaderType) const;
+
+private:
+    NODISCARD static const char *getCoreShaderMacros(GLenum shaderType);
 
 private:
     template<typename _VertexType>
@@ -226,15 +382,34 @@ class NODISCARD Functions final : private QOpenGLFunctions,
         const auto numVerts = static_cast<GLsizei>(batch.size());
         const auto vertSize = static_cast<GLsizei>(sizeof(_VertexType));
         const auto numBytes = numVerts * vertSize;
-        Base::glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        m_frameStats.uploadedBytes += static_cast<size_t>(numBytes);
+        setBufferBytes(vbo, static_cast<size_t>(numBytes));
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
         Base::glBufferData(GL_ARRAY_BUFFER, numBytes, batch.data(), Legacy::toGLenum(usage));
-        Base::glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return numVerts;
+    }
+
+    template<typename _VertexType>
+    GLsizei setStreamingVbo_internal(const GLuint vbo,
+                                     GLsizeiptr &capacity,
+                                     const std::vector<_VertexType> &batch)
+    {
+        const auto numVerts = static_cast<GLsizei>(batch.size());
+        const auto numBytes = static_cast<GLsizeiptr>(batch.size() * sizeof(_VertexType));
+        capacity = std::max(capacity, numBytes);
+        m_frameStats.uploadedBytes += static_cast<size_t>(numBytes);
+        setBufferBytes(vbo, static_cast<size_t>(capacity));
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        // Orphaning the old storage lets the driver keep drawing from it
+        // instead of waiting for the draws that use it to finish.
+        Base::glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        Base::glBufferSubData(GL_ARRAY_BUFFER, 0, numBytes, batch.data());
         return numVerts;
     }
 
 public:
     /// platform-specific (ES vs GL)
-    static bool canRenderQuads();
+    NODISCARD bool canRenderQuads() const;
 
     /// platform-specific (ES vs GL)
     static std::optional<GLenum> toGLenum(DrawModeEnum mode);
@@ -265,11 +440,29 @@ class NODISCARD Functions final : private QOpenGLFunctions,
         return std::pair(mode, setVbo_internal(vbo, batch, usage));
     }
 
+    /// Like setVbo(), but for a buffer of a StreamingVbo; the capacity only grows,
+    /// so uploading the same amount of geometry every frame doesn't reallocate.
+    template<typename T>
+    std::pair<DrawModeEnum, GLsizei> setStreamingVbo(const DrawModeEnum mode,
+                                                     const GLuint vbo,
+                                                     GLsizeiptr &capacity,
+                                                     const std::vector<T> &batch)
+    {
+        if (mode == DrawModeEnum::QUADS && !canRenderQuads()) {
+            // only used on the rendering thread
+            static std::vector<T> triangles;
+            convertQuadsToTris(batch, triangles);
+            return std::pair(DrawModeEnum::TRIANGLES,
+                             setStreamingVbo_internal(vbo, capacity, triangles));
+        }
+        return std::pair(mode, setStreamingVbo_internal(vbo, capacity, batch));
+    }
+
     void clearVbo(const GLuint vbo, const BufferUsageEnum usage = BufferUsageEnum::DYNAMIC_DRAW)
     {
-        Base::glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        setBufferBytes(vbo, 0);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
         Base::glBufferData(GL_ARRAY_BUFFER, 0, nullptr, Legacy::toGLenum(usage));
-        Base::glBindBuffer(GL_ARRAY_BUFFER, 0);
     }
 
 public:
@@ -278,12 +471,30 @@ class NODISCARD Functions final : private QOpenGLFunctions,
 public:
     UniqueMesh createPlainBatch(DrawModeEnum mode, const std::vector<glm::vec3> &batch);
     UniqueMesh createColoredBatch(DrawModeEnum mode, const std::vector<ColorVert> &batch);
+    UniqueMesh createPackedColoredBatch(DrawModeEnum mode,
+                                        const std::vector<PackedColorVert> &batch,
+                                        const glm::vec3 &origin);
     UniqueMesh createTexturedBatch(DrawModeEnum mode,
                                    const std::vector<TexVert> &batch,
                                    const SharedMMTexture &texture);
     UniqueMesh createColoredTexturedBatch(DrawModeEnum mode,
                                           const std::vector<ColoredTexVert> &batch,
                                           const SharedMMTexture &texture);
+    UniqueMesh createRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                   const glm::vec3 &origin);
+    UniqueMesh createRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                   const glm::vec3 &origin,
+                                   const SharedMMTexture &texture);
+    UniqueMesh createAtlasRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                        const glm::vec3 &origin,
+                                        const SharedMMTexture &atlas);
+    UniqueMesh createPlainRoomQuadBatch(const std::vector<RoomQuadVert> &batch,
+                                        const glm::vec3 &origin);
+    UniqueMesh createColoredRoomQuadBatch(const std::vector<ColoredRoomQuadVert> &batch,
+                                          const glm::vec3 &origin,
+                                          const SharedMMTexture &texture);
+    UniqueMesh createSegmentBatch(const std::vector<ColorSegment> &batch,
+                                  const glm::vec3 &origin);
 
 public:
     UniqueMesh createFontMesh(const SharedMMTexture &texture,
@@ -2,6 +2,9 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2019 The MMapper Authors
 
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
 #include "../../global/utils.h"
 #include "Legacy.h"
 #include "Shaders.h"
@@ -56,7 +59,6 @@ class NODISCARD PlainMesh final : public SimpleMesh<_VertexType, UColorPlainShad
         auto &attribs = boundAttribs.value();
         Functions &gl = Base::m_functions;
         gl.glDisableVertexAttribArray(attribs.vertPos);
-        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
         boundAttribs.reset();
     }
 };
@@ -112,11 +114,83 @@ class NODISCARD ColoredMesh final : public SimpleMesh<_VertexType, AColorPlainSh
         Functions &gl = Base::m_functions;
         gl.glDisableVertexAttribArray(attribs.colorPos);
         gl.glDisableVertexAttribArray(attribs.vertPos);
-        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
         boundAttribs.reset();
     }
 }; // namespace Legacy
 
+// Like ColoredMesh, but the positions are fixed point and relative to the origin;
+// see PackedColorVert.
+template<typename _VertexType>
+class NODISCARD PackedColoredMesh final : public SimpleMesh<_VertexType, AColorPlainShader>
+{
+public:
+    using Base = SimpleMesh<_VertexType, AColorPlainShader>;
+
+private:
+    const glm::mat4 m_model;
+
+public:
+    explicit PackedColoredMesh(const SharedFunctions &sharedFunctions,
+                               const std::shared_ptr<AColorPlainShader> &sharedProgram,
+                               const DrawModeEnum mode,
+                               const glm::vec3 &origin,
+                               const std::vector<_VertexType> &verts)
+        : Base(sharedFunctions, sharedProgram)
+        , m_model{glm::scale(glm::translate(glm::mat4(1), origin),
+                             glm::vec3{1.f / _VertexType::SCALE})}
+    {
+        Base::setStatic(mode, verts);
+    }
+
+private:
+    struct NODISCARD Attribs final
+    {
+        GLuint colorPos = INVALID_ATTRIB_LOCATION;
+        GLuint vertPos = INVALID_ATTRIB_LOCATION;
+
+        static Attribs getLocations(AbstractShaderProgram &fontShader)
+        {
+            Attribs result;
+            result.colorPos = fontShader.getAttribLocation("aColor");
+            result.vertPos = fontShader.getAttribLocation("aVert");
+            return result;
+        }
+    };
+
+    std::optional<Attribs> boundAttribs;
+
+    glm::mat4 virt_getModelMatrix() const override { return m_model; }
+
+    void virt_bind() override
+    {
+        const auto vertSize = static_cast<GLsizei>(sizeof(_VertexType));
+        static_assert(sizeof(std::declval<_VertexType>().color) == 4 * sizeof(uint8_t));
+        static_assert(sizeof(std::declval<_VertexType>().vert) == 3 * sizeof(GLshort));
+        static_assert(sizeof(_VertexType) % 4 == 0);
+
+        Functions &gl = Base::m_functions;
+        const auto attribs = Attribs::getLocations(Base::m_program);
+        gl.glBindBuffer(GL_ARRAY_BUFFER, Base::m_vbo.get());
+        gl.enableAttrib(attribs.colorPos, 4, GL_UNSIGNED_BYTE, GL_TRUE, vertSize, VPO(color));
+        gl.enableAttrib(attribs.vertPos, 3, GL_SHORT, GL_FALSE, vertSize, VPO(vert));
+        boundAttribs = attribs;
+    }
+
+    void virt_unbind() override
+    {
+        if (!boundAttribs) {
+            assert(false);
+            return;
+        }
+
+        auto &attribs = boundAttribs.value();
+        Functions &gl = Base::m_functions;
+        gl.glDisableVertexAttribArray(attribs.colorPos);
+        gl.glDisableVertexAttribArray(attribs.vertPos);
+        boundAttribs.reset();
+    }
+};
+
 // Textured mesh with color modulated by uniform
 template<typename _VertexType>
 class NODISCARD TexturedMesh final : public SimpleMesh<_VertexType, UColorTexturedShader>
@@ -168,7 +242,6 @@ class NODISCARD TexturedMesh final : public SimpleMesh<_VertexType, UColorTextur
         Functions &gl = Base::m_functions;
         gl.glDisableVertexAttribArray(attribs.texPos);
         gl.glDisableVertexAttribArray(attribs.vertPos);
-        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
         boundAttribs.reset();
     }
 };
@@ -229,7 +302,249 @@ class NODISCARD ColoredTexturedMesh final : public SimpleMesh<_VertexType, AColo
         gl.glDisableVertexAttribArray(attribs.colorPos);
         gl.glDisableVertexAttribArray(attribs.texPos);
         gl.glDisableVertexAttribArray(attribs.vertPos);
-        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
+        boundAttribs.reset();
+    }
+};
+
+// Room quads with color modulated by uniform; see RoomQuadVert.
+// They're textured unless the program is UColorPlainShader.
+template<typename _VertexType, typename _ProgramType = UColorTexturedShader>
+class NODISCARD RoomQuadMesh final : public SimpleMesh<_VertexType, _ProgramType>
+{
+public:
+    using Base = SimpleMesh<_VertexType, _ProgramType>;
+
+private:
+    const glm::mat4 m_model;
+
+public:
+    explicit RoomQuadMesh(const SharedFunctions &sharedFunctions,
+                          const std::shared_ptr<_ProgramType> &sharedProgram,
+                          const glm::vec3 &origin,
+                          const std::vector<_VertexType> &verts)
+        : Base(sharedFunctions, sharedProgram)
+        , m_model{glm::translate(glm::mat4(1), origin)}
+    {
+        Base::setStaticQuadInstances(verts);
+    }
+
+private:
+    struct NODISCARD Attribs final
+    {
+        GLuint roomPos = INVALID_ATTRIB_LOCATION;
+
+        static Attribs getLocations(AbstractShaderProgram &fontShader)
+        {
+            Attribs result;
+            result.roomPos = fontShader.getAttribLocation("aRoom");
+            return result;
+        }
+    };
+
+    std::optional<Attribs> boundAttribs;
+
+    glm::mat4 virt_getModelMatrix() const override { return m_model; }
+
+    void virt_bind() override
+    {
+        static_assert(sizeof(std::declval<_VertexType>()) == 4 * sizeof(uint8_t));
+
+        Functions &gl = Base::m_functions;
+        const auto attribs = Attribs::getLocations(Base::m_program);
+        gl.glBindBuffer(GL_ARRAY_BUFFER, Base::m_vbo.get());
+        gl.enableAttrib(attribs.roomPos, 4, GL_UNSIGNED_BYTE, GL_FALSE, 0, nullptr);
+        if (Base::isInstanced())
+            gl.glVertexAttribDivisor(attribs.roomPos, 1);
+        boundAttribs = attribs;
+    }
+
+    void virt_unbind() override
+    {
+        if (!boundAttribs) {
+            assert(false);
+            return;
+        }
+
+        auto &attribs = boundAttribs.value();
+        Functions &gl = Base::m_functions;
+        gl.glDisableVertexAttribArray(attribs.roomPos);
+        boundAttribs.reset();
+    }
+};
+
+// Textured room quads with color modulated by color attribute; see RoomQuadVert.
+template<typename _VertexType>
+class NODISCARD ColoredRoomQuadMesh final : public SimpleMesh<_VertexType, AColorTexturedShader>
+{
+public:
+    using Base = SimpleMesh<_VertexType, AColorTexturedShader>;
+
+private:
+    const glm::mat4 m_model;
+
+public:
+    explicit ColoredRoomQuadMesh(const SharedFunctions &sharedFunctions,
+                                 const std::shared_ptr<AColorTexturedShader> &sharedProgram,
+                                 const glm::vec3 &origin,
+                                 const std::vector<_VertexType> &verts)
+        : Base(sharedFunctions, sharedProgram)
+        , m_model{glm::translate(glm::mat4(1), origin)}
+    {
+        Base::setStaticQuadInstances(verts);
+    }
+
+private:
+    struct NODISCARD Attribs final
+    {
+        GLuint colorPos = INVALID_ATTRIB_LOCATION;
+        GLuint roomPos = INVALID_ATTRIB_LOCATION;
+
+        static Attribs getLocations(AColorTexturedShader &fontShader)
+        {
+            Attribs result;
+            result.colorPos = fontShader.getAttribLocation("aColor");
+            result.roomPos = fontShader.getAttribLocation("aRoom");
+            return result;
+        }
+    };
+
+    std::optional<Attribs> boundAttribs;
+
+    glm::mat4 virt_getModelMatrix() const override { return m_model; }
+
+    void virt_bind() override
+    {
+        const auto vertSize = static_cast<GLsizei>(sizeof(_VertexType));
+        static_assert(sizeof(std::declval<_VertexType>().color) == 4 * sizeof(uint8_t));
+        static_assert(sizeof(std::declval<_VertexType>().quad) == 4 * sizeof(uint8_t));
+
+        Functions &gl = Base::m_functions;
+        const auto attribs = Attribs::getLocations(Base::m_program);
+        gl.glBindBuffer(GL_ARRAY_BUFFER, Base::m_vbo.get());
+        gl.enableAttrib(attribs.colorPos, 4, GL_UNSIGNED_BYTE, GL_TRUE, vertSize, VPO(color));
+        gl.enableAttrib(attribs.roomPos, 4, GL_UNSIGNED_BYTE, GL_FALSE, vertSize, VPO(quad));
+        if (Base::isInstanced()) {
+            gl.glVertexAttribDivisor(attribs.colorPos, 1);
+            gl.glVertexAttribDivisor(attribs.roomPos, 1);
+        }
+        boundAttribs = attribs;
+    }
+
+    void virt_unbind() override
+    {
+        if (!boundAttribs) {
+            assert(false);
+            return;
+        }
+
+        auto &attribs = boundAttribs.value();
+        Functions &gl = Base::m_functions;
+        gl.glDisableVertexAttribArray(attribs.colorPos);
+        gl.glDisableVertexAttribArray(attribs.roomPos);
+        boundAttribs.reset();
+    }
+};
+
+// Line segments that the vertex shader widens into quads; see PackedSegmentVert.
+template<typename _VertexType>
+class NODISCARD SegmentMesh final : public SimpleMesh<_VertexType, SegmentShader>
+{
+public:
+    using Base = SimpleMesh<_VertexType, SegmentShader>;
+
+private:
+    const glm::mat4 m_model;
+
+public:
+    explicit SegmentMesh(const SharedFunctions &sharedFunctions,
+                         const std::shared_ptr<SegmentShader> &sharedProgram,
+                         const glm::vec3 &origin,
+                         const std::vector<ColorSegment> &segments)
+        : Base(sharedFunctions, sharedProgram)
+        , m_model{glm::scale(glm::translate(glm::mat4(1), origin),
+                             glm::vec3{1.f / PackedColorVert::SCALE})}
+    {
+        std::vector<_VertexType> verts;
+        if (Base::m_functions.isCore()) {
+            verts.reserve(segments.size());
+            for (const ColorSegment &segment : segments)
+                verts.emplace_back(segment, origin, glm::ivec2{0, 0});
+            Base::setStaticInstances(verts);
+            return;
+        }
+
+        verts.reserve(segments.size() * VERTS_PER_QUAD);
+        for (const ColorSegment &segment : segments) {
+            // ccw, like the room quads
+            verts.emplace_back(segment, origin, glm::ivec2{0, 0});
+            verts.emplace_back(segment, origin, glm::ivec2{1, 0});
+            verts.emplace_back(segment, origin, glm::ivec2{1, 1});
+            verts.emplace_back(segment, origin, glm::ivec2{0, 1});
+        }
+        Base::setStatic(DrawModeEnum::QUADS, verts);
+    }
+
+private:
+    struct NODISCARD Attribs final
+    {
+        GLuint colorPos = INVALID_ATTRIB_LOCATION;
+        GLuint fromPos = INVALID_ATTRIB_LOCATION;
+        GLuint toPos = INVALID_ATTRIB_LOCATION;
+        GLuint paramsPos = INVALID_ATTRIB_LOCATION;
+
+        static Attribs getLocations(AbstractShaderProgram &shader)
+        {
+            Attribs result;
+            result.colorPos = shader.getAttribLocation("aColor");
+            result.fromPos = shader.getAttribLocation("aFrom");
+            result.toPos = shader.getAttribLocation("aTo");
+            result.paramsPos = shader.getAttribLocation("aParams");
+            return result;
+        }
+    };
+
+    std::optional<Attribs> boundAttribs;
+
+    glm::mat4 virt_getModelMatrix() const override { return m_model; }
+
+    void virt_bind() override
+    {
+        const auto vertSize = static_cast<GLsizei>(sizeof(_VertexType));
+        static_assert(sizeof(std::declval<_VertexType>().color) == 4 * sizeof(uint8_t));
+        static_assert(sizeof(std::declval<_VertexType>().from) == 3 * sizeof(GLshort));
+        static_assert(sizeof(std::declval<_VertexType>().to) == 3 * sizeof(GLshort));
+        static_assert(offsetof(_VertexType, middleAlpha) == offsetof(_VertexType, corner) + 1);
+        static_assert(sizeof(_VertexType) % 4 == 0);
+
+        Functions &gl = Base::m_functions;
+        const auto attribs = Attribs::getLocations(Base::m_program);
+        gl.glBindBuffer(GL_ARRAY_BUFFER, Base::m_vbo.get());
+        gl.enableAttrib(attribs.colorPos, 4, GL_UNSIGNED_BYTE, GL_TRUE, vertSize, VPO(color));
+        gl.enableAttrib(attribs.fromPos, 3, GL_SHORT, GL_FALSE, vertSize, VPO(from));
+        gl.enableAttrib(attribs.toPos, 3, GL_SHORT, GL_FALSE, vertSize, VPO(to));
+        gl.enableAttrib(attribs.paramsPos, 2, GL_UNSIGNED_BYTE, GL_FALSE, vertSize, VPO(corner));
+        if (Base::isInstanced()) {
+            gl.glVertexAttribDivisor(attribs.colorPos, 1);
+            gl.glVertexAttribDivisor(attribs.fromPos, 1);
+            gl.glVertexAttribDivisor(attribs.toPos, 1);
+            gl.glVertexAttribDivisor(attribs.paramsPos, 1);
+        }
+        boundAttribs = attribs;
+    }
+
+    void virt_unbind() override
+    {
+        if (!boundAttribs) {
+            assert(false);
+            return;
+        }
+
+        auto &attribs = boundAttribs.value();
+        Functions &gl = Base::m_functions;
+        gl.glDisableVertexAttribArray(attribs.colorPos);
+        gl.glDisableVertexAttribArray(attribs.fromPos);
+        gl.glDisableVertexAttribArray(attribs.toPos);
+        gl.glDisableVertexAttribArray(attribs.paramsPos);
         boundAttribs.reset();
     }
 };
@@ -285,7 +600,6 @@ class NODISCARD PointMesh final : public SimpleMesh<_VertexType, PointShader>
         Functions &gl = Base::m_functions;
         gl.glDisableVertexAttribArray(attribs.colorPos);
         gl.glDisableVertexAttribArray(attribs.vertPos);
-        gl.glBindBuffer(GL_ARRAY_BUFFER, 0);
         boundAttribs.reset();
     }
 };
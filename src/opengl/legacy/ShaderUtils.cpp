@@ -178,9 +178,8 @@ static GLuint compileShader(Functions &gl, const GLenum type, const Source &sour
     // NOTE: GLES 2.0 required `const char**` instead of `const char*const*`,
     // so Qt uses the least common denominator without the middle const;
     // that's the reason the `ptrs` array below is not `const`.
-    std::array<const char *, 3> ptrs = {Functions::getShaderVersion(),
-                                        "#line 1\n",
-                                        source.source.c_str()};
+    const std::string preamble = gl.getShaderPreamble(type);
+    std::array<const char *, 3> ptrs = {preamble.c_str(), "#line 1\n", source.source.c_str()};
     gl.glShaderSource(shaderId, ptrs.size(), ptrs.data(), nullptr);
     gl.glCompileShader(shaderId);
     checkShaderInfo(gl, shaderId);
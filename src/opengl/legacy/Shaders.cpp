@@ -31,6 +31,7 @@ AColorTexturedShader::~AColorTexturedShader() = default;
 UColorTexturedShader::~UColorTexturedShader() = default;
 FontShader::~FontShader() = default;
 PointShader::~PointShader() = default;
+SegmentShader::~SegmentShader() = default;
 
 // essentially a private member of ShaderPrograms
 template<typename T>
@@ -80,6 +81,26 @@ const std::shared_ptr<UColorTexturedShader> &ShaderPrograms::getTexturedUColorSh
     return getInitialized<UColorTexturedShader>(uTexturedShader, getFunctions(), "tex/ucolor");
 }
 
+const std::shared_ptr<UColorTexturedShader> &ShaderPrograms::getRoomQuadUColorShader()
+{
+    return getInitialized<UColorTexturedShader>(uRoomQuadShader, getFunctions(), "room/ucolor");
+}
+
+const std::shared_ptr<AColorTexturedShader> &ShaderPrograms::getRoomQuadAColorShader()
+{
+    return getInitialized<AColorTexturedShader>(aRoomQuadShader, getFunctions(), "room/acolor");
+}
+
+const std::shared_ptr<UColorTexturedShader> &ShaderPrograms::getRoomQuadAtlasShader()
+{
+    return getInitialized<UColorTexturedShader>(atlasRoomQuadShader, getFunctions(), "room/atlas");
+}
+
+const std::shared_ptr<UColorPlainShader> &ShaderPrograms::getRoomQuadPlainShader()
+{
+    return getInitialized<UColorPlainShader>(plainRoomQuadShader, getFunctions(), "room/plain");
+}
+
 const std::shared_ptr<FontShader> &ShaderPrograms::getFontShader()
 {
     return getInitialized<FontShader>(font, getFunctions(), "font");
@@ -90,4 +111,9 @@ const std::shared_ptr<PointShader> &ShaderPrograms::getPointShader()
     return getInitialized<PointShader>(point, getFunctions(), "point");
 }
 
+const std::shared_ptr<SegmentShader> &ShaderPrograms::getSegmentShader()
+{
+    return getInitialized<SegmentShader>(segment, getFunctions(), "segment");
+}
+
 } // namespace Legacy
@@ -109,6 +109,30 @@ struct PointShader final : public AbstractShaderProgram
     }
 };
 
+struct SegmentShader final : public AbstractShaderProgram
+{
+private:
+    using Base = AbstractShaderProgram;
+
+public:
+    using Base::AbstractShaderProgram;
+
+    ~SegmentShader() override;
+
+protected:
+    void virt_setUniforms(const glm::mat4 &mvp, const GLRenderState::Uniforms &uniforms) final
+    {
+        auto functions = Base::m_functions.lock();
+
+        setColor("uColor", uniforms.color);
+        setMatrix("uMVP", mvp);
+        setViewport("uPhysViewport", deref(functions).getPhysicalViewport());
+        // The width is set by setUniforms() if the render state has one.
+        if (!uniforms.lineWidth)
+            setLineWidth(1.f);
+    }
+};
+
 /* owned by Functions */
 struct ShaderPrograms final
 {
@@ -118,8 +142,13 @@ struct ShaderPrograms final
     std::shared_ptr<UColorPlainShader> uColorShader;
     std::shared_ptr<AColorTexturedShader> aTexturedShader;
     std::shared_ptr<UColorTexturedShader> uTexturedShader;
+    std::shared_ptr<UColorTexturedShader> uRoomQuadShader;
+    std::shared_ptr<AColorTexturedShader> aRoomQuadShader;
+    std::shared_ptr<UColorTexturedShader> atlasRoomQuadShader;
+    std::shared_ptr<UColorPlainShader> plainRoomQuadShader;
     std::shared_ptr<FontShader> font;
     std::shared_ptr<PointShader> point;
+    std::shared_ptr<SegmentShader> segment;
 
 public:
     explicit ShaderPrograms(Functions &functions)
@@ -138,8 +167,13 @@ struct ShaderPrograms final
         uColorShader.reset();
         aTexturedShader.reset();
         uTexturedShader.reset();
+        uRoomQuadShader.reset();
+        aRoomQuadShader.reset();
+        atlasRoomQuadShader.reset();
+        plainRoomQuadShader.reset();
         font.reset();
         point.reset();
+        segment.reset();
     }
 
 public:
@@ -151,8 +185,16 @@ struct ShaderPrograms final
     const std::shared_ptr<AColorTexturedShader> &getTexturedAColorShader();
     // uniform color + textured (aka "Textured")
     const std::shared_ptr<UColorTexturedShader> &getTexturedUColorShader();
+    // same uniforms as the textured shaders, but the vertices are RoomQuadVert
+    const std::shared_ptr<UColorTexturedShader> &getRoomQuadUColorShader();
+    const std::shared_ptr<AColorTexturedShader> &getRoomQuadAColorShader();
+    const std::shared_ptr<UColorTexturedShader> &getRoomQuadAtlasShader();
+    // same uniforms as the plain uniform color shader, but the vertices are RoomQuadVert
+    const std::shared_ptr<UColorPlainShader> &getRoomQuadPlainShader();
     const std::shared_ptr<FontShader> &getFontShader();
     const std::shared_ptr<PointShader> &getPointShader();
+    // PackedSegmentVert, widened to the line width by the vertex shader
+    const std::shared_ptr<SegmentShader> &getSegmentShader();
 };
 
 } // namespace Legacy
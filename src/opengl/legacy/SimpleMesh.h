@@ -25,7 +25,14 @@ class NODISCARD SimpleMesh : public IRenderable
     const std::shared_ptr<_ProgramType> m_shared_program;
     _ProgramType &m_program;
     VBO m_vbo;
+    // CORE backend only
+    VAO m_vao;
+    // the VAO has this mesh's attributes and buffer
+    bool m_vaoReady = false;
+    // one vertex per quad; see setStaticQuadInstances()
+    bool m_instancedQuads = false;
     DrawModeEnum m_drawMode = DrawModeEnum::INVALID;
+    // or instances
     GLsizei m_numVerts = 0;
 
 public:
@@ -79,9 +86,23 @@ class NODISCARD SimpleMesh : public IRenderable
     void unbindAttribs() { virt_unbind(); }
     virtual void virt_bind() = 0;
     virtual void virt_unbind() = 0;
+    // Meshes with vertices relative to an origin move them into place here.
+    virtual glm::mat4 virt_getModelMatrix() const { return glm::mat4(1); }
+
+protected:
+    NODISCARD bool isInstanced() const { return m_instancedQuads; }
 
 public:
-    void unsafe_swapVboId(VBO &vbo) { return m_vbo.unsafe_swapVboId(vbo); }
+    void unsafe_swapVboId(VBO &vbo)
+    {
+        m_vaoReady = false;
+        return m_vbo.unsafe_swapVboId(vbo);
+    }
+    void unsafe_swapVaoId(VAO &vao)
+    {
+        m_vaoReady = false;
+        return m_vao.unsafe_swapVaoId(vao);
+    }
 
 public:
     void setDynamic(const DrawModeEnum mode, const std::vector<_VertexType> &verts)
@@ -93,6 +114,50 @@ class NODISCARD SimpleMesh : public IRenderable
         setCommon(mode, verts, BufferUsageEnum::STATIC_DRAW);
     }
 
+    /// Like setStatic(QUADS, verts), but with the CORE backend only the first vertex
+    /// of each quad is uploaded, and every quad is drawn as an instance of a 4-vertex
+    /// triangle strip. The vertex shader has to take the corner from gl_VertexID
+    /// (see MM_INSTANCED_QUADS), and the mesh must give its attributes a divisor of 1.
+    void setStaticQuadInstances(const std::vector<_VertexType> &verts)
+    {
+        if (!m_functions.isCore()) {
+            setStatic(DrawModeEnum::QUADS, verts);
+            return;
+        }
+
+        assert(verts.size() % VERTS_PER_QUAD == 0);
+        std::vector<_VertexType> instances;
+        instances.reserve(verts.size() / VERTS_PER_QUAD);
+        for (size_t i = 0; i < verts.size(); i += VERTS_PER_QUAD)
+            instances.emplace_back(verts[i]);
+        setStaticInstances(instances);
+    }
+
+    /// CORE backend only: setStaticQuadInstances() with just the first vertex of each quad,
+    /// for meshes that can make the instances without making every corner first.
+    void setStaticInstances(const std::vector<_VertexType> &instances)
+    {
+        assert(m_functions.isCore());
+        // Points aren't converted, unlike quads.
+        setCommon(DrawModeEnum::POINTS, instances, BufferUsageEnum::STATIC_DRAW);
+        if (m_drawMode != DrawModeEnum::INVALID) {
+            m_drawMode = DrawModeEnum::QUADS;
+            m_instancedQuads = true;
+        }
+    }
+
+    /// Uploads to the next buffer of the stream and lends it to this mesh;
+    /// call unsafe_swapVboId() and unsafe_swapVaoId() with the slot's before and after.
+    void setStreaming(const DrawModeEnum mode,
+                      const std::vector<_VertexType> &verts,
+                      StreamingVbo::Slot &slot)
+    {
+        assert(m_vbo);
+        const auto tmp = m_functions.setStreamingVbo(mode, m_vbo.get(), slot.capacity, verts);
+        m_drawMode = tmp.first;
+        m_numVerts = tmp.second;
+    }
+
 private:
     void setCommon(const DrawModeEnum mode,
                    const std::vector<_VertexType> &verts,
@@ -103,7 +168,9 @@ class NODISCARD SimpleMesh : public IRenderable
 
         if (!m_vbo && numVerts != 0) {
             m_vbo.emplace(m_shared_functions);
+            m_vaoReady = false;
         }
+        m_instancedQuads = false;
 
         if (LOG_VBO_STATIC_UPLOADS && usage == BufferUsageEnum::STATIC_DRAW && m_vbo) {
             qInfo() << "Uploading static buffer with" << numVerts << "verts of size"
@@ -137,7 +204,10 @@ class NODISCARD SimpleMesh : public IRenderable
     {
         m_drawMode = DrawModeEnum::INVALID;
         m_numVerts = 0;
+        m_instancedQuads = false;
+        m_vaoReady = false;
         m_vbo.reset();
+        m_vao.reset();
         assert(isEmpty() && !m_vbo);
     }
 
@@ -155,16 +225,48 @@ class NODISCARD SimpleMesh : public IRenderable
 
         m_functions.checkError();
 
-        const glm::mat4 mvp = m_functions.getProjectionMatrix();
+        const glm::mat4 mvp = m_functions.getProjectionMatrix() * virt_getModelMatrix();
         auto programUnbinder = m_program.bind();
         m_program.setUniforms(mvp, renderState.uniforms);
         RenderStateBinder renderStateBinder(m_functions, renderState);
-        auto attribUnbinder = bindAttribs(); // mesh sets its own attributes
 
+        if (m_functions.isCore()) {
+            bindVao();
+            draw();
+        } else {
+            auto attribUnbinder = bindAttribs(); // mesh sets its own attributes
+            draw();
+        }
+    }
+
+private:
+    // The VAO keeps the attributes, so they're only set up again after the buffer changes.
+    void bindVao()
+    {
+        if (!m_vao) {
+            m_vao.emplace(m_shared_functions);
+            m_vaoReady = false;
+        }
+        m_functions.glBindVertexArray(m_vao.get());
+        if (!m_vaoReady) {
+            virt_bind();
+            m_vaoReady = true;
+        }
+    }
+
+    void draw()
+    {
         m_functions.checkError();
 
-        if (const auto optMode = Functions::toGLenum(m_drawMode)) {
+        if (m_instancedQuads) {
+            m_functions.glDrawArraysInstanced(GL_TRIANGLE_STRIP,
+                                              0,
+                                              static_cast<GLsizei>(VERTS_PER_QUAD),
+                                              m_numVerts);
+            m_functions.countDrawCall(m_numVerts * static_cast<GLsizei>(VERTS_PER_QUAD));
+        } else if (const auto optMode = Functions::toGLenum(m_drawMode)) {
             m_functions.glDrawArrays(optMode.value(), 0, m_numVerts);
+            m_functions.countDrawCall(m_numVerts);
         } else {
             assert(false);
         }
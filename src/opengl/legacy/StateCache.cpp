@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "StateCache.h"
+
+#include <cstring>
+
+namespace Legacy {
+
+NODISCARD static uint64_t uniformKey(const GLuint program, const GLint location)
+{
+    return (static_cast<uint64_t>(program) << 32u) | static_cast<uint32_t>(location);
+}
+
+void StateCache::invalidate()
+{
+    m_program = UNKNOWN;
+    m_arrayBuffer = UNKNOWN;
+    m_vertexArray = UNKNOWN;
+    m_activeUnit = UNKNOWN;
+    m_units.fill(TextureUnit{});
+}
+
+bool StateCache::bindTexture(const GLuint unit, const GLenum target, const GLuint texture)
+{
+    if (unit >= NUM_TEXTURE_UNITS)
+        return true;
+
+    TextureUnit &cached = m_units[unit];
+    if (cached.texture == texture && cached.target == target)
+        return false;
+
+    cached.target = target;
+    cached.texture = texture;
+    return true;
+}
+
+bool StateCache::setUniform(const GLint location, const void *const value, const size_t size)
+{
+    if (m_program == 0 || m_program == UNKNOWN || location < 0)
+        return true;
+
+    const uint64_t key = uniformKey(m_program, location);
+    if (size > MAX_UNIFORM_BYTES) {
+        m_uniforms.erase(key);
+        return true;
+    }
+
+    UniformValue &cached = m_uniforms[key];
+    if (cached.size == size && std::memcmp(cached.bytes.data(), value, size) == 0)
+        return false;
+
+    std::memcpy(cached.bytes.data(), value, size);
+    cached.size = size;
+    return true;
+}
+
+void StateCache::onDeleteProgram(const GLuint program)
+{
+    for (auto it = m_uniforms.begin(); it != m_uniforms.end();) {
+        if ((it->first >> 32u) == program)
+            it = m_uniforms.erase(it);
+        else
+            ++it;
+    }
+    if (m_program == program)
+        m_program = UNKNOWN;
+}
+
+} // namespace Legacy
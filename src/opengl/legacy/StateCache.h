@@ -0,0 +1,112 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <QtGui/qopengl.h>
+
+#include "../../global/macros.h"
+
+namespace Legacy {
+
+/// Remembers the program, buffers, textures, and uniform values that
+/// Legacy::Functions last set, so it can skip calls that wouldn't change anything.
+///
+/// This only works if every change goes through Functions; after anything else
+/// touches the context (e.g. Qt, between frames), call invalidate().
+class NODISCARD StateCache final
+{
+public:
+    // The size of GLRenderState::Textures; other units aren't cached.
+    static constexpr const size_t NUM_TEXTURE_UNITS = 2;
+
+private:
+    static constexpr const GLuint UNKNOWN = ~0u;
+    // big enough for a mat4
+    static constexpr const size_t MAX_UNIFORM_BYTES = 64;
+
+    struct NODISCARD TextureUnit final
+    {
+        GLenum target = 0;
+        GLuint texture = UNKNOWN;
+    };
+
+    struct NODISCARD UniformValue final
+    {
+        std::array<unsigned char, MAX_UNIFORM_BYTES> bytes{};
+        size_t size = 0;
+    };
+
+private:
+    GLuint m_program = UNKNOWN;
+    GLuint m_arrayBuffer = UNKNOWN;
+    GLuint m_vertexArray = UNKNOWN;
+    GLuint m_activeUnit = UNKNOWN;
+    std::array<TextureUnit, NUM_TEXTURE_UNITS> m_units{};
+    // keyed by program and location
+    std::unordered_map<uint64_t, UniformValue> m_uniforms;
+
+public:
+    /// Forgets the bindings, but not the uniforms: those belong to our programs,
+    /// which nothing else uses.
+    void invalidate();
+
+public:
+    // These return false if the call can be skipped.
+    NODISCARD bool useProgram(const GLuint program)
+    {
+        return std::exchange(m_program, program) != program;
+    }
+    NODISCARD bool bindArrayBuffer(const GLuint buffer)
+    {
+        return std::exchange(m_arrayBuffer, buffer) != buffer;
+    }
+    NODISCARD bool bindVertexArray(const GLuint vao)
+    {
+        return std::exchange(m_vertexArray, vao) != vao;
+    }
+    NODISCARD bool activeTexture(const GLuint unit)
+    {
+        return std::exchange(m_activeUnit, unit) != unit;
+    }
+    NODISCARD bool bindTexture(GLuint unit, GLenum target, GLuint texture);
+    /// Uniforms are only cached for the current program.
+    NODISCARD bool setUniform(GLint location, const void *value, size_t size);
+
+public:
+    /// Deleting a bound buffer unbinds it.
+    void onDeleteBuffer(const GLuint buffer)
+    {
+        if (m_arrayBuffer == buffer)
+            m_arrayBuffer = 0;
+    }
+    void onDeleteVertexArray(const GLuint vao)
+    {
+        if (m_vertexArray == vao)
+            m_vertexArray = 0;
+    }
+    /// The name (and its uniform locations) can be reused by the next program.
+    void onDeleteProgram(GLuint program);
+
+public:
+    NODISCARD bool hasProgram() const { return m_program != 0; }
+    NODISCARD bool hasArrayBuffer() const { return m_arrayBuffer != 0; }
+    NODISCARD bool hasVertexArray() const { return m_vertexArray != 0; }
+
+    /// Calls callback(unit, target) for every unit with a texture bound through the cache.
+    template<typename Callback>
+    void forEachBoundTexture(Callback &&callback) const
+    {
+        for (size_t i = 0; i < NUM_TEXTURE_UNITS; ++i) {
+            const TextureUnit &unit = m_units[i];
+            if (unit.texture != 0 && unit.texture != UNKNOWN)
+                callback(static_cast<GLuint>(i), unit.target);
+        }
+    }
+};
+
+} // namespace Legacy
@@ -0,0 +1,136 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "TimerQueries.h"
+
+#include <cstdint>
+#include <type_traits>
+#include <QByteArray>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+
+namespace Legacy {
+
+// The values are the same for the core, ARB and EXT versions.
+static constexpr const GLenum TIME_ELAPSED = 0x88BF;
+static constexpr const GLenum QUERY_RESULT = 0x8866;
+static constexpr const GLenum QUERY_RESULT_AVAILABLE = 0x8867;
+
+struct NODISCARD TimerQueries::Procs final
+{
+    using GenQueries = void(QOPENGLF_APIENTRYP)(GLsizei, GLuint *);
+    using DeleteQueries = void(QOPENGLF_APIENTRYP)(GLsizei, const GLuint *);
+    using BeginQuery = void(QOPENGLF_APIENTRYP)(GLenum, GLuint);
+    using EndQuery = void(QOPENGLF_APIENTRYP)(GLenum);
+    using GetQueryObjectuiv = void(QOPENGLF_APIENTRYP)(GLuint, GLenum, GLuint *);
+    using GetQueryObjectui64v = void(QOPENGLF_APIENTRYP)(GLuint, GLenum, uint64_t *);
+
+    GenQueries genQueries = nullptr;
+    DeleteQueries deleteQueries = nullptr;
+    BeginQuery beginQuery = nullptr;
+    EndQuery endQuery = nullptr;
+    GetQueryObjectuiv getQueryObjectuiv = nullptr;
+    GetQueryObjectui64v getQueryObjectui64v = nullptr;
+
+    NODISCARD static std::unique_ptr<Procs> resolve(QOpenGLContext &ctx)
+    {
+        const char *suffix = "";
+        if (ctx.isOpenGLES()) {
+            if (!ctx.hasExtension("GL_EXT_disjoint_timer_query"))
+                return nullptr;
+            suffix = "EXT";
+        } else {
+            const auto version = ctx.format().version();
+            if (version < qMakePair(3, 3) && !ctx.hasExtension("GL_ARB_timer_query"))
+                return nullptr;
+        }
+
+        const auto get = [&ctx, suffix](auto &proc, const char *const name) -> bool {
+            using Proc = std::remove_reference_t<decltype(proc)>;
+            proc = reinterpret_cast<Proc>(ctx.getProcAddress(QByteArray(name) + suffix));
+            return proc != nullptr;
+        };
+
+        auto procs = std::make_unique<Procs>();
+        if (!get(procs->genQueries, "glGenQueries")
+            || !get(procs->deleteQueries, "glDeleteQueries")
+            || !get(procs->beginQuery, "glBeginQuery")
+            || !get(procs->endQuery, "glEndQuery")
+            || !get(procs->getQueryObjectuiv, "glGetQueryObjectuiv")
+            || !get(procs->getQueryObjectui64v, "glGetQueryObjectui64v"))
+            return nullptr;
+        return procs;
+    }
+};
+
+TimerQueries::TimerQueries() = default;
+TimerQueries::~TimerQueries() = default;
+
+void TimerQueries::begin()
+{
+    if (!m_resolved) {
+        m_resolved = true;
+        if (QOpenGLContext *const ctx = QOpenGLContext::currentContext()) {
+            if ((m_procs = Procs::resolve(*ctx))) {
+                m_procs->genQueries(static_cast<GLsizei>(NUM_QUERIES), m_ids.data());
+            }
+        }
+    }
+
+    if (m_procs == nullptr || m_active)
+        return;
+
+    collect();
+    if (m_pending == NUM_QUERIES) {
+        // Every query is still in flight; skip timing this frame.
+        return;
+    }
+
+    m_procs->beginQuery(TIME_ELAPSED, m_ids[m_next]);
+    m_active = true;
+}
+
+void TimerQueries::end()
+{
+    if (!m_active)
+        return;
+
+    m_procs->endQuery(TIME_ELAPSED);
+    m_active = false;
+    m_next = (m_next + 1) % NUM_QUERIES;
+    ++m_pending;
+}
+
+void TimerQueries::collect()
+{
+    while (m_pending != 0) {
+        const GLuint id = m_ids[(m_next + NUM_QUERIES - m_pending) % NUM_QUERIES];
+        GLuint available = 0;
+        m_procs->getQueryObjectuiv(id, QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        uint64_t ns = 0;
+        m_procs->getQueryObjectui64v(id, QUERY_RESULT, &ns);
+        m_lastMs = static_cast<double>(ns) * 1e-6;
+        --m_pending;
+    }
+}
+
+void TimerQueries::reset()
+{
+    if (m_procs != nullptr) {
+        if (m_active)
+            m_procs->endQuery(TIME_ELAPSED);
+        m_procs->deleteQueries(static_cast<GLsizei>(NUM_QUERIES), m_ids.data());
+    }
+    m_procs.reset();
+    m_ids = {};
+    m_next = 0;
+    m_pending = 0;
+    m_resolved = false;
+    m_active = false;
+    m_lastMs.reset();
+}
+
+} // namespace Legacy
@@ -0,0 +1,58 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <qopengl.h>
+
+#include "../../global/RuleOf5.h"
+#include "../../global/macros.h"
+
+namespace Legacy {
+
+/// \c GL_TIME_ELAPSED queries around a frame's GL work.
+///
+/// Timer queries aren't part of GL 2.0 or ES 2.0, so the entry points are
+/// resolved from the current context (GL 3.3, \c GL_ARB_timer_query, or
+/// \c GL_EXT_disjoint_timer_query); if none is available, begin() and end() do
+/// nothing. Results are read a few frames late from a small ring of queries so
+/// the CPU never waits for the GPU.
+class NODISCARD TimerQueries final
+{
+public:
+    static constexpr const size_t NUM_QUERIES = 4;
+
+private:
+    struct Procs;
+    std::unique_ptr<Procs> m_procs;
+    std::array<GLuint, NUM_QUERIES> m_ids{};
+    size_t m_next = 0;
+    size_t m_pending = 0;
+    bool m_resolved = false;
+    bool m_active = false;
+    std::optional<double> m_lastMs;
+
+public:
+    TimerQueries();
+    ~TimerQueries();
+    DELETE_CTORS_AND_ASSIGN_OPS(TimerQueries);
+
+public:
+    /// The context must be current.
+    void begin();
+    void end();
+
+    /// GPU time of the most recent frame whose result is available.
+    NODISCARD std::optional<double> getLastMs() const { return m_lastMs; }
+
+    /// Deletes the queries; the context must be current.
+    void reset();
+
+private:
+    void collect();
+};
+
+} // namespace Legacy
@@ -37,4 +37,28 @@ GLuint VBO::get()
     return m_vbo;
 }
 
+void VAO::emplace(const SharedFunctions &sharedFunctions)
+{
+    if (!m_vao) {
+        m_weakFunctions = sharedFunctions;
+        deref(sharedFunctions).glGenVertexArrays(1, &m_vao);
+    }
+}
+
+void VAO::reset()
+{
+    if (auto vao = std::exchange(m_vao, 0)) {
+        auto sharedFunctions = std::exchange(m_weakFunctions, {}).lock();
+        deref(sharedFunctions).glDeleteVertexArrays(1, &vao);
+    }
+    assert(m_weakFunctions.lock() == nullptr);
+}
+
+GLuint VAO::get()
+{
+    if (m_vao == 0)
+        throw std::runtime_error("VAO not allocated");
+    return m_vao;
+}
+
 } // namespace Legacy
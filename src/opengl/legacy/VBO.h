@@ -2,6 +2,10 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 // Copyright (C) 2019 The MMapper Authors
 
+#include <array>
+#include <memory>
+#include <vector>
+
 #include "../../global/utils.h"
 #include "Legacy.h"
 
@@ -37,11 +41,87 @@ class NODISCARD VBO final
 using SharedVbo = std::shared_ptr<VBO>;
 using WeakVbo = std::weak_ptr<VBO>;
 
+/// A vertex array object; only the CORE backend has them.
+class NODISCARD VAO final
+{
+private:
+    WeakFunctions m_weakFunctions;
+    GLuint m_vao = 0;
+
+public:
+    VAO() = default;
+
+    DELETE_CTORS_AND_ASSIGN_OPS(VAO);
+    ~VAO() { reset(); }
+
+public:
+    void emplace(const SharedFunctions &sharedFunctions);
+    void reset();
+    GLuint get();
+
+public:
+    explicit operator bool() const { return m_vao != 0; }
+
+public:
+    void unsafe_swapVaoId(VAO &other)
+    {
+        std::swap(m_vao, other.m_vao);
+        std::swap(m_weakFunctions, other.m_weakFunctions);
+    }
+};
+
+/// A ring of VBOs for geometry that's replaced every time it's drawn.
+///
+/// GL 2.0 and ES 2.0 have neither persistent mapping nor fences, so each upload
+/// goes to the next buffer in the ring and orphans that buffer's old storage
+/// (see Functions::setStreamingVbo()); the driver doesn't have to wait for the
+/// previous draws from a buffer, and a buffer is only reused after RING_SIZE
+/// other uploads.
+class NODISCARD StreamingVbo final
+{
+public:
+    static constexpr const size_t RING_SIZE = 4;
+
+    struct NODISCARD Slot final
+    {
+        VBO vbo;
+        // The CORE backend sets up the attributes of each upload again in here.
+        VAO vao;
+        GLsizeiptr capacity = 0;
+    };
+
+private:
+    std::array<Slot, RING_SIZE> m_slots;
+    size_t m_next = 0;
+
+public:
+    StreamingVbo() = default;
+    ~StreamingVbo() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(StreamingVbo);
+
+public:
+    /// The buffer for the next upload; it's allocated if necessary.
+    NODISCARD Slot &next(const SharedFunctions &sharedFunctions)
+    {
+        Slot &slot = m_slots[m_next];
+        m_next = (m_next + 1) % RING_SIZE;
+        if (!slot.vbo) {
+            slot.vbo.emplace(sharedFunctions);
+            slot.capacity = 0;
+        }
+        return slot;
+    }
+};
+
+using SharedStreamingVbo = std::shared_ptr<StreamingVbo>;
+using WeakStreamingVbo = std::weak_ptr<StreamingVbo>;
+
 class NODISCARD StaticVbos final : private std::vector<SharedVbo>
 {
 public:
 private:
     using base = std::vector<SharedVbo>;
+    std::vector<SharedStreamingVbo> m_streaming;
 
 public:
     StaticVbos() = default;
@@ -53,7 +133,17 @@ class NODISCARD StaticVbos final : private std::vector<SharedVbo>
         return base::back();
     }
 
-    void resetAll() { base::clear(); }
+    NODISCARD SharedStreamingVbo allocStreaming()
+    {
+        m_streaming.emplace_back(std::make_shared<StreamingVbo>());
+        return m_streaming.back();
+    }
+
+    void resetAll()
+    {
+        base::clear();
+        m_streaming.clear();
+    }
 };
 
 } // namespace Legacy
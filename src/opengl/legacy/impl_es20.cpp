@@ -2,7 +2,7 @@
 
 namespace Legacy {
 
-bool Functions::canRenderQuads()
+bool Functions::canRenderQuads() const
 {
     return false;
 }
@@ -25,8 +25,16 @@ std::optional<GLenum> Functions::toGLenum(const DrawModeEnum mode)
     return std::nullopt;
 }
 
-const char *Functions::getShaderVersion()
+std::string Functions::getShaderPreamble(const GLenum shaderType) const
 {
+    if (isCore())
+        return std::string{"#version 300 es // OpenGL ES 3.0\n\nprecision highp float;\n\n"}
+               + getCoreShaderMacros(shaderType);
+    // The font shader needs fwidth() for its distance field.
+    if (shaderType == GL_FRAGMENT_SHADER)
+        return "#version 100 // OpenGL ES 2.0\n\n"
+               "#extension GL_OES_standard_derivatives : enable\n\n"
+               "precision highp float;\n\n";
     return "#version 100 // OpenGL ES 2.0\n\nprecision highp float;\n\n";
 }
 
@@ -2,9 +2,10 @@
 
 namespace Legacy {
 
-bool Functions::canRenderQuads()
+bool Functions::canRenderQuads() const
 {
-    return true;
+    // Core profiles don't have GL_QUADS.
+    return !isCore();
 }
 
 std::optional<GLenum> Functions::toGLenum(const DrawModeEnum mode)
@@ -25,8 +26,10 @@ std::optional<GLenum> Functions::toGLenum(const DrawModeEnum mode)
     return std::nullopt;
 }
 
-const char *Functions::getShaderVersion()
+std::string Functions::getShaderPreamble(const GLenum shaderType) const
 {
+    if (isCore())
+        return std::string{"#version 330 core // OpenGL 3.3\n\n"} + getCoreShaderMacros(shaderType);
     return "#version 110 // OpenGL 2.0\n\n";
 }
 
@@ -54,6 +57,16 @@ bool Functions::tryEnableMultisampling(const int requestedSamples)
 
     const bool hasMultisampling = getSampleBuffers() > 1 || getSamples() > 1;
 
+    if (isCore()) {
+        // Core profiles don't have point, line, or polygon smoothing.
+        if (hasMultisampling && requestedSamples > 0) {
+            Base::glEnable(GL_MULTISAMPLE);
+            return true;
+        }
+        Base::glDisable(GL_MULTISAMPLE);
+        return false;
+    }
+
     if (hasMultisampling && requestedSamples > 0) {
         Base::glEnable(GL_MULTISAMPLE);
 
@@ -5,15 +5,18 @@
 
 #include "CGroup.h"
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <QByteArray>
 #include <QMessageLogContext>
 #include <QMutex>
 #include <QObject>
+#include <QString>
 #include <QVariantMap>
 
 #include "../configuration/configuration.h"
+#include "../global/MemoryUsage.h"
 #include "../global/roomid.h"
 #include "CGroupChar.h"
 #include "groupaction.h"
@@ -29,6 +32,34 @@ CGroup::CGroup(QObject *const parent)
     self->setRoomId(DEFAULT_ROOMID);
     self->setColor(groupManager.color);
     charIndex.push_back(self);
+    charsByName.insert(getNameKey(self->getName()), self);
+    publishMemoryUsage();
+}
+
+void CGroup::publishMemoryUsage() const
+{
+    size_t bytes = charIndex.capacity() * sizeof(SharedGroupChar)
+                   + static_cast<size_t>(charsByName.capacity())
+                         * (sizeof(QByteArray) + sizeof(SharedGroupChar));
+    for (const SharedGroupChar &character : charIndex)
+        bytes += sizeof(CGroupChar) + static_cast<size_t>(character->getName().capacity());
+    ::publishMemoryUsage("group", charIndex.size(), bytes);
+}
+
+QByteArray CGroup::getNameKey(const QByteArray &name)
+{
+    return QString::fromLatin1(name.simplified()).toCaseFolded().toLatin1();
+}
+
+void CGroup::setName(const SharedGroupChar &character, const QByteArray &name)
+{
+    QMutexLocker locker(&characterLock);
+    const QByteArray oldKey = getNameKey(character->getName());
+    const auto it = charsByName.find(oldKey);
+    if (it != charsByName.end() && it.value() == character)
+        charsByName.erase(it);
+    character->setName(name);
+    charsByName.insert(getNameKey(name), character);
 }
 
 /**
@@ -102,15 +133,18 @@ void CGroup::resetChars()
     }
     charIndex.clear();
     charIndex.push_back(self);
+    charsByName.clear();
+    charsByName.insert(getNameKey(self->getName()), self);
+    publishMemoryUsage();
 
     emit characterChanged(true);
 }
 
-bool CGroup::addChar(const QVariantMap &map)
+bool CGroup::addChar(const CharacterState &state)
 {
     QMutexLocker locker(&characterLock);
     auto newChar = CGroupChar::alloc();
-    newChar->updateFromVariantMap(map);
+    newChar->applyState(state);
     if (isNamePresent(newChar->getName()) || newChar->getName() == "") {
         emit log(QString("'%1' could not join the group because the name already existed.")
                      .arg(newChar->getName().constData()));
@@ -118,6 +152,8 @@ bool CGroup::addChar(const QVariantMap &map)
     }
     emit log(QString("'%1' joined the group.").arg(newChar->getName().constData()));
     charIndex.push_back(newChar);
+    charsByName.insert(getNameKey(newChar->getName()), newChar);
+    publishMemoryUsage();
     emit characterChanged(true);
     return true;
 }
@@ -130,52 +166,45 @@ void CGroup::removeChar(const QByteArray &name)
         return;
     }
 
-    for (auto it = charIndex.begin(); it != charIndex.end(); ++it) {
-        SharedGroupChar character = *it;
-        if (character->getName() == name) {
-            emit log(QString("Removing '%1' from the group.").arg(character->getName().constData()));
-            charIndex.erase(it);
-            emit characterChanged(true);
-            return;
-        }
+    const SharedGroupChar character = getCharByName(name);
+    if (character == nullptr) {
+        return;
     }
+
+    emit log(QString("Removing '%1' from the group.").arg(character->getName().constData()));
+    charsByName.remove(getNameKey(name));
+    charIndex.erase(std::find(charIndex.begin(), charIndex.end(), character));
+    publishMemoryUsage();
+    emit characterChanged(true);
 }
 
 bool CGroup::isNamePresent(const QByteArray &name) const
 {
     QMutexLocker locker(&characterLock);
 
-    const QString nameStr = name.simplified();
-    for (auto &character : charIndex) {
-        if (nameStr.compare(character->getName(), Qt::CaseInsensitive) == 0) {
-            return true;
-        }
-    }
-
-    return false;
+    return charsByName.contains(getNameKey(name));
 }
 
 SharedGroupChar CGroup::getCharByName(const QByteArray &name) const
 {
     QMutexLocker locker(&characterLock);
-    for (auto &character : charIndex) {
-        if (character->getName() == name) {
-            return character;
-        }
+    const auto it = charsByName.find(getNameKey(name));
+    if (it == charsByName.end() || it.value()->getName() != name) {
+        return {};
     }
-    return {};
+    return it.value();
 }
 
-void CGroup::updateChar(const QVariantMap &map)
+void CGroup::updateChar(const CharacterState &state)
 {
-    const auto sharedCh = getCharByName(CGroupChar::getNameFromUpdateChar(map));
+    const auto sharedCh = getCharByName(state.name);
     if (sharedCh == nullptr) {
         return;
     }
 
     CGroupChar &ch = *sharedCh;
     const auto oldRoomId = ch.getRoomId();
-    const bool change = ch.updateFromVariantMap(map);
+    const bool change = ch.applyState(state);
     if (!change) {
         return;
     }
@@ -208,6 +237,11 @@ void CGroup::renameChar(const QVariantMap &map)
         return;
     }
 
-    ch->setName(newname.toLatin1());
+    setName(ch, newname.toLatin1());
     emit characterChanged(false);
 }
+
+void CGroup::renameSelf(const QByteArray &newname)
+{
+    setName(self, newname);
+}
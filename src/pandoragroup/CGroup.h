@@ -8,6 +8,7 @@
 #include <set>
 #include <vector>
 #include <QByteArray>
+#include <QHash>
 #include <QMutex>
 #include <QObject>
 #include <QVariantMap>
@@ -58,19 +59,30 @@ public slots:
 public:
     const SharedGroupChar &getSelf() { return self; }
     void renameChar(const QVariantMap &map);
+    void renameSelf(const QByteArray &newname);
     void resetChars();
-    void updateChar(const QVariantMap &map); // updates given char from the map
+    void updateChar(const CharacterState &state); // updates the char named in the state
     void removeChar(const QByteArray &name);
-    bool addChar(const QVariantMap &node);
+    bool addChar(const CharacterState &state);
 
 public:
     SharedGroupChar getCharByName(const QByteArray &name) const;
 
+private:
+    // Names are compared without case and surrounding whitespace.
+    static QByteArray getNameKey(const QByteArray &name);
+    void setName(const SharedGroupChar &character, const QByteArray &name);
+    // For the memory report (see MemoryUsage); called with the lock held, when the
+    // members change.
+    void publishMemoryUsage() const;
+
 private:
     mutable QMutex characterLock;
     std::set<GroupRecipient *> locks;
     std::queue<std::shared_ptr<GroupAction>> actionSchedule;
     GroupVector charIndex;
+    // Every character in charIndex, by getNameKey()
+    QHash<QByteArray, SharedGroupChar> charsByName;
     // deleted in destructor as member of charIndex
     SharedGroupChar self;
 };
@@ -8,11 +8,11 @@
 #include <vector>
 #include <QByteArray>
 #include <QColor>
-#include <QVariantMap>
 
 #include "../global/RuleOf5.h"
 #include "../global/roomid.h"
 #include "../parser/CommandQueue.h"
+#include "CharacterState.h"
 #include "mmapper2character.h"
 
 class CGroupChar;
@@ -52,11 +52,12 @@ class CGroupChar final : public std::enable_shared_from_this<CGroupChar>
     void setName(QByteArray _name) { name = _name; }
     void setColor(QColor col) { color = col; }
     const QColor &getColor() const { return color; }
-    const QVariantMap toVariantMap() const;
-    bool updateFromVariantMap(const QVariantMap &);
+    /// Sets every field.
+    NODISCARD CharacterState getState() const;
+    /// Applies the fields that `state` sets; returns true if anything changed.
+    bool applyState(const CharacterState &state);
     void setRoomId(RoomId id) { roomId = id; }
     RoomId getRoomId() const { return roomId; }
-    static QByteArray getNameFromUpdateChar(const QVariantMap &);
 
     void setScore(int _hp, int _maxhp, int _mana, int _maxmana, int _moves, int _maxmoves)
     {
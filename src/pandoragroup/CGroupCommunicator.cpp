@@ -5,17 +5,25 @@
 
 #include "CGroupCommunicator.h"
 
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
 #include <QByteArray>
 #include <QMessageLogContext>
 #include <QObject>
 #include <QString>
+#include <QStringList>
 #include <QVariantMap>
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
 
 #include "../configuration/configuration.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
 #include "../global/utils.h"
+#include "../mapdata/MapDigest.h"
 #include "CGroup.h"
+#include "GroupMessages.h"
 #include "GroupServer.h"
 #include "GroupSocket.h"
 #include "groupaction.h"
@@ -26,114 +34,156 @@ using MessagesEnum = CGroupCommunicator::MessagesEnum;
 
 constexpr const bool LOG_MESSAGE_INFO = false;
 
+// A link is reported as slow past any of these.
+static constexpr const auto SLOW_ROUND_TRIP = std::chrono::milliseconds(1000);
+static constexpr const qint64 SLOW_QUEUED_BYTES = 64 * 1024;
+
+using Clock = std::chrono::steady_clock;
+
 CGroupCommunicator::CGroupCommunicator(const GroupManagerStateEnum mode, Mmapper2Group *const parent)
     : QObject(parent)
     , mode(mode)
-{}
+    , linkStatsTimer(this)
+{
+    linkStatsTimer.setInterval(
+        static_cast<int>(std::chrono::milliseconds(LINK_STATS_INTERVAL).count()));
+    connect(&linkStatsTimer, &QTimer::timeout, this, &CGroupCommunicator::onLinkStatsTimeout);
+    linkStatsTimer.start();
+}
 
-//
-// Communication protocol switches and logic
-//
+static QString formatBytes(const uint64_t bytes)
+{
+    return QString("%1 KiB").arg(static_cast<double>(bytes) / 1024.0, 0, 'f', 1);
+}
 
-//
-// Low level. Message forming and messaging
-//
-QByteArray CGroupCommunicator::formMessageBlock(const MessagesEnum message, const QVariantMap &data)
+static std::optional<std::chrono::milliseconds> getUnansweredPing(const GroupSocketStats &stats)
 {
-    QByteArray block;
-    QXmlStreamWriter xml(&block);
-    xml.setCodec("ISO 8859-1");
-    xml.setAutoFormatting(LOG_MESSAGE_INFO);
-    xml.writeStartDocument();
-    xml.writeStartElement("datagram");
-    xml.writeAttribute("message", QString::number(static_cast<int>(message)));
-    xml.writeStartElement("data");
-
-    const auto write_player_data = [](auto &xml, const auto &data) {
-        if (!data.contains("playerData") || !data["playerData"].canConvert(QMetaType::QVariantMap)) {
-            abort();
+    if (!stats.pingSent.has_value())
+        return std::nullopt;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now()
+                                                                 - stats.pingSent.value());
+}
+
+static bool isSlow(const GroupSocket &socket)
+{
+    const GroupSocketStats &stats = socket.getStats();
+    const auto unanswered = getUnansweredPing(stats);
+    return (unanswered.has_value() && unanswered.value() > SLOW_ROUND_TRIP)
+           || (stats.roundTrip.has_value() && stats.roundTrip.value() > SLOW_ROUND_TRIP)
+           || socket.getQueuedBytes() > SLOW_QUEUED_BYTES;
+}
+
+static QString describeLink(const GroupSocket &socket)
+{
+    const GroupSocketStats &stats = socket.getStats();
+    QStringList parts;
+    const auto unanswered = getUnansweredPing(stats);
+    if (unanswered.has_value() && unanswered.value() > SLOW_ROUND_TRIP) {
+        parts << QString("no reply to a ping for %1 ms").arg(unanswered.value().count());
+    } else if (stats.roundTrip.has_value()) {
+        parts << QString("round trip %1 ms").arg(stats.roundTrip.value().count());
+    }
+    parts << QString("%1 in (%2 messages)").arg(formatBytes(stats.bytesIn)).arg(stats.messagesIn);
+    parts << QString("%1 out (%2 messages)")
+                 .arg(formatBytes(stats.bytesOut))
+                 .arg(stats.messagesOut);
+    if (stats.messagesIn > 0) {
+        const auto perMessage = std::chrono::duration<double, std::micro>(stats.parseTime)
+                                / static_cast<double>(stats.messagesIn);
+        parts << QString("%1 us to parse each message").arg(perMessage.count(), 0, 'f', 1);
+    }
+    if (const qint64 queued = socket.getQueuedBytes(); queued > 0)
+        parts << QString("%1 queued").arg(formatBytes(static_cast<uint64_t>(queued)));
+    return parts.join(", ");
+}
+
+void CGroupCommunicator::onLinkStatsTimeout()
+{
+    QVariantMap stats;
+    std::set<QByteArray> slow;
+    for (const Link &link : getLinks()) {
+        GroupSocket &socket = *link.socket;
+        const QString description = describeLink(socket);
+        stats[QString::fromLatin1(link.name)] = description;
+
+        if (isSlow(socket)) {
+            slow.insert(link.name);
+            if (slowLinks.count(link.name) == 0)
+                emit sendLog(QString("<b>WARNING:</b> The link to '%1' is slow: %2.")
+                                 .arg(QString::fromLatin1(link.name))
+                                 .arg(description));
+        } else if (slowLinks.count(link.name) != 0) {
+            emit sendLog(QString("The link to '%1' has recovered: %2.")
+                             .arg(QString::fromLatin1(link.name))
+                             .arg(description));
         }
-        const QVariantMap &playerData = data["playerData"].toMap();
-        xml.writeStartElement("playerData");
-        xml.writeAttribute("maxhp", playerData["maxhp"].toString());
-        xml.writeAttribute("moves", playerData["moves"].toString());
-        xml.writeAttribute("state", playerData["state"].toString());
-        xml.writeAttribute("mana", playerData["mana"].toString());
-        xml.writeAttribute("maxmana", playerData["maxmana"].toString());
-        xml.writeAttribute("name", playerData["name"].toString());
-        xml.writeAttribute("color", playerData["color"].toString());
-        xml.writeAttribute("hp", playerData["hp"].toString());
-        xml.writeAttribute("maxmoves", playerData["maxmoves"].toString());
-        xml.writeAttribute("room", playerData["room"].toString());
-        xml.writeAttribute("prespam", playerData["prespam"].toString());
-        xml.writeAttribute("affects", playerData["affects"].toString());
-        // REVISIT: Use static keys
-        xml.writeEndElement();
-    };
-
-    switch (message) {
-    case MessagesEnum::REQ_HANDSHAKE:
-        xml.writeStartElement("handshake");
-        xml.writeStartElement("protocolVersion");
-        xml.writeCharacters(data["protocolVersion"].toString());
-        xml.writeEndElement();
-        xml.writeEndElement();
-        break;
-
-    case MessagesEnum::UPDATE_CHAR:
-        if (data.contains("loginData") && data["loginData"].canConvert(QMetaType::QVariantMap)) {
-            // Client needs to submit loginData and nested playerData
-            xml.writeStartElement("loginData");
-            const QVariantMap &loginData = data["loginData"].toMap();
-            xml.writeAttribute("protocolVersion", loginData["protocolVersion"].toString());
-            write_player_data(xml, loginData);
-            xml.writeEndElement();
-        } else {
-            // Server just submits playerData
-            write_player_data(xml, data);
+
+        // Only one ping is outstanding at a time, so a slow link isn't flooded with them.
+        if (!socket.getStats().pingSent.has_value()) {
+            socket.onPingSent();
+            sendMessage(&socket, MessagesEnum::REQ_ACK);
         }
-        break;
-
-    case MessagesEnum::GTELL:
-        xml.writeStartElement("gtell");
-        xml.writeAttribute("from", data["from"].toString());
-        xml.writeCharacters(data["text"].toString());
-        xml.writeEndElement();
-        break;
-
-    case MessagesEnum::REMOVE_CHAR:
-    case MessagesEnum::ADD_CHAR:
-        write_player_data(xml, data);
-        break;
-
-    case MessagesEnum::RENAME_CHAR:
-        xml.writeStartElement("rename");
-        xml.writeAttribute("oldname", data["oldname"].toString());
-        xml.writeAttribute("newname", data["newname"].toString());
-        xml.writeEndElement();
-        break;
-
-    case MessagesEnum::NONE:
-    case MessagesEnum::ACK:
-    case MessagesEnum::REQ_ACK:
-    case MessagesEnum::REQ_INFO:
-    case MessagesEnum::REQ_LOGIN:
-    case MessagesEnum::PROT_VERSION:
-    case MessagesEnum::STATE_LOGGED:
-    case MessagesEnum::STATE_KICKED:
-        xml.writeTextElement("text", data["text"].toString());
-        break;
     }
+    slowLinks = std::move(slow);
+
+    if (stats.isEmpty() && !reportedLinks)
+        return;
+    reportedLinks = !stats.isEmpty();
+    emit sig_linkStats(stats);
+}
+
+void CGroupCommunicator::logLinkSummary(const QByteArray &name, const GroupSocket &socket)
+{
+    if (socket.getStats().messagesIn == 0)
+        return;
+    QString summary = QString("The link to '%1': %2.")
+                          .arg(QString::fromLatin1(name))
+                          .arg(describeLink(socket));
+    if (messagesSerialized > 0) {
+        const auto perMessage = std::chrono::duration<double, std::micro>(serializeTime)
+                                / static_cast<double>(messagesSerialized);
+        summary += QString(" Each message took %1 us to form.").arg(perMessage.count(), 0, 'f', 1);
+    }
+    emit sendLog(summary);
+}
 
-    xml.writeEndElement();
-    xml.writeEndElement();
-    xml.writeEndDocument();
+//
+// Communication protocol switches and logic
+//
 
+QByteArray CGroupCommunicator::formMessageBlock(const ProtocolVersion version,
+                                                const MessagesEnum message,
+                                                const QVariantMap &data)
+{
+    const auto start = Clock::now();
+    QByteArray block = usesBinaryMessages(version) ? formBinaryMessageBlock(message, data)
+                                                   : formXmlMessageBlock(message, data);
+    serializeTime += Clock::now() - start;
+    ++messagesSerialized;
     if (LOG_MESSAGE_INFO)
         qInfo() << "Outgoing message:" << block;
     return block;
 }
 
+QVariantMap CharUpdateDeltas::next(const CharacterState &update)
+{
+    ++m_sequence;
+    const bool isKeyframe = !m_last.has_value() || m_sequence % KEYFRAME_INTERVAL == 0;
+
+    QVariantMap result = isKeyframe ? update.toMessage() : update.deltaFrom(*m_last).toMessage();
+    result["sequence"] = m_sequence;
+    if (!isKeyframe)
+        result["delta"] = true;
+    m_last = update.clone();
+    return result;
+}
+
+void CharUpdateDeltas::reset()
+{
+    m_last.reset();
+    m_sequence = 0;
+}
+
 void CGroupCommunicator::sendMessage(GroupSocket *const socket,
                                      const MessagesEnum message,
                                      const QByteArray &text)
@@ -147,114 +197,30 @@ void CGroupCommunicator::sendMessage(GroupSocket *const socket,
                                      const MessagesEnum message,
                                      const QVariantMap &node)
 {
-    socket->sendData(formMessageBlock(message, node));
+    socket->sendData(formMessageBlock(socket->getProtocolVersion(), message, node));
 }
 
+// this function is for sending gtell from a local user
 // the core of the protocol
 void CGroupCommunicator::incomingData(GroupSocket *const socket, const QByteArray &buff)
 {
     if (LOG_MESSAGE_INFO)
         qInfo() << "Incoming message:" << buff;
 
-    QXmlStreamReader xml(buff);
-    if (xml.readNextStartElement() && xml.error() != QXmlStreamReader::NoError) {
-        qWarning() << "Message cannot be read" << buff;
-        return;
-    }
-
-    if (xml.name() != QLatin1String("datagram")) {
-        qWarning() << "Message does not start with element 'datagram'" << buff;
-        return;
-    }
-    if (xml.attributes().isEmpty() || !xml.attributes().hasAttribute("message")) {
-        qWarning() << "'datagram' element did not have a 'message' attribute" << buff;
-        return;
-    }
-
-    // TODO: need stronger type checking
-    const MessagesEnum message = static_cast<MessagesEnum>(
-        xml.attributes().value("message").toInt());
-
-    if (xml.readNextStartElement() && xml.name() != QLatin1String("data")) {
-        qWarning() << "'datagram' element did not have a 'data' child element" << buff;
-        return;
-    }
-
-    // Deserialize XML
+    MessagesEnum message = MessagesEnum::NONE;
     QVariantMap data;
-    while (xml.readNextStartElement()) {
-        switch (message) {
-        case MessagesEnum::GTELL:
-            if (xml.name() == QLatin1String("gtell")) {
-                data["from"] = xml.attributes().value("from").toString();
-                data["text"] = xml.readElementText();
-            }
-            break;
-
-        case MessagesEnum::REQ_HANDSHAKE:
-            if (xml.name() == QLatin1String("protocolVersion")) {
-                data["protocolVersion"] = xml.readElementText();
-            }
-            break;
-        case MessagesEnum::UPDATE_CHAR:
-            if (xml.name() == QLatin1String("loginData")) {
-                const auto &attributes = xml.attributes();
-                if (attributes.hasAttribute("protocolVersion"))
-                    data["protocolVersion"] = attributes.value("protocolVersion").toUInt();
-                xml.readNextStartElement();
-            }
-            goto common_update_char; // effectively a fall-thru
-
-        common_update_char:
-        case MessagesEnum::REMOVE_CHAR:
-        case MessagesEnum::ADD_CHAR:
-            if (xml.name() == QLatin1String("playerData")) {
-                const auto &attributes = xml.attributes();
-                QVariantMap playerData;
-                playerData["hp"] = attributes.value("hp").toInt();
-                playerData["maxhp"] = attributes.value("maxhp").toInt();
-                playerData["moves"] = attributes.value("moves").toInt();
-                playerData["maxmoves"] = attributes.value("maxmoves").toInt();
-                playerData["mana"] = attributes.value("mana").toInt();
-                playerData["maxmana"] = attributes.value("maxmana").toInt();
-                playerData["state"] = attributes.value("state").toUInt();
-                playerData["name"] = attributes.value("name").toString();
-                playerData["color"] = attributes.value("color").toString();
-                playerData["room"] = attributes.value("room").toUInt();
-                playerData["prespam"] = attributes.value("prespam").toString();
-                playerData["affects"] = attributes.value("affects").toUInt();
-                data["playerData"] = playerData;
-            }
-            break;
-
-        case MessagesEnum::RENAME_CHAR:
-            if (xml.name() == QLatin1String("rename")) {
-                const auto &attributes = xml.attributes();
-                data["oldname"] = attributes.value("oldname").toString();
-                data["newname"] = attributes.value("newname").toString();
-            }
-            break;
-
-        case MessagesEnum::NONE:
-        case MessagesEnum::ACK:
-        case MessagesEnum::REQ_ACK:
-        case MessagesEnum::REQ_INFO:
-        case MessagesEnum::REQ_LOGIN:
-        case MessagesEnum::PROT_VERSION:
-        case MessagesEnum::STATE_LOGGED:
-        case MessagesEnum::STATE_KICKED:
-            if (xml.name() == QLatin1String("text")) {
-                data["text"] = xml.readElementText();
-            }
-            break;
-        }
-    }
+    const auto start = Clock::now();
+    const bool parsed = usesBinaryMessages(socket->getProtocolVersion())
+                            ? parseBinaryMessage(buff, message, data)
+                            : parseXmlMessage(buff, message, data);
+    socket->recordParseTime(Clock::now() - start);
+    if (!parsed)
+        return;
 
     // converting a given node to the text form.
     retrieveData(socket, message, data);
 }
 
-// this function is for sending gtell from a local user
 void CGroupCommunicator::sendGroupTell(const QByteArray &tell)
 {
     // form the gtell QVariantMap first.
@@ -266,6 +232,11 @@ void CGroupCommunicator::sendGroupTell(const QByteArray &tell)
     sendGroupTellMessage(root);
 }
 
+void CGroupCommunicator::sendCharUpdate(GroupSocket *const socket, const CharacterState &state)
+{
+    sendCharUpdate(socket, state.toMessage());
+}
+
 void CGroupCommunicator::sendCharUpdate(GroupSocket *const socket, const QVariantMap &map)
 {
     sendMessage(socket, MessagesEnum::UPDATE_CHAR, map);
@@ -295,3 +266,72 @@ GroupAuthority *CGroupCommunicator::getAuthority()
     auto *group = checked_dynamic_downcast<Mmapper2Group *>(this->parent());
     return group->getAuthority();
 }
+
+SharedMapDigest CGroupCommunicator::getMapDigest()
+{
+    auto *group = checked_dynamic_downcast<Mmapper2Group *>(this->parent());
+    return group->getMapDigest();
+}
+
+void CGroupCommunicator::answerMapRequest(GroupSocket *const socket,
+                                          const MessagesEnum message,
+                                          const QVariantMap &data)
+{
+    const auto nodes = unpackMapNodes(data["nodes"].toByteArray());
+    if (!nodes.has_value() || nodes->size() > MAX_MAP_NODES_PER_REQUEST) {
+        qWarning() << "Map request has malformed nodes";
+        return;
+    }
+    const auto &settings = getConfig().groupManager;
+    if (!settings.shareMap) {
+        // Empty answers, so the client knows to stop.
+        QVariantMap reply;
+        if (message == MessagesEnum::REQ_MAP_ROOMS) {
+            reply["rooms"] = QByteArray();
+            sendMessage(socket, MessagesEnum::MAP_ROOMS, reply);
+            return;
+        }
+        reply["identity"] = QByteArray();
+        reply["level"] = data["level"];
+        reply["nodes"] = data["nodes"];
+        reply["hashes"] = QByteArray();
+        sendMessage(socket, MessagesEnum::MAP_HASHES, reply);
+        return;
+    }
+    const SharedMapDigest digest = getMapDigest();
+    if (digest == nullptr) {
+        qWarning() << "There is no map to answer map requests from";
+        return;
+    }
+
+    QVariantMap reply;
+    if (message == MessagesEnum::REQ_MAP_ROOMS) {
+        std::vector<RoomId> ids;
+        ids.reserve(nodes->size());
+        for (const uint32_t id : nodes.value())
+            ids.emplace_back(id);
+        reply["rooms"] = encodeSyncedRooms(*digest, ids, settings.shareMapNotes);
+        sendMessage(socket, MessagesEnum::MAP_ROOMS, reply);
+        return;
+    }
+
+    const uint32_t level = data["level"].toUInt();
+    if (level >= MapDigest::ROOM_LEVEL) {
+        qWarning() << "Map request asks for the children of rooms";
+        return;
+    }
+    std::vector<uint64_t> hashes;
+    hashes.reserve(nodes->size() * MapDigest::FANOUT);
+    for (const uint32_t node : nodes.value()) {
+        // Ids past the rooms would be past every level's end, and could overflow.
+        const bool isPastEnd = node >= MapDigest::MAX_ROOM_IDS / MapDigest::FANOUT;
+        for (uint32_t i = 0; i < MapDigest::FANOUT; ++i)
+            hashes.push_back(
+                isPastEnd ? 0u : digest->getHash(level + 1, node * MapDigest::FANOUT + i));
+    }
+    reply["identity"] = packMapHashes({digest->getMapIdentity()});
+    reply["level"] = level;
+    reply["nodes"] = data["nodes"];
+    reply["hashes"] = packMapHashes(hashes);
+    sendMessage(socket, MessagesEnum::MAP_HASHES, reply);
+}
@@ -4,15 +4,24 @@
 // Author: Dmitrijs Barbarins <lachupe@gmail.com> (Azazello)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <chrono>
 #include <cstdint>
 #include <memory>
+#include <optional>
+#include <set>
+#include <vector>
 #include <QByteArray>
 #include <QList>
 #include <QObject>
 #include <QString>
+#include <QTimer>
 #include <QVariantMap>
 #include <QtCore>
 
+#include "../global/macros.h"
+#include "../mapdata/MapDigest.h"
+#include "CharacterState.h"
+#include "GroupMessages.h"
 #include "GroupSocket.h"
 #include "groupaction.h"
 #include "mmapper2group.h"
@@ -20,32 +29,46 @@
 class CGroup;
 class GroupAuthority;
 
+/// Turns a character's full updates into deltas for protocol 104: the name and the fields that
+/// changed since the last update. Every KEYFRAME_INTERVAL-th update is sent in full, so anyone
+/// that joined with a stale copy catches up.
+class CharUpdateDeltas final
+{
+public:
+    static constexpr const uint32_t KEYFRAME_INTERVAL = 30;
+
+private:
+    std::optional<CharacterState> m_last;
+    uint32_t m_sequence = 0;
+
+public:
+    /// Returns the message to send for \p update, with its "sequence" number and, unless it's a
+    /// keyframe, "delta".
+    QVariantMap next(const CharacterState &update);
+    void reset();
+};
+
 class CGroupCommunicator : public QObject
 {
     Q_OBJECT
 public:
     explicit CGroupCommunicator(GroupManagerStateEnum mode, Mmapper2Group *parent);
 
+    // Protocol 105 is protocol 104 with the MAP_* messages, which sync a client's map with the
+    // host's (see MapDigest).
+    static constexpr const ProtocolVersion PROTOCOL_VERSION_105 = 105;
+    // Protocol 104 is protocol 103 with binary messages instead of XML once logging in starts.
+    static constexpr const ProtocolVersion PROTOCOL_VERSION_104 = 104;
     static constexpr const ProtocolVersion PROTOCOL_VERSION_103 = 103;
     static constexpr const ProtocolVersion PROTOCOL_VERSION_102 = 102;
+    // Offered in the handshake of protocol 103 and later when we can compress the connection.
+    static constexpr const char *const COMPRESSION_ZLIB = "zlib";
+    // How often connections are pinged and their health is reported
+    static constexpr const auto LINK_STATS_INTERVAL = std::chrono::seconds(5);
+    // The most nodes whose child hashes, or rooms, one map request asks for
+    static constexpr const uint32_t MAX_MAP_NODES_PER_REQUEST = 256;
 
-    // TODO: password and encryption options
-    enum class MessagesEnum {
-        NONE, // Unused
-        ACK,
-        REQ_LOGIN,
-        REQ_ACK,
-        REQ_HANDSHAKE,
-        REQ_INFO,
-        PROT_VERSION, // Unused
-        GTELL,
-        STATE_LOGGED,
-        STATE_KICKED,
-        ADD_CHAR,
-        REMOVE_CHAR,
-        UPDATE_CHAR,
-        RENAME_CHAR
-    };
+    using MessagesEnum = GroupMessageEnum;
 
     GroupManagerStateEnum getMode() const { return mode; }
 
@@ -53,6 +76,19 @@ class CGroupCommunicator : public QObject
     virtual bool start() = 0;
 
 protected:
+    struct NODISCARD Link final
+    {
+        /// The character at the other end; ours, if we're the client.
+        QByteArray name;
+        GroupSocket *socket = nullptr;
+    };
+    /// Every connection that has logged in.
+    virtual std::vector<Link> getLinks() = 0;
+    /// Logs what went over a connection, e.g. before it closes.
+    void logLinkSummary(const QByteArray &name, const GroupSocket &socket);
+
+protected:
+    void sendCharUpdate(GroupSocket *, const CharacterState &);
     void sendCharUpdate(GroupSocket *, const QVariantMap &);
     void sendMessage(GroupSocket *, MessagesEnum, const QByteArray & = "");
     void sendMessage(GroupSocket *, MessagesEnum, const QVariantMap &);
@@ -60,9 +96,19 @@ class CGroupCommunicator : public QObject
     virtual void sendGroupTellMessage(const QVariantMap &map) = 0;
     virtual void sendCharRename(const QVariantMap &map) = 0;
 
-    QByteArray formMessageBlock(MessagesEnum message, const QVariantMap &data);
+    static bool usesBinaryMessages(ProtocolVersion version)
+    {
+        return version >= PROTOCOL_VERSION_104;
+    }
+    static bool syncsMaps(ProtocolVersion version) { return version >= PROTOCOL_VERSION_105; }
+    /// Answers a REQ_MAP_HASHES or REQ_MAP_ROOMS from our map.
+    void answerMapRequest(GroupSocket *, MessagesEnum, const QVariantMap &);
+    QByteArray formMessageBlock(ProtocolVersion version,
+                                MessagesEnum message,
+                                const QVariantMap &data);
     CGroup *getGroup();
     GroupAuthority *getAuthority();
+    SharedMapDigest getMapDigest();
 
 public slots:
     void incomingData(GroupSocket *, const QByteArray &);
@@ -71,7 +117,8 @@ public slots:
     virtual void retrieveData(GroupSocket *, MessagesEnum, const QVariantMap &) = 0;
     virtual void connectionClosed(GroupSocket *) = 0;
     virtual void kickCharacter(const QByteArray &) = 0;
-    virtual void sendCharUpdate(const QVariantMap &map) = 0;
+    virtual void sendCharUpdate(const SharedCharacterState &state) = 0;
+    virtual void syncMap() = 0;
     void sendSelfRename(const QByteArray &, const QByteArray &);
 
 signals:
@@ -79,7 +126,21 @@ public slots:
     void sig_scheduleAction(std::shared_ptr<GroupAction> action);
     void gTellArrived(QVariantMap node);
     void sendLog(const QString &);
+    /// Each link's name and a description of its health.
+    void sig_linkStats(const QVariantMap &stats);
+    /// Rooms from the host, for MapData::slot_applySyncedRooms().
+    void sig_mapRoomsArrived(const QByteArray &rooms);
+
+private:
+    void onLinkStatsTimeout();
 
 private:
     GroupManagerStateEnum mode = GroupManagerStateEnum::Off;
+    QTimer linkStatsTimer;
+    // The links that were last reported as slow
+    std::set<QByteArray> slowLinks;
+    bool reportedLinks = false;
+    // Spent in formMessageBlock(), for every connection
+    std::chrono::nanoseconds serializeTime{0};
+    uint64_t messagesSerialized = 0;
 };
@@ -0,0 +1,202 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "CharacterState.h"
+
+#include <QDebug>
+#include <QMessageLogContext>
+#include <QString>
+#include <QVariant>
+
+namespace { // anonymous
+
+constexpr const char *const PLAYER_DATA_KEY = "playerData";
+
+QVariant toVariant(const QByteArray &s)
+{
+    return QString::fromLatin1(s);
+}
+QVariant toVariant(const QColor &color)
+{
+    return color.name();
+}
+QVariant toVariant(const int n)
+{
+    return n;
+}
+QVariant toVariant(const CharacterPositionEnum position)
+{
+    return static_cast<int>(position);
+}
+QVariant toVariant(const RoomId roomId)
+{
+    return roomId.asUint32();
+}
+QVariant toVariant(const CommandQueue &prespam)
+{
+    return prespam.toByteArray();
+}
+QVariant toVariant(const CharacterAffects affects)
+{
+    return affects.asUint32();
+}
+
+// Each of these returns false if the value has the wrong type.
+bool fromVariant(const char *const /*key*/, const QVariant &v, QByteArray &out)
+{
+    if (!v.canConvert(QMetaType::QString))
+        return false;
+    out = v.toString().toLatin1();
+    return true;
+}
+
+bool fromVariant(const char *const /*key*/, const QVariant &v, QColor &out)
+{
+    if (!v.canConvert(QMetaType::QString))
+        return false;
+    const QString str = v.toString();
+    out = QColor(str);
+    if (str != out.name())
+        qWarning() << "Round trip error on color" << str << "vs" << out;
+    return true;
+}
+
+bool fromVariant(const char *const key, const QVariant &v, int &out)
+{
+    if (!v.canConvert(QMetaType::Int))
+        return false;
+    out = v.toInt();
+    if (out < 0) {
+        qWarning() << "Input" << key << "(" << out << ") has been raised to 0.";
+        out = 0;
+    }
+    return true;
+}
+
+bool fromVariant(const char *const /*key*/, const QVariant &v, CharacterPositionEnum &out)
+{
+    if (!v.canConvert(QMetaType::Int))
+        return false;
+    const int n = v.toInt();
+    if (n < static_cast<int>(CharacterPositionEnum::UNDEFINED) || n >= NUM_CHARACTER_POSITIONS) {
+        qWarning() << "Invalid input state (" << n << ") is changed to UNDEFINED.";
+        out = CharacterPositionEnum::UNDEFINED;
+    } else {
+        out = static_cast<CharacterPositionEnum>(n);
+    }
+    return true;
+}
+
+bool fromVariant(const char *const /*key*/, const QVariant &v, RoomId &out)
+{
+    if (!v.canConvert(QMetaType::UInt))
+        return false;
+
+    // FIXME: Using a room# assumes everyone has _exactly_ the same static map;
+    // if anyone in the group modifies their map, they will report a room #
+    // that does not exist in anyone else's map. And if two different users
+    // each modify their maps, they'll be reported as being in the same room?
+    // Instead, this should serialize the room coordinates + name/desc/exits.
+
+    // NOTE: We don't have access to the map here, so we can't verify the room #.
+    out = RoomId{v.toUInt()};
+    if (out == INVALID_ROOMID) {
+        qWarning() << "Invalid room changed to default room.";
+        out = DEFAULT_ROOMID;
+    }
+    return true;
+}
+
+bool fromVariant(const char *const /*key*/, const QVariant &v, CommandQueue &out)
+{
+    if (!v.canConvert(QMetaType::QString))
+        return false;
+    out = v.toString().toLatin1();
+    return true;
+}
+
+bool fromVariant(const char *const /*key*/, const QVariant &v, CharacterAffects &out)
+{
+    if (!v.canConvert(QMetaType::UInt))
+        return false;
+    out = CharacterAffects{v.toUInt()};
+    return true;
+}
+
+} // namespace
+
+CharacterState CharacterState::clone() const
+{
+    CharacterState result;
+#define X_COPY(UPPER_CASE, member, key) result.member = member;
+    X_FOREACH_CHARACTER_FIELD(X_COPY)
+#undef X_COPY
+    result.fields = fields;
+    return result;
+}
+
+void CharacterState::merge(const CharacterState &update)
+{
+#define X_MERGE(UPPER_CASE, member, key) \
+    if (update.has(CharacterFieldEnum::UPPER_CASE)) \
+        member = update.member;
+    X_FOREACH_CHARACTER_FIELD(X_MERGE)
+#undef X_MERGE
+    fields |= update.fields;
+}
+
+CharacterState CharacterState::deltaFrom(const CharacterState &previous) const
+{
+    CharacterState result;
+#define X_DIFF(UPPER_CASE, member, key) \
+    if (has(CharacterFieldEnum::UPPER_CASE) \
+        && (!previous.has(CharacterFieldEnum::UPPER_CASE) || member != previous.member)) { \
+        result.member = member; \
+        result.fields.insert(CharacterFieldEnum::UPPER_CASE); \
+    }
+    X_FOREACH_CHARACTER_FIELD(X_DIFF)
+#undef X_DIFF
+    // The receiver needs the name to know whose update it is.
+    result.name = name;
+    result.fields.insert(CharacterFieldEnum::NAME);
+    return result;
+}
+
+CharacterState CharacterState::fromPlayerData(const QVariantMap &playerData)
+{
+    CharacterState result;
+#define X_READ(UPPER_CASE, member, key) \
+    if (playerData.contains(key) && fromVariant(key, playerData[key], result.member)) \
+        result.fields.insert(CharacterFieldEnum::UPPER_CASE);
+    X_FOREACH_CHARACTER_FIELD(X_READ)
+#undef X_READ
+    return result;
+}
+
+CharacterState CharacterState::fromMessage(const QVariantMap &data)
+{
+    if (!data.contains(PLAYER_DATA_KEY)
+        || !data[PLAYER_DATA_KEY].canConvert(QMetaType::QVariantMap)) {
+        qWarning() << "Unable to find" << PLAYER_DATA_KEY << "in map" << data;
+        return CharacterState{};
+    }
+    return fromPlayerData(data[PLAYER_DATA_KEY].toMap());
+}
+
+QVariantMap CharacterState::toPlayerData() const
+{
+    QVariantMap playerData;
+#define X_WRITE(UPPER_CASE, member, key) \
+    if (has(CharacterFieldEnum::UPPER_CASE)) \
+        playerData[key] = toVariant(member);
+    X_FOREACH_CHARACTER_FIELD(X_WRITE)
+#undef X_WRITE
+    return playerData;
+}
+
+QVariantMap CharacterState::toMessage() const
+{
+    QVariantMap root;
+    root[PLAYER_DATA_KEY] = toPlayerData();
+    return root;
+}
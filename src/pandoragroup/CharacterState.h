@@ -0,0 +1,102 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <memory>
+#include <QByteArray>
+#include <QColor>
+#include <QMetaType>
+#include <QVariantMap>
+
+#include "../global/Flags.h"
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "../global/roomid.h"
+#include "../parser/CommandQueue.h"
+#include "mmapper2character.h"
+
+// X(UPPER_CASE, member, "key in the protocol's player data")
+#define X_FOREACH_CHARACTER_FIELD(X) \
+    X(NAME, name, "name") \
+    X(COLOR, color, "color") \
+    X(HP, hp, "hp") \
+    X(MAX_HP, maxhp, "maxhp") \
+    X(MANA, mana, "mana") \
+    X(MAX_MANA, maxmana, "maxmana") \
+    X(MOVES, moves, "moves") \
+    X(MAX_MOVES, maxmoves, "maxmoves") \
+    X(POSITION, position, "state") \
+    X(ROOM, roomId, "room") \
+    X(PRESPAM, prespam, "prespam") \
+    X(AFFECTS, affects, "affects") \
+    /* define character fields above */
+
+enum class CharacterFieldEnum {
+#define X_DECL_CHARACTER_FIELD(UPPER_CASE, member, key) UPPER_CASE,
+    X_FOREACH_CHARACTER_FIELD(X_DECL_CHARACTER_FIELD)
+#undef X_DECL_CHARACTER_FIELD
+};
+
+#define X_COUNT(UPPER_CASE, member, key) +1
+static constexpr const int NUM_CHARACTER_FIELDS = X_FOREACH_CHARACTER_FIELD(X_COUNT);
+#undef X_COUNT
+DEFINE_ENUM_COUNT(CharacterFieldEnum, NUM_CHARACTER_FIELDS)
+
+class CharacterFields final : public enums::Flags<CharacterFields, CharacterFieldEnum, uint32_t>
+{
+    using Flags::Flags;
+
+public:
+    NODISCARD static CharacterFields all() { return ~CharacterFields{}; }
+};
+
+/// A character's state as it goes from the parser through Mmapper2Group and the
+/// communicator to the group, along with the fields it sets: all of them for a full
+/// update, or just the name and the ones that changed for a delta.
+///
+/// It's only turned into the protocol's "playerData" map when it's sent or received;
+/// it can't be copied by accident, so use clone() when a second one is needed.
+class NODISCARD CharacterState final
+{
+public:
+    QByteArray name;
+    QColor color;
+    int hp = 0, maxhp = 0;
+    int mana = 0, maxmana = 0;
+    int moves = 0, maxmoves = 0;
+    CharacterPositionEnum position = CharacterPositionEnum::UNDEFINED;
+    RoomId roomId = DEFAULT_ROOMID;
+    CommandQueue prespam;
+    CharacterAffects affects;
+    /// The fields above that this state sets.
+    CharacterFields fields;
+
+public:
+    CharacterState() = default;
+    ~CharacterState() = default;
+    DEFAULT_MOVES_DELETE_COPIES(CharacterState);
+
+public:
+    NODISCARD CharacterState clone() const;
+    NODISCARD bool has(const CharacterFieldEnum field) const { return fields.contains(field); }
+
+public:
+    /// Copies the fields that `update` sets.
+    void merge(const CharacterState &update);
+    /// The name and the fields that are set here and differ from `previous`.
+    NODISCARD CharacterState deltaFrom(const CharacterState &previous) const;
+
+public:
+    /// Sets the fields that `playerData` has, after checking their values.
+    NODISCARD static CharacterState fromPlayerData(const QVariantMap &playerData);
+    /// Reads the "playerData" of a message.
+    NODISCARD static CharacterState fromMessage(const QVariantMap &data);
+    /// Only has the fields that are set.
+    NODISCARD QVariantMap toPlayerData() const;
+    /// A message whose "playerData" is toPlayerData().
+    NODISCARD QVariantMap toMessage() const;
+};
+
+using SharedCharacterState = std::shared_ptr<const CharacterState>;
+Q_DECLARE_METATYPE(SharedCharacterState)
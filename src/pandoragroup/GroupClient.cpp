@@ -5,7 +5,9 @@
 
 #include "GroupClient.h"
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include <QAbstractSocket>
 #include <QByteArray>
 #include <QMessageLogContext>
@@ -14,6 +16,7 @@
 #include <QVariantMap>
 
 #include "../configuration/configuration.h"
+#include "../mapdata/MapDigest.h"
 #include "CGroup.h"
 #include "CGroupChar.h"
 #include "GroupSocket.h"
@@ -64,6 +67,7 @@ void GroupClient::connectionClosed(GroupSocket * /*socket*/)
         return;
 
     emit sendLog("Server closed the connection");
+    logLinkSummary(getConfig().groupManager.charName, socket);
     tryReconnecting();
 }
 
@@ -138,6 +142,9 @@ void GroupClient::retrieveData(GroupSocket *const /* socket */,
         } else if (message == MessagesEnum::REQ_LOGIN) {
             assert(!NO_OPEN_SSL);
             socket.setProtocolVersion(proposedProtocolVersion);
+            // The host starts compressing right after asking us to log in
+            if (proposedCompression)
+                socket.startCompression();
             socket.startClientEncrypted();
         } else if (message == MessagesEnum::ACK) {
             // aha! logged on!
@@ -165,17 +172,27 @@ void GroupClient::retrieveData(GroupSocket *const /* socket */,
 
     } else if (socket.getProtocolState() == ProtocolStateEnum::Logged) {
         if (message == MessagesEnum::ADD_CHAR) {
-            emit sig_scheduleAction(std::make_shared<AddCharacter>(data));
+            emit sig_scheduleAction(
+                std::make_shared<AddCharacter>(CharacterState::fromMessage(data)));
         } else if (message == MessagesEnum::REMOVE_CHAR) {
-            emit sig_scheduleAction(std::make_shared<RemoveCharacter>(data));
+            emit sig_scheduleAction(
+                std::make_shared<RemoveCharacter>(CharacterState::fromMessage(data).name));
         } else if (message == MessagesEnum::UPDATE_CHAR) {
-            emit sig_scheduleAction(std::make_shared<UpdateCharacter>(data));
+            emit sig_scheduleAction(
+                std::make_shared<UpdateCharacter>(CharacterState::fromMessage(data)));
         } else if (message == MessagesEnum::RENAME_CHAR) {
             emit sig_scheduleAction(std::make_shared<RenameCharacter>(data));
         } else if (message == MessagesEnum::GTELL) {
             emit gTellArrived(data);
         } else if (message == MessagesEnum::REQ_ACK) {
             sendMessage(&socket, MessagesEnum::ACK);
+        } else if (message == MessagesEnum::ACK) {
+            // Reply to our ping
+            socket.onPingAnswered();
+        } else if (message == MessagesEnum::MAP_HASHES) {
+            receiveMapHashes(data);
+        } else if (message == MessagesEnum::MAP_ROOMS) {
+            receiveMapRooms(data);
         } else {
             // ERROR: unexpected message marker!
             // try to ignore?
@@ -202,6 +219,10 @@ void GroupClient::sendHandshake(const QVariantMap &data)
         // Ensure we only pick a protocol within the bounds we understand
         if (NO_OPEN_SSL) {
             return PROTOCOL_VERSION_102;
+        } else if (serverProtocolVersion >= PROTOCOL_VERSION_105) {
+            return PROTOCOL_VERSION_105;
+        } else if (serverProtocolVersion >= PROTOCOL_VERSION_104) {
+            return PROTOCOL_VERSION_104;
         } else if (serverProtocolVersion >= PROTOCOL_VERSION_103) {
             return PROTOCOL_VERSION_103;
         } else if (serverProtocolVersion <= PROTOCOL_VERSION_102) {
@@ -210,6 +231,7 @@ void GroupClient::sendHandshake(const QVariantMap &data)
         return serverProtocolVersion;
     };
     proposedProtocolVersion = get_proposed_protocol_version(serverProtocolVersion);
+    proposedCompression = false;
 
     if (serverProtocolVersion == PROTOCOL_VERSION_102
         || proposedProtocolVersion == PROTOCOL_VERSION_102) {
@@ -233,28 +255,35 @@ void GroupClient::sendHandshake(const QVariantMap &data)
     } else {
         QVariantMap handshake;
         handshake["protocolVersion"] = proposedProtocolVersion;
+        if (!NO_ZLIB && data["compression"].toString() == COMPRESSION_ZLIB) {
+            handshake["compression"] = COMPRESSION_ZLIB;
+            proposedCompression = true;
+        }
         sendMessage(&socket, MessagesEnum::REQ_HANDSHAKE, handshake);
     }
 }
 
 void GroupClient::receiveGroupInformation(const QVariantMap &data)
 {
+    CharacterState state = CharacterState::fromMessage(data);
     const auto &selection = getGroup()->selectAll();
     const bool isSolo = selection->size() == 1 && getGroup()->getSelf() == *selection->begin();
     if (isSolo) {
         // Update metadata and assume first received character is host
         const auto &secret = socket.getSecret();
-        const auto &nameStr = QString::fromLatin1(CGroupChar::getNameFromUpdateChar(data));
+        const auto &nameStr = QString::fromLatin1(state.name);
         getAuthority()->setMetadata(secret, GroupMetadataEnum::NAME, nameStr);
         emit sendLog("Host's name is most likely '" + nameStr + "'");
     }
-    emit sig_scheduleAction(std::make_shared<AddCharacter>(data));
+    emit sig_scheduleAction(std::make_shared<AddCharacter>(std::move(state)));
 }
 
 void GroupClient::sendLoginInformation()
 {
     const SharedGroupChar &character = getGroup()->getSelf();
-    QVariantMap loginData = character->toVariantMap();
+    QVariantMap loginData = character->getState().toMessage();
+    // The host starts from the login data, so the next update is a keyframe.
+    selfDeltas.reset();
     if (proposedProtocolVersion == PROTOCOL_VERSION_102) {
         // Protocol 102 does handshake and login in one step
         loginData["protocolVersion"] = socket.getProtocolVersion();
@@ -318,6 +347,7 @@ void GroupClient::tryReconnecting()
     emit sendLog(QString("Attempting to reconnect... (%1 left)").arg(reconnectAttempts));
 
     // Retry
+    mapSync.reset();
     reconnectAttempts--;
     emit sig_scheduleAction(std::make_shared<ResetCharacters>());
     socket.connectToHost();
@@ -328,9 +358,12 @@ void GroupClient::sendGroupTellMessage(const QVariantMap &root)
     sendMessage(&socket, MessagesEnum::GTELL, root);
 }
 
-void GroupClient::sendCharUpdate(const QVariantMap &map)
+void GroupClient::sendCharUpdate(const SharedCharacterState &state)
 {
-    CGroupCommunicator::sendCharUpdate(&socket, map);
+    if (usesBinaryMessages(socket.getProtocolVersion()))
+        CGroupCommunicator::sendCharUpdate(&socket, selfDeltas.next(*state));
+    else
+        CGroupCommunicator::sendCharUpdate(&socket, *state);
 }
 
 void GroupClient::sendCharRename(const QVariantMap &map)
@@ -338,9 +371,19 @@ void GroupClient::sendCharRename(const QVariantMap &map)
     sendMessage(&socket, MessagesEnum::RENAME_CHAR, map);
 }
 
+std::vector<CGroupCommunicator::Link> GroupClient::getLinks()
+{
+    if (socket.getProtocolState() != ProtocolStateEnum::Logged)
+        return {};
+    return {Link{getConfig().groupManager.charName, &socket}};
+}
+
 void GroupClient::stop()
 {
+    if (clientConnected)
+        logLinkSummary(getConfig().groupManager.charName, socket);
     clientConnected = false;
+    mapSync.reset();
     socket.disconnectFromHost();
     emit sig_scheduleAction(std::make_shared<ResetCharacters>());
     deleteLater();
@@ -356,3 +399,158 @@ void GroupClient::kickCharacter(const QByteArray &)
 {
     throw std::runtime_error("impossible");
 }
+
+void GroupClient::syncMap()
+{
+    if (socket.getProtocolState() != ProtocolStateEnum::Logged) {
+        emit sendLog("The map can only be synced once you've joined the host.");
+        return;
+    }
+    if (!syncsMaps(socket.getProtocolVersion())) {
+        emit sendLog("The host's MMapper is too old to sync maps.");
+        return;
+    }
+    if (mapSync.has_value()) {
+        emit sendLog("The map is already being synced.");
+        return;
+    }
+    SharedMapDigest digest = getMapDigest();
+    if (digest == nullptr) {
+        emit sendLog("There is no map to sync.");
+        return;
+    }
+
+    emit sendLog("Comparing the map with the host's...");
+    mapSync.emplace();
+    mapSync->digest = std::move(digest);
+    requestMapHashes(0, {0});
+}
+
+void GroupClient::requestMapHashes(const uint32_t level, const std::vector<uint32_t> &nodes)
+{
+    for (size_t begin = 0; begin < nodes.size(); begin += MAX_MAP_NODES_PER_REQUEST) {
+        const size_t end = std::min<size_t>(nodes.size(), begin + MAX_MAP_NODES_PER_REQUEST);
+        QVariantMap root;
+        root["level"] = level;
+        root["nodes"] = packMapNodes(
+            std::vector<uint32_t>(nodes.begin() + static_cast<ptrdiff_t>(begin),
+                                  nodes.begin() + static_cast<ptrdiff_t>(end)));
+        sendMessage(&socket, MessagesEnum::REQ_MAP_HASHES, root);
+        ++mapSync->pendingReplies;
+    }
+}
+
+void GroupClient::receiveMapHashes(const QVariantMap &data)
+{
+    if (!mapSync.has_value() || mapSync->pendingReplies == 0) {
+        qWarning("Unexpected map hashes. Trying to ignore.");
+        return;
+    }
+    MapSync &sync = mapSync.value();
+    --sync.pendingReplies;
+    if (data["identity"].toByteArray().isEmpty()) {
+        emit sendLog("The host doesn't share its map.");
+        mapSync.reset();
+        return;
+    }
+
+    const uint32_t level = data["level"].toUInt();
+    const auto nodes = unpackMapNodes(data["nodes"].toByteArray());
+    const auto hashes = unpackMapHashes(data["hashes"].toByteArray());
+    const auto isMalformed = [&nodes, &hashes, level]() {
+        if (!nodes.has_value() || !hashes.has_value() || level >= MapDigest::ROOM_LEVEL
+            || hashes->size() != nodes->size() * MapDigest::FANOUT)
+            return true;
+        return std::any_of(nodes->begin(), nodes->end(), [](const uint32_t node) {
+            return node >= MapDigest::MAX_ROOM_IDS / MapDigest::FANOUT;
+        });
+    };
+    if (isMalformed()) {
+        emit sendLog("The host sent malformed map hashes, so the map sync has stopped.");
+        mapSync.reset();
+        return;
+    }
+    // Rooms with the same id are only the same room in copies of the same map.
+    const auto identity = unpackMapHashes(data["identity"].toByteArray());
+    if (!identity.has_value() || identity->size() != 1
+        || identity->front() != sync.digest->getMapIdentity()) {
+        emit sendLog("The host's map isn't a copy of yours, so it can't be synced.");
+        mapSync.reset();
+        return;
+    }
+
+    const uint32_t childLevel = level + 1;
+    std::vector<uint32_t> differing;
+    for (size_t i = 0; i < nodes->size(); ++i) {
+        for (uint32_t k = 0; k < MapDigest::FANOUT; ++k) {
+            const uint32_t child = nodes->at(i) * MapDigest::FANOUT + k;
+            const uint64_t theirs = hashes->at(i * MapDigest::FANOUT + k);
+            if (theirs == sync.digest->getHash(childLevel, child))
+                continue;
+            if (childLevel < MapDigest::ROOM_LEVEL)
+                differing.push_back(child);
+            else if (theirs == 0)
+                ++sync.roomsOnlyHere;
+            else
+                sync.roomsToFetch.push_back(child);
+        }
+    }
+    requestMapHashes(childLevel, differing);
+
+    if (sync.pendingReplies == 0)
+        requestMapRooms();
+}
+
+void GroupClient::requestMapRooms()
+{
+    MapSync &sync = mapSync.value();
+    const std::vector<uint32_t> &ids = sync.roomsToFetch;
+    if (ids.empty()) {
+        finishMapSync();
+        return;
+    }
+
+    emit sendLog(QString("%1 room(s) differ from the host's; fetching them...").arg(ids.size()));
+    for (size_t begin = 0; begin < ids.size(); begin += MAX_MAP_NODES_PER_REQUEST) {
+        const size_t end = std::min<size_t>(ids.size(), begin + MAX_MAP_NODES_PER_REQUEST);
+        QVariantMap root;
+        root["nodes"] = packMapNodes(
+            std::vector<uint32_t>(ids.begin() + static_cast<ptrdiff_t>(begin),
+                                  ids.begin() + static_cast<ptrdiff_t>(end)));
+        sendMessage(&socket, MessagesEnum::REQ_MAP_ROOMS, root);
+        ++sync.pendingReplies;
+    }
+    sync.roomsFetched = ids.size();
+    sync.roomsToFetch.clear();
+}
+
+void GroupClient::receiveMapRooms(const QVariantMap &data)
+{
+    if (!mapSync.has_value() || mapSync->pendingReplies == 0) {
+        qWarning("Unexpected map rooms. Trying to ignore.");
+        return;
+    }
+    const QByteArray rooms = data["rooms"].toByteArray();
+    if (rooms.isEmpty()) {
+        emit sendLog("The host stopped sharing its map, so the map sync has stopped.");
+        mapSync.reset();
+        return;
+    }
+    emit sig_mapRoomsArrived(rooms);
+    if (--mapSync->pendingReplies == 0)
+        finishMapSync();
+}
+
+void GroupClient::finishMapSync()
+{
+    const MapSync &sync = mapSync.value();
+    if (sync.roomsFetched == 0 && sync.roomsOnlyHere == 0) {
+        emit sendLog("The map is already in sync with the host's.");
+    } else {
+        emit sendLog(QString("Fetched %1 room(s) from the host; the %2 room(s) that only your "
+                             "map has were kept.")
+                         .arg(sync.roomsFetched)
+                         .arg(sync.roomsOnlyHere));
+    }
+    mapSync.reset();
+}
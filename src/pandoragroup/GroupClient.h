@@ -6,6 +6,9 @@
 
 #include "CGroupCommunicator.h"
 #include "GroupSocket.h"
+#include <cstdint>
+#include <optional>
+#include <vector>
 #include <QVariantMap>
 
 class GroupClient final : public CGroupCommunicator
@@ -28,18 +31,40 @@ public slots:
     void sendGroupTellMessage(const QVariantMap &map) override;
     bool start() override;
     void stop() override;
-    void sendCharUpdate(const QVariantMap &map) override;
+    void sendCharUpdate(const SharedCharacterState &state) override;
     void sendCharRename(const QVariantMap &map) override;
+    std::vector<Link> getLinks() override;
     void kickCharacter(const QByteArray &) override;
+    /// Compares our map's digest with the host's and fetches the rooms that differ.
+    void syncMap() override;
 
 private:
     void sendHandshake(const QVariantMap &data);
     void sendLoginInformation();
     void tryReconnecting();
     void receiveGroupInformation(const QVariantMap &data);
+    void requestMapHashes(uint32_t level, const std::vector<uint32_t> &nodes);
+    void receiveMapHashes(const QVariantMap &data);
+    void requestMapRooms();
+    void receiveMapRooms(const QVariantMap &data);
+    void finishMapSync();
+
+    struct NODISCARD MapSync final
+    {
+        SharedMapDigest digest;
+        std::vector<uint32_t> roomsToFetch;
+        // The host answers in order: every hash reply comes before the rooms are asked for.
+        size_t pendingReplies = 0;
+        size_t roomsFetched = 0;
+        size_t roomsOnlyHere = 0;
+    };
+    // The sync in progress, if any
+    std::optional<MapSync> mapSync;
 
     ProtocolVersion proposedProtocolVersion = PROTOCOL_VERSION_102;
+    bool proposedCompression = false;
     bool clientConnected = false;
     int reconnectAttempts = 3;
     GroupSocket socket;
+    CharUpdateDeltas selfDeltas;
 };
@@ -24,6 +24,11 @@ void GroupManagerApi::sendGroupTell(const QByteArray &msg) const
     m_group.acceptVisitor([&msg](Mmapper2Group &group) { group.sendGroupTell(msg); });
 }
 
+void GroupManagerApi::syncMap() const
+{
+    m_group.acceptVisitor([](Mmapper2Group &group) { group.syncMap(); });
+}
+
 void GroupManagerApi::sendScoreLineEvent(const QByteArray &arr) const
 {
     m_group.acceptVisitor([&arr](Mmapper2Group &group) { group.parseScoreInformation(arr); });
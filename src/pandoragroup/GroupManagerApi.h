@@ -24,6 +24,7 @@ class GroupManagerApi final
 public:
     void kickCharacter(const QByteArray &name) const;
     void sendGroupTell(const QByteArray &msg) const;
+    void syncMap() const;
 
 public:
     void sendScoreLineEvent(const QByteArray &arr) const;
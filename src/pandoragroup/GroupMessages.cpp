@@ -0,0 +1,677 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+// Author: Dmitrijs Barbarins <lachupe@gmail.com> (Azazello)
+// Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
+
+#include "GroupMessages.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <utility>
+#include <QByteArray>
+#include <QDebug>
+#include <QString>
+#include <QVariantMap>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+#include "../global/macros.h"
+
+using MessagesEnum = GroupMessageEnum;
+
+// Indents the XML, e.g. to read it in the log with CGroupCommunicator's LOG_MESSAGE_INFO.
+static constexpr const bool FORMAT_XML_MESSAGES = false;
+
+QByteArray formXmlMessageBlock(const MessagesEnum message, const QVariantMap &data)
+{
+    QByteArray block;
+    QXmlStreamWriter xml(&block);
+    xml.setCodec("ISO 8859-1");
+    xml.setAutoFormatting(FORMAT_XML_MESSAGES);
+    xml.writeStartDocument();
+    xml.writeStartElement("datagram");
+    xml.writeAttribute("message", QString::number(static_cast<int>(message)));
+    xml.writeStartElement("data");
+
+    const auto write_player_data = [](auto &xml, const auto &data) {
+        if (!data.contains("playerData") || !data["playerData"].canConvert(QMetaType::QVariantMap)) {
+            abort();
+        }
+        const QVariantMap &playerData = data["playerData"].toMap();
+        xml.writeStartElement("playerData");
+        xml.writeAttribute("maxhp", playerData["maxhp"].toString());
+        xml.writeAttribute("moves", playerData["moves"].toString());
+        xml.writeAttribute("state", playerData["state"].toString());
+        xml.writeAttribute("mana", playerData["mana"].toString());
+        xml.writeAttribute("maxmana", playerData["maxmana"].toString());
+        xml.writeAttribute("name", playerData["name"].toString());
+        xml.writeAttribute("color", playerData["color"].toString());
+        xml.writeAttribute("hp", playerData["hp"].toString());
+        xml.writeAttribute("maxmoves", playerData["maxmoves"].toString());
+        xml.writeAttribute("room", playerData["room"].toString());
+        xml.writeAttribute("prespam", playerData["prespam"].toString());
+        xml.writeAttribute("affects", playerData["affects"].toString());
+        // REVISIT: Use static keys
+        xml.writeEndElement();
+    };
+
+    switch (message) {
+    case MessagesEnum::REQ_HANDSHAKE:
+        xml.writeStartElement("handshake");
+        xml.writeStartElement("protocolVersion");
+        xml.writeCharacters(data["protocolVersion"].toString());
+        xml.writeEndElement();
+        // Older versions stop reading the handshake here, so it goes last.
+        if (data.contains("compression")) {
+            xml.writeStartElement("compression");
+            xml.writeCharacters(data["compression"].toString());
+            xml.writeEndElement();
+        }
+        xml.writeEndElement();
+        break;
+
+    case MessagesEnum::UPDATE_CHAR:
+        if (data.contains("loginData") && data["loginData"].canConvert(QMetaType::QVariantMap)) {
+            // Client needs to submit loginData and nested playerData
+            xml.writeStartElement("loginData");
+            const QVariantMap &loginData = data["loginData"].toMap();
+            xml.writeAttribute("protocolVersion", loginData["protocolVersion"].toString());
+            write_player_data(xml, loginData);
+            xml.writeEndElement();
+        } else {
+            // Server just submits playerData
+            write_player_data(xml, data);
+        }
+        break;
+
+    case MessagesEnum::GTELL:
+        xml.writeStartElement("gtell");
+        xml.writeAttribute("from", data["from"].toString());
+        xml.writeCharacters(data["text"].toString());
+        xml.writeEndElement();
+        break;
+
+    case MessagesEnum::REMOVE_CHAR:
+    case MessagesEnum::ADD_CHAR:
+        write_player_data(xml, data);
+        break;
+
+    case MessagesEnum::RENAME_CHAR:
+        xml.writeStartElement("rename");
+        xml.writeAttribute("oldname", data["oldname"].toString());
+        xml.writeAttribute("newname", data["newname"].toString());
+        xml.writeEndElement();
+        break;
+
+    case MessagesEnum::NONE:
+    case MessagesEnum::ACK:
+    case MessagesEnum::REQ_ACK:
+    case MessagesEnum::REQ_INFO:
+    case MessagesEnum::REQ_LOGIN:
+    case MessagesEnum::PROT_VERSION:
+    case MessagesEnum::STATE_LOGGED:
+    case MessagesEnum::STATE_KICKED:
+        xml.writeTextElement("text", data["text"].toString());
+        break;
+
+    case MessagesEnum::REQ_MAP_HASHES:
+    case MessagesEnum::MAP_HASHES:
+    case MessagesEnum::REQ_MAP_ROOMS:
+    case MessagesEnum::MAP_ROOMS:
+        // Only protocol 105 and later sync maps, and they're binary.
+        qWarning() << "Map messages can't be sent as XML";
+        break;
+    }
+
+    xml.writeEndElement();
+    xml.writeEndElement();
+    xml.writeEndDocument();
+    return block;
+}
+
+//
+// Protocol 104 sends the same messages in binary: the message number as a varint, followed by
+// fields that each start with a varint tag (the field number shifted left once, plus one if the
+// field is a string). Numbers follow as varints (zigzag encoded if they can be negative), and
+// strings as a varint length and that many Latin-1 bytes. Fields that are zero or empty are left
+// out, and fields the receiver doesn't know are skipped, so fields can be added later.
+//
+// Character updates can also be deltas (see CharUpdateDeltas), which only have the name and the
+// fields that changed, even if they changed to zero.
+//
+namespace { // anonymous
+
+// The numbers are part of the protocol; don't reuse them.
+enum class BinaryFieldEnum : uint32_t {
+    TEXT = 1,
+    FROM = 2,
+    PROTOCOL_VERSION = 3,
+    // The login data's protocol version; its presence means the player data is login data.
+    LOGIN_DATA = 4,
+    NAME = 5,
+    COLOR = 6,
+    HP = 7,
+    MAX_HP = 8,
+    MANA = 9,
+    MAX_MANA = 10,
+    MOVES = 11,
+    MAX_MOVES = 12,
+    STATE = 13,
+    ROOM = 14,
+    PRESPAM = 15,
+    AFFECTS = 16,
+    OLD_NAME = 17,
+    NEW_NAME = 18,
+    SEQUENCE = 19,
+    // Its presence means only the name and the fields that changed are present.
+    DELTA = 20,
+    COMPRESSION = 21,
+    MAP_LEVEL = 22,
+    MAP_NODES = 23,
+    MAP_HASHES = 24,
+    MAP_ROOMS = 25,
+    MAP_IDENTITY = 26,
+};
+
+enum class BinaryTypeEnum { SIGNED, UNSIGNED, STRING };
+
+struct NODISCARD PlayerDataField final
+{
+    const char *key;
+    BinaryFieldEnum field;
+    BinaryTypeEnum type;
+};
+
+const PlayerDataField PLAYER_DATA_FIELDS[] = {
+    {"name", BinaryFieldEnum::NAME, BinaryTypeEnum::STRING},
+    {"color", BinaryFieldEnum::COLOR, BinaryTypeEnum::STRING},
+    {"hp", BinaryFieldEnum::HP, BinaryTypeEnum::SIGNED},
+    {"maxhp", BinaryFieldEnum::MAX_HP, BinaryTypeEnum::SIGNED},
+    {"mana", BinaryFieldEnum::MANA, BinaryTypeEnum::SIGNED},
+    {"maxmana", BinaryFieldEnum::MAX_MANA, BinaryTypeEnum::SIGNED},
+    {"moves", BinaryFieldEnum::MOVES, BinaryTypeEnum::SIGNED},
+    {"maxmoves", BinaryFieldEnum::MAX_MOVES, BinaryTypeEnum::SIGNED},
+    {"state", BinaryFieldEnum::STATE, BinaryTypeEnum::UNSIGNED},
+    {"room", BinaryFieldEnum::ROOM, BinaryTypeEnum::UNSIGNED},
+    {"prespam", BinaryFieldEnum::PRESPAM, BinaryTypeEnum::STRING},
+    {"affects", BinaryFieldEnum::AFFECTS, BinaryTypeEnum::UNSIGNED},
+};
+
+const PlayerDataField *findPlayerDataField(const BinaryFieldEnum field)
+{
+    for (const PlayerDataField &f : PLAYER_DATA_FIELDS) {
+        if (f.field == field)
+            return &f;
+    }
+    return nullptr;
+}
+
+class NODISCARD BinaryWriter final
+{
+private:
+    QByteArray m_block;
+
+public:
+    explicit BinaryWriter(const MessagesEnum message)
+    {
+        m_block.reserve(64);
+        writeVarint(static_cast<uint32_t>(message));
+    }
+
+private:
+    void writeVarint(uint64_t value)
+    {
+        while (value >= 0x80u) {
+            m_block.append(static_cast<char>((value & 0x7Fu) | 0x80u));
+            value >>= 7;
+        }
+        m_block.append(static_cast<char>(value));
+    }
+    void writeTag(const BinaryFieldEnum field, const bool isString)
+    {
+        writeVarint((static_cast<uint64_t>(field) << 1) | (isString ? 1u : 0u));
+    }
+
+public:
+    void writeUnsigned(const BinaryFieldEnum field, const uint32_t value, const bool always = false)
+    {
+        if (value == 0 && !always)
+            return;
+        writeTag(field, false);
+        writeVarint(value);
+    }
+    void writeSigned(const BinaryFieldEnum field, const int32_t value, const bool always = false)
+    {
+        const auto u = static_cast<uint32_t>(value);
+        writeUnsigned(field, (u << 1) ^ (value < 0 ? ~0u : 0u), always);
+    }
+    void writeString(const BinaryFieldEnum field, const QString &value, const bool always = false)
+    {
+        if (value.isEmpty() && !always)
+            return;
+        writeBytes(field, value.toLatin1(), always);
+    }
+    void writeBytes(const BinaryFieldEnum field, const QByteArray &value, const bool always = false)
+    {
+        if (value.isEmpty() && !always)
+            return;
+        writeTag(field, true);
+        writeVarint(static_cast<uint32_t>(value.size()));
+        m_block.append(value);
+    }
+    void writePlayerData(const QVariantMap &playerData, const bool isDelta)
+    {
+        for (const PlayerDataField &f : PLAYER_DATA_FIELDS) {
+            if (isDelta && !playerData.contains(f.key))
+                continue;
+            const QVariant &value = playerData[f.key];
+            switch (f.type) {
+            case BinaryTypeEnum::SIGNED:
+                writeSigned(f.field, value.toInt(), isDelta);
+                break;
+            case BinaryTypeEnum::UNSIGNED:
+                writeUnsigned(f.field, value.toUInt(), isDelta);
+                break;
+            case BinaryTypeEnum::STRING:
+                writeString(f.field, value.toString(), isDelta);
+                break;
+            }
+        }
+    }
+
+public:
+    NODISCARD QByteArray getBlock() && { return std::move(m_block); }
+};
+
+class NODISCARD BinaryReader final
+{
+private:
+    const char *m_pos = nullptr;
+    const char *const m_end = nullptr;
+
+public:
+    explicit BinaryReader(const QByteArray &block)
+        : m_pos{block.constData()}
+        , m_end{block.constData() + block.size()}
+    {}
+
+public:
+    NODISCARD bool isEmpty() const { return m_pos == m_end; }
+    NODISCARD std::optional<uint64_t> readVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && m_pos != m_end; shift += 7) {
+            const auto byte = static_cast<uint8_t>(*m_pos++);
+            value |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+            if ((byte & 0x80u) == 0)
+                return value;
+        }
+        return std::nullopt;
+    }
+    NODISCARD std::optional<QByteArray> readBytes()
+    {
+        const auto length = readVarint();
+        if (!length.has_value() || length.value() > static_cast<uint64_t>(m_end - m_pos))
+            return std::nullopt;
+        const auto size = static_cast<int>(length.value());
+        QByteArray result(m_pos, size);
+        m_pos += size;
+        return result;
+    }
+};
+
+} // namespace
+
+QByteArray formBinaryMessageBlock(const MessagesEnum message, const QVariantMap &data)
+{
+    using F = BinaryFieldEnum;
+    BinaryWriter writer{message};
+
+    const auto write_player_data = [&writer](const QVariantMap &node, const bool isDelta) {
+        if (!node.contains("playerData")
+            || !node["playerData"].canConvert(QMetaType::QVariantMap)) {
+            abort();
+        }
+        writer.writePlayerData(node["playerData"].toMap(), isDelta);
+    };
+
+    switch (message) {
+    case MessagesEnum::REQ_HANDSHAKE:
+        writer.writeUnsigned(F::PROTOCOL_VERSION, data["protocolVersion"].toUInt());
+        writer.writeString(F::COMPRESSION, data["compression"].toString());
+        break;
+
+    case MessagesEnum::UPDATE_CHAR:
+        if (data.contains("loginData") && data["loginData"].canConvert(QMetaType::QVariantMap)) {
+            const QVariantMap &loginData = data["loginData"].toMap();
+            writer.writeUnsigned(F::LOGIN_DATA, loginData["protocolVersion"].toUInt(), true);
+            write_player_data(loginData, false);
+        } else {
+            const bool isDelta = data["delta"].toBool();
+            writer.writeUnsigned(F::SEQUENCE, data["sequence"].toUInt());
+            if (isDelta)
+                writer.writeUnsigned(F::DELTA, 1);
+            write_player_data(data, isDelta);
+        }
+        break;
+
+    case MessagesEnum::GTELL:
+        writer.writeString(F::FROM, data["from"].toString());
+        writer.writeString(F::TEXT, data["text"].toString());
+        break;
+
+    case MessagesEnum::REMOVE_CHAR:
+    case MessagesEnum::ADD_CHAR:
+        write_player_data(data, false);
+        break;
+
+    case MessagesEnum::RENAME_CHAR:
+        writer.writeString(F::OLD_NAME, data["oldname"].toString());
+        writer.writeString(F::NEW_NAME, data["newname"].toString());
+        break;
+
+    case MessagesEnum::MAP_HASHES:
+        writer.writeBytes(F::MAP_IDENTITY, data["identity"].toByteArray());
+        writer.writeBytes(F::MAP_HASHES, data["hashes"].toByteArray());
+        FALLTHRU;
+    case MessagesEnum::REQ_MAP_HASHES:
+        writer.writeUnsigned(F::MAP_LEVEL, data["level"].toUInt());
+        FALLTHRU;
+    case MessagesEnum::REQ_MAP_ROOMS:
+        writer.writeBytes(F::MAP_NODES, data["nodes"].toByteArray());
+        break;
+
+    case MessagesEnum::MAP_ROOMS:
+        writer.writeBytes(F::MAP_ROOMS, data["rooms"].toByteArray());
+        break;
+
+    case MessagesEnum::NONE:
+    case MessagesEnum::ACK:
+    case MessagesEnum::REQ_ACK:
+    case MessagesEnum::REQ_INFO:
+    case MessagesEnum::REQ_LOGIN:
+    case MessagesEnum::PROT_VERSION:
+    case MessagesEnum::STATE_LOGGED:
+    case MessagesEnum::STATE_KICKED:
+        writer.writeString(F::TEXT, data["text"].toString());
+        break;
+    }
+
+    return std::move(writer).getBlock();
+}
+
+bool parseBinaryMessage(const QByteArray &buff, MessagesEnum &message, QVariantMap &data)
+{
+    using F = BinaryFieldEnum;
+    BinaryReader reader{buff};
+
+    const auto number = reader.readVarint();
+    if (!number.has_value() || number.value() > static_cast<uint64_t>(MessagesEnum::MAP_ROOMS)) {
+        qWarning() << "Message does not start with a message number" << buff;
+        return false;
+    }
+    message = static_cast<MessagesEnum>(number.value());
+
+    bool hasPlayerData = false;
+    switch (message) {
+    case MessagesEnum::REQ_HANDSHAKE:
+        data["protocolVersion"] = 0u;
+        break;
+    case MessagesEnum::UPDATE_CHAR:
+    case MessagesEnum::REMOVE_CHAR:
+    case MessagesEnum::ADD_CHAR:
+        hasPlayerData = true;
+        break;
+    case MessagesEnum::GTELL:
+        data["from"] = QString();
+        data["text"] = QString();
+        break;
+    case MessagesEnum::RENAME_CHAR:
+        data["oldname"] = QString();
+        data["newname"] = QString();
+        break;
+    case MessagesEnum::MAP_HASHES:
+        data["identity"] = QByteArray();
+        data["hashes"] = QByteArray();
+        FALLTHRU;
+    case MessagesEnum::REQ_MAP_HASHES:
+        data["level"] = 0u;
+        FALLTHRU;
+    case MessagesEnum::REQ_MAP_ROOMS:
+        data["nodes"] = QByteArray();
+        break;
+    case MessagesEnum::MAP_ROOMS:
+        data["rooms"] = QByteArray();
+        break;
+    case MessagesEnum::NONE:
+    case MessagesEnum::ACK:
+    case MessagesEnum::REQ_ACK:
+    case MessagesEnum::REQ_INFO:
+    case MessagesEnum::REQ_LOGIN:
+    case MessagesEnum::PROT_VERSION:
+    case MessagesEnum::STATE_LOGGED:
+    case MessagesEnum::STATE_KICKED:
+        data["text"] = QString();
+        break;
+    }
+
+    bool isDelta = false;
+    QVariantMap playerData;
+    while (!reader.isEmpty()) {
+        const auto tag = reader.readVarint();
+        if (!tag.has_value()) {
+            qWarning() << "Message has a truncated field" << buff;
+            return false;
+        }
+        const auto field = static_cast<F>(tag.value() >> 1);
+        const PlayerDataField *const playerDataField = findPlayerDataField(field);
+        if ((tag.value() & 1u) != 0) {
+            const auto bytes = reader.readBytes();
+            if (!bytes.has_value()) {
+                qWarning() << "Message has a truncated string" << buff;
+                return false;
+            }
+            const QString str = QString::fromLatin1(bytes.value());
+            if (playerDataField != nullptr) {
+                // A string where a number belongs is skipped like an unknown field.
+                if (playerDataField->type == BinaryTypeEnum::STRING)
+                    playerData[playerDataField->key] = str;
+                continue;
+            }
+            switch (field) {
+            case F::TEXT:
+                data["text"] = str;
+                break;
+            case F::FROM:
+                data["from"] = str;
+                break;
+            case F::OLD_NAME:
+                data["oldname"] = str;
+                break;
+            case F::NEW_NAME:
+                data["newname"] = str;
+                break;
+            case F::COMPRESSION:
+                data["compression"] = str;
+                break;
+            case F::MAP_NODES:
+                data["nodes"] = bytes.value();
+                break;
+            case F::MAP_HASHES:
+                data["hashes"] = bytes.value();
+                break;
+            case F::MAP_ROOMS:
+                data["rooms"] = bytes.value();
+                break;
+            case F::MAP_IDENTITY:
+                data["identity"] = bytes.value();
+                break;
+            default:
+                break; // newer than us
+            }
+            continue;
+        }
+
+        const auto value = reader.readVarint();
+        if (!value.has_value()) {
+            qWarning() << "Message has a truncated number" << buff;
+            return false;
+        }
+        const auto u = static_cast<uint32_t>(value.value());
+        if (playerDataField != nullptr) {
+            const auto i = static_cast<int32_t>((u >> 1) ^ (0u - (u & 1u)));
+            if (playerDataField->type == BinaryTypeEnum::SIGNED)
+                playerData[playerDataField->key] = i;
+            else if (playerDataField->type == BinaryTypeEnum::UNSIGNED)
+                playerData[playerDataField->key] = u;
+            continue;
+        }
+        switch (field) {
+        case F::PROTOCOL_VERSION:
+        case F::LOGIN_DATA:
+            data["protocolVersion"] = u;
+            break;
+        case F::SEQUENCE:
+            data["sequence"] = u;
+            break;
+        case F::DELTA:
+            isDelta = true;
+            break;
+        case F::MAP_LEVEL:
+            data["level"] = u;
+            break;
+        default:
+            break; // newer than us
+        }
+    }
+
+    if (!hasPlayerData)
+        return true;
+    if (isDelta) {
+        data["delta"] = true;
+    } else {
+        // Fields that were left out are zero or empty.
+        for (const PlayerDataField &f : PLAYER_DATA_FIELDS) {
+            if (playerData.contains(f.key))
+                continue;
+            switch (f.type) {
+            case BinaryTypeEnum::SIGNED:
+                playerData[f.key] = 0;
+                break;
+            case BinaryTypeEnum::UNSIGNED:
+                playerData[f.key] = 0u;
+                break;
+            case BinaryTypeEnum::STRING:
+                playerData[f.key] = QString();
+                break;
+            }
+        }
+    }
+    data["playerData"] = playerData;
+    return true;
+}
+
+bool parseXmlMessage(const QByteArray &buff, MessagesEnum &message, QVariantMap &data)
+{
+    QXmlStreamReader xml(buff);
+    if (xml.readNextStartElement() && xml.error() != QXmlStreamReader::NoError) {
+        qWarning() << "Message cannot be read" << buff;
+        return false;
+    }
+
+    if (xml.name() != QLatin1String("datagram")) {
+        qWarning() << "Message does not start with element 'datagram'" << buff;
+        return false;
+    }
+    if (xml.attributes().isEmpty() || !xml.attributes().hasAttribute("message")) {
+        qWarning() << "'datagram' element did not have a 'message' attribute" << buff;
+        return false;
+    }
+
+    // TODO: need stronger type checking
+    message = static_cast<MessagesEnum>(xml.attributes().value("message").toInt());
+
+    if (xml.readNextStartElement() && xml.name() != QLatin1String("data")) {
+        qWarning() << "'datagram' element did not have a 'data' child element" << buff;
+        return false;
+    }
+
+    // Deserialize XML
+    while (xml.readNextStartElement()) {
+        switch (message) {
+        case MessagesEnum::GTELL:
+            if (xml.name() == QLatin1String("gtell")) {
+                data["from"] = xml.attributes().value("from").toString();
+                data["text"] = xml.readElementText();
+            }
+            break;
+
+        case MessagesEnum::REQ_HANDSHAKE:
+            if (xml.name() == QLatin1String("protocolVersion")) {
+                data["protocolVersion"] = xml.readElementText();
+            } else if (xml.name() == QLatin1String("compression")) {
+                data["compression"] = xml.readElementText();
+            }
+            break;
+        case MessagesEnum::UPDATE_CHAR:
+            if (xml.name() == QLatin1String("loginData")) {
+                const auto &attributes = xml.attributes();
+                if (attributes.hasAttribute("protocolVersion"))
+                    data["protocolVersion"] = attributes.value("protocolVersion").toUInt();
+                xml.readNextStartElement();
+            }
+            goto common_update_char; // effectively a fall-thru
+
+        common_update_char:
+        case MessagesEnum::REMOVE_CHAR:
+        case MessagesEnum::ADD_CHAR:
+            if (xml.name() == QLatin1String("playerData")) {
+                const auto &attributes = xml.attributes();
+                QVariantMap playerData;
+                playerData["hp"] = attributes.value("hp").toInt();
+                playerData["maxhp"] = attributes.value("maxhp").toInt();
+                playerData["moves"] = attributes.value("moves").toInt();
+                playerData["maxmoves"] = attributes.value("maxmoves").toInt();
+                playerData["mana"] = attributes.value("mana").toInt();
+                playerData["maxmana"] = attributes.value("maxmana").toInt();
+                playerData["state"] = attributes.value("state").toUInt();
+                playerData["name"] = attributes.value("name").toString();
+                playerData["color"] = attributes.value("color").toString();
+                playerData["room"] = attributes.value("room").toUInt();
+                playerData["prespam"] = attributes.value("prespam").toString();
+                playerData["affects"] = attributes.value("affects").toUInt();
+                data["playerData"] = playerData;
+            }
+            break;
+
+        case MessagesEnum::RENAME_CHAR:
+            if (xml.name() == QLatin1String("rename")) {
+                const auto &attributes = xml.attributes();
+                data["oldname"] = attributes.value("oldname").toString();
+                data["newname"] = attributes.value("newname").toString();
+            }
+            break;
+
+        case MessagesEnum::NONE:
+        case MessagesEnum::ACK:
+        case MessagesEnum::REQ_ACK:
+        case MessagesEnum::REQ_INFO:
+        case MessagesEnum::REQ_LOGIN:
+        case MessagesEnum::PROT_VERSION:
+        case MessagesEnum::STATE_LOGGED:
+        case MessagesEnum::STATE_KICKED:
+            if (xml.name() == QLatin1String("text")) {
+                data["text"] = xml.readElementText();
+            }
+            break;
+
+        case MessagesEnum::REQ_MAP_HASHES:
+        case MessagesEnum::MAP_HASHES:
+        case MessagesEnum::REQ_MAP_ROOMS:
+        case MessagesEnum::MAP_ROOMS:
+            break; // never sent as XML
+        }
+    }
+    return true;
+}
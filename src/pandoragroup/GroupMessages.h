@@ -0,0 +1,49 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <QByteArray>
+#include <QVariantMap>
+
+#include "../global/macros.h"
+
+// TODO: password and encryption options
+enum class GroupMessageEnum {
+    NONE, // Unused
+    ACK,
+    REQ_LOGIN,
+    REQ_ACK,
+    REQ_HANDSHAKE,
+    REQ_INFO,
+    PROT_VERSION, // Unused
+    GTELL,
+    STATE_LOGGED,
+    STATE_KICKED,
+    ADD_CHAR,
+    REMOVE_CHAR,
+    UPDATE_CHAR,
+    RENAME_CHAR,
+    // The hashes of the children of "nodes" on "level" (of the host's MapDigest), and
+    // its map "identity", which the client checks before comparing anything
+    REQ_MAP_HASHES,
+    MAP_HASHES,
+    // The rooms whose ids are in "nodes", with the map identity (see encodeSyncedRooms());
+    // both answers are empty if the host doesn't share its map
+    REQ_MAP_ROOMS,
+    MAP_ROOMS
+};
+
+/// Protocol 103 and earlier; map messages can't be sent this way.
+NODISCARD QByteArray formXmlMessageBlock(GroupMessageEnum message, const QVariantMap &data);
+NODISCARD bool parseXmlMessage(const QByteArray &buff,
+                               GroupMessageEnum &message,
+                               QVariantMap &data);
+
+/// Protocol 104 and later.
+NODISCARD QByteArray formBinaryMessageBlock(GroupMessageEnum message, const QVariantMap &data);
+/// Produces the same maps as parseXmlMessage(), except for deltas, whose player data only has
+/// the fields that were sent, and which have "delta" and "sequence" entries. Fields with the
+/// wrong wire type are skipped like unknown ones, and truncated messages are rejected.
+NODISCARD bool parseBinaryMessage(const QByteArray &buff,
+                                  GroupMessageEnum &message,
+                                  QVariantMap &data);
@@ -4,8 +4,16 @@
 
 #include "GroupPortMapper.h"
 
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
 #include <QDebug>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "../global/macros.h"
 
 #ifndef MMAPPER_NO_MINIUPNPC
 #include <miniupnpc/miniupnpc.h>
@@ -49,22 +57,44 @@ using UPNPDev_ptr = std::unique_ptr<UPNPDev, decltype(&::freeUPNPDevlist)>;
 class MiniUPnPcPortMapper final : public GroupPortMapper::Pimpl
 {
 private:
+    // How long to wait for gateways to answer the discovery broadcast.
+    static constexpr const int DISCOVERY_TIMEOUT_MILLIS = 1000;
+    // How long not finding a gateway is remembered before looking again.
+    static constexpr const std::chrono::seconds REDISCOVERY_INTERVAL{60};
+
+    // Guards everything below; miniupnpc's calls block on the network.
+    std::mutex m_mutex;
     UPNPDev_ptr deviceList{nullptr, ::freeUPNPDevlist};
     UPNPUrls urls;
     IGDdatas igdData;
     char lanAddress[64];
     int validIGDState = 0;
+    std::optional<std::chrono::steady_clock::time_point> m_discoveredAt;
 
 public:
-    MiniUPnPcPortMapper()
+    MiniUPnPcPortMapper() = default;
+    virtual ~MiniUPnPcPortMapper() override;
+
+private:
+    // Requires m_mutex. Finds the gateway, unless the last search was recent or found one.
+    bool ensureValidIGD()
     {
+        const auto now = std::chrono::steady_clock::now();
+        if (m_discoveredAt.has_value()
+            && (validIGD() || now - m_discoveredAt.value() < REDISCOVERY_INTERVAL))
+            return validIGD();
+
+        forget();
+        m_discoveredAt = now;
         int result = 0;
 #if MINIUPNPC_API_VERSION < 14
-        deviceList = UPNPDev_ptr(upnpDiscover(1000, nullptr, nullptr, 0, 0, &result),
-                                 ::freeUPNPDevlist);
+        deviceList = UPNPDev_ptr(
+            upnpDiscover(DISCOVERY_TIMEOUT_MILLIS, nullptr, nullptr, 0, 0, &result),
+            ::freeUPNPDevlist);
 #else
-        deviceList = UPNPDev_ptr(upnpDiscover(1000, nullptr, nullptr, 0, 0, 2, &result),
-                                 ::freeUPNPDevlist);
+        deviceList = UPNPDev_ptr(
+            upnpDiscover(DISCOVERY_TIMEOUT_MILLIS, nullptr, nullptr, 0, 0, 2, &result),
+            ::freeUPNPDevlist);
 #endif
         validIGDState = UPNP_GetValidIGD(deviceList.get(),
                                          &urls,
@@ -88,14 +118,26 @@ class MiniUPnPcPortMapper final : public GroupPortMapper::Pimpl
             qWarning() << "UPNP_GetValidIGD returned an unknown result code" << validIGDState;
             break;
         };
+        return validIGD();
+    }
+
+    // Requires m_mutex. The next call discovers the gateway again.
+    void forget()
+    {
+        if (validIGDState != 0)
+            FreeUPNPUrls(&urls);
+        validIGDState = 0;
+        deviceList.reset();
+        m_discoveredAt.reset();
     }
-    virtual ~MiniUPnPcPortMapper() override;
 
     bool validIGD() const { return validIGDState == 1; }
 
+public:
     QByteArray tryGetExternalIp() override
     {
-        if (!validIGD())
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!ensureValidIGD())
             return "";
 
         // REVISIT: Expose the external IP in the preferences?
@@ -120,7 +162,8 @@ class MiniUPnPcPortMapper final : public GroupPortMapper::Pimpl
 
     bool tryAddPortMapping(const quint16 port) override
     {
-        if (!validIGD()) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!ensureValidIGD()) {
             qDebug() << "No IGD found to add a port mapping to";
             return false;
         }
@@ -137,6 +180,9 @@ class MiniUPnPcPortMapper final : public GroupPortMapper::Pimpl
                                          UPNP_PERMANENT_LEASE);
         if (result != UPNPCOMMAND_SUCCESS) {
             qWarning() << "UPNP_AddPortMapping failed with result code" << result;
+            // The gateway may have gone away; look for it again next time.
+            if (result == UPNPCOMMAND_HTTP_ERROR)
+                forget();
             return false;
         }
 
@@ -146,7 +192,9 @@ class MiniUPnPcPortMapper final : public GroupPortMapper::Pimpl
 
     bool tryDeletePortMapping(const quint16 port) override
     {
-        if (!validIGD()) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        // Nothing can have been mapped if the gateway was never found.
+        if (!m_discoveredAt.has_value() || !validIGD()) {
             qDebug() << "No IGD found to remove a port mapping from";
             return false;
         }
@@ -169,18 +217,44 @@ class MiniUPnPcPortMapper final : public GroupPortMapper::Pimpl
 
 MiniUPnPcPortMapper::~MiniUPnPcPortMapper()
 {
-    if (validIGDState != 0)
-        FreeUPNPUrls(&urls);
+    forget();
 }
+#endif
 
-GroupPortMapper::GroupPortMapper()
-    : m_pimpl{std::make_unique<MiniUPnPcPortMapper>()}
-{}
+namespace { // anonymous
+
+std::shared_ptr<GroupPortMapper::Pimpl> getSharedPimpl()
+{
+#ifndef MMAPPER_NO_MINIUPNPC
+    static const auto pimpl = std::make_shared<MiniUPnPcPortMapper>();
 #else
+    static const auto pimpl = std::make_shared<NoopPortMapper>();
+#endif
+    return pimpl;
+}
+
+class NODISCARD DeletePortMapping final : public QRunnable
+{
+private:
+    std::shared_ptr<GroupPortMapper::Pimpl> m_pimpl;
+    quint16 m_port = 0;
+
+public:
+    explicit DeletePortMapping(std::shared_ptr<GroupPortMapper::Pimpl> pimpl, const quint16 port)
+        : m_pimpl{std::move(pimpl)}
+        , m_port{port}
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override { m_pimpl->tryDeletePortMapping(m_port); }
+};
+
+} // namespace
+
 GroupPortMapper::GroupPortMapper()
-    : m_pimpl{std::make_unique<NoopPortMapper>()}
+    : m_pimpl{getSharedPimpl()}
 {}
-#endif
 
 GroupPortMapper::~GroupPortMapper() = default;
 
@@ -198,3 +272,8 @@ bool GroupPortMapper::tryDeletePortMapping(const quint16 port)
 {
     return m_pimpl->tryDeletePortMapping(port);
 }
+
+void GroupPortMapper::deletePortMappingInBackground(const quint16 port)
+{
+    QThreadPool::globalInstance()->start(new DeletePortMapping(m_pimpl, port));
+}
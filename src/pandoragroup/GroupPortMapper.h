@@ -8,13 +8,19 @@
 #include <memory>
 #include <QByteArray>
 
+/// Maps the group server's port on the UPnP gateway.
+///
+/// Every call may block for seconds on the network, so GroupServer makes them
+/// from a background thread; they're safe to call from any thread. The gateway
+/// is discovered on first use and its description is kept for the whole process,
+/// so a restarted server doesn't have to find it again.
 class GroupPortMapper final
 {
 public:
     struct Pimpl;
 
 private:
-    std::unique_ptr<Pimpl> m_pimpl;
+    std::shared_ptr<Pimpl> m_pimpl;
 
 public:
     GroupPortMapper();
@@ -24,4 +30,6 @@ class GroupPortMapper final
     QByteArray tryGetExternalIp();
     bool tryAddPortMapping(quint16 port);
     bool tryDeletePortMapping(quint16 port);
+    /// Returns at once; the mapping is deleted on the global thread pool.
+    void deletePortMappingInBackground(quint16 port);
 };
@@ -6,6 +6,8 @@
 #include "GroupServer.h"
 
 #include <algorithm>
+#include <optional>
+#include <vector>
 #include <QAbstractSocket>
 #include <QByteArray>
 #include <QHostAddress>
@@ -62,37 +64,73 @@ void GroupServer::errorInConnection(GroupSocket *const socket, const QString &er
     closeOne(socket);
 }
 
-void GroupServer::sendToAll(const QByteArray &message)
+void GroupServer::sendToAll(const MessagesEnum message, const QVariantMap &data)
 {
-    sendToAllExceptOne(nullptr, message);
+    sendToAllExceptOne(nullptr, message, data);
 }
 
-void GroupServer::sendToAllExceptOne(GroupSocket *const exception, const QByteArray &message)
+void GroupServer::sendToAllExceptOne(GroupSocket *const exception,
+                                     const MessagesEnum message,
+                                     const QVariantMap &data)
 {
+    sendToAllExceptOne(exception, message, data, data);
+}
+
+void GroupServer::sendToAllExceptOne(GroupSocket *const exception,
+                                     const MessagesEnum message,
+                                     const QVariantMap &xmlData,
+                                     const QVariantMap &binaryData)
+{
+    // Each encoding is formed and framed at most once, when the first client that uses it is
+    // found, and every client is then given the same implicitly shared buffer.
+    std::optional<QByteArray> xmlFrame;
+    std::optional<QByteArray> binaryFrame;
     for (auto &connection : clientsList) {
         if (connection == exception)
             continue;
         if (connection->getProtocolState() == ProtocolStateEnum::Logged) {
-            connection->sendData(message);
+            const ProtocolVersion version = connection->getProtocolVersion();
+            const bool binary = usesBinaryMessages(version);
+            auto &frame = binary ? binaryFrame : xmlFrame;
+            if (!frame.has_value())
+                frame = GroupSocket::formFrame(
+                    formMessageBlock(version, message, binary ? binaryData : xmlData));
+            connection->sendFrame(frame.value());
         }
     }
 }
 
+std::vector<CGroupCommunicator::Link> GroupServer::getLinks()
+{
+    std::vector<Link> links;
+    for (auto &connection : clientsList) {
+        if (connection != nullptr && connection->getProtocolState() == ProtocolStateEnum::Logged)
+            links.emplace_back(Link{connection->getName(), connection.data()});
+    }
+    return links;
+}
+
 void GroupServer::closeAll()
 {
     for (auto &connection : clientsList) {
         if (connection != nullptr) {
+            if (connection->getProtocolState() == ProtocolStateEnum::Logged)
+                logLinkSummary(connection->getName(), *connection);
             connection->disconnectFromHost();
             disconnectAll(connection);
         }
     }
     clientsList.clear();
+    relayedPlayerData.clear();
 }
 
 void GroupServer::closeOne(GroupSocket *const target)
 {
+    if (target->getProtocolState() == ProtocolStateEnum::Logged)
+        logLinkSummary(target->getName(), *target);
     target->disconnectFromHost();
     disconnectAll(target);
+    relayedPlayerData.erase(target);
 
     auto it = std::find_if(clientsList.begin(), clientsList.end(), [&target](const auto &socket) {
         return socket == target;
@@ -130,6 +168,7 @@ void GroupServer::disconnectAll(GroupSocket *const client)
 GroupServer::GroupServer(Mmapper2Group *parent)
     : CGroupCommunicator(GroupManagerStateEnum::Server, parent)
     , server(this)
+    , portMappingJob(*this)
 {
     connect(&server, &GroupTcpServer::acceptError, this, [this]() {
         emit sendLog(QString("Server encountered an error: %1").arg(server.errorString()));
@@ -149,10 +188,10 @@ GroupServer::~GroupServer()
                this,
                &GroupServer::onRevokeWhitelist);
     closeAll();
+    portMappingJob.cancel();
+    // Stopping the server shouldn't wait for the router.
     const auto localPort = static_cast<quint16>(getConfig().groupManager.localPort);
-    if (portMapper.tryDeletePortMapping(localPort)) {
-        emit sendLog("Deleted port mapping from UPnP IGD router");
-    }
+    portMapper.deletePortMappingInBackground(localPort);
 }
 
 void GroupServer::connectionClosed(GroupSocket *const socket)
@@ -169,7 +208,9 @@ void GroupServer::connectionClosed(GroupSocket *const socket)
 void GroupServer::connectionEstablished(GroupSocket *const socket)
 {
     QVariantMap handshake;
-    handshake["protocolVersion"] = NO_OPEN_SSL ? PROTOCOL_VERSION_102 : PROTOCOL_VERSION_103;
+    handshake["protocolVersion"] = NO_OPEN_SSL ? PROTOCOL_VERSION_102 : PROTOCOL_VERSION_105;
+    if (!NO_ZLIB)
+        handshake["compression"] = COMPRESSION_ZLIB;
     sendMessage(socket, MessagesEnum::REQ_HANDSHAKE, handshake);
 }
 
@@ -224,13 +265,14 @@ void GroupServer::retrieveData(GroupSocket *const socket,
     } else if (socket->getProtocolState() == ProtocolStateEnum::Logged) {
         // usual update situation. receive update, unpack, apply.
         if (message == MessagesEnum::UPDATE_CHAR) {
-            const QString &updateName = QString::fromLatin1(CGroupChar::getNameFromUpdateChar(data));
+            CharacterState update = CharacterState::fromMessage(data);
+            const QString updateName = QString::fromLatin1(update.name);
             if (updateName.compare(nameStr, Qt::CaseInsensitive) != 0) {
                 emit sendLog(QString("WARNING: '%1' spoofed as '%2'").arg(nameStr).arg(updateName));
                 return;
             }
-            emit sig_scheduleAction(std::make_shared<UpdateCharacter>(data));
-            relayMessage(socket, MessagesEnum::UPDATE_CHAR, data);
+            relayCharUpdate(socket, data, update);
+            emit sig_scheduleAction(std::make_shared<UpdateCharacter>(std::move(update)));
 
         } else if (message == MessagesEnum::GTELL) {
             const auto &fromName = QString::fromLatin1(data["from"].toByteArray()).simplified();
@@ -244,6 +286,10 @@ void GroupServer::retrieveData(GroupSocket *const socket,
         } else if (message == MessagesEnum::REQ_ACK) {
             sendMessage(socket, MessagesEnum::ACK);
 
+        } else if (message == MessagesEnum::ACK) {
+            // Reply to our ping
+            socket->onPingAnswered();
+
         } else if (message == MessagesEnum::RENAME_CHAR) {
             const QString oldName = QString::fromLatin1(data["oldname"].toByteArray()).simplified();
             if (oldName.compare(nameStr, Qt::CaseInsensitive) != 0) {
@@ -269,6 +315,11 @@ void GroupServer::retrieveData(GroupSocket *const socket,
             emit sig_scheduleAction(std::make_shared<RenameCharacter>(data));
             relayMessage(socket, MessagesEnum::RENAME_CHAR, data);
 
+        } else if ((message == MessagesEnum::REQ_MAP_HASHES
+                    || message == MessagesEnum::REQ_MAP_ROOMS)
+                   && syncsMaps(socket->getProtocolVersion())) {
+            answerMapRequest(socket, message, data);
+
         } else {
             // ERROR: unexpected message marker!
             // try to ignore?
@@ -277,11 +328,13 @@ void GroupServer::retrieveData(GroupSocket *const socket,
     }
 }
 
-void GroupServer::sendCharUpdate(const QVariantMap &map)
+void GroupServer::sendCharUpdate(const SharedCharacterState &state)
 {
     if (getConfig().groupManager.shareSelf) {
-        const QByteArray &message = formMessageBlock(MessagesEnum::UPDATE_CHAR, map);
-        sendToAll(message);
+        sendToAllExceptOne(nullptr,
+                           MessagesEnum::UPDATE_CHAR,
+                           state->toMessage(),
+                           selfDeltas.next(*state));
     }
 }
 
@@ -304,7 +357,7 @@ void GroupServer::parseHandshake(GroupSocket *const socket, const QVariantMap &d
                        "Please upgrade to the latest MMapper.");
         return;
     }
-    auto supportedProtocolVersion = NO_OPEN_SSL ? PROTOCOL_VERSION_102 : PROTOCOL_VERSION_103;
+    auto supportedProtocolVersion = NO_OPEN_SSL ? PROTOCOL_VERSION_102 : PROTOCOL_VERSION_105;
     if (clientProtocolVersion > supportedProtocolVersion) {
         kickConnection(socket, "Host uses an older version of MMapper and needs to upgrade.");
         return;
@@ -316,6 +369,9 @@ void GroupServer::parseHandshake(GroupSocket *const socket, const QVariantMap &d
         assert(!NO_OPEN_SSL);
         sendMessage(socket, MessagesEnum::REQ_LOGIN);
         socket->setProtocolVersion(clientProtocolVersion);
+        // The client only asks for compression if we offered it
+        if (!NO_ZLIB && data["compression"].toString() == COMPRESSION_ZLIB)
+            socket->startCompression();
         socket->startServerEncrypted();
     }
 }
@@ -408,7 +464,9 @@ void GroupServer::parseLoginInformation(GroupSocket *socket, const QVariantMap &
     // Strip protocolVersion from original QVariantMap
     QVariantMap charNode;
     charNode["playerData"] = playerData;
-    emit sig_scheduleAction(std::make_shared<AddCharacter>(charNode));
+    CharacterState state = CharacterState::fromPlayerData(playerData);
+    relayedPlayerData.insert_or_assign(socket, state.clone());
+    emit sig_scheduleAction(std::make_shared<AddCharacter>(std::move(state)));
     relayMessage(socket, MessagesEnum::ADD_CHAR, charNode);
     sendMessage(socket, MessagesEnum::ACK);
     socket->setProtocolState(ProtocolStateEnum::AwaitingInfo);
@@ -426,7 +484,7 @@ void GroupServer::sendGroupInformation(GroupSocket *const socket)
         if (getGroup()->getSelf() == character && !getConfig().groupManager.shareSelf) {
             continue;
         }
-        CGroupCommunicator::sendCharUpdate(socket, character->toVariantMap());
+        CGroupCommunicator::sendCharUpdate(socket, character->getState());
     }
 }
 
@@ -435,31 +493,41 @@ void GroupServer::sendRemoveUserNotification(GroupSocket *const socket, const QB
     auto selection = getGroup()->selectByName(name);
     for (const auto &character : *selection) {
         if (character->getName() == name) {
-            const QVariantMap &map = character->toVariantMap();
-            const QByteArray &message = formMessageBlock(MessagesEnum::REMOVE_CHAR, map);
-            sendToAllExceptOne(socket, message);
+            sendToAllExceptOne(socket,
+                               MessagesEnum::REMOVE_CHAR,
+                               character->getState().toMessage());
         }
     }
 }
 
 void GroupServer::sendGroupTellMessage(const QVariantMap &root)
 {
-    const QByteArray &message = formMessageBlock(MessagesEnum::GTELL, root);
-    sendToAll(message);
+    sendToAll(MessagesEnum::GTELL, root);
 }
 
 void GroupServer::relayMessage(GroupSocket *const socket,
                                const MessagesEnum message,
                                const QVariantMap &data)
 {
-    const QByteArray &buffer = formMessageBlock(message, data);
-    sendToAllExceptOne(socket, buffer);
+    sendToAllExceptOne(socket, message, data);
+}
+
+void GroupServer::relayCharUpdate(GroupSocket *const socket,
+                                  const QVariantMap &data,
+                                  const CharacterState &update)
+{
+    // Clients that use XML can't take deltas, so they get the merged state instead.
+    CharacterState &merged = relayedPlayerData[socket];
+    if (data["delta"].toBool())
+        merged.merge(update);
+    else
+        merged = update.clone();
+    sendToAllExceptOne(socket, MessagesEnum::UPDATE_CHAR, merged.toMessage(), data);
 }
 
 void GroupServer::sendCharRename(const QVariantMap &map)
 {
-    QByteArray message = formMessageBlock(MessagesEnum::RENAME_CHAR, map);
-    sendToAll(message);
+    sendToAll(MessagesEnum::RENAME_CHAR, map);
 }
 
 void GroupServer::stop()
@@ -478,11 +546,6 @@ bool GroupServer::start()
         server.close();
     }
     const auto localPort = static_cast<quint16>(getConfig().groupManager.localPort);
-    if (portMapper.tryAddPortMapping(localPort)) {
-        const QString externalIp = QString::fromLocal8Bit(portMapper.tryGetExternalIp());
-        emit sendLog(
-            QString("Added port mapping to UPnP IGD router with external IP: %1").arg(externalIp));
-    }
     emit sendLog(QString("Listening on port %1").arg(localPort));
     if (!server.listen(QHostAddress::Any, localPort)) {
         emit sendLog("Failed to start a group Manager server");
@@ -490,6 +553,18 @@ bool GroupServer::start()
             QString("Failed to start the groupManager server: %1.").arg(server.errorString()));
         return false;
     }
+
+    // Finding the router and asking it for a mapping can take seconds, so it's
+    // reported whenever it's done; clients on the LAN can connect meanwhile.
+    portMappingJob.start([this, localPort](const BackgroundJob::Token &token) {
+        if (!portMapper.tryAddPortMapping(localPort) || token.isCancelled())
+            return;
+        const QString externalIp = QString::fromLocal8Bit(portMapper.tryGetExternalIp());
+        token.post([this, externalIp]() {
+            emit sendLog(QString("Added port mapping to UPnP IGD router with external IP: %1")
+                             .arg(externalIp));
+        });
+    });
     return true;
 }
 
@@ -503,6 +578,11 @@ void GroupServer::kickCharacter(const QByteArray &name)
     }
 }
 
+void GroupServer::syncMap()
+{
+    throw std::runtime_error("impossible");
+}
+
 void GroupServer::kickConnection(GroupSocket *const socket, const QString &message)
 {
     if (socket->getProtocolVersion() == PROTOCOL_VERSION_102
@@ -4,9 +4,11 @@
 // Author: Dmitrijs Barbarins <lachupe@gmail.com> (Azazello)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include "../global/BackgroundJob.h"
 #include "CGroupCommunicator.h"
 #include "GroupPortMapper.h"
 
+#include <map>
 #include <vector>
 #include <QByteArray>
 #include <QPointer>
@@ -56,9 +58,11 @@ protected slots:
     void sendGroupTellMessage(const QVariantMap &root) override;
     bool start() override;
     void stop() override;
-    void sendCharUpdate(const QVariantMap &map) override;
+    void sendCharUpdate(const SharedCharacterState &state) override;
+    std::vector<Link> getLinks() override;
     void sendCharRename(const QVariantMap &map) override;
     void kickCharacter(const QByteArray &) override;
+    void syncMap() override;
 
 private:
     void parseHandshake(GroupSocket *socket, const QVariantMap &data);
@@ -71,8 +75,15 @@ protected slots:
     void errorInConnection(GroupSocket *, const QString &);
 
 private:
-    void sendToAll(const QByteArray &);
-    void sendToAllExceptOne(GroupSocket *exception, const QByteArray &);
+    void sendToAll(MessagesEnum message, const QVariantMap &data);
+    void sendToAllExceptOne(GroupSocket *exception, MessagesEnum message, const QVariantMap &data);
+    void sendToAllExceptOne(GroupSocket *exception,
+                            MessagesEnum message,
+                            const QVariantMap &xmlData,
+                            const QVariantMap &binaryData);
+    void relayCharUpdate(GroupSocket *socket,
+                         const QVariantMap &data,
+                         const CharacterState &update);
     void closeAll();
     void closeOne(GroupSocket *target);
     void connectAll(GroupSocket *);
@@ -80,6 +91,11 @@ protected slots:
 
     using ClientList = std::vector<QPointer<GroupSocket>>;
     ClientList clientsList{};
+    // The merged state of each client's character, for relaying deltas to older clients
+    std::map<GroupSocket *, CharacterState> relayedPlayerData{};
+    CharUpdateDeltas selfDeltas{};
     GroupTcpServer server;
     GroupPortMapper portMapper;
+    // Adds the port mapping; declared last, so it's waited for before portMapper goes.
+    BackgroundJob portMappingJob;
 };
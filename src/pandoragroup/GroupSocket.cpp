@@ -5,7 +5,10 @@
 
 #include "GroupSocket.h"
 
+#include <algorithm>
 #include <cassert>
+#include <stdexcept>
+#include <utility>
 #include <QByteArray>
 #include <QHostAddress>
 #include <QMessageLogContext>
@@ -20,6 +23,9 @@
 
 static constexpr const bool DEBUG = false;
 static constexpr const auto THIRTY_SECOND_TIMEOUT = 30000;
+// Far more than any message needs (a map sync reply is the biggest); a peer that announces
+// more is dropped, rather than making us buffer whatever it claims to send.
+static constexpr const unsigned int MAX_MESSAGE_LENGTH = 1u << 20;
 
 GroupSocket::GroupSocket(GroupAuthority *authority, QObject *parent)
     : QObject(parent)
@@ -79,6 +85,7 @@ GroupSocket::~GroupSocket()
 {
     timer.stop();
     socket.disconnectFromHost();
+    endCompression();
 }
 
 void GroupSocket::connectToHost()
@@ -223,61 +230,235 @@ void GroupSocket::onTimeout()
 void GroupSocket::onReadyRead()
 {
     io::readAllAvailable(socket, ioBuffer, [this](const QByteArray &byteArray) {
-        for (const auto &c : byteArray) {
-            onReadInternal(c);
-        }
+        const int length = byteArray.size();
+        stats.bytesIn += static_cast<uint64_t>(length);
+        const int used = compressed ? 0 : onReadInternal(byteArray.constData(), length);
+        // The rest of this read is compressed if compression began partway through it
+        if (used < length)
+            inflateInput(byteArray.constData() + used, length - used);
     });
 }
 
-void GroupSocket::onReadInternal(const char c)
+int GroupSocket::onReadInternal(const char *const data, const int length)
 {
-    switch (state) {
-    case GroupMessageStateEnum::LENGTH:
-        if (c == ' ' && currentMessageLen > 0) {
-            // Terminating space received
-            state = GroupMessageStateEnum::PAYLOAD;
-        } else if (c >= '0' && c <= '9') {
-            // Digit received
-            currentMessageLen *= 10;
-            currentMessageLen += static_cast<unsigned int>(c - '0');
-        } else {
-            // Reset due to garbage
-            currentMessageLen = 0;
+    const bool wasCompressed = compressed;
+    const char *pos = data;
+    const char *const end = pos + length;
+    while (pos != end) {
+        switch (state) {
+        case GroupMessageStateEnum::LENGTH: {
+            const char c = *pos++;
+            if (c == ' ' && currentMessageLen > 0) {
+                // Terminating space received
+                state = GroupMessageStateEnum::PAYLOAD;
+            } else if (c >= '0' && c <= '9') {
+                // Digit received; the check below keeps this from overflowing.
+                currentMessageLen *= 10;
+                currentMessageLen += static_cast<unsigned int>(c - '0');
+                if (currentMessageLen > MAX_MESSAGE_LENGTH) {
+                    currentMessageLen = 0;
+                    buffer.clear();
+                    emit errorInConnection(this, "Received a message that is too long");
+                    return length;
+                }
+            } else {
+                // Reset due to garbage
+                currentMessageLen = 0;
+            }
+            break;
         }
-        break;
-    case GroupMessageStateEnum::PAYLOAD:
-        buffer.append(c);
-        if (static_cast<unsigned int>(buffer.size()) == currentMessageLen) {
-            // Cut message from buffer
-            if (DEBUG)
-                qDebug() << "Incoming message:" << buffer;
-            emit incomingData(this, buffer);
-
-            // Reset state machine
-            buffer.clear();
-            currentMessageLen = 0;
-            state = GroupMessageStateEnum::LENGTH;
+        case GroupMessageStateEnum::PAYLOAD: {
+            // Take as much of the payload as this read has in one go
+            const auto missing = currentMessageLen - static_cast<unsigned int>(buffer.size());
+            const auto available = static_cast<unsigned int>(end - pos);
+            const auto n = static_cast<int>(std::min(missing, available));
+            if (buffer.isEmpty() && n == static_cast<int>(missing)) {
+                // The whole payload is here, so it doesn't need to be buffered
+                buffer = QByteArray(pos, n);
+            } else {
+                // Only grows by what has arrived, whatever length was announced.
+                buffer.append(pos, n);
+            }
+            pos += n;
+
+            if (static_cast<unsigned int>(buffer.size()) == currentMessageLen) {
+                // Cut message from buffer
+                if (DEBUG)
+                    qDebug() << "Incoming message:" << buffer;
+                const QByteArray message = std::exchange(buffer, QByteArray{});
+
+                // Reset state machine
+                currentMessageLen = 0;
+                state = GroupMessageStateEnum::LENGTH;
+                ++stats.messagesIn;
+                emit incomingData(this, message);
+
+                // The message may have started compression
+                if (compressed != wasCompressed)
+                    return static_cast<int>(pos - data);
+            }
+            break;
         }
-        break;
+        }
+    }
+    return length;
+}
+
+void GroupSocket::startCompression()
+{
+#ifdef MMAPPER_NO_ZLIB
+    abort();
+#else
+    if (compressed)
+        return;
+
+    // Group messages are small; this is enough for most reads to be inflated in one go.
+    static constexpr const size_t INFLATE_BUFFER_SIZE = 16 * 1024;
+    if (inflateBuffer.empty())
+        inflateBuffer.resize(INFLATE_BUFFER_SIZE);
+
+    inStream.zalloc = Z_NULL;
+    inStream.zfree = Z_NULL;
+    inStream.opaque = Z_NULL;
+    inStream.avail_in = 0;
+    inStream.next_in = Z_NULL;
+    if (inflateInit(&inStream) != Z_OK)
+        throw std::runtime_error("Unable to initialize zlib");
+
+    outStream.zalloc = Z_NULL;
+    outStream.zfree = Z_NULL;
+    outStream.opaque = Z_NULL;
+    if (deflateInit(&outStream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        inflateEnd(&inStream);
+        throw std::runtime_error("Unable to initialize zlib");
+    }
+    compressed = true;
+    emit sendLog("Group traffic is now compressed.");
+#endif
+}
+
+void GroupSocket::endCompression()
+{
+#ifndef MMAPPER_NO_ZLIB
+    if (compressed) {
+        inflateEnd(&inStream);
+        deflateEnd(&outStream);
     }
+#endif
+    compressed = false;
+}
+
+void GroupSocket::inflateInput(const char *const data, const int length)
+{
+#ifdef MMAPPER_NO_ZLIB
+    static_cast<void>(data);
+    static_cast<void>(length);
+    abort();
+#else
+    assert(compressed);
+    const int CHUNK = static_cast<int>(inflateBuffer.size());
+    char *const out = inflateBuffer.data();
+
+    inStream.avail_in = static_cast<uInt>(length);
+    inStream.next_in = reinterpret_cast<const Bytef *>(data);
+    do {
+        inStream.avail_out = static_cast<uInt>(CHUNK);
+        inStream.next_out = reinterpret_cast<Bytef *>(out);
+        switch (::inflate(&inStream, Z_SYNC_FLUSH)) {
+        case Z_NEED_DICT:
+        case Z_DATA_ERROR:
+        case Z_MEM_ERROR:
+        case Z_STREAM_END:
+        case Z_STREAM_ERROR:
+            qWarning() << "Unable to inflate group data" << inStream.msg;
+            endCompression();
+            emit errorInConnection(this, "Received corrupt compressed data");
+            return;
+        default:
+            break;
+        }
+
+        const int outLen = CHUNK - static_cast<int>(inStream.avail_out);
+        if (outLen > 0)
+            onReadInternal(out, outLen);
+    } while (compressed && inStream.avail_out == 0);
+#endif
+}
+
+QByteArray GroupSocket::deflateOutput(const QByteArray &data)
+{
+#ifdef MMAPPER_NO_ZLIB
+    static_cast<void>(data);
+    abort();
+#else
+    assert(compressed);
+    // deflate() never needs more than this, plus a few bytes for the sync flush
+    static constexpr const int SLACK = 64;
+    const int bound = static_cast<int>(deflateBound(&outStream, static_cast<uLong>(data.size())))
+                      + SLACK;
+
+    QByteArray result;
+    outStream.avail_in = static_cast<uInt>(data.size());
+    outStream.next_in = reinterpret_cast<const Bytef *>(data.data());
+    do {
+        const int used = result.size();
+        result.resize(used + bound);
+        outStream.avail_out = static_cast<uInt>(bound);
+        outStream.next_out = reinterpret_cast<Bytef *>(result.data() + used);
+        // Z_SYNC_FLUSH, because the peer has to be able to read the message now.
+        if (::deflate(&outStream, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+            throw std::runtime_error("Unable to compress");
+        result.resize(used + bound - static_cast<int>(outStream.avail_out));
+    } while (outStream.avail_out == 0);
+    return result;
+#endif
 }
 
 /*
  * Protocol is <message length as string> <space> <message XML>
  */
+QByteArray GroupSocket::formFrame(const QByteArray &data)
+{
+    const QByteArray len = QByteArray::number(data.size());
+    QByteArray frame;
+    frame.reserve(len.size() + 1 + data.size());
+    frame += len;
+    frame += ' ';
+    frame += data;
+    return frame;
+}
+
 void GroupSocket::sendData(const QByteArray &data)
+{
+    sendFrame(formFrame(data));
+}
+
+void GroupSocket::sendFrame(const QByteArray &frame)
 {
     if (socket.state() != QAbstractSocket::ConnectedState) {
         qWarning() << "Socket is not connected";
         return;
     }
-    QByteArray buff;
-    QString len = QString("%1 ").arg(data.size());
-    buff = len.toLatin1();
-    buff += data;
     if (DEBUG)
-        qDebug() << "Sending message:" << buff;
-    socket.write(buff);
+        qDebug() << "Sending message:" << frame;
+    const qint64 written = socket.write(compressed ? deflateOutput(frame) : frame);
+    if (written > 0)
+        stats.bytesOut += static_cast<uint64_t>(written);
+    ++stats.messagesOut;
+}
+
+qint64 GroupSocket::getQueuedBytes() const
+{
+    return socket.bytesToWrite() + socket.encryptedBytesToWrite();
+}
+
+void GroupSocket::onPingAnswered()
+{
+    if (!stats.pingSent.has_value())
+        return;
+    stats.roundTrip = std::chrono::duration_cast<std::chrono::milliseconds>(
+        GroupSocketStats::Clock::now() - stats.pingSent.value());
+    stats.pingSent.reset();
 }
 
 void GroupSocket::reset()
@@ -289,4 +470,6 @@ void GroupSocket::reset()
     name.clear();
     state = GroupMessageStateEnum::LENGTH;
     currentMessageLen = 0;
+    stats = GroupSocketStats{};
+    endCompression();
 }
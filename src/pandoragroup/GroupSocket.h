@@ -4,6 +4,10 @@
 // Author: Dmitrijs Barbarins <lachupe@gmail.com> (Azazello)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <vector>
 #include <QAbstractSocket>
 #include <QByteArray>
 #include <QMap>
@@ -14,13 +18,35 @@
 #include <QtCore>
 #include <QtGlobal>
 
+#ifndef MMAPPER_NO_ZLIB
+#include <zlib.h>
+#endif
+
 #include "../global/io.h"
+#include "../global/macros.h"
 
 class GroupAuthority;
 
 enum class ProtocolStateEnum { Unconnected, AwaitingLogin, AwaitingInfo, Logged };
 using ProtocolVersion = uint32_t;
 
+/// What went over one connection since it was established.
+struct NODISCARD GroupSocketStats final
+{
+    using Clock = std::chrono::steady_clock;
+
+    /// As they were read from or written to the socket, i.e. after compression.
+    uint64_t bytesIn = 0;
+    uint64_t bytesOut = 0;
+    uint64_t messagesIn = 0;
+    uint64_t messagesOut = 0;
+    /// Spent in CGroupCommunicator::incomingData turning messagesIn into maps.
+    std::chrono::nanoseconds parseTime{0};
+    /// The last reply to a ping (REQ_ACK), and when the unanswered one was sent, if any.
+    std::optional<std::chrono::milliseconds> roundTrip;
+    std::optional<Clock::time_point> pingSent;
+};
+
 class GroupSocket final : public QObject
 {
     Q_OBJECT
@@ -50,7 +76,23 @@ class GroupSocket final : public QObject
     void setName(const QByteArray val) { name = val; }
     const QByteArray &getName() { return name; }
 
+    const GroupSocketStats &getStats() const { return stats; }
+    /// Bytes that were sent but haven't left yet.
+    qint64 getQueuedBytes() const;
+    void recordParseTime(const std::chrono::nanoseconds time) { stats.parseTime += time; }
+    void onPingSent() { stats.pingSent = GroupSocketStats::Clock::now(); }
+    void onPingAnswered();
+
+    /// Deflates everything sent and inflates everything received from now on; both peers have
+    /// to call this at the same point in the conversation, once they've agreed to it.
+    /// NOTE: Requires zlib; don't call it if NO_ZLIB.
+    void startCompression();
+    bool isCompressed() const { return compressed; }
+
     void sendData(const QByteArray &data);
+    /// Sends a message that was already framed by formFrame(), e.g. one that goes to many sockets.
+    void sendFrame(const QByteArray &frame);
+    static QByteArray formFrame(const QByteArray &data);
 
 protected slots:
     void onError(QAbstractSocket::SocketError socketError);
@@ -68,11 +110,15 @@ protected slots:
 
 private:
     void reset();
+    void endCompression();
+    void inflateInput(const char *data, int length);
+    QByteArray deflateOutput(const QByteArray &data);
 
     QSslSocket socket;
     QTimer timer;
     GroupAuthority *const authority;
-    void onReadInternal(char c);
+    // Returns how many bytes were used, which is fewer if compression began partway through.
+    int onReadInternal(const char *data, int length);
 
     ProtocolStateEnum protocolState = ProtocolStateEnum::Unconnected;
     ProtocolVersion protocolVersion = 102;
@@ -90,4 +136,13 @@ protected slots:
     QByteArray secret;
     QByteArray name;
     unsigned int currentMessageLen = 0;
+    GroupSocketStats stats;
+
+#ifndef MMAPPER_NO_ZLIB
+    z_stream inStream;
+    z_stream outStream;
+#endif
+    /** reused for the output of every inflate() call */
+    std::vector<char> inflateBuffer;
+    bool compressed = false;
 };
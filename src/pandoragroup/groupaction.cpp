@@ -4,7 +4,6 @@
 
 #include "groupaction.h"
 #include "CGroup.h"
-#include "CGroupChar.h"
 #include <cassert>
 #include <utility>
 
@@ -13,26 +12,18 @@ GroupAction::~GroupAction() = default;
 
 /**
  * @brief AddCharacter::AddCharacter
- * @param Variant map representing the character
+ * @param State of the character
  */
-AddCharacter::AddCharacter(const QVariantMap &map)
-    : map(map)
+AddCharacter::AddCharacter(CharacterState state)
+    : state(std::move(state))
 {}
 
 void AddCharacter::exec()
 {
     assert(group);
-    group->addChar(map);
+    group->addChar(state);
 }
 
-/**
- * @brief RemoveCharacter::RemoveCharacter
- * @param Variant map representing which character to delete
- */
-RemoveCharacter::RemoveCharacter(const QVariantMap &map)
-    : RemoveCharacter(CGroupChar::getNameFromUpdateChar(map))
-{}
-
 /**
  * @brief RemoveCharacter::RemoveCharacter
  * @param name of the character to delete
@@ -49,16 +40,16 @@ void RemoveCharacter::exec()
 
 /**
  * @brief UpdateCharacter::UpdateCharacter
- * @param Variant map with which to update the character with
+ * @param State with which to update the character, which may only set some fields
  */
-UpdateCharacter::UpdateCharacter(const QVariantMap &map)
-    : map(map)
+UpdateCharacter::UpdateCharacter(CharacterState state)
+    : state(std::move(state))
 {}
 
 void UpdateCharacter::exec()
 {
     assert(group);
-    group->updateChar(map);
+    group->updateChar(state);
 }
 
 /**
@@ -8,6 +8,8 @@
 #include <QString>
 #include <QVariantMap>
 
+#include "CharacterState.h"
+
 class CGroup;
 
 class GroupAction
@@ -26,19 +28,18 @@ class GroupAction
 class AddCharacter final : public GroupAction
 {
 public:
-    explicit AddCharacter(const QVariantMap &map);
+    explicit AddCharacter(CharacterState state);
 
 protected:
     void exec() override;
 
 private:
-    QVariantMap map;
+    CharacterState state;
 };
 
 class RemoveCharacter final : public GroupAction
 {
 public:
-    explicit RemoveCharacter(const QVariantMap &variant);
     explicit RemoveCharacter(QByteArray);
 
 protected:
@@ -51,13 +52,13 @@ class RemoveCharacter final : public GroupAction
 class UpdateCharacter final : public GroupAction
 {
 public:
-    explicit UpdateCharacter(const QVariantMap &variant);
+    explicit UpdateCharacter(CharacterState state);
 
 protected:
     void exec() override;
 
 private:
-    QVariantMap map;
+    CharacterState state;
 };
 
 class RenameCharacter final : public GroupAction
@@ -188,6 +188,7 @@ void GroupAuthority::refresh()
     if (key.isNull()) {
         qWarning() << "Unable to generate a valid private key" << key;
     }
+    getConfig().writeLater();
     emit secretRefreshed(getSecret());
 }
 #else
@@ -276,6 +277,7 @@ bool GroupAuthority::add(const GroupSecret &secret)
 
         // Update configuration
         setConfig().groupManager.authorizedSecrets = model.stringList();
+        getConfig().writeLater();
         return true;
     }
 
@@ -303,6 +305,7 @@ bool GroupAuthority::remove(const GroupSecret &secret)
             for (auto type : ALL_GROUP_METADATA) {
                 conf.secretMetadata.remove(getMetadataKey(secret, type));
             }
+            getConfig().writeLater();
             return true;
         }
     }
@@ -339,4 +342,5 @@ void GroupAuthority::setMetadata(const GroupSecret &secret,
 {
     auto &metadata = setConfig().groupManager.secretMetadata;
     metadata[getMetadataKey(secret, meta)] = value;
+    getConfig().writeLater();
 }
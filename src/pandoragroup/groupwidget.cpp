@@ -4,6 +4,9 @@
 
 #include "groupwidget.h"
 
+#include <cstdint>
+#include <utility>
+#include <vector>
 #include <QAction>
 #include <QHeaderView>
 #include <QMessageLogContext>
@@ -24,9 +27,9 @@
 #include "groupselection.h"
 #include "mmapper2group.h"
 
-static constexpr const int GROUP_COLUMN_COUNT = 9;
-static_assert(GROUP_COLUMN_COUNT == static_cast<int>(GroupModel::ColumnTypeEnum::ROOM_NAME) + 1,
-              "# of columns");
+static constexpr const int GROUP_COLUMN_COUNT = GroupModel::COLUMN_COUNT;
+static_assert(GROUP_COLUMN_COUNT == 9, "# of columns");
+static constexpr const uint32_t ALL_COLUMNS = (1u << GROUP_COLUMN_COUNT) - 1u;
 
 GroupStateData::GroupStateData(const QColor &color,
                                const CharacterPositionEnum position,
@@ -118,21 +121,102 @@ GroupModel::GroupModel(MapData *const md, Mmapper2Group *const group, QObject *c
     : QAbstractTableModel(parent)
     , m_map(md)
     , m_group(group)
-{}
+{
+    rebuildRows();
+}
 
 void GroupModel::resetModel()
 {
     beginResetModel();
+    rebuildRows();
     endResetModel();
 }
 
-int GroupModel::rowCount(const QModelIndex & /* parent */) const
+void GroupModel::rebuildRows()
 {
+    m_rows.clear();
     if (auto group = m_group->getGroup()) {
         auto selection = group->selectAll();
-        return static_cast<int>(selection->size());
+        m_rows.resize(selection->size());
+        for (size_t i = 0; i < m_rows.size(); ++i)
+            static_cast<void>(updateRow(m_rows[i], *selection->at(static_cast<int>(i)), true));
     }
-    return 0;
+}
+
+void GroupModel::updateModel()
+{
+    auto group = m_group->getGroup();
+    if (group == nullptr) {
+        if (!m_rows.empty())
+            resetModel();
+        return;
+    }
+
+    std::vector<uint32_t> changed;
+    {
+        auto selection = group->selectAll();
+        const auto sameRoster = [this, &selection]() -> bool {
+            if (selection->size() != m_rows.size())
+                return false;
+            for (size_t i = 0; i < m_rows.size(); ++i)
+                if (selection->at(static_cast<int>(i))->getName() != m_rows[i].name)
+                    return false;
+            return true;
+        };
+        if (!sameRoster()) {
+            // The selection has to be released first, since resetModel() takes another.
+            selection.reset();
+            resetModel();
+            return;
+        }
+
+        changed.resize(m_rows.size());
+        for (size_t i = 0; i < m_rows.size(); ++i)
+            changed[i] = updateRow(m_rows[i], *selection->at(static_cast<int>(i)), false);
+    }
+
+    for (size_t i = 0; i < changed.size(); ++i)
+        emitRowChanged(static_cast<int>(i), changed[i]);
+}
+
+void GroupModel::emitRowChanged(const int row, const uint32_t columns)
+{
+    // One signal for each run of adjacent columns
+    for (int first = 0; first < GROUP_COLUMN_COUNT; ++first) {
+        if ((columns & (1u << first)) == 0)
+            continue;
+        int last = first;
+        while (last + 1 < GROUP_COLUMN_COUNT && (columns & (1u << (last + 1))) != 0)
+            ++last;
+        emit dataChanged(index(row, first), index(row, last));
+        first = last;
+    }
+}
+
+void GroupModel::setLinkStats(const QVariantMap &stats)
+{
+    const QVariantMap old = std::exchange(m_linkStats, stats);
+    for (size_t i = 0; i < m_rows.size(); ++i) {
+        const QString name = QString::fromLatin1(m_rows[i].name);
+        if (old.value(name) != m_linkStats.value(name))
+            emitRowChanged(static_cast<int>(i), 1u << static_cast<int>(ColumnTypeEnum::NAME));
+    }
+}
+
+void GroupModel::setMapLoaded(const bool val)
+{
+    m_mapLoaded = val;
+    // Room names are only looked up again when someone moves.
+    for (size_t i = 0; i < m_rows.size(); ++i) {
+        CharacterRow &row = m_rows[i];
+        row.display[static_cast<int>(ColumnTypeEnum::ROOM_NAME)] = getRoomName(row.roomId);
+        emitRowChanged(static_cast<int>(i), 1u << static_cast<int>(ColumnTypeEnum::ROOM_NAME));
+    }
+}
+
+int GroupModel::rowCount(const QModelIndex & /* parent */) const
+{
+    return static_cast<int>(m_rows.size());
 }
 
 int GroupModel::columnCount(const QModelIndex & /* parent */) const
@@ -184,85 +268,125 @@ static QString getPrettyName(const CharacterAffectEnum affect)
 #undef X_CASE
 }
 
-QVariant GroupModel::dataForCharacter(const SharedGroupChar &character,
-                                      const ColumnTypeEnum column,
-                                      const int role) const
+QString GroupModel::getRoomName(const RoomId roomId) const
+{
+    if (roomId != DEFAULT_ROOMID && roomId != INVALID_ROOMID && !m_map->isEmpty() && m_mapLoaded
+        && roomId <= m_map->getMaxId()) {
+        auto roomSelection = RoomSelection(*m_map);
+        if (const Room *const r = roomSelection.getRoom(roomId)) {
+            return r->getName().toQString();
+        }
+    }
+    return "Unknown";
+}
+
+uint32_t GroupModel::updateRow(CharacterRow &row,
+                               const CGroupChar &character,
+                               const bool force) const
+{
+    uint32_t changed = 0;
+    const auto set = [&row, &changed](const ColumnTypeEnum column,
+                                      QVariant display,
+                                      QVariant toolTip = QVariant()) {
+        const auto i = static_cast<int>(column);
+        row.display[i] = std::move(display);
+        row.toolTip[i] = std::move(toolTip);
+        changed |= 1u << i;
+    };
+    const auto setPoints = [&set](const ColumnTypeEnum percentColumn,
+                                  const ColumnTypeEnum ratioColumn,
+                                  const int points,
+                                  const int maxPoints) {
+        const QString ratio = calculateRatio(points, maxPoints);
+        set(percentColumn, calculatePercentage(points, maxPoints), ratio);
+        set(ratioColumn, ratio);
+    };
+
+    if (force || row.name != character.getName()) {
+        row.name = character.getName();
+        set(ColumnTypeEnum::NAME, row.name);
+    }
+    if (force || row.hp != character.hp || row.maxhp != character.maxhp) {
+        row.hp = character.hp;
+        row.maxhp = character.maxhp;
+        setPoints(ColumnTypeEnum::HP_PERCENT, ColumnTypeEnum::HP, row.hp, row.maxhp);
+    }
+    if (force || row.mana != character.mana || row.maxmana != character.maxmana) {
+        row.mana = character.mana;
+        row.maxmana = character.maxmana;
+        setPoints(ColumnTypeEnum::MANA_PERCENT, ColumnTypeEnum::MANA, row.mana, row.maxmana);
+    }
+    if (force || row.moves != character.moves || row.maxmoves != character.maxmoves) {
+        row.moves = character.moves;
+        row.maxmoves = character.maxmoves;
+        setPoints(ColumnTypeEnum::MOVES_PERCENT, ColumnTypeEnum::MOVES, row.moves, row.maxmoves);
+    }
+
+    const bool colorChanged = row.color != character.getColor();
+    if (force || colorChanged || row.position != character.position
+        || row.affects != character.affects) {
+        row.color = character.getColor();
+        row.position = character.position;
+        row.affects = character.affects;
+        QString prettyName = getPrettyName(row.position);
+        for (const auto affect : ALL_CHARACTER_AFFECTS) {
+            if (row.affects.contains(affect)) {
+                prettyName.append(", ").append(getPrettyName(affect));
+            }
+        }
+        set(ColumnTypeEnum::STATE,
+            QVariant::fromValue(GroupStateData(row.color, row.position, row.affects)),
+            prettyName);
+    }
+    if (force || row.roomId != character.roomId) {
+        row.roomId = character.roomId;
+        set(ColumnTypeEnum::ROOM_NAME, getRoomName(row.roomId));
+    }
+
+    // Every cell is painted in the character's color.
+    if (colorChanged)
+        changed = ALL_COLUMNS;
+    return changed;
+}
+
+QVariant GroupModel::data(const QModelIndex &index, int role) const
 {
+    if (!index.isValid() || index.row() < 0 || index.row() >= static_cast<int>(m_rows.size()))
+        return QVariant();
+
+    const CharacterRow &row = m_rows.at(static_cast<size_t>(index.row()));
+    const int column = index.column();
+    if (column < 0 || column >= GROUP_COLUMN_COUNT) {
+        qWarning() << "Unsupported column" << column;
+        return QVariant();
+    }
+
     // Map column to data
     switch (role) {
     case Qt::DisplayRole:
-        switch (column) {
-        case ColumnTypeEnum::NAME:
-            return character->getName();
-        case ColumnTypeEnum::HP_PERCENT:
-            return calculatePercentage(character->hp, character->maxhp);
-        case ColumnTypeEnum::MANA_PERCENT:
-            return calculatePercentage(character->mana, character->maxmana);
-        case ColumnTypeEnum::MOVES_PERCENT:
-            return calculatePercentage(character->moves, character->maxmoves);
-        case ColumnTypeEnum::HP:
-            return calculateRatio(character->hp, character->maxhp);
-        case ColumnTypeEnum::MANA:
-            return calculateRatio(character->mana, character->maxmana);
-        case ColumnTypeEnum::MOVES:
-            return calculateRatio(character->moves, character->maxmoves);
-        case ColumnTypeEnum::STATE:
-            return QVariant::fromValue(
-                GroupStateData(character->getColor(), character->position, character->affects));
-        case ColumnTypeEnum::ROOM_NAME:
-            if (character->roomId != DEFAULT_ROOMID && character->roomId != INVALID_ROOMID
-                && !m_map->isEmpty() && m_mapLoaded && character->roomId <= m_map->getMaxId()) {
-                auto roomSelection = RoomSelection(*m_map);
-                if (const Room *const r = roomSelection.getRoom(character->roomId)) {
-                    return r->getName().toQString();
-                }
-            }
-            return "Unknown";
-
-        default:
-            qWarning() << "Unsupported column" << static_cast<int>(column);
-            break;
-        }
-        break;
+        return row.display.at(static_cast<size_t>(column));
 
     case Qt::BackgroundRole:
-        return character->getColor();
+        return row.color;
 
     case Qt::ForegroundRole:
-        return textColor(character->getColor());
+        return textColor(row.color);
 
     case Qt::TextAlignmentRole:
-        if (column != ColumnTypeEnum::NAME && column != ColumnTypeEnum::ROOM_NAME) {
+        switch (static_cast<ColumnTypeEnum>(column)) {
+        case ColumnTypeEnum::NAME:
+        case ColumnTypeEnum::ROOM_NAME:
+            break;
+        default:
             // NOTE: There's no QVariant(AlignmentFlag) constructor.
             return static_cast<int>(Qt::AlignCenter);
         }
         break;
 
     case Qt::ToolTipRole:
-        switch (column) {
-        case ColumnTypeEnum::HP_PERCENT:
-            return calculateRatio(character->hp, character->maxhp);
-        case ColumnTypeEnum::MANA_PERCENT:
-            return calculateRatio(character->mana, character->maxmana);
-        case ColumnTypeEnum::MOVES_PERCENT:
-            return calculateRatio(character->moves, character->maxmoves);
-        case ColumnTypeEnum::STATE: {
-            QString prettyName = getPrettyName(character->position);
-            for (const auto affect : ALL_CHARACTER_AFFECTS) {
-                if (character->affects.contains(affect)) {
-                    prettyName.append(", ").append(getPrettyName(affect));
-                }
-            }
-            return prettyName;
-        }
-        case ColumnTypeEnum::NAME:
-        case ColumnTypeEnum::HP:
-        case ColumnTypeEnum::MANA:
-        case ColumnTypeEnum::MOVES:
-        case ColumnTypeEnum::ROOM_NAME:
-            break;
-        }
-        break;
+        if (static_cast<ColumnTypeEnum>(column) == ColumnTypeEnum::NAME)
+            return m_linkStats.value(QString::fromLatin1(row.name));
+        return row.toolTip.at(static_cast<size_t>(column));
 
     default:
         break;
@@ -271,25 +395,6 @@ QVariant GroupModel::dataForCharacter(const SharedGroupChar &character,
     return QVariant();
 }
 
-QVariant GroupModel::data(const QModelIndex &index, int role) const
-{
-    QVariant data = QVariant();
-    if (!index.isValid())
-        return data;
-
-    if (auto group = m_group->getGroup()) {
-        auto selection = group->selectAll();
-
-        // Map row to character
-        if (index.row() < static_cast<int>(selection->size())) {
-            const SharedGroupChar &character = selection->at(index.row());
-            const auto column = static_cast<ColumnTypeEnum>(index.column());
-            data = dataForCharacter(character, column, role);
-        }
-    }
-    return data;
-}
-
 QVariant GroupModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
     switch (role) {
@@ -404,6 +509,11 @@ GroupWidget::GroupWidget(Mmapper2Group *const group, MapData *const md, QWidget
             this,
             &GroupWidget::updateLabels,
             Qt::QueuedConnection);
+    connect(m_group,
+            &Mmapper2Group::linkStats,
+            this,
+            &GroupWidget::updateLinkStats,
+            Qt::QueuedConnection);
     connect(m_group,
             &Mmapper2Group::messageBox,
             this,
@@ -422,7 +532,7 @@ GroupWidget::~GroupWidget()
 
 void GroupWidget::updateLabels()
 {
-    m_model.resetModel();
+    m_model.updateModel();
 
     // Hide unnecessary columns like mana if everyone is a zorc/troll
     const auto one_character_had_mana = [this]() -> bool {
@@ -3,13 +3,18 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <QAbstractTableModel>
 #include <QString>
 #include <QStyledItemDelegate>
+#include <QVariantMap>
 #include <QWidget>
 #include <QtCore>
 
+#include "../global/macros.h"
+#include "../global/roomid.h"
 #include "groupselection.h"
 #include "mmapper2character.h"
 
@@ -71,13 +76,13 @@ class GroupModel final : public QAbstractTableModel
         STATE,
         ROOM_NAME
     };
+    static constexpr const int COLUMN_COUNT = static_cast<int>(ColumnTypeEnum::ROOM_NAME) + 1;
 
     explicit GroupModel(MapData *md, Mmapper2Group *group, QObject *parent = nullptr);
 
     void resetModel();
-    QVariant dataForCharacter(const SharedGroupChar &character,
-                              ColumnTypeEnum column,
-                              int role) const;
+    // Only announces the cells that changed, unless someone joined, left or was renamed.
+    void updateModel();
 
     int rowCount(const QModelIndex &parent) const override;
     int columnCount(const QModelIndex &parent) const override;
@@ -86,12 +91,38 @@ class GroupModel final : public QAbstractTableModel
     QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
     Qt::ItemFlags flags(const QModelIndex &parent) const override;
 
-    void setMapLoaded(const bool val) { m_mapLoaded = val; }
+    void setMapLoaded(bool val);
+    // Shown as the tooltip of each character's name
+    void setLinkStats(const QVariantMap &stats);
+
+private:
+    // What was last shown for a character, and the values it was formatted from.
+    struct NODISCARD CharacterRow final
+    {
+        QByteArray name;
+        QColor color;
+        RoomId roomId = INVALID_ROOMID;
+        int hp = 0, maxhp = 0;
+        int mana = 0, maxmana = 0;
+        int moves = 0, maxmoves = 0;
+        CharacterPositionEnum position = CharacterPositionEnum::UNDEFINED;
+        CharacterAffects affects;
+        std::array<QVariant, COLUMN_COUNT> display;
+        std::array<QVariant, COLUMN_COUNT> toolTip;
+    };
+
+    // Returns a mask of the columns that changed.
+    NODISCARD uint32_t updateRow(CharacterRow &row, const CGroupChar &character, bool force) const;
+    NODISCARD QString getRoomName(RoomId roomId) const;
+    void rebuildRows();
+    void emitRowChanged(int row, uint32_t columns);
 
 private:
     MapData *m_map = nullptr;
     Mmapper2Group *m_group = nullptr;
     bool m_mapLoaded = false;
+    std::vector<CharacterRow> m_rows;
+    QVariantMap m_linkStats;
 };
 
 class GroupWidget final : public QWidget
@@ -104,6 +135,7 @@ class GroupWidget final : public QWidget
 
 public slots:
     void updateLabels();
+    void updateLinkStats(const QVariantMap &stats) { m_model.setLinkStats(stats); }
     void messageBox(const QString &title, const QString &message);
     void mapUnloaded() { m_model.setMapLoaded(false); }
     void mapLoaded() { m_model.setMapLoaded(true); }
@@ -42,11 +42,13 @@ const Mmapper2Group::AffectTimeout Mmapper2Group::s_affectTimeout
 Mmapper2Group::Mmapper2Group(QObject *const /* parent */)
     : QObject(nullptr)
     , affectTimer{this}
+    , charUpdateTimer{this}
     , networkLock(QMutex::Recursive)
     , thread(THREADED ? new QThread : nullptr)
 {
     qRegisterMetaType<CharacterPositionEnum>("CharacterPositionEnum");
     qRegisterMetaType<CharacterAffectEnum>("CharacterAffectEnum");
+    qRegisterMetaType<SharedCharacterState>("SharedCharacterState");
 
     connect(this,
             &Mmapper2Group::sig_invokeStopInternal,
@@ -59,7 +61,11 @@ Mmapper2Group::Mmapper2Group(QObject *const /* parent */)
     affectTimer.start();
     connect(&affectTimer, &QTimer::timeout, this, &Mmapper2Group::onAffectTimeout);
 
+    charUpdateTimer.setSingleShot(true);
+    connect(&charUpdateTimer, &QTimer::timeout, this, &Mmapper2Group::onCharUpdateTimeout);
+
     if (thread) {
+        thread->setObjectName("GroupManager");
         connect(thread.get(), &QThread::started, this, [this]() {
             emit log("GroupManager", "Initialized Group Manager service");
         });
@@ -121,6 +127,7 @@ void Mmapper2Group::slot_stopInternal()
     assert(QThread::currentThread() == QObject::thread());
     assert(QThread::currentThread() == Mmapper2Group::thread.get() || !Mmapper2Group::thread);
     affectTimer.stop();
+    charUpdateTimer.stop();
     stopNetwork();
     ++m_calledStopInternal;
 }
@@ -166,7 +173,7 @@ void Mmapper2Group::updateSelf()
         if (network) {
             emit sig_sendSelfRename(oldname, newname);
         }
-        group->getSelf()->setName(newname);
+        group->renameSelf(newname);
 
     } else if (group->getSelf()->getColor() != groupManagerSettings.color) {
         group->getSelf()->setColor(groupManagerSettings.color);
@@ -175,7 +182,7 @@ void Mmapper2Group::updateSelf()
         return;
     }
 
-    issueLocalCharUpdate();
+    issueLocalCharUpdate(true);
 }
 
 void Mmapper2Group::setCharacterRoomId(RoomId roomId)
@@ -203,10 +210,10 @@ void Mmapper2Group::setCharacterRoomId(RoomId roomId)
 
     group->getSelf()->setRoomId(roomId);
 
-    issueLocalCharUpdate();
+    issueLocalCharUpdate(true);
 }
 
-void Mmapper2Group::issueLocalCharUpdate()
+void Mmapper2Group::issueLocalCharUpdate(const bool immediately)
 {
     emit updateWidget();
 
@@ -215,10 +222,42 @@ void Mmapper2Group::issueLocalCharUpdate()
         return;
     }
 
-    if (network) {
-        const QVariantMap &data = group->getSelf()->toVariantMap();
-        emit sig_sendCharUpdate(data);
+    if (!network)
+        return;
+
+    const auto now = std::chrono::steady_clock::now();
+    const auto nextAllowed = lastCharUpdateSent + MIN_CHAR_UPDATE_INTERVAL;
+    if (immediately || now >= nextAllowed) {
+        sendLocalCharUpdate();
+        return;
     }
+    if (charUpdatePending)
+        return; // It will send the latest state
+
+    // This can be called from the parser's thread, but the timer belongs to ours.
+    charUpdatePending = true;
+    const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(nextAllowed - now);
+    QMetaObject::invokeMethod(
+        this,
+        [this, delay]() { charUpdateTimer.start(static_cast<int>(delay.count()) + 1); },
+        Qt::QueuedConnection);
+}
+
+void Mmapper2Group::sendLocalCharUpdate()
+{
+    QMutexLocker locker(&networkLock);
+    charUpdatePending = false;
+    lastCharUpdateSent = std::chrono::steady_clock::now();
+    emit sig_sendCharUpdate(std::make_shared<const CharacterState>(group->getSelf()->getState()));
+}
+
+void Mmapper2Group::onCharUpdateTimeout()
+{
+    QMutexLocker locker(&networkLock);
+    // The update may have been sent immediately in the meantime.
+    if (!charUpdatePending || !group || !network)
+        return;
+    sendLocalCharUpdate();
 }
 
 void Mmapper2Group::relayMessageBox(const QString &message)
@@ -272,6 +311,21 @@ void Mmapper2Group::kickCharacter(const QByteArray &character)
     }
 }
 
+void Mmapper2Group::syncMap()
+{
+    QMutexLocker locker(&networkLock);
+
+    switch (getMode()) {
+    case GroupManagerStateEnum::Off:
+        throw std::runtime_error("network is down");
+    case GroupManagerStateEnum::Server:
+        throw std::invalid_argument("Only clients can sync their map from the host");
+    case GroupManagerStateEnum::Client:
+        emit sig_syncMap();
+        break;
+    }
+}
+
 void Mmapper2Group::sendGroupTell(const QByteArray &tell)
 {
     QMutexLocker locker(&networkLock);
@@ -375,6 +429,8 @@ void Mmapper2Group::parsePromptInformation(const QByteArray &prompt)
         return; // No update needed
     }
 
+    // Fighting, dying and recovering are sent to the group immediately
+    const CharacterPositionEnum oldPosition = self->position;
     if (textHP == "Dying") {
         // Incapacitated state overrides fighting state
         self->position = CharacterPositionEnum::INCAPACITATED;
@@ -455,7 +511,7 @@ void Mmapper2Group::parsePromptInformation(const QByteArray &prompt)
     }
 #undef X_SCORE
 
-    issueLocalCharUpdate();
+    issueLocalCharUpdate(self->position != oldPosition);
 }
 
 void Mmapper2Group::updateCharacterPosition(const CharacterPositionEnum position)
@@ -478,7 +534,7 @@ void Mmapper2Group::updateCharacterPosition(const CharacterPositionEnum position
         return; // Prefer dead state until we finish recovering some hp (i.e. stand)
 
     oldPosition = position;
-    issueLocalCharUpdate();
+    issueLocalCharUpdate(true);
 }
 
 void Mmapper2Group::updateCharacterAffect(const CharacterAffectEnum affect, const bool enable)
@@ -554,7 +610,7 @@ void Mmapper2Group::reset()
     self->roomId = DEFAULT_ROOMID;
     self->position = CharacterPositionEnum::UNDEFINED;
     self->affects = CharacterAffects{};
-    issueLocalCharUpdate();
+    issueLocalCharUpdate(true);
 }
 
 void Mmapper2Group::sendLog(const QString &text)
@@ -594,9 +650,18 @@ void Mmapper2Group::startNetwork()
                 &CGroupCommunicator::gTellArrived,
                 this,
                 &Mmapper2Group::gTellArrived);
+        connect(network.get(),
+                &CGroupCommunicator::sig_linkStats,
+                this,
+                &Mmapper2Group::linkStats);
+        connect(network.get(),
+                &CGroupCommunicator::sig_mapRoomsArrived,
+                this,
+                &Mmapper2Group::sig_applySyncedRooms);
         connect(network.get(), &CGroupCommunicator::destroyed, this, [this]() {
             network.release();
             emit networkStatus(false);
+            emit linkStats(QVariantMap{});
         });
         connect(network.get(),
                 &CGroupCommunicator::sig_scheduleAction,
@@ -613,11 +678,12 @@ void Mmapper2Group::startNetwork()
         connect(this,
                 &Mmapper2Group::sig_sendCharUpdate,
                 network.get(),
-                QOverload<const QVariantMap &>::of(&CGroupCommunicator::sendCharUpdate));
+                QOverload<const SharedCharacterState &>::of(&CGroupCommunicator::sendCharUpdate));
         connect(this,
                 &Mmapper2Group::sig_sendSelfRename,
                 network.get(),
                 &CGroupCommunicator::sendSelfRename);
+        connect(this, &Mmapper2Group::sig_syncMap, network.get(), &CGroupCommunicator::syncMap);
     }
 
     // REVISIT: What about if the network is already started?
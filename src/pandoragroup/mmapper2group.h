@@ -4,8 +4,11 @@
 // Author: Dmitrijs Barbarins <lachupe@gmail.com> (Azazello)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <chrono>
+#include <functional>
 #include <memory>
 #include <QArgument>
+#include <QByteArray>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
@@ -14,6 +17,8 @@
 
 #include "../global/WeakHandle.h"
 #include "../global/roomid.h"
+#include "../mapdata/MapDigest.h"
+#include "CharacterState.h"
 #include "GroupManagerApi.h"
 #include "mmapper2character.h"
 
@@ -34,7 +39,7 @@ class Mmapper2Group final : public QObject
     void log(const QString &, const QString &);
     // MainWindow::groupNetworkStatus (via MainWindow)
     void networkStatus(bool);
-    // MapCanvas::requestUpdate (via MainWindow)
+    // MapCanvas::groupChanged (via MainWindow)
     void updateMapCanvas(); // redraw the opengl screen
 
     // sent to ParserXML::sendGTellToUser (via Proxy)
@@ -44,6 +49,8 @@ class Mmapper2Group final : public QObject
     void messageBox(QString title, QString message);
     // GroupWidget::updateLabels (via GroupWidget)
     void updateWidget(); // update group widget
+    // GroupWidget::updateLinkStats (via GroupWidget)
+    void linkStats(const QVariantMap &stats);
 
     // Mmapper2Group::slot_stopInternal
     void sig_invokeStopInternal();
@@ -53,9 +60,14 @@ class Mmapper2Group final : public QObject
     // CGroupCommunicator::kickCharacter
     void sig_kickCharacter(const QByteArray &character);
     // CGroupCommunicator::sendCharUpdate
-    void sig_sendCharUpdate(const QVariantMap &map);
+    void sig_sendCharUpdate(const SharedCharacterState &state);
     // CGroupCommunicator::sendSelfRename
     void sig_sendSelfRename(const QByteArray &, const QByteArray &);
+    // CGroupCommunicator::syncMap
+    void sig_syncMap();
+
+    // MapData::slot_applySyncedRooms (via MainWindow)
+    void sig_applySyncedRooms(const QByteArray &rooms);
 
 public:
     explicit Mmapper2Group(QObject *parent = nullptr);
@@ -69,6 +81,12 @@ class Mmapper2Group final : public QObject
     GroupAuthority *getAuthority() { return authority.get(); }
     CGroup *getGroup() { return group.get(); }
 
+    using MapDigestSource = std::function<SharedMapDigest()>;
+    // Where the map's digest comes from when syncing maps (e.g. MapData::getMapDigest);
+    // it's called from the group's thread, so set it before start().
+    void setMapDigestSource(MapDigestSource source) { mapDigestSource = std::move(source); }
+    SharedMapDigest getMapDigest() { return mapDigestSource ? mapDigestSource() : nullptr; }
+
 public:
     GroupManagerApi &getGroupManagerApi() { return m_groupManagerApi; }
 
@@ -80,6 +98,7 @@ class Mmapper2Group final : public QObject
 protected:
     void sendGroupTell(const QByteArray &tell); // sends gtell from local user
     void kickCharacter(const QByteArray &character);
+    void syncMap();
     void parseScoreInformation(const QByteArray &score);
     void parsePromptInformation(const QByteArray &prompt);
     void updateCharacterPosition(CharacterPositionEnum);
@@ -102,6 +121,7 @@ protected slots:
     void sendLog(const QString &);
     void characterChanged(bool updateCanvas);
     void onAffectTimeout();
+    void onCharUpdateTimeout();
     void slot_stopInternal();
 
 private:
@@ -119,8 +139,18 @@ protected slots:
     using AffectTimeout = QMap<CharacterAffectEnum, int32_t>;
     static const AffectTimeout s_affectTimeout;
 
+    // Our character's updates are sent to the group at most this often, with the latest state
+    // winning, except for the ones that are sent immediately (e.g. moving or dying).
+    static constexpr const std::chrono::milliseconds MIN_CHAR_UPDATE_INTERVAL{250};
+    QTimer charUpdateTimer;
+    std::chrono::steady_clock::time_point lastCharUpdateSent{};
+    bool charUpdatePending = false;
+
     bool init();
-    void issueLocalCharUpdate();
+    void issueLocalCharUpdate(bool immediately = false);
+    void sendLocalCharUpdate();
+
+    MapDigestSource mapDigestSource;
 
     QMutex networkLock;
     std::unique_ptr<QThread> thread;
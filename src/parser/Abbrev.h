@@ -3,11 +3,15 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <array>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <optional>
 #include <stdexcept>
 #include <string_view>
+#include <vector>
 #include <QCharRef>
 
 #include "../global/StringView.h"
@@ -34,3 +38,69 @@ struct Abbrev
     int getLength() const { return len; }
     QString describe() const;
 };
+
+/// Finds which of a set of abbreviations a word matches in one walk over the word,
+/// instead of trying each Abbrev in turn. Where two overlap, the first one added wins.
+/// Matching is case-insensitive, and only letters can be matched.
+template<typename T>
+class AbbrevTrie final
+{
+private:
+    static constexpr const size_t NUM_LETTERS = 26;
+
+    struct Node final
+    {
+        // Index of the child for each letter; 0 (the root) for none.
+        std::array<uint16_t, NUM_LETTERS> children{};
+        std::optional<T> value;
+    };
+    std::vector<Node> m_nodes = std::vector<Node>(1);
+
+    static std::optional<size_t> getLetterIndex(const char c)
+    {
+        if (c >= 'a' && c <= 'z')
+            return static_cast<size_t>(c - 'a');
+        if (c >= 'A' && c <= 'Z')
+            return static_cast<size_t>(c - 'A');
+        return std::nullopt;
+    }
+
+public:
+    void add(const Abbrev &abbrev, const T value)
+    {
+        if (!abbrev)
+            throw std::invalid_argument("abbrev");
+
+        size_t node = 0;
+        for (int i = 0; i < abbrev.getLength(); ++i) {
+            const auto letter = getLetterIndex(abbrev.getCommand()[i]);
+            if (!letter.has_value())
+                throw std::invalid_argument("abbrev");
+
+            uint16_t next = m_nodes[node].children[letter.value()];
+            if (next == 0) {
+                assert(m_nodes.size() <= UINT16_MAX);
+                next = static_cast<uint16_t>(m_nodes.size());
+                m_nodes[node].children[letter.value()] = next;
+                m_nodes.emplace_back();
+            }
+            node = next;
+            if (i + 1 >= abbrev.getMinAbbrev() && !m_nodes[node].value.has_value())
+                m_nodes[node].value = value;
+        }
+    }
+
+    std::optional<T> find(const StringView word) const
+    {
+        size_t node = 0;
+        for (const char c : word) {
+            const auto letter = getLetterIndex(c);
+            if (!letter.has_value())
+                return std::nullopt;
+            node = m_nodes[node].children[letter.value()];
+            if (node == 0)
+                return std::nullopt;
+        }
+        return m_nodes[node].value;
+    }
+};
@@ -4,38 +4,25 @@
 
 #include "abstractparser.h"
 
-#include <cassert>
-#include <memory>
-
 #include "../clock/mumeclock.h"
 #include "../pandoragroup/mmapper2group.h"
 #include "Action.h"
 
 void AbstractParser::initActionMap()
 {
-    auto &map = m_actionMap;
-    map.clear();
+    auto &matcher = m_actionMatcher;
+    matcher.clear();
 
-    auto addStartsWith = [&map](const std::string &match, const ActionCallback &callback) {
-        assert(!match.empty());
-        const char hint = match[0];
-        map.emplace(hint, std::make_unique<StartsWithAction>(match, callback));
+    auto addStartsWith = [&matcher](const std::string &match, const ActionCallback &callback) {
+        matcher.addStartsWith(match, callback);
     };
 
-    auto addEndsWith = [&map](const std::string &match, const ActionCallback &callback) {
-        assert(!match.empty());
-        const char hint = 0;
-        map.emplace(hint, std::make_unique<EndsWithAction>(match, callback));
+    auto addEndsWith = [&matcher](const std::string &match, const ActionCallback &callback) {
+        matcher.addEndsWith(match, callback);
     };
 
-    auto addRegex = [&map](const std::string &match, const ActionCallback &callback) {
-        assert(!match.empty());
-        const char hint = [&match]() -> char {
-            if (match.length() > 2 && match[0] == '^' && match[1] != '\\')
-                return match[1];
-            return 0;
-        }();
-        map.emplace(hint, std::make_unique<RegexAction>(match, callback));
+    auto addRegex = [&matcher](const std::string &match, const ActionCallback &callback) {
+        matcher.addRegex(match, callback);
     };
 
     /// Positions
@@ -322,22 +309,6 @@ void AbstractParser::initActionMap()
 
 bool AbstractParser::evalActionMap(StringView line)
 {
-    if (line.empty())
-        return false;
-
-    auto &map = m_actionMap;
-
-    auto range = map.equal_range(line.firstChar());
-    for (auto it = range.first; it != range.second; ++it) {
-        const std::unique_ptr<IAction> &action = it->second;
-        action->match(line);
-    }
-
-    range = map.equal_range(0);
-    for (auto it = range.first; it != range.second; ++it) {
-        const std::unique_ptr<IAction> &action = it->second;
-        action->match(line);
-    }
-
+    m_actionMatcher.match(line);
     return false;
 }
@@ -7,10 +7,12 @@
 #include <algorithm>
 #include <functional>
 #include <map>
+#include <optional>
 #include <ostream>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <vector>
 #include <QMessageLogContext>
@@ -22,6 +24,8 @@
 #include "../mapdata/ExitFlags.h"
 #include "../mapdata/enums.h"
 #include "../mapdata/mmapper2room.h"
+#include "../pathmachine/pathmachinestats.h"
+#include "../proxy/ProxyLatencyStats.h"
 #include "../syntax/SyntaxArgs.h"
 #include "../syntax/TreeParser.h"
 #include "Abbrev.h"
@@ -39,9 +43,13 @@ const Abbrev cmdDoorHelp{"doorhelp", 5};
 const Abbrev cmdGroup{"group", 5};
 const Abbrev cmdGroupTell{"gtell", 2};
 const Abbrev cmdHelp{"help", 2};
+const Abbrev cmdLatency{"latency", 3};
 const Abbrev cmdMarkCurrent{"markcurrent", 4};
+const Abbrev cmdMemory{"memory", 3};
+const Abbrev cmdPathStats{"pathstats", 5};
 const Abbrev cmdRemoveDoorNames{"removedoornames"};
 const Abbrev cmdRoom{"room", 2};
+const Abbrev cmdRoute{"route", 3};
 const Abbrev cmdSearch{"search", 3};
 const Abbrev cmdSet{"set", 2};
 const Abbrev cmdTime{"time", 2};
@@ -329,44 +337,50 @@ Abbrev getParserCommandName(const ExitFlagEnum x)
 #undef CASE3
 }
 
-static bool isCommand(const std::string &str, Abbrev abbrev)
+// Every abbreviation of the commands the parser acts on, so a line needs one walk.
+static const AbbrevTrie<CommandEnum> &getSimpleCommands()
 {
-    if (!abbrev)
-        return false;
-
-    auto view = StringView{str}.trim();
-    if (view.isEmpty())
-        return false;
-
-    const auto word = view.takeFirstWord();
-    return abbrev.matches(word);
+    static const AbbrevTrie<CommandEnum> trie = []() {
+        AbbrevTrie<CommandEnum> result;
+        for (const CommandEnum cmd : ALL_COMMANDS) {
+            switch (cmd) {
+            case CommandEnum::NORTH:
+            case CommandEnum::SOUTH:
+            case CommandEnum::EAST:
+            case CommandEnum::WEST:
+            case CommandEnum::UP:
+            case CommandEnum::DOWN:
+            case CommandEnum::FLEE:
+                // REVISIT: Add support for 'charge' and 'escape' commands
+                result.add(Abbrev{getLowercase(cmd), 1}, cmd);
+                break;
+
+            case CommandEnum::SCOUT:
+                result.add(Abbrev{getLowercase(cmd), 2}, cmd);
+                break;
+
+            case CommandEnum::LOOK:
+                result.add(Abbrev{getLowercase(cmd), 1}, cmd);
+                result.add(Abbrev{"examine", 3}, cmd);
+                break;
+
+            case CommandEnum::UNKNOWN:
+            case CommandEnum::NONE:
+                break;
+            }
+        }
+        return result;
+    }();
+    return trie;
 }
 
-static bool isCommand(const std::string &str, const CommandEnum cmd)
+static std::optional<CommandEnum> findSimpleCommand(const std::string &str)
 {
-    switch (cmd) {
-    case CommandEnum::NORTH:
-    case CommandEnum::SOUTH:
-    case CommandEnum::EAST:
-    case CommandEnum::WEST:
-    case CommandEnum::UP:
-    case CommandEnum::DOWN:
-    case CommandEnum::FLEE:
-        // REVISIT: Add support for 'charge' and 'escape' commands
-        return isCommand(str, Abbrev{getLowercase(cmd), 1});
-
-    case CommandEnum::SCOUT:
-        return isCommand(str, Abbrev{getLowercase(cmd), 2});
-
-    case CommandEnum::LOOK:
-        return isCommand(str, Abbrev{getLowercase(cmd), 1}) || isCommand(str, Abbrev{"examine", 3});
-
-    case CommandEnum::UNKNOWN:
-    case CommandEnum::NONE:
-        return false;
-    }
+    auto view = StringView{str}.trim();
+    if (view.isEmpty())
+        return std::nullopt;
 
-    return false;
+    return getSimpleCommands().find(view.takeFirstWord());
 }
 
 bool AbstractParser::parseUserCommands(const QString &input)
@@ -393,13 +407,8 @@ bool AbstractParser::parseSimpleCommand(const QString &qstr)
     const std::string str = ::toStdStringLatin1(qstr);
     const auto isOnline = ::isOnline();
 
-    for (const CommandEnum cmd : ALL_COMMANDS) {
-        if (cmd == CommandEnum::NONE || cmd == CommandEnum::UNKNOWN)
-            continue;
-
-        if (!isCommand(str, cmd))
-            continue;
-
+    if (const std::optional<CommandEnum> found = findSimpleCommand(str)) {
+        const CommandEnum cmd = found.value();
         switch (cmd) {
         case CommandEnum::NORTH:
         case CommandEnum::SOUTH:
@@ -449,8 +458,6 @@ bool AbstractParser::parseSimpleCommand(const QString &qstr)
         case CommandEnum::NONE:
             break;
         }
-
-        break; /* break the for loop */
     }
 
     if (!isOnline) {
@@ -547,8 +554,14 @@ void AbstractParser::parseSearch(StringView view)
 
 void AbstractParser::parseDirections(StringView view)
 {
-    if (view.isEmpty())
-        showSyntax("dirs [-(name|desc|dyncdesc|note|exits|flags|all)] pattern");
+    if (view.isEmpty()) {
+        showSyntax("dirs [-(name|desc|dyncdesc|note|exits|flags|all)] pattern | dirs -id <room id>");
+        return;
+    }
+
+    StringView rest = view;
+    if (rest.takeFirstWord() == std::string_view{"-id"})
+        doGetDirectionsToRoomCommand(rest);
     else
         doGetDirectionsCommand(view);
 }
@@ -592,6 +605,11 @@ std::ostream &ArgHelpCommand::virt_to_stream(std::ostream &os) const
 }
 
 void AbstractParser::parseHelp(StringView words)
+{
+    evalCached("help", [this]() { return buildHelpSyntax(); }, words);
+}
+
+syntax::SharedConstSublist AbstractParser::buildHelpSyntax()
 {
     using namespace syntax;
     static auto abb = syntax::abbrevToken;
@@ -632,7 +650,7 @@ void AbstractParser::parseHelp(StringView words)
                     simpleSyntax("miscellaneous", [this](auto &&, auto &&) { showMiscHelp(); })),
         Accept([this](auto &&, auto &&) { showHelp(); }, "general help"));
 
-    eval("help", syntax, words);
+    return syntax;
 }
 
 void AbstractParser::initSpecialCommandMap()
@@ -791,6 +809,72 @@ void AbstractParser::initSpecialCommandMap()
                            .arg(::toQStringLatin1(name))
                            .arg(::toQStringLatin1(help)));
         });
+    add(
+        cmdPathStats,
+        [this](const std::vector<StringView> & /*s*/, StringView rest) {
+            if (rest.isEmpty()) {
+                this->showPathMachineStats();
+                return true;
+            }
+            const auto word = rest.takeFirstWord();
+            if (Abbrev{"reset", 3}.matches(word) && rest.isEmpty()) {
+                getPathMachineStats().reset();
+                sendToUser("Path machine statistics have been reset.\r\n");
+                return true;
+            }
+            if (Abbrev{"log", 3}.matches(word) && !rest.isEmpty()) {
+                const auto arg = rest.takeFirstWord();
+                if (!rest.isEmpty())
+                    return false;
+                const bool enable = Abbrev{"on", 2}.matches(arg);
+                if (!enable && !Abbrev{"off", 3}.matches(arg))
+                    return false;
+                getPathMachineStats().setLogging(enable);
+                sendToUser(QString("Path machine statistics logging is now %1.\r\n")
+                               .arg(enable ? "on" : "off"));
+                return true;
+            }
+            return false;
+        },
+        makeSimpleHelp("Displays path machine timing statistics (\"reset\" clears them, "
+                       "\"log on|off\" logs them)."));
+    add(
+        cmdLatency,
+        [this](const std::vector<StringView> & /*s*/, StringView rest) {
+            if (rest.isEmpty()) {
+                this->showProxyLatencyStats();
+                return true;
+            }
+            const auto word = rest.takeFirstWord();
+            if (Abbrev{"reset", 3}.matches(word) && rest.isEmpty()) {
+                getProxyLatencyStats().reset();
+                sendToUser("Latency statistics have been reset.\r\n");
+                return true;
+            }
+            if (Abbrev{"log", 3}.matches(word) && !rest.isEmpty()) {
+                const auto arg = rest.takeFirstWord();
+                if (!rest.isEmpty())
+                    return false;
+                const bool enable = Abbrev{"on", 2}.matches(arg);
+                if (!enable && !Abbrev{"off", 3}.matches(arg))
+                    return false;
+                getProxyLatencyStats().setLogging(enable);
+                sendToUser(QString("Latency logging is now %1.\r\n").arg(enable ? "on" : "off"));
+                return true;
+            }
+            return false;
+        },
+        makeSimpleHelp("Displays latency percentiles of MUME's output (\"reset\" clears them, "
+                       "\"log on|off\" logs them)."));
+    add(
+        cmdMemory,
+        [this](const std::vector<StringView> & /*s*/, StringView rest) {
+            if (!rest.isEmpty())
+                return false;
+            this->showMemoryUsage();
+            return true;
+        },
+        makeSimpleHelp("Displays an estimate of the memory held by the map, meshes and group."));
     add(
         cmdTime,
         [this](const std::vector<StringView> & /*s*/, StringView rest) {
@@ -800,6 +884,16 @@ void AbstractParser::initSpecialCommandMap()
             return true;
         },
         makeSimpleHelp("Displays the current MUME time."));
+    add(
+        cmdRoute,
+        [this](const std::vector<StringView> & /*s*/, StringView rest) {
+            if (rest.isEmpty()) {
+                this->showRoutingProfiles();
+                return true;
+            }
+            return this->setRoutingProfile(rest);
+        },
+        makeSimpleHelp("Lists the routing profiles, or picks the one [dirs] finds routes with."));
     add(
         cmdTrollExit,
         [this](const std::vector<StringView> & /*s*/, StringView rest) {
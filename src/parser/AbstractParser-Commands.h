@@ -17,7 +17,9 @@ extern const Abbrev cmdDirections;
 extern const Abbrev cmdDoorHelp;
 extern const Abbrev cmdGroupTell;
 extern const Abbrev cmdHelp;
+extern const Abbrev cmdLatency;
 extern const Abbrev cmdMarkCurrent;
+extern const Abbrev cmdPathStats;
 extern const Abbrev cmdRemoveDoorNames;
 extern const Abbrev cmdSearch;
 extern const Abbrev cmdSet;
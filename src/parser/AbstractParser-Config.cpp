@@ -352,7 +352,9 @@ void AbstractParser::doConfig(const StringView &cmd)
                         TokenMatcher::alloc<ArgHexColor>(),
                         setNamedColor))),
             syn("perf-stats",
-                syn("set", opt("enabled", advanced.printPerfStats, "enable/disable stats"))),
+                syn("set",
+                    opt("enabled", advanced.printPerfStats, "enable/disable stats"),
+                    opt("log", advanced.logPerfStats, "enable/disable logging stats"))),
             zoomSyntax,
             syn("3d-camera",
                 syn("set",
@@ -44,6 +44,11 @@ std::ostream &ArgPlayer::virt_to_stream(std::ostream &os) const
 }
 
 void AbstractParser::parseGroup(StringView input)
+{
+    evalCached("group", [this]() { return buildGroupSyntax(); }, input);
+}
+
+syntax::SharedConstSublist AbstractParser::buildGroupSyntax()
 {
     using namespace ::syntax;
     static auto abb = syntax::abbrevToken;
@@ -85,6 +90,7 @@ void AbstractParser::parseGroup(StringView input)
                 }
 
                 lockGroup = value;
+                getConfig().writeLater();
                 os << "--->Group has been " << msg << std::endl;
             },
             "modify group lock");
@@ -113,9 +119,18 @@ void AbstractParser::parseGroup(StringView input)
         return buildSyntax(abb("tell"), argRest, acceptTell);
     }();
 
-    const auto groupSyntax = buildSyntax(groupKickSyntax, groupLockSyntax, groupTellSyntax);
+    auto groupSyncSyntax = [this]() -> SharedConstSublist {
+        auto acceptSync = Accept(
+            [this](User &user, const Pair *) -> void {
+                auto &os = user.getOstream();
+                m_group.syncMap();
+                os << "--->Comparing the map with the host's; see the log for the rooms synced.\n";
+            },
+            "update the rooms both maps have from the host's");
+        return buildSyntax(abb("sync"), acceptSync);
+    }();
 
-    eval("group", groupSyntax, input);
+    return buildSyntax(groupKickSyntax, groupLockSyntax, groupSyncSyntax, groupTellSyntax);
 }
 
 void AbstractParser::sendScoreLineEvent(const QByteArray &arr)
@@ -329,6 +329,11 @@ std::ostream &ArgRoomFlag::virt_to_stream(std::ostream &os) const
 }
 
 void AbstractParser::parseRoom(StringView input)
+{
+    evalCached("room", [this]() { return buildRoomSyntax(); }, input);
+}
+
+syntax::SharedConstSublist AbstractParser::buildRoomSyntax()
 {
     using namespace ::syntax;
     static auto abb = syntax::abbrevToken;
@@ -376,9 +381,9 @@ void AbstractParser::parseRoom(StringView input)
 
                 const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
                 const RoomId roomId = [&rs]() {
-                    if (rs->count() != 1)
+                    if (rs->size() != 1)
                         throw std::runtime_error("unable to select current room");
-                    return rs->firstKey();
+                    return rs->getFirstRoomId();
                 }();
 
                 if (!m_mapData->execute(std::make_unique<SingleRoomAction>(
@@ -406,9 +411,9 @@ void AbstractParser::parseRoom(StringView input)
 
             const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
             const RoomId roomId = [&rs]() {
-                if (rs->count() != 1)
+                if (rs->size() != 1)
                     throw std::runtime_error("unable to select current room");
-                return rs->firstKey();
+                return rs->getFirstRoomId();
             }();
 
             if (!m_mapData->execute(std::make_unique<SingleRoomAction>(
@@ -433,9 +438,9 @@ void AbstractParser::parseRoom(StringView input)
 
             const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
             const RoomId roomId = [&rs]() {
-                if (rs->count() != 1)
+                if (rs->size() != 1)
                     throw std::runtime_error("unable to select current room");
-                return rs->firstKey();
+                return rs->getFirstRoomId();
             }();
 
             if (!m_mapData
@@ -491,9 +496,9 @@ void AbstractParser::parseRoom(StringView input)
 
                 const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
                 const RoomId roomId = [&rs]() {
-                    if (rs->count() != 1)
+                    if (rs->size() != 1)
                         throw std::runtime_error("unable to select current room");
-                    return rs->firstKey();
+                    return rs->getFirstRoomId();
                 }();
 
                 if (!m_mapData->execute(std::make_unique<SingleRoomAction>(
@@ -532,9 +537,9 @@ void AbstractParser::parseRoom(StringView input)
 
                 const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
                 const RoomId roomId = [&rs]() {
-                    if (rs->count() != 1)
+                    if (rs->size() != 1)
                         throw std::runtime_error("unable to select current room");
-                    return rs->firstKey();
+                    return rs->getFirstRoomId();
                 }();
 
                 if (!m_mapData->execute(std::make_unique<SingleRoomAction>(
@@ -570,9 +575,9 @@ void AbstractParser::parseRoom(StringView input)
 
             const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
             const RoomId roomId = [&rs]() {
-                if (rs->count() != 1)
+                if (rs->size() != 1)
                     throw std::runtime_error("unable to select current room");
-                return rs->firstKey();
+                return rs->getFirstRoomId();
             }();
 
             const auto &old = rs->getFirstRoom()->getNote();
@@ -594,9 +599,9 @@ void AbstractParser::parseRoom(StringView input)
 
             const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
             const RoomId roomId = [&rs]() {
-                if (rs->count() != 1)
+                if (rs->size() != 1)
                     throw std::runtime_error("unable to select current room");
-                return rs->firstKey();
+                return rs->getFirstRoomId();
             }();
 
             if (!m_mapData
@@ -626,9 +631,9 @@ void AbstractParser::parseRoom(StringView input)
 
             const auto rs = RoomSelection::createSelection(*m_mapData, getTailPosition());
             const RoomId roomId = [&rs]() {
-                if (rs->count() != 1)
+                if (rs->size() != 1)
                     throw std::runtime_error("unable to select current room");
-                return rs->firstKey();
+                return rs->getFirstRoomId();
             }();
 
             if (!m_mapData->execute(std::make_unique<SingleRoomAction>(
@@ -651,5 +656,5 @@ void AbstractParser::parseRoom(StringView input)
 
     auto roomSyntax = buildSyntax(doorSyntax, exitFlagsSyntax, flagsSyntax, noteSyntax, printSyntax);
 
-    eval("room", roomSyntax, input);
+    return roomSyntax;
 }
@@ -4,39 +4,141 @@
 
 #include "Action.h"
 
+#include <algorithm>
+#include <cassert>
+#include <optional>
 #include <regex>
 
-IAction::~IAction() = default;
+namespace { // anonymous
 
-void IAction::match(const StringView &input) const
+std::regex createRegex(const std::string &pattern)
 {
-    return virt_match(input);
+    return std::regex(pattern, std::regex::nosubs | std::regex::optimize);
 }
 
-void StartsWithAction::virt_match(const StringView &input) const
+// The character every line the pattern matches has to start with, if the pattern
+// is anchored to a literal one; e.g. 'Z' for "^ZBLAM!", but nothing for "^\d+" or "^a?b".
+std::optional<char> getLiteralFirstChar(const std::string &pattern)
 {
-    if (input.startsWith(match))
-        callback(input);
+    static constexpr const std::string_view SPECIAL = "\\^$.|?*+()[]{}";
+    static constexpr const std::string_view QUANTIFIERS = "?*{";
+    if (pattern.length() < 3 || pattern[0] != '^')
+        return std::nullopt;
+    if (SPECIAL.find(pattern[1]) != std::string_view::npos
+        || QUANTIFIERS.find(pattern[2]) != std::string_view::npos)
+        return std::nullopt;
+    return pattern[1];
 }
 
-void EndsWithAction::virt_match(const StringView &input) const
+uint8_t toIndex(const char c)
 {
-    if (input.endsWith(match))
-        callback(input);
+    return static_cast<uint8_t>(c);
 }
 
-static std::regex createRegex(const std::string &pattern)
+} // namespace
+
+const ActionMatcher::Node *ActionMatcher::Trie::findChild(const Node &node, const char c) const
 {
-    return std::regex(pattern, std::regex::nosubs | std::regex::optimize);
+    for (const auto &child : node.children)
+        if (child.first == c)
+            return &m_nodes[child.second];
+    return nullptr;
+}
+
+template<typename It>
+void ActionMatcher::Trie::insert(It begin, const It end, const ActionIndex action)
+{
+    uint32_t current = 0;
+    for (; begin != end; ++begin) {
+        const char c = *begin;
+        const Node *const child = findChild(m_nodes[current], c);
+        if (child != nullptr) {
+            current = static_cast<uint32_t>(child - m_nodes.data());
+            continue;
+        }
+        const auto next = static_cast<uint32_t>(m_nodes.size());
+        m_nodes[current].children.emplace_back(c, next);
+        m_nodes.emplace_back();
+        current = next;
+    }
+    m_nodes[current].actions.emplace_back(action);
+}
+
+template<typename It>
+void ActionMatcher::Trie::collect(It begin,
+                                  const It end,
+                                  std::vector<ActionIndex> &out) const
+{
+    const Node *node = &m_nodes.front();
+    for (; begin != end; ++begin) {
+        node = findChild(*node, *begin);
+        if (node == nullptr)
+            return;
+        out.insert(out.end(), node->actions.begin(), node->actions.end());
+    }
 }
 
-RegexAction::RegexAction(const std::string &pattern, const ActionCallback &callback)
-    : regex{createRegex(pattern)}
-    , callback{callback}
-{}
+void ActionMatcher::clear()
+{
+    m_callbacks.clear();
+    m_startsWith.clear();
+    m_endsWith.clear();
+    for (auto &regexes : m_regexesByFirstChar)
+        regexes.clear();
+    m_otherRegexes.clear();
+}
+
+ActionMatcher::ActionIndex ActionMatcher::addCallback(ActionCallback callback)
+{
+    const auto index = static_cast<ActionIndex>(m_callbacks.size());
+    m_callbacks.emplace_back(std::move(callback));
+    return index;
+}
 
-void RegexAction::virt_match(const StringView &input) const
+void ActionMatcher::addStartsWith(const std::string_view match, ActionCallback callback)
 {
-    if (std::regex_match(input.begin(), input.end(), regex))
-        callback(input);
+    assert(!match.empty());
+    m_startsWith.insert(match.begin(), match.end(), addCallback(std::move(callback)));
+}
+
+void ActionMatcher::addEndsWith(const std::string_view match, ActionCallback callback)
+{
+    assert(!match.empty());
+    m_endsWith.insert(match.rbegin(), match.rend(), addCallback(std::move(callback)));
+}
+
+void ActionMatcher::addRegex(const std::string &pattern, ActionCallback callback)
+{
+    assert(!pattern.empty());
+    RegexAction action{createRegex(pattern), addCallback(std::move(callback))};
+    if (const auto firstChar = getLiteralFirstChar(pattern))
+        m_regexesByFirstChar[toIndex(*firstChar)].emplace_back(std::move(action));
+    else
+        m_otherRegexes.emplace_back(std::move(action));
+}
+
+void ActionMatcher::match(const StringView line) const
+{
+    if (line.empty())
+        return;
+
+    std::vector<ActionIndex> matched;
+    const std::string_view sv = line.getStdStringView();
+    m_startsWith.collect(sv.begin(), sv.end(), matched);
+    m_endsWith.collect(sv.rbegin(), sv.rend(), matched);
+
+    const auto tryRegexes = [&line, &matched](const std::vector<RegexAction> &regexes) {
+        for (const RegexAction &action : regexes)
+            if (std::regex_match(line.begin(), line.end(), action.regex))
+                matched.emplace_back(action.action);
+    };
+    tryRegexes(m_regexesByFirstChar[toIndex(line.firstChar())]);
+    tryRegexes(m_otherRegexes);
+
+    if (matched.empty())
+        return;
+
+    std::sort(matched.begin(), matched.end());
+    for (const ActionIndex index : matched)
+        m_callbacks[index](line);
 }
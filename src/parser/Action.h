@@ -3,76 +3,80 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <array>
+#include <cstdint>
 #include <functional>
-#include <memory>
 #include <regex>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <utility>
+#include <vector>
 
-#include "../global/RuleOf5.h"
 #include "../global/StringView.h"
+#include "../global/macros.h"
 
 using ActionCallback = std::function<void(StringView)>;
 
-struct IAction
+/// The parser's line triggers, compiled so each line is classified in one pass
+/// before any callback runs: the starts-with strings share a trie that is walked
+/// forwards from the start of the line, the ends-with strings a trie of their
+/// reversed text walked backwards from its end, and a regex is only tried on
+/// lines that begin with the literal character its pattern is anchored to.
+///
+/// Every action that matches is called, in the order the actions were added.
+class NODISCARD ActionMatcher final
 {
-public:
-    virtual ~IAction();
-    IAction() = default;
-    DEFAULT_CTORS_AND_ASSIGN_OPS(IAction);
-
 private:
-    virtual void virt_match(const StringView &input) const = 0;
+    using ActionIndex = uint32_t;
+
+    // Children are found by a linear search; few nodes have more than a handful.
+    struct NODISCARD Node final
+    {
+        std::vector<std::pair<char, uint32_t>> children;
+        std::vector<ActionIndex> actions;
+    };
+
+    class NODISCARD Trie final
+    {
+    private:
+        std::vector<Node> m_nodes{1};
+
+    public:
+        template<typename It>
+        void insert(It begin, const It end, ActionIndex action);
+        /// Appends the actions of every string that is a prefix of [begin, end).
+        template<typename It>
+        void collect(It begin, const It end, std::vector<ActionIndex> &out) const;
+        void clear() { m_nodes.assign(1, Node{}); }
+
+    private:
+        NODISCARD const Node *findChild(const Node &node, char c) const;
+    };
+
+    struct NODISCARD RegexAction final
+    {
+        std::regex regex;
+        ActionIndex action = 0;
+    };
+
+    std::vector<ActionCallback> m_callbacks;
+    Trie m_startsWith;
+    Trie m_endsWith;
+    std::array<std::vector<RegexAction>, 256> m_regexesByFirstChar;
+    // Regexes whose pattern doesn't begin with a literal character.
+    std::vector<RegexAction> m_otherRegexes;
 
 public:
-    void match(const StringView &input) const;
-};
-
-class StartsWithAction : public IAction
-{
-private:
-    const std::string match;
-    const ActionCallback callback;
+    void clear();
+    void addStartsWith(std::string_view match, ActionCallback callback);
+    void addEndsWith(std::string_view match, ActionCallback callback);
+    void addRegex(const std::string &pattern, ActionCallback callback);
 
 public:
-    explicit StartsWithAction(std::string moved_str, const ActionCallback &callback)
-        : match{std::move(moved_str)}
-        , callback{callback}
-    {}
+    /// Calls the callback of every action that matches the line.
+    void match(StringView line) const;
+    NODISCARD size_t size() const { return m_callbacks.size(); }
 
 private:
-    void virt_match(const StringView &input) const override;
+    NODISCARD ActionIndex addCallback(ActionCallback callback);
 };
-
-class EndsWithAction : public IAction
-{
-private:
-    const std::string match;
-    const ActionCallback callback;
-
-public:
-    explicit EndsWithAction(std::string moved_str, const ActionCallback &callback)
-        : match{std::move(moved_str)}
-        , callback{callback}
-    {}
-
-private:
-    void virt_match(const StringView &input) const override;
-};
-
-class RegexAction : public IAction
-{
-private:
-    const std::regex regex;
-    const ActionCallback callback;
-
-public:
-    explicit RegexAction(const std::string &pattern, const ActionCallback &callback);
-
-private:
-    void virt_match(const StringView &input) const override;
-};
-
-using ActionHint = char;
-using ActionRecordMap = std::unordered_multimap<ActionHint, std::unique_ptr<IAction>>;
@@ -4,13 +4,19 @@
 
 #include "CommandQueue.h"
 
+#include <cassert>
+#include <stdexcept>
+
 #include "../mapdata/ExitDirection.h"
 
+static_assert(static_cast<size_t>(CommandEnum::NONE) <= UINT8_MAX);
+static_assert(CommandQueue::CAPACITY <= UINT16_MAX);
+
 QByteArray CommandQueue::toByteArray() const
 {
     QByteArray dirs;
-    for (int i = 0; i < base::size(); i++) {
-        const auto cmd = base::at(i);
+    dirs.reserve(static_cast<int>(m_size));
+    for (const CommandEnum cmd : *this) {
         // REVISIT: Serialize/deserialize directions more intelligently
         dirs.append(Mmapper2Exit::charForDir(getDirection(cmd)));
     }
@@ -19,9 +25,69 @@ QByteArray CommandQueue::toByteArray() const
 
 CommandQueue &CommandQueue::operator=(const QByteArray &dirs)
 {
-    base::clear();
+    clear();
     for (int i = 0; i < dirs.length(); i++) {
-        base::enqueue(static_cast<CommandEnum>(Mmapper2Exit::dirForChar(dirs.at(i))));
+        append(static_cast<CommandEnum>(Mmapper2Exit::dirForChar(dirs.at(i))));
     }
     return *this;
 }
+
+CommandEnum CommandQueue::at(const size_t index) const
+{
+    if (index >= m_size)
+        throw std::out_of_range("index");
+    return static_cast<CommandEnum>(m_commands[(m_head + index) % CAPACITY]);
+}
+
+CommandEnum CommandQueue::head() const
+{
+    return at(0);
+}
+
+void CommandQueue::append(const CommandEnum cmd)
+{
+    if (isFull())
+        clear();
+    m_commands[(m_head + m_size) % CAPACITY] = static_cast<uint8_t>(cmd);
+    ++m_size;
+    ++m_version;
+}
+
+void CommandQueue::prepend(const CommandEnum cmd)
+{
+    if (isFull())
+        clear();
+    m_head = static_cast<uint16_t>((m_head + CAPACITY - 1) % CAPACITY);
+    m_commands[m_head] = static_cast<uint8_t>(cmd);
+    ++m_size;
+    ++m_version;
+}
+
+CommandEnum CommandQueue::dequeue()
+{
+    const CommandEnum cmd = head();
+    m_head = static_cast<uint16_t>((m_head + 1) % CAPACITY);
+    --m_size;
+    ++m_version;
+    return cmd;
+}
+
+void CommandQueue::clear()
+{
+    if (isEmpty())
+        return;
+    m_head = 0;
+    m_size = 0;
+    ++m_version;
+}
+
+bool CommandQueue::operator==(const CommandQueue &rhs) const
+{
+    if (m_size != rhs.m_size)
+        return false;
+    for (size_t i = 0; i < m_size; ++i) {
+        if (m_commands[(m_head + i) % CAPACITY] != rhs.m_commands[(rhs.m_head + i) % CAPACITY])
+            return false;
+    }
+    return true;
+}
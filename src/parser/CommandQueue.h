@@ -3,32 +3,98 @@
 // Copyright (C) 2019 The MMapper Authors
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
-#include <QQueue>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <QByteArray>
 
 #include "CommandId.h"
 
-class CommandQueue : private QQueue<CommandEnum>
+/// The commands that have been sent but not yet seen by the parser in the MUD's
+/// output, oldest first.
+///
+/// It is a fixed ring buffer of one byte per command, so the copies that go to
+/// the map display and the group on every move don't allocate. Adding a command
+/// while it's full clears it first: after CAPACITY commands that the MUD hasn't
+/// answered, the old ones can't be matched to its output anymore. The version
+/// changes with every modification, so observers can tell whether a copy is
+/// still current.
+class CommandQueue final
 {
+public:
+    static constexpr const size_t CAPACITY = 256;
+
 private:
-    using base = QQueue<CommandEnum>;
+    std::array<uint8_t, CAPACITY> m_commands{};
+    uint16_t m_head = 0;
+    uint16_t m_size = 0;
+    uint32_t m_version = 0;
 
 public:
-    using QQueue<CommandEnum>::QQueue;
+    class const_iterator final
+    {
+    private:
+        const CommandQueue *m_queue = nullptr;
+        size_t m_index = 0;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = CommandEnum;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const CommandEnum *;
+        using reference = CommandEnum;
+
+    public:
+        const_iterator() = default;
+        explicit const_iterator(const CommandQueue &queue, const size_t index)
+            : m_queue{&queue}
+            , m_index{index}
+        {}
+
+    public:
+        CommandEnum operator*() const { return m_queue->at(m_index); }
+        const_iterator &operator++()
+        {
+            ++m_index;
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator copy = *this;
+            ++m_index;
+            return copy;
+        }
+        bool operator==(const const_iterator &rhs) const
+        {
+            return m_queue == rhs.m_queue && m_index == rhs.m_index;
+        }
+        bool operator!=(const const_iterator &rhs) const { return !(*this == rhs); }
+    };
 
 public:
     QByteArray toByteArray() const;
     CommandQueue &operator=(const QByteArray &dirs);
 
 public:
-    using base::begin;
-    using base::end;
-    using base::head;
-    using base::isEmpty;
+    const_iterator begin() const { return const_iterator{*this, 0}; }
+    const_iterator end() const { return const_iterator{*this, m_size}; }
+    CommandEnum head() const;
+    CommandEnum at(size_t index) const;
+    bool isEmpty() const { return m_size == 0; }
+    bool isFull() const { return m_size == CAPACITY; }
+    size_t size() const { return m_size; }
+    uint32_t getVersion() const { return m_version; }
+
+public:
+    void append(CommandEnum cmd);
+    void enqueue(const CommandEnum cmd) { append(cmd); }
+    void prepend(CommandEnum cmd);
+    CommandEnum dequeue();
+    void clear();
 
 public:
-    using base::append;
-    using base::clear;
-    using base::dequeue;
-    using base::enqueue;
-    using base::prepend;
+    // Compares the commands, not the versions.
+    bool operator==(const CommandQueue &rhs) const;
+    bool operator!=(const CommandQueue &rhs) const { return !(*this == rhs); }
 };
@@ -42,6 +42,14 @@ class ConnectedRoomFlagsType final
 
 public:
     ConnectedRoomFlagsType() = default;
+    explicit operator uint32_t() const { return m_flags; }
+    /// NOTE: No validation; only use this with values from operator uint32_t().
+    static ConnectedRoomFlagsType create_unsafe(const uint32_t value)
+    {
+        ConnectedRoomFlagsType result;
+        result.m_flags = value;
+        return result;
+    }
 
 public:
     bool operator==(const ConnectedRoomFlagsType rhs) const { return m_flags == rhs.m_flags; }
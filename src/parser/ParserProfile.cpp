@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "ParserProfile.h"
+
+static_assert(static_cast<size_t>(ParserStageEnum::PROMPT) + 1 == ParserProfile::NUM_STAGES);
+
+// The innermost stage that this thread is in, if any.
+static thread_local ParserProfile::StageTimer *t_currentStage = nullptr;
+
+ParserProfile::StageTimer::StageTimer(ParserProfile &profile, const ParserStageEnum stage)
+    : m_profile{profile}
+    , m_stage{stage}
+    , m_enabled{profile.isEnabled()}
+{
+    if (!m_enabled)
+        return;
+    m_parent = t_currentStage;
+    t_currentStage = this;
+    m_start = Clock::now();
+}
+
+ParserProfile::StageTimer::~StageTimer()
+{
+    if (!m_enabled)
+        return;
+    const auto elapsed = Clock::now() - m_start;
+    if (m_parent != nullptr)
+        m_parent->m_children += elapsed;
+    t_currentStage = m_parent;
+
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed - m_children);
+    Counters &c = m_profile.m_counters.at(static_cast<size_t>(m_stage));
+    c.calls.fetch_add(1, std::memory_order_relaxed);
+    c.ns.fetch_add(ns.count(), std::memory_order_relaxed);
+}
+
+void ParserProfile::reset()
+{
+    for (Counters &c : m_counters) {
+        c.calls.store(0, std::memory_order_relaxed);
+        c.ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+ParserProfile::Totals ParserProfile::getTotals(const ParserStageEnum stage) const
+{
+    const Counters &c = m_counters.at(static_cast<size_t>(stage));
+    Totals result;
+    result.calls = c.calls.load(std::memory_order_relaxed);
+    result.time = std::chrono::nanoseconds{c.ns.load(std::memory_order_relaxed)};
+    return result;
+}
+
+ParserProfile &getParserProfile()
+{
+    static ParserProfile profile;
+    return profile;
+}
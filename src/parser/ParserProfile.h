@@ -0,0 +1,70 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+
+enum class ParserStageEnum { PARSE, ELEMENT, CHARACTERS, MOVE, PROMPT };
+
+/// Where the XML parser spends its time, for benchmarks (see BenchParserReplay).
+///
+/// It does nothing until it's enabled. Each call's time doesn't include the
+/// stages it calls (e.g. parse() calls element() and characters()).
+class NODISCARD ParserProfile final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr const size_t NUM_STAGES = 5;
+
+    struct NODISCARD Totals final
+    {
+        uint64_t calls = 0;
+        std::chrono::nanoseconds time{};
+    };
+
+    /// Times one call of a stage; lives on the stack.
+    class NODISCARD StageTimer final
+    {
+    private:
+        ParserProfile &m_profile;
+        const ParserStageEnum m_stage;
+        const bool m_enabled;
+        Clock::time_point m_start;
+        Clock::duration m_children{};
+        StageTimer *m_parent = nullptr;
+
+    public:
+        StageTimer(ParserProfile &profile, ParserStageEnum stage);
+        ~StageTimer();
+        DELETE_CTORS_AND_ASSIGN_OPS(StageTimer);
+    };
+
+private:
+    struct NODISCARD Counters final
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<int64_t> ns{0};
+    };
+
+    std::array<Counters, NUM_STAGES> m_counters;
+    std::atomic<bool> m_enabled{false};
+
+public:
+    ParserProfile() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(ParserProfile);
+
+public:
+    NODISCARD bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    void reset();
+    NODISCARD Totals getTotals(ParserStageEnum stage) const;
+};
+
+NODISCARD ParserProfile &getParserProfile();
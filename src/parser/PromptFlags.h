@@ -64,6 +64,13 @@ class PromptFlagsType final
 
 public:
     explicit operator uint32_t() const { return flags; }
+    /// NOTE: No validation; only use this with values from operator uint32_t().
+    static PromptFlagsType create_unsafe(const uint32_t value)
+    {
+        PromptFlagsType result;
+        result.flags = value;
+        return result;
+    }
     bool operator==(const PromptFlagsType rhs) const { return flags == rhs.flags; }
     bool operator!=(const PromptFlagsType rhs) const { return flags != rhs.flags; }
 
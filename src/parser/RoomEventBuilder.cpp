@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "RoomEventBuilder.h"
+
+#include "../mapdata/mmapper2room.h"
+#include "parserutils.h"
+
+// Appends the normalized line; see AbstractParser::normalizeStringCopy().
+static void appendNormalized(std::string &buffer, QString line)
+{
+    // Remove ANSI first, since we don't want Latin1
+    // transliterations to accidentally count as ANSI.
+    ParserUtils::removeAnsiMarksInPlace(line);
+    ParserUtils::toAsciiInPlace(line);
+
+    buffer.reserve(buffer.size() + static_cast<size_t>(line.size()));
+    for (const QChar c : line)
+        buffer += c.toLatin1();
+}
+
+void RoomEventBuilder::reset()
+{
+    m_name.clear();
+    m_dynamicDesc.clear();
+    m_staticDesc.clear();
+    m_hasName = false;
+}
+
+void RoomEventBuilder::beginRoom()
+{
+    reset();
+    m_hasName = true;
+}
+
+void RoomEventBuilder::setName(const QString &line)
+{
+    m_name.clear();
+    appendNormalized(m_name, line);
+    m_hasName = true;
+}
+
+void RoomEventBuilder::appendDynamicDescLine(const QString &line)
+{
+    appendNormalized(m_dynamicDesc, line.simplified());
+    m_dynamicDesc += '\n';
+}
+
+void RoomEventBuilder::beginStaticDesc()
+{
+    m_staticDesc.clear();
+}
+
+void RoomEventBuilder::appendStaticDescLine(const QString &line)
+{
+    appendNormalized(m_staticDesc, line.simplified());
+    m_staticDesc += '\n';
+}
+
+SharedParseEvent RoomEventBuilder::build(const CommandEnum move,
+                                         const ExitsFlagsType &exitsFlags,
+                                         const PromptFlagsType &promptFlags,
+                                         const ConnectedRoomFlagsType &connectedRoomFlags) const
+{
+    return ParseEvent::createEvent(move,
+                                   RoomName{m_name},
+                                   RoomDynamicDesc{m_dynamicDesc},
+                                   RoomStaticDesc{m_staticDesc},
+                                   exitsFlags,
+                                   promptFlags,
+                                   connectedRoomFlags);
+}
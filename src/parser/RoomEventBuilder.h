@@ -0,0 +1,55 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <string>
+#include <QString>
+
+#include "../expandoracommon/parseevent.h"
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+#include "CommandId.h"
+#include "ConnectedRoomFlags.h"
+#include "ExitsFlags.h"
+#include "PromptFlags.h"
+
+/// Collects a room's name and descriptions as MumeXmlParser reads them, and
+/// turns them into a ParseEvent when the room is complete.
+///
+/// Lines are normalized straight into buffers that are reused from room to
+/// room, so only the finished strings are interned instead of every partial
+/// description.
+class NODISCARD RoomEventBuilder final
+{
+private:
+    std::string m_name;
+    std::string m_dynamicDesc;
+    std::string m_staticDesc;
+    // Blindness leaves a room without a name; missing descriptions are just empty.
+    bool m_hasName = false;
+
+public:
+    RoomEventBuilder() = default;
+    ~RoomEventBuilder() = default;
+    DEFAULT_MOVES_DELETE_COPIES(RoomEventBuilder);
+
+public:
+    /// Forgets the room, but keeps the buffers.
+    void reset();
+    /// The 'name' tag won't show up when blinded, so a room starts with an empty name.
+    void beginRoom();
+    void setName(const QString &line);
+    void appendDynamicDescLine(const QString &line);
+    void beginStaticDesc();
+    void appendStaticDescLine(const QString &line);
+
+public:
+    NODISCARD bool hasName() const { return m_hasName; }
+    NODISCARD const std::string &getName() const { return m_name; }
+
+public:
+    NODISCARD SharedParseEvent build(CommandEnum move,
+                                     const ExitsFlagsType &exitsFlags,
+                                     const PromptFlagsType &promptFlags,
+                                     const ConnectedRoomFlagsType &connectedRoomFlags) const;
+};
@@ -10,6 +10,7 @@
 #include <cassert>
 #include <cctype>
 #include <cstdlib>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <optional>
@@ -33,6 +34,7 @@
 #include "../expandoracommon/parseevent.h"
 #include "../expandoracommon/room.h"
 #include "../global/CharBuffer.h"
+#include "../global/MemoryUsage.h"
 #include "../global/RAII.h"
 #include "../global/StringView.h"
 #include "../global/TextUtils.h"
@@ -49,8 +51,10 @@
 #include "../mapdata/roomfilter.h"
 #include "../mapdata/roomselection.h"
 #include "../mapdata/shortestpath.h"
+#include "../pathmachine/pathmachinestats.h"
 #include "../proxy/GmcpMessage.h"
 #include "../proxy/GmcpUtils.h"
+#include "../proxy/ProxyLatencyStats.h"
 #include "../proxy/proxy.h"
 #include "../proxy/telnetfilter.h"
 #include "../syntax/Accept.h"
@@ -65,6 +69,7 @@
 #include "ConnectedRoomFlags.h"
 #include "DoorAction.h"
 #include "ExitsFlags.h"
+#include "ParserProfile.h"
 #include "PromptFlags.h"
 #include "parserutils.h"
 
@@ -162,6 +167,7 @@ void AbstractParser::reset()
 
 void AbstractParser::parsePrompt(const QString &prompt)
 {
+    ParserProfile::StageTimer timer{getParserProfile(), ParserStageEnum::PROMPT};
     m_promptFlags.reset();
 
     if (prompt.length() < 2)
@@ -480,7 +486,7 @@ void AbstractParser::parseExits(std::ostream &os)
         };
         os << ::toStdStringLatin1(right_trim(m_exits) + cn);
 
-        if (getConfig().mumeNative.showNotes) {
+        if (getProxyConfigSnapshot().mumeNative.showNotes) {
             const auto &ns = room->getNote();
             if (!ns.isEmpty()) {
                 const QString note = QString("Note: %1\r\n").arg(ns.toQString());
@@ -541,7 +547,29 @@ void AbstractParser::emulateExits(std::ostream &os, const CommandEnum move)
         sendRoomExitsInfoToUser(os, r);
 }
 
-QByteArray AbstractParser::enhanceExits(const Room *sourceRoom)
+QByteArray AbstractParser::enhanceExits(const Room *const sourceRoom)
+{
+    // The annotations also depend on the neighbouring rooms, so the whole cache
+    // is dropped whenever any room changes.
+    auto &cache = m_enhancedExits;
+    const uint64_t modificationCount = m_mapData->getModificationCount();
+    const bool showHiddenExitFlags = getProxyConfigSnapshot().mumeNative.showHiddenExitFlags;
+    if (cache.modificationCount != modificationCount
+        || cache.showHiddenExitFlags != showHiddenExitFlags) {
+        cache.exits.clear();
+        cache.modificationCount = modificationCount;
+        cache.showHiddenExitFlags = showHiddenExitFlags;
+    }
+
+    const RoomId id = sourceRoom->getId();
+    if (const auto it = cache.exits.find(id); it != cache.exits.end())
+        return it->second;
+    QByteArray cn = buildEnhancedExits(sourceRoom);
+    cache.exits.emplace(id, cn);
+    return cn;
+}
+
+QByteArray AbstractParser::buildEnhancedExits(const Room *const sourceRoom)
 {
     QByteArray cn = " -";
     bool enhancedExits = false;
@@ -563,7 +591,7 @@ QByteArray AbstractParser::enhanceExits(const Room *sourceRoom)
         };
 
         // Extract hidden exit flags
-        if (getConfig().mumeNative.showHiddenExitFlags) {
+        if (getProxyConfigSnapshot().mumeNative.showHiddenExitFlags) {
             /* TODO: const char* lowercaseName(ExitFlagEnum) */
             if (ef.contains(ExitFlagEnum::NO_FLEE)) {
                 add_exit_keyword("noflee");
@@ -659,6 +687,7 @@ QByteArray AbstractParser::enhanceExits(const Room *sourceRoom)
 
 void AbstractParser::parseNewUserInput(const TelnetData &data)
 {
+    refreshProxyConfigSnapshot();
     auto parse_and_send = [this, &data]() {
         auto parse = [this, &data]() -> bool {
             const QString input = QString::fromLatin1(data.line.constData(), data.line.size())
@@ -751,32 +780,41 @@ static QString compressDirections(QString original)
     return ans;
 }
 
+// Formats each path as it is found; runs on the worker thread, so it only
+// hands finished text to the output callback.
 class ShortestPathEmitter final : public ShortestPathRecipient
 {
-    AbstractParser &parser;
+    const std::function<void(QString)> output;
+    bool found = false;
 
 public:
-    explicit ShortestPathEmitter(AbstractParser &parser)
-        : parser(parser)
+    explicit ShortestPathEmitter(std::function<void(QString)> output)
+        : output(std::move(output))
     {}
     virtual ~ShortestPathEmitter() override;
 
-    void receiveShortestPath(RoomAdmin * /*admin*/, QVector<SPNode> spnodes, int endpoint) override
+    bool hasFound() const { return found; }
+
+    void receiveShortestPath(RoomAdmin * /*admin*/,
+                             const QVector<SPNode> &spnodes,
+                             const int endpoint) override
     {
+        found = true;
         const SPNode *spnode = &spnodes[endpoint];
         auto name = spnode->r->getName();
-        parser.sendToUser("Distance " + QString::number(spnode->dist) + ": " + name + "\r\n");
+        QString text = "Distance " + QString::number(spnode->dist) + ": " + name + "\r\n";
         QString dirs;
         while (spnode->parent >= 0) {
             if (&spnodes[spnode->parent] == spnode) {
-                parser.sendToUser("ERROR: loop\r\n");
+                text += "ERROR: loop\r\n";
                 break;
             }
             dirs.append(Mmapper2Exit::charForDir(spnode->lastdir));
             spnode = &spnodes[spnode->parent];
         }
         std::reverse(dirs.begin(), dirs.end());
-        parser.sendToUser("dirs: " + compressDirections(dirs) + "\r\n");
+        text += "dirs: " + compressDirections(dirs) + "\r\n";
+        output(std::move(text));
     }
 };
 
@@ -785,25 +823,82 @@ ShortestPathEmitter::~ShortestPathEmitter() = default;
 void AbstractParser::searchCommand(const RoomFilter &f)
 {
     if (f.patternKind() == PatternKindsEnum::NONE) {
+        m_searchJob.cancel();
         emit newRoomSelection(SigRoomSelection{});
         sendToUser("Rooms unselected.\r\n");
         return;
     }
-    const auto tmpSel = RoomSelection::createSelection(*m_mapData);
-    tmpSel->genericSearch(f);
-    sendToUser(
-        QString("%1 room%2 found.\r\n").arg(tmpSel->size()).arg((tmpSel->size() == 1) ? "" : "s"));
-    emit newRoomSelection(SigRoomSelection{tmpSel});
+
+    // Match against a snapshot on a worker, then select the hits on this thread.
+    MapData &mapData = deref(m_mapData);
+    m_searchJob.start([this, &mapData, f](const BackgroundJob::Token &token) {
+        const SharedMapSnapshot snapshot = mapData.getSnapshot();
+        std::vector<RoomId> hits;
+        if (!mapData.searchSnapshot(
+                *snapshot,
+                f,
+                [&hits](const RoomId id) { hits.emplace_back(id); },
+                [&token]() { return token.isCancelled(); }))
+            return;
+        token.post([this, &mapData, hits = std::move(hits)]() {
+            const auto tmpSel = RoomSelection::createSelection(mapData);
+            for (const RoomId id : hits) {
+                tmpSel->getRoom(id);
+            }
+            sendToUser(QString("%1 room%2 found.\r\n")
+                           .arg(tmpSel->size())
+                           .arg((tmpSel->size() == 1) ? "" : "s"));
+            emit newRoomSelection(SigRoomSelection{tmpSel});
+        });
+    });
 }
 
 void AbstractParser::dirsCommand(const RoomFilter &f)
 {
-    ShortestPathEmitter sp_emitter(*this);
+    const RoomId origin = getTailRoomId();
+    if (origin == INVALID_ROOMID)
+        return;
+
+    MapData &mapData = deref(m_mapData);
+    const RoutingProfileEnum profile = getConfig().pathMachine.routingProfile;
+    m_dirsJob.start([this, &mapData, origin, f, profile](const BackgroundJob::Token &token) {
+        ShortestPathEmitter sp_emitter(
+            [this, &token](QString text) { token.post([this, text]() { sendToUser(text); }); });
+        mapData.shortestPathSearch(origin, &sp_emitter, f, profile, 10, 0, [&token]() {
+            return token.isCancelled();
+        });
+    });
+}
+
+void AbstractParser::dirsCommand(const RoomId target)
+{
+    const RoomId origin = getTailRoomId();
+    if (origin == INVALID_ROOMID) {
+        sendToUser("No path found.\r\n");
+        return;
+    }
+
+    MapData &mapData = deref(m_mapData);
+    const RoutingProfileEnum profile = getConfig().pathMachine.routingProfile;
+    m_dirsJob.start([this, &mapData, origin, target, profile](const BackgroundJob::Token &token) {
+        ShortestPathEmitter sp_emitter(
+            [this, &token](QString text) { token.post([this, text]() { sendToUser(text); }); });
+        mapData.shortestPathSearch(origin, &sp_emitter, target, profile, [&token]() {
+            return token.isCancelled();
+        });
+        if (!sp_emitter.hasFound() && !token.isCancelled()) {
+            token.post([this]() { sendToUser("No path found.\r\n"); });
+        }
+    });
+}
 
+RoomId AbstractParser::getTailRoomId()
+{
     auto rs = RoomSelection(*m_mapData);
     if (const Room *const r = rs.getRoom(getTailPosition())) {
-        m_mapData->shortestPathSearch(r, &sp_emitter, f, 10, 0);
+        return r->getId();
     }
+    return INVALID_ROOMID;
 }
 
 void AbstractParser::markCurrentCommand()
@@ -841,6 +936,7 @@ bool AbstractParser::setCommandPrefix(const char prefix)
     if (!isValidPrefix(prefix))
         return false;
     setConfig().parser.prefixChar = prefix;
+    getConfig().publishProxySnapshot();
     showCommandPrefix();
     return true;
 }
@@ -862,6 +958,34 @@ void AbstractParser::toggleTrollMapping()
     sendToUser("Troll exit mapping is now " + toggleText + ".\r\n");
 }
 
+void AbstractParser::showRoutingProfiles()
+{
+    const RoutingProfileEnum current = getConfig().pathMachine.routingProfile;
+    QString text = "Routing profiles:\r\n";
+    for (size_t i = 0; i < NUM_ROUTING_PROFILES; ++i) {
+        const auto profile = static_cast<RoutingProfileEnum>(i);
+        text += QString("  %1 %2 - %3\r\n")
+                    .arg((profile == current) ? "*" : " ")
+                    .arg(getRoutingProfileName(profile), -8)
+                    .arg(getRoutingProfileDescription(profile));
+    }
+    sendToUser(text);
+}
+
+bool AbstractParser::setRoutingProfile(StringView view)
+{
+    const auto word = view.takeFirstWord();
+    if (!view.isEmpty())
+        return false;
+    const auto profile = findRoutingProfile(word.getStdStringView());
+    if (!profile)
+        return false;
+    setConfig().pathMachine.routingProfile = *profile;
+    sendToUser(QString("Routes are now found for %1.\r\n")
+                   .arg(getRoutingProfileDescription(*profile)));
+    return true;
+}
+
 void AbstractParser::doSearchCommand(StringView view)
 {
     if (std::optional<RoomFilter> optFilter = RoomFilter::parseRoomFilter(view.getStdStringView())) {
@@ -880,6 +1004,17 @@ void AbstractParser::doGetDirectionsCommand(StringView view)
     }
 }
 
+void AbstractParser::doGetDirectionsToRoomCommand(StringView view)
+{
+    bool ok = false;
+    const uint id = view.isEmpty() ? 0u : view.toQString().toUInt(&ok);
+    if (!ok) {
+        sendToUser("Expected a room id.\r\n");
+        return;
+    }
+    dirsCommand(RoomId{id});
+}
+
 void AbstractParser::doMarkCurrentCommand()
 {
     markCurrentCommand();
@@ -969,6 +1104,7 @@ void AbstractParser::showGroupHelp()
     showHeader("Group commands");
     sendToUser(QString("  %1GKick [player]      - kick [player] from the group\r\n"
                        "  %1GLock               - Toggle lock on group\r\n"
+                       "  %1GSync               - update your map's rooms from the host's\r\n"
                        "  %1GTell [message]     - send a grouptell with the [message]\r\n")
                    .arg(prefixChar));
 }
@@ -988,7 +1124,10 @@ void AbstractParser::showMiscHelp()
 {
     showHeader("Miscellaneous commands");
     sendToUser(QString("  %1back        - delete prespammed commands from queue\r\n"
+                       "  %1latency     - display latency statistics of MUME's output\r\n"
                        "  %1markcurrent - select the room you are currently in\r\n"
+                       "  %1memory      - display an estimate of MMapper's memory usage\r\n"
+                       "  %1pathstats   - display path machine timing statistics\r\n"
                        "  %1time        - display current MUME time\r\n"
                        "  %1trollexit   - toggle troll-only exit mapping for direct sunlight\r\n"
                        "  %1vote        - vote for MUME on TMC!\r\n")
@@ -1018,6 +1157,26 @@ void AbstractParser::showHelp()
     sendToUser(s.arg(prefixChar));
 }
 
+void AbstractParser::showProxyLatencyStats()
+{
+    showHeader("Latency statistics");
+    sendToUser(getProxyLatencyStats().toReport());
+}
+
+void AbstractParser::showMemoryUsage()
+{
+    showHeader("Memory usage (estimated)");
+    MemoryUsage usage = m_mapData->getMemoryUsage();
+    usage.add(getPublishedMemoryUsage());
+    sendToUser(usage.toString().replace("\n", "\r\n"));
+}
+
+void AbstractParser::showPathMachineStats()
+{
+    showHeader("Path machine statistics");
+    sendToUser(getPathMachineStats().toReport());
+}
+
 void AbstractParser::showMumeTime()
 {
     const MumeMoment moment = m_mumeClock->getMumeMoment();
@@ -1095,6 +1254,8 @@ void AbstractParser::doMove(const CommandEnum cmd)
 {
     // REVISIT: should "look" commands be queued?
     assert(isDirectionNESWUD(cmd) || cmd == CommandEnum::LOOK);
+    if (m_queue.isFull())
+        sendToUser("--->Too many moves haven't been answered yet; forgetting them.\r\n");
     m_queue.enqueue(cmd);
     pathChanged();
     if (isOffline())
@@ -1167,7 +1328,7 @@ void AbstractParser::doOfflineCharacterMove()
     }
 
     const auto rs1 = RoomSelection(*m_mapData, m_mapData->getPosition());
-    if (rs1.isEmpty()) {
+    if (rs1.empty()) {
         sendToUser("Alas, you cannot go that way...\r\n");
         return;
     }
@@ -1281,7 +1442,7 @@ void AbstractParser::sendRoomInfoToUser(const Room *r)
         return;
     }
 
-    const auto &settings = getConfig().parser;
+    const auto &settings = getProxyConfigSnapshot().parser;
     static constexpr const auto ESCAPE = S_ESC;
 
     QByteArray roomName("\r\n");
@@ -1418,7 +1579,7 @@ void AbstractParser::sendRoomExitsInfoToUser(std::ostream &os, const Room *const
     QByteArray cn = enhanceExits(r);
     os << ::toStdStringLatin1(etmp.toLatin1() + cn);
 
-    if (getConfig().mumeNative.showNotes) {
+    if (getProxyConfigSnapshot().mumeNative.showNotes) {
         const auto &ns = r->getNote();
         if (!ns.isEmpty()) {
             QByteArray note = "Note: " + ns.toQByteArray() + "\r\n";
@@ -1485,37 +1646,40 @@ void AbstractParser::sendPromptToUser(const char light, const char terrain)
 
 void AbstractParser::performDoorCommand(const ExitDirEnum direction, const DoorActionEnum action)
 {
-    Coordinate c = getTailPosition();
-
     auto cn = getCommandName(action) + " ";
-    auto dn = m_mapData->getDoorName(c, direction).toQByteArray();
-
+    QByteArray dn;
     bool needdir = false;
 
-    if (direction == ExitDirEnum::UNKNOWN) {
-        // If there is only one secret assume that is what needs opening
-        auto secretCount = 0;
-        for (const auto i : ALL_EXITS_NESWUD) {
-            if (m_mapData->getExitFlag(c, i, ExitFieldVariant{DoorFlags{DoorFlagEnum::HIDDEN}})) {
-                dn = m_mapData->getDoorName(c, i).toQByteArray();
-                secretCount++;
+    {
+        const auto room = m_mapData->readRoom(getTailPosition());
+        dn = room.getDoorName(direction).toQByteArray();
+
+        if (direction == ExitDirEnum::UNKNOWN) {
+            // If there is only one secret assume that is what needs opening
+            const ExitFieldVariant hidden{DoorFlags{DoorFlagEnum::HIDDEN}};
+            auto secretCount = 0;
+            for (const auto i : ALL_EXITS_NESWUD) {
+                if (room.getExitFlag(i, hidden)) {
+                    dn = room.getDoorName(i).toQByteArray();
+                    secretCount++;
+                }
             }
-        }
-        if (secretCount == 1 && !dn.isEmpty()) {
-            needdir = false;
-        } else {
-            // Otherwise open any exit
+            if (secretCount == 1 && !dn.isEmpty()) {
+                needdir = false;
+            } else {
+                // Otherwise open any exit
+                needdir = true;
+                dn = "exit";
+            }
+        } else if (dn.isEmpty()) {
             needdir = true;
             dn = "exit";
-        }
-    } else if (dn.isEmpty()) {
-        needdir = true;
-        dn = "exit";
-    } else {
-        // Check if we need to add a direction to the door name
-        for (const auto i : ALL_EXITS_NESWUD) {
-            if ((i != direction) && (m_mapData->getDoorName(c, i).toQByteArray() == dn)) {
-                needdir = true;
+        } else {
+            // Check if we need to add a direction to the door name
+            for (const auto i : ALL_EXITS_NESWUD) {
+                if ((i != direction) && (room.getDoorName(i).toQByteArray() == dn)) {
+                    needdir = true;
+                }
             }
         }
     }
@@ -1540,18 +1704,20 @@ void AbstractParser::performDoorCommand(const ExitDirEnum direction, const DoorA
 void AbstractParser::genericDoorCommand(QString command, const ExitDirEnum direction)
 {
     QByteArray cn = emptyByteArray;
-    Coordinate c = getTailPosition();
-
-    auto dn = m_mapData->getDoorName(c, direction).toQByteArray();
-
+    QByteArray dn;
     bool needdir = false;
-    if (dn.isEmpty()) {
-        dn = "exit";
-        needdir = true;
-    } else {
-        for (const auto i : ALL_EXITS_NESWUD) {
-            if ((i != direction) && (m_mapData->getDoorName(c, i).toQByteArray() == dn)) {
-                needdir = true;
+
+    {
+        const auto room = m_mapData->readRoom(getTailPosition());
+        dn = room.getDoorName(direction).toQByteArray();
+        if (dn.isEmpty()) {
+            dn = "exit";
+            needdir = true;
+        } else {
+            for (const auto i : ALL_EXITS_NESWUD) {
+                if ((i != direction) && (room.getDoorName(i).toQByteArray() == dn)) {
+                    needdir = true;
+                }
             }
         }
     }
@@ -1647,3 +1813,17 @@ void AbstractParser::eval(const std::string &name,
     const auto completeSyntax = buildSyntax(stringToken(thisCommand), syntax);
     sendToUser(processSyntax(completeSyntax, thisCommand, input));
 }
+
+void AbstractParser::evalCached(const std::string &name,
+                                const SyntaxBuilder &build,
+                                StringView input)
+{
+    using namespace syntax;
+    // The syntax starts with the prefixed command, so a new prefix gets a new one.
+    const auto thisCommand = std::string(1, prefixChar) + name;
+    std::shared_ptr<const CompiledSyntax> &compiled = m_compiledSyntaxes[thisCommand];
+    if (compiled == nullptr)
+        compiled = std::make_shared<const CompiledSyntax>(
+            buildSyntax(stringToken(thisCommand), build()));
+    sendToUser(processSyntax(compiled, thisCommand, input));
+}
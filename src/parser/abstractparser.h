@@ -10,6 +10,7 @@
 #include <memory>
 #include <ostream>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <QArgument>
 #include <QObject>
@@ -18,8 +19,10 @@
 #include <QVariant>
 
 #include "../expandoracommon/parseevent.h"
+#include "../global/BackgroundJob.h"
 #include "../global/StringView.h"
 #include "../global/TextUtils.h"
+#include "../global/roomid.h"
 #include "../mapdata/DoorFlags.h"
 #include "../mapdata/ExitFieldVariant.h"
 #include "../mapdata/RoomFieldVariant.h"
@@ -47,8 +50,9 @@ class RoomFieldVariant;
 class RoomFilter;
 
 namespace syntax {
+class CompiledSyntax;
 class Sublist;
-}
+} // namespace syntax
 
 class AbstractParser : public QObject
 {
@@ -82,9 +86,11 @@ class AbstractParser : public QObject
 private:
     ParserRecordMap m_specialCommandMap;
     const char &prefixChar;
+    // by the command with its prefix; see evalCached()
+    std::map<std::string, std::shared_ptr<const syntax::CompiledSyntax>> m_compiledSyntaxes;
 
 private:
-    ActionRecordMap m_actionMap;
+    ActionMatcher m_actionMatcher;
 
 protected:
     QString m_exits = nullString;
@@ -98,9 +104,23 @@ class AbstractParser : public QObject
     bool m_overrideSendPrompt = false;
     CommandQueue m_queue;
 
+private:
+    // The annotations appended to the exits line, by room; see enhanceExits().
+    struct EnhancedExitsCache final
+    {
+        uint64_t modificationCount = 0;
+        bool showHiddenExitFlags = false;
+        std::unordered_map<RoomId, QByteArray> exits;
+    };
+    EnhancedExitsCache m_enhancedExits;
+
 private:
     bool m_trollExitMapping = false;
     QTimer m_offlineCommandTimer;
+    // Declared last, so their destructors wait for running jobs before anything
+    // the jobs refer to is destroyed.
+    BackgroundJob m_searchJob{*this};
+    BackgroundJob m_dirsJob{*this};
 
 public:
     explicit AbstractParser(
@@ -171,6 +191,7 @@ protected slots:
 
     void emulateExits(std::ostream &, CommandEnum move);
     QByteArray enhanceExits(const Room *);
+    QByteArray buildEnhancedExits(const Room *);
 
     void parseExits(std::ostream &);
     void parsePrompt(const QString &prompt);
@@ -179,6 +200,8 @@ protected slots:
 
     void searchCommand(const RoomFilter &f);
     void dirsCommand(const RoomFilter &f);
+    void dirsCommand(RoomId target);
+    RoomId getTailRoomId();
     void markCurrentCommand();
 
     bool evalActionMap(StringView line);
@@ -194,6 +217,9 @@ protected slots:
 
     void showDoorCommandHelp();
     void showMumeTime();
+    void showPathMachineStats();
+    void showProxyLatencyStats();
+    void showMemoryUsage();
     void showHelp();
     void showGroupHelp();
     void showMiscHelp();
@@ -222,7 +248,10 @@ protected slots:
     void doMarkCurrentCommand();
     void doSearchCommand(StringView view);
     void doGetDirectionsCommand(StringView view);
+    void doGetDirectionsToRoomCommand(StringView view);
     void toggleTrollMapping();
+    void showRoutingProfiles();
+    bool setRoutingProfile(StringView view);
 
     void initActionMap();
 
@@ -236,6 +265,9 @@ protected slots:
     void parseHelp(StringView words);
     void parseRoom(StringView input);
     void parseGroup(StringView input);
+    std::shared_ptr<const syntax::Sublist> buildHelpSyntax();
+    std::shared_ptr<const syntax::Sublist> buildRoomSyntax();
+    std::shared_ptr<const syntax::Sublist> buildGroupSyntax();
 
     bool parseDoorAction(DoorActionEnum dat, StringView words);
 
@@ -270,4 +302,8 @@ protected slots:
     void eval(const std::string &name,
               const std::shared_ptr<const syntax::Sublist> &syntax,
               StringView input);
+    using SyntaxBuilder = std::function<std::shared_ptr<const syntax::Sublist>()>;
+    // Builds and compiles the syntax the first time the command is used, and reuses it
+    // afterwards; its accept functions mustn't capture anything that could change.
+    void evalCached(const std::string &name, const SyntaxBuilder &build, StringView input);
 };
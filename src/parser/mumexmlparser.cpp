@@ -5,7 +5,11 @@
 
 #include "mumexmlparser.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
+#include <string>
 #include <QByteArray>
 #include <QString>
 
@@ -13,9 +17,12 @@
 #include "../configuration/configuration.h"
 #include "../expandoracommon/parseevent.h"
 #include "../global/TextUtils.h"
+#include "../global/Trace.h"
 #include "../pandoragroup/mmapper2group.h"
+#include "../proxy/ProxyLatencyStats.h"
 #include "../proxy/telnetfilter.h"
 #include "ExitsFlags.h"
+#include "ParserProfile.h"
 #include "PromptFlags.h"
 #include "abstractparser.h"
 #include "parserutils.h"
@@ -34,10 +41,132 @@ static constexpr const auto XPS_DEBUG_TO_FILE = false;
 
 static const QByteArray greaterThanChar(">");
 static const QByteArray lessThanChar("<");
-static const QByteArray greaterThanTemplate("&gt;");
-static const QByteArray lessThanTemplate("&lt;");
-static const QByteArray ampersand("&");
-static const QByteArray ampersandTemplate("&amp;");
+
+static const char *findChar(const char *const begin, const char *const end, const char c)
+{
+    return static_cast<const char *>(std::memchr(begin, c, static_cast<size_t>(end - begin)));
+}
+
+/// Returns the length of the entity (i.e. "&gt;", "&lt;" or "&amp;") at it, or 0.
+static int matchXmlEntity(const char *const it, const char *const end, char &decoded)
+{
+    const auto rest = end - it;
+    if (rest >= 4 && std::memcmp(it, "&gt;", 4) == 0) {
+        decoded = '>';
+        return 4;
+    }
+    if (rest >= 4 && std::memcmp(it, "&lt;", 4) == 0) {
+        decoded = '<';
+        return 4;
+    }
+    if (rest >= 5 && std::memcmp(it, "&amp;", 5) == 0) {
+        decoded = '&';
+        return 5;
+    }
+    return 0;
+}
+
+/// Returns the input (shared, not copied) if it doesn't have any entities.
+static QByteArray decodeXmlEntities(const QByteArray &input)
+{
+    const char *it = input.constData();
+    const char *const end = it + input.size();
+    const char *amp = findChar(it, end, '&');
+    if (amp == nullptr)
+        return input;
+
+    QByteArray result;
+    result.reserve(input.size());
+    for (; amp != nullptr; amp = findChar(it, end, '&')) {
+        result.append(it, static_cast<int>(amp - it));
+        char decoded = '&';
+        const int length = matchXmlEntity(amp, end, decoded);
+        result.append(decoded);
+        it = amp + std::max(1, length);
+    }
+    result.append(it, static_cast<int>(end - it));
+    return result;
+}
+
+/// Returns the input (shared, not copied) if nothing needs to be escaped.
+static QByteArray encodeXmlEntities(const QByteArray &input)
+{
+    const auto needsEscape = [](const char c) { return c == '&' || c == '<' || c == '>'; };
+    if (std::none_of(input.begin(), input.end(), needsEscape))
+        return input;
+
+    QByteArray result;
+    result.reserve(input.size() + 16);
+    for (const char c : input) {
+        switch (c) {
+        case '&':
+            result.append("&amp;");
+            break;
+        case '<':
+            result.append("&lt;");
+            break;
+        case '>':
+            result.append("&gt;");
+            break;
+        default:
+            result.append(c);
+            break;
+        }
+    }
+    return result;
+}
+
+/// Same as normalizeStringCopy(QString::fromLatin1(decoded).trimmed()) for a line that has
+/// been decoded if decodeEntities, but in one pass over the line.
+static std::string normalizeForActions(const QByteArray &line, const bool decodeEntities)
+{
+    // QString::trimmed() also trims Latin-1's NEL and NBSP.
+    const auto isSpace = [](const char c) {
+        const auto u = static_cast<uint8_t>(c);
+        return u == ' ' || (u >= '\t' && u <= '\r') || u == 0x85u || u == 0xA0u;
+    };
+    const auto isDigit = [](const char c) { return c >= '0' && c <= '9'; };
+    const auto isAlpha = [](const char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    };
+
+    const char *begin = line.constData();
+    const char *end = begin + line.size();
+    while (begin != end && isSpace(*begin))
+        ++begin;
+    while (end != begin && isSpace(end[-1]))
+        --end;
+
+    std::string result;
+    result.reserve(static_cast<size_t>(end - begin));
+    bool hasLatin1 = false;
+    for (const char *it = begin; it != end;) {
+        const char c = *it;
+        if (c == '\x1b' && end - it > 1 && it[1] == '[') {
+            // Remove ANSI marks; see ParserUtils::removeAnsiMarksInPlace().
+            const char *mark = it + 2;
+            while (mark != end && (isDigit(*mark) || *mark == ';'))
+                ++mark;
+            if (mark != end && isAlpha(*mark)) {
+                it = mark + 1;
+                continue;
+            }
+        } else if (c == '&' && decodeEntities) {
+            char decoded = '&';
+            if (const int length = matchXmlEntity(it, end, decoded)) {
+                result += decoded;
+                it += length;
+                continue;
+            }
+        }
+        hasLatin1 |= (static_cast<uint8_t>(c) & 0x80u) != 0;
+        result += c;
+        ++it;
+    }
+    if (hasLatin1)
+        ParserUtils::latin1ToAsciiInPlace(result);
+    return result;
+}
 
 MumeXmlParser::MumeXmlParser(
     MapData *md, MumeClock *mc, ProxyParserApi proxy, GroupManagerApi group, QObject *parent)
@@ -64,6 +193,8 @@ MumeXmlParser::~MumeXmlParser()
 
 void MumeXmlParser::parseNewMudInput(const TelnetData &data)
 {
+    ProxyLatencyStats::StageTimer timer{getProxyLatencyStats(), LatencyStageEnum::PARSER};
+    refreshProxyConfigSnapshot();
     switch (data.type) {
     case TelnetDataEnum::MENU_PROMPT:
     case TelnetDataEnum::LOGIN:
@@ -104,41 +235,51 @@ void MumeXmlParser::parseNewMudInput(const TelnetData &data)
 
 void MumeXmlParser::parse(const TelnetData &data)
 {
+    MMAPPER_TRACE_SCOPE("MumeXmlParser::parse");
+    ParserProfile::StageTimer timer{getParserProfile(), ParserStageEnum::PARSE};
     const QByteArray &line = data.line;
     m_lineToUser.clear();
     m_lineFlags.remove(LineFlagEnum::NONE);
 
-    for (const char c : line) {
+    // Tags and text are passed on as views of the line; only a tag that
+    // continues on the next line is copied.
+    const char *pos = line.constData();
+    const char *const end = pos + line.size();
+    while (pos != end) {
         if (m_readingTag) {
-            if (c == '>') {
-                // send tag
-                if (!m_tempTag.isEmpty()) {
-                    element(m_tempTag);
-                }
+            const char *const tagEnd = findChar(pos, end, '>');
+            if (tagEnd == nullptr) {
+                m_tempTag.append(pos, static_cast<int>(end - pos));
+                break;
+            }
 
+            // send tag
+            if (!m_tempTag.isEmpty()) {
+                m_tempTag.append(pos, static_cast<int>(tagEnd - pos));
+                element(m_tempTag);
                 m_tempTag.clear();
-
-                m_readingTag = false;
-                continue;
+            } else if (tagEnd != pos) {
+                element(QByteArray::fromRawData(pos, static_cast<int>(tagEnd - pos)));
             }
-            m_tempTag.append(c);
 
-        } else {
-            if (c == '<') {
-                m_lineToUser.append(characters(m_tempCharacters));
-                m_tempCharacters.clear();
+            m_readingTag = false;
+            pos = tagEnd + 1;
 
-                m_readingTag = true;
-                continue;
+        } else {
+            const char *const tagBegin = findChar(pos, end, '<');
+            const char *const textEnd = (tagBegin == nullptr) ? end : tagBegin;
+            if (textEnd != pos) {
+                m_lineToUser.append(
+                    characters(QByteArray::fromRawData(pos, static_cast<int>(textEnd - pos))));
             }
-            m_tempCharacters.append(c);
+            if (tagBegin == nullptr)
+                break;
+
+            m_readingTag = true;
+            pos = tagBegin + 1;
         }
     }
 
-    if (!m_readingTag) {
-        m_lineToUser.append(characters(m_tempCharacters));
-        m_tempCharacters.clear();
-    }
     if (!m_lineToUser.isEmpty()) {
         const auto isGoAhead = [](const TelnetDataEnum type) -> bool {
             switch (type) {
@@ -157,21 +298,15 @@ void MumeXmlParser::parse(const TelnetData &data)
         };
         sendToUser(m_lineToUser, isGoAhead(data.type));
 
-        {
-            // Simplify the output and run actions
-            QByteArray temp = m_lineToUser;
-            if (!getConfig().parser.removeXmlTags) {
-                stripXmlEntities(temp);
-            }
-            QString tempStr = temp;
-            tempStr = normalizeStringCopy(tempStr.trimmed());
-            parseMudCommands(tempStr);
-        }
+        // Simplify the output and run actions
+        const bool decodeEntities = !getProxyConfigSnapshot().parser.removeXmlTags;
+        parseMudCommands(normalizeForActions(m_lineToUser, decodeEntities));
     }
 }
 
 bool MumeXmlParser::element(const QByteArray &line)
 {
+    ParserProfile::StageTimer timer{getParserProfile(), ParserStageEnum::ELEMENT};
     const int length = line.length();
 
     switch (m_xmlMode) {
@@ -182,7 +317,7 @@ bool MumeXmlParser::element(const QByteArray &line)
                 if (line.startsWith("/snoop")) {
                     m_lineFlags.remove(LineFlagEnum::SNOOP);
                     if (m_descriptionReady) {
-                        if (!m_exitsReady && getConfig().mumeNative.emulatedExits) {
+                        if (!m_exitsReady && getProxyConfigSnapshot().mumeNative.emulatedExits) {
                             m_exitsReady = true;
                             std::ostringstream os;
                             emulateExits(os, m_move);
@@ -224,11 +359,9 @@ bool MumeXmlParser::element(const QByteArray &line)
             case 'r':
                 if (line.startsWith("room")) {
                     m_xmlMode = XmlModeEnum::ROOM;
-                    m_roomName = RoomName{}; // 'name' tag will not show up when blinded
+                    m_room.beginRoom();
                     m_descriptionReady = false;
                     m_exitsReady = false;
-                    m_dynamicRoomDesc.reset();
-                    m_staticRoomDesc.reset();
                     m_exits = nullString;
                     m_promptFlags.reset();
                     m_exitsFlags.reset();
@@ -307,7 +440,8 @@ bool MumeXmlParser::element(const QByteArray &line)
         if (length > 0) {
             switch (line.at(0)) {
             case 'g':
-                if (line.startsWith("gratuitous") && getConfig().parser.removeXmlTags) {
+                if (line.startsWith("gratuitous")
+                    && getProxyConfigSnapshot().parser.removeXmlTags) {
                     m_gratuitous = true;
                 }
                 break;
@@ -320,8 +454,7 @@ bool MumeXmlParser::element(const QByteArray &line)
             case 'd':
                 if (line.startsWith("description")) {
                     m_xmlMode = XmlModeEnum::DESCRIPTION;
-                    // might be empty but valid description
-                    m_staticRoomDesc = RoomStaticDesc{""};
+                    m_room.beginStaticDesc();
                     m_lineFlags.insert(LineFlagEnum::DESCRIPTION);
                 }
                 break;
@@ -417,7 +550,7 @@ bool MumeXmlParser::element(const QByteArray &line)
         break;
     }
 
-    if (!getConfig().parser.removeXmlTags) {
+    if (!getProxyConfigSnapshot().parser.removeXmlTags) {
         m_lineToUser.append(lessThanChar).append(line).append(greaterThanChar);
     }
 
@@ -426,23 +559,22 @@ bool MumeXmlParser::element(const QByteArray &line)
 
 void MumeXmlParser::stripXmlEntities(QByteArray &ch)
 {
-    ch.replace(greaterThanTemplate, greaterThanChar);
-    ch.replace(lessThanTemplate, lessThanChar);
-    ch.replace(ampersandTemplate, ampersand);
+    ch = decodeXmlEntities(ch);
 }
 
-QByteArray MumeXmlParser::characters(QByteArray &ch)
+QByteArray MumeXmlParser::characters(const QByteArray &input)
 {
+    ParserProfile::StageTimer timer{getParserProfile(), ParserStageEnum::CHARACTERS};
     QByteArray toUser;
 
-    if (ch.isEmpty()) {
+    if (input.isEmpty()) {
         return toUser;
     }
 
     // replace > and < chars
-    stripXmlEntities(ch);
+    const QByteArray ch = decodeXmlEntities(input);
 
-    const auto &config = getConfig();
+    const auto &config = getProxyConfigSnapshot();
     m_stringBuffer = QString::fromLatin1(ch);
 
     if (m_lineFlags.isSnoop() && m_stringBuffer.length() > 3 && m_stringBuffer.at(0) == '&'
@@ -468,21 +600,17 @@ QByteArray MumeXmlParser::characters(QByteArray &ch)
         break;
 
     case XmlModeEnum::ROOM: // dynamic line
-        m_dynamicRoomDesc = RoomDynamicDesc{
-            m_dynamicRoomDesc.value_or(RoomDynamicDesc{}).toQString()
-            + normalizeStringCopy(m_stringBuffer.simplified().append("\n"))};
+        m_room.appendDynamicDescLine(m_stringBuffer);
         toUser.append(ch);
         break;
 
     case XmlModeEnum::NAME:
-        m_roomName = RoomName{normalizeStringCopy(m_stringBuffer)};
+        m_room.setName(m_stringBuffer);
         toUser.append(ch);
         break;
 
     case XmlModeEnum::DESCRIPTION: // static line
-        m_staticRoomDesc = RoomStaticDesc{
-            m_staticRoomDesc.value_or(RoomStaticDesc{}).toQString()
-            + normalizeStringCopy(m_stringBuffer.simplified().append("\n"))};
+        m_room.appendStaticDescLine(m_stringBuffer);
         if (!m_gratuitous) {
             toUser.append(ch);
         }
@@ -495,11 +623,8 @@ QByteArray MumeXmlParser::characters(QByteArray &ch)
     case XmlModeEnum::PROMPT:
         // Store prompts in case an internal command is executed
         m_lastPrompt = m_stringBuffer.toLatin1();
-        if (!getConfig().parser.removeXmlTags) {
-            m_lastPrompt.replace(ampersand, ampersandTemplate);
-            m_lastPrompt.replace(greaterThanChar, greaterThanTemplate);
-            m_lastPrompt.replace(lessThanChar, lessThanTemplate);
-            m_lastPrompt = "<prompt>" + m_lastPrompt + "</prompt>";
+        if (!getProxyConfigSnapshot().parser.removeXmlTags) {
+            m_lastPrompt = "<prompt>" + encodeXmlEntities(m_lastPrompt) + "</prompt>";
         }
         sendPromptLineEvent(normalizeStringCopy(m_stringBuffer).toLatin1());
         if (m_descriptionReady) {
@@ -522,36 +647,26 @@ QByteArray MumeXmlParser::characters(QByteArray &ch)
         break;
     }
 
-    if (!getConfig().parser.removeXmlTags) {
-        toUser.replace(ampersand, ampersandTemplate);
-        toUser.replace(greaterThanChar, greaterThanTemplate);
-        toUser.replace(lessThanChar, lessThanTemplate);
+    if (!getProxyConfigSnapshot().parser.removeXmlTags) {
+        toUser = encodeXmlEntities(toUser);
     }
     return toUser;
 }
 
 void MumeXmlParser::move()
 {
+    ParserProfile::StageTimer timer{getParserProfile(), ParserStageEnum::MOVE};
     m_descriptionReady = false;
 
-    if (!m_roomName.has_value() || // blindness
-        Patterns::matchNoDescriptionPatterns(
-            m_roomName.value()
-                .toQString())) { // non standard end of description parsed (fog, dark or so ...)
-        m_roomName.reset();
-        m_dynamicRoomDesc.reset();
-        m_staticRoomDesc.reset();
+    // blindness, or a non standard end of description parsed (fog, dark or so ...)
+    if (!m_room.hasName()
+        || Patterns::matchNoDescriptionPatterns(::toQStringLatin1(m_room.getName()))) {
+        m_room.reset();
     }
 
     const auto emitEvent = [this]() {
-        auto ev = ParseEvent::createEvent(m_move,
-                                          m_roomName.value_or(RoomName{}),
-                                          m_dynamicRoomDesc.value_or(RoomDynamicDesc{}),
-                                          m_staticRoomDesc.value_or(RoomStaticDesc{}),
-                                          m_exitsFlags,
-                                          m_promptFlags,
-                                          m_connectedRoomFlags);
-        emit event(SigParseEvent{ev});
+        emit event(
+            SigParseEvent{m_room.build(m_move, m_exitsFlags, m_promptFlags, m_connectedRoomFlags)});
     };
 
     if (m_queue.isEmpty()) {
@@ -570,11 +685,10 @@ void MumeXmlParser::move()
     m_move = CommandEnum::LOOK;
 }
 
-void MumeXmlParser::parseMudCommands(const QString &str)
+void MumeXmlParser::parseMudCommands(const std::string &str)
 {
     // REVISIT: Add XML tag-based actions that match on a given LineFlag
-    const auto stdString = ::toStdStringLatin1(str);
-    if (evalActionMap(StringView{stdString}))
+    if (evalActionMap(StringView{str}))
         return;
 }
 
@@ -6,6 +6,7 @@
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
 #include <optional>
+#include <string>
 #include <string_view>
 #include <QByteArray>
 #include <QString>
@@ -15,6 +16,7 @@
 
 #include "CommandId.h"
 #include "LineFlags.h"
+#include "RoomEventBuilder.h"
 #include "abstractparser.h"
 
 class GroupManagerApi;
@@ -42,7 +44,7 @@ class MumeXmlParser final : public AbstractParser
     XmlModeEnum m_xmlMode = XmlModeEnum::NONE;
     LineFlags m_lineFlags;
     QByteArray m_lineToUser;
-    QByteArray m_tempCharacters;
+    // a tag that continues on the next line
     QByteArray m_tempTag;
     QString m_stringBuffer;
     std::optional<char> m_snoopChar;
@@ -50,11 +52,7 @@ class MumeXmlParser final : public AbstractParser
     bool m_gratuitous = false;
     bool m_exitsReady = false;
     bool m_descriptionReady = false;
-
-    // REVISIT: Is there any point to having a distinction between null and empty?
-    std::optional<RoomName> m_roomName;
-    std::optional<RoomStaticDesc> m_staticRoomDesc;
-    std::optional<RoomDynamicDesc> m_dynamicRoomDesc;
+    RoomEventBuilder m_room;
 
 public:
     explicit MumeXmlParser(
@@ -68,8 +66,8 @@ class MumeXmlParser final : public AbstractParser
     void parseNewMudInput(const TelnetData &data) override;
 
 private:
-    void parseMudCommands(const QString &str);
-    QByteArray characters(QByteArray &ch);
+    void parseMudCommands(const std::string &str);
+    QByteArray characters(const QByteArray &input);
     bool element(const QByteArray &);
     void move();
     std::string snoopToUser(const std::string_view &str);
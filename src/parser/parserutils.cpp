@@ -8,6 +8,8 @@
 
 #include <array>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
 #include <stdexcept>
 #include <QRegularExpression>
 #include <QtCore>
@@ -62,35 +64,108 @@ static_assert(latin1ToAscii("\x9f"[0]) == LATIN1_UNDEFINED);
 static_assert(latin1ToAscii("\xa0"[0]) == ' ');
 static_assert(latin1ToAscii("\xff"[0]) == 'y');
 
+// Every byte's transliteration, so the loops below don't branch on the character.
+static constexpr const std::array<char, NUM_LATIN1_CODEPOINTS> g_byteToAscii = []() {
+    std::array<char, NUM_LATIN1_CODEPOINTS> table{};
+    for (size_t i = 0; i < NUM_LATIN1_CODEPOINTS; ++i)
+        table[i] = latin1ToAscii(static_cast<char>(i));
+    return table;
+}();
+
+static_assert(g_byteToAscii['X'] == 'X');
+static_assert(g_byteToAscii[0x80] == LATIN1_UNDEFINED);
+static_assert(g_byteToAscii[0xE9] == 'e');
+
+// Checks a word at a time; compilers vectorize the main loop.
+bool isAscii(const std::string_view &sv)
+{
+    static constexpr const uint64_t HIGH_BITS = 0x8080808080808080ull;
+    const char *const data = sv.data();
+    const size_t size = sv.size();
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, sizeof(word));
+        if ((word & HIGH_BITS) != 0)
+            return false;
+    }
+    for (; i < size; ++i) {
+        if (!isAscii(data[i]))
+            return false;
+    }
+    return true;
+}
+
+bool isAscii(const QString &str)
+{
+    static constexpr const uint64_t NON_ASCII_BITS = 0xFF80FF80FF80FF80ull;
+    const ushort *const utf16 = str.utf16();
+    const int size = str.size();
+    int i = 0;
+    for (; i + 4 <= size; i += 4) {
+        uint64_t word = 0;
+        std::memcpy(&word, utf16 + i, sizeof(word));
+        if ((word & NON_ASCII_BITS) != 0)
+            return false;
+    }
+    for (; i < size; ++i) {
+        if (utf16[i] >= NUM_ASCII_CODEPOINTS)
+            return false;
+    }
+    return true;
+}
+
 QString &removeAnsiMarksInPlace(QString &str)
 {
     static const QRegularExpression ansi("\x1b\\[[0-9;]*[A-Za-z]");
-    str.remove(ansi);
+    if (str.contains(QChar('\x1b')))
+        str.remove(ansi);
     return str;
 }
 
 QString &toAsciiInPlace(QString &str)
 {
+    // Avoids detaching strings that are already ASCII, which most lines are.
+    if (isAscii(str))
+        return str;
+
     // NOTE: 128 (0x80) was not converted to 'z' before.
+    // Characters beyond Latin-1 are left alone.
     for (QChar &qc : str) {
         // c++17 if statement with initializer
-        if (const char ch = qc.toLatin1(); !isAscii(ch)) {
-            qc = latin1ToAscii(ch);
-        }
+        if (const size_t u = qc.unicode(); u >= NUM_ASCII_CODEPOINTS && u < NUM_LATIN1_CODEPOINTS)
+            qc = g_byteToAscii[u];
     }
     return str;
 }
 
+static void transliterate(char *const data, const size_t size) noexcept
+{
+    for (size_t i = 0; i < size; ++i)
+        data[i] = g_byteToAscii[getIndex(data[i])];
+}
+
+void latin1ToAsciiInPlace(char *const data, const size_t size)
+{
+    if (!isAscii(std::string_view{data, size}))
+        transliterate(data, size);
+}
+
 std::string &latin1ToAsciiInPlace(std::string &str)
 {
-    for (char &c : str) {
-        if (!isAscii(c)) {
-            c = latin1ToAscii(c);
-        }
-    }
+    latin1ToAsciiInPlace(str.data(), str.size());
     return str;
 }
 
+QByteArray &latin1ToAsciiInPlace(QByteArray &bytes)
+{
+    // Only detaches if something changes.
+    const auto size = static_cast<size_t>(bytes.size());
+    if (!isAscii(std::string_view{bytes.constData(), size}))
+        transliterate(bytes.data(), size);
+    return bytes;
+}
+
 std::string latin1ToAscii(const std::string_view &sv)
 {
     std::string tmp{sv};
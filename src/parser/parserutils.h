@@ -5,15 +5,25 @@
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <cstddef>
 #include <string>
 #include <string_view>
 
+class QByteArray;
 class QString;
 
 namespace ParserUtils {
+bool isAscii(const std::string_view &sv);
+bool isAscii(const QString &str);
+
 QString &removeAnsiMarksInPlace(QString &str);
 QString &toAsciiInPlace(QString &str);
+
+// Transliterates Latin-1 bytes with a lookup table; buffers that are already ASCII
+// are only read.
+void latin1ToAsciiInPlace(char *data, size_t size);
 std::string &latin1ToAsciiInPlace(std::string &str);
+QByteArray &latin1ToAsciiInPlace(QByteArray &bytes);
 std::string latin1ToAscii(const std::string_view &sv);
 
 } // namespace ParserUtils
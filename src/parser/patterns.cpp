@@ -5,10 +5,108 @@
 
 #include "patterns.h"
 
+#include <algorithm>
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+#include <vector>
 #include <QRegularExpression>
+#include <QSet>
+#include <QStringList>
 
 #include "../configuration/configuration.h"
 
+namespace {
+// A list of patterns, sorted by kind when the list is configured, so a line
+// doesn't have to decode each pattern's prefix code again.
+struct CompiledPatterns final
+{
+    QStringList source;
+    QSet<QString> equal;
+    std::vector<QString> prefixes;
+    std::vector<QString> suffixes;
+    std::vector<QString> substrings;
+    std::vector<QRegularExpression> regexes;
+
+    explicit CompiledPatterns(const QStringList &list)
+        : source{list}
+    {
+        for (const QString &pattern : list) {
+            if (pattern.size() < 2 || pattern.at(0) != '#')
+                continue;
+
+            const QString rest = pattern.mid(2);
+            switch (pattern.at(1).toLatin1()) {
+            case '!':
+                regexes.emplace_back(rest);
+                break;
+            case '<':
+                prefixes.emplace_back(rest);
+                break;
+            case '=':
+                equal.insert(rest);
+                break;
+            case '>':
+                suffixes.emplace_back(rest);
+                break;
+            case '?':
+                substrings.emplace_back(rest);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    bool matches(const QString &str) const
+    {
+        const auto any = [](const std::vector<QString> &patterns, const auto &pred) {
+            return std::any_of(patterns.begin(), patterns.end(), pred);
+        };
+
+        return equal.contains(str)
+               || any(prefixes, [&str](const QString &p) { return str.startsWith(p); })
+               || any(suffixes, [&str](const QString &p) { return str.endsWith(p); })
+               || any(substrings, [&str](const QString &p) { return str.contains(p); })
+               || std::any_of(regexes.begin(), regexes.end(), [&str](const QRegularExpression &re) {
+                      return re.match(str).hasMatch();
+                  });
+    }
+};
+
+// Each proxy thread keeps its own compiled copy; while the list is still
+// shared with the config, checking that it's current is a pointer comparison.
+const CompiledPatterns &getCompiledPatterns(const QStringList &list)
+{
+    thread_local std::optional<CompiledPatterns> t_compiled;
+    if (!t_compiled.has_value() || !t_compiled->source.isSharedWith(list)) {
+        if (t_compiled.has_value() && t_compiled->source == list)
+            t_compiled->source = list;
+        else
+            t_compiled.emplace(list);
+    }
+    return t_compiled.value();
+}
+
+// Matches ^<stem>(<suffix>)? $, where $ also matches before a final newline,
+// without converting the line to a QString.
+bool matchPrompt(const QByteArray &str,
+                 const std::string_view &stem,
+                 const std::initializer_list<std::string_view> &optionalSuffixes)
+{
+    std::string_view s{str.constData(), static_cast<size_t>(str.size())};
+    if (!s.empty() && s.back() == '\n')
+        s.remove_suffix(1);
+    if (s.size() <= stem.size() || s.back() != ' ' || s.substr(0, stem.size()) != stem)
+        return false;
+
+    s = s.substr(stem.size(), s.size() - stem.size() - 1);
+    return s.empty()
+           || std::find(optionalSuffixes.begin(), optionalSuffixes.end(), s)
+                  != optionalSuffixes.end();
+}
+} // namespace
+
 bool Patterns::matchPattern(const QString &pattern, const QString &str)
 {
     if (pattern.at(0) != '#') {
@@ -48,28 +146,24 @@ bool Patterns::matchPattern(const QString &pattern, const QString &str)
 
 bool Patterns::matchNoDescriptionPatterns(const QString &str)
 {
-    for (auto &pattern : getConfig().parser.noDescriptionPatternsList) {
-        if (matchPattern(pattern, str)) {
-            return true;
-        }
-    }
-    return false;
+    const auto &settings = getProxyConfigSnapshot().parser;
+    return getCompiledPatterns(settings.noDescriptionPatternsList).matches(str);
 }
 
 bool Patterns::matchPasswordPatterns(const QByteArray &str)
 {
-    static const QRegularExpression re(R"(^Account pass phrase:? $)");
-    return re.match(str).hasMatch();
+    // ^Account pass phrase:? $
+    return matchPrompt(str, "Account pass phrase", {":"});
 }
 
 bool Patterns::matchLoginPatterns(const QByteArray &str)
 {
-    static const QRegularExpression re(R"(^By what name do you wish to be known\?? $)");
-    return re.match(str).hasMatch();
+    // ^By what name do you wish to be known\?? $
+    return matchPrompt(str, "By what name do you wish to be known", {"?"});
 }
 
 bool Patterns::matchMenuPromptPatterns(const QByteArray &str)
 {
-    static const QRegularExpression re(R"(^Account(>|&gt;)? $)");
-    return re.match(str).hasMatch();
+    // ^Account(>|&gt;)? $
+    return matchPrompt(str, "Account", {">", "&gt;"});
 }
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "EventCapture.h"
+
+#include <string>
+
+#include "../global/io.h"
+#include "../parser/CommandId.h"
+
+static constexpr const quint32 CAPTURE_MAGIC = 0x4d4d4556u; // "MMEV"
+static constexpr const quint32 CAPTURE_VERSION = 1u;
+
+static void writeString(QDataStream &stream, const std::string &s)
+{
+    stream << QByteArray::fromStdString(s);
+}
+
+EventCaptureWriter::EventCaptureWriter(const QString &fileName)
+    : m_file{fileName}
+{
+    if (!m_file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "Unable to open event capture file" << fileName << m_file.errorString();
+        return;
+    }
+    m_stream.setDevice(&m_file);
+    m_stream << CAPTURE_MAGIC << CAPTURE_VERSION;
+}
+
+void EventCaptureWriter::writeEvent(const ParseEvent &event, const RoomId result)
+{
+    if (!isOpen())
+        return;
+
+    m_stream << static_cast<quint8>(CaptureRecordEnum::EVENT);
+    m_stream << static_cast<quint8>(event.getMoveType());
+    writeString(m_stream, event.getRoomName().getStdString());
+    writeString(m_stream, event.getDynamicDesc().getStdString());
+    writeString(m_stream, event.getStaticDesc().getStdString());
+    m_stream << static_cast<quint32>(event.getExitsFlags());
+    m_stream << static_cast<quint32>(event.getPromptFlags());
+    m_stream << static_cast<quint32>(event.getConnectedRoomFlags());
+    m_stream << result.asUint32();
+    // Flush so an abrupt exit still leaves a usable capture.
+    m_file.flush();
+}
+
+void EventCaptureWriter::writeSetCurrentRoom(const RoomId id, const bool update)
+{
+    if (!isOpen())
+        return;
+
+    m_stream << static_cast<quint8>(CaptureRecordEnum::SET_CURRENT_ROOM) << id.asUint32() << update;
+    m_file.flush();
+}
+
+void EventCaptureWriter::writeReleaseAllPaths()
+{
+    if (!isOpen())
+        return;
+
+    m_stream << static_cast<quint8>(CaptureRecordEnum::RELEASE_ALL_PATHS);
+    m_file.flush();
+}
+
+EventCaptureReader::EventCaptureReader(QIODevice &device)
+    : m_stream{&device}
+{
+    quint32 magic = 0;
+    quint32 version = 0;
+    m_stream >> magic >> version;
+    checkStatus();
+    if (magic != CAPTURE_MAGIC)
+        throw io::IOException("not an event capture");
+    if (version != CAPTURE_VERSION)
+        throw io::IOException("unsupported event capture version");
+}
+
+void EventCaptureReader::checkStatus()
+{
+    if (m_stream.status() != QDataStream::Ok)
+        throw io::IOException("truncated or corrupt event capture");
+}
+
+std::optional<CaptureRecord> EventCaptureReader::next()
+{
+    if (m_stream.atEnd())
+        return std::nullopt;
+
+    quint8 type = 0;
+    m_stream >> type;
+    checkStatus();
+
+    CaptureRecord record;
+    switch (static_cast<CaptureRecordEnum>(type)) {
+    case CaptureRecordEnum::EVENT: {
+        quint8 move = 0;
+        QByteArray name;
+        QByteArray dynamicDesc;
+        QByteArray staticDesc;
+        quint32 exits = 0;
+        quint32 prompt = 0;
+        quint32 connected = 0;
+        quint32 result = 0;
+        m_stream >> move >> name >> dynamicDesc >> staticDesc >> exits >> prompt >> connected
+            >> result;
+        checkStatus();
+
+        record.type = CaptureRecordEnum::EVENT;
+        record.event = ParseEvent::createEvent(static_cast<CommandEnum>(move),
+                                               RoomName{name.toStdString()},
+                                               RoomDynamicDesc{dynamicDesc.toStdString()},
+                                               RoomStaticDesc{staticDesc.toStdString()},
+                                               ExitsFlagsType::create_unsafe(exits),
+                                               PromptFlagsType::create_unsafe(prompt),
+                                               ConnectedRoomFlagsType::create_unsafe(connected));
+        record.room = RoomId{result};
+        return record;
+    }
+    case CaptureRecordEnum::SET_CURRENT_ROOM: {
+        quint32 id = 0;
+        bool update = false;
+        m_stream >> id >> update;
+        checkStatus();
+
+        record.type = CaptureRecordEnum::SET_CURRENT_ROOM;
+        record.room = RoomId{id};
+        record.update = update;
+        return record;
+    }
+    case CaptureRecordEnum::RELEASE_ALL_PATHS:
+        record.type = CaptureRecordEnum::RELEASE_ALL_PATHS;
+        return record;
+    }
+
+    throw io::IOException("unknown event capture record");
+}
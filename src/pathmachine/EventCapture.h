@@ -0,0 +1,61 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstdint>
+#include <optional>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+
+#include "../expandoracommon/parseevent.h"
+#include "../global/RuleOf5.h"
+#include "../global/roomid.h"
+
+/// Everything fed to the path machine during a session, in order: each parse
+/// event together with the room the path machine settled on afterwards, plus
+/// the commands that reset its state. See tests/BenchEventReplay.cpp for the consumer.
+enum class CaptureRecordEnum : uint8_t { EVENT = 0, SET_CURRENT_ROOM = 1, RELEASE_ALL_PATHS = 2 };
+
+struct CaptureRecord final
+{
+    CaptureRecordEnum type = CaptureRecordEnum::EVENT;
+    SharedParseEvent event;       // EVENT
+    RoomId room = INVALID_ROOMID; // EVENT: resulting room; SET_CURRENT_ROOM: target
+    bool update = false;          // SET_CURRENT_ROOM
+};
+
+class EventCaptureWriter final
+{
+private:
+    QFile m_file;
+    QDataStream m_stream;
+
+public:
+    explicit EventCaptureWriter(const QString &fileName);
+    DELETE_CTORS_AND_ASSIGN_OPS(EventCaptureWriter);
+
+public:
+    bool isOpen() const { return m_file.isOpen(); }
+    void writeEvent(const ParseEvent &event, RoomId result);
+    void writeSetCurrentRoom(RoomId id, bool update);
+    void writeReleaseAllPaths();
+};
+
+/// Throws io::IOException if the capture is truncated or isn't a capture.
+class EventCaptureReader final
+{
+private:
+    QDataStream m_stream;
+
+public:
+    explicit EventCaptureReader(QIODevice &device);
+    DELETE_CTORS_AND_ASSIGN_OPS(EventCaptureReader);
+
+public:
+    /// Returns std::nullopt at the end of the capture.
+    std::optional<CaptureRecord> next();
+
+private:
+    void checkStatus();
+};
@@ -9,8 +9,11 @@
 #include "../expandoracommon/room.h"
 #include "../mapfrontend/mapaction.h"
 
-Approved::Approved(const SigParseEvent &sigParseEvent, const int tolerance)
+Approved::Approved(const SigParseEvent &sigParseEvent,
+                   const int tolerance,
+                   RoomCompareCache &in_compareCache)
     : myEvent{sigParseEvent.requireValid()}
+    , compareCache{in_compareCache}
     , matchingTolerance{tolerance}
 {}
 
@@ -28,17 +31,11 @@ Approved::~Approved()
 void Approved::receiveRoom(RoomAdmin *const sender, const Room *const perhaps)
 {
     auto &event = myEvent.deref();
+    ++numCandidates;
 
     const auto id = perhaps->getId();
-    const auto cmp = [this, &event, &id, &perhaps]() {
-        // Cache comparisons because we regularly call releaseMatch() and try the same rooms again
-        auto it = compareCache.find(id);
-        if (it != compareCache.end())
-            return it->second;
-        const auto result = Room::compare(perhaps, event, matchingTolerance);
-        compareCache.emplace(id, result);
-        return result;
-    }();
+    // Cached because we regularly call releaseMatch() and try the same rooms again
+    const auto cmp = compareCache.compare(perhaps, event, matchingTolerance);
 
     if (cmp == ComparisonResultEnum::DIFFERENT) {
         sender->releaseRoom(*this, id);
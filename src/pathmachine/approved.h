@@ -4,13 +4,12 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
-#include <unordered_map>
-
 #include "../expandoracommon/RoomRecipient.h"
 #include "../expandoracommon/parseevent.h"
 #include "../expandoracommon/room.h"
 #include "../global/RuleOf5.h"
 #include "../global/roomid.h"
+#include "roomcomparecache.h"
 
 class ParseEvent;
 class Room;
@@ -20,21 +19,25 @@ class Approved : public RoomRecipient
 {
 private:
     SigParseEvent myEvent;
-    std::unordered_map<RoomId, ComparisonResultEnum> compareCache;
+    RoomCompareCache &compareCache;
     const Room *matchedRoom = nullptr;
     RoomAdmin *owner = nullptr;
     const int matchingTolerance;
     bool moreThanOne = false;
     bool update = false;
+    uint numCandidates = 0u;
 
 public:
-    explicit Approved(const SigParseEvent &sigParseEvent, int matchingTolerance);
+    explicit Approved(const SigParseEvent &sigParseEvent,
+                      int matchingTolerance,
+                      RoomCompareCache &compareCache);
     ~Approved() override;
 
 public:
     void receiveRoom(RoomAdmin *, const Room *) override;
     const Room *oneMatch() const;
     bool needsUpdate() const { return update; }
+    uint getNumCandidates() const { return numCandidates; }
     void releaseMatch();
 
 public:
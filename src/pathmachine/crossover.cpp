@@ -20,6 +20,7 @@ Crossover::Crossover(std::shared_ptr<PathList> paths, ExitDirEnum dirCode, PathP
 
 void Crossover::receiveRoom(RoomAdmin *const admin, const Room *const room)
 {
+    ++numCandidates;
     if (shortPaths->empty())
         admin->releaseRoom(*this, room->getId());
 
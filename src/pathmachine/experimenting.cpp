@@ -5,6 +5,7 @@
 
 #include "experimenting.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "../expandoracommon/room.h"
@@ -32,16 +33,50 @@ void Experimenting::augmentPath(const std::shared_ptr<Path> &path,
     if (best == nullptr) {
         best = working;
     } else if (working->getProb() > best->getProb()) {
-        paths->push_back(best);
+        addCandidate(best);
         second = best;
         best = working;
     } else {
         if (second == nullptr || working->getProb() > second->getProb()) {
             second = working;
         }
-        paths->push_back(working);
+        addCandidate(working);
     }
     numPaths++;
+    pruneCandidates();
+}
+
+bool Experimenting::isMoreLikely(const Candidate &a, const Candidate &b)
+{
+    // As a heap comparator, this keeps the least likely candidate in front.
+    return a.prob > b.prob;
+}
+
+void Experimenting::addCandidate(const std::shared_ptr<Path> &path)
+{
+    m_candidates.emplace_back(Candidate{path->getProb(), m_nextSequence++, path});
+    std::push_heap(m_candidates.begin(), m_candidates.end(), isMoreLikely);
+}
+
+// Same test evaluate() uses to throw a path away. Since best only grows and numPaths
+// only increases, once this holds for a candidate it still holds in evaluate().
+bool Experimenting::isPruned(const Path &working) const
+{
+    return best->getProb() > working.getProb() * params.maxPaths / numPaths;
+}
+
+void Experimenting::pruneCandidates()
+{
+    if (!params.pruneForks)
+        return;
+
+    // Denying is deferred to evaluate(): it can release rooms, and this runs
+    // while the map is still handing us candidates.
+    while (!m_candidates.empty() && isPruned(*m_candidates.front().path)) {
+        std::pop_heap(m_candidates.begin(), m_candidates.end(), isMoreLikely);
+        m_doomed.emplace_back(std::move(m_candidates.back().path));
+        m_candidates.pop_back();
+    }
 }
 
 std::shared_ptr<PathList> Experimenting::evaluate()
@@ -54,9 +89,28 @@ std::shared_ptr<PathList> Experimenting::evaluate()
         }
     }
 
+    // The survivors keep the order in which they were forked.
+    std::sort(m_candidates.begin(), m_candidates.end(), [](const auto &a, const auto &b) {
+        return a.sequence < b.sequence;
+    });
+    for (Candidate &candidate : m_candidates) {
+        paths->push_back(std::move(candidate.path));
+    }
+    m_candidates.clear();
+
+    const bool acceptBest = best != nullptr
+                            && (second == nullptr
+                                || best->getProb() > second->getProb() * params.acceptBestRelative
+                                || best->getProb() > second->getProb() + params.acceptBestAbsolute);
+    second = nullptr;
+
+    for (auto &path : m_doomed) {
+        path->deny();
+    }
+    m_doomed.clear();
+
     if (best != nullptr) {
-        if (second == nullptr || best->getProb() > second->getProb() * params.acceptBestRelative
-            || best->getProb() > second->getProb() + params.acceptBestAbsolute) {
+        if (acceptBest) {
             for (auto &path : *paths) {
                 path->deny();
             }
@@ -82,7 +136,6 @@ std::shared_ptr<PathList> Experimenting::evaluate()
             }
         }
     }
-    second = nullptr;
     shortPaths = nullptr;
     best = nullptr;
     return paths;
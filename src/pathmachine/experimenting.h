@@ -4,7 +4,9 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 #include <QtGlobal>
 
 #include "../expandoracommon/RoomRecipient.h"
@@ -31,6 +33,26 @@ class Experimenting : public RoomRecipient
     std::shared_ptr<Path> best;
     std::shared_ptr<Path> second;
     double numPaths = 0.0;
+    uint numCandidates = 0u;
+
+private:
+    // Forked paths other than `best`, as a min-heap on probability. Entries that
+    // can no longer survive evaluate() are moved to m_doomed as soon as `best`
+    // and `numPaths` make that certain, so the heap only holds real contenders.
+    struct Candidate final
+    {
+        double prob = 0.0;
+        uint64_t sequence = 0;
+        std::shared_ptr<Path> path;
+    };
+    std::vector<Candidate> m_candidates;
+    std::vector<std::shared_ptr<Path>> m_doomed;
+    uint64_t m_nextSequence = 0;
+
+    static bool isMoreLikely(const Candidate &a, const Candidate &b);
+    void addCandidate(const std::shared_ptr<Path> &path);
+    void pruneCandidates();
+    bool isPruned(const Path &working) const;
 
 public:
     explicit Experimenting(std::shared_ptr<PathList> paths,
@@ -39,6 +61,8 @@ class Experimenting : public RoomRecipient
     virtual ~Experimenting() override;
 
     std::shared_ptr<PathList> evaluate();
+    uint getNumCandidates() const { return numCandidates; }
+    uint getNumForks() const { return static_cast<uint>(numPaths); }
     virtual void receiveRoom(RoomAdmin *, const Room *) override = 0;
 
 public:
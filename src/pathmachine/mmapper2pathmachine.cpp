@@ -11,7 +11,11 @@
 
 #include "../configuration/configuration.h"
 #include "../expandoracommon/parseevent.h"
+#include "../global/Trace.h"
+#include "../proxy/ProxyLatencyStats.h"
+#include "EventCapture.h"
 #include "pathmachine.h"
+#include "pathmachinestats.h"
 #include "pathparameters.h"
 
 static const char *stateName(const PathStateEnum state)
@@ -34,6 +38,9 @@ static const char *stateName(const PathStateEnum state)
 void Mmapper2PathMachine::event(const SigParseEvent &sigParseEvent)
 {
     static constexpr const char *const me = "PathMachine";
+    MMAPPER_TRACE_SCOPE("PathMachine::event");
+    ProxyLatencyStats::MapEventScope mapEvent{getProxyLatencyStats()};
+    ProxyLatencyStats::StageTimer timer{getProxyLatencyStats(), LatencyStageEnum::PATH_MACHINE};
 
     /*
      * REVISIT: replace PathParameters with Configuration::PathMachineSettings
@@ -48,16 +55,52 @@ void Mmapper2PathMachine::event(const SigParseEvent &sigParseEvent)
     params.maxPaths = settings.maxPaths;
     params.matchingTolerance = std::max(0, settings.matchingTolerance);
     params.multipleConnectionsPenalty = settings.multipleConnectionsPenalty;
+    params.nearbySyncRadius = std::max(0, settings.nearbySyncRadius);
 
     time.restart();
     emit log(me, QString("received event, state: %1").arg(stateName(state)));
     PathMachine::event(sigParseEvent);
+    if (m_capture != nullptr) {
+        m_capture->writeEvent(sigParseEvent.deref(), getMostLikelyRoomId());
+    }
     emit log(me,
              QString("done processing event, state: %1, elapsed: %2 ms")
                  .arg(stateName(state))
                  .arg(time.elapsed()));
+
+    static constexpr const uint64_t STATS_LOG_INTERVAL = 1000;
+    const auto &stats = getPathMachineStats();
+    if (stats.isLogging() && stats.getTotalEvents() % STATS_LOG_INTERVAL == 0) {
+        emit log(me, QString("statistics: %1").arg(stats.toSummaryLine()));
+    }
 }
 
 Mmapper2PathMachine::Mmapper2PathMachine(MapData *const mapData, QObject *const parent)
     : PathMachine(mapData, parent)
-{}
+{
+    const QByteArray captureFile = qgetenv("MMAPPER_CAPTURE_EVENTS");
+    if (!captureFile.isEmpty()) {
+        m_capture = std::make_unique<EventCaptureWriter>(QString::fromLocal8Bit(captureFile));
+    }
+}
+
+Mmapper2PathMachine::~Mmapper2PathMachine() = default;
+
+void Mmapper2PathMachine::releaseAllPaths()
+{
+    // setCurrentRoom() releases the paths itself, so replaying it does too.
+    if (m_capture != nullptr && !m_settingCurrentRoom) {
+        m_capture->writeReleaseAllPaths();
+    }
+    PathMachine::releaseAllPaths();
+}
+
+void Mmapper2PathMachine::setCurrentRoom(const RoomId id, const bool update)
+{
+    if (m_capture != nullptr) {
+        m_capture->writeSetCurrentRoom(id, update);
+    }
+    m_settingCurrentRoom = true;
+    PathMachine::setCurrentRoom(id, update);
+    m_settingCurrentRoom = false;
+}
@@ -4,6 +4,7 @@
 // Author: Ulf Hermann <ulfonk_mennhar@gmx.de> (Alve)
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 
+#include <memory>
 #include <QString>
 #include <QtCore>
 
@@ -11,6 +12,7 @@
 #include "pathmachine.h"
 
 class Configuration;
+class EventCaptureWriter;
 class MapData;
 class ParseEvent;
 class QObject;
@@ -24,13 +26,22 @@ class Mmapper2PathMachine final : public PathMachine
     Q_OBJECT
 public slots:
     void event(const SigParseEvent &) override;
+    void releaseAllPaths() override;
+    void setCurrentRoom(RoomId id, bool update) override;
 
 public:
     explicit Mmapper2PathMachine(MapData *mapData, QObject *parent);
+    ~Mmapper2PathMachine() override;
+
+public:
+    RoomId getCurrentRoomId() const { return getMostLikelyRoomId(); }
 
 signals:
     void log(const QString &, const QString &);
 
 private:
     QElapsedTimer time;
+    // Enabled by setting MMAPPER_CAPTURE_EVENTS to the output file name.
+    std::unique_ptr<EventCaptureWriter> m_capture;
+    bool m_settingCurrentRoom = false;
 };
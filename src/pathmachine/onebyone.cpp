@@ -14,21 +14,26 @@
 #include "../parser/CommandId.h"
 #include "experimenting.h"
 #include "pathparameters.h"
+#include "roomcomparecache.h"
 #include "roomsignalhandler.h"
 
 class Path;
 
 OneByOne::OneByOne(const SigParseEvent &sigParseEvent,
                    PathParameters &in_params,
-                   RoomSignalHandler *const in_handler)
+                   RoomSignalHandler *const in_handler,
+                   RoomCompareCache &in_compareCache)
     : Experimenting{PathList::alloc(), getDirection(sigParseEvent.deref().getMoveType()), in_params}
     , event{sigParseEvent.getShared()}
     , handler{in_handler}
+    , compareCache{in_compareCache}
 {}
 
 void OneByOne::receiveRoom(RoomAdmin *const admin, const Room *const room)
 {
-    if (Room::compare(room, deref(event), params.matchingTolerance) == ComparisonResultEnum::EQUAL) {
+    ++numCandidates;
+    if (compareCache.compare(room, deref(event), params.matchingTolerance)
+        == ComparisonResultEnum::EQUAL) {
         augmentPath(shortPaths->back(), admin, room);
     } else {
         // needed because the memory address is not unique and
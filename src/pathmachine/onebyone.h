@@ -13,6 +13,7 @@ class ParseEvent;
 class Path;
 class Room;
 class RoomAdmin;
+class RoomCompareCache;
 class RoomSignalHandler;
 struct PathParameters;
 
@@ -21,11 +22,13 @@ class OneByOne final : public Experimenting
 public:
     explicit OneByOne(const SigParseEvent &sigParseEvent,
                       PathParameters &in_params,
-                      RoomSignalHandler *handler);
+                      RoomSignalHandler *handler,
+                      RoomCompareCache &compareCache);
     void receiveRoom(RoomAdmin *admin, const Room *room) override;
     void addPath(std::shared_ptr<Path> path);
 
 private:
     SharedParseEvent event;
     RoomSignalHandler *handler = nullptr;
+    RoomCompareCache &compareCache;
 };
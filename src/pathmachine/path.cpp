@@ -24,12 +24,15 @@ std::shared_ptr<Path> Path::alloc(const Room *const room,
                                   RoomSignalHandler *const signaler,
                                   std::optional<ExitDirEnum> moved_direction)
 {
-    return std::make_shared<Path>(this_is_private{0},
-                                  room,
-                                  owner,
-                                  locker,
-                                  signaler,
-                                  std::move(moved_direction));
+    // Paths are created and discarded by the hundred while the path machine
+    // experiments, so they (and their control blocks) are recycled via a pool.
+    return std::allocate_shared<Path>(PoolAllocator<Path>{},
+                                      this_is_private{0},
+                                      room,
+                                      owner,
+                                      locker,
+                                      signaler,
+                                      std::move(moved_direction));
 }
 
 Path::Path(this_is_private,
@@ -144,7 +147,7 @@ void Path::approve()
     }
 
     // was: `delete this`
-    this->m_zombie = true;
+    becomeZombie();
 }
 
 /** removes this path and all parents up to the next branch
@@ -166,7 +169,17 @@ void Path::deny()
     }
 
     // was: `delete this`
-    this->m_zombie = true;
+    becomeZombie();
+}
+
+void Path::becomeZombie()
+{
+    m_zombie = true;
+    // Zombies are never asked for their parent or children, so drop the links
+    // now; that lets pruned branches go back to the pool without waiting for
+    // the last PathList holding this path to be discarded.
+    m_parent.reset();
+    std::vector<std::weak_ptr<Path>>{}.swap(m_children);
 }
 
 void Path::insertChild(const std::shared_ptr<Path> &p)
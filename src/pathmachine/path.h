@@ -13,6 +13,7 @@
 #include <vector>
 #include <QtGlobal>
 
+#include "../global/PoolAllocator.h"
 #include "../mapdata/ExitDirection.h"
 #include "../mapdata/mmapper2exit.h"
 #include "pathparameters.h"
@@ -90,6 +91,9 @@ class Path final : public std::enable_shared_from_this<Path>
         return m_parent;
     }
 
+private:
+    void becomeZombie();
+
 private:
     std::shared_ptr<Path> m_parent;
     std::vector<std::weak_ptr<Path>> m_children;
@@ -101,7 +105,9 @@ class Path final : public std::enable_shared_from_this<Path>
     bool m_zombie = false;
 };
 
-struct PathList : public std::list<std::shared_ptr<Path>>,
+// List nodes come from a pool, since the path machine builds and discards
+// these lists on every move.
+struct PathList : public std::list<std::shared_ptr<Path>, PoolAllocator<std::shared_ptr<Path>>>,
                   public std::enable_shared_from_this<PathList>
 {
 private:
@@ -7,9 +7,11 @@
 #include "pathmachine.h"
 
 #include <cassert>
+#include <chrono>
 #include <memory>
 #include <set>
 #include <utility>
+#include <vector>
 
 #include "../expandoracommon/coordinate.h"
 #include "../expandoracommon/exit.h"
@@ -20,6 +22,7 @@
 #include "../mapdata/customaction.h"
 #include "../mapdata/mapdata.h"
 #include "../mapdata/mmapper2room.h"
+#include "../mapfrontend/MapLock.h"
 #include "../mapfrontend/mapaction.h"
 #include "../parser/CommandId.h"
 #include "../parser/ConnectedRoomFlags.h"
@@ -29,6 +32,7 @@
 #include "forced.h"
 #include "onebyone.h"
 #include "path.h"
+#include "pathmachinestats.h"
 #include "pathparameters.h"
 #include "roomsignalhandler.h"
 #include "syncing.h"
@@ -43,9 +47,9 @@ PathMachine::PathMachine(MapData *const mapData, QObject *const parent)
     , paths{PathList::alloc()}
 {
     connect(&signaler,
-            &RoomSignalHandler::sig_scheduleAction,
+            &RoomSignalHandler::sig_scheduleActions,
             this,
-            &PathMachine::slot_scheduleAction);
+            &PathMachine::slot_scheduleActions);
 }
 
 void PathMachine::setCurrentRoom(const RoomId id, bool update)
@@ -53,11 +57,13 @@ void PathMachine::setCurrentRoom(const RoomId id, bool update)
     Forced forced(lastEvent, update);
     emit lookingForRooms(forced, id);
     releaseAllPaths();
+    m_syncMoves = 0;
     if (const Room *const perhaps = forced.oneMatch()) {
         setMostLikelyRoom(*perhaps);
         emit playerMoved(perhaps->getPosition());
         emit setCharPosition(perhaps->getId());
         state = PathStateEnum::APPROVED;
+        emit sig_sweepTemporaryRooms();
     } else {
         clearMostLikelyRoom();
         state = PathStateEnum::SYNCING;
@@ -66,6 +72,7 @@ void PathMachine::setCurrentRoom(const RoomId id, bool update)
 
 void PathMachine::releaseAllPaths()
 {
+    const RoomSignalHandler::Batch batch{signaler};
     for (auto &path : *paths) {
         path->deny();
     }
@@ -80,18 +87,36 @@ void PathMachine::event(const SigParseEvent &sigParseEvent)
         lastEvent = sigParseEvent;
 
     lastEvent.requireValid();
+    compareCache.reset();
 
-    switch (state) {
-    case PathStateEnum::APPROVED:
-        approved(sigParseEvent);
-        break;
-    case PathStateEnum::EXPERIMENTING:
-        experimenting(sigParseEvent);
-        break;
-    case PathStateEnum::SYNCING:
-        syncing(sigParseEvent);
-        break;
+    const auto start = std::chrono::steady_clock::now();
+    const auto lockWaitBefore = MapLock::getCurrentThreadWaitTime();
+    const PathStateEnum startState = state;
+    m_step = PathMachineStats::Step{};
+
+    {
+        // Paths fork and die throughout the event; their rooms are given back at the end.
+        const RoomSignalHandler::Batch batch{signaler};
+        switch (state) {
+        case PathStateEnum::APPROVED:
+            approved(sigParseEvent);
+            break;
+        case PathStateEnum::EXPERIMENTING:
+            experimenting(sigParseEvent);
+            break;
+        case PathStateEnum::SYNCING:
+            syncing(sigParseEvent);
+            break;
+        }
     }
+    if (state == PathStateEnum::APPROVED && startState != PathStateEnum::APPROVED)
+        emit sig_sweepTemporaryRooms();
+
+    m_step.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    m_step.lockWait = MapLock::getCurrentThreadWaitTime() - lockWaitBefore;
+    m_step.paths = paths->size();
+    getPathMachineStats().record(startState, m_step);
 }
 
 void PathMachine::tryExits(const Room *const room,
@@ -144,15 +169,9 @@ void PathMachine::tryCoordinate(const Room *const room,
         emit lookingForRooms(recipient, c);
 
     } else {
-        const Coordinate roomPos = room->getPosition();
-        // REVISIT: Should this enumerate 6 or 7 values?
-        // NOTE: This previously enumerated 8 values instead of 7,
-        // which meant it was asking for exitDir(ExitDirEnum::NONE),
-        // even though both ExitDirEnum::UNKNOWN and ExitDirEnum::NONE
-        // both have Coordinate(0, 0, 0).
-        for (const auto dir : ALL_EXITS7) {
-            emit lookingForRooms(recipient, roomPos + Room::exitDir(dir));
-        }
+        // The room itself plus its six unit neighbours, i.e. the exitDir() of
+        // each of ALL_EXITS7, is exactly the set within Manhattan distance 1.
+        emit lookingForRoomsNear(recipient, room->getPosition(), 1, event.getPromptFlags());
     }
 }
 
@@ -160,13 +179,17 @@ void PathMachine::approved(const SigParseEvent &sigParseEvent)
 {
     ParseEvent &event = sigParseEvent.deref();
 
-    Approved appr(sigParseEvent, params.matchingTolerance);
+    Approved appr(sigParseEvent, params.matchingTolerance, compareCache);
     const Room *perhaps = nullptr;
 
     if (event.getMoveType() == CommandEnum::LOOK) {
         emit lookingForRooms(appr, getMostLikelyRoomId());
 
     } else {
+        // NOTE: There's no point in prefetching candidates for prespammed moves:
+        // the exit lookup below is already a direct RoomId lookup, the room side
+        // of the comparison is precomputed when the room changes, and the rest
+        // depends on the event we haven't received yet.
         tryExits(getMostLikelyRoom(), appr, event, true);
     }
 
@@ -213,6 +236,8 @@ void PathMachine::approved(const SigParseEvent &sigParseEvent)
         }
     }
 
+    m_step.candidates += appr.getNumCandidates();
+
     if (perhaps == nullptr) {
         // couldn't match, give up
         state = PathStateEnum::EXPERIMENTING;
@@ -285,11 +310,26 @@ void PathMachine::approved(const SigParseEvent &sigParseEvent)
 void PathMachine::syncing(const SigParseEvent &sigParseEvent)
 {
     ParseEvent &event = sigParseEvent.deref();
+    if (isDirection7(event.getMoveType())) {
+        ++m_syncMoves;
+    }
     {
         Syncing sync(params, paths, &signaler);
         if (event.getNumSkipped() <= params.maxSkipped) {
-            emit lookingForRooms(sync, sigParseEvent);
+            if (params.nearbySyncRadius > 0 && hasMostLikelyRoom()) {
+                emit lookingForNearbyRooms(sync,
+                                           sigParseEvent,
+                                           getMostLikelyRoomPosition(),
+                                           params.nearbySyncRadius + m_syncMoves);
+            } else {
+                emit lookingForRooms(sync, sigParseEvent);
+            }
+            // MUME may have changed the description since the room was mapped.
+            if (sync.getNumCandidates() == 0 && !event.getStaticDesc().isEmpty()) {
+                emit lookingForSimilarRooms(sync, sigParseEvent, params.matchingTolerance);
+            }
         }
+        m_step.candidates += sync.getNumCandidates();
         paths = sync.evaluate();
     }
     evaluatePaths();
@@ -321,7 +361,10 @@ void PathMachine::experimenting(const SigParseEvent &sigParseEvent)
         }
         emit lookingForRooms(*exp, sigParseEvent);
     } else {
-        auto pOneByOne = std::make_unique<OneByOne>(sigParseEvent, params, &signaler);
+        auto pOneByOne = std::make_unique<OneByOne>(sigParseEvent,
+                                                     params,
+                                                     &signaler,
+                                                     compareCache);
         {
             auto &tmp = *pOneByOne;
             for (auto &path : *paths) {
@@ -335,6 +378,8 @@ void PathMachine::experimenting(const SigParseEvent &sigParseEvent)
         exp = static_upcast<Experimenting>(std::exchange(pOneByOne, nullptr));
     }
 
+    m_step.candidates += exp->getNumCandidates();
+    m_step.forks += exp->getNumForks();
     paths = exp->evaluate();
     evaluatePaths();
 }
@@ -344,6 +389,7 @@ void PathMachine::evaluatePaths()
     if (paths->empty()) {
         state = PathStateEnum::SYNCING;
     } else {
+        m_syncMoves = 0;
         if (const Room *const room = (paths->front()->getRoom()))
             setMostLikelyRoom(*room);
         else
@@ -363,9 +409,17 @@ void PathMachine::evaluatePaths()
 
 void PathMachine::scheduleAction(const std::shared_ptr<MapAction> &action)
 {
+    // The action may modify rooms we've already compared.
+    compareCache.reset();
     emit sig_scheduleAction(action);
 }
 
+void PathMachine::scheduleActions(const std::vector<std::shared_ptr<MapAction>> &actions)
+{
+    compareCache.reset();
+    emit sig_scheduleActions(actions);
+}
+
 const Room *PathMachine::getPathRoot() const
 {
     return m_mapData.getRoom(m_pathRootPos.value_or(Coordinate{}));
@@ -376,6 +430,16 @@ const Room *PathMachine::getMostLikelyRoom() const
     return m_mapData.getRoom(m_mostLikelyRoomPos.value_or(Coordinate{}));
 }
 
+std::vector<std::pair<RoomId, double>> PathMachine::getPathSummary() const
+{
+    std::vector<std::pair<RoomId, double>> result;
+    for (const auto &path : *paths) {
+        const Room *const room = path->getRoom();
+        result.emplace_back((room == nullptr) ? INVALID_ROOMID : room->getId(), path->getProb());
+    }
+    return result;
+}
+
 RoomId PathMachine::getMostLikelyRoomId() const
 {
     if (const Room *const room = getMostLikelyRoom())
@@ -8,13 +8,18 @@
 #include <list>
 #include <memory>
 #include <optional>
+#include <utility>
+#include <vector>
 #include <QString>
 #include <QtCore>
 
 #include "../expandoracommon/parseevent.h"
 #include "../expandoracommon/room.h"
+#include "../global/macros.h"
 #include "path.h"
+#include "pathmachinestats.h"
 #include "pathparameters.h"
+#include "roomcomparecache.h"
 #include "roomsignalhandler.h"
 
 class Approved;
@@ -43,21 +48,37 @@ public slots:
     virtual void releaseAllPaths();
     virtual void setCurrentRoom(RoomId id, bool update);
     void slot_scheduleAction(const std::shared_ptr<MapAction> &action) { scheduleAction(action); }
+    void slot_scheduleActions(const std::vector<std::shared_ptr<MapAction>> &actions)
+    {
+        scheduleActions(actions);
+    }
 
 signals:
     void lookingForRooms(RoomRecipient &, const SigParseEvent &);
     void lookingForRooms(RoomRecipient &, RoomId);
     void lookingForRooms(RoomRecipient &, const Coordinate &);
+    void lookingForNearbyRooms(RoomRecipient &, const SigParseEvent &, const Coordinate &, int);
+    void lookingForRoomsNear(RoomRecipient &, const Coordinate &, int, PromptFlagsType);
+    void lookingForSimilarRooms(RoomRecipient &, const SigParseEvent &, int);
     void playerMoved(const Coordinate &);
     void createRoom(const SigParseEvent &, const Coordinate &);
     void sig_scheduleAction(std::shared_ptr<MapAction>);
+    void sig_scheduleActions(std::vector<std::shared_ptr<MapAction>>);
+    // Sent when the machine gets back to APPROVED, once the paths' rooms are released.
+    void sig_sweepTemporaryRooms();
     void setCharPosition(RoomId id);
 
 public:
     explicit PathMachine(MapData *mapData, QObject *parent);
 
+public:
+    void setPruneForks(const bool prune) { params.pruneForks = prune; }
+    /// The room and probability of each path that's still considered, in order.
+    NODISCARD std::vector<std::pair<RoomId, double>> getPathSummary() const;
+
 private:
     void scheduleAction(const std::shared_ptr<MapAction> &action);
+    void scheduleActions(const std::vector<std::shared_ptr<MapAction>> &actions);
 
 protected:
     PathParameters params;
@@ -76,10 +97,16 @@ public slots:
     SigParseEvent lastEvent;
     PathStateEnum state = PathStateEnum::SYNCING;
     std::shared_ptr<PathList> paths;
+    // Only valid for the event currently being processed.
+    RoomCompareCache compareCache;
 
 private:
     std::optional<Coordinate> m_pathRootPos;
     std::optional<Coordinate> m_mostLikelyRoomPos;
+    // Moves made since syncing began; widens the nearby sync radius.
+    int m_syncMoves = 0;
+    // Counters for the event currently being processed.
+    PathMachineStats::Step m_step;
 
 private:
     void clearMostLikelyRoom() { m_mostLikelyRoomPos.reset(); }
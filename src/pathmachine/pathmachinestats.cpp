@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "pathmachinestats.h"
+
+#include <algorithm>
+#include <QStringList>
+
+#include "pathmachine.h"
+
+static_assert(static_cast<size_t>(PathStateEnum::SYNCING) + 1 == PathMachineStats::NUM_STATES);
+
+static const char *getStateName(const size_t i)
+{
+    switch (static_cast<PathStateEnum>(i)) {
+    case PathStateEnum::APPROVED:
+        return "approved";
+    case PathStateEnum::EXPERIMENTING:
+        return "experimenting";
+    case PathStateEnum::SYNCING:
+        return "syncing";
+    }
+    return "unknown";
+}
+
+static double toMicros(const std::chrono::nanoseconds ns)
+{
+    return static_cast<double>(ns.count()) / 1000.0;
+}
+
+size_t PathMachineStats::getLatencyBucket(const std::chrono::nanoseconds elapsed)
+{
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    size_t bucket = 0;
+    for (auto i = micros; i > 0 && bucket + 1 < NUM_LATENCY_BUCKETS; i >>= 1) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+void PathMachineStats::record(const PathStateEnum state, const Step &step)
+{
+    const auto index = static_cast<size_t>(state);
+    const size_t bucket = getLatencyBucket(step.elapsed);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    auto &s = m_states.at(index);
+    ++s.events;
+    s.candidates += step.candidates;
+    s.forks += step.forks;
+    s.maxPaths = std::max(s.maxPaths, step.paths);
+    s.totalTime += step.elapsed;
+    s.maxTime = std::max(s.maxTime, step.elapsed);
+    s.lockWait += step.lockWait;
+    ++s.latency[bucket];
+    ++m_totalEvents;
+}
+
+void PathMachineStats::reset()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_states = {};
+    m_totalEvents = 0;
+}
+
+bool PathMachineStats::isLogging() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_logging;
+}
+
+void PathMachineStats::setLogging(const bool enabled)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_logging = enabled;
+}
+
+std::array<PathMachineStats::StateStats, PathMachineStats::NUM_STATES>
+PathMachineStats::getSnapshot() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_states;
+}
+
+uint64_t PathMachineStats::getTotalEvents() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_totalEvents;
+}
+
+QString PathMachineStats::toReport() const
+{
+    const auto states = getSnapshot();
+
+    QString result;
+    for (size_t i = 0; i < NUM_STATES; ++i) {
+        const StateStats &s = states[i];
+        result += QString("%1: %2 events").arg(getStateName(i)).arg(s.events);
+        if (s.events == 0) {
+            result += "\r\n";
+            continue;
+        }
+
+        const auto n = static_cast<double>(s.events);
+        result += QString(", avg %1 us, max %2 us, map lock wait %3 us total\r\n")
+                      .arg(toMicros(s.totalTime) / n, 0, 'f', 1)
+                      .arg(toMicros(s.maxTime), 0, 'f', 1)
+                      .arg(toMicros(s.lockWait), 0, 'f', 1);
+        result += QString("  candidates %1/event, forks %2/event, max paths %3\r\n")
+                      .arg(static_cast<double>(s.candidates) / n, 0, 'f', 1)
+                      .arg(static_cast<double>(s.forks) / n, 0, 'f', 1)
+                      .arg(s.maxPaths);
+
+        result += "  latency:";
+        for (size_t b = 0; b < NUM_LATENCY_BUCKETS; ++b) {
+            if (s.latency[b] == 0)
+                continue;
+            const bool last = b + 1 == NUM_LATENCY_BUCKETS;
+            result += QString(" %1%2us:%3")
+                          .arg(last ? ">=" : "<")
+                          .arg(uint64_t{1} << (last ? b - 1 : b))
+                          .arg(s.latency[b]);
+        }
+        result += "\r\n";
+    }
+    return result;
+}
+
+QString PathMachineStats::toSummaryLine() const
+{
+    const auto states = getSnapshot();
+
+    QStringList parts;
+    for (size_t i = 0; i < NUM_STATES; ++i) {
+        const StateStats &s = states[i];
+        if (s.events == 0)
+            continue;
+        const auto n = static_cast<double>(s.events);
+        parts << QString("%1 %2 events avg %3 us max %4 us")
+                     .arg(getStateName(i))
+                     .arg(s.events)
+                     .arg(toMicros(s.totalTime) / n, 0, 'f', 1)
+                     .arg(toMicros(s.maxTime), 0, 'f', 1);
+    }
+    return parts.join("; ");
+}
+
+PathMachineStats &getPathMachineStats()
+{
+    static PathMachineStats stats;
+    return stats;
+}
@@ -0,0 +1,77 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <QString>
+
+#include "../global/RuleOf5.h"
+
+enum class PathStateEnum;
+
+/// Counters for PathMachine::event(), broken down by the state the path
+/// machine was in when the event arrived. Recording costs one uncontended
+/// mutex per event, so this is always on.
+class PathMachineStats final
+{
+public:
+    static constexpr const size_t NUM_STATES = 3;
+    /// Bucket 0 counts events that took less than 1 us, and bucket i counts
+    /// [2^(i-1), 2^i) us; the last bucket also counts everything slower.
+    static constexpr const size_t NUM_LATENCY_BUCKETS = 20;
+
+    struct Step final
+    {
+        std::chrono::nanoseconds elapsed{};
+        std::chrono::nanoseconds lockWait{};
+        uint64_t candidates = 0;
+        uint64_t forks = 0;
+        uint64_t paths = 0;
+    };
+
+    struct StateStats final
+    {
+        uint64_t events = 0;
+        uint64_t candidates = 0;
+        uint64_t forks = 0;
+        uint64_t maxPaths = 0;
+        std::chrono::nanoseconds totalTime{};
+        std::chrono::nanoseconds maxTime{};
+        std::chrono::nanoseconds lockWait{};
+        std::array<uint64_t, NUM_LATENCY_BUCKETS> latency{};
+    };
+
+private:
+    mutable std::mutex m_mutex;
+    std::array<StateStats, NUM_STATES> m_states{};
+    uint64_t m_totalEvents = 0;
+    bool m_logging = false;
+
+public:
+    PathMachineStats() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(PathMachineStats);
+
+public:
+    void record(PathStateEnum state, const Step &step);
+    void reset();
+    /// Whether Mmapper2PathMachine logs a summary line every so often.
+    bool isLogging() const;
+    void setLogging(bool enabled);
+
+public:
+    std::array<StateStats, NUM_STATES> getSnapshot() const;
+    uint64_t getTotalEvents() const;
+    /// Multi-line report, using "\r\n" line endings for the MUD client.
+    QString toReport() const;
+    /// One-line summary for the log window.
+    QString toSummaryLine() const;
+
+public:
+    static size_t getLatencyBucket(std::chrono::nanoseconds elapsed);
+};
+
+PathMachineStats &getPathMachineStats();
@@ -15,4 +15,10 @@ struct PathParameters
     double maxPaths = 500.0;
     int matchingTolerance = 5;
     uint maxSkipped = 1;
+    // When positive, syncing first looks for matches near the last known
+    // position; the radius grows by one for each move made while syncing.
+    int nearbySyncRadius = 0;
+    // Lets Experimenting drop hopeless forks as soon as they're certain to lose;
+    // only turned off to check that this doesn't change which paths survive.
+    bool pruneForks = true;
 };
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "roomcomparecache.h"
+
+#include "../expandoracommon/parseevent.h"
+
+ComparisonResultEnum RoomCompareCache::compare(const Room *const room,
+                                               const ParseEvent &event,
+                                               const int tolerance)
+{
+    if (m_event != &event || m_tolerance != tolerance) {
+        reset();
+        m_event = &event;
+        m_tolerance = tolerance;
+    }
+
+    const RoomId id = room->getId();
+    if (id == INVALID_ROOMID)
+        return Room::compare(room, event, tolerance);
+
+    auto it = m_results.find(id);
+    if (it != m_results.end() && it->second.room == room)
+        return it->second.result;
+
+    const auto result = Room::compare(room, event, tolerance);
+    m_results[id] = Entry{room, result};
+    return result;
+}
+
+void RoomCompareCache::reset()
+{
+    m_event = nullptr;
+    m_results.clear();
+}
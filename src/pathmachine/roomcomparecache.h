@@ -0,0 +1,41 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <unordered_map>
+
+#include "../expandoracommon/room.h"
+#include "../global/RuleOf5.h"
+#include "../global/roomid.h"
+
+class ParseEvent;
+
+/**
+ * Memoizes Room::compare() against a single parse event.
+ *
+ * The same room is usually offered several times per event (once per path
+ * via each exit direction and by coordinate, and again after releaseMatch()),
+ * so the path machine keeps one of these and resets it whenever a new event
+ * arrives or it schedules an action that could modify a room.
+ */
+class RoomCompareCache final
+{
+private:
+    struct Entry final
+    {
+        const Room *room = nullptr;
+        ComparisonResultEnum result = ComparisonResultEnum::DIFFERENT;
+    };
+
+    const ParseEvent *m_event = nullptr;
+    int m_tolerance = 0;
+    std::unordered_map<RoomId, Entry> m_results;
+
+public:
+    RoomCompareCache() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(RoomCompareCache);
+
+public:
+    ComparisonResultEnum compare(const Room *room, const ParseEvent &event, int tolerance);
+    void reset();
+};
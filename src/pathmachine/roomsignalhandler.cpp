@@ -7,12 +7,69 @@
 
 #include <cassert>
 #include <memory>
+#include <utility>
 
 #include "../expandoracommon/RoomAdmin.h"
 #include "../expandoracommon/room.h"
 #include "../global/roomid.h"
 #include "../mapfrontend/mapaction.h"
 
+RoomSignalHandler::Batch::Batch(RoomSignalHandler &handler)
+    : m_handler{handler}
+{
+    ++m_handler.m_batchDepth;
+}
+
+RoomSignalHandler::Batch::~Batch()
+{
+    assert(m_handler.m_batchDepth > 0);
+    if (--m_handler.m_batchDepth == 0) {
+        m_handler.settle();
+    }
+}
+
+void RoomSignalHandler::settle()
+{
+    if (!m_pendingActions.empty()) {
+        emit sig_scheduleActions(std::exchange(m_pendingActions, {}));
+    }
+
+    // The map only keeps one lock per recipient, so a room that the same locker
+    // has held again since must not be given back.
+    const auto pending = std::exchange(m_pendingReleases, {});
+    std::vector<std::pair<RoomRecipient *, RoomId>> toRelease;
+    for (size_t i = 0, size = pending.size(); i < size; ++i) {
+        const PendingRelease &p = pending[i];
+        const auto it = lockers.find(p.room);
+        if (it == lockers.end() || it->second.count(p.locker) == 0) {
+            toRelease.emplace_back(p.locker, p.id);
+        }
+        if (i + 1 == size || pending[i + 1].owner != p.owner) {
+            p.owner->releaseRooms(toRelease);
+            toRelease.clear();
+        }
+    }
+}
+
+void RoomSignalHandler::releaseLock(const Room *const room,
+                                    RoomAdmin &owner,
+                                    RoomRecipient &locker)
+{
+    if (m_batchDepth == 0) {
+        owner.releaseRoom(locker, room->getId());
+    } else {
+        m_pendingReleases.emplace_back(PendingRelease{room, room->getId(), &owner, &locker});
+    }
+}
+
+void RoomSignalHandler::scheduleAction(const std::shared_ptr<MapAction> &action)
+{
+    m_pendingActions.emplace_back(action);
+    if (m_batchDepth == 0) {
+        emit sig_scheduleActions(std::exchange(m_pendingActions, {}));
+    }
+}
+
 void RoomSignalHandler::hold(const Room *const room,
                              RoomAdmin *const owner,
                              RoomRecipient *const locker)
@@ -32,7 +89,7 @@ void RoomSignalHandler::release(const Room *const room)
         if (RoomAdmin *const rcv = owners[room]) {
             for (auto i = lockers[room].begin(); i != lockers[room].end(); ++i) {
                 if (RoomRecipient *const recipient = *i) {
-                    rcv->releaseRoom(*recipient, room->getId());
+                    releaseLock(room, *rcv, *recipient);
                 }
             }
         } else {
@@ -51,7 +108,7 @@ void RoomSignalHandler::keep(const Room *const room, const ExitDirEnum dir, cons
 
     RoomAdmin *const rcv = owners[room];
     if (static_cast<uint32_t>(dir) < NUM_EXITS) {
-        emit sig_scheduleAction(std::make_shared<AddExit>(fromId, room->getId(), dir));
+        scheduleAction(std::make_shared<AddExit>(fromId, room->getId(), dir));
     }
 
     if (!lockers[room].empty()) {
@@ -7,10 +7,12 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 #include <QObject>
 #include <QString>
 #include <QtCore>
 
+#include "../global/RuleOf5.h"
 #include "../global/roomid.h"
 #include "../mapdata/ExitDirection.h"
 #include "../mapdata/mmapper2exit.h"
@@ -29,6 +31,34 @@ class RoomSignalHandler : public QObject
     std::map<const Room *, std::set<RoomRecipient *>> lockers{};
     std::map<const Room *, int> holdCount{};
 
+    // While a Batch is alive, the locks to give back and the actions to schedule
+    // wait here, so the map is only locked once for each when it ends.
+    struct PendingRelease final
+    {
+        const Room *room = nullptr;
+        RoomId id = INVALID_ROOMID;
+        RoomAdmin *owner = nullptr;
+        RoomRecipient *locker = nullptr;
+    };
+    std::vector<PendingRelease> m_pendingReleases;
+    std::vector<std::shared_ptr<MapAction>> m_pendingActions;
+    int m_batchDepth = 0;
+
+public:
+    // Defers the owners' releaseRoom() calls and the exit actions from keep()
+    // until the outermost batch ends (e.g. one PathMachine::event()). Rooms that
+    // are released and then held again in the meantime are never given back.
+    class Batch final
+    {
+    private:
+        RoomSignalHandler &m_handler;
+
+    public:
+        explicit Batch(RoomSignalHandler &handler);
+        ~Batch();
+        DELETE_CTORS_AND_ASSIGN_OPS(Batch);
+    };
+
 public:
     RoomSignalHandler() = delete;
     explicit RoomSignalHandler(QObject *parent)
@@ -50,6 +80,11 @@ class RoomSignalHandler : public QObject
 
     auto getNumLockers(const Room *room) { return lockers[room].size(); }
 
+private:
+    void releaseLock(const Room *room, RoomAdmin &owner, RoomRecipient &locker);
+    void scheduleAction(const std::shared_ptr<MapAction> &action);
+    void settle();
+
 signals:
-    void sig_scheduleAction(std::shared_ptr<MapAction>);
+    void sig_scheduleActions(std::vector<std::shared_ptr<MapAction>>);
 };
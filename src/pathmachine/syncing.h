@@ -33,6 +33,7 @@ class Syncing : public RoomRecipient
                      RoomSignalHandler *signaler);
     void receiveRoom(RoomAdmin *, const Room *) override;
     std::shared_ptr<PathList> evaluate();
+    uint getNumCandidates() const { return numPaths; }
     ~Syncing() override;
 
 public:
@@ -183,6 +183,10 @@ AdvancedGraphicsGroupBox::AdvancedGraphicsGroupBox(QGroupBox &groupBox)
     checkboxDiag->setChecked(MapCanvasConfig::getShowPerfStats());
     vertical->addWidget(checkboxDiag);
 
+    auto *const adaptiveQuality = new QCheckBox("Lower quality while drawing is slow");
+    adaptiveQuality->setChecked(MapCanvasConfig::isAdaptiveQuality());
+    vertical->addWidget(adaptiveQuality);
+
     auto *const checkbox3d = new QCheckBox("3d Mode");
     const bool is3dAtInit = MapCanvasConfig::isIn3dMode();
     checkbox3d->setChecked(is3dAtInit);
@@ -226,15 +230,22 @@ AdvancedGraphicsGroupBox::AdvancedGraphicsGroupBox(QGroupBox &groupBox)
         graphicsSettingsChanged();
     });
 
+    connect(adaptiveQuality, &QCheckBox::stateChanged, this, [this, adaptiveQuality](int) {
+        MapCanvasConfig::setAdaptiveQuality(adaptiveQuality->isChecked());
+        graphicsSettingsChanged();
+    });
+
     m_connections = MapCanvasConfig::registerChangeCallback(
-        [this, checkboxDiag, checkbox3d, autoTilt]() -> void {
+        [this, checkboxDiag, adaptiveQuality, checkbox3d, autoTilt]() -> void {
             SignalBlocker sb1{*checkboxDiag};
             SignalBlocker sb2{*checkbox3d};
             SignalBlocker sb3{*autoTilt};
+            SignalBlocker sb4{*adaptiveQuality};
             for (auto &ssb : m_ssbs) {
                 ssb->forcedUpdate();
             }
             checkboxDiag->setChecked(MapCanvasConfig::getShowPerfStats());
+            adaptiveQuality->setChecked(MapCanvasConfig::isAdaptiveQuality());
             checkbox3d->setChecked(MapCanvasConfig::isIn3dMode());
             autoTilt->setChecked(MapCanvasConfig::isAutoTilt());
         });
@@ -10,6 +10,7 @@
 #include <QListWidget>
 #include <QtWidgets>
 
+#include "../configuration/configuration.h"
 #include "clientpage.h"
 #include "generalpage.h"
 #include "graphicspage.h"
@@ -70,6 +71,9 @@ ConfigDialog::ConfigDialog(Mmapper2Group *gm, QWidget *parent)
             &GraphicsPage::sig_graphicsSettingsChanged,
             this,
             &ConfigDialog::sig_graphicsSettingsChanged);
+
+    // The pages change the settings as they're edited; save them once the dialog is closed.
+    connect(this, &QDialog::finished, this, []() { getConfig().writeLater(); });
 }
 
 ConfigDialog::~ConfigDialog()
@@ -69,6 +69,12 @@ GeneralPage::GeneralPage(QWidget *parent)
     connect(ui->checkForUpdateCheckBox, &QCheckBox::stateChanged, this, [this]() {
         setConfig().general.checkForUpdate = ui->checkForUpdateCheckBox->isChecked();
     });
+    connect(ui->compressMapFilesCheckBox, &QCheckBox::stateChanged, this, [this]() {
+        setConfig().general.compressMapFiles = ui->compressMapFilesCheckBox->isChecked();
+    });
+    connect(ui->loadRoomTextOnDemandCheckBox, &QCheckBox::stateChanged, this, [this]() {
+        setConfig().general.loadRoomTextOnDemand = ui->loadRoomTextOnDemandCheckBox->isChecked();
+    });
     connect(ui->autoLoadFileName,
             &QLineEdit::textChanged,
             this,
@@ -141,6 +147,8 @@ void GeneralPage::loadConfig()
     ui->autoStartGroupManagerCheckBox->setChecked(config.groupManager.autoStart);
     ui->checkForUpdateCheckBox->setChecked(config.general.checkForUpdate);
     ui->checkForUpdateCheckBox->setDisabled(NO_UPDATER);
+    ui->compressMapFilesCheckBox->setChecked(config.general.compressMapFiles);
+    ui->loadRoomTextOnDemandCheckBox->setChecked(config.general.loadRoomTextOnDemand);
     ui->autoLoadFileName->setText(autoLoad.fileName);
     ui->autoLoadCheck->setChecked(autoLoad.autoLoadMap);
     ui->autoLoadFileName->setEnabled(autoLoad.autoLoadMap);
@@ -190,16 +198,19 @@ void GeneralPage::tlsEncryptionCheckBoxStateChanged(int /*unused*/)
 void GeneralPage::emulatedExitsStateChanged(int /*unused*/)
 {
     setConfig().mumeNative.emulatedExits = ui->emulatedExitsCheckBox->isChecked();
+    getConfig().publishProxySnapshot();
 }
 
 void GeneralPage::showHiddenExitFlagsStateChanged(int /*unused*/)
 {
     setConfig().mumeNative.showHiddenExitFlags = ui->showHiddenExitFlagsCheckBox->isChecked();
+    getConfig().publishProxySnapshot();
 }
 
 void GeneralPage::showNotesStateChanged(int /*unused*/)
 {
     setConfig().mumeNative.showNotes = ui->showNotesCheckBox->isChecked();
+    getConfig().publishProxySnapshot();
 }
 
 void GeneralPage::autoLoadFileNameTextChanged(const QString & /*unused*/)
@@ -89,6 +89,13 @@ GroupManagerPage::GroupManagerPage(Mmapper2Group *gm, QWidget *parent)
     connect(ui->lockGroupCheckBox, &QCheckBox::stateChanged, this, [this]() {
         setConfig().groupManager.lockGroup = ui->lockGroupCheckBox->isChecked();
     });
+    connect(ui->shareMapCheckBox, &QCheckBox::stateChanged, this, [this]() {
+        setConfig().groupManager.shareMap = ui->shareMapCheckBox->isChecked();
+        ui->shareMapNotesCheckBox->setEnabled(ui->shareMapCheckBox->isChecked());
+    });
+    connect(ui->shareMapNotesCheckBox, &QCheckBox::stateChanged, this, [this]() {
+        setConfig().groupManager.shareMapNotes = ui->shareMapNotesCheckBox->isChecked();
+    });
 
     connect(ui->remoteHost,
             &QComboBox::editTextChanged,
@@ -146,6 +153,9 @@ void GroupManagerPage::loadConfig()
     ui->localPort->setValue(settings.localPort);
     ui->shareSelfCheckBox->setChecked(settings.shareSelf);
     ui->lockGroupCheckBox->setChecked(settings.lockGroup);
+    ui->shareMapCheckBox->setChecked(settings.shareMap);
+    ui->shareMapNotesCheckBox->setChecked(settings.shareMapNotes);
+    ui->shareMapNotesCheckBox->setEnabled(settings.shareMap);
 
     // Client Section
     loadRemoteHostConfig();
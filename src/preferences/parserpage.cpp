@@ -57,6 +57,7 @@ ParserPage::ParserPage(QWidget *const parent)
 
     connect(charPrefixLineEdit, &QLineEdit::editingFinished, this, [this]() {
         setConfig().parser.prefixChar = charPrefixLineEdit->text().at(0).toLatin1();
+        getConfig().publishProxySnapshot();
     });
 
     connect(removeEndDescPattern,
@@ -105,6 +106,7 @@ void ParserPage::roomNameColorClicked()
     QString ansiString = AnsiColorDialog::getColor(getConfig().parser.roomNameColor, this);
     AnsiCombo::makeWidgetColoured(roomNameColorLabel, ansiString);
     setConfig().parser.roomNameColor = ansiString;
+    getConfig().publishProxySnapshot();
 }
 
 void ParserPage::roomDescColorClicked()
@@ -112,11 +114,13 @@ void ParserPage::roomDescColorClicked()
     QString ansiString = AnsiColorDialog::getColor(getConfig().parser.roomDescColor, this);
     AnsiCombo::makeWidgetColoured(roomDescColorLabel, ansiString);
     setConfig().parser.roomDescColor = ansiString;
+    getConfig().publishProxySnapshot();
 }
 
 void ParserPage::suppressXmlTagsCheckBoxStateChanged(int /*unused*/)
 {
     setConfig().parser.removeXmlTags = suppressXmlTagsCheckBox->isChecked();
+    getConfig().publishProxySnapshot();
 }
 
 void ParserPage::savePatterns()
@@ -133,6 +137,7 @@ void ParserPage::savePatterns()
 
     auto &settings = setConfig().parser;
     settings.noDescriptionPatternsList = save(endDescPatternsList);
+    getConfig().publishProxySnapshot();
 }
 
 void ParserPage::removeEndDescPatternClicked()
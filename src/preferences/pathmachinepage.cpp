@@ -40,6 +40,10 @@ PathmachinePage::PathmachinePage(QWidget *parent)
             SIGNAL(valueChanged(int)),
             this,
             SLOT(matchingToleranceSpinBoxValueChanged(int)));
+    connect(nearbySyncRadiusSpinBox,
+            SIGNAL(valueChanged(int)),
+            this,
+            SLOT(nearbySyncRadiusSpinBoxValueChanged(int)));
 }
 
 void PathmachinePage::loadConfig()
@@ -52,6 +56,7 @@ void PathmachinePage::loadConfig()
     maxPaths->setValue(settings.maxPaths);
     matchingToleranceSpinBox->setValue(settings.matchingTolerance);
     multipleConnectionsPenaltyDoubleSpinBox->setValue(settings.multipleConnectionsPenalty);
+    nearbySyncRadiusSpinBox->setValue(settings.nearbySyncRadius);
 }
 
 void PathmachinePage::acceptBestRelativeDoubleSpinBoxValueChanged(const double val)
@@ -88,3 +93,8 @@ void PathmachinePage::matchingToleranceSpinBoxValueChanged(const int val)
 {
     setConfig().pathMachine.matchingTolerance = val;
 }
+
+void PathmachinePage::nearbySyncRadiusSpinBoxValueChanged(const int val)
+{
+    setConfig().pathMachine.nearbySyncRadius = val;
+}
@@ -28,4 +28,5 @@ public slots:
     void multipleConnectionsPenaltyDoubleSpinBoxValueChanged(double);
     void maxPathsValueChanged(int);
     void matchingToleranceSpinBoxValueChanged(int);
+    void nearbySyncRadiusSpinBoxValueChanged(int);
 };
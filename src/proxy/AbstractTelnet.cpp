@@ -5,8 +5,11 @@
 
 #include "AbstractTelnet.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <limits>
+#include <string>
 #include <QByteArray>
 #include <QMessageLogContext>
 #include <QObject>
@@ -57,6 +60,7 @@ static QString telnetOptionName(uint8_t opt)
         CASE(NAWS);
         CASE(CHARSET);
         CASE(COMPRESS2);
+        CASE(COMPRESS3);
         CASE(GMCP);
     }
     return QString::asprintf("%u", opt);
@@ -83,11 +87,7 @@ static QString telnetSubnegName(uint8_t opt)
 
 static bool containsIAC(const QByteArray &arr)
 {
-    for (const auto &c : arr) {
-        if (static_cast<uint8_t>(c) == TN_IAC)
-            return true;
-    }
-    return false;
+    return std::memchr(arr.constData(), TN_IAC, static_cast<size_t>(arr.size())) != nullptr;
 }
 
 struct TelnetFormatter final : public AppendBuffer
@@ -156,7 +156,20 @@ AbstractTelnet::AbstractTelnet(TextCodecStrategyEnum strategy,
     reset();
 }
 
+AbstractTelnet::~AbstractTelnet()
+{
+    resetCompress();
+    endCompressingOutput();
+}
+
 void AbstractTelnet::reset()
+{
+    resetNegotiation();
+    resetCompress();
+    endCompressingOutput();
+}
+
+void AbstractTelnet::resetNegotiation()
 {
     myOptionState.fill(false);
     hisOptionState.fill(false);
@@ -171,7 +184,6 @@ void AbstractTelnet::reset()
     subnegBuffer.clear();
     sentBytes = 0;
     recvdGA = false;
-    resetCompress();
 }
 
 void AbstractTelnet::resetGmcpModules()
@@ -485,7 +497,15 @@ void AbstractTelnet::processTelnetCommand(const AppendBuffer &command)
                 sendCharsetRequest(textCodec.supportedEncodings());
                 // REVISIT: RFC 2066 states to queue all subsequent data until ACCEPTED / REJECTED
             } else if (myOptionState[OPT_COMPRESS2] && option == OPT_COMPRESS2 && !NO_ZLIB) {
-                // REVISIT: Start deflating after sending IAC SB COMPRESS2 IAC SE
+                if (!deflateTelnet) {
+                    // Everything after IAC SB COMPRESS2 IAC SE is compressed
+                    TelnetFormatter s;
+                    s.addSubnegBegin(OPT_COMPRESS2);
+                    s.addSubnegEnd();
+                    sendRawData(s);
+                    flushRawData();
+                    startCompressingOutput();
+                }
 
             } else if (myOptionState[OPT_GMCP] && option == OPT_GMCP) {
                 onGmcpEnabled();
@@ -609,13 +629,28 @@ void AbstractTelnet::processTelnetSubnegotiation(const AppendBuffer &payload)
     case OPT_COMPRESS2:
         assert(!NO_ZLIB);
         if (hisOptionState[OPT_COMPRESS2]) {
-            if (debug) {
-                if (inflateTelnet) {
+            if (inflateTelnet) {
+                if (debug)
                     qDebug() << "Compression was already enabled";
-                    break;
-                }
+                break;
+            }
+            if (debug)
                 qDebug() << "Starting compression";
+            recvdCompress = true;
+        }
+        break;
+
+    case OPT_COMPRESS3:
+        // MCCP3: the client compresses what it sends after IAC SB COMPRESS3 IAC SE
+        assert(!NO_ZLIB);
+        if (myOptionState[OPT_COMPRESS3]) {
+            if (inflateTelnet) {
+                if (debug)
+                    qDebug() << "Compression was already enabled";
+                break;
             }
+            if (debug)
+                qDebug() << "Starting compression";
             recvdCompress = true;
         }
         break;
@@ -685,16 +720,52 @@ void AbstractTelnet::onReadInternal(const QByteArray &data)
             continue;
         }
 
+        pos += processTelnetData(data.data() + pos, data.size() - pos, cleanData);
+        if (recvdCompress) {
+            initCompress();
+            recvdCompress = false;
+            // Start inflating at the next position
+        }
+    }
+
+    // some data left to send - do it now!
+    if (!cleanData.isEmpty()) {
+        sendToMapper(cleanData, recvdGA); // without GO-AHEAD
+        cleanData.clear();
+    }
+}
+
+int AbstractTelnet::processTelnetData(const char *const data,
+                                      const int length,
+                                      AppendBuffer &cleanData)
+{
+    int pos = 0;
+    while (pos < length) {
+        // Text and subnegotiation payload only change the state at IAC,
+        // so everything up to the next one is copied at once.
+        if (state == TelnetStateEnum::NORMAL || state == TelnetStateEnum::SUBNEG) {
+            const char *const begin = data + pos;
+            const auto remaining = static_cast<size_t>(length - pos);
+            const auto *const iac = static_cast<const char *>(
+                std::memchr(begin, TN_IAC, remaining));
+            const int span = (iac == nullptr) ? static_cast<int>(remaining)
+                                              : static_cast<int>(iac - begin);
+            if (span > 0) {
+                AppendBuffer &out = (state == TelnetStateEnum::NORMAL) ? cleanData : subnegBuffer;
+                out.QByteArray::append(begin, span);
+                pos += span;
+                continue;
+            }
+        }
+
         // Process character by character
-        const uint8_t c = static_cast<unsigned char>(data.at(pos));
+        const uint8_t c = static_cast<unsigned char>(data[pos]);
         onReadInternal2(cleanData, c);
         pos++;
 
         if (recvdCompress) {
-            initCompress();
-            recvdCompress = false;
-            // Start inflating at the next position
-            continue;
+            // The rest is compressed
+            break;
         }
 
         if (recvdGA) {
@@ -703,12 +774,7 @@ void AbstractTelnet::onReadInternal(const QByteArray &data)
             recvdGA = false;
         }
     }
-
-    // some data left to send - do it now!
-    if (!cleanData.isEmpty()) {
-        sendToMapper(cleanData, recvdGA); // without GO-AHEAD
-        cleanData.clear();
-    }
+    return pos;
 }
 
 /*
@@ -863,8 +929,8 @@ int AbstractTelnet::onReadInternalInflate(const char *data,
 #ifdef MMAPPER_NO_ZLIB
     abort();
 #else
-    static constexpr const int CHUNK = 1024;
-    char out[CHUNK];
+    const int CHUNK = static_cast<int>(inflateBuffer.size());
+    char *const out = inflateBuffer.data();
 
     stream.avail_in = static_cast<uInt>(length);
     stream.next_in = reinterpret_cast<const Bytef *>(data);
@@ -881,26 +947,20 @@ int AbstractTelnet::onReadInternalInflate(const char *data,
         case Z_MEM_ERROR:
         case Z_STREAM_END:
             /* clean up and return */
-            inflateEnd(&stream);
+            const std::string msg = (stream.msg != nullptr) ? stream.msg : "end of stream";
             resetCompress();
             if (debug)
                 qDebug() << "Ending compression";
-            throw std::runtime_error(stream.msg);
+            throw std::runtime_error(msg);
         default:
             break;
         }
 
         const int outLen = CHUNK - static_cast<int>(stream.avail_out);
-        for (auto i = 0; i < outLen; i++) {
-            // Process character by character
-            const uint8_t c = static_cast<unsigned char>(out[i]);
-            onReadInternal2(cleanData, c);
-
-            if (recvdGA) {
-                sendToMapper(cleanData, recvdGA); // with GO-AHEAD
-                cleanData.clear();
-                recvdGA = false;
-            }
+        for (int i = 0; i < outLen;) {
+            i += processTelnetData(out + i, outLen - i, cleanData);
+            // compression can't be started again while inflating
+            recvdCompress = false;
         }
 
         if (debug && outLen > 0) {
@@ -917,9 +977,14 @@ int AbstractTelnet::onReadInternalInflate(const char *data,
 
 void AbstractTelnet::resetCompress()
 {
+#ifndef MMAPPER_NO_ZLIB
+    if (inflateTelnet)
+        inflateEnd(&stream);
+#endif
     inflateTelnet = false;
     recvdCompress = false;
     hisOptionState[OPT_COMPRESS2] = false;
+    myOptionState[OPT_COMPRESS3] = false;
 }
 
 void AbstractTelnet::initCompress()
@@ -929,6 +994,12 @@ void AbstractTelnet::initCompress()
 #else
     inflateTelnet = true;
 
+    // MUME sends up to a few KiB per chunk; this is big enough to inflate most of
+    // them in one go, and it's kept for the next time compression starts.
+    static constexpr const size_t INFLATE_BUFFER_SIZE = 16 * 1024;
+    if (inflateBuffer.empty())
+        inflateBuffer.resize(INFLATE_BUFFER_SIZE);
+
     /* allocate inflate state */
     stream.zalloc = Z_NULL;
     stream.zfree = Z_NULL;
@@ -941,3 +1012,65 @@ void AbstractTelnet::initCompress()
     }
 #endif
 }
+
+void AbstractTelnet::startCompressingOutput()
+{
+#ifdef MMAPPER_NO_ZLIB
+    abort();
+#else
+    outStream.zalloc = Z_NULL;
+    outStream.zfree = Z_NULL;
+    outStream.opaque = Z_NULL;
+    int ret = deflateInit(&outStream, Z_DEFAULT_COMPRESSION);
+    if (ret != Z_OK) {
+        throw std::runtime_error("Unable to initialize zlib");
+    }
+    deflateTelnet = true;
+    if (debug)
+        qDebug() << "Starting to compress output";
+#endif
+}
+
+void AbstractTelnet::endCompressingOutput()
+{
+#ifndef MMAPPER_NO_ZLIB
+    if (deflateTelnet)
+        deflateEnd(&outStream);
+#endif
+    deflateTelnet = false;
+}
+
+QByteArray AbstractTelnet::compressOutput(const QByteArray &data)
+{
+#ifdef MMAPPER_NO_ZLIB
+    abort();
+#else
+    assert(deflateTelnet);
+    // deflate() never needs more than this, plus a few bytes for the sync flush
+    static constexpr const int SLACK = 64;
+    const int bound = static_cast<int>(deflateBound(&outStream, static_cast<uLong>(data.size())))
+                      + SLACK;
+
+    QByteArray result;
+    outStream.avail_in = static_cast<uInt>(data.size());
+    outStream.next_in = reinterpret_cast<const Bytef *>(data.data());
+    do {
+        const int used = result.size();
+        result.resize(used + bound);
+        outStream.avail_out = static_cast<uInt>(bound);
+        outStream.next_out = reinterpret_cast<Bytef *>(result.data() + used);
+        // Z_SYNC_FLUSH, because the whole batch has to reach the client now.
+        if (::deflate(&outStream, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+            throw std::runtime_error("Unable to compress");
+        result.resize(used + bound - static_cast<int>(outStream.avail_out));
+    } while (outStream.avail_out == 0);
+
+    if (debug && !data.isEmpty()) {
+        const double compressionRatio = static_cast<double>(data.size())
+                                        / static_cast<double>(std::max(1, result.size()));
+        qDebug() << QString("zlib compression ratio of %1:1")
+                        .arg(QString::number(compressionRatio, 'f', 1));
+    }
+    return result;
+#endif
+}
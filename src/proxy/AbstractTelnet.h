@@ -6,6 +6,7 @@
 
 #include <cassert>
 #include <cstdint>
+#include <vector>
 #include <QByteArray>
 #include <QObject>
 #include <QString>
@@ -47,6 +48,7 @@ static constexpr const uint8_t OPT_TERMINAL_TYPE = 24;
 static constexpr const uint8_t OPT_NAWS = 31;
 static constexpr const uint8_t OPT_CHARSET = 42;
 static constexpr const uint8_t OPT_COMPRESS2 = 86;
+static constexpr const uint8_t OPT_COMPRESS3 = 87;
 static constexpr const uint8_t OPT_GMCP = 201;
 
 // telnet SB suboption types
@@ -92,6 +94,7 @@ class AbstractTelnet : public QObject
                             bool debug = false,
                             QObject *parent = nullptr,
                             const QByteArray &defaultTermType = "unknown");
+    ~AbstractTelnet() override;
 
     QByteArray getTerminalType() const { return termType; }
     /* unused */
@@ -140,10 +143,18 @@ class AbstractTelnet : public QObject
             telnet sequences. */
     virtual void sendRawData(const QByteArray &data) = 0;
 
+    /** Sends whatever sendRawData() has held back, e.g. before the output starts
+        being compressed. */
+    virtual void flushRawData() {}
+
     /** send a telnet option */
     void sendTelnetOption(unsigned char type, unsigned char subnegBuffer);
 
+    /** for a new connection */
     void reset();
+    /** Forgets what was negotiated, but keeps the compression of the stream,
+        which the peer doesn't forget. */
+    void resetNegotiation();
 
     void resetGmcpModules();
 
@@ -151,6 +162,11 @@ class AbstractTelnet : public QObject
 
     void onReadInternal(const QByteArray &);
 
+    /** whether everything sent is compressed (MCCP2) */
+    bool isCompressingOutput() const { return deflateTelnet; }
+    /** Compresses the data and flushes it, so the peer can decompress all of it. */
+    QByteArray compressOutput(const QByteArray &data);
+
     void setTerminalType(const QByteArray &terminalType) { termType = terminalType; }
 
     TextCodec &getTextCodec();
@@ -193,6 +209,10 @@ class AbstractTelnet : public QObject
 private:
     void onReadInternal2(AppendBuffer &, uint8_t);
 
+    /** Runs the data through the state machine until it ends or compression starts;
+        returns how much of the data was consumed. */
+    int processTelnetData(const char *data, int length, AppendBuffer &cleanData);
+
     /** processes a telnet command (IAC ...) */
     void processTelnetCommand(const AppendBuffer &command);
 
@@ -227,11 +247,17 @@ class AbstractTelnet : public QObject
     int onReadInternalInflate(const char *, const int, AppendBuffer &);
     void resetCompress();
     void initCompress();
+    void startCompressingOutput();
+    void endCompressingOutput();
 
 #ifndef MMAPPER_NO_ZLIB
     // REVIST: Refactor this to use PImpl
     z_stream stream;
+    z_stream outStream;
 #endif
+    /** reused for the output of every inflate() call */
+    std::vector<char> inflateBuffer;
     bool inflateTelnet = false;
     bool recvdCompress = false;
+    bool deflateTelnet = false;
 };
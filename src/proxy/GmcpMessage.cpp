@@ -3,8 +3,10 @@
 
 #include "GmcpMessage.h"
 
+#include <algorithm>
 #include <exception>
 #include <sstream>
+#include <string_view>
 
 #include "../global/TextUtils.h"
 #include "GmcpModule.h"
@@ -31,12 +33,21 @@ GmcpMessage::GmcpMessage(const GmcpMessageTypeEnum type)
     , type(type)
 {}
 
-static GmcpMessageTypeEnum toGmcpMessageType(const std::string &str)
+// Compares the package with each normalized name in place, instead of lowercasing a copy.
+static GmcpMessageTypeEnum toGmcpMessageType(const std::string_view &package)
 {
-    const auto lower = ::toLowerLatin1(str);
+    const auto matches = [&package](const std::string_view &normalized) {
+        return package.size() == normalized.size()
+               && std::equal(package.begin(),
+                             package.end(),
+                             normalized.begin(),
+                             [](const char c, const char lower) {
+                                 return ::toLowerLatin1(c) == lower;
+                             });
+    };
 #define X_CASE(UPPER_CASE, CamelCase, normalized, friendly) \
     do { \
-        if (lower.compare(normalized) == 0) \
+        if (matches(normalized)) \
             return GmcpMessageTypeEnum::UPPER_CASE; \
     } while (false);
     X_FOREACH_GMCP_MESSAGE_TYPE(X_CASE)
@@ -66,8 +77,29 @@ GmcpMessage::GmcpMessage(const GmcpMessageTypeEnum type, const std::string &json
     , type(type)
 {}
 
+GmcpMessageName GmcpMessage::getName() const
+{
+    if (raw.isEmpty())
+        return name;
+    return GmcpMessageName{std::string(raw.constData(), static_cast<size_t>(packageLength))};
+}
+
+std::optional<GmcpJson> GmcpMessage::getJson() const
+{
+    if (raw.isEmpty())
+        return json;
+    // <data> is optional
+    if (packageLength == raw.size())
+        return std::nullopt;
+    return GmcpJson{raw.mid(packageLength + 1).toStdString()}; // UTF-8
+}
+
 QByteArray GmcpMessage::toRawBytes() const
 {
+    // A relayed message goes out exactly as it came in.
+    if (!raw.isEmpty())
+        return raw;
+
     std::ostringstream oss;
     oss << name.getStdString();
     if (json)
@@ -77,12 +109,13 @@ QByteArray GmcpMessage::toRawBytes() const
 
 GmcpMessage GmcpMessage::fromRawBytes(const QByteArray &ba)
 {
-    const int pos = ba.indexOf(' ');
     // <data> is optional
-    if (pos == -1)
-        return GmcpMessage(ba.toStdString());
+    const int pos = ba.indexOf(' ');
 
-    const std::string package = ba.mid(0, pos).toStdString(); // Latin-1
-    const std::string json = ba.mid(pos + 1).toStdString();   // UTF-8
-    return GmcpMessage(package, json);
+    GmcpMessage msg;
+    msg.raw = ba;
+    msg.packageLength = (pos == -1) ? ba.size() : pos;
+    msg.type = toGmcpMessageType(
+        std::string_view{ba.constData(), static_cast<size_t>(msg.packageLength)}); // Latin-1
+    return msg;
 }
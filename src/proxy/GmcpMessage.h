@@ -50,6 +50,14 @@ class GmcpMessage final
     GmcpMessageName name;
     std::optional<GmcpJson> json;
     GmcpMessageTypeEnum type = GmcpMessageTypeEnum::UNKNOWN;
+    // A received message keeps its bytes as they came, and the name and the json
+    // are only split from them when they're asked for; most messages are just
+    // relayed, so they're never parsed.
+    QByteArray raw;
+    int packageLength = 0;
+
+private:
+    GmcpMessage() = default;
 
 public:
     explicit GmcpMessage(const std::string &package);
@@ -65,8 +73,8 @@ class GmcpMessage final
 #undef DECL_GETTERS_AND_SETTERS
 
 public:
-    GmcpMessageName getName() const { return name; }
-    std::optional<GmcpJson> getJson() const { return json; }
+    GmcpMessageName getName() const;
+    std::optional<GmcpJson> getJson() const;
 
 public:
     QByteArray toRawBytes() const;
@@ -12,8 +12,10 @@
 
 #include "../configuration/configuration.h"
 #include "../global/TextUtils.h"
+#include "../global/Trace.h"
 #include "../global/Version.h"
 #include "GmcpUtils.h"
+#include "ProxyLatencyStats.h"
 
 static QByteArray addTerminalTypeSuffix(const std::string_view &prefix)
 {
@@ -58,6 +60,8 @@ void MudTelnet::onConnected()
 
 void MudTelnet::onAnalyzeMudStream(const QByteArray &data)
 {
+    MMAPPER_TRACE_SCOPE("MudTelnet::onAnalyzeMudStream");
+    ProxyLatencyStats::StageTimer timer{getProxyLatencyStats(), LatencyStageEnum::TELNET};
     onReadInternal(data);
 }
 
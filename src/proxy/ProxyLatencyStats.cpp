@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "ProxyLatencyStats.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <QStringList>
+
+static_assert(static_cast<size_t>(LatencyStageEnum::TOTAL) + 1 == ProxyLatencyStats::NUM_STAGES);
+
+// The read from the MUD's socket that this thread is handling, if any.
+static thread_local std::optional<ProxyLatencyStats::Clock::time_point> t_packetArrival;
+// The innermost stage that this thread is in, if any.
+static thread_local ProxyLatencyStats::StageTimer *t_currentStage = nullptr;
+
+static const char *getStageName(const size_t i)
+{
+    switch (static_cast<LatencyStageEnum>(i)) {
+    case LatencyStageEnum::TELNET:
+        return "telnet";
+    case LatencyStageEnum::PARSER:
+        return "parser";
+    case LatencyStageEnum::PATH_MACHINE:
+        return "path machine";
+    case LatencyStageEnum::DISPLAY:
+        return "display";
+    case LatencyStageEnum::TOTAL:
+        return "total";
+    }
+    return "unknown";
+}
+
+static double toMicros(const std::chrono::nanoseconds ns)
+{
+    return static_cast<double>(ns.count()) / 1000.0;
+}
+
+ProxyLatencyStats::PacketScope::PacketScope(ProxyLatencyStats &stats)
+    : m_stats{stats}
+    , m_outer{t_packetArrival}
+{
+    const auto now = Clock::now();
+    t_packetArrival = now;
+
+    std::lock_guard<std::mutex> lock{m_stats.m_mutex};
+    if (!m_stats.m_unsentSince.has_value())
+        m_stats.m_unsentSince = now;
+    ++m_stats.m_packets;
+}
+
+ProxyLatencyStats::PacketScope::~PacketScope()
+{
+    t_packetArrival = m_outer;
+}
+
+ProxyLatencyStats::MapEventScope::MapEventScope(ProxyLatencyStats &stats)
+    : m_outer{t_packetArrival}
+{
+    std::lock_guard<std::mutex> lock{stats.m_mutex};
+    auto &queue = stats.m_queuedMapEvents;
+    if (queue.empty()) {
+        // e.g. an event that didn't come from the proxy
+        t_packetArrival.reset();
+        return;
+    }
+    t_packetArrival = queue.front();
+    queue.pop_front();
+}
+
+ProxyLatencyStats::MapEventScope::~MapEventScope()
+{
+    t_packetArrival = m_outer;
+}
+
+ProxyLatencyStats::StageTimer::StageTimer(ProxyLatencyStats &stats, const LatencyStageEnum stage)
+    : m_stats{stats}
+    , m_stage{stage}
+    , m_start{Clock::now()}
+    , m_parent{t_currentStage}
+{
+    t_currentStage = this;
+}
+
+ProxyLatencyStats::StageTimer::~StageTimer()
+{
+    const auto elapsed = Clock::now() - m_start;
+    if (m_parent != nullptr)
+        m_parent->m_children += elapsed;
+    t_currentStage = m_parent;
+    m_stats.record(m_stage, elapsed - m_children);
+}
+
+void ProxyLatencyStats::onSentToUser()
+{
+    const auto now = Clock::now();
+    std::optional<Clock::time_point> since;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        since = std::exchange(m_unsentSince, std::nullopt);
+    }
+    if (since.has_value())
+        record(LatencyStageEnum::TOTAL, now - since.value());
+}
+
+void ProxyLatencyStats::onMapEventQueued()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_queuedMapEvents.emplace_back(t_packetArrival);
+}
+
+void ProxyLatencyStats::onRepaintRequested()
+{
+    if (!t_packetArrival.has_value())
+        return;
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (!m_undisplayedSince.has_value())
+        m_undisplayedSince = t_packetArrival;
+}
+
+void ProxyLatencyStats::onFramePainted()
+{
+    const auto now = Clock::now();
+    std::optional<Clock::time_point> since;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        since = std::exchange(m_undisplayedSince, std::nullopt);
+    }
+    if (since.has_value())
+        record(LatencyStageEnum::DISPLAY, now - since.value());
+}
+
+void ProxyLatencyStats::record(const LatencyStageEnum stage, const Clock::duration elapsed)
+{
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    Samples &s = m_samples.at(static_cast<size_t>(stage));
+    if (s.ns.size() < NUM_SAMPLES) {
+        s.ns.emplace_back(ns);
+    } else {
+        s.ns[s.next] = ns;
+    }
+    s.next = (s.next + 1) % NUM_SAMPLES;
+    ++s.count;
+    s.totalNs += ns;
+}
+
+void ProxyLatencyStats::reset()
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_samples = {};
+    m_unsentSince.reset();
+    m_undisplayedSince.reset();
+    m_packets = 0;
+}
+
+bool ProxyLatencyStats::isLogging() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_logging;
+}
+
+void ProxyLatencyStats::setLogging(const bool enabled)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_logging = enabled;
+}
+
+ProxyLatencyStats::Percentiles ProxyLatencyStats::getPercentiles(
+    const LatencyStageEnum stage) const
+{
+    std::vector<int64_t> ns;
+    Percentiles result;
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        const Samples &s = m_samples.at(static_cast<size_t>(stage));
+        ns = s.ns;
+        result.count = s.count;
+        result.total = std::chrono::nanoseconds{s.totalNs};
+    }
+    if (ns.empty())
+        return result;
+
+    // nearest rank
+    const auto at = [&ns](const double p) -> std::chrono::nanoseconds {
+        const auto rank = static_cast<size_t>(p * static_cast<double>(ns.size() - 1) + 0.5);
+        std::nth_element(ns.begin(), ns.begin() + static_cast<ptrdiff_t>(rank), ns.end());
+        return std::chrono::nanoseconds{ns[rank]};
+    };
+    result.p50 = at(0.50);
+    result.p95 = at(0.95);
+    result.p99 = at(0.99);
+    result.max = std::chrono::nanoseconds{*std::max_element(ns.begin(), ns.end())};
+    return result;
+}
+
+uint64_t ProxyLatencyStats::getTotalPackets() const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_packets;
+}
+
+QString ProxyLatencyStats::toReport() const
+{
+    QString result = QString("%1 reads from MUME; percentiles of the last %2 samples:\r\n")
+                         .arg(getTotalPackets())
+                         .arg(NUM_SAMPLES);
+    for (size_t i = 0; i < NUM_STAGES; ++i) {
+        const Percentiles p = getPercentiles(static_cast<LatencyStageEnum>(i));
+        result += QString("%1: %2 samples").arg(getStageName(i)).arg(p.count);
+        if (p.count == 0) {
+            result += "\r\n";
+            continue;
+        }
+        result += QString(", p50 %1 us, p95 %2 us, p99 %3 us, max %4 us\r\n")
+                      .arg(toMicros(p.p50), 0, 'f', 1)
+                      .arg(toMicros(p.p95), 0, 'f', 1)
+                      .arg(toMicros(p.p99), 0, 'f', 1)
+                      .arg(toMicros(p.max), 0, 'f', 1);
+    }
+    return result;
+}
+
+QString ProxyLatencyStats::toSummaryLine() const
+{
+    QStringList parts;
+    for (size_t i = 0; i < NUM_STAGES; ++i) {
+        const Percentiles p = getPercentiles(static_cast<LatencyStageEnum>(i));
+        if (p.count == 0)
+            continue;
+        parts << QString("%1 p50 %2 us p99 %3 us")
+                     .arg(getStageName(i))
+                     .arg(toMicros(p.p50), 0, 'f', 1)
+                     .arg(toMicros(p.p99), 0, 'f', 1);
+    }
+    return parts.join("; ");
+}
+
+ProxyLatencyStats &getProxyLatencyStats()
+{
+    static ProxyLatencyStats stats;
+    return stats;
+}
@@ -0,0 +1,140 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <vector>
+#include <QString>
+
+#include "../global/RuleOf5.h"
+#include "../global/macros.h"
+
+enum class LatencyStageEnum { TELNET, PARSER, PATH_MACHINE, DISPLAY, TOTAL };
+
+/// Rolling latency percentiles for MUD output on its way through MMapper.
+///
+/// TELNET, PARSER and PATH_MACHINE are the time spent in each stage for one
+/// call, not counting the stages it calls directly (e.g. the telnet stage
+/// calls the parser, which calls the path machine unless the proxy runs in
+/// its own thread). TOTAL is the time from reading the MUD's socket to
+/// writing the client's, and DISPLAY is the time until a map update caused
+/// by the data was painted.
+///
+/// The parser's events are queued for the path machine if the proxy runs in
+/// its own thread, so each one carries the arrival time of its data through a
+/// FIFO (see MapEventScope).
+class NODISCARD ProxyLatencyStats final
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr const size_t NUM_STAGES = 5;
+    /// Each stage keeps this many of its most recent samples.
+    static constexpr const size_t NUM_SAMPLES = 1000;
+
+    struct NODISCARD Percentiles final
+    {
+        uint64_t count = 0; // all samples since reset(), not just the recent ones
+        std::chrono::nanoseconds total{}; // the sum of all samples since reset()
+        std::chrono::nanoseconds p50{};
+        std::chrono::nanoseconds p95{};
+        std::chrono::nanoseconds p99{};
+        std::chrono::nanoseconds max{};
+    };
+
+    /// Marks one read from the MUD's socket; lives on the stack.
+    class NODISCARD PacketScope final
+    {
+    private:
+        ProxyLatencyStats &m_stats;
+        std::optional<Clock::time_point> m_outer;
+
+    public:
+        explicit PacketScope(ProxyLatencyStats &stats);
+        ~PacketScope();
+        DELETE_CTORS_AND_ASSIGN_OPS(PacketScope);
+    };
+
+    /// Times one call of a stage; lives on the stack.
+    class NODISCARD StageTimer final
+    {
+    private:
+        ProxyLatencyStats &m_stats;
+        const LatencyStageEnum m_stage;
+        const Clock::time_point m_start;
+        Clock::duration m_children{};
+        StageTimer *const m_parent;
+
+    public:
+        StageTimer(ProxyLatencyStats &stats, LatencyStageEnum stage);
+        ~StageTimer();
+        DELETE_CTORS_AND_ASSIGN_OPS(StageTimer);
+    };
+
+    /// Marks the path machine's handling of one queued event; lives on the stack.
+    class NODISCARD MapEventScope final
+    {
+    private:
+        std::optional<Clock::time_point> m_outer;
+
+    public:
+        explicit MapEventScope(ProxyLatencyStats &stats);
+        ~MapEventScope();
+        DELETE_CTORS_AND_ASSIGN_OPS(MapEventScope);
+    };
+
+private:
+    struct NODISCARD Samples final
+    {
+        std::vector<int64_t> ns;
+        size_t next = 0;
+        uint64_t count = 0;
+        int64_t totalNs = 0;
+    };
+
+    mutable std::mutex m_mutex;
+    std::array<Samples, NUM_STAGES> m_samples{};
+    // the oldest data the client hasn't got yet
+    std::optional<Clock::time_point> m_unsentSince;
+    // the oldest data of a map update that hasn't been painted yet
+    std::optional<Clock::time_point> m_undisplayedSince;
+    // the arrival of the data of each event queued for the path machine, in order
+    std::deque<std::optional<Clock::time_point>> m_queuedMapEvents;
+    uint64_t m_packets = 0;
+    bool m_logging = false;
+
+public:
+    ProxyLatencyStats() = default;
+    DELETE_CTORS_AND_ASSIGN_OPS(ProxyLatencyStats);
+
+public:
+    /// Called for each write to the client's socket.
+    void onSentToUser();
+    /// Called when the parser sends an event to the path machine.
+    void onMapEventQueued();
+    /// Called when the map asks to be repainted.
+    void onRepaintRequested();
+    /// Called after each frame of the map.
+    void onFramePainted();
+
+    void record(LatencyStageEnum stage, Clock::duration elapsed);
+    void reset();
+
+    NODISCARD bool isLogging() const;
+    void setLogging(bool enabled);
+
+public:
+    NODISCARD Percentiles getPercentiles(LatencyStageEnum stage) const;
+    NODISCARD uint64_t getTotalPackets() const;
+    /// Multi-line report, using "\r\n" line endings for the MUD client.
+    NODISCARD QString toReport() const;
+    /// One-line summary for the log window.
+    NODISCARD QString toSummaryLine() const;
+};
+
+NODISCARD ProxyLatencyStats &getProxyLatencyStats();
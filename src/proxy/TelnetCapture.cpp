@@ -0,0 +1,63 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "TelnetCapture.h"
+
+#include "../global/io.h"
+
+static constexpr const quint32 CAPTURE_MAGIC = 0x4d4d544eu; // "MMTN"
+static constexpr const quint32 CAPTURE_VERSION = 1u;
+
+TelnetCaptureWriter::TelnetCaptureWriter(const QString &fileName)
+    : m_file{fileName}
+{
+    if (!m_file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "Unable to open telnet capture file" << fileName << m_file.errorString();
+        return;
+    }
+    m_stream.setDevice(&m_file);
+    m_stream << CAPTURE_MAGIC << CAPTURE_VERSION;
+    m_timer.start();
+}
+
+void TelnetCaptureWriter::write(const QByteArray &data)
+{
+    if (!isOpen())
+        return;
+
+    m_stream << static_cast<qint64>(m_timer.nsecsElapsed()) << data;
+    // Flush so an abrupt exit still leaves a usable capture.
+    m_file.flush();
+}
+
+TelnetCaptureReader::TelnetCaptureReader(QIODevice &device)
+    : m_stream{&device}
+{
+    quint32 magic = 0;
+    quint32 version = 0;
+    m_stream >> magic >> version;
+    checkStatus();
+    if (magic != CAPTURE_MAGIC)
+        throw io::IOException("not a telnet capture");
+    if (version != CAPTURE_VERSION)
+        throw io::IOException("unsupported telnet capture version");
+}
+
+void TelnetCaptureReader::checkStatus()
+{
+    if (m_stream.status() != QDataStream::Ok)
+        throw io::IOException("truncated or corrupt telnet capture");
+}
+
+std::optional<TelnetCaptureRecord> TelnetCaptureReader::next()
+{
+    if (m_stream.atEnd())
+        return std::nullopt;
+
+    qint64 elapsed = 0;
+    TelnetCaptureRecord record;
+    m_stream >> elapsed >> record.data;
+    checkStatus();
+    record.elapsed = std::chrono::nanoseconds{elapsed};
+    return record;
+}
@@ -0,0 +1,56 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <chrono>
+#include <optional>
+#include <QByteArray>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+
+#include "../global/RuleOf5.h"
+
+/// The bytes read from the MUD's socket during a session, before any telnet
+/// decoding (so an MCCP stream is still compressed), each with the time since
+/// the capture started. See tests/BenchTelnetReplay.cpp for the consumer.
+struct TelnetCaptureRecord final
+{
+    std::chrono::nanoseconds elapsed{};
+    QByteArray data;
+};
+
+class TelnetCaptureWriter final
+{
+private:
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_timer;
+
+public:
+    explicit TelnetCaptureWriter(const QString &fileName);
+    DELETE_CTORS_AND_ASSIGN_OPS(TelnetCaptureWriter);
+
+public:
+    bool isOpen() const { return m_file.isOpen(); }
+    void write(const QByteArray &data);
+};
+
+/// Throws io::IOException if the capture is truncated or isn't a capture.
+class TelnetCaptureReader final
+{
+private:
+    QDataStream m_stream;
+
+public:
+    explicit TelnetCaptureReader(QIODevice &device);
+    DELETE_CTORS_AND_ASSIGN_OPS(TelnetCaptureReader);
+
+public:
+    /// Returns std::nullopt at the end of the capture.
+    std::optional<TelnetCaptureRecord> next();
+
+private:
+    void checkStatus();
+};
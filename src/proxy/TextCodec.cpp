@@ -5,11 +5,82 @@
 #include "TextCodec.h"
 
 #include "../configuration/configuration.h"
+#include "../global/macros.h"
 #include "../parser/parserutils.h"
 
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <string_view>
 #include <QDebug>
 
+NODISCARD static bool isAscii(const QByteArray &data)
+{
+    const auto size = static_cast<size_t>(data.size());
+    return ParserUtils::isAscii(std::string_view{data.constData(), size});
+}
+
+NODISCARD static bool isAscii(const QString &data)
+{
+    return ParserUtils::isAscii(data);
+}
+
+// The two byte UTF-8 encoding of each Latin-1 character from 0x80 to 0xFF.
+using Utf8Pair = std::array<char, 2>;
+static const std::array<Utf8Pair, 128> LATIN1_TO_UTF8 = []() {
+    std::array<Utf8Pair, 128> result{};
+    for (uint32_t i = 0; i < result.size(); ++i) {
+        const uint32_t c = 0x80u + i;
+        result[i] = Utf8Pair{static_cast<char>(0xC0u | (c >> 6)),
+                             static_cast<char>(0x80u | (c & 0x3Fu))};
+    }
+    return result;
+}();
+
+NODISCARD static QByteArray latin1ToUtf8(const QByteArray &data)
+{
+    QByteArray result;
+    result.reserve(2 * data.size());
+    const char *const end = data.data() + data.size();
+    for (const char *it = data.data(); it != end;) {
+        // copy up to the next non-ASCII character at once
+        const char *span = it;
+        while (span != end && (static_cast<uint8_t>(*span) & 0x80u) == 0)
+            ++span;
+        result.append(it, static_cast<int>(span - it));
+        if (span == end)
+            break;
+        const Utf8Pair &pair = LATIN1_TO_UTF8[static_cast<uint8_t>(*span) - 0x80u];
+        result.append(pair.data(), static_cast<int>(pair.size()));
+        it = span + 1;
+    }
+    return result;
+}
+
+/// Only decodes the UTF-8 encoding of Latin-1 (i.e. a lead byte of 0xC2 or 0xC3);
+/// returns false for anything else, which the caller leaves to QTextCodec.
+NODISCARD static bool tryUtf8ToLatin1(const QByteArray &data, QByteArray &result)
+{
+    result.clear();
+    result.reserve(data.size());
+    const int size = data.size();
+    for (int i = 0; i < size; ++i) {
+        const auto c = static_cast<uint8_t>(data[i]);
+        if ((c & 0x80u) == 0) {
+            result.append(static_cast<char>(c));
+            continue;
+        }
+        if ((c != 0xC2u && c != 0xC3u) || i + 1 == size)
+            return false;
+        const auto next = static_cast<uint8_t>(data[i + 1]);
+        if ((next & 0xC0u) != 0x80u)
+            return false;
+        result.append(static_cast<char>(((c & 0x1Fu) << 6) | (next & 0x3Fu)));
+        ++i;
+    }
+    return true;
+}
+
 TextCodec::TextCodec(const TextCodecStrategyEnum textCodecStrategy)
     : textCodecStrategy{textCodecStrategy}
 {
@@ -56,11 +127,21 @@ bool TextCodec::supports(const QByteArray &hisCharacterSet) const
 
 QByteArray TextCodec::fromUnicode(const QString &data)
 {
-    if (currentEncoding == CharacterEncodingEnum::ASCII) {
+    // ASCII is the same in every supported encoding
+    if (::isAscii(data))
+        return data.toLatin1();
+
+    switch (currentEncoding) {
+    case CharacterEncodingEnum::ASCII: {
         // Simplify Latin-1 characters to US-ASCII
         QString outdata = data;
         ParserUtils::toAsciiInPlace(outdata);
-        return textCodec->fromUnicode(outdata);
+        return outdata.toLatin1();
+    }
+    case CharacterEncodingEnum::LATIN1:
+        return data.toLatin1();
+    case CharacterEncodingEnum::UTF8:
+        break;
     }
 
     return textCodec->fromUnicode(data);
@@ -68,9 +149,44 @@ QByteArray TextCodec::fromUnicode(const QString &data)
 
 QString TextCodec::toUnicode(const QByteArray &data)
 {
+    if (currentEncoding != CharacterEncodingEnum::UTF8 || ::isAscii(data))
+        return QString::fromLatin1(data);
+
     return textCodec->toUnicode(data);
 }
 
+QByteArray TextCodec::fromLatin1(const QByteArray &data)
+{
+    if (::isAscii(data))
+        return data;
+
+    switch (currentEncoding) {
+    case CharacterEncodingEnum::ASCII: {
+        QByteArray outdata = data;
+        return ParserUtils::latin1ToAsciiInPlace(outdata);
+    }
+    case CharacterEncodingEnum::LATIN1:
+        return data;
+    case CharacterEncodingEnum::UTF8:
+        break;
+    }
+
+    return ::latin1ToUtf8(data);
+}
+
+QByteArray TextCodec::toLatin1(const QByteArray &data)
+{
+    if (currentEncoding != CharacterEncodingEnum::UTF8 || ::isAscii(data))
+        return data;
+
+    QByteArray result;
+    if (::tryUtf8ToLatin1(data, result))
+        return result;
+
+    // e.g. invalid sequences, or characters that Latin-1 doesn't have
+    return textCodec->toUnicode(data).toLatin1();
+}
+
 void TextCodec::setEncoding(const CharacterEncodingEnum encoding)
 {
     switch (encoding) {
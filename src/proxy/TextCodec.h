@@ -28,6 +28,11 @@ class TextCodec final
     QByteArray fromUnicode(const QString &);
     QString toUnicode(const QByteArray &);
 
+    /** Same as fromUnicode(QString::fromLatin1(data)), without the QString. */
+    QByteArray fromLatin1(const QByteArray &data);
+    /** Same as toUnicode(data).toLatin1(), without the QString. */
+    QByteArray toLatin1(const QByteArray &data);
+
     void setEncodingForName(const QByteArray &encodingName);
     bool supports(const QByteArray &encodingName) const;
     QStringList supportedEncodings() const;
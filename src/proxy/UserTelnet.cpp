@@ -7,7 +7,9 @@
 #include "../global/TextUtils.h"
 
 #include <sstream>
+#include <utility>
 #include <QJsonDocument>
+#include <QTimer>
 
 UserTelnet::UserTelnet(QObject *const parent)
     : AbstractTelnet(TextCodecStrategyEnum::AUTO_SELECT_CODEC, false, parent)
@@ -15,13 +17,20 @@ UserTelnet::UserTelnet(QObject *const parent)
 
 void UserTelnet::onConnected()
 {
-    reset();
+    // The user's connection stays the same, including its compression.
+    flushRawData();
+    resetNegotiation();
     // Negotiate options
     requestTelnetOption(TN_DO, OPT_TERMINAL_TYPE);
     requestTelnetOption(TN_DO, OPT_NAWS);
     requestTelnetOption(TN_DO, OPT_CHARSET);
     // Most clients expect the server (i.e. MMapper) to send IAC WILL GMCP
     requestTelnetOption(TN_WILL, OPT_GMCP);
+    // Compression only pays off for clients that aren't on the same machine
+    if (!NO_ZLIB && getConfig().connection.proxyListensOnAnyInterface) {
+        requestTelnetOption(TN_WILL, OPT_COMPRESS2);
+        requestTelnetOption(TN_WILL, OPT_COMPRESS3);
+    }
 }
 
 void UserTelnet::onAnalyzeUserStream(const QByteArray &data)
@@ -31,13 +40,12 @@ void UserTelnet::onAnalyzeUserStream(const QByteArray &data)
 
 void UserTelnet::onSendToUser(const QByteArray &ba, const bool goAhead)
 {
-    // MMapper internally represents all data as Latin-1
-    QString temp = QString::fromLatin1(ba);
-
-    // Convert from unicode into the client requested encoding
-    QByteArray outdata = getTextCodec().fromUnicode(temp);
-
-    submitOverTelnet(outdata, goAhead);
+    // MMapper internally represents all data as Latin-1;
+    // convert it into the client requested encoding
+    submitOverTelnet(getTextCodec().fromLatin1(ba), goAhead);
+    // Prompts must reach the client right away
+    if (goAhead)
+        flushRawData();
 }
 
 void UserTelnet::onGmcpToUser(const GmcpMessage &msg)
@@ -50,8 +58,7 @@ void UserTelnet::sendToMapper(const QByteArray &data, const bool goAhead)
 {
     // MMapper requires all data to be Latin-1 internally
     // REVISIT: This will break things if the client is handling MPI itself
-    QByteArray outdata = getTextCodec().toUnicode(data).toLatin1();
-    emit analyzeUserStream(outdata, goAhead);
+    emit analyzeUserStream(getTextCodec().toLatin1(data), goAhead);
 }
 
 void UserTelnet::onRelayEchoMode(const bool isDisabled)
@@ -134,6 +141,26 @@ void UserTelnet::receiveWindowSize(const int x, const int y)
             telnet sequences. */
 void UserTelnet::sendRawData(const QByteArray &data)
 {
+    // Everything sent during this pass of the event loop is written (and compressed)
+    // together, instead of as many small writes.
+    pendingOutput += data;
+    if (!flushScheduled) {
+        flushScheduled = true;
+        QTimer::singleShot(0, this, [this]() {
+            flushScheduled = false;
+            flushRawData();
+        });
+    }
+}
+
+void UserTelnet::flushRawData()
+{
+    if (pendingOutput.isEmpty())
+        return;
+
+    QByteArray data = std::exchange(pendingOutput, QByteArray{});
+    if (isCompressingOutput())
+        data = compressOutput(data);
     sentBytes += data.length();
     emit sendToSocket(data);
 }
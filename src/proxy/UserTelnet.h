@@ -36,4 +36,10 @@ public slots:
     void receiveTerminalType(const QByteArray &) override;
     void receiveWindowSize(int, int) override;
     void sendRawData(const QByteArray &data) override;
+    void flushRawData() override;
+
+private:
+    /** output waiting to be written (and compressed) together */
+    QByteArray pendingOutput;
+    bool flushScheduled = false;
 };
@@ -6,12 +6,14 @@
 
 #include "connectionlistener.h"
 
+#include <algorithm>
 #include <memory>
 #include <QTcpSocket>
 #include <QThread>
 
 #include "../configuration/configuration.h"
 #include "../global/TextUtils.h"
+#include "mumesocket.h"
 #include "proxy.h"
 
 ConnectionListenerTcpServer::ConnectionListenerTcpServer(ConnectionListener *const parent)
@@ -44,13 +46,12 @@ ConnectionListener::ConnectionListener(MapData *const md,
 
 ConnectionListener::~ConnectionListener()
 {
-    if (m_proxy) {
-        m_proxy.release(); // thread will delete the proxy
+    // The threads delete their proxies when they finish.
+    for (const auto &thread : m_threads) {
+        thread->quit();
     }
-    if (m_thread) {
-        m_thread->quit();
-        m_thread->wait();
-        m_thread.release(); // finished() and destroyed() signals will destruct the thread
+    for (const auto &thread : m_threads) {
+        thread->wait();
     }
 }
 
@@ -87,63 +88,104 @@ void ConnectionListener::listen()
         if (!serverIPv6->listen(QHostAddress::LocalHostIPv6, port))
             throw std::runtime_error(::toStdStringLatin1(serverIPv6->errorString()));
     }
+
+    // The first client usually connects soon after the proxy starts.
+    prewarmMudHost();
+}
+
+QThread &ConnectionListener::getThreadForNewSession()
+{
+    const auto countSessions = [this](const QThread *const thread) {
+        return std::count_if(m_proxies.begin(), m_proxies.end(), [thread](const auto &proxy) {
+            return proxy != nullptr && proxy->thread() == thread;
+        });
+    };
+
+    const auto maxThreads = static_cast<size_t>(std::max(1, QThread::idealThreadCount()));
+    if (m_threads.size() < maxThreads) {
+        const auto idle = std::find_if(m_threads.begin(), m_threads.end(), [&](const auto &t) {
+            return countSessions(t.get()) == 0;
+        });
+        if (idle != m_threads.end())
+            return **idle;
+
+        auto &thread = m_threads.emplace_back(std::make_unique<QThread>());
+        thread->setObjectName(QString("Proxy %1").arg(m_threads.size()));
+        thread->start();
+        return *thread;
+    }
+
+    return **std::min_element(m_threads.begin(),
+                              m_threads.end(),
+                              [&countSessions](const auto &a, const auto &b) {
+                                  return countSessions(a.get()) < countSessions(b.get());
+                              });
 }
 
 void ConnectionListener::onIncomingConnection(qintptr socketDescriptor)
 {
-    if (m_accept) {
-        emit log("Listener", "New connection: accepted.");
-        m_accept = false;
-        emit clientSuccessfullyConnected();
-
-        m_proxy = std::make_unique<Proxy>(m_mapData,
-                                          m_pathMachine,
-                                          m_prespammedPath,
-                                          m_groupManager,
-                                          m_mumeClock,
-                                          m_mapCanvas,
-                                          socketDescriptor,
-                                          this);
-
-        if (getConfig().connection.proxyThreaded) {
-            m_thread = std::make_unique<QThread>();
-            m_proxy->moveToThread(m_thread.get());
-
-            // Proxy destruction stops the thread which then destroys itself on completion
-            connect(m_proxy.get(), &QObject::destroyed, m_thread.get(), &QThread::quit);
-            connect(m_thread.get(), &QThread::finished, m_thread.get(), &QObject::deleteLater);
-            connect(m_thread.get(), &QObject::destroyed, this, [this]() {
-                m_accept = true;
-                m_proxy.release();
-                m_thread.release();
-            });
-
-            // Make sure if the thread is interrupted that we kill the proxy
-            connect(m_thread.get(), &QThread::finished, m_proxy.get(), &QObject::deleteLater);
-
-            // Start the proxy when the thread starts
-            connect(m_thread.get(), &QThread::started, m_proxy.get(), &Proxy::start);
-            m_thread->start();
-
-        } else {
-            connect(m_proxy.get(), &QObject::destroyed, this, [this]() {
-                m_accept = true;
-                m_proxy.release();
-            });
-            m_proxy->start();
-        }
+    m_proxies.erase(std::remove_if(m_proxies.begin(),
+                                   m_proxies.end(),
+                                   [](const QPointer<Proxy> &proxy) { return proxy.isNull(); }),
+                    m_proxies.end());
 
-    } else {
+    const auto &settings = getConfig().connection;
+    if (m_proxies.size() >= static_cast<size_t>(settings.maxProxySessions)) {
         emit log("Listener", "New connection: rejected.");
-        QTcpSocket tcpSocket;
-        if (tcpSocket.setSocketDescriptor(socketDescriptor)) {
-            QByteArray ba("\033[1;37;41mYou can't connect to MMapper more than once!\033[0m\r\n"
-                          "\r\n"
-                          "\033[1;37;41mPlease close the existing connection.\033[0m\r\n");
-            tcpSocket.write(ba);
-            tcpSocket.flush();
-            tcpSocket.disconnectFromHost();
-            tcpSocket.waitForDisconnected();
-        }
+        rejectConnection(socketDescriptor, settings.maxProxySessions);
+        return;
+    }
+
+    // The first session to connect drives the mapper until it disconnects.
+    const bool hasPrimary = std::any_of(m_proxies.begin(), m_proxies.end(), [](const auto &proxy) {
+        return proxy != nullptr && proxy->isPrimary();
+    });
+    const auto session = hasPrimary ? ProxySessionEnum::SECONDARY : ProxySessionEnum::PRIMARY;
+    emit log("Listener",
+             hasPrimary ? "New connection: accepted as an additional session."
+                        : "New connection: accepted.");
+    emit clientSuccessfullyConnected();
+
+    auto *const proxy = new Proxy(m_mapData,
+                                  m_pathMachine,
+                                  m_prespammedPath,
+                                  m_groupManager,
+                                  m_mumeClock,
+                                  m_mapCanvas,
+                                  socketDescriptor,
+                                  session,
+                                  this);
+    m_proxies.emplace_back(proxy);
+
+    if (settings.proxyThreaded) {
+        QThread &thread = getThreadForNewSession();
+        proxy->moveToThread(&thread);
+        // Make sure if the thread is interrupted that we kill the proxy
+        connect(&thread, &QThread::finished, proxy, &QObject::deleteLater);
+        QMetaObject::invokeMethod(proxy, &Proxy::start, Qt::QueuedConnection);
+    } else {
+        proxy->start();
+    }
+}
+
+void ConnectionListener::rejectConnection(const qintptr socketDescriptor, const int maxSessions)
+{
+    QTcpSocket tcpSocket;
+    if (tcpSocket.setSocketDescriptor(socketDescriptor)) {
+        const QByteArray ba = [maxSessions]() -> QByteArray {
+            if (maxSessions == 1)
+                return "\033[1;37;41mYou can't connect to MMapper more than once!\033[0m\r\n"
+                       "\r\n"
+                       "\033[1;37;41mPlease close the existing connection.\033[0m\r\n";
+            return QString("\033[1;37;41mMMapper can't take more than %1 connections!\033[0m\r\n"
+                           "\r\n"
+                           "\033[1;37;41mPlease close one of the existing connections.\033[0m\r\n")
+                .arg(maxSessions)
+                .toLatin1();
+        }();
+        tcpSocket.write(ba);
+        tcpSocket.flush();
+        tcpSocket.disconnectFromHost();
+        tcpSocket.waitForDisconnected();
     }
 }
@@ -65,17 +65,22 @@ class ConnectionListener final : public QObject
 protected slots:
     void onIncomingConnection(qintptr socketDescriptor);
 
+private:
+    void rejectConnection(qintptr socketDescriptor, int maxSessions);
+    QThread &getThreadForNewSession();
+
 private:
     MapData *m_mapData = nullptr;
     Mmapper2PathMachine *m_pathMachine = nullptr;
     PrespammedPath *m_prespammedPath = nullptr;
     Mmapper2Group *m_groupManager = nullptr;
     MumeClock *m_mumeClock = nullptr;
+    // nullptr when running headless.
     MapCanvas *m_mapCanvas = nullptr;
     using ServerList = std::vector<QPointer<ConnectionListenerTcpServer>>;
     ServerList m_servers;
-    std::unique_ptr<Proxy> m_proxy;
-    std::unique_ptr<QThread> m_thread;
-
-    bool m_accept = true;
+    // Each proxy deletes itself when its session ends.
+    std::vector<QPointer<Proxy>> m_proxies;
+    // The threaded sessions share at most one thread per core.
+    std::vector<std::unique_ptr<QThread>> m_threads;
 };
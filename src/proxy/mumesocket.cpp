@@ -6,17 +6,69 @@
 
 #include "mumesocket.h"
 
+#include <map>
 #include <QByteArray>
+#include <QCoreApplication>
+#include <QHostInfo>
 #include <QMessageLogContext>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QSslSocket>
 #include <QString>
 #include <QtNetwork>
 
 #include "../configuration/configuration.h"
 #include "../global/io.h"
+#include "../global/macros.h"
+#include "ProxyLatencyStats.h"
 
 static constexpr int TIMEOUT_MILLIS = 10000;
 
+namespace { // anonymous
+
+// The TLS session tickets of earlier connections, so a reconnect can resume the
+// session instead of doing a full handshake. Every proxy has its own socket, on
+// its own thread, so they're shared here.
+class NODISCARD SessionTicketCache final
+{
+private:
+    QMutex m_mutex;
+    std::map<QString, QByteArray> m_tickets;
+
+public:
+    NODISCARD QByteArray get(const QString &key)
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto it = m_tickets.find(key);
+        return it == m_tickets.end() ? QByteArray{} : it->second;
+    }
+    void set(const QString &key, const QByteArray &ticket)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_tickets[key] = ticket;
+    }
+    void remove(const QString &key)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_tickets.erase(key);
+    }
+};
+
+SessionTicketCache &getSessionTicketCache()
+{
+    static SessionTicketCache cache;
+    return cache;
+}
+
+} // namespace
+
+void prewarmMudHost()
+{
+    QHostInfo::lookupHost(getConfig().connection.remoteServerName,
+                          QCoreApplication::instance(),
+                          [](const QHostInfo &) {});
+}
+
 void MumeSocket::onConnect()
 {
     emit connected();
@@ -75,6 +127,8 @@ MumeSslSocket::MumeSslSocket(QObject *parent)
     const auto get_ssl_config = [this]() {
         auto config = m_socket.sslConfiguration();
         config.setPeerVerifyMode(QSslSocket::QueryPeer);
+        // Qt only hands out session tickets if it's allowed to keep sessions.
+        config.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
         return config;
     };
     m_socket.setSslConfiguration(get_ssl_config());
@@ -90,6 +144,13 @@ MumeSslSocket::MumeSslSocket(QObject *parent)
             this,
             &MumeSslSocket::onError);
     connect(&m_socket, &QSslSocket::peerVerifyError, this, &MumeSslSocket::onPeerVerifyError);
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    // TLS 1.3 servers only send the ticket after the handshake.
+    connect(&m_socket,
+            &QSslSocket::newSessionTicketReceived,
+            this,
+            &MumeSslSocket::rememberSessionTicket);
+#endif
 
     m_timer.setInterval(TIMEOUT_MILLIS);
     m_timer.setSingleShot(true);
@@ -105,6 +166,13 @@ MumeSslSocket::~MumeSslSocket()
 void MumeSslSocket::connectToHost()
 {
     const auto &settings = getConfig().connection;
+    m_sessionKey = QString("%1:%2").arg(settings.remoteServerName).arg(settings.remotePort);
+    {
+        // An empty ticket means a full handshake.
+        auto config = m_socket.sslConfiguration();
+        config.setSessionTicket(getSessionTicketCache().get(m_sessionKey));
+        m_socket.setSslConfiguration(config);
+    }
     m_socket.connectToHostEncrypted(settings.remoteServerName,
                                     settings.remotePort,
                                     QIODevice::ReadWrite);
@@ -133,6 +201,10 @@ void MumeSslSocket::onConnect()
 
 void MumeSslSocket::onError(QAbstractSocket::SocketError e)
 {
+    // Don't offer a ticket the server may have choked on next time.
+    if (e == QAbstractSocket::SslHandshakeFailedError)
+        getSessionTicketCache().remove(m_sessionKey);
+
     // MUME disconnecting is not an error. We also handle timeouts separately.
     if (e != QAbstractSocket::RemoteHostClosedError && e != QAbstractSocket::SocketTimeoutError) {
         m_timer.stop();
@@ -144,6 +216,7 @@ void MumeSslSocket::onEncrypted()
 {
     m_timer.stop();
     emit log("Proxy", "Connection now encrypted ...");
+    rememberSessionTicket();
     constexpr const bool LOG_CERT_INFO = true;
     if ((LOG_CERT_INFO)) {
         /* TODO: If we save the cert to config file, then we can notify the user if it changes! */
@@ -161,6 +234,13 @@ void MumeSslSocket::onEncrypted()
     MumeSocket::onConnect();
 }
 
+void MumeSslSocket::rememberSessionTicket()
+{
+    const QByteArray ticket = m_socket.sslConfiguration().sessionTicket();
+    if (!ticket.isEmpty() && !m_sessionKey.isEmpty())
+        getSessionTicketCache().set(m_sessionKey, ticket);
+}
+
 void MumeSslSocket::onPeerVerifyError(const QSslError &error)
 {
     emit log("Proxy", "<b>WARNING:</b> " + error.errorString());
@@ -176,8 +256,10 @@ void MumeSslSocket::onPeerVerifyError(const QSslError &error)
 void MumeSslSocket::onReadyRead()
 {
     io::readAllAvailable(m_socket, m_buffer, [this](const QByteArray &byteArray) {
-        if (!byteArray.isEmpty())
+        if (!byteArray.isEmpty()) {
+            ProxyLatencyStats::PacketScope packet{getProxyLatencyStats()};
             emit processMudStream(byteArray);
+        }
     });
 }
 
@@ -186,6 +268,7 @@ void MumeSslSocket::checkTimeout()
     switch (m_socket.state()) {
     case QAbstractSocket::ConnectedState:
         if (!m_socket.isEncrypted()) {
+            getSessionTicketCache().remove(m_sessionKey);
             onError2(QAbstractSocket::SslHandshakeFailedError,
                      "Timeout during encryption handshake.");
             return;
@@ -64,12 +64,21 @@ protected slots:
     void onPeerVerifyError(const QSslError &error);
     void checkTimeout();
 
+private:
+    void rememberSessionTicket();
+
 protected:
     io::buffer<(1 << 13)> m_buffer;
     QSslSocket m_socket;
     QTimer m_timer;
+    // The host and port the session ticket is cached under.
+    QString m_sessionKey;
 };
 
+// Looks up the configured MUME host in the background, so the first connection
+// finds the address in QHostInfo's cache instead of waiting for the resolver.
+void prewarmMudHost();
+
 class MumeTcpSocket final : public MumeSslSocket
 {
     Q_OBJECT
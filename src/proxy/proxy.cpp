@@ -6,7 +6,7 @@
 
 #include "proxy.h"
 
-#include <cassert>
+#include <atomic>
 #include <memory>
 #include <stdexcept>
 #include <QByteArray>
@@ -19,8 +19,8 @@
 #include "../display/mapcanvas.h"
 #include "../display/prespammedpath.h"
 #include "../expandoracommon/parseevent.h"
+#include "../global/Trace.h"
 #include "../global/io.h"
-#include "../mainwindow/mainwindow.h"
 #include "../mpi/mpifilter.h"
 #include "../mpi/remoteedit.h"
 #include "../pandoragroup/mmapper2group.h"
@@ -29,6 +29,8 @@
 #include "../pathmachine/mmapper2pathmachine.h"
 #include "GmcpUtils.h"
 #include "MudTelnet.h"
+#include "ProxyLatencyStats.h"
+#include "TelnetCapture.h"
 #include "UserTelnet.h"
 #include "connectionlistener.h"
 #include "mumesocket.h"
@@ -53,6 +55,7 @@ Proxy::Proxy(MapData *const md,
              MumeClock *mc,
              MapCanvas *mca,
              qintptr &socketDescriptor,
+             const ProxySessionEnum session,
              ConnectionListener *const listener)
     : QObject(nullptr)
     , m_mapData(md)
@@ -63,6 +66,7 @@ Proxy::Proxy(MapData *const md,
     , m_mapCanvas(mca)
     , m_listener(listener)
     , m_socketDescriptor(socketDescriptor)
+    , m_session(session)
     // TODO: pass this in as a non-owning pointer.
     , m_remoteEdit{makeQPointer<RemoteEdit>(m_listener->parent())}
 {
@@ -85,15 +89,28 @@ Proxy::~Proxy()
     }
 }
 
-void Proxy::start()
+void connectParserToPathMachine(MumeXmlParser &parser, Mmapper2PathMachine &pathMachine)
 {
-    auto *const mw = dynamic_cast<MainWindow *>(m_listener->parent());
-    if (mw == nullptr) {
-        // dynamic cast can fail
-        assert(false);
-        return;
-    }
+    // The parser predicts the next room from the map's position (e.g. for the notes and
+    // the emulated exits), so the path machine has to handle each event before the parser
+    // reads the next room of the same packet. These connections are only queued if the
+    // proxy runs in its own thread.
+    QObject::connect(&parser,
+                     QOverload<const SigParseEvent &>::of(&MumeXmlParser::event),
+                     &parser,
+                     []() { getProxyLatencyStats().onMapEventQueued(); });
+    QObject::connect(&parser,
+                     QOverload<const SigParseEvent &>::of(&MumeXmlParser::event),
+                     &pathMachine,
+                     &Mmapper2PathMachine::event);
+    QObject::connect(&parser,
+                     &AbstractParser::releaseAllPaths,
+                     &pathMachine,
+                     &PathMachine::releaseAllPaths);
+}
 
+void Proxy::start()
+{
     m_userSocket = [this]() -> QPointer<QTcpSocket> {
         auto userSock = makeQPointer<QTcpSocket>(this);
         if (!userSock->setSocketDescriptor(m_socketDescriptor)) {
@@ -134,7 +151,7 @@ void Proxy::start()
     auto *const mudSocket = m_mudSocket.data();
     auto *const remoteEdit = m_remoteEdit.data();
 
-    connect(this, &Proxy::log, mw, &MainWindow::log);
+    connect(this, &Proxy::log, m_listener, &ConnectionListener::log, Qt::DirectConnection);
     connect(this, &Proxy::sig_sendToMud, mudTelnet, &MudTelnet::onSendToMud);
     connect(this, &Proxy::sig_sendToUser, userTelnet, &UserTelnet::onSendToUser);
     connect(this, &Proxy::sig_gmcpToMud, mudTelnet, &MudTelnet::onGmcpToMud);
@@ -178,33 +195,23 @@ void Proxy::start()
 
     connect(parserXml, &MumeXmlParser::sendToMud, mudTelnet, &MudTelnet::onSendToMud);
     connect(parserXml, &MumeXmlParser::sig_sendToUser, userTelnet, &UserTelnet::onSendToUser);
-
-    connect(parserXml,
-            QOverload<const SigParseEvent &>::of(&MumeXmlParser::event),
-            m_pathMachine,
-            &Mmapper2PathMachine::event);
-    connect(parserXml,
-            &AbstractParser::releaseAllPaths,
-            m_pathMachine,
-            &PathMachine::releaseAllPaths);
-    connect(parserXml, &AbstractParser::showPath, m_prespammedPath, &PrespammedPath::setPath);
-    connect(parserXml, &AbstractParser::sig_mapChanged, m_mapCanvas, &MapCanvas::mapChanged);
+    // There's no canvas when running headless.
+    if (m_mapCanvas != nullptr) {
+        connect(parserXml, &AbstractParser::sig_mapChanged, m_mapCanvas, &MapCanvas::mapChanged);
+        connect(parserXml,
+                &AbstractParser::sig_graphicsSettingsChanged,
+                m_mapCanvas,
+                &MapCanvas::graphicsSettingsChanged);
+    }
     connect(parserXml,
-            &AbstractParser::sig_graphicsSettingsChanged,
-            m_mapCanvas,
-            &MapCanvas::graphicsSettingsChanged);
-    connect(parserXml, &AbstractParser::log, mw, &MainWindow::log);
-    connect(parserXml, &AbstractParser::newRoomSelection, m_mapCanvas, &MapCanvas::setRoomSelection);
-
+            &AbstractParser::log,
+            m_listener,
+            &ConnectionListener::log,
+            Qt::DirectConnection);
     connect(userSocket, &QAbstractSocket::disconnected, parserXml, &AbstractParser::reset);
 
-    // Group Manager Support
-    connect(parserXml, &AbstractParser::showPath, m_groupManager, &Mmapper2Group::setPath);
-    // Group Tell
-    connect(m_groupManager,
-            &Mmapper2Group::displayGroupTellEvent,
-            parserXml,
-            &AbstractParser::sendGTellToUser);
+    if (isPrimary())
+        connectToMapper();
 
     emit log("Proxy", "Connection to client established ...");
 
@@ -213,22 +220,61 @@ void Proxy::start()
                         .arg(getConfig().parser.prefixChar)
                         .toLatin1();
     sendToUser(ba);
+    if (!isPrimary())
+        sendToUser("\033[37;46mAnother client is mapping; this session won't move the map."
+                   "\033[0m\r\n");
 
     connect(mudSocket, &MumeSocket::connected, userTelnet, &UserTelnet::onConnected);
     connect(mudSocket, &MumeSocket::connected, mudTelnet, &MudTelnet::onConnected);
     connect(mudSocket, &MumeSocket::connected, this, &Proxy::onMudConnected);
     connect(mudSocket, &MumeSocket::socketError, parserXml, &AbstractParser::reset);
-    connect(mudSocket, &MumeSocket::socketError, m_groupManager, &Mmapper2Group::reset);
     connect(mudSocket, &MumeSocket::socketError, this, &Proxy::onMudError);
     connect(mudSocket, &MumeSocket::disconnected, parserXml, &AbstractParser::reset);
-    connect(mudSocket, &MumeSocket::disconnected, m_groupManager, &Mmapper2Group::reset);
     connect(mudSocket, &MumeSocket::disconnected, this, &Proxy::mudTerminatedConnection);
     connect(mudSocket, &MumeSocket::processMudStream, mudTelnet, &MudTelnet::onAnalyzeMudStream);
-    connect(mudSocket, &MumeSocket::log, mw, &MainWindow::log);
+
+    // e.g. for tests/BenchTelnetReplay
+    const QByteArray captureFile = qgetenv("MMAPPER_CAPTURE_TELNET");
+    if (isPrimary() && !captureFile.isEmpty()) {
+        m_capture = std::make_unique<TelnetCaptureWriter>(QString::fromLocal8Bit(captureFile));
+        connect(mudSocket, &MumeSocket::processMudStream, this, [this](const QByteArray &ba) {
+            m_capture->write(ba);
+        });
+    }
+    connect(mudSocket,
+            &MumeSocket::log,
+            m_listener,
+            &ConnectionListener::log,
+            Qt::DirectConnection);
 
     connectToMud();
 }
 
+// Connections to state that only one client can drive at a time.
+void Proxy::connectToMapper()
+{
+    auto *const parserXml = m_parserXml.data();
+    auto *const mudSocket = m_mudSocket.data();
+
+    connectParserToPathMachine(*parserXml, *m_pathMachine);
+    connect(parserXml, &AbstractParser::showPath, m_prespammedPath, &PrespammedPath::setPath);
+    if (m_mapCanvas != nullptr)
+        connect(parserXml,
+                &AbstractParser::newRoomSelection,
+                m_mapCanvas,
+                &MapCanvas::setRoomSelection);
+
+    // Group Manager Support
+    connect(parserXml, &AbstractParser::showPath, m_groupManager, &Mmapper2Group::setPath);
+    // Group Tell
+    connect(m_groupManager,
+            &Mmapper2Group::displayGroupTellEvent,
+            parserXml,
+            &AbstractParser::sendGTellToUser);
+    connect(mudSocket, &MumeSocket::socketError, m_groupManager, &Mmapper2Group::reset);
+    connect(mudSocket, &MumeSocket::disconnected, m_groupManager, &Mmapper2Group::reset);
+}
+
 void Proxy::onMudConnected()
 {
     const auto &settings = getConfig().mumeClientProtocol;
@@ -242,7 +288,7 @@ void Proxy::onMudConnected()
     emit log("Proxy", "Sent MUME Protocol Initiator IAC-GA prompt request");
     sendToMud(idPrompt);
 
-    if (settings.remoteEditing) {
+    if (settings.usesRemoteEditing()) {
         QByteArray idRemoteEditing("~$#EI\n");
         emit log("Proxy", "Sent MUME Protocol Initiator remote editing request");
         sendToMud(idRemoteEditing);
@@ -323,6 +369,7 @@ void Proxy::mudTerminatedConnection()
 
 void Proxy::processUserStream()
 {
+    MMAPPER_TRACE_SCOPE("Proxy::processUserStream");
     if (m_userSocket != nullptr) {
         io::readAllAvailable(*m_userSocket, m_buffer, [this](const QByteArray &byteArray) {
             if (!byteArray.isEmpty())
@@ -333,6 +380,7 @@ void Proxy::processUserStream()
 
 void Proxy::onSendToMudSocket(const QByteArray &ba)
 {
+    MMAPPER_TRACE_SCOPE("Proxy::onSendToMudSocket");
     if (m_mudSocket != nullptr) {
         if (m_mudSocket->state() != QAbstractSocket::ConnectedState) {
             sendToUser(
@@ -352,8 +400,17 @@ void Proxy::onSendToMudSocket(const QByteArray &ba)
 
 void Proxy::onSendToUserSocket(const QByteArray &ba)
 {
+    MMAPPER_TRACE_SCOPE("Proxy::onSendToUserSocket");
     if (m_userSocket != nullptr) {
         m_userSocket->write(ba);
+
+        auto &stats = getProxyLatencyStats();
+        stats.onSentToUser();
+        static constexpr const uint64_t STATS_LOG_INTERVAL = 1000;
+        static std::atomic<uint64_t> writes{0};
+        if (stats.isLogging() && ++writes % STATS_LOG_INTERVAL == 0) {
+            emit log("Proxy", QString("latency: %1").arg(stats.toSummaryLine()));
+        }
     } else {
         qWarning() << "User socket not available";
     }
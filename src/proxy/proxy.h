@@ -16,6 +16,7 @@
 
 #include "../global/WeakHandle.h"
 #include "../global/io.h"
+#include "../global/macros.h"
 #include "../pandoragroup/GroupManagerApi.h"
 #include "GmcpMessage.h"
 #include "ProxyParserApi.h"
@@ -35,11 +36,19 @@ class QDataStream;
 class QFile;
 class QTcpSocket;
 class RemoteEdit;
+class TelnetCaptureWriter;
 class TelnetFilter;
 class UserTelnet;
 
 #undef ERROR // Bad dog, Microsoft; bad dog!!!
 
+/// Only the PRIMARY session feeds the path machine, the map's selection and
+/// the group manager; the others just share the map.
+enum class ProxySessionEnum { PRIMARY, SECONDARY };
+
+/// Feeds the parser's events to the path machine, as the PRIMARY session does.
+void connectParserToPathMachine(MumeXmlParser &parser, Mmapper2PathMachine &pathMachine);
+
 class Proxy final : public QObject
 {
     Q_OBJECT
@@ -51,9 +60,12 @@ class Proxy final : public QObject
                    MumeClock *,
                    MapCanvas *,
                    qintptr &,
+                   ProxySessionEnum,
                    ConnectionListener *);
     ~Proxy() override;
 
+    NODISCARD bool isPrimary() const { return m_session == ProxySessionEnum::PRIMARY; }
+
 public slots:
     void start();
 
@@ -82,6 +94,7 @@ public slots:
 private:
     friend ProxyParserApi;
     bool isConnected() const;
+    void connectToMapper();
     void connectToMud();
     void disconnectFromMud();
     void sendToUser(const QByteArray &ba) { emit sig_sendToUser(ba, false); }
@@ -103,6 +116,7 @@ public slots:
     MapCanvas *const m_mapCanvas;
     ConnectionListener *const m_listener;
     const qintptr m_socketDescriptor;
+    const ProxySessionEnum m_session;
 
     // initialized in ctor
     QPointer<RemoteEdit> m_remoteEdit;
@@ -115,6 +129,7 @@ public slots:
     QPointer<MpiFilter> m_mpiFilter;
     QPointer<MumeXmlParser> m_parserXml;
     QPointer<MumeSocket> m_mudSocket;
+    std::unique_ptr<TelnetCaptureWriter> m_capture;
 
     enum class ServerStateEnum {
         INITIALIZED,
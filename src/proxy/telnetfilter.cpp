@@ -6,10 +6,14 @@
 
 #include "telnetfilter.h"
 
+#include <array>
 #include <cstdint>
+#include <cstring>
+#include <utility>
 #include <QByteArray>
 #include <QObject>
 
+#include "../global/macros.h"
 #include "../parser/patterns.h"
 
 static constexpr const uint8_t ASCII_DEL = 8;
@@ -21,9 +25,9 @@ void TelnetFilter::onAnalyzeMudStream(const QByteArray &ba, bool goAhead)
     dispatchTelnetStream(ba, m_mudIncomingBuffer, m_mudIncomingQue, goAhead);
 
     // parse incoming lines in que
-    TelnetData data;
-    while (!m_mudIncomingQue.isEmpty()) {
-        data = m_mudIncomingQue.dequeue();
+    while (!m_mudIncomingQue.empty()) {
+        const TelnetData data = std::move(m_mudIncomingQue.front());
+        m_mudIncomingQue.pop_front();
         emit parseNewMudInput(data);
     }
 }
@@ -33,29 +37,67 @@ void TelnetFilter::onAnalyzeUserStream(const QByteArray &ba, bool goAhead)
     dispatchTelnetStream(ba, m_userIncomingData, m_userIncomingQue, goAhead);
 
     // parse incoming lines in que
-    TelnetData data;
-    while (!m_userIncomingQue.isEmpty()) {
-        data = m_userIncomingQue.dequeue();
+    while (!m_userIncomingQue.empty()) {
+        const TelnetData data = std::move(m_userIncomingQue.front());
+        m_userIncomingQue.pop_front();
         emit parseNewUserInput(data);
     }
 }
 
+// Only these bytes can end a line; see dispatchTelnetStream().
+static constexpr const std::array<bool, 256> IS_LINE_BREAK = []() {
+    std::array<bool, 256> result{};
+    result[ASCII_DEL] = true;
+    result[ASCII_CR] = true;
+    result[ASCII_LF] = true;
+    return result;
+}();
+
+NODISCARD static int findLineBreak(const QByteArray &stream, const int from)
+{
+    // Every line break is less than this, and text rarely is, so 8 bytes at a
+    // time are skipped unless one of them might be a line break.
+    static_assert(ASCII_DEL < 14 && ASCII_CR < 14 && ASCII_LF < 14);
+    static constexpr const uint64_t ONES = 0x0101010101010101ull;
+    static constexpr const uint64_t HIGH_BITS = 0x8080808080808080ull;
+    static constexpr const uint64_t LIMIT = 14 * ONES;
+
+    const char *const data = stream.constData();
+    const int size = stream.size();
+    int i = from;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, data + i, sizeof(word));
+        // sets the high bit of each byte that's less than 14
+        if (((word - LIMIT) & ~word & HIGH_BITS) != 0)
+            break;
+    }
+    for (; i < size; ++i) {
+        if (IS_LINE_BREAK[static_cast<uint8_t>(data[i])])
+            return i;
+    }
+    return size;
+}
+
 void TelnetFilter::dispatchTelnetStream(const QByteArray &stream,
                                         TelnetData &buffer,
                                         TelnetIncomingDataQueue &que,
                                         const bool &goAhead)
 {
-    quint16 index = 0;
-
-    while (index < stream.size()) {
+    // Moves the line to the queue, and starts the next one.
+    const auto enqueue = [&buffer, &que](const TelnetDataEnum type) {
+        buffer.type = type;
+        que.emplace_back(std::exchange(buffer, TelnetData{}));
+    };
+
+    const int size = stream.size();
+    int index = 0;
+    while (index < size) {
         const auto val1 = static_cast<uint8_t>(stream.at(index));
         switch (val1) {
         case ASCII_DEL:
             buffer.line.append(static_cast<char>(ASCII_DEL));
-            buffer.type = TelnetDataEnum::DELAY;
-            que.enqueue(buffer);
-            buffer.line.clear();
-            buffer.type = TelnetDataEnum::UNKNOWN;
+            enqueue(TelnetDataEnum::DELAY);
             index++;
             break;
 
@@ -64,71 +106,48 @@ void TelnetFilter::dispatchTelnetStream(const QByteArray &stream,
             index++;
             break;
 
-        case ASCII_LF:
-            if (!buffer.line.isEmpty()) {
-                const auto val2 = static_cast<uint8_t>(buffer.line.right(1).at(0)); // get last char
-                switch (val2) {
-                case ASCII_CR:
-                    buffer.line.append(static_cast<char>(ASCII_LF));
-                    buffer.type = TelnetDataEnum::CRLF;
-                    que.enqueue(buffer);
-                    buffer.line.clear();
-                    buffer.type = TelnetDataEnum::UNKNOWN;
-                    index++;
-                    break;
-
-                default:
-                    buffer.line.append(static_cast<char>(ASCII_LF));
-                    index++;
-                    break;
-                }
-            } else {
-                buffer.line.append(static_cast<char>(ASCII_LF));
-                index++;
-                break;
-            }
+        case ASCII_LF: {
+            const bool crlf = buffer.line.endsWith(static_cast<char>(ASCII_CR));
+            buffer.line.append(static_cast<char>(ASCII_LF));
+            if (crlf)
+                enqueue(TelnetDataEnum::CRLF);
+            index++;
             break;
+        }
 
         default:
-            if (!buffer.line.isEmpty() && buffer.line.right(1).at(0) == ASCII_LF) {
-                buffer.type = TelnetDataEnum::LF;
-                que.enqueue(buffer);
-                buffer.line.clear();
-                buffer.type = TelnetDataEnum::UNKNOWN;
+            if (buffer.line.endsWith(static_cast<char>(ASCII_LF)))
+                enqueue(TelnetDataEnum::LF);
+
+            // The rest of the text up to the next line break can't end the line,
+            // so it's appended at once; a whole packet of text is shared, not copied.
+            {
+                const int end = findLineBreak(stream, index + 1);
+                if (buffer.line.isEmpty() && index == 0 && end == size)
+                    buffer.line = stream;
+                else
+                    buffer.line.append(stream.constData() + index, end - index);
+                index = end;
             }
-
-            buffer.line.append(static_cast<char>(val1));
-            index++;
             break;
         }
     }
 
     if (!buffer.line.isEmpty() && (goAhead || buffer.type == TelnetDataEnum::UNKNOWN)) {
-        {
-            if (goAhead) {
-                const auto get_type = [&buffer]() {
-                    if (Patterns::matchPasswordPatterns(buffer.line))
-                        return TelnetDataEnum::LOGIN_PASSWORD;
-                    else if (Patterns::matchMenuPromptPatterns(buffer.line))
-                        return TelnetDataEnum::MENU_PROMPT;
-                    return TelnetDataEnum::PROMPT;
-                };
-                buffer.type = get_type();
-                que.enqueue(buffer);
-                buffer.line.clear();
-                buffer.type = TelnetDataEnum::UNKNOWN;
-            } else if (buffer.line.endsWith(char(ASCII_LF))) {
-                buffer.type = TelnetDataEnum::LF;
-                que.enqueue(buffer);
-                buffer.line.clear();
-                buffer.type = TelnetDataEnum::UNKNOWN;
-            } else if (Patterns::matchLoginPatterns(buffer.line)) {
-                // IAC-GA usually take effect after the login screen
-                buffer.type = TelnetDataEnum::LOGIN;
-                que.enqueue(buffer);
-                buffer.line.clear();
-                buffer.type = TelnetDataEnum::UNKNOWN;
-            }
+        if (goAhead) {
+            const auto get_type = [&buffer]() {
+                if (Patterns::matchPasswordPatterns(buffer.line))
+                    return TelnetDataEnum::LOGIN_PASSWORD;
+                else if (Patterns::matchMenuPromptPatterns(buffer.line))
+                    return TelnetDataEnum::MENU_PROMPT;
+                return TelnetDataEnum::PROMPT;
+            };
+            enqueue(get_type());
+        } else if (buffer.line.endsWith(char(ASCII_LF))) {
+            enqueue(TelnetDataEnum::LF);
+        } else if (Patterns::matchLoginPatterns(buffer.line)) {
+            // IAC-GA usually take effect after the login screen
+            enqueue(TelnetDataEnum::LOGIN);
         }
     }
 }
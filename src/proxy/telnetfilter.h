@@ -5,9 +5,9 @@
 // Author: Marek Krejza <krejza@gmail.com> (Caligor)
 // Author: Nils Schimmelmann <nschimme@gmail.com> (Jahara)
 
+#include <deque>
 #include <QByteArray>
 #include <QObject>
-#include <QQueue>
 #include <QString>
 #include <QtCore>
 
@@ -23,7 +23,7 @@ struct TelnetData final
 class TelnetFilter final : public QObject
 {
     Q_OBJECT
-    using TelnetIncomingDataQueue = QQueue<TelnetData>;
+    using TelnetIncomingDataQueue = std::deque<TelnetData>;
 
 public:
     explicit TelnetFilter(QObject *const parent)
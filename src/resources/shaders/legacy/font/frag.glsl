@@ -8,5 +8,10 @@ varying vec2 vTexCoord;
 
 void main()
 {
-    gl_FragColor = vColor * texture2D(uFontTexture, vTexCoord);
+    // The atlas holds a signed distance field of the glyphs; 0.5 is the outline.
+    float dist = texture2D(uFontTexture, vTexCoord).a;
+    // about a pixel of antialiasing at any scale
+    float width = max(0.5 * fwidth(dist), 1e-3);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, dist);
+    gl_FragColor = vec4(vColor.rgb, vColor.a * alpha);
 }
@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+uniform mat4 uMVP;
+
+// xy = room relative to the origin, z = corner of the room (x + 2y) unless instanced,
+// w = cell of the atlas
+attribute vec4 aRoom;
+
+#ifdef MM_INSTANCED_QUADS
+// one instance per room, drawn as a 4-vertex triangle strip
+#define CORNER float(gl_VertexID)
+#else
+#define CORNER aRoom.z
+#endif
+
+varying vec2 vTexCoord;
+
+// These must match MapCanvasTextures::ATLAS_COLUMNS, ATLAS_ROWS, and ATLAS_CELL_SIZE.
+const vec2 GRID = vec2(16.0, 8.0);
+const float CELL_SIZE = 128.0;
+
+void main()
+{
+    vec2 corner = vec2(mod(CORNER, 2.0), floor(CORNER * 0.5));
+    vec2 cell = vec2(mod(aRoom.w, GRID.x), floor(aRoom.w / GRID.x));
+    // Stay half a texel inside the cell, so the neighbouring cells don't bleed in.
+    vec2 inset = mix(vec2(0.5), vec2(CELL_SIZE - 0.5), corner) / CELL_SIZE;
+    vTexCoord = (cell + inset) / GRID;
+    gl_Position = uMVP * vec4(aRoom.xy + corner, 0.0, 1.0);
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+uniform mat4 uMVP;
+
+// xy = room relative to the origin, z = corner of the room (x + 2y) unless instanced, w = unused
+attribute vec4 aRoom;
+
+#ifdef MM_INSTANCED_QUADS
+// one instance per room, drawn as a 4-vertex triangle strip
+#define CORNER float(gl_VertexID)
+#else
+#define CORNER aRoom.z
+#endif
+
+void main()
+{
+    vec2 corner = vec2(mod(CORNER, 2.0), floor(CORNER * 0.5));
+    gl_Position = uMVP * vec4(aRoom.xy + corner, 0.0, 1.0);
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+uniform vec4 uColor;
+
+varying vec4 vColor;
+varying float vMiddleAlpha;
+varying float vDistance;
+varying float vLength;
+
+// ColorSegment::FADE_LENGTH
+const float FADE_LENGTH = 3.0;
+
+void main()
+{
+    float margin = FADE_LENGTH * 0.5;
+    bool isMiddle = vLength >= FADE_LENGTH && vDistance > margin
+                    && vDistance < vLength - margin;
+    gl_FragColor = vec4(vColor.rgb, isMiddle ? vMiddleAlpha : vColor.a) * uColor;
+}
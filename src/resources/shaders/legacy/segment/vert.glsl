@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+uniform mat4 uMVP;
+uniform ivec4 uPhysViewport;
+uniform float uLineWidth; // in physical pixels
+
+attribute vec4 aColor;
+// the ends of the segment, relative to the origin, in units of 1/128 of a room
+attribute vec3 aFrom;
+attribute vec3 aTo;
+// x = corner of the quad (end + 2 * side) unless instanced, y = alpha of the middle
+attribute vec2 aParams;
+
+#ifdef MM_INSTANCED_QUADS
+// one instance per segment, drawn as a 4-vertex triangle strip
+#define CORNER float(gl_VertexID)
+#else
+#define CORNER aParams.x
+#endif
+
+// PackedColorVert::SCALE
+const float PACKED_SCALE = 128.0;
+
+varying vec4 vColor;
+varying float vMiddleAlpha;
+// how far along the segment this is, and its length, in rooms
+varying float vDistance;
+varying float vLength;
+
+void main()
+{
+    vec2 corner = vec2(mod(CORNER, 2.0), floor(CORNER * 0.5));
+    vec4 from = uMVP * vec4(aFrom, 1.0);
+    vec4 to = uMVP * vec4(aTo, 1.0);
+
+    // The ends in pixels, which gives the direction of the quad's sides on the screen.
+    vec2 halfViewport = vec2(uPhysViewport.zw) * 0.5;
+    vec2 dir = to.xy / to.w * halfViewport - from.xy / from.w * halfViewport;
+    float len = length(dir);
+    dir = (len > 0.0001) ? dir / len : vec2(1.0, 0.0);
+    vec2 normal = vec2(-dir.y, dir.x);
+
+    vec4 pos = mix(from, to, corner.x);
+    vec2 offset = normal * (corner.y - 0.5) * uLineWidth;
+    pos.xy += offset / halfViewport * pos.w;
+    gl_Position = pos;
+
+    vColor = aColor;
+    vMiddleAlpha = aParams.y / 255.0;
+    vLength = length(aTo - aFrom) / PACKED_SCALE;
+    vDistance = corner.x * vLength;
+}
@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "CompiledSyntax.h"
+
+#include <cassert>
+#include <utility>
+
+#include "../global/utils.h"
+#include "MatchResult.h"
+#include "Value.h"
+
+namespace syntax {
+
+CompiledSyntax::CompiledSyntax(SharedConstSublist root)
+    : m_root{std::move(root)}
+{
+    m_program.emplace_back(); // FAIL_INDEX
+    compile(deref(m_root));
+}
+
+size_t CompiledSyntax::compile(const Sublist &node)
+{
+    // The vector grows while the rest of the list is compiled, so this is filled in last.
+    const size_t index = m_program.size();
+    m_program.emplace_back();
+
+    const size_t rest = [this, &node]() -> size_t {
+        if (!node.hasNextNode()) {
+            Instruction accept;
+            accept.op = OpEnum::ACCEPT;
+            accept.accept = &node.getAcceptFn();
+            m_program.emplace_back(accept);
+            return m_program.size() - 1;
+        }
+        if (const SharedConstSublist &next = node.getNext())
+            return compile(*next);
+        return FAIL_INDEX;
+    }();
+
+    Instruction instruction;
+    if (node.holdsNestedSublist()) {
+        instruction.op = OpEnum::BRANCH;
+        instruction.next = compile(deref(node.getNestedSublist()));
+        instruction.otherwise = rest;
+        ++m_numBranches;
+    } else {
+        instruction.op = OpEnum::MATCH;
+        instruction.token = &node.getTokenMatcher();
+        instruction.next = rest;
+        ++m_numMatches;
+    }
+    m_program[index] = instruction;
+    return index;
+}
+
+bool CompiledSyntax::match(const ParserInput &input, User &user) const
+{
+    struct Alternative final
+    {
+        size_t pc;
+        ParserInput input;
+        const Pair *matchedArgs;
+    };
+
+    // Each instruction runs at most once, so these never reallocate;
+    // that keeps the Pairs in place for the accept function.
+    std::vector<Pair> pairs;
+    pairs.reserve(m_numMatches);
+    std::vector<Alternative> alternatives;
+    alternatives.reserve(m_numBranches);
+
+    size_t pc = FAIL_INDEX + 1;
+    ParserInput current = input;
+    const Pair *matchedArgs = nullptr;
+
+    const auto fail = [&]() -> bool {
+        if (alternatives.empty())
+            return false;
+        // Note: No support for stacking arguments spilled from a list.
+        Alternative &alt = alternatives.back();
+        pc = alt.pc;
+        current = std::move(alt.input);
+        matchedArgs = alt.matchedArgs;
+        alternatives.pop_back();
+        return true;
+    };
+
+    while (true) {
+        const Instruction &instruction = m_program[pc];
+        switch (instruction.op) {
+        case OpEnum::FAIL:
+            if (!fail())
+                return false;
+            break;
+
+        case OpEnum::MATCH: {
+            MatchResult result = instruction.token->tryMatch(current, nullptr);
+            if (!result) {
+                if (!fail())
+                    return false;
+                break;
+            }
+            if (result.optValue) {
+                assert(pairs.size() < pairs.capacity());
+                pairs.emplace_back(std::move(result.optValue.value()), matchedArgs);
+                matchedArgs = &pairs.back();
+            }
+            current = std::move(result.unmatched);
+            pc = instruction.next;
+            break;
+        }
+
+        case OpEnum::BRANCH:
+            alternatives.emplace_back(Alternative{instruction.otherwise, current, matchedArgs});
+            pc = instruction.next;
+            break;
+
+        case OpEnum::ACCEPT:
+            if (!current.empty()) {
+                if (!fail())
+                    return false;
+                break;
+            }
+            instruction.accept->call(user, matchedArgs);
+            return true;
+        }
+    }
+}
+
+} // namespace syntax
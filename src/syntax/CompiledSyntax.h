@@ -0,0 +1,75 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../global/RuleOf5.h"
+#include "../global/StringView.h"
+#include "Accept.h"
+#include "ParserInput.h"
+#include "Sublist.h"
+#include "TokenMatcher.h"
+#include "User.h"
+
+namespace syntax {
+
+// A syntax tree flattened into an array of instructions, so matching it walks
+// the array instead of recursing through the tree's shared pointers. It keeps
+// the tree alive, and can be reused for as long as the tree's accept functions
+// stay valid.
+class CompiledSyntax final
+{
+private:
+    enum class OpEnum : uint8_t {
+        // Nothing matched; resume at the most recent alternative, if any.
+        FAIL,
+        // Match the token, then continue at `next`.
+        MATCH,
+        // Try the nested list at `next`, and resume at `otherwise` if it fails.
+        BRANCH,
+        // Call the accept function if all of the input was matched.
+        ACCEPT
+    };
+
+    struct Instruction final
+    {
+        OpEnum op = OpEnum::FAIL;
+        const TokenMatcher *token = nullptr;
+        const Accept *accept = nullptr;
+        size_t next = 0;
+        size_t otherwise = 0;
+    };
+
+    // The FAIL that every list without an accept function ends in.
+    static constexpr const size_t FAIL_INDEX = 0;
+
+    SharedConstSublist m_root;
+    std::vector<Instruction> m_program;
+    size_t m_numMatches = 0;
+    size_t m_numBranches = 0;
+
+public:
+    explicit CompiledSyntax(SharedConstSublist root);
+    DELETE_CTORS_AND_ASSIGN_OPS(CompiledSyntax);
+
+public:
+    const SharedConstSublist &getRoot() const { return m_root; }
+    // Calls the accept function of the first path that matches all of the input,
+    // in the same order as the tree is walked for help.
+    bool match(const ParserInput &input, User &user) const;
+
+private:
+    size_t compile(const Sublist &node);
+};
+
+// Same as processSyntax() for the tree, but reuses the compiled syntax.
+std::string processSyntax(const std::shared_ptr<const CompiledSyntax> &syntax,
+                          const std::string &name,
+                          const StringView &args);
+
+} // namespace syntax
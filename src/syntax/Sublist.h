@@ -15,11 +15,13 @@ namespace syntax {
 
 class Sublist;
 using SharedConstSublist = std::shared_ptr<const Sublist>;
+class CompiledSyntax;
 class TreeParser;
 
 class Sublist final
 {
 private:
+    friend class CompiledSyntax;
     friend class TreeParser;
 
     using Car = std::variant<TokenMatcher, SharedConstSublist>;
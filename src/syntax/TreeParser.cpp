@@ -16,10 +16,17 @@
 namespace syntax {
 
 TreeParser::TreeParser(SharedConstSublist syntaxRoot, User &user)
-    : m_syntaxRoot(std::move(syntaxRoot))
-    , m_user{user}
+    : TreeParser(std::make_shared<const CompiledSyntax>(std::move(syntaxRoot)), user)
 {}
 
+TreeParser::TreeParser(std::shared_ptr<const CompiledSyntax> syntax, User &user)
+    : m_syntax(std::move(syntax))
+    , m_user{user}
+{
+    if (m_syntax == nullptr)
+        throw NullPointerException();
+}
+
 bool TreeParser::parse(const ParserInput &input)
 {
     if (syntaxOnly(input))
@@ -49,73 +56,7 @@ bool TreeParser::parse(const ParserInput &input)
 
 bool TreeParser::syntaxOnly(const ParserInput &input)
 {
-    const Sublist &node = deref(m_syntaxRoot);
-    return syntaxRecurseFirst(node, input, nullptr).isSuccess();
-}
-
-ParseResult TreeParser::syntaxRecurseFirst(const Sublist &node,
-                                           const ParserInput &input,
-                                           const Pair *const matchedArgs)
-{
-    if (node.holdsNestedSublist()) {
-        return recurseNewSublist(node, input, matchedArgs);
-    } else {
-        return recurseTokenMatcher(node, input, matchedArgs);
-    }
-}
-
-ParseResult TreeParser::recurseNewSublist(const Sublist &node,
-                                          const ParserInput &input,
-                                          const Pair *const matchedArgs)
-{
-    ParseResult tmp = syntaxRecurseFirst(deref(node.getNestedSublist()), input, matchedArgs);
-    if (tmp.isSuccess()) {
-        return tmp;
-    }
-
-    // Note: No support for stacking arguments spilled from a list.
-    return syntaxRecurseNext(node, input, matchedArgs);
-}
-
-ParseResult TreeParser::recurseTokenMatcher(const Sublist &node,
-                                            const ParserInput &input,
-                                            const Pair *const matchedArgs)
-{
-    MatchResult tmp = node.getTokenMatcher().tryMatch(input, nullptr);
-    if (!tmp) {
-        return ParseResult::failure(input);
-    }
-
-    if (!tmp.optValue) {
-        return syntaxRecurseNext(node, tmp.unmatched, matchedArgs);
-    }
-
-    const Pair p{tmp.optValue.value(), matchedArgs};
-    return syntaxRecurseNext(node, tmp.unmatched, &p);
-}
-
-ParseResult TreeParser::syntaxRecurseNext(const Sublist &node,
-                                          const ParserInput &input,
-                                          const Pair *const matchedArgs)
-{
-    if (!node.hasNextNode())
-        return recurseAccept(node, input, matchedArgs);
-
-    if (const SharedConstSublist &tmp = node.getNext())
-        return syntaxRecurseFirst(deref(tmp), input, matchedArgs);
-
-    return ParseResult::failure(input);
-}
-
-ParseResult TreeParser::recurseAccept(const Sublist &node,
-                                      const ParserInput &input,
-                                      const Pair *matchedArgs)
-{
-    if (!input.empty())
-        return ParseResult::failure(input);
-
-    node.getAcceptFn().call(m_user, matchedArgs);
-    return ParseResult::success(input);
+    return m_syntax->match(input, m_user);
 }
 
 struct HelpFrame final : IMatchErrorLogger
@@ -391,7 +332,7 @@ ParseResult TreeParser::HelpCommon::recurseAccept(const Sublist &node,
 
 void TreeParser::help(const ParserInput &input, bool isFull)
 {
-    const Sublist &node = deref(m_syntaxRoot);
+    const Sublist &node = deref(m_syntax->getRoot());
     HelpFrame frame{m_user.getOstream()};
     HelpCommon{isFull}.syntaxRecurseFirst(node, input, frame).isSuccess();
 }
@@ -399,6 +340,13 @@ void TreeParser::help(const ParserInput &input, bool isFull)
 std::string processSyntax(const syntax::SharedConstSublist &syntax,
                           const std::string &name,
                           const StringView &args)
+{
+    return processSyntax(std::make_shared<const CompiledSyntax>(syntax), name, args);
+}
+
+std::string processSyntax(const std::shared_ptr<const CompiledSyntax> &syntax,
+                          const std::string &name,
+                          const StringView &args)
 {
     using namespace syntax;
 
@@ -8,6 +8,7 @@
 #include <variant>
 
 #include "../global/NullPointerException.h"
+#include "CompiledSyntax.h"
 #include "ParserInput.h"
 #include "Sublist.h"
 #include "TokenMatcher.h"
@@ -20,33 +21,18 @@ enum class MatchTypeEnum { Fail, Partial, Pass };
 class TreeParser final
 {
 private:
-    const SharedConstSublist m_syntaxRoot;
+    const std::shared_ptr<const CompiledSyntax> m_syntax;
     User &m_user;
 
 public:
     explicit TreeParser(SharedConstSublist syntaxRoot, User &user);
+    explicit TreeParser(std::shared_ptr<const CompiledSyntax> syntax, User &user);
 
     bool parse(const ParserInput &input);
 
 private:
     bool syntaxOnly(const ParserInput &input);
 
-    ParseResult syntaxRecurseFirst(const Sublist &node,
-                                   const ParserInput &input,
-                                   const Pair *matchedArgs);
-    ParseResult recurseNewSublist(const Sublist &node,
-                                  const ParserInput &input,
-                                  const Pair *matchedArgs);
-    ParseResult recurseTokenMatcher(const Sublist &node,
-                                    const ParserInput &input,
-                                    const Pair *matchedArgs);
-    ParseResult syntaxRecurseNext(const Sublist &node,
-                                  const ParserInput &input,
-                                  const Pair *matchedArgs);
-    ParseResult recurseAccept(const Sublist &node,
-                              const ParserInput &input,
-                              const Pair *matchedArgs);
-
 private:
     class HelpCommon;
     void help(const ParserInput &input, bool isFull);
@@ -0,0 +1,425 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// Micro-benchmarks for the string utilities and the map's core data
+// structures, run on a synthetic map (see BenchMapGenerator.h), and printed as
+// JSON:
+//
+//   BenchCore [--rooms N] [--seed N] [--samples N] [--only NAME] [--output results.json]
+//
+// Every benchmark repeats its work until a sample takes at least 20 ms, and
+// reports the median and the fastest of the samples in nanoseconds per
+// operation. The benchmarks and their fields are always written in the same
+// order, and each one's checksum only depends on the seed and the map size, so
+// results can be diffed between builds. --only runs the benchmarks whose names
+// contain NAME.
+//
+// This isn't run by ctest; the timings are only meaningful in a release build.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+#include <QApplication>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+
+#include "../src/expandoracommon/coordinate.h"
+#include "../src/expandoracommon/exit.h"
+#include "../src/expandoracommon/parseevent.h"
+#include "../src/expandoracommon/room.h"
+#include "../src/global/Debug.h"
+#include "../src/global/StringView.h"
+#include "../src/global/TextUtils.h"
+#include "../src/global/entities.h"
+#include "../src/global/roomid.h"
+#include "../src/global/unquote.h"
+#include "../src/mapdata/ExitDirection.h"
+#include "../src/mapdata/ExitFlags.h"
+#include "../src/mapdata/roomfilter.h"
+#include "../src/mapfrontend/AbstractRoomVisitor.h"
+#include "../src/mapfrontend/ParseTree.h"
+#include "../src/mapfrontend/map.h"
+#include "../src/mapfrontend/roomcollection.h"
+#include "BenchMapGenerator.h"
+#include "BenchUtils.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Every benchmark returns a checksum of what it computed, which ends up here,
+// so the compiler can't drop the work.
+volatile size_t g_sink = 0;
+
+struct NODISCARD BenchOptions final
+{
+    int samples = 9;
+    QString only;
+};
+
+/// Times `fn`, which does `opsPerCall` operations per call and returns a checksum.
+template<typename F>
+void measure(QJsonArray &results,
+             const BenchOptions &options,
+             const char *const name,
+             const size_t opsPerCall,
+             F &&fn)
+{
+    static constexpr const auto MIN_SAMPLE = std::chrono::milliseconds(20);
+    if (!options.only.isEmpty() && !QString(name).contains(options.only))
+        return;
+
+    // The first call warms the caches and gives the checksum.
+    auto start = Clock::now();
+    const size_t checksum = fn();
+    auto elapsed = Clock::now() - start;
+
+    size_t calls = 1;
+    while (elapsed < MIN_SAMPLE) {
+        calls *= 2;
+        start = Clock::now();
+        for (size_t i = 0; i < calls; ++i)
+            g_sink += fn();
+        elapsed = Clock::now() - start;
+    }
+
+    std::vector<double> nsPerOp;
+    for (int s = 0; s < options.samples; ++s) {
+        start = Clock::now();
+        for (size_t i = 0; i < calls; ++i)
+            g_sink += fn();
+        const std::chrono::duration<double, std::nano> ns = Clock::now() - start;
+        const auto ops = static_cast<double>(calls * std::max<size_t>(1, opsPerCall));
+        nsPerOp.emplace_back(ns.count() / ops);
+    }
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+
+    QJsonObject result;
+    result["name"] = name;
+    result["opsPerCall"] = static_cast<qint64>(opsPerCall);
+    result["callsPerSample"] = static_cast<qint64>(calls);
+    result["medianNsPerOp"] = nsPerOp[nsPerOp.size() / 2];
+    result["minNsPerOp"] = nsPerOp.front();
+    result["checksum"] = QString::number(static_cast<qulonglong>(checksum));
+    results.append(result);
+    std::fprintf(stderr, "%-32s %12.1f ns/op\n", name, nsPerOp[nsPerOp.size() / 2]);
+}
+
+class NODISCARD CountingVisitor final : public AbstractRoomVisitor
+{
+public:
+    size_t count = 0;
+    uint64_t idSum = 0;
+
+public:
+    void visit(const Room *const room) override
+    {
+        ++count;
+        idSum += room->getId().asUint32();
+    }
+};
+
+/// What the benchmarks run on; built once, before any timing.
+struct NODISCARD BenchData final
+{
+    RoomModificationTracker tracker;
+    std::vector<SharedRoom> rooms;
+    std::vector<SharedParseEvent> events;
+    RoomIndex roomIndex;
+    std::vector<RoomId> shuffledIds;
+
+    // Room text as it arrives from MUME, and the commands users type.
+    std::vector<std::string> descLines;
+    std::vector<QString> ansiText;
+    std::vector<entities::DecodedUnicode> decoded;
+    std::vector<entities::EncodedLatin1> encoded;
+    std::vector<std::string> commands;
+
+    BenchData(const uint32_t seed, const uint32_t numRooms)
+    {
+        MapGenerator generator{seed, numRooms};
+        rooms = generator.makeRooms(tracker, numRooms);
+
+        roomIndex.resize(numRooms);
+        for (const SharedRoom &room : rooms) {
+            roomIndex[room->getId()] = room;
+            events.emplace_back(Room::getEvent(room.get()));
+        }
+
+        shuffledIds.resize(numRooms);
+        for (uint32_t i = 0; i < numRooms; ++i)
+            shuffledIds[i] = RoomId{i};
+        std::shuffle(shuffledIds.begin(), shuffledIds.end(), std::mt19937{seed});
+
+        static const char *const colors[] = {"\x1b[32m", "\x1b[1;33m", "\x1b[0;36;40m"};
+        const size_t numTexts = std::min<size_t>(rooms.size(), 1000);
+        for (size_t i = 0; i < numTexts; ++i) {
+            const Room &room = *rooms[i];
+            QString desc = room.getStaticDescription().toQString();
+            for (const QString &line : desc.split('\n', QString::SkipEmptyParts))
+                descLines.emplace_back(line.toStdString());
+            // Some of MUME's text is Latin-1, and some needs escaping for XML.
+            const QString text = room.getName().toQString() + " <Éowyn & Théoden> "
+                                 + desc.left(120);
+            if (i % 2 != 0)
+                desc.replace("\n", "\n\t");
+            ansiText.emplace_back(colors[i % std::size(colors)] + room.getName().toQString()
+                                  + "\x1b[0m\n" + desc);
+            decoded.emplace_back(entities::DecodedUnicode{text});
+            encoded.emplace_back(entities::encode(decoded.back()));
+        }
+
+        commands = {"mark add text \"The Fountain Square\" 'north gate'",
+                    "room set note \"beware of the trolls\"",
+                    "group tell 'meet at \\\"the prancing pony\\\"'",
+                    "search note troll",
+                    "doorname 'hidden hatch' down",
+                    "config map colors set background #000000"};
+    }
+};
+
+void benchStrings(QJsonArray &results, const BenchOptions &options, const BenchData &data)
+{
+    measure(results, options, "StringView::getWords", data.descLines.size(), [&data]() {
+        size_t sum = 0;
+        for (const std::string &line : data.descLines)
+            for (const StringView &word : StringView{line}.getWords())
+                sum += word.size();
+        return sum;
+    });
+    measure(results, options, "StringView::takeFirstWord", data.descLines.size(), [&data]() {
+        size_t sum = 0;
+        for (const std::string &line : data.descLines) {
+            StringView view{line};
+            while (!view.trim().isEmpty())
+                sum += view.takeFirstWord().size();
+        }
+        return sum;
+    });
+    measure(results, options, "TextUtils::normalizeAnsi", data.ansiText.size(), [&data]() {
+        size_t sum = 0;
+        for (const QString &text : data.ansiText)
+            sum += static_cast<size_t>(normalizeAnsi(text).length());
+        return sum;
+    });
+    measure(results, options, "TextUtils::measureExpandedTabs", data.ansiText.size(), [&data]() {
+        size_t sum = 0;
+        for (const QString &text : data.ansiText)
+            sum += static_cast<size_t>(measureExpandedTabsMultiline(text));
+        return sum;
+    });
+    measure(results, options, "TextUtils::containsAnsi", data.ansiText.size(), [&data]() {
+        size_t sum = 0;
+        for (const QString &text : data.ansiText)
+            sum += containsAnsi(text) ? 1 : 0;
+        return sum;
+    });
+    measure(results, options, "entities::encode", data.decoded.size(), [&data]() {
+        size_t sum = 0;
+        for (const entities::DecodedUnicode &text : data.decoded)
+            sum += static_cast<size_t>(entities::encode(text).size());
+        return sum;
+    });
+    measure(results, options, "entities::decode", data.encoded.size(), [&data]() {
+        size_t sum = 0;
+        for (const entities::EncodedLatin1 &text : data.encoded)
+            sum += static_cast<size_t>(entities::decode(text).size());
+        return sum;
+    });
+    measure(results, options, "unquote", data.commands.size(), [&data]() {
+        size_t sum = 0;
+        for (const std::string &command : data.commands) {
+            const UnquoteResult result = unquote(command, false, false);
+            if (result)
+                sum += result.getVectorOfStrings().size();
+        }
+        return sum;
+    });
+}
+
+void benchRooms(QJsonArray &results, const BenchOptions &options, BenchData &data)
+{
+    const size_t numRooms = data.rooms.size();
+    const size_t numExits = numRooms * NUM_EXITS_NESWUD;
+
+    measure(results, options, "Flags::contains/count", numExits, [&data]() {
+        size_t sum = 0;
+        for (const SharedRoom &room : data.rooms) {
+            const ExitsList &exits = room->getExitsList();
+            for (const ExitDirEnum dir : ALL_EXITS_NESWUD) {
+                const ExitFlags flags = exits[dir].getExitFlags();
+                sum += flags.count() + (flags.contains(ExitFlagEnum::DOOR) ? 8 : 0)
+                       + ((flags | ExitFlagEnum::ROAD).containsAll(ExitFlags{ExitFlagEnum::EXIT})
+                              ? 1
+                              : 0);
+            }
+        }
+        return sum;
+    });
+    measure(results, options, "roomid_vector::tryGet", numRooms, [&data]() {
+        size_t sum = 0;
+        for (const RoomId id : data.shuffledIds)
+            if (const SharedRoom *const room = data.roomIndex.tryGet(id))
+                sum += (*room)->getPosition().x;
+        return sum;
+    });
+    measure(results, options, "RoomCollection", numRooms, [&data]() {
+        // Mostly one or two rooms per collection, like the parse tree, and
+        // now and then more than fit inline.
+        static constexpr const size_t SIZES[] = {1, 1, 2, 1, 1, 3, 1, 6};
+        size_t sum = 0;
+        size_t next = 0;
+        RoomCollection collection;
+        for (size_t i = 0; i < data.rooms.size(); ++i) {
+            collection.addRoom(data.rooms[i]);
+            if (collection.size() < SIZES[next % std::size(SIZES)])
+                continue;
+            ++next;
+            sum += collection.contains(data.rooms[i]->getId()) ? 1 : 0;
+            collection.forEachRoom(data.roomIndex,
+                                   [&sum](const Room *room) { sum += room->getId().asUint32(); });
+            collection.clear();
+        }
+        return sum;
+    });
+    measure(results, options, "Room::compare (same room)", numRooms, [&data]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < data.rooms.size(); ++i)
+            sum += static_cast<size_t>(Room::compare(data.rooms[i].get(), *data.events[i], 8));
+        return sum;
+    });
+    measure(results, options, "Room::compare (other room)", numRooms, [&data]() {
+        size_t sum = 0;
+        const size_t n = data.rooms.size();
+        for (size_t i = 0; i < n; ++i)
+            sum += static_cast<size_t>(
+                Room::compare(data.rooms[i].get(), *data.events[(i + 1) % n], 8));
+        return sum;
+    });
+
+    const RoomFilter byName{"gate", Qt::CaseInsensitive, PatternKindsEnum::NAME};
+    const RoomFilter byDesc{"dorfal", Qt::CaseInsensitive, PatternKindsEnum::DESC};
+    const RoomFilter byFlags{"door", Qt::CaseInsensitive, PatternKindsEnum::FLAGS};
+    const RoomFilter byAll{"Tower", Qt::CaseSensitive, PatternKindsEnum::ALL};
+    for (const auto &[name, filter] : {std::pair{"RoomFilter::filter (name)", &byName},
+                                       std::pair{"RoomFilter::filter (desc)", &byDesc},
+                                       std::pair{"RoomFilter::filter (flags)", &byFlags},
+                                       std::pair{"RoomFilter::filter (all)", &byAll}}) {
+        measure(results, options, name, numRooms, [&data, f = filter]() {
+            size_t sum = 0;
+            for (const SharedRoom &room : data.rooms)
+                sum += f->filter(room.get()) ? 1 : 0;
+            return sum;
+        });
+    }
+}
+
+void benchMapStructures(QJsonArray &results, const BenchOptions &options, BenchData &data)
+{
+    const size_t numRooms = data.rooms.size();
+
+    measure(results, options, "ParseTree::insertRoom", numRooms, [&data]() {
+        ParseTree tree;
+        size_t sum = 0;
+        for (size_t i = 0; i < data.rooms.size(); ++i) {
+            const SharedRoomCollection collection = tree.insertRoom(*data.events[i]);
+            collection->addRoom(data.rooms[i]);
+            sum += collection->size();
+        }
+        return sum;
+    });
+
+    ParseTree tree;
+    for (size_t i = 0; i < numRooms; ++i)
+        tree.insertRoom(*data.events[i])->addRoom(data.rooms[i]);
+    measure(results, options, "ParseTree::getRooms", numRooms, [&data, &tree]() {
+        CountingVisitor visitor;
+        for (const SharedParseEvent &event : data.events)
+            tree.getRooms(data.roomIndex, visitor, *event);
+        return visitor.count + visitor.idSum;
+    });
+
+    measure(results, options, "Map::setNearest", numRooms, [&data]() {
+        Map map;
+        size_t sum = 0;
+        for (const SharedRoom &room : data.rooms)
+            sum += static_cast<size_t>(map.setNearest(room->getPosition(), *room).x);
+        return sum;
+    });
+
+    Map map;
+    for (const SharedRoom &room : data.rooms)
+        map.setNearest(room->getPosition(), *room);
+    // Every other lookup misses, above the map.
+    measure(results, options, "Map::get", numRooms * 2, [&data, &map]() {
+        size_t sum = 0;
+        for (const RoomId id : data.shuffledIds) {
+            const Coordinate &pos = data.roomIndex[id]->getPosition();
+            if (const Room *const room = map.get(pos))
+                sum += room->getId().asUint32();
+            if (map.get(Coordinate{pos.x, pos.y, pos.z + 100}) != nullptr)
+                ++sum;
+        }
+        return sum;
+    });
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    setEnteredMain();
+    QApplication app(argc, argv);
+
+    uint32_t numRooms = 10000;
+    uint32_t seed = 1;
+    BenchOptions options;
+    QString output;
+    const QStringList args = QApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--rooms" && hasValue) {
+            numRooms = std::max(1u, args.at(++i).toUInt());
+        } else if (arg == "--seed" && hasValue) {
+            seed = args.at(++i).toUInt();
+        } else if (arg == "--samples" && hasValue) {
+            options.samples = std::max(1, args.at(++i).toInt());
+        } else if (arg == "--only" && hasValue) {
+            options.only = args.at(++i);
+        } else if (arg == "--output" && hasValue) {
+            output = args.at(++i);
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--rooms N] [--seed N] [--samples N] [--only NAME] "
+                         "[--output FILE]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    BenchData data{seed, numRooms};
+    QJsonArray results;
+    benchStrings(results, options, data);
+    benchRooms(results, options, data);
+    benchMapStructures(results, options, data);
+
+    QJsonObject doc;
+    doc["qtVersion"] = qVersion();
+    doc["debugBuild"] = IS_DEBUG_BUILD;
+    doc["rooms"] = static_cast<qint64>(numRooms);
+    doc["seed"] = static_cast<qint64>(seed);
+    doc["samples"] = options.samples;
+    doc["results"] = results;
+    return writeBenchResults(doc, output);
+}
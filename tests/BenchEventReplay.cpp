@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// Loads a map, replays an event capture (see EventCapture.h) against a
+// headless path machine, and prints throughput, how often the replay settled
+// on the same room as the recorded session, and the path machine statistics:
+//
+//   BenchEventReplay [--check-pruning] <map.mm2> <capture>
+//
+// The capture is recorded by setting MMAPPER_CAPTURE_EVENTS=<capture> during a
+// normal session. The map should be the one that was loaded when the capture
+// was recorded; the capture does not include edits made to the map during the
+// session. The exit status is nonzero if the final room differs. This isn't
+// run by ctest; it needs a capture.
+//
+// --check-pruning replays the capture again on a freshly loaded map, with the
+// path machine keeping every fork until it evaluates them, and fails (with
+// status 3) unless the same paths survived every event both times.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+#include "../src/configuration/configuration.h"
+#include "../src/global/macros.h"
+#include "../src/global/roomid.h"
+#include "../src/headless/HeadlessMapper.h"
+#include "../src/mapdata/mapdata.h"
+#include "../src/mapstorage/mapstorage.h"
+#include "../src/pathmachine/EventCapture.h"
+#include "../src/pathmachine/mmapper2pathmachine.h"
+#include "../src/pathmachine/pathmachinestats.h"
+
+namespace {
+
+using PathSummary = std::vector<std::pair<RoomId, double>>;
+
+struct NODISCARD Replay final
+{
+    uint64_t numEvents = 0;
+    uint64_t numAgreed = 0;
+    bool lastAgreed = true;
+    qint64 elapsedNs = 0;
+    // The surviving paths after each event, if they were asked for.
+    std::vector<PathSummary> paths;
+};
+
+// Prints what went wrong and returns nothing if the map or the capture can't be read.
+std::optional<Replay> replay(QTextStream &out,
+                             const QString &mapFileName,
+                             const QString &captureFileName,
+                             const bool pruneForks,
+                             const bool recordPaths)
+{
+    MapData mapData;
+    {
+        QFile mapFile(mapFileName);
+        if (!mapFile.open(QFile::ReadOnly)) {
+            out << "Cannot read map " << mapFileName << ": " << mapFile.errorString() << "\n";
+            return std::nullopt;
+        }
+        MapStorage storage(mapData, mapFileName, &mapFile);
+        if (!storage.canLoad() || !storage.loadData()) {
+            out << "Failed to load map " << mapFileName << "\n";
+            return std::nullopt;
+        }
+    }
+
+    QFile captureFile(captureFileName);
+    if (!captureFile.open(QFile::ReadOnly)) {
+        out << "Cannot read capture " << captureFileName << ": " << captureFile.errorString()
+            << "\n";
+        return std::nullopt;
+    }
+
+    Mmapper2PathMachine pathMachine(&mapData, nullptr);
+    connectPathMachine(pathMachine, mapData);
+    pathMachine.setPruneForks(pruneForks);
+    getPathMachineStats().reset();
+
+    Replay result;
+    try {
+        EventCaptureReader reader(captureFile);
+        QElapsedTimer timer;
+        while (const auto record = reader.next()) {
+            timer.start();
+            switch (record->type) {
+            case CaptureRecordEnum::EVENT:
+                pathMachine.event(SigParseEvent{record->event});
+                break;
+            case CaptureRecordEnum::SET_CURRENT_ROOM:
+                pathMachine.setCurrentRoom(record->room, record->update);
+                break;
+            case CaptureRecordEnum::RELEASE_ALL_PATHS:
+                pathMachine.releaseAllPaths();
+                break;
+            }
+            result.elapsedNs += timer.nsecsElapsed();
+
+            if (record->type == CaptureRecordEnum::EVENT) {
+                ++result.numEvents;
+                result.lastAgreed = pathMachine.getCurrentRoomId() == record->room;
+                if (result.lastAgreed)
+                    ++result.numAgreed;
+                if (recordPaths)
+                    result.paths.emplace_back(pathMachine.getPathSummary());
+            }
+        }
+    } catch (const std::exception &ex) {
+        out << "Error reading capture " << captureFileName << ": " << ex.what() << "\n";
+        return std::nullopt;
+    }
+    return result;
+}
+
+int runEventReplay(const QString &mapFileName,
+                   const QString &captureFileName,
+                   const bool checkPruning)
+{
+    QTextStream out(stdout);
+
+    const auto pruned = replay(out, mapFileName, captureFileName, true, checkPruning);
+    if (!pruned.has_value())
+        return 1;
+
+    const double seconds = static_cast<double>(pruned->elapsedNs) / 1e9;
+    out << "Replayed " << pruned->numEvents << " events in "
+        << QString::number(seconds * 1000.0, 'f', 1) << " ms";
+    if (seconds > 0.0)
+        out << " (" << QString::number(static_cast<double>(pruned->numEvents) / seconds, 'f', 0)
+            << " events/s)";
+    out << "\n";
+    out << "Agreed with the recorded room on " << pruned->numAgreed << " of " << pruned->numEvents
+        << " events; final room " << (pruned->lastAgreed ? "agrees" : "DIFFERS") << "\n";
+    out << getPathMachineStats().toReport().replace("\r\n", "\n");
+    out.flush();
+
+    if (checkPruning) {
+        const auto unpruned = replay(out, mapFileName, captureFileName, false, true);
+        if (!unpruned.has_value())
+            return 1;
+        const auto mismatch = std::mismatch(pruned->paths.begin(),
+                                            pruned->paths.end(),
+                                            unpruned->paths.begin(),
+                                            unpruned->paths.end());
+        if (mismatch.first != pruned->paths.end() || mismatch.second != unpruned->paths.end()) {
+            out << "Pruning changed the surviving paths after event "
+                << (mismatch.first - pruned->paths.begin() + 1) << "\n";
+            return 3;
+        }
+        out << "Pruning kept the same paths after all " << pruned->numEvents << " events\n";
+    }
+
+    return pruned->lastAgreed ? 0 : 2;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    setEnteredMain();
+    QApplication app(argc, argv);
+
+    QStringList args = QApplication::arguments();
+    const bool checkPruning = args.size() > 1 && args.at(1) == "--check-pruning";
+    if (checkPruning)
+        args.removeAt(1);
+    if (args.size() != 3) {
+        std::fprintf(stderr, "usage: %s [--check-pruning] <map.mm2> <capture>\n", argv[0]);
+        return 2;
+    }
+    return runEventReplay(args.at(1), args.at(2), checkPruning);
+}
@@ -0,0 +1,191 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+#include <QString>
+
+#include "../src/expandoracommon/exit.h"
+#include "../src/expandoracommon/room.h"
+#include "../src/global/macros.h"
+#include "../src/global/roomid.h"
+#include "../src/mapdata/DoorFlags.h"
+#include "../src/mapdata/ExitDirection.h"
+#include "../src/mapdata/ExitFlags.h"
+#include "../src/mapdata/mapdata.h"
+#include "../src/mapdata/mmapper2room.h"
+
+/// Deterministic map contents with roughly the shape of the MUME map: names
+/// repeat a lot, many descriptions are shared by whole areas, notes and dynamic
+/// descriptions are rare, and most rooms have two to four exits.
+class NODISCARD MapGenerator final
+{
+private:
+    std::mt19937 m_rng;
+    std::vector<QString> m_words;
+    std::vector<QString> m_names;
+    std::vector<QString> m_sharedDescs;
+    std::vector<QString> m_doorNames;
+
+public:
+    explicit MapGenerator(const uint32_t seed, const uint32_t numRooms)
+        : m_rng{seed}
+    {
+        static const char *const syllables[] = {"an", "dor", "el", "fal", "gor", "hal", "is",
+                                                "kar", "lin", "mor", "nen", "or", "ras", "sil",
+                                                "tin", "ur", "val", "wen", "yr", "zal"};
+        static const char *const nouns[] = {"Path", "Road", "Forest", "Hall", "Cave", "River",
+                                            "Field", "Tunnel", "Square", "Bridge", "Ruins",
+                                            "Hill", "Marsh", "Gate", "Tower", "Clearing"};
+        for (int i = 0; i < 2000; ++i) {
+            QString word;
+            const int n = 1 + static_cast<int>(next(3));
+            for (int k = 0; k < n; ++k)
+                word += syllables[next(std::size(syllables))];
+            m_words.emplace_back(word);
+        }
+        const size_t numNames = std::max<size_t>(64, numRooms / 20);
+        for (size_t i = 0; i < numNames; ++i) {
+            QString name = pick(m_words);
+            name[0] = name[0].toUpper();
+            m_names.emplace_back(name + " " + nouns[next(std::size(nouns))]);
+        }
+        const size_t numShared = std::max<size_t>(32, numRooms / 50);
+        for (size_t i = 0; i < numShared; ++i)
+            m_sharedDescs.emplace_back(makeDescription());
+        for (const char *const door : {"door", "gate", "hatch", "grille", "boulder", "trapdoor"})
+            m_doorNames.emplace_back(door);
+    }
+
+public:
+    NODISCARD uint32_t next(const size_t n)
+    {
+        return std::uniform_int_distribution<uint32_t>(0, static_cast<uint32_t>(n - 1))(m_rng);
+    }
+    NODISCARD bool chance(const double p) { return std::bernoulli_distribution(p)(m_rng); }
+    NODISCARD const QString &pick(const std::vector<QString> &v) { return v[next(v.size())]; }
+
+    NODISCARD QString makeDescription()
+    {
+        QString desc;
+        const int lines = 3 + static_cast<int>(next(4));
+        for (int l = 0; l < lines; ++l) {
+            QString line;
+            while (line.size() < 70)
+                line += (line.isEmpty() ? "" : " ") + pick(m_words);
+            desc += line + "\n";
+        }
+        return desc;
+    }
+
+    NODISCARD RoomTerrainEnum makeTerrain()
+    {
+        static const RoomTerrainEnum common[] = {RoomTerrainEnum::FIELD,
+                                                 RoomTerrainEnum::FOREST,
+                                                 RoomTerrainEnum::FOREST,
+                                                 RoomTerrainEnum::ROAD,
+                                                 RoomTerrainEnum::INDOORS,
+                                                 RoomTerrainEnum::CITY,
+                                                 RoomTerrainEnum::HILLS,
+                                                 RoomTerrainEnum::MOUNTAINS,
+                                                 RoomTerrainEnum::TUNNEL,
+                                                 RoomTerrainEnum::CAVERN,
+                                                 RoomTerrainEnum::BRUSH,
+                                                 RoomTerrainEnum::SHALLOW,
+                                                 RoomTerrainEnum::WATER};
+        return common[next(std::size(common))];
+    }
+
+    // Rooms sit on a square grid per layer; each has an exit to its east and
+    // south neighbours with 70% probability, and an occasional way up.
+    NODISCARD std::vector<SharedRoom> makeRooms(RoomModificationTracker &tracker,
+                                                 const uint32_t numRooms)
+    {
+        const uint32_t numLayers = std::max<uint32_t>(1, std::min<uint32_t>(8, numRooms / 20000));
+        const uint32_t perLayer = (numRooms + numLayers - 1) / numLayers;
+        const auto width = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(perLayer))));
+
+        std::vector<SharedRoom> rooms;
+        rooms.reserve(numRooms);
+        std::vector<ExitsList> exits(numRooms);
+        for (uint32_t i = 0; i < numRooms; ++i) {
+            const SharedRoom room = Room::createPermanentRoom(tracker);
+            room->setId(RoomId{i});
+            const uint32_t layer = i / perLayer;
+            const uint32_t cell = i % perLayer;
+            room->setPosition(Coordinate{static_cast<int>(cell % width),
+                                         static_cast<int>(cell / width),
+                                         static_cast<int>(layer)});
+            room->setName(RoomName{pick(m_names)});
+            room->setStaticDescription(
+                RoomStaticDesc{chance(0.4) ? pick(m_sharedDescs) : makeDescription()});
+            if (chance(0.1))
+                room->setDynamicDescription(RoomDynamicDesc{pick(m_words) + " is here.\n"});
+            if (chance(0.02))
+                room->setNote(RoomNote{"Note: " + pick(m_words) + " " + pick(m_words)});
+            room->setTerrainType(makeTerrain());
+            room->setLightType(chance(0.8) ? RoomLightEnum::LIT : RoomLightEnum::DARK);
+            room->setAlignType(static_cast<RoomAlignEnum>(1 + next(NUM_ALIGN_TYPES - 1)));
+            room->setPortableType(chance(0.95) ? RoomPortableEnum::PORTABLE
+                                               : RoomPortableEnum::NOT_PORTABLE);
+            room->setRidableType(chance(0.9) ? RoomRidableEnum::RIDABLE
+                                             : RoomRidableEnum::NOT_RIDABLE);
+            room->setSundeathType(RoomSundeathEnum::NO_SUNDEATH);
+            if (chance(0.03))
+                room->setMobFlags(RoomMobFlags{static_cast<RoomMobFlagEnum>(
+                    next(NUM_ROOM_MOB_FLAGS))});
+            room->setUpToDate();
+            rooms.emplace_back(room);
+        }
+
+        const auto connect = [this, &exits](const uint32_t from,
+                                            const ExitDirEnum dir,
+                                            const uint32_t to) {
+            Exit &out = exits[from][dir];
+            Exit &back = exits[to][opposite(dir)];
+            if (chance(0.04)) {
+                const DoorName name{pick(m_doorNames)};
+                for (Exit *const e : {&out, &back}) {
+                    e->setExitFlags(ExitFlags{ExitFlagEnum::EXIT} | ExitFlagEnum::DOOR);
+                    e->setDoorFlags(chance(0.3) ? DoorFlags{DoorFlagEnum::HIDDEN} : DoorFlags{});
+                    e->setDoorName(name);
+                }
+            } else {
+                out.setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+                back.setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+            }
+            out.addOut(RoomId{to});
+            back.addIn(RoomId{from});
+            back.addOut(RoomId{from});
+            out.addIn(RoomId{to});
+        };
+        for (uint32_t i = 0; i < numRooms; ++i) {
+            const uint32_t cell = i % perLayer;
+            const uint32_t layerEnd = std::min(numRooms, (i / perLayer + 1) * perLayer);
+            if (cell % width + 1 < width && i + 1 < layerEnd && chance(0.7))
+                connect(i, ExitDirEnum::EAST, i + 1);
+            if (i + width < layerEnd && chance(0.7))
+                connect(i, ExitDirEnum::SOUTH, i + width);
+            if (i + perLayer < numRooms && chance(0.01))
+                connect(i, ExitDirEnum::UP, i + perLayer);
+        }
+        for (uint32_t i = 0; i < numRooms; ++i)
+            rooms[i]->setExitsList(exits[i]);
+        return rooms;
+    }
+
+    void generate(MapData &mapData, const uint32_t numRooms)
+    {
+        const std::vector<SharedRoom> rooms = makeRooms(mapData, numRooms);
+        {
+            MapFrontendBlocker blocker(mapData);
+            mapData.insertPredefinedRooms(rooms);
+        }
+        mapData.checkSize();
+    }
+};
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// Renders a map without a window, using the same meshes and shaders as the
+// map canvas, and either times a few standard views or writes the whole map
+// out as image tiles:
+//
+//   BenchMapRendering [--map FILE] [--size WxH] [--frames N] [--output results.json]
+//   BenchMapRendering [--map FILE] --tiles DIR [--tile-rooms N] [--tile-pixels N]
+//
+// The default map is the built-in one (if it was compiled in). Tiles are
+// written as DIR/<layer>/<x>_<y>.png, where x and y count tiles of
+// --tile-rooms rooms from the origin; tiles without rooms are skipped.
+//
+// This isn't run by ctest; it needs an OpenGL driver.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <set>
+#include <tuple>
+#include <vector>
+#include <QApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSize>
+#include <QString>
+
+#include "../src/configuration/configuration.h"
+#include "../src/display/OffscreenMapRenderer.h"
+#include "../src/expandoracommon/coordinate.h"
+#include "../src/expandoracommon/room.h"
+#include "../src/global/Debug.h"
+#include "../src/mapdata/MapSnapshot.h"
+#include "../src/mapdata/mapdata.h"
+#include "../src/mapstorage/mapstorage.h"
+#include "BenchUtils.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(const Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool loadMap(MapData &mapData, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    MapStorage storage(mapData, fileName, &file);
+    return storage.loadData();
+}
+
+struct NODISCARD StandardView final
+{
+    const char *name;
+    float zoom;
+};
+
+// One view per level of detail (see Configuration::CanvasSettings).
+const StandardView STANDARD_VIEWS[] = {{"full", 1.f}, {"medium", 0.1f}, {"low", 0.04f}};
+
+QJsonArray benchmarkViews(OffscreenMapRenderer &renderer,
+                          const Bounds &bounds,
+                          const QSize &size,
+                          const int frames)
+{
+    const glm::vec2 center = (bounds.min.to_vec2() + bounds.max.to_vec2()) * 0.5f
+                             + glm::vec2{0.5f};
+    const int layer = std::clamp(0, bounds.min.z, bounds.max.z);
+
+    QJsonArray results;
+    for (const StandardView &standard : STANDARD_VIEWS) {
+        OffscreenMapRenderer::View view;
+        view.center = center;
+        view.layer = layer;
+        view.zoom = standard.zoom;
+        view.size = size;
+
+        // The first frames also upload the glyphs and fill the streaming buffers.
+        for (int i = 0; i < 5; ++i)
+            renderer.render(view);
+        renderer.finish();
+
+        const auto start = Clock::now();
+        for (int i = 0; i < frames; ++i)
+            renderer.render(view);
+        renderer.finish();
+        const double ms = msSince(start);
+
+        QJsonObject result;
+        result["view"] = standard.name;
+        result["zoom"] = static_cast<double>(standard.zoom);
+        result["width"] = size.width();
+        result["height"] = size.height();
+        result["frames"] = frames;
+        result["msPerFrame"] = ms / frames;
+        result["fps"] = ms > 0.0 ? frames * 1000.0 / ms : 0.0;
+        results.append(result);
+    }
+    return results;
+}
+
+int writeTiles(OffscreenMapRenderer &renderer,
+               const MapSnapshot &snapshot,
+               const QDir &dir,
+               const int tileRooms,
+               const int tilePixels)
+{
+    const auto floorDiv = [tileRooms](const int n) -> int {
+        return static_cast<int>(std::floor(static_cast<double>(n) / tileRooms));
+    };
+    std::set<std::tuple<int, int, int>> tiles;
+    snapshot.forEach([&tiles, &floorDiv](const Room &room) {
+        const Coordinate &c = room.getPosition();
+        tiles.emplace(c.z, floorDiv(c.x), floorDiv(c.y));
+    });
+
+    int written = 0;
+    for (const auto &tile : tiles) {
+        const auto [z, x, y] = tile;
+        OffscreenMapRenderer::View view;
+        view.center = glm::vec2{x, y} * static_cast<float>(tileRooms)
+                      + glm::vec2{static_cast<float>(tileRooms) * 0.5f};
+        view.layer = z;
+        view.zoom = static_cast<float>(tilePixels)
+                    / (static_cast<float>(tileRooms) * OffscreenMapRenderer::PIXELS_PER_ROOM);
+        view.size = QSize{tilePixels, tilePixels};
+
+        const QString layerDir = dir.filePath(QString::number(z));
+        QDir().mkpath(layerDir);
+        const QString fileName = QDir(layerDir).filePath(QString("%1_%2.png").arg(x).arg(y));
+        if (!renderer.renderImage(view).save(fileName)) {
+            std::fprintf(stderr, "cannot write %s\n", qPrintable(fileName));
+            return -1;
+        }
+        ++written;
+    }
+    return written;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    setEnteredMain();
+    QApplication app(argc, argv);
+
+    QString mapFile = ":/arda.mm2";
+    QString output;
+    QString tilesDir;
+    QSize size{1024, 768};
+    int frames = 100;
+    int tileRooms = 32;
+    int tilePixels = 256;
+    const QStringList args = QApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--map" && hasValue) {
+            mapFile = args.at(++i);
+        } else if (arg == "--size" && hasValue) {
+            const QStringList wh = args.at(++i).split('x');
+            if (wh.size() == 2)
+                size = QSize{wh.at(0).toInt(), wh.at(1).toInt()};
+        } else if (arg == "--frames" && hasValue) {
+            frames = std::max(1, args.at(++i).toInt());
+        } else if (arg == "--output" && hasValue) {
+            output = args.at(++i);
+        } else if (arg == "--tiles" && hasValue) {
+            tilesDir = args.at(++i);
+        } else if (arg == "--tile-rooms" && hasValue) {
+            tileRooms = std::max(1, args.at(++i).toInt());
+        } else if (arg == "--tile-pixels" && hasValue) {
+            tilePixels = std::max(1, args.at(++i).toInt());
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--map FILE] [--size WxH] [--frames N] [--output FILE]\n"
+                         "       %s [--map FILE] --tiles DIR [--tile-rooms N] [--tile-pixels N]\n",
+                         argv[0],
+                         argv[0]);
+            return 2;
+        }
+    }
+    if (size.isEmpty()) {
+        std::fprintf(stderr, "invalid --size\n");
+        return 2;
+    }
+
+    MapData mapData;
+    if (!loadMap(mapData, mapFile)) {
+        std::fprintf(stderr, "cannot load %s\n", qPrintable(mapFile));
+        return 1;
+    }
+    const SharedMapSnapshot snapshot = mapData.getSnapshot();
+    if (snapshot->isEmpty()) {
+        std::fprintf(stderr, "%s has no rooms\n", qPrintable(mapFile));
+        return 1;
+    }
+
+    try {
+        OffscreenMapRenderer renderer;
+
+        const auto meshStart = Clock::now();
+        renderer.setMap(*snapshot);
+        renderer.finish();
+        const double meshMs = msSince(meshStart);
+
+        if (!tilesDir.isEmpty()) {
+            const auto start = Clock::now();
+            const int written
+                = writeTiles(renderer, *snapshot, QDir(tilesDir), tileRooms, tilePixels);
+            if (written < 0)
+                return 1;
+            std::fprintf(stderr,
+                         "wrote %d tiles in %.1f ms (meshing took %.1f ms)\n",
+                         written,
+                         msSince(start),
+                         meshMs);
+            return 0;
+        }
+
+        QJsonObject doc;
+        doc["qtVersion"] = qVersion();
+        doc["debugBuild"] = IS_DEBUG_BUILD;
+        doc["map"] = mapFile;
+        doc["rooms"] = static_cast<qint64>(snapshot->getNumRooms());
+        doc["meshMs"] = meshMs;
+        doc["results"] = benchmarkViews(renderer, snapshot->getBounds().getBounds(), size, frames);
+        return writeBenchResults(doc, output);
+    } catch (const std::exception &ex) {
+        std::fprintf(stderr, "%s\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
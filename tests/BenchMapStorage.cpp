@@ -0,0 +1,361 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// Times loading, merging, saving and exporting synthetic maps in every format
+// MapStorage, MmpMapStorage, JsonMapStorage and PandoraMapStorage support, and
+// prints the results as JSON:
+//
+//   BenchMapStorage [--sizes 10000,100000,1000000] [--output results.json]
+//                   [--seed N] [--dir DIR]
+//
+// Every measurement reports the wall time, the resident memory before it
+// started and the peak resident memory while it ran. The peak is only exact on
+// Linux, where the high-water mark can be reset; elsewhere it's the peak of the
+// whole process so far, or -1 if unknown.
+//
+// This isn't run by ctest; it takes minutes and needs gigabytes at 1M rooms.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <QApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QThreadPool>
+#include <QXmlStreamWriter>
+
+#ifndef Q_OS_WIN
+#include <sys/resource.h>
+#endif
+
+#include "../src/configuration/configuration.h"
+#include "../src/expandoracommon/exit.h"
+#include "../src/expandoracommon/room.h"
+#include "../src/global/Debug.h"
+#include "../src/mapdata/ExitDirection.h"
+#include "../src/mapdata/mapdata.h"
+#include "../src/mapdata/mmapper2room.h"
+#include "../src/mapstorage/MmpMapStorage.h"
+#include "../src/mapstorage/PandoraMapStorage.h"
+#include "../src/mapstorage/jsonmapstorage.h"
+#include "../src/mapstorage/mapstorage.h"
+#include "BenchMapGenerator.h"
+#include "BenchUtils.h"
+
+namespace {
+
+// Memory is reported in KiB; -1 means it couldn't be measured.
+int64_t readProcStatusKiB(const char *const key)
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+    const QByteArray prefix = QByteArray(key) + ':';
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if (line.startsWith(prefix)) {
+            bool ok = false;
+            const auto kib = line.mid(prefix.size()).trimmed().split(' ').front().toLongLong(&ok);
+            return ok ? kib : -1;
+        }
+    }
+    return -1;
+}
+
+int64_t getCurrentMemoryKiB()
+{
+    return readProcStatusKiB("VmRSS");
+}
+
+int64_t getPeakMemoryKiB()
+{
+    const auto hwm = readProcStatusKiB("VmHWM");
+    if (hwm >= 0)
+        return hwm;
+#ifndef Q_OS_WIN
+    struct rusage usage
+    {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return static_cast<int64_t>(usage.ru_maxrss) / 1024; // bytes
+#else
+        return static_cast<int64_t>(usage.ru_maxrss);
+#endif
+    }
+#endif
+    return -1;
+}
+
+// Linux 4.0+ resets VmHWM to the current size when "5" is written here.
+void resetPeakMemory()
+{
+    QFile clearRefs("/proc/self/clear_refs");
+    if (clearRefs.open(QIODevice::WriteOnly))
+        clearRefs.write("5");
+}
+
+int64_t getSize(const QString &path)
+{
+    const QFileInfo info(path);
+    if (!info.isDir())
+        return info.size();
+    int64_t total = 0;
+    QDirIterator it(path, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        total += it.fileInfo().size();
+    }
+    return total;
+}
+
+// PandoraMapStorage can't save, so its input is written straight from the map.
+void writePandoraMap(MapData &mapData, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        throw std::runtime_error("cannot write " + fileName.toStdString());
+
+    QXmlStreamWriter xml(&file);
+    xml.writeStartDocument();
+    xml.writeStartElement("map");
+    xml.writeAttribute("rooms", QString::number(mapData.getRoomsCount()));
+    mapData.getSnapshot()->forEach([&xml](const Room &room) {
+        const Coordinate &pos = room.getPosition();
+        xml.writeStartElement("room");
+        xml.writeAttribute("id", QString::number(room.getId().asUint32()));
+        xml.writeAttribute("x", QString::number(pos.x));
+        xml.writeAttribute("y", QString::number(pos.y));
+        xml.writeAttribute("z", QString::number(pos.z));
+        xml.writeAttribute("terrain", "forest");
+        xml.writeTextElement("roomname", room.getName().toQString());
+        xml.writeTextElement("desc", room.getStaticDescription().toQString().replace("\n", "|"));
+        xml.writeTextElement("note", room.getNote().toQString());
+        xml.writeStartElement("exits");
+        for (const auto dir : ALL_EXITS_NESWUD) {
+            const Exit &e = room.exit(dir);
+            if (e.outIsEmpty())
+                continue;
+            xml.writeStartElement("exit");
+            xml.writeAttribute("dir", QString(Mmapper2Exit::charForDir(dir)));
+            xml.writeAttribute("to", QString::number(e.outFirst().asUint32()));
+            // An empty name is a plain exit; "exit" would be an unnamed door.
+            xml.writeAttribute("door", e.isDoor() ? e.getDoorName().toQString() : QString());
+            xml.writeEndElement();
+        }
+        xml.writeEndElement(); // exits
+        xml.writeEndElement(); // room
+    });
+    xml.writeEndElement(); // map
+    xml.writeEndDocument();
+}
+
+class NODISCARD Benchmark final
+{
+private:
+    QJsonArray m_results;
+
+public:
+    /// Runs fn once and records it; fn returns false if the storage reported failure.
+    void measure(const uint32_t numRooms,
+                 const QString &format,
+                 const QString &option,
+                 const QString &operation,
+                 const QString &path,
+                 const std::function<bool()> &fn)
+    {
+        const int64_t before = getCurrentMemoryKiB();
+        resetPeakMemory();
+        const auto start = std::chrono::steady_clock::now();
+        bool ok = false;
+        QString error;
+        try {
+            ok = fn();
+        } catch (const std::exception &ex) {
+            error = ex.what();
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        QJsonObject result;
+        result["rooms"] = static_cast<qint64>(numRooms);
+        result["format"] = format;
+        result["option"] = option;
+        result["operation"] = operation;
+        result["seconds"] = elapsed.count();
+        result["memoryBeforeKiB"] = static_cast<qint64>(before);
+        result["peakMemoryKiB"] = static_cast<qint64>(getPeakMemoryKiB());
+        result["bytes"] = static_cast<qint64>(path.isEmpty() ? -1 : getSize(path));
+        result["ok"] = ok;
+        if (!error.isEmpty())
+            result["error"] = error;
+        m_results.append(result);
+
+        std::fprintf(stderr,
+                     "%8u rooms  %-7s %-14s %-8s %8.3f s%s\n",
+                     numRooms,
+                     qPrintable(format),
+                     qPrintable(option),
+                     qPrintable(operation),
+                     elapsed.count(),
+                     ok ? "" : "  FAILED");
+    }
+
+    NODISCARD const QJsonArray &getResults() const { return m_results; }
+};
+
+bool saveMm2(MapData &mapData, const QString &fileName, const bool compress)
+{
+    setConfig().general.compressMapFiles = compress;
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    MapStorage storage(mapData, fileName, &file);
+    return storage.saveData(false);
+}
+
+template<typename Storage>
+bool loadInto(MapData &mapData, const QString &fileName, const bool merge)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    Storage storage(mapData, fileName, &file);
+    return merge ? storage.mergeData() : storage.loadData();
+}
+
+void runSize(Benchmark &bench, const uint32_t numRooms, const uint32_t seed, const QDir &dir)
+{
+    MapData source;
+    bench.measure(numRooms, "memory", "", "generate", "", [&]() {
+        MapGenerator{seed, numRooms}.generate(source, numRooms);
+        return source.getRoomsCount() == numRooms;
+    });
+
+    const QString prefix = dir.filePath(QString("map%1").arg(numRooms));
+    const QString mm2 = prefix + ".mm2";
+    const QString mm2z = prefix + "-compressed.mm2";
+    const QString mmp = prefix + ".xml";
+    const QString web = prefix + "-web";
+    const QString pandora = prefix + "-pandora.xml";
+
+    bench.measure(numRooms, "mm2", "uncompressed", "save", mm2, [&]() {
+        return saveMm2(source, mm2, false);
+    });
+    bench.measure(numRooms, "mm2", "compressed", "save", mm2z, [&]() {
+        return saveMm2(source, mm2z, true);
+    });
+    bench.measure(numRooms, "mmp", "", "save", mmp, [&]() {
+        QFile file(mmp);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        MmpMapStorage storage(source, mmp, &file);
+        return storage.saveData(false);
+    });
+    bench.measure(numRooms, "web", "", "export", web, [&]() {
+        QDir(web).removeRecursively();
+        QDir().mkpath(web);
+        JsonMapStorage storage(source, web);
+        return storage.saveData(false);
+    });
+    writePandoraMap(source, pandora);
+
+    struct NODISCARD LoadCase final
+    {
+        QString fileName;
+        QString option;
+        bool textOnDemand;
+    };
+    for (const LoadCase &c : {LoadCase{mm2, "uncompressed", false},
+                              LoadCase{mm2, "text-on-demand", true},
+                              LoadCase{mm2z, "compressed", false}}) {
+        setConfig().general.loadRoomTextOnDemand = c.textOnDemand;
+        MapData loaded;
+        bench.measure(numRooms, "mm2", c.option, "load", c.fileName, [&]() {
+            return loadInto<MapStorage>(loaded, c.fileName, false);
+        });
+    }
+    setConfig().general.loadRoomTextOnDemand = false;
+    {
+        MapData merged;
+        if (loadInto<MapStorage>(merged, mm2z, false)) {
+            bench.measure(numRooms, "mm2", "uncompressed", "merge", mm2, [&]() {
+                return loadInto<MapStorage>(merged, mm2, true);
+            });
+        }
+    }
+    {
+        MapData loaded;
+        bench.measure(numRooms, "pandora", "", "load", pandora, [&]() {
+            return loadInto<PandoraMapStorage>(loaded, pandora, false);
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    setEnteredMain();
+    QApplication app(argc, argv);
+
+    std::vector<uint32_t> sizes{10000, 100000, 1000000};
+    QString output;
+    QString dirName;
+    uint32_t seed = 42;
+    const QStringList args = QApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--sizes" && hasValue) {
+            sizes.clear();
+            for (const QString &s : args.at(++i).split(',', QString::SkipEmptyParts))
+                sizes.emplace_back(s.toUInt());
+        } else if (arg == "--output" && hasValue) {
+            output = args.at(++i);
+        } else if (arg == "--seed" && hasValue) {
+            seed = args.at(++i).toUInt();
+        } else if (arg == "--dir" && hasValue) {
+            dirName = args.at(++i);
+        } else {
+            std::fprintf(stderr,
+                         "usage: %s [--sizes N,...] [--output FILE] [--seed N] [--dir DIR]\n",
+                         argv[0]);
+            return 2;
+        }
+    }
+
+    // Files go to a temporary directory unless --dir keeps them.
+    std::optional<QTemporaryDir> tempDir;
+    if (dirName.isEmpty()) {
+        tempDir.emplace();
+        if (!tempDir->isValid()) {
+            std::fprintf(stderr, "cannot create a temporary directory\n");
+            return 1;
+        }
+        dirName = tempDir->path();
+    }
+    QDir().mkpath(dirName);
+
+    Benchmark bench;
+    for (const uint32_t numRooms : sizes)
+        runSize(bench, numRooms, seed, QDir(dirName));
+
+    QJsonObject doc;
+    doc["qtVersion"] = qVersion();
+    doc["threads"] = QThreadPool::globalInstance()->maxThreadCount();
+    doc["debugBuild"] = IS_DEBUG_BUILD;
+    doc["seed"] = static_cast<qint64>(seed);
+    doc["results"] = bench.getResults();
+    return writeBenchResults(doc, output);
+}
@@ -0,0 +1,345 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// Replays a capture of an XML-mode MUME session through MumeXmlParser as fast
+// as it can, and prints the throughput, the allocations per line and the time
+// spent in each part of the parser as JSON:
+//
+//   BenchParserReplay --capture FILE [--map FILE] [--rounds N] [--output results.json]
+//   BenchParserReplay --check
+//
+// The capture is recorded with MMAPPER_CAPTURE_TELNET=FILE (see
+// BenchTelnetReplay). It is decoded by the telnet and MPI filters once, before
+// timing, so only the parser is measured. Its events and messages go nowhere,
+// and the path machine doesn't run, so the map is only used to look up rooms.
+//
+// Allocations are counted by wrapping malloc(), which only works with glibc;
+// elsewhere they're reported as null. This isn't run by ctest; it needs a
+// capture.
+//
+// --check replays one packet with two rooms through the parser and the path
+// machine, connected as the proxy connects them, and fails unless the notes
+// of both rooms were shown. That needs each room to be mapped before the
+// parser reads the next one.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <QApplication>
+#include <QByteArray>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+
+#include "../src/clock/mumeclock.h"
+#include "../src/configuration/configuration.h"
+#include "../src/expandoracommon/exit.h"
+#include "../src/expandoracommon/room.h"
+#include "../src/global/Debug.h"
+#include "../src/global/WeakHandle.h"
+#include "../src/global/io.h"
+#include "../src/global/roomid.h"
+#include "../src/headless/HeadlessMapper.h"
+#include "../src/mapdata/ExitFlags.h"
+#include "../src/mapdata/mapdata.h"
+#include "../src/mapstorage/mapstorage.h"
+#include "../src/mpi/mpifilter.h"
+#include "../src/pandoragroup/GroupManagerApi.h"
+#include "../src/parser/ParserProfile.h"
+#include "../src/parser/mumexmlparser.h"
+#include "../src/pathmachine/mmapper2pathmachine.h"
+#include "../src/proxy/MudTelnet.h"
+#include "../src/proxy/ProxyParserApi.h"
+#include "../src/proxy/TelnetCapture.h"
+#include "../src/proxy/proxy.h"
+#include "../src/proxy/telnetfilter.h"
+
+#define BENCH_COUNT_ALLOCATIONS
+#include "BenchUtils.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<TelnetCaptureRecord> readCapture(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        throw io::IOException("cannot open the capture");
+
+    std::vector<TelnetCaptureRecord> records;
+    TelnetCaptureReader reader(file);
+    while (auto record = reader.next())
+        records.emplace_back(std::move(record.value()));
+    return records;
+}
+
+// Returns what the parser would have been given.
+std::vector<TelnetData> decodeCapture(const std::vector<TelnetCaptureRecord> &records)
+{
+    QObject parent;
+    auto *const mudTelnet = new MudTelnet(&parent);
+    auto *const telnetFilter = new TelnetFilter(&parent);
+    auto *const mpiFilter = new MpiFilter(&parent);
+
+    std::vector<TelnetData> lines;
+    QObject::connect(mudTelnet,
+                     &MudTelnet::analyzeMudStream,
+                     telnetFilter,
+                     &TelnetFilter::onAnalyzeMudStream);
+    QObject::connect(telnetFilter,
+                     &TelnetFilter::parseNewMudInput,
+                     mpiFilter,
+                     &MpiFilter::analyzeNewMudInput);
+    QObject::connect(mpiFilter, &MpiFilter::parseNewMudInput, [&lines](const TelnetData &data) {
+        lines.emplace_back(data);
+    });
+
+    for (const TelnetCaptureRecord &record : records)
+        mudTelnet->onAnalyzeMudStream(record.data);
+    return lines;
+}
+
+bool loadMap(MapData &mapData, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    MapStorage storage(mapData, fileName, &file);
+    return storage.loadData();
+}
+
+struct NODISCARD ReplayResult final
+{
+    double seconds = 0.0;
+    uint64_t allocations = 0;
+};
+
+ReplayResult replay(const std::vector<TelnetData> &lines, MapData &mapData, MumeClock &clock)
+{
+    QObject parent;
+    // Nothing is sent anywhere; the parser only sees unconnected signals and empty handles.
+    auto *const parser = new MumeXmlParser(&mapData,
+                                           &clock,
+                                           ProxyParserApi{WeakHandle<Proxy>{}},
+                                           GroupManagerApi{WeakHandle<Mmapper2Group>{}},
+                                           &parent);
+
+    ReplayResult result;
+    const uint64_t allocations = getAllocations();
+    const auto start = Clock::now();
+    for (const TelnetData &data : lines)
+        parser->parseNewMudInput(data);
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.allocations = getAllocations() - allocations;
+    return result;
+}
+
+QJsonObject getStages()
+{
+    static constexpr const ParserStageEnum STAGES[] = {ParserStageEnum::PARSE,
+                                                       ParserStageEnum::ELEMENT,
+                                                       ParserStageEnum::CHARACTERS,
+                                                       ParserStageEnum::MOVE,
+                                                       ParserStageEnum::PROMPT};
+    static constexpr const char *const NAMES[] = {"parse",
+                                                  "element",
+                                                  "characters",
+                                                  "move",
+                                                  "parsePrompt"};
+
+    QJsonObject result;
+    const auto &profile = getParserProfile();
+    for (size_t i = 0; i < std::size(STAGES); ++i) {
+        const auto totals = profile.getTotals(STAGES[i]);
+        QJsonObject stage;
+        stage["calls"] = static_cast<qint64>(totals.calls);
+        stage["totalMs"] = std::chrono::duration<double, std::milli>(totals.time).count();
+        result[NAMES[i]] = stage;
+    }
+    return result;
+}
+
+// Three lit indoor rooms from west to east; the second and third have notes.
+void makeCheckMap(MapData &mapData)
+{
+    static constexpr const uint32_t NUM_ROOMS = 3;
+    std::vector<SharedRoom> rooms;
+    std::vector<ExitsList> exits(NUM_ROOMS);
+    for (uint32_t i = 0; i < NUM_ROOMS; ++i) {
+        const SharedRoom room = Room::createPermanentRoom(mapData);
+        room->setId(RoomId{i});
+        room->setPosition(Coordinate{static_cast<int>(i), 0, 0});
+        room->setName(RoomName{QString("Room %1").arg(i)});
+        room->setStaticDescription(RoomStaticDesc{QString("You are in room %1.\n").arg(i)});
+        if (i > 0)
+            room->setNote(RoomNote{QString("room %1").arg(i)});
+        room->setTerrainType(RoomTerrainEnum::INDOORS);
+        room->setLightType(RoomLightEnum::LIT);
+        room->setUpToDate();
+        rooms.emplace_back(room);
+    }
+    for (uint32_t i = 0; i + 1 < NUM_ROOMS; ++i) {
+        Exit &out = exits[i][ExitDirEnum::EAST];
+        Exit &back = exits[i + 1][ExitDirEnum::WEST];
+        out.setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+        back.setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+        out.addOut(RoomId{i + 1});
+        out.addIn(RoomId{i + 1});
+        back.addOut(RoomId{i});
+        back.addIn(RoomId{i});
+    }
+    for (uint32_t i = 0; i < NUM_ROOMS; ++i)
+        rooms[i]->setExitsList(exits[i]);
+    {
+        MapFrontendBlocker blocker(mapData);
+        mapData.insertPredefinedRooms(rooms);
+    }
+    mapData.checkSize();
+}
+
+bool checkTwoRoomsInOnePacket()
+{
+    setConfig().general.mapMode = MapModeEnum::PLAY;
+    setConfig().mumeNative.showNotes = true;
+    setConfig().mumeNative.emulatedExits = false;
+
+    MapData mapData;
+    makeCheckMap(mapData);
+    Mmapper2PathMachine pathMachine(&mapData, nullptr);
+    connectPathMachine(pathMachine, mapData);
+    // As MapCanvas::moveMarker() does.
+    QObject::connect(&pathMachine,
+                     &Mmapper2PathMachine::playerMoved,
+                     [&mapData](const Coordinate &pos) { mapData.setPosition(pos); });
+
+    MumeClock clock;
+    QObject parent;
+    auto *const parser = new MumeXmlParser(&mapData,
+                                           &clock,
+                                           ProxyParserApi{WeakHandle<Proxy>{}},
+                                           GroupManagerApi{WeakHandle<Mmapper2Group>{}},
+                                           &parent);
+    connectParserToPathMachine(*parser, pathMachine);
+    QByteArray toUser;
+    QObject::connect(parser,
+                     &MumeXmlParser::sig_sendToUser,
+                     [&toUser](const QByteArray &ba, bool) { toUser += ba; });
+
+    pathMachine.setCurrentRoom(RoomId{0}, false);
+    parser->doMove(CommandEnum::EAST);
+    parser->doMove(CommandEnum::EAST);
+
+    static constexpr const char *const IAC_GA = "\xff\xf9";
+    const QByteArray packet = QByteArray("<movement dir=east/><room><name>Room 1</name>\n"
+                                         "<description>You are in room 1.\n</description>"
+                                         "</room><exits>Exits: east, west.\n</exits>\n"
+                                         "<prompt>*[&gt;</prompt>")
+                              + IAC_GA
+                              + "<movement dir=east/><room><name>Room 2</name>\n"
+                                "<description>You are in room 2.\n</description>"
+                                "</room><exits>Exits: west.\n</exits>\n"
+                                "<prompt>*[&gt;</prompt>"
+                              + IAC_GA;
+    for (const TelnetData &data : decodeCapture({TelnetCaptureRecord{{}, packet}}))
+        parser->parseNewMudInput(data);
+
+    const bool passed = toUser.count("Note: room 1") == 1 && toUser.count("Note: room 2") == 1
+                        && pathMachine.getCurrentRoomId() == RoomId{2};
+    if (!passed)
+        std::fprintf(stderr, "two rooms in one packet:\n%s\n", toUser.constData());
+    return passed;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    setEnteredMain();
+    QApplication app(argc, argv);
+
+    QString captureFile;
+    QString mapFile;
+    QString output;
+    int rounds = 5;
+    const QStringList args = QApplication::arguments();
+    if (args.size() == 2 && args.at(1) == "--check")
+        return checkTwoRoomsInOnePacket() ? 0 : 1;
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--capture" && hasValue) {
+            captureFile = args.at(++i);
+        } else if (arg == "--map" && hasValue) {
+            mapFile = args.at(++i);
+        } else if (arg == "--rounds" && hasValue) {
+            rounds = std::max(1, args.at(++i).toInt());
+        } else if (arg == "--output" && hasValue) {
+            output = args.at(++i);
+        } else {
+            captureFile.clear();
+            break;
+        }
+    }
+    if (captureFile.isEmpty()) {
+        std::fprintf(stderr,
+                     "usage: %s --capture FILE [--map FILE] [--rounds N] [--output FILE]\n"
+                     "       %s --check\n",
+                     argv[0],
+                     argv[0]);
+        return 2;
+    }
+
+    std::vector<TelnetData> lines;
+    try {
+        lines = decodeCapture(readCapture(captureFile));
+    } catch (const io::IOException &ex) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(captureFile), ex.what());
+        return 1;
+    }
+
+    MapData mapData;
+    if (!mapFile.isEmpty() && !loadMap(mapData, mapFile)) {
+        std::fprintf(stderr, "cannot load %s\n", qPrintable(mapFile));
+        return 1;
+    }
+
+    MumeClock clock;
+    QJsonArray results;
+    getParserProfile().setEnabled(true);
+    for (int round = 0; round < rounds; ++round) {
+        getParserProfile().reset();
+        const ReplayResult replayed = replay(lines, mapData, clock);
+        const auto numLines = static_cast<double>(std::max<size_t>(1, lines.size()));
+
+        QJsonObject result;
+        result["seconds"] = replayed.seconds;
+        result["linesPerSecond"] = replayed.seconds > 0.0
+                                       ? static_cast<double>(lines.size()) / replayed.seconds
+                                       : 0.0;
+        result["allocationsPerLine"] = COUNTS_ALLOCATIONS
+                                           ? QJsonValue(static_cast<double>(replayed.allocations)
+                                                        / numLines)
+                                           : QJsonValue();
+        result["stages"] = getStages();
+        results.append(result);
+    }
+
+    QJsonObject doc;
+    doc["qtVersion"] = qVersion();
+    doc["debugBuild"] = IS_DEBUG_BUILD;
+    doc["capture"] = captureFile;
+    doc["map"] = mapFile;
+    doc["lines"] = static_cast<qint64>(lines.size());
+    doc["results"] = results;
+    return writeBenchResults(doc, output);
+}
@@ -0,0 +1,441 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// Plays a long session by replaying a capture of MUD output over and over
+// through everything a headless mapper runs: the proxy's stack (MudTelnet,
+// TelnetFilter, MpiFilter and MumeXmlParser), the path machine in map mode,
+// so the map is edited, and the group manager, which also gets updates from a
+// few made-up group members. The map is saved every few rounds. It prints how
+// the memory, the allocations, the map lock and the latency change over time
+// as JSON:
+//
+//   BenchSoak --capture FILE [--map FILE] [--rounds N] [--save-every N]
+//             [--output results.json]
+//
+// The capture is recorded with MMAPPER_CAPTURE_TELNET=FILE (see
+// BenchTelnetReplay) and is replayed as fast as it goes, with the events
+// handled after each read, as the event loop would. Each round is a new
+// connection (a new stack) to the same map, path machine and group, and is
+// one sample. The latency is that of each read, from the socket to the map.
+//
+// Allocations are counted by wrapping malloc(), which only works with glibc;
+// elsewhere they're reported as null, and so is the memory where there's no
+// /proc. This isn't run by ctest; it needs a capture.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <QApplication>
+#include <QByteArray>
+#include <QColor>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <QTemporaryDir>
+
+#include "../src/clock/mumeclock.h"
+#include "../src/configuration/configuration.h"
+#include "../src/expandoracommon/parseevent.h"
+#include "../src/global/Debug.h"
+#include "../src/global/WeakHandle.h"
+#include "../src/global/io.h"
+#include "../src/global/roomid.h"
+#include "../src/headless/HeadlessMapper.h"
+#include "../src/mapdata/mapdata.h"
+#include "../src/mapfrontend/MapLock.h"
+#include "../src/mapstorage/mapstorage.h"
+#include "../src/mpi/mpifilter.h"
+#include "../src/pandoragroup/CGroup.h"
+#include "../src/pandoragroup/CharacterState.h"
+#include "../src/pandoragroup/groupaction.h"
+#include "../src/pandoragroup/mmapper2group.h"
+#include "../src/parser/mumexmlparser.h"
+#include "../src/pathmachine/mmapper2pathmachine.h"
+#include "../src/pathmachine/pathmachine.h"
+#include "../src/proxy/MudTelnet.h"
+#include "../src/proxy/ProxyParserApi.h"
+#include "../src/proxy/TelnetCapture.h"
+#include "../src/proxy/telnetfilter.h"
+
+#define BENCH_COUNT_ALLOCATIONS
+#include "BenchUtils.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// The made-up group members, and how many reads there are between their updates.
+static constexpr const int NUM_PEERS = 4;
+static constexpr const size_t READS_PER_PEER_UPDATE = 8;
+
+std::vector<TelnetCaptureRecord> readCapture(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        throw io::IOException("cannot open the capture");
+
+    std::vector<TelnetCaptureRecord> records;
+    TelnetCaptureReader reader(file);
+    while (auto record = reader.next())
+        records.emplace_back(std::move(record.value()));
+    return records;
+}
+
+bool loadMap(MapData &mapData, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    MapStorage storage(mapData, fileName, &file);
+    return storage.loadData();
+}
+
+bool saveMap(MapData &mapData, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    MapStorage storage(mapData, fileName, &file);
+    return storage.saveData(false);
+}
+
+// Memory is reported in KiB; -1 means it couldn't be measured.
+int64_t getCurrentMemoryKiB()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return -1;
+    const QByteArray prefix = "VmRSS:";
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if (line.startsWith(prefix)) {
+            bool ok = false;
+            const auto kib = line.mid(prefix.size()).trimmed().split(' ').front().toLongLong(&ok);
+            return ok ? kib : -1;
+        }
+    }
+    return -1;
+}
+
+double toMs(const Clock::duration d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+// Reorders `latencies`.
+QJsonObject getLatency(std::vector<Clock::duration> &latencies)
+{
+    const auto percentile = [&latencies](const double q) -> double {
+        if (latencies.empty())
+            return 0.0;
+        const double index = q * static_cast<double>(latencies.size() - 1);
+        const auto nth = latencies.begin() + static_cast<std::ptrdiff_t>(index);
+        std::nth_element(latencies.begin(), nth, latencies.end());
+        return toMs(*nth);
+    };
+
+    QJsonObject result;
+    result["p50Ms"] = percentile(0.5);
+    result["p99Ms"] = percentile(0.99);
+    result["maxMs"] = percentile(1.0);
+    return result;
+}
+
+// The rest of the group, as the network would report them to the group manager's thread.
+class NODISCARD Peers final
+{
+private:
+    Mmapper2Group &m_groupManager;
+    MapData &m_mapData;
+    uint64_t m_updates = 0;
+
+public:
+    explicit Peers(Mmapper2Group &groupManager, MapData &mapData)
+        : m_groupManager{groupManager}
+        , m_mapData{mapData}
+    {
+        for (int i = 0; i < NUM_PEERS; ++i) {
+            CharacterState state = getState(i);
+            state.color = Qt::yellow;
+            state.fields = CharacterFields::all();
+            const QVariantMap message = state.toMessage();
+            schedule(std::make_shared<AddCharacter>(CharacterState::fromMessage(message)));
+        }
+    }
+
+public:
+    NODISCARD uint64_t getUpdates() const { return m_updates; }
+
+    // Someone's health and room change.
+    void update()
+    {
+        const int i = static_cast<int>(m_updates++ % static_cast<uint64_t>(NUM_PEERS));
+        const QVariantMap message = getState(i).toMessage();
+        schedule(std::make_shared<UpdateCharacter>(CharacterState::fromMessage(message)));
+    }
+
+private:
+    NODISCARD CharacterState getState(const int i) const
+    {
+        const uint32_t numRooms = std::max(1u, m_mapData.getRoomsCount());
+        CharacterState state;
+        state.name = QByteArray("Peer") + QByteArray::number(i);
+        state.maxhp = 100;
+        state.hp = static_cast<int>(m_updates % 101);
+        state.roomId = RoomId{static_cast<uint32_t>(m_updates % numRooms)};
+        state.fields.insert(CharacterFieldEnum::NAME);
+        state.fields.insert(CharacterFieldEnum::HP);
+        state.fields.insert(CharacterFieldEnum::MAX_HP);
+        state.fields.insert(CharacterFieldEnum::ROOM);
+        return state;
+    }
+
+    void schedule(std::shared_ptr<GroupAction> action)
+    {
+        CGroup *const group = m_groupManager.getGroup();
+        QMetaObject::invokeMethod(
+            &m_groupManager,
+            [group, action = std::move(action)]() { group->slot_scheduleAction(action); },
+            Qt::QueuedConnection);
+    }
+};
+
+struct NODISCARD Session final
+{
+    MapData &mapData;
+    MumeClock &clock;
+    Mmapper2PathMachine &pathMachine;
+    Mmapper2Group &groupManager;
+    Peers &peers;
+};
+
+// A new connection that plays the whole capture; returns each read's latency.
+std::vector<Clock::duration> replay(const std::vector<TelnetCaptureRecord> &records,
+                                    Session &session)
+{
+    QObject parent;
+    auto *const mudTelnet = new MudTelnet(&parent);
+    auto *const telnetFilter = new TelnetFilter(&parent);
+    auto *const mpiFilter = new MpiFilter(&parent);
+    // Nothing is sent to the MUD or the client; the group manager is offline.
+    auto *const parser = new MumeXmlParser(&session.mapData,
+                                           &session.clock,
+                                           ProxyParserApi{WeakHandle<Proxy>{}},
+                                           session.groupManager.getGroupManagerApi(),
+                                           &parent);
+
+    QObject::connect(mudTelnet,
+                     &MudTelnet::analyzeMudStream,
+                     telnetFilter,
+                     &TelnetFilter::onAnalyzeMudStream);
+    QObject::connect(telnetFilter,
+                     &TelnetFilter::parseNewMudInput,
+                     mpiFilter,
+                     &MpiFilter::analyzeNewMudInput);
+    QObject::connect(mpiFilter,
+                     &MpiFilter::parseNewMudInput,
+                     parser,
+                     &MumeXmlParser::parseNewMudInput);
+    // Queued, as the proxy connects them.
+    QObject::connect(parser,
+                     QOverload<const SigParseEvent &>::of(&MumeXmlParser::event),
+                     &session.pathMachine,
+                     &Mmapper2PathMachine::event,
+                     Qt::QueuedConnection);
+    QObject::connect(parser,
+                     &AbstractParser::releaseAllPaths,
+                     &session.pathMachine,
+                     &PathMachine::releaseAllPaths,
+                     Qt::QueuedConnection);
+
+    std::vector<Clock::duration> latencies;
+    latencies.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto start = Clock::now();
+        mudTelnet->onAnalyzeMudStream(records[i].data);
+        QCoreApplication::processEvents();
+        latencies.emplace_back(Clock::now() - start);
+
+        if (i % READS_PER_PEER_UPDATE == 0)
+            session.peers.update();
+    }
+    return latencies;
+}
+
+QJsonValue getDrift(const QJsonArray &samples)
+{
+    if (samples.size() < 2)
+        return QJsonValue{};
+
+    // The first round fills the map and the caches, so it's left out.
+    const QJsonObject first = samples.at(1).toObject();
+    const QJsonObject last = samples.last().toObject();
+    const double firstP99 = first["latency"].toObject()["p99Ms"].toDouble();
+    const double lastP99 = last["latency"].toObject()["p99Ms"].toDouble();
+
+    QJsonObject result;
+    if (!first["rssKiB"].isNull() && !last["rssKiB"].isNull())
+        result["rssKiB"] = last["rssKiB"].toDouble() - first["rssKiB"].toDouble();
+    else
+        result["rssKiB"] = QJsonValue{};
+    result["allocationsPerRead"] = last["allocationsPerRead"].toDouble()
+                                   - first["allocationsPerRead"].toDouble();
+    result["p99Ratio"] = firstP99 > 0.0 ? lastP99 / firstP99 : 0.0;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    setEnteredMain();
+    QApplication app(argc, argv);
+
+    QString captureFile;
+    QString mapFile;
+    QString output;
+    int rounds = 20;
+    int saveEvery = 5;
+    const QStringList args = QApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--capture" && hasValue) {
+            captureFile = args.at(++i);
+        } else if (arg == "--map" && hasValue) {
+            mapFile = args.at(++i);
+        } else if (arg == "--rounds" && hasValue) {
+            rounds = std::max(1, args.at(++i).toInt());
+        } else if (arg == "--save-every" && hasValue) {
+            saveEvery = std::max(1, args.at(++i).toInt());
+        } else if (arg == "--output" && hasValue) {
+            output = args.at(++i);
+        } else {
+            captureFile.clear();
+            break;
+        }
+    }
+    if (captureFile.isEmpty()) {
+        std::fprintf(stderr,
+                     "usage: %s --capture FILE [--map FILE] [--rounds N] [--save-every N]"
+                     " [--output FILE]\n",
+                     argv[0]);
+        return 2;
+    }
+
+    std::vector<TelnetCaptureRecord> records;
+    try {
+        records = readCapture(captureFile);
+    } catch (const io::IOException &ex) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(captureFile), ex.what());
+        return 1;
+    }
+
+    QTemporaryDir tempDir;
+    if (!tempDir.isValid()) {
+        std::fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+    const QString savedMap = tempDir.filePath("soak.mm2");
+
+    qRegisterMetaType<RoomId>("RoomId");
+    qRegisterMetaType<SigParseEvent>("SigParseEvent");
+
+    // New rooms are made when the path machine can't find them.
+    setConfig().general.mapMode = MapModeEnum::MAP;
+
+    MapData mapData;
+    if (!mapFile.isEmpty() && !loadMap(mapData, mapFile)) {
+        std::fprintf(stderr, "cannot load %s\n", qPrintable(mapFile));
+        return 1;
+    }
+    MumeClock clock;
+    QObject parent;
+    auto *const pathMachine = new Mmapper2PathMachine(&mapData, &parent);
+    connectPathMachine(*pathMachine, mapData);
+
+    // Nothing owns it; as in HeadlessMapper, it's left to clean up after itself once stopped.
+    auto *const groupManager = new Mmapper2Group;
+    groupManager->start();
+    QObject::connect(pathMachine,
+                     &PathMachine::setCharPosition,
+                     groupManager,
+                     &Mmapper2Group::setCharacterRoomId,
+                     Qt::QueuedConnection);
+
+    Peers peers(*groupManager, mapData);
+    Session session{mapData, clock, *pathMachine, *groupManager, peers};
+
+    std::ignore = MapLock::takeWriteHoldStats();
+    const auto sessionStart = Clock::now();
+    QJsonArray samples;
+    for (int round = 0; round < rounds; ++round) {
+        const uint64_t allocations = getAllocations();
+        const auto waitTime = MapLock::getCurrentThreadWaitTime();
+        const auto start = Clock::now();
+        std::vector<Clock::duration> latencies = replay(records, session);
+        const auto replayed = Clock::now();
+
+        std::optional<Clock::duration> saveTime;
+        if ((round + 1) % saveEvery == 0) {
+            if (!saveMap(mapData, savedMap)) {
+                std::fprintf(stderr, "cannot save the map\n");
+                return 1;
+            }
+            saveTime = Clock::now() - replayed;
+        }
+
+        const uint64_t roundAllocations = getAllocations() - allocations;
+        const auto holds = MapLock::takeWriteHoldStats();
+        QJsonObject mapLock;
+        mapLock["waitMs"] = toMs(MapLock::getCurrentThreadWaitTime() - waitTime);
+        mapLock["writeHolds"] = static_cast<qint64>(holds.count);
+        mapLock["writeHoldTotalMs"] = toMs(holds.total);
+        mapLock["writeHoldMaxMs"] = toMs(holds.max);
+
+        const int64_t rss = getCurrentMemoryKiB();
+        QJsonObject sample;
+        sample["round"] = round;
+        sample["elapsedSeconds"] = std::chrono::duration<double>(Clock::now() - sessionStart)
+                                       .count();
+        sample["replaySeconds"] = std::chrono::duration<double>(replayed - start).count();
+        sample["saveMs"] = saveTime.has_value() ? QJsonValue{toMs(saveTime.value())}
+                                                : QJsonValue{};
+        sample["rooms"] = static_cast<qint64>(mapData.getRoomsCount());
+        sample["rssKiB"] = rss >= 0 ? QJsonValue{static_cast<qint64>(rss)} : QJsonValue{};
+        sample["allocations"] = COUNTS_ALLOCATIONS
+                                    ? QJsonValue{static_cast<qint64>(roundAllocations)}
+                                    : QJsonValue{};
+        sample["allocationsPerRead"] = COUNTS_ALLOCATIONS && !records.empty()
+                                           ? QJsonValue{static_cast<double>(roundAllocations)
+                                                        / static_cast<double>(records.size())}
+                                           : QJsonValue{};
+        sample["mapLock"] = mapLock;
+        sample["latency"] = getLatency(latencies);
+        samples.append(sample);
+    }
+
+    groupManager->stop();
+
+    QJsonObject doc;
+    doc["qtVersion"] = qVersion();
+    doc["debugBuild"] = IS_DEBUG_BUILD;
+    doc["capture"] = captureFile;
+    doc["map"] = mapFile;
+    doc["reads"] = static_cast<qint64>(records.size());
+    doc["peerUpdates"] = static_cast<qint64>(peers.getUpdates());
+    doc["results"] = samples;
+    doc["drift"] = getDrift(samples);
+    return writeBenchResults(doc, output);
+}
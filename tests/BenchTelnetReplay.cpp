@@ -0,0 +1,187 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// Replays a capture of MUD output through the proxy's stack (MudTelnet,
+// TelnetFilter, MpiFilter and MumeXmlParser) as fast as it can, and prints
+// the throughput and the time spent in each stage as JSON:
+//
+//   BenchTelnetReplay --capture FILE [--rounds N] [--output results.json]
+//
+// Record a capture by running MMapper with MMAPPER_CAPTURE_TELNET=FILE; it
+// holds the bytes as they came from the socket, so MCCP is replayed too.
+// Each round starts with a new stack but keeps the map. The telnet stage
+// includes the filters, since they run inside it; see ProxyLatencyStats.
+//
+// This isn't run by ctest; it needs a capture.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <QApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QString>
+
+#include "../src/clock/mumeclock.h"
+#include "../src/configuration/configuration.h"
+#include "../src/global/Debug.h"
+#include "../src/global/WeakHandle.h"
+#include "../src/global/io.h"
+#include "../src/mapdata/mapdata.h"
+#include "../src/mpi/mpifilter.h"
+#include "../src/pandoragroup/GroupManagerApi.h"
+#include "../src/parser/mumexmlparser.h"
+#include "../src/proxy/MudTelnet.h"
+#include "../src/proxy/ProxyLatencyStats.h"
+#include "../src/proxy/ProxyParserApi.h"
+#include "../src/proxy/TelnetCapture.h"
+#include "../src/proxy/telnetfilter.h"
+#include "BenchUtils.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<TelnetCaptureRecord> readCapture(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        throw io::IOException("cannot open the capture");
+
+    std::vector<TelnetCaptureRecord> records;
+    TelnetCaptureReader reader(file);
+    while (auto record = reader.next())
+        records.emplace_back(std::move(record.value()));
+    return records;
+}
+
+// Returns the wall time in seconds.
+double replay(const std::vector<TelnetCaptureRecord> &records, MapData &mapData, MumeClock &clock)
+{
+    QObject parent;
+    auto *const mudTelnet = new MudTelnet(&parent);
+    auto *const telnetFilter = new TelnetFilter(&parent);
+    auto *const mpiFilter = new MpiFilter(&parent);
+    // Nothing is sent anywhere; the parser only sees unconnected signals and empty handles.
+    auto *const parser = new MumeXmlParser(&mapData,
+                                           &clock,
+                                           ProxyParserApi{WeakHandle<Proxy>{}},
+                                           GroupManagerApi{WeakHandle<Mmapper2Group>{}},
+                                           &parent);
+
+    QObject::connect(mudTelnet,
+                     &MudTelnet::analyzeMudStream,
+                     telnetFilter,
+                     &TelnetFilter::onAnalyzeMudStream);
+    QObject::connect(telnetFilter,
+                     &TelnetFilter::parseNewMudInput,
+                     mpiFilter,
+                     &MpiFilter::analyzeNewMudInput);
+    QObject::connect(mpiFilter,
+                     &MpiFilter::parseNewMudInput,
+                     parser,
+                     &MumeXmlParser::parseNewMudInput);
+
+    const auto start = Clock::now();
+    for (const TelnetCaptureRecord &record : records)
+        mudTelnet->onAnalyzeMudStream(record.data);
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+QJsonObject getStages()
+{
+    static constexpr const LatencyStageEnum STAGES[] = {LatencyStageEnum::TELNET,
+                                                        LatencyStageEnum::PARSER};
+    static constexpr const char *const NAMES[] = {"telnet", "parser"};
+
+    const auto ms = [](const std::chrono::nanoseconds ns) {
+        return std::chrono::duration<double, std::milli>(ns).count();
+    };
+
+    QJsonObject result;
+    const auto &stats = getProxyLatencyStats();
+    for (size_t i = 0; i < std::size(STAGES); ++i) {
+        const auto p = stats.getPercentiles(STAGES[i]);
+        QJsonObject stage;
+        stage["calls"] = static_cast<qint64>(p.count);
+        stage["totalMs"] = ms(p.total);
+        stage["p50Ms"] = ms(p.p50);
+        stage["p99Ms"] = ms(p.p99);
+        stage["maxMs"] = ms(p.max);
+        result[NAMES[i]] = stage;
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    setEnteredMain();
+    QApplication app(argc, argv);
+
+    QString captureFile;
+    QString output;
+    int rounds = 5;
+    const QStringList args = QApplication::arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        const bool hasValue = i + 1 < args.size();
+        if (arg == "--capture" && hasValue) {
+            captureFile = args.at(++i);
+        } else if (arg == "--rounds" && hasValue) {
+            rounds = std::max(1, args.at(++i).toInt());
+        } else if (arg == "--output" && hasValue) {
+            output = args.at(++i);
+        } else {
+            captureFile.clear();
+            break;
+        }
+    }
+    if (captureFile.isEmpty()) {
+        std::fprintf(stderr, "usage: %s --capture FILE [--rounds N] [--output FILE]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<TelnetCaptureRecord> records;
+    try {
+        records = readCapture(captureFile);
+    } catch (const io::IOException &ex) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(captureFile), ex.what());
+        return 1;
+    }
+
+    qint64 bytes = 0;
+    for (const TelnetCaptureRecord &record : records)
+        bytes += record.data.size();
+
+    MapData mapData;
+    MumeClock clock;
+    QJsonArray results;
+    for (int round = 0; round < rounds; ++round) {
+        getProxyLatencyStats().reset();
+        const double seconds = replay(records, mapData, clock);
+
+        QJsonObject result;
+        result["seconds"] = seconds;
+        result["mbPerSecond"] = seconds > 0.0 ? static_cast<double>(bytes) / 1e6 / seconds : 0.0;
+        result["stages"] = getStages();
+        results.append(result);
+    }
+
+    QJsonObject doc;
+    doc["qtVersion"] = qVersion();
+    doc["debugBuild"] = IS_DEBUG_BUILD;
+    doc["capture"] = captureFile;
+    doc["reads"] = static_cast<qint64>(records.size());
+    doc["bytes"] = bytes;
+    doc["results"] = results;
+    return writeBenchResults(doc, output);
+}
@@ -0,0 +1,80 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+// What the benchmarks share. Include it from the benchmark's .cpp, which is the
+// only one of its own; with BENCH_COUNT_ALLOCATIONS defined first, it also
+// replaces malloc() to count the allocations.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <QByteArray>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+
+#include "../src/global/macros.h"
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+#if defined(__GLIBC__)
+static constexpr const bool COUNTS_ALLOCATIONS = true;
+static std::atomic<uint64_t> g_allocations{0};
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+// These replace the C library's for the whole process, including Qt.
+void *malloc(const size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(const size_t count, const size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *const ptr, const size_t size) noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+
+static uint64_t getAllocations()
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+#else
+// Only glibc can be wrapped like this; the counts are reported as null.
+static constexpr const bool COUNTS_ALLOCATIONS = false;
+static uint64_t getAllocations()
+{
+    return 0;
+}
+#endif
+#endif
+
+/// Prints the results to stdout, or writes them to `output` if it isn't empty;
+/// returns the exit status.
+NODISCARD static inline int writeBenchResults(const QJsonObject &doc, const QString &output)
+{
+    const QByteArray json = QJsonDocument(doc).toJson();
+    if (output.isEmpty()) {
+        std::fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+        return 0;
+    }
+    QFile file(output);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        std::fprintf(stderr, "cannot write %s\n", qPrintable(output));
+        return 1;
+    }
+    return 0;
+}
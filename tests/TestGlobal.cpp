@@ -3,12 +3,22 @@
 
 #include "TestGlobal.h"
 
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
 #include <QDebug>
 #include <QtTest/QtTest>
 
 #include "../src/global/AnsiColor.h"
+#include "../src/global/BackgroundJob.h"
+#include "../src/global/CopyOnWrite.h"
+#include "../src/global/FlatHashMap.h"
+#include "../src/global/InternedStrings.h"
+#include "../src/global/LogRing.h"
 #include "../src/global/StringView.h"
 #include "../src/global/TextUtils.h"
+#include "../src/global/TinyRoomIdSet.h"
 #include "../src/global/unquote.h"
 
 TestGlobal::TestGlobal() = default;
@@ -98,4 +108,217 @@ void TestGlobal::toLowerLatin1Test()
     QCOMPARE(toLowerLatin1('-'), '-');
 }
 
+void TestGlobal::backgroundJobTest()
+{
+    QObject context;
+    int delivered = 0;
+    std::atomic<bool> firstStarted{false};
+    {
+        BackgroundJob job{context};
+        job.start([&firstStarted, &delivered](const BackgroundJob::Token &token) {
+            firstStarted = true;
+            while (!token.isCancelled()) {
+                QThread::msleep(1);
+            }
+            token.post([&delivered]() { delivered += 100; });
+        });
+        QTRY_VERIFY(firstStarted.load());
+
+        // Starting another job cancels the first, so only the second one reports.
+        job.start([&delivered](const BackgroundJob::Token &token) {
+            token.post([&delivered]() { ++delivered; });
+        });
+        QTRY_COMPARE(delivered, 1);
+    }
+    QCoreApplication::processEvents();
+    QCOMPARE(delivered, 1);
+}
+
+void TestGlobal::internedStringsTest()
+{
+    const size_t before = interned::getNumStrings();
+    {
+        const auto a = interned::intern("A Dark Tunnel");
+        const auto b = interned::intern(std::string("A Dark ") + "Tunnel");
+        const auto c = interned::intern("A Dark Cave");
+        QVERIFY(a == b);
+        QVERIFY(a != c);
+        QCOMPARE(*a, std::string("A Dark Tunnel"));
+        QCOMPARE(interned::getNumStrings(), before + 2);
+    }
+    // Entries go away with their last reference.
+    QCOMPARE(interned::getNumStrings(), before);
+}
+
+void TestGlobal::flatHashMapTest()
+{
+    FlatHashMap<int> map;
+    QVERIFY(map.find(0) == nullptr);
+
+    // Enough keys to rehash several times; multiples of 1024 would all share
+    // a slot without the mixing.
+    static constexpr const int N = 1000;
+    for (int i = 0; i < N; ++i)
+        map[static_cast<uint64_t>(i) * 1024u] = i;
+    QCOMPARE(map.size(), static_cast<size_t>(N));
+    for (int i = 0; i < N; ++i) {
+        const int *const value = map.find(static_cast<uint64_t>(i) * 1024u);
+        QVERIFY(value != nullptr);
+        QCOMPARE(*value, i);
+    }
+    QVERIFY(map.find(1) == nullptr);
+
+    // Existing keys are updated in place.
+    map[0] = -1;
+    QCOMPARE(map.size(), static_cast<size_t>(N));
+    QCOMPARE(*map.find(0), -1);
+
+    int sum = 0;
+    map.forEach([&sum](uint64_t, const int value) { sum += value; });
+    QCOMPARE(sum, N * (N - 1) / 2 - 1);
+}
+
+void TestGlobal::tinyRoomIdSetTest()
+{
+    const auto toVector = [](const TinyRoomIdSet &set) {
+        return std::vector<RoomId>(set.begin(), set.end());
+    };
+
+    TinyRoomIdSet set;
+    QVERIFY(set.empty());
+    QVERIFY(set.find(RoomId{0}) == set.end());
+
+    // Up to INLINE_CAPACITY ids don't allocate.
+    static_assert(TinyRoomIdSet::INLINE_CAPACITY == 2);
+    set.insert(RoomId{5});
+    set.insert(RoomId{2});
+    set.insert(RoomId{5});
+    QCOMPARE(toVector(set), (std::vector<RoomId>{RoomId{2}, RoomId{5}}));
+    QCOMPARE(set.getHeapBytes(), static_cast<size_t>(0));
+
+    // One more moves them all to the heap, still sorted.
+    set.insert(RoomId{3});
+    QCOMPARE(toVector(set), (std::vector<RoomId>{RoomId{2}, RoomId{3}, RoomId{5}}));
+    QVERIFY(set.getHeapBytes() > 0);
+    QVERIFY(set.contains(RoomId{3}));
+    QVERIFY(!set.contains(RoomId{4}));
+
+    // Copies are deep, and compare equal until either changes.
+    TinyRoomIdSet copy{set};
+    QVERIFY(copy == set);
+    copy.insert(RoomId{9});
+    QVERIFY(copy != set);
+    QCOMPARE(set.size(), static_cast<size_t>(3));
+    TinyRoomIdSet assigned;
+    assigned.insert(RoomId{1});
+    assigned = copy;
+    QCOMPARE(toVector(assigned), toVector(copy));
+    const TinyRoomIdSet &self = assigned;
+    assigned = self;
+    QCOMPARE(assigned.size(), static_cast<size_t>(4));
+
+    // Erasing down to INLINE_CAPACITY frees the heap.
+    set.erase(RoomId{4});
+    set.erase(RoomId{2});
+    QCOMPARE(toVector(set), (std::vector<RoomId>{RoomId{3}, RoomId{5}}));
+    QCOMPARE(set.getHeapBytes(), static_cast<size_t>(0));
+    set.erase(RoomId{5});
+    QCOMPARE(toVector(set), (std::vector<RoomId>{RoomId{3}}));
+    set.insert(RoomId{1});
+    QCOMPARE(toVector(set), (std::vector<RoomId>{RoomId{1}, RoomId{3}}));
+
+    // Moves leave the source empty, whether the ids were inline or on the heap.
+    TinyRoomIdSet movedInline{std::move(set)};
+    QCOMPARE(toVector(movedInline), (std::vector<RoomId>{RoomId{1}, RoomId{3}}));
+    QVERIFY(set.empty()); // NOLINT(bugprone-use-after-move)
+    TinyRoomIdSet movedHeap;
+    movedHeap = std::move(copy);
+    QCOMPARE(toVector(movedHeap), toVector(assigned));
+    QVERIFY(movedHeap.getHeapBytes() > 0);
+    QVERIFY(copy.empty()); // NOLINT(bugprone-use-after-move)
+    QCOMPARE(copy.getHeapBytes(), static_cast<size_t>(0));
+
+    // A moved-from set can be used again.
+    copy.insert(RoomId{7});
+    QCOMPARE(toVector(copy), (std::vector<RoomId>{RoomId{7}}));
+}
+
+void TestGlobal::logRingTest()
+{
+    LogRing ring{3};
+    QCOMPARE(ring.capacity(), static_cast<size_t>(4));
+
+    // Runs of the same line are folded; a full ring drops and counts the rest.
+    QVERIFY(ring.push("A", "one"));
+    QVERIFY(ring.push("A", "one"));
+    QVERIFY(ring.push("B", "two"));
+    QVERIFY(ring.push("A", "one"));
+    QVERIFY(!ring.push("A", "three"));
+    {
+        const auto drained = ring.drain(10);
+        QCOMPARE(drained.lines.size(), static_cast<size_t>(3));
+        QCOMPARE(drained.lines[0].message, QString("one"));
+        QCOMPARE(drained.lines[0].repeats, static_cast<size_t>(2));
+        QCOMPARE(drained.lines[1].module, QString("B"));
+        QCOMPARE(drained.lines[2].repeats, static_cast<size_t>(1));
+        QCOMPARE(drained.suppressed, static_cast<size_t>(1));
+    }
+
+    // Lines over the limit are counted rather than returned.
+    for (int i = 0; i < 4; ++i)
+        QVERIFY(ring.push("C", QString::number(i)));
+    {
+        const auto drained = ring.drain(1);
+        QCOMPARE(drained.lines.size(), static_cast<size_t>(1));
+        QCOMPARE(drained.lines[0].message, QString("0"));
+        QCOMPARE(drained.suppressed, static_cast<size_t>(3));
+    }
+
+    // Concurrent producers never lose a line that push() accepted.
+    LogRing shared{1024};
+    static constexpr const int THREADS = 4;
+    static constexpr const int PER_THREAD = 200;
+    std::atomic<int> accepted{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&shared, &accepted, t]() {
+            for (int i = 0; i < PER_THREAD; ++i) {
+                if (shared.push(QString::number(t), QString::number(i)))
+                    ++accepted;
+            }
+        });
+    }
+    for (auto &thread : threads)
+        thread.join();
+    const auto drained = shared.drain(THREADS * PER_THREAD);
+    QCOMPARE(static_cast<int>(drained.lines.size()), accepted.load());
+    QCOMPARE(accepted.load(), THREADS * PER_THREAD);
+}
+
+void TestGlobal::copyOnWriteTest()
+{
+    const CopyOnWrite<std::vector<int>> empty;
+    QVERIFY(empty->empty());
+
+    CopyOnWrite<std::vector<int>> a{std::vector<int>{1, 2, 3}};
+    CopyOnWrite<std::vector<int>> b = a;
+    QVERIFY(a.isSharedWith(b));
+
+    // The first write through a shared copy gives it a value of its own.
+    b.mut().push_back(4);
+    QVERIFY(!a.isSharedWith(b));
+    QCOMPARE(a->size(), static_cast<size_t>(3));
+    QCOMPARE(b->size(), static_cast<size_t>(4));
+
+    // Writing a value that isn't shared doesn't copy it.
+    const int *const data = b->data();
+    b.mut()[0] = 5;
+    QCOMPARE(b->data(), data);
+    QCOMPARE((*b)[0], 5);
+    QCOMPARE((*a)[0], 1);
+
+    b.set(std::vector<int>{7});
+    QCOMPARE(b->size(), static_cast<size_t>(1));
+}
+
 QTEST_MAIN(TestGlobal)
@@ -17,4 +17,10 @@ private Q_SLOTS:
     void stringViewTest();
     void unquoteTest();
     void toLowerLatin1Test();
+    void backgroundJobTest();
+    void internedStringsTest();
+    void flatHashMapTest();
+    void tinyRoomIdSetTest();
+    void logRingTest();
+    void copyOnWriteTest();
 };
@@ -0,0 +1,245 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "TestGroupMessages.h"
+
+#include <initializer_list>
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+#include <QtTest/QtTest>
+
+#include "../src/pandoragroup/GroupMessages.h"
+
+Q_DECLARE_METATYPE(GroupMessageEnum)
+
+namespace { // anonymous
+
+// Field numbers and wire types from the protocol (see BinaryFieldEnum).
+constexpr const char TEXT_STRING = (1 << 1) | 1;
+constexpr const char TEXT_NUMBER = 1 << 1;
+constexpr const char NAME_STRING = (5 << 1) | 1;
+constexpr const char NAME_NUMBER = 5 << 1;
+constexpr const char HP_STRING = (7 << 1) | 1;
+constexpr const char HP_NUMBER = 7 << 1;
+// Not a field yet.
+constexpr const char UNKNOWN_STRING = (60 << 1) | 1;
+
+QByteArray startMessage(const GroupMessageEnum message)
+{
+    return QByteArray(1, static_cast<char>(message));
+}
+
+// The XML parser reads every value as text, and the binary one as a number or a string.
+QVariantMap toStrings(const QVariantMap &map)
+{
+    QVariantMap result;
+    for (auto it = map.begin(); it != map.end(); ++it) {
+        if (it.value().userType() == QMetaType::QVariantMap)
+            result[it.key()] = toStrings(it.value().toMap());
+        else
+            result[it.key()] = it.value().toString();
+    }
+    return result;
+}
+
+QVariantMap makePlayerData(const QString &name)
+{
+    QVariantMap playerData;
+    playerData["name"] = name;
+    playerData["color"] = QString("#ff0000");
+    playerData["hp"] = 120;
+    playerData["maxhp"] = 150;
+    playerData["mana"] = 0;
+    playerData["maxmana"] = 80;
+    playerData["moves"] = -3;
+    playerData["maxmoves"] = 110;
+    playerData["state"] = 2u;
+    playerData["room"] = 4096u;
+    playerData["prespam"] = QString("n:e:s");
+    playerData["affects"] = 0x15u;
+    return playerData;
+}
+
+} // namespace
+
+TestGroupMessages::TestGroupMessages() = default;
+
+TestGroupMessages::~TestGroupMessages() = default;
+
+void TestGroupMessages::roundTripTest_data()
+{
+    QTest::addColumn<GroupMessageEnum>("message");
+    QTest::addColumn<QVariantMap>("data");
+
+    {
+        QVariantMap data;
+        data["protocolVersion"] = 104u;
+        data["compression"] = QString("zlib");
+        QTest::newRow("handshake") << GroupMessageEnum::REQ_HANDSHAKE << data;
+    }
+    {
+        QVariantMap loginData;
+        loginData["protocolVersion"] = 104u;
+        loginData["playerData"] = makePlayerData("Alice");
+        QVariantMap data;
+        data["loginData"] = loginData;
+        QTest::newRow("login") << GroupMessageEnum::UPDATE_CHAR << data;
+    }
+    {
+        QVariantMap data;
+        data["playerData"] = makePlayerData("Bob");
+        QTest::newRow("update") << GroupMessageEnum::UPDATE_CHAR << data;
+        QTest::newRow("add") << GroupMessageEnum::ADD_CHAR << data;
+        QTest::newRow("remove") << GroupMessageEnum::REMOVE_CHAR << data;
+    }
+    {
+        QVariantMap data;
+        data["playerData"] = makePlayerData("");
+        QTest::newRow("empty player") << GroupMessageEnum::ADD_CHAR << data;
+    }
+    {
+        QVariantMap data;
+        data["from"] = QString("Alice");
+        data["text"] = QString("Déjà vu <&> \"quoted\"");
+        QTest::newRow("gtell") << GroupMessageEnum::GTELL << data;
+    }
+    {
+        QVariantMap data;
+        data["oldname"] = QString("Alice");
+        data["newname"] = QString("Carol");
+        QTest::newRow("rename") << GroupMessageEnum::RENAME_CHAR << data;
+    }
+    {
+        QVariantMap data;
+        data["text"] = QString("You have been kicked");
+        QTest::newRow("kicked") << GroupMessageEnum::STATE_KICKED << data;
+    }
+    {
+        QVariantMap data;
+        data["text"] = QString();
+        QTest::newRow("ack") << GroupMessageEnum::ACK << data;
+    }
+}
+
+void TestGroupMessages::roundTripTest()
+{
+    QFETCH(GroupMessageEnum, message);
+    QFETCH(QVariantMap, data);
+
+    QVariantMap fromXml;
+    GroupMessageEnum xmlMessage = GroupMessageEnum::NONE;
+    QVERIFY(parseXmlMessage(formXmlMessageBlock(message, data), xmlMessage, fromXml));
+    QCOMPARE(xmlMessage, message);
+
+    QVariantMap fromBinary;
+    GroupMessageEnum binaryMessage = GroupMessageEnum::NONE;
+    QVERIFY(parseBinaryMessage(formBinaryMessageBlock(message, data), binaryMessage, fromBinary));
+    QCOMPARE(binaryMessage, message);
+
+    QCOMPARE(toStrings(fromBinary), toStrings(fromXml));
+}
+
+void TestGroupMessages::mapMessagesTest()
+{
+    QVariantMap data;
+    data["identity"] = QByteArray("\x01\x02\x03\x04", 4);
+    data["hashes"] = QByteArray(64, '\x7f');
+    data["level"] = 3u;
+    data["nodes"] = QByteArray("\x00\x80\xff", 3);
+
+    for (const GroupMessageEnum message : {GroupMessageEnum::REQ_MAP_HASHES,
+                                           GroupMessageEnum::MAP_HASHES,
+                                           GroupMessageEnum::REQ_MAP_ROOMS}) {
+        QVariantMap parsed;
+        GroupMessageEnum parsedMessage = GroupMessageEnum::NONE;
+        QVERIFY(parseBinaryMessage(formBinaryMessageBlock(message, data), parsedMessage, parsed));
+        QCOMPARE(parsedMessage, message);
+        QCOMPARE(parsed["nodes"].toByteArray(), data["nodes"].toByteArray());
+        if (message != GroupMessageEnum::REQ_MAP_ROOMS)
+            QCOMPARE(parsed["level"].toUInt(), 3u);
+        if (message == GroupMessageEnum::MAP_HASHES) {
+            QCOMPARE(parsed["identity"].toByteArray(), data["identity"].toByteArray());
+            QCOMPARE(parsed["hashes"].toByteArray(), data["hashes"].toByteArray());
+        }
+    }
+
+    // Empty fields are left out, and come back empty.
+    QVariantMap empty;
+    empty["rooms"] = QByteArray();
+    QVariantMap parsed;
+    GroupMessageEnum parsedMessage = GroupMessageEnum::NONE;
+    const QByteArray block = formBinaryMessageBlock(GroupMessageEnum::MAP_ROOMS, empty);
+    QCOMPARE(block, startMessage(GroupMessageEnum::MAP_ROOMS));
+    QVERIFY(parseBinaryMessage(block, parsedMessage, parsed));
+    QCOMPARE(parsedMessage, GroupMessageEnum::MAP_ROOMS);
+    QVERIFY(parsed.contains("rooms"));
+    QVERIFY(parsed["rooms"].toByteArray().isEmpty());
+}
+
+void TestGroupMessages::malformedTest()
+{
+    const auto parses = [](const QByteArray &block) {
+        GroupMessageEnum message = GroupMessageEnum::NONE;
+        QVariantMap data;
+        return parseBinaryMessage(block, message, data);
+    };
+
+    const QByteArray gtell = startMessage(GroupMessageEnum::GTELL);
+    QVERIFY(parses(gtell + TEXT_STRING + '\x02' + "hi"));
+
+    QVERIFY(!parses(QByteArray()));
+    // No message has this number.
+    const auto afterLast = static_cast<char>(static_cast<int>(GroupMessageEnum::MAP_ROOMS) + 1);
+    QVERIFY(!parses(QByteArray(1, afterLast)));
+    // Varints that stop in the middle, or run past ten bytes.
+    QVERIFY(!parses(QByteArray(1, '\x87')));
+    QVERIFY(!parses(gtell + '\x82'));
+    QVERIFY(!parses(gtell + HP_NUMBER + '\x80' + '\x80'));
+    QVERIFY(!parses(gtell + HP_NUMBER + QByteArray(11, '\xff')));
+    // A tag without its value.
+    QVERIFY(!parses(gtell + TEXT_STRING));
+    QVERIFY(!parses(gtell + HP_NUMBER));
+    // Lengths past the end of the message, including ones too big for an int.
+    QVERIFY(!parses(gtell + TEXT_STRING + '\x03' + "hi"));
+    QVERIFY(!parses(gtell + TEXT_STRING + "\xff\xff\xff\xff\x0f" + "hi"));
+    QVERIFY(!parses(gtell + TEXT_STRING + "\xff\xff\xff\xff\xff\xff\xff\xff\x7f" + "hi"));
+}
+
+void TestGroupMessages::wireTypeTest()
+{
+    // Known fields with the other wire type are skipped, like unknown ones.
+    {
+        const QByteArray block = startMessage(GroupMessageEnum::GTELL) + TEXT_NUMBER + '\x07'
+                                 + UNKNOWN_STRING + '\x01' + 'x' + TEXT_STRING + '\x02' + "hi";
+        GroupMessageEnum message = GroupMessageEnum::NONE;
+        QVariantMap data;
+        QVERIFY(parseBinaryMessage(block, message, data));
+        QCOMPARE(data["text"].toString(), QString("hi"));
+    }
+    {
+        const QByteArray block = startMessage(GroupMessageEnum::ADD_CHAR) + NAME_NUMBER + '\x05'
+                                 + HP_STRING + '\x02' + "12";
+        GroupMessageEnum message = GroupMessageEnum::NONE;
+        QVariantMap data;
+        QVERIFY(parseBinaryMessage(block, message, data));
+        const QVariantMap playerData = data["playerData"].toMap();
+        QCOMPARE(playerData["name"].userType(), static_cast<int>(QMetaType::QString));
+        QCOMPARE(playerData["name"].toString(), QString());
+        QCOMPARE(playerData["hp"].userType(), static_cast<int>(QMetaType::Int));
+        QCOMPARE(playerData["hp"].toInt(), 0);
+    }
+    {
+        // Zigzag: 5 is -3.
+        const QByteArray block = startMessage(GroupMessageEnum::ADD_CHAR) + NAME_STRING + '\x03'
+                                 + "Bob" + HP_NUMBER + '\x05';
+        GroupMessageEnum message = GroupMessageEnum::NONE;
+        QVariantMap data;
+        QVERIFY(parseBinaryMessage(block, message, data));
+        const QVariantMap playerData = data["playerData"].toMap();
+        QCOMPARE(playerData["name"].toString(), QString("Bob"));
+        QCOMPARE(playerData["hp"].toInt(), -3);
+    }
+}
+
+QTEST_MAIN(TestGroupMessages)
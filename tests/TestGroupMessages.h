@@ -0,0 +1,20 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <QObject>
+
+class TestGroupMessages final : public QObject
+{
+    Q_OBJECT
+public:
+    TestGroupMessages();
+    ~TestGroupMessages() override;
+
+private Q_SLOTS:
+    void roundTripTest_data();
+    void roundTripTest();
+    void mapMessagesTest();
+    void malformedTest();
+    void wireTypeTest();
+};
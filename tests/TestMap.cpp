@@ -0,0 +1,273 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "TestMap.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <QtTest/QtTest>
+
+#include "../src/expandoracommon/coordinate.h"
+#include "../src/expandoracommon/room.h"
+#include "../src/global/roomid.h"
+#include "../src/mapfrontend/map.h"
+#include "../src/mapfrontend/roomcollection.h"
+
+namespace { // anonymous
+
+// The grid's tiles are 16 by 16, so these straddle the tiles around the origin,
+// including the ones with negative coordinates.
+const std::vector<Coordinate> &getCoordinates()
+{
+    static const std::vector<Coordinate> coordinates = [] {
+        std::vector<Coordinate> result;
+        for (const int y : {-17, -16, -1, 0, 15, 16}) {
+            for (const int x : {-17, -16, -1, 0, 15, 16})
+                result.emplace_back(x, y, 0);
+        }
+        result.emplace_back(0, 0, -1);
+        result.emplace_back(-16, 16, 2);
+        return result;
+    }();
+    return coordinates;
+}
+
+// Places the rooms of getCoordinates(), in order, so room i has RoomId{i}.
+std::vector<std::shared_ptr<Room>> fillMap(RoomModificationTracker &tracker, Map &map)
+{
+    std::vector<std::shared_ptr<Room>> rooms;
+    const auto &coordinates = getCoordinates();
+    for (size_t i = 0; i < coordinates.size(); ++i) {
+        auto room = Room::createPermanentRoom(tracker);
+        room->setId(RoomId{static_cast<uint32_t>(i)});
+        if (map.setNearest(coordinates[i], *room) != coordinates[i])
+            qFatal("coordinate %zu was already taken", i);
+        rooms.emplace_back(std::move(room));
+    }
+    return rooms;
+}
+
+std::vector<RoomId> visitWindow(const Map &map, const Coordinate &min, const Coordinate &max)
+{
+    std::vector<RoomId> result;
+    map.forEachRoom(min, max, [&result](const Room *const room) {
+        result.emplace_back(room->getId());
+    });
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+std::vector<RoomId> expectWindow(const Coordinate &min, const Coordinate &max)
+{
+    std::vector<RoomId> result;
+    const auto &coordinates = getCoordinates();
+    for (size_t i = 0; i < coordinates.size(); ++i) {
+        const Coordinate &c = coordinates[i];
+        if (c.x >= min.x && c.x <= max.x && c.y >= min.y && c.y <= max.y && c.z >= min.z
+            && c.z <= max.z)
+            result.emplace_back(static_cast<uint32_t>(i));
+    }
+    return result;
+}
+
+std::vector<RoomId> collectIds(const RoomCollection &collection, const RoomIndex &index)
+{
+    std::vector<RoomId> result;
+    collection.forEachRoom(index, [&result](const Room *const room) {
+        result.emplace_back(room->getId());
+    });
+    return result;
+}
+
+} // namespace
+
+TestMap::TestMap() = default;
+
+TestMap::~TestMap() = default;
+
+void TestMap::gridTest()
+{
+    RoomModificationTracker tracker;
+    Map map;
+    QVERIFY(!map.getBounds().has_value());
+
+    const auto rooms = fillMap(tracker, map);
+    const auto &coordinates = getCoordinates();
+    for (size_t i = 0; i < coordinates.size(); ++i) {
+        QVERIFY(map.defined(coordinates[i]));
+        QCOMPARE(map.get(coordinates[i]), rooms[i].get());
+    }
+    // Next to rooms on either side of a tile boundary.
+    for (const Coordinate &c : {Coordinate{-18, 0, 0},
+                                Coordinate{-15, -1, 0},
+                                Coordinate{1, 0, 0},
+                                Coordinate{15, 14, 0},
+                                Coordinate{16, 17, 0},
+                                Coordinate{0, 0, 1}}) {
+        QVERIFY(!map.defined(c));
+        QCOMPARE(map.get(c), static_cast<Room *>(nullptr));
+    }
+
+    QCOMPARE(map.getBounds(), (OptMapExtent{MapExtent{Coordinate{-17, -17, -1},
+                                                      Coordinate{16, 16, 2}}}));
+    QCOMPARE(map.getLayerExtent(-1),
+             (OptMapExtent{MapExtent{Coordinate{0, 0, -1}, Coordinate{0, 0, -1}}}));
+
+    // A taken coordinate puts the room somewhere free instead.
+    auto extra = Room::createPermanentRoom(tracker);
+    const Coordinate moved = map.setNearest(Coordinate{-1, -1, 0}, *extra);
+    QVERIFY(moved != (Coordinate{-1, -1, 0}));
+    QCOMPARE(map.get(moved), extra.get());
+    QCOMPARE(map.get(Coordinate{-1, -1, 0}), rooms[14].get());
+    map.remove(moved);
+    QVERIFY(!map.defined(moved));
+
+    map.remove(Coordinate{0, 0, -1});
+    QVERIFY(!map.defined(Coordinate{0, 0, -1}));
+    QVERIFY(!map.getLayerExtent(-1).has_value());
+    map.remove(Coordinate{0, 0, -1});
+
+    // Emptying a tile doesn't disturb its neighbours.
+    map.remove(Coordinate{-1, -1, 0});
+    map.remove(Coordinate{-16, -1, 0});
+    map.remove(Coordinate{-1, -16, 0});
+    map.remove(Coordinate{-16, -16, 0});
+    QVERIFY(!map.defined(Coordinate{-1, -1, 0}));
+    QCOMPARE(map.get(Coordinate{-17, -1, 0}), rooms[12].get());
+    QCOMPARE(map.get(Coordinate{0, 0, 0}), rooms[21].get());
+    QCOMPARE(map.get(Coordinate{-1, -17, 0}), rooms[2].get());
+
+    map.clear();
+    QVERIFY(!map.getBounds().has_value());
+    QVERIFY(!map.defined(Coordinate{0, 0, 0}));
+}
+
+void TestMap::forEachRoomTest()
+{
+    RoomModificationTracker tracker;
+    Map map;
+    const auto rooms = fillMap(tracker, map);
+
+    std::vector<RoomId> all;
+    map.forEachRoom([&all](const Room *const room) { all.emplace_back(room->getId()); });
+    std::sort(all.begin(), all.end());
+    QCOMPARE(all, expectWindow(Coordinate{INT_MIN, INT_MIN, INT_MIN},
+                               Coordinate{INT_MAX, INT_MAX, INT_MAX}));
+    QCOMPARE(all.size(), getCoordinates().size());
+
+    const std::vector<std::pair<Coordinate, Coordinate>> windows{
+        // One cell, and a row and column across tile boundaries.
+        {Coordinate{-1, -1, 0}, Coordinate{-1, -1, 0}},
+        {Coordinate{-20, 0, 0}, Coordinate{20, 0, 0}},
+        {Coordinate{-16, -40, 0}, Coordinate{-16, 40, 0}},
+        // Inside a single tile, and across four tiles without covering them.
+        {Coordinate{1, 1, 0}, Coordinate{15, 15, 0}},
+        {Coordinate{-2, -2, 0}, Coordinate{3, 3, 0}},
+        // Only the other layers.
+        {Coordinate{-20, -20, 1}, Coordinate{20, 20, 5}},
+        {Coordinate{-20, -20, -5}, Coordinate{20, 20, -1}},
+        // Huge windows are clamped to the rooms' bounds.
+        {Coordinate{INT_MIN, INT_MIN, INT_MIN}, Coordinate{INT_MAX, INT_MAX, INT_MAX}},
+        {Coordinate{INT_MIN, 0, 0}, Coordinate{0, INT_MAX, 0}},
+        {Coordinate{-1000000, -1000000, 0}, Coordinate{1000000, 1000000, 0}},
+        // Nothing left after clamping.
+        {Coordinate{17, INT_MIN, INT_MIN}, Coordinate{INT_MAX, INT_MAX, INT_MAX}},
+        {Coordinate{-20, -20, 3}, Coordinate{20, 20, INT_MAX}},
+        {Coordinate{INT_MIN, INT_MIN, 0}, Coordinate{-18, INT_MAX, 0}},
+    };
+    for (const auto &window : windows) {
+        const std::vector<RoomId> visited = visitWindow(map, window.first, window.second);
+        QCOMPARE(visited, expectWindow(window.first, window.second));
+        QVERIFY(std::adjacent_find(visited.begin(), visited.end()) == visited.end());
+    }
+    QVERIFY(visitWindow(map, Coordinate{1, 1, 0}, Coordinate{14, 14, 0}).empty());
+
+    map.remove(Coordinate{0, 0, 0});
+    QCOMPARE(visitWindow(map, Coordinate{0, 0, 0}, Coordinate{0, 0, 0}), std::vector<RoomId>{});
+    map.clear();
+    QVERIFY(visitWindow(map, Coordinate{INT_MIN, INT_MIN, INT_MIN},
+                        Coordinate{INT_MAX, INT_MAX, INT_MAX})
+                .empty());
+}
+
+void TestMap::roomCollectionTest()
+{
+    RoomModificationTracker tracker;
+    RoomIndex index;
+    index.resize(10);
+    for (uint32_t i = 0; i < 10; ++i) {
+        const RoomId id{i};
+        index[id] = Room::createPermanentRoom(tracker);
+        index[id]->setId(id);
+    }
+    const auto ids = [](const std::initializer_list<uint32_t> values) {
+        std::vector<RoomId> result;
+        for (const uint32_t value : values)
+            result.emplace_back(value);
+        return result;
+    };
+
+    // The first four are kept inline, sorted whatever order they come in.
+    RoomCollection collection;
+    const size_t inlineBytes = collection.getMemoryBytes();
+    for (const uint32_t i : {5u, 1u, 3u, 5u, 7u})
+        collection.addRoom(index[RoomId{i}]);
+    QCOMPARE(collection.size(), size_t{4});
+    QCOMPARE(collectIds(collection, index), ids({1, 3, 5, 7}));
+    QCOMPARE(collection.getMemoryBytes(), inlineBytes);
+    QVERIFY(collection.contains(RoomId{3}));
+    QVERIFY(!collection.contains(RoomId{4}));
+
+    // The fifth spills them all to the heap, in order, wherever it goes.
+    collection.addRoom(index[RoomId{4}]);
+    QCOMPARE(collection.size(), size_t{5});
+    QCOMPARE(collectIds(collection, index), ids({1, 3, 4, 5, 7}));
+    QVERIFY(collection.getMemoryBytes() > inlineBytes);
+    collection.addRoom(index[RoomId{0}]);
+    collection.addRoom(index[RoomId{9}]);
+    collection.addRoom(index[RoomId{4}]);
+    QCOMPARE(collectIds(collection, index), ids({0, 1, 3, 4, 5, 7, 9}));
+    QVERIFY(collection.contains(RoomId{9}));
+
+    // Removing down to four moves them back inline.
+    collection.removeRoom(index[RoomId{2}]);
+    collection.removeRoom(index[RoomId{9}]);
+    collection.removeRoom(index[RoomId{0}]);
+    QCOMPARE(collection.size(), size_t{5});
+    collection.removeRoom(index[RoomId{4}]);
+    QCOMPARE(collection.size(), size_t{4});
+    QCOMPARE(collectIds(collection, index), ids({1, 3, 5, 7}));
+    QCOMPARE(collection.getMemoryBytes(), inlineBytes);
+    QVERIFY(!collection.contains(RoomId{4}));
+
+    // ... and spilling again still keeps them in order.
+    collection.addRoom(index[RoomId{2}]);
+    QCOMPARE(collectIds(collection, index), ids({1, 2, 3, 5, 7}));
+    collection.removeRoom(index[RoomId{1}]);
+    QCOMPARE(collectIds(collection, index), ids({2, 3, 5, 7}));
+
+    // Inline removals shift the rest down.
+    collection.removeRoom(index[RoomId{3}]);
+    collection.removeRoom(index[RoomId{3}]);
+    QCOMPARE(collectIds(collection, index), ids({2, 5, 7}));
+    collection.removeRoom(index[RoomId{7}]);
+    collection.removeRoom(index[RoomId{2}]);
+    QCOMPARE(collectIds(collection, index), ids({5}));
+
+    // Rooms that are gone from the index are skipped.
+    collection.addRoom(index[RoomId{8}]);
+    index[RoomId{5}].reset();
+    QCOMPARE(collectIds(collection, index), ids({8}));
+    QCOMPARE(collection.size(), size_t{2});
+
+    collection.clear();
+    QCOMPARE(collection.size(), size_t{0});
+    QVERIFY(collectIds(collection, index).empty());
+}
+
+QTEST_MAIN(TestMap)
@@ -0,0 +1,18 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <QObject>
+
+class TestMap final : public QObject
+{
+    Q_OBJECT
+public:
+    TestMap();
+    ~TestMap() override;
+
+private Q_SLOTS:
+    void gridTest();
+    void forEachRoomTest();
+    void roomCollectionTest();
+};
@@ -0,0 +1,298 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include "TestMapDigest.h"
+
+#include <cstdint>
+#include <variant>
+#include <vector>
+#include <QByteArray>
+#include <QString>
+#include <QtTest/QtTest>
+
+#include "../src/expandoracommon/coordinate.h"
+#include "../src/expandoracommon/exit.h"
+#include "../src/expandoracommon/room.h"
+#include "../src/global/roomid.h"
+#include "../src/mapdata/ExitDirection.h"
+#include "../src/mapdata/ExitFlags.h"
+#include "../src/mapdata/MapDigest.h"
+#include "../src/mapdata/MapEditHistory.h"
+#include "../src/mapdata/MapSnapshot.h"
+#include "../src/mapdata/mmapper2room.h"
+
+namespace { // anonymous
+
+// Rooms 0..n-1 from west to east; each leads east to the next and back.
+RoomIndex makeRooms(RoomModificationTracker &tracker, const uint32_t n)
+{
+    RoomIndex index;
+    index.resize(n);
+    for (uint32_t i = 0; i < n; ++i) {
+        const RoomId id{i};
+        index[id] = Room::createPermanentRoom(tracker);
+        index[id]->setId(id);
+        index[id]->setPosition(Coordinate{static_cast<int>(i), 0, 0});
+        index[id]->setName(RoomName{QString("Room %1").arg(i)});
+    }
+    for (uint32_t i = 0; i + 1 < n; ++i) {
+        ExitsList west = index[RoomId{i}]->getExitsList();
+        ExitsList east = index[RoomId{i + 1}]->getExitsList();
+        west[ExitDirEnum::EAST].setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+        west[ExitDirEnum::EAST].addOut(RoomId{i + 1});
+        west[ExitDirEnum::EAST].addIn(RoomId{i + 1});
+        east[ExitDirEnum::WEST].setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+        east[ExitDirEnum::WEST].addOut(RoomId{i});
+        east[ExitDirEnum::WEST].addIn(RoomId{i});
+        index[RoomId{i}]->setExitsList(west);
+        index[RoomId{i + 1}]->setExitsList(east);
+    }
+    return index;
+}
+
+SharedMapSnapshot takeSnapshot(const uint64_t generation,
+                               const RoomIndex &index,
+                               const MapSnapshot *const prev,
+                               const RoomId dirty)
+{
+    return MapSnapshot::build(generation, index, prev, [dirty](const RoomId id) {
+        return id == dirty;
+    });
+}
+
+const MapEditHistory::RoomState *findState(const SyncTarget &target, const RoomId id)
+{
+    for (const MapEditHistory::RoomState &state : target.rooms) {
+        if (state.id == id)
+            return &state;
+    }
+    return nullptr;
+}
+
+// What MapData::undo() and redo() do to the rooms, without the map or the parse tree.
+void applyEdit(RoomIndex &index,
+               const MapEditHistory::Edit &edit,
+               const MapEditDirectionEnum direction)
+{
+    const bool undo = direction == MapEditDirectionEnum::UNDO;
+    for (const MapEditHistory::RoomDelta &delta : edit.rooms) {
+        Room &room = *index[delta.id];
+        for (const MapEditHistory::FieldChange &change : delta.changes) {
+            const MapEditHistory::FieldValue &value = undo ? change.before : change.after;
+            if (const auto *const pos = std::get_if<Coordinate>(&value))
+                room.setPosition(*pos);
+            else if (const auto *const flags = std::get_if<RoomMobFlags>(&value))
+                room.setMobFlags(*flags);
+            else
+                QFAIL("the edit changed a field that it shouldn't have");
+        }
+    }
+}
+
+} // namespace
+
+TestMapDigest::TestMapDigest() = default;
+
+TestMapDigest::~TestMapDigest() = default;
+
+void TestMapDigest::digestDiffTest()
+{
+    RoomModificationTracker tracker;
+    RoomIndex index = makeRooms(tracker, 3);
+    const SharedMapSnapshot before = takeSnapshot(1, index, nullptr, INVALID_ROOMID);
+    const SharedMapDigest a = MapDigest::build(before, nullptr, 0);
+    // Without an identity, the map is known by its rooms.
+    QCOMPARE(a->getMapIdentity(), a->getHash(0, 0));
+    QVERIFY(a->getHash(0, 0) != 0);
+    QCOMPARE(a->getHash(MapDigest::ROOM_LEVEL, 3), uint64_t{0});
+
+    // An identical copy has identical hashes.
+    RoomModificationTracker otherTracker;
+    const RoomIndex copy = makeRooms(otherTracker, 3);
+    const SharedMapDigest b = MapDigest::build(takeSnapshot(1, copy, nullptr, INVALID_ROOMID),
+                                               nullptr,
+                                               a->getMapIdentity());
+    for (uint32_t level = 0; level < MapDigest::NUM_LEVELS; ++level)
+        QCOMPARE(b->getHash(level, 0), a->getHash(level, 0));
+
+    // Only the changed room and the ranges above it differ; the identity stays.
+    index[RoomId{1}]->setName(RoomName{"Renamed"});
+    const SharedMapSnapshot after = takeSnapshot(2, index, before.get(), RoomId{1});
+    const SharedMapDigest c = MapDigest::build(after, a.get(), a->getMapIdentity());
+    QCOMPARE(c->getMapIdentity(), a->getMapIdentity());
+    QCOMPARE(c->getHash(MapDigest::ROOM_LEVEL, 0), a->getHash(MapDigest::ROOM_LEVEL, 0));
+    QVERIFY(c->getHash(MapDigest::ROOM_LEVEL, 1) != a->getHash(MapDigest::ROOM_LEVEL, 1));
+    QCOMPARE(c->getHash(MapDigest::ROOM_LEVEL, 2), a->getHash(MapDigest::ROOM_LEVEL, 2));
+    for (uint32_t level = 0; level < MapDigest::ROOM_LEVEL; ++level)
+        QVERIFY(c->getHash(level, 0) != a->getHash(level, 0));
+    QCOMPARE(c->getHash(MapDigest::ROOM_LEVEL, 1), MapDigest::hashRoom(*index[RoomId{1}]));
+
+    // A missing room hashes to 0.
+    index[RoomId{2}].reset();
+    const SharedMapDigest d = MapDigest::build(takeSnapshot(3, index, after.get(), RoomId{2}),
+                                               c.get(),
+                                               c->getMapIdentity());
+    QCOMPARE(d->getHash(MapDigest::ROOM_LEVEL, 2), uint64_t{0});
+    QVERIFY(d->getHash(0, 0) != c->getHash(0, 0));
+}
+
+void TestMapDigest::syncedRoomsTest()
+{
+    RoomModificationTracker tracker;
+    RoomIndex index = makeRooms(tracker, 2);
+    index[RoomId{1}]->setNote(RoomNote{"private"});
+    const SharedMapDigest digest
+        = MapDigest::build(takeSnapshot(1, index, nullptr, INVALID_ROOMID), nullptr, 42);
+    const std::vector<RoomId> ids{RoomId{1}, RoomId{0}, RoomId{7}};
+
+    const auto withoutNotes = decodeSyncedRooms(encodeSyncedRooms(*digest, ids, false));
+    QVERIFY(withoutNotes.has_value());
+    QCOMPARE(withoutNotes->mapIdentity, uint64_t{42});
+    QVERIFY(!withoutNotes->hasNotes);
+    // In the order asked for, without the missing room.
+    QCOMPARE(withoutNotes->rooms.size(), size_t{2});
+    QCOMPARE(withoutNotes->rooms[0].id, RoomId{1});
+    QCOMPARE(withoutNotes->rooms[1].id, RoomId{0});
+    QVERIFY(withoutNotes->rooms[0].Note.isEmpty());
+    QCOMPARE(withoutNotes->rooms[0].Name.toQString(), QString("Room 1"));
+    QVERIFY(withoutNotes->rooms[0].exits[ExitDirEnum::WEST].containsOut(RoomId{0}));
+    QVERIFY(withoutNotes->rooms[0].exits[ExitDirEnum::WEST].containsIn(RoomId{0}));
+
+    const QByteArray encoded = encodeSyncedRooms(*digest, ids, true);
+    const auto withNotes = decodeSyncedRooms(encoded);
+    QVERIFY(withNotes.has_value());
+    QVERIFY(withNotes->hasNotes);
+    QCOMPARE(withNotes->rooms[0].Note.toQString(), QString("private"));
+
+    QVERIFY(!decodeSyncedRooms(encoded.left(encoded.size() - 1)).has_value());
+    QVERIFY(!decodeSyncedRooms(QByteArray()).has_value());
+}
+
+void TestMapDigest::syncTargetTest()
+{
+    // Here, 0 <-> 1 <-> 2 from west to east; the sender has moved room 0's east
+    // exit to room 2, and has a room 9 that this map doesn't.
+    RoomModificationTracker tracker;
+    RoomIndex index = makeRooms(tracker, 3);
+    index[RoomId{0}]->setNote(RoomNote{"mine"});
+
+    SyncedRooms synced;
+    synced.mapIdentity = 1;
+    {
+        MapEditHistory::RoomState state = MapEditHistory::captureRoom(*index[RoomId{0}]);
+        Exit &east = state.exits[ExitDirEnum::EAST];
+        east.removeOut(RoomId{1});
+        east.addOut(RoomId{2});
+        east.addOut(RoomId{9});
+        // Whatever the sender thinks leads in is ignored.
+        east.addIn(RoomId{2});
+        state.Note = RoomNote{"theirs"};
+        synced.rooms.emplace_back(state);
+    }
+    {
+        MapEditHistory::RoomState state;
+        state.id = RoomId{9};
+        synced.rooms.emplace_back(state);
+    }
+
+    const SyncTarget target = buildSyncTarget(index, synced);
+    QCOMPARE(target.numSynced, size_t{1});
+    QCOMPARE(target.numOnlyThere, size_t{1});
+    QCOMPARE(target.rooms.size(), size_t{3});
+    QCOMPARE(target.rooms[0].id, RoomId{0});
+
+    const MapEditHistory::RoomState &room0 = target.rooms[0];
+    QCOMPARE(room0.Note.toQString(), QString("mine"));
+    const Exit &east = room0.exits[ExitDirEnum::EAST];
+    QVERIFY(east.containsOut(RoomId{2}));
+    QVERIFY(!east.containsOut(RoomId{1}));
+    QVERIFY(!east.containsOut(RoomId{9}));
+    // Room 1 still leads west into room 0.
+    QVERIFY(east.containsIn(RoomId{1}));
+    QVERIFY(!east.containsIn(RoomId{2}));
+
+    // Every exit is entered at its other end, and no longer where it used to lead.
+    const MapEditHistory::RoomState *const room1 = findState(target, RoomId{1});
+    const MapEditHistory::RoomState *const room2 = findState(target, RoomId{2});
+    QVERIFY(room1 != nullptr && room2 != nullptr);
+    QVERIFY(!room1->exits[ExitDirEnum::WEST].containsIn(RoomId{0}));
+    QVERIFY(room1->exits[ExitDirEnum::WEST].containsOut(RoomId{0}));
+    QVERIFY(room2->exits[ExitDirEnum::WEST].containsIn(RoomId{0}));
+    QVERIFY(room2->exits[ExitDirEnum::WEST].containsIn(RoomId{1}));
+
+    // With the sender's notes, theirs win.
+    synced.hasNotes = true;
+    QCOMPARE(buildSyncTarget(index, synced).rooms[0].Note.toQString(), QString("theirs"));
+}
+
+void TestMapDigest::packTest()
+{
+    const std::vector<uint32_t> nodes{0, 1, 127, 128, 300, MapDigest::MAX_ROOM_IDS - 1};
+    QCOMPARE(unpackMapNodes(packMapNodes(nodes)).value(), nodes);
+    QCOMPARE(unpackMapNodes(QByteArray()).value(), std::vector<uint32_t>{});
+    // A varint that doesn't end, and an id past the digest's.
+    QVERIFY(!unpackMapNodes(QByteArray("\x80", 1)).has_value());
+    QVERIFY(!unpackMapNodes(packMapNodes({MapDigest::MAX_ROOM_IDS})).has_value());
+
+    const std::vector<uint64_t> hashes{0, 1, 0x0123456789ABCDEFull, UINT64_MAX};
+    const QByteArray packed = packMapHashes(hashes);
+    QCOMPARE(packed.size(), 32);
+    // Little-endian whatever the platform's.
+    QCOMPARE(static_cast<uint8_t>(packed.at(16)), uint8_t{0xEF});
+    QCOMPARE(unpackMapHashes(packed).value(), hashes);
+    QVERIFY(!unpackMapHashes(packed.left(31)).has_value());
+}
+
+void TestMapDigest::editHistoryTest()
+{
+    RoomModificationTracker tracker;
+    RoomIndex index = makeRooms(tracker, 3);
+    MapEditHistory history;
+    QVERIFY(!history.canUndo());
+
+    // As MoveRelative{Coordinate{0, 5, 0}} and ModifyRoomFlags{RoomMobFlagEnum::RENT, SET} do
+    // to rooms 0 and 1.
+    const RoomIdSet affected{RoomId{0}, RoomId{1}};
+    const auto before = MapEditHistory::capture(index, affected);
+    for (const RoomId id : affected) {
+        Room &room = *index[id];
+        room.setPosition(room.getPosition() + Coordinate{0, 5, 0});
+        room.setMobFlags(room.getMobFlags() | RoomMobFlagEnum::RENT);
+    }
+    history.record(before, index);
+    QVERIFY(history.canUndo());
+    QVERIFY(!history.canRedo());
+
+    const MapEditHistory::SharedEdit edit = history.getUndo();
+    QCOMPARE(edit->rooms.size(), size_t{2});
+    QVERIFY(MapEditHistory::isCurrent(*edit, index, MapEditDirectionEnum::UNDO));
+    // Nothing has been undone yet.
+    QVERIFY(!MapEditHistory::isCurrent(*edit, index, MapEditDirectionEnum::REDO));
+
+    applyEdit(index, *edit, MapEditDirectionEnum::UNDO);
+    history.onUndone();
+    QCOMPARE(index[RoomId{1}]->getPosition(), (Coordinate{1, 0, 0}));
+    QVERIFY(!index[RoomId{1}]->getMobFlags().contains(RoomMobFlagEnum::RENT));
+    QVERIFY(!history.canUndo());
+    QVERIFY(history.canRedo());
+
+    QCOMPARE(history.getRedo(), edit);
+    QVERIFY(MapEditHistory::isCurrent(*edit, index, MapEditDirectionEnum::REDO));
+    applyEdit(index, *edit, MapEditDirectionEnum::REDO);
+    history.onRedone();
+    QCOMPARE(index[RoomId{1}]->getPosition(), (Coordinate{1, 5, 0}));
+    QVERIFY(index[RoomId{1}]->getMobFlags().contains(RoomMobFlagEnum::RENT));
+    QVERIFY(history.canUndo());
+    QVERIFY(!history.canRedo());
+
+    // Changed without being logged (e.g. by the group), so undoing would revert it as well,
+    // and MapData refuses.
+    index[RoomId{0}]->setMobFlags(RoomMobFlags{});
+    QVERIFY(!MapEditHistory::isCurrent(*history.getUndo(), index, MapEditDirectionEnum::UNDO));
+    // Rooms that the edit didn't touch don't matter.
+    index[RoomId{0}]->setMobFlags(RoomMobFlags{RoomMobFlagEnum::RENT});
+    index[RoomId{2}]->setMobFlags(RoomMobFlags{RoomMobFlagEnum::SHOP});
+    QVERIFY(MapEditHistory::isCurrent(*history.getUndo(), index, MapEditDirectionEnum::UNDO));
+}
+
+QTEST_MAIN(TestMapDigest)
@@ -0,0 +1,20 @@
+#pragma once
+// SPDX-License-Identifier: GPL-2.0-or-later
+// Copyright (C) 2019 The MMapper Authors
+
+#include <QObject>
+
+class TestMapDigest final : public QObject
+{
+    Q_OBJECT
+public:
+    TestMapDigest();
+    ~TestMapDigest() override;
+
+private Q_SLOTS:
+    void digestDiffTest();
+    void syncedRoomsTest();
+    void syncTargetTest();
+    void packTest();
+    void editHistoryTest();
+};
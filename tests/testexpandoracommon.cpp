@@ -440,3 +440,134 @@ void TestExpandoraCommon::roomCompareTest()
 }
 
 QTEST_MAIN(TestExpandoraCommon)
+
+void TestExpandoraCommon::roomFlagSignatureTest()
+{
+    static TestRoomAdmin admin;
+    const auto room = Room::createPermanentRoom(admin);
+    QVERIFY(room->getFlagSignature().empty());
+
+    const auto has = [&room](const auto flag) -> bool {
+        RoomFlagSignature mask;
+        mask.add(flag);
+        return room->getFlagSignature().intersects(mask);
+    };
+
+    room->setMobFlags(RoomMobFlags{RoomMobFlagEnum::RENT});
+    room->setLightType(RoomLightEnum::DARK);
+    room->setDoorFlags(ExitDirEnum::WEST, DoorFlags{DoorFlagEnum::HIDDEN});
+    room->setExitFlags(ExitDirEnum::NORTH, ExitFlags{ExitFlagEnum::ROAD});
+    QVERIFY(has(RoomMobFlagEnum::RENT));
+    QVERIFY(has(RoomLightEnum::DARK));
+    QVERIFY(has(DoorFlagEnum::HIDDEN));
+    QVERIFY(has(ExitFlagEnum::ROAD));
+    QVERIFY(!has(RoomMobFlagEnum::SHOP));
+    QVERIFY(!has(RoomLightEnum::LIT));
+    QVERIFY(!has(DoorFlagEnum::NEED_KEY));
+    QVERIFY(!has(ExitFlagEnum::CLIMB));
+    QVERIFY(!has(RoomLoadFlagEnum::TREASURE));
+
+    // Flags of other exits still count after one exit loses its flags.
+    room->setExitFlags(ExitDirEnum::SOUTH, ExitFlags{ExitFlagEnum::ROAD});
+    room->setExitFlags(ExitDirEnum::NORTH, ExitFlags{});
+    QVERIFY(has(ExitFlagEnum::ROAD));
+    room->setExitFlags(ExitDirEnum::SOUTH, ExitFlags{});
+    QVERIFY(!has(ExitFlagEnum::ROAD));
+
+    room->setLightType(RoomLightEnum::UNDEFINED);
+    QVERIFY(!has(RoomLightEnum::DARK));
+    QVERIFY(room->clone(admin)->getFlagSignature() == room->getFlagSignature());
+}
+
+void TestExpandoraCommon::exitLayoutTest()
+{
+    static TestRoomAdmin admin;
+    const auto setExit = [](Exit &e, const int kind) {
+        switch (kind) {
+        case 1:
+            e.setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+            break;
+        case 2:
+            e.setExitFlags(ExitFlags{ExitFlagEnum::EXIT | ExitFlagEnum::DOOR});
+            break;
+        case 3:
+            e.setExitFlags(ExitFlags{ExitFlagEnum::EXIT | ExitFlagEnum::DOOR});
+            e.setDoorFlags(DoorFlags{DoorFlagEnum::HIDDEN});
+            break;
+        case 4:
+            e.setExitFlags(ExitFlags{ExitFlagEnum::EXIT | ExitFlagEnum::NO_MATCH});
+            break;
+        default:
+            break;
+        }
+    };
+    const auto seenExit = [](const int kind) -> ExitFlags {
+        switch (kind) {
+        case 1:
+            return ExitFlags{ExitFlagEnum::EXIT};
+        case 2:
+            return ExitFlags{ExitFlagEnum::EXIT | ExitFlagEnum::DOOR};
+        default:
+            return ExitFlags{};
+        }
+    };
+
+    // ParseTree::getRooms() may only drop rooms that compareWeakProps() rejects.
+    int numRuledOut = 0;
+    for (const bool upToDate : {true, false}) {
+        for (int n = 0; n < 5 * 5 * 3 * 3; ++n) {
+            ExitsList exits;
+            setExit(exits[ExitDirEnum::NORTH], n % 5);
+            setExit(exits[ExitDirEnum::SOUTH], (n / 5) % 5);
+            setExit(exits[ExitDirEnum::EAST], 1);
+            const auto room = Room::createPermanentRoom(admin);
+            room->setExitsList(exits);
+            if (upToDate)
+                room->setUpToDate();
+
+            ExitsFlagsType seen;
+            seen.set(ExitDirEnum::NORTH, seenExit((n / 25) % 3));
+            seen.set(ExitDirEnum::SOUTH, seenExit(n / 75));
+            seen.set(ExitDirEnum::EAST, ExitFlagEnum::EXIT);
+            seen.setValid();
+            const auto event = ParseEvent::createEvent(CommandEnum::NORTH,
+                                                       RoomName{},
+                                                       RoomDynamicDesc{},
+                                                       RoomStaticDesc{},
+                                                       seen,
+                                                       PromptFlagsType{},
+                                                       ConnectedRoomFlagsType{});
+
+            if (room->getExitLayout().rulesOut(ExitLayout::fromEvent(seen), upToDate)) {
+                ++numRuledOut;
+                QCOMPARE(Room::compareWeakProps(room.get(), *event),
+                         ComparisonResultEnum::DIFFERENT);
+            }
+        }
+    }
+    QVERIFY(numRuledOut > 0);
+}
+
+void TestExpandoraCommon::exitRenderMasksTest()
+{
+    static TestRoomAdmin admin;
+    const auto room = Room::createPermanentRoom(admin);
+    QVERIFY(room->getExitRenderMasks() == ExitRenderMasks{});
+
+    const auto bit = [](const ExitDirEnum dir) { return ExitRenderMasks::dirBit(dir); };
+    room->setExitFlags(ExitDirEnum::NORTH, ExitFlagEnum::EXIT | ExitFlagEnum::ROAD);
+    room->setExitFlags(ExitDirEnum::DOWN, ExitFlagEnum::EXIT | ExitFlagEnum::FLOW);
+    room->setExitFlags(ExitDirEnum::WEST, ExitFlagEnum::EXIT | ExitFlagEnum::GUARDED);
+    QCOMPARE(room->getExitRenderMasks().roads, bit(ExitDirEnum::NORTH));
+    QCOMPARE(room->getExitRenderMasks().flows, bit(ExitDirEnum::DOWN));
+    QVERIFY(room->getExitRenderMasks().hasColoredWall(ExitDirEnum::WEST));
+    QVERIFY(!room->getExitRenderMasks().hasColoredWall(ExitDirEnum::NORTH));
+
+    // Exits edited through the whole list are covered too.
+    ExitsList exits = room->getExitsList();
+    exits[ExitDirEnum::NORTH].setExitFlags(ExitFlags{ExitFlagEnum::EXIT});
+    exits[ExitDirEnum::SOUTH].setExitFlags(ExitFlagEnum::EXIT | ExitFlagEnum::ROAD);
+    room->setExitsList(exits);
+    QCOMPARE(room->getExitRenderMasks().roads, bit(ExitDirEnum::SOUTH));
+    QVERIFY(room->clone(admin)->getExitRenderMasks() == room->getExitRenderMasks());
+}
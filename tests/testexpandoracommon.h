@@ -25,4 +25,7 @@ private Q_SLOTS:
     void stringPropertyTest();
     void roomCompareTest_data();
     void roomCompareTest();
+    void roomFlagSignatureTest();
+    void exitLayoutTest();
+    void exitRenderMasksTest();
 };
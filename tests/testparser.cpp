@@ -4,6 +4,10 @@
 #include "testparser.h"
 
 #include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+#include <QByteArray>
 #include <QDebug>
 #include <QString>
 #include <QtTest/QtTest>
@@ -11,7 +15,10 @@
 #include "../src/expandoracommon/parseevent.h"
 #include "../src/expandoracommon/property.h"
 #include "../src/global/TextUtils.h"
+#include "../src/global/entities.h"
 #include "../src/mapdata/mmapper2room.h"
+#include "../src/parser/Action.h"
+#include "../src/parser/CommandQueue.h"
 #include "../src/parser/parserutils.h"
 
 TestParser::TestParser() = default;
@@ -32,6 +39,10 @@ void TestParser::latinToAsciiTest()
     const QString expectedAscii("Norui Ninui");
     ParserUtils::toAsciiInPlace(utf8);
     QCOMPARE(utf8, expectedAscii);
+
+    QByteArray latin1 = QString("Nórui Nínui").toLatin1();
+    ParserUtils::latin1ToAsciiInPlace(latin1);
+    QCOMPARE(latin1, expectedAscii.toLatin1());
 }
 
 void TestParser::createParseEventTest()
@@ -70,4 +81,145 @@ void TestParser::createParseEventTest()
              ::toQStringLatin1(std::string(1, static_cast<char>(terrain))));
 }
 
+void TestParser::entitiesTest()
+{
+    // start, length, and the decoded character, or -1 if it's unknown or invalid
+    using Found = std::tuple<int, int, int>;
+    struct Recorder final : entities::EntityCallback
+    {
+        std::vector<Found> found;
+        void decodedEntity(const int start, const int len, const OptQChar decoded) override
+        {
+            found.emplace_back(start, len, decoded ? static_cast<int>(decoded->unicode()) : -1);
+        }
+    };
+    const auto check = [](const char *const in,
+                          const std::vector<Found> &expectFound,
+                          const char *const expectDecoded) {
+        const QString input = QString::fromLatin1(in);
+        Recorder recorder;
+        entities::foreachEntity(QStringRef{&input}, recorder);
+        QCOMPARE(recorder.found, expectFound);
+        QCOMPARE(static_cast<QString>(entities::decode(entities::EncodedLatin1{in})),
+                 QString::fromLatin1(expectDecoded));
+    };
+
+    check("", {}, "");
+    check("&;", {}, "&;");
+    check("&&", {}, "&&");
+    check("&&;", {}, "&&;");
+    check("&", {}, "&");
+    check("&lt", {}, "&lt");
+    check("&lt;", {Found{0, 4, '<'}}, "<");
+    check("&lt&lt;", {Found{3, 4, '<'}}, "&lt<");
+    check("a&lt;b&gt;", {Found{1, 4, '<'}, Found{6, 4, '>'}}, "a<b>");
+    check("&foo;", {Found{0, 5, -1}}, "?");
+
+    // Without the '#', these are names (or not even that), not numbers.
+    check("&1114111;", {}, "&1114111;");
+    check("&1114112;", {}, "&1114112;");
+    check("&x10FFFF;", {Found{0, 9, -1}}, "?");
+    check("&x110000;", {Found{0, 9, -1}}, "?");
+
+    check("&#65;", {Found{0, 5, 'A'}}, "A");
+    check("&#x41;&#x61;", {Found{0, 6, 'A'}, Found{6, 6, 'a'}}, "Aa");
+    check("&#1114112;", {Found{0, 10, -1}}, "?");
+    check("&#x110000;", {Found{0, 10, -1}}, "?");
+    check("&#x;", {Found{0, 4, -1}}, "?");
+
+    // The largest code point is valid, though a QChar can't hold it.
+    const QString largest = QString::fromLatin1("&#1114111; &#x10FFFF;");
+    Recorder recorder;
+    entities::foreachEntity(QStringRef{&largest}, recorder);
+    QCOMPARE(recorder.found.size(), size_t{2});
+    QCOMPARE(std::get<1>(recorder.found[0]), 10);
+    QVERIFY(std::get<2>(recorder.found[0]) != -1);
+    QCOMPARE(std::get<0>(recorder.found[1]), 11);
+    QVERIFY(std::get<2>(recorder.found[1]) != -1);
+}
+
+void TestParser::actionMatcherTest()
+{
+    ActionMatcher matcher;
+    QString fired;
+    const auto record = [&fired](const char c) {
+        return [&fired, c](StringView /*line*/) { fired += QChar::fromLatin1(c); };
+    };
+    matcher.addStartsWith("You go", record('a'));
+    matcher.addEndsWith("sends you sprawling.", record('b'));
+    matcher.addStartsWith("You go to sleep.", record('c'));
+    matcher.addRegex(R"(^\d+/\d+ hits.$)", record('d'));
+    matcher.addRegex(R"(^You .+ sleep.$)", record('e'));
+    matcher.addEndsWith("sprawling.", record('f'));
+    QCOMPARE(matcher.size(), size_t{6});
+
+    const auto matchLine = [&matcher, &fired](const std::string &line) -> QString {
+        fired.clear();
+        matcher.match(StringView{line});
+        return fired;
+    };
+    // Every action that matches is called, in the order they were added.
+    QCOMPARE(matchLine("You go to sleep."), QString("ace"));
+    QCOMPARE(matchLine("You go home."), QString("a"));
+    QCOMPARE(matchLine("12/34 hits."), QString("d"));
+    QCOMPARE(matchLine("The troll sends you sprawling."), QString("bf"));
+    QCOMPARE(matchLine("You"), QString());
+    QCOMPARE(matchLine(""), QString());
+
+    matcher.clear();
+    QCOMPARE(matcher.size(), size_t{0});
+    QCOMPARE(matchLine("You go to sleep."), QString());
+}
+
+void TestParser::commandQueueTest()
+{
+    CommandQueue queue;
+    QVERIFY(queue.isEmpty());
+    queue.append(CommandEnum::NORTH);
+    queue.append(CommandEnum::EAST);
+    queue.prepend(CommandEnum::UP);
+    QCOMPARE(queue.size(), size_t{3});
+    QCOMPARE(queue.toByteArray(), QByteArray("une"));
+
+    // Oldest first.
+    QCOMPARE(queue.dequeue(), CommandEnum::UP);
+    QCOMPARE(queue.dequeue(), CommandEnum::NORTH);
+    QCOMPARE(queue.dequeue(), CommandEnum::EAST);
+    QVERIFY(queue.isEmpty());
+
+    // The prepend wrapped the head back to the end of the ring; this moves it two
+    // cells before the end, so the next three commands wrap around it again.
+    for (size_t i = 0; i < CommandQueue::CAPACITY - 4; ++i) {
+        queue.append(CommandEnum::SOUTH);
+        std::ignore = queue.dequeue();
+    }
+    queue.append(CommandEnum::WEST);
+    queue.append(CommandEnum::NORTH);
+    queue.append(CommandEnum::DOWN);
+    QCOMPARE(queue.toByteArray(), QByteArray("wnd"));
+    QCOMPARE(queue.at(2), CommandEnum::DOWN);
+    QVERIFY_EXCEPTION_THROWN(std::ignore = queue.at(3), std::out_of_range);
+
+    // Equal commands from different heads are equal, whatever the versions.
+    CommandQueue other;
+    other = QByteArray("wnd");
+    QVERIFY(other.getVersion() != queue.getVersion());
+    QVERIFY(other == queue);
+    other.append(CommandEnum::EAST);
+    QVERIFY(other != queue);
+
+    // Adding to a full queue forgets what it held.
+    queue.clear();
+    for (size_t i = 0; i < CommandQueue::CAPACITY; ++i)
+        queue.append(CommandEnum::EAST);
+    QVERIFY(queue.isFull());
+    queue.append(CommandEnum::NORTH);
+    QCOMPARE(queue.size(), size_t{1});
+    QCOMPARE(queue.head(), CommandEnum::NORTH);
+    for (size_t i = 1; i < CommandQueue::CAPACITY; ++i)
+        queue.append(CommandEnum::EAST);
+    queue.prepend(CommandEnum::SOUTH);
+    QCOMPARE(queue.toByteArray(), QByteArray("s"));
+}
+
 QTEST_MAIN(TestParser)
@@ -17,4 +17,10 @@ private Q_SLOTS:
     void removeAnsiMarksTest();
     void latinToAsciiTest();
     void createParseEventTest();
+    // entities
+    void entitiesTest();
+    // Action
+    void actionMatcherTest();
+    // CommandQueue
+    void commandQueueTest();
 };